@@ -161,7 +161,7 @@ public:
         : clients(64), duration(10000000L, duration_t::queries_t), op_ratios(op_ratios_t()),
             keys(distr_t(8, 16)), values(distr_t(8, 128)),
             batch_factor(distr_t(1, 16)), range_size(distr_t(16, 128)),
-            distr(rnd_uniform_t), mu(1), pipeline_limit(0), ignore_protocol_errors(0)
+            distr(rnd_uniform_t), mu(1), pipeline_limit(0), ignore_protocol_errors(0), op_stats(0)
         {
             latency_file[0] = 0;
             worst_latency_file[0] = 0;
@@ -225,6 +225,7 @@ public:
     char db_file[MAX_FILE];
     int pipeline_limit;
     int ignore_protocol_errors;
+    int op_stats;
 };
 
 /* List supported protocols. */
@@ -237,6 +238,9 @@ void list_protocols() {
 #endif
 #ifdef USE_LIBMEMCACHED
     printf("libmemcached,");
+#endif
+#ifdef USE_RDB
+    printf("rdb,");
 #endif
     printf("sqlite");
 }
@@ -260,6 +264,8 @@ void usage(const char *name) {
     printf("\t-c, --clients\n\t\tNumber of concurrent clients. Defaults to [%d].\n", _d.clients);
     printf("\t--client-suffix\n\t\tAppend a per-client id to key names.\n");
     printf("\t--ignore-protocol-errors\n\t\tDo not quit if the protocol throws errors.\n");
+    printf("\t--op-stats\n\t\tAt the end of the run, print the throughput and latency percentiles\n" \
+           "\t\tof each operation type separately.\n");
     printf("\t-w, --workload\n\t\tTarget load to generate. Expects a value in format D/U/I/R/A/P/V/RR, where\n" \
            "\t\t\tD - number of deletes\n" \
            "\t\t\tU - number of updates\n" \
@@ -321,6 +327,11 @@ void usage(const char *name) {
     printf("\t\tFor mysql protocol the host argument should be in the following\n" \
            "\t\tformat: username/password@host:port+database.\n\n");
 #endif
+#ifdef USE_RDB
+    printf("\t\tFor rdb protocol the host argument should be in the form\n" \
+           "\t\thost:port[/database/table[/index]]. With an index, reads and range\n" \
+           "\t\treads go through that secondary index.\n\n");
+#endif
 
     printf("\t\tDuration can be specified as a number of queries (e.g. 5000 or 5000q),\n" \
            "\t\ta number of rows inserted (e.g. 5000i), or a number of seconds (e.g. 5000s).\n");
@@ -356,6 +367,7 @@ void parse(config_t *config, int argc, char *argv[]) {
                 {"pipeline",           required_argument, 0, 'p'},
                 {"client-suffix",      no_argument, 0, 'a'},
                 {"ignore-protocol-errors", no_argument, &config->ignore_protocol_errors, 1},
+                {"op-stats",           no_argument, &config->op_stats, 1},
                 {"help",               no_argument, &do_help, 1},
                 {0, 0, 0, 0}
             };
@@ -1,5 +1,6 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 
+#include <algorithm>
 #include <map>
 #include <unistd.h>
 #include <getopt.h>
@@ -35,6 +36,36 @@ FILE *get_out_file(const char *name, const char *what) {
 
 #define BACKUP_FOLDER "sqlite_backup"
 
+/* The names of the operations, in the order each client adds them. */
+static const char *op_names[] = {
+    "insert", "delete", "read", "update", "append", "prepend", "verify", "range read"
+};
+static const int num_op_types = sizeof(op_names) / sizeof(op_names[0]);
+
+/* Prints the throughput and latency percentiles of each type of operation that ran. */
+void print_op_stats(query_stats_t *op_stats, double seconds) {
+    printf("%-12s %10s %10s %10s %10s %10s %10s\n",
+        "Operation", "Queries", "QPS", "p50 (us)", "p95 (us)", "p99 (us)", "Worst (us)");
+    for (int i = 0; i < num_op_types; i++) {
+        query_stats_t *stats = &op_stats[i];
+        if (stats->queries == 0) {
+            continue;
+        }
+        std::vector<ticks_t> samples(stats->latency_samples.samples,
+                                     stats->latency_samples.samples + stats->latency_samples.size());
+        std::sort(samples.begin(), samples.end());
+        double percentiles[3] = { 0.50, 0.95, 0.99 };
+        double latencies[3];
+        for (int j = 0; j < 3; j++) {
+            latencies[j] = samples.empty() ? 0
+                : ticks_to_us(samples[std::min(samples.size() - 1, size_t(percentiles[j] * samples.size()))]);
+        }
+        printf("%-12s %10d %10.0f %10.2f %10.2f %10.2f %10.2f\n",
+            op_names[i], stats->queries, stats->queries / seconds,
+            latencies[0], latencies[1], latencies[2], ticks_to_us(stats->worst_latency));
+    }
+}
+
 /* Tie it all together */
 int main(int argc, char *argv[])
 {
@@ -165,6 +196,8 @@ int main(int argc, char *argv[])
         ~client_stuff_t() {
             if (sqlite) delete sqlite;
             delete protocol;
+
+            assert(client.ops.size() == size_t(num_op_types));
         }
     };
 
@@ -175,7 +208,7 @@ int main(int argc, char *argv[])
 
         /* Collecting latency samples is a potentially expensive operation, so we disable it
         if the user does not ask for them. */
-        if (latencies_fd == NULL) {
+        if (latencies_fd == NULL && !config.op_stats) {
             for (int j = 0; j < (int)clients[i]->client.ops.size(); j++) {
                 clients[i]->client.ops[j]->query_stats.set_enable_latency_samples(false);
             }
@@ -225,6 +258,7 @@ int main(int argc, char *argv[])
     ticks_t start_time = get_ticks();
 
     query_stats_t total_stats;
+    query_stats_t op_stats[num_op_types];
     int total_time = 0, total_inserts_minus_deletes = 0;
 
     // TODO: If an workload contains contains no inserts and there are no keys available for a
@@ -258,6 +292,7 @@ int main(int argc, char *argv[])
             the Python interface. */
             for (int j = 0; j < (int)c->client.ops.size(); j++) {
                 round_stats.aggregate(c->client.ops[j]->query_stats);
+                op_stats[j].aggregate(c->client.ops[j]->query_stats);
             }
 
             /* Count total number of keys inserted and deleted (we will use this if our
@@ -327,13 +362,18 @@ int main(int argc, char *argv[])
         client_stuff_t *c = clients[i];
         for (int j = 0; j < (int)c->client.ops.size(); j++) {
             total_stats.aggregate(c->client.ops[j]->query_stats);
+            op_stats[j].aggregate(c->client.ops[j]->query_stats);
         }
         total_inserts_minus_deletes += c->insert_op_generator.query_stats.queries - c->delete_op_generator.query_stats.queries;
     }
 
-    printf("Total running time: %f seconds\n", ticks_to_secs(get_ticks() - start_time));
+    double running_time = ticks_to_secs(get_ticks() - start_time);
+    printf("Total running time: %f seconds\n", running_time);
     printf("Total operations: %d\n", total_stats.queries);
     printf("Total keys inserted minus keys deleted: %d\n", total_inserts_minus_deletes);
+    if (config.op_stats) {
+        print_op_stats(op_stats, running_time);
+    }
 
     // Dump key vectors if we have an out file
     if(config.out_file[0] != 0) {
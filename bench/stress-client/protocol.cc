@@ -8,6 +8,9 @@
 #ifdef USE_MYSQL
 #  include "protocols/mysql_protocol.hpp"
 #endif
+#ifdef USE_RDB
+#  include "protocols/rdb_protocol.hpp"
+#endif
 #include "protocols/sqlite_protocol.hpp"
 
 protocol_t *server_t::connect() {
@@ -21,6 +24,10 @@ protocol_t *server_t::connect() {
 #ifdef USE_LIBMEMCACHED
     case protocol_libmemcached:
         return new memcached_protocol_t(host);
+#endif
+#ifdef USE_RDB
+    case protocol_rdb:
+        return new rdb_protocol_t(host);
 #endif
     case protocol_sqlite:
         return new sqlite_protocol_t(host);
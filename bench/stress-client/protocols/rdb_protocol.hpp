@@ -0,0 +1,459 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef __STRESS_CLIENT_PROTOCOLS_RDB_PROTOCOL_HPP__
+#define __STRESS_CLIENT_PROTOCOLS_RDB_PROTOCOL_HPP__
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "protocol.hpp"
+#include "protocols/ql2.pb.h"
+
+/* Talks ReQL to a RethinkDB server, with protocol buffers over the client driver
+port.  The host string is "host:port[/DB/TABLE[/INDEX]]", and DB and TABLE default
+to "test" and "stress".  Each key is a document {id: KEY, sk: KEY, val: VALUE}.
+Reads are a `get` for one key or a `getAll` for a batch, and range reads are a
+`between` with a `limit`.  If INDEX is given, reads and range reads go through that
+secondary index on `sk` instead of the primary key.  The database, table and index
+are created when we connect if they don't exist yet. */
+class rdb_protocol_t : public protocol_t {
+public:
+    explicit rdb_protocol_t(const char *conn_str)
+        : sockfd(-1), next_token(1), db_name("test"), table_name("stress") {
+        parse_conn_str(conn_str);
+        connect_to_server();
+        create_table_if_necessary();
+    }
+
+    ~rdb_protocol_t() {
+        if (sockfd != -1) {
+            close(sockfd);
+        }
+    }
+
+    virtual void remove(const char *key, size_t key_size) {
+        Query query;
+        Term *del = start_query(&query, Term::DELETE);
+        Term *get = add_arg(del, Term::GET);
+        add_table(get);
+        add_str(get, key, key_size);
+        run_write(&query);
+    }
+
+    virtual void update(const char *key, size_t key_size,
+                        const char *value, size_t value_size) {
+        Query query;
+        Term *update = start_query(&query, Term::UPDATE);
+        Term *get = add_arg(update, Term::GET);
+        add_table(get);
+        add_str(get, key, key_size);
+        Term *obj = add_arg(update, Term::MAKE_OBJ);
+        add_str(add_optarg(obj, "val"), value, value_size);
+        run_write(&query);
+    }
+
+    virtual void insert(const char *key, size_t key_size,
+                        const char *value, size_t value_size) {
+        Query query;
+        Term *insert = start_query(&query, Term::INSERT);
+        add_table(insert);
+        Term *obj = add_arg(insert, Term::MAKE_OBJ);
+        add_str(add_optarg(obj, "id"), key, key_size);
+        add_str(add_optarg(obj, "sk"), key, key_size);
+        add_str(add_optarg(obj, "val"), value, value_size);
+        add_bool(add_optarg(insert, "upsert"), true);
+        run_write(&query);
+    }
+
+    virtual void read(payload_t *keys, int count, payload_t *values = NULL) {
+        Query query;
+        if (count == 1 && index_name.empty()) {
+            Term *get = start_query(&query, Term::GET);
+            add_table(get);
+            add_str(get, keys[0].first, keys[0].second);
+        } else {
+            Term *get_all = start_query(&query, Term::GET_ALL);
+            add_table(get_all);
+            for (int i = 0; i < count; i++) {
+                add_str(get_all, keys[i].first, keys[i].second);
+            }
+            if (!index_name.empty()) {
+                add_str(add_optarg(get_all, "index"), index_name.data(), index_name.size());
+            }
+        }
+
+        Response response;
+        run(&query, &response);
+        if (response.response_size() != (response.type() == Response::SUCCESS_ATOM ? 1 : count)) {
+            throw protocol_error_t("Read got the wrong number of rows back.");
+        }
+        for (int i = 0; i < response.response_size(); i++) {
+            const Datum *row = &response.response(i);
+            if (response.type() == Response::SUCCESS_ATOM && row->type() == Datum::R_NULL) {
+                throw protocol_error_t("Read a key that doesn't exist.");
+            }
+            if (values != NULL) {
+                check_row(row, keys, values, count);
+            }
+        }
+    }
+
+    virtual void range_read(char* lkey, size_t lkey_size, char* rkey, size_t rkey_size, int count_limit, UNUSED payload_t *values = NULL) {
+        Query query;
+        Term *limit = start_query(&query, Term::LIMIT);
+        Term *between = add_arg(limit, Term::BETWEEN);
+        add_table(between);
+        add_str(between, lkey, lkey_size);
+        add_str(between, rkey, rkey_size);
+        if (!index_name.empty()) {
+            add_str(add_optarg(between, "index"), index_name.data(), index_name.size());
+        }
+        add_num(limit, count_limit);
+
+        Response response;
+        run(&query, &response);
+        int rows = response.response_size();
+        while (response.type() == Response::SUCCESS_PARTIAL) {
+            Query more;
+            more.set_type(Query::CONTINUE);
+            more.set_token(query.token());
+            send_query(&more);
+            receive_response(&response);
+            check_response(&response);
+            rows += response.response_size();
+        }
+        if (rows > count_limit) {
+            throw protocol_error_t("Range read got more rows than its limit.");
+        }
+    }
+
+    virtual void append(const char *key, size_t key_size,
+                        const char *value, size_t value_size) {
+        concatenate(key, key_size, value, value_size, true);
+    }
+
+    virtual void prepend(const char *key, size_t key_size,
+                          const char *value, size_t value_size) {
+        concatenate(key, key_size, value, value_size, false);
+    }
+
+private:
+    void parse_conn_str(const char *conn_str) {
+        std::string str(conn_str);
+        size_t slash = str.find('/');
+        host = str.substr(0, slash);
+        if (slash == std::string::npos) {
+            return;
+        }
+        std::string rest = str.substr(slash + 1);
+        size_t table_slash = rest.find('/');
+        if (table_slash == std::string::npos) {
+            fprintf(stderr, "rdb_protocol: expected host:port/DB/TABLE[/INDEX], got %s\n", conn_str);
+            exit(-1);
+        }
+        db_name = rest.substr(0, table_slash);
+        rest = rest.substr(table_slash + 1);
+        size_t index_slash = rest.find('/');
+        table_name = rest.substr(0, index_slash);
+        if (index_slash != std::string::npos) {
+            index_name = rest.substr(index_slash + 1);
+        }
+    }
+
+    void connect_to_server() {
+        size_t colon = host.find(':');
+        if (colon == std::string::npos) {
+            fprintf(stderr, "rdb_protocol: the host must be in the form host:port\n");
+            exit(-1);
+        }
+        std::string hostname = host.substr(0, colon);
+        std::string port = host.substr(colon + 1);
+
+        struct addrinfo hints, *res;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(hostname.c_str(), port.c_str(), &hints, &res) != 0) {
+            fprintf(stderr, "rdb_protocol: could not resolve %s\n", host.c_str());
+            exit(-1);
+        }
+        sockfd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        if (sockfd == -1) {
+            perror("rdb_protocol: could not create a socket");
+            exit(-1);
+        }
+        if (::connect(sockfd, res->ai_addr, res->ai_addrlen) != 0) {
+            perror("rdb_protocol: could not connect to the server");
+            exit(-1);
+        }
+        freeaddrinfo(res);
+
+        int flag = 1;
+        setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+        // The handshake: the magic number, then an empty auth key.
+        int32_t magic = VersionDummy::V0_2;
+        uint32_t auth_key_size = 0;
+        send_all(&magic, sizeof(magic));
+        send_all(&auth_key_size, sizeof(auth_key_size));
+        std::string reply;
+        for (;;) {
+            char c;
+            recv_all(&c, 1);
+            if (c == '\0') {
+                break;
+            }
+            reply.push_back(c);
+        }
+        if (reply != "SUCCESS") {
+            fprintf(stderr, "rdb_protocol: handshake failed: %s\n", reply.c_str());
+            exit(-1);
+        }
+    }
+
+    // All the clients connect at once, so everything but the first one creating
+    // the database, table or index gets an error that it exists already.
+    void create_table_if_necessary() {
+        {
+            Query query;
+            Term *db_create = start_query(&query, Term::DB_CREATE);
+            add_str(db_create, db_name.data(), db_name.size());
+            run_ignoring_errors(&query);
+        }
+        {
+            Query query;
+            Term *table_create = start_query(&query, Term::TABLE_CREATE);
+            Term *db = add_arg(table_create, Term::DB);
+            add_str(db, db_name.data(), db_name.size());
+            add_str(table_create, table_name.data(), table_name.size());
+            run_ignoring_errors(&query);
+        }
+        if (!index_name.empty()) {
+            Query query;
+            Term *index_create = start_query(&query, Term::INDEX_CREATE);
+            add_table(index_create);
+            add_str(index_create, index_name.data(), index_name.size());
+            // r.row('sk')
+            Term *func = add_arg(index_create, Term::FUNC);
+            Term *params = add_arg(func, Term::MAKE_ARRAY);
+            add_num(params, 1);
+            Term *get_field = add_arg(func, Term::GET_FIELD);
+            add_num(add_arg(get_field, Term::VAR), 1);
+            add_str(get_field, "sk", 2);
+            run_ignoring_errors(&query);
+        }
+    }
+
+    // `row` must be the document for one of `keys`, with the matching value.
+    void check_row(const Datum *row, payload_t *keys, payload_t *values, int count) {
+        std::string id, val;
+        for (int i = 0; i < row->r_object_size(); i++) {
+            const Datum::AssocPair &pair = row->r_object(i);
+            if (pair.key() == "id") {
+                id = pair.val().r_str();
+            } else if (pair.key() == "val") {
+                val = pair.val().r_str();
+            }
+        }
+        for (int i = 0; i < count; i++) {
+            if (id.size() == keys[i].second && memcmp(id.data(), keys[i].first, keys[i].second) == 0) {
+                if (val.size() != values[i].second || memcmp(val.data(), values[i].first, values[i].second) != 0) {
+                    throw protocol_error_t("Read the wrong value for key " + id + ".");
+                }
+                return;
+            }
+        }
+        throw protocol_error_t("Read a row for key " + id + " that we didn't ask for.");
+    }
+
+    void concatenate(const char *key, size_t key_size,
+                     const char *value, size_t value_size, bool at_end) {
+        // r.table(...).get(key).update(function(row) {
+        //     return {val: row('val') + value};   // or value + row('val')
+        // })
+        Query query;
+        Term *update = start_query(&query, Term::UPDATE);
+        Term *get = add_arg(update, Term::GET);
+        add_table(get);
+        add_str(get, key, key_size);
+        Term *func = add_arg(update, Term::FUNC);
+        Term *params = add_arg(func, Term::MAKE_ARRAY);
+        add_num(params, 1);
+        Term *obj = add_arg(func, Term::MAKE_OBJ);
+        Term *add = add_optarg(obj, "val");
+        add->set_type(Term::ADD);
+        if (!at_end) {
+            add_str(add, value, value_size);
+        }
+        Term *get_field = add_arg(add, Term::GET_FIELD);
+        add_num(add_arg(get_field, Term::VAR), 1);
+        add_str(get_field, "val", 3);
+        if (at_end) {
+            add_str(add, value, value_size);
+        }
+        run_write(&query);
+    }
+
+    Term *start_query(Query *query, Term::TermType type) {
+        query->set_type(Query::START);
+        query->set_token(next_token++);
+        query->mutable_query()->set_type(type);
+        return query->mutable_query();
+    }
+
+    static Term *add_arg(Term *term, Term::TermType type) {
+        Term *arg = term->add_args();
+        arg->set_type(type);
+        return arg;
+    }
+
+    // The returned term's type is up to the caller.
+    static Term *add_optarg(Term *term, const char *key) {
+        Term::AssocPair *pair = term->add_optargs();
+        pair->set_key(key);
+        return pair->mutable_val();
+    }
+
+    void add_table(Term *term) {
+        Term *table = add_arg(term, Term::TABLE);
+        Term *db = add_arg(table, Term::DB);
+        add_str(db, db_name.data(), db_name.size());
+        add_str(table, table_name.data(), table_name.size());
+    }
+
+    static void add_str(Term *term, const char *str, size_t size) {
+        Term *arg = term->has_type() ? term->add_args() : term;
+        arg->set_type(Term::DATUM);
+        arg->mutable_datum()->set_type(Datum::R_STR);
+        arg->mutable_datum()->set_r_str(str, size);
+    }
+
+    static void add_num(Term *term, double num) {
+        Term *arg = term->has_type() ? term->add_args() : term;
+        arg->set_type(Term::DATUM);
+        arg->mutable_datum()->set_type(Datum::R_NUM);
+        arg->mutable_datum()->set_r_num(num);
+    }
+
+    static void add_bool(Term *term, bool b) {
+        Term *arg = term->has_type() ? term->add_args() : term;
+        arg->set_type(Term::DATUM);
+        arg->mutable_datum()->set_type(Datum::R_BOOL);
+        arg->mutable_datum()->set_r_bool(b);
+    }
+
+    void run(Query *query, Response *response) {
+        send_query(query);
+        receive_response(response);
+        check_response(response);
+    }
+
+    // Write queries return an object counting what they did; errors in it (like
+    // writing a key that isn't there) are errors for us.
+    void run_write(Query *query) {
+        Response response;
+        run(query, &response);
+        if (response.response_size() != 1) {
+            throw protocol_error_t("Write didn't return one result.");
+        }
+        const Datum &result = response.response(0);
+        for (int i = 0; i < result.r_object_size(); i++) {
+            const Datum::AssocPair &pair = result.r_object(i);
+            if (pair.key() == "errors" && pair.val().r_num() != 0) {
+                throw protocol_error_t("Write failed.");
+            } else if (pair.key() == "skipped" && pair.val().r_num() != 0) {
+                throw protocol_error_t("Write found no row for its key.");
+            }
+        }
+    }
+
+    void run_ignoring_errors(Query *query) {
+        Response response;
+        send_query(query);
+        receive_response(&response);
+    }
+
+    void check_response(Response *response) {
+        switch (response->type()) {
+        case Response::SUCCESS_ATOM:
+        case Response::SUCCESS_SEQUENCE:
+        case Response::SUCCESS_PARTIAL:
+            return;
+        default: {
+            std::string message = "Query failed";
+            if (response->response_size() > 0) {
+                message += ": " + response->response(0).r_str();
+            }
+            throw protocol_error_t(message);
+        }
+        }
+    }
+
+    void send_query(Query *query) {
+        if (!query->SerializeToString(&send_buffer)) {
+            throw protocol_error_t("Could not serialize a query.");
+        }
+        uint32_t size = send_buffer.size();
+        send_buffer.insert(0, reinterpret_cast<const char *>(&size), sizeof(size));
+        send_all(send_buffer.data(), send_buffer.size());
+    }
+
+    void receive_response(Response *response) {
+        uint32_t size;
+        recv_all(&size, sizeof(size));
+        recv_buffer.resize(size);
+        recv_all(&recv_buffer[0], size);
+        if (!response->ParseFromString(recv_buffer)) {
+            throw protocol_error_t("Could not parse a response.");
+        }
+    }
+
+    void send_all(const void *data, size_t size) {
+        const char *p = static_cast<const char *>(data);
+        while (size > 0) {
+            ssize_t res = send(sockfd, p, size, 0);
+            if (res < 0 && errno == EINTR) {
+                continue;
+            } else if (res <= 0) {
+                perror("rdb_protocol: could not write to the socket");
+                exit(-1);
+            }
+            p += res;
+            size -= res;
+        }
+    }
+
+    void recv_all(void *data, size_t size) {
+        char *p = static_cast<char *>(data);
+        while (size > 0) {
+            ssize_t res = recv(sockfd, p, size, 0);
+            if (res < 0 && errno == EINTR) {
+                continue;
+            } else if (res == 0) {
+                fprintf(stderr, "rdb_protocol: the server closed the connection\n");
+                exit(-1);
+            } else if (res < 0) {
+                perror("rdb_protocol: could not read from the socket");
+                exit(-1);
+            }
+            p += res;
+            size -= res;
+        }
+    }
+
+    int sockfd;
+    int64_t next_token;
+    std::string host, db_name, table_name, index_name;
+    std::string send_buffer, recv_buffer;
+};
+
+#endif  // __STRESS_CLIENT_PROTOCOLS_RDB_PROTOCOL_HPP__
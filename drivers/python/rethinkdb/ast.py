@@ -987,6 +987,9 @@ class Table(RqlQuery):
     def sync(self):
         return Sync(self)
 
+    def changes(self):
+        return Changes(self)
+
     def compose(self, args, optargs):
         if isinstance(self.args[0], DB):
             return T(args[0], '.table(', args[1], ')')
@@ -1185,6 +1188,10 @@ class Sync(RqlMethodQuery):
     tt = p.Term.SYNC
     st = 'sync'
 
+class Changes(RqlMethodQuery):
+    tt = p.Term.CHANGES
+    st = 'changes'
+
 class Branch(RqlTopLevelQuery):
     tt = p.Term.BRANCH
     st = "branch"
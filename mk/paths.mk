@@ -46,6 +46,10 @@ ifeq ($(BUILD_DIR),)
     BUILD_DIR += noepoll
   endif
 
+  ifeq (1,$(NO_IO_URING))
+    BUILD_DIR += nouring
+  endif
+
   ifeq (1,$(VALGRIND))
     BUILD_DIR += valgrind
   endif
@@ -69,6 +73,7 @@ GDB_FUNCTIONS_NAME := rethinkdb-gdb.py
 
 PACKAGE_NAME := $(VANILLA_PACKAGE_NAME)
 SERVER_UNIT_TEST_NAME := $(SERVER_EXEC_NAME)-unittest
+SERVER_MICROBENCH_NAME := $(SERVER_EXEC_NAME)-bench
 
 EXTERNAL_DIR := $(TOP)/external
 EXTERNAL_DIR_ABS := $(abspath $(EXTERNAL_DIR))
@@ -54,13 +54,13 @@ _complete_rethinkdb() {
     local format_args=("--format")
     local formats=("csv" "json")
     local commands=("create" "help" "serve" "admin" "proxy" "import")
-    local file_args=("--input-file" "--pid-file" "-f" "--file")
+    local file_args=("--input-file" "--pid-file" "-f" "--file" "--slow-query-log-file")
     local directory_args=("-d" "--directory" "-l" "--log-file")
     local numb_args=("-c" "--cores" "--client-port" "--cluster-port" "--driver-port" "-o" "--port-offset" "--http-port" "--clients")
     local help_tokens=("create" "serve" "admin" "proxy" "export" "import" "dump" "restore")
     local create_tokens=("-d" "--directory" "-n" "--machine-name" "--io-backend")
-    local serve_tokens=("-d" "--directory" "--cluster-port" "--driver-port" "-o" "--port-offset" "-j" "--join" "--http-port" "-c" "--cores" "--pid-file" "--io-backend")
-    local proxy_tokens=("--log-file" "--cluster-port" "--driver-port" "-o" "--port-offset" "-j" "--join" "--http-port" "--pid-file" "--io-backend")
+    local serve_tokens=("-d" "--directory" "--cluster-port" "--driver-port" "-o" "--port-offset" "-j" "--join" "--http-port" "-c" "--cores" "--cpu-affinity" "--blocker-cpu-affinity" "--busy-poll-us" "--js-warm-workers" "--reuse-port" "--cluster-compression" "--slow-query-threshold" "--slow-query-log-file" "--pid-file" "--io-backend" "--backfill-latency-target-ms" "--auto-reshard" "--fast-failover")
+    local proxy_tokens=("--log-file" "--cluster-port" "--driver-port" "-o" "--port-offset" "-j" "--join" "--http-port" "--reuse-port" "--cluster-compression" "--slow-query-threshold" "--slow-query-log-file" "--pid-file" "--io-backend")
     local export_tokens=("-c" "--connect" "-a" "--auth" "-d" "--directory" "-e" "--export" "--format" "--fields")
     local import_tokens=("-c" "--connect" "-a" "--auth" "-d" "--directory" "-i" "--import" "-f" "--file" "--format" "--table" "--pkey" "--clients" "--force")
     local dump_tokens=("-c" "--connect" "-a" "--auth" "-e" "--export" "-f" "--file")
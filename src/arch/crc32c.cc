@@ -0,0 +1,101 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/crc32c.hpp"
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+// The bit-reversed Castagnoli polynomial.
+static const uint32_t CRC32C_POLYNOMIAL = 0x82f63b78;
+
+class crc32c_table_t {
+public:
+    crc32c_table_t() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int j = 0; j < 8; ++j) {
+                crc = (crc >> 1) ^ ((crc & 1) != 0 ? CRC32C_POLYNOMIAL : 0);
+            }
+            table_[i] = crc;
+        }
+    }
+
+    uint32_t extend(uint32_t crc, const uint8_t *p, size_t size) const {
+        for (size_t i = 0; i < size; ++i) {
+            crc = table_[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+        }
+        return crc;
+    }
+
+private:
+    uint32_t table_[256];
+};
+
+static uint32_t crc32c_extend_table(uint32_t crc, const uint8_t *p, size_t size) {
+    static const crc32c_table_t table;
+    return table.extend(crc, p, size);
+}
+
+#if defined(__x86_64__)
+
+__attribute__((__target__("sse4.2")))
+static uint32_t crc32c_extend_sse42(uint32_t crc, const uint8_t *p, size_t size) {
+    uint64_t crc64 = crc;
+    for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), p += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        crc64 = __builtin_ia32_crc32di(crc64, word);
+    }
+    crc = crc64;
+    for (; size > 0; --size, ++p) {
+        crc = __builtin_ia32_crc32qi(crc, *p);
+    }
+    return crc;
+}
+
+static bool cpu_has_sse42() {
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) != 0 && (ecx & bit_SSE4_2) != 0;
+}
+
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+
+static uint32_t crc32c_extend_armv8(uint32_t crc, const uint8_t *p, size_t size) {
+    for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), p += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        crc = __crc32cd(crc, word);
+    }
+    for (; size > 0; --size, ++p) {
+        crc = __crc32cb(crc, *p);
+    }
+    return crc;
+}
+
+#endif
+
+typedef uint32_t (*crc32c_extend_fn_t)(uint32_t, const uint8_t *, size_t);
+
+static crc32c_extend_fn_t choose_crc32c_extend() {
+#if defined(__x86_64__)
+    if (cpu_has_sse42()) {
+        return &crc32c_extend_sse42;
+    }
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+    return &crc32c_extend_armv8;
+#endif
+    return &crc32c_extend_table;
+}
+
+uint32_t crc32c_extend(uint32_t crc, const void *data, size_t size) {
+    static const crc32c_extend_fn_t extend_fn = choose_crc32c_extend();
+    return ~extend_fn(~crc, static_cast<const uint8_t *>(data), size);
+}
+
+uint32_t crc32c(const void *data, size_t size) {
+    return crc32c_extend(0, data, size);
+}
@@ -0,0 +1,19 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_CRC32C_HPP_
+#define ARCH_CRC32C_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* CRC32C (the Castagnoli polynomial, as used by iSCSI and ext4).  This uses the CPU's
+CRC instructions when there are any (SSE4.2 on x86-64, checked at runtime, or the
+ARMv8 CRC extension, when we're compiled for it), and a lookup table otherwise. */
+
+// Returns the checksum of size bytes at data.
+uint32_t crc32c(const void *data, size_t size);
+
+// Returns the checksum of the concatenation of the bytes whose checksum is crc and
+// the size bytes at data.  crc32c(data, size) is crc32c_extend(0, data, size).
+uint32_t crc32c_extend(uint32_t crc, const void *data, size_t size);
+
+#endif  // ARCH_CRC32C_HPP_
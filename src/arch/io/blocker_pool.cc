@@ -3,6 +3,7 @@
 
 #include <string.h>
 
+#include "arch/runtime/numa.hpp"
 #include "config/args.hpp"
 #include "utils.hpp"
 
@@ -24,6 +25,10 @@ void* blocker_pool_t::event_loop(void *arg) {
 
     set_in_blocker_pool_thread(1);
 
+    // Otherwise we'd run on the CPU of the event loop thread that made us, if it
+    // is pinned.
+    apply_blocker_cpu_affinity();
+
     blocker_pool_t *parent = reinterpret_cast<blocker_pool_t*>(arg);
 
     // Disable signals on this thread. This ensures that signals like SIGINT are
@@ -2,6 +2,10 @@
 #include "arch/io/disk.hpp"
 
 #include <fcntl.h>
+#ifdef __linux__
+#include <linux/falloc.h>
+#include <linux/fs.h>
+#endif
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
@@ -17,9 +21,12 @@
 #include "config/args.hpp"
 #include "backtrace.hpp"
 #include "arch/runtime/runtime.hpp"
+#include "arch/io/disk/aio.hpp"
+#include "arch/io/disk/coalescing.hpp"
 #include "arch/io/disk/filestat.hpp"
 #include "arch/io/disk/pool.hpp"
 #include "arch/io/disk/conflict_resolving.hpp"
+#include "arch/io/disk/uring.hpp"
 #include "arch/io/disk/stats.hpp"
 #include "arch/io/disk/accounting.hpp"
 #include "do_on_thread.hpp"
@@ -44,14 +51,46 @@ public:
     linux_disk_manager_t(linux_event_queue_t *queue,
                          int batch_factor,
                          int max_concurrent_io_requests,
+                         disk_backend_t backend,
                          perfmon_collection_t *stats) :
         stack_stats(stats, "stack"),
         conflict_resolver(stats),
         accounter(batch_factor),
         backend_stats(stats, "backend", accounter.producer),
-        backend(queue, backend_stats.producer, max_concurrent_io_requests),
+        coalescer(stats, "backend", backend_stats.producer),
         outstanding_txn(0)
     {
+        boost::function<void(pool_diskmgr_t::action_t *)> backend_done_fun
+            = std::bind(&coalescing_diskmgr_t::done, &coalescer, ph::_1);
+        switch (backend) {
+        case disk_backend_t::io_uring:
+#if USE_IO_URING
+            uring_backend.init(new uring_diskmgr_t(queue, coalescer.producer,
+                                                   max_concurrent_io_requests));
+            uring_backend->done_fun = backend_done_fun;
+            break;
+#else
+            unreachable();
+#endif
+        case disk_backend_t::native_aio:
+#if USE_KERNEL_ASYNC_IO
+            aio_backend.init(new aio_diskmgr_t(queue, coalescer.producer,
+                                               max_concurrent_io_requests));
+            aio_backend->done_fun = backend_done_fun;
+            break;
+#else
+            unreachable();
+#endif
+        case disk_backend_t::blocker_pool:
+            pool_backend.init(new pool_diskmgr_t(queue, coalescer.producer,
+                                                 max_concurrent_io_requests));
+            pool_backend->done_fun = backend_done_fun;
+            break;
+        case disk_backend_t::automatic:
+        default:
+            unreachable();
+        }
+
         /* Hook up the `submit_fun`s of the parts of the IO stack that are above the
         queue. (The parts below the queue use the `passive_producer_t` interface instead
         of a callback function.) */
@@ -60,8 +99,10 @@ public:
         conflict_resolver.submit_fun = std::bind(&accounting_diskmgr_t::submit,
                                                  &accounter, ph::_1);
 
+        accounter.queued_fun = std::bind(&stats_diskmgr_2_t::queued, &backend_stats, ph::_1);
+
         /* Hook up everything's `done_fun`. */
-        backend.done_fun = std::bind(&stats_diskmgr_2_t::done, &backend_stats, ph::_1);
+        coalescer.done_fun = std::bind(&stats_diskmgr_2_t::done, &backend_stats, ph::_1);
         backend_stats.done_fun = std::bind(&accounting_diskmgr_t::done, &accounter, ph::_1);
         accounter.done_fun = std::bind(&conflict_resolving_diskmgr_t::done,
                                        &conflict_resolver, ph::_1);
@@ -73,8 +114,9 @@ public:
         rassert(outstanding_txn == 0, "Closing a file with outstanding txns\n");
     }
 
-    void *create_account(int pri, int outstanding_requests_limit) {
-        return new accounting_diskmgr_t::account_t(&accounter, pri, outstanding_requests_limit);
+    void *create_account(int pri, int outstanding_requests_limit, int deadline_ms) {
+        return new accounting_diskmgr_t::account_t(&accounter, pri, outstanding_requests_limit,
+                                                   deadline_ms);
     }
 
     void delayed_destroy(void *_account) {
@@ -161,7 +203,8 @@ private:
     holding back operations that must be run after other, currently-running, operations.
     Then it goes to the account manager, which queues up running IO operations according
     to which account they are part of. Finally the "backend" pops the IO operations
-    from the queue.
+    from the queue, through the coalescer, which merges writes (and reads) that continue
+    each other into one.
 
     At two points in the process--once as soon as it is submitted, and again right
     as the backend pops it off the queue--its statistics are recorded. The "stack stats"
@@ -174,26 +217,94 @@ private:
     conflict_resolving_diskmgr_t conflict_resolver;
     accounting_diskmgr_t accounter;
     stats_diskmgr_2_t backend_stats;
-    pool_diskmgr_t backend;
-
+    coalescing_diskmgr_t coalescer;
+    // Exactly one of these is set, depending on the disk backend.
+    scoped_ptr_t<pool_diskmgr_t> pool_backend;
+#if USE_KERNEL_ASYNC_IO
+    scoped_ptr_t<aio_diskmgr_t> aio_backend;
+#endif
+#if USE_IO_URING
+    scoped_ptr_t<uring_diskmgr_t> uring_backend;
+#endif
 
     int outstanding_txn;
 
     DISABLE_COPYING(linux_disk_manager_t);
 };
 
+const char *disk_backend_name(disk_backend_t backend) {
+    switch (backend) {
+    case disk_backend_t::automatic: return "auto";
+    case disk_backend_t::io_uring: return "io_uring";
+    case disk_backend_t::native_aio: return "aio";
+    case disk_backend_t::blocker_pool: return "pool";
+    default: unreachable();
+    }
+}
+
+// Returns 0 if we can use the backend, the errno value otherwise.
+static int check_disk_backend_support(disk_backend_t backend) {
+    switch (backend) {
+    case disk_backend_t::io_uring:
+#if USE_IO_URING
+        return uring_diskmgr_t::check_support();
+#else
+        return ENOSYS;
+#endif
+    case disk_backend_t::native_aio:
+#if USE_KERNEL_ASYNC_IO
+        return aio_diskmgr_t::check_support();
+#else
+        return ENOSYS;
+#endif
+    case disk_backend_t::blocker_pool:
+        return 0;
+    case disk_backend_t::automatic:
+    default:
+        unreachable();
+    }
+}
+
+static disk_backend_t choose_disk_backend(disk_backend_t requested,
+                                          file_direct_io_mode_t direct_io_mode) {
+    if (requested != disk_backend_t::automatic) {
+        const int errcode = check_disk_backend_support(requested);
+        if (errcode != 0) {
+            fail_due_to_user_error("The %s disk backend is not available: %s",
+                                   disk_backend_name(requested),
+                                   errno_string(errcode).c_str());
+        }
+        return requested;
+    }
+
+    if (check_disk_backend_support(disk_backend_t::io_uring) == 0) {
+        return disk_backend_t::io_uring;
+    }
+    // Native AIO blocks in io_submit unless the files are opened with O_DIRECT.
+    if (direct_io_mode == file_direct_io_mode_t::direct_desired
+        && check_disk_backend_support(disk_backend_t::native_aio) == 0) {
+        return disk_backend_t::native_aio;
+    }
+    return disk_backend_t::blocker_pool;
+}
+
 io_backender_t::io_backender_t(file_direct_io_mode_t _direct_io_mode,
-                               int max_concurrent_io_requests)
+                               int max_concurrent_io_requests,
+                               disk_backend_t requested_backend)
     : direct_io_mode(_direct_io_mode),
+      backend(choose_disk_backend(requested_backend, _direct_io_mode)),
       diskmgr(new linux_disk_manager_t(&linux_thread_pool_t::get_thread()->queue,
                                        DEFAULT_IO_BATCH_FACTOR,
                                        max_concurrent_io_requests,
+                                       backend,
                                        &stats)) { }
 
 io_backender_t::~io_backender_t() { }
 
 file_direct_io_mode_t io_backender_t::get_direct_io_mode() const { return direct_io_mode; }
 
+disk_backend_t io_backender_t::get_backend() const { return backend; }
+
 
 /* Disk file object */
 
@@ -310,6 +421,41 @@ void linux_file_t::writev_async(int64_t offset, size_t length,
 
 }
 
+static void discard_blocking(fd_t fd, int64_t offset, int64_t length,
+                             int *errcode_out) {
+#ifdef __linux__
+    struct stat st;
+    int res = fstat(fd, &st);
+    if (res == 0 && S_ISBLK(st.st_mode)) {
+        uint64_t range[2] = { static_cast<uint64_t>(offset),
+                              static_cast<uint64_t>(length) };
+        res = ioctl(fd, BLKDISCARD, range);
+    } else if (res == 0) {
+        do {
+            res = fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                            offset, length);
+        } while (res == -1 && get_errno() == EINTR);
+    }
+    *errcode_out = res == 0 ? 0 : get_errno();
+    if (*errcode_out == ENOTTY || *errcode_out == ENOSYS) {
+        *errcode_out = EOPNOTSUPP;
+    }
+#else
+    (void)fd;
+    (void)offset;
+    (void)length;
+    *errcode_out = EOPNOTSUPP;
+#endif  // __linux__
+}
+
+int linux_file_t::discard(int64_t offset, int64_t length) {
+    rassert(offset >= 0 && length >= 0 && offset + length <= file_size);
+    int errcode;
+    thread_pool_t::run_in_blocker_pool(std::bind(&discard_blocking, fd.get(), offset,
+                                                 length, &errcode));
+    return errcode;
+}
+
 bool linux_file_t::coop_lock_and_check() {
     if (flock(fd.get(), LOCK_EX | LOCK_NB) != 0) {
         rassert(get_errno() == EWOULDBLOCK);
@@ -318,8 +464,9 @@ bool linux_file_t::coop_lock_and_check() {
     return true;
 }
 
-void *linux_file_t::create_account(int priority, int outstanding_requests_limit) {
-    return diskmgr->create_account(priority, outstanding_requests_limit);
+void *linux_file_t::create_account(int priority, int outstanding_requests_limit,
+                                   int deadline_ms) {
+    return diskmgr->create_account(priority, outstanding_requests_limit, deadline_ms);
 }
 
 void linux_file_t::destroy_account(void *account) {
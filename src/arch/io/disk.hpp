@@ -27,14 +27,20 @@ public:
     // This takes what is effectively a global flag whether to use O_DIRECT here.  Nothing technical
     // stops us from specifying this on a file-by-file basis, but right now there's no desire for
     // that.  See https://github.com/rethinkdb/rethinkdb/issues/97#issuecomment-19778177 .
+    // Crashes if a backend other than disk_backend_t::automatic is requested and the
+    // kernel doesn't support it.
     io_backender_t(file_direct_io_mode_t direct_io_mode,
-                   int max_concurrent_io_requests = DEFAULT_MAX_CONCURRENT_IO_REQUESTS);
+                   int max_concurrent_io_requests = DEFAULT_MAX_CONCURRENT_IO_REQUESTS,
+                   disk_backend_t requested_backend = disk_backend_t::automatic);
     ~io_backender_t();
     linux_disk_manager_t *get_diskmgr_ptr() { return diskmgr.get(); }
     file_direct_io_mode_t get_direct_io_mode() const;
+    // The backend that's used, never disk_backend_t::automatic.
+    disk_backend_t get_backend() const;
 
 protected:
     const file_direct_io_mode_t direct_io_mode;
+    const disk_backend_t backend;
     perfmon_collection_t stats;
     scoped_ptr_t<linux_disk_manager_t> diskmgr;
 
@@ -42,6 +48,9 @@ private:
     DISABLE_COPYING(io_backender_t);
 };
 
+// Returns "auto", "io_uring", "aio" or "pool".
+const char *disk_backend_name(disk_backend_t backend);
+
 // A file_open_result_t is either FILE_OPEN_DIRECT, FILE_OPEN_BUFFERED, or an errno value.
 struct file_open_result_t {
     enum outcome_t {
@@ -80,9 +89,11 @@ public:
     void writev_async(int64_t offset, size_t length, scoped_array_t<iovec> &&bufs,
                       file_account_t *account, linux_iocallback_t *cb);
 
+    int discard(int64_t offset, int64_t length);
+
     bool coop_lock_and_check();
 
-    void *create_account(int priority, int outstanding_requests_limit);
+    void *create_account(int priority, int outstanding_requests_limit, int deadline_ms);
     void destroy_account(void *account);
 
     ~linux_file_t();
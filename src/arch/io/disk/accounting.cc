@@ -6,19 +6,28 @@
    `unlimited_fifo_queue_t` associated with it. Operations for that account
    queue up on that queue while they wait for the `accounting_queue_t` on the
    `accounting_diskmgr_t` to draw from that account. */
-struct accounting_diskmgr_eager_account_t : public semaphore_available_callback_t {
+struct accounting_diskmgr_eager_account_t
+    : public semaphore_available_callback_t,
+      private accounting_queue_deadline_t {
     typedef accounting_diskmgr_action_t action_t;
 
     accounting_diskmgr_eager_account_t(accounting_diskmgr_t *par,
                                        int pri,
-                                       int outstanding_requests_limit) :
+                                       int outstanding_requests_limit,
+                                       int deadline_ms) :
+        deadline_ticks(deadline_ms * (secs_to_ticks(1) / 1000)),
         outstanding_requests_limiter(outstanding_requests_limit == UNLIMITED_OUTSTANDING_REQUESTS ? SEMAPHORE_NO_LIMIT : outstanding_requests_limit),
-        account(&par->queue, &queue, pri),
+        account(&par->queue, &queue, pri,
+                deadline_ms == NO_IO_DEADLINE ? NULL : this),
         accounter_lock(par->get_auto_drainer()) {
         rassert(outstanding_requests_limit == UNLIMITED_OUTSTANDING_REQUESTS || outstanding_requests_limit > 0);
+        rassert(deadline_ms >= 0);
     }
 
     void push(action_t *action) {
+        // The deadline counts from when the operation was submitted, so time spent
+        // waiting for the outstanding requests limit counts too.
+        action->deadline = get_ticks() + deadline_ticks;
         throttled_queue.push_back(action);
         outstanding_requests_limiter.lock(this, 1);
     }
@@ -32,6 +41,12 @@ struct accounting_diskmgr_eager_account_t : public semaphore_available_callback_
     }
 
 private:
+    ticks_t next_deadline() {
+        return queue.peek()->deadline;
+    }
+
+    const ticks_t deadline_ticks;
+
     // It would be nice if we could just use a limited_fifo_queue to
     // implement the limitation of outstanding requests.
     // However this part of the code must not rely on coroutines, therefore
@@ -49,9 +64,11 @@ private:
 
 accounting_diskmgr_account_t::accounting_diskmgr_account_t(accounting_diskmgr_t *_par,
                                                            int _pri,
-                                                           int _outstanding_requests_limit)
+                                                           int _outstanding_requests_limit,
+                                                           int _deadline_ms)
         : par(_par), pri(_pri),
-          outstanding_requests_limit(_outstanding_requests_limit) { }
+          outstanding_requests_limit(_outstanding_requests_limit),
+          deadline_ms(_deadline_ms) { }
 
 accounting_diskmgr_account_t::~accounting_diskmgr_account_t() {
     par->assert_thread();
@@ -75,7 +92,8 @@ semaphore_t *accounting_diskmgr_account_t::get_outstanding_requests_limiter() {
 void accounting_diskmgr_account_t::maybe_init(){
     if (!eager_account.has()) {
         par->assert_thread();
-        eager_account.init(new eager_account_t(par, pri, outstanding_requests_limit));
+        eager_account.init(new eager_account_t(par, pri, outstanding_requests_limit,
+                                               deadline_ms));
     }
 }
 
@@ -96,6 +114,10 @@ accounting_diskmgr_t::~accounting_diskmgr_t() {
 }
 
 void accounting_diskmgr_t::submit(action_t *a) {
+    a->has_deadline = a->account->has_deadline();
+    if (queued_fun) {
+        queued_fun(a);
+    }
     a->account->push(a);
 }
 
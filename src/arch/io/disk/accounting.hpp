@@ -33,7 +33,9 @@ private:
 };
 
 /* `accounting_diskmgr_t` shares disk throughput proportionally between a
-number of different "accounts". */
+number of different "accounts".  An account can also have a deadline; its
+operations go ahead of everything else once they have waited for that long (see
+`accounting_queue_deadline_t`). */
 
 typedef stats_diskmgr_2_t::action_t accounting_payload_t;
 
@@ -48,13 +50,15 @@ struct accounting_diskmgr_account_t {
 
     accounting_diskmgr_account_t(accounting_diskmgr_t *_par,
                                  int _pri,
-                                 int _outstanding_requests_limit);
+                                 int _outstanding_requests_limit,
+                                 int _deadline_ms);
 
     ~accounting_diskmgr_account_t();
 
     void push(action_t *action);
     void on_semaphore_available();
     semaphore_t *get_outstanding_requests_limiter();
+    bool has_deadline() const { return deadline_ms != NO_IO_DEADLINE; }
 
 private:
     typedef accounting_diskmgr_eager_account_t eager_account_t;
@@ -64,6 +68,7 @@ private:
     accounting_diskmgr_t *par;
     int pri;
     int outstanding_requests_limit;
+    int deadline_ms;
     scoped_ptr_t<eager_account_t> eager_account;
 
     DISABLE_COPYING(accounting_diskmgr_account_t);
@@ -73,6 +78,9 @@ struct accounting_diskmgr_action_t
     : public intrusive_list_node_t<accounting_diskmgr_action_t>,
       public accounting_payload_t {
     accounting_diskmgr_account_t *account;
+    // When the operation should be popped off the queue, if its account has a
+    // deadline.
+    ticks_t deadline;
 };
 
 void debug_print(printf_buffer_t *buf,
@@ -96,6 +104,10 @@ public:
 
     boost::function<void (action_t *)> done_fun;
 
+    /* Called on each action when it is queued, before the action waits for its
+    account's turn. */
+    boost::function<void (accounting_payload_t *)> queued_fun;
+
     passive_producer_t<accounting_payload_t *> * const producer;
     void done(accounting_payload_t *p);
 
@@ -0,0 +1,140 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/io/disk/aio.hpp"
+
+#if USE_KERNEL_ASYNC_IO
+
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// glibc has no wrappers for the kernel AIO system calls (libaio does, but that's one
+// more dependency for five system calls).
+
+static int sys_io_setup(unsigned nr_events, aio_context_t *ctx) {
+    return syscall(SYS_io_setup, nr_events, ctx);
+}
+
+static int sys_io_destroy(aio_context_t ctx) {
+    return syscall(SYS_io_destroy, ctx);
+}
+
+static int sys_io_submit(aio_context_t ctx, long nr, iocb **iocbpp) {  // NOLINT(runtime/int)
+    return syscall(SYS_io_submit, ctx, nr, iocbpp);
+}
+
+static int sys_io_getevents(aio_context_t ctx, long min_nr, long nr,  // NOLINT(runtime/int)
+                            io_event *events, timespec *timeout) {
+    return syscall(SYS_io_getevents, ctx, min_nr, nr, events, timeout);
+}
+
+int aio_diskmgr_t::check_support() {
+    aio_context_t ctx = 0;
+    if (sys_io_setup(1, &ctx) != 0) {
+        return get_errno();
+    }
+    UNUSED int res = sys_io_destroy(ctx);
+    return 0;
+}
+
+aio_diskmgr_t::aio_diskmgr_t(linux_event_queue_t *queue,
+                             passive_producer_t<action_t *> *source,
+                             int max_concurrent_io_requests)
+    : async_diskmgr_t(queue, source, max_concurrent_io_requests),
+      context_(0),
+      events_(queue_depth()) {
+    int res = sys_io_setup(queue_depth(), &context_);
+    guarantee_err(res == 0, "Could not set up a native AIO context");
+    prepared_.reserve(queue_depth());
+    prepared_ptrs_.reserve(queue_depth());
+    start();
+}
+
+aio_diskmgr_t::~aio_diskmgr_t() {
+    stop();
+    int res = sys_io_destroy(context_);
+    guarantee_err(res == 0, "Could not destroy a native AIO context");
+}
+
+void aio_diskmgr_t::prepare_op(void *tag, const op_t &op) {
+    iocb cb;
+    memset(&cb, 0, sizeof(cb));
+    cb.aio_data = reinterpret_cast<uintptr_t>(tag);
+    cb.aio_fildes = op.fd;
+    switch (op.type) {
+    case op_readv:
+        cb.aio_lio_opcode = IOCB_CMD_PREADV;
+        break;
+    case op_writev:
+        cb.aio_lio_opcode = IOCB_CMD_PWRITEV;
+        break;
+    case op_datasync:
+        cb.aio_lio_opcode = IOCB_CMD_FDSYNC;
+        break;
+    default:
+        unreachable();
+    }
+    cb.aio_buf = reinterpret_cast<uintptr_t>(op.iov);
+    cb.aio_nbytes = op.iovcnt;
+    cb.aio_offset = op.offset;
+    cb.aio_flags = IOCB_FLAG_RESFD;
+    cb.aio_resfd = completion_eventfd();
+    prepared_.push_back(cb);
+}
+
+void aio_diskmgr_t::submit_ops() {
+    if (prepared_.empty()) {
+        return;
+    }
+
+    for (size_t i = 0; i < prepared_.size(); ++i) {
+        prepared_ptrs_.push_back(&prepared_[i]);
+    }
+
+    size_t submitted = 0;
+    while (submitted < prepared_ptrs_.size()) {
+        int res = sys_io_submit(context_, prepared_ptrs_.size() - submitted,
+                                prepared_ptrs_.data() + submitted);
+        if (res == -1 && get_errno() == EINTR) {
+            continue;
+        }
+        if (res == -1 && get_errno() == EINVAL && submitted < prepared_ptrs_.size()
+            && prepared_ptrs_[submitted]->aio_lio_opcode == IOCB_CMD_FDSYNC) {
+            // Old kernels reject IOCB_CMD_FDSYNC at submission time.  (The request
+            // then does its datasyncs with a blocking call, so this doesn't prepare
+            // another operation.)
+            const iocb *cb = prepared_ptrs_[submitted];
+            ++submitted;
+            op_done(reinterpret_cast<void *>(static_cast<uintptr_t>(cb->aio_data)),
+                    -EINVAL);
+            continue;
+        }
+        guarantee_err(res > 0, "Could not submit native AIO operations");
+        submitted += res;
+    }
+
+    prepared_.clear();
+    prepared_ptrs_.clear();
+}
+
+void aio_diskmgr_t::reap_ops() {
+    timespec no_wait;
+    no_wait.tv_sec = 0;
+    no_wait.tv_nsec = 0;
+    for (;;) {
+        int res = sys_io_getevents(context_, 0, events_.size(), events_.data(), &no_wait);
+        if (res == -1 && get_errno() == EINTR) {
+            continue;
+        }
+        guarantee_err(res >= 0, "Could not get native AIO completions");
+        if (res == 0) {
+            break;
+        }
+        for (int i = 0; i < res; ++i) {
+            op_done(reinterpret_cast<void *>(static_cast<uintptr_t>(events_[i].data)),
+                    events_[i].res);
+        }
+    }
+}
+
+#endif  // USE_KERNEL_ASYNC_IO
@@ -0,0 +1,44 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_DISK_AIO_HPP_
+#define ARCH_IO_DISK_AIO_HPP_
+
+#include "arch/io/disk/async.hpp"
+
+#if USE_KERNEL_ASYNC_IO
+
+#include <linux/aio_abi.h>
+
+#include <vector>
+
+/* The native AIO disk manager sends IO requests to the kernel with io_submit(2).
+Keep in mind that Linux only does them asynchronously for files that are opened with
+O_DIRECT; on other files io_submit blocks until the operation is done. */
+
+class aio_diskmgr_t : public async_diskmgr_t {
+public:
+    // Returns 0 if the kernel supports native AIO, the errno value otherwise.
+    static int check_support();
+
+    aio_diskmgr_t(linux_event_queue_t *queue, passive_producer_t<action_t *> *source,
+                  int max_concurrent_io_requests);
+    ~aio_diskmgr_t();
+
+private:
+    void prepare_op(void *tag, const op_t &op);
+    void submit_ops();
+    void reap_ops();
+
+    aio_context_t context_;
+
+    // The operations that prepare_op() prepared for the next submit_ops().
+    std::vector<iocb> prepared_;
+    std::vector<iocb *> prepared_ptrs_;
+
+    std::vector<io_event> events_;
+
+    DISABLE_COPYING(aio_diskmgr_t);
+};
+
+#endif  // USE_KERNEL_ASYNC_IO
+
+#endif  // ARCH_IO_DISK_AIO_HPP_
@@ -0,0 +1,213 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/io/disk/async.hpp"
+
+#if USE_KERNEL_ASYNC_IO
+
+#include <limits.h>
+
+#include <algorithm>
+
+#include "arch/io/disk.hpp"
+
+// The kernel limits how many operations a ring or AIO context can hold, so we don't
+// go all the way to MAXIMUM_MAX_CONCURRENT_IO_REQUESTS.
+static const int MAX_ASYNC_DISKMGR_QUEUE_DEPTH = 4096;
+
+struct async_diskmgr_t::request_t {
+    enum stage_t { pre_datasync, io, post_datasync };
+
+    action_t *action;
+    stage_t stage;
+    // The position of the next vectored read or write of the action.
+    size_t next_iov;
+    int64_t next_offset;
+    // How many buffers the read or write that's in flight covers, if it is one.
+    int iovcnt;
+    // Whether the operation in flight is an async datasync.
+    bool async_datasync;
+};
+
+struct async_diskmgr_t::datasync_job_t : public blocker_pool_t::job_t {
+    datasync_job_t(async_diskmgr_t *_parent, request_t *_request)
+        : parent(_parent), request(_request), errcode(0) { }
+
+    void run() {
+        errcode = perform_datasync(request->action->get_fd());
+    }
+
+    void done() {
+        async_diskmgr_t *local_parent = parent;
+        request_t *local_request = request;
+        const int local_errcode = errcode;
+        delete this;
+        local_parent->blocking_datasync_done(local_request, local_errcode);
+    }
+
+    async_diskmgr_t *parent;
+    request_t *request;
+    int errcode;
+};
+
+async_diskmgr_t::async_diskmgr_t(linux_event_queue_t *queue,
+                                 passive_producer_t<action_t *> *source,
+                                 int max_concurrent_io_requests)
+    : queue_(queue),
+      source_(source),
+      queue_depth_(std::min(max_concurrent_io_requests, MAX_ASYNC_DISKMGR_QUEUE_DEPTH)),
+      requests_(queue_depth_),
+      async_datasync_unsupported_(false) {
+    guarantee(max_concurrent_io_requests > 0);
+    free_requests_.reserve(queue_depth_);
+    for (size_t i = 0; i < requests_.size(); ++i) {
+        free_requests_.push_back(&requests_[i]);
+    }
+}
+
+async_diskmgr_t::~async_diskmgr_t() {
+    assert_thread();
+    rassert(free_requests_.size() == requests_.size(),
+            "Destroying a disk manager with IO operations in flight.");
+}
+
+void async_diskmgr_t::start() {
+    queue_->watch_resource(completion_event_.get_notify_fd(), poll_event_in, this);
+    if (source_->available->get()) { pump(); }
+    source_->available->set_callback(this);
+}
+
+void async_diskmgr_t::stop() {
+    assert_thread();
+    source_->available->unset_callback();
+    queue_->forget_resource(completion_event_.get_notify_fd(), this);
+}
+
+void async_diskmgr_t::on_source_availability_changed() {
+    assert_thread();
+    if (source_->available->get()) pump();
+}
+
+void async_diskmgr_t::on_event(DEBUG_VAR int events) {
+    assert_thread();
+    rassert(events == poll_event_in);
+    completion_event_.consume_wakey_wakeys();
+    reap_ops();
+    pump();
+}
+
+void async_diskmgr_t::pump() {
+    assert_thread();
+    while (source_->available->get() && !free_requests_.empty()) {
+        request_t *request = free_requests_.back();
+        free_requests_.pop_back();
+
+        request->action = source_->pop();
+        request->stage = request->action->get_wrap_in_datasyncs()
+            ? request_t::pre_datasync
+            : request_t::io;
+        request->next_iov = 0;
+        request->next_offset = request->action->get_offset();
+        prepare_next_op(request);
+    }
+    submit_ops();
+}
+
+void async_diskmgr_t::prepare_next_op(request_t *request) {
+    action_t *action = request->action;
+    op_t op;
+    op.fd = action->get_fd();
+
+    if (request->stage == request_t::io) {
+        iovec *vecs;
+        size_t vecs_len;
+        action->get_bufs(&vecs, &vecs_len);
+        request->iovcnt = std::min<size_t>(IOV_MAX, vecs_len - request->next_iov);
+        request->async_datasync = false;
+
+        op.type = action->get_is_read() ? op_readv : op_writev;
+        op.iov = vecs + request->next_iov;
+        op.iovcnt = request->iovcnt;
+        op.offset = request->next_offset;
+    } else if (async_datasync_unsupported_) {
+        request->async_datasync = false;
+        if (!datasync_pool_.has()) {
+            datasync_pool_.init(new blocker_pool_t(1, queue_));
+        }
+        datasync_pool_->do_job(new datasync_job_t(this, request));
+        return;
+    } else {
+        request->async_datasync = true;
+        op.type = op_datasync;
+        op.iov = NULL;
+        op.iovcnt = 0;
+        op.offset = 0;
+    }
+
+    prepare_op(request, op);
+}
+
+void async_diskmgr_t::op_done(void *tag, int64_t res) {
+    assert_thread();
+    request_t *request = static_cast<request_t *>(tag);
+    action_t *action = request->action;
+
+    if (res < 0) {
+        if (res == -EINVAL && request->async_datasync) {
+            // The kernel (or the file system) can't do datasyncs asynchronously.
+            async_datasync_unsupported_ = true;
+            prepare_next_op(request);
+            return;
+        }
+        action->io_result = res;
+        finish_request(request);
+        return;
+    }
+
+    switch (request->stage) {
+    case request_t::pre_datasync:
+        request->stage = request_t::io;
+        prepare_next_op(request);
+        break;
+    case request_t::io: {
+        iovec *vecs;
+        size_t vecs_len;
+        action->get_bufs(&vecs, &vecs_len);
+        int64_t lensum = 0;
+        for (size_t i = request->next_iov; i < request->next_iov + request->iovcnt; ++i) {
+            lensum += vecs[i].iov_len;
+        }
+        guarantee(lensum == res);
+
+        request->next_iov += request->iovcnt;
+        request->next_offset += res;
+        if (request->next_iov < vecs_len) {
+            prepare_next_op(request);
+        } else if (action->get_wrap_in_datasyncs()) {
+            request->stage = request_t::post_datasync;
+            prepare_next_op(request);
+        } else {
+            action->io_result = request->next_offset - action->get_offset();
+            finish_request(request);
+        }
+    } break;
+    case request_t::post_datasync:
+        action->io_result = request->next_offset - action->get_offset();
+        finish_request(request);
+        break;
+    default:
+        unreachable();
+    }
+}
+
+void async_diskmgr_t::finish_request(request_t *request) {
+    action_t *action = request->action;
+    request->action = NULL;
+    free_requests_.push_back(request);
+    done_fun(action);
+}
+
+void async_diskmgr_t::blocking_datasync_done(request_t *request, int errcode) {
+    op_done(request, -static_cast<int64_t>(errcode));
+    pump();
+}
+
+#endif  // USE_KERNEL_ASYNC_IO
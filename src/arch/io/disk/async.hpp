@@ -0,0 +1,125 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_DISK_ASYNC_HPP_
+#define ARCH_IO_DISK_ASYNC_HPP_
+
+#include <sys/uio.h>
+
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/function.hpp>
+
+#include "arch/io/blocker_pool.hpp"
+#include "arch/io/disk/pool.hpp"
+#include "arch/runtime/event_queue.hpp"
+#include "arch/runtime/system_event/eventfd_event.hpp"
+#include "concurrency/queue/passive_producer.hpp"
+#include "containers/scoped.hpp"
+
+/* The kernel's asynchronous IO interfaces need an eventfd to tell the event queue
+about completions. */
+#if defined(__linux) && !defined(NO_EVENTFD)
+#define USE_KERNEL_ASYNC_IO 1
+#else
+#define USE_KERNEL_ASYNC_IO 0
+#endif
+
+#if USE_KERNEL_ASYNC_IO
+
+#if !USE_WRITEV
+#error "The kernel async IO disk managers need writev."
+#endif
+
+/* `async_diskmgr_t` is the common part of the disk managers that hand IO requests
+straight to the kernel (see `aio_diskmgr_t` and `uring_diskmgr_t`) instead of running
+blocking IO calls in a blocker pool.  The kernel tells us about completions through an
+eventfd that our event queue watches, so a request never leaves the disk manager's
+thread.
+
+An action turns into a sequence of operations that are sent to the kernel one after
+the other: a datasync before and after the write for actions that are wrapped in
+datasyncs, and one vectored read or write for every IOV_MAX buffers. */
+
+class async_diskmgr_t :
+    private availability_callback_t,
+    private linux_event_callback_t,
+    public home_thread_mixin_debug_only_t {
+public:
+    typedef pool_diskmgr_action_t action_t;
+
+    /* Calls `done_fun` on each action when it's done, like `pool_diskmgr_t`. */
+    boost::function<void(action_t *)> done_fun;
+
+    virtual ~async_diskmgr_t();
+
+protected:
+    enum op_type_t { op_readv, op_writev, op_datasync };
+
+    struct op_t {
+        op_type_t type;
+        fd_t fd;
+        const iovec *iov;
+        int iovcnt;
+        int64_t offset;
+    };
+
+    async_diskmgr_t(linux_event_queue_t *queue,
+                    passive_producer_t<action_t *> *source,
+                    int max_concurrent_io_requests);
+
+    // queue_depth() operations can be in flight at most.
+    int queue_depth() const { return queue_depth_; }
+
+    /* The subclass must have the kernel signal this eventfd when operations
+    complete. */
+    fd_t completion_eventfd() { return completion_event_.get_notify_fd(); }
+
+    /* The subclass must call `start()` at the end of its constructor, once it can
+    take operations, and `stop()` at the beginning of its destructor. */
+    void start();
+    void stop();
+
+    /* Queues an operation up to be sent to the kernel by the next `submit_ops()`
+    call.  When it completes, the subclass must call `op_done(tag, res)` where res
+    is what the operation returned, or the negated errno value. */
+    virtual void prepare_op(void *tag, const op_t &op) = 0;
+    virtual void submit_ops() = 0;
+
+    /* Called when the completion eventfd has been signalled.  Reaps the completed
+    operations and calls `op_done` for them. */
+    virtual void reap_ops() = 0;
+
+    void op_done(void *tag, int64_t res);
+
+private:
+    struct request_t;
+    struct datasync_job_t;
+
+    void on_source_availability_changed();
+    void on_event(int events);
+    void pump();
+
+    void prepare_next_op(request_t *request);
+    void finish_request(request_t *request);
+    void blocking_datasync_done(request_t *request, int errcode);
+
+    linux_event_queue_t *const queue_;
+    passive_producer_t<action_t *> *const source_;
+    const int queue_depth_;
+
+    scoped_array_t<request_t> requests_;
+    std::vector<request_t *> free_requests_;
+
+    eventfd_event_t completion_event_;
+
+    // Set once the kernel has told us that it can't do async datasyncs (kernel AIO
+    // only learned that in Linux 4.18).  We then do them in `datasync_pool_`.
+    bool async_datasync_unsupported_;
+    scoped_ptr_t<blocker_pool_t> datasync_pool_;
+
+    DISABLE_COPYING(async_diskmgr_t);
+};
+
+#endif  // USE_KERNEL_ASYNC_IO
+
+#endif  // ARCH_IO_DISK_ASYNC_HPP_
@@ -0,0 +1,161 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/io/disk/coalescing.hpp"
+
+#include <limits.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "config/args.hpp"
+
+struct coalescing_diskmgr_t::coalesced_action_t : public action_t {
+    // The actions that this one is made of, in order.
+    std::vector<action_t *> parts;
+};
+
+coalescing_diskmgr_t::coalescing_diskmgr_t(
+        perfmon_collection_t *stats, const std::string &name,
+        passive_producer_t<action_t *> *_source) :
+    passive_producer_t<action_t *>(&available_control),
+    producer(this),
+    source(_source),
+    pending(NULL),
+    producing(false),
+    stats_membership(stats,
+                     &coalesced_writes, (name + "_coalesced_writes").c_str(),
+                     &coalesced_reads, (name + "_coalesced_reads").c_str()) {
+    update_availability();
+    source->available->set_callback(this);
+}
+
+coalescing_diskmgr_t::~coalescing_diskmgr_t() {
+    rassert(pending == NULL);
+    source->available->unset_callback();
+}
+
+bool coalescing_diskmgr_t::can_coalesce(action_t *a) {
+#if USE_WRITEV
+    return !a->get_wrap_in_datasyncs() && a->get_count() > 0;
+#else
+    (void)a;
+    return false;
+#endif
+}
+
+bool coalescing_diskmgr_t::can_append(action_t *next, action_t *first,
+                                      int64_t end_offset) {
+    return can_coalesce(next)
+        && next->get_is_read() == first->get_is_read()
+        && next->get_fd() == first->get_fd()
+        && next->get_offset() == end_offset;
+}
+
+pool_diskmgr_t::action_t *coalescing_diskmgr_t::produce_next_value() {
+    rassert(!producing);
+    producing = true;
+
+    action_t *first;
+    if (pending != NULL) {
+        first = pending;
+        pending = NULL;
+    } else {
+        first = source->pop();
+    }
+
+    std::vector<action_t *> parts(1, first);
+    if (can_coalesce(first)) {
+        size_t total_count = first->get_count();
+        size_t total_bufs;
+        {
+            iovec *bufs;
+            first->get_bufs(&bufs, &total_bufs);
+        }
+        while (source->available->get()) {
+            action_t *next = source->pop();
+            iovec *bufs;
+            size_t bufs_len;
+            next->get_bufs(&bufs, &bufs_len);
+            if (!can_append(next, first, first->get_offset() + total_count)
+                || total_count + next->get_count() > IO_COALESCING_MAX_BYTES
+                || total_bufs + bufs_len > static_cast<size_t>(IOV_MAX)) {
+                pending = next;
+                break;
+            }
+            parts.push_back(next);
+            total_count += next->get_count();
+            total_bufs += bufs_len;
+        }
+
+        if (parts.size() > 1) {
+#if USE_WRITEV
+            scoped_array_t<iovec> merged_bufs(total_bufs);
+            size_t i = 0;
+            for (auto it = parts.begin(); it != parts.end(); ++it) {
+                iovec *bufs;
+                size_t bufs_len;
+                (*it)->get_bufs(&bufs, &bufs_len);
+                memcpy(merged_bufs.data() + i, bufs, bufs_len * sizeof(iovec));
+                i += bufs_len;
+            }
+            rassert(i == total_bufs);
+
+            coalesced_action_t *merged = new coalesced_action_t;
+            if (first->get_is_read()) {
+                merged->make_readv(first->get_fd(), std::move(merged_bufs),
+                                   total_count, first->get_offset());
+                coalesced_reads += parts.size() - 1;
+            } else {
+                merged->make_writev(first->get_fd(), std::move(merged_bufs),
+                                    total_count, first->get_offset());
+                coalesced_writes += parts.size() - 1;
+            }
+            merged->parts.swap(parts);
+            first = merged;
+#else
+            unreachable();
+#endif
+        }
+    }
+
+    producing = false;
+    update_availability();
+    return first;
+}
+
+void coalescing_diskmgr_t::done(action_t *a) {
+    coalesced_action_t *merged = dynamic_cast<coalesced_action_t *>(a);
+    if (merged == NULL) {
+        done_fun(a);
+        return;
+    }
+
+    // An error goes to every part.  Otherwise each part gets the bytes of the
+    // merged result that fall in its range, which only matters for a short read.
+    const int64_t result = merged->io_result;
+    std::vector<action_t *> parts;
+    parts.swap(merged->parts);
+    delete merged;
+
+    int64_t part_start = 0;
+    for (auto it = parts.begin(); it != parts.end(); ++it) {
+        const int64_t count = (*it)->get_count();
+        if (result < 0) {
+            (*it)->io_result = result;
+        } else {
+            (*it)->io_result = std::min(count, std::max<int64_t>(0, result - part_start));
+        }
+        part_start += count;
+        done_fun(*it);
+    }
+}
+
+void coalescing_diskmgr_t::on_source_availability_changed() {
+    // `produce_next_value()` updates our availability itself when it's done popping.
+    if (!producing) {
+        update_availability();
+    }
+}
+
+void coalescing_diskmgr_t::update_availability() {
+    available_control.set_available(pending != NULL || source->available->get());
+}
@@ -0,0 +1,69 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_DISK_COALESCING_HPP_
+#define ARCH_IO_DISK_COALESCING_HPP_
+
+#include <string>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/function.hpp>
+
+#include "arch/io/disk/pool.hpp"
+#include "concurrency/queue/passive_producer.hpp"
+#include "perfmon/perfmon.hpp"
+
+/* `coalescing_diskmgr_t` sits between the queue and the backend.  When the backend
+pops a write and the next writes in the queue continue it in the same file, they are
+merged into one vectored write of at most `IO_COALESCING_MAX_BYTES`.  Reads are merged
+the same way, into one vectored read; that's what lets a large blob, whose blocks the
+serializer wrote next to each other and the cache loads all at once, come off the
+disk in one read.  When the merged action is done, `done_fun` is called on each of
+the original actions with its share of the merged action's result.
+
+Only actions that are already queued are merged, so this never holds one back.
+Writes that are wrapped in datasyncs are passed through as they are.  The order in
+which the backend sees the actions doesn't change. */
+
+class coalescing_diskmgr_t :
+    private passive_producer_t<pool_diskmgr_t::action_t *>,
+    private availability_callback_t {
+public:
+    typedef pool_diskmgr_t::action_t action_t;
+
+    coalescing_diskmgr_t(perfmon_collection_t *stats, const std::string &name,
+                         passive_producer_t<action_t *> *_source);
+    ~coalescing_diskmgr_t();
+
+    boost::function<void (action_t *)> done_fun;
+
+    passive_producer_t<action_t *> *const producer;
+    void done(action_t *a);
+
+private:
+    struct coalesced_action_t;
+
+    action_t *produce_next_value();
+    void on_source_availability_changed();
+    void update_availability();
+
+    // Whether `next` can be appended to a merged action like `first` that ends at
+    // `end_offset`.
+    static bool can_append(action_t *next, action_t *first, int64_t end_offset);
+    static bool can_coalesce(action_t *a);
+
+    passive_producer_t<action_t *> *const source;
+    availability_control_t available_control;
+
+    // An action that we popped from `source` looking for writes to merge but that
+    // couldn't be merged.  It is the next one we produce.
+    action_t *pending;
+    bool producing;
+
+    perfmon_counter_t coalesced_writes;
+    perfmon_counter_t coalesced_reads;
+    perfmon_multi_membership_t stats_membership;
+
+    DISABLE_COPYING(coalescing_diskmgr_t);
+};
+
+#endif  // ARCH_IO_DISK_COALESCING_HPP_
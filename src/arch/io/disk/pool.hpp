@@ -53,6 +53,16 @@ struct pool_diskmgr_action_t
         buf_and_count.iov_len = _count;
         offset = _offset;
     }
+
+    void make_readv(fd_t _fd, scoped_array_t<iovec> &&_bufs, size_t _count, int64_t _offset) {
+        is_read = true;
+        wrap_in_datasyncs = false;
+        fd = _fd;
+        iovecs = std::move(_bufs);
+        buf_and_count.iov_base = NULL;
+        buf_and_count.iov_len = _count;
+        offset = _offset;
+    }
 #endif
 
     void make_read(fd_t _fd, void *_buf, size_t _count, int64_t _offset) {
@@ -66,6 +76,7 @@ struct pool_diskmgr_action_t
 
     bool get_is_write() const { return !is_read; }
     bool get_is_read() const { return is_read; }
+    bool get_wrap_in_datasyncs() const { return wrap_in_datasyncs; }
     fd_t get_fd() const { return fd; }
     void get_bufs(iovec **iovecs_out, size_t *iovecs_len_out) {
         if (buf_and_count.iov_base != NULL) {
@@ -88,16 +99,17 @@ struct pool_diskmgr_action_t
 
 private:
     friend class pool_diskmgr_t;
+    friend class async_diskmgr_t;
+    friend class coalescing_diskmgr_t;
     pool_diskmgr_t *parent;
 
     bool is_read;
     bool wrap_in_datasyncs;
     fd_t fd;
 
-    // Either buf_and_count.iov_base is used, or iovecs is used (for writev).  If
-    // iovecs is used, then buf_and_count.iov_len is the sum of the iovecs' iov_len
-    // fields.  Currently readv is not supported, but if you need it, it should be
-    // easy to add.
+    // Either buf_and_count.iov_base is used, or iovecs is used (for writev and
+    // readv).  If iovecs is used, then buf_and_count.iov_len is the sum of the
+    // iovecs' iov_len fields.
     scoped_array_t<iovec> iovecs;
     iovec buf_and_count;
     int64_t offset;
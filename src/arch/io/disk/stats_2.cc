@@ -4,6 +4,25 @@
 
 #include "containers/printf_buffer.hpp"
 
+// How much weight a new read latency gets in the moving average.
+#define READ_LATENCY_SAMPLE_WEIGHT 0.05
+
+// Only written by the disk managers' threads, with
+// update_recent_disk_read_latency.
+static ticks_t recent_disk_read_latency = 0;
+
+ticks_t get_recent_disk_read_latency() {
+    return __sync_fetch_and_add(&recent_disk_read_latency, 0);
+}
+
+static void update_recent_disk_read_latency(ticks_t latency) {
+    // We don't care about losing a sample when two disk managers race here.
+    const ticks_t old_average = get_recent_disk_read_latency();
+    const ticks_t new_average = (1 - READ_LATENCY_SAMPLE_WEIGHT) * old_average
+        + READ_LATENCY_SAMPLE_WEIGHT * latency;
+    __sync_lock_test_and_set(&recent_disk_read_latency, new_average);
+}
+
 void debug_print(printf_buffer_t *buf,
                  const stats_diskmgr_2_action_t &action) {
     buf->appendf("stats_diskmgr_2_action{start_time=%" PRIu64 "}<",
@@ -21,16 +40,33 @@ stats_diskmgr_2_t::stats_diskmgr_2_t(
     passive_producer_t<pool_diskmgr_t::action_t *>(_source->available),
     producer(this),
     source(_source),
-    read_sampler(secs_to_ticks(1)),
+    // Reads are always timed, for get_recent_disk_read_latency.
+    read_sampler(secs_to_ticks(1), true),
     write_sampler(secs_to_ticks(1)),
+    deadline_queue_sampler(secs_to_ticks(1)),
+    background_queue_sampler(secs_to_ticks(1)),
     stats_membership(stats,
                      &read_sampler, (name + "_read").c_str(),
-                     &write_sampler, (name + "_write").c_str()) { }
+                     &write_sampler, (name + "_write").c_str(),
+                     &deadline_queue_sampler, (name + "_deadline_queue").c_str(),
+                     &background_queue_sampler, (name + "_background_queue").c_str()) { }
+
+void stats_diskmgr_2_t::queued(action_t *a) {
+    if (a->has_deadline) {
+        deadline_queue_sampler.begin(&a->queue_start_time);
+    } else {
+        background_queue_sampler.begin(&a->queue_start_time);
+    }
+}
 
 
 void stats_diskmgr_2_t::done(pool_diskmgr_t::action_t *p) {
     action_t *a = static_cast<action_t *>(p);
     if (a->get_is_read()) {
+        // (The sampler can be told not to time reads after all.)
+        if (a->start_time != 0) {
+            update_recent_disk_read_latency(get_ticks() - a->start_time);
+        }
         read_sampler.end(&a->start_time);
     } else {
         write_sampler.end(&a->start_time);
@@ -40,6 +76,11 @@ void stats_diskmgr_2_t::done(pool_diskmgr_t::action_t *p) {
 
 pool_diskmgr_t::action_t *stats_diskmgr_2_t::produce_next_value() {
     action_t *a = source->pop();
+    if (a->has_deadline) {
+        deadline_queue_sampler.end(&a->queue_start_time);
+    } else {
+        background_queue_sampler.end(&a->queue_start_time);
+    }
     if (a->get_is_read()) {
         read_sampler.begin(&a->start_time);
     } else {
@@ -8,11 +8,19 @@
 
 struct stats_diskmgr_2_action_t : public pool_diskmgr_t::action_t {
     ticks_t start_time;
+    // When the action was queued, and whether its IO account has a deadline.
+    ticks_t queue_start_time;
+    bool has_deadline;
 };
 
 void debug_print(printf_buffer_t *buf,
                  const stats_diskmgr_2_action_t &action);
 
+/* The moving average of how long the disk took for recent reads, over all the disk
+managers.  This can be called on any thread.  It is used to keep background I/O
+(namely the serializer's GC) from hurting query latency. */
+ticks_t get_recent_disk_read_latency();
+
 struct stats_diskmgr_2_t : private passive_producer_t<pool_diskmgr_t::action_t *> {
     typedef stats_diskmgr_2_action_t action_t;
 
@@ -28,11 +36,18 @@ struct stats_diskmgr_2_t : private passive_producer_t<pool_diskmgr_t::action_t *
     passive_producer_t<pool_diskmgr_t::action_t *> *const producer;
     void done(pool_diskmgr_t::action_t *p);
 
+    /* Should be called when an action is put on the queue that `_source` pops from,
+    so that we know how many actions are waiting there and for how long. */
+    void queued(action_t *a);
+
 private:
     pool_diskmgr_t::action_t *produce_next_value();
 
     passive_producer_t<action_t *> *source;
     perfmon_duration_sampler_t read_sampler, write_sampler;
+    // The queue depths and wait times of the accounts with deadlines and of the
+    // other (background) accounts.
+    perfmon_duration_sampler_t deadline_queue_sampler, background_queue_sampler;
     perfmon_multi_membership_t stats_membership;
 };
 
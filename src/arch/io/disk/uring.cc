@@ -0,0 +1,184 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/io/disk/uring.hpp"
+
+#if USE_IO_URING
+
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "arch/io/io_utils.hpp"
+#include "arch/runtime/system_event/eventfd.hpp"
+
+// glibc has no wrappers for the io_uring system calls either.
+
+static int sys_io_uring_setup(unsigned entries, io_uring_params *params) {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(fd_t fd, unsigned to_submit, unsigned min_complete,
+                              unsigned flags) {
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(fd_t fd, unsigned opcode, const void *arg,
+                                 unsigned nr_args) {
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+int uring_diskmgr_t::check_support() {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    const int ring_fd = sys_io_uring_setup(1, &params);
+    if (ring_fd == -1) {
+        return get_errno();
+    }
+    scoped_fd_t ring(ring_fd);
+
+    const int event_fd = eventfd(0, 0);
+    if (event_fd == -1) {
+        return get_errno();
+    }
+    scoped_fd_t event(event_fd);
+
+    if (sys_io_uring_register(ring.get(), IORING_REGISTER_EVENTFD, &event_fd, 1) != 0) {
+        return get_errno();
+    }
+    return 0;
+}
+
+static void *map_ring(fd_t ring_fd, size_t size, off_t offset) {
+    void *res = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     ring_fd, offset);
+    guarantee_err(res != MAP_FAILED, "Could not map an io_uring ring");
+    return res;
+}
+
+template <class T>
+static T *ring_field(void *ring, unsigned offset) {
+    return reinterpret_cast<T *>(static_cast<char *>(ring) + offset);
+}
+
+uring_diskmgr_t::uring_diskmgr_t(linux_event_queue_t *queue,
+                                 passive_producer_t<action_t *> *source,
+                                 int max_concurrent_io_requests)
+    : async_diskmgr_t(queue, source, max_concurrent_io_requests),
+      to_submit_(0) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd_ = sys_io_uring_setup(queue_depth(), &params);
+    guarantee_err(ring_fd_ != -1, "Could not set up an io_uring");
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+#ifdef IORING_FEAT_SINGLE_MMAP
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+        // Linux 5.4 and later map both rings with one mmap.
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+        sq_ring_ = map_ring(ring_fd_, sq_ring_size_, IORING_OFF_SQ_RING);
+        cq_ring_ = sq_ring_;
+    } else
+#endif
+    {
+        sq_ring_ = map_ring(ring_fd_, sq_ring_size_, IORING_OFF_SQ_RING);
+        cq_ring_ = map_ring(ring_fd_, cq_ring_size_, IORING_OFF_CQ_RING);
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe *>(map_ring(ring_fd_, sqes_size_, IORING_OFF_SQES));
+
+    sq_tail_ = ring_field<unsigned>(sq_ring_, params.sq_off.tail);
+    sq_ring_mask_ = *ring_field<unsigned>(sq_ring_, params.sq_off.ring_mask);
+    sq_array_ = ring_field<unsigned>(sq_ring_, params.sq_off.array);
+    cq_head_ = ring_field<unsigned>(cq_ring_, params.cq_off.head);
+    cq_tail_ = ring_field<unsigned>(cq_ring_, params.cq_off.tail);
+    cq_ring_mask_ = *ring_field<unsigned>(cq_ring_, params.cq_off.ring_mask);
+    cqes_ = ring_field<io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+
+    // There can't be more operations in flight than there are requests, so neither
+    // queue can overflow.
+    guarantee(params.sq_entries >= static_cast<unsigned>(queue_depth()));
+
+    const fd_t event_fd = completion_eventfd();
+    int res = sys_io_uring_register(ring_fd_, IORING_REGISTER_EVENTFD, &event_fd, 1);
+    guarantee_err(res == 0, "Could not register an eventfd with an io_uring");
+
+    start();
+}
+
+uring_diskmgr_t::~uring_diskmgr_t() {
+    stop();
+    int res = munmap(sqes_, sqes_size_);
+    guarantee_err(res == 0, "Could not unmap an io_uring ring");
+    if (cq_ring_ != sq_ring_) {
+        res = munmap(cq_ring_, cq_ring_size_);
+        guarantee_err(res == 0, "Could not unmap an io_uring ring");
+    }
+    res = munmap(sq_ring_, sq_ring_size_);
+    guarantee_err(res == 0, "Could not unmap an io_uring ring");
+    res = close(ring_fd_);
+    guarantee_err(res == 0 || get_errno() == EINTR, "Could not close an io_uring");
+}
+
+void uring_diskmgr_t::prepare_op(void *tag, const op_t &op) {
+    // Only we write the tail, and the kernel reads it once we call io_uring_enter.
+    const unsigned tail = *sq_tail_;
+    const unsigned index = tail & sq_ring_mask_;
+    io_uring_sqe *sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    switch (op.type) {
+    case op_readv:
+        sqe->opcode = IORING_OP_READV;
+        break;
+    case op_writev:
+        sqe->opcode = IORING_OP_WRITEV;
+        break;
+    case op_datasync:
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        break;
+    default:
+        unreachable();
+    }
+    sqe->fd = op.fd;
+    sqe->addr = reinterpret_cast<uintptr_t>(op.iov);
+    sqe->len = op.iovcnt;
+    sqe->off = op.offset;
+    sqe->user_data = reinterpret_cast<uintptr_t>(tag);
+    sq_array_[index] = index;
+
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    ++to_submit_;
+}
+
+void uring_diskmgr_t::submit_ops() {
+    while (to_submit_ > 0) {
+        int res = sys_io_uring_enter(ring_fd_, to_submit_, 0, 0);
+        if (res == -1 && (get_errno() == EINTR || get_errno() == EAGAIN)) {
+            continue;
+        }
+        guarantee_err(res > 0, "Could not submit io_uring operations");
+        to_submit_ -= res;
+    }
+}
+
+void uring_diskmgr_t::reap_ops() {
+    // Only we write the head.
+    unsigned head = *cq_head_;
+    for (;;) {
+        const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            break;
+        }
+        const io_uring_cqe cqe = cqes_[head & cq_ring_mask_];
+        ++head;
+        // Release the entry before op_done, which might prepare more operations.
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        op_done(reinterpret_cast<void *>(static_cast<uintptr_t>(cqe.user_data)),
+                cqe.res);
+    }
+}
+
+#endif  // USE_IO_URING
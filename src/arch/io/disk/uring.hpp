@@ -0,0 +1,64 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_DISK_URING_HPP_
+#define ARCH_IO_DISK_URING_HPP_
+
+#include "arch/io/disk/async.hpp"
+
+// Build with NO_IO_URING=1 on systems whose kernel headers predate io_uring.
+#if USE_KERNEL_ASYNC_IO && !defined(NO_IO_URING)
+#define USE_IO_URING 1
+#else
+#define USE_IO_URING 0
+#endif
+
+#if USE_IO_URING
+
+#include <linux/io_uring.h>
+
+/* The io_uring disk manager puts IO requests on an io_uring submission queue, and
+sends them to the kernel with one io_uring_enter(2) call per batch.  We need Linux
+5.2 or later (for IORING_REGISTER_EVENTFD). */
+
+class uring_diskmgr_t : public async_diskmgr_t {
+public:
+    // Returns 0 if the kernel supports everything we need from io_uring, the errno
+    // value otherwise.
+    static int check_support();
+
+    uring_diskmgr_t(linux_event_queue_t *queue, passive_producer_t<action_t *> *source,
+                    int max_concurrent_io_requests);
+    ~uring_diskmgr_t();
+
+private:
+    void prepare_op(void *tag, const op_t &op);
+    void submit_ops();
+    void reap_ops();
+
+    fd_t ring_fd_;
+
+    void *sq_ring_;
+    size_t sq_ring_size_;
+    void *cq_ring_;
+    size_t cq_ring_size_;
+    io_uring_sqe *sqes_;
+    size_t sqes_size_;
+
+    // Pointers into the submission and completion queue rings.
+    unsigned *sq_tail_;
+    unsigned sq_ring_mask_;
+    unsigned *sq_array_;
+    unsigned *cq_head_;
+    unsigned *cq_tail_;
+    unsigned cq_ring_mask_;
+    io_uring_cqe *cqes_;
+
+    // How many entries we've added to the submission queue since the last
+    // io_uring_enter call.
+    unsigned to_submit_;
+
+    DISABLE_COPYING(uring_diskmgr_t);
+};
+
+#endif  // USE_IO_URING
+
+#endif  // ARCH_IO_DISK_URING_HPP_
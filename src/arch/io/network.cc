@@ -4,6 +4,7 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <net/if.h>
 #include <netdb.h>
 #include <netinet/tcp.h>
@@ -96,10 +97,12 @@ linux_tcp_conn_t::linux_tcp_conn_t(const ip_address_t &peer,
         sock(create_socket_wrapper(peer.get_address_family())),
         event_watcher(new linux_event_watcher_t(sock.get(), this)),
         read_in_progress(false), write_in_progress(false),
+        read_buffer_begin(0), read_buffer_end(0), read_size(IO_BUFFER_SIZE),
         write_handler(this),
         write_queue_limiter(WRITE_QUEUE_MAX_SIZE),
         write_coro_pool(1, &write_queue, &write_handler),
         current_write_buffer(get_write_buffer()),
+        write_corked(false),
         drainer(new auto_drainer_t) {
     guarantee_err(fcntl(sock.get(), F_SETFL, O_NONBLOCK) == 0, "Could not make socket non-blocking");
 
@@ -142,10 +145,12 @@ linux_tcp_conn_t::linux_tcp_conn_t(fd_t s) :
     sock(s),
     event_watcher(new linux_event_watcher_t(sock.get(), this)),
     read_in_progress(false), write_in_progress(false),
+    read_buffer_begin(0), read_buffer_end(0), read_size(IO_BUFFER_SIZE),
     write_handler(this),
     write_queue_limiter(WRITE_QUEUE_MAX_SIZE),
     write_coro_pool(1, &write_queue, &write_handler),
     current_write_buffer(get_write_buffer()),
+    write_corked(false),
     drainer(new auto_drainer_t)
 {
     rassert(sock.get() != INVALID_FD);
@@ -231,15 +236,55 @@ size_t linux_tcp_conn_t::read_internal(void *buffer, size_t size) THROWS_ONLY(tc
     }
 }
 
+void linux_tcp_conn_t::consume_read_buffer(size_t len) {
+    rassert(len <= read_buffer_size());
+    read_buffer_begin += len;
+    if (read_buffer_begin == read_buffer_end) {
+        read_buffer_begin = read_buffer_end = 0;
+        // Don't hold on to a buffer that a big peek() made us grow.
+        if (read_buffer.size() > 2 * TCP_CONN_MAX_READ_SIZE) {
+            read_buffer.reset();
+        }
+    }
+}
+
+void linux_tcp_conn_t::fill_read_buffer() THROWS_ONLY(tcp_conn_read_closed_exc_t) {
+    if (read_buffer.size() - read_buffer_end < read_size) {
+        const size_t buffered = read_buffer_size();
+        if (buffered + read_size <= read_buffer.size()) {
+            memmove(read_buffer.data(), read_buffer.data() + read_buffer_begin, buffered);
+        } else {
+            scoped_array_t<char> new_buffer(
+                std::max(2 * read_buffer.size(), buffered + read_size));
+            if (buffered > 0) {
+                memcpy(new_buffer.data(), read_buffer.data() + read_buffer_begin, buffered);
+            }
+            read_buffer.swap(new_buffer);
+        }
+        read_buffer_begin = 0;
+        read_buffer_end = buffered;
+    }
+
+    const size_t delta = read_internal(read_buffer.data() + read_buffer_end, read_size);
+    read_buffer_end += delta;
+
+    // Adapt the size of our reads to how much data the peer is sending us.
+    if (delta == read_size && read_size < TCP_CONN_MAX_READ_SIZE) {
+        read_size *= 2;
+    } else if (delta < read_size / 4 && read_size > IO_BUFFER_SIZE) {
+        read_size /= 2;
+    }
+}
+
 size_t linux_tcp_conn_t::read_some(void *buf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
     rassert(size > 0);
     read_op_wrapper_t sentry(this, closer);
 
-    if (read_buffer.size()) {
+    if (read_buffer_size() > 0) {
         /* Return the data from the peek buffer */
-        size_t read_buffer_bytes = std::min(read_buffer.size(), size);
-        memcpy(buf, read_buffer.data(), read_buffer_bytes);
-        read_buffer.erase(read_buffer.begin(), read_buffer.begin() + read_buffer_bytes);
+        size_t read_buffer_bytes = std::min(read_buffer_size(), size);
+        memcpy(buf, read_buffer.data() + read_buffer_begin, read_buffer_bytes);
+        consume_read_buffer(read_buffer_bytes);
         return read_buffer_bytes;
     } else {
         /* Go to the kernel _once_. */
@@ -249,31 +294,33 @@ size_t linux_tcp_conn_t::read_some(void *buf, size_t size, signal_t *closer) THR
 
 void linux_tcp_conn_t::read(void *buf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
     read_op_wrapper_t sentry(this, closer);
+    char *dest = static_cast<char *>(buf);
 
-    /* First, consume any data in the peek buffer */
-    int read_buffer_bytes = std::min(read_buffer.size(), size);
-    memcpy(buf, read_buffer.data(), read_buffer_bytes);
-    read_buffer.erase(read_buffer.begin(), read_buffer.begin() + read_buffer_bytes);
-    buf = reinterpret_cast<void *>(reinterpret_cast<char *>(buf) + read_buffer_bytes);
-    size -= read_buffer_bytes;
-
-    /* Now go to the kernel for any more data that we need */
     while (size > 0) {
-        size_t delta = read_internal(buf, size);
-        rassert(delta <= size);
-        buf = reinterpret_cast<void *>(reinterpret_cast<char *>(buf) + delta);
-        size -= delta;
+        /* First, consume any data in the peek buffer */
+        if (read_buffer_size() > 0) {
+            size_t read_buffer_bytes = std::min(read_buffer_size(), size);
+            memcpy(dest, read_buffer.data() + read_buffer_begin, read_buffer_bytes);
+            consume_read_buffer(read_buffer_bytes);
+            dest += read_buffer_bytes;
+            size -= read_buffer_bytes;
+        } else if (size < read_size) {
+            /* Small reads go through the buffer, so that a client that pipelines
+            many small messages doesn't cost us a syscall per message. */
+            fill_read_buffer();
+        } else {
+            /* Big reads go straight into the caller's buffer */
+            size_t delta = read_internal(dest, size);
+            rassert(delta <= size);
+            dest += delta;
+            size -= delta;
+        }
     }
 }
 
 void linux_tcp_conn_t::read_more_buffered(signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
     read_op_wrapper_t sentry(this, closer);
-
-    size_t old_size = read_buffer.size();
-    read_buffer.resize(old_size + IO_BUFFER_SIZE);
-    size_t delta = read_internal(read_buffer.data() + old_size, IO_BUFFER_SIZE);
-
-    read_buffer.resize(old_size + delta);
+    fill_read_buffer();
 }
 
 const_charslice linux_tcp_conn_t::peek() const THROWS_ONLY(tcp_conn_read_closed_exc_t) {
@@ -281,14 +328,16 @@ const_charslice linux_tcp_conn_t::peek() const THROWS_ONLY(tcp_conn_read_closed_
     rassert(!read_in_progress);   // Is there a read already in progress?
     if (read_closed.is_pulsed()) throw tcp_conn_read_closed_exc_t();
 
-    return const_charslice(read_buffer.data(), read_buffer.data() + read_buffer.size());
+    return const_charslice(read_buffer.data() + read_buffer_begin,
+                           read_buffer.data() + read_buffer_end);
 }
 
 const_charslice linux_tcp_conn_t::peek(size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
-    while (read_buffer.size() < size) {
+    while (read_buffer_size() < size) {
         read_more_buffered(closer);
     }
-    return const_charslice(read_buffer.data(), read_buffer.data() + size);
+    return const_charslice(read_buffer.data() + read_buffer_begin,
+                           read_buffer.data() + read_buffer_begin + size);
 }
 
 void linux_tcp_conn_t::pop(size_t len, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
@@ -297,7 +346,7 @@ void linux_tcp_conn_t::pop(size_t len, signal_t *closer) THROWS_ONLY(tcp_conn_re
     if (read_closed.is_pulsed()) throw tcp_conn_read_closed_exc_t();
 
     peek(len, closer);
-    read_buffer.erase(read_buffer.begin(), read_buffer.begin() + len);  // INEFFICIENT
+    consume_read_buffer(len);
 }
 
 void linux_tcp_conn_t::shutdown_read() {
@@ -325,12 +374,50 @@ linux_tcp_conn_t::write_handler_t::write_handler_t(linux_tcp_conn_t *_parent) :
 { }
 
 void linux_tcp_conn_t::write_handler_t::coro_pool_callback(write_queue_op_t *operation, UNUSED signal_t *interruptor) {
-    if (operation->buffer != NULL) {
-        parent->perform_write(operation->buffer, operation->size);
-        if (operation->dealloc != NULL) {
-            parent->release_write_buffer(operation->dealloc);
-            parent->write_queue_limiter.unlock(operation->size);
+    batch.clear();
+    batch_iovecs.clear();
+    add_to_batch(operation);
+
+    /* Take along whatever queued up while we were busy, as long as it fits into a
+    single `writev()` call. */
+    while (parent->write_queue.size() > 0) {
+        write_queue_op_t *next = parent->write_queue.peek();
+        const size_t next_iovcnt = next->iov != NULL ? next->iovcnt : (next->buffer != NULL ? 1 : 0);
+        if (batch_iovecs.size() + next_iovcnt > static_cast<size_t>(IOV_MAX)) {
+            break;
         }
+        add_to_batch(parent->write_queue.pop());
+    }
+
+    parent->set_write_corked(parent->write_queue.size() > 0);
+    if (!batch_iovecs.empty()) {
+        parent->perform_write(batch_iovecs.data(), batch_iovecs.size());
+    }
+    parent->set_write_corked(parent->write_queue.size() > 0);
+
+    for (auto it = batch.begin(); it != batch.end(); ++it) {
+        finish_operation(*it);
+    }
+    batch.clear();
+}
+
+void linux_tcp_conn_t::write_handler_t::add_to_batch(write_queue_op_t *operation) {
+    batch.push_back(operation);
+    if (operation->iov != NULL) {
+        batch_iovecs.insert(batch_iovecs.end(),
+                            operation->iov, operation->iov + operation->iovcnt);
+    } else if (operation->buffer != NULL) {
+        iovec iov;
+        iov.iov_base = const_cast<void *>(operation->buffer);
+        iov.iov_len = operation->size;
+        batch_iovecs.push_back(iov);
+    }
+}
+
+void linux_tcp_conn_t::write_handler_t::finish_operation(write_queue_op_t *operation) {
+    if (operation->dealloc != NULL) {
+        parent->release_write_buffer(operation->dealloc);
+        parent->write_queue_limiter.unlock(operation->size);
     }
 
     if (operation->cond != NULL) {
@@ -351,6 +438,8 @@ void linux_tcp_conn_t::internal_flush_write_buffer() {
     op->buffer = current_write_buffer->buffer;
     op->size = current_write_buffer->size;
     op->dealloc = current_write_buffer.release();
+    op->iov = NULL;
+    op->iovcnt = 0;
     op->cond = NULL;
     op->keepalive = auto_drainer_t::lock_t(drainer.get());
     current_write_buffer.init(get_write_buffer());
@@ -364,7 +453,7 @@ void linux_tcp_conn_t::internal_flush_write_buffer() {
     write_queue.push(op);
 }
 
-void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
+void linux_tcp_conn_t::perform_write(iovec *iov, size_t iovcnt) {
     assert_thread();
 
     if (write_closed.is_pulsed()) {
@@ -374,8 +463,15 @@ void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
         return;
     }
 
-    while (size > 0) {
-        ssize_t res = ::write(sock.get(), buf, size);
+    /* Skip empty buffers so that `res == 0` below really means that nothing was
+    written. */
+    while (iovcnt > 0 && iov->iov_len == 0) {
+        ++iov;
+        --iovcnt;
+    }
+
+    while (iovcnt > 0) {
+        ssize_t res = ::writev(sock.get(), iov, std::min<size_t>(iovcnt, IOV_MAX));
 
         if (res == -1 && (get_errno() == EAGAIN || get_errno() == EWOULDBLOCK)) {
             /* Wait for a notification from the event queue, or for an order to
@@ -413,14 +509,38 @@ void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
             break;
 
         } else {
-            rassert(res <= static_cast<ssize_t>(size));
-            buf = reinterpret_cast<const void *>(reinterpret_cast<const char *>(buf) + res);
-            size -= res;
             if (write_perfmon) write_perfmon->record(res);
+            size_t written = res;
+            while (iovcnt > 0 && written >= iov->iov_len) {
+                written -= iov->iov_len;
+                ++iov;
+                --iovcnt;
+            }
+            rassert(iovcnt > 0 || written == 0);
+            if (iovcnt > 0) {
+                iov->iov_base = static_cast<char *>(iov->iov_base) + written;
+                iov->iov_len -= written;
+            }
         }
     }
 }
 
+void linux_tcp_conn_t::set_write_corked(bool corked) {
+    assert_thread();
+#ifdef TCP_CORK
+    if (corked == write_corked || write_closed.is_pulsed()) {
+        return;
+    }
+    int sockoptval = corked ? 1 : 0;
+    int res = setsockopt(sock.get(), IPPROTO_TCP, TCP_CORK, &sockoptval, sizeof(sockoptval));
+    if (res == 0) {
+        write_corked = corked;
+    }
+#else
+    (void)corked;
+#endif
+}
+
 void linux_tcp_conn_t::write(const void *buf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
     write_op_wrapper_t sentry(this, closer);
 
@@ -436,6 +556,8 @@ void linux_tcp_conn_t::write(const void *buf, size_t size, signal_t *closer) THR
     /* Enqueue the write so it will happen eventually */
     op.buffer = buf;
     op.size = size;
+    op.iov = NULL;
+    op.iovcnt = 0;
     op.dealloc = NULL;
     op.cond = &to_signal_when_done;
     write_queue.push(&op);
@@ -448,6 +570,30 @@ void linux_tcp_conn_t::write(const void *buf, size_t size, signal_t *closer) THR
     if (write_closed.is_pulsed()) throw tcp_conn_write_closed_exc_t();
 }
 
+void linux_tcp_conn_t::writev(const iovec *iov, size_t iovcnt, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
+    write_op_wrapper_t sentry(this, closer);
+
+    write_queue_op_t op;
+    cond_t to_signal_when_done;
+
+    /* Flush out any data that's been buffered, so that things don't get out of order */
+    if (current_write_buffer->size > 0) internal_flush_write_buffer();
+
+    /* Like in `write()`, we block until the write is done, so the write handler can
+    use the caller's buffers directly. */
+    op.buffer = NULL;
+    op.size = 0;
+    op.iov = iov;
+    op.iovcnt = iovcnt;
+    op.dealloc = NULL;
+    op.cond = &to_signal_when_done;
+    write_queue.push(&op);
+
+    to_signal_when_done.wait();
+
+    if (write_closed.is_pulsed()) throw tcp_conn_write_closed_exc_t();
+}
+
 void linux_tcp_conn_t::write_buffered(const void *vbuf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
     write_op_wrapper_t sentry(this, closer);
 
@@ -495,6 +641,8 @@ void linux_tcp_conn_t::flush_buffer(signal_t *closer) THROWS_ONLY(tcp_conn_write
     write_queue_op_t op;
     cond_t to_signal_when_done;
     op.buffer = NULL;
+    op.iov = NULL;
+    op.iovcnt = 0;
     op.dealloc = NULL;
     op.cond = &to_signal_when_done;
     write_queue.push(&op);
@@ -633,11 +781,13 @@ void linux_tcp_conn_descriptor_t::make_overcomplicated(linux_tcp_conn_t **tcp_co
 /* Network listener object */
 linux_nonthrowing_tcp_listener_t::linux_nonthrowing_tcp_listener_t(
         const std::set<ip_address_t> &bind_addresses, int _port,
-        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &cb) :
+        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &cb,
+        bool _reuse_port) :
     callback(cb),
     local_addresses(bind_addresses),
     port(_port),
     bound(false),
+    reuse_port(_reuse_port),
     socks(),
     last_used_socket_index(0),
     event_watchers(),
@@ -707,6 +857,15 @@ int linux_nonthrowing_tcp_listener_t::init_sockets() {
         int res = setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &sockoptval, sizeof(sockoptval));
         guarantee_err(res != -1, "Could not set REUSEADDR option");
 
+        if (reuse_port) {
+#ifdef SO_REUSEPORT
+            res = setsockopt(sock_fd, SOL_SOCKET, SO_REUSEPORT, &sockoptval, sizeof(sockoptval));
+            guarantee_err(res != -1, "Could not set REUSEPORT option");
+#else
+            crash("SO_REUSEPORT is not supported on this platform");
+#endif
+        }
+
         /* XXX Making our socket NODELAY prevents the problem where responses to
          * pipelined requests are delayed, since the TCP Nagle algorithm will
          * notice when we send multiple small packets and try to coalesce them. But
@@ -975,6 +1134,119 @@ int linux_tcp_listener_t::get_port() const {
     return listener->get_port();
 }
 
+static bool tcp_listener_reuse_port = false;
+
+void set_tcp_listener_reuse_port(bool reuse_port) {
+    tcp_listener_reuse_port = reuse_port;
+}
+
+/* Old kernels know SO_REUSEPORT but don't let us set it. */
+static bool kernel_supports_reuse_port() {
+#ifdef SO_REUSEPORT
+    scoped_fd_t sock(socket(AF_INET, SOCK_STREAM, 0));
+    if (sock.get() == INVALID_FD) {
+        return false;
+    }
+    int sockoptval = 1;
+    return setsockopt(sock.get(), SOL_SOCKET, SO_REUSEPORT,
+                      &sockoptval, sizeof(sockoptval)) == 0;
+#else
+    return false;
+#endif
+}
+
+linux_reuseport_tcp_listener_t::linux_reuseport_tcp_listener_t(
+        const std::set<ip_address_t> &bind_addresses, int _port,
+        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback,
+        int num_threads) THROWS_ONLY(address_in_use_exc_t, tcp_socket_exc_t) :
+    local_addresses(bind_addresses),
+    port(_port),
+    listeners(num_threads),
+    per_thread(false) {
+    guarantee(num_threads > 0 && num_threads <= get_num_threads());
+    per_thread = listens_per_thread(num_threads);
+
+    if (!per_thread) {
+        listeners[0].init(new linux_nonthrowing_tcp_listener_t(
+            local_addresses, port, callback));
+        if (!listeners[0]->begin_listening()) {
+            throw address_in_use_exc_t("localhost", listeners[0]->get_port());
+        }
+        port = listeners[0]->get_port();
+        return;
+    }
+
+    // The other threads' sockets have to be bound to the same port as the first
+    // one, which matters if we were asked for ANY_PORT.
+    std::exception_ptr error;
+    for (int i = 0; i < num_threads && !error; ++i) {
+        on_thread_t thread_switcher((threadnum_t(i)));
+        error = start_listener(i, i == 0 ? port : listeners[0]->get_port(), callback);
+    }
+    if (error) {
+        // We can't switch threads while we handle an exception, so we clean up
+        // before we throw it.
+        for (size_t i = 0; i < listeners.size(); ++i) {
+            stop_listener(i);
+        }
+        std::rethrow_exception(error);
+    }
+    port = listeners[0]->get_port();
+}
+
+std::exception_ptr linux_reuseport_tcp_listener_t::start_listener(
+        int thread, int listen_port,
+        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback) {
+    try {
+        listeners[thread].init(new linux_nonthrowing_tcp_listener_t(
+            local_addresses, listen_port, callback, true));
+        if (!listeners[thread]->begin_listening()) {
+            throw address_in_use_exc_t("localhost", listeners[thread]->get_port());
+        }
+    } catch (...) {
+        return std::current_exception();
+    }
+    return std::exception_ptr();
+}
+
+void linux_reuseport_tcp_listener_t::stop_listener(int thread) {
+    if (listeners[thread].has()) {
+        // The listeners' event watchers belong to the threads that created them.
+        on_thread_t thread_switcher(per_thread ? threadnum_t(thread) : home_thread());
+        listeners[thread].reset();
+    }
+}
+
+linux_reuseport_tcp_listener_t::~linux_reuseport_tcp_listener_t() {
+    for (size_t i = 0; i < listeners.size(); ++i) {
+        stop_listener(i);
+    }
+}
+
+int linux_reuseport_tcp_listener_t::get_port() const {
+    return port;
+}
+
+bool linux_reuseport_tcp_listener_t::is_per_thread() const {
+    return per_thread;
+}
+
+bool linux_reuseport_tcp_listener_t::listens_per_thread(int num_threads) {
+    if (!tcp_listener_reuse_port || num_threads <= 1) {
+        return false;
+    }
+    static bool warned = false;
+    if (!kernel_supports_reuse_port()) {
+        if (!warned) {
+            logWRN("The kernel doesn't support SO_REUSEPORT, so each port will only "
+                   "be listened on by one thread.");
+            warned = true;
+        }
+        return false;
+    }
+    return true;
+}
+
 linux_repeated_nonthrowing_tcp_listener_t::linux_repeated_nonthrowing_tcp_listener_t(
     const std::set<ip_address_t> &bind_addresses,
     int port,
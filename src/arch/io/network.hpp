@@ -6,9 +6,11 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <ifaddrs.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 
+#include <exception>
 #include <set>
 #include <stdexcept>
 #include <string>
@@ -80,12 +82,17 @@ public:
     // Note that you should always call peek() before calling
     // read_more_buffered(), because there might be leftover data in
     // the peek buffer that might be enough for you.
+    // The slice points straight into the read buffer, so parsers can work on it
+    // without copying. It stays valid until the next read, peek(size), pop() or
+    // read_more_buffered() call.
     const_charslice peek() const THROWS_ONLY(tcp_conn_read_closed_exc_t);
 
     //you can also peek with a specific size (this is really just convenient
     //for some things and can in some cases avoid an unneeded copy
     const_charslice peek(size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t);
 
+    // Consumes `len` bytes from the front of the read buffer. Popping bytes that
+    // have already been peeked at doesn't copy anything.
     void pop(size_t len, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t);
 
     void read_more_buffered(signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t);
@@ -105,6 +112,11 @@ public:
     pipe and throws `tcp_conn_write_closed_exc_t`. */
     void write(const void *buf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
 
+    /* writev() is like write(), but sends the `iovcnt` buffers at `iov` one after
+    another. The buffers are handed to the kernel as they are, without being copied
+    first, so they have to stay valid until writev() returns. */
+    void writev(const iovec *iov, size_t iovcnt, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
+
     /* write_buffered() is like write(), but it might not send the data until
     flush_buffer*() or write() is called. Internally, it bundles together the
     buffered writes; this may improve performance. */
@@ -224,8 +236,25 @@ private:
     /* These are pulsed if and only if the read/write end of the connection has been closed. */
     cond_t read_closed, write_closed;
 
-    /* Holds data that we read from the socket but hasn't been consumed yet */
-    std::vector<char> read_buffer;
+    /* Holds data that we read from the socket but hasn't been consumed yet, in
+    [read_buffer_begin, read_buffer_end). Consuming data only moves
+    `read_buffer_begin`; the unconsumed data is moved back to the front only when
+    there isn't enough room behind it for the next read. */
+    scoped_array_t<char> read_buffer;
+    size_t read_buffer_begin, read_buffer_end;
+
+    /* How much we ask the kernel for when we fill `read_buffer`. It starts out at
+    IO_BUFFER_SIZE and doubles (up to TCP_CONN_MAX_READ_SIZE) whenever a read fills
+    all of it, so that busy connections need fewer syscalls. */
+    size_t read_size;
+
+    size_t read_buffer_size() const {
+        return read_buffer_end - read_buffer_begin;
+    }
+    void consume_read_buffer(size_t len);
+
+    /* Reads up to `read_size` bytes from the socket into the end of `read_buffer`. */
+    void fill_read_buffer() THROWS_ONLY(tcp_conn_read_closed_exc_t);
 
     /* Reads up to the given number of bytes, but not necessarily that many. Simple wrapper around
     ::read(). Returns the number of bytes read or throws tcp_conn_read_closed_exc_t. Bypasses read_buffer. */
@@ -240,20 +269,32 @@ private:
         size_t size;
     };
 
+    /* An operation writes either `size` bytes from `buffer`, or the `iovcnt`
+    buffers at `iov` (if `iov` isn't NULL), or nothing at all. */
     struct write_queue_op_t : public intrusive_list_node_t<write_queue_op_t> {
         write_buffer_t *dealloc;
         const void *buffer;
         size_t size;
+        const iovec *iov;
+        size_t iovcnt;
         cond_t *cond;
         auto_drainer_t::lock_t keepalive;
     };
 
+    /* The write handler takes every operation that is queued up when it gets to
+    run and sends all of their data with as few `writev()` calls as possible. */
     class write_handler_t : public coro_pool_callback_t<write_queue_op_t*> {
     public:
         explicit write_handler_t(linux_tcp_conn_t *_parent);
     private:
         linux_tcp_conn_t *parent;
         void coro_pool_callback(write_queue_op_t *operation, signal_t *interruptor);
+        void add_to_batch(write_queue_op_t *operation);
+        void finish_operation(write_queue_op_t *operation);
+
+        // Kept around so that we don't allocate for every batch.
+        std::vector<write_queue_op_t *> batch;
+        std::vector<iovec> batch_iovecs;
     } write_handler;
 
     template <class T>
@@ -299,8 +340,14 @@ private:
     scoped_ptr_t<write_buffer_t> current_write_buffer;
 
     /* Used to actually perform a write. If the write end of the connection is open, then writes
-    `size` bytes from `buffer` to the socket. */
-    void perform_write(const void *buffer, size_t size);
+    the `iovcnt` buffers at `iov` to the socket. Overwrites `iov`. */
+    void perform_write(iovec *iov, size_t iovcnt);
+
+    /* While more writes are queued up behind the one that we are doing, we set
+    TCP_CORK so that the kernel only sends full segments. We take it off again when
+    the queue is empty, which sends whatever is left. */
+    void set_write_corked(bool corked);
+    bool write_corked;
 
     scoped_ptr_t<auto_drainer_t> drainer;
 };
@@ -332,8 +379,11 @@ the provided callback will be called in a new coroutine every time something con
 
 class linux_nonthrowing_tcp_listener_t : private linux_event_callback_t {
 public:
+    /* If `reuse_port` is true, the sockets are bound with SO_REUSEPORT, so that other
+    listeners can listen on the same port too. */
     linux_nonthrowing_tcp_listener_t(const std::set<ip_address_t> &bind_addresses, int _port,
-        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback);
+        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback,
+        bool reuse_port = false);
 
     ~linux_nonthrowing_tcp_listener_t();
 
@@ -376,6 +426,8 @@ private:
     // Inidicates successful binding to a port
     bool bound;
 
+    const bool reuse_port;
+
     // The sockets to listen for connections on
     scoped_array_t<scoped_fd_t> socks;
 
@@ -413,6 +465,52 @@ private:
     scoped_ptr_t<linux_nonthrowing_tcp_listener_t> listener;
 };
 
+/* `linux_reuseport_tcp_listener_t` is like `linux_tcp_listener_t`, but listens with
+one socket per thread (for the first `num_threads` threads), all bound to the same
+port with SO_REUSEPORT. The kernel spreads the incoming connections over the sockets,
+so no single thread has to accept all of them, and `callback` is called on the
+thread that accepted the connection; handle it there instead of moving it elsewhere.
+
+If per-thread listeners are disabled (see `set_tcp_listener_reuse_port()`) or the
+kernel doesn't support SO_REUSEPORT, it uses a single socket on the thread that
+created it instead, and `is_per_thread()` returns false.
+
+It has to be created and destroyed in a coroutine. */
+class linux_reuseport_tcp_listener_t : public home_thread_mixin_t {
+public:
+    linux_reuseport_tcp_listener_t(const std::set<ip_address_t> &bind_addresses, int port,
+        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback,
+        int num_threads) THROWS_ONLY(address_in_use_exc_t, tcp_socket_exc_t);
+    ~linux_reuseport_tcp_listener_t();
+
+    int get_port() const;
+    bool is_per_thread() const;
+
+    /* Whether a listener for `num_threads` threads that is created now will listen
+    on each of them. */
+    static bool listens_per_thread(int num_threads);
+
+private:
+    // Returns the exception that starting the listener threw, if any.
+    std::exception_ptr start_listener(int thread, int listen_port,
+        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback);
+    void stop_listener(int thread);
+
+    std::set<ip_address_t> local_addresses;
+    int port;
+
+    // Indexed by thread. Only the first one is used if `!is_per_thread()`.
+    scoped_array_t<scoped_ptr_t<linux_nonthrowing_tcp_listener_t> > listeners;
+    bool per_thread;
+
+    DISABLE_COPYING(linux_reuseport_tcp_listener_t);
+};
+
+/* Whether `linux_reuseport_tcp_listener_t`s should listen on every thread. This is
+off by default, since SO_REUSEPORT also lets other processes of the same user listen
+on our ports. Call it before any listeners are created. */
+void set_tcp_listener_reuse_port(bool reuse_port);
+
 /* Like a linux tcp listener but repeatedly tries to bind to its port until successful */
 class linux_repeated_nonthrowing_tcp_listener_t {
 public:
@@ -2,12 +2,14 @@
 #define ARCH_RUNTIME_CALLABLE_ACTION_HPP_
 
 #include "errors.hpp"
+#include "arch/runtime/small_object_allocator.hpp"
 
 /* The below classes may be used to create a generic callable object without
   boost::function so as to avoid the heap allocation that boost::functions use.
   Allocate a callable_action_wrapper_t (preferrably on the stack), then assign
   any callable object into it.  The wrapper will only use the heap if it can't
-  fit inside the internal pre-allocated buffer. */
+  fit inside the internal pre-allocated buffer, and then it takes the memory from
+  the small object allocator. */
 
 #define CALLABLE_CUTOFF_SIZE 128
 
@@ -21,7 +23,9 @@ private:
 };
 
 template<class Callable>
-class callable_action_instance_t : public callable_action_t {
+class callable_action_instance_t
+    : public callable_action_t,
+      public small_object_allocated_t<small_object_kind_t::coro_action> {
 public:
     explicit callable_action_instance_t(const Callable& callable) : callable_(callable) { }
 
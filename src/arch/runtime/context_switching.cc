@@ -39,9 +39,13 @@ bool artificial_stack_context_ref_t::is_nil() {
 }
 
 artificial_stack_t::artificial_stack_t(void (*initial_fun)(void), size_t _stack_size)
-    : stack_size(_stack_size) {
-    /* Allocate the stack */
-    stack = malloc_aligned(stack_size, getpagesize());
+    : stack_size(ceil_aligned(_stack_size, getpagesize())) {
+    /* Allocate the stack.  We map it ourselves (instead of using malloc) so that
+    the kernel only commits the pages that the coroutine actually touches, and so
+    that the memory goes straight back to the kernel when the stack is destroyed. */
+    stack = mmap(NULL, stack_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    guarantee_err(stack != MAP_FAILED, "Could not allocate a coroutine stack");
 
     /* Protect the end of the stack so that we crash when we get a stack
     overflow instead of corrupting memory. */
@@ -135,11 +139,50 @@ artificial_stack_t::~artificial_stack_t() {
 #endif
 #endif
 
-    /* Undo protections changes */
-    mprotect(stack, getpagesize(), PROT_READ | PROT_WRITE);
+    /* Release the stack we allocated (including its protection page) */
+    const int res = munmap(stack, stack_size);
+    guarantee_err(res == 0, "Could not unmap a coroutine stack");
+}
+
+// Where the pages that the stack's switched out context may still use start.
+static uintptr_t lowest_live_stack_page(void *stack_pointer) {
+    // The x86-64 ABI lets functions use up to 128 bytes below the stack pointer
+    // (the "red zone").  We leave a bit more than that alone.
+    const uintptr_t margin = 256;
+    return floor_aligned(reinterpret_cast<uintptr_t>(stack_pointer) - margin,
+                         getpagesize());
+}
 
-    /* Release the stack we allocated */
-    free(stack);
+void artificial_stack_t::release_unused_memory() {
+    rassert(!context.is_nil());
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(stack) + getpagesize();
+    const uintptr_t end = lowest_live_stack_page(context.pointer);
+    if (end > begin) {
+        const int res = madvise(reinterpret_cast<void *>(begin), end - begin,
+                                MADV_DONTNEED);
+        guarantee_err(res == 0, "Could not release coroutine stack memory");
+    }
+}
+
+size_t artificial_stack_t::get_used_size() {
+    rassert(!context.is_nil());
+    const size_t page_size = getpagesize();
+    const size_t num_pages = stack_size / page_size;
+    scoped_array_t<unsigned char> resident(num_pages);
+#ifdef __linux__
+    const int res = mincore(stack, stack_size, resident.data());
+#else
+    const int res = mincore(stack, stack_size, reinterpret_cast<char *>(resident.data()));
+#endif
+    guarantee_err(res == 0, "mincore failed on a coroutine stack");
+    // The stack grows down, so the lowest page that is in memory tells us how
+    // deep it went.  (The guard page never is.)
+    for (size_t i = 1; i < num_pages; ++i) {
+        if ((resident[i] & 1) != 0) {
+            return (num_pages - i) * page_size;
+        }
+    }
+    return 0;
 }
 
 bool artificial_stack_t::address_in_stack(void *addr) {
@@ -65,6 +65,14 @@ public:
     /* Returns the end of the stack */
     void *get_stack_bound() { return stack; }
 
+    /* The stack is mapped straight from the kernel, so its pages only take up memory
+    once they have been used.  While the stack's context is switched out (so that
+    `context` isn't nil), `release_unused_memory()` gives the pages below the stack
+    pointer back to the kernel, and `get_used_size()` returns how much of the stack
+    has been used since it was created or since they were last given back. */
+    void release_unused_memory();
+    size_t get_used_size();
+
 private:
     void *stack;
     size_t stack_size;
@@ -174,6 +182,10 @@ public:
     /* Returns the end of the stack */
     void *get_stack_bound();
 
+    // The stack belongs to a pthread, so we don't know how much of it is used.
+    void release_unused_memory() { }
+    size_t get_used_size() { return 0; }
+
 private:
     static void *internal_run(void *p);
     void get_stack_addr_size(void **stackaddr_out, size_t *stacksize_out);
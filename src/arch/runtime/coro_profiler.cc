@@ -1,8 +1,9 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "arch/runtime/coro_profiler.hpp"
 
-#ifdef ENABLE_CORO_PROFILER
+#include <inttypes.h>
 
+#include <functional>
 #include <string>
 #include <vector>
 #include <sstream>
@@ -22,7 +23,14 @@ coro_profiler_t &coro_profiler_t::get_global_profiler() {
     return profiler;
 }
 
-coro_profiler_t::coro_profiler_t() {
+#ifdef ENABLE_CORO_PROFILER
+volatile bool coro_profiler_t::enabled = true;
+#else
+volatile bool coro_profiler_t::enabled = false;
+#endif
+
+coro_profiler_t::coro_profiler_t() : write_reports(false), generation(0) {
+#ifdef ENABLE_CORO_PROFILER
     logINF("Coro profiler activated.");
 
     const std::string reql_output_filename = "coro_profiler_out.py";
@@ -30,24 +38,74 @@ coro_profiler_t::coro_profiler_t() {
     if (reql_output_file.is_open()) {
         logINF("Writing profiler reports to '%s'", reql_output_filename.c_str());
         write_reql_header();
+        write_reports = true;
     } else {
         logWRN("Could not open '%s' for writing profiler reports.", reql_output_filename.c_str());
     }
+#endif
+}
+
+void coro_profiler_t::enable() {
+    {
+        std::vector<scoped_ptr_t<spinlock_acq_t> > thread_locks;
+        for (auto thread_samples = per_thread_samples.begin();
+             thread_samples != per_thread_samples.end();
+             ++thread_samples) {
+            thread_locks.push_back(
+                scoped_ptr_t<spinlock_acq_t>(new spinlock_acq_t(&thread_samples->value.spinlock)));
+        }
+        reset_samples();
+    }
+    if (!enabled) {
+        logINF("Coro profiler enabled.");
+    }
+    enabled = true;
+}
+
+void coro_profiler_t::disable() {
+    if (enabled) {
+        logINF("Coro profiler disabled.");
+    }
+    enabled = false;
+}
+
+void coro_profiler_t::reset_samples() {
+    ++generation;
+    for (auto thread_samples = per_thread_samples.begin();
+         thread_samples != per_thread_samples.end();
+         ++thread_samples) {
+        thread_samples->value.per_execution_point_samples.clear();
+    }
 }
 
 void coro_profiler_t::record_sample(size_t levels_to_strip_from_backtrace) {
+    record_sample_internal(levels_to_strip_from_backtrace + 1, false);
+}
+
+void coro_profiler_t::record_sample_internal(size_t levels_to_strip_from_backtrace,
+                                             bool waiting) {
     if (coro_t::self() == NULL) return;
 
     const ticks_t ticks_on_entry = get_ticks();
 
     coro_profiler_mixin_t &coro_mixin = static_cast<coro_profiler_mixin_t&>(*coro_t::self());
     bool might_have_to_generate_report = false;
-    per_thread_samples_t &thread_samples = per_thread_samples[get_thread_id().threadnum].value;
+    const int thread = get_thread_id().threadnum;
+    per_thread_samples_t &thread_samples = per_thread_samples[thread].value;
     {
         const spinlock_acq_t thread_lock(&thread_samples.spinlock);
 
+        if (coro_mixin.profiler_generation != generation) {
+            // The coroutine resumed before the profiler was enabled (or reset), so we
+            // only count from here.
+            coro_mixin.profiler_generation = generation;
+            coro_mixin.last_resumed_at = ticks_on_entry;
+            coro_mixin.last_sample_at = ticks_on_entry;
+        }
+
         // See if we might have to generate a report
-        if (thread_samples.ticks_at_last_report + CORO_PROFILER_REPORTING_INTERVAL <= ticks_on_entry) {
+        if (write_reports
+            && thread_samples.ticks_at_last_report + CORO_PROFILER_REPORTING_INTERVAL <= ticks_on_entry) {
             // There is a chance that we have to generate a report (unless another
             // thread is already at it). Let's first release the lock on thread_samples
             // before we actually check for that though. That way we can be sure
@@ -73,10 +131,20 @@ void coro_profiler_t::record_sample(size_t levels_to_strip_from_backtrace) {
         rassert(coro_mixin.last_resumed_at <= ticks_on_entry);
         rassert(coro_mixin.last_resumed_at > 0);
         ticks_t ticks_since_resume = ticks_on_entry - coro_mixin.last_resumed_at;
-        execution_point_samples.samples.push_back(coro_sample_t(ticks_since_resume,
-                                                                ticks_since_previous,
-                                                                coro_t::self()->get_priority()));
+        if (write_reports) {
+            execution_point_samples.samples.push_back(coro_sample_t(ticks_since_resume,
+                                                                    ticks_since_previous,
+                                                                    coro_t::self()->get_priority()));
+        }
+        execution_point_samples.running_ticks += ticks_since_previous;
         coro_mixin.last_sample_at = ticks_on_entry;
+
+        if (waiting) {
+            coro_mixin.wait_point = &execution_point_samples;
+            coro_mixin.wait_thread = thread;
+        } else {
+            coro_mixin.wait_point = NULL;
+        }
     }
 
     if (might_have_to_generate_report) {
@@ -100,6 +168,7 @@ void coro_profiler_t::record_sample(size_t levels_to_strip_from_backtrace) {
     const ticks_t clock_skew = ticks_on_exit - ticks_on_entry;
     coro_mixin.last_resumed_at += clock_skew;
     coro_mixin.last_sample_at += clock_skew;
+    coro_mixin.waiting_since = ticks_on_exit;
 }
 
 void coro_profiler_t::record_coro_resume() {
@@ -108,6 +177,17 @@ void coro_profiler_t::record_coro_resume() {
     const ticks_t ticks = get_ticks();
 
     coro_profiler_mixin_t &coro_mixin = static_cast<coro_profiler_mixin_t&>(*coro_t::self());
+    if (coro_mixin.wait_point != NULL) {
+        // The coroutine might have waited on another thread.
+        per_thread_samples_t &wait_thread_samples =
+            per_thread_samples[coro_mixin.wait_thread].value;
+        const spinlock_acq_t thread_lock(&wait_thread_samples.spinlock);
+        if (coro_mixin.profiler_generation == generation) {
+            static_cast<per_execution_point_samples_t *>(coro_mixin.wait_point)->waiting_ticks
+                += ticks - coro_mixin.waiting_since;
+        }
+        coro_mixin.wait_point = NULL;
+    }
     coro_mixin.last_sample_at = ticks;
     coro_mixin.last_resumed_at = ticks;
 }
@@ -115,7 +195,111 @@ void coro_profiler_t::record_coro_resume() {
 void coro_profiler_t::record_coro_yield(size_t levels_to_strip_from_backtrace) {
     rassert(coro_t::self());
 
-    record_sample(1 + levels_to_strip_from_backtrace);
+    record_sample_internal(1 + levels_to_strip_from_backtrace, false);
+}
+
+void coro_profiler_t::record_coro_wait(size_t levels_to_strip_from_backtrace) {
+    rassert(coro_t::self());
+
+    record_sample_internal(1 + levels_to_strip_from_backtrace, true);
+}
+
+void coro_profiler_t::get_totals(
+        std::map<coro_execution_point_key_t, std::pair<ticks_t, ticks_t> > *totals) {
+    const spinlock_acq_t report_interval_lock(&report_interval_spinlock);
+    {
+        std::vector<scoped_ptr_t<spinlock_acq_t> > thread_locks;
+        for (auto thread_samples = per_thread_samples.begin();
+             thread_samples != per_thread_samples.end();
+             ++thread_samples) {
+            thread_locks.push_back(
+                scoped_ptr_t<spinlock_acq_t>(new spinlock_acq_t(&thread_samples->value.spinlock)));
+        }
+
+        for (auto thread_samples = per_thread_samples.begin();
+             thread_samples != per_thread_samples.end();
+             ++thread_samples) {
+            for (auto execution_point_samples = thread_samples->value.per_execution_point_samples.begin();
+                 execution_point_samples != thread_samples->value.per_execution_point_samples.end();
+                 ++execution_point_samples) {
+                std::pair<ticks_t, ticks_t> *total = &(*totals)[execution_point_samples->first];
+                total->first += execution_point_samples->second.running_ticks;
+                total->second += execution_point_samples->second.waiting_ticks;
+            }
+        }
+    }
+}
+
+std::string coro_profiler_t::get_folded_stacks() {
+    std::map<coro_execution_point_key_t, std::pair<ticks_t, ticks_t> > totals;
+    get_totals(&totals);
+
+    // Symbolizing is slow, so we do it without holding up the threads.
+    std::string out;
+    for (auto it = totals.begin(); it != totals.end(); ++it) {
+        std::string stack;
+        if (it->first.first != "?") {
+            stack = it->first.first;
+            std::replace(stack.begin(), stack.end(), ';', ',');
+            std::replace(stack.begin(), stack.end(), '\n', ' ');
+        }
+        for (size_t i = CORO_PROFILER_BACKTRACE_DEPTH; i-- > 0; ) {
+            if (it->first.second[i] != NULL) {
+                if (!stack.empty()) {
+                    stack += ";";
+                }
+                stack += get_frame_name(it->first.second[i]);
+            }
+        }
+        if (stack.empty()) {
+            stack = "?";
+        }
+
+        const uint64_t running_us = it->second.first / THOUSAND;
+        const uint64_t waiting_us = it->second.second / THOUSAND;
+        if (running_us > 0) {
+            out += strprintf("%s %" PRIu64 "\n", stack.c_str(), running_us);
+        }
+        if (waiting_us > 0) {
+            out += strprintf("%s;[waiting] %" PRIu64 "\n", stack.c_str(), waiting_us);
+        }
+    }
+    return out;
+}
+
+std::string coro_profiler_t::get_top_coroutine_types(size_t n) {
+    std::map<coro_execution_point_key_t, std::pair<ticks_t, ticks_t> > totals;
+    get_totals(&totals);
+
+    std::map<std::string, ticks_t> running_ticks_by_type;
+    for (auto it = totals.begin(); it != totals.end(); ++it) {
+        std::string type = it->first.first;
+        if (type == "?") {
+            // Release builds don't know coroutines' types, so we go by the outermost
+            // frame that we have.
+            for (size_t i = CORO_PROFILER_BACKTRACE_DEPTH; i-- > 0; ) {
+                if (it->first.second[i] != NULL) {
+                    type = get_frame_name(it->first.second[i]);
+                    break;
+                }
+            }
+        }
+        running_ticks_by_type[type] += it->second.first;
+    }
+
+    std::vector<std::pair<ticks_t, std::string> > sorted;
+    for (auto it = running_ticks_by_type.begin(); it != running_ticks_by_type.end(); ++it) {
+        sorted.push_back(std::make_pair(it->second, it->first));
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              std::greater<std::pair<ticks_t, std::string> >());
+
+    std::string out;
+    for (size_t i = 0; i < sorted.size() && i < n; ++i) {
+        const uint64_t running_us = sorted[i].first / THOUSAND;
+        out += strprintf("%" PRIu64 " %s\n", running_us, sorted[i].second.c_str());
+    }
+    return out;
 }
 
 coro_profiler_t::coro_execution_point_key_t coro_profiler_t::get_current_execution_point(
@@ -378,4 +562,26 @@ const std::string &coro_profiler_t::get_frame_description(void *addr) {
         std::pair<void *, std::string>(addr, description_stream.str())).first->second;
 }
 
-#endif /* ENABLE_CORO_PROFILER */
+const std::string &coro_profiler_t::get_frame_name(void *addr) {
+    auto cache_it = frame_name_cache.find(addr);
+    if (cache_it != frame_name_cache.end()) {
+        return cache_it->second;
+    }
+
+    backtrace_frame_t frame(addr);
+    frame.initialize_symbols();
+    std::string name;
+    try {
+        name = frame.get_demangled_name();
+    } catch (const demangle_failed_exc_t &e) {
+        name = frame.get_name();
+    }
+    if (name.empty()) {
+        name = strprintf("%p", addr);
+    }
+    // Folded stacks use ';' between frames and nothing that we write has newlines.
+    std::replace(name.begin(), name.end(), ';', ',');
+    std::replace(name.begin(), name.end(), '\n', ' ');
+
+    return frame_name_cache.insert(std::make_pair(addr, name)).first->second;
+}
@@ -2,9 +2,6 @@
 #ifndef ARCH_RUNTIME_CORO_PROFILER_HPP_
 #define	ARCH_RUNTIME_CORO_PROFILER_HPP_
 
-
-#ifdef ENABLE_CORO_PROFILER
-
 #include <algorithm>
 #include <array>
 #include <map>
@@ -34,12 +31,15 @@
 
 /*
  * The `coro_profiler_t` collects information about where coroutines spend time.
- * In order to turn it on, `ENABLE_CORO_PROFILER` must be defined at compile time.
+ * It can be turned on and off at runtime with `enable()` and `disable()` (the
+ * admin HTTP server has `/ajax/coro_profiler` for that), or from the start by
+ * defining `ENABLE_CORO_PROFILER` at compile time.  While it is off, the only cost
+ * is a check of `is_enabled()` whenever a coroutine yields or resumes.
  * It will only work reliably in debug mode, even though it can provide some
  * data in release mode as well.
- * You should compile as follows: `make CORO_PROFILING=1 DEBUG=1`
+ * For the start-up mode and its reports, compile as follows: `make CORO_PROFILING=1 DEBUG=1`
  * If you want to use the profiler in release mode, compile with
- * `make CORO_PROFILING=1 SYMBOLS=1 NO_OMIT_FRAME_POINTER=1`
+ * `make SYMBOLS=1 NO_OMIT_FRAME_POINTER=1` (plus `CORO_PROFILING=1` for the reports).
  * Keep in mind though that backtraces can be unreliable in release.
  *
  * The coro profiler records a sample whenever it encounters a `PROFILER_RECORD_SAMPLE`
@@ -60,8 +60,18 @@
  * identify an "execution point". Data is recorded and reported for each such
  * execution point.
  *
- * The aggregated data is written to the file "coro_profiler_out.py" in the working
- * directory. Data is written every `CORO_PROFILER_REPORTING_INTERVAL` ticks.
+ * With `ENABLE_CORO_PROFILER`, the aggregated data is written to the file
+ * "coro_profiler_out.py" in the working directory. Data is written every
+ * `CORO_PROFILER_REPORTING_INTERVAL` ticks.
+ *
+ * In any case, `get_folded_stacks()` gives the time spent at each execution point
+ * since the profiler was enabled in the "folded stacks" format that the flame graph
+ * tools read: one line per stack, the frames from the outermost one in, separated by
+ * ';', and then the microseconds.  `get_top_coroutine_types()` sums up the time
+ * running by coroutine type instead.  The time that a coroutine spends running is
+ * counted at the execution point where it next yields or records a sample, and the
+ * time it spends in `coro_t::wait()` (for example waiting on a `signal_t`) is
+ * counted at the point where it started waiting, under an extra "[waiting]" frame.
  */
 class coro_profiler_t {
 public:
@@ -71,12 +81,25 @@ public:
 
     static coro_profiler_t &get_global_profiler();
 
+    static bool is_enabled() { return enabled; }
+
+    // These can be called from any thread.  `enable()` throws away what has been
+    // recorded so far.
+    void enable();
+    void disable();
+    std::string get_folded_stacks();
+    // The `n` coroutine types that have spent the most time running since the
+    // profiler was enabled, one per line: the microseconds, and then the type.
+    std::string get_top_coroutine_types(size_t n);
+
     void record_sample(size_t levels_to_strip_from_backtrace = 0);
 
     // coroutine execution is resumed
     void record_coro_resume();
     // coroutine execution yields
     void record_coro_yield(size_t levels_to_strip_from_backtrace);
+    // coroutine execution yields until something notifies the coroutine
+    void record_coro_wait(size_t levels_to_strip_from_backtrace);
 
 private:
     typedef std::array<void *, CORO_PROFILER_BACKTRACE_DEPTH> small_trace_t;
@@ -94,9 +117,14 @@ private:
         int priority;
     };
     struct per_execution_point_samples_t {
-        per_execution_point_samples_t() : num_samples_total(0) { }
+        per_execution_point_samples_t()
+            : num_samples_total(0), running_ticks(0), waiting_ticks(0) { }
         int num_samples_total;
+        // Only kept when we write reports.
         std::vector<coro_sample_t> samples;
+        // For `get_folded_stacks()`.
+        ticks_t running_ticks;
+        ticks_t waiting_ticks;
     };
     struct per_thread_samples_t {
         per_thread_samples_t() : ticks_at_last_report(get_ticks()) { }
@@ -135,6 +163,12 @@ private:
         void divide_stddev(data_distribution_t *current_out) const;
     };
 
+    void record_sample_internal(size_t levels_to_strip_from_backtrace, bool waiting);
+    // The time running and waiting at each execution point, summed over the threads.
+    void get_totals(
+        std::map<coro_execution_point_key_t, std::pair<ticks_t, ticks_t> > *totals);
+    // Discards the samples of all threads.  The per-thread spinlocks must be held.
+    void reset_samples();
     void generate_report();
     void print_to_reql(const std::map<coro_execution_point_key_t,
                        per_execution_point_collected_report_t> &execution_point_reports);
@@ -142,6 +176,8 @@ private:
     std::string distribution_to_object_str(const data_distribution_t &distribution);
     std::string trace_to_array_str(const small_trace_t &trace);
     const std::string &get_frame_description(void *addr);
+    // The function name of the frame, in a form that can go in a folded stack.
+    const std::string &get_frame_name(void *addr);
     coro_execution_point_key_t get_current_execution_point(size_t levels_to_strip_from_backtrace);
 
     // Would be nice if we could use one_per_thread here. However
@@ -158,18 +194,30 @@ private:
     spinlock_t report_interval_spinlock;
 
     std::map<void *, std::string> frame_description_cache;
+    std::map<void *, std::string> frame_name_cache;
     address_to_line_t address_to_line;
 
+    // Whether we write reports to `reql_output_file`, which we do with
+    // `ENABLE_CORO_PROFILER`.
+    bool write_reports;
     std::ofstream reql_output_file;
 
+    // Bumped (with all the per-thread spinlocks held) whenever the recorded samples
+    // are thrown away, so that a coroutine notices that what it remembers about its
+    // previous sample is stale.
+    int64_t generation;
+
+    static volatile bool enabled;
+
     DISABLE_COPYING(coro_profiler_t);
 };
 
 // Short-cuts
 //
-// PROFILER_CORO_RESUME and PROFILER_CORO_YIELD are meant to be used in
-// the internal coroutine implementation to notify the profiler about when a coroutine
-// yields and resumes execution respectively.
+// PROFILER_CORO_RESUME, PROFILER_CORO_YIELD and PROFILER_CORO_WAIT are meant to be
+// used in the internal coroutine implementation to notify the profiler about when a
+// coroutine resumes execution, yields, and yields to wait for a notification
+// respectively.
 //
 // PROFILER_RECORD_SAMPLE on the other hand can be used throughout the code to
 // increase the granularity of profiling. By default, the coro profiler collects
@@ -177,17 +225,25 @@ private:
 // PROFILER_RECORD_SAMPLE adds an additional point for data collection in between
 // such yields and can be used to "trace" execution times through different
 // sections of a given piece of code.
-#define PROFILER_RECORD_SAMPLE coro_profiler_t::get_global_profiler().record_sample()
-#define PROFILER_CORO_RESUME coro_profiler_t::get_global_profiler().record_coro_resume()
-#define PROFILER_CORO_YIELD(STRIP_FRAMES) coro_profiler_t::get_global_profiler().record_coro_yield(STRIP_FRAMES)
-
-#else /* ENABLE_CORO_PROFILER */
-
-// Short-cuts (no-ops for disabled coro profiler)
-#define PROFILER_RECORD_SAMPLE do {} while(0)
-#define PROFILER_CORO_RESUME do {} while(0)
-#define PROFILER_CORO_YIELD(STRIP_FRAMES) do {} while(0)
-
-#endif /* not ENABLE_CORO_PROFILER */
+#define PROFILER_RECORD_SAMPLE do { \
+        if (coro_profiler_t::is_enabled()) { \
+            coro_profiler_t::get_global_profiler().record_sample(); \
+        } \
+    } while (0)
+#define PROFILER_CORO_RESUME do { \
+        if (coro_profiler_t::is_enabled()) { \
+            coro_profiler_t::get_global_profiler().record_coro_resume(); \
+        } \
+    } while (0)
+#define PROFILER_CORO_YIELD(STRIP_FRAMES) do { \
+        if (coro_profiler_t::is_enabled()) { \
+            coro_profiler_t::get_global_profiler().record_coro_yield(STRIP_FRAMES); \
+        } \
+    } while (0)
+#define PROFILER_CORO_WAIT(STRIP_FRAMES) do { \
+        if (coro_profiler_t::is_enabled()) { \
+            coro_profiler_t::get_global_profiler().record_coro_wait(STRIP_FRAMES); \
+        } \
+    } while (0)
 
 #endif /* ARCH_RUNTIME_CORO_PROFILER_HPP_ */
@@ -1,10 +1,13 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "arch/runtime/coroutines.hpp"
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 
+#include <algorithm>
 #include <functional>
+#include <vector>
 #ifndef NDEBUG
 #include <map>
 #include <set>
@@ -40,9 +43,24 @@ struct coro_globals_t {
     /* The previous context. */
     coro_t *prev_coro;
 
-    /* A list of coro_t objects that are not in use. */
+    /* A list of coro_t objects that are not in use, the most recently used last. */
     intrusive_list_t<coro_t> free_coros;
 
+    /* When `coro_t::maybe_release_idle_stacks()` last went over `free_coros`. */
+    ticks_t last_idle_stack_check;
+
+    /* The most stack that we have seen a coroutine on this thread use. */
+    size_t stack_high_water_mark;
+
+    /* The number of coroutines that this thread has notified and not run yet. */
+    int64_t ready_coroutines;
+
+    /* The longest that a coroutine waited between being notified and running, in
+    the current and in the previous window of EVENT_LOOP_STATS_WINDOW_MS. */
+    ticks_t lag_window_start;
+    ticks_t max_lag_this_window;
+    ticks_t max_lag_last_window;
+
 #ifndef NDEBUG
 
     /* An integer counting the number of coros on this thread */
@@ -68,6 +86,12 @@ struct coro_globals_t {
     coro_globals_t()
         : current_coro(NULL)
         , prev_coro(NULL)
+        , last_idle_stack_check(get_ticks())
+        , stack_high_water_mark(0)
+        , ready_coroutines(0)
+        , lag_window_start(get_ticks())
+        , max_lag_this_window(0)
+        , max_lag_last_window(0)
 #ifndef NDEBUG
         , coro_count(0)
         , assert_no_coro_waiting_counter(0)
@@ -90,13 +114,117 @@ struct coro_globals_t {
 
 TLS_with_init(coro_globals_t *, cglobals, NULL);
 
+// Starts a new scheduling lag window if the current one is over.
+static void update_lag_window(ticks_t now) {
+    coro_globals_t *globals = TLS_get_cglobals();
+    const ticks_t window_length = EVENT_LOOP_STATS_WINDOW_MS * MILLION;
+    if (now - globals->lag_window_start >= window_length) {
+        // A window with nothing in it resets the last one too.
+        globals->max_lag_last_window =
+            now - globals->lag_window_start < 2 * window_length
+            ? globals->max_lag_this_window : 0;
+        globals->max_lag_this_window = 0;
+        globals->lag_window_start = now;
+    }
+}
+
 // These must be initialized after TLS_cglobals, because perfmon_multi_membership_t
 // construction depends on coro_t::coroutines_have_been_initialized() which in turn
 // depends on cglobals.
 static perfmon_counter_t pm_active_coroutines, pm_allocated_coroutines;
+
+/* Reports every thread's `coro_globals_t::stack_high_water_mark` (in bytes).  Stacks
+are only measured while their coroutines are unused, so a stack that never is can
+have used a bit more than this says. */
+class coro_stack_high_water_mark_perfmon_t
+    : public perfmon_perthread_t<size_t, std::vector<size_t> > {
+protected:
+    void get_thread_stat(size_t *stat) {
+        *stat = TLS_get_cglobals()->stack_high_water_mark;
+    }
+    std::vector<size_t> combine_stats(const size_t *stats) {
+        return std::vector<size_t>(stats, stats + get_num_threads());
+    }
+    scoped_ptr_t<perfmon_result_t> output_stat(const std::vector<size_t> &stats) {
+        scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
+        for (size_t i = 0; i < stats.size(); ++i) {
+            result->insert(strprintf("thread_%zu", i),
+                           new perfmon_result_t(strprintf("%zu", stats[i])));
+        }
+        return result;
+    }
+};
+
+static coro_stack_high_water_mark_perfmon_t pm_coroutine_stack_high_water_mark;
+
+/* The time from `notify_*()` to the coroutine running, in seconds, over all threads. */
+static perfmon_sampler_t pm_coroutine_scheduling_lag(
+    EVENT_LOOP_STATS_WINDOW_MS * MILLION, true);
+
+struct event_loop_stats_t {
+    double busy_secs;
+    int utilization_permille;
+    size_t pending_messages;
+    int64_t ready_coroutines;
+    ticks_t max_scheduling_lag;
+};
+
+/* Reports how busy each thread's event loop is and how far behind it is: the time it
+has spent handling events (in total, and its share of the time lately), the messages
+and the coroutines that it has yet to get to, and the longest that a coroutine has
+lately waited between being notified and running.  This lives here rather than with
+the thread pool because, like the other coroutine stats, it can't be constructed
+before `cglobals`. */
+class event_loop_perfmon_t
+    : public perfmon_perthread_t<event_loop_stats_t, std::vector<event_loop_stats_t> > {
+protected:
+    void get_thread_stat(event_loop_stats_t *stat) {
+        linux_thread_t *thread = linux_thread_pool_t::get_thread();
+        coro_globals_t *globals = TLS_get_cglobals();
+        update_lag_window(get_ticks());
+        stat->busy_secs = ticks_to_secs(thread->total_busy_ticks());
+        stat->utilization_permille = thread->utilization_permille();
+        stat->pending_messages = thread->message_hub.num_pending_messages();
+        stat->ready_coroutines = globals->ready_coroutines;
+        stat->max_scheduling_lag = std::max(globals->max_lag_this_window,
+                                            globals->max_lag_last_window);
+    }
+    std::vector<event_loop_stats_t> combine_stats(const event_loop_stats_t *stats) {
+        return std::vector<event_loop_stats_t>(stats, stats + get_num_threads());
+    }
+    scoped_ptr_t<perfmon_result_t> output_stat(
+            const std::vector<event_loop_stats_t> &stats) {
+        scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
+        for (size_t i = 0; i < stats.size(); ++i) {
+            perfmon_result_t *thread = perfmon_result_t::alloc_map_result().release();
+            thread->insert("busy_secs",
+                           new perfmon_result_t(strprintf("%.3f", stats[i].busy_secs)));
+            thread->insert("utilization",
+                           new perfmon_result_t(strprintf(
+                               "%.3f", stats[i].utilization_permille / 1000.0)));
+            thread->insert("pending_messages",
+                           new perfmon_result_t(strprintf("%zu",
+                                                          stats[i].pending_messages)));
+            thread->insert("ready_coroutines",
+                           new perfmon_result_t(strprintf("%" PRIi64,
+                                                          stats[i].ready_coroutines)));
+            thread->insert("max_scheduling_lag",
+                           new perfmon_result_t(strprintf(
+                               "%.8f", ticks_to_secs(stats[i].max_scheduling_lag))));
+            result->insert(strprintf("thread_%zu", i), thread);
+        }
+        return result;
+    }
+};
+
+static event_loop_perfmon_t pm_event_loop_threads;
+
 static perfmon_multi_membership_t pm_coroutines_membership(&get_global_perfmon_collection(),
     &pm_active_coroutines, "active_coroutines",
-    &pm_allocated_coroutines, "allocated_coroutines");
+    &pm_allocated_coroutines, "allocated_coroutines",
+    &pm_coroutine_stack_high_water_mark, "coroutine_stack_high_water_mark",
+    &pm_coroutine_scheduling_lag, "coroutine_scheduling_lag",
+    &pm_event_loop_threads, "event_loop_threads");
 
 coro_runtime_t::coro_runtime_t() {
     rassert(!TLS_get_cglobals(), "coro runtime initialized twice on this thread");
@@ -124,9 +252,13 @@ TLS_with_init(int64_t, coro_selfname_counter, 0);
 
 coro_t::coro_t() :
     stack(&coro_t::run, coro_stack_size),
+    free_since_(0),
+    stack_released_(false),
     current_thread_(linux_thread_pool_t::get_thread_id()),
     notified_(false),
-    waiting_(false)
+    waiting_(false),
+    notified_at_(0),
+    counted_as_ready_(false)
 #ifndef NDEBUG
     , selfname_number(get_thread_id().threadnum + MAX_THREADS *
           // The comma here is the comma operator, to implement the semantics
@@ -149,6 +281,8 @@ coro_t::coro_t() :
 }
 
 void coro_t::return_coro_to_free_list(coro_t *coro) {
+    coro->free_since_ = get_ticks();
+    coro->stack_released_ = false;
     TLS_get_cglobals()->free_coros.push_back(coro);
 }
 
@@ -157,10 +291,42 @@ void coro_t::maybe_evict_from_free_list() {
     while (cglobals->free_coros.size() > COROUTINE_FREE_LIST_SIZE) {
         coro_t *coro_to_delete = cglobals->free_coros.tail();
         cglobals->free_coros.remove(coro_to_delete);
+        coro_to_delete->note_stack_usage();
         delete coro_to_delete;
     }
 }
 
+void coro_t::maybe_release_idle_stacks() {
+    coro_globals_t *cglobals = TLS_get_cglobals();
+    const ticks_t now = get_ticks();
+    const ticks_t idle_ticks = COROUTINE_STACK_IDLE_RELEASE_MS * (secs_to_ticks(1) / 1000);
+    if (now - cglobals->last_idle_stack_check < idle_ticks) {
+        return;
+    }
+    cglobals->last_idle_stack_check = now;
+
+    /* Rotating the list once around keeps its order. */
+    for (size_t i = 0, n = cglobals->free_coros.size(); i < n; ++i) {
+        coro_t *coro = cglobals->free_coros.head();
+        cglobals->free_coros.remove(coro);
+        cglobals->free_coros.push_back(coro);
+        if (coro->stack_released_) {
+            continue;
+        }
+        coro->note_stack_usage();
+        if (now - coro->free_since_ >= idle_ticks) {
+            coro->stack.release_unused_memory();
+            coro->stack_released_ = true;
+        }
+    }
+}
+
+void coro_t::note_stack_usage() {
+    coro_globals_t *cglobals = TLS_get_cglobals();
+    cglobals->stack_high_water_mark = std::max(cglobals->stack_high_water_mark,
+                                               stack.get_used_size());
+}
+
 coro_t::~coro_t() {
     /* We never move contexts from one thread to another any more. */
     rassert(get_thread_id() == home_thread());
@@ -246,7 +412,7 @@ void coro_t::wait() {   /* class method */
     rassert(!self()->waiting_);
     self()->waiting_ = true;
 
-    PROFILER_CORO_YIELD(1);
+    PROFILER_CORO_WAIT(1);
     if (TLS_get_cglobals()->prev_coro) {
         context_switch(&self()->stack.context, &TLS_get_cglobals()->prev_coro->stack.context);
     } else {
@@ -313,9 +479,18 @@ void coro_t::notify_now_deprecated() {
 #endif
 }
 
+void coro_t::note_notified() {
+    notified_at_ = get_ticks();
+    counted_as_ready_ = current_thread_ == get_thread_id();
+    if (counted_as_ready_) {
+        ++TLS_get_cglobals()->ready_coroutines;
+    }
+}
+
 void coro_t::notify_sometime() {
     rassert(!notified_);
     notified_ = true;
+    note_notified();
     linux_thread_pool_t::get_thread()->message_hub.store_message_sometime(
         current_thread_,
         this);
@@ -324,6 +499,7 @@ void coro_t::notify_sometime() {
 void coro_t::notify_later_ordered() {
     rassert(!notified_);
     notified_ = true;
+    note_notified();
 
     /* `current_thread` is the thread that the coroutine lives on, which may or may not be the
     same as `get_thread_id()`.  (In a call to move_to_thread, it won't be.) */
@@ -348,6 +524,17 @@ void coro_t::on_thread_switch() {
     rassert(notified_);
     notified_ = false;
 
+    const ticks_t now = get_ticks();
+    const ticks_t lag = now - notified_at_;
+    coro_globals_t *globals = TLS_get_cglobals();
+    if (counted_as_ready_) {
+        --globals->ready_coroutines;
+        counted_as_ready_ = false;
+    }
+    update_lag_window(now);
+    globals->max_lag_this_window = std::max(globals->max_lag_this_window, lag);
+    pm_coroutine_scheduling_lag.record(ticks_to_secs(lag));
+
     /* TODO: When `notify_now_deprecated()` is finally removed, just fold it
     into this function. */
     notify_now_deprecated();
@@ -395,6 +582,9 @@ coro_t * coro_t::get_coro() {
         so we can reclaim the memory. */
         maybe_evict_from_free_list();
     }
+    /* Similarly, this is where we give the memory of stacks that haven't been
+    used in a while back to the kernel. */
+    maybe_release_idle_stacks();
 
     rassert(!coro->intrusive_list_node_t<coro_t>::in_a_list());
 
@@ -24,12 +24,20 @@ threadnum_t get_thread_id();
 struct coro_globals_t;
 
 
+/* What `coro_profiler_t` remembers about a coroutine. */
 struct coro_profiler_mixin_t {
-#ifdef ENABLE_CORO_PROFILER
-    coro_profiler_mixin_t() : last_resumed_at(0), last_sample_at(0) { }
+    coro_profiler_mixin_t()
+        : last_resumed_at(0), last_sample_at(0), profiler_generation(-1),
+          wait_point(NULL), wait_thread(-1), waiting_since(0) { }
     ticks_t last_resumed_at;
     ticks_t last_sample_at;
-#endif
+    // The `coro_profiler_t::generation` that the fields belong to.
+    int64_t profiler_generation;
+    // Where the coroutine started waiting in `coro_t::wait()`, if it is waiting; a
+    // `coro_profiler_t::per_execution_point_samples_t` of thread `wait_thread`.
+    void *wait_point;
+    int wait_thread;
+    ticks_t waiting_since;
 };
 
 
@@ -189,6 +197,11 @@ private:
 
     static void return_coro_to_free_list(coro_t *coro);
     static void maybe_evict_from_free_list();
+    static void maybe_release_idle_stacks();
+    // Records how much of our stack we have used in the thread's high-water mark.
+    void note_stack_usage();
+    // For the scheduling lag and ready coroutine stats.
+    void note_notified();
 
     static void run() NORETURN;
 
@@ -199,6 +212,10 @@ private:
     virtual void on_thread_switch();
 
     coro_stack_t stack;
+    // While the coroutine is on the free list: when it was put there, and whether
+    // its stack's unused memory has been given back to the kernel since.
+    ticks_t free_since_;
+    bool stack_released_;
 
     threadnum_t current_thread_;
 
@@ -206,6 +223,11 @@ private:
     bool notified_;
     bool waiting_;
 
+    // When the coroutine was last notified, for the scheduling lag stats, and whether
+    // it counts as ready on its thread (it doesn't if another thread notified it).
+    ticks_t notified_at_;
+    bool counted_as_ready_;
+
     callable_action_wrapper_t action_wrapper;
 
 #ifndef NDEBUG
@@ -15,6 +15,17 @@ perfmon_duration_sampler_t *pm_eventloop_singleton_t::get() {
     return &pm_eventloop;
 }
 
+static int64_t event_queue_busy_poll_us = 0;
+
+void set_event_queue_busy_poll_us(int64_t us) {
+    rassert(us >= 0);
+    event_queue_busy_poll_us = us;
+}
+
+int64_t get_event_queue_busy_poll_us() {
+    return event_queue_busy_poll_us;
+}
+
 std::string format_poll_event(int event) {
     std::string s;
     if (event & poll_event_in) {
@@ -18,6 +18,14 @@ const int poll_event_rdhup = 16;
 
 std::string format_poll_event(int event);
 
+// For how many microseconds at most an event loop thread that runs out of work keeps
+// polling for new events before it goes to sleep.  This trades CPU time for the
+// latency of waking the thread up.  Zero, the default, means that threads go to sleep
+// right away.  (Only the epoll queue polls.)  This has to be set before the thread
+// pool starts.
+void set_event_queue_busy_poll_us(int64_t us);
+int64_t get_event_queue_busy_poll_us();
+
 // Queue stats (declared here so whichever queue is chosen can access it)
 // This is a singleton initialized on first use.
 // Note that we cannot put it into a static variable since its initialization
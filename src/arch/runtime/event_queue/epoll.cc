@@ -14,6 +14,7 @@
 #include <string>
 
 #include "config/args.hpp"
+#include "time.hpp"
 #include "utils.hpp"
 #include "arch/runtime/event_queue.hpp"
 #include "arch/runtime/thread_pool.hpp"
@@ -46,20 +47,49 @@ int epoll_to_user(int mode) {
 }
 
 epoll_event_queue_t::epoll_event_queue_t(linux_queue_parent_t *_parent)
-    : parent(_parent) {
+    : parent(_parent),
+      max_busy_poll_nanos(get_event_queue_busy_poll_us() * THOUSAND),
+      average_wait_nanos(max_busy_poll_nanos / 2) {
     // Create a poll fd
 
     epoll_fd = epoll_create1(0);
     guarantee_err(epoll_fd >= 0, "Could not create epoll fd");
 }
 
+int epoll_event_queue_t::wait_for_events() {
+    if (max_busy_poll_nanos == 0) {
+        return epoll_wait(epoll_fd, events, MAX_IO_EVENT_PROCESSING_BATCH_SIZE, -1);
+    }
+
+    const int64_t start = get_ticks();
+    const int64_t busy_poll_nanos = average_wait_nanos <= max_busy_poll_nanos
+        ? std::min(max_busy_poll_nanos, 2 * average_wait_nanos)
+        : 0;
+
+    int res = 0;
+    if (busy_poll_nanos > 0) {
+        do {
+            res = epoll_wait(epoll_fd, events, MAX_IO_EVENT_PROCESSING_BATCH_SIZE, 0);
+        } while (res == 0 && static_cast<int64_t>(get_ticks()) - start < busy_poll_nanos);
+    }
+    if (res == 0) {
+        res = epoll_wait(epoll_fd, events, MAX_IO_EVENT_PROCESSING_BATCH_SIZE, -1);
+    }
+
+    const int64_t waited = static_cast<int64_t>(get_ticks()) - start;
+    average_wait_nanos += (waited - average_wait_nanos) / 8;
+    return res;
+}
+
 void epoll_event_queue_t::run() {
     int res;
 
     // Now, start the loop
     while (!parent->should_shut_down()) {
         // Grab the events from the kernel!
-        res = epoll_wait(epoll_fd, events, MAX_IO_EVENT_PROCESSING_BATCH_SIZE, -1);
+        parent->on_wait_begin();
+        res = wait_for_events();
+        parent->on_wait_end();
 
         // epoll_wait might return with EINTR in some cases (in
         // particular under GDB), we just need to retry.
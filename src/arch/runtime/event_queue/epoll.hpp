@@ -26,10 +26,20 @@ public:
     void forget_resource(fd_t resource, linux_event_callback_t *cb);
 
 private:
+    // Waits for events and puts them in `events`, busy-polling first if we do that.
+    int wait_for_events();
+
     linux_queue_parent_t *parent;
 
     fd_t epoll_fd;
 
+    // How long we may busy-poll, from `get_event_queue_busy_poll_us()`, and the
+    // moving average of how long we've had to wait for events.  We busy-poll for
+    // twice that average, up to the maximum, so that we only spin when events tend
+    // to show up while we do.
+    const int64_t max_busy_poll_nanos;
+    int64_t average_wait_nanos;
+
     // We store this as a class member because forget_resource needs
     // to go through the events and remove queued messages for
     // resources that are being destroyed.
@@ -15,6 +15,10 @@ struct linux_event_callback_t {
 struct linux_queue_parent_t {
     virtual void pump() = 0;
     virtual bool should_shut_down() = 0;
+    // Called right before and after the queue waits for events, so the parent can
+    // tell how busy the queue is.
+    virtual void on_wait_begin() { }
+    virtual void on_wait_end() { }
     virtual ~linux_queue_parent_t() {}
 };
 
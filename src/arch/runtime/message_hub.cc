@@ -20,7 +20,8 @@ linux_message_hub_t::linux_message_hub_t(linux_event_queue_t *queue,
                                          threadnum_t current_thread)
     : queue_(queue),
       thread_pool_(thread_pool),
-      is_woken_up_(false),
+      is_woken_up_(0),
+      incoming_head_(NULL),
       current_thread_(current_thread) {
 
 #ifndef NDEBUG
@@ -44,7 +45,7 @@ linux_message_hub_t::~linux_message_hub_t() {
         guarantee(get_priority_msg_list(p).empty());
     }
 
-    guarantee(incoming_messages_.empty());
+    guarantee(incoming_head_ == NULL);
 }
 
 void linux_message_hub_t::do_store_message(threadnum_t nthread, linux_thread_message_t *msg) {
@@ -91,19 +92,44 @@ void linux_message_hub_t::store_message_sometime(threadnum_t nthread, linux_thre
 
 
 void linux_message_hub_t::insert_external_message(linux_thread_message_t *msg) {
-    bool do_wake_up;
-    {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        do_wake_up = !check_and_set_is_woken_up();
-        incoming_messages_.push_back(msg);
-    }
+    msg_list_t msgs;
+    msgs.push_back(msg);
 
     // Wakey wakey eggs and bakey
-    if (do_wake_up) {
+    if (push_incoming_messages(&msgs)) {
         event_.wakey_wakey();
     }
 }
 
+bool linux_message_hub_t::push_incoming_messages(msg_list_t *msgs) {
+    rassert(!msgs->empty());
+
+    // Link the messages up newest first, like the stack.
+    linux_thread_message_t *const oldest = msgs->head();
+    linux_thread_message_t *newest = NULL;
+    while (linux_thread_message_t *m = msgs->head()) {
+        msgs->remove(m);
+        m->incoming_next_ = newest;
+        newest = m;
+    }
+
+    linux_thread_message_t *head = incoming_head_;
+    for (;;) {
+        oldest->incoming_next_ = head;
+        linux_thread_message_t *const prev_head
+            = __sync_val_compare_and_swap(&incoming_head_, head, newest);
+        if (prev_head == head) {
+            break;
+        }
+        head = prev_head;
+    }
+
+    // The compare-and-swap is a full barrier, so either we see that our home thread
+    // has cleared is_woken_up_, or it sees our messages when it checks the incoming
+    // stack after clearing it.
+    return !check_and_set_is_woken_up();
+}
+
 linux_message_hub_t::msg_list_t &linux_message_hub_t::get_priority_msg_list(int priority) {
     rassert(priority >= MESSAGE_SCHEDULER_MIN_PRIORITY);
     rassert(priority <= MESSAGE_SCHEDULER_MAX_PRIORITY);
@@ -168,38 +194,45 @@ void linux_message_hub_t::on_event(int events) {
         }
     }
 
-    // We might have left some messages unprocessed.
+    // Until now, other threads haven't woken us up, because we were going to look at
+    // the incoming stack again anyway.  From now on they have to.
+    __sync_fetch_and_and(&is_woken_up_, 0);
+
+    // We might have left some messages unprocessed, or more might have come in.
     // Check if that is the case, and if yes, make sure we are called again.
-    for (int i = 0; i < NUM_SCHEDULER_PRIORITIES; ++i) {
-        if (!priority_msg_lists_[i].empty()) {
-            // Place wakey_wakey and then yield to the event processing.
-            // It will wake us up again immediately, but can handle a few
-            // OS events (such as timers, network messages etc.) in the meantime.
-            bool do_wake_up;
-            {
-                spinlock_acq_t acq(&incoming_messages_lock_);
-                do_wake_up = !check_and_set_is_woken_up();
-            }
-            if (do_wake_up) {
-                event_.wakey_wakey();
-            }
-            break;
+    bool more_messages = __sync_fetch_and_add(&incoming_head_, 0) != NULL;
+    for (int i = 0; i < NUM_SCHEDULER_PRIORITIES && !more_messages; ++i) {
+        more_messages = !priority_msg_lists_[i].empty();
+    }
+    if (more_messages) {
+        // Place wakey_wakey and then yield to the event processing.
+        // It will wake us up again immediately, but can handle a few
+        // OS events (such as timers, network messages etc.) in the meantime.
+        if (!check_and_set_is_woken_up()) {
+            event_.wakey_wakey();
         }
     }
 }
 
-void linux_message_hub_t::sort_incoming_messages_by_priority() {
-    // We do this in two steps to release the spinlock faster.
-    // append_and_clear is a very cheap operation, while
-    // assigning each message to a different priority queue
-    // is more expensive.
+size_t linux_message_hub_t::num_pending_messages() const {
+    size_t ret = 0;
+    for (int i = 0; i < NUM_SCHEDULER_PRIORITIES; ++i) {
+        ret += priority_msg_lists_[i].size();
+    }
+    return ret;
+}
 
-    // 1. Pull the messages
+void linux_message_hub_t::sort_incoming_messages_by_priority() {
+    // 1. Pull the messages.  We take the whole incoming stack, and reverse it so
+    // that the oldest message comes first.  (We leave is_woken_up_ set until
+    // on_event is done, so that nobody wakes us up while we're busy anyway.)
     msg_list_t new_messages;
-    {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        new_messages.append_and_clear(&incoming_messages_);
-        is_woken_up_ = false;
+    linux_thread_message_t *m = __sync_lock_test_and_set(&incoming_head_, NULL);
+    while (m != NULL) {
+        linux_thread_message_t *const next = m->incoming_next_;
+        m->incoming_next_ = NULL;
+        new_messages.push_front(m);
+        m = next;
     }
 
     // 2. Sort the messages into their respective priority queues
@@ -219,9 +252,8 @@ void linux_message_hub_t::sort_incoming_messages_by_priority() {
 }
 
 bool linux_message_hub_t::check_and_set_is_woken_up() {
-    const bool was_woken_up = is_woken_up_;
-    is_woken_up_ = true;
-    return was_woken_up;
+    // This is a full barrier (see push_incoming_messages and on_event).
+    return __sync_fetch_and_or(&is_woken_up_, 1) != 0;
 }
 
 // Pushes messages collected locally global lists available to all
@@ -232,23 +264,12 @@ void linux_message_hub_t::push_messages() {
         // message list.
         thread_queue_t *queue = &queues_[i];
         if (!queue->msg_local_list.empty()) {
-            // Transfer messages to the other core
-
-            bool do_wake_up;
-            {
-                spinlock_acq_t acq(&thread_pool_->threads[i]->message_hub.incoming_messages_lock_);
-
-                // We only need to do a wake up if we're the first people to do a
-                // wake up.
-                do_wake_up =
-                    !thread_pool_->threads[i]->message_hub.check_and_set_is_woken_up();
-
-                thread_pool_->threads[i]->message_hub.incoming_messages_.append_and_clear(&queue->msg_local_list);
-            }
-
-            // Wakey wakey, perhaps eggs and bakey
-            if (do_wake_up) {
-                thread_pool_->threads[i]->message_hub.event_.wakey_wakey();
+            // Transfer messages to the other core.  We only need to do a wake up if
+            // we're the first people to do a wake up.
+            linux_message_hub_t *other_hub = &thread_pool_->threads[i]->message_hub;
+            if (other_hub->push_incoming_messages(&queue->msg_local_list)) {
+                // Wakey wakey, perhaps eggs and bakey
+                other_hub->event_.wakey_wakey();
             }
         }
     }
@@ -8,7 +8,6 @@
 #include "arch/runtime/event_queue.hpp"
 #include "arch/runtime/runtime_utils.hpp"
 #include "arch/runtime/system_event.hpp"
-#include "arch/spinlock.hpp"
 #include "config/args.hpp"
 #include "containers/intrusive_list.hpp"
 #include "threading.hpp"
@@ -24,7 +23,15 @@ class linux_thread_pool_t;
 /* There is one message hub per thread, NOT one message hub for the entire program.
 
 Each message hub stores messages that are going from that message hub's home thread to
-other threads. It keeps a separate queue for messages destined for each other thread. */
+other threads. It keeps a separate queue for messages destined for each other thread.
+
+The messages that other threads send to a message hub's home thread go onto its
+incoming stack, which is lock-free: any thread can push a batch of messages with one
+compare-and-swap, and the home thread takes all of them at once with an atomic exchange
+(and then reverses them, so that the messages from any one thread stay in order).
+Only the first thread to push while the home thread isn't looking writes the
+eventfd; as long as the home thread is busy handling messages, it checks the stack
+again before it goes back to sleep instead. */
 
 class linux_message_hub_t : private linux_event_callback_t {
 public:
@@ -49,6 +56,10 @@ public:
     // (which does not have an event queue)
     void insert_external_message(linux_thread_message_t *msg);
 
+    // The number of messages that have been sorted by priority but haven't been
+    // processed yet.  Must be called on the hub's thread.
+    size_t num_pending_messages() const;
+
     ~linux_message_hub_t();
 
 private:
@@ -56,10 +67,14 @@ private:
     // debug mode.
     void do_store_message(threadnum_t nthread, linux_thread_message_t *msg);
 
-    // Moves messages from incoming_messages_ into the respective entries of
+    // Moves messages from the incoming stack into the respective entries of
     // priority_msg_lists, depending on the messages' priorities.
     void sort_incoming_messages_by_priority();
 
+    // Pushes `msgs` (in order) onto the incoming stack and empties `msgs`.  Can be
+    // called on any thread.  Returns true if the caller has to wake us up.
+    MUST_USE bool push_incoming_messages(msg_list_t *msgs);
+
     msg_list_t &get_priority_msg_list(int priority);
 
     linux_event_queue_t *const queue_;
@@ -69,16 +84,20 @@ private:
     struct thread_queue_t {
         //TODO this doesn't need to be a class anymore
 
-        /* Messages are cached here before being pushed to the global list so that we don't
-        have to acquire the spinlock as often */
+        /* Messages are cached here before being pushed to the other thread's incoming
+        stack, so that we push them in batches */
         msg_list_t msg_local_list;
     } queues_[MAX_THREADS];
 
-    // Must only be used with acquired incoming_messages_lock_
+    // Returns false (and sets is_woken_up_) if nobody has written the eventfd
+    // since we last cleared is_woken_up_.  Can be called on any thread.
     bool check_and_set_is_woken_up();
-    bool is_woken_up_;
-    msg_list_t incoming_messages_;
-    spinlock_t incoming_messages_lock_;
+    // 1 while we have been woken up, or are handling messages, and will look at the
+    // incoming stack again without another wakeup.  Only accessed atomically.
+    int is_woken_up_;
+    // The newest message on the incoming stack (see above), or NULL.  The messages
+    // are linked through their incoming_next_ fields.  Only accessed atomically.
+    linux_thread_message_t *incoming_head_;
 
     // Use `sort_incoming_messages_by_priority()` to sort incoming_messages_ into
     // these lists.
@@ -91,7 +110,7 @@ private:
     void on_event(int events);
 
     // The eventfd (or pipe-based alternative) notified after the first incoming
-    // message is put onto incoming_messages_.
+    // message is put onto the incoming stack.
     system_event_t event_;
 
     /* The thread that we queue messages originating from. (Recall that there is one
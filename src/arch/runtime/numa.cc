@@ -0,0 +1,278 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/runtime/numa.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+#ifdef __linux
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "arch/runtime/runtime_utils.hpp"
+#include "errors.hpp"
+#include "utils.hpp"
+
+// Parses the kernel's list format, for example "0-3,8-11", as far as it can.  Sets
+// `*ok_out` (if it isn't NULL) to whether all of `list` was well-formed.
+static std::vector<int> parse_cpu_or_node_list(const std::string &list,
+                                               bool *ok_out = NULL) {
+    // Way more than there are CPUs, which keeps a typo from making a huge list.
+    const long max_id = 1 << 16;
+
+    std::vector<int> ret;
+    bool ok = false;
+    const char *p = list.c_str();
+    while (*p != '\0' && *p != '\n') {
+        char *end;
+        const long first = strtol(p, &end, 10);
+        if (end == p || first < 0 || first >= max_id) {
+            break;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            ++p;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first || last >= max_id) {
+                break;
+            }
+            p = end;
+        }
+        for (long i = first; i <= last; ++i) {
+            ret.push_back(i);
+        }
+        if (*p == ',') {
+            ++p;
+        } else {
+            ok = (*p == '\0' || *p == '\n');
+            break;
+        }
+    }
+    if (ok_out != NULL) {
+        *ok_out = ok;
+    }
+    return ret;
+}
+
+class numa_topology_t {
+public:
+    numa_topology_t() {
+        std::vector<int> nodes;
+        std::string online;
+        if (blocking_read_file("/sys/devices/system/node/online", &online)) {
+            nodes = parse_cpu_or_node_list(online);
+        }
+
+        // The CPUs of each node with CPUs.
+        std::vector<std::vector<int> > cpus_by_node;
+        std::vector<int> nodes_with_cpus;
+        for (auto it = nodes.begin(); it != nodes.end(); ++it) {
+            std::string cpulist;
+            if (!blocking_read_file(strprintf("/sys/devices/system/node/node%d/cpulist",
+                                              *it).c_str(),
+                                    &cpulist)) {
+                continue;
+            }
+            std::vector<int> cpus = parse_cpu_or_node_list(cpulist);
+            if (!cpus.empty()) {
+                cpus_by_node.push_back(std::move(cpus));
+                nodes_with_cpus.push_back(*it);
+            }
+        }
+
+        if (cpus_by_node.empty()) {
+            // No NUMA support, so we pretend there's one node.
+            std::vector<int> cpus;
+            for (int i = 0, e = get_cpu_count(); i < e; ++i) {
+                cpus.push_back(i);
+            }
+            cpus_by_node.push_back(std::move(cpus));
+            nodes_with_cpus.push_back(0);
+        }
+
+        num_nodes_ = cpus_by_node.size();
+
+        // Interleave the nodes' CPUs: the first CPU of each node, then the second
+        // CPU of each node, and so on.
+        for (size_t i = 0; cpu_order_.size() < total_size(cpus_by_node); ++i) {
+            for (size_t n = 0; n < cpus_by_node.size(); ++n) {
+                if (i < cpus_by_node[n].size()) {
+                    const int cpu = cpus_by_node[n][i];
+                    cpu_order_.push_back(cpu);
+                    if (node_by_cpu_.size() <= static_cast<size_t>(cpu)) {
+                        node_by_cpu_.resize(cpu + 1, nodes_with_cpus[0]);
+                    }
+                    node_by_cpu_[cpu] = nodes_with_cpus[n];
+                }
+            }
+        }
+    }
+
+    int num_nodes() const { return num_nodes_; }
+
+    // The CPUs in the order that threads get pinned to them by default.
+    const std::vector<int> &cpu_order() const { return cpu_order_; }
+
+    int node_for_cpu(int cpu) const {
+        if (cpu < 0 || static_cast<size_t>(cpu) >= node_by_cpu_.size()) {
+            return node_by_cpu_.empty() ? 0 : node_by_cpu_[0];
+        }
+        return node_by_cpu_[cpu];
+    }
+
+private:
+    static size_t total_size(const std::vector<std::vector<int> > &vecs) {
+        size_t ret = 0;
+        for (auto it = vecs.begin(); it != vecs.end(); ++it) {
+            ret += it->size();
+        }
+        return ret;
+    }
+
+    int num_nodes_;
+    std::vector<int> cpu_order_;
+    std::vector<int> node_by_cpu_;
+
+    DISABLE_COPYING(numa_topology_t);
+};
+
+static const numa_topology_t &get_numa_topology() {
+    static const numa_topology_t topology;
+    return topology;
+}
+
+int get_numa_node_count() {
+    return get_numa_topology().num_nodes();
+}
+
+// What `configure_cpu_affinity()` was given.
+static std::vector<int> configured_event_loop_cpus;
+static std::vector<int> configured_blocker_cpus;
+
+int get_cpu_for_thread(int thread_id) {
+    rassert(thread_id >= 0);
+    if (!configured_event_loop_cpus.empty()) {
+        return configured_event_loop_cpus[thread_id % configured_event_loop_cpus.size()];
+    }
+
+    const std::vector<int> &order = get_numa_topology().cpu_order();
+    if (!configured_blocker_cpus.empty()) {
+        std::vector<int> remaining;
+        for (auto it = order.begin(); it != order.end(); ++it) {
+            if (std::find(configured_blocker_cpus.begin(), configured_blocker_cpus.end(),
+                          *it) == configured_blocker_cpus.end()) {
+                remaining.push_back(*it);
+            }
+        }
+        // If the blocker CPUs are all of them, the event loops have to share.
+        if (!remaining.empty()) {
+            return remaining[thread_id % remaining.size()];
+        }
+    }
+    return order[thread_id % order.size()];
+}
+
+int get_numa_node_for_thread(int thread_id) {
+    return get_numa_topology().node_for_cpu(get_cpu_for_thread(thread_id));
+}
+
+bool parse_cpu_list(const std::string &list, std::vector<int> *cpus_out) {
+    bool ok;
+    std::vector<int> cpus = parse_cpu_or_node_list(list, &ok);
+    if (!ok || cpus.empty()) {
+        return false;
+    }
+#ifdef __linux
+    // We can't pin anything to CPUs that the process isn't allowed on.
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    const int res = sched_getaffinity(0, sizeof(allowed), &allowed);
+    guarantee_err(res == 0, "Could not get the process's CPU affinity");
+    for (auto it = cpus.begin(); it != cpus.end(); ++it) {
+        if (*it >= CPU_SETSIZE || !CPU_ISSET(*it, &allowed)) {
+            return false;
+        }
+    }
+#endif
+    *cpus_out = std::move(cpus);
+    return true;
+}
+
+std::string format_cpu_list(const std::vector<int> &cpus) {
+    std::string ret;
+    for (size_t i = 0; i < cpus.size(); ) {
+        // Write runs of consecutive CPUs as ranges.
+        size_t j = i + 1;
+        while (j < cpus.size() && cpus[j] == cpus[j - 1] + 1) {
+            ++j;
+        }
+        if (!ret.empty()) {
+            ret += ",";
+        }
+        ret += j - i > 1
+            ? strprintf("%d-%d", cpus[i], cpus[j - 1])
+            : strprintf("%d", cpus[i]);
+        i = j;
+    }
+    return ret;
+}
+
+void configure_cpu_affinity(const std::vector<int> &event_loop_cpus,
+                            const std::vector<int> &blocker_cpus) {
+    configured_event_loop_cpus = event_loop_cpus;
+    configured_blocker_cpus = blocker_cpus;
+}
+
+bool cpu_affinity_is_configured() {
+    return !configured_event_loop_cpus.empty() || !configured_blocker_cpus.empty();
+}
+
+const std::vector<int> &get_blocker_cpus() {
+    return configured_blocker_cpus;
+}
+
+void apply_blocker_cpu_affinity() {
+#ifdef __linux
+    if (configured_blocker_cpus.empty()) {
+        return;
+    }
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (auto it = configured_blocker_cpus.begin();
+         it != configured_blocker_cpus.end();
+         ++it) {
+        CPU_SET(*it, &mask);
+    }
+    const int res = pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+    guarantee_xerr(res == 0, res, "Could not set the affinity of a blocker thread");
+#endif
+}
+
+int get_current_numa_node() {
+#ifdef __linux
+    return get_numa_topology().node_for_cpu(sched_getcpu());
+#else
+    return get_numa_topology().node_for_cpu(0);
+#endif
+}
+
+void prefer_numa_node_for_memory(UNUSED void *addr, UNUSED size_t size,
+                                 UNUSED int node) {
+#if defined(__linux) && defined(SYS_mbind)
+    const size_t bits_per_word = 8 * sizeof(unsigned long);
+    unsigned long nodemask[1024 / bits_per_word] = { 0 };
+    if (node < 0 || static_cast<size_t>(node) >= 1024) {
+        return;
+    }
+    nodemask[node / bits_per_word] |= 1UL << (node % bits_per_word);
+    // This is only a preference, so we don't care if it fails.
+    UNUSED long res = syscall(SYS_mbind, addr, size, MPOL_PREFERRED, nodemask,
+                              static_cast<unsigned long>(1024), 0);
+#endif
+}
@@ -0,0 +1,63 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_NUMA_HPP_
+#define ARCH_RUNTIME_NUMA_HPP_
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "errors.hpp"
+
+// The machine's NUMA topology, as the kernel reports it in
+// /sys/devices/system/node.  Without NUMA support (or on other platforms) the
+// machine looks like one node that has all the CPUs.  NUMA nodes are identified by
+// the kernel's node numbers.
+
+// How many NUMA nodes have CPUs.
+int get_numa_node_count();
+
+// The CPU that the thread pool pins the thread with the given thread id to, if it
+// pins threads.  Consecutive thread ids are spread across the NUMA nodes, so that
+// thread i and thread i + 1 don't sit on the same node (if there's more than one).
+// With `configure_cpu_affinity()`, the threads go round the configured event loop
+// CPUs instead, or avoid the blocker CPUs.
+int get_cpu_for_thread(int thread_id);
+
+// Parses a list of CPUs in the kernel's format, for example "0-3,8-11".  Returns
+// false if the list is malformed or empty, or has CPUs that we can't run on.
+MUST_USE bool parse_cpu_list(const std::string &list, std::vector<int> *cpus_out);
+
+// Formats a list of CPUs the way `parse_cpu_list()` reads it.
+std::string format_cpu_list(const std::vector<int> &cpus);
+
+// Sets which CPUs the thread pool's event loop threads get pinned to, and which
+// CPUs blocker pool threads and extproc workers get confined to, so that they
+// don't compete with the event loops.  Either list can be empty, which leaves the
+// default for those threads.  This has to be called before the thread pool and the
+// extproc spawner start.
+void configure_cpu_affinity(const std::vector<int> &event_loop_cpus,
+                            const std::vector<int> &blocker_cpus);
+
+// Whether `configure_cpu_affinity()` set any CPUs.
+bool cpu_affinity_is_configured();
+
+// The blocker CPUs that were configured, if any.
+const std::vector<int> &get_blocker_cpus();
+
+// Confines the calling thread (and the threads and processes that it starts later)
+// to the blocker CPUs, if some were configured.
+void apply_blocker_cpu_affinity();
+
+// The NUMA node of get_cpu_for_thread(thread_id).
+int get_numa_node_for_thread(int thread_id);
+
+// The NUMA node of the CPU that the calling thread is running on.
+int get_current_numa_node();
+
+// Asks the kernel to back the (not yet touched) memory in [addr, addr + size) with
+// memory from the given NUMA node, when it has some.  This is only a preference, so
+// it's fine if it fails, which it does on machines without NUMA support.
+void prefer_numa_node_for_memory(void *addr, size_t size, int node);
+
+#endif  // ARCH_RUNTIME_NUMA_HPP_
@@ -5,6 +5,7 @@
 
 #include <functional>
 
+#include "arch/runtime/numa.hpp"
 #include "arch/runtime/starter.hpp"
 #include "arch/runtime/thread_pool.hpp"
 #include "do_on_thread.hpp"
@@ -20,6 +21,12 @@ int get_num_threads() {
     return linux_thread_pool_t::get_thread_pool()->n_threads;
 }
 
+int get_thread_utilization_permille(threadnum_t thread) {
+    assert_good_thread_id(thread);
+    return linux_thread_pool_t::get_thread_pool()->threads[thread.threadnum]
+        ->utilization_permille();
+}
+
 #ifndef NDEBUG
 void assert_good_thread_id(threadnum_t thread) {
     rassert(thread.threadnum >= 0, "(thread = %" PRIi32 ")", thread.threadnum);
@@ -64,7 +71,11 @@ private:
 
 // Runs the action 'fun()' on thread zero.
 void run_in_thread_pool(const std::function<void()> &fun, int worker_threads) {
-    linux_thread_pool_t thread_pool(worker_threads, false);
+    // On NUMA machines, we pin threads to CPUs, so that a thread's memory (like
+    // the buffers of a cache on it) stays on its node.  We also do when we're told
+    // which CPUs to use.
+    linux_thread_pool_t thread_pool(worker_threads,
+                                    get_numa_node_count() > 1 || cpu_affinity_is_configured());
     starter_t starter(&thread_pool, fun);
     thread_pool.run_thread_pool(&starter);
 }
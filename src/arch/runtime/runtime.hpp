@@ -11,6 +11,10 @@ threadnum_t get_thread_id();
 
 int get_num_threads();
 
+// The share of its time, in thousandths, that `thread`'s event loop has spent handling
+// events rather than waiting for them lately.
+int get_thread_utilization_permille(threadnum_t thread);
+
 #ifndef NDEBUG
 void assert_good_thread_id(threadnum_t thread);
 #else
@@ -0,0 +1,353 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/runtime/small_object_allocator.hpp"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+#include "arch/spinlock.hpp"
+#include "config/args.hpp"
+#include "perfmon/perfmon.hpp"
+#include "thread_local.hpp"
+#include "time.hpp"
+#include "utils.hpp"
+
+#define NUM_SMALL_OBJECT_SIZE_CLASSES (SMALL_OBJECT_MAX_SIZE / SMALL_OBJECT_GRANULARITY)
+
+// Chunks start this far into their slab, after the slab's header.
+#define SMALL_OBJECT_SLAB_HEADER_SIZE 64
+
+const char *const small_object_kind_names[NUM_SMALL_OBJECT_KINDS] = {
+    "coro_actions",
+    "thread_messages",
+    "signal_subscriptions",
+    "semaphore_acquirers",
+    "mailbox_buffers"
+};
+
+class small_object_heap_t;
+
+struct small_object_free_chunk_t {
+    small_object_free_chunk_t *next;
+};
+
+// Sits at the start of every slab, which is aligned to SMALL_OBJECT_SLAB_SIZE, so
+// that a chunk's slab header can be found by rounding down its address.
+struct small_object_slab_header_t {
+    small_object_heap_t *owner;
+    size_t size_class;
+};
+
+// The counters are only ever written by the thread using the heap, but the stats
+// read them from other threads.
+struct small_object_kind_stats_t {
+    small_object_kind_stats_t() : allocations(0), frees(0) { }
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> frees;
+};
+
+class small_object_heap_t {
+public:
+    small_object_heap_t()
+        : next_heap(NULL), next_orphan(NULL),
+          remote_frees_(NULL), slabs_(0), remote_frees_count_(0) {
+        for (size_t i = 0; i < NUM_SMALL_OBJECT_SIZE_CLASSES; ++i) {
+            free_lists_[i] = NULL;
+        }
+    }
+
+    void *allocate(size_t size_class) {
+        small_object_free_chunk_t *chunk = free_lists_[size_class];
+        if (chunk == NULL) {
+            take_remote_frees();
+            chunk = free_lists_[size_class];
+            if (chunk == NULL) {
+                add_slab(size_class);
+                chunk = free_lists_[size_class];
+            }
+        }
+        free_lists_[size_class] = chunk->next;
+        return chunk;
+    }
+
+    // Called on the thread using this heap.
+    void free_local(void *ptr, size_t size_class) {
+        small_object_free_chunk_t *chunk = static_cast<small_object_free_chunk_t *>(ptr);
+        chunk->next = free_lists_[size_class];
+        free_lists_[size_class] = chunk;
+    }
+
+    // Called on any thread.
+    void free_remote(void *ptr) {
+        small_object_free_chunk_t *chunk = static_cast<small_object_free_chunk_t *>(ptr);
+        small_object_free_chunk_t *head = remote_frees_.load(std::memory_order_relaxed);
+        do {
+            chunk->next = head;
+        } while (!remote_frees_.compare_exchange_weak(head, chunk,
+                                                      std::memory_order_release,
+                                                      std::memory_order_relaxed));
+    }
+
+    small_object_kind_stats_t *kind_stats(small_object_kind_t kind) {
+        return &kind_stats_[static_cast<size_t>(kind)];
+    }
+
+    void count_remote_free() {
+        remote_frees_count_.store(remote_frees_count_.load(std::memory_order_relaxed) + 1,
+                                  std::memory_order_relaxed);
+    }
+
+    static small_object_slab_header_t *slab_header(void *chunk) {
+        return reinterpret_cast<small_object_slab_header_t *>(
+            reinterpret_cast<uintptr_t>(chunk)
+            & ~static_cast<uintptr_t>(SMALL_OBJECT_SLAB_SIZE - 1));
+    }
+
+    uint64_t slabs() const { return slabs_.load(std::memory_order_relaxed); }
+    uint64_t remote_frees_count() const {
+        return remote_frees_count_.load(std::memory_order_relaxed);
+    }
+
+    // Both protected by the global heap list's lock.
+    small_object_heap_t *next_heap;
+    small_object_heap_t *next_orphan;
+
+private:
+    // Moves the chunks that other threads freed back onto our free lists.  The whole
+    // stack is taken at once, so there's no ABA problem.
+    void take_remote_frees() {
+        small_object_free_chunk_t *chunk
+            = remote_frees_.exchange(NULL, std::memory_order_acquire);
+        while (chunk != NULL) {
+            small_object_free_chunk_t *next = chunk->next;
+            const small_object_slab_header_t *header = slab_header(chunk);
+            rassert(header->owner == this);
+            free_local(chunk, header->size_class);
+            chunk = next;
+        }
+    }
+
+    void add_slab(size_t size_class) {
+        char *slab = static_cast<char *>(malloc_aligned(SMALL_OBJECT_SLAB_SIZE,
+                                                        SMALL_OBJECT_SLAB_SIZE));
+        small_object_slab_header_t *header
+            = reinterpret_cast<small_object_slab_header_t *>(slab);
+        header->owner = this;
+        header->size_class = size_class;
+
+        const size_t chunk_size = (size_class + 1) * SMALL_OBJECT_GRANULARITY;
+        // Push the chunks in reverse so that they get handed out in address order.
+        size_t offset = SMALL_OBJECT_SLAB_HEADER_SIZE
+            + (SMALL_OBJECT_SLAB_SIZE - SMALL_OBJECT_SLAB_HEADER_SIZE) / chunk_size
+            * chunk_size;
+        while (offset > SMALL_OBJECT_SLAB_HEADER_SIZE) {
+            offset -= chunk_size;
+            free_local(slab + offset, size_class);
+        }
+        slabs_.store(slabs_.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+    }
+
+    small_object_free_chunk_t *free_lists_[NUM_SMALL_OBJECT_SIZE_CLASSES];
+    std::atomic<small_object_free_chunk_t *> remote_frees_;
+
+    small_object_kind_stats_t kind_stats_[NUM_SMALL_OBJECT_KINDS];
+    std::atomic<uint64_t> slabs_;
+    std::atomic<uint64_t> remote_frees_count_;
+
+    DISABLE_COPYING(small_object_heap_t);
+};
+
+// Every heap that was ever made, and the ones no thread is using.  Heaps are never
+// destroyed, because their chunks can be freed at any time, even by static
+// destructors.
+class small_object_heap_list_t {
+public:
+    small_object_heap_list_t() : heaps(NULL), orphans(NULL) { }
+
+    small_object_heap_t *acquire() {
+        spinlock_acq_t acq(&lock);
+        if (orphans != NULL) {
+            small_object_heap_t *heap = orphans;
+            orphans = heap->next_orphan;
+            heap->next_orphan = NULL;
+            return heap;
+        }
+        small_object_heap_t *heap = new small_object_heap_t;
+        heap->next_heap = heaps;
+        heaps = heap;
+        return heap;
+    }
+
+    void release(small_object_heap_t *heap) {
+        spinlock_acq_t acq(&lock);
+        heap->next_orphan = orphans;
+        orphans = heap;
+    }
+
+    template <class callable_t>
+    void visit(const callable_t &callable) {
+        spinlock_acq_t acq(&lock);
+        for (small_object_heap_t *heap = heaps; heap != NULL; heap = heap->next_heap) {
+            callable(heap);
+        }
+    }
+
+private:
+    spinlock_t lock;
+    small_object_heap_t *heaps;
+    small_object_heap_t *orphans;
+
+    DISABLE_COPYING(small_object_heap_list_t);
+};
+
+static small_object_heap_list_t *get_small_object_heap_list() {
+    static small_object_heap_list_t *list = new small_object_heap_list_t;
+    return list;
+}
+
+TLS_with_init(small_object_heap_t *, small_object_heap, NULL);
+
+static small_object_heap_t *get_small_object_heap() {
+    small_object_heap_t *heap = TLS_get_small_object_heap();
+    if (heap == NULL) {
+        heap = get_small_object_heap_list()->acquire();
+        TLS_set_small_object_heap(heap);
+    }
+    return heap;
+}
+
+static void count(std::atomic<uint64_t> *counter) {
+    counter->store(counter->load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+}
+
+void *allocate_small_object(size_t size, small_object_kind_t kind) {
+    small_object_heap_t *heap = get_small_object_heap();
+    count(&heap->kind_stats(kind)->allocations);
+    if (size > SMALL_OBJECT_MAX_SIZE || size == 0) {
+        return ::operator new(size);
+    }
+    return heap->allocate((size - 1) / SMALL_OBJECT_GRANULARITY);
+}
+
+void free_small_object(void *ptr, size_t size, small_object_kind_t kind) {
+    if (ptr == NULL) {
+        return;
+    }
+    small_object_heap_t *heap = get_small_object_heap();
+    count(&heap->kind_stats(kind)->frees);
+    if (size > SMALL_OBJECT_MAX_SIZE || size == 0) {
+        ::operator delete(ptr);
+        return;
+    }
+    small_object_slab_header_t *header = small_object_heap_t::slab_header(ptr);
+    rassert(header->size_class == (size - 1) / SMALL_OBJECT_GRANULARITY);
+    if (header->owner == heap) {
+        heap->free_local(ptr, header->size_class);
+    } else {
+        heap->count_remote_free();
+        header->owner->free_remote(ptr);
+    }
+}
+
+void release_small_object_heap() {
+    small_object_heap_t *heap = TLS_get_small_object_heap();
+    if (heap != NULL) {
+        TLS_set_small_object_heap(NULL);
+        get_small_object_heap_list()->release(heap);
+    }
+}
+
+// Reports each kind's allocations under "small_objects".  The rates are averaged
+// over the time since they were last computed, but at least a second, so that
+// several clients polling the stats don't make them jump around.
+class small_object_perfmon_t : public perfmon_t {
+public:
+    small_object_perfmon_t() : last_ticks(0) {
+        for (size_t i = 0; i < NUM_SMALL_OBJECT_KINDS; ++i) {
+            last_allocations[i] = 0;
+            rates[i] = 0;
+        }
+    }
+
+    void *begin_stats() {
+        return NULL;
+    }
+    void visit_stats(void *) { }
+    scoped_ptr_t<perfmon_result_t> end_stats(void *) {
+        uint64_t allocations[NUM_SMALL_OBJECT_KINDS] = { };
+        uint64_t frees[NUM_SMALL_OBJECT_KINDS] = { };
+        uint64_t slabs = 0;
+        uint64_t remote_frees = 0;
+        get_small_object_heap_list()->visit([&](small_object_heap_t *heap) {
+            for (size_t i = 0; i < NUM_SMALL_OBJECT_KINDS; ++i) {
+                small_object_kind_stats_t *stats
+                    = heap->kind_stats(static_cast<small_object_kind_t>(i));
+                allocations[i] += stats->allocations.load(std::memory_order_relaxed);
+                frees[i] += stats->frees.load(std::memory_order_relaxed);
+            }
+            slabs += heap->slabs();
+            remote_frees += heap->remote_frees_count();
+        });
+
+        double current_rates[NUM_SMALL_OBJECT_KINDS];
+        {
+            spinlock_acq_t acq(&rates_lock);
+            const ticks_t now = get_ticks();
+            const double secs = ticks_to_secs(now - last_ticks);
+            if (last_ticks == 0 || secs >= 1.0) {
+                for (size_t i = 0; i < NUM_SMALL_OBJECT_KINDS; ++i) {
+                    rates[i] = last_ticks == 0
+                        ? 0 : (allocations[i] - last_allocations[i]) / secs;
+                    last_allocations[i] = allocations[i];
+                }
+                last_ticks = now;
+            }
+            for (size_t i = 0; i < NUM_SMALL_OBJECT_KINDS; ++i) {
+                current_rates[i] = rates[i];
+            }
+        }
+
+        scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
+        for (size_t i = 0; i < NUM_SMALL_OBJECT_KINDS; ++i) {
+            scoped_ptr_t<perfmon_result_t> kind_result
+                = perfmon_result_t::alloc_map_result();
+            kind_result->insert("allocations",
+                                new perfmon_result_t(strprintf("%" PRIu64,
+                                                               allocations[i])));
+            kind_result->insert("allocations_per_sec",
+                                new perfmon_result_t(strprintf("%.1f",
+                                                               current_rates[i])));
+            // Frees and allocations are counted on different threads, so the
+            // difference can briefly be off.
+            kind_result->insert("in_use",
+                                new perfmon_result_t(strprintf(
+                                    "%" PRIi64,
+                                    static_cast<int64_t>(allocations[i] - frees[i]))));
+            result->insert(small_object_kind_names[i], kind_result.release());
+        }
+        result->insert("slab_bytes",
+                       new perfmon_result_t(strprintf(
+                           "%" PRIu64,
+                           slabs * static_cast<uint64_t>(SMALL_OBJECT_SLAB_SIZE))));
+        result->insert("remote_frees",
+                       new perfmon_result_t(strprintf("%" PRIu64, remote_frees)));
+        return result;
+    }
+
+private:
+    spinlock_t rates_lock;
+    ticks_t last_ticks;
+    uint64_t last_allocations[NUM_SMALL_OBJECT_KINDS];
+    double rates[NUM_SMALL_OBJECT_KINDS];
+
+    DISABLE_COPYING(small_object_perfmon_t);
+};
+
+static small_object_perfmon_t pm_small_objects;
+static perfmon_membership_t pm_small_objects_membership(
+    &get_global_perfmon_collection(), &pm_small_objects, "small_objects");
@@ -0,0 +1,63 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_SMALL_OBJECT_ALLOCATOR_HPP_
+#define ARCH_RUNTIME_SMALL_OBJECT_ALLOCATOR_HPP_
+
+#include <stddef.h>
+
+/* Coroutine-heavy code makes and frees lots of small objects of a few fixed sizes:
+callable actions that don't fit in a coroutine, thread messages, signal
+subscriptions, semaphore acquirers and the buffers that hold received mailbox
+messages.  Classes opt in by deriving from `small_object_allocated_t`, and then get
+their memory from per-thread free lists instead of malloc.
+
+Each thread carves chunks out of slabs it owns, with one free list per size class
+(SMALL_OBJECT_GRANULARITY bytes apart, up to SMALL_OBJECT_MAX_SIZE; bigger objects,
+which subclasses can be, come from malloc).  A chunk freed on another thread goes
+onto its owner's remote free list, a lock-free stack that the owner takes over the
+next time one of its free lists runs dry, so memory always flows back to the thread
+that allocated it.  Slabs are never returned to the OS.  Allocation counts and rates
+for each kind of object are reported under the "small_objects" stats. */
+
+// What an object is, for the stats.
+enum class small_object_kind_t {
+    coro_action = 0,
+    thread_message,
+    signal_subscription,
+    semaphore_acquirer,
+    mailbox_buffer
+};
+#define NUM_SMALL_OBJECT_KINDS 5
+
+void *allocate_small_object(size_t size, small_object_kind_t kind);
+
+// `size` must be the size that was passed to `allocate_small_object()`.
+void free_small_object(void *ptr, size_t size, small_object_kind_t kind);
+
+// Leaves the current thread's slabs (and the objects still allocated from them) to
+// the next thread that needs some.  Threads of the thread pool call this on their
+// way out.
+void release_small_object_heap();
+
+template <small_object_kind_t kind>
+class small_object_allocated_t {
+public:
+    static void *operator new(size_t size) {
+        return allocate_small_object(size, kind);
+    }
+    static void operator delete(void *ptr, size_t size) {
+        free_small_object(ptr, size, kind);
+    }
+
+    // Declaring the above hides the global placement new, which `object_buffer_t`
+    // and `callable_action_wrapper_t` use.
+    static void *operator new(size_t, void *ptr) {
+        return ptr;
+    }
+    static void operator delete(void *, void *) { }
+
+protected:
+    small_object_allocated_t() { }
+    ~small_object_allocated_t() { }
+};
+
+#endif  // ARCH_RUNTIME_SMALL_OBJECT_ALLOCATOR_HPP_
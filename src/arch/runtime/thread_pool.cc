@@ -11,9 +11,12 @@
 #include "arch/os_signal.hpp"
 #include "arch/io/timer_provider.hpp"
 #include "arch/runtime/event_queue.hpp"
+#include "arch/runtime/numa.hpp"
 #include "arch/runtime/runtime.hpp"
+#include "arch/runtime/small_object_allocator.hpp"
 #include "errors.hpp"
 #include "logger.hpp"
+#include "time.hpp"
 #include "utils.hpp"
 
 const int SEGV_STACK_SIZE = SIGSTKSZ;
@@ -53,6 +56,10 @@ linux_thread_pool_t::linux_thread_pool_t(int worker_threads, bool _do_set_affini
     rassert(n_threads > 1);             // we want at least one non-utility thread
     rassert(n_threads <= MAX_THREADS);
 
+    for (int i = 0; i < MAX_THREADS; ++i) {
+        thread_cpus[i] = -1;
+    }
+
     int res;
 
     res = pthread_cond_init(&shutdown_cond, NULL);
@@ -171,6 +178,9 @@ void *linux_thread_pool_t::start_thread(void *arg) {
         set_thread(NULL);
     }
 
+    // The next thread pool's threads can reuse our slabs.
+    release_small_object_heap();
+
     delete tdata;
     return NULL;
 }
@@ -201,13 +211,15 @@ void linux_thread_pool_t::run_thread_pool(linux_thread_message_t *initial_messag
         if (do_set_affinity) {
             // On Apple, the thread affinity API has awful documentation, so we don't even bother.
 #ifdef _GNU_SOURCE
-            // Distribute threads evenly among CPUs
-            int ncpus = get_cpu_count();
+            // Distribute threads evenly among CPUs, alternating between NUMA
+            // nodes.
             cpu_set_t mask;
             CPU_ZERO(&mask);
-            CPU_SET(i % ncpus, &mask);
+            const int cpu = get_cpu_for_thread(i);
+            CPU_SET(cpu, &mask);
             res = pthread_setaffinity_np(pthreads[i], sizeof(cpu_set_t), &mask);
             guarantee_xerr(res == 0, res, "Could not set thread affinity");
+            thread_cpus[i] = cpu;
 #endif
         }
     }
@@ -377,6 +389,12 @@ linux_thread_t::linux_thread_t(linux_thread_pool_t *parent_pool, int thread_id)
     : queue(this),
       message_hub(&queue, parent_pool, threadnum_t(thread_id)),
       timer_handler(&queue),
+      window_start(get_ticks()),
+      window_busy_ticks(0),
+      busy_since(window_start),
+      busy_ticks_before(0),
+      waiting_since(0),
+      average_utilization_permille(0),
       do_shutdown(false)
 #ifndef NDEBUG
       , coroutine_counts_at_shutdown(NULL)
@@ -407,6 +425,44 @@ void linux_thread_t::pump() {
     message_hub.push_messages();
 }
 
+void linux_thread_t::on_wait_begin() {
+    const ticks_t now = get_ticks();
+    window_busy_ticks += now - busy_since;
+    busy_ticks_before += now - busy_since;
+    waiting_since = now;
+}
+
+void linux_thread_t::on_wait_end() {
+    const ticks_t now = get_ticks();
+    waiting_since = 0;
+    busy_since = now;
+    const ticks_t window_length = now - window_start;
+    if (window_length >= THREAD_UTILIZATION_WINDOW_MS * MILLION) {
+        const int window_utilization =
+            static_cast<int>(window_busy_ticks * THOUSAND / window_length);
+        average_utilization_permille =
+            (average_utilization_permille + window_utilization) / 2;
+        window_start = now;
+        window_busy_ticks = 0;
+    }
+}
+
+int linux_thread_t::utilization_permille() const {
+    // The average is only brought up to date when the event loop wakes up, so it
+    // says nothing about a thread that has been waiting for a whole window.
+    const ticks_t waiting = waiting_since;
+    if (waiting != 0 && get_ticks() - waiting >= THREAD_UTILIZATION_WINDOW_MS * MILLION) {
+        return 0;
+    }
+    return average_utilization_permille;
+}
+
+ticks_t linux_thread_t::total_busy_ticks() const {
+    rassert(this == linux_thread_pool_t::get_thread());
+    // We're running, so the event loop is busy.
+    return busy_ticks_before + (get_ticks() - busy_since);
+}
+
 void linux_thread_t::on_event(int events) {
     // No-op. This is just to make sure that the event queue wakes up
     // so it can shut down.
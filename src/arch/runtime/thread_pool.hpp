@@ -15,6 +15,8 @@
 #include "arch/io/blocker_pool.hpp"
 #include "arch/io/timer_provider.hpp"
 #include "arch/timer.hpp"
+#include "arch/spinlock.hpp"
+#include "time.hpp"
 
 class linux_thread_t;
 class os_signal_cond_t;
@@ -91,6 +93,8 @@ public:
 
     int n_threads;
     bool do_set_affinity;
+    // The CPU that each thread is pinned to, or -1.
+    int thread_cpus[MAX_THREADS];
 
     // Non-inlinable getters and setters for the thread local variables.
     // See thread_local.hpp for an explanation of why these must not be
@@ -170,6 +174,8 @@ public:
 
     void pump();   // Called by the event queue
     bool should_shut_down();   // Called by the event queue
+    void on_wait_begin();   // Called by the event queue
+    void on_wait_end();   // Called by the event queue
 #ifndef NDEBUG
     void initiate_shut_down(std::map<std::string, size_t> *coroutine_counts); // Can be called from any thread
 #else
@@ -177,7 +183,29 @@ public:
 #endif
     void on_event(int events);
 
+    // The share of its time, in thousandths, that the thread's event loop has spent
+    // handling events rather than waiting for them lately.  Can be called from any
+    // thread.
+    int utilization_permille() const;
+
+    // The total time that the thread's event loop has spent handling events.  Must be
+    // called on the thread itself.
+    ticks_t total_busy_ticks() const;
+
 private:
+    // For `utilization_permille()`.  The event loop's busy time in the current
+    // window of THREAD_UTILIZATION_WINDOW_MS, and when it last stopped waiting.
+    ticks_t window_start;
+    ticks_t window_busy_ticks;
+    ticks_t busy_since;
+    // For `total_busy_ticks()`: the busy time up to `busy_since`.
+    ticks_t busy_ticks_before;
+    // When the event loop started waiting, or 0 if it's busy.
+    volatile ticks_t waiting_since;
+    // The average of the past windows' utilization, each weighing half as much as
+    // the one after it.
+    volatile int average_utilization_permille;
+
     volatile bool do_shutdown;
     pthread_mutex_t do_shutdown_mutex;
     system_event_t shutdown_notify_event;
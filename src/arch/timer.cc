@@ -1,22 +1,31 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "arch/timer.hpp"
+
+#include <string.h>
+
+#include <algorithm>
+
 #include "arch/runtime/thread_pool.hpp"
+#include "config/args.hpp"
 #include "time.hpp"
 #include "utils.hpp"
 
-class timer_token_t : public intrusive_priority_queue_node_t<timer_token_t> {
+class timer_token_t : public intrusive_list_node_t<timer_token_t> {
     friend class timer_handler_t;
 
 private:
-    timer_token_t() : interval_nanos(-1), next_time_in_nanos(-1), callback(NULL) { }
-
-    friend bool left_is_higher_priority(const timer_token_t *left, const timer_token_t *right);
+    timer_token_t() : interval_nanos(-1), ring_tick(-1), level(-1), slot(-1), callback(NULL) { }
 
     // The time between rings, if a repeating timer, otherwise zero.
     int64_t interval_nanos;
 
-    // The time of the next 'ring'.
-    int64_t next_time_in_nanos;
+    // The tick of the next 'ring'.
+    int64_t ring_tick;
+
+    // Where the token is in the wheel, if it is in the wheel.  (A `level` of -1 means
+    // that it's in `ringing_tokens` instead.)
+    int level;
+    int slot;
 
     // The callback we call upon each 'ring'.
     timer_callback_t *callback;
@@ -24,48 +33,200 @@ private:
     DISABLE_COPYING(timer_token_t);
 };
 
-bool left_is_higher_priority(const timer_token_t *left, const timer_token_t *right) {
-    return left->next_time_in_nanos < right->next_time_in_nanos;
+static const int64_t timer_wheel_tick_nanos = TIMER_WHEEL_TICK_MS * MILLION;
+
+// The first tick that starts no earlier than `nanos`.
+static int64_t tick_at_or_after(int64_t nanos) {
+    return (nanos + timer_wheel_tick_nanos - 1) / timer_wheel_tick_nanos;
 }
 
 timer_handler_t::timer_handler_t(linux_event_queue_t *queue)
     : timer_provider(queue),
-      expected_oneshot_time_in_nanos(0) {
+      current_tick(get_ticks() / timer_wheel_tick_nanos),
+      scheduled_tick(-1),
+      num_wheel_tokens(0) {
+    for (int i = 0; i < wheel_levels; ++i) {
+        memset(wheel[i].occupied, 0, sizeof(wheel[i].occupied));
+    }
     // Right now, we have no tokens.  So we don't ask the timer provider to do anything for us.
 }
 
 timer_handler_t::~timer_handler_t() {
-    guarantee(token_queue.empty());
+    guarantee(num_wheel_tokens == 0 && ringing_tokens.empty());
+    if (scheduled_tick != -1) {
+        timer_provider.unschedule_oneshot();
+    }
 }
 
-void timer_handler_t::on_oneshot() {
-    // If the timer_provider tends to return its callback a touch early, we don't want to make a
-    // bunch of calls to it, returning a tad early over and over again, leading up to a ticks
-    // threshold.  So we bump the real time up to the threshold when processing the priority queue.
-    int64_t real_ticks = get_ticks();
-    int64_t ticks = std::max(real_ticks, expected_oneshot_time_in_nanos);
-
-    while (!token_queue.empty() && token_queue.peek()->next_time_in_nanos <= ticks) {
-        timer_token_t *token = token_queue.pop();
-
-        // Put the repeating timer back on the queue before the callback can be called (so that it
-        // may be canceled).
-        if (token->interval_nanos != 0) {
-            token->next_time_in_nanos = real_ticks + token->interval_nanos;
-            token_queue.push(token);
+void timer_handler_t::insert(timer_token_t *token) {
+    const int64_t max_delta = (int64_t(1) << (wheel_levels * wheel_level_bits)) - 1;
+
+    // Timers that are further away than the wheel reaches go in the last slot it
+    // reaches, and are put back in from there.
+    const int64_t delta = std::min(std::max<int64_t>(token->ring_tick - current_tick, 0),
+                                   max_delta);
+    const int64_t tick = current_tick + delta;
+
+    int level = 0;
+    while (level + 1 < wheel_levels
+           && delta >= (int64_t(1) << ((level + 1) * wheel_level_bits))) {
+        ++level;
+    }
+    const int slot = (tick >> (level * wheel_level_bits)) & (wheel_slots - 1);
+
+    token->level = level;
+    token->slot = slot;
+    wheel[level].slots[slot].push_back(token);
+    wheel[level].occupied[slot / 64] |= uint64_t(1) << (slot % 64);
+    ++num_wheel_tokens;
+}
+
+void timer_handler_t::remove(timer_token_t *token) {
+    rassert(token->level >= 0);
+    intrusive_list_t<timer_token_t> *list = &wheel[token->level].slots[token->slot];
+    list->remove(token);
+    if (list->empty()) {
+        wheel[token->level].occupied[token->slot / 64] &= ~(uint64_t(1) << (token->slot % 64));
+    }
+    --num_wheel_tokens;
+}
+
+int timer_handler_t::first_occupied_slot(int level, int slot) const {
+    for (int word = slot / 64; word < wheel_slots / 64; ++word) {
+        uint64_t bits = wheel[level].occupied[word];
+        if (word == slot / 64) {
+            bits &= ~uint64_t(0) << (slot % 64);
+        }
+        if (bits != 0) {
+            return word * 64 + __builtin_ctzll(bits);
+        }
+    }
+    return wheel_slots;
+}
+
+void timer_handler_t::cascade() {
+    // The higher levels go first, because their timers can end up in the slot of the
+    // levels below that we're about to move down too.
+    int top = 0;
+    while (top + 1 < wheel_levels
+           && (current_tick & ((int64_t(1) << ((top + 1) * wheel_level_bits)) - 1)) == 0) {
+        ++top;
+    }
+    for (int level = top; level > 0; --level) {
+        const int slot = (current_tick >> (level * wheel_level_bits)) & (wheel_slots - 1);
+        intrusive_list_t<timer_token_t> *list = &wheel[level].slots[slot];
+        while (!list->empty()) {
+            timer_token_t *token = list->head();
+            remove(token);
+            insert(token);
+        }
+    }
+}
+
+void timer_handler_t::ring_slot(int slot, int64_t real_ticks) {
+    intrusive_list_t<timer_token_t> *list = &wheel[0].slots[slot];
+    while (!list->empty()) {
+        timer_token_t *token = list->head();
+        remove(token);
+        token->level = -1;
+        ringing_tokens.push_back(token);
+    }
+
+    while (!ringing_tokens.empty()) {
+        timer_token_t *token = ringing_tokens.head();
+        ringing_tokens.remove(token);
+        const bool once = token->interval_nanos == 0;
+
+        // Put the repeating timer back in the wheel before the callback can be called (so
+        // that it may be canceled).
+        if (!once) {
+            token->ring_tick = tick_at_or_after(real_ticks + token->interval_nanos);
+            insert(token);
         }
 
         token->callback->on_timer();
 
         // Delete nonrepeating timer tokens.
-        if (token->interval_nanos == 0) {
+        if (once) {
             delete token;
         }
     }
+}
+
+int64_t timer_handler_t::next_event_tick() const {
+    rassert(num_wheel_tokens > 0);
+
+    // If we are at the start of a run that we haven't moved down yet, its timers can be
+    // due before anything in the levels below.
+    for (int level = 1; level < wheel_levels; ++level) {
+        const int shift = level * wheel_level_bits;
+        if ((current_tick & ((int64_t(1) << shift) - 1)) != 0) {
+            break;
+        }
+        const int current_slot = (current_tick >> shift) & (wheel_slots - 1);
+        if (!wheel[level].slots[current_slot].empty()) {
+            return current_tick;
+        }
+    }
+
+    for (int level = 0; level < wheel_levels; ++level) {
+        const int shift = level * wheel_level_bits;
+        const int current_slot = (current_tick >> shift) & (wheel_slots - 1);
+        // The current slot of a higher level has already been moved down (or is empty,
+        // from the check above) so it only has timers for the next rotation.
+        const int slot = first_occupied_slot(level, level == 0 ? current_slot : current_slot + 1);
+        if (slot < wheel_slots) {
+            return ((current_tick >> shift) - current_slot + slot) << shift;
+        }
+        if (first_occupied_slot(level, 0) < wheel_slots) {
+            // This level only has timers for its next rotation.
+            return ((current_tick >> (shift + wheel_level_bits)) + 1) << (shift + wheel_level_bits);
+        }
+    }
+    unreachable();
+}
+
+void timer_handler_t::schedule_oneshot_at(int64_t tick) {
+    if (scheduled_tick == -1 || tick < scheduled_tick) {
+        timer_provider.schedule_oneshot(tick * timer_wheel_tick_nanos, this);
+        scheduled_tick = tick;
+    }
+}
+
+void timer_handler_t::on_oneshot() {
+    // If the timer_provider tends to return its callback a touch early, we don't want to make a
+    // bunch of calls to it, returning a tad early over and over again, leading up to a ticks
+    // threshold.  So we bump the real time up to the threshold when processing the wheel.
+    const int64_t real_ticks = get_ticks();
+    const int64_t last_tick = std::max(real_ticks / timer_wheel_tick_nanos, scheduled_tick);
+    scheduled_tick = -1;
+
+    while (current_tick <= last_tick && num_wheel_tokens > 0) {
+        if ((current_tick & (wheel_slots - 1)) == 0) {
+            cascade();
+        }
+
+        // Skip straight to the next timers of this run of level 0, or to the next run.
+        const int current_slot = current_tick & (wheel_slots - 1);
+        const int slot = first_occupied_slot(0, current_slot);
+        const int64_t tick = current_tick - current_slot + slot;
+        if (tick > last_tick) {
+            current_tick = last_tick + 1;
+            break;
+        }
+        if (slot < wheel_slots) {
+            current_tick = tick + 1;
+            ring_slot(slot, real_ticks);
+        } else {
+            // `tick` is the start of the next run, which has to go through `cascade()`.
+            current_tick = tick;
+        }
+    }
+    current_tick = std::max(current_tick, last_tick + 1);
 
     // We've processed young tokens.  Now schedule a new one-shot (if necessary).
-    if (!token_queue.empty()) {
-        timer_provider.schedule_oneshot(token_queue.peek()->next_time_in_nanos, this);
+    if (num_wheel_tokens > 0) {
+        schedule_oneshot_at(next_event_tick());
     }
 }
 
@@ -73,30 +234,33 @@ timer_token_t *timer_handler_t::add_timer_internal(const int64_t ms, timer_callb
     const int64_t nanos = ms * MILLION;
     rassert(nanos > 0);
 
-    const int64_t next_time_in_nanos = get_ticks() + nanos;
+    const int64_t real_ticks = get_ticks();
+    if (num_wheel_tokens == 0) {
+        // There's nothing on the way, so we can catch up without processing anything.
+        current_tick = std::max(current_tick, real_ticks / timer_wheel_tick_nanos);
+    }
 
     timer_token_t *const token = new timer_token_t;
     token->interval_nanos = once ? 0 : nanos;
-    token->next_time_in_nanos = next_time_in_nanos;
+    token->ring_tick = tick_at_or_after(real_ticks + nanos);
     token->callback = callback;
+    insert(token);
 
-    const timer_token_t *top_entry = token_queue.peek();
-    token_queue.push(token);
-
-    if (top_entry == NULL || next_time_in_nanos < top_entry->next_time_in_nanos) {
-        timer_provider.schedule_oneshot(next_time_in_nanos, this);
-    }
+    schedule_oneshot_at(std::max(token->ring_tick, current_tick));
 
     return token;
 }
 
 void timer_handler_t::cancel_timer(timer_token_t *token) {
-    token_queue.remove(token);
+    if (token->level == -1) {
+        ringing_tokens.remove(token);
+    } else {
+        remove(token);
+    }
     delete token;
 
-    if (token_queue.empty()) {
-        timer_provider.unschedule_oneshot();
-    }
+    // We leave the timer provider alone: if it rings for nothing, we just find that
+    // there's nothing to do.
 }
 
 
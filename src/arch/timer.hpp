@@ -2,7 +2,9 @@
 #ifndef ARCH_TIMER_HPP_
 #define ARCH_TIMER_HPP_
 
-#include "containers/intrusive_priority_queue.hpp"
+#include <stdint.h>
+
+#include "containers/intrusive_list.hpp"
 #include "arch/io/timer_provider.hpp"
 
 class timer_token_t;
@@ -14,7 +16,13 @@ struct timer_callback_t {
 
 /* This timer class uses the underlying OS timer provider to get one-shot timing events. It then
  * manages a list of application timers based on that lower level interface. Everyone who needs a
- * timer should use this class (through the thread pool). */
+ * timer should use this class (through the thread pool).
+ *
+ * The timers are kept in a hierarchical timing wheel of `TIMER_WHEEL_TICK_MS` ticks, so adding
+ * and canceling a timer takes constant time.  Level `n` of the wheel has a slot for each of the
+ * next 256 runs of 256^n ticks; a timer sits in the lowest level whose range covers it, and is
+ * moved down a level when its run comes up.  The OS timer is only reprogrammed when a timer is
+ * added that rings before the one it is set for. */
 class timer_handler_t : private timer_provider_callback_t {
 public:
     explicit timer_handler_t(linux_event_queue_t *queue);
@@ -24,17 +32,46 @@ public:
     void cancel_timer(timer_token_t *timer);
 
 private:
+    static const int wheel_levels = 4;
+    static const int wheel_level_bits = 8;
+    static const int wheel_slots = 1 << wheel_level_bits;
+
+    struct wheel_level_t {
+        intrusive_list_t<timer_token_t> slots[wheel_slots];
+        // A bit for every nonempty slot.
+        uint64_t occupied[wheel_slots / 64];
+    };
+
     void on_oneshot();
 
+    void insert(timer_token_t *token);
+    void remove(timer_token_t *token);
+    // Moves the timers in the slots of the runs that start at `current_tick` to the levels below.
+    void cascade();
+    // Rings the timers in `slot` of level 0, which is for the tick `current_tick - 1`.
+    void ring_slot(int slot, int64_t real_ticks);
+    // The first slot of `level` at or after `slot` that has timers, or `wheel_slots`.
+    int first_occupied_slot(int level, int slot) const;
+    // A tick no later than the first one that has something to do.
+    int64_t next_event_tick() const;
+    void schedule_oneshot_at(int64_t tick);
+
     // The timer provider, a platform-dependent typedef for interfacing with the OS.
     timer_provider_t timer_provider;
 
-    // The expected time of the next on_oneshot call.  If the oneshot arrived earlier than this
-    // time, we pretend that it had arrived on time.
-    int64_t expected_oneshot_time_in_nanos;
+    // The first tick that we haven't processed yet.
+    int64_t current_tick;
+
+    // The tick that the timer provider is set to ring on, or -1.  If the oneshot arrives
+    // earlier than this tick, we pretend that it had arrived on time.
+    int64_t scheduled_tick;
+
+    // How many timers are in `wheel`.
+    size_t num_wheel_tokens;
+    wheel_level_t wheel[wheel_levels];
 
-    // A priority queue of timer tokens, ordered by the soonest.
-    intrusive_priority_queue_t<timer_token_t> token_queue;
+    // The timers that are taken out of the wheel to be rung.
+    intrusive_list_t<timer_token_t> ringing_tokens;
 
     DISABLE_COPYING(timer_handler_t);
 };
@@ -15,9 +15,10 @@ address_in_use_exc_t::address_in_use_exc_t(const char* hostname, int port) throw
     }
 }
 
-file_account_t::file_account_t(file_t *par, int pri, int outstanding_requests_limit) :
+file_account_t::file_account_t(file_t *par, int pri, int outstanding_requests_limit,
+                               int deadline_ms) :
     parent(par),
-    account(parent->create_account(pri, outstanding_requests_limit)) { }
+    account(parent->create_account(pri, outstanding_requests_limit, deadline_ms)) { }
 
 file_account_t::~file_account_t() {
     parent->destroy_account(account);
@@ -14,6 +14,8 @@ struct iovec;
 
 #define DEFAULT_DISK_ACCOUNT (static_cast<file_account_t *>(0))
 #define UNLIMITED_OUTSTANDING_REQUESTS (-1)
+// An account with a deadline of `NO_IO_DEADLINE` only gets its share of the disk.
+#define NO_IO_DEADLINE 0
 
 // TODO: Remove this from this header.
 
@@ -90,6 +92,9 @@ typedef linux_tcp_listener_t tcp_listener_t;
 class linux_repeated_nonthrowing_tcp_listener_t;
 typedef linux_repeated_nonthrowing_tcp_listener_t repeated_nonthrowing_tcp_listener_t;
 
+class linux_reuseport_tcp_listener_t;
+typedef linux_reuseport_tcp_listener_t reuseport_tcp_listener_t;
+
 class linux_tcp_conn_descriptor_t;
 typedef linux_tcp_conn_descriptor_t tcp_conn_descriptor_t;
 
@@ -101,6 +106,16 @@ enum class file_direct_io_mode_t {
     buffered_desired
 };
 
+// How the disk manager gets IO requests to the kernel.  `automatic` picks io_uring
+// if the kernel has it, then native AIO (for direct I/O only), then the blocker
+// pool.
+enum class disk_backend_t {
+    automatic,
+    io_uring,
+    native_aio,
+    blocker_pool
+};
+
 
 
 class semantic_checking_file_t {
@@ -138,7 +153,18 @@ public:
     virtual void writev_async(int64_t offset, size_t length, scoped_array_t<iovec> &&bufs,
                               file_account_t *account, linux_iocallback_t *cb) = 0;
 
-    virtual void *create_account(int priority, int outstanding_requests_limit) = 0;
+    /* Tells the file system or device that the contents of the range aren't needed
+    any more (so an SSD needn't keep them around), and waits until that's done.  The
+    range keeps its place in the file; it reads back as zeros or as the old data.
+    Returns 0, or the errno value if the range couldn't be discarded (EOPNOTSUPP if
+    the file system or device can't do that). */
+    virtual MUST_USE int discard(int64_t offset, int64_t length) = 0;
+
+    /* An account's operations get the disk in proportion to its priority.  If the
+    account has a deadline (in milliseconds) and one of its operations has been
+    waiting for longer than that, the operation goes next instead. */
+    virtual void *create_account(int priority, int outstanding_requests_limit,
+                                 int deadline_ms) = 0;
     virtual void destroy_account(void *account) = 0;
 
     virtual bool coop_lock_and_check() = 0;
@@ -149,7 +175,8 @@ private:
 
 class file_account_t {
 public:
-    file_account_t(file_t *f, int p, int outstanding_requests_limit = UNLIMITED_OUTSTANDING_REQUESTS);
+    file_account_t(file_t *f, int p, int outstanding_requests_limit = UNLIMITED_OUTSTANDING_REQUESTS,
+                   int deadline_ms = NO_IO_DEADLINE);
     ~file_account_t();
     void *get_account() { return account; }
 
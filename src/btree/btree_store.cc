@@ -95,6 +95,21 @@ btree_store_t<protocol_t>::~btree_store_t() {
     assert_thread();
 }
 
+template <class protocol_t>
+void btree_store_t<protocol_t>::set_cache_memory_quota(
+        alt_memory_arbiter_t *arbiter,
+        const cache_memory_quota_t &quota) {
+    assert_thread();
+    cache->set_memory_quota(arbiter, quota);
+}
+
+template <class protocol_t>
+void btree_store_t<protocol_t>::enable_cache_warm_up_manifest(
+        const std::string &path) {
+    assert_thread();
+    cache->enable_warm_up_manifest(path);
+}
+
 template <class protocol_t>
 void btree_store_t<protocol_t>::read(
         DEBUG_ONLY(const metainfo_checker_t<protocol_t>& metainfo_checker, )
@@ -194,7 +209,8 @@ void btree_store_t<protocol_t>::receive_backfill(
                                  token_pair,
                                  &txn,
                                  &real_superblock,
-                                 interruptor);
+                                 interruptor,
+                                 semaphore_priority_t::background);
 
     scoped_ptr_t<superblock_t> superblock(real_superblock.release());
     protocol_receive_backfill(btree.get(),
@@ -916,12 +932,13 @@ void btree_store_t<protocol_t>::acquire_superblock_for_write(
         write_token_pair_t *token_pair,
         scoped_ptr_t<txn_t> *txn_out,
         scoped_ptr_t<real_superblock_t> *sb_out,
-        signal_t *interruptor)
+        signal_t *interruptor,
+        semaphore_priority_t throttle_priority)
         THROWS_ONLY(interrupted_exc_t) {
     acquire_superblock_for_write(timestamp,
                                  expected_change_count, durability,
                                  &token_pair->main_write_token, txn_out, sb_out,
-                                 interruptor);
+                                 interruptor, throttle_priority);
 }
 
 template <class protocol_t>
@@ -932,7 +949,8 @@ void btree_store_t<protocol_t>::acquire_superblock_for_write(
         object_buffer_t<fifo_enforcer_sink_t::exit_write_t> *token,
         scoped_ptr_t<txn_t> *txn_out,
         scoped_ptr_t<real_superblock_t> *sb_out,
-        signal_t *interruptor)
+        signal_t *interruptor,
+        semaphore_priority_t throttle_priority)
         THROWS_ONLY(interrupted_exc_t) {
     assert_thread();
 
@@ -941,7 +959,7 @@ void btree_store_t<protocol_t>::acquire_superblock_for_write(
 
     get_btree_superblock_and_txn(general_cache_conn.get(), write_access_t::write,
                                  expected_change_count, timestamp,
-                                 durability, sb_out, txn_out);
+                                 durability, sb_out, txn_out, throttle_priority);
 }
 
 /* store_view_t interface */
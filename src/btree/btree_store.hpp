@@ -18,6 +18,7 @@
 #include "buffer_cache/types.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/mutex.hpp"
+#include "concurrency/new_semaphore.hpp"
 #include "containers/map_sentries.hpp"
 #include "perfmon/perfmon.hpp"
 #include "protocol_api.hpp"
@@ -25,8 +26,10 @@
 
 struct rdb_protocol_t;
 template <class T> class btree_store_t;
+class alt_memory_arbiter_t;
 class btree_slice_t;
 class cache_conn_t;
+class cache_memory_quota_t;
 class cache_t;
 class internal_disk_backed_queue_t;
 class io_backender_t;
@@ -91,6 +94,14 @@ public:
                   const base_path_t &base_path);
     virtual ~btree_store_t();
 
+    // Lets the node's memory arbiter resize this store's cache within the quota.
+    void set_cache_memory_quota(alt_memory_arbiter_t *arbiter,
+                                const cache_memory_quota_t &quota);
+
+    // Makes the store's cache remember its hottest blocks in the file at the given
+    // path, and load them back when the store is opened again.
+    void enable_cache_warm_up_manifest(const std::string &path);
+
     /* store_view_t interface */
     void new_read_token(object_buffer_t<fifo_enforcer_sink_t::exit_read_t> *token_out);
     void new_write_token(object_buffer_t<fifo_enforcer_sink_t::exit_write_t> *token_out);
@@ -329,6 +340,8 @@ public:
             signal_t *interruptor)
             THROWS_ONLY(interrupted_exc_t);
 
+    // Backfilling and building secondary indexes pass
+    // semaphore_priority_t::background.
     void acquire_superblock_for_write(
             repli_timestamp_t timestamp,
             int expected_change_count,
@@ -336,7 +349,8 @@ public:
             write_token_pair_t *token_pair,
             scoped_ptr_t<txn_t> *txn_out,
             scoped_ptr_t<real_superblock_t> *sb_out,
-            signal_t *interruptor)
+            signal_t *interruptor,
+            semaphore_priority_t throttle_priority = semaphore_priority_t::normal)
             THROWS_ONLY(interrupted_exc_t);
 
 private:
@@ -347,7 +361,8 @@ private:
             object_buffer_t<fifo_enforcer_sink_t::exit_write_t> *token,
             scoped_ptr_t<txn_t> *txn_out,
             scoped_ptr_t<real_superblock_t> *sb_out,
-            signal_t *interruptor)
+            signal_t *interruptor,
+            semaphore_priority_t throttle_priority = semaphore_priority_t::normal)
             THROWS_ONLY(interrupted_exc_t);
 
 public:
@@ -9,6 +9,7 @@
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/semaphore.hpp"
 #include "concurrency/fifo_enforcer.hpp"
+#include "concurrency/new_semaphore.hpp"
 
 class incr_decr_t {
 public:
@@ -36,11 +37,14 @@ static const int max_semaphore_capacity = 30;
 class concurrent_traversal_adapter_t : public depth_first_traversal_callback_t {
 public:
 
-    explicit concurrent_traversal_adapter_t(concurrent_traversal_callback_t *cb,
-                                            cond_t *failure_cond)
+    concurrent_traversal_adapter_t(concurrent_traversal_callback_t *cb,
+                                   traversal_order_t order,
+                                   cond_t *failure_cond)
         : semaphore_(concurrent_traversal::initial_semaphore_capacity, 0.5),
+          eval_exclusivity_(1),
           sink_waiters_(0),
           cb_(cb),
+          order_(order),
           failure_cond_(failure_cond) { }
 
     void handle_pair_coro(scoped_key_value_t *fragile_keyvalue,
@@ -53,13 +57,22 @@ public:
 
         semaphore_acq_t semaphore_acq(std::move(*fragile_acq));
 
-        fifo_enforcer_sink_t::exit_write_t exit_write(&sink_, token);
-
         done_traversing_t done;
         try {
-            done = cb_->handle_pair(
-                std::move(keyvalue),
-                concurrent_traversal_fifo_enforcer_signal_t(&exit_write, this));
+            if (order_ == traversal_order_t::KEY_ORDER) {
+                fifo_enforcer_sink_t::exit_write_t exit_write(&sink_, token);
+                done = cb_->handle_pair(
+                    std::move(keyvalue),
+                    concurrent_traversal_fifo_enforcer_signal_t(&exit_write, NULL,
+                                                                this));
+            } else {
+                // Gets in line for `eval_exclusivity_` in `wait_interruptible()`.
+                new_semaphore_acq_t eval_acq;
+                done = cb_->handle_pair(
+                    std::move(keyvalue),
+                    concurrent_traversal_fifo_enforcer_signal_t(NULL, &eval_acq,
+                                                                this));
+            }
         } catch (const interrupted_exc_t &) {
             done = done_traversing_t::YES;
         }
@@ -70,9 +83,12 @@ public:
     }
 
     virtual done_traversing_t handle_pair(scoped_key_value_t &&keyvalue) {
-        // First thing first: Get in line with the token enforcer.
-
-        fifo_enforcer_write_token_t token = source_.enter_write();
+        // First thing first: Get in line with the token enforcer (unless the order
+        // doesn't matter).
+        fifo_enforcer_write_token_t token;
+        if (order_ == traversal_order_t::KEY_ORDER) {
+            token = source_.enter_write();
+        }
         // ... and wait for the semaphore, we don't want too many things loading
         // values at once.
         semaphore_acq_t acq(&semaphore_);
@@ -97,11 +113,17 @@ private:
     fifo_enforcer_source_t source_;
     fifo_enforcer_sink_t sink_;
 
+    // Lets one `handle_pair` call at a time in, in whatever order they ask, for
+    // `traversal_order_t::LOAD_ORDER`.
+    new_semaphore_t eval_exclusivity_;
+
     // The number of coroutines waiting for their turn with sink_.
     size_t sink_waiters_;
 
     concurrent_traversal_callback_t *cb_;
 
+    const traversal_order_t order_;
+
     // Signals when the query has failed, when we should give up all hope in executing
     // the query.
     cond_t *failure_cond_;
@@ -114,9 +136,13 @@ private:
 concurrent_traversal_fifo_enforcer_signal_t::
 concurrent_traversal_fifo_enforcer_signal_t(
         signal_t *eval_exclusivity_signal,
+        new_semaphore_acq_t *eval_exclusivity_acq,
         concurrent_traversal_adapter_t *parent)
     : eval_exclusivity_signal_(eval_exclusivity_signal),
-      parent_(parent) { }
+      eval_exclusivity_acq_(eval_exclusivity_acq),
+      parent_(parent) {
+    rassert((eval_exclusivity_signal_ == NULL) != (eval_exclusivity_acq_ == NULL));
+}
 
 void concurrent_traversal_fifo_enforcer_signal_t::wait_interruptible()
     THROWS_ONLY(interrupted_exc_t) {
@@ -139,16 +165,23 @@ void concurrent_traversal_fifo_enforcer_signal_t::wait_interruptible()
                               parent_->semaphore_.get_capacity() + 1));
     }
 
-    ::wait_interruptible(eval_exclusivity_signal_, parent_->failure_cond_);
+    if (eval_exclusivity_acq_ != NULL) {
+        eval_exclusivity_acq_->init(&parent_->eval_exclusivity_, 1);
+        ::wait_interruptible(eval_exclusivity_acq_->acquisition_signal(),
+                             parent_->failure_cond_);
+    } else {
+        ::wait_interruptible(eval_exclusivity_signal_, parent_->failure_cond_);
+    }
 }
 
 bool btree_concurrent_traversal(superblock_t *superblock, const key_range_t &range,
                                 concurrent_traversal_callback_t *cb,
-                                direction_t direction) {
+                                direction_t direction,
+                                traversal_order_t order) {
     cond_t failure_cond;
     bool failure_seen;
     {
-        concurrent_traversal_adapter_t adapter(cb, &failure_cond);
+        concurrent_traversal_adapter_t adapter(cb, order, &failure_cond);
         failure_seen = !btree_depth_first_traversal(superblock,
                                                     range, &adapter, direction);
     }
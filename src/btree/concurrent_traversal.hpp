@@ -6,6 +6,7 @@
 #include "concurrency/interruptor.hpp"
 
 class concurrent_traversal_adapter_t;
+class new_semaphore_acq_t;
 
 namespace profile { class trace_t; }
 
@@ -16,10 +17,14 @@ public:
 private:
     friend class concurrent_traversal_adapter_t;
 
+    // Exactly one of `eval_exclusivity_signal` (for `traversal_order_t::KEY_ORDER`)
+    // and `eval_exclusivity_acq` (for `traversal_order_t::LOAD_ORDER`) is non-NULL.
     concurrent_traversal_fifo_enforcer_signal_t(signal_t *eval_exclusivity_signal,
+                                                new_semaphore_acq_t *eval_exclusivity_acq,
                                                 concurrent_traversal_adapter_t *parent);
 
     signal_t *const eval_exclusivity_signal_;
+    new_semaphore_acq_t *const eval_exclusivity_acq_;
     concurrent_traversal_adapter_t *const parent_;
 };
 
@@ -44,9 +49,21 @@ private:
     DISABLE_COPYING(concurrent_traversal_callback_t);
 };
 
+// The order in which `handle_pair` calls get their exclusive access.
+enum class traversal_order_t {
+    // The order of the keys.
+    KEY_ORDER,
+    // The order in which they call `wait_interruptible()`, which is usually the
+    // order in which their values finish loading.  Callers that don't care about
+    // the order (because they only aggregate the values) use this so that a value
+    // that takes a random read to load doesn't hold up all the ones behind it.
+    LOAD_ORDER
+};
+
 bool btree_concurrent_traversal(superblock_t *superblock, const key_range_t &range,
                                 concurrent_traversal_callback_t *cb,
-                                direction_t direction);
+                                direction_t direction,
+                                traversal_order_t order);
 
 
 
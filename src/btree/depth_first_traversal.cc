@@ -1,7 +1,11 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "btree/depth_first_traversal.hpp"
 
+#include <algorithm>
+#include <vector>
+
 #include "btree/operations.hpp"
+#include "config/args.hpp"
 #include "rdb_protocol/profile.hpp"
 
 class counted_buf_lock_t : public buf_lock_t,
@@ -94,7 +98,31 @@ bool btree_depth_first_traversal(counted_t<counted_buf_lock_t> block,
             r.decrement();
             end_index = internal_node::get_offset_index(inode, r.btree_key()) + 1;
         }
-        for (int i = 0; i < end_index - start_index; ++i) {
+        const int num_children = end_index - start_index;
+
+        // Once we move on to a second child, we're scanning the children in order, so
+        // we load the next ones ahead of time.  [i, read_ahead_end) are the children
+        // that have been loaded (or requested) already.
+        int read_ahead_end = 1;
+        int read_ahead_window = BTREE_READ_AHEAD_INITIAL_WINDOW;
+
+        for (int i = 0; i < num_children; ++i) {
+            if (i >= 1 && read_ahead_end < num_children
+                && read_ahead_end - i <= read_ahead_window / 2) {
+                const int new_end = std::min(num_children,
+                                             std::max(read_ahead_end, i + 1)
+                                             + read_ahead_window);
+                std::vector<block_id_t> block_ids;
+                for (int j = std::max(read_ahead_end, i + 1); j < new_end; ++j) {
+                    int true_j = (direction == FORWARD ? start_index + j : (end_index - 1) - j);
+                    block_ids.push_back(internal_node::get_pair_by_index(inode, true_j)->lnode);
+                }
+                block->cache()->prefetch_blocks(block_ids, block->txn()->account());
+                read_ahead_end = new_end;
+                read_ahead_window = std::min(read_ahead_window * 2,
+                                             BTREE_READ_AHEAD_MAX_WINDOW);
+            }
+
             int true_index = (direction == FORWARD ? start_index + i : (end_index - 1) - i);
             const btree_internal_pair *pair = internal_node::get_pair_by_index(inode, true_index);
             counted_t<counted_buf_lock_t> lock;
@@ -103,6 +131,9 @@ bool btree_depth_first_traversal(counted_t<counted_buf_lock_t> block,
                 lock = make_counted<counted_buf_lock_t>(block.get(), pair->lnode,
                                                         access_t::read);
             }
+            // We visit each child once, so if we're a snapshot, the child's old
+            // version can go away once we're done with it.
+            block->release_snapshotted_child(pair->lnode);
             if (!btree_depth_first_traversal(std::move(lock),
                                              range, cb, direction)) {
                 return false;
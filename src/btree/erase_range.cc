@@ -3,10 +3,13 @@
 
 #include "buffer_cache/alt/alt.hpp"
 #include "btree/btree_store.hpp"
+#include "btree/internal_node.hpp"
 #include "btree/leaf_node.hpp"
 #include "btree/node.hpp"
+#include "btree/operations.hpp"
 #include "btree/parallel_traversal.hpp"
 #include "btree/slice.hpp"
+#include "btree/subtree_eraser.hpp"
 #include "concurrency/fifo_checker.hpp"
 
 void noop_value_deleter_t::delete_value(buf_parent_t, const void *) const { }
@@ -141,6 +144,158 @@ void btree_erase_range_generic(value_sizer_t<void> *sizer,
                              release_superblock);
 }
 
+// Checks if (x_l_excl, x_r_incl] is a subset of (y_l_excl, y_r_incl].
+static bool range_is_inside(const btree_key_t *x_l_excl, const btree_key_t *x_r_incl,
+                            const btree_key_t *y_l_excl, const btree_key_t *y_r_incl) {
+    return (y_l_excl == NULL || (x_l_excl != NULL && sized_strcmp(y_l_excl->contents, y_l_excl->size, x_l_excl->contents, x_l_excl->size) <= 0))
+        && (y_r_incl == NULL || (x_r_incl != NULL && sized_strcmp(x_r_incl->contents, x_r_incl->size, y_r_incl->contents, y_r_incl->size) <= 0));
+}
+
+struct erase_range_child_t {
+    int index;
+    block_id_t block_id;
+    bool erased_entirely;
+    bool left_unbounded;
+    store_key_t left_exclusive;
+    bool right_unbounded;
+    store_key_t right_inclusive;
+
+    const btree_key_t *left_exclusive_or_null() const {
+        return left_unbounded ? NULL : left_exclusive.btree_key();
+    }
+    const btree_key_t *right_inclusive_or_null() const {
+        return right_unbounded ? NULL : right_inclusive.btree_key();
+    }
+};
+
+// Unlinks and hands to `subtree_eraser` the children of the node in `node_buf`
+// whose key ranges lie inside the erased range, and descends into the children
+// that overlap it.
+static void detach_erased_children(value_sizer_t<void> *sizer, buf_lock_t *node_buf,
+                                   const btree_key_t *node_left_excl,
+                                   const btree_key_t *node_right_incl,
+                                   const btree_key_t *left_exclusive_or_null,
+                                   const btree_key_t *right_inclusive_or_null,
+                                   block_id_t stat_block,
+                                   background_subtree_eraser_t *subtree_eraser) {
+    std::vector<erase_range_child_t> children;
+    std::vector<int> erased_indices;
+    {
+        buf_read_t read(node_buf);
+        const node_t *node = static_cast<const node_t *>(read.get_data_read());
+        if (node::is_leaf(node)) {
+            return;
+        }
+        const internal_node_t *inode = reinterpret_cast<const internal_node_t *>(node);
+
+        int num_erased = 0;
+        for (int i = 0; i < inode->npairs; ++i) {
+            const btree_key_t *l = i == 0
+                ? node_left_excl
+                : &internal_node::get_pair_by_index(inode, i - 1)->key;
+            const btree_key_t *r = i == inode->npairs - 1
+                ? node_right_incl
+                : &internal_node::get_pair_by_index(inode, i)->key;
+            if (!erase_range_helper_t::overlaps(l, r, left_exclusive_or_null,
+                                                right_inclusive_or_null)) {
+                continue;
+            }
+            erase_range_child_t child;
+            child.index = i;
+            child.block_id = internal_node::get_pair_by_index(inode, i)->lnode;
+            child.erased_entirely = range_is_inside(l, r, left_exclusive_or_null,
+                                                    right_inclusive_or_null);
+            child.left_unbounded = l == NULL;
+            if (l != NULL) {
+                child.left_exclusive = store_key_t(l);
+            }
+            child.right_unbounded = r == NULL;
+            if (r != NULL) {
+                child.right_inclusive = store_key_t(r);
+            }
+            num_erased += child.erased_entirely ? 1 : 0;
+            children.push_back(child);
+        }
+
+        // Internal nodes need at least two children, so we might have to keep some
+        // children and erase their contents instead.
+        for (auto it = children.rbegin();
+             it != children.rend() && inode->npairs - num_erased < 2; ++it) {
+            if (it->erased_entirely) {
+                it->erased_entirely = false;
+                --num_erased;
+            }
+        }
+    }
+
+    std::vector<block_id_t> erased_block_ids;
+    for (auto it = children.rbegin(); it != children.rend(); ++it) {
+        if (it->erased_entirely) {
+            erased_indices.push_back(it->index);
+            erased_block_ids.push_back(it->block_id);
+        }
+    }
+    if (!erased_indices.empty()) {
+        buf_write_t write(node_buf);
+        internal_node_t *inode = static_cast<internal_node_t *>(write.get_data_write());
+        // The indices go from right to left, so removing a pair doesn't move the
+        // ones that are still to be removed.
+        for (size_t i = 0; i < erased_indices.size(); ++i) {
+            internal_node::remove_by_index(sizer->block_size(), inode,
+                                           erased_indices[i]);
+        }
+    }
+    for (size_t i = 0; i < erased_block_ids.size(); ++i) {
+        {
+            // Acquiring the child makes the subtree eraser's transactions come
+            // after this one, so the child can't be freed on disk before it's
+            // unlinked.
+            buf_lock_t child(node_buf, erased_block_ids[i], access_t::write);
+        }
+        node_buf->detach_child(erased_block_ids[i]);
+        subtree_eraser->erase_subtree(erased_block_ids[i], stat_block);
+    }
+
+    for (auto it = children.begin(); it != children.end(); ++it) {
+        if (!it->erased_entirely) {
+            buf_lock_t child(node_buf, it->block_id, access_t::write);
+            detach_erased_children(sizer, &child, it->left_exclusive_or_null(),
+                                   it->right_inclusive_or_null(),
+                                   left_exclusive_or_null, right_inclusive_or_null,
+                                   stat_block, subtree_eraser);
+        }
+    }
+}
+
+void btree_detach_erased_subtrees(value_sizer_t<void> *sizer,
+                                  const btree_key_t *left_exclusive_or_null,
+                                  const btree_key_t *right_inclusive_or_null,
+                                  superblock_t *superblock,
+                                  background_subtree_eraser_t *subtree_eraser) {
+    const block_id_t root_id = superblock->get_root_block_id();
+    if (root_id == NULL_BLOCK_ID) {
+        return;
+    }
+    ensure_stat_block(superblock);
+    const block_id_t stat_block = superblock->get_stat_block_id();
+
+    if (left_exclusive_or_null == NULL && right_inclusive_or_null == NULL) {
+        {
+            // See the comment in `detach_erased_children()`.
+            buf_lock_t root(superblock->expose_buf(), root_id, access_t::write);
+        }
+        superblock->expose_buf().detach_child(root_id);
+        superblock->set_root_block_id(NULL_BLOCK_ID);
+        subtree_eraser->erase_subtree(root_id, stat_block);
+        return;
+    }
+
+    buf_lock_t root(superblock->expose_buf(), root_id, access_t::write);
+    detach_erased_children(sizer, &root, NULL, NULL,
+                           left_exclusive_or_null, right_inclusive_or_null,
+                           stat_block, subtree_eraser);
+}
+
 // KSI: Wait, seriously?  Is it actually correct and proper for our
 // partially-completed btree erasure operation to be interrupted?  If the tree is
 // already detached, the worst that would happen is that we leak blocks, yes.
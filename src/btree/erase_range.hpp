@@ -15,12 +15,17 @@ class order_token_t;
 class superblock_t;
 class signal_t;
 class value_deleter_t;
+class background_subtree_eraser_t;
 
 class key_tester_t {
 public:
     key_tester_t() { }
     virtual bool key_should_be_erased(const btree_key_t *key) = 0;
 
+    // True if `key_should_be_erased()` is true for every key, so that an erase
+    // range can drop whole subtrees without looking at their keys.
+    virtual bool erases_every_key() { return false; }
+
 protected:
     virtual ~key_tester_t() { }
 private:
@@ -31,6 +36,7 @@ struct always_true_key_tester_t : public key_tester_t {
     bool key_should_be_erased(UNUSED const btree_key_t *key) {
         return true;
     }
+    bool erases_every_key() { return true; }
 };
 
 void btree_erase_range_generic(value_sizer_t<void> *sizer, key_tester_t *tester,
@@ -41,6 +47,19 @@ void btree_erase_range_generic(value_sizer_t<void> *sizer, key_tester_t *tester,
             &on_erase_cb =
                 std::function<void(const store_key_t &, const char *, const buf_parent_t &)>());
 
+/* Unlinks the subtrees whose whole key range lies in the given range from the tree,
+and hands them to `subtree_eraser`, which frees them in the background.  This
+only looks at the nodes along the two edges of the range, so it's fast no matter
+how many keys are in the range; erasing the keys it leaves behind (those that are
+in the range but share a leaf or a small subtree with keys outside of it) with
+`btree_erase_range_generic()` is cheap too.  Every key in the range gets erased,
+without calling any callbacks for them. */
+void btree_detach_erased_subtrees(value_sizer_t<void> *sizer,
+                                  const btree_key_t *left_exclusive_or_null,
+                                  const btree_key_t *right_inclusive_or_null,
+                                  superblock_t *superblock,
+                                  background_subtree_eraser_t *subtree_eraser);
+
 void erase_all(value_sizer_t<void> *sizer,
                const value_deleter_t *deleter,
                superblock_t *superblock,
@@ -1,9 +1,13 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "btree/get_distribution.hpp"
 
+#include <algorithm>
+#include <set>
+
 #include "btree/internal_node.hpp"
 #include "btree/node.hpp"
 #include "btree/leaf_node.hpp"
+#include "btree/operations.hpp"
 #include "btree/parallel_traversal.hpp"
 #include "buffer_cache/alt/alt.hpp"
 #include "utils.hpp"
@@ -87,6 +91,167 @@ public:
     std::vector<store_key_t> *keys;
 };
 
+class key_sample_traversal_helper_t : public btree_traversal_helper_t, public home_thread_mixin_debug_only_t {
+public:
+    key_sample_traversal_helper_t(
+            size_t _sample_size,
+            const std::function<int64_t(const btree_key_t *, const void *)> *_pair_size)
+        : sample_size(_sample_size), pair_size(_pair_size),
+          key_count(0), byte_count(0) {
+        samples.reserve(sample_size);
+    }
+
+    void process_a_leaf(buf_lock_t *leaf_node_buf,
+                        const btree_key_t *,
+                        const btree_key_t *,
+                        signal_t * /*interruptor*/,
+                        int * /*population_change_out*/) THROWS_ONLY(interrupted_exc_t) {
+        assert_thread();
+        buf_read_t read(leaf_node_buf);
+        const leaf_node_t *node
+            = static_cast<const leaf_node_t *>(read.get_data_read());
+
+        // Nothing below blocks, so the leaves don't interleave.
+        for (auto it = leaf::begin(*node); it != leaf::end(*node); ++it) {
+            const btree_key_t *key = (*it).first;
+            const int64_t size = (*pair_size)(key, (*it).second);
+            // The key with index `key_count` replaces a random sample with
+            // probability `sample_size / (key_count + 1)`.
+            if (samples.size() < sample_size) {
+                samples.push_back(std::make_pair(store_key_t(key), size));
+            } else {
+                const size_t i = randsize(key_count + 1);
+                if (i < sample_size) {
+                    samples[i] = std::make_pair(store_key_t(key), size);
+                }
+            }
+            ++key_count;
+            byte_count += size;
+        }
+    }
+
+    void postprocess_internal_node(buf_lock_t *) { }
+
+    void filter_interesting_children(buf_parent_t,
+                                     ranged_block_ids_t *ids_source,
+                                     interesting_children_callback_t *cb) {
+        for (int i = 0, e = ids_source->num_block_ids(); i < e; ++i) {
+            cb->receive_interesting_child(i);
+        }
+        cb->no_more_interesting_children();
+    }
+
+    access_t btree_superblock_mode() {
+        return access_t::read;
+    }
+
+    access_t btree_node_mode() {
+        return access_t::read;
+    }
+
+    const size_t sample_size;
+    const std::function<int64_t(const btree_key_t *, const void *)> *pair_size;
+    int64_t key_count;
+    int64_t byte_count;
+    std::vector<std::pair<store_key_t, int64_t> > samples;
+};
+
+void get_btree_key_sample(
+        superblock_t *superblock, size_t sample_size,
+        const std::function<int64_t(const btree_key_t *, const void *)> &pair_size,
+        int64_t *key_count_out, int64_t *byte_count_out,
+        std::vector<std::pair<store_key_t, int64_t> > *samples_out) {
+    key_sample_traversal_helper_t helper(sample_size, &pair_size);
+
+    cond_t non_interruptor;
+    btree_parallel_traversal(superblock, &helper, &non_interruptor);
+
+    std::sort(helper.samples.begin(), helper.samples.end());
+    *key_count_out = helper.key_count;
+    *byte_count_out = helper.byte_count;
+    *samples_out = std::move(helper.samples);
+}
+
+void get_btree_random_sample(
+        superblock_t *superblock, size_t sample_size, size_t max_walks,
+        const std::function<bool(const btree_key_t *, const void *, buf_lock_t *)>
+            &on_key,
+        int64_t *key_count_out) {
+    const block_id_t root_id = superblock->get_root_block_id();
+    const block_id_t stat_block_id = superblock->get_stat_block_id();
+    txn_t *txn = superblock->expose_buf().txn();
+    if (root_id == NULL_BLOCK_ID) {
+        superblock->release();
+        *key_count_out = 0;
+        return;
+    }
+    buf_lock_t root(superblock->expose_buf(), root_id, access_t::read);
+    superblock->release();
+
+    if (stat_block_id == NULL_BLOCK_ID) {
+        *key_count_out = 0;
+    } else {
+        buf_lock_t stat_block(buf_parent_t(txn), stat_block_id, access_t::read);
+        buf_read_t read(&stat_block);
+        *key_count_out = static_cast<const btree_statblock_t *>(
+            read.get_data_read())->population;
+    }
+
+    std::set<store_key_t> kept;
+    double max_weight = 0;
+    for (size_t walk = 0; walk < max_walks && kept.size() < sample_size; ++walk) {
+        // The product of the fanouts on the way down.
+        double weight = 1;
+        buf_lock_t node_buf;
+        buf_lock_t *buf = &root;
+        for (;;) {
+            block_id_t child_id;
+            {
+                buf_read_t read(buf);
+                const node_t *node = static_cast<const node_t *>(read.get_data_read());
+                if (node::is_leaf(node)) {
+                    break;
+                }
+                const internal_node_t *internal
+                    = static_cast<const internal_node_t *>(read.get_data_read());
+                weight *= internal->npairs;
+                child_id = internal_node::get_pair_by_index(
+                    internal, randint(internal->npairs))->lnode;
+            }
+            buf_lock_t tmp(buf_parent_t(buf), child_id, access_t::read);
+            node_buf = std::move(tmp);
+            buf = &node_buf;
+        }
+
+        buf_read_t read(buf);
+        const leaf_node_t *leaf
+            = static_cast<const leaf_node_t *>(read.get_data_read());
+        // The leaf also has entries for deleted keys, which we skip.
+        size_t num_keys = 0;
+        for (auto it = leaf::begin(*leaf); it != leaf::end(*leaf); ++it) {
+            ++num_keys;
+        }
+        if (num_keys == 0) {
+            continue;
+        }
+        weight *= num_keys;
+        max_weight = std::max(max_weight, weight);
+        if (randdouble() * max_weight >= weight) {
+            continue;
+        }
+
+        auto it = leaf::begin(*leaf);
+        for (size_t i = randsize(num_keys); i > 0; --i) {
+            ++it;
+        }
+        const btree_key_t *key = (*it).first;
+        store_key_t store_key(key);
+        if (kept.count(store_key) == 0 && on_key(key, (*it).second, buf)) {
+            kept.insert(std::move(store_key));
+        }
+    }
+}
+
 void get_btree_key_distribution(superblock_t *superblock, int depth_limit,
                                 int64_t *key_count_out,
                                 std::vector<store_key_t> *keys_out) {
@@ -2,15 +2,47 @@
 #ifndef BTREE_GET_DISTRIBUTION_HPP_
 #define BTREE_GET_DISTRIBUTION_HPP_
 
+#include <functional>
+#include <utility>
 #include <vector>
 
 #include "btree/keys.hpp"
 #include "buffer_cache/types.hpp"
 
+class buf_lock_t;
 class superblock_t;
 
 void get_btree_key_distribution(superblock_t *superblock, int depth_limit,
                                 int64_t *key_count_out,
                                 std::vector<store_key_t> *keys_out);
 
+/* Visits every leaf of the btree and takes a uniformly random sample of up to
+`sample_size` of its keys (by reservoir sampling).  `samples_out` gets the sampled
+keys in order, each with the size in bytes that `pair_size` reports for its pair;
+`key_count_out` and `byte_count_out` get the totals over the whole btree.  Unlike
+`get_btree_key_distribution()`, this reads every leaf, but the sample doesn't depend
+on how the keys happen to be spread over the nodes. */
+void get_btree_key_sample(
+        superblock_t *superblock, size_t sample_size,
+        const std::function<int64_t(const btree_key_t *, const void *)> &pair_size,
+        int64_t *key_count_out, int64_t *byte_count_out,
+        std::vector<std::pair<store_key_t, int64_t> > *samples_out);
+
+/* Takes an approximately uniform random sample of up to `sample_size` distinct keys
+of the btree by walking down from the root to random pairs, so it only reads the
+nodes on the walks rather than every leaf.  A walk picks each child of a node, and
+each pair of a leaf, with equal probability, so it reaches a key with a probability
+inversely proportional to the product of the fanouts on its way.  The key is kept
+with a probability proportional to that product (relative to the largest one seen
+so far), which evens that out.  It gives up after `max_walks` walks.
+
+`on_key` gets each key to keep with its value, while the leaf is held, and returns
+false to drop it after all.  `key_count_out` gets the number of keys in the whole
+btree.  The superblock is released. */
+void get_btree_random_sample(
+        superblock_t *superblock, size_t sample_size, size_t max_walks,
+        const std::function<bool(const btree_key_t *, const void *, buf_lock_t *)>
+            &on_key,
+        int64_t *key_count_out);
+
 #endif /* BTREE_GET_DISTRIBUTION_HPP_ */
@@ -0,0 +1,81 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "btree/hot_keys.hpp"
+
+#include <string>
+
+#include "config/args.hpp"
+#include "perfmon/perfmon.hpp"
+#include "utils.hpp"
+
+btree_hot_keys_t::btree_hot_keys_t()
+    : countdown(1 + randint(BTREE_HOT_KEYS_SAMPLE_RATE)),
+      samples_until_decay(BTREE_HOT_KEYS_DECAY_INTERVAL),
+      keys(BTREE_HOT_KEYS_SKETCH_SIZE),
+      leaves(BTREE_HOT_KEYS_SKETCH_SIZE) { }
+
+void btree_hot_keys_t::record_sample(const btree_key_t *key, block_id_t leaf,
+                                     access_t access) {
+    // Choosing the gap between samples at random (rather than sampling every Nth
+    // access) keeps periodic access patterns from skewing the sample.
+    countdown = 1 + randint(2 * BTREE_HOT_KEYS_SAMPLE_RATE - 1);
+
+    keys.record(store_key_t(key), access);
+    leaves.record(leaf, access);
+
+    if (--samples_until_decay == 0) {
+        keys.decay();
+        leaves.decay();
+        samples_until_decay = BTREE_HOT_KEYS_DECAY_INTERVAL;
+    }
+}
+
+struct hot_keys_stats_t {
+    std::vector<std::pair<store_key_t, space_saving_sketch_t<store_key_t>::counter_t> >
+        keys;
+    std::vector<std::pair<block_id_t, space_saving_sketch_t<block_id_t>::counter_t> >
+        leaves;
+};
+
+void *btree_hot_keys_t::begin_stats() {
+    return new hot_keys_stats_t;
+}
+
+void btree_hot_keys_t::visit_stats(void *ctx) {
+    // The sketches are only touched on our home thread.
+    if (get_thread_id() == home_thread()) {
+        hot_keys_stats_t *stats = static_cast<hot_keys_stats_t *>(ctx);
+        stats->keys = keys.top(BTREE_HOT_KEYS_REPORTED);
+        stats->leaves = leaves.top(BTREE_HOT_KEYS_REPORTED);
+    }
+}
+
+template <class counter_t>
+perfmon_result_t *counter_to_perfmon_result(const counter_t &counter) {
+    scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
+    result->insert("count", new perfmon_result_t(strprintf("%" PRIu64, counter.count)));
+    result->insert("error", new perfmon_result_t(strprintf("%" PRIu64, counter.error)));
+    result->insert("writes", new perfmon_result_t(strprintf("%" PRIu64, counter.writes)));
+    return result.release();
+}
+
+scoped_ptr_t<perfmon_result_t> btree_hot_keys_t::end_stats(void *ctx) {
+    scoped_ptr_t<hot_keys_stats_t> stats(static_cast<hot_keys_stats_t *>(ctx));
+
+    // The counts are in samples, so they're roughly 1/BTREE_HOT_KEYS_SAMPLE_RATE of
+    // the accesses (with older accesses weighing less).
+    scoped_ptr_t<perfmon_result_t> keys_result = perfmon_result_t::alloc_map_result();
+    for (auto it = stats->keys.begin(); it != stats->keys.end(); ++it) {
+        keys_result->insert(key_to_debug_str(it->first),
+                            counter_to_perfmon_result(it->second));
+    }
+    scoped_ptr_t<perfmon_result_t> leaves_result = perfmon_result_t::alloc_map_result();
+    for (auto it = stats->leaves.begin(); it != stats->leaves.end(); ++it) {
+        leaves_result->insert(strprintf("%" PRIu64, it->first),
+                              counter_to_perfmon_result(it->second));
+    }
+
+    scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
+    result->insert("keys", keys_result.release());
+    result->insert("leaves", leaves_result.release());
+    return result;
+}
@@ -0,0 +1,119 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BTREE_HOT_KEYS_HPP_
+#define BTREE_HOT_KEYS_HPP_
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "btree/keys.hpp"
+#include "concurrency/access.hpp"
+#include "perfmon/core.hpp"
+#include "serializer/types.hpp"
+#include "threading.hpp"
+
+/* A Space-Saving sketch: it keeps counts for at most `capacity` items.  An item
+that isn't tracked yet takes the place of the one with the smallest count, and
+inherits that count as its possible overcount (`error`).  Every item that has been
+recorded more than (total recorded / capacity) times is guaranteed to be tracked,
+and a tracked item's true count lies in [count - error, count]. */
+template <class item_t>
+class space_saving_sketch_t {
+public:
+    struct counter_t {
+        counter_t() : count(0), error(0), writes(0) { }
+        uint64_t count;
+        uint64_t error;
+        // How many of the recordings (since the item was last let in) were writes.
+        uint64_t writes;
+    };
+
+    explicit space_saving_sketch_t(size_t _capacity) : capacity(_capacity) {
+        guarantee(capacity > 0);
+    }
+
+    void record(const item_t &item, access_t access) {
+        auto it = counters.find(item);
+        if (it == counters.end()) {
+            counter_t counter;
+            if (counters.size() == capacity) {
+                auto smallest = counters.begin();
+                for (auto jt = counters.begin(); jt != counters.end(); ++jt) {
+                    if (jt->second.count < smallest->second.count) {
+                        smallest = jt;
+                    }
+                }
+                counter.count = smallest->second.count;
+                counter.error = smallest->second.count;
+                counters.erase(smallest);
+            }
+            it = counters.insert(std::make_pair(item, counter)).first;
+        }
+        ++it->second.count;
+        if (access == access_t::write) {
+            ++it->second.writes;
+        }
+    }
+
+    // Halves every count, so that items that stopped being hot eventually lose
+    // their place to ones that are hot now.
+    void decay() {
+        for (auto it = counters.begin(); it != counters.end(); ++it) {
+            it->second.count /= 2;
+            it->second.error /= 2;
+            it->second.writes /= 2;
+        }
+    }
+
+    // The `n` items with the highest counts, highest first.
+    std::vector<std::pair<item_t, counter_t> > top(size_t n) const {
+        std::vector<std::pair<item_t, counter_t> > ret(counters.begin(), counters.end());
+        std::sort(ret.begin(), ret.end(),
+                  [](const std::pair<item_t, counter_t> &x,
+                     const std::pair<item_t, counter_t> &y) {
+                      return x.second.count > y.second.count;
+                  });
+        if (ret.size() > n) {
+            ret.resize(n);
+        }
+        return ret;
+    }
+
+private:
+    const size_t capacity;
+    std::map<item_t, counter_t> counters;
+};
+
+/* Tracks the most frequently accessed keys of a btree, and the leaf nodes that
+hold them, from a random sample of one in BTREE_HOT_KEYS_SAMPLE_RATE point reads
+and writes.  As a perfmon, it reports the top BTREE_HOT_KEYS_REPORTED of each.  All
+recording happens on the btree's home thread. */
+class btree_hot_keys_t : public perfmon_t, public home_thread_mixin_t {
+public:
+    btree_hot_keys_t();
+
+    void record(const btree_key_t *key, block_id_t leaf, access_t access) {
+        assert_thread();
+        if (--countdown > 0) {
+            return;
+        }
+        record_sample(key, leaf, access);
+    }
+
+    void *begin_stats();
+    void visit_stats(void *ctx);
+    scoped_ptr_t<perfmon_result_t> end_stats(void *ctx);
+
+private:
+    void record_sample(const btree_key_t *key, block_id_t leaf, access_t access);
+
+    int countdown;
+    int samples_until_decay;
+    space_saving_sketch_t<store_key_t> keys;
+    space_saving_sketch_t<block_id_t> leaves;
+
+    DISABLE_COPYING(btree_hot_keys_t);
+};
+
+#endif  // BTREE_HOT_KEYS_HPP_
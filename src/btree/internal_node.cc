@@ -71,7 +71,12 @@ bool insert(UNUSED block_size_t block_size, internal_node_t *node, const btree_k
 }
 
 bool remove(block_size_t block_size, internal_node_t *node, const btree_key_t *key) {
-    int index = get_offset_index(node, key);
+    remove_by_index(block_size, node, get_offset_index(node, key));
+    return true;
+}
+
+void remove_by_index(block_size_t block_size, internal_node_t *node, int index) {
+    rassert(index >= 0 && index < node->npairs);
     impl::delete_pair(node, node->pair_offsets[index]);
     impl::delete_offset(node, index);
 
@@ -80,7 +85,6 @@ bool remove(block_size_t block_size, internal_node_t *node, const btree_key_t *k
     }
 
     validate(block_size, node);
-    return true;
 }
 
 void split(block_size_t block_size, internal_node_t *node, internal_node_t *rnode, btree_key_t *median) {
@@ -353,7 +357,29 @@ btree_internal_pair *get_pair_by_index(internal_node_t *node, int index) {
 }
 
 int get_offset_index(const internal_node_t *node, const btree_key_t *key) {
-    return std::lower_bound(node->pair_offsets, node->pair_offsets+node->npairs-1, (uint16_t) internal_key_comp::faux_offset, internal_key_comp(node, key)) - node->pair_offsets;
+    // Finds the first pair whose key is at least `key`, not counting the special
+    // last pair.  Like `leaf::find_key()`, this skips the prefix that the keys
+    // between the bounds of the search share with `key`.
+    int beg = 0;
+    int end = node->npairs - 1;
+    int beg_common = 0;
+    int end_common = 0;
+    while (beg < end) {
+        int test_point = beg + (end - beg) / 2;
+        const btree_key_t *pair_key = &get_pair_by_index(node, test_point)->key;
+        int common;
+        int res = sized_strcmp_from(pair_key->contents, pair_key->size,
+                                    key->contents, key->size,
+                                    std::min(beg_common, end_common), &common);
+        if (res < 0) {
+            beg = test_point + 1;
+            beg_common = common;
+        } else {
+            end = test_point;
+            end_common = common;
+        }
+    }
+    return beg;
 }
 
 int nodecmp(const internal_node_t *node1, const internal_node_t *node2) {
@@ -33,6 +33,9 @@ void init(block_size_t block_size, internal_node_t *node, const internal_node_t
 block_id_t lookup(const internal_node_t *node, const btree_key_t *key);
 bool insert(block_size_t block_size, internal_node_t *node, const btree_key_t *key, block_id_t lnode, block_id_t rnode);
 bool remove(block_size_t block_size, internal_node_t *node, const btree_key_t *key);
+// Removes the index'th pair.  The range of the child that goes with it is taken over
+// by its right sibling, or by its left sibling if it's the last child.
+void remove_by_index(block_size_t block_size, internal_node_t *node, int index);
 void split(block_size_t block_size, internal_node_t *node, internal_node_t *rnode, btree_key_t *median);
 void merge(block_size_t block_size, const internal_node_t *node, internal_node_t *rnode, const internal_node_t *parent);
 bool level(block_size_t block_size, internal_node_t *node, internal_node_t *sibling,
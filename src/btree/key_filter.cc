@@ -0,0 +1,141 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "btree/key_filter.hpp"
+
+#include <algorithm>
+
+#include "config/args.hpp"
+
+// One block is a cache line.
+static const uint64_t bits_per_block = 512;
+static const uint64_t words_per_block = bits_per_block / 64;
+
+class key_filter_t::bits_t {
+public:
+    explicit bits_t(int64_t _capacity)
+        : capacity(_capacity), num_keys(0),
+          num_blocks(std::max<uint64_t>(
+              1, (capacity * KEY_FILTER_BITS_PER_KEY + bits_per_block - 1)
+                 / bits_per_block)),
+          words(num_blocks * words_per_block, 0) { }
+
+    static uint64_t bytes_for(int64_t capacity) {
+        return (capacity * KEY_FILTER_BITS_PER_KEY + bits_per_block - 1)
+            / bits_per_block * (bits_per_block / 8);
+    }
+
+    bool test(const btree_key_t *key) const {
+        uint64_t block, a, b;
+        locate(key, &block, &a, &b);
+        const uint64_t *w = &words[block * words_per_block];
+        for (int i = 0; i < KEY_FILTER_HASHES; ++i) {
+            const uint64_t bit = (a + i * b) % bits_per_block;
+            if (!(w[bit / 64] & (uint64_t(1) << (bit % 64)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void set(const btree_key_t *key) {
+        uint64_t block, a, b;
+        locate(key, &block, &a, &b);
+        uint64_t *w = &words[block * words_per_block];
+        for (int i = 0; i < KEY_FILTER_HASHES; ++i) {
+            const uint64_t bit = (a + i * b) % bits_per_block;
+            w[bit / 64] |= uint64_t(1) << (bit % 64);
+        }
+        ++num_keys;
+    }
+
+    const int64_t capacity;
+    int64_t num_keys;
+
+private:
+    // FNV-1a, with MurmurHash3's finalizer so that the high bits are good too.
+    static uint64_t hash_key(const btree_key_t *key) {
+        uint64_t h = 14695981039346656037ULL;
+        for (int i = 0; i < key->size; ++i) {
+            h ^= key->contents[i];
+            h *= 1099511628211ULL;
+        }
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // The block, and the first bit and stride of the key's bits in it (the stride
+    // is odd, so the bits are all different).
+    void locate(const btree_key_t *key, uint64_t *block_out,
+                uint64_t *a_out, uint64_t *b_out) const {
+        const uint64_t h = hash_key(key);
+        *block_out = (h >> 32) % num_blocks;
+        *a_out = h & 0xffff;
+        *b_out = ((h >> 16) & 0xffff) | 1;
+    }
+
+    const uint64_t num_blocks;
+    std::vector<uint64_t> words;
+};
+
+key_filter_t::key_filter_t() {
+    rebuild_wanted_.pulse();
+}
+
+key_filter_t::~key_filter_t() { }
+
+bool key_filter_t::may_contain(const btree_key_t *key) const {
+    assert_thread();
+    return !ready_.has() || ready_->test(key);
+}
+
+void key_filter_t::note_key(const btree_key_t *key) {
+    assert_thread();
+    if (building_.has()) {
+        building_->set(key);
+    }
+    if (ready_.has()) {
+        ready_->set(key);
+        if (ready_->num_keys > ready_->capacity && !building_.has()) {
+            rebuild_wanted_.pulse_if_not_already_pulsed();
+        }
+    }
+}
+
+bool key_filter_t::start_building(int64_t expected_keys) {
+    assert_thread();
+    guarantee(!building_.has());
+    rebuild_wanted_.reset();
+    // Leave room for the table to double before it has to be built again.
+    const int64_t capacity = std::max<int64_t>(2 * expected_keys, KEY_FILTER_MIN_KEYS);
+    if (bits_t::bytes_for(capacity) > KEY_FILTER_MAX_BYTES) {
+        // Too big to keep in memory; lookups just walk the tree.
+        ready_.reset();
+        return false;
+    }
+    building_.init(new bits_t(capacity));
+    return true;
+}
+
+void key_filter_t::add_built_key(const btree_key_t *key) {
+    assert_thread();
+    guarantee(building_.has());
+    building_->set(key);
+}
+
+void key_filter_t::finish_building() {
+    assert_thread();
+    guarantee(building_.has());
+    ready_ = std::move(building_);
+    if (ready_->num_keys > ready_->capacity) {
+        rebuild_wanted_.pulse_if_not_already_pulsed();
+    }
+}
+
+void key_filter_t::abandon_building() {
+    assert_thread();
+    building_.reset();
+    rebuild_wanted_.pulse_if_not_already_pulsed();
+}
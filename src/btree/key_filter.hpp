@@ -0,0 +1,72 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BTREE_KEY_FILTER_HPP_
+#define BTREE_KEY_FILTER_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "btree/keys.hpp"
+#include "concurrency/cond_var.hpp"
+#include "containers/scoped.hpp"
+#include "threading.hpp"
+
+/* A Bloom filter over the keys of a btree, so that looking up a key that isn't there
+usually doesn't have to walk down the tree (and, on a cold table, read a leaf from
+disk) to find that out.
+
+The filter lives in memory only and gets built by traversing the tree (see
+`build_primary_key_filter()` for the primary btrees of rdb stores); until it's built,
+`may_contain()` says yes to everything.  Keeping it on disk would mean writing a
+filter block in every write transaction, just to be able to skip one traversal at
+startup.
+
+Every key that might get inserted has to go through `note_key()` while the writer
+still holds the superblock, before anything else can get the superblock after it:
+a read that gets the superblock later then finds the key in the filter even if the
+writer hasn't reached the leaf yet.  Deleted keys stay in the filter, which only
+costs a false positive.  Once more keys have been noted than the filter was sized
+for, `get_rebuild_wanted()` gets pulsed; the old filter keeps answering, and keeps
+getting keys, until the new one is done.
+
+Each key sets `KEY_FILTER_BITS_PER_KEY`-ish bits that all lie in one 64-byte
+block, so a lookup touches one cache line. */
+class key_filter_t : public home_thread_mixin_debug_only_t {
+public:
+    key_filter_t();
+    ~key_filter_t();
+
+    // Returns false only if the key definitely isn't in the btree.
+    bool may_contain(const btree_key_t *key) const;
+
+    // Called for every key a writer might insert, while it holds the superblock.
+    void note_key(const btree_key_t *key);
+
+    bool is_ready() const { return ready_.has(); }
+
+    // Pulsed when the filter has had more keys than it was sized for, or has never
+    // been built.
+    signal_t *get_rebuild_wanted() { return &rebuild_wanted_; }
+
+    // Starts a new filter for about `expected_keys` keys.  From now on `note_key()`
+    // adds keys to the new filter too, so this must be called before the traversal
+    // that builds it gets the superblock.  Returns false (and builds nothing) if the
+    // filter would be bigger than `KEY_FILTER_MAX_BYTES`.
+    bool start_building(int64_t expected_keys);
+    // Adds a key found by the traversal.
+    void add_built_key(const btree_key_t *key);
+    // Replaces the filter in use with the new one.
+    void finish_building();
+    void abandon_building();
+
+private:
+    class bits_t;
+
+    scoped_ptr_t<bits_t> ready_;
+    scoped_ptr_t<bits_t> building_;
+    cond_t rebuild_wanted_;
+
+    DISABLE_COPYING(key_filter_t);
+};
+
+#endif  // BTREE_KEY_FILTER_HPP_
@@ -14,10 +14,58 @@ int sized_strcmp(const uint8_t *str1, int len1, const uint8_t *str2, int len2) {
     return res;
 }
 
+int sized_strcmp_from(const uint8_t *str1, int len1, const uint8_t *str2, int len2,
+                      int skip, int *common_out) {
+    const int min_len = std::min(len1, len2);
+    rassert(skip >= 0 && skip <= min_len);
+    int i = skip;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // Compare eight bytes at a time.  The lowest set byte of the difference of two
+    // little-endian words is their first differing byte.
+    while (i + static_cast<int>(sizeof(uint64_t)) <= min_len) {
+        uint64_t word1, word2;
+        memcpy(&word1, str1 + i, sizeof(uint64_t));
+        memcpy(&word2, str2 + i, sizeof(uint64_t));
+        if (word1 != word2) {
+            i += __builtin_ctzll(word1 ^ word2) / 8;
+            *common_out = i;
+            return static_cast<int>(str1[i]) - static_cast<int>(str2[i]);
+        }
+        i += sizeof(uint64_t);
+    }
+#endif
+    while (i < min_len && str1[i] == str2[i]) {
+        ++i;
+    }
+    *common_out = i;
+    if (i < min_len) {
+        return static_cast<int>(str1[i]) - static_cast<int>(str2[i]);
+    }
+    return len1 - len2;
+}
+
+void get_shortest_separator(const btree_key_t *left, const btree_key_t *right,
+                            btree_key_t *separator_out) {
+    rassert(btree_key_cmp(left, right) < 0);
+    const int min_size = std::min(left->size, right->size);
+    int common = 0;
+    while (common < min_size && left->contents[common] == right->contents[common]) {
+        ++common;
+    }
+    // Unless `left` is a prefix of `right`, the first `common + 1` bytes of `right`
+    // are greater than `left`. They're less than `right` unless they're all of it.
+    if (common < left->size && common + 1 < right->size) {
+        separator_out->size = common + 1;
+        memcpy(separator_out->contents, right->contents, common + 1);
+    } else {
+        memcpy(separator_out, left, left->full_size());
+    }
+}
+
 bool unescaped_str_to_key(const char *str, int len, store_key_t *buf) {
     if (len <= MAX_KEY_SIZE) {
-        memcpy(buf->contents(), str, len);
         buf->set_size(uint8_t(len));
+        memcpy(buf->contents(), str, len);
         return true;
     } else {
         return false;
@@ -202,5 +250,21 @@ bool operator<(const key_range_t &a, const key_range_t &b) THROWS_NOTHING {
     return (a.left < b.left || (a.left == b.left && a.right < b.right));
 }
 
+key_range_t printable_key_subrange(const std::string &prefix,
+                                   int piece_number, int num_pieces) {
+    const int first_char = '0';
+    const int num_chars = 'z' + 1 - first_char;
+    guarantee(piece_number >= 0 && piece_number < num_pieces);
+    guarantee(num_pieces <= num_chars);
+
+    const store_key_t left(prefix + static_cast<char>(
+        first_char + num_chars * piece_number / num_pieces));
+    const store_key_t right(prefix + static_cast<char>(
+        first_char + num_chars * (piece_number + 1) / num_pieces));
+    return key_range_t(piece_number == 0 ? key_range_t::none : key_range_t::closed, left,
+                       piece_number == num_pieces - 1 ? key_range_t::none : key_range_t::open,
+                       right);
+}
+
 RDB_IMPL_SERIALIZABLE_2(key_range_t::right_bound_t, unbounded, key);
 RDB_IMPL_SERIALIZABLE_2(key_range_t, left, right);
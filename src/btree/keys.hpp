@@ -20,6 +20,13 @@
 // Fast string compare
 int sized_strcmp(const uint8_t *str1, int len1, const uint8_t *str2, int len2);
 
+// Like `sized_strcmp()`, but the caller knows that the first `skip` bytes of the two
+// strings are equal, and `*common_out` is set to the length of their common prefix.
+// A binary search uses this to skip the prefix that all keys between its bounds
+// share with the key it's looking for.
+int sized_strcmp_from(const uint8_t *str1, int len1, const uint8_t *str2, int len2,
+                      int skip, int *common_out);
+
 // Note: Changing this struct changes the format of the data stored on disk.
 // If you change this struct, previous stored data will be misinterpreted.
 struct btree_key_t {
@@ -37,34 +44,90 @@ inline int btree_key_cmp(const btree_key_t *left, const btree_key_t *right) {
     return sized_strcmp(left->contents, left->size, right->contents, right->size);
 }
 
+// Sets `*separator_out` to the shortest key that is at least `left` and less than
+// `right`, which must be greater than `left`.  Leaf splits use this for the key that
+// goes into the parent, so internal nodes hold short keys and fit more children.
+void get_shortest_separator(const btree_key_t *left, const btree_key_t *right,
+                            btree_key_t *separator_out);
+
+// Keys of up to STORE_KEY_INLINE_SIZE bytes are stored in the object itself, so
+// that copying one (or a `key_range_t` or `region_t`) doesn't copy MAX_KEY_SIZE
+// bytes.  Longer keys get a heap buffer with room for any key, which the
+// `store_key_t` keeps until it's destroyed.
+//
+// `btree_key()` and `contents()` only have room for `size()` bytes: to write a
+// longer key through them, call `set_size()` first, or use `writable_btree_key()`.
 struct store_key_t {
 public:
-    store_key_t() {
+    store_key_t() : heap_buffer(NULL) {
         set_size(0);
     }
 
-    store_key_t(int sz, const uint8_t *buf) {
+    store_key_t(int sz, const uint8_t *buf) : heap_buffer(NULL) {
         assign(sz, buf);
     }
 
-    store_key_t(const store_key_t &_key) {
+    store_key_t(const store_key_t &_key) : heap_buffer(NULL) {
         assign(_key.size(), _key.contents());
     }
 
-    explicit store_key_t(const btree_key_t *key) {
+    store_key_t(store_key_t &&_key) : heap_buffer(_key.heap_buffer) {
+        if (heap_buffer == NULL) {
+            memcpy(inline_buffer, _key.inline_buffer, _key.btree_key()->full_size());
+        }
+        _key.heap_buffer = NULL;
+        _key.set_size(0);
+    }
+
+    explicit store_key_t(const btree_key_t *key) : heap_buffer(NULL) {
         assign(key->size, key->contents);
     }
 
-    explicit store_key_t(const std::string &s) {
+    explicit store_key_t(const std::string &s) : heap_buffer(NULL) {
         assign(s.size(), reinterpret_cast<const uint8_t *>(s.data()));
     }
 
-    btree_key_t *btree_key() { return reinterpret_cast<btree_key_t *>(buffer); }
+    ~store_key_t() {
+        delete[] heap_buffer;
+    }
+
+    store_key_t &operator=(const store_key_t &_key) {
+        if (this != &_key) {
+            assign(_key.size(), _key.contents());
+        }
+        return *this;
+    }
+
+    store_key_t &operator=(store_key_t &&_key) {
+        if (this != &_key) {
+            if (_key.heap_buffer != NULL) {
+                delete[] heap_buffer;
+                heap_buffer = _key.heap_buffer;
+                _key.heap_buffer = NULL;
+                _key.set_size(0);
+            } else {
+                assign(_key.size(), _key.contents());
+            }
+        }
+        return *this;
+    }
+
+    btree_key_t *btree_key() {
+        return reinterpret_cast<btree_key_t *>(
+            heap_buffer != NULL ? heap_buffer : inline_buffer);
+    }
     const btree_key_t *btree_key() const {
-        return reinterpret_cast<const btree_key_t *>(buffer);
+        return reinterpret_cast<const btree_key_t *>(
+            heap_buffer != NULL ? heap_buffer : inline_buffer);
+    }
+    // Has room for a key of any size, for functions that write a `btree_key_t`.
+    btree_key_t *writable_btree_key() {
+        reserve(MAX_KEY_SIZE);
+        return btree_key();
     }
     void set_size(int s) {
         rassert(s <= MAX_KEY_SIZE);
+        reserve(s);
         btree_key()->size = s;
     }
     int size() const { return btree_key()->size; }
@@ -94,8 +157,8 @@ public:
 
     bool increment() {
         if (size() < MAX_KEY_SIZE) {
-            contents()[size()] = 0;
             set_size(size() + 1);
+            contents()[size() - 1] = 0;
             return true;
         }
         while (size() > 0 && contents()[size()-1] == 255) {
@@ -116,10 +179,11 @@ public:
             return false;
         } else if ((reinterpret_cast<uint8_t *>(contents()))[size()-1] > 0) {
             (reinterpret_cast<uint8_t *>(contents()))[size()-1]--;
-            for (int i = size(); i < MAX_KEY_SIZE; i++) {
+            const int old_size = size();
+            set_size(MAX_KEY_SIZE);
+            for (int i = old_size; i < MAX_KEY_SIZE; i++) {
                 contents()[i] = 255;
             }
-            set_size(MAX_KEY_SIZE);
             return true;
         } else {
             set_size(size() - 1);
@@ -142,6 +206,10 @@ public:
         uint8_t sz;
         archive_result_t res = deserialize(s, &sz);
         if (bad(res)) { return res; }
+        if (sz > MAX_KEY_SIZE) {
+            return archive_result_t::RANGE_ERROR;
+        }
+        reserve(sz);
         int64_t num_read = force_read(s, contents(), sz);
         if (num_read == -1) {
             return archive_result_t::SOCK_ERROR;
@@ -155,7 +223,17 @@ public:
     }
 
 private:
-    char buffer[sizeof(btree_key_t) + MAX_KEY_SIZE];
+    // Makes sure there's room for a key of `sz` bytes, keeping the current one.
+    void reserve(int sz) {
+        if (sz > STORE_KEY_INLINE_SIZE && heap_buffer == NULL) {
+            heap_buffer = new char[sizeof(btree_key_t) + MAX_KEY_SIZE];
+            memcpy(heap_buffer, inline_buffer,
+                   reinterpret_cast<btree_key_t *>(inline_buffer)->full_size());
+        }
+    }
+
+    char *heap_buffer;
+    char inline_buffer[sizeof(btree_key_t) + STORE_KEY_INLINE_SIZE];
 };
 
 inline bool operator==(const store_key_t &k1, const store_key_t &k2) {
@@ -260,6 +338,13 @@ struct key_range_t {
 RDB_DECLARE_SERIALIZABLE(key_range_t::right_bound_t);
 RDB_DECLARE_SERIALIZABLE(key_range_t);
 
+/* The `piece_number`th of `num_pieces` contiguous key ranges that together cover
+every key. They divide the keys that follow `prefix` evenly by their next character,
+going by the printable characters '0' through 'z'; the first and last pieces also
+take every key that sorts before or after those. */
+key_range_t printable_key_subrange(const std::string &prefix,
+                                   int piece_number, int num_pieces);
+
 void debug_print(printf_buffer_t *buf, const store_key_t &k);
 void debug_print(printf_buffer_t *buf, const store_key_t *k);
 void debug_print(printf_buffer_t *buf, const key_range_t &kr);
@@ -515,6 +515,15 @@ bool is_empty(const leaf_node_t *node) {
     return node->num_pairs == 0;
 }
 
+bool is_past_last_key(const leaf_node_t *node, const btree_key_t *key) {
+    if (node->num_pairs == 0) {
+        return true;
+    }
+    const btree_key_t *last
+        = entry_key(get_entry(node, node->pair_offsets[node->num_pairs - 1]));
+    return sized_strcmp(last->contents, last->size, key->contents, key->size) < 0;
+}
+
 bool is_full(value_sizer_t<void> *sizer, const leaf_node_t *node, const btree_key_t *key, const void *value) {
 
     // Upon an insertion, we preserve `MANDATORY_TIMESTAMPS - 1`
@@ -653,6 +662,10 @@ void garbage_collect(value_sizer_t<void> *sizer, leaf_node_t *node, int num_tsta
     rassert(ignore == 0);
 }
 
+void freeze(value_sizer_t<void> *sizer, leaf_node_t *node) {
+    garbage_collect(sizer, node, 0);
+}
+
 void clean_entry(void *p, int sz) {
     rassert(sz > 0);
 
@@ -935,19 +948,22 @@ void move_elements(value_sizer_t<void> *sizer, leaf_node_t *fro, int beg, int en
     validate(sizer, tow);
 }
 
-void split(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_key_t *median_out) {
+void split(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_key_t *median_out,
+           split_policy_t policy) {
     int tstamp_back_offset;
     int mandatory = mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS, &tstamp_back_offset);
 
     rassert(mandatory >= free_space(sizer) - leaf_epsilon(sizer));
 
-    // We shall split the mandatory cost of this node as evenly as possible.
+    // We shall split the mandatory cost of this node as evenly as possible, or, for
+    // an append, move as little of it as we can.
+    const int target_rcost = policy == split_policy_t::APPEND ? 1 : mandatory / 2;
 
     int num_mandatories = 0;
     int i = node->num_pairs - 1;
     int prev_rcost = 0;
     int rcost = 0;
-    while (i >= 0 && rcost < mandatory / 2) {
+    while (i >= 0 && rcost < target_rcost) {
         int offset = node->pair_offsets[i];
         entry_t *ent = get_entry(node, offset);
 
@@ -976,29 +992,41 @@ void split(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, bt
         --i;
     }
 
-    // Since the mandatory_cost is at least free_space - leaf_epsilon there's no way i can equal num_pairs or zero.
-    rassert(i < node->num_pairs);
-    rassert(i > 0);
-
-    // Now prev_rcost and rcost envelope mandatory / 2.
-    rassert(prev_rcost < mandatory / 2);
-    rassert(rcost >= mandatory / 2, "rcost = %d, mandatory / 2 = %d, i = %d", rcost, mandatory / 2, i);
-
     int s;
     int end_rcost;
-    if ((mandatory - prev_rcost) - prev_rcost < rcost - (mandatory - rcost)) {
-        end_rcost = prev_rcost;
-        s = i + 2;
-        --num_mandatories;
-    } else {
+    if (policy == split_policy_t::APPEND) {
+        // `rnode` gets the last entry (and any deletions after it that don't need
+        // to be kept).  It's left underfull, but the keys that come next fill it.
+        if (i < 0 || mandatory - rcost < free_space(sizer) / 2 - leaf_epsilon(sizer)) {
+            // The node has few, big entries.
+            split(sizer, node, rnode, median_out, split_policy_t::EVEN);
+            return;
+        }
         end_rcost = rcost;
         s = i + 1;
-    }
+    } else {
+        // Since the mandatory_cost is at least free_space - leaf_epsilon there's no way i can equal num_pairs or zero.
+        rassert(i < node->num_pairs);
+        rassert(i > 0);
+
+        // Now prev_rcost and rcost envelope mandatory / 2.
+        rassert(prev_rcost < mandatory / 2);
+        rassert(rcost >= mandatory / 2, "rcost = %d, mandatory / 2 = %d, i = %d", rcost, mandatory / 2, i);
+
+        if ((mandatory - prev_rcost) - prev_rcost < rcost - (mandatory - rcost)) {
+            end_rcost = prev_rcost;
+            s = i + 2;
+            --num_mandatories;
+        } else {
+            end_rcost = rcost;
+            s = i + 1;
+        }
 
-    // If our math was right, neither node can be underfull just
-    // considering the split of the mandatory costs.
-    rassert(end_rcost >= free_space(sizer) / 2 - leaf_epsilon(sizer));
-    rassert(mandatory - end_rcost >= free_space(sizer) / 2 - leaf_epsilon(sizer));
+        // If our math was right, neither node can be underfull just
+        // considering the split of the mandatory costs.
+        rassert(end_rcost >= free_space(sizer) / 2 - leaf_epsilon(sizer));
+        rassert(mandatory - end_rcost >= free_space(sizer) / 2 - leaf_epsilon(sizer));
+    }
 
     // Now we wish to move the elements at indices [s, num_pairs) to rnode.
 
@@ -1008,7 +1036,10 @@ void split(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, bt
     move_elements(sizer, node, s, node->num_pairs, 0, rnode, node_copysize,
                   tstamp_back_offset, NULL);
 
-    keycpy(median_out, entry_key(get_entry(node, node->pair_offsets[s - 1])));
+    // Any key between the two nodes will do for the parent, so use the shortest.
+    get_shortest_separator(entry_key(get_entry(node, node->pair_offsets[s - 1])),
+                           entry_key(get_entry(rnode, rnode->pair_offsets[0])),
+                           median_out);
 }
 
 void merge(value_sizer_t<void> *sizer, leaf_node_t *left, leaf_node_t *right) {
@@ -1137,9 +1168,13 @@ bool level(value_sizer_t<void> *sizer, int nodecmp_node_with_sib,
     guarantee(sibling->num_pairs > 0);
 
     if (nodecmp_node_with_sib < 0) {
-        keycpy(replacement_key_out, entry_key(get_entry(node, node->pair_offsets[node->num_pairs - 1])));
+        get_shortest_separator(entry_key(get_entry(node, node->pair_offsets[node->num_pairs - 1])),
+                               entry_key(get_entry(sibling, sibling->pair_offsets[0])),
+                               replacement_key_out);
     } else {
-        keycpy(replacement_key_out, entry_key(get_entry(sibling, sibling->pair_offsets[sibling->num_pairs - 1])));
+        get_shortest_separator(entry_key(get_entry(sibling, sibling->pair_offsets[sibling->num_pairs - 1])),
+                               entry_key(get_entry(node, node->pair_offsets[0])),
+                               replacement_key_out);
     }
 
     return true;
@@ -1159,20 +1194,37 @@ bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out) {
     // beg == 0 or key > *(beg - 1).
     // end == num_pairs or key < *end.
 
+    // The lengths of the prefixes `key` shares with *(beg - 1) and *end.  Every
+    // entry in between shares at least the shorter of them with `key` too, so we
+    // don't have to compare that part again.
+    int beg_common = 0;
+    int end_common = 0;
+
     while (beg < end) {
         // when (end - beg) > 0, (end - beg) / 2 is always less than (end - beg).  So beg <= test_point < end.
         int test_point = beg + (end - beg) / 2;
 
+        // The entries are spread all over the block.  Start loading the two that
+        // could be probed next while we compare this one.
+        __builtin_prefetch(get_entry(node, node->pair_offsets[beg + (test_point - beg) / 2]));
+        if (test_point + 1 < end) {
+            __builtin_prefetch(get_entry(node, node->pair_offsets[test_point + 1 + (end - test_point - 1) / 2]));
+        }
+
         const btree_key_t *ek = entry_key(get_entry(node, node->pair_offsets[test_point]));
 
-        int res = sized_strcmp(key->contents, key->size, ek->contents, ek->size);
+        int common;
+        int res = sized_strcmp_from(key->contents, key->size, ek->contents, ek->size,
+                                    std::min(beg_common, end_common), &common);
 
         if (res < 0) {
             // key < *test_point.
             end = test_point;
+            end_common = common;
         } else if (res > 0) {
             // key > *test_point.  Since test_point < end, we have test_point + 1 <= end.
             beg = test_point + 1;
+            beg_common = common;
         } else {
             // We found the key!
             *index_out = test_point;
@@ -126,8 +126,19 @@ bool is_full(value_sizer_t<void> *sizer, const leaf_node_t *node, const btree_ke
 
 bool is_underfull(value_sizer_t<void> *sizer, const leaf_node_t *node);
 
+// Whether `key` sorts after every key (or deletion entry) in `node`.
+bool is_past_last_key(const leaf_node_t *node, const btree_key_t *key);
+
+// How `split` divides a full node.  EVEN splits its entries' cost as evenly as
+// possible.  APPEND is for a key that goes after every key in the rightmost leaf
+// under its parent: it moves just the last entry to `sibling`, where the new key
+// goes too, so that keys inserted in increasing order leave full leaves behind
+// instead of half-full ones.  (It falls back to EVEN if that would leave `node`
+// underfull.)
+enum class split_policy_t { EVEN, APPEND };
+
 void split(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *sibling,
-           btree_key_t *median_out);
+           btree_key_t *median_out, split_policy_t policy = split_policy_t::EVEN);
 
 void merge(value_sizer_t<void> *sizer, leaf_node_t *left, leaf_node_t *right);
 
@@ -139,6 +150,11 @@ bool level(value_sizer_t<void> *sizer, int nodecmp_node_with_sib, leaf_node_t *n
 
 bool is_mergable(value_sizer_t<void> *sizer, const leaf_node_t *node, const leaf_node_t *sibling);
 
+// Drops `node`'s timestamps and deletion entries, and packs its entries together.
+// Backfills then send all of `node`, as they do once its deletion history has been
+// garbage collected.
+void freeze(value_sizer_t<void> *sizer, leaf_node_t *node);
+
 bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out);
 
 bool lookup(value_sizer_t<void> *sizer, const leaf_node_t *node, const btree_key_t *key, void *value_out);
@@ -352,6 +352,41 @@ void ensure_stat_block(superblock_t *sb) {
     }
 }
 
+int64_t get_btree_population(superblock_t *sb) {
+    const block_id_t stat_block_id = sb->get_stat_block_id();
+    txn_t *txn = sb->expose_buf().txn();
+    sb->release();
+    if (stat_block_id == NULL_BLOCK_ID) {
+        // Nothing has ever been written to the btree.
+        return 0;
+    }
+    buf_lock_t stat_block(buf_parent_t(txn), stat_block_id, access_t::read);
+    buf_read_t read(&stat_block);
+    return static_cast<const btree_statblock_t *>(read.get_data_read())->population;
+}
+
+block_id_t peek_leaf_for_key(cache_t *cache, block_id_t root_id,
+                             const btree_key_t *key) {
+    ASSERT_NO_CORO_WAITING;
+    block_id_t node_id = root_id;
+    for (;;) {
+        bool write_waiting;
+        const void *data = cache->peek_block(node_id, &write_waiting);
+        if (data == NULL) {
+            return NULL_BLOCK_ID;
+        }
+        if (!node::is_internal(static_cast<const node_t *>(data))) {
+            // A writer that's merely in line for an internal node hasn't changed
+            // anything yet, and will get in line for the leaf after us.  But one
+            // that's already in line for the leaf would get to it first.
+            return write_waiting ? NULL_BLOCK_ID : node_id;
+        }
+        node_id = internal_node::lookup(static_cast<const internal_node_t *>(data),
+                                        key);
+        rassert(node_id != NULL_BLOCK_ID && node_id != SUPERBLOCK_ID);
+    }
+}
+
 buf_lock_t get_root(value_sizer_t<void> *sizer, superblock_t *sb) {
     const block_id_t node_id = sb->get_root_block_id();
 
@@ -391,6 +426,13 @@ void detach_all_children(const node_t *node, buf_parent_t parent,
     }
 }
 
+// Whether `child_id` is the last child of the internal node `parent` holds.
+bool is_last_child(buf_lock_t *parent, block_id_t child_id) {
+    buf_read_t read(parent);
+    auto node = static_cast<const internal_node_t *>(read.get_data_read());
+    return internal_node::get_pair_by_index(node, node->npairs - 1)->lnode == child_id;
+}
+
 // Split the node if necessary. If the node is a leaf_node, provide the new
 // value that will be inserted; if it's an internal node, provide NULL (we
 // split internal nodes proactively).
@@ -402,6 +444,7 @@ void check_and_handle_split(value_sizer_t<void> *sizer,
                             superblock_t *sb,
                             const btree_key_t *key, void *new_value,
                             const value_deleter_t *detacher) {
+    leaf::split_policy_t leaf_split_policy = leaf::split_policy_t::EVEN;
     {
         buf_read_t buf_read(buf);
         const node_t *node = static_cast<const node_t *>(buf_read.get_data_read());
@@ -409,10 +452,17 @@ void check_and_handle_split(value_sizer_t<void> *sizer,
         // If the node isn't full, we don't need to split, so we're done.
         if (!node::is_internal(node)) { // This should only be called when update_needed.
             rassert(new_value);
-            if (!leaf::is_full(sizer, reinterpret_cast<const leaf_node_t *>(node),
-                               key, new_value)) {
+            const leaf_node_t *leaf_node = reinterpret_cast<const leaf_node_t *>(node);
+            if (!leaf::is_full(sizer, leaf_node, key, new_value)) {
                 return;
             }
+            // A key past the end of the last leaf under its parent is most likely
+            // one of a run of increasing keys (timestamps, counters), which would
+            // otherwise leave a trail of half-full leaves.
+            if (leaf::is_past_last_key(leaf_node, key)
+                && (last_buf->empty() || is_last_child(last_buf, buf->block_id()))) {
+                leaf_split_policy = leaf::split_policy_t::APPEND;
+            }
         } else {
             rassert(!new_value);
             if (!internal_node::is_full(reinterpret_cast<const internal_node_t *>(node))) {
@@ -433,15 +483,23 @@ void check_and_handle_split(value_sizer_t<void> *sizer,
     buf_lock_t rbuf(last_buf->empty() ? sb->expose_buf() : buf_parent_t(last_buf),
                     alt_create_t::create);
     store_key_t median_buffer;
-    btree_key_t *median = median_buffer.btree_key();
+    btree_key_t *median = median_buffer.writable_btree_key();
 
     {
         buf_write_t buf_write(buf);
         buf_write_t rbuf_write(&rbuf);
-        node::split(sizer,
-                    static_cast<node_t *>(buf_write.get_data_write()),
-                    static_cast<node_t *>(rbuf_write.get_data_write()),
-                    median);
+        if (leaf_split_policy == leaf::split_policy_t::APPEND) {
+            leaf::split(sizer,
+                        static_cast<leaf_node_t *>(buf_write.get_data_write()),
+                        static_cast<leaf_node_t *>(rbuf_write.get_data_write()),
+                        median,
+                        leaf_split_policy);
+        } else {
+            node::split(sizer,
+                        static_cast<node_t *>(buf_write.get_data_write()),
+                        static_cast<node_t *>(rbuf_write.get_data_write()),
+                        median);
+        }
 
         // We must detach all entries that we have removed from `buf`.
         buf_read_t rbuf_read(&rbuf);
@@ -627,7 +685,7 @@ void check_and_handle_underfull(value_sizer_t<void> *sizer,
         } else {
             // Level.
             store_key_t replacement_key_buffer;
-            btree_key_t *replacement_key = replacement_key_buffer.btree_key();
+            btree_key_t *replacement_key = replacement_key_buffer.writable_btree_key();
 
             bool leveled;
             {
@@ -689,6 +747,331 @@ void check_and_handle_underfull(value_sizer_t<void> *sizer,
     }
 }
 
+// Helper for `freeze_btree_step()`.
+void freeze_leaf(value_sizer_t<void> *sizer, buf_lock_t *buf) {
+    buf_write_t write(buf);
+    leaf::freeze(sizer, static_cast<leaf_node_t *>(write.get_data_write()));
+}
+
+// Helper for `freeze_btree_step()`.  Moves entries from the end of the frozen leaf
+// `left` to the front of its right sibling `right` for as long as they fit, leaving
+// at least `min_left_pairs` in `left`.  Returns the number of entries moved.
+int move_frozen_entries(value_sizer_t<void> *sizer, buf_lock_t *left, buf_lock_t *right,
+                        int min_left_pairs, const value_deleter_t *detacher) {
+    buf_write_t left_write(left);
+    buf_write_t right_write(right);
+    leaf_node_t *lnode = static_cast<leaf_node_t *>(left_write.get_data_write());
+    leaf_node_t *rnode = static_cast<leaf_node_t *>(right_write.get_data_write());
+    int moved = 0;
+    while (lnode->num_pairs > min_left_pairs) {
+        // `left` is frozen, so it has no deletion entries and its last entry is a
+        // live one.
+        const std::pair<const btree_key_t *, const void *> last = *leaf::rbegin(*lnode);
+        if (leaf::is_full(sizer, rnode, last.first, last.second)) {
+            break;
+        }
+        const store_key_t key(last.first);
+        leaf::insert(sizer, rnode, key.btree_key(), last.second,
+                     repli_timestamp_t::distant_past,
+                     key_modification_proof_t::real_proof());
+        detacher->delete_value(buf_parent_t(left), last.second);
+        leaf::erase_presence(sizer, lnode, key.btree_key(),
+                             key_modification_proof_t::real_proof());
+        ++moved;
+    }
+    return moved;
+}
+
+bool freeze_btree_step(value_sizer_t<void> *sizer, superblock_t *sb,
+                       const value_deleter_t *detacher, store_key_t *cursor) {
+    buf_lock_t buf = get_root(sizer, sb);
+    // We never replace the root, so writers can follow us down right away.
+    sb->release();
+
+    bool root_is_leaf;
+    {
+        buf_read_t read(&buf);
+        root_is_leaf = node::is_leaf(static_cast<const node_t *>(read.get_data_read()));
+    }
+    if (root_is_leaf) {
+        freeze_leaf(sizer, &buf);
+        return false;
+    }
+
+    // Walk down to the lowest internal node on the way to `*cursor`, keeping track of
+    // where its key range ends.  Only the last child of a node has no separator key
+    // of its own, and inherits the end of its parent's range.
+    bool bounded = false;
+    store_key_t upper_bound;
+    for (;;) {
+        block_id_t child_id;
+        bool child_bounded = bounded;
+        store_key_t child_upper_bound = upper_bound;
+        {
+            buf_read_t read(&buf);
+            const internal_node_t *node
+                = static_cast<const internal_node_t *>(read.get_data_read());
+            const int index = internal_node::get_offset_index(node, cursor->btree_key());
+            const btree_internal_pair *pair = internal_node::get_pair_by_index(node, index);
+            child_id = pair->lnode;
+            if (index < node->npairs - 1) {
+                child_bounded = true;
+                child_upper_bound.assign(&pair->key);
+            }
+        }
+        buf_lock_t child(&buf, child_id, access_t::write);
+        bool child_is_leaf;
+        {
+            buf_read_t read(&child);
+            child_is_leaf = node::is_leaf(static_cast<const node_t *>(read.get_data_read()));
+        }
+        if (child_is_leaf) {
+            break;
+        }
+        buf = std::move(child);
+        bounded = child_bounded;
+        upper_bound = child_upper_bound;
+    }
+
+    // Pack the leaves of `buf` from right to left, filling up each one from the end of
+    // the one before it.
+    int npairs;
+    block_id_t last_child_id;
+    {
+        buf_read_t read(&buf);
+        const internal_node_t *node
+            = static_cast<const internal_node_t *>(read.get_data_read());
+        npairs = node->npairs;
+        last_child_id = internal_node::get_pair_by_index(node, npairs - 1)->lnode;
+    }
+    buf_lock_t right(&buf, last_child_id, access_t::write);
+    freeze_leaf(sizer, &right);
+    for (int index = npairs - 2; index >= 0; --index) {
+        block_id_t left_id;
+        store_key_t separator;
+        int parent_npairs;
+        bool parent_change_unsafe;
+        {
+            buf_read_t read(&buf);
+            const internal_node_t *node
+                = static_cast<const internal_node_t *>(read.get_data_read());
+            const btree_internal_pair *pair = internal_node::get_pair_by_index(node, index);
+            left_id = pair->lnode;
+            separator.assign(&pair->key);
+            parent_npairs = node->npairs;
+            // If the parent is nearly full, a longer separator key might not fit.
+            parent_change_unsafe = internal_node::change_unsafe(node);
+        }
+        buf_lock_t left(&buf, left_id, access_t::write);
+        freeze_leaf(sizer, &left);
+
+        // An internal node needs at least two children, so the last two can't be
+        // merged.
+        const int moved = parent_change_unsafe ? 0
+            : move_frozen_entries(sizer, &left, &right, parent_npairs > 2 ? 0 : 1,
+                                  detacher);
+        if (moved > 0) {
+            right.manually_touch_recency(superceding_recency(right.get_recency(),
+                                                             left.get_recency()));
+            // The moved entries came with timestamps.
+            freeze_leaf(sizer, &right);
+
+            bool left_is_empty;
+            store_key_t new_separator;
+            {
+                buf_read_t left_read(&left);
+                buf_read_t right_read(&right);
+                const leaf_node_t *lnode
+                    = static_cast<const leaf_node_t *>(left_read.get_data_read());
+                const leaf_node_t *rnode
+                    = static_cast<const leaf_node_t *>(right_read.get_data_read());
+                left_is_empty = leaf::is_empty(lnode);
+                if (!left_is_empty) {
+                    get_shortest_separator((*leaf::rbegin(*lnode)).first,
+                                           (*leaf::begin(*rnode)).first,
+                                           new_separator.writable_btree_key());
+                }
+            }
+
+            if (left_is_empty) {
+                left.mark_deleted();
+                left.reset_buf_lock();
+                buf_write_t write(&buf);
+                internal_node::remove(sizer->block_size(),
+                                      static_cast<internal_node_t *>(write.get_data_write()),
+                                      separator.btree_key());
+                // `right` now takes the range of `left`, and stays where it is.
+                continue;
+            }
+
+            buf_write_t write(&buf);
+            internal_node::update_key(static_cast<internal_node_t *>(write.get_data_write()),
+                                      separator.btree_key(),
+                                      new_separator.btree_key());
+        }
+        right = std::move(left);
+    }
+    right.reset_buf_lock();
+
+    if (!bounded) {
+        return false;
+    }
+    *cursor = upper_bound;
+    return cursor->increment();
+}
+
+// The nodes of one level of a tree that `bulk_load_btree()` is building, from left to
+// right.  `separators[i]` is the key that separates the subtree of `block_ids[i]`
+// from the one of `block_ids[i + 1]`.
+struct bulk_load_level_t {
+    std::vector<block_id_t> block_ids;
+    std::vector<store_key_t> separators;
+};
+
+// Fills `node` with pointers to the nodes [beg, end) of `level`.
+void fill_bulk_load_internal_node(block_size_t block_size,
+                                  const bulk_load_level_t &level,
+                                  size_t beg, size_t end,
+                                  internal_node_t *node) {
+    guarantee(end - beg >= 2);
+    internal_node::init(block_size, node);
+    for (size_t i = beg + 1; i < end; ++i) {
+        bool inserted = internal_node::insert(block_size, node,
+                                              level.separators[i - 1].btree_key(),
+                                              level.block_ids[i - 1],
+                                              level.block_ids[i]);
+        guarantee(inserted);
+    }
+}
+
+// Builds the level of internal nodes above `level`, filling up each node as far as
+// `internal_node::is_full()` allows.
+void build_bulk_load_level(block_size_t block_size, superblock_t *sb,
+                           const bulk_load_level_t &level,
+                           bulk_load_level_t *parent_level_out) {
+    rassert(level.block_ids.size() >= 2);
+    rassert(level.separators.size() + 1 == level.block_ids.size());
+
+    // Find out how many nodes fit into each parent by filling a scratch node.
+    std::vector<size_t> group_ends;
+    {
+        scoped_malloc_t<internal_node_t> scratch(block_size.value());
+        size_t beg = 0;
+        while (beg < level.block_ids.size()) {
+            internal_node::init(block_size, scratch.get());
+            size_t end = beg + 1;
+            while (end < level.block_ids.size()
+                   && !internal_node::is_full(scratch.get())) {
+                bool inserted = internal_node::insert(block_size, scratch.get(),
+                                                      level.separators[end - 1].btree_key(),
+                                                      level.block_ids[end - 1],
+                                                      level.block_ids[end]);
+                guarantee(inserted);
+                ++end;
+            }
+            group_ends.push_back(end);
+            beg = end;
+        }
+    }
+
+    // An internal node needs at least two children, so if the last one would only
+    // get one, it takes the last child of the one before, which is full and has
+    // plenty to spare.
+    if (group_ends.size() >= 2
+        && group_ends[group_ends.size() - 1] - group_ends[group_ends.size() - 2] == 1) {
+        --group_ends[group_ends.size() - 2];
+    }
+
+    parent_level_out->block_ids.clear();
+    parent_level_out->separators.clear();
+    size_t beg = 0;
+    for (size_t i = 0; i < group_ends.size(); ++i) {
+        const size_t end = group_ends[i];
+        if (beg > 0) {
+            parent_level_out->separators.push_back(level.separators[beg - 1]);
+        }
+        buf_lock_t node_buf(sb->expose_buf(), alt_create_t::create);
+        {
+            buf_write_t write(&node_buf);
+            fill_bulk_load_internal_node(
+                block_size, level, beg, end,
+                static_cast<internal_node_t *>(write.get_data_write()));
+        }
+        parent_level_out->block_ids.push_back(node_buf.block_id());
+        beg = end;
+    }
+}
+
+int64_t bulk_load_btree(value_sizer_t<void> *sizer, superblock_t *sb,
+                        repli_timestamp_t tstamp, bulk_load_source_t *source) {
+    // An empty tree either has no root or an empty root leaf, which we get rid of.
+    const block_id_t old_root_id = sb->get_root_block_id();
+    if (old_root_id != NULL_BLOCK_ID) {
+        buf_lock_t old_root(sb->expose_buf(), old_root_id, access_t::write);
+        {
+            buf_read_t read(&old_root);
+            const node_t *node = static_cast<const node_t *>(read.get_data_read());
+            guarantee(node::is_leaf(node)
+                      && leaf::is_empty(reinterpret_cast<const leaf_node_t *>(node)),
+                      "bulk_load_btree() called on a tree that isn't empty");
+        }
+        old_root.mark_deleted();
+        sb->set_root_block_id(NULL_BLOCK_ID);
+    }
+
+    // Like `check_and_handle_split()`, we create all new nodes as children of the
+    // superblock, since we don't know their parents yet.
+    bulk_load_level_t level;
+    scoped_malloc_t<char> value(sizer->max_possible_size());
+    store_key_t key;
+    store_key_t last_key;
+    int64_t num_pairs = 0;
+    bool have_pair = source->next(sb->expose_buf(), &key, value.get());
+    while (have_pair) {
+        buf_lock_t leaf_buf(sb->expose_buf(), alt_create_t::create);
+        buf_write_t write(&leaf_buf);
+        leaf_node_t *leaf = static_cast<leaf_node_t *>(write.get_data_write());
+        leaf::init(sizer, leaf);
+
+        if (!level.block_ids.empty()) {
+            store_key_t separator;
+            get_shortest_separator(last_key.btree_key(), key.btree_key(),
+                                   separator.writable_btree_key());
+            level.separators.push_back(separator);
+        }
+        level.block_ids.push_back(leaf_buf.block_id());
+
+        // Any pair fits into an empty leaf.
+        do {
+            guarantee(num_pairs == 0 || last_key < key,
+                      "bulk_load_btree() got keys out of order");
+            leaf::insert(sizer, leaf, key.btree_key(), value.get(), tstamp,
+                         key_modification_proof_t::real_proof());
+            last_key = key;
+            ++num_pairs;
+            have_pair = source->next(sb->expose_buf(), &key, value.get());
+        } while (have_pair && !leaf::is_full(sizer, leaf, key.btree_key(), value.get()));
+    }
+
+    while (level.block_ids.size() > 1) {
+        bulk_load_level_t parent_level;
+        build_bulk_load_level(sizer->block_size(), sb, level, &parent_level);
+        level = std::move(parent_level);
+    }
+    if (!level.block_ids.empty()) {
+        insert_root(level.block_ids[0], sb);
+    }
+
+    ensure_stat_block(sb);
+    buf_lock_t stat_block(buf_parent_t(sb->expose_buf().txn()),
+                          sb->get_stat_block_id(), access_t::write);
+    buf_write_t stat_block_write(&stat_block);
+    static_cast<btree_statblock_t *>(stat_block_write.get_data_write())->population
+        += num_pairs;
+
+    return num_pairs;
+}
+
 void get_btree_superblock(txn_t *txn, access_t access,
                           scoped_ptr_t<real_superblock_t> *got_superblock_out) {
     buf_lock_t tmp_buf(buf_parent_t(txn), SUPERBLOCK_ID, access);
@@ -702,8 +1085,10 @@ void get_btree_superblock_and_txn(cache_conn_t *cache_conn,
                                   repli_timestamp_t tstamp,
                                   write_durability_t durability,
                                   scoped_ptr_t<real_superblock_t> *got_superblock_out,
-                                  scoped_ptr_t<txn_t> *txn_out) {
-    txn_t *txn = new txn_t(cache_conn, durability, tstamp, expected_change_count);
+                                  scoped_ptr_t<txn_t> *txn_out,
+                                  semaphore_priority_t throttle_priority) {
+    txn_t *txn = new txn_t(cache_conn, durability, tstamp, expected_change_count,
+                           throttle_priority);
 
     txn_out->init(txn);
 
@@ -158,6 +158,21 @@ class null_key_modification_callback_t : public key_modification_callback_t<Valu
     }
 };
 
+// Gets the values `find_keyvalue_locations_for_read` finds.
+template <class Value>
+class multi_key_read_callback_t {
+public:
+    // `value` is the value of the `i`th key, in the leaf node `leaf`, which is held
+    // until this returns.
+    virtual void on_value(size_t i, const Value *value, buf_lock_t *leaf) = 0;
+
+    multi_key_read_callback_t() { }
+protected:
+    virtual ~multi_key_read_callback_t() { }
+private:
+    DISABLE_COPYING(multi_key_read_callback_t);
+};
+
 
 /* This iterator encapsulates most of the metainfo data layout. Unfortunately,
  * functions set_superblock_metainfo and delete_superblock_metainfo also know a
@@ -221,6 +236,46 @@ void check_and_handle_underfull(value_sizer_t<void> *sizer,
                                 const btree_key_t *key,
                                 const value_deleter_t *detacher);
 
+/* `bulk_load_source_t` supplies the key/value pairs for `bulk_load_btree()`. */
+class bulk_load_source_t {
+public:
+    /* Sets `*key_out` to the next key, which must be greater than the one before,
+    writes its value to `value_out`, which has room for `max_possible_size()` bytes,
+    and returns true.  Returns false if there are no more pairs.  Blocks that the
+    value refers to should be created as children of `parent`. */
+    virtual bool next(buf_parent_t parent, store_key_t *key_out, void *value_out) = 0;
+
+protected:
+    bulk_load_source_t() { }
+    virtual ~bulk_load_source_t() { }
+
+private:
+    DISABLE_COPYING(bulk_load_source_t);
+};
+
+/* Fills the empty tree of `sb` with the pairs from `source`, building it from the
+bottom up: each leaf is filled up before the next one is started, and then each
+level of internal nodes is built over the one below it.  Inserting the pairs one by
+one would split leaves over and over, leave them half full and touch the same path
+from the root every time.  The tree must have no root or an empty root leaf.
+Returns the number of pairs loaded. */
+int64_t bulk_load_btree(value_sizer_t<void> *sizer, superblock_t *sb,
+                        repli_timestamp_t tstamp, bulk_load_source_t *source);
+
+/* Freezes the leaves under the lowest internal node of the tree of `sb` whose key
+range contains `*cursor` (see `leaf::freeze()`), and packs their entries into as few
+of them as they fit in, removing the ones that get emptied from the internal node.
+`detacher` detaches the values that move to another leaf.  Releases `sb` once it has
+the root, since the tree's shape above the leaves doesn't change.
+
+Returns false if that was the last such node.  Otherwise sets `*cursor` to the first
+key of the next one's range and returns true, so a whole tree gets frozen by calling
+this with `*cursor` starting at `store_key_t::min()` until it returns false, each
+time in a new write transaction.  The internal nodes may be left underfull, until the
+next write through them merges them. */
+bool freeze_btree_step(value_sizer_t<void> *sizer, superblock_t *sb,
+                       const value_deleter_t *detacher, store_key_t *cursor);
+
 // Metainfo functions
 bool get_superblock_metainfo(buf_lock_t *superblock,
                              const std::vector<char> &key,
@@ -244,6 +299,19 @@ void insert_root(block_id_t root_id, superblock_t *sb);
 /* Create a stat block for the superblock if it doesn't already have one. */
 void ensure_stat_block(superblock_t *sb);
 
+/* Returns the number of keys in the btree, as recorded in its stat block, and
+releases sb.  Changes that are still in flight in other transactions may or may
+not be counted. */
+int64_t get_btree_population(superblock_t *sb);
+
+/* Walks from the root to the leaf that would hold `key` by peeking at the cached
+nodes instead of acquiring them, so it doesn't wait in line behind writers.  It
+doesn't block, so the path it sees is consistent.  Returns NULL_BLOCK_ID if a node
+on the way isn't in memory or is held by a writer, or if a writer is in line for the
+leaf (which could change the leaf before a reader that gets in line after it). */
+block_id_t peek_leaf_for_key(cache_t *cache, block_id_t root_id,
+                             const btree_key_t *key);
+
 void get_btree_superblock(txn_t *txn, access_t access,
                           scoped_ptr_t<real_superblock_t> *got_superblock_out);
 
@@ -253,7 +321,9 @@ void get_btree_superblock_and_txn(cache_conn_t *cache_conn,
                                   repli_timestamp_t tstamp,
                                   write_durability_t durability,
                                   scoped_ptr_t<real_superblock_t> *got_superblock_out,
-                                  scoped_ptr_t<txn_t> *txn_out);
+                                  scoped_ptr_t<txn_t> *txn_out,
+                                  semaphore_priority_t throttle_priority
+                                      = semaphore_priority_t::normal);
 
 void get_btree_superblock_and_txn_for_backfilling(cache_conn_t *cache_conn,
                                                   cache_account_t *backfill_account,
@@ -75,8 +75,17 @@ void find_keyvalue_location_for_write(
         // Release the superblock, if we've gone past the root (and haven't
         // already released it). If we're still at the root or at one of
         // its direct children, we might still want to replace the root, so
-        // we can't release the superblock yet.
-        if (!last_buf.empty() && keyvalue_location_out->superblock) {
+        // we can't release the superblock yet -- unless the root has more than
+        // two children.  Then splitting or merging one of them can't replace the
+        // root (the root isn't full, or it would have been split above), so we
+        // let the next writer have the superblock before acquiring the child.
+        bool root_stays = false;
+        if (last_buf.empty()) {
+            buf_read_t read(&buf);
+            root_stays = !internal_node::is_singleton(
+                static_cast<const internal_node_t *>(read.get_data_read()));
+        }
+        if ((!last_buf.empty() || root_stays) && keyvalue_location_out->superblock) {
             if (pass_back_superblock != NULL) {
                 pass_back_superblock->pulse(superblock);
                 keyvalue_location_out->superblock = NULL;
@@ -107,6 +116,8 @@ void find_keyvalue_location_for_write(
         }
     }
 
+    stats->pm_hot_keys.record(key, buf.block_id(), access_t::write);
+
     {
         scoped_malloc_t<Value> tmp(sizer.max_possible_size());
 
@@ -125,6 +136,64 @@ void find_keyvalue_location_for_write(
     keyvalue_location_out->buf.swap(buf);
 }
 
+/* Returns true if `key` goes in the leaf `kv_loc` holds, which
+ * `find_keyvalue_location_for_write` found for another key (and which may have been
+ * changed through `kv_loc` since), and if changing the leaf for `key` can't need
+ * nodes that `kv_loc` doesn't hold.  The walk down the tree made sure the parent has
+ * room for a split of the leaf, and isn't underfull, so this checks that it still
+ * does and isn't. */
+template <class Value>
+bool keyvalue_location_holds_key(keyvalue_location_t<Value> *kv_loc,
+                                 const btree_key_t *key) {
+    if (kv_loc->last_buf.empty()) {
+        // The leaf is the root, which every key goes in.  Splitting it takes the
+        // superblock, which `kv_loc` holds unless it was released.
+        return kv_loc->superblock != NULL;
+    }
+    if (kv_loc->superblock != NULL
+        && kv_loc->superblock->get_root_block_id() != kv_loc->last_buf.block_id()) {
+        // A merge made the leaf the root, and deleted its parent.
+        return false;
+    }
+    buf_read_t read(&kv_loc->last_buf);
+    auto parent = static_cast<const internal_node_t *>(read.get_data_read());
+    // The parent may be the root if `kv_loc` still holds the superblock, and the
+    // root is never underfull.  If it was released, the parent may still be a root
+    // with more than two children, and a merge mustn't leave it with one.
+    return !internal_node::is_full(parent)
+        && (kv_loc->superblock != NULL
+            || (!internal_node::is_underfull(kv_loc->buf.cache()->get_block_size(),
+                                             parent)
+                && !internal_node::is_singleton(parent)))
+        && internal_node::lookup(parent, key) == kv_loc->buf.block_id();
+}
+
+/* Points `kv_loc` at `key`, in the same leaf, if `keyvalue_location_holds_key` says
+ * it can, so that keys in the same leaf can be written without walking down the tree
+ * for each of them.  Returns false, and leaves `kv_loc` alone, if it can't. */
+template <class Value>
+bool move_keyvalue_location_for_write(keyvalue_location_t<Value> *kv_loc,
+                                      const btree_key_t *key) {
+    if (!keyvalue_location_holds_key(kv_loc, key)) {
+        return false;
+    }
+    value_sizer_t<Value> sizer(kv_loc->buf.cache()->max_block_size());
+    kv_loc->stats->pm_hot_keys.record(key, kv_loc->buf.block_id(), access_t::write);
+
+    scoped_malloc_t<Value> tmp(sizer.max_possible_size());
+    {
+        buf_read_t read(&kv_loc->buf);
+        auto node = static_cast<const leaf_node_t *>(read.get_data_read());
+        kv_loc->there_originally_was_value = leaf::lookup(&sizer, node, key, tmp.get());
+    }
+    if (kv_loc->there_originally_was_value) {
+        kv_loc->value = std::move(tmp);
+    } else {
+        kv_loc->value.reset();
+    }
+    return true;
+}
+
 template <class Value>
 void find_keyvalue_location_for_read(
         superblock_t *superblock, const btree_key_t *key,
@@ -142,8 +211,22 @@ void find_keyvalue_location_for_read(
         return;
     }
 
+    // If the whole path is in memory, we skip straight to the leaf instead of
+    // waiting in line for every node on the way (behind writers, on the nodes near
+    // the root).  Snapshotted reads have to go through the parent for each node.
+    const block_id_t leaf_id = superblock->expose_buf().is_snapshotted()
+        ? NULL_BLOCK_ID
+        : peek_leaf_for_key(superblock->cache(), root_id, key);
+
     buf_lock_t buf;
-    {
+    if (leaf_id != NULL_BLOCK_ID) {
+        // We get in line for the leaf without blocking after peeking at the path, so
+        // the leaf we'll read is the one the path led to.
+        buf_lock_t tmp(buf_parent_t(superblock->expose_buf().txn()), leaf_id,
+                       access_t::read);
+        superblock->release();
+        buf = std::move(tmp);
+    } else {
         profile::starter_t starter("Acquire a block for read.", trace);
         buf_lock_t tmp(superblock->expose_buf(), root_id, access_t::read);
         superblock->release();
@@ -157,6 +240,7 @@ void find_keyvalue_location_for_read(
     }
 #endif  // NDEBUG
 
+    // This walks down the tree if we didn't go straight to the leaf.
     for (;;) {
         block_id_t node_id;
         {
@@ -186,6 +270,8 @@ void find_keyvalue_location_for_read(
 #endif  // NDEBUG
     }
 
+    stats->pm_hot_keys.record(key, buf.block_id(), access_t::read);
+
     // Got down to the leaf, now probe it.
     scoped_malloc_t<Value> value(sizer.max_possible_size());
     bool value_found;
@@ -202,6 +288,112 @@ void find_keyvalue_location_for_read(
     }
 }
 
+// Looks up `keys[begin]` through `keys[end - 1]` in the subtree rooted at `buf`.
+template <class Value>
+void find_keyvalues_in_subtree(
+        value_sizer_t<Value> *sizer, buf_lock_t *buf,
+        const std::vector<const btree_key_t *> &keys, size_t begin, size_t end,
+        multi_key_read_callback_t<Value> *cb,
+        btree_stats_t *stats, profile::trace_t *trace) {
+#ifndef NDEBUG
+    {
+        buf_read_t read(buf);
+        node::validate(sizer, static_cast<const node_t *>(read.get_data_read()));
+    }
+#endif  // NDEBUG
+
+    // The children the keys lead to, each with the end of its run of keys.
+    std::vector<std::pair<block_id_t, size_t> > children;
+    std::vector<std::pair<size_t, scoped_malloc_t<Value> > > values;
+    {
+        buf_read_t read(buf);
+        const void *data = read.get_data_read();
+        if (node::is_internal(static_cast<const node_t *>(data))) {
+            auto node = static_cast<const internal_node_t *>(data);
+            for (size_t i = begin; i < end; ++i) {
+                const block_id_t child_id = internal_node::lookup(node, keys[i]);
+                rassert(child_id != NULL_BLOCK_ID && child_id != SUPERBLOCK_ID);
+                if (children.empty() || children.back().first != child_id) {
+                    children.push_back(std::make_pair(child_id, i + 1));
+                } else {
+                    children.back().second = i + 1;
+                }
+            }
+        } else {
+            auto leaf = static_cast<const leaf_node_t *>(data);
+            for (size_t i = begin; i < end; ++i) {
+                scoped_malloc_t<Value> value(sizer->max_possible_size());
+                if (leaf::lookup(sizer, leaf, keys[i], value.get())) {
+                    values.push_back(std::make_pair(i, std::move(value)));
+                }
+            }
+        }
+    }
+
+    if (children.empty()) {
+        for (size_t i = begin; i < end; ++i) {
+            stats->pm_hot_keys.record(keys[i], buf->block_id(), access_t::read);
+        }
+        for (auto it = values.begin(); it != values.end(); ++it) {
+            cb->on_value(it->first, it->second.get(), buf);
+        }
+        return;
+    }
+
+    // We get in line for all the children before letting go of this node, like the
+    // single key lookup does for its one child.
+    std::vector<buf_lock_t> child_bufs;
+    child_bufs.reserve(children.size());
+    {
+        profile::starter_t starter("Acquire blocks for read.", trace);
+        for (auto it = children.begin(); it != children.end(); ++it) {
+            child_bufs.emplace_back(buf, it->first, access_t::read);
+        }
+    }
+    buf->reset_buf_lock();
+
+    size_t child_begin = begin;
+    for (size_t i = 0; i < children.size(); ++i) {
+        find_keyvalues_in_subtree(sizer, &child_bufs[i], keys,
+                                  child_begin, children[i].second, cb, stats, trace);
+        child_bufs[i].reset_buf_lock();
+        child_begin = children[i].second;
+    }
+}
+
+// Looks up all of `keys`, which must be sorted, in one walk down the tree, so that
+// the nodes on the way to several of the keys are only acquired once.  Calls `cb`
+// for each key that has a value, in order.
+template <class Value>
+void find_keyvalue_locations_for_read(
+        superblock_t *superblock, const std::vector<const btree_key_t *> &keys,
+        multi_key_read_callback_t<Value> *cb,
+        btree_stats_t *stats, profile::trace_t *trace) {
+    for (size_t i = 0; i < keys.size(); ++i) {
+        stats->pm_keys_read.record();
+    }
+    value_sizer_t<Value> sizer(superblock->cache()->max_block_size());
+
+    const block_id_t root_id = superblock->get_root_block_id();
+    rassert(root_id != SUPERBLOCK_ID);
+
+    if (root_id == NULL_BLOCK_ID || keys.empty()) {
+        // There is no root, so the tree is empty.
+        superblock->release();
+        return;
+    }
+
+    buf_lock_t buf;
+    {
+        profile::starter_t starter("Acquire a block for read.", trace);
+        buf_lock_t tmp(superblock->expose_buf(), root_id, access_t::read);
+        superblock->release();
+        buf = std::move(tmp);
+    }
+
+    find_keyvalues_in_subtree(&sizer, &buf, keys, 0, keys.size(), cb, stats, trace);
+}
+
 enum class expired_t { NO, YES };
 
 template <class Value>
@@ -292,9 +484,13 @@ void apply_keyvalue_change(keyvalue_location_t<Value> *kv_loc,
     }
 
     // Check to see if the leaf is underfull (following a change in
-    // size or a deletion, and merge/level if it is.
-    check_and_handle_underfull(&sizer, &kv_loc->buf, &kv_loc->last_buf,
-                               kv_loc->superblock, key, detacher);
+    // size or a deletion, and merge/level if it is.  A leaf that just got a new key
+    // didn't shrink, so it's only underfull if an append split left it that way
+    // on purpose (see `leaf::split_policy_t`); leveling it would undo that.
+    if (population_change != 1) {
+        check_and_handle_underfull(&sizer, &kv_loc->buf, &kv_loc->last_buf,
+                                   kv_loc->superblock, key, detacher);
+    }
 
     // Modify the stats block.  The stats block is detached from the rest of the
     // btree, we don't keep a consistent view of it, so we pass the txn as its
@@ -6,6 +6,7 @@
 #include "btree/internal_node.hpp"
 #include "btree/node.hpp"
 #include "btree/operations.hpp"
+#include "buffer_cache/alt/alt.hpp"
 #include "concurrency/coro_pool.hpp"
 #include "concurrency/queue/unlimited_fifo.hpp"
 
@@ -69,8 +70,14 @@
 class parent_releaser_t;
 
 struct acquisition_waiter_callback_t {
+    acquisition_waiter_callback_t() : prefetched(false) { }
     virtual void you_may_acquire() = 0;
     virtual void cancel() = 0;
+    // Starts loading the block that `you_may_acquire()` will acquire.
+    virtual void prefetch() = 0;
+
+    // Set by `traversal_state_t` once it has called `prefetch()`.
+    bool prefetched;
 protected:
     virtual ~acquisition_waiter_callback_t() { }
 };
@@ -84,6 +91,7 @@ public:
           helper(_helper),
           interruptor(_interruptor),
           interrupted(false),
+          num_prefetched(0),
           coro_pool(4, &pending_acquires, this)
     {
         interruptor_watcher.parent = this;
@@ -172,6 +180,9 @@ public:
                     while (diff > 0 && !acquisition_waiter_stacks[i].empty()) {
                         acquisition_waiter_callback_t *waiter_cb = acquisition_waiter_stacks[i].back();
                         acquisition_waiter_stacks[i].pop_back();
+                        if (waiter_cb->prefetched) {
+                            --num_prefetched;
+                        }
 
                         // Spawn a coroutine so that it's safe to acquire
                         // blocks.
@@ -181,6 +192,7 @@ public:
                     }
                 }
             }
+            prefetch_upcoming();
         }
 
         if (total_level_count() == 0) {
@@ -188,6 +200,32 @@ public:
         }
     }
 
+    // The level limits above keep the number of blocks we hold small, but they
+    // would also cap how many reads we have in flight.  So we start loading the
+    // blocks that the waiters on top of the stacks (which are the next to be
+    // acquired) will need, deepest level first, until
+    // PARALLEL_TRAVERSAL_PREFETCH_WINDOW loaded-but-not-yet-acquired blocks are
+    // outstanding.  The reads go through the traversal's cache account, so the
+    // window is a limit on how far this traversal gets ahead of itself on the
+    // account's file_account_t queue.
+    void prefetch_upcoming() {
+        for (int i = acquisition_waiter_stacks.size() - 1;
+             i >= 0 && num_prefetched < PARALLEL_TRAVERSAL_PREFETCH_WINDOW; --i) {
+            std::vector<acquisition_waiter_callback_t *> *stack
+                = &acquisition_waiter_stacks[i];
+            for (auto it = stack->rbegin();
+                 it != stack->rend()
+                     && num_prefetched < PARALLEL_TRAVERSAL_PREFETCH_WINDOW;
+                 ++it) {
+                if (!(*it)->prefetched) {
+                    (*it)->prefetched = true;
+                    ++num_prefetched;
+                    (*it)->prefetch();
+                }
+            }
+        }
+    }
+
     void coro_pool_callback(acquisition_waiter_callback_t *waiter_cb, UNUSED signal_t *pool_interruptor) {
         waiter_cb->you_may_acquire();
     }
@@ -228,6 +266,10 @@ public:
     }
 
 private:
+    // The number of waiters in `acquisition_waiter_stacks` whose blocks we've
+    // started loading.
+    int64_t num_prefetched;
+
     unlimited_fifo_queue_t<acquisition_waiter_callback_t *> pending_acquires;
     coro_pool_t<acquisition_waiter_callback_t *> coro_pool;
     DISABLE_COPYING(traversal_state_t);
@@ -290,6 +332,12 @@ struct acquire_a_node_fsm_t : public acquisition_waiter_callback_t {
         delete this;
         local_cb->on_cancel();
     }
+
+    void prefetch() {
+        txn_t *txn = parent.txn();
+        txn->cache()->prefetch_blocks(std::vector<block_id_t>(1, block_id),
+                                      txn->account());
+    }
 };
 
 
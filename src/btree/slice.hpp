@@ -5,6 +5,8 @@
 #include <string>
 #include <vector>
 
+#include "btree/hot_keys.hpp"
+#include "btree/key_filter.hpp"
 #include "buffer_cache/types.hpp"
 #include "buffer_cache/alt/cache_account.hpp"
 #include "containers/scoped.hpp"
@@ -26,10 +28,13 @@ public:
           pm_keys_read(secs_to_ticks(1)),
           pm_keys_set(secs_to_ticks(1)),
           pm_keys_expired(secs_to_ticks(1)),
+          pm_keys_filtered(secs_to_ticks(1)),
           pm_keys_membership(&btree_collection,
               &pm_keys_read, "keys_read",
               &pm_keys_set, "keys_set",
-              &pm_keys_expired, "keys_expired")
+              &pm_keys_expired, "keys_expired",
+              &pm_keys_filtered, "keys_filtered",
+              &pm_hot_keys, "hot_keys")
     { }
 
     perfmon_collection_t btree_collection;
@@ -37,7 +42,10 @@ public:
     perfmon_rate_monitor_t
         pm_keys_read,
         pm_keys_set,
-        pm_keys_expired;
+        pm_keys_expired,
+        // Lookups that the key filter answered without walking the tree.
+        pm_keys_filtered;
+    btree_hot_keys_t pm_hot_keys;
     perfmon_multi_membership_t pm_keys_membership;
 };
 
@@ -64,6 +72,10 @@ public:
 
     btree_stats_t stats;
 
+    // Only built for the primary btrees of rdb stores; the other slices' filters say
+    // yes to everything.
+    key_filter_t key_filter;
+
 private:
     cache_t *cache_;
 
@@ -0,0 +1,107 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "btree/subtree_eraser.hpp"
+
+#include <functional>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "btree/btree_store.hpp"
+#include "btree/internal_node.hpp"
+#include "btree/leaf_node.hpp"
+#include "btree/node.hpp"
+#include "config/args.hpp"
+#include "utils.hpp"
+
+background_subtree_eraser_t::background_subtree_eraser_t(
+        cache_t *cache,
+        value_sizer_t<void> *sizer,
+        const value_deleter_t *deleter)
+    : cache_conn_(cache),
+      sizer_(sizer),
+      deleter_(deleter),
+      erasing_(false) { }
+
+background_subtree_eraser_t::~background_subtree_eraser_t() {
+    assert_thread();
+}
+
+void background_subtree_eraser_t::erase_subtree(block_id_t subtree_root,
+                                                block_id_t stat_block) {
+    assert_thread();
+    pending_.push_back(std::make_pair(subtree_root, stat_block));
+    if (!erasing_) {
+        erasing_ = true;
+        coro_t::spawn_sometime(
+            std::bind(&background_subtree_eraser_t::erase_in_background,
+                      this, drainer_.lock()));
+    }
+}
+
+bool background_subtree_eraser_t::is_idle() const {
+    assert_thread();
+    return !erasing_;
+}
+
+void background_subtree_eraser_t::erase_in_background(auto_drainer_t::lock_t lock) {
+    with_priority_t p(CORO_PRIORITY_SUBTREE_ERASER);
+    try {
+        while (!pending_.empty()) {
+            erase_batch();
+            nap(SUBTREE_ERASER_BATCH_INTERVAL_MS, lock.get_drain_signal());
+        }
+    } catch (const interrupted_exc_t &) {
+        // We're being destroyed; whatever is left in `pending_` gets leaked.
+    }
+    erasing_ = false;
+}
+
+void background_subtree_eraser_t::erase_batch() {
+    txn_t txn(&cache_conn_, write_durability_t::SOFT,
+              repli_timestamp_t::distant_past, SUBTREE_ERASER_NODES_PER_BATCH,
+              semaphore_priority_t::background);
+    scoped_malloc_t<char> value(sizer_->max_possible_size());
+
+    for (int i = 0; i < SUBTREE_ERASER_NODES_PER_BATCH && !pending_.empty(); ++i) {
+        const block_id_t block_id = pending_.back().first;
+        const block_id_t stat_block = pending_.back().second;
+        pending_.pop_back();
+
+        buf_lock_t node_lock(buf_parent_t(&txn), block_id, access_t::write);
+        int population_change = 0;
+        {
+            buf_write_t write(&node_lock);
+            node_t *node = static_cast<node_t *>(write.get_data_write());
+            if (node::is_leaf(node)) {
+                const leaf_node_t *leaf = reinterpret_cast<const leaf_node_t *>(node);
+                for (auto it = leaf::begin(*leaf); it != leaf::end(*leaf); ++it) {
+                    // Deleting a value can change it in place, which would confuse
+                    // the iteration, so we delete a copy.
+                    const void *v = (*it).second;
+                    memcpy(value.get(), v, sizer_->size(v));
+                    deleter_->delete_value(buf_parent_t(&node_lock), value.get());
+                    --population_change;
+                }
+            } else {
+                const internal_node_t *internal
+                    = reinterpret_cast<const internal_node_t *>(node);
+                for (int j = 0; j < internal->npairs; ++j) {
+                    const block_id_t child_id
+                        = internal_node::get_pair_by_index(internal, j)->lnode;
+                    node_lock.detach_child(child_id);
+                    pending_.push_back(std::make_pair(child_id, stat_block));
+                }
+            }
+        }
+        node_lock.mark_deleted();
+        node_lock.reset_buf_lock();
+
+        if (population_change != 0 && stat_block != NULL_BLOCK_ID) {
+            // The stat block has no parent, and changes to it are commutative.
+            buf_lock_t stat_lock(buf_parent_t(&txn), stat_block, access_t::write);
+            buf_write_t stat_write(&stat_lock);
+            auto stat_block_buf
+                = static_cast<btree_statblock_t *>(stat_write.get_data_write());
+            stat_block_buf->population += population_change;
+        }
+    }
+}
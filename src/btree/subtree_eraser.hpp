@@ -0,0 +1,60 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BTREE_SUBTREE_ERASER_HPP_
+#define BTREE_SUBTREE_ERASER_HPP_
+
+#include <utility>
+#include <vector>
+
+#include "buffer_cache/alt/alt.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "threading.hpp"
+
+template <class> class value_sizer_t;
+class value_deleter_t;
+
+// Frees subtrees that have been unlinked from a btree (see
+// `btree_detach_erased_subtrees()`), along with the values in their leaves.  The
+// subtrees are freed by a background coroutine, SUBTREE_ERASER_NODES_PER_BATCH
+// nodes per transaction, with a pause of SUBTREE_ERASER_BATCH_INTERVAL_MS after
+// each transaction, so that erasing a large part of a table doesn't starve the
+// table's other work.
+//
+// Subtrees that haven't been freed yet when the eraser is destroyed are leaked,
+// like the blocks of an erase range that got interrupted.
+class background_subtree_eraser_t : public home_thread_mixin_t {
+public:
+    // `sizer` and `deleter` must outlive the eraser.
+    background_subtree_eraser_t(cache_t *cache,
+                                value_sizer_t<void> *sizer,
+                                const value_deleter_t *deleter);
+    ~background_subtree_eraser_t();
+
+    // `subtree_root` must have been detached from its parent, and the transaction
+    // that detached it must have acquired it for write, so that freeing it can't
+    // reach the disk before it's unlinked.  The keys in the subtree get subtracted
+    // from the population in `stat_block`, unless that's NULL_BLOCK_ID.
+    void erase_subtree(block_id_t subtree_root, block_id_t stat_block);
+
+    // True if there are no subtrees left to free.
+    bool is_idle() const;
+
+private:
+    void erase_in_background(auto_drainer_t::lock_t lock);
+    void erase_batch();
+
+    cache_conn_t cache_conn_;
+    value_sizer_t<void> *const sizer_;
+    const value_deleter_t *const deleter_;
+
+    // The parentless nodes that still need to be freed, each with its stat block.
+    // The most recently detached ones are freed first, so this stays about as small
+    // as the height of the trees times their branching factor.
+    std::vector<std::pair<block_id_t, block_id_t> > pending_;
+    bool erasing_;
+
+    auto_drainer_t drainer_;
+
+    DISABLE_COPYING(background_subtree_eraser_t);
+};
+
+#endif  // BTREE_SUBTREE_ERASER_HPP_
@@ -4,6 +4,7 @@
 
 #include "arch/types.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "buffer_cache/alt/block_trace.hpp"
 #include "buffer_cache/alt/stats.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "utils.hpp"
@@ -17,8 +18,13 @@ using alt::page_cache_t;
 using alt::page_t;
 using alt::page_txn_t;
 using alt::tracker_acq_t;
+using alt::txn_flush_t;
 
 const int SOFT_UNWRITTEN_CHANGES_LIMIT = 200;
+// While both wait, queries' write transactions get through this many times as
+// often as background ones (backfilling, secondary index construction).
+const int UNWRITTEN_CHANGES_NORMAL_WEIGHT = 4;
+const int UNWRITTEN_CHANGES_BACKGROUND_WEIGHT = 1;
 
 // There are very few ASSERT_NO_CORO_WAITING calls (instead we have
 // ASSERT_FINITE_CORO_WAITING) because most of the time we're at the mercy of the
@@ -43,19 +49,28 @@ private:
     scoped_ptr_t<current_page_acq_t> current_page_acq_;
 
     // RSP: std::map memory usage.
-    // A NULL pointer associated with a block id indicates that the block is deleted.
+    // A NULL pointer associated with a block id indicates that the block is deleted,
+    // or that it got released with buf_lock_t::release_snapshotted_child.
     std::map<block_id_t, alt_snapshot_node_t *> children_;
 
     // The number of buf_lock_t's referring to this node, plus the number of
     // alt_snapshot_node_t's referring to this node (via its children_ vector).
     int64_t ref_count_;
 
+    // True if some of children_ got released.  New snapshots of the block (at the
+    // same version) can't share this node then, because they might still want
+    // those children.
+    bool released_children_;
+
 
     DISABLE_COPYING(alt_snapshot_node_t);
 };
 
 alt_memory_tracker_t::alt_memory_tracker_t()
-    : unwritten_changes_semaphore_(SOFT_UNWRITTEN_CHANGES_LIMIT) { }
+    : unwritten_changes_semaphore_(SOFT_UNWRITTEN_CHANGES_LIMIT) {
+    unwritten_changes_semaphore_.set_priority_weights(
+        UNWRITTEN_CHANGES_NORMAL_WEIGHT, UNWRITTEN_CHANGES_BACKGROUND_WEIGHT);
+}
 alt_memory_tracker_t::~alt_memory_tracker_t() { }
 
 void alt_memory_tracker_t::inform_memory_change(UNUSED uint64_t in_memory_size,
@@ -65,9 +80,11 @@ void alt_memory_tracker_t::inform_memory_change(UNUSED uint64_t in_memory_size,
 
 // KSI: An interface problem here is that this is measured in blocks while
 // inform_memory_change is measured in bytes.
-tracker_acq_t alt_memory_tracker_t::begin_txn_or_throttle(int64_t expected_change_count) {
+tracker_acq_t alt_memory_tracker_t::begin_txn_or_throttle(
+        int64_t expected_change_count, semaphore_priority_t priority) {
     tracker_acq_t acq;
-    acq.semaphore_acq_.init(&unwritten_changes_semaphore_, expected_change_count);
+    acq.semaphore_acq_.init(&unwritten_changes_semaphore_, expected_change_count,
+                            priority);
     acq.semaphore_acq_.acquisition_signal()->wait();
     return acq;
 }
@@ -80,7 +97,7 @@ cache_t::cache_t(serializer_t *serializer, const alt_cache_config_t &config,
                  perfmon_collection_t *perfmon_collection)
     : stats_(make_scoped<alt_cache_stats_t>(perfmon_collection)),
       tracker_(),
-      page_cache_(serializer, config.page_config, &tracker_) { }
+      page_cache_(serializer, config.page_config, &tracker_, stats_.get()) { }
 
 cache_t::~cache_t() { }
 
@@ -88,6 +105,37 @@ cache_account_t cache_t::create_cache_account(int priority) {
     return page_cache_.create_cache_account(priority);
 }
 
+void cache_t::set_memory_quota(alt_memory_arbiter_t *arbiter,
+                               const cache_memory_quota_t &quota) {
+    assert_thread();
+    memory_arbiter_registration_.reset();
+    if (arbiter != NULL && quota.floor < quota.ceiling) {
+        memory_arbiter_registration_.init(
+            new alt_memory_arbiter_t::registration_t(arbiter,
+                                                     &page_cache_.evicter(),
+                                                     quota));
+    }
+}
+
+void cache_t::enable_warm_up_manifest(const std::string &path) {
+    assert_thread();
+    warm_up_manifest_.reset();
+    warm_up_manifest_.init(new alt::warm_up_manifest_t(&page_cache_, path));
+}
+
+void cache_t::prefetch_blocks(const std::vector<block_id_t> &block_ids,
+                              cache_account_t *account) {
+    assert_thread();
+    for (auto it = block_ids.begin(); it != block_ids.end(); ++it) {
+        page_cache_.prefetch_block(*it, account);
+    }
+}
+
+const void *cache_t::peek_block(block_id_t block_id, bool *write_waiting_out) {
+    assert_thread();
+    return page_cache_.peek_current_page(block_id, write_waiting_out);
+}
+
 alt_snapshot_node_t *
 cache_t::matching_snapshot_node_or_null(block_id_t block_id,
                                         block_version_t block_version) {
@@ -95,7 +143,8 @@ cache_t::matching_snapshot_node_or_null(block_id_t block_id,
     intrusive_list_t<alt_snapshot_node_t> *list
         = &snapshot_nodes_by_block_id_[block_id];
     for (alt_snapshot_node_t *p = list->tail(); p != NULL; p = list->prev(p)) {
-        if (p->current_page_acq_->block_version() == block_version) {
+        if (p->current_page_acq_->block_version() == block_version
+            && !p->released_children_) {
             return p;
         }
     }
@@ -106,6 +155,7 @@ void cache_t::add_snapshot_node(block_id_t block_id,
                                 alt_snapshot_node_t *node) {
     ASSERT_NO_CORO_WAITING;
     snapshot_nodes_by_block_id_[block_id].push_back(node);
+    stats_->snapshotted_version_added();
 }
 
 void cache_t::remove_snapshot_node(block_id_t block_id, alt_snapshot_node_t *node) {
@@ -129,6 +179,7 @@ void cache_t::remove_snapshot_node(block_id_t block_id, alt_snapshot_node_t *nod
             = std::move(pair.second->children_);
         // Step 2. Destroy the node.
         delete pair.second;
+        stats_->snapshotted_version_removed();
 
         // Step 3. Take its children and reduce their reference count, readying them
         // for deletion if necessary.
@@ -155,21 +206,24 @@ txn_t::txn_t(cache_conn_t *cache_conn,
              read_access_t)
     : cache_(cache_conn->cache()),
       cache_account_(cache_->page_cache_.default_reads_account()),
+      profile_counters_(NULL),
       access_(access_t::read),
       durability_(write_durability_t::SOFT) {
     // Right now, cache_conn is only used to control flushing of write txns.  When we
     // need to support other cache_conn_t related features (like read operations
     // magically passing write operations), we'll need to do something fancier with
     // read txns on cache conns.
-    help_construct(repli_timestamp_t::invalid, 0, NULL);
+    help_construct(repli_timestamp_t::invalid, 0, semaphore_priority_t::normal, NULL);
 }
 
 txn_t::txn_t(cache_conn_t *cache_conn,
              write_durability_t durability,
              repli_timestamp_t txn_timestamp,
-             int64_t expected_change_count)
+             int64_t expected_change_count,
+             semaphore_priority_t throttle_priority)
     : cache_(cache_conn->cache()),
       cache_account_(cache_->page_cache_.default_reads_account()),
+      profile_counters_(NULL),
       access_(access_t::write),
       durability_(durability) {
     // Write transactions need to specify a timestamp, even if it's
@@ -183,16 +237,18 @@ txn_t::txn_t(cache_conn_t *cache_conn,
         txn_timestamp = repli_timestamp_t::distant_past;
     }
 
-    help_construct(txn_timestamp, expected_change_count, cache_conn);
+    help_construct(txn_timestamp, expected_change_count, throttle_priority, cache_conn);
 }
 
 void txn_t::help_construct(repli_timestamp_t txn_timestamp,
                            int64_t expected_change_count,
+                           semaphore_priority_t throttle_priority,
                            cache_conn_t *cache_conn) {
     cache_->assert_thread();
     guarantee(expected_change_count >= 0);
     tracker_acq_t tracker_acq
-        = cache_->tracker_.begin_txn_or_throttle(expected_change_count);
+        = cache_->tracker_.begin_txn_or_throttle(expected_change_count,
+                                                 throttle_priority);
 
     ASSERT_FINITE_CORO_WAITING;
 
@@ -216,11 +272,14 @@ void txn_t::pulse_and_inform_tracker(cache_t *cache,
 txn_t::~txn_t() {
     cache_->assert_thread();
 
-    if (durability_ == write_durability_t::SOFT) {
-        cache_->page_cache_.flush_and_destroy_txn(std::move(page_txn_),
-                                                  std::bind(&txn_t::inform_tracker,
-                                                            cache_,
-                                                            ph::_1));
+    if (durability_ == write_durability_t::SOFT
+        || durability_ == write_durability_t::GROUP_SOFT) {
+        cache_->page_cache_.flush_and_destroy_txn(
+                std::move(page_txn_),
+                std::bind(&txn_t::inform_tracker, cache_, ph::_1),
+                durability_ == write_durability_t::GROUP_SOFT
+                    ? txn_flush_t::grouped
+                    : txn_flush_t::now);
     } else {
         cond_t cond;
         cache_->page_cache_.flush_and_destroy_txn(
@@ -237,7 +296,7 @@ void txn_t::set_account(cache_account_t *cache_account) {
 
 
 alt_snapshot_node_t::alt_snapshot_node_t(scoped_ptr_t<current_page_acq_t> &&acq)
-    : current_page_acq_(std::move(acq)), ref_count_(0) { }
+    : current_page_acq_(std::move(acq)), ref_count_(0), released_children_(false) { }
 
 alt_snapshot_node_t::~alt_snapshot_node_t() {
     // The only thing that deletes an alt_snapshot_node_t should be the
@@ -375,6 +434,9 @@ void buf_lock_t::help_construct(buf_parent_t parent, block_id_t block_id,
                                 access_t access) {
     buf_lock_t::wait_for_parent(parent, access);
     ASSERT_FINITE_CORO_WAITING;
+    if (txn_profile_counters_t *counters = parent.txn()->profile_counters()) {
+        ++counters->blocks_acquired;
+    }
     if (parent.lock_or_null_ != NULL && parent.lock_or_null_->snapshot_node_ != NULL) {
         buf_lock_t *parent_lock = parent.lock_or_null_;
         rassert(!parent_lock->current_page_acq_.has());
@@ -383,8 +445,8 @@ void buf_lock_t::help_construct(buf_parent_t parent, block_id_t block_id,
                                                 parent_lock->snapshot_node_,
                                                 block_id);
         guarantee(snapshot_node_ != NULL,
-                  "Tried to acquire (in cache %p) a deleted block (%" PRIu64
-                  " as child of %" PRIu64 ") (with read access).",
+                  "Tried to acquire (in cache %p) a deleted or released block (%"
+                  PRIu64 " as child of %" PRIu64 ") (with read access).",
                   txn_->cache(),
                   block_id, parent_lock->block_id());
         ++snapshot_node_->ref_count_;
@@ -661,6 +723,36 @@ void buf_lock_t::detach_child(block_id_t child_id) {
             child_id);
 }
 
+void buf_lock_t::release_snapshotted_child(block_id_t child_id) {
+    ASSERT_FINITE_CORO_WAITING;
+    guarantee(!empty());
+    if (snapshot_node_ == NULL || snapshot_node_->ref_count_ != 1) {
+        // Either we aren't snapshotted, or some other snapshot (or a snapshot of our
+        // parent that hasn't released us yet) might still want the child.
+        return;
+    }
+
+    snapshot_node_->released_children_ = true;
+    alt_snapshot_node_t *child = NULL;
+    auto it = snapshot_node_->children_.find(child_id);
+    if (it == snapshot_node_->children_.end()) {
+        // The NULL entry also keeps write transactions from handing us a copy of
+        // the child's current version in create_child_snapshot_attachments.
+        snapshot_node_->children_.insert(
+                std::make_pair(child_id, static_cast<alt_snapshot_node_t *>(NULL)));
+    } else {
+        child = it->second;
+        it->second = NULL;
+    }
+
+    if (child != NULL) {
+        --child->ref_count_;
+        if (child->ref_count_ == 0) {
+            cache()->remove_snapshot_node(child_id, child);
+        }
+    }
+}
+
 repli_timestamp_t buf_lock_t::get_recency() const {
     guarantee(!empty());
     current_page_acq_t *cpa = current_page_acq();
@@ -720,6 +812,22 @@ page_t *buf_lock_t::get_held_page_for_write() {
     return current_page_acq_->current_page_for_write(txn()->account());
 }
 
+void buf_lock_t::count_page_acq(const page_acq_t &page_acq, access_t access) {
+    if (block_tracer_t::is_enabled()) {
+        block_tracer_t::get_global_tracer().record(
+            cache()->page_cache_.trace_cache_id(), block_id(),
+            access == access_t::write, page_acq.cache_miss());
+    }
+    txn_profile_counters_t *const counters = txn_->profile_counters();
+    if (counters != NULL && page_acq.cache_miss()) {
+        ++counters->cache_misses;
+        if (page_acq.disk_bytes_read() != 0) {
+            ++counters->disk_reads;
+            counters->disk_bytes_read += page_acq.disk_bytes_read();
+        }
+    }
+}
+
 buf_read_t::buf_read_t(buf_lock_t *lock)
     : lock_(lock) {
     guarantee(!lock_->empty());
@@ -736,6 +844,7 @@ const void *buf_read_t::get_data_read(uint32_t *block_size_out) {
     if (!page_acq_.has()) {
         page_acq_.init(page, &lock_->cache()->page_cache_,
                        lock_->txn()->account());
+        lock_->count_page_acq(page_acq_, access_t::read);
     }
     page_acq_.buf_ready_signal()->wait();
     *block_size_out = page_acq_.get_buf_size().value();
@@ -758,6 +867,7 @@ void *buf_write_t::get_data_write(uint32_t block_size) {
     if (!page_acq_.has()) {
         page_acq_.init(page, &lock_->cache()->page_cache_,
                        lock_->txn()->account());
+        lock_->count_page_acq(page_acq_, access_t::write);
     }
     page_acq_.buf_ready_signal()->wait();
     return page_acq_.get_buf_write(block_size_t::make_from_cache(block_size));
@@ -3,10 +3,13 @@
 #define BUFFER_CACHE_ALT_ALT_HPP_
 
 #include <map>
+#include <string>
 #include <vector>
 #include <utility>
 
+#include "buffer_cache/alt/memory_arbiter.hpp"
 #include "buffer_cache/alt/page_cache.hpp"
+#include "buffer_cache/alt/warm_up_manifest.hpp"
 #include "buffer_cache/types.hpp"
 #include "containers/two_level_array.hpp"
 #include "repli_timestamp.hpp"
@@ -26,7 +29,8 @@ public:
     alt_memory_tracker_t();
     ~alt_memory_tracker_t();
 
-    alt::tracker_acq_t begin_txn_or_throttle(int64_t expected_change_count);
+    alt::tracker_acq_t begin_txn_or_throttle(int64_t expected_change_count,
+                                             semaphore_priority_t priority);
     void end_txn(alt::tracker_acq_t acq);
 
 private:
@@ -57,6 +61,27 @@ public:
     // might consider supporting a mem_cap paremeter.
     cache_account_t create_cache_account(int priority);
 
+    // Lets the arbiter move this cache's memory limit within the given quota.  (By
+    // default, the cache keeps the memory limit it was configured with.)
+    void set_memory_quota(alt_memory_arbiter_t *arbiter,
+                          const cache_memory_quota_t &quota);
+
+    // Loads the blocks listed in the warm-up manifest at the given path into the
+    // cache (in the background), and from then on keeps the manifest up to date
+    // with the hottest blocks in the cache.
+    void enable_warm_up_manifest(const std::string &path);
+
+    // Starts loading the given blocks in the background (if they aren't already in
+    // memory), for read-ahead.
+    void prefetch_blocks(const std::vector<block_id_t> &block_ids,
+                         cache_account_t *account);
+
+    // Returns the block's current contents without acquiring it, or NULL if it isn't
+    // in memory or someone has write access to it.  Sets *write_waiting_out to
+    // whether a write acquirer is in line for the block.  The pointer is only good
+    // until the caller blocks.
+    const void *peek_block(block_id_t block_id, bool *write_waiting_out);
+
 private:
     friend class txn_t;
     friend class buf_read_t;
@@ -78,19 +103,42 @@ private:
 
     two_level_nevershrink_array_t<intrusive_list_t<alt_snapshot_node_t> > snapshot_nodes_by_block_id_;
 
+    // These must be destroyed before page_cache_.
+    scoped_ptr_t<alt::warm_up_manifest_t> warm_up_manifest_;
+    scoped_ptr_t<alt_memory_arbiter_t::registration_t> memory_arbiter_registration_;
+
     DISABLE_COPYING(cache_t);
 };
 
+// What a transaction's blocks cost it, for query profiles.  See
+// txn_t::set_profile_counters.
+struct txn_profile_counters_t {
+    txn_profile_counters_t()
+        : blocks_acquired(0), cache_misses(0), disk_reads(0), disk_bytes_read(0) { }
+
+    // Existing blocks acquired, whether or not their contents were looked at.
+    int64_t blocks_acquired;
+    // Blocks whose contents were looked at but weren't in memory.
+    int64_t cache_misses;
+    // The reads from disk that the transaction started for them.
+    int64_t disk_reads;
+    int64_t disk_bytes_read;
+};
+
 class txn_t {
 public:
     // Constructor for read-only transactions.
     txn_t(cache_conn_t *cache_conn, read_access_t read_access);
 
     // KSI: Remove default parameter for expected_change_count.
+    // Background work (backfilling, building secondary indexes) passes
+    // semaphore_priority_t::background, so that queries' writes get through the
+    // cache's write throttling first.
     txn_t(cache_conn_t *cache_conn,
           write_durability_t durability,
           repli_timestamp_t txn_timestamp,
-          int64_t expected_change_count = 2);
+          int64_t expected_change_count = 2,
+          semaphore_priority_t throttle_priority = semaphore_priority_t::normal);
 
     ~txn_t();
 
@@ -101,6 +149,13 @@ public:
     void set_account(cache_account_t *cache_account);
     cache_account_t *account() { return cache_account_; }
 
+    // From now on, counts the transaction's block acquisitions in *counters (or
+    // stops counting them, if counters is NULL).
+    void set_profile_counters(txn_profile_counters_t *counters) {
+        profile_counters_ = counters;
+    }
+    txn_profile_counters_t *profile_counters() { return profile_counters_; }
+
 private:
     // Resets the *tracker_acq parameter.
     static void inform_tracker(cache_t *cache,
@@ -114,6 +169,7 @@ private:
 
     void help_construct(repli_timestamp_t txn_timestamp,
                         int64_t expected_change_count,
+                        semaphore_priority_t throttle_priority,
                         cache_conn_t *cache_conn);
 
     cache_t *const cache_;
@@ -122,6 +178,9 @@ private:
     // set_account().
     cache_account_t *cache_account_;
 
+    // NULL unless a query is profiling this transaction.
+    txn_profile_counters_t *profile_counters_;
+
     const access_t access_;
 
     // Only applicable if access_ == write.
@@ -193,9 +252,19 @@ public:
     }
 
     void snapshot_subdag();
+    bool is_snapshotted() const {
+        return snapshot_node_ != NULL;
+    }
 
     void detach_child(block_id_t child_id);
 
+    // Promises that this snapshotted buf won't be used to acquire child_id again
+    // (other than through an existing buf_lock_t for it).  If nothing else holds
+    // our snapshot, that lets the child's snapshotted version be freed as soon as
+    // the child's buf_lock_t's are gone, and write transactions stop copying the
+    // child for our sake.  Does nothing if the buf isn't snapshotted.
+    void release_snapshotted_child(block_id_t child_id);
+
     block_id_t block_id() const {
         guarantee(txn_ != NULL);
         return current_page_acq()->block_id();
@@ -258,6 +327,9 @@ private:
     alt::page_t *get_held_page_for_read();
     alt::page_t *get_held_page_for_write();
 
+    // For buf_read_t and buf_write_t, once they've gotten in line for the page.
+    void count_page_acq(const alt::page_acq_t &page_acq, access_t access);
+
     txn_t *txn_;
 
     scoped_ptr_t<alt::current_page_acq_t> current_page_acq_;
@@ -297,6 +369,10 @@ public:
         return txn_ == NULL;
     }
 
+    bool is_snapshotted() const {
+        return lock_or_null_ != NULL && lock_or_null_->is_snapshotted();
+    }
+
     txn_t *txn() const {
         guarantee(!empty());
         return txn_;
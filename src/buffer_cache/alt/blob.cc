@@ -4,6 +4,7 @@
 #include <stdint.h>
 
 #include <limits>
+#include <vector>
 
 #include "buffer_cache/alt/alt.hpp"
 #include "concurrency/pmap.hpp"
@@ -411,6 +412,15 @@ make_tree_from_block_ids(buf_parent_t parent, access_t mode, int levels,
     compute_acquisition_offsets(parent.cache()->max_block_size(), levels, offset,
                                 size, &filler.lo, &filler.hi);
 
+    if (mode == access_t::read && filler.hi - filler.lo > 1) {
+        // Acquiring a block doesn't load it; reading it does.  The leaves get read
+        // one after another in expose_tree_from_block_ids, so without this a big
+        // value would come off the disk one block at a time.
+        parent.cache()->prefetch_blocks(
+            std::vector<block_id_t>(block_ids + filler.lo, block_ids + filler.hi),
+            parent.txn()->account());
+    }
+
     filler.nodes = new temporary_acq_tree_node_t[filler.hi - filler.lo];
 
     pmap(filler.hi - filler.lo, filler);
@@ -0,0 +1,84 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "buffer_cache/alt/block_trace.hpp"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "arch/runtime/runtime.hpp"
+#include "logger.hpp"
+#include "time.hpp"
+
+volatile bool block_tracer_t::enabled = false;
+
+block_tracer_t::block_tracer_t() { }
+
+block_tracer_t &block_tracer_t::get_global_tracer() {
+    static block_tracer_t tracer;
+    return tracer;
+}
+
+uint32_t block_tracer_t::new_cache_id() {
+    static uint32_t next_cache_id = 0;
+    return __sync_fetch_and_add(&next_cache_id, 1);
+}
+
+void block_tracer_t::enable() {
+    for (auto ring = rings.begin(); ring != rings.end(); ++ring) {
+        spinlock_acq_t acq(&ring->value.spinlock);
+        ring->value.next = 0;
+        ring->value.wrapped = false;
+    }
+    if (!enabled) {
+        logINF("Block tracing enabled.");
+    }
+    enabled = true;
+}
+
+void block_tracer_t::disable() {
+    if (enabled) {
+        logINF("Block tracing disabled.");
+    }
+    enabled = false;
+}
+
+std::string block_tracer_t::dump() {
+    std::vector<block_trace_record_t> records;
+    for (auto ring = rings.begin(); ring != rings.end(); ++ring) {
+        spinlock_acq_t acq(&ring->value.spinlock);
+        const std::vector<block_trace_record_t> &ring_records = ring->value.records;
+        const size_t count = ring->value.wrapped ? ring_records.size() : ring->value.next;
+        records.insert(records.end(), ring_records.begin(), ring_records.begin() + count);
+    }
+    std::sort(records.begin(), records.end(),
+              [](const block_trace_record_t &x, const block_trace_record_t &y) {
+                  return x.ticks < y.ticks;
+              });
+
+    std::string result(BLOCK_TRACE_MAGIC);
+    const uint32_t header[2] = { sizeof(block_trace_record_t), 0 };
+    result.append(reinterpret_cast<const char *>(header), sizeof(header));
+    result.append(reinterpret_cast<const char *>(records.data()),
+                  records.size() * sizeof(block_trace_record_t));
+    return result;
+}
+
+void block_tracer_t::record(uint32_t cache_id, block_id_t block_id,
+                            bool write, bool miss) {
+    per_thread_ring_t *ring = &rings[get_thread_id().threadnum].value;
+    spinlock_acq_t acq(&ring->spinlock);
+    if (ring->records.empty()) {
+        ring->records.resize(BLOCK_TRACE_RECORDS_PER_THREAD);
+    }
+    block_trace_record_t *record = &ring->records[ring->next];
+    record->ticks = get_ticks();
+    record->block_id = block_id;
+    record->cache_id = cache_id;
+    record->flags = (write ? BLOCK_TRACE_WRITE : 0) | (miss ? BLOCK_TRACE_MISS : 0);
+    memset(record->padding, 0, sizeof(record->padding));
+    ++ring->next;
+    if (ring->next == ring->records.size()) {
+        ring->next = 0;
+        ring->wrapped = true;
+    }
+}
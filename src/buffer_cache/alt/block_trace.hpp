@@ -0,0 +1,84 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_ALT_BLOCK_TRACE_HPP_
+#define BUFFER_CACHE_ALT_BLOCK_TRACE_HPP_
+
+#include <stdint.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "arch/spinlock.hpp"
+#include "concurrency/cache_line_padded.hpp"
+#include "config/args.hpp"
+#include "errors.hpp"
+#include "serializer/types.hpp"
+
+// One block acquisition in a block trace.
+struct block_trace_record_t {
+    // When the block's buffer was asked for, from get_ticks().
+    uint64_t ticks;
+    uint64_t block_id;
+    // Which cache the block is in (there is one per table shard on a server), from
+    // `block_tracer_t::new_cache_id()`.
+    uint32_t cache_id;
+    // BLOCK_TRACE_WRITE and BLOCK_TRACE_MISS.
+    uint8_t flags;
+    uint8_t padding[3];
+};
+
+static const uint8_t BLOCK_TRACE_WRITE = 1;
+// The buffer wasn't in memory.
+static const uint8_t BLOCK_TRACE_MISS = 2;
+
+// A dump starts with these 8 bytes, then the uint32_t size of a record (so readers
+// can check they agree), then a uint32_t of zero, then the records in time order.
+// Everything is in the server's byte order.
+#define BLOCK_TRACE_MAGIC "rdbbtrc1"
+
+/* `block_tracer_t` records every block buffer that transactions read or write,
+and whether it was in memory, so that eviction policies and cache sizes can be
+tried out offline against a real workload (`rethinkdb-bench cache --trace=FILE`
+replays a dump).  It is off until `enable()`; the admin HTTP server has
+`/ajax/block_trace` for turning it on and off and getting a dump.  While it is off,
+the only cost is a check of `is_enabled()` per block acquisition.  Each thread keeps
+the last BLOCK_TRACE_RECORDS_PER_THREAD accesses in a ring buffer of its own. */
+class block_tracer_t {
+public:
+    block_tracer_t();
+
+    static block_tracer_t &get_global_tracer();
+
+    static bool is_enabled() { return enabled; }
+
+    // Each cache gets a number, to tell apart the blocks of different caches in a
+    // trace.  Can be called from any thread.
+    static uint32_t new_cache_id();
+
+    // These can be called from any thread.  `enable()` throws away what has been
+    // recorded so far.
+    void enable();
+    void disable();
+    // The records of all threads so far, in the dump format above.
+    std::string dump();
+
+    void record(uint32_t cache_id, block_id_t block_id, bool write, bool miss);
+
+private:
+    struct per_thread_ring_t {
+        per_thread_ring_t() : next(0), wrapped(false) { }
+        // Allocated the first time the thread records something.
+        std::vector<block_trace_record_t> records;
+        size_t next;
+        bool wrapped;
+        spinlock_t spinlock;
+    };
+
+    std::array<cache_line_padded_t<per_thread_ring_t>, MAX_THREADS> rings;
+
+    static volatile bool enabled;
+
+    DISABLE_COPYING(block_tracer_t);
+};
+
+#endif  // BUFFER_CACHE_ALT_BLOCK_TRACE_HPP_
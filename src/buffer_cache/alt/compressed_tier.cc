@@ -0,0 +1,88 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "buffer_cache/alt/compressed_tier.hpp"
+
+#include <string.h>
+#include <zlib.h>
+
+#include "buffer_cache/alt/page.hpp"
+
+namespace alt {
+
+// A copy is only kept if it's at most this fraction of the buffer's size.  Pages
+// that don't compress that well would cost nearly as much memory as they do when
+// they're loaded.
+static const double MAX_COMPRESSED_SIZE_RATIO = 0.75;
+
+compressed_page_tier_t::compressed_page_tier_t() : size_(0) { }
+
+compressed_page_tier_t::~compressed_page_tier_t() {
+    while (remove_oldest()) { }
+}
+
+void compressed_page_tier_t::add(page_t *page, const ser_buffer_t *buf,
+                                 uint32_t ser_buf_size) {
+    rassert(page->compressed_copy_ == NULL);
+
+    uLongf compressed_size = compressBound(ser_buf_size);
+    scoped_array_t<char> data(compressed_size);
+    // We're on the eviction path, so speed matters more than the ratio.
+    int res = compress2(reinterpret_cast<Bytef *>(data.data()), &compressed_size,
+                        reinterpret_cast<const Bytef *>(buf), ser_buf_size,
+                        Z_BEST_SPEED);
+    if (res != Z_OK || compressed_size > ser_buf_size * MAX_COMPRESSED_SIZE_RATIO) {
+        return;
+    }
+
+    // Don't hold on to compressBound's slack.
+    scoped_array_t<char> trimmed(compressed_size);
+    memcpy(trimmed.data(), data.data(), compressed_size);
+
+    compressed_page_t *copy = new compressed_page_t(page, ser_buf_size,
+                                                    std::move(trimmed),
+                                                    compressed_size);
+    copies_.push_back(copy);
+    size_ += compressed_size + sizeof(compressed_page_t);
+    page->compressed_copy_ = copy;
+}
+
+bool compressed_page_tier_t::take(page_t *page, ser_buffer_t *buf) {
+    compressed_page_t *copy = page->compressed_copy_;
+    if (copy == NULL) {
+        return false;
+    }
+
+    uLongf size = copy->ser_buf_size;
+    int res = uncompress(reinterpret_cast<Bytef *>(buf), &size,
+                         reinterpret_cast<const Bytef *>(copy->data.data()),
+                         copy->data_size);
+    guarantee(res == Z_OK && size == copy->ser_buf_size,
+              "Could not decompress a page in the compressed page tier.");
+
+    remove_copy(copy);
+    return true;
+}
+
+void compressed_page_tier_t::remove(page_t *page) {
+    if (page->compressed_copy_ != NULL) {
+        remove_copy(page->compressed_copy_);
+    }
+}
+
+bool compressed_page_tier_t::remove_oldest() {
+    compressed_page_t *copy = copies_.head();
+    if (copy == NULL) {
+        return false;
+    }
+    remove_copy(copy);
+    return true;
+}
+
+void compressed_page_tier_t::remove_copy(compressed_page_t *copy) {
+    rassert(copy->page->compressed_copy_ == copy);
+    copy->page->compressed_copy_ = NULL;
+    copies_.remove(copy);
+    size_ -= copy->data_size + sizeof(compressed_page_t);
+    delete copy;
+}
+
+}  // namespace alt
@@ -0,0 +1,74 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_ALT_COMPRESSED_TIER_HPP_
+#define BUFFER_CACHE_ALT_COMPRESSED_TIER_HPP_
+
+#include <stdint.h>
+
+#include "containers/intrusive_list.hpp"
+#include "containers/scoped.hpp"
+#include "errors.hpp"
+
+struct ser_buffer_t;
+
+namespace alt {
+
+class page_t;
+
+// A compressed copy of an evicted page's buffer, owned by the
+// compressed_page_tier_t.  The page points back at it with its compressed_copy_
+// field.
+class compressed_page_t : public intrusive_list_node_t<compressed_page_t> {
+public:
+    compressed_page_t(page_t *_page, uint32_t _ser_buf_size,
+                      scoped_array_t<char> &&_data, size_t _data_size)
+        : page(_page), ser_buf_size(_ser_buf_size),
+          data(std::move(_data)), data_size(_data_size) { }
+
+    page_t *const page;
+    // The size of the buffer that got compressed.
+    const uint32_t ser_buf_size;
+    const scoped_array_t<char> data;
+    const size_t data_size;
+
+    DISABLE_COPYING(compressed_page_t);
+};
+
+// Holds zlib-compressed copies of the buffers of evicted, disk-backed pages, so that
+// reloading one of them costs a decompression instead of a disk read.  The evicter_t
+// counts the tier's memory as part of the cache's memory usage, and the tier drops
+// its oldest copies first.
+class compressed_page_tier_t {
+public:
+    compressed_page_tier_t();
+    ~compressed_page_tier_t();
+
+    // Stores a compressed copy of the page's buffer, unless it doesn't compress
+    // well.  The page must not already have a copy in the tier.
+    void add(page_t *page, const ser_buffer_t *buf, uint32_t ser_buf_size);
+
+    // If the page has a compressed copy, decompresses it into *buf (which must be
+    // big enough), removes the copy and returns true.
+    bool take(page_t *page, ser_buffer_t *buf);
+
+    // Drops the page's compressed copy, if it has one.
+    void remove(page_t *page);
+
+    // Drops the oldest compressed copy.  Returns false if the tier is empty.
+    bool remove_oldest();
+
+    // How much memory the tier is using.
+    uint64_t size() const { return size_; }
+
+private:
+    void remove_copy(compressed_page_t *copy);
+
+    // Oldest copies first.
+    intrusive_list_t<compressed_page_t> copies_;
+    uint64_t size_;
+
+    DISABLE_COPYING(compressed_page_tier_t);
+};
+
+}  // namespace alt
+
+#endif  // BUFFER_CACHE_ALT_COMPRESSED_TIER_HPP_
@@ -6,6 +6,22 @@
 #include "containers/archive/archive.hpp"
 #include "rpc/serialize_macros.hpp"
 
+// Selects how the evicter_t picks disk-backed pages to evict.
+enum class eviction_policy_t {
+    // Samples a few random evictable pages and evicts the least recently accessed
+    // one.
+    random_sampling,
+    // ARC-style.  Pages accessed only once since being loaded are evicted before
+    // pages that have been reused, and the balance between the two adapts to hits
+    // on recently evicted ("ghost") pages.  One-pass scans only churn the pages
+    // that were never reused.
+    scan_resistant
+};
+
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(eviction_policy_t, int8_t,
+                                      eviction_policy_t::random_sampling,
+                                      eviction_policy_t::scan_resistant);
+
 // KSI: Maybe this config struct can just go away completely.  For now we have it to
 // conform to some aspects of the interface of the mirrored cache, putting off until
 // later whether certain configuration options may be removed.
@@ -15,13 +31,26 @@ public:
     page_cache_config_t()
         : io_priority_reads(CACHE_READS_IO_PRIORITY),
           io_priority_writes(CACHE_WRITES_IO_PRIORITY),
-          memory_limit(GIGABYTE) { }
+          memory_limit(GIGABYTE),
+          eviction_policy(eviction_policy_t::scan_resistant),
+          compressed_tier_percent(CACHE_COMPRESSED_TIER_PERCENT),
+          group_soft_loss_window_ms(CACHE_GROUP_SOFT_LOSS_WINDOW_MS) { }
 
     int32_t io_priority_reads;
     int32_t io_priority_writes;
     uint64_t memory_limit;
+    eviction_policy_t eviction_policy;
+    // How much of memory_limit (in percent) may be used to keep compressed copies of
+    // evicted pages.  0 disables the compressed tier.
+    int32_t compressed_tier_percent;
+    // The flushes of txns with write_durability_t::GROUP_SOFT are put off until at
+    // most this long after the first of them was waiting, and then done together.
+    // 0 flushes them right away, like soft txns.
+    int64_t group_soft_loss_window_ms;
 
-    RDB_MAKE_ME_SERIALIZABLE_3(io_priority_reads, io_priority_writes, memory_limit);
+    RDB_MAKE_ME_SERIALIZABLE_6(io_priority_reads, io_priority_writes, memory_limit,
+                               eviction_policy, compressed_tier_percent,
+                               group_soft_loss_window_ms);
 };
 
 class alt_cache_config_t {
@@ -1,12 +1,26 @@
 #include "buffer_cache/alt/evicter.hpp"
 
+#include <algorithm>
+
 #include "buffer_cache/alt/page.hpp"
+#include "buffer_cache/alt/stats.hpp"
 
 namespace alt {
 
-evicter_t::evicter_t(memory_tracker_t *tracker, uint64_t memory_limit)
-    : tracker_(tracker), memory_limit_(memory_limit),
-      access_time_counter_(INITIAL_ACCESS_TIME) { }
+evicter_t::evicter_t(memory_tracker_t *tracker, alt_cache_stats_t *stats,
+                     uint64_t memory_limit,
+                     eviction_policy_t policy,
+                     int32_t compressed_tier_percent)
+    : tracker_(tracker), stats_(stats), memory_limit_(memory_limit),
+      policy_(policy),
+      access_time_counter_(INITIAL_ACCESS_TIME),
+      access_count_(0),
+      miss_count_(0),
+      eviction_clock_(0),
+      unreused_target_size_(0),
+      compressed_tier_percent_(compressed_tier_percent) {
+    guarantee(compressed_tier_percent_ >= 0 && compressed_tier_percent_ <= 100);
+}
 
 evicter_t::~evicter_t() {
     assert_thread();
@@ -51,6 +65,7 @@ void evicter_t::move_unevictable_to_evictable(page_t *page) {
     unevictable_.remove(page, page->hypothetical_memory_usage());
     eviction_bag_t *new_bag = correct_eviction_category(page);
     rassert(new_bag == &evictable_disk_backed_
+            || new_bag == &evictable_disk_backed_reused_
             || new_bag == &evictable_unbacked_);
     new_bag->add(page, page->hypothetical_memory_usage());
     inform_tracker();
@@ -75,7 +90,7 @@ eviction_bag_t *evicter_t::correct_eviction_category(page_t *page) {
     } else if (page->is_evicted()) {
         return &evicted_;
     } else if (page->is_disk_backed()) {
-        return &evictable_disk_backed_;
+        return page->reused_ ? &evictable_disk_backed_reused_ : &evictable_disk_backed_;
     } else {
         return &evictable_unbacked_;
     }
@@ -85,21 +100,92 @@ void evicter_t::remove_page(page_t *page) {
     assert_thread();
     eviction_bag_t *bag = correct_eviction_category(page);
     bag->remove(page, page->hypothetical_memory_usage());
+    compressed_tier_.remove(page);
     inform_tracker();
     evict_if_necessary();
 }
 
+void evicter_t::note_page_acquired(page_t *page) {
+    assert_thread();
+    // The reused_ flag affects which evictable bag the page belongs in, so it may
+    // only change while the page is unevictable.
+    rassert(unevictable_.has_page(page));
+    ++access_count_;
+    if (page->is_evicted()) {
+        ++miss_count_;
+    }
+    if (policy_ != eviction_policy_t::scan_resistant || page->reused_) {
+        return;
+    }
+
+    if (page->is_evicted() && page->ghost_eviction_clock_ != 0) {
+        // The page is being reloaded.  If it was evicted recently enough, it's a
+        // ghost hit:  we'd have kept it with a bigger share of memory for its list,
+        // so we adapt the target size like ARC does.
+        rassert(page->ghost_eviction_clock_ <= eviction_clock_);
+        if (eviction_clock_ - page->ghost_eviction_clock_ <= memory_limit_) {
+            const uint64_t delta = page->hypothetical_memory_usage();
+            if (page->ghost_was_reused_) {
+                unreused_target_size_ -= std::min(unreused_target_size_, delta);
+            } else {
+                unreused_target_size_ = std::min(memory_limit_,
+                                                 unreused_target_size_ + delta);
+            }
+            page->reused_ = true;
+        }
+        page->ghost_eviction_clock_ = 0;
+    }
+
+    if (page->acquisition_count_ < 2) {
+        ++page->acquisition_count_;
+    }
+    if (page->acquisition_count_ >= 2) {
+        page->reused_ = true;
+    }
+}
+
 uint64_t evicter_t::in_memory_size() const {
     assert_thread();
     return unevictable_.size()
         + evictable_disk_backed_.size()
-        + evictable_unbacked_.size();
+        + evictable_disk_backed_reused_.size()
+        + evictable_unbacked_.size()
+        + compressed_tier_.size();
+}
+
+uint64_t evicter_t::compressed_tier_limit() const {
+    return memory_limit_ / 100 * compressed_tier_percent_;
+}
+
+bool evicter_t::take_compressed_copy(page_t *page, ser_buffer_t *buf) {
+    assert_thread();
+    if (!compressed_tier_.take(page, buf)) {
+        return false;
+    }
+    inform_tracker();
+    return true;
 }
 
 bool evicter_t::interested_in_read_ahead_block(uint32_t in_memory_block_size) const {
     return in_memory_size() + in_memory_block_size < memory_limit_;
 }
 
+void evicter_t::update_memory_limit(uint64_t new_memory_limit) {
+    assert_thread();
+    memory_limit_ = new_memory_limit;
+    unreused_target_size_ = std::min(unreused_target_size_, memory_limit_);
+    inform_tracker();
+    evict_if_necessary();
+}
+
+void evicter_t::take_access_counts(uint64_t *accesses_out, uint64_t *misses_out) {
+    assert_thread();
+    *accesses_out = access_count_;
+    *misses_out = miss_count_;
+    access_count_ = 0;
+    miss_count_ = 0;
+}
+
 void evicter_t::evict_if_necessary() {
     assert_thread();
     // KSI: Implement eviction of unbacked evictables too.  When flushing, you
@@ -108,10 +194,55 @@ void evicter_t::evict_if_necessary() {
     // currently being written for the purpose of eviction.
 
     page_t *page;
-    while (in_memory_size() > memory_limit_
-           && evictable_disk_backed_.remove_oldish(&page, access_time_counter_)) {
+    while (in_memory_size() > memory_limit_) {
+        // Once the compressed tier has used up its share of memory, its oldest copies
+        // make room for the newly evicted ones.  They also go when there's nothing
+        // else left to evict.
+        if (compressed_tier_.size() > compressed_tier_limit()
+            || !remove_eviction_victim(&page)) {
+            if (!compressed_tier_.remove_oldest()) {
+                break;
+            }
+            if (stats_ != NULL) {
+                stats_->pm_compressed_copy_drops.record();
+            }
+            continue;
+        }
+
+        eviction_clock_ += page->hypothetical_memory_usage();
+        page->ghost_eviction_clock_ = eviction_clock_;
+        page->ghost_was_reused_ = page->reused_;
+        page->reused_ = false;
+        page->acquisition_count_ = 0;
         evicted_.add(page, page->hypothetical_memory_usage());
+        if (compressed_tier_percent_ > 0) {
+            compressed_tier_.add(page, page->buf_.get(), page->ser_buf_size_);
+        }
         page->evict_self();
+        if (stats_ != NULL) {
+            stats_->pm_evictions.record();
+        }
+    }
+}
+
+bool evicter_t::remove_eviction_victim(page_t **page_out) {
+    switch (policy_) {
+    case eviction_policy_t::random_sampling:
+        return evictable_disk_backed_.remove_oldish(page_out, access_time_counter_);
+    case eviction_policy_t::scan_resistant:
+        // This is ARC's REPLACE step: prefer evicting never-reused pages while they
+        // take more than their target share of memory.
+        if (evictable_disk_backed_.size() > unreused_target_size_
+            || evictable_disk_backed_reused_.size() == 0) {
+            if (evictable_disk_backed_.remove_oldish(page_out, access_time_counter_)) {
+                return true;
+            }
+        }
+        return evictable_disk_backed_reused_.remove_oldish(page_out,
+                                                           access_time_counter_)
+            || evictable_disk_backed_.remove_oldish(page_out, access_time_counter_);
+    default:
+        unreachable();
     }
 }
 
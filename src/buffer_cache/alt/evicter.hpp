@@ -3,9 +3,13 @@
 
 #include <stdint.h>
 
+#include "buffer_cache/alt/compressed_tier.hpp"
+#include "buffer_cache/alt/config.hpp"
 #include "buffer_cache/alt/eviction_bag.hpp"
 #include "threading.hpp"
 
+class alt_cache_stats_t;
+
 class memory_tracker_t {
 public:
     virtual ~memory_tracker_t() { }
@@ -28,12 +32,41 @@ public:
     eviction_bag_t *unevictable_category() { return &unevictable_; }
     void remove_page(page_t *page);
 
-    explicit evicter_t(memory_tracker_t *tracker,
-                       uint64_t memory_limit);
+    // Called by page_t::add_waiter, once the page is in the unevictable bag, to
+    // record the acquisition for the replacement policy.
+    void note_page_acquired(page_t *page);
+
+    // stats can be NULL.
+    evicter_t(memory_tracker_t *tracker,
+              alt_cache_stats_t *stats,
+              uint64_t memory_limit,
+              eviction_policy_t policy,
+              int32_t compressed_tier_percent);
     ~evicter_t();
 
     bool interested_in_read_ahead_block(uint32_t in_memory_block_size) const;
 
+    uint64_t memory_limit() const { return memory_limit_; }
+    // Used by the alt_memory_arbiter_t to move memory between caches.
+    void update_memory_limit(uint64_t new_memory_limit);
+
+    // Returns the number of page acquisitions and of acquisitions that had to wait
+    // for the page to be loaded (since the last call), and resets the counters.
+    void take_access_counts(uint64_t *accesses_out, uint64_t *misses_out);
+
+    // Called when loading an evicted page.  If the compressed tier has a copy of the
+    // page's buffer, decompresses it into buf and returns true.
+    bool take_compressed_copy(page_t *page, ser_buffer_t *buf);
+
+    // The sizes of the eviction bags (and the compressed tier), for the stats.
+    uint64_t unevictable_size() const { return unevictable_.size(); }
+    uint64_t evictable_unbacked_size() const { return evictable_unbacked_.size(); }
+    uint64_t evictable_disk_backed_size() const {
+        return evictable_disk_backed_.size() + evictable_disk_backed_reused_.size();
+    }
+    uint64_t evicted_size() const { return evicted_.size(); }
+    uint64_t compressed_tier_size() const { return compressed_tier_.size(); }
+
     uint64_t next_access_time() {
         return ++access_time_counter_;
     }
@@ -44,21 +77,57 @@ private:
     void evict_if_necessary();
     uint64_t in_memory_size() const;
 
+    // Removes the page that should be evicted next from its evictable bag.  Returns
+    // false if there's nothing that can be evicted.
+    bool remove_eviction_victim(page_t **page_out);
+
     void inform_tracker() const;
 
+    // How much memory the compressed tier may use before its copies get dropped to
+    // make room for pages.
+    uint64_t compressed_tier_limit() const;
+
     // LSI: Implement issue 97.
     memory_tracker_t *const tracker_;
+    alt_cache_stats_t *const stats_;
     uint64_t memory_limit_;
 
+    const eviction_policy_t policy_;
+
     // This gets incremented every time a page is accessed.
     uint64_t access_time_counter_;
 
+    // Page acquisitions and misses since the last take_access_counts call.
+    uint64_t access_count_;
+    uint64_t miss_count_;
+
+    // This gets incremented by a page's size every time a page is evicted.  A page
+    // that was evicted less than memory_limit_ bytes of evictions ago is still in
+    // the (implicit) ghost list, see page_t::ghost_eviction_clock_.
+    uint64_t eviction_clock_;
+
+    // For the scan_resistant policy, the number of bytes that evictable disk-backed
+    // pages that haven't been reused are allowed to use before we'd rather evict
+    // reused pages.  (This is ARC's "p" parameter.)  It starts at zero, so that
+    // never-reused pages always get evicted first until ghost hits tell us that
+    // they deserve more room.
+    uint64_t unreused_target_size_;
+
     // These track whether every page's eviction status.
     eviction_bag_t unevictable_;
+    // Disk-backed pages that have not been reused.  (With the random_sampling
+    // policy, all disk-backed evictable pages are here.)
     eviction_bag_t evictable_disk_backed_;
+    // Disk-backed pages that have been reused (only used by scan_resistant).
+    eviction_bag_t evictable_disk_backed_reused_;
     eviction_bag_t evictable_unbacked_;
     eviction_bag_t evicted_;
 
+    // The percentage of memory_limit_ that compressed copies of evicted pages may
+    // use.  0 disables the compressed tier.
+    const int32_t compressed_tier_percent_;
+    compressed_page_tier_t compressed_tier_;
+
     DISABLE_COPYING(evicter_t);
 };
 
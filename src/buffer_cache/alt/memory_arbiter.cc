@@ -0,0 +1,171 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "buffer_cache/alt/memory_arbiter.hpp"
+
+#include <algorithm>
+#include <functional>
+
+#include "arch/runtime/coroutines.hpp"
+#include "buffer_cache/alt/evicter.hpp"
+#include "concurrency/pmap.hpp"
+#include "config/args.hpp"
+
+// How much of a cache's weight is kept from one rebalancing to the next.
+static const double ARBITER_WEIGHT_DECAY = 0.5;
+
+alt_memory_arbiter_t::registration_t::registration_t(
+        alt_memory_arbiter_t *parent,
+        alt::evicter_t *evicter,
+        const cache_memory_quota_t &quota)
+    : parent_(parent),
+      evicter_(evicter),
+      base_memory_limit_(evicter->memory_limit()),
+      quota_(quota),
+      weight_(0) {
+    guarantee(quota_.floor <= quota_.ceiling);
+    parent_->registrations_.get()->insert(this);
+}
+
+alt_memory_arbiter_t::registration_t::~registration_t() {
+    assert_thread();
+    parent_->registrations_.get()->erase(this);
+}
+
+alt_memory_arbiter_t::alt_memory_arbiter_t()
+    : rebalance_in_progress_(false),
+      timer_(CACHE_MEMORY_ARBITER_INTERVAL_MS, this) { }
+
+alt_memory_arbiter_t::~alt_memory_arbiter_t() {
+    assert_thread();
+}
+
+void alt_memory_arbiter_t::on_ring() {
+    assert_thread();
+    if (!rebalance_in_progress_) {
+        rebalance_in_progress_ = true;
+        coro_t::spawn_sometime(std::bind(&alt_memory_arbiter_t::rebalance,
+                                         this, drainer_.lock()));
+    }
+}
+
+void alt_memory_arbiter_t::rebalance(auto_drainer_t::lock_t) {
+    assert_thread();
+    std::vector<std::vector<sample_t> > samples(get_num_threads());
+
+    pmap(get_num_threads(), std::bind(&alt_memory_arbiter_t::collect_samples,
+                                      this, std::placeholders::_1, &samples));
+
+    std::vector<sample_t *> all_samples;
+    for (auto it = samples.begin(); it != samples.end(); ++it) {
+        for (auto jt = it->begin(); jt != it->end(); ++jt) {
+            all_samples.push_back(&*jt);
+        }
+    }
+
+    if (!all_samples.empty()) {
+        compute_memory_limits(&all_samples);
+        pmap(get_num_threads(), std::bind(&alt_memory_arbiter_t::apply_samples,
+                                          this, std::placeholders::_1, &samples));
+    }
+
+    rebalance_in_progress_ = false;
+}
+
+void alt_memory_arbiter_t::collect_samples(
+        int thread, std::vector<std::vector<sample_t> > *samples) {
+    on_thread_t th((threadnum_t(thread)));
+    ASSERT_NO_CORO_WAITING;
+    std::set<registration_t *> *regs = registrations_.get();
+    std::vector<sample_t> *out = &(*samples)[thread];
+    for (auto it = regs->begin(); it != regs->end(); ++it) {
+        registration_t *reg = *it;
+        uint64_t accesses;
+        uint64_t misses;
+        reg->evicter_->take_access_counts(&accesses, &misses);
+        reg->weight_ = reg->weight_ * ARBITER_WEIGHT_DECAY
+            + accesses + CACHE_MEMORY_ARBITER_MISS_WEIGHT * misses;
+
+        sample_t sample;
+        sample.registration = reg;
+        sample.base_memory_limit = reg->base_memory_limit_;
+        sample.quota = reg->quota_;
+        sample.weight = reg->weight_;
+        sample.new_memory_limit = reg->evicter_->memory_limit();
+        out->push_back(sample);
+    }
+}
+
+void alt_memory_arbiter_t::apply_samples(
+        int thread, const std::vector<std::vector<sample_t> > *samples) {
+    on_thread_t th((threadnum_t(thread)));
+    ASSERT_NO_CORO_WAITING;
+    std::set<registration_t *> *regs = registrations_.get();
+    const std::vector<sample_t> &thread_samples = (*samples)[thread];
+    for (auto it = thread_samples.begin(); it != thread_samples.end(); ++it) {
+        // The cache might have been destroyed while we were computing limits.
+        if (regs->count(it->registration) == 1) {
+            it->registration->evicter_->update_memory_limit(it->new_memory_limit);
+        }
+    }
+}
+
+void alt_memory_arbiter_t::compute_memory_limits(std::vector<sample_t *> *samples) {
+    uint64_t pool = 0;
+    uint64_t floors = 0;
+    for (auto it = samples->begin(); it != samples->end(); ++it) {
+        pool += (*it)->base_memory_limit;
+        floors += (*it)->quota.floor;
+        (*it)->new_memory_limit = (*it)->quota.floor;
+    }
+
+    // Floors are honored even if they add up to more than the pool.
+    uint64_t remaining = pool > floors ? pool - floors : 0;
+
+    std::vector<sample_t *> active;
+    double total_weight = 0;
+    for (auto it = samples->begin(); it != samples->end(); ++it) {
+        if ((*it)->quota.ceiling > (*it)->quota.floor) {
+            active.push_back(*it);
+            total_weight += (*it)->weight;
+        }
+    }
+
+    // If nothing has been used lately, fall back to the configured sizes.
+    const bool use_base_limits = total_weight <= 0;
+
+    // Hand out the remaining memory proportionally to weight.  Caches that hit their
+    // ceiling drop out, and what they couldn't take is handed out again to the
+    // others.
+    while (remaining > 0 && !active.empty()) {
+        double weight_sum = 0;
+        for (auto it = active.begin(); it != active.end(); ++it) {
+            weight_sum += use_base_limits ? (*it)->base_memory_limit : (*it)->weight;
+        }
+        if (weight_sum <= 0) {
+            break;
+        }
+
+        uint64_t handed_out = 0;
+        std::vector<sample_t *> still_active;
+        for (auto it = active.begin(); it != active.end(); ++it) {
+            const double weight
+                = use_base_limits ? (*it)->base_memory_limit : (*it)->weight;
+            const uint64_t share = static_cast<uint64_t>(remaining * (weight / weight_sum));
+            const uint64_t room = (*it)->quota.ceiling - (*it)->new_memory_limit;
+            if (share >= room) {
+                (*it)->new_memory_limit = (*it)->quota.ceiling;
+                handed_out += room;
+            } else {
+                (*it)->new_memory_limit += share;
+                handed_out += share;
+                still_active.push_back(*it);
+            }
+        }
+
+        remaining -= std::min(remaining, handed_out);
+        if (still_active.size() == active.size()) {
+            // Nobody hit their ceiling, so only rounding error is left over.
+            break;
+        }
+        active.swap(still_active);
+    }
+}
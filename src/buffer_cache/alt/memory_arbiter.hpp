@@ -0,0 +1,96 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_ALT_MEMORY_ARBITER_HPP_
+#define BUFFER_CACHE_ALT_MEMORY_ARBITER_HPP_
+
+#include <stdint.h>
+
+#include <set>
+#include <vector>
+
+#include "arch/timing.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/one_per_thread.hpp"
+#include "threading.hpp"
+
+namespace alt {
+class evicter_t;
+}  // namespace alt
+
+// The bounds within which the alt_memory_arbiter_t may move a cache's memory limit.
+// A cache whose floor equals its ceiling keeps a fixed memory limit.
+class cache_memory_quota_t {
+public:
+    cache_memory_quota_t() : floor(0), ceiling(0) { }
+    cache_memory_quota_t(uint64_t _floor, uint64_t _ceiling)
+        : floor(_floor), ceiling(_ceiling) { }
+
+    uint64_t floor;
+    uint64_t ceiling;
+};
+
+// The alt_memory_arbiter_t is a node-wide object that periodically moves memory
+// between the evicters of different caches.  The memory it hands out is the sum of
+// the registered caches' configured memory limits, and each cache gets its floor
+// plus a share of the rest that is proportional to how much (and how recently) the
+// cache has been used, with misses counting more than hits.  No cache gets more
+// than its ceiling.
+class alt_memory_arbiter_t : public home_thread_mixin_t,
+                             private repeating_timer_callback_t {
+public:
+    alt_memory_arbiter_t();
+    ~alt_memory_arbiter_t();
+
+    // A registration_t lives on the evicter's thread, and must be destroyed before
+    // the evicter is.
+    class registration_t : public home_thread_mixin_debug_only_t {
+    public:
+        registration_t(alt_memory_arbiter_t *parent,
+                       alt::evicter_t *evicter,
+                       const cache_memory_quota_t &quota);
+        ~registration_t();
+
+    private:
+        friend class alt_memory_arbiter_t;
+
+        alt_memory_arbiter_t *const parent_;
+        alt::evicter_t *const evicter_;
+        // The memory limit the cache was configured with, which it contributes to
+        // the pool.
+        const uint64_t base_memory_limit_;
+        const cache_memory_quota_t quota_;
+
+        // An exponentially decaying measure of how much the cache has been used.
+        double weight_;
+
+        DISABLE_COPYING(registration_t);
+    };
+
+private:
+    struct sample_t {
+        registration_t *registration;
+        uint64_t base_memory_limit;
+        cache_memory_quota_t quota;
+        double weight;
+        uint64_t new_memory_limit;
+    };
+
+    void on_ring();
+    void rebalance(auto_drainer_t::lock_t lock);
+
+    void collect_samples(int thread, std::vector<std::vector<sample_t> > *samples);
+    void apply_samples(int thread, const std::vector<std::vector<sample_t> > *samples);
+
+    static void compute_memory_limits(std::vector<sample_t *> *samples);
+
+    // The registrations on each thread.  Each set is only accessed on its thread.
+    one_per_thread_t<std::set<registration_t *> > registrations_;
+
+    bool rebalance_in_progress_;
+
+    auto_drainer_t drainer_;
+    repeating_timer_t timer_;
+
+    DISABLE_COPYING(alt_memory_arbiter_t);
+};
+
+#endif  // BUFFER_CACHE_ALT_MEMORY_ARBITER_HPP_
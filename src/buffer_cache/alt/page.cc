@@ -2,7 +2,9 @@
 
 #include "arch/runtime/coroutines.hpp"
 #include "buffer_cache/alt/page_cache.hpp"
+#include "buffer_cache/alt/stats.hpp"
 #include "serializer/serializer.hpp"
+#include "time.hpp"
 
 namespace alt {
 
@@ -12,8 +14,10 @@ public:
         : abandon_page_(false) { }
     virtual ~page_loader_t() { }
 
-    virtual void added_waiter(page_cache_t *, cache_account_t *) {
+    // Returns whether this starts reading the block.
+    virtual bool added_waiter(page_cache_t *, cache_account_t *) {
         // Do nothing, in the default case.
+        return false;
     }
 
     bool abandon_page() const { return abandon_page_; }
@@ -40,6 +44,11 @@ page_t::page_t(block_id_t block_id, page_cache_t *page_cache)
       max_ser_block_size_(page_cache->max_block_size().ser_value()),
       ser_buf_size_(0),
       access_time_(page_cache->evicter().next_access_time()),
+      acquisition_count_(0),
+      reused_(false),
+      ghost_was_reused_(false),
+      ghost_eviction_clock_(0),
+      compressed_copy_(NULL),
       snapshot_refcount_(0) {
     page_cache->evicter().add_not_yet_loaded(this);
 
@@ -55,6 +64,11 @@ page_t::page_t(block_id_t block_id, page_cache_t *page_cache,
       max_ser_block_size_(page_cache->max_block_size().ser_value()),
       ser_buf_size_(0),
       access_time_(page_cache->evicter().next_access_time()),
+      acquisition_count_(0),
+      reused_(false),
+      ghost_was_reused_(false),
+      ghost_eviction_clock_(0),
+      compressed_copy_(NULL),
       snapshot_refcount_(0) {
     page_cache->evicter().add_not_yet_loaded(this);
 
@@ -72,6 +86,11 @@ page_t::page_t(block_size_t block_size, scoped_malloc_t<ser_buffer_t> buf,
       ser_buf_size_(block_size.ser_value()),
       buf_(std::move(buf)),
       access_time_(page_cache->evicter().next_access_time()),
+      acquisition_count_(0),
+      reused_(false),
+      ghost_was_reused_(false),
+      ghost_eviction_clock_(0),
+      compressed_copy_(NULL),
       snapshot_refcount_(0) {
     rassert(buf_.has());
     page_cache->evicter().add_to_evictable_unbacked(this);
@@ -86,6 +105,11 @@ page_t::page_t(scoped_malloc_t<ser_buffer_t> buf,
       buf_(std::move(buf)),
       block_token_(block_token),
       access_time_(READ_AHEAD_ACCESS_TIME),
+      acquisition_count_(0),
+      reused_(false),
+      ghost_was_reused_(false),
+      ghost_eviction_clock_(0),
+      compressed_copy_(NULL),
       snapshot_refcount_(0) {
     rassert(buf_.has());
     page_cache->evicter().add_to_evictable_disk_backed(this);
@@ -96,6 +120,11 @@ page_t::page_t(page_t *copyee, page_cache_t *page_cache, cache_account_t *accoun
       max_ser_block_size_(page_cache->max_block_size().ser_value()),
       ser_buf_size_(0),
       access_time_(page_cache->evicter().next_access_time()),
+      acquisition_count_(0),
+      reused_(false),
+      ghost_was_reused_(false),
+      ghost_eviction_clock_(0),
+      compressed_copy_(NULL),
       snapshot_refcount_(0) {
     page_cache->evicter().add_not_yet_loaded(this);
     coro_t::spawn_now_dangerously(std::bind(&page_t::load_from_copyee,
@@ -190,11 +219,12 @@ public:
         return std::move(block_token_ptr_);
     }
 
-    void added_waiter(page_cache_t *page_cache, cache_account_t *account) {
+    bool added_waiter(page_cache_t *page_cache, cache_account_t *account) {
         coro_t::spawn_now_dangerously(std::bind(&page_t::catch_up_with_deferred_load,
                                                 this,
                                                 page_cache,
                                                 account));
+        return true;
     }
 
     page_t *page() { return page_; }
@@ -234,6 +264,7 @@ void page_t::catch_up_with_deferred_load(
     deferred_loader->abandon_page();
 
     scoped_malloc_t<ser_buffer_t> buf;
+    const ticks_t start_ticks = get_ticks();
     {
         serializer_t *const serializer = page_cache->serializer_;
         buf = serializer_t::allocate_buffer(page_cache->max_block_size());
@@ -253,6 +284,9 @@ void page_t::catch_up_with_deferred_load(
     if (our_loader.abandon_page()) {
         return;
     }
+    if (page_cache->stats() != NULL) {
+        page_cache->stats()->record_miss_latency(get_ticks() - start_ticks);
+    }
 
     page_t::finish_load_with_block_id(page, page_cache,
                                       std::move(block_token_ptr->token),
@@ -320,6 +354,7 @@ void page_t::load_with_block_id(page_t *page, block_id_t block_id,
     scoped_malloc_t<ser_buffer_t> buf;
     counted_t<standard_block_token_t> block_token;
 
+    const ticks_t start_ticks = get_ticks();
     {
         serializer_t *const serializer = page_cache->serializer_;
         buf = serializer_t::allocate_buffer(page_cache->max_block_size());
@@ -336,6 +371,9 @@ void page_t::load_with_block_id(page_t *page, block_id_t block_id,
     if (loader.abandon_page()) {
         return;
     }
+    if (page_cache->stats() != NULL) {
+        page_cache->stats()->record_miss_latency(get_ticks() - start_ticks);
+    }
 
     page_t::finish_load_with_block_id(page, page_cache,
                                       std::move(block_token),
@@ -389,11 +427,26 @@ void page_t::add_waiter(page_acq_t *acq, cache_account_t *account) {
         = acq->page_cache()->evicter().correct_eviction_category(this);
     waiters_.push_back(acq);
     acq->page_cache()->evicter().change_to_correct_eviction_bag(old_bag, this);
+    acq->page_cache()->evicter().note_page_acquired(this);
+    alt_cache_stats_t *const stats = acq->page_cache()->stats();
+    if (stats != NULL) {
+        if (buf_.has()) {
+            stats->record_page_hit();
+        } else {
+            stats->record_page_miss();
+        }
+    }
+    acq->cache_miss_ = !buf_.has();
     if (buf_.has()) {
         acq->buf_ready_signal_.pulse();
     } else if (loader_ != NULL) {
-        loader_->added_waiter(acq->page_cache(), account);
+        if (loader_->added_waiter(acq->page_cache(), account)) {
+            acq->disk_bytes_read_ = max_ser_block_size_;
+        }
     } else if (block_token_.has()) {
+        if (compressed_copy_ == NULL) {
+            acq->disk_bytes_read_ = block_token_->block_size().ser_value();
+        }
         coro_t::spawn_now_dangerously(std::bind(&page_t::load_using_block_token,
                                                 this,
                                                 acq->page_cache(),
@@ -418,20 +471,28 @@ void page_t::load_using_block_token(page_t *page, page_cache_t *page_cache,
     rassert(block_token.has());
 
     scoped_malloc_t<ser_buffer_t> buf;
+    const ticks_t start_ticks = get_ticks();
     {
         serializer_t *const serializer = page_cache->serializer_;
         buf = serializer_t::allocate_buffer(page_cache->max_block_size());
 
-        on_thread_t th(serializer->home_thread());
-        serializer->block_read(block_token,
-                               buf.get(),
-                               account->get());
+        // The compressed tier has a copy of many evicted pages, which saves us the
+        // disk read.
+        if (!page_cache->evicter().take_compressed_copy(page, buf.get())) {
+            on_thread_t th(serializer->home_thread());
+            serializer->block_read(block_token,
+                                   buf.get(),
+                                   account->get());
+        }
     }
 
     ASSERT_FINITE_CORO_WAITING;
     if (loader.abandon_page()) {
         return;
     }
+    if (page_cache->stats() != NULL) {
+        page_cache->stats()->record_miss_latency(get_ticks() - start_ticks);
+    }
 
     rassert(page->block_token_.get() == block_token.get());
     rassert(!page->buf_.has());
@@ -496,7 +557,8 @@ void page_t::evict_self() {
 }
 
 
-page_acq_t::page_acq_t() : page_(NULL), page_cache_(NULL) {
+page_acq_t::page_acq_t()
+    : page_(NULL), page_cache_(NULL), cache_miss_(false), disk_bytes_read_(0) {
 }
 
 void page_acq_t::init(page_t *page, page_cache_t *page_cache,
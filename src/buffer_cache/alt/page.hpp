@@ -12,6 +12,7 @@ namespace alt {
 
 class page_cache_t;
 class page_acq_t;
+class compressed_page_t;
 
 class page_loader_t;
 class deferred_page_loader_t;
@@ -56,6 +57,7 @@ public:
     bool has_waiters() const { return !waiters_.empty(); }
     bool is_evicted() const { return !buf_.has(); }
     bool is_disk_backed() const { return block_token_.has(); }
+    uint64_t access_time() const { return access_time_; }
 
     void evict_self();
 
@@ -97,6 +99,8 @@ private:
 
     friend class page_cache_t;
     friend class eviction_bag_t;
+    friend class evicter_t;
+    friend class compressed_page_tier_t;
     friend backindex_bag_index_t *access_backindex(page_t *page);
 
     // KSI: Explain this more.
@@ -114,6 +118,23 @@ private:
 
     uint64_t access_time_;
 
+    // Replacement policy state, managed by the evicter_t.  How many times the page
+    // has been acquired since it was last loaded (saturating at 2), and whether the
+    // page counts as reused.  reused_ only changes while the page is in the
+    // unevictable bag, since it decides which evictable bag the page goes in.
+    uint8_t acquisition_count_;
+    bool reused_;
+    // Whether the page was reused when it was last evicted.
+    bool ghost_was_reused_;
+    // If the page is evicted, the evicter's eviction clock at the time it was
+    // evicted (so we can tell if it's still on the ghost list).  0 if the page has
+    // not been evicted.
+    uint64_t ghost_eviction_clock_;
+
+    // If the page is evicted, possibly a compressed copy of its buffer, owned by the
+    // evicter's compressed_page_tier_t.
+    compressed_page_t *compressed_copy_;
+
     // How many page_ptr_t's point at this page, expecting nothing to modify it,
     // other than themselves.
     size_t snapshot_refcount_;
@@ -223,12 +244,21 @@ public:
     void *get_buf_write(block_size_t block_size);
     const void *get_buf_read();
 
+    // Whether the page wasn't in memory when init() was called, and how many bytes
+    // init() started reading from disk for it.  That's 0 if the page came from the
+    // compressed tier or was already being read for someone else, and an upper
+    // bound if the block had never been loaded before.
+    bool cache_miss() const { return cache_miss_; }
+    uint32_t disk_bytes_read() const { return disk_bytes_read_; }
+
 private:
     friend class page_t;
 
     page_t *page_;
     page_cache_t *page_cache_;
     cond_t buf_ready_signal_;
+    bool cache_miss_;
+    uint32_t disk_bytes_read_;
     DISABLE_COPYING(page_acq_t);
 };
 
@@ -5,6 +5,9 @@
 #include <stack>
 
 #include "arch/runtime/coroutines.hpp"
+#include "buffer_cache/alt/block_trace.hpp"
+#include "buffer_cache/alt/stats.hpp"
+#include "buffer_cache/alt/writeback_scheduler.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "do_on_thread.hpp"
 #include "serializer/serializer.hpp"
@@ -138,16 +141,122 @@ void page_cache_t::read_ahead_cb_is_destroyed() {
     read_ahead_cb_existence_.reset();
 }
 
+std::vector<block_id_t> page_cache_t::hottest_block_ids(size_t max_count) {
+    assert_thread();
+    ASSERT_NO_CORO_WAITING;
+
+    std::vector<std::pair<uint64_t, block_id_t> > resident;
+    for (block_id_t block_id = 0; block_id < current_pages_.size(); ++block_id) {
+        current_page_t *current_page = current_pages_[block_id];
+        if (current_page == NULL || current_page->is_deleted()
+            || !current_page->page_.has()) {
+            continue;
+        }
+        page_t *page = current_page->page_.get_page_for_read();
+        if (!page->is_evicted() && page->is_disk_backed()) {
+            resident.push_back(std::make_pair(page->access_time(), block_id));
+        }
+    }
+
+    std::sort(resident.begin(), resident.end(),
+              std::greater<std::pair<uint64_t, block_id_t> >());
+
+    std::vector<block_id_t> ret;
+    ret.reserve(std::min(max_count, resident.size()));
+    for (auto it = resident.begin(); it != resident.end() && ret.size() < max_count;
+         ++it) {
+        ret.push_back(it->second);
+    }
+    return ret;
+}
+
+void page_cache_t::warm_up(std::vector<block_id_t> block_ids) {
+    assert_thread();
+    if (!block_ids.empty()) {
+        coro_t::spawn_sometime(std::bind(&page_cache_t::do_warm_up,
+                                         this, std::move(block_ids),
+                                         drainer_->lock()));
+    }
+}
+
+struct warm_up_block_t {
+    block_id_t block_id;
+    counted_t<standard_block_token_t> token;
+
+    bool operator<(const warm_up_block_t &other) const {
+        return token->offset() < other.token->offset();
+    }
+};
+
+void page_cache_t::do_warm_up(std::vector<block_id_t> block_ids,
+                              auto_drainer_t::lock_t lock) {
+    assert_thread();
+
+    std::vector<warm_up_block_t> blocks;
+    {
+        on_thread_t th(serializer_->home_thread());
+        const block_id_t max_block_id = serializer_->max_block_id();
+        for (auto it = block_ids.begin(); it != block_ids.end(); ++it) {
+            if (*it >= max_block_id) {
+                continue;
+            }
+            warm_up_block_t block;
+            block.block_id = *it;
+            block.token = serializer_->index_read(*it);
+            if (block.token.has()) {
+                blocks.push_back(block);
+            }
+        }
+        // Reading in disk order turns the warm-up into mostly sequential I/O (and
+        // lets the serializer's own read-ahead pick up neighboring blocks).
+        std::sort(blocks.begin(), blocks.end());
+    }
+
+    for (auto it = blocks.begin(); it != blocks.end(); ++it) {
+        if (lock.get_drain_signal()->is_pulsed()) {
+            return;
+        }
+        if (!evicter_.interested_in_read_ahead_block(max_block_size().ser_value())) {
+            return;
+        }
+        if (it->block_id < current_pages_.size()
+            && current_pages_[it->block_id] != NULL) {
+            continue;
+        }
+
+        scoped_malloc_t<ser_buffer_t> buf
+            = serializer_t::allocate_buffer(max_block_size());
+        {
+            on_thread_t th(serializer_->home_thread());
+            serializer_->block_read(it->token, buf.get(),
+                                    default_reads_account_.get());
+        }
+
+        // The block might have been acquired (or created, or deleted) while we were
+        // reading it, in which case our copy is not needed.
+        resize_current_pages_to_id(it->block_id);
+        if (current_pages_[it->block_id] == NULL) {
+            current_pages_[it->block_id]
+                = new current_page_t(std::move(buf), it->token, this);
+        }
+    }
+}
+
 
 page_cache_t::page_cache_t(serializer_t *serializer,
                            const page_cache_config_t &config,
-                           memory_tracker_t *tracker)
+                           memory_tracker_t *tracker,
+                           alt_cache_stats_t *stats)
     : dynamic_config_(config),
       max_block_size_(serializer->max_block_size()),
       serializer_(serializer),
+      stats_(stats),
+      trace_cache_id_(block_tracer_t::new_cache_id()),
       free_list_(serializer),
-      evicter_(tracker, config.memory_limit),
+      evicter_(tracker, stats, config.memory_limit, config.eviction_policy,
+               config.compressed_tier_percent),
       read_ahead_cb_(NULL),
+      grouped_flush_timer_(NULL),
       drainer_(make_scoped<auto_drainer_t>()) {
 
     const bool start_read_ahead = config.memory_limit > 0;
@@ -162,18 +271,36 @@ page_cache_t::page_cache_t(serializer_t *serializer,
                                                       config.memory_limit);
         }
         default_reads_account_.init(serializer->home_thread(),
-                                    serializer->make_io_account(config.io_priority_reads));
+                                    serializer->make_io_account(config.io_priority_reads,
+                                                                UNLIMITED_OUTSTANDING_REQUESTS,
+                                                                CACHE_READS_IO_DEADLINE_MS));
         writes_io_account_.init(serializer->make_io_account(config.io_priority_writes));
         index_write_sink_.init(new fifo_enforcer_sink_t);
         recencies_ = serializer->get_all_recencies();
     }
+
+    writeback_scheduler_.init(new writeback_scheduler_t(this));
+    if (stats_ != NULL) {
+        stats_->set_evicter(&evicter_, max_block_size_);
+    }
 }
 
 page_cache_t::~page_cache_t() {
     assert_thread();
 
+    if (stats_ != NULL) {
+        stats_->set_evicter(NULL, max_block_size_);
+    }
+    writeback_scheduler_.reset();
     have_read_ahead_cb_destroyed();
 
+    // The txns whose flushes we put off have waiters holding locks on drainer_.
+    if (grouped_flush_timer_ != NULL) {
+        cancel_timer(grouped_flush_timer_);
+        grouped_flush_timer_ = NULL;
+    }
+    flush_grouped_txns(drainer_->lock());
+
     drainer_.reset();
     for (auto it = current_pages_.begin(); it != current_pages_.end(); ++it) {
         delete *it;
@@ -230,11 +357,13 @@ private:
 
 void page_cache_t::flush_and_destroy_txn(
         scoped_ptr_t<page_txn_t> txn,
-        std::function<void(tracker_acq_t *)> on_flush_complete) {
+        std::function<void(tracker_acq_t *)> on_flush_complete,
+        txn_flush_t flush) {
     rassert(txn->live_acqs_.empty(),
             "current_page_acq_t lifespan exceeds its page_txn_t's");
     guarantee(!txn->began_waiting_for_flush_);
 
+    txn->flush_ = flush;
     txn->announce_waiting_for_flush();
 
     page_txn_t *page_txn = txn.release();
@@ -338,6 +467,73 @@ struct current_page_help_t {
     page_cache_t *page_cache;
 };
 
+void page_cache_t::prefetch_block(block_id_t block_id, cache_account_t *account) {
+    assert_thread();
+
+    current_page_t *current_page
+        = block_id < current_pages_.size() ? current_pages_[block_id] : NULL;
+    if (current_page == NULL) {
+        // The block could have been deleted since the caller looked up its id (if the
+        // caller is a snapshotted reader).
+        if (recency_for_block_id(block_id) == repli_timestamp_t::invalid) {
+            return;
+        }
+        current_page = page_for_block_id(block_id);
+    } else if (current_page->is_deleted()) {
+        return;
+    }
+
+    if (!current_page->page_.has()) {
+        // This starts loading the page.
+        current_page->convert_from_serializer_if_necessary(
+                current_page_help_t(block_id, this), account);
+        return;
+    }
+
+    page_t *page = current_page->page_.get_page_for_read();
+    // Pages with a compressed copy are cheap to load when they're needed.
+    if (page->is_evicted() && !page->is_loading()
+        && page->compressed_copy_ == NULL) {
+        rassert(page->is_disk_backed());
+        eviction_bag_t *old_bag = evicter_.correct_eviction_category(page);
+        // This sets the page's loader_ before it returns, which makes the page
+        // unevictable until it's loaded.
+        coro_t::spawn_now_dangerously(std::bind(&page_t::load_using_block_token,
+                                                page, this, account));
+        evicter_.change_to_correct_eviction_bag(old_bag, page);
+    }
+}
+
+const void *page_cache_t::peek_current_page(block_id_t block_id,
+                                            bool *write_waiting_out) {
+    assert_thread();
+    ASSERT_NO_CORO_WAITING;
+    *write_waiting_out = false;
+
+    current_page_t *current_page
+        = block_id < current_pages_.size() ? current_pages_[block_id] : NULL;
+    if (current_page == NULL || current_page->is_deleted()
+        || !current_page->page_.has()) {
+        return NULL;
+    }
+
+    bool write_held;
+    current_page->check_write_acquirers(&write_held, write_waiting_out);
+    if (write_held) {
+        // The writer might be in the middle of changing the page (or, with its
+        // other pages, the tree around it).
+        return NULL;
+    }
+
+    page_t *page = current_page->page_.get_page_for_read();
+    if (page->is_evicted()) {
+        return NULL;
+    }
+    // This counts as an access of the page, so that pages that are only ever
+    // peeked at don't look cold to the evicter.
+    return page->get_page_buf(this);
+}
+
 current_page_acq_t::current_page_acq_t()
     : page_cache_(NULL), the_txn_(NULL) { }
 
@@ -381,6 +577,9 @@ void current_page_acq_t::init(page_txn_t *txn,
             current_page_ = page_cache_->page_for_new_chosen_block_id(block_id);
         } else {
             current_page_ = page_cache_->page_for_block_id(block_id);
+            if (page_cache_->stats() != NULL) {
+                page_cache_->stats()->record_block_access(block_id);
+            }
         }
         dirtied_page_ = false;
 
@@ -415,6 +614,9 @@ void current_page_acq_t::init(page_cache_t *page_cache,
     declared_snapshotted_ = false;
     block_id_ = block_id;
     current_page_ = page_cache_->page_for_block_id(block_id);
+    if (page_cache_->stats() != NULL) {
+        page_cache_->stats()->record_block_access(block_id);
+    }
     dirtied_page_ = false;
 
     current_page_->add_acquirer(this);
@@ -658,6 +860,23 @@ void current_page_t::remove_acquirer(current_page_acq_t *acq) {
     }
 }
 
+void current_page_t::check_write_acquirers(bool *write_held_out,
+                                           bool *write_waiting_out) const {
+    *write_held_out = false;
+    *write_waiting_out = false;
+    for (current_page_acq_t *acq = acquirers_.head();
+         acq != NULL;
+         acq = acquirers_.next(acq)) {
+        if (acq->access_ == access_t::write) {
+            if (acq->write_cond_.is_pulsed()) {
+                *write_held_out = true;
+            } else {
+                *write_waiting_out = true;
+            }
+        }
+    }
+}
+
 void current_page_t::pulse_pulsables(current_page_acq_t *const acq) {
     const current_page_help_t help = acq->help();
 
@@ -813,7 +1032,8 @@ page_txn_t::page_txn_t(page_cache_t *page_cache,
       tracker_acq_(std::move(tracker_acq)),
       this_txn_recency_(txn_recency),
       began_waiting_for_flush_(false),
-      spawned_flush_(false) {
+      spawned_flush_(false),
+      flush_(txn_flush_t::now) {
     if (cache_conn != NULL) {
         page_txn_t *old_newest_txn = cache_conn->newest_txn_;
         cache_conn->newest_txn_ = this;
@@ -856,6 +1076,7 @@ void page_txn_t::remove_subseqer(page_txn_t *subseqer) {
 
 page_txn_t::~page_txn_t() {
     guarantee(flush_complete_cond_.is_pulsed());
+    rassert(!in_a_list());
 
     guarantee(preceders_.empty());
     guarantee(subseqers_.empty());
@@ -918,6 +1139,7 @@ void page_txn_t::announce_waiting_for_flush() {
     rassert(live_acqs_.empty());
     rassert(!began_waiting_for_flush_);
     began_waiting_for_flush_ = true;
+    page_cache_->waiting_for_flush_txns_.push_back(this);
     std::set<page_txn_t *> txns;
     txns.insert(this);
     page_cache_->im_waiting_for_flush(std::move(txns));
@@ -1125,6 +1347,13 @@ void page_cache_t::do_flush_changes(page_cache_t *page_cache,
                         rassert(page->loader_ == NULL);
                         rassert(page->buf_.has());
 
+                        // If the writeback scheduler is writing the page right now,
+                        // we take it over, so that the page doesn't become
+                        // disk-backed (and evictable) while we write its buf.
+                        if (!page_cache->writing_back_pages_.empty()) {
+                            page_cache->writing_back_pages_.erase(page);
+                        }
+
                         // KSI: Is there a page_acq_t for this buf we're writing?  Is it
                         // possible that we might be trying to do an unbacked eviction
                         // for this page right now?  (No, we don't do that yet.)
@@ -1264,6 +1493,110 @@ void page_cache_t::do_flush_txn_set(page_cache_t *page_cache,
     page_cache->im_waiting_for_flush(std::move(unblocked));
 }
 
+// Whether the writeback scheduler could write the dirtied page.
+static bool is_write_back_candidate(const std::set<page_t *> &writing_back_pages,
+                                    const dirtied_page_t &d) {
+    if (!d.ptr.has()) {
+        // The block is deleted.
+        return false;
+    }
+    page_t *page = d.ptr.get_page_for_read();
+    return !page->is_disk_backed() && !page->is_evicted() && !page->is_loading()
+        && writing_back_pages.find(page) == writing_back_pages.end();
+}
+
+size_t page_cache_t::write_back_candidate_count() {
+    assert_thread();
+    size_t count = 0;
+    for (page_txn_t *txn = waiting_for_flush_txns_.head();
+         txn != NULL;
+         txn = waiting_for_flush_txns_.next(txn)) {
+        for (size_t i = 0, e = txn->snapshotted_dirtied_pages_.size(); i < e; ++i) {
+            if (is_write_back_candidate(writing_back_pages_,
+                                        txn->snapshotted_dirtied_pages_[i])) {
+                ++count;
+            }
+        }
+    }
+    return count;
+}
+
+uint64_t page_cache_t::write_back_pages(uint64_t max_bytes) {
+    assert_thread();
+
+    // The page_ptr_t's keep the pages alive, even if their txns get flushed and
+    // destroyed in the meantime.  The page_acq_t's keep their bufs from getting
+    // evicted, which could happen if do_flush_changes makes them disk-backed.
+    std::vector<page_ptr_t> page_ptrs;
+    std::vector<buf_write_info_t> write_infos;
+    uint64_t bytes = 0;
+    {
+        ASSERT_NO_CORO_WAITING;
+        bool batch_is_full = false;
+        for (page_txn_t *txn = waiting_for_flush_txns_.head();
+             txn != NULL && !batch_is_full;
+             txn = waiting_for_flush_txns_.next(txn)) {
+            for (size_t i = 0, e = txn->snapshotted_dirtied_pages_.size(); i < e; ++i) {
+                const dirtied_page_t &d = txn->snapshotted_dirtied_pages_[i];
+                if (!is_write_back_candidate(writing_back_pages_, d)) {
+                    continue;
+                }
+                page_t *page = d.ptr.get_page_for_read();
+                if (bytes + page->ser_buf_size_ > max_bytes) {
+                    batch_is_full = true;
+                    break;
+                }
+                writing_back_pages_.insert(page);
+                page_ptrs.push_back(page_ptr_t(page, this));
+                write_infos.push_back(buf_write_info_t(page->buf_.get(),
+                                                       block_size_t::unsafe_make(page->ser_buf_size_),
+                                                       d.block_id));
+                bytes += page->ser_buf_size_;
+            }
+        }
+    }
+
+    if (write_infos.empty()) {
+        return 0;
+    }
+
+    scoped_array_t<page_acq_t> page_acqs(page_ptrs.size());
+    for (size_t i = 0; i < page_ptrs.size(); ++i) {
+        page_acqs[i].init(page_ptrs[i].get_page_for_read(), this,
+                          &default_reads_account_);
+    }
+
+    std::vector<counted_t<standard_block_token_t> > tokens;
+    {
+        on_thread_t th(serializer_->home_thread());
+
+        struct : public iocallback_t, public cond_t {
+            void on_io_complete() {
+                pulse();
+            }
+        } blocks_releasable_cb;
+
+        tokens = serializer_->block_writes(write_infos, writes_io_account_.get(),
+                                           &blocks_releasable_cb);
+        blocks_releasable_cb.wait();
+    }
+
+    rassert(tokens.size() == page_ptrs.size());
+    for (size_t i = 0; i < page_ptrs.size(); ++i) {
+        page_t *page = page_ptrs[i].get_page_for_read();
+        // If do_flush_changes took the page over, it gives the page its own block
+        // token, and ours just gets dropped.
+        if (writing_back_pages_.erase(page) == 1) {
+            rassert(!page->block_token_.has());
+            eviction_bag_t *old_bag = evicter_.correct_eviction_category(page);
+            page->block_token_ = std::move(tokens[i]);
+            evicter_.change_to_correct_eviction_bag(old_bag, page);
+        }
+    }
+
+    return bytes;
+}
+
 bool page_cache_t::exists_flushable_txn_set(page_txn_t *txn,
                                             std::set<page_txn_t *> *flush_set_out) {
     assert_thread();
@@ -1304,6 +1637,27 @@ bool page_cache_t::exists_flushable_txn_set(page_txn_t *txn,
     return true;
 }
 
+void page_cache_t::on_timer() {
+    // The timer token deletes itself after firing once.
+    grouped_flush_timer_ = NULL;
+    coro_t::spawn_sometime(std::bind(&page_cache_t::flush_grouped_txns,
+                                     this, drainer_->lock()));
+}
+
+void page_cache_t::flush_grouped_txns(auto_drainer_t::lock_t) {
+    assert_thread();
+    std::set<page_txn_t *> txns;
+    for (page_txn_t *txn = waiting_for_flush_txns_.head();
+         txn != NULL;
+         txn = waiting_for_flush_txns_.next(txn)) {
+        if (txn->flush_ == txn_flush_t::grouped) {
+            txn->flush_ = txn_flush_t::now;
+            txns.insert(txn);
+        }
+    }
+    im_waiting_for_flush(std::move(txns));
+}
+
 void page_cache_t::im_waiting_for_flush(std::set<page_txn_t *> queue) {
     assert_thread();
     ASSERT_FINITE_CORO_WAITING;
@@ -1341,9 +1695,24 @@ void page_cache_t::im_waiting_for_flush(std::set<page_txn_t *> queue) {
 
         std::set<page_txn_t *> flush_set;
         if (exists_flushable_txn_set(txn, &flush_set)) {
+            if (dynamic_config_.group_soft_loss_window_ms > 0
+                && std::all_of(flush_set.begin(), flush_set.end(),
+                               [](page_txn_t *t) {
+                                   return t->flush_ == txn_flush_t::grouped;
+                               })) {
+                // The flush set stays waiting, so that later txns' flushes can
+                // take it along, until on_timer flushes it.
+                if (grouped_flush_timer_ == NULL) {
+                    grouped_flush_timer_ = fire_timer_once(
+                        dynamic_config_.group_soft_loss_window_ms, this);
+                }
+                continue;
+            }
+
             for (auto it = flush_set.begin(); it != flush_set.end(); ++it) {
                 rassert(!(*it)->spawned_flush_);
                 (*it)->spawned_flush_ = true;
+                waiting_for_flush_txns_.remove(*it);
             }
 
             std::map<block_id_t, block_change_t> changes
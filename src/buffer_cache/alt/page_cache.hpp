@@ -8,6 +8,7 @@
 #include <utility>
 #include <vector>
 
+#include "arch/timer.hpp"
 #include "buffer_cache/alt/block_version.hpp"
 #include "buffer_cache/alt/cache_account.hpp"
 #include "buffer_cache/alt/config.hpp"
@@ -26,6 +27,7 @@
 #include "repli_timestamp.hpp"
 #include "serializer/types.hpp"
 
+class alt_cache_stats_t;
 class alt_memory_tracker_t;
 class auto_drainer_t;
 class cache_t;
@@ -35,9 +37,15 @@ namespace alt {
 class current_page_acq_t;
 class page_cache_t;
 class page_txn_t;
+class writeback_scheduler_t;
 
 enum class page_create_t { no, yes };
 
+// Whether page_cache_t::flush_and_destroy_txn may put off a txn's flush, to do it
+// along with the flushes of other such txns (see group_soft_loss_window_ms in
+// page_cache_config_t).
+enum class txn_flush_t { now, grouped };
+
 }  // namespace alt
 
 enum class alt_create_t { create };
@@ -118,6 +126,10 @@ private:
 
     bool is_deleted() const { return is_deleted_; }
 
+    // Tells whether some acquirer currently has write access to the page, and
+    // whether some write acquirer is in line for it.
+    void check_write_acquirers(bool *write_held_out, bool *write_waiting_out) const;
+
     void make_non_deleted(block_size_t block_size,
                           scoped_malloc_t<ser_buffer_t> buf,
                           page_cache_t *page_cache);
@@ -288,18 +300,21 @@ private:
     DISABLE_COPYING(tracker_acq_t);
 };
 
-class page_cache_t : public home_thread_mixin_t {
+class page_cache_t : public home_thread_mixin_t, private timer_callback_t {
 public:
+    // stats can be NULL (in unit tests).
     page_cache_t(serializer_t *serializer,
                  const page_cache_config_t &config,
-                 memory_tracker_t *tracker);
+                 memory_tracker_t *tracker,
+                 alt_cache_stats_t *stats);
     ~page_cache_t();
 
     // Takes a txn to be flushed.  Calls on_flush_complete() (which resets the
     // tracker_acq parameter) when done.
     void flush_and_destroy_txn(
             scoped_ptr_t<page_txn_t> txn,
-            std::function<void(tracker_acq_t *)> on_flush_complete);
+            std::function<void(tracker_acq_t *)> on_flush_complete,
+            txn_flush_t flush = txn_flush_t::now);
 
     current_page_t *page_for_block_id(block_id_t block_id);
     current_page_t *page_for_new_block_id(block_id_t *block_id_out);
@@ -318,7 +333,46 @@ public:
         return &default_reads_account_;
     }
 
+    evicter_t &evicter() { return evicter_; }
+
+    // Can be NULL.
+    alt_cache_stats_t *stats() { return stats_; }
+
+    // Identifies this cache's blocks in block traces.
+    uint32_t trace_cache_id() const { return trace_cache_id_; }
+
+    // Returns the block ids of up to max_count resident, unmodified pages, most
+    // recently accessed first.
+    std::vector<block_id_t> hottest_block_ids(size_t max_count);
+
+    // Starts loading the given blocks into the cache in the background, for as long
+    // as the evicter has room for them.  They're read in the order they're laid out
+    // on disk.  Blocks that are already in the cache (or were deleted) are skipped.
+    void warm_up(std::vector<block_id_t> block_ids);
+
+    // Starts loading the block in the background if it isn't in memory.  This
+    // doesn't count as an access of the page, as far as the evicter is concerned.
+    void prefetch_block(block_id_t block_id, cache_account_t *account);
+
+    // Returns the current contents of the block without acquiring it, if that's
+    // safe: if the page is in memory and nobody has write access to it.  Returns
+    // NULL otherwise.  Sets *write_waiting_out to whether a write acquirer is in
+    // line for the block.  The pointer is only good until the caller blocks.
+    const void *peek_current_page(block_id_t block_id, bool *write_waiting_out);
+
 private:
+    void do_warm_up(std::vector<block_id_t> block_ids, auto_drainer_t::lock_t lock);
+
+    friend class writeback_scheduler_t;
+    // How many dirty pages of txns in waiting_for_flush_txns_ could be written back
+    // (because they aren't disk-backed yet, or being written back).
+    size_t write_back_candidate_count();
+    // Writes up to max_bytes of such pages to disk (but at least one page, if
+    // there's any and max_bytes is at least max_block_size()), and makes them
+    // disk-backed.  Returns how many bytes were written, once the writes are
+    // complete.
+    uint64_t write_back_pages(uint64_t max_bytes);
+
     friend class page_read_ahead_cb_t;
     void add_read_ahead_buf(block_id_t block_id,
                             ser_buffer_t *buf,
@@ -332,7 +386,6 @@ private:
     current_page_t *internal_page_for_new_chosen(block_id_t block_id);
 
     friend class page_t;
-    evicter_t &evicter() { return evicter_; }
 
     // KSI: Maybe just have txn_t hold a single list of block_change_t objects.
     struct block_change_t {
@@ -373,6 +426,11 @@ private:
 
     void im_waiting_for_flush(std::set<page_txn_t *> txns);
 
+    // Rings group_soft_loss_window_ms after a flush set of grouped txns was put off.
+    void on_timer();
+    // Makes the grouped txns that are waiting for flush flush now.
+    void flush_grouped_txns(auto_drainer_t::lock_t lock);
+
     friend class current_page_acq_t;
     repli_timestamp_t recency_for_block_id(block_id_t id) {
         return recencies_.size() <= id
@@ -416,6 +474,9 @@ private:
     scoped_ptr_t<fifo_enforcer_sink_t> index_write_sink_;
 
     serializer_t *serializer_;
+    alt_cache_stats_t *const stats_;
+
+    const uint32_t trace_cache_id_;
     segmented_vector_t<repli_timestamp_t> recencies_;
 
     // RSP: Array growth slow.
@@ -433,8 +494,20 @@ private:
     // destroyed and all possible read-ahead operations have completed.
     auto_drainer_t::lock_t read_ahead_cb_existence_;
 
+    // Txns that are waiting for flush and haven't started flushing, oldest first.
+    intrusive_list_t<page_txn_t> waiting_for_flush_txns_;
+    // Set while the flushes of some grouped txns are put off.
+    timer_token_t *grouped_flush_timer_;
+    // The pages that write_back_pages is currently writing.  do_flush_changes
+    // removes the pages it writes itself, and write_back_pages then throws away
+    // its block tokens for them.
+    std::set<page_t *> writing_back_pages_;
+
     scoped_ptr_t<auto_drainer_t> drainer_;
 
+    // This gets destroyed first, since it uses everything else.
+    scoped_ptr_t<writeback_scheduler_t> writeback_scheduler_;
+
     DISABLE_COPYING(page_cache_t);
 };
 
@@ -506,7 +579,7 @@ public:
 // their copies of the block.
 //
 // LSI: Make situation '(a)' happenable.
-class page_txn_t {
+class page_txn_t : public intrusive_list_node_t<page_txn_t> {
 public:
     // Our transaction has to get committed to disk _after_ or at the same time as
     // preceding transactions on cache_conn, if that parameter is not NULL.  (The
@@ -598,10 +671,15 @@ private:
     // from the graph?
 
     // Tells whether this page_txn_t has announced itself (to the cache) to be
-    // waiting for a flush.
+    // waiting for a flush.  It's in the page cache's waiting_for_flush_txns_ list
+    // from then until spawned_flush_ gets set.
     bool began_waiting_for_flush_;
     bool spawned_flush_;
 
+    // Set by flush_and_destroy_txn.  The flush is put off as long as everything
+    // in the flush set is grouped.
+    txn_flush_t flush_;
+
     // This gets pulsed when the flush is complete or when the txn has no reason to
     // exist any more.
     cond_t flush_complete_cond_;
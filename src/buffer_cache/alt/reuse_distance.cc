@@ -0,0 +1,124 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "buffer_cache/alt/reuse_distance.hpp"
+
+#include <algorithm>
+
+namespace alt {
+
+reuse_distance_estimator_t::reuse_distance_estimator_t(int sample_shift,
+                                                       size_t max_tracked_blocks)
+    : sample_shift_(sample_shift),
+      max_tracked_blocks_(max_tracked_blocks),
+      fenwick_(2 * max_tracked_blocks + 1, 0),
+      sampled_accesses_(0),
+      cold_accesses_(0) {
+    guarantee(sample_shift_ >= 0 && sample_shift_ < 64);
+    guarantee(max_tracked_blocks_ > 0);
+    slot_blocks_.reserve(2 * max_tracked_blocks_);
+    std::fill(distance_buckets_, distance_buckets_ + NUM_BUCKETS, 0);
+}
+
+bool reuse_distance_estimator_t::is_sampled(block_id_t block_id) const {
+    if (sample_shift_ == 0) {
+        return true;
+    }
+    // Fibonacci hashing, so that block ids that are handed out sequentially are
+    // sampled evenly.
+    const uint64_t hash = static_cast<uint64_t>(block_id) * 0x9E3779B97F4A7C15ULL;
+    return (hash >> (64 - sample_shift_)) == 0;
+}
+
+void reuse_distance_estimator_t::record_access(block_id_t block_id) {
+    if (!is_sampled(block_id)) {
+        return;
+    }
+    ++sampled_accesses_;
+
+    auto it = last_slots_.find(block_id);
+    if (it == last_slots_.end()) {
+        ++cold_accesses_;
+    } else {
+        const size_t slot = it->second;
+        const int64_t live_after = fenwick_prefix_sum(slot_blocks_.size())
+            - fenwick_prefix_sum(slot + 1);
+        ++distance_buckets_[bucket_for_distance(
+            static_cast<uint64_t>(live_after) << sample_shift_)];
+        fenwick_add(slot, -1);
+        slot_blocks_[slot] = NULL_BLOCK_ID;
+    }
+
+    if (slot_blocks_.size() == 2 * max_tracked_blocks_) {
+        compact();
+    }
+    const size_t new_slot = slot_blocks_.size();
+    slot_blocks_.push_back(block_id);
+    fenwick_add(new_slot, 1);
+    last_slots_[block_id] = new_slot;
+}
+
+void reuse_distance_estimator_t::compact() {
+    std::vector<block_id_t> live;
+    live.reserve(last_slots_.size());
+    for (auto it = slot_blocks_.begin(); it != slot_blocks_.end(); ++it) {
+        if (*it != NULL_BLOCK_ID) {
+            live.push_back(*it);
+        }
+    }
+
+    // Leave room for the access that's being recorded.
+    const size_t keep = std::min(live.size(), max_tracked_blocks_ - 1);
+    for (size_t i = 0; i < live.size() - keep; ++i) {
+        last_slots_.erase(live[i]);
+    }
+
+    slot_blocks_.assign(live.end() - keep, live.end());
+    std::fill(fenwick_.begin(), fenwick_.end(), 0);
+    for (size_t i = 0; i < slot_blocks_.size(); ++i) {
+        fenwick_add(i, 1);
+        last_slots_[slot_blocks_[i]] = i;
+    }
+}
+
+void reuse_distance_estimator_t::fenwick_add(size_t slot, int32_t delta) {
+    for (size_t i = slot + 1; i < fenwick_.size(); i += i & (~i + 1)) {
+        fenwick_[i] += delta;
+    }
+}
+
+int64_t reuse_distance_estimator_t::fenwick_prefix_sum(size_t slot) const {
+    int64_t ret = 0;
+    for (size_t i = slot; i > 0; i -= i & (~i + 1)) {
+        ret += fenwick_[i];
+    }
+    return ret;
+}
+
+size_t reuse_distance_estimator_t::bucket_for_distance(uint64_t distance) {
+    size_t bucket = 0;
+    for (uint64_t d = distance + 1; d > 1; d >>= 1) {
+        ++bucket;
+    }
+    return std::min(bucket, NUM_BUCKETS - 1);
+}
+
+double reuse_distance_estimator_t::predicted_hit_ratio(uint64_t cache_blocks) const {
+    if (sampled_accesses_ == 0) {
+        return 0;
+    }
+
+    // We assume the distances are spread evenly within each bucket.
+    double hits = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        const uint64_t low = (1ULL << i) - 1;
+        const uint64_t high = (2ULL << i) - 1;
+        if (high <= cache_blocks) {
+            hits += distance_buckets_[i];
+        } else if (low < cache_blocks) {
+            hits += distance_buckets_[i] * static_cast<double>(cache_blocks - low)
+                / (high - low);
+        }
+    }
+    return hits / sampled_accesses_;
+}
+
+}  // namespace alt
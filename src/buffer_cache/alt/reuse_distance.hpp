@@ -0,0 +1,79 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_ALT_REUSE_DISTANCE_HPP_
+#define BUFFER_CACHE_ALT_REUSE_DISTANCE_HPP_
+
+#include <stdint.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "errors.hpp"
+#include "serializer/types.hpp"
+
+namespace alt {
+
+// Estimates the hit ratio an LRU cache of some other size would have, from the
+// stream of block accesses.  The reuse distance of an access is the number of
+// distinct blocks accessed since the previous access of the same block; an LRU
+// cache that holds n blocks hits exactly the accesses with a reuse distance below n.
+//
+// Only a hash-selected sample of the block ids (1 in 2^sample_shift) is tracked, and
+// distances among the sampled blocks are scaled up by the sampling rate, so the
+// memory and time spent don't depend on the size of the table.  (This is the
+// SHARDS technique.)  At most max_tracked_blocks sampled blocks are remembered; when
+// there are more, the least recently accessed ones are forgotten, and their next
+// accesses count as cold.
+class reuse_distance_estimator_t {
+public:
+    explicit reuse_distance_estimator_t(int sample_shift = 6,
+                                        size_t max_tracked_blocks = 8192);
+
+    void record_access(block_id_t block_id);
+
+    // The predicted hit ratio of an LRU cache that holds cache_blocks blocks, among
+    // the sampled accesses so far.  Returns 0 if no access has been sampled.
+    double predicted_hit_ratio(uint64_t cache_blocks) const;
+
+    uint64_t sampled_accesses() const { return sampled_accesses_; }
+    // The sampled accesses of blocks that weren't tracked (yet), which no cache size
+    // would have hit.
+    uint64_t cold_accesses() const { return cold_accesses_; }
+
+private:
+    bool is_sampled(block_id_t block_id) const;
+
+    // Renumbers the live slots so that they're contiguous again, dropping the
+    // oldest blocks if more than max_tracked_blocks_ are live.
+    void compact();
+
+    // The Fenwick tree over the slots in last_slots_.  A slot holds 1 if it's the
+    // most recent access of some tracked block.
+    void fenwick_add(size_t slot, int32_t delta);
+    // The number of live slots in [0, slot).
+    int64_t fenwick_prefix_sum(size_t slot) const;
+
+    // Bucket i holds the accesses with a (scaled) reuse distance in
+    // [2^i - 1, 2^(i+1) - 1).
+    static const size_t NUM_BUCKETS = 48;
+    static size_t bucket_for_distance(uint64_t distance);
+
+    const int sample_shift_;
+    const size_t max_tracked_blocks_;
+
+    // The slot of each tracked block's most recent access.
+    std::unordered_map<block_id_t, size_t> last_slots_;
+    // The block of each slot in use (or NULL_BLOCK_ID, if the block has been
+    // accessed again since).
+    std::vector<block_id_t> slot_blocks_;
+    std::vector<int32_t> fenwick_;
+
+    uint64_t sampled_accesses_;
+    uint64_t cold_accesses_;
+    uint64_t distance_buckets_[NUM_BUCKETS];
+
+    DISABLE_COPYING(reuse_distance_estimator_t);
+};
+
+}  // namespace alt
+
+#endif  // BUFFER_CACHE_ALT_REUSE_DISTANCE_HPP_
@@ -1,10 +1,178 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "buffer_cache/alt/stats.hpp"
 
+#include <inttypes.h>
+
+#include <algorithm>
+
+#include "buffer_cache/alt/evicter.hpp"
 #include "perfmon/perfmon.hpp"
+#include "utils.hpp"
+
+// What alt_cache_state_perfmon_t::visit_stats copies out of the stats on the cache's
+// home thread.
+struct alt_cache_state_t {
+    alt_cache_state_t() : visited(false) { }
+
+    // Whether visit_stats has run on the cache's home thread.
+    bool visited;
+    uint64_t page_hits;
+    uint64_t page_misses;
+    uint64_t miss_latency_buckets[5];
+    uint64_t snapshotted_versions;
+
+    bool has_evicter;
+    uint64_t unevictable_bytes;
+    uint64_t unbacked_bytes;
+    uint64_t disk_backed_bytes;
+    uint64_t evicted_bytes;
+    uint64_t compressed_bytes;
+
+    // The predicted hit ratios at 1/4, 1/2, 1, 2 and 4 times the current memory
+    // limit.
+    double predicted_hit_ratios[5];
+};
+
+static const char *const miss_latency_bucket_names[] = {
+    "under_100us", "under_1ms", "under_10ms", "under_100ms", "over_100ms"
+};
+
+static const char *const predicted_hit_ratio_names[] = {
+    "0.25x", "0.5x", "1x", "2x", "4x"
+};
+
+static perfmon_result_t *uint64_result(uint64_t value) {
+    return new perfmon_result_t(strprintf("%" PRIu64, value));
+}
+
+alt_cache_state_perfmon_t::alt_cache_state_perfmon_t(alt_cache_stats_t *stats)
+    : stats_(stats) { }
+
+void *alt_cache_state_perfmon_t::begin_stats() {
+    return new alt_cache_state_t;
+}
+
+void alt_cache_state_perfmon_t::visit_stats(void *data) {
+    if (!(get_thread_id() == stats_->home_thread())) {
+        return;
+    }
+    alt_cache_state_t *state = static_cast<alt_cache_state_t *>(data);
+    state->visited = true;
+    state->page_hits = stats_->page_hits_;
+    state->page_misses = stats_->page_misses_;
+    CT_ASSERT(alt_cache_stats_t::NUM_MISS_LATENCY_BUCKETS
+              == sizeof(state->miss_latency_buckets) / sizeof(uint64_t));
+    std::copy(stats_->miss_latency_buckets_,
+              stats_->miss_latency_buckets_
+              + alt_cache_stats_t::NUM_MISS_LATENCY_BUCKETS,
+              state->miss_latency_buckets);
+    state->snapshotted_versions = stats_->snapshotted_versions_;
+
+    alt::evicter_t *evicter = stats_->evicter_;
+    state->has_evicter = evicter != NULL;
+    if (evicter != NULL) {
+        state->unevictable_bytes = evicter->unevictable_size();
+        state->unbacked_bytes = evicter->evictable_unbacked_size();
+        state->disk_backed_bytes = evicter->evictable_disk_backed_size();
+        state->evicted_bytes = evicter->evicted_size();
+        state->compressed_bytes = evicter->compressed_tier_size();
+
+        const double memory_limit_blocks
+            = static_cast<double>(evicter->memory_limit())
+            / stats_->max_block_size_.ser_value();
+        for (int i = 0; i < 5; ++i) {
+            const double factor = 0.25 * (1 << i);
+            state->predicted_hit_ratios[i]
+                = stats_->reuse_distances_.predicted_hit_ratio(
+                    static_cast<uint64_t>(memory_limit_blocks * factor));
+        }
+    }
+}
+
+scoped_ptr_t<perfmon_result_t> alt_cache_state_perfmon_t::end_stats(void *data) {
+    scoped_ptr_t<alt_cache_state_t> state(static_cast<alt_cache_state_t *>(data));
+    scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
+    if (!state->visited) {
+        return result;
+    }
+
+    const uint64_t accesses = state->page_hits + state->page_misses;
+    result->insert("page_hits", uint64_result(state->page_hits));
+    result->insert("page_misses", uint64_result(state->page_misses));
+    result->insert("hit_ratio",
+                   new perfmon_result_t(strprintf("%.4f", accesses == 0 ? 0.0
+                                                  : static_cast<double>(
+                                                      state->page_hits)
+                                                  / accesses)));
+
+    perfmon_result_t *latencies = perfmon_result_t::alloc_map_result().release();
+    for (int i = 0; i < alt_cache_stats_t::NUM_MISS_LATENCY_BUCKETS; ++i) {
+        latencies->insert(miss_latency_bucket_names[i],
+                          uint64_result(state->miss_latency_buckets[i]));
+    }
+    result->insert("miss_latency", latencies);
+
+    result->insert("snapshotted_versions", uint64_result(state->snapshotted_versions));
+
+    if (state->has_evicter) {
+        result->insert("unevictable_bytes", uint64_result(state->unevictable_bytes));
+        // Evictable unbacked pages are the dirty pages that nobody holds right now.
+        result->insert("dirty_bytes", uint64_result(state->unbacked_bytes));
+        result->insert("disk_backed_bytes", uint64_result(state->disk_backed_bytes));
+        result->insert("evicted_bytes", uint64_result(state->evicted_bytes));
+        result->insert("compressed_bytes", uint64_result(state->compressed_bytes));
+
+        perfmon_result_t *predictions = perfmon_result_t::alloc_map_result().release();
+        for (int i = 0; i < 5; ++i) {
+            predictions->insert(predicted_hit_ratio_names[i],
+                                new perfmon_result_t(
+                                    strprintf("%.4f", state->predicted_hit_ratios[i])));
+        }
+        result->insert("predicted_hit_ratio", predictions);
+    }
+    return result;
+}
 
 alt_cache_stats_t::alt_cache_stats_t(perfmon_collection_t *parent)
     : cache_collection(),
       cache_membership(parent, &cache_collection, "cache"),
-      cache_collection_membership(&cache_collection) { }
+      pm_evictions(secs_to_ticks(1)),
+      pm_compressed_copy_drops(secs_to_ticks(1)),
+      pm_miss_latency(),
+      page_hits_(0),
+      page_misses_(0),
+      snapshotted_versions_(0),
+      evicter_(NULL),
+      max_block_size_(block_size_t::undefined()),
+      state_perfmon_(this),
+      cache_collection_membership(&cache_collection,
+                                  &pm_evictions, "evictions",
+                                  &pm_compressed_copy_drops, "compressed_copy_drops",
+                                  &pm_miss_latency, "miss_latency",
+                                  &state_perfmon_, "pages") {
+    std::fill(miss_latency_buckets_,
+              miss_latency_buckets_ + NUM_MISS_LATENCY_BUCKETS, 0);
+}
+
+alt_cache_stats_t::~alt_cache_stats_t() {
+    rassert(evicter_ == NULL);
+}
+
+void alt_cache_stats_t::set_evicter(alt::evicter_t *evicter,
+                                    block_size_t max_block_size) {
+    assert_thread();
+    evicter_ = evicter;
+    max_block_size_ = max_block_size;
+}
 
+void alt_cache_stats_t::record_miss_latency(ticks_t latency) {
+    assert_thread();
+    int bucket = 0;
+    for (ticks_t limit = secs_to_ticks(1) / 10000;
+         bucket < NUM_MISS_LATENCY_BUCKETS - 1 && latency >= limit;
+         limit *= 10) {
+        ++bucket;
+    }
+    ++miss_latency_buckets_[bucket];
+    pm_miss_latency.record(latency);
+}
@@ -2,18 +2,94 @@
 #ifndef BUFFER_CACHE_ALT_STATS_HPP_
 #define BUFFER_CACHE_ALT_STATS_HPP_
 
+#include <stdint.h>
+
+#include "buffer_cache/alt/reuse_distance.hpp"
 #include "perfmon/perfmon.hpp"
+#include "serializer/types.hpp"
+#include "threading.hpp"
+#include "time.hpp"
+
+namespace alt {
+class evicter_t;
+}  // namespace alt
+
+class alt_cache_stats_t;
+
+// Reports the parts of an alt_cache_stats_t that are kept on the cache's home thread
+// (instead of in per-thread perfmons).
+class alt_cache_state_perfmon_t : public perfmon_t {
+public:
+    explicit alt_cache_state_perfmon_t(alt_cache_stats_t *stats);
 
-class alt_cache_stats_t {
+    void *begin_stats();
+    void visit_stats(void *data);
+    scoped_ptr_t<perfmon_result_t> end_stats(void *data);
+
+private:
+    alt_cache_stats_t *const stats_;
+
+    DISABLE_COPYING(alt_cache_state_perfmon_t);
+};
+
+// The stats of one cache (that is, of one table's shard on this server).  Except
+// for the per-thread perfmons, all of this may only be touched on the cache's home
+// thread.
+class alt_cache_stats_t : public home_thread_mixin_t {
 public:
     explicit alt_cache_stats_t(perfmon_collection_t *parent);
+    ~alt_cache_stats_t();
+
+    // The page cache registers its evicter (and unregisters it with NULL before it
+    // goes away), so that we can report the sizes of its eviction bags.
+    void set_evicter(alt::evicter_t *evicter, block_size_t max_block_size);
+
+    // A page acquisition found the page's buffer in memory (a hit), or had to wait
+    // for it to be loaded (a miss).
+    void record_page_hit() { ++page_hits_; }
+    void record_page_miss() { ++page_misses_; }
+    // How long a block read for a miss took.
+    void record_miss_latency(ticks_t latency);
+
+    // Called when a block is acquired, for the reuse-distance estimator.
+    void record_block_access(block_id_t block_id) {
+        reuse_distances_.record_access(block_id);
+    }
+
+    void snapshotted_version_added() { ++snapshotted_versions_; }
+    void snapshotted_version_removed() {
+        rassert(snapshotted_versions_ > 0);
+        --snapshotted_versions_;
+    }
 
     perfmon_collection_t cache_collection;
     perfmon_membership_t cache_membership;
 
-    /*
-      LSI: insert perfmons here
-    */
+    // Pages the evicter moved from a disk-backed bag to the evicted bag.
+    perfmon_rate_monitor_t pm_evictions;
+    // Compressed copies of evicted pages that were dropped to make room.
+    perfmon_rate_monitor_t pm_compressed_copy_drops;
+    // How long block reads for misses took, with percentiles.
+    perfmon_latency_histogram_t pm_miss_latency;
+
+private:
+    friend class alt_cache_state_perfmon_t;
+
+    // The miss latency histogram's buckets are below 100us, 1ms, 10ms, 100ms, and
+    // 100ms and above.
+    static const int NUM_MISS_LATENCY_BUCKETS = 5;
+
+    uint64_t page_hits_;
+    uint64_t page_misses_;
+    uint64_t miss_latency_buckets_[NUM_MISS_LATENCY_BUCKETS];
+    uint64_t snapshotted_versions_;
+
+    alt::evicter_t *evicter_;
+    block_size_t max_block_size_;
+
+    alt::reuse_distance_estimator_t reuse_distances_;
+
+    alt_cache_state_perfmon_t state_perfmon_;
 
     perfmon_multi_membership_t cache_collection_membership;
 };
@@ -0,0 +1,138 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "buffer_cache/alt/warm_up_manifest.hpp"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <functional>
+
+#include "arch/io/io_utils.hpp"
+#include "arch/types.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "buffer_cache/alt/page_cache.hpp"
+#include "config/args.hpp"
+#include "containers/archive/stl_types.hpp"
+#include "containers/archive/string_stream.hpp"
+#include "containers/archive/vector_stream.hpp"
+#include "logger.hpp"
+#include "utils.hpp"
+
+namespace alt {
+
+warm_up_manifest_t::warm_up_manifest_t(page_cache_t *page_cache,
+                                       const std::string &path)
+    : page_cache_(page_cache),
+      path_(path),
+      save_in_progress_(false),
+      drainer_(make_scoped<auto_drainer_t>()) {
+    std::vector<block_id_t> block_ids;
+    thread_pool_t::run_in_blocker_pool(
+        std::bind(&warm_up_manifest_t::read_manifest_blocking,
+                  std::cref(path_), &block_ids));
+    page_cache_->warm_up(std::move(block_ids));
+
+    timer_.init(new repeating_timer_t(CACHE_WARM_UP_MANIFEST_INTERVAL_MS, this));
+}
+
+warm_up_manifest_t::~warm_up_manifest_t() {
+    assert_thread();
+    timer_.reset();
+    drainer_.reset();
+    save();
+}
+
+void warm_up_manifest_t::on_ring() {
+    assert_thread();
+    if (!save_in_progress_) {
+        save_in_progress_ = true;
+        coro_t::spawn_sometime(std::bind(&warm_up_manifest_t::save_in_background,
+                                         this, drainer_->lock()));
+    }
+}
+
+void warm_up_manifest_t::save_in_background(auto_drainer_t::lock_t) {
+    save();
+    save_in_progress_ = false;
+}
+
+void warm_up_manifest_t::save() {
+    assert_thread();
+    // There's no point in remembering more blocks than the cache could hold.
+    const uint64_t max_count = page_cache_->evicter().memory_limit()
+        / page_cache_->max_block_size().ser_value();
+    const std::vector<block_id_t> block_ids
+        = page_cache_->hottest_block_ids(max_count);
+
+    write_message_t wm;
+    wm << block_ids;
+    vector_stream_t stream;
+    stream.reserve(wm.size());
+    int res = send_write_message(&stream, &wm);
+    guarantee(res == 0);
+
+    bool ok;
+    thread_pool_t::run_in_blocker_pool(
+        std::bind(&warm_up_manifest_t::write_manifest_blocking,
+                  std::cref(path_), &stream.vector(), &ok));
+    if (!ok) {
+        logWRN("Could not write the cache warm-up manifest \"%s\".", path_.c_str());
+    }
+}
+
+void warm_up_manifest_t::read_manifest_blocking(
+        const std::string &path,
+        std::vector<block_id_t> *block_ids_out) {
+    std::string contents;
+    if (!blocking_read_file(path.c_str(), &contents)) {
+        // There's no manifest, which is normal for a new table.
+        return;
+    }
+
+    string_read_stream_t stream(std::move(contents), 0);
+    archive_result_t res = deserialize(&stream, block_ids_out);
+    if (bad(res)) {
+        // The manifest is only a hint, so we can live without it.
+        block_ids_out->clear();
+    }
+}
+
+void warm_up_manifest_t::write_manifest_blocking(const std::string &path,
+                                                 const std::vector<char> *data,
+                                                 bool *ok_out) {
+    *ok_out = false;
+    const std::string temporary_path = path + ".tmp";
+
+    {
+        scoped_fd_t fd;
+        int res;
+        do {
+            res = ::open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        } while (res == -1 && get_errno() == EINTR);
+        if (res == -1) {
+            return;
+        }
+        fd.reset(res);
+
+        size_t written = 0;
+        while (written < data->size()) {
+            ssize_t write_res = ::write(fd.get(), data->data() + written,
+                                        data->size() - written);
+            if (write_res == -1) {
+                if (get_errno() == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            written += write_res;
+        }
+    }
+
+    // Renaming means that we never replace a good manifest with a half-written one.
+    *ok_out = ::rename(temporary_path.c_str(), path.c_str()) == 0;
+}
+
+}  // namespace alt
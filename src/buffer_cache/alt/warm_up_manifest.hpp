@@ -0,0 +1,57 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_ALT_WARM_UP_MANIFEST_HPP_
+#define BUFFER_CACHE_ALT_WARM_UP_MANIFEST_HPP_
+
+#include <string>
+#include <vector>
+
+#include "arch/timing.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "containers/scoped.hpp"
+#include "serializer/types.hpp"
+#include "threading.hpp"
+
+namespace alt {
+
+class page_cache_t;
+
+// Keeps a file (the "warm-up manifest") listing the block ids of the hottest pages
+// in a page cache.  The file is rewritten periodically and when the
+// warm_up_manifest_t is destroyed, so after a restart the cache can load those
+// blocks in the background, instead of waiting for queries to fault them in one by
+// one.
+class warm_up_manifest_t : public home_thread_mixin_debug_only_t,
+                           private repeating_timer_callback_t {
+public:
+    // Starts warming up page_cache with the blocks listed in the manifest at path,
+    // if there is one.  Blocks (on the blocker pool) while the file gets read.
+    warm_up_manifest_t(page_cache_t *page_cache, const std::string &path);
+
+    // Saves the manifest one last time.
+    ~warm_up_manifest_t();
+
+private:
+    void on_ring();
+    void save_in_background(auto_drainer_t::lock_t lock);
+    void save();
+
+    static void read_manifest_blocking(const std::string &path,
+                                       std::vector<block_id_t> *block_ids_out);
+    static void write_manifest_blocking(const std::string &path,
+                                        const std::vector<char> *data,
+                                        bool *ok_out);
+
+    page_cache_t *const page_cache_;
+    const std::string path_;
+
+    bool save_in_progress_;
+
+    scoped_ptr_t<auto_drainer_t> drainer_;
+    scoped_ptr_t<repeating_timer_t> timer_;
+
+    DISABLE_COPYING(warm_up_manifest_t);
+};
+
+}  // namespace alt
+
+#endif  // BUFFER_CACHE_ALT_WARM_UP_MANIFEST_HPP_
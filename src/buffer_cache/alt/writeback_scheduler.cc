@@ -0,0 +1,82 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "buffer_cache/alt/writeback_scheduler.hpp"
+
+#include <algorithm>
+#include <functional>
+
+#include "arch/runtime/coroutines.hpp"
+#include "buffer_cache/alt/page_cache.hpp"
+#include "config/args.hpp"
+
+namespace alt {
+
+// How much weight a new batch's throughput gets in the moving average.
+static const double THROUGHPUT_SAMPLE_WEIGHT = 0.2;
+
+writeback_scheduler_t::writeback_scheduler_t(page_cache_t *page_cache)
+    : page_cache_(page_cache),
+      tokens_(0),
+      throughput_(CACHE_WRITEBACK_INITIAL_THROUGHPUT),
+      last_ring_ticks_(get_ticks()),
+      batch_in_progress_(false),
+      drainer_(make_scoped<auto_drainer_t>()) {
+    timer_.init(new repeating_timer_t(CACHE_WRITEBACK_INTERVAL_MS, this));
+}
+
+writeback_scheduler_t::~writeback_scheduler_t() {
+    assert_thread();
+    timer_.reset();
+    drainer_.reset();
+}
+
+void writeback_scheduler_t::on_ring() {
+    assert_thread();
+    const ticks_t now = get_ticks();
+    const double elapsed_secs = ticks_to_secs(now - last_ring_ticks_);
+    last_ring_ticks_ = now;
+
+    const size_t pending = page_cache_->write_back_candidate_count();
+    if (pending == 0) {
+        // Don't save up tokens for a burst later.
+        tokens_ = 0;
+        return;
+    }
+
+    const double fill = std::min(1.0, static_cast<double>(pending)
+                                 / CACHE_WRITEBACK_DIRTY_PAGES_TARGET);
+    tokens_ = std::min<double>(tokens_ + throughput_ * fill * elapsed_secs,
+                               CACHE_WRITEBACK_MAX_BATCH_BYTES);
+
+    if (!batch_in_progress_
+        && tokens_ >= page_cache_->max_block_size().ser_value()) {
+        const uint64_t max_bytes = static_cast<uint64_t>(tokens_);
+        tokens_ -= max_bytes;
+        batch_in_progress_ = true;
+        coro_t::spawn_sometime(std::bind(&writeback_scheduler_t::write_batch,
+                                         this, max_bytes, drainer_->lock()));
+    }
+}
+
+void writeback_scheduler_t::write_batch(uint64_t max_bytes,
+                                        auto_drainer_t::lock_t) {
+    assert_thread();
+    const ticks_t start_ticks = get_ticks();
+    const uint64_t bytes_written = page_cache_->write_back_pages(max_bytes);
+    const double elapsed_secs = ticks_to_secs(get_ticks() - start_ticks);
+
+    // Give back what we didn't use (for example because the txns started flushing
+    // while we waited to get to run).
+    tokens_ = std::min<double>(tokens_ + (max_bytes - bytes_written),
+                               CACHE_WRITEBACK_MAX_BATCH_BYTES);
+    if (bytes_written > 0 && elapsed_secs > 0) {
+        // Small batches are dominated by latency, so without a floor the rate
+        // could keep shrinking along with the batch size.
+        throughput_ = std::max<double>((1 - THROUGHPUT_SAMPLE_WEIGHT) * throughput_
+                                       + THROUGHPUT_SAMPLE_WEIGHT
+                                       * (bytes_written / elapsed_secs),
+                                       CACHE_WRITEBACK_MIN_THROUGHPUT);
+    }
+    batch_in_progress_ = false;
+}
+
+}  // namespace alt
@@ -0,0 +1,55 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_ALT_WRITEBACK_SCHEDULER_HPP_
+#define BUFFER_CACHE_ALT_WRITEBACK_SCHEDULER_HPP_
+
+#include <stdint.h>
+
+#include "arch/timing.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "containers/scoped.hpp"
+#include "threading.hpp"
+#include "time.hpp"
+
+namespace alt {
+
+class page_cache_t;
+
+// Writes the dirty pages of page_txn_t's that are waiting for their turn to flush
+// (behind the txns they depend on) to disk in the background, a bounded batch at a
+// time.  When such a txn's flush comes around, do_flush_changes finds its pages
+// already disk-backed, and only has to do the index write.  This keeps a long
+// queue of waiting txns from turning into one big burst of block writes.
+//
+// The pace is set by a token bucket (measured in bytes), which is refilled at the
+// disk throughput measured on previous batches, scaled down by how far the number
+// of pages waiting to be written is below CACHE_WRITEBACK_DIRTY_PAGES_TARGET.
+class writeback_scheduler_t : public home_thread_mixin_debug_only_t,
+                              private repeating_timer_callback_t {
+public:
+    explicit writeback_scheduler_t(page_cache_t *page_cache);
+    ~writeback_scheduler_t();
+
+private:
+    void on_ring();
+    void write_batch(uint64_t max_bytes, auto_drainer_t::lock_t lock);
+
+    page_cache_t *const page_cache_;
+
+    // How many bytes we may write right now.  Never more than
+    // CACHE_WRITEBACK_MAX_BATCH_BYTES.
+    double tokens_;
+    // A moving average of the throughput of our batches, in bytes per second.
+    double throughput_;
+    ticks_t last_ring_ticks_;
+
+    bool batch_in_progress_;
+
+    scoped_ptr_t<auto_drainer_t> drainer_;
+    scoped_ptr_t<repeating_timer_t> timer_;
+
+    DISABLE_COPYING(writeback_scheduler_t);
+};
+
+}  // namespace alt
+
+#endif  // BUFFER_CACHE_ALT_WRITEBACK_SCHEDULER_HPP_
@@ -9,10 +9,13 @@
 #include "serializer/types.hpp"
 
 // write_durability_t::INVALID is an invalid value, notably it can't be serialized.
-enum class write_durability_t { INVALID, SOFT, HARD };
+// A GROUP_SOFT txn doesn't wait for its flush either, and its flush may also be put
+// off for up to the cache's group_soft_loss_window_ms, so that it can be done along
+// with those of other such txns.
+enum class write_durability_t { INVALID, SOFT, HARD, GROUP_SOFT };
 ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(write_durability_t, int8_t,
                                       write_durability_t::SOFT,
-                                      write_durability_t::HARD);
+                                      write_durability_t::GROUP_SOFT);
 
 
 typedef uint32_t block_magic_comparison_t;
@@ -224,7 +224,7 @@ ifeq ($(MEMCACHED_STRICT),1)
 endif
 
 ifeq ($(LEGACY_LINUX),1)
-  RT_CXXFLAGS += -DLEGACY_LINUX -DNO_EPOLL -Wno-format
+  RT_CXXFLAGS += -DLEGACY_LINUX -DNO_EPOLL -DNO_IO_URING -Wno-format
 endif
 
 ifeq ($(LEGACY_GCC),1)
@@ -239,6 +239,10 @@ ifeq ($(NO_EPOLL),1)
   RT_CXXFLAGS += -DNO_EPOLL
 endif
 
+ifeq ($(NO_IO_URING),1)
+  RT_CXXFLAGS += -DNO_IO_URING
+endif
+
 ifeq ($(THREADED_COROUTINES),1)
   RT_CXXFLAGS += -DTHREADED_COROUTINES
 endif
@@ -276,7 +280,9 @@ RT_CXXFLAGS += -I$(PROTO_DIR)
 
 SOURCES := $(shell find $(SOURCE_DIR) -name '*.cc' | grep -v '/\.')
 
-SERVER_EXEC_SOURCES := $(filter-out $(SOURCE_DIR)/unittest/%,$(SOURCES))
+MICROBENCH_SOURCES := $(filter $(SOURCE_DIR)/microbench/%,$(SOURCES))
+
+SERVER_EXEC_SOURCES := $(filter-out $(SOURCE_DIR)/unittest/% $(MICROBENCH_SOURCES),$(SOURCES))
 
 QL2_PROTO_NAMES := rdb_protocol/ql2 rdb_protocol/ql2_extensions
 QL2_PROTO_SOURCES := $(foreach _,$(QL2_PROTO_NAMES),$(SOURCE_DIR)/$_.proto)
@@ -292,10 +298,12 @@ OBJS := $(QL2_PROTO_OBJS) $(patsubst %,$(OBJ_DIR)/%.o,$(NAMES))
 
 SERVER_EXEC_OBJS := $(QL2_PROTO_OBJS) $(patsubst $(SOURCE_DIR)/%.cc,$(OBJ_DIR)/%.o,$(SERVER_EXEC_SOURCES))
 
-SERVER_NOMAIN_OBJS := $(QL2_PROTO_OBJS) $(patsubst $(SOURCE_DIR)/%.cc,$(OBJ_DIR)/%.o,$(filter-out %/main.cc,$(SOURCES)))
+SERVER_NOMAIN_OBJS := $(QL2_PROTO_OBJS) $(patsubst $(SOURCE_DIR)/%.cc,$(OBJ_DIR)/%.o,$(filter-out %/main.cc $(MICROBENCH_SOURCES),$(SOURCES)))
 
 SERVER_UNIT_TEST_OBJS := $(SERVER_NOMAIN_OBJS) $(OBJ_DIR)/unittest/main.o
 
+SERVER_MICROBENCH_OBJS := $(QL2_PROTO_OBJS) $(patsubst $(SOURCE_DIR)/%.cc,$(OBJ_DIR)/%.o,$(filter-out %/main.cc,$(SERVER_EXEC_SOURCES)) $(MICROBENCH_SOURCES))
+
 ##### Version number handling
 
 RT_CXXFLAGS += -DRETHINKDB_VERSION=\"$(RETHINKDB_VERSION)\"
@@ -316,6 +324,11 @@ unit: $(BUILD_DIR)/$(SERVER_UNIT_TEST_NAME)
 	$P RUN $(SERVER_UNIT_TEST_NAME)
 	$(BUILD_DIR)/$(SERVER_UNIT_TEST_NAME) --gtest_filter=$(UNIT_TEST_FILTER)
 
+.PHONY: bench
+bench: $(BUILD_DIR)/$(SERVER_MICROBENCH_NAME)
+	$P RUN $(SERVER_MICROBENCH_NAME)
+	$(BUILD_DIR)/$(SERVER_MICROBENCH_NAME) --filter=$(MICROBENCH_FILTER)
+
 .PRECIOUS: $(PROTO_DIR)/. $(QL2_PROTO_HEADERS) $(QL2_PROTO_CODE)
 
 $(PROTO_DIR)/%.pb.h $(PROTO_DIR)/%.pb.cc: $(SOURCE_DIR)/%.proto $(PROTOC_BIN_DEP) | $(PROTO_DIR)/.
@@ -357,6 +370,10 @@ $(BUILD_DIR)/$(SERVER_UNIT_TEST_NAME): $(SERVER_UNIT_TEST_OBJS) $(GTEST_LIBS_DEP
 	$P LD $@
 	$(RT_CXX) $(SERVER_UNIT_TEST_OBJS) $(RT_LDFLAGS) $(GTEST_LIBS) -o $@ $(LD_OUTPUT_FILTER)
 
+$(BUILD_DIR)/$(SERVER_MICROBENCH_NAME): $(SERVER_MICROBENCH_OBJS) | $(BUILD_DIR)/. $(RETHINKDB_DEPENDENCIES_LIBS)
+	$P LD $@
+	$(RT_CXX) $(SERVER_MICROBENCH_OBJS) $(RT_LDFLAGS) -o $@ $(LD_OUTPUT_FILTER)
+
 $(BUILD_DIR)/$(GDB_FUNCTIONS_NAME): | $(BUILD_DIR)/.
 	$P CP $@
 	cp $(SCRIPTS_DIR)/$(GDB_FUNCTIONS_NAME) $@
@@ -0,0 +1,344 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/administration/auto_resharder.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "clustering/administration/suggester.hpp"
+#include "config/args.hpp"
+#include "logger.hpp"
+
+static bool auto_reshard_enabled = false;
+
+void set_auto_reshard_enabled(bool enabled) {
+    auto_reshard_enabled = enabled;
+}
+
+// Only shards that span all hashes are split, like the admin CLI does.
+static bool spans_all_hashes(const hash_region_t<key_range_t> &shard) {
+    return shard.beg == 0 && shard.end == HASH_REGION_HASH_SIZE;
+}
+
+std::map<store_key_t, shard_load_t> get_shard_loads(
+        const nonoverlapping_regions_t<rdb_protocol_t> &shards,
+        const std::map<store_key_t, int64_t> &key_counts,
+        const std::map<store_key_t, int64_t> &byte_counts) {
+    std::map<store_key_t, shard_load_t> loads;
+    for (auto shard = shards.begin(); shard != shards.end(); ++shard) {
+        shard_load_t *load = &loads[shard->inner.left];
+        for (auto it = key_counts.lower_bound(shard->inner.left);
+             it != key_counts.end() && shard->inner.contains_key(it->first);
+             ++it) {
+            load->keys += it->second;
+        }
+        for (auto it = byte_counts.lower_bound(shard->inner.left);
+             it != byte_counts.end() && shard->inner.contains_key(it->first);
+             ++it) {
+            load->bytes += it->second;
+        }
+    }
+    return loads;
+}
+
+// The key in `weights` that comes closest to splitting `range` in half, or false if
+// there's none besides its left bound.
+static bool find_median_key(const key_range_t &range,
+                            const std::map<store_key_t, int64_t> &weights,
+                            store_key_t *key_out) {
+    int64_t total = 0;
+    for (auto it = weights.lower_bound(range.left);
+         it != weights.end() && range.contains_key(it->first);
+         ++it) {
+        total += it->second;
+    }
+    bool found = false;
+    int64_t best_distance = 0;
+    int64_t before = 0;
+    for (auto it = weights.lower_bound(range.left);
+         it != weights.end() && range.contains_key(it->first);
+         ++it) {
+        if (it->first != range.left) {
+            const int64_t distance = 2 * before > total
+                ? 2 * before - total : total - 2 * before;
+            if (!found || distance < best_distance) {
+                found = true;
+                best_distance = distance;
+                *key_out = it->first;
+            }
+        }
+        before += it->second;
+    }
+    return found;
+}
+
+std::set<store_key_t> choose_reshard_split_points(
+        const nonoverlapping_regions_t<rdb_protocol_t> &shards,
+        const std::map<store_key_t, int64_t> &key_counts,
+        const std::map<store_key_t, int64_t> &byte_counts,
+        const std::map<store_key_t, shard_load_t> &previous_loads,
+        int64_t max_shard_bytes,
+        int64_t min_hot_keys,
+        double hot_factor,
+        size_t max_shards) {
+    const std::map<store_key_t, shard_load_t> loads
+        = get_shard_loads(shards, key_counts, byte_counts);
+
+    // What each shard gained since the last poll.  Shards that weren't there then
+    // don't count.
+    std::map<store_key_t, int64_t> growth;
+    int64_t total_growth = 0;
+    for (auto it = loads.begin(); it != loads.end(); ++it) {
+        auto prev = previous_loads.find(it->first);
+        if (prev != previous_loads.end()) {
+            const int64_t gained = std::max<int64_t>(0, it->second.keys - prev->second.keys);
+            growth[it->first] = gained;
+            total_growth += gained;
+        }
+    }
+    const double mean_growth = growth.empty()
+        ? 0 : static_cast<double>(total_growth) / growth.size();
+
+    const std::map<store_key_t, int64_t> &weights
+        = byte_counts.empty() ? key_counts : byte_counts;
+    std::vector<std::pair<int64_t, store_key_t> > candidates;
+    for (auto shard = shards.begin(); shard != shards.end(); ++shard) {
+        if (!spans_all_hashes(*shard)) {
+            continue;
+        }
+        const shard_load_t &load = loads.find(shard->inner.left)->second;
+        auto gained = growth.find(shard->inner.left);
+        const bool too_big = load.bytes > max_shard_bytes;
+        const bool too_hot = gained != growth.end()
+            && gained->second > min_hot_keys
+            && gained->second > hot_factor * mean_growth;
+        store_key_t split_point;
+        if ((too_big || too_hot)
+            && find_median_key(shard->inner, weights, &split_point)) {
+            candidates.push_back(std::make_pair(load.bytes, split_point));
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(),
+              [](const std::pair<int64_t, store_key_t> &a,
+                 const std::pair<int64_t, store_key_t> &b) {
+                  return a.first > b.first;
+              });
+    std::set<store_key_t> split_points;
+    for (auto it = candidates.begin();
+         it != candidates.end() && shards.size() + split_points.size() < max_shards;
+         ++it) {
+        split_points.insert(it->second);
+    }
+    return split_points;
+}
+
+auto_resharder_t::auto_resharder_t(
+        const machine_id_t &_us,
+        boost::shared_ptr<semilattice_readwrite_view_t<cluster_semilattice_metadata_t> >
+            _semilattice_view,
+        const clone_ptr_t<watchable_t<change_tracking_map_t<peer_id_t, cluster_directory_metadata_t> > > &_directory_view,
+        namespace_repo_t<rdb_protocol_t> *_ns_repo)
+    : us(_us),
+      semilattice_view(_semilattice_view),
+      directory_view(_directory_view),
+      ns_repo(_ns_repo) {
+    if (auto_reshard_enabled) {
+        coro_t::spawn_sometime(std::bind(&auto_resharder_t::run, this,
+                                         auto_drainer_t::lock_t(&drainer)));
+    }
+}
+
+void auto_resharder_t::run(auto_drainer_t::lock_t keepalive) {
+    try {
+        for (;;) {
+            nap(AUTO_RESHARD_POLL_INTERVAL_MS, keepalive.get_drain_signal());
+            if (is_leader()) {
+                poll(keepalive.get_drain_signal());
+            } else {
+                // Another server may reshard the tables in the meantime.
+                tables.clear();
+            }
+        }
+    } catch (const interrupted_exc_t &) {
+        // We're shutting down.
+    }
+}
+
+bool auto_resharder_t::is_leader() const {
+    const std::map<peer_id_t, cluster_directory_metadata_t> directory
+        = directory_view->get().get_inner();
+    for (auto it = directory.begin(); it != directory.end(); ++it) {
+        if (it->second.peer_type == SERVER_PEER && it->second.machine_id < us) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool auto_resharder_t::is_settled(const namespace_id_t &ns_id) const {
+    typedef reactor_business_card_t<rdb_protocol_t> bcard_t;
+    const std::map<peer_id_t, cluster_directory_metadata_t> directory
+        = directory_view->get().get_inner();
+    for (auto it = directory.begin(); it != directory.end(); ++it) {
+        auto bcard = it->second.rdb_namespaces.reactor_bcards.find(ns_id);
+        if (bcard == it->second.rdb_namespaces.reactor_bcards.end()) {
+            continue;
+        }
+        const bcard_t::activity_map_t &activities = bcard->second.internal->activities;
+        for (auto a = activities.begin(); a != activities.end(); ++a) {
+            const bcard_t::activity_t &activity = a->second.activity;
+            if (boost::get<bcard_t::primary_t>(&activity) == NULL
+                && boost::get<bcard_t::secondary_up_to_date_t>(&activity) == NULL
+                && boost::get<bcard_t::nothing_t>(&activity) == NULL) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void auto_resharder_t::poll(signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+    const cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > namespaces
+        = semilattice_view->get().rdb_namespaces;
+    const ticks_t now = get_ticks();
+
+    // Forget dropped tables, and finish the reshards whose backfills are done.
+    int reshards_in_progress = 0;
+    for (auto it = tables.begin(); it != tables.end();) {
+        auto ns = namespaces->namespaces.find(it->first);
+        if (ns == namespaces->namespaces.end() || ns->second.is_deleted()) {
+            tables.erase(it++);
+            continue;
+        }
+        if (it->second.resharding) {
+            if (is_settled(it->first)) {
+                it->second.resharding = false;
+                it->second.cooldown_until
+                    = now + secs_to_ticks(1) / 1000 * AUTO_RESHARD_COOLDOWN_MS;
+            } else {
+                ++reshards_in_progress;
+            }
+        }
+        ++it;
+    }
+
+    for (auto it = namespaces->namespaces.begin();
+         it != namespaces->namespaces.end();
+         ++it) {
+        if (it->second.is_deleted() || it->second.get_ref().shards.in_conflict()) {
+            continue;
+        }
+        const table_state_t &state = tables[it->first];
+        if (state.resharding || now < state.cooldown_until) {
+            continue;
+        }
+        poll_table(it->first, it->second.get_ref().shards.get_ref(),
+                   &reshards_in_progress, interruptor);
+    }
+}
+
+void auto_resharder_t::poll_table(const namespace_id_t &ns_id,
+                                  const nonoverlapping_regions_t<rdb_protocol_t> &shards,
+                                  int *reshards_in_progress,
+                                  signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t) {
+    rdb_protocol_t::distribution_read_t inner_read(1, 0);
+    inner_read.sample_size = AUTO_RESHARD_SAMPLE_SIZE;
+    rdb_protocol_t::read_t read(inner_read, profile_bool_t::DONT_PROFILE);
+    rdb_protocol_t::read_response_t response;
+    try {
+        namespace_repo_t<rdb_protocol_t>::access_t ns_access(ns_repo, ns_id, interruptor);
+        ns_access.get_namespace_if()->read_outdated(read, &response, interruptor);
+    } catch (const cannot_perform_query_exc_t &) {
+        // We'll look again next time.
+        return;
+    }
+    const rdb_protocol_t::distribution_read_response_t *dist
+        = boost::get<rdb_protocol_t::distribution_read_response_t>(&response.response);
+    guarantee(dist != NULL);
+
+    table_state_t *state = &tables[ns_id];
+    std::set<store_key_t> split_points;
+    if (*reshards_in_progress < AUTO_RESHARD_MAX_CONCURRENT) {
+        split_points = choose_reshard_split_points(
+            shards, dist->key_counts, dist->byte_counts, state->loads,
+            AUTO_RESHARD_MAX_SHARD_BYTES, AUTO_RESHARD_MIN_HOT_KEYS,
+            AUTO_RESHARD_HOT_FACTOR, AUTO_RESHARD_MAX_SHARDS);
+    }
+    state->loads = get_shard_loads(shards, dist->key_counts, dist->byte_counts);
+
+    if (!split_points.empty() && reshard(ns_id, split_points)) {
+        state->resharding = true;
+        state->loads.clear();
+        ++*reshards_in_progress;
+    }
+}
+
+bool auto_resharder_t::reshard(const namespace_id_t &ns_id,
+                               const std::set<store_key_t> &split_points) {
+    cluster_semilattice_metadata_t metadata = semilattice_view->get();
+    {
+        cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> >::change_t
+            change(&metadata.rdb_namespaces);
+        auto ns_it = change.get()->namespaces.find(ns_id);
+        if (ns_it == change.get()->namespaces.end() || ns_it->second.is_deleted()) {
+            return false;
+        }
+        namespace_semilattice_metadata_t<rdb_protocol_t> *ns
+            = ns_it->second.get_mutable();
+        if (ns->shards.in_conflict()) {
+            return false;
+        }
+
+        nonoverlapping_regions_t<rdb_protocol_t> &shards = ns->shards.get_mutable();
+        for (auto key = split_points.begin(); key != split_points.end(); ++key) {
+            auto shard = shards.begin();
+            while (shard != shards.end() && !shard->inner.contains_key(*key)) {
+                ++shard;
+            }
+            if (shard == shards.end() || !spans_all_hashes(*shard)
+                || shard->inner.left == *key) {
+                continue;
+            }
+            key_range_t left;
+            left.left = shard->inner.left;
+            left.right = key_range_t::right_bound_t(*key);
+            key_range_t right;
+            right.left = *key;
+            right.right = shard->inner.right;
+            shards.remove_region(shard);
+            bool add_success = shards.add_region(hash_region_t<key_range_t>(left));
+            guarantee(add_success);
+            add_success = shards.add_region(hash_region_t<key_range_t>(right));
+            guarantee(add_success);
+        }
+        ns->shards.upgrade_version(us);
+
+        // The pinnings were for the old shards, so they go (see
+        // `admin_cluster_link_t::admin_split_shard_internal`).
+        ns->primary_pinnings = ns->primary_pinnings.make_resolving_version(
+            region_map_t<rdb_protocol_t, machine_id_t>(
+                rdb_protocol_t::region_t::universe(), nil_uuid()),
+            us);
+        ns->secondary_pinnings = ns->secondary_pinnings.make_resolving_version(
+            region_map_t<rdb_protocol_t, std::set<machine_id_t> >(
+                rdb_protocol_t::region_t::universe(), std::set<machine_id_t>()),
+            us);
+    }
+
+    try {
+        fill_in_blueprints(&metadata, directory_view->get().get_inner(), us,
+                           boost::optional<namespace_id_t>(ns_id));
+    } catch (const missing_machine_exc_t &) {
+        // We'll try again once the machine is back.
+        return false;
+    }
+    semilattice_view->join(metadata);
+    logINF("Splitting %zu hot or big shard(s) of table %s.\n",
+           split_points.size(), uuid_to_str(ns_id).c_str());
+    return true;
+}
@@ -0,0 +1,113 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_AUTO_RESHARDER_HPP_
+#define CLUSTERING_ADMINISTRATION_AUTO_RESHARDER_HPP_
+
+#include <map>
+#include <set>
+
+#include "errors.hpp"
+#include <boost/shared_ptr.hpp>
+
+#include "clustering/administration/metadata.hpp"
+#include "clustering/administration/namespace_interface_repository.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/watchable.hpp"
+#include "containers/incremental_lenses.hpp"
+#include "rdb_protocol/protocol.hpp"
+#include "rpc/semilattice/view.hpp"
+#include "time.hpp"
+
+// Whether servers split hot rdb shards on their own (see `auto_resharder_t`).  Off
+// by default.
+void set_auto_reshard_enabled(bool enabled);
+
+// How one shard looked to the resharder: how many keys it holds and how many bytes
+// they take, from a sampling distribution read.
+struct shard_load_t {
+    shard_load_t() : keys(0), bytes(0) { }
+    int64_t keys;
+    int64_t bytes;
+};
+
+// Adds up the distribution `key_counts` and `byte_counts` by the shards they fall
+// in.  The result is keyed by the left bound of each shard.
+std::map<store_key_t, shard_load_t> get_shard_loads(
+        const nonoverlapping_regions_t<rdb_protocol_t> &shards,
+        const std::map<store_key_t, int64_t> &key_counts,
+        const std::map<store_key_t, int64_t> &byte_counts);
+
+// Picks a split point for each shard that is too big or too hot.  A shard is too big
+// if it holds more than `max_shard_bytes`, and too hot if it gained more than
+// `min_hot_keys` keys since `previous_loads` and more than `hot_factor` times the
+// mean of what the shards gained.  The split point is the distribution key closest
+// to the shard's median by bytes (or by keys, if there are no byte counts).  No more
+// than `max_shards` shards come out of it, and the biggest shards are split first.
+std::set<store_key_t> choose_reshard_split_points(
+        const nonoverlapping_regions_t<rdb_protocol_t> &shards,
+        const std::map<store_key_t, int64_t> &key_counts,
+        const std::map<store_key_t, int64_t> &byte_counts,
+        const std::map<store_key_t, shard_load_t> &previous_loads,
+        int64_t max_shard_bytes,
+        int64_t min_hot_keys,
+        double hot_factor,
+        size_t max_shards);
+
+/* Splits the shards of rdb tables that grow too big or take too many writes, and
+lets the suggester place the new shards.
+
+Every AUTO_RESHARD_POLL_INTERVAL_MS it takes a sampling distribution read of each
+table, and compares each shard's size to AUTO_RESHARD_MAX_SHARD_BYTES and its growth
+since the last poll to that of the other shards.  Shards are split where the
+distribution says their median is, the table's pinnings are cleared (like the admin
+CLI's `split shard` does), and the blueprint is filled in again.
+
+Only the connected server with the lowest machine ID does this, so that servers
+don't race to split the same shards.  No more than AUTO_RESHARD_MAX_CONCURRENT
+tables are resharded at once; a reshard lasts until no reactor of the table is
+backfilling, and a table isn't looked at again for AUTO_RESHARD_COOLDOWN_MS after
+that. */
+class auto_resharder_t {
+public:
+    auto_resharder_t(
+        const machine_id_t &us,
+        boost::shared_ptr<semilattice_readwrite_view_t<cluster_semilattice_metadata_t> >
+            semilattice_view,
+        const clone_ptr_t<watchable_t<change_tracking_map_t<peer_id_t, cluster_directory_metadata_t> > > &directory_view,
+        namespace_repo_t<rdb_protocol_t> *ns_repo);
+
+private:
+    struct table_state_t {
+        table_state_t() : resharding(false), cooldown_until(0) { }
+        // The shards' loads at the last poll, to tell how fast they grow.
+        std::map<store_key_t, shard_load_t> loads;
+        bool resharding;
+        ticks_t cooldown_until;
+    };
+
+    void run(auto_drainer_t::lock_t keepalive);
+    void poll(signal_t *interruptor) THROWS_ONLY(interrupted_exc_t);
+    bool is_leader() const;
+    bool is_settled(const namespace_id_t &ns_id) const;
+    void poll_table(const namespace_id_t &ns_id,
+                    const nonoverlapping_regions_t<rdb_protocol_t> &shards,
+                    int *reshards_in_progress,
+                    signal_t *interruptor) THROWS_ONLY(interrupted_exc_t);
+    // Returns false if the table couldn't be resharded right now.
+    bool reshard(const namespace_id_t &ns_id,
+                 const std::set<store_key_t> &split_points);
+
+    const machine_id_t us;
+    boost::shared_ptr<semilattice_readwrite_view_t<cluster_semilattice_metadata_t> >
+        semilattice_view;
+    clone_ptr_t<watchable_t<change_tracking_map_t<peer_id_t, cluster_directory_metadata_t> > >
+        directory_view;
+    namespace_repo_t<rdb_protocol_t> *ns_repo;
+
+    std::map<namespace_id_t, table_state_t> tables;
+
+    auto_drainer_t drainer;
+
+    DISABLE_COPYING(auto_resharder_t);
+};
+
+#endif  // CLUSTERING_ADMINISTRATION_AUTO_RESHARDER_HPP_
@@ -259,7 +259,7 @@ admin_cluster_link_t::admin_cluster_link_t(const peer_address_set_t &joins,
     log_writer(&local_issue_tracker), // TODO: come up with something else for this file
     connectivity_cluster(),
     message_multiplexer(&connectivity_cluster),
-    heartbeat_manager_client(&message_multiplexer, 'H'),
+    heartbeat_manager_client(&message_multiplexer, 'H', message_priority_t::CONTROL),
     heartbeat_manager(&heartbeat_manager_client),
     heartbeat_manager_client_run(&heartbeat_manager_client, &heartbeat_manager),
     mailbox_manager_client(&message_multiplexer, 'M'),
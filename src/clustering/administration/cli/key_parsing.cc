@@ -31,8 +31,8 @@ bool cli_str_to_key(const std::string &str, store_key_t *out) {
             return false;
         }
         if (out->size() < MAX_KEY_SIZE) {
-            out->contents()[out->size()] = translation;
             out->set_size(out->size() + 1);
+            out->contents()[out->size() - 1] = translation;
         } else {
             return false;
         }
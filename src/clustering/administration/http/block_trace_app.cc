@@ -0,0 +1,39 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/administration/http/block_trace_app.hpp"
+
+#include <string>
+
+#include "buffer_cache/alt/block_trace.hpp"
+
+void block_trace_http_app_t::handle(const http_req_t &req, http_res_t *result,
+                                    UNUSED signal_t *interruptor) {
+    http_req_t::resource_t::iterator it = req.resource.begin();
+    if (it == req.resource.end()) {
+        if (req.method != GET) {
+            *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+            return;
+        }
+        http_res_t res(HTTP_OK);
+        res.set_body("application/octet-stream",
+                     block_tracer_t::get_global_tracer().dump());
+        *result = res;
+        return;
+    }
+
+    const std::string command = *it;
+    ++it;
+    if (it != req.resource.end() || (command != "start" && command != "stop")) {
+        *result = http_res_t(HTTP_NOT_FOUND);
+        return;
+    }
+    if (req.method != POST) {
+        *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+        return;
+    }
+    if (command == "start") {
+        block_tracer_t::get_global_tracer().enable();
+    } else {
+        block_tracer_t::get_global_tracer().disable();
+    }
+    *result = http_res_t(HTTP_OK);
+}
@@ -0,0 +1,25 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_HTTP_BLOCK_TRACE_APP_HPP_
+#define CLUSTERING_ADMINISTRATION_HTTP_BLOCK_TRACE_APP_HPP_
+
+#include "http/http.hpp"
+
+/* `block_trace_http_app_t` turns block tracing (see `block_tracer_t`) on and off
+and hands out what it has recorded:
+
+    POST /ajax/block_trace/start   starts (or restarts) tracing from scratch
+    POST /ajax/block_trace/stop    stops tracing
+    GET  /ajax/block_trace         returns a binary dump of the trace so far
+
+Save the dump to a file and replay it with `rethinkdb-bench cache --trace=FILE`. */
+class block_trace_http_app_t : public http_app_t {
+public:
+    block_trace_http_app_t() { }
+
+    void handle(const http_req_t &req, http_res_t *result, signal_t *interruptor);
+
+private:
+    DISABLE_COPYING(block_trace_http_app_t);
+};
+
+#endif /* CLUSTERING_ADMINISTRATION_HTTP_BLOCK_TRACE_APP_HPP_ */
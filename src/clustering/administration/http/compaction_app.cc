@@ -0,0 +1,18 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/administration/http/compaction_app.hpp"
+
+#include "serializer/log/log_serializer.hpp"
+
+void compaction_http_app_t::handle(const http_req_t &req, http_res_t *result,
+                                   UNUSED signal_t *interruptor) {
+    if (req.resource.begin() != req.resource.end()) {
+        *result = http_res_t(HTTP_NOT_FOUND);
+        return;
+    }
+    if (req.method != POST) {
+        *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+        return;
+    }
+    log_serializer_t::start_compaction_everywhere();
+    *result = http_res_t(HTTP_OK);
+}
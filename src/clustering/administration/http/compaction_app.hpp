@@ -0,0 +1,25 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_HTTP_COMPACTION_APP_HPP_
+#define CLUSTERING_ADMINISTRATION_HTTP_COMPACTION_APP_HPP_
+
+#include "http/http.hpp"
+
+/* `compaction_http_app_t` starts compacting the data files of all the tables on
+this server (see `log_serializer_t::start_compaction()`):
+
+    POST /ajax/compact   starts compacting, or starts over if it's already running
+
+It returns right away; the compaction goes on in the background, and each table
+file's "serializer_compaction_extents_left" stat in /ajax/stat shows how far along it
+is. */
+class compaction_http_app_t : public http_app_t {
+public:
+    compaction_http_app_t() { }
+
+    void handle(const http_req_t &req, http_res_t *result, signal_t *interruptor);
+
+private:
+    DISABLE_COPYING(compaction_http_app_t);
+};
+
+#endif /* CLUSTERING_ADMINISTRATION_HTTP_COMPACTION_APP_HPP_ */
@@ -0,0 +1,61 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/administration/http/coro_profiler_app.hpp"
+
+#include <string>
+
+#include "arch/runtime/coro_profiler.hpp"
+#include "utils.hpp"
+
+void coro_profiler_http_app_t::handle(const http_req_t &req, http_res_t *result,
+                                      UNUSED signal_t *interruptor) {
+    http_req_t::resource_t::iterator it = req.resource.begin();
+    if (it == req.resource.end()) {
+        if (req.method != GET) {
+            *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+            return;
+        }
+        http_res_t res(HTTP_OK);
+        res.set_body("text/plain",
+                     coro_profiler_t::get_global_profiler().get_folded_stacks());
+        *result = res;
+        return;
+    }
+
+    const std::string command = *it;
+    ++it;
+    if (it == req.resource.end() && command == "top") {
+        if (req.method != GET) {
+            *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+            return;
+        }
+        uint64_t n = 20;
+        boost::optional<std::string> maybe_n = req.find_query_param("n");
+        if (maybe_n) {
+            const char *end;
+            n = strtou64_strict(maybe_n->c_str(), &end, 10);
+            if (maybe_n->empty() || *end != '\0') {
+                *result = http_error_res("Query parameter \"n\" must be a number\n");
+                return;
+            }
+        }
+        http_res_t res(HTTP_OK);
+        res.set_body("text/plain",
+                     coro_profiler_t::get_global_profiler().get_top_coroutine_types(n));
+        *result = res;
+        return;
+    }
+    if (it != req.resource.end() || (command != "start" && command != "stop")) {
+        *result = http_res_t(HTTP_NOT_FOUND);
+        return;
+    }
+    if (req.method != POST) {
+        *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+        return;
+    }
+    if (command == "start") {
+        coro_profiler_t::get_global_profiler().enable();
+    } else {
+        coro_profiler_t::get_global_profiler().disable();
+    }
+    *result = http_res_t(HTTP_OK);
+}
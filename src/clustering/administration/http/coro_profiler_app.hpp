@@ -0,0 +1,27 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_HTTP_CORO_PROFILER_APP_HPP_
+#define CLUSTERING_ADMINISTRATION_HTTP_CORO_PROFILER_APP_HPP_
+
+#include "http/http.hpp"
+
+/* `coro_profiler_http_app_t` turns the coroutine profiler on and off and hands out
+what it has recorded:
+
+    POST /ajax/coro_profiler/start   starts (or restarts) profiling from scratch
+    POST /ajax/coro_profiler/stop    stops profiling
+    GET  /ajax/coro_profiler         returns the folded stacks recorded so far
+    GET  /ajax/coro_profiler/top?n=N returns the N (default 20) coroutine types that
+                                     have spent the most time running
+
+The folded stacks can be fed straight into `flamegraph.pl`. */
+class coro_profiler_http_app_t : public http_app_t {
+public:
+    coro_profiler_http_app_t() { }
+
+    void handle(const http_req_t &req, http_res_t *result, signal_t *interruptor);
+
+private:
+    DISABLE_COPYING(coro_profiler_http_app_t);
+};
+
+#endif /* CLUSTERING_ADMINISTRATION_HTTP_CORO_PROFILER_APP_HPP_ */
@@ -1,4 +1,5 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
+#include <set>
 #include <string>
 
 #include "errors.hpp"
@@ -10,7 +11,7 @@
 #include "clustering/administration/http/directory_app.hpp"
 
 directory_http_app_t::directory_http_app_t(const clone_ptr_t<watchable_t<change_tracking_map_t<peer_id_t, cluster_directory_metadata_t> > >& _directory_metadata)
-    : directory_metadata(_directory_metadata) { }
+    : directory_metadata(_directory_metadata), root_version(0) { }
 
 static const char *any_machine_id_wildcard = "_";
 
@@ -45,19 +46,56 @@ cJSON *directory_http_app_t::get_metadata_json(
     return json_adapter_head->render();
 }
 
+void directory_http_app_t::update_root_json() {
+    const unsigned int old_version = root_version;
+    directory_metadata->apply_read(
+        [&](const change_tracking_map_t<peer_id_t, cluster_directory_metadata_t> *md) {
+            if (root_version != 0 && md->get_current_version() == root_version) {
+                return;
+            }
+            const std::map<peer_id_t, cluster_directory_metadata_t> &inner = md->get_inner();
+            std::set<peer_id_t> changed;
+            if (root_version != 0 && md->get_current_version() == root_version + 1) {
+                changed = md->get_changed_keys();
+            } else {
+                // We missed a version, so we don't know what changed since.
+                peer_json.clear();
+                for (auto it = inner.begin(); it != inner.end(); ++it) {
+                    changed.insert(it->first);
+                }
+            }
+            for (auto it = changed.begin(); it != changed.end(); ++it) {
+                auto md_it = inner.find(*it);
+                if (md_it == inner.end()) {
+                    peer_json.erase(*it);
+                } else {
+                    cluster_directory_metadata_t metadata = md_it->second;
+                    json_read_only_adapter_t<cluster_directory_metadata_t> json_adapter(&metadata);
+                    peer_json_t *p = &peer_json[*it];
+                    p->machine_id = uuid_to_str(metadata.machine_id);
+                    p->json.reset(json_adapter.render());
+                }
+            }
+            root_version = md->get_current_version();
+        });
+    if (root_version == old_version && !root_body.empty()) {
+        return;
+    }
+
+    scoped_cJSON_t body(cJSON_CreateObject());
+    for (auto it = peer_json.begin(); it != peer_json.end(); ++it) {
+        body.AddItemToObject(it->second.machine_id.c_str(), it->second.json.DeepCopy());
+    }
+    root_body = http_json_body(body.get());
+    root_etag = http_etag(root_body);
+}
+
 void directory_http_app_t::get_root(scoped_cJSON_t *json_out) {
     // keep this in sync with handle's behavior for getting the root
-    std::map<peer_id_t, cluster_directory_metadata_t> md = directory_metadata->get().get_inner();
-
+    update_root_json();
     json_out->reset(cJSON_CreateObject());
-
-    for (std::map<peer_id_t, cluster_directory_metadata_t>::const_iterator i = md.begin(); i != md.end(); ++i) {
-        cluster_directory_metadata_t metadata = i->second;
-        std::string machine_id = uuid_to_str(metadata.machine_id);
-
-        json_read_only_adapter_t<cluster_directory_metadata_t> json_adapter(&metadata);
-
-        json_out->AddItemToObject(machine_id.c_str(), json_adapter.render());
+    for (auto it = peer_json.begin(); it != peer_json.end(); ++it) {
+        json_out->AddItemToObject(it->second.machine_id.c_str(), it->second.json.DeepCopy());
     }
 }
 
@@ -66,6 +104,11 @@ void directory_http_app_t::handle(const http_req_t &req, http_res_t *result, sig
         *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
         return;
     }
+    if (req.resource.begin() == req.resource.end()) {
+        update_root_json();
+        http_etag_res(req, "application/json", root_body, root_etag, result);
+        return;
+    }
     try {
         std::map<peer_id_t, cluster_directory_metadata_t> md = directory_metadata->get().get_inner();
 
@@ -3,10 +3,11 @@
 #define CLUSTERING_ADMINISTRATION_HTTP_DIRECTORY_APP_HPP_
 
 #include <map>
+#include <string>
 
 #include "clustering/administration/metadata.hpp"
 #include "http/http.hpp"
-#include "http/json/cJSON.hpp"
+#include "http/json.hpp"
 
 class directory_http_app_t : public http_json_app_t {
 public:
@@ -19,8 +20,24 @@ protected:
 private:
     cJSON *get_metadata_json(cluster_directory_metadata_t *metadata, http_req_t::resource_t::iterator path_begin, http_req_t::resource_t::iterator path_end) THROWS_ONLY(schema_mismatch_exc_t);
 
+    // Brings `peer_json`, `root_body` and `root_etag` up to date with the directory.
+    // If we saw the version before the current one, only the peers that changed in
+    // the current one are rendered again.
+    void update_root_json();
+
     clone_ptr_t<watchable_t<change_tracking_map_t<peer_id_t, cluster_directory_metadata_t> > > directory_metadata;
 
+    // Each peer's directory entry as JSON, keyed by its machine ID, as of version
+    // `root_version` of the directory (0 if we haven't rendered it yet).
+    struct peer_json_t {
+        std::string machine_id;
+        scoped_cJSON_t json;
+    };
+    std::map<peer_id_t, peer_json_t> peer_json;
+    unsigned int root_version;
+    std::string root_body;
+    std::string root_etag;
+
     DISABLE_COPYING(directory_http_app_t);
 };
 
@@ -12,6 +12,7 @@
 #define DEFAULT_DEPTH 1
 #define MAX_DEPTH 2
 #define DEFAULT_LIMIT 128
+#define MAX_SAMPLE_SIZE 100000
 
 distribution_app_t::distribution_app_t(boost::shared_ptr<semilattice_read_view_t<cow_ptr_t<namespaces_semilattice_metadata_t<memcached_protocol_t> > > > _namespaces_sl_metadata,
                                        namespace_repo_t<memcached_protocol_t> *_ns_repo,
@@ -60,6 +61,33 @@ void distribution_app_t::handle(const http_req_t &req, http_res_t *result, signa
         }
     }
 
+    // For rdb tables, `sample=N` bases the distribution on N randomly sampled keys
+    // per shard instead of on the btree nodes at depth `depth`, and `weight=bytes`
+    // returns the estimated size of each range in bytes instead of its number of
+    // keys (which requires `sample`).
+    uint64_t sample_size = 0;
+    boost::optional<std::string> maybe_sample = req.find_query_param("sample");
+
+    if (maybe_sample) {
+        if (!strtou64_strict(maybe_sample.get(), 10, &sample_size)
+            || sample_size == 0 || sample_size > MAX_SAMPLE_SIZE) {
+            *result = http_error_res("Invalid sample value.");
+            return;
+        }
+    }
+
+    bool weight_by_bytes = false;
+    boost::optional<std::string> maybe_weight = req.find_query_param("weight");
+
+    if (maybe_weight) {
+        if (maybe_weight.get() == "bytes" && sample_size != 0) {
+            weight_by_bytes = true;
+        } else if (maybe_weight.get() != "keys") {
+            *result = http_error_res("Invalid weight value.");
+            return;
+        }
+    }
+
     if (std_contains(ns_snapshot->namespaces, n_id)) {
         try {
             namespace_repo_t<memcached_protocol_t>::access_t ns_access(ns_repo, n_id, interruptor);
@@ -80,13 +108,18 @@ void distribution_app_t::handle(const http_req_t &req, http_res_t *result, signa
             namespace_repo_t<rdb_protocol_t>::access_t rdb_ns_access(rdb_ns_repo, n_id, interruptor);
 
             rdb_protocol_t::distribution_read_t inner_read(depth, limit);
+            inner_read.sample_size = sample_size;
             rdb_protocol_t::read_t read(inner_read, profile_bool_t::DONT_PROFILE);
             rdb_protocol_t::read_response_t db_res;
             rdb_ns_access.get_namespace_if()->read_outdated(read,
                                                             &db_res,
                                                             interruptor);
 
-            scoped_cJSON_t data(render_as_json(&boost::get<rdb_protocol_t::distribution_read_response_t>(db_res.response).key_counts));
+            rdb_protocol_t::distribution_read_response_t *dist
+                = &boost::get<rdb_protocol_t::distribution_read_response_t>(db_res.response);
+            scoped_cJSON_t data(render_as_json(weight_by_bytes
+                                               ? &dist->byte_counts
+                                               : &dist->key_counts));
             http_json_res(data.get(), result);
         } catch (const cannot_perform_query_exc_t &) {
             *result = http_res_t(HTTP_INTERNAL_SERVER_ERROR);
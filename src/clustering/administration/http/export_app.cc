@@ -0,0 +1,249 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/administration/http/export_app.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "config/args.hpp"
+#include "containers/uuid.hpp"
+#include "http/json.hpp"
+#include "rdb_protocol/export.hpp"
+#include "rdb_protocol/protocol.hpp"
+#include "stl_utils.hpp"
+
+// Finds the table named by the request's "namespace" parameter.  Sets `*result` and
+// returns false if there's no such rdb table.
+static bool get_table(
+        const http_req_t &req,
+        const cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > &snapshot,
+        namespace_id_t *namespace_id_out, std::string *primary_key_out,
+        http_res_t *result) {
+    boost::optional<std::string> maybe_n_id = req.find_query_param("namespace");
+    if (!maybe_n_id || !is_uuid(*maybe_n_id)) {
+        *result = http_error_res("Valid uuid required for query parameter \"namespace\"\n");
+        return false;
+    }
+    *namespace_id_out = str_to_uuid(*maybe_n_id);
+
+    auto it = snapshot->namespaces.find(*namespace_id_out);
+    if (it == snapshot->namespaces.end() || it->second.is_deleted()
+        || it->second.get_ref().primary_key.in_conflict()) {
+        *result = http_res_t(HTTP_NOT_FOUND);
+        return false;
+    }
+    *primary_key_out = it->second.get_ref().primary_key.get();
+    return true;
+}
+
+export_app_t::export_app_t(boost::shared_ptr<semilattice_read_view_t<cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > > > _namespaces_sl_metadata,
+                           namespace_repo_t<rdb_protocol_t> *_ns_repo)
+    : namespaces_sl_metadata(_namespaces_sl_metadata), ns_repo(_ns_repo) { }
+
+void export_app_t::handle(const http_req_t &req, http_res_t *result, signal_t *interruptor) {
+    if (req.resource.begin() != req.resource.end()) {
+        *result = http_res_t(HTTP_NOT_FOUND);
+        return;
+    }
+    if (req.method != POST) {
+        *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+        return;
+    }
+
+    namespace_id_t n_id;
+    std::string primary_key;
+    if (!get_table(req, namespaces_sl_metadata->get(), &n_id, &primary_key, result)) {
+        return;
+    }
+    boost::optional<std::string> maybe_directory = req.find_query_param("directory");
+    if (!maybe_directory || maybe_directory->empty()) {
+        *result = http_error_res("Query parameter \"directory\" required\n");
+        return;
+    }
+
+    try {
+        namespace_repo_t<rdb_protocol_t>::access_t ns_access(ns_repo, n_id, interruptor);
+
+        // Not `read_outdated`, so that the export has the writes that were acked
+        // before it.
+        rdb_protocol_t::read_t read(rdb_protocol_t::export_read_t(*maybe_directory),
+                                    profile_bool_t::DONT_PROFILE);
+        rdb_protocol_t::read_response_t db_res;
+        ns_access.get_namespace_if()->read(read, &db_res, order_token_t::ignore,
+                                           interruptor);
+
+        rdb_protocol_t::export_read_response_t *res
+            = boost::get<rdb_protocol_t::export_read_response_t>(&db_res.response);
+        guarantee(res != NULL);
+        if (!res->error.empty()) {
+            *result = http_error_res(res->error + "\n", HTTP_INTERNAL_SERVER_ERROR);
+            return;
+        }
+
+        scoped_cJSON_t data(cJSON_CreateObject());
+        scoped_cJSON_t files(cJSON_CreateArray());
+        for (auto it = res->files.begin(); it != res->files.end(); ++it) {
+            files.AddItemToArray(cJSON_CreateString(it->c_str()));
+        }
+        data.AddItemToObject("files", files.release());
+        data.AddItemToObject("rows", cJSON_CreateNumber(res->rows));
+        http_json_res(data.get(), result);
+    } catch (const cannot_perform_query_exc_t &e) {
+        *result = http_error_res(std::string(e.what()) + "\n",
+                                 HTTP_INTERNAL_SERVER_ERROR);
+    }
+}
+
+import_app_t::import_app_t(boost::shared_ptr<semilattice_read_view_t<cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > > > _namespaces_sl_metadata,
+                           namespace_repo_t<rdb_protocol_t> *_ns_repo)
+    : namespaces_sl_metadata(_namespaces_sl_metadata), ns_repo(_ns_repo) { }
+
+void import_app_t::handle(const http_req_t &req, http_res_t *result, signal_t *interruptor) {
+    if (req.resource.begin() != req.resource.end()) {
+        *result = http_res_t(HTTP_NOT_FOUND);
+        return;
+    }
+    if (req.method != POST) {
+        *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+        return;
+    }
+
+    namespace_id_t n_id;
+    std::string primary_key;
+    if (!get_table(req, namespaces_sl_metadata->get(), &n_id, &primary_key, result)) {
+        return;
+    }
+    boost::optional<std::string> maybe_file = req.find_query_param("file");
+    if (!maybe_file || maybe_file->empty()) {
+        *result = http_error_res("Query parameter \"file\" required\n");
+        return;
+    }
+
+    export_reader_t reader(*maybe_file);
+    if (!reader.error().empty()) {
+        *result = http_error_res(reader.error() + "\n");
+        return;
+    }
+
+    uint64_t rows = 0;
+    uint64_t errors = 0;
+    std::string first_error;
+    try {
+        namespace_repo_t<rdb_protocol_t>::access_t ns_access(ns_repo, n_id, interruptor);
+
+        std::vector<counted_t<const ql::datum_t> > chunk;
+        while (reader.next_chunk(&chunk)) {
+            // Rows from a table with a different primary key can't be inserted.
+            auto valid_end = std::partition(
+                chunk.begin(), chunk.end(),
+                [&primary_key](const counted_t<const ql::datum_t> &row) {
+                    return row->get_type() == ql::datum_t::R_OBJECT
+                        && row->get(primary_key, ql::NOTHROW).has();
+                });
+            if (valid_end != chunk.end()) {
+                errors += chunk.end() - valid_end;
+                if (first_error.empty()) {
+                    first_error = strprintf("Rows without the primary key `%s`.",
+                                            primary_key.c_str());
+                }
+            }
+
+            for (auto it = chunk.begin(); it != valid_end; ) {
+                const size_t n = std::min<size_t>(valid_end - it, IMPORT_BATCH_SIZE);
+                std::vector<counted_t<const ql::datum_t> > batch(
+                    std::make_move_iterator(it), std::make_move_iterator(it + n));
+                it += n;
+
+                // The table is synced once at the end instead.
+                rdb_protocol_t::write_t write(
+                    rdb_protocol_t::batched_insert_t(std::move(batch), primary_key,
+                                                     true, false),
+                    DURABILITY_REQUIREMENT_SOFT, profile_bool_t::DONT_PROFILE);
+                rdb_protocol_t::write_response_t response;
+                ns_access.get_namespace_if()->write(write, &response,
+                                                    order_token_t::ignore, interruptor);
+
+                counted_t<const ql::datum_t> stats
+                    = boost::get<rdb_protocol_t::batched_replace_response_t>(
+                        response.response);
+                counted_t<const ql::datum_t> batch_errors
+                    = stats->get("errors", ql::NOTHROW);
+                if (batch_errors.has() && batch_errors->as_num() > 0) {
+                    errors += batch_errors->as_num();
+                    counted_t<const ql::datum_t> batch_first_error
+                        = stats->get("first_error", ql::NOTHROW);
+                    if (first_error.empty() && batch_first_error.has()) {
+                        first_error = batch_first_error->as_str().to_std();
+                    }
+                }
+                rows += n;
+            }
+        }
+
+        rdb_protocol_t::write_t sync(rdb_protocol_t::sync_t(),
+                                     DURABILITY_REQUIREMENT_HARD,
+                                     profile_bool_t::DONT_PROFILE);
+        rdb_protocol_t::write_response_t sync_response;
+        ns_access.get_namespace_if()->write(sync, &sync_response,
+                                            order_token_t::ignore, interruptor);
+    } catch (const cannot_perform_query_exc_t &e) {
+        *result = http_error_res(strprintf("%s (after importing %" PRIu64 " rows)\n",
+                                           e.what(), rows),
+                                 HTTP_INTERNAL_SERVER_ERROR);
+        return;
+    }
+
+    if (!reader.error().empty()) {
+        *result = http_error_res(strprintf("%s (after importing %" PRIu64 " rows)\n",
+                                           reader.error().c_str(), rows));
+        return;
+    }
+
+    scoped_cJSON_t data(cJSON_CreateObject());
+    data.AddItemToObject("rows", cJSON_CreateNumber(rows));
+    data.AddItemToObject("errors", cJSON_CreateNumber(errors));
+    if (!first_error.empty()) {
+        data.AddItemToObject("first_error", cJSON_CreateString(first_error.c_str()));
+    }
+    http_json_res(data.get(), result);
+}
+
+freeze_app_t::freeze_app_t(boost::shared_ptr<semilattice_read_view_t<cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > > > _namespaces_sl_metadata,
+                           namespace_repo_t<rdb_protocol_t> *_ns_repo)
+    : namespaces_sl_metadata(_namespaces_sl_metadata), ns_repo(_ns_repo) { }
+
+void freeze_app_t::handle(const http_req_t &req, http_res_t *result, signal_t *interruptor) {
+    if (req.resource.begin() != req.resource.end()) {
+        *result = http_res_t(HTTP_NOT_FOUND);
+        return;
+    }
+    if (req.method != POST) {
+        *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+        return;
+    }
+
+    namespace_id_t n_id;
+    std::string primary_key;
+    if (!get_table(req, namespaces_sl_metadata->get(), &n_id, &primary_key, result)) {
+        return;
+    }
+
+    try {
+        namespace_repo_t<rdb_protocol_t>::access_t ns_access(ns_repo, n_id, interruptor);
+
+        rdb_protocol_t::write_t write(rdb_protocol_t::freeze_t(),
+                                      DURABILITY_REQUIREMENT_DEFAULT,
+                                      profile_bool_t::DONT_PROFILE);
+        rdb_protocol_t::write_response_t response;
+        ns_access.get_namespace_if()->write(write, &response,
+                                            order_token_t::ignore, interruptor);
+    } catch (const cannot_perform_query_exc_t &e) {
+        *result = http_error_res(std::string(e.what()) + "\n",
+                                 HTTP_INTERNAL_SERVER_ERROR);
+        return;
+    }
+
+    scoped_cJSON_t data(cJSON_CreateObject());
+    http_json_res(data.get(), result);
+}
@@ -0,0 +1,74 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_HTTP_EXPORT_APP_HPP_
+#define CLUSTERING_ADMINISTRATION_HTTP_EXPORT_APP_HPP_
+
+#include "errors.hpp"
+#include <boost/shared_ptr.hpp>
+
+#include "clustering/administration/namespace_interface_repository.hpp"
+#include "clustering/administration/namespace_metadata.hpp"
+#include "http/http.hpp"
+#include "rpc/semilattice/view.hpp"
+
+struct rdb_protocol_t;
+
+/* `export_app_t` and `import_app_t` back up and restore rdb tables without going
+through ReQL (see `rdb_export()`):
+
+    POST /ajax/export?namespace=<uuid>&directory=<path>
+        makes each shard write its rows to a file in <path> on the server it's read
+        from, and returns {"files": [...], "rows": N}
+    POST /ajax/import?namespace=<uuid>&file=<path>
+        inserts the rows in the export file <path> on this server into the table
+        (replacing the rows with the same keys), and returns
+        {"rows": N, "errors": N, "first_error": ...}
+
+The export files have to be copied to the server that imports them.
+
+`freeze_app_t` is for tables that won't be written to again, like the archive a
+backup gets restored into:
+
+    POST /ajax/freeze?namespace=<uuid>
+        makes each shard pack its rows into as few leaves as they fit in (see
+        `rdb_protocol_t::freeze_t`), and returns {} right away; the packing goes on in
+        the background */
+class export_app_t : public http_app_t {
+public:
+    export_app_t(boost::shared_ptr<semilattice_read_view_t<cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > > > _namespaces_sl_metadata,
+                 namespace_repo_t<rdb_protocol_t> *_ns_repo);
+    void handle(const http_req_t &req, http_res_t *result, signal_t *interruptor);
+
+private:
+    boost::shared_ptr<semilattice_read_view_t<cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > > > namespaces_sl_metadata;
+    namespace_repo_t<rdb_protocol_t> *ns_repo;
+
+    DISABLE_COPYING(export_app_t);
+};
+
+class import_app_t : public http_app_t {
+public:
+    import_app_t(boost::shared_ptr<semilattice_read_view_t<cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > > > _namespaces_sl_metadata,
+                 namespace_repo_t<rdb_protocol_t> *_ns_repo);
+    void handle(const http_req_t &req, http_res_t *result, signal_t *interruptor);
+
+private:
+    boost::shared_ptr<semilattice_read_view_t<cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > > > namespaces_sl_metadata;
+    namespace_repo_t<rdb_protocol_t> *ns_repo;
+
+    DISABLE_COPYING(import_app_t);
+};
+
+class freeze_app_t : public http_app_t {
+public:
+    freeze_app_t(boost::shared_ptr<semilattice_read_view_t<cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > > > _namespaces_sl_metadata,
+                 namespace_repo_t<rdb_protocol_t> *_ns_repo);
+    void handle(const http_req_t &req, http_res_t *result, signal_t *interruptor);
+
+private:
+    boost::shared_ptr<semilattice_read_view_t<cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > > > namespaces_sl_metadata;
+    namespace_repo_t<rdb_protocol_t> *ns_repo;
+
+    DISABLE_COPYING(freeze_app_t);
+};
+
+#endif /* CLUSTERING_ADMINISTRATION_HTTP_EXPORT_APP_HPP_ */
@@ -0,0 +1,156 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/administration/http/metrics_app.hpp"
+
+#include <stdlib.h>
+
+#include <map>
+#include <vector>
+
+#include "arch/runtime/coroutines.hpp"
+#include "containers/uuid.hpp"
+#include "perfmon/collect.hpp"
+#include "perfmon/core.hpp"
+#include "utils.hpp"
+
+namespace {
+
+struct metric_labels_t {
+    std::string table, shard, thread;
+};
+
+// Whether `component` is `prefix` followed by digits, and if so, the digits.
+bool numbered_component(const std::string &component, const std::string &prefix,
+                        std::string *number_out) {
+    if (component.size() <= prefix.size()
+        || component.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+    for (size_t i = prefix.size(); i < component.size(); ++i) {
+        if (component[i] < '0' || component[i] > '9') {
+            return false;
+        }
+    }
+    *number_out = component.substr(prefix.size());
+    return true;
+}
+
+void append_name_part(const std::string &component, std::string *name) {
+    name->push_back('_');
+    for (size_t i = 0; i < component.size(); ++i) {
+        const char c = component[i];
+        const bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+            || (c >= '0' && c <= '9') || c == '_';
+        name->push_back(ok ? c : '_');
+    }
+}
+
+void append_label(const char *key, const std::string &value, std::string *out) {
+    if (value.empty()) {
+        return;
+    }
+    out->append(out->empty() ? "{" : ",");
+    out->append(key);
+    out->append("=\"");
+    for (size_t i = 0; i < value.size(); ++i) {
+        switch (value[i]) {
+        case '\\': out->append("\\\\"); break;
+        case '"': out->append("\\\""); break;
+        case '\n': out->append("\\n"); break;
+        default: out->push_back(value[i]); break;
+        }
+    }
+    out->append("\"");
+}
+
+// Samples are grouped by metric name, since a metric's samples have to be
+// together in the output.
+typedef std::map<std::string, std::vector<std::string> > samples_by_name_t;
+
+void collect_samples(const perfmon_result_t &stat, const std::string &name,
+                     const metric_labels_t &labels, samples_by_name_t *out) {
+    if (stat.is_map()) {
+        for (auto it = stat.begin(); it != stat.end(); ++it) {
+            metric_labels_t sublabels = labels;
+            std::string subname = name;
+            std::string number;
+            if (sublabels.table.empty() && is_uuid(it->first)) {
+                sublabels.table = it->first;
+            } else if (sublabels.shard.empty()
+                       && numbered_component(it->first, "shard_", &number)) {
+                sublabels.shard = number;
+            } else if (sublabels.thread.empty()
+                       && numbered_component(it->first, "thread_", &number)) {
+                sublabels.thread = number;
+            } else {
+                append_name_part(it->first, &subname);
+            }
+            collect_samples(*it->second, subname, sublabels, out);
+        }
+        return;
+    }
+
+    const std::string &value = *stat.get_string();
+    char *end;
+    strtod(value.c_str(), &end);
+    if (value.empty() || *end != '\0') {
+        return;
+    }
+    std::string sample;
+    append_label("table", labels.table, &sample);
+    append_label("shard", labels.shard, &sample);
+    append_label("thread", labels.thread, &sample);
+    if (!sample.empty()) {
+        sample.append("}");
+    }
+    sample.append(" ");
+    sample.append(value);
+    (*out)[name].push_back(sample);
+}
+
+}  // namespace
+
+std::string render_perfmon_metrics(const perfmon_result_t &stats) {
+    samples_by_name_t samples;
+    collect_samples(stats, "rethinkdb", metric_labels_t(), &samples);
+
+    std::string body;
+    for (auto it = samples.begin(); it != samples.end(); ++it) {
+        body.append("# TYPE " + it->first + " untyped\n");
+        for (auto s = it->second.begin(); s != it->second.end(); ++s) {
+            body.append(it->first);
+            body.append(*s);
+            body.append("\n");
+        }
+    }
+    return body;
+}
+
+void metrics_http_app_t::handle(const http_req_t &req, http_res_t *result,
+                                UNUSED signal_t *interruptor) {
+    if (req.method != GET) {
+        *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+        return;
+    }
+    if (req.resource.begin() != req.resource.end()) {
+        *result = http_res_t(HTTP_NOT_FOUND);
+        return;
+    }
+
+    std::string body;
+    {
+        on_thread_t th(home_thread());
+        mutex_t::acq_t acq(&refresh_mutex);
+        const ticks_t now = get_ticks();
+        if (cached_at == 0
+            || now - cached_at > static_cast<ticks_t>(METRICS_CACHE_MS) * MILLION) {
+            scoped_ptr_t<perfmon_result_t> stats = perfmon_get_stats();
+            cached_body = render_perfmon_metrics(*stats);
+            cached_at = get_ticks();
+        }
+        body = cached_body;
+    }
+
+    http_res_t res(HTTP_OK);
+    res.set_body("text/plain; version=0.0.4", body);
+    *result = res;
+}
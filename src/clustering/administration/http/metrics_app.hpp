@@ -0,0 +1,41 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_HTTP_METRICS_APP_HPP_
+#define CLUSTERING_ADMINISTRATION_HTTP_METRICS_APP_HPP_
+
+#include <string>
+
+#include "concurrency/mutex.hpp"
+#include "http/http.hpp"
+#include "threading.hpp"
+#include "time.hpp"
+
+class perfmon_result_t;
+
+/* Renders this server's stats in the Prometheus text format. Each numeric stat
+becomes a sample named after its path in the perfmon tree (prefixed with
+"rethinkdb_", with anything but letters, digits and underscores turned into
+underscores). Path components that are table IDs, "shard_N" or "thread_N" become
+the `table`, `shard` and `thread` labels instead of parts of the name. Stats that
+aren't numbers (such as "-") are left out. */
+std::string render_perfmon_metrics(const perfmon_result_t &stats);
+
+/* `metrics_http_app_t` serves `render_perfmon_metrics()` of the local server's
+stats at GET /ajax/metrics. Unlike /ajax/stat, it doesn't ask the other servers
+(each one is scraped on its own) and goes through no JSON. The result is reused
+for METRICS_CACHE_MS, and scrapers that come in while it is being collected wait
+for that collection instead of starting their own. */
+class metrics_http_app_t : public http_app_t, public home_thread_mixin_t {
+public:
+    metrics_http_app_t() : cached_at(0) { }
+
+    void handle(const http_req_t &req, http_res_t *result, signal_t *interruptor);
+
+private:
+    mutex_t refresh_mutex;
+    std::string cached_body;
+    ticks_t cached_at;
+
+    DISABLE_COPYING(metrics_http_app_t);
+};
+
+#endif /* CLUSTERING_ADMINISTRATION_HTTP_METRICS_APP_HPP_ */
@@ -1,9 +1,11 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <set>
 #include <string>
 #include <vector>
 
 #include "errors.hpp"
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/bind.hpp>
 
 #include "http/http.hpp"
 #include "clustering/administration/http/json_adapters.hpp"
@@ -11,6 +13,38 @@
 #include "clustering/administration/suggester.hpp"
 #include "stl_utils.hpp"
 
+// The names of the top-level JSON fields of `after` that differ from those of `before`.
+static void get_changed_json_subfields(const cluster_semilattice_metadata_t &before,
+                                       const cluster_semilattice_metadata_t &after,
+                                       std::set<std::string> *changed_out) {
+    if (!(before.dummy_namespaces == after.dummy_namespaces)) {
+        changed_out->insert("dummy_namespaces");
+    }
+    if (!(before.memcached_namespaces == after.memcached_namespaces)) {
+        changed_out->insert("memcached_namespaces");
+    }
+    if (!(before.rdb_namespaces == after.rdb_namespaces)) {
+        changed_out->insert("rdb_namespaces");
+    }
+    if (!(before.machines == after.machines)) {
+        changed_out->insert("machines");
+    }
+    if (!(before.datacenters == after.datacenters)) {
+        changed_out->insert("datacenters");
+    }
+    if (!(before.databases == after.databases)) {
+        changed_out->insert("databases");
+    }
+}
+
+static void get_changed_json_subfields(const auth_semilattice_metadata_t &before,
+                                       const auth_semilattice_metadata_t &after,
+                                       std::set<std::string> *changed_out) {
+    if (!(before.auth_key == after.auth_key)) {
+        changed_out->insert("auth_key");
+    }
+}
+
 template <class metadata_t>
 semilattice_http_app_t<metadata_t>::semilattice_http_app_t(
         metadata_change_handler_t<metadata_t> *_metadata_change_handler,
@@ -18,7 +52,12 @@ semilattice_http_app_t<metadata_t>::semilattice_http_app_t(
         uuid_u _us) :
     directory_metadata(_directory_metadata),
     us(_us),
-    metadata_change_handler(_metadata_change_handler) {
+    metadata_change_handler(_metadata_change_handler),
+    metadata_version(0),
+    root_json_version(0),
+    rendered_version(0),
+    metadata_subscription(boost::bind(&semilattice_http_app_t<metadata_t>::on_metadata_change, this),
+                          metadata_change_handler->get_view()) {
     // Do nothing
 }
 
@@ -28,16 +67,60 @@ semilattice_http_app_t<metadata_t>::~semilattice_http_app_t() {
 }
 
 template <class metadata_t>
-void semilattice_http_app_t<metadata_t>::get_root(scoped_cJSON_t *json_out) {
-    // keep this in sync with handle's behavior for getting the root
+void semilattice_http_app_t<metadata_t>::on_metadata_change() {
+    ++metadata_version;
+}
+
+template <class metadata_t>
+void semilattice_http_app_t<metadata_t>::update_root_json() {
+    if (root_json.get() != NULL && root_json_version == metadata_version) {
+        return;
+    }
     metadata_t metadata = metadata_change_handler->get();
     vclock_ctx_t json_ctx(us);
     json_ctx_adapter_t<metadata_t, vclock_ctx_t> json_adapter(&metadata, json_ctx);
-    json_out->reset(json_adapter.render());
+    if (root_json.get() == NULL) {
+        root_json.reset(json_adapter.render());
+    } else {
+        // Comparing the metadata is much cheaper than rendering it.
+        std::set<std::string> changed;
+        get_changed_json_subfields(root_metadata, metadata, &changed);
+        json_adapter_if_t::json_adapter_map_t subfields = json_adapter.get_subfields();
+        for (std::set<std::string>::iterator it = changed.begin(); it != changed.end(); ++it) {
+            guarantee(subfields.find(*it) != subfields.end());
+            root_json.ReplaceItemInObject(it->c_str(), subfields[*it]->render());
+        }
+    }
+    root_metadata = metadata;
+    root_json_version = metadata_version;
+}
+
+template <class metadata_t>
+void semilattice_http_app_t<metadata_t>::forget_stale_renders() {
+    if (rendered_version != metadata_version) {
+        rendered.clear();
+        rendered_version = metadata_version;
+    }
+}
+
+template <class metadata_t>
+void semilattice_http_app_t<metadata_t>::get_root(scoped_cJSON_t *json_out) {
+    update_root_json();
+    json_out->reset(root_json.DeepCopy());
 }
 
 template <class metadata_t>
 void semilattice_http_app_t<metadata_t>::handle(const http_req_t &req, http_res_t *result, signal_t *) {
+    if (req.method == GET) {
+        forget_stale_renders();
+        typename std::map<std::string, rendered_t>::iterator it
+            = rendered.find(req.resource.as_string());
+        if (it != rendered.end()) {
+            http_etag_res(req, "application/json", it->second.body, it->second.etag, result);
+            return;
+        }
+    }
+
     try {
         metadata_t metadata = metadata_change_handler->get();
 
@@ -62,8 +145,17 @@ void semilattice_http_app_t<metadata_t>::handle(const http_req_t &req, http_res_
         switch (req.method) {
             case GET:
             {
-                scoped_cJSON_t json_repr(json_adapter_head->render());
-                http_json_res(json_repr.get(), result);
+                rendered_t r;
+                if (req.resource.begin() == req.resource.end()) {
+                    update_root_json();
+                    r.body = http_json_body(root_json.get());
+                } else {
+                    scoped_cJSON_t json_repr(json_adapter_head->render());
+                    r.body = http_json_body(json_repr.get());
+                }
+                r.etag = http_etag(r.body);
+                http_etag_res(req, "application/json", r.body, r.etag, result);
+                rendered[req.resource.as_string()] = r;
             }
             break;
             case POST:
@@ -116,6 +208,9 @@ void semilattice_http_app_t<metadata_t>::handle(const http_req_t &req, http_res_
 
                 metadata_change_callback(&metadata, prioritize_distr_for_ns);
                 metadata_change_handler->update(metadata);
+                // Don't count on the view to tell us about our own change in time
+                // for the next GET.
+                on_metadata_change();
 
                 scoped_cJSON_t json_repr(json_adapter_head->render());
                 http_json_res(json_repr.get(), result);
@@ -130,6 +225,7 @@ void semilattice_http_app_t<metadata_t>::handle(const http_req_t &req, http_res_
                 metadata_change_callback(&metadata,
                                          boost::optional<namespace_id_t>());
                 metadata_change_handler->update(metadata);
+                on_metadata_change();
 
                 scoped_cJSON_t json_repr(json_adapter_head->render());
                 http_json_res(json_repr.get(), result);
@@ -169,6 +265,7 @@ void semilattice_http_app_t<metadata_t>::handle(const http_req_t &req, http_res_
                 metadata_change_callback(&metadata,
                                          boost::optional<namespace_id_t>());
                 metadata_change_handler->update(metadata);
+                on_metadata_change();
 
                 scoped_cJSON_t json_repr(json_adapter_head->render());
                 http_json_res(json_repr.get(), result);
@@ -45,8 +45,35 @@ private:
     namespace_id_t get_resource_namespace(const http_req_t::resource_t &resource) const
         THROWS_ONLY(collect_namespaces_exc_t);
 
+    // Brings `root_json` up to date with the metadata.  Only the top-level fields that
+    // changed since the last time are rendered again.
+    void update_root_json();
+    // Drops the `rendered` bodies if the metadata changed since they were rendered.
+    void forget_stale_renders();
+    void on_metadata_change();
+
     metadata_change_handler_t<metadata_t> *metadata_change_handler;
 
+    // Counts the changes to the metadata, so that we can tell if what we rendered
+    // is still good without looking at the metadata.
+    uint64_t metadata_version;
+
+    // The whole metadata as JSON, and what it was rendered from.
+    scoped_cJSON_t root_json;
+    metadata_t root_metadata;
+    uint64_t root_json_version;
+
+    // The bodies of the GETs since the last change, by path.  The web UI polls the
+    // same few paths over and over.
+    struct rendered_t {
+        std::string body;
+        std::string etag;
+    };
+    std::map<std::string, rendered_t> rendered;
+    uint64_t rendered_version;
+
+    typename semilattice_read_view_t<metadata_t>::subscription_t metadata_subscription;
+
     DISABLE_COPYING(semilattice_http_app_t);
 };
 
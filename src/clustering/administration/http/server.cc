@@ -1,12 +1,17 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/administration/http/server.hpp"
 
+#include "clustering/administration/http/block_trace_app.hpp"
+#include "clustering/administration/http/compaction_app.hpp"
+#include "clustering/administration/http/coro_profiler_app.hpp"
 #include "clustering/administration/http/cyanide.hpp"
 #include "clustering/administration/http/directory_app.hpp"
 #include "clustering/administration/http/distribution_app.hpp"
+#include "clustering/administration/http/export_app.hpp"
 #include "clustering/administration/http/issues_app.hpp"
 #include "clustering/administration/http/last_seen_app.hpp"
 #include "clustering/administration/http/log_app.hpp"
+#include "clustering/administration/http/metrics_app.hpp"
 #include "clustering/administration/http/progress_app.hpp"
 #include "clustering/administration/http/semilattice_app.hpp"
 #include "clustering/administration/http/stat_app.hpp"
@@ -238,6 +243,13 @@ administrative_http_server_manager_t::administrative_http_server_manager_t(
     progress_app.init(new progress_app_t(_directory_metadata, mbox_manager));
     distribution_app.init(new distribution_app_t(metadata_field(&cluster_semilattice_metadata_t::memcached_namespaces, _semilattice_metadata), _namespace_repo,
                                                  metadata_field(&cluster_semilattice_metadata_t::rdb_namespaces, _semilattice_metadata), _rdb_namespace_repo));
+    coro_profiler_app.init(new coro_profiler_http_app_t);
+    block_trace_app.init(new block_trace_http_app_t);
+    compaction_app.init(new compaction_http_app_t);
+    export_app.init(new export_app_t(metadata_field(&cluster_semilattice_metadata_t::rdb_namespaces, _semilattice_metadata), _rdb_namespace_repo));
+    import_app.init(new import_app_t(metadata_field(&cluster_semilattice_metadata_t::rdb_namespaces, _semilattice_metadata), _rdb_namespace_repo));
+    freeze_app.init(new freeze_app_t(metadata_field(&cluster_semilattice_metadata_t::rdb_namespaces, _semilattice_metadata), _rdb_namespace_repo));
+    metrics_app.init(new metrics_http_app_t);
 
 #ifndef NDEBUG
     cyanide_app.init(new cyanide_http_app_t);
@@ -254,6 +266,13 @@ administrative_http_server_manager_t::administrative_http_server_manager_t(
     ajax_routes["semilattice"] = cluster_semilattice_app.get();
     ajax_routes["auth"] = auth_semilattice_app.get();
     ajax_routes["reql"] = reql_app;
+    ajax_routes["coro_profiler"] = coro_profiler_app.get();
+    ajax_routes["block_trace"] = block_trace_app.get();
+    ajax_routes["compact"] = compaction_app.get();
+    ajax_routes["export"] = export_app.get();
+    ajax_routes["import"] = import_app.get();
+    ajax_routes["freeze"] = freeze_app.get();
+    ajax_routes["metrics"] = metrics_app.get();
     DEBUG_ONLY_CODE(ajax_routes["cyanide"] = cyanide_app.get());
 
     std::map<std::string, http_json_app_t *> default_views;
@@ -29,6 +29,13 @@ class stat_manager_t;
 class distribution_app_t;
 class cyanide_http_app_t;
 class combining_http_app_t;
+class coro_profiler_http_app_t;
+class block_trace_http_app_t;
+class compaction_http_app_t;
+class export_app_t;
+class import_app_t;
+class freeze_app_t;
+class metrics_http_app_t;
 
 class administrative_http_server_manager_t {
 
@@ -63,6 +70,13 @@ private:
     scoped_ptr_t<progress_app_t> progress_app;
     scoped_ptr_t<distribution_app_t> distribution_app;
     scoped_ptr_t<combining_http_app_t> combining_app;
+    scoped_ptr_t<coro_profiler_http_app_t> coro_profiler_app;
+    scoped_ptr_t<block_trace_http_app_t> block_trace_app;
+    scoped_ptr_t<compaction_http_app_t> compaction_app;
+    scoped_ptr_t<export_app_t> export_app;
+    scoped_ptr_t<import_app_t> import_app;
+    scoped_ptr_t<freeze_app_t> freeze_app;
+    scoped_ptr_t<metrics_http_app_t> metrics_app;
 #ifndef NDEBUG
     scoped_ptr_t<cyanide_http_app_t> cyanide_app;
 #endif
@@ -33,6 +33,10 @@ void check_namespaces_for_protocol(
             check("namespace", it->first, "secondary_pinnings", it->second.get_ref().secondary_pinnings, out);
             check("namespace", it->first, "database", it->second.get_ref().database, out);
             check("namespace", it->first, "cache_size", it->second.get_ref().cache_size, out);
+            check("namespace", it->first, "cache_size_floor", it->second.get_ref().cache_size_floor, out);
+            check("namespace", it->first, "cache_size_ceiling", it->second.get_ref().cache_size_ceiling, out);
+            check("namespace", it->first, "block_size", it->second.get_ref().block_size, out);
+            check("namespace", it->first, "hash_shards", it->second.get_ref().hash_shards, out);
         }
     }
 }
@@ -21,9 +21,14 @@
 #include <functional>
 
 #include "arch/io/disk.hpp"
+#include "arch/io/network.hpp"
 #include "arch/os_signal.hpp"
+#include "arch/runtime/event_queue.hpp"
+#include "arch/runtime/numa.hpp"
 #include "arch/runtime/starter.hpp"
+#include "extproc/extproc_pool.hpp"
 #include "extproc/extproc_spawner.hpp"
+#include "clustering/administration/auto_resharder.hpp"
 #include "clustering/administration/cli/admin_command_parser.hpp"
 #include "clustering/administration/main/names.hpp"
 #include "clustering/administration/main/options.hpp"
@@ -34,8 +39,13 @@
 #include "clustering/administration/logger.hpp"
 #include "clustering/administration/main/path.hpp"
 #include "clustering/administration/persist.hpp"
+#include "clustering/immediate_consistency/branch/backfiller.hpp"
+#include "clustering/reactor/reactor.hpp"
 #include "logger.hpp"
 #include "mock/dummy_protocol.hpp"
+#include "rdb_protocol/slow_query_log.hpp"
+#include "rpc/connectivity/cluster.hpp"
+#include "serializer/buffer_allocator.hpp"
 
 #define RETHINKDB_EXPORT_SCRIPT "rethinkdb-export"
 #define RETHINKDB_IMPORT_SCRIPT "rethinkdb-import"
@@ -312,12 +322,22 @@ public:
         joins(&_joins),
         ports(_ports),
         web_assets(_web_assets),
-        config_file(_config_file) { }
+        config_file(_config_file),
+        use_shared_table_file(false) { }
 
     const std::vector<host_and_port_t> *joins;
     service_address_ports_t ports;
     std::string web_assets;
     boost::optional<std::string> config_file;
+    // Where the tables' index files go, if they get any (see
+    // parse_directory_option()).
+    boost::optional<base_path_t> index_base_path;
+    // Where the tables' archive files go, if they get any.
+    boost::optional<base_path_t> archive_base_path;
+    // Whether new tables go in the shared table file (--shared-table-file).
+    bool use_shared_table_file;
+    // See parse_slow_query_log_options().
+    slow_query_log_config_t slow_query_log;
 };
 
 // Used for options that don't take parameters, such as --help or --exit-failure, tells whether the
@@ -603,6 +623,7 @@ void run_rethinkdb_create(const base_path_t &base_path,
                           const name_string_t &machine_name,
                           const file_direct_io_mode_t direct_io_mode,
                           const int max_concurrent_io_requests,
+                          const disk_backend_t disk_backend,
                           bool *const result_out) {
     machine_id_t our_machine_id = generate_uuid();
 
@@ -614,7 +635,7 @@ void run_rethinkdb_create(const base_path_t &base_path,
     machine_semilattice_metadata.datacenter = vclock_t<datacenter_id_t>(nil_uuid(), our_machine_id);
     cluster_metadata.machines.machines.insert(std::make_pair(our_machine_id, make_deletable(machine_semilattice_metadata)));
 
-    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests);
+    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests, disk_backend);
 
     perfmon_collection_t metadata_perfmon_collection;
     perfmon_membership_t metadata_perfmon_membership(&get_global_perfmon_collection(), &metadata_perfmon_collection, "metadata");
@@ -709,6 +730,7 @@ void run_rethinkdb_serve(const base_path_t &base_path,
                          const serve_info_t &serve_info,
                          const file_direct_io_mode_t direct_io_mode,
                          const int max_concurrent_io_requests,
+                         const disk_backend_t disk_backend,
                          const machine_id_t *our_machine_id,
                          const cluster_semilattice_metadata_t *cluster_metadata,
                          directory_lock_t *data_directory_lock,
@@ -719,7 +741,8 @@ void run_rethinkdb_serve(const base_path_t &base_path,
 
     logINF("Loading data from directory %s\n", base_path.path().c_str());
 
-    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests);
+    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests, disk_backend);
+    logINF("Using the %s disk backend.\n", disk_backend_name(io_backender.get_backend()));
 
     perfmon_collection_t metadata_perfmon_collection;
     perfmon_membership_t metadata_perfmon_membership(&get_global_perfmon_collection(), &metadata_perfmon_collection, "metadata");
@@ -759,13 +782,17 @@ void run_rethinkdb_serve(const base_path_t &base_path,
 
         *result_out = serve(&io_backender,
                             base_path,
+                            serve_info.index_base_path,
+                            serve_info.archive_base_path,
+                            serve_info.use_shared_table_file,
                             cluster_metadata_file.get(),
                             auth_metadata_file.get(),
                             look_up_peers_addresses(*serve_info.joins),
                             serve_info.ports,
                             serve_info.web_assets,
                             &sigint_cond,
-                            serve_info.config_file);
+                            serve_info.config_file,
+                            serve_info.slow_query_log);
 
     } catch (const metadata_persistence::file_in_use_exc_t &ex) {
         logINF("Directory '%s' is in use by another rethinkdb process.\n", base_path.path().c_str());
@@ -780,13 +807,14 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
                              const name_string_t &machine_name,
                              const file_direct_io_mode_t direct_io_mode,
                              const int max_concurrent_io_requests,
+                             const disk_backend_t disk_backend,
                              const bool new_directory,
                              const serve_info_t &serve_info,
                              directory_lock_t *data_directory_lock,
                              bool *const result_out) {
     if (!new_directory) {
         run_rethinkdb_serve(base_path, serve_info,
-                            direct_io_mode, max_concurrent_io_requests,
+                            direct_io_mode, max_concurrent_io_requests, disk_backend,
                             NULL, NULL, data_directory_lock,
                             result_out);
     } else {
@@ -819,7 +847,7 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
         }
 
         run_rethinkdb_serve(base_path, serve_info,
-                            direct_io_mode, max_concurrent_io_requests,
+                            direct_io_mode, max_concurrent_io_requests, disk_backend,
                             &our_machine_id, &cluster_metadata,
                             data_directory_lock, result_out);
     }
@@ -834,7 +862,8 @@ void run_rethinkdb_proxy(const serve_info_t &serve_info, bool *const result_out)
                                   serve_info.ports,
                                   serve_info.web_assets,
                                   &sigint_cond,
-                                  serve_info.config_file);
+                                  serve_info.config_file,
+                                  serve_info.slow_query_log);
     } catch (const host_lookup_exc_t &ex) {
         logERR("%s\n", ex.what());
         *result_out = false;
@@ -861,6 +890,22 @@ options::help_section_t get_log_options(std::vector<options::option_t> *options_
 }
 
 
+options::help_section_t get_slow_query_log_options(
+        std::vector<options::option_t> *options_out) {
+    options::help_section_t help("Slow query log options");
+    options_out->push_back(options::option_t(options::names_t("--slow-query-threshold"),
+                                             options::OPTIONAL,
+                                             "0"));
+    help.add("--slow-query-threshold ms",
+             "log the queries that take at least this many milliseconds, defaults to "
+             "0 (none)");
+    options_out->push_back(options::option_t(options::names_t("--slow-query-log-file"),
+                                             options::OPTIONAL));
+    help.add("--slow-query-log-file file",
+             "specify the file to log slow queries to, defaults to 'slow_query_log'");
+    return help;
+}
+
 options::help_section_t get_file_options(std::vector<options::option_t> *options_out) {
     options::help_section_t help("File path options");
     options_out->push_back(options::option_t(options::names_t("--directory", "-d"),
@@ -875,6 +920,53 @@ options::help_section_t get_file_options(std::vector<options::option_t> *options
     options_out->push_back(options::option_t(options::names_t("--no-direct-io"),
                                              options::OPTIONAL_NO_PARAMETER));
     help.add("--no-direct-io", "disable direct I/O");
+    options_out->push_back(options::option_t(options::names_t("--io-backend"),
+                                             options::OPTIONAL,
+                                             "auto"));
+    options_out->push_back(options::option_t(options::names_t("--index-directory"),
+                                             options::OPTIONAL));
+    help.add("--index-directory path",
+             "keep the tables' metablocks and block indexes in separate files in this "
+             "directory (which should be on a low-latency device); tables created "
+             "with this option need it every time");
+    options_out->push_back(options::option_t(options::names_t("--archive-directory"),
+                                             options::OPTIONAL));
+    help.add("--archive-directory path",
+             "move the tables' blocks that haven't been written for a long time to "
+             "separate files in this directory (which can be on a larger, slower "
+             "device); tables created with this option need it every time");
+    options_out->push_back(options::option_t(options::names_t("--shared-table-file"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--shared-table-file",
+             "put new tables in one shared data file, so that their writes get "
+             "synced together; tables created with this option need it every time");
+    help.add("--io-backend mode",
+             "how I/O requests get to the kernel: 'io_uring', 'aio' for native AIO, "
+             "'pool' for a pool of threads making blocking calls, or 'auto' to pick "
+             "the first of these that works");
+    options_out->push_back(options::option_t(options::names_t("--cache-huge-pages"),
+                                             options::OPTIONAL,
+                                             "transparent"));
+    help.add("--cache-huge-pages mode",
+             "how block buffers are backed: 'none' for regular pages, 'transparent' "
+             "for transparent huge pages, or 'reserved' for the kernel's reserved "
+             "huge page pool");
+    options_out->push_back(options::option_t(options::names_t("--backfill-latency-target-ms"),
+                                             options::OPTIONAL,
+                                             "0"));
+    help.add("--backfill-latency-target-ms n",
+             "slow down backfills while they take more than n milliseconds to read or "
+             "apply each chunk, to leave the disks to queries (0 never slows them)");
+    options_out->push_back(options::option_t(options::names_t("--auto-reshard"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--auto-reshard",
+             "split the shards of tables that grow too big or take too many writes");
+    options_out->push_back(options::option_t(options::names_t("--fast-failover"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--fast-failover",
+             "let a new primary that is up to date take over while a majority of the "
+             "table's servers can see it, without waiting for lost servers to be "
+             "removed (writes only the lost servers acknowledged can be lost)");
     return help;
 }
 
@@ -948,6 +1040,17 @@ options::help_section_t get_network_options(const bool join_required, std::vecto
                                              options::OPTIONAL_REPEAT));
     help.add("--canonical-address addr", "address that other rethinkdb instances will use to connect to us, can be specified multiple times");
 
+    options_out->push_back(options::option_t(options::names_t("--reuse-port"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--reuse-port", "accept client driver connections on every thread, using "
+             "SO_REUSEPORT (which lets other processes of the same user listen on the "
+             "driver port too)");
+
+    options_out->push_back(options::option_t(options::names_t("--cluster-compression"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--cluster-compression", "compress the larger messages sent to other "
+             "nodes that also use this option");
+
     return help;
 }
 
@@ -957,6 +1060,26 @@ options::help_section_t get_cpu_options(std::vector<options::option_t> *options_
                                              options::OPTIONAL,
                                              strprintf("%d", get_cpu_count())));
     help.add("-c [ --cores ] n", "the number of cores to use");
+    options_out->push_back(options::option_t(options::names_t("--cpu-affinity"),
+                                             options::OPTIONAL));
+    help.add("--cpu-affinity list", "pin the event loop threads to these CPUs, one "
+             "thread per CPU in turn (for example '0-3,8-11')");
+    options_out->push_back(options::option_t(options::names_t("--blocker-cpu-affinity"),
+                                             options::OPTIONAL));
+    help.add("--blocker-cpu-affinity list", "keep the threads that do blocking calls, "
+             "and the external processes, on these CPUs (and the event loop threads "
+             "off them, unless --cpu-affinity is given)");
+    options_out->push_back(options::option_t(options::names_t("--busy-poll-us"),
+                                             options::OPTIONAL,
+                                             "0"));
+    help.add("--busy-poll-us n", "let threads that run out of work poll for new events "
+             "for up to n microseconds before they sleep, trading CPU for latency");
+    options_out->push_back(options::option_t(options::names_t("--js-warm-workers"),
+                                             options::OPTIONAL,
+                                             strprintf("%d",
+                                                       DEFAULT_EXTPROC_WARM_WORKERS)));
+    help.add("--js-warm-workers n", "keep n processes for running JavaScript started "
+             "before any query needs them (at most one per core)");
     return help;
 }
 
@@ -971,6 +1094,52 @@ MUST_USE bool parse_cores_option(const std::map<std::string, options::values_t>
     return true;
 }
 
+MUST_USE bool parse_cpu_affinity_options(const std::map<std::string, options::values_t> &opts) {
+    std::vector<int> event_loop_cpus;
+    const boost::optional<std::string> event_loop_list
+        = get_optional_option(opts, "--cpu-affinity");
+    if (event_loop_list && !parse_cpu_list(*event_loop_list, &event_loop_cpus)) {
+        fprintf(stderr, "ERROR: cpu-affinity must be a list of CPUs that we may run on, "
+                "like '0-3,8-11'\n");
+        return false;
+    }
+
+    std::vector<int> blocker_cpus;
+    const boost::optional<std::string> blocker_list
+        = get_optional_option(opts, "--blocker-cpu-affinity");
+    if (blocker_list && !parse_cpu_list(*blocker_list, &blocker_cpus)) {
+        fprintf(stderr, "ERROR: blocker-cpu-affinity must be a list of CPUs that we may "
+                "run on, like '0-3,8-11'\n");
+        return false;
+    }
+
+    configure_cpu_affinity(event_loop_cpus, blocker_cpus);
+    return true;
+}
+
+MUST_USE bool parse_busy_poll_option(const std::map<std::string, options::values_t> &opts) {
+    const int busy_poll_us = get_single_int(opts, "--busy-poll-us");
+    if (busy_poll_us < 0 || busy_poll_us > MAX_EVENT_QUEUE_BUSY_POLL_US) {
+        fprintf(stderr, "ERROR: busy-poll-us must be between 0 and %d\n",
+                MAX_EVENT_QUEUE_BUSY_POLL_US);
+        return false;
+    }
+    set_event_queue_busy_poll_us(busy_poll_us);
+    return true;
+}
+
+MUST_USE bool parse_js_warm_workers_option(
+        const std::map<std::string, options::values_t> &opts) {
+    const int warm_workers = get_single_int(opts, "--js-warm-workers");
+    if (warm_workers < 0 || warm_workers > MAX_THREADS) {
+        fprintf(stderr, "ERROR: js-warm-workers must be between 0 and %d\n",
+                MAX_THREADS);
+        return false;
+    }
+    set_extproc_warm_workers(warm_workers);
+    return true;
+}
+
 options::help_section_t get_service_options(std::vector<options::option_t> *options_out) {
     options::help_section_t help("Service options");
     options_out->push_back(options::option_t(options::names_t("--pid-file"),
@@ -1025,6 +1194,7 @@ void get_rethinkdb_serve_options(std::vector<options::help_section_t> *help_out,
     help_out->push_back(get_setuser_options(options_out));
     help_out->push_back(get_help_options(options_out));
     help_out->push_back(get_log_options(options_out));
+    help_out->push_back(get_slow_query_log_options(options_out));
     help_out->push_back(get_config_file_options(options_out));
 }
 
@@ -1036,6 +1206,7 @@ void get_rethinkdb_proxy_options(std::vector<options::help_section_t> *help_out,
     help_out->push_back(get_setuser_options(options_out));
     help_out->push_back(get_help_options(options_out));
     help_out->push_back(get_log_options(options_out));
+    help_out->push_back(get_slow_query_log_options(options_out));
     help_out->push_back(get_config_file_options(options_out));
 }
 
@@ -1077,6 +1248,7 @@ void get_rethinkdb_porcelain_options(std::vector<options::help_section_t> *help_
     help_out->push_back(get_setuser_options(options_out));
     help_out->push_back(get_help_options(options_out));
     help_out->push_back(get_log_options(options_out));
+    help_out->push_back(get_slow_query_log_options(options_out));
     help_out->push_back(get_config_file_options(options_out));
 }
 
@@ -1146,6 +1318,96 @@ MUST_USE bool parse_io_threads_option(const std::map<std::string, options::value
     return true;
 }
 
+MUST_USE bool parse_backfill_latency_target_option(
+        const std::map<std::string, options::values_t> &opts) {
+    const int target_ms = get_single_int(opts, "--backfill-latency-target-ms");
+    if (target_ms < 0 || target_ms > MAX_BACKFILL_LATENCY_TARGET_MS) {
+        fprintf(stderr, "ERROR: backfill-latency-target-ms must be between 0 and %d\n",
+                MAX_BACKFILL_LATENCY_TARGET_MS);
+        return false;
+    }
+    set_backfill_latency_target_ms(target_ms);
+    return true;
+}
+
+MUST_USE bool parse_io_backend_option(const std::map<std::string, options::values_t> &opts,
+                                      disk_backend_t *disk_backend_out) {
+    const std::string mode = get_single_option(opts, "--io-backend");
+    if (mode == "auto") {
+        *disk_backend_out = disk_backend_t::automatic;
+    } else if (mode == "io_uring") {
+        *disk_backend_out = disk_backend_t::io_uring;
+    } else if (mode == "aio") {
+        *disk_backend_out = disk_backend_t::native_aio;
+    } else if (mode == "pool") {
+        *disk_backend_out = disk_backend_t::blocker_pool;
+    } else {
+        fprintf(stderr, "ERROR: io-backend must be 'auto', 'io_uring', 'aio', "
+                "or 'pool'\n");
+        return false;
+    }
+    return true;
+}
+
+// Sets *base_path_out to the directory given by `option_name` (--index-directory or
+// --archive-directory), if it's given, and recreates its temporary directory.
+MUST_USE bool parse_directory_option(const std::map<std::string, options::values_t> &opts,
+                                     const std::string &option_name,
+                                     boost::optional<base_path_t> *base_path_out) {
+    const boost::optional<std::string> path = get_optional_option(opts, option_name);
+    if (!path) {
+        *base_path_out = boost::none;
+        return true;
+    }
+    if (path->empty() || access(path->c_str(), R_OK | W_OK | X_OK) != 0) {
+        fprintf(stderr, "ERROR: %s '%s' is not an accessible directory\n",
+                option_name.substr(2).c_str(), path->c_str());
+        return false;
+    }
+    base_path_t base_path(*path);
+    recreate_temporary_directory(base_path);
+    base_path.make_absolute();
+    *base_path_out = base_path;
+    return true;
+}
+
+// Reads the slow query log's options into *config_out.  The log file goes in
+// `dirpath` unless --slow-query-log-file says otherwise.
+MUST_USE bool parse_slow_query_log_options(
+        const std::map<std::string, options::values_t> &opts,
+        const base_path_t &dirpath,
+        slow_query_log_config_t *config_out) {
+    const int threshold_ms = get_single_int(opts, "--slow-query-threshold");
+    if (threshold_ms < 0) {
+        fprintf(stderr, "ERROR: slow-query-threshold must not be negative\n");
+        return false;
+    }
+    config_out->threshold_ms = threshold_ms;
+    if (exists_option(opts, "--slow-query-log-file")) {
+        config_out->filename = get_single_option(opts, "--slow-query-log-file");
+    } else {
+        config_out->filename = dirpath.path() + "/slow_query_log";
+    }
+    return true;
+}
+
+MUST_USE bool parse_huge_pages_option(const std::map<std::string, options::values_t> &opts,
+                                      huge_pages_mode_t *huge_pages_mode_out) {
+    const std::string mode = get_single_option(opts, "--cache-huge-pages");
+    if (mode == "none") {
+        *huge_pages_mode_out = huge_pages_mode_t::none;
+    } else if (mode == "transparent") {
+        *huge_pages_mode_out = huge_pages_mode_t::transparent;
+    } else if (mode == "reserved") {
+        *huge_pages_mode_out = huge_pages_mode_t::reserved;
+    } else {
+        fprintf(stderr, "ERROR: cache-huge-pages must be 'none', 'transparent', "
+                "or 'reserved'\n");
+        return false;
+    }
+    return true;
+}
+
 file_direct_io_mode_t parse_direct_io_mode_option(const std::map<std::string, options::values_t> &opts) {
     return exists_option(opts, "--no-direct-io") ?
         file_direct_io_mode_t::buffered_desired :
@@ -1182,6 +1444,17 @@ int main_rethinkdb_create(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        disk_backend_t disk_backend;
+        if (!parse_io_backend_option(opts, &disk_backend)) {
+            return EXIT_FAILURE;
+        }
+
+        huge_pages_mode_t huge_pages_mode;
+        if (!parse_huge_pages_option(opts, &huge_pages_mode)) {
+            return EXIT_FAILURE;
+        }
+        configure_block_buffer_allocator(huge_pages_mode);
+
         const int num_workers = get_cpu_count();
 
         bool is_new_directory = false;
@@ -1203,6 +1476,7 @@ int main_rethinkdb_create(int argc, char *argv[]) {
                                      machine_name,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     disk_backend,
                                      &result),
                            num_workers);
 
@@ -1288,11 +1562,43 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        if (!parse_cpu_affinity_options(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_busy_poll_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_js_warm_workers_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        set_tcp_listener_reuse_port(exists_option(opts, "--reuse-port"));
+        set_cluster_wire_compression(exists_option(opts, "--cluster-compression"));
+
         int max_concurrent_io_requests;
         if (!parse_io_threads_option(opts, &max_concurrent_io_requests)) {
             return EXIT_FAILURE;
         }
 
+        if (!parse_backfill_latency_target_option(opts)) {
+            return EXIT_FAILURE;
+        }
+        set_auto_reshard_enabled(exists_option(opts, "--auto-reshard"));
+        set_reactor_fast_failover(exists_option(opts, "--fast-failover"));
+
+        disk_backend_t disk_backend;
+        if (!parse_io_backend_option(opts, &disk_backend)) {
+            return EXIT_FAILURE;
+        }
+
+        huge_pages_mode_t huge_pages_mode;
+        if (!parse_huge_pages_option(opts, &huge_pages_mode)) {
+            return EXIT_FAILURE;
+        }
+        configure_block_buffer_allocator(huge_pages_mode);
+
         // Open and lock the directory, but do not create it
         bool is_new_directory = false;
         directory_lock_t data_directory_lock(base_path, false, &is_new_directory);
@@ -1320,6 +1626,19 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
 
         serve_info_t serve_info(joins, address_ports, web_path,
                                 get_optional_option(opts, "--config-file"));
+        if (!parse_directory_option(opts, "--index-directory",
+                                    &serve_info.index_base_path)) {
+            return EXIT_FAILURE;
+        }
+        if (!parse_directory_option(opts, "--archive-directory",
+                                    &serve_info.archive_base_path)) {
+            return EXIT_FAILURE;
+        }
+        serve_info.use_shared_table_file = exists_option(opts, "--shared-table-file");
+        if (!parse_slow_query_log_options(opts, base_path,
+                                          &serve_info.slow_query_log)) {
+            return EXIT_FAILURE;
+        }
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
 
@@ -1328,6 +1647,7 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
                                      serve_info,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     disk_backend,
                                      static_cast<machine_id_t*>(NULL),
                                      static_cast<cluster_semilattice_metadata_t*>(NULL),
                                      &data_directory_lock,
@@ -1420,6 +1740,9 @@ int main_rethinkdb_proxy(int argc, char *argv[]) {
         const std::string web_path = get_web_path(opts, argv);
         const int num_workers = get_cpu_count();
 
+        set_tcp_listener_reuse_port(exists_option(opts, "--reuse-port"));
+        set_cluster_wire_compression(exists_option(opts, "--cluster-compression"));
+
         if (check_pid_file(opts) != EXIT_SUCCESS) {
             return EXIT_FAILURE;
         }
@@ -1437,6 +1760,10 @@ int main_rethinkdb_proxy(int argc, char *argv[]) {
 
         serve_info_t serve_info(joins, address_ports, web_path,
                                 get_optional_option(opts, "--config-file"));
+        if (!parse_slow_query_log_options(opts, base_path,
+                                          &serve_info.slow_query_log)) {
+            return EXIT_FAILURE;
+        }
 
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_proxy, serve_info, &result),
@@ -1544,11 +1871,43 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        if (!parse_cpu_affinity_options(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_busy_poll_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_js_warm_workers_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        set_tcp_listener_reuse_port(exists_option(opts, "--reuse-port"));
+        set_cluster_wire_compression(exists_option(opts, "--cluster-compression"));
+
         int max_concurrent_io_requests;
         if (!parse_io_threads_option(opts, &max_concurrent_io_requests)) {
             return EXIT_FAILURE;
         }
 
+        if (!parse_backfill_latency_target_option(opts)) {
+            return EXIT_FAILURE;
+        }
+        set_auto_reshard_enabled(exists_option(opts, "--auto-reshard"));
+        set_reactor_fast_failover(exists_option(opts, "--fast-failover"));
+
+        disk_backend_t disk_backend;
+        if (!parse_io_backend_option(opts, &disk_backend)) {
+            return EXIT_FAILURE;
+        }
+
+        huge_pages_mode_t huge_pages_mode;
+        if (!parse_huge_pages_option(opts, &huge_pages_mode)) {
+            return EXIT_FAILURE;
+        }
+        configure_block_buffer_allocator(huge_pages_mode);
+
         // Attempt to create the directory early so that the log file can use it.
         // If we create the file, it will be cleaned up unless directory_initialized()
         // is called on it.  This will be done after the metadata files have been created.
@@ -1580,6 +1939,19 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
 
         serve_info_t serve_info(joins, address_ports, web_path,
                                 get_optional_option(opts, "--config-file"));
+        if (!parse_directory_option(opts, "--index-directory",
+                                    &serve_info.index_base_path)) {
+            return EXIT_FAILURE;
+        }
+        if (!parse_directory_option(opts, "--archive-directory",
+                                    &serve_info.archive_base_path)) {
+            return EXIT_FAILURE;
+        }
+        serve_info.use_shared_table_file = exists_option(opts, "--shared-table-file");
+        if (!parse_slow_query_log_options(opts, base_path,
+                                          &serve_info.slow_query_log)) {
+            return EXIT_FAILURE;
+        }
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
 
@@ -1589,6 +1961,7 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
                                      machine_name,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     disk_backend,
                                      is_new_directory,
                                      serve_info,
                                      &data_directory_lock,
@@ -1,6 +1,8 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "clustering/administration/main/file_based_svs_by_namespace.hpp"
 
+#include "arch/runtime/numa.hpp"
+#include "clustering/administration/main/shared_table_file.hpp"
 #include "clustering/immediate_consistency/branch/multistore.hpp"
 #include "clustering/reactor/reactor.hpp"
 #include "serializer/config.hpp"
@@ -15,10 +17,15 @@ template <class protocol_t>
 struct store_args_t {
     store_args_t(io_backender_t *_io_backender, const base_path_t &_base_path,
             namespace_id_t _namespace_id, int64_t _cache_size,
+            alt_memory_arbiter_t *_memory_arbiter,
+            const cache_memory_quota_t &_cache_quota,
+            const std::string &_warm_up_manifest_path,
             perfmon_collection_t *_serializers_perfmon_collection, typename
             protocol_t::context_t *_ctx)
         : io_backender(_io_backender), base_path(_base_path),
           namespace_id(_namespace_id), cache_size(_cache_size),
+          memory_arbiter(_memory_arbiter), cache_quota(_cache_quota),
+          warm_up_manifest_path(_warm_up_manifest_path),
           serializers_perfmon_collection(_serializers_perfmon_collection),
           ctx(_ctx)
     { }
@@ -27,6 +34,10 @@ struct store_args_t {
     base_path_t base_path;
     namespace_id_t namespace_id;
     int64_t cache_size;
+    alt_memory_arbiter_t *memory_arbiter;
+    cache_memory_quota_t cache_quota;
+    // Each store appends its shard number to this.
+    std::string warm_up_manifest_path;
     perfmon_collection_t *serializers_perfmon_collection;
     typename protocol_t::context_t *ctx;
 };
@@ -35,12 +46,17 @@ std::string hash_shard_perfmon_name(int hash_shard_number) {
     return strprintf("shard_%d", hash_shard_number);
 }
 
+std::string warm_up_manifest_path_for_shard(const std::string &base_path,
+                                            int hash_shard_number) {
+    return strprintf("%s.warm_up_%d", base_path.c_str(), hash_shard_number);
+}
+
 template <class protocol_t>
 void do_construct_existing_store(
     const std::vector<threadnum_t> &threads,
     int thread_offset,
     store_args_t<protocol_t> store_args,
-    serializer_multiplexer_t *multiplexer,
+    const std::vector<serializer_t *> *serializers,
     scoped_array_t<scoped_ptr_t<typename protocol_t::store_t> > *stores_out_stores,
     store_view_t<protocol_t> **store_views) {
 
@@ -49,9 +65,13 @@ void do_construct_existing_store(
     on_thread_t th(threads[thread_offset]);
     // TODO: Can we pass serializers_perfmon_collection across threads like this?
     typename protocol_t::store_t *store = new typename protocol_t::store_t(
-        multiplexer->proxies[thread_offset], hash_shard_perfmon_name(thread_offset),
+        (*serializers)[thread_offset], hash_shard_perfmon_name(thread_offset),
         store_args.cache_size, false, store_args.serializers_perfmon_collection,
         store_args.ctx, store_args.io_backender, store_args.base_path);
+    store->set_cache_memory_quota(store_args.memory_arbiter, store_args.cache_quota);
+    store->enable_cache_warm_up_manifest(
+        warm_up_manifest_path_for_shard(store_args.warm_up_manifest_path,
+                                        thread_offset));
     (*stores_out_stores)[thread_offset].init(store);
     store_views[thread_offset] = store;
 }
@@ -61,15 +81,19 @@ void do_create_new_store(
     const std::vector<threadnum_t> &threads,
     int thread_offset,
     store_args_t<protocol_t> store_args,
-    serializer_multiplexer_t *multiplexer,
+    const std::vector<serializer_t *> *serializers,
     scoped_array_t<scoped_ptr_t<typename protocol_t::store_t> > *stores_out_stores,
     store_view_t<protocol_t> **store_views) {
 
     on_thread_t th(threads[thread_offset]);
     typename protocol_t::store_t *store = new typename protocol_t::store_t(
-        multiplexer->proxies[thread_offset], hash_shard_perfmon_name(thread_offset),
+        (*serializers)[thread_offset], hash_shard_perfmon_name(thread_offset),
         store_args.cache_size, true, store_args.serializers_perfmon_collection,
         store_args.ctx, store_args.io_backender, store_args.base_path);
+    store->set_cache_memory_quota(store_args.memory_arbiter, store_args.cache_quota);
+    store->enable_cache_warm_up_manifest(
+        warm_up_manifest_path_for_shard(store_args.warm_up_manifest_path,
+                                        thread_offset));
     (*stores_out_stores)[thread_offset].init(store);
     store_views[thread_offset] = store;
 }
@@ -80,6 +104,9 @@ file_based_svs_by_namespace_t<protocol_t>::get_svs(
             perfmon_collection_t *serializers_perfmon_collection,
             namespace_id_t namespace_id,
             int64_t cache_size,
+            const cache_memory_quota_t &cache_quota,
+            int64_t block_size,
+            int hash_shards,
             stores_lifetimer_t<protocol_t> *stores_out,
             scoped_ptr_t<multistore_ptr_t<protocol_t> > *svs_out,
             typename protocol_t::context_t *ctx) {
@@ -95,15 +122,29 @@ file_based_svs_by_namespace_t<protocol_t>::get_svs(
     // TODO: We should use N slices on M serializers, not N slices
     // on N serializers.
 
-    const int num_stores = CPU_SHARDING_FACTOR;
+    guarantee(hash_shards > 0 && hash_shards <= MAX_HASH_SHARDS);
     scoped_array_t<scoped_ptr_t<typename protocol_t::store_t> > *stores_out_stores
         = stores_out->stores();
-    stores_out_stores->init(num_stores);
 
+    const threadnum_t calling_thread = get_thread_id();
     const threadnum_t serializer_thread = next_thread(num_db_threads);
-    std::vector<threadnum_t> store_threads;
-    for (int i = 0; i < num_stores; ++i) {
-        store_threads.push_back(next_thread(num_db_threads));
+
+    const serializer_filepath_t serializer_filepath = file_name_for(namespace_id);
+
+    // With a shared table file, new tables go in it if they can.  Tables that
+    // already have a file of their own keep using it.
+    std::vector<int32_t> shared_slots;
+    bool create_in_shared_file = false;
+    if (shared_table_file_ != NULL) {
+        shared_slots = shared_table_file_->table_slots(namespace_id);
+        if (shared_slots.empty()
+            && access(serializer_filepath.permanent_path().c_str(), F_OK) != 0
+            && block_size
+               == static_cast<int64_t>(shared_table_file_->block_size().ser_value())
+            && shared_table_file_->reserve_slots(namespace_id, hash_shards,
+                                                 &shared_slots)) {
+            create_in_shared_file = true;
+        }
     }
 
     scoped_ptr_t<serializer_t> serializer;
@@ -111,60 +152,86 @@ file_based_svs_by_namespace_t<protocol_t>::get_svs(
     scoped_ptr_t<multistore_ptr_t<protocol_t> > mptr;
     {
         on_thread_t th(serializer_thread);
-        scoped_array_t<store_view_t<protocol_t> *> store_views(num_stores);
 
-        const serializer_filepath_t serializer_filepath = file_name_for(namespace_id);
-        int res = access(serializer_filepath.permanent_path().c_str(), R_OK | W_OK);
-        store_args_t<protocol_t> store_args(io_backender_, base_path_,
-                                            namespace_id, cache_size / num_stores,
-                                            serializers_perfmon_collection, ctx);
+        // The serializers that the stores go in.
+        std::vector<serializer_t *> store_serializers;
+        bool create;
         filepath_file_opener_t file_opener(serializer_filepath, io_backender_);
-        if (res == 0) {
+        if (!shared_slots.empty()) {
+            for (auto it = shared_slots.begin(); it != shared_slots.end(); ++it) {
+                store_serializers.push_back(shared_table_file_->slot_serializer(*it));
+            }
+            create = create_in_shared_file;
+        } else if (access(serializer_filepath.permanent_path().c_str(),
+                          R_OK | W_OK) == 0) {
             // TODO: Could we handle failure when loading the serializer?  Right
             // now, we don't.
+            scoped_ptr_t<serializer_t> ser
+                = make_scoped<standard_serializer_t>(
+                    standard_serializer_t::dynamic_config_t(),
+                    &file_opener,
+                    serializers_perfmon_collection);
+            ser = make_scoped<merger_serializer_t>(std::move(ser),
+                                                   MERGER_SERIALIZER_MAX_ACTIVE_WRITES);
+            serializer = std::move(ser);
 
-            {
-                scoped_ptr_t<serializer_t> ser
-                    = make_scoped<standard_serializer_t>(
-                        standard_serializer_t::dynamic_config_t(),
-                        &file_opener,
-                        serializers_perfmon_collection);
-                ser = make_scoped<merger_serializer_t>(std::move(ser),
-                                                       MERGER_SERIALIZER_MAX_ACTIVE_WRITES);
-                serializer = std::move(ser);
-            }
+            std::vector<serializer_t *> ptrs;
+            ptrs.push_back(serializer.get());
+            multiplexer.init(new serializer_multiplexer_t(ptrs));
+            create = false;
+        } else {
+            standard_serializer_t::create(&file_opener,
+                                          standard_serializer_t::static_config_t(block_size));
+            scoped_ptr_t<serializer_t> ser
+                = make_scoped<standard_serializer_t>(
+                    standard_serializer_t::dynamic_config_t(),
+                    &file_opener,
+                    serializers_perfmon_collection);
+            ser = make_scoped<merger_serializer_t>(std::move(ser),
+                                                   MERGER_SERIALIZER_MAX_ACTIVE_WRITES);
+            serializer = std::move(ser);
 
             std::vector<serializer_t *> ptrs;
             ptrs.push_back(serializer.get());
+            serializer_multiplexer_t::create(ptrs, hash_shards);
             multiplexer.init(new serializer_multiplexer_t(ptrs));
+            create = true;
+        }
+        if (multiplexer.has()) {
+            store_serializers.assign(multiplexer->proxies.begin(),
+                                     multiplexer->proxies.end());
+        }
+
+        // A table that already exists keeps the number of stores it was created
+        // with, whatever the table's metadata says now.
+        const int num_stores = store_serializers.size();
+        stores_out_stores->init(num_stores);
+        scoped_array_t<store_view_t<protocol_t> *> store_views(num_stores);
+        std::vector<threadnum_t> store_threads;
+        {
+            // The thread counters belong to the calling thread.
+            on_thread_t th2(calling_thread);
+            store_threads = pick_store_threads(num_db_threads, num_stores);
+        }
 
+        store_args_t<protocol_t> store_args(io_backender_, base_path_,
+                                            namespace_id, cache_size / num_stores,
+                                            memory_arbiter_,
+                                            cache_memory_quota_t(
+                                                cache_quota.floor / num_stores,
+                                                cache_quota.ceiling / num_stores),
+                                            serializer_filepath.permanent_path(),
+                                            serializers_perfmon_collection, ctx);
+        if (!create) {
             // TODO: Exceptions?  Can exceptions happen, and then
             // store_views' values would leak.  That is, are we handling
             // them in the pmap?  No.
             pmap(num_stores, boost::bind(do_construct_existing_store<protocol_t>,
                                          store_threads, _1, store_args,
-                                         multiplexer.get(),
+                                         &store_serializers,
                                          stores_out_stores, store_views.data()));
             mptr.init(new multistore_ptr_t<protocol_t>(store_views.data(), num_stores));
         } else {
-            standard_serializer_t::create(&file_opener,
-                                          standard_serializer_t::static_config_t());
-            {
-                scoped_ptr_t<serializer_t> ser
-                    = make_scoped<standard_serializer_t>(
-                        standard_serializer_t::dynamic_config_t(),
-                        &file_opener,
-                        serializers_perfmon_collection);
-                ser = make_scoped<merger_serializer_t>(std::move(ser),
-                                                       MERGER_SERIALIZER_MAX_ACTIVE_WRITES);
-                serializer = std::move(ser);
-            }
-
-            std::vector<serializer_t *> ptrs;
-            ptrs.push_back(serializer.get());
-            serializer_multiplexer_t::create(ptrs, num_stores);
-            multiplexer.init(new serializer_multiplexer_t(ptrs));
-
             // TODO: How do we specify what the stores' regions are?
             // TODO: Exceptions?  Can exceptions happen, and then store_views'
             // values would leak.
@@ -172,7 +239,7 @@ file_based_svs_by_namespace_t<protocol_t>::get_svs(
             // TODO: This should use pmap.
             pmap(num_stores, boost::bind(do_create_new_store<protocol_t>,
                                          store_threads, _1, store_args,
-                                         multiplexer.get(),
+                                         &store_serializers,
                                          stores_out_stores, store_views.data()));
             mptr.init(new multistore_ptr_t<protocol_t>(store_views.data(), num_stores));
 
@@ -191,10 +258,16 @@ file_based_svs_by_namespace_t<protocol_t>::get_svs(
                 &dummy_interruptor);
 
             // Finally, the store is created.
-            file_opener.move_serializer_file_to_permanent_location();
+            if (!create_in_shared_file) {
+                file_opener.move_serializer_file_to_permanent_location();
+            }
         }
     } // back on calling thread
 
+    if (create_in_shared_file) {
+        shared_table_file_->commit_table(namespace_id);
+    }
+
     svs_out->init(mptr.release());
     stores_out->serializer()->init(serializer.release());
     stores_out->multiplexer()->init(multiplexer.release());
@@ -202,17 +275,52 @@ file_based_svs_by_namespace_t<protocol_t>::get_svs(
 
 template<class protocol_t>
 void file_based_svs_by_namespace_t<protocol_t>::destroy_svs(namespace_id_t namespace_id) {
+    if (shared_table_file_ != NULL) {
+        shared_table_file_->destroy_table(namespace_id);
+    }
+
     // TODO: Handle errors?  It seems like we can't really handle the error so
     // let's just ignore it?
-    const std::string filepath = file_name_for(namespace_id).permanent_path();
+    const serializer_filepath_t serializer_filepath = file_name_for(namespace_id);
+    const std::string filepath = serializer_filepath.permanent_path();
     const int res = ::unlink(filepath.c_str());
     guarantee_err(res == 0 || get_errno() == ENOENT,
                   "unlink failed for file %s", filepath.c_str());
+
+    // Tables that were created without an index file don't have one, of course.
+    if (serializer_filepath.has_index_file()) {
+        const std::string index_filepath = serializer_filepath.index_permanent_path();
+        const int index_res = ::unlink(index_filepath.c_str());
+        guarantee_err(index_res == 0 || get_errno() == ENOENT,
+                      "unlink failed for file %s", index_filepath.c_str());
+    }
+
+    // The cache warm-up manifests are only hints, so we don't care whether they
+    // existed.  We don't know how many stores the table had, so try all of them.
+    for (int i = 0; i < MAX_HASH_SHARDS; ++i) {
+        const std::string manifest_path = warm_up_manifest_path_for_shard(filepath, i);
+        ::unlink(manifest_path.c_str());
+    }
+}
+
+template<class protocol_t>
+bool file_based_svs_by_namespace_t<protocol_t>::has_svs(namespace_id_t namespace_id) {
+    if (shared_table_file_ != NULL
+        && !shared_table_file_->table_slots(namespace_id).empty()) {
+        return true;
+    }
+    return access(file_name_for(namespace_id).permanent_path().c_str(), F_OK) == 0;
 }
 
 template<class protocol_t>
 serializer_filepath_t file_based_svs_by_namespace_t<protocol_t>::file_name_for(namespace_id_t namespace_id) {
-    return serializer_filepath_t(base_path_, uuid_to_str(namespace_id));
+    serializer_filepath_t filepath = index_base_path_
+        ? serializer_filepath_t(base_path_, *index_base_path_, uuid_to_str(namespace_id))
+        : serializer_filepath_t(base_path_, uuid_to_str(namespace_id));
+    if (archive_base_path_) {
+        filepath.set_archive_directory(*archive_base_path_);
+    }
+    return filepath;
 }
 
 template<class protocol_t>
@@ -221,6 +329,46 @@ threadnum_t file_based_svs_by_namespace_t<protocol_t>::next_thread(int num_db_th
     return threadnum_t(thread_counter_);
 }
 
+template<class protocol_t>
+std::vector<threadnum_t>
+file_based_svs_by_namespace_t<protocol_t>::pick_store_threads(int num_db_threads,
+                                                              int num_stores) {
+    // The db threads of each NUMA node (by the order in which the nodes first show
+    // up).  Since the thread pool pins threads to CPUs that alternate between nodes
+    // (see get_cpu_for_thread), every node gets some, as long as there are enough
+    // threads.
+    std::vector<std::vector<threadnum_t> > threads_by_node;
+    std::vector<int> node_ids;
+    for (int i = 0; i < num_db_threads; ++i) {
+        const int node = get_numa_node_for_thread(i);
+        size_t n = 0;
+        while (n < node_ids.size() && node_ids[n] != node) {
+            ++n;
+        }
+        if (n == node_ids.size()) {
+            node_ids.push_back(node);
+            threads_by_node.push_back(std::vector<threadnum_t>());
+        }
+        threads_by_node[n].push_back(threadnum_t(i));
+    }
+
+    const int num_nodes = threads_by_node.size();
+    if (numa_node_thread_counters_.size() < threads_by_node.size()) {
+        numa_node_thread_counters_.resize(threads_by_node.size(), 0);
+    }
+
+    std::vector<threadnum_t> store_threads;
+    for (int i = 0; i < num_stores; ++i) {
+        const int n = (numa_node_counter_ + i) % num_nodes;
+        const std::vector<threadnum_t> &node_threads = threads_by_node[n];
+        numa_node_thread_counters_[n]
+            = (numa_node_thread_counters_[n] + 1) % node_threads.size();
+        store_threads.push_back(node_threads[numa_node_thread_counters_[n]]);
+    }
+    numa_node_counter_ = (numa_node_counter_ + 1) % num_nodes;
+    return store_threads;
+}
+
 #include "mock/dummy_protocol.hpp"
 template class file_based_svs_by_namespace_t<mock::dummy_protocol_t>;
 
@@ -3,34 +3,71 @@
 #define CLUSTERING_ADMINISTRATION_MAIN_FILE_BASED_SVS_BY_NAMESPACE_HPP_
 
 #include <string>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/optional.hpp>
 
 #include "clustering/administration/reactor_driver.hpp"
 
+class shared_table_file_t;
+
 template <class protocol_t>
 class file_based_svs_by_namespace_t : public svs_by_namespace_t<protocol_t> {
 public:
+    // New tables get index files in index_base_path and archive files in
+    // archive_base_path, if they're set.  If shared_table_file isn't NULL, new
+    // tables go in it when there's room.
     file_based_svs_by_namespace_t(io_backender_t *io_backender,
-                                  const base_path_t& base_path)
-        : io_backender_(io_backender), base_path_(base_path), thread_counter_(0) { }
+                                  alt_memory_arbiter_t *memory_arbiter,
+                                  const base_path_t& base_path,
+                                  const boost::optional<base_path_t> &index_base_path
+                                      = boost::none,
+                                  const boost::optional<base_path_t> &archive_base_path
+                                      = boost::none,
+                                  shared_table_file_t *shared_table_file = NULL)
+        : io_backender_(io_backender), memory_arbiter_(memory_arbiter),
+          base_path_(base_path), index_base_path_(index_base_path),
+          archive_base_path_(archive_base_path),
+          shared_table_file_(shared_table_file),
+          thread_counter_(0), numa_node_counter_(0) { }
 
     void get_svs(perfmon_collection_t *serializers_perfmon_collection,
                  namespace_id_t namespace_id,
                  int64_t cache_size,
+                 const cache_memory_quota_t &cache_quota,
+                 int64_t block_size,
+                 int hash_shards,
                  stores_lifetimer_t<protocol_t> *stores_out,
                  scoped_ptr_t<multistore_ptr_t<protocol_t> > *svs_out,
                  typename protocol_t::context_t *);
 
     void destroy_svs(namespace_id_t namespace_id);
 
+    bool has_svs(namespace_id_t namespace_id);
+
     serializer_filepath_t file_name_for(namespace_id_t namespace_id);
 
 private:
     io_backender_t *io_backender_;
+    alt_memory_arbiter_t *memory_arbiter_;
     const base_path_t base_path_;
+    const boost::optional<base_path_t> index_base_path_;
+    const boost::optional<base_path_t> archive_base_path_;
+    shared_table_file_t *const shared_table_file_;
 
     threadnum_t next_thread(int num_db_threads);
     int thread_counter_; // should only be used by `next_thread`
 
+    // Picks the threads for a table's CPU shards.  The shards are dealt out to the
+    // NUMA nodes in turn (starting with a different node for each table), and each
+    // node hands out its own threads round-robin.  That way each table is spread
+    // over all the sockets, and so are the shards of all tables together.
+    std::vector<threadnum_t> pick_store_threads(int num_db_threads, int num_stores);
+    // These should only be used by `pick_store_threads`.
+    int numa_node_counter_;
+    std::vector<int> numa_node_thread_counters_;
+
     DISABLE_COPYING(file_based_svs_by_namespace_t);
 };
 
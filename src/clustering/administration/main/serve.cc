@@ -6,6 +6,7 @@
 #include "arch/arch.hpp"
 #include "arch/os_signal.hpp"
 #include "clustering/administration/admin_tracker.hpp"
+#include "clustering/administration/auto_resharder.hpp"
 #include "clustering/administration/auto_reconnect.hpp"
 #include "clustering/administration/http/server.hpp"
 #include "clustering/administration/issues/local.hpp"
@@ -13,6 +14,7 @@
 #include "clustering/administration/main/file_based_svs_by_namespace.hpp"
 #include "clustering/administration/main/initial_join.hpp"
 #include "clustering/administration/main/ports.hpp"
+#include "clustering/administration/main/shared_table_file.hpp"
 #include "clustering/administration/main/watchable_fields.hpp"
 #include "containers/incremental_lenses.hpp"
 #include "clustering/administration/metadata.hpp"
@@ -30,6 +32,7 @@
 #include "mock/dummy_protocol_parser.hpp"
 #include "rdb_protocol/pb_server.hpp"
 #include "rdb_protocol/protocol.hpp"
+#include "rdb_protocol/slow_query_log.hpp"
 #include "rpc/connectivity/cluster.hpp"
 #include "rpc/connectivity/multiplexer.hpp"
 #include "rpc/connectivity/heartbeat.hpp"
@@ -66,13 +69,17 @@ bool do_serve(
     bool i_am_a_server,
     // NB. filepath & persistent_file are used iff i_am_a_server is true.
     const base_path_t &base_path,
+    const boost::optional<base_path_t> &index_base_path,
+    const boost::optional<base_path_t> &archive_base_path,
+    bool use_shared_table_file,
     metadata_persistence::cluster_persistent_file_t *cluster_metadata_file,
     metadata_persistence::auth_persistent_file_t *auth_metadata_file,
     const peer_address_set_t &joins,
     service_address_ports_t address_ports,
     std::string web_assets,
     os_signal_cond_t *stop_cond,
-    const boost::optional<std::string> &config_file) {
+    const boost::optional<std::string> &config_file,
+    const slow_query_log_config_t &slow_query_log_config) {
     try {
         extproc_pool_t extproc_pool(get_num_threads());
 
@@ -98,7 +105,7 @@ bool do_serve(
         connectivity_cluster_t connectivity_cluster;
         message_multiplexer_t message_multiplexer(&connectivity_cluster);
 
-        message_multiplexer_t::client_t heartbeat_manager_client(&message_multiplexer, 'H', SEMAPHORE_NO_LIMIT);
+        message_multiplexer_t::client_t heartbeat_manager_client(&message_multiplexer, 'H', message_priority_t::CONTROL, SEMAPHORE_NO_LIMIT);
         heartbeat_manager_t heartbeat_manager(&heartbeat_manager_client);
         message_multiplexer_t::client_t::run_t heartbeat_manager_client_run(&heartbeat_manager_client, &heartbeat_manager);
 
@@ -254,10 +261,43 @@ bool do_serve(
 
         //This is an annoying chicken and egg problem here
         rdb_ctx.ns_repo = &rdb_namespace_repo;
+        rdb_ctx.mailbox_manager = &mailbox_manager;
+
+        scoped_ptr_t<slow_query_log_t> slow_query_log;
+        if (slow_query_log_config.threshold_ms > 0) {
+            slow_query_log.init(new slow_query_log_t(slow_query_log_config));
+            rdb_ctx.slow_query_log = slow_query_log.get();
+        }
+
+        if (i_am_a_server) {
+            rdb_ctx.io_backender = io_backender;
+            rdb_ctx.temp_path = base_path;
+        }
+
+        // Splits the rdb tables' hot shards, if `--auto-reshard` asked for that.
+        scoped_ptr_t<auto_resharder_t> auto_resharder;
+        if (i_am_a_server) {
+            auto_resharder.init(new auto_resharder_t(machine_id,
+                                                     semilattice_manager_cluster.get_root_view(),
+                                                     directory_read_manager.get_root_view(),
+                                                     &rdb_namespace_repo));
+        }
 
         {
             // Reactor drivers
 
+            // Moves cache memory between the tables' stores, within each table's
+            // cache size floor and ceiling.
+            alt_memory_arbiter_t cache_memory_arbiter;
+
+            // Holds the tables of all the protocols, so it has to outlive their
+            // svs sources.
+            scoped_ptr_t<shared_table_file_t> shared_table_file;
+            if (i_am_a_server && use_shared_table_file) {
+                shared_table_file.init(new shared_table_file_t(
+                    io_backender, base_path, index_base_path));
+            }
+
             // Dummy
             scoped_ptr_t<file_based_svs_by_namespace_t<mock::dummy_protocol_t> > dummy_svs_source;
             scoped_ptr_t<reactor_driver_t<mock::dummy_protocol_t> > dummy_reactor_driver;
@@ -266,7 +306,8 @@ bool do_serve(
 
             if (i_am_a_server) {
                 dummy_svs_source.init(new file_based_svs_by_namespace_t<mock::dummy_protocol_t>(
-                    io_backender, base_path));
+                    io_backender, &cache_memory_arbiter, base_path, index_base_path,
+                    archive_base_path, shared_table_file.get()));
                 dummy_reactor_driver.init(new reactor_driver_t<mock::dummy_protocol_t>(
                     base_path,
                     io_backender,
@@ -299,7 +340,8 @@ bool do_serve(
 
             if (i_am_a_server) {
                 memcached_svs_source.init(new file_based_svs_by_namespace_t<memcached_protocol_t>(
-                    io_backender, base_path));
+                    io_backender, &cache_memory_arbiter, base_path, index_base_path,
+                    archive_base_path, shared_table_file.get()));
                 memcached_reactor_driver.init(new reactor_driver_t<memcached_protocol_t>(
                     base_path,
                     io_backender,
@@ -332,7 +374,8 @@ bool do_serve(
 
             if (i_am_a_server) {
                 rdb_svs_source.init(new file_based_svs_by_namespace_t<rdb_protocol_t>(
-                    io_backender, base_path));
+                    io_backender, &cache_memory_arbiter, base_path, index_base_path,
+                    archive_base_path, shared_table_file.get()));
                 rdb_reactor_driver.init(new reactor_driver_t<rdb_protocol_t>(
                         base_path,
                         io_backender,
@@ -479,40 +522,53 @@ bool do_serve(
 
 bool serve(io_backender_t *io_backender,
            const base_path_t &base_path,
+           const boost::optional<base_path_t> &index_base_path,
+           const boost::optional<base_path_t> &archive_base_path,
+           bool use_shared_table_file,
            metadata_persistence::cluster_persistent_file_t *cluster_persistent_file,
            metadata_persistence::auth_persistent_file_t *auth_persistent_file,
            const peer_address_set_t &joins,
            service_address_ports_t address_ports,
            std::string web_assets,
            os_signal_cond_t *stop_cond,
-           const boost::optional<std::string>& config_file) {
+           const boost::optional<std::string>& config_file,
+           const slow_query_log_config_t &slow_query_log_config) {
     return do_serve(io_backender,
                     true,
                     base_path,
+                    index_base_path,
+                    archive_base_path,
+                    use_shared_table_file,
                     cluster_persistent_file,
                     auth_persistent_file,
                     joins,
                     address_ports,
                     web_assets,
                     stop_cond,
-                    config_file);
+                    config_file,
+                    slow_query_log_config);
 }
 
 bool serve_proxy(const peer_address_set_t &joins,
                  service_address_ports_t address_ports,
                  std::string web_assets,
                  os_signal_cond_t *stop_cond,
-                 const boost::optional<std::string>& config_file) {
+                 const boost::optional<std::string>& config_file,
+                 const slow_query_log_config_t &slow_query_log_config) {
     // TODO: filepath doesn't _seem_ ignored.
     // filepath and persistent_file are ignored for proxies, so we use the empty string & NULL respectively.
     return do_serve(NULL,
                     false,
                     base_path_t(""),
+                    boost::none,
+                    boost::none,
+                    false,
                     NULL,
                     NULL,
                     joins,
                     address_ports,
                     web_assets,
                     stop_cond,
-                    config_file);
+                    config_file,
+                    slow_query_log_config);
 }
@@ -10,6 +10,7 @@
 #include "arch/address.hpp"
 
 class os_signal_cond_t;
+class slow_query_log_config_t;
 
 class invalid_port_exc_t : public std::exception {
 public:
@@ -85,20 +86,29 @@ struct service_address_ports_t {
 /* This has been factored out from `command_line.hpp` because it takes a very
 long time to compile. */
 
+// index_base_path is where the tables' index files go, if they are to have any, and
+// archive_base_path the same for their archive files.
+// With use_shared_table_file, new tables go in one shared file (see
+// shared_table_file_t).
 bool serve(io_backender_t *io_backender,
            const base_path_t &base_path,
+           const boost::optional<base_path_t> &index_base_path,
+           const boost::optional<base_path_t> &archive_base_path,
+           bool use_shared_table_file,
            metadata_persistence::cluster_persistent_file_t *cluster_persistent_file,
            metadata_persistence::auth_persistent_file_t *auth_persistent_file,
            const peer_address_set_t &joins,
            service_address_ports_t ports,
            std::string web_assets,
            os_signal_cond_t *stop_cond,
-           const boost::optional<std::string>& config_file);
+           const boost::optional<std::string>& config_file,
+           const slow_query_log_config_t &slow_query_log_config);
 
 bool serve_proxy(const peer_address_set_t &joins,
                  service_address_ports_t ports,
                  std::string web_assets,
                  os_signal_cond_t *stop_cond,
-                 const boost::optional<std::string>& config_file);
+                 const boost::optional<std::string>& config_file,
+                 const slow_query_log_config_t &slow_query_log_config);
 
 #endif /* CLUSTERING_ADMINISTRATION_MAIN_SERVE_HPP_ */
@@ -0,0 +1,244 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/administration/main/shared_table_file.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <functional>
+
+#include "arch/io/io_utils.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "config/args.hpp"
+#include "containers/archive/stl_types.hpp"
+#include "containers/archive/string_stream.hpp"
+#include "containers/archive/vector_stream.hpp"
+#include "serializer/config.hpp"
+#include "serializer/merger.hpp"
+#include "serializer/translator.hpp"
+
+shared_table_file_t::shared_table_file_t(
+        io_backender_t *io_backender,
+        const base_path_t &base_path,
+        const boost::optional<base_path_t> &index_base_path)
+    : directory_path_(base_path.path() + "/shared_tables.directory"),
+      perfmon_membership_(&get_global_perfmon_collection(), &perfmon_collection_,
+                          "shared_table_file") {
+    const serializer_filepath_t filepath = index_base_path
+        ? serializer_filepath_t(base_path, *index_base_path, "shared_tables")
+        : serializer_filepath_t(base_path, "shared_tables");
+    filepath_file_opener_t file_opener(filepath, io_backender);
+    const bool exists = access(filepath.permanent_path().c_str(), R_OK | W_OK) == 0;
+    if (!exists) {
+        standard_serializer_t::create(
+            &file_opener,
+            standard_serializer_t::static_config_t(DEFAULT_BTREE_BLOCK_SIZE));
+    }
+    scoped_ptr_t<serializer_t> ser
+        = make_scoped<standard_serializer_t>(standard_serializer_t::dynamic_config_t(),
+                                             &file_opener,
+                                             &perfmon_collection_);
+    ser = make_scoped<merger_serializer_t>(std::move(ser),
+                                           MERGER_SERIALIZER_MAX_ACTIVE_WRITES);
+    serializer_ = std::move(ser);
+
+    std::vector<serializer_t *> ptrs;
+    ptrs.push_back(serializer_.get());
+    if (!exists) {
+        serializer_multiplexer_t::create(ptrs, SHARED_TABLE_FILE_SLOTS);
+        file_opener.move_serializer_file_to_permanent_location();
+    }
+    multiplexer_.init(new serializer_multiplexer_t(ptrs));
+    // A file created with a different SHARED_TABLE_FILE_SLOTS keeps its own count.
+    slot_taken_.resize(multiplexer_->proxies.size(), false);
+
+    bool ok;
+    thread_pool_t::run_in_blocker_pool(
+        std::bind(&shared_table_file_t::read_directory_blocking,
+                  std::cref(directory_path_), &directory_, &ok));
+    if (!ok) {
+        fail_due_to_user_error("The shared table directory \"%s\" is corrupted.",
+                               directory_path_.c_str());
+    }
+    for (auto it = directory_.begin(); it != directory_.end(); ++it) {
+        for (auto slot = it->second.begin(); slot != it->second.end(); ++slot) {
+            guarantee(*slot >= 0 && static_cast<size_t>(*slot) < slot_taken_.size());
+            guarantee(!slot_taken_[*slot]);
+            slot_taken_[*slot] = true;
+        }
+    }
+}
+
+shared_table_file_t::~shared_table_file_t() {
+    assert_thread();
+    multiplexer_.reset();
+    serializer_.reset();
+}
+
+block_size_t shared_table_file_t::block_size() const {
+    return serializer_->max_block_size();
+}
+
+std::vector<int32_t> shared_table_file_t::table_slots(namespace_id_t namespace_id) const {
+    assert_thread();
+    auto it = directory_.find(namespace_id);
+    return it == directory_.end() ? std::vector<int32_t>() : it->second;
+}
+
+bool shared_table_file_t::reserve_slots(namespace_id_t namespace_id, int count,
+                                        std::vector<int32_t> *slots_out) {
+    assert_thread();
+    guarantee(directory_.count(namespace_id) == 0);
+    guarantee(reserved_.count(namespace_id) == 0);
+
+    std::vector<int32_t> slots;
+    for (size_t i = 0; i < slot_taken_.size() && slots.size() < static_cast<size_t>(count); ++i) {
+        if (!slot_taken_[i]) {
+            slots.push_back(i);
+        }
+    }
+    if (slots.size() < static_cast<size_t>(count)) {
+        return false;
+    }
+    for (auto it = slots.begin(); it != slots.end(); ++it) {
+        slot_taken_[*it] = true;
+    }
+    reserved_[namespace_id] = slots;
+
+    // The slots are ours now, so nobody else can hand them out while we clear out
+    // whatever an interrupted create or destroy left behind.
+    for (auto it = slots.begin(); it != slots.end(); ++it) {
+        clear_slot(*it);
+    }
+    *slots_out = std::move(slots);
+    return true;
+}
+
+void shared_table_file_t::commit_table(namespace_id_t namespace_id) {
+    assert_thread();
+    auto it = reserved_.find(namespace_id);
+    guarantee(it != reserved_.end());
+    directory_[namespace_id] = it->second;
+    reserved_.erase(it);
+    save_directory();
+}
+
+void shared_table_file_t::destroy_table(namespace_id_t namespace_id) {
+    assert_thread();
+    std::vector<int32_t> slots;
+    auto reserved_it = reserved_.find(namespace_id);
+    if (reserved_it != reserved_.end()) {
+        slots = reserved_it->second;
+        reserved_.erase(reserved_it);
+    } else {
+        auto it = directory_.find(namespace_id);
+        if (it == directory_.end()) {
+            return;
+        }
+        slots = it->second;
+        directory_.erase(it);
+        // The table is gone once it's out of the directory, whether or not we get
+        // to delete its blocks.
+        save_directory();
+    }
+
+    for (auto it = slots.begin(); it != slots.end(); ++it) {
+        clear_slot(*it);
+        slot_taken_[*it] = false;
+    }
+}
+
+serializer_t *shared_table_file_t::slot_serializer(int32_t slot) {
+    guarantee(slot >= 0 && static_cast<size_t>(slot) < multiplexer_->proxies.size());
+    return multiplexer_->proxies[slot];
+}
+
+void shared_table_file_t::save_directory() {
+    assert_thread();
+    mutex_t::acq_t acq(&save_mutex_);
+
+    // We save whatever the directory is once we get the mutex, which includes the
+    // changes of anybody who was waiting along with us.
+    write_message_t wm;
+    wm << directory_;
+    vector_stream_t stream;
+    stream.reserve(wm.size());
+    int res = send_write_message(&stream, &wm);
+    guarantee(res == 0);
+
+    bool ok;
+    thread_pool_t::run_in_blocker_pool(
+        std::bind(&shared_table_file_t::write_directory_blocking,
+                  std::cref(directory_path_), &stream.vector(), &ok));
+    guarantee(ok, "Could not write the shared table directory \"%s\".",
+              directory_path_.c_str());
+}
+
+void shared_table_file_t::clear_slot(int32_t slot) {
+    serializer_t *proxy = slot_serializer(slot);
+    on_thread_t th(proxy->home_thread());
+    std::vector<index_write_op_t> ops;
+    for (block_id_t id = 0, e = proxy->max_block_id(); id < e; ++id) {
+        if (!proxy->get_delete_bit(id)) {
+            ops.push_back(index_write_op_t(id, counted_t<standard_block_token_t>()));
+        }
+    }
+    if (!ops.empty()) {
+        proxy->index_write(ops, DEFAULT_DISK_ACCOUNT);
+    }
+}
+
+void shared_table_file_t::read_directory_blocking(const std::string &path,
+                                                  directory_t *directory_out,
+                                                  bool *ok_out) {
+    std::string contents;
+    if (!blocking_read_file(path.c_str(), &contents)) {
+        // No table has been committed yet.
+        *ok_out = true;
+        return;
+    }
+
+    string_read_stream_t stream(std::move(contents), 0);
+    archive_result_t res = deserialize(&stream, directory_out);
+    *ok_out = !bad(res);
+}
+
+void shared_table_file_t::write_directory_blocking(const std::string &path,
+                                                   const std::vector<char> *data,
+                                                   bool *ok_out) {
+    *ok_out = false;
+    const std::string temporary_path = path + ".tmp";
+
+    {
+        scoped_fd_t fd;
+        int res;
+        do {
+            res = ::open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        } while (res == -1 && get_errno() == EINTR);
+        if (res == -1) {
+            return;
+        }
+        fd.reset(res);
+
+        size_t written = 0;
+        while (written < data->size()) {
+            ssize_t write_res = ::write(fd.get(), data->data() + written,
+                                        data->size() - written);
+            if (write_res == -1) {
+                if (get_errno() == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            written += write_res;
+        }
+
+        // Unlike the cache warm-up manifests, the directory isn't just a hint.
+        if (::fsync(fd.get()) != 0) {
+            return;
+        }
+    }
+
+    *ok_out = ::rename(temporary_path.c_str(), path.c_str()) == 0;
+}
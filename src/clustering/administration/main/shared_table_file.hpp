@@ -0,0 +1,95 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_MAIN_SHARED_TABLE_FILE_HPP_
+#define CLUSTERING_ADMINISTRATION_MAIN_SHARED_TABLE_FILE_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/optional.hpp>
+
+#include "concurrency/mutex.hpp"
+#include "containers/scoped.hpp"
+#include "containers/uuid.hpp"
+#include "perfmon/perfmon.hpp"
+#include "serializer/types.hpp"
+#include "threading.hpp"
+#include "utils.hpp"
+
+class io_backender_t;
+class serializer_multiplexer_t;
+class serializer_t;
+
+/* With --shared-table-file, new tables don't get a file of their own.  Their stores
+go in the slots of one shared log file instead, which is split up into
+SHARED_TABLE_FILE_SLOTS proxy serializers the same way a table's file is split up
+into its CPU shards.  Since all the tables' index writes then go through the same
+merger serializer, they get committed together, with one metablock write and one
+fsync, instead of every table syncing its own file.
+
+Which slots belong to which table is kept in a small directory file next to the log
+file.  A slot that's not in the directory may still have blocks in it (if the
+server died while creating or destroying a table), so those get deleted before the
+slot is handed out again. */
+class shared_table_file_t : public home_thread_mixin_t {
+public:
+    // Opens the shared file in base_path, creating it if it doesn't exist.  Like
+    // the tables' files, it has an index file in index_base_path, if that's set.
+    shared_table_file_t(io_backender_t *io_backender,
+                        const base_path_t &base_path,
+                        const boost::optional<base_path_t> &index_base_path);
+    ~shared_table_file_t();
+
+    block_size_t block_size() const;
+
+    // The slots that hold the table's stores, in order, or an empty vector if the
+    // table isn't in the shared file.
+    std::vector<int32_t> table_slots(namespace_id_t namespace_id) const;
+
+    // Takes `count` empty slots for a new table, or returns false if there aren't
+    // enough free slots.  The table must then either be committed with
+    // commit_table() or given up with destroy_table().
+    MUST_USE bool reserve_slots(namespace_id_t namespace_id, int count,
+                                std::vector<int32_t> *slots_out);
+    // Records the table in the directory, once its stores have been created.
+    void commit_table(namespace_id_t namespace_id);
+    // Removes the table from the directory and deletes its blocks.  Its stores
+    // must have been destroyed.
+    void destroy_table(namespace_id_t namespace_id);
+
+    serializer_t *slot_serializer(int32_t slot);
+
+private:
+    typedef std::map<namespace_id_t, std::vector<int32_t> > directory_t;
+
+    void save_directory();
+    void clear_slot(int32_t slot);
+
+    static void read_directory_blocking(const std::string &path,
+                                        directory_t *directory_out, bool *ok_out);
+    static void write_directory_blocking(const std::string &path,
+                                         const std::vector<char> *data, bool *ok_out);
+
+    const std::string directory_path_;
+
+    perfmon_collection_t perfmon_collection_;
+    perfmon_membership_t perfmon_membership_;
+
+    scoped_ptr_t<serializer_t> serializer_;
+    scoped_ptr_t<serializer_multiplexer_t> multiplexer_;
+
+    // The committed tables, which is what gets saved.
+    directory_t directory_;
+    // Tables whose slots have been reserved but that haven't been committed yet.
+    directory_t reserved_;
+    // Whether each slot belongs to a table in directory_ or reserved_.
+    std::vector<bool> slot_taken_;
+
+    // Makes the directory saves happen one at a time.
+    mutex_t save_mutex_;
+
+    DISABLE_COPYING(shared_table_file_t);
+};
+
+#endif  // CLUSTERING_ADMINISTRATION_MAIN_SHARED_TABLE_FILE_HPP_
@@ -199,6 +199,206 @@ void with_ctx_apply_json_to(cJSON *change, auth_semilattice_metadata_t *target,
 void with_ctx_on_subfield_change(auth_semilattice_metadata_t *, const vclock_ctx_t &) { }
 
 
+template <class protocol_t>
+void get_namespaces_delta(const cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > &current,
+                          const cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > &added,
+                          cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > *delta_out) {
+    // `added` usually comes from a copy of our own metadata, so this is common.
+    if (current.get() == added.get()) {
+        return;
+    }
+    typename cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> >::change_t change(delta_out);
+    get_changed_map_entries(current->namespaces, added->namespaces,
+                            &change.get()->namespaces);
+}
+
+bool get_semilattice_delta(const cluster_semilattice_metadata_t &current,
+                           const cluster_semilattice_metadata_t &added,
+                           cluster_semilattice_metadata_t *delta_out) {
+    get_namespaces_delta(current.dummy_namespaces, added.dummy_namespaces,
+                         &delta_out->dummy_namespaces);
+    get_namespaces_delta(current.memcached_namespaces, added.memcached_namespaces,
+                         &delta_out->memcached_namespaces);
+    get_namespaces_delta(current.rdb_namespaces, added.rdb_namespaces,
+                         &delta_out->rdb_namespaces);
+    get_changed_map_entries(current.machines.machines, added.machines.machines,
+                            &delta_out->machines.machines);
+    get_changed_map_entries(current.datacenters.datacenters, added.datacenters.datacenters,
+                            &delta_out->datacenters.datacenters);
+    get_changed_map_entries(current.databases.databases, added.databases.databases,
+                            &delta_out->databases.databases);
+    return true;
+}
+
+bool get_semilattice_digest(const cluster_semilattice_metadata_t &value,
+                            semilattice_digest_t *digest_out) {
+    add_map_to_semilattice_digest('d', value.dummy_namespaces->namespaces, digest_out);
+    add_map_to_semilattice_digest('n', value.memcached_namespaces->namespaces, digest_out);
+    add_map_to_semilattice_digest('r', value.rdb_namespaces->namespaces, digest_out);
+    add_map_to_semilattice_digest('m', value.machines.machines, digest_out);
+    add_map_to_semilattice_digest('c', value.datacenters.datacenters, digest_out);
+    add_map_to_semilattice_digest('b', value.databases.databases, digest_out);
+    return true;
+}
+
+template <class protocol_t>
+void get_namespaces_digest_difference(char tag,
+                                      const cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > &value,
+                                      const semilattice_digest_t &digest,
+                                      cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > *difference_out) {
+    typename cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> >::change_t change(difference_out);
+    get_map_digest_difference(tag, value->namespaces, digest, &change.get()->namespaces);
+}
+
+void get_semilattice_digest_difference(const cluster_semilattice_metadata_t &value,
+                                       const semilattice_digest_t &digest,
+                                       cluster_semilattice_metadata_t *difference_out) {
+    get_namespaces_digest_difference('d', value.dummy_namespaces, digest,
+                                     &difference_out->dummy_namespaces);
+    get_namespaces_digest_difference('n', value.memcached_namespaces, digest,
+                                     &difference_out->memcached_namespaces);
+    get_namespaces_digest_difference('r', value.rdb_namespaces, digest,
+                                     &difference_out->rdb_namespaces);
+    get_map_digest_difference('m', value.machines.machines, digest,
+                              &difference_out->machines.machines);
+    get_map_digest_difference('c', value.datacenters.datacenters, digest,
+                              &difference_out->datacenters.datacenters);
+    get_map_digest_difference('b', value.databases.databases, digest,
+                              &difference_out->databases.databases);
+}
+
+// Directory deltas for namespaces_directory_metadata_t list the business cards that
+// were added or changed, then the IDs of the namespaces whose cards were removed.
+template <class protocol_t>
+void serialize_namespaces_delta(write_message_t *msg,
+                                const namespaces_directory_metadata_t<protocol_t> &old_value,
+                                const namespaces_directory_metadata_t<protocol_t> &new_value) {
+    typedef typename namespaces_directory_metadata_t<protocol_t>::reactor_bcards_map_t bcards_map_t;
+    const bcards_map_t &old_bcards = old_value.reactor_bcards;
+    const bcards_map_t &new_bcards = new_value.reactor_bcards;
+
+    std::vector<typename bcards_map_t::const_iterator> changed;
+    std::vector<namespace_id_t> removed;
+    typename bcards_map_t::const_iterator old_it = old_bcards.begin();
+    typename bcards_map_t::const_iterator new_it = new_bcards.begin();
+    while (old_it != old_bcards.end() || new_it != new_bcards.end()) {
+        if (new_it == new_bcards.end()
+                || (old_it != old_bcards.end() && old_it->first < new_it->first)) {
+            removed.push_back(old_it->first);
+            ++old_it;
+        } else if (old_it == old_bcards.end() || new_it->first < old_it->first) {
+            changed.push_back(new_it);
+            ++new_it;
+        } else {
+            // Unchanged business cards share their `cow_ptr_t`, so this is cheap.
+            if (!(old_it->second == new_it->second)) {
+                changed.push_back(new_it);
+            }
+            ++old_it;
+            ++new_it;
+        }
+    }
+
+    serialize_varint_uint64(msg, changed.size());
+    for (auto it = changed.begin(); it != changed.end(); ++it) {
+        *msg << (*it)->first;
+        *msg << (*it)->second;
+    }
+    *msg << removed;
+}
+
+template <class protocol_t>
+archive_result_t apply_namespaces_delta(read_stream_t *s,
+                                        namespaces_directory_metadata_t<protocol_t> *value) {
+    uint64_t num_changed;
+    archive_result_t res = deserialize_varint_uint64(s, &num_changed);
+    if (bad(res)) { return res; }
+    for (uint64_t i = 0; i < num_changed; ++i) {
+        namespace_id_t namespace_id;
+        res = deserialize(s, &namespace_id);
+        if (bad(res)) { return res; }
+        typename namespaces_directory_metadata_t<protocol_t>::reactor_bcards_map_t::mapped_type bcard;
+        res = deserialize(s, &bcard);
+        if (bad(res)) { return res; }
+        value->reactor_bcards[namespace_id] = std::move(bcard);
+    }
+    std::vector<namespace_id_t> removed;
+    res = deserialize(s, &removed);
+    if (bad(res)) { return res; }
+    for (auto it = removed.begin(); it != removed.end(); ++it) {
+        value->reactor_bcards.erase(*it);
+    }
+    return archive_result_t::SUCCESS;
+}
+
+bool serialize_directory_delta(write_message_t *msg,
+                               const cluster_directory_metadata_t &old_value,
+                               const cluster_directory_metadata_t &new_value) {
+    serialize_namespaces_delta(msg, old_value.dummy_namespaces, new_value.dummy_namespaces);
+    serialize_namespaces_delta(msg, old_value.memcached_namespaces, new_value.memcached_namespaces);
+    serialize_namespaces_delta(msg, old_value.rdb_namespaces, new_value.rdb_namespaces);
+
+    // The other fields are small and hardly ever change, so they're sent together.
+    const bool others_changed = !(old_value.machine_id == new_value.machine_id
+        && old_value.peer_id == new_value.peer_id
+        && old_value.ips == new_value.ips
+        && old_value.get_stats_mailbox_address == new_value.get_stats_mailbox_address
+        && old_value.semilattice_change_mailbox == new_value.semilattice_change_mailbox
+        && old_value.auth_change_mailbox == new_value.auth_change_mailbox
+        && old_value.log_mailbox == new_value.log_mailbox
+        && old_value.local_issues == new_value.local_issues
+        && old_value.peer_type == new_value.peer_type);
+    *msg << others_changed;
+    if (others_changed) {
+        *msg << new_value.machine_id;
+        *msg << new_value.peer_id;
+        *msg << new_value.ips;
+        *msg << new_value.get_stats_mailbox_address;
+        *msg << new_value.semilattice_change_mailbox;
+        *msg << new_value.auth_change_mailbox;
+        *msg << new_value.log_mailbox;
+        *msg << new_value.local_issues;
+        *msg << new_value.peer_type;
+    }
+    return true;
+}
+
+archive_result_t apply_directory_delta(read_stream_t *s,
+                                       cluster_directory_metadata_t *value) {
+    archive_result_t res = apply_namespaces_delta(s, &value->dummy_namespaces);
+    if (bad(res)) { return res; }
+    res = apply_namespaces_delta(s, &value->memcached_namespaces);
+    if (bad(res)) { return res; }
+    res = apply_namespaces_delta(s, &value->rdb_namespaces);
+    if (bad(res)) { return res; }
+
+    bool others_changed;
+    res = deserialize(s, &others_changed);
+    if (bad(res)) { return res; }
+    if (others_changed) {
+        res = deserialize(s, &value->machine_id);
+        if (bad(res)) { return res; }
+        res = deserialize(s, &value->peer_id);
+        if (bad(res)) { return res; }
+        res = deserialize(s, &value->ips);
+        if (bad(res)) { return res; }
+        res = deserialize(s, &value->get_stats_mailbox_address);
+        if (bad(res)) { return res; }
+        res = deserialize(s, &value->semilattice_change_mailbox);
+        if (bad(res)) { return res; }
+        res = deserialize(s, &value->auth_change_mailbox);
+        if (bad(res)) { return res; }
+        res = deserialize(s, &value->log_mailbox);
+        if (bad(res)) { return res; }
+        value->local_issues.clear();
+        res = deserialize(s, &value->local_issues);
+        if (bad(res)) { return res; }
+        res = deserialize(s, &value->peer_type);
+        if (bad(res)) { return res; }
+    }
+    return archive_result_t::SUCCESS;
+}
+
 // ctx-less json adapter concept for cluster_directory_metadata_t
 json_adapter_if_t::json_adapter_map_t get_json_subfields(cluster_directory_metadata_t *target) {
     json_adapter_if_t::json_adapter_map_t res;
@@ -261,6 +461,10 @@ json_adapter_if_t::json_adapter_map_t with_ctx_get_json_subfields(namespace_semi
     res["primary_key"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<std::string>(&target->primary_key, ctx));
     res["database"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<database_id_t>(&target->database, ctx));
     res["cache_size"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<int64_t>(&target->cache_size, ctx));
+    res["cache_size_floor"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<int64_t>(&target->cache_size_floor, ctx));
+    res["cache_size_ceiling"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<int64_t>(&target->cache_size_ceiling, ctx));
+    res["block_size"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<int64_t>(&target->block_size, ctx));
+    res["hash_shards"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<int64_t>(&target->hash_shards, ctx));
     return res;
 }
 
@@ -299,6 +503,10 @@ inline json_adapter_if_t::json_adapter_map_t with_ctx_get_json_subfields(namespa
     default_namespace.primary_key = default_namespace.primary_key.make_new_version("id", ctx.us);
 
     default_namespace.cache_size = default_namespace.cache_size.make_new_version(GIGABYTE, ctx.us);
+    default_namespace.cache_size_floor = default_namespace.cache_size_floor.make_new_version(0, ctx.us);
+    default_namespace.cache_size_ceiling = default_namespace.cache_size_ceiling.make_new_version(0, ctx.us);
+    default_namespace.block_size = default_namespace.block_size.make_new_version(0, ctx.us);
+    default_namespace.hash_shards = default_namespace.hash_shards.make_new_version(0, ctx.us);
 
     deletable_t<namespace_semilattice_metadata_t<protocol_t> > default_ns_in_deletable(default_namespace);
     return json_ctx_adapter_with_inserter_t<typename namespaces_semilattice_metadata_t<protocol_t>::namespace_map_t, vclock_ctx_t>(&target->namespaces, generate_uuid, ctx, default_ns_in_deletable).get_subfields();
@@ -25,6 +25,7 @@
 #include "mock/dummy_protocol.hpp"
 #include "rdb_protocol/protocol.hpp"
 #include "rpc/semilattice/joins/cow_ptr.hpp"
+#include "rpc/semilattice/delta.hpp"
 #include "rpc/semilattice/joins/macros.hpp"
 #include "rpc/serialize_macros.hpp"
 
@@ -50,6 +51,17 @@ public:
 RDB_MAKE_SEMILATTICE_JOINABLE_6(cluster_semilattice_metadata_t, dummy_namespaces, memcached_namespaces, rdb_namespaces, machines, datacenters, databases);
 RDB_MAKE_EQUALITY_COMPARABLE_6(cluster_semilattice_metadata_t, dummy_namespaces, memcached_namespaces, rdb_namespaces, machines, datacenters, databases);
 
+// Deltas and digests for cluster_semilattice_metadata_t (see rpc/semilattice/delta.hpp)
+// work on the individual namespaces, machines, datacenters and databases.
+bool get_semilattice_delta(const cluster_semilattice_metadata_t &current,
+                           const cluster_semilattice_metadata_t &added,
+                           cluster_semilattice_metadata_t *delta_out);
+bool get_semilattice_digest(const cluster_semilattice_metadata_t &value,
+                            semilattice_digest_t *digest_out);
+void get_semilattice_digest_difference(const cluster_semilattice_metadata_t &value,
+                                       const semilattice_digest_t &digest,
+                                       cluster_semilattice_metadata_t *difference_out);
+
 //json adapter concept for cluster_semilattice_metadata_t
 json_adapter_if_t::json_adapter_map_t with_ctx_get_json_subfields(cluster_semilattice_metadata_t *target, const vclock_ctx_t &ctx);
 cJSON *with_ctx_render_as_json(cluster_semilattice_metadata_t *target, const vclock_ctx_t &ctx);
@@ -169,6 +181,15 @@ public:
     RDB_MAKE_ME_SERIALIZABLE_12(dummy_namespaces, memcached_namespaces, rdb_namespaces, machine_id, peer_id, ips, get_stats_mailbox_address, semilattice_change_mailbox, auth_change_mailbox, log_mailbox, local_issues, peer_type);
 };
 
+// Directory deltas for cluster_directory_metadata_t (see rpc/directory/delta.hpp).
+// They carry the business cards that changed and, only if any of them changed, the
+// other fields.
+bool serialize_directory_delta(write_message_t *msg,
+                               const cluster_directory_metadata_t &old_value,
+                               const cluster_directory_metadata_t &new_value);
+MUST_USE archive_result_t apply_directory_delta(read_stream_t *s,
+                                                cluster_directory_metadata_t *value);
+
 // ctx-less json adapter for directory_echo_wrapper_t
 template <typename T>
 json_adapter_if_t::json_adapter_map_t get_json_subfields(directory_echo_wrapper_t<T> *target) {
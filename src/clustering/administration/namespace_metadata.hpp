@@ -61,7 +61,9 @@ void debug_print(printf_buffer_t *buf, const ack_expectation_t &x);
 template<class protocol_t>
 class namespace_semilattice_metadata_t {
 public:
-    namespace_semilattice_metadata_t() : cache_size(GIGABYTE) { }
+    namespace_semilattice_metadata_t()
+        : cache_size(GIGABYTE), cache_size_floor(0), cache_size_ceiling(0),
+          block_size(0), hash_shards(0) { }
 
     vclock_t<persistable_blueprint_t<protocol_t> > blueprint;
     vclock_t<datacenter_id_t> primary_datacenter;
@@ -75,8 +77,20 @@ public:
     vclock_t<std::string> primary_key; //TODO this should actually never be changed...
     vclock_t<database_id_t> database;
     vclock_t<int64_t> cache_size;
-
-    RDB_MAKE_ME_SERIALIZABLE_12(blueprint, primary_datacenter, replica_affinities, ack_expectations, shards, name, port, primary_pinnings, secondary_pinnings, primary_key, database, cache_size);
+    // The range within which the node's cache memory arbiter may move the table's
+    // cache size.  Zero means the same as cache_size.
+    vclock_t<int64_t> cache_size_floor;
+    vclock_t<int64_t> cache_size_ceiling;
+    // The block size of the table's files, used when a node creates them.  Zero
+    // means DEFAULT_BTREE_BLOCK_SIZE.  Files that already exist keep the block
+    // size they were created with.
+    vclock_t<int64_t> block_size;
+    // How many stores, split by hash, a node makes for the table when it creates
+    // its files.  Zero means CPU_SHARDING_FACTOR.  Files that already exist keep
+    // the number of stores they were created with.
+    vclock_t<int64_t> hash_shards;
+
+    RDB_MAKE_ME_SERIALIZABLE_16(blueprint, primary_datacenter, replica_affinities, ack_expectations, shards, name, port, primary_pinnings, secondary_pinnings, primary_key, database, cache_size, cache_size_floor, cache_size_ceiling, block_size, hash_shards);
 };
 
 template <class protocol_t>
@@ -103,6 +117,16 @@ void debug_print(printf_buffer_t *buf, const namespace_semilattice_metadata_t<pr
     debug_print(buf, m.primary_key);
     buf->appendf(", database=");
     debug_print(buf, m.database);
+    buf->appendf(", cache_size=");
+    debug_print(buf, m.cache_size);
+    buf->appendf(", cache_size_floor=");
+    debug_print(buf, m.cache_size_floor);
+    buf->appendf(", cache_size_ceiling=");
+    debug_print(buf, m.cache_size_ceiling);
+    buf->appendf(", block_size=");
+    debug_print(buf, m.block_size);
+    buf->appendf(", hash_shards=");
+    debug_print(buf, m.hash_shards);
     buf->appendf("}");
 }
 
@@ -137,14 +161,18 @@ namespace_semilattice_metadata_t<protocol_t> new_namespace(
     ns.secondary_pinnings = make_vclock(secondary_pinnings, machine);
 
     ns.cache_size = make_vclock(cache_size, machine);
+    ns.cache_size_floor = make_vclock<int64_t>(0, machine);
+    ns.cache_size_ceiling = make_vclock<int64_t>(0, machine);
+    ns.block_size = make_vclock<int64_t>(0, machine);
+    ns.hash_shards = make_vclock<int64_t>(0, machine);
     return ns;
 }
 
 template<class protocol_t>
-RDB_MAKE_SEMILATTICE_JOINABLE_12(namespace_semilattice_metadata_t<protocol_t>, blueprint, primary_datacenter, replica_affinities, ack_expectations, shards, name, port, primary_pinnings, secondary_pinnings, primary_key, database, cache_size);
+RDB_MAKE_SEMILATTICE_JOINABLE_16(namespace_semilattice_metadata_t<protocol_t>, blueprint, primary_datacenter, replica_affinities, ack_expectations, shards, name, port, primary_pinnings, secondary_pinnings, primary_key, database, cache_size, cache_size_floor, cache_size_ceiling, block_size, hash_shards);
 
 template<class protocol_t>
-RDB_MAKE_EQUALITY_COMPARABLE_12(namespace_semilattice_metadata_t<protocol_t>, blueprint, primary_datacenter, replica_affinities, ack_expectations, shards, name, port, primary_pinnings, secondary_pinnings, primary_key, database, cache_size);
+RDB_MAKE_EQUALITY_COMPARABLE_16(namespace_semilattice_metadata_t<protocol_t>, blueprint, primary_datacenter, replica_affinities, ack_expectations, shards, name, port, primary_pinnings, secondary_pinnings, primary_key, database, cache_size, cache_size_floor, cache_size_ceiling, block_size, hash_shards);
 
 // ctx-less json adapter concept for ack_expectation_t
 json_adapter_if_t::json_adapter_map_t get_json_subfields(ack_expectation_t *target);
@@ -5,10 +5,13 @@
 #include <sys/types.h>
 
 #include "arch/runtime/thread_pool.hpp"
+#include "arch/timing.hpp"
 #include "buffer_cache/alt/alt.hpp"
 #include "buffer_cache/alt/blob.hpp"
 #include "containers/archive/buffer_group_stream.hpp"
+#include "containers/archive/varint.hpp"
 #include "clustering/immediate_consistency/branch/history.hpp"
+#include "config/args.hpp"
 #include "serializer/config.hpp"
 
 namespace metadata_persistence {
@@ -34,17 +37,20 @@ struct cluster_metadata_superblock_t {
     char dummy_branch_history_blob[BRANCH_HISTORY_BLOB_MAXREFLEN];
     char memcached_branch_history_blob[BRANCH_HISTORY_BLOB_MAXREFLEN];
     char rdb_branch_history_blob[BRANCH_HISTORY_BLOB_MAXREFLEN];
+
+    /* The changes to the metadata since `metadata_blob` was written: a `uint64_t`
+    count followed by that many deltas (see `get_semilattice_delta()`) to join into
+    it, in order. Files from before this existed have zeroes here, which is an
+    empty blob. */
+    static const int METADATA_LOG_BLOB_MAXREFLEN = 500;
+    char metadata_log_blob[METADATA_LOG_BLOB_MAXREFLEN];
 };
 
 /* Etymology: (R)ethink(D)B (m)eta(d)ata */
 const block_magic_t expected_magic = { { 'R', 'D', 'm', 'd' } };
 
-template <class T>
-static void write_blob(buf_parent_t parent, char *ref, int maxreflen,
-                       const T &value) {
-    write_message_t msg;
-    msg << value;
-    intrusive_list_t<write_buffer_t> *buffers = msg.unsafe_expose_buffers();
+static std::string message_to_string(write_message_t *msg) {
+    intrusive_list_t<write_buffer_t> *buffers = msg->unsafe_expose_buffers();
     size_t slen = 0;
     for (write_buffer_t *p = buffers->head(); p != NULL; p = buffers->next(p)) {
         slen += p->size;
@@ -55,11 +61,20 @@ static void write_blob(buf_parent_t parent, char *ref, int maxreflen,
         str.append(p->data, p->size);
     }
     guarantee(str.size() == slen);
+    return str;
+}
+
+template <class T>
+static void write_blob(buf_parent_t parent, char *ref, int maxreflen,
+                       const T &value) {
+    write_message_t msg;
+    msg << value;
+    std::string str = message_to_string(&msg);
     blob_t blob(parent.cache()->get_block_size(), ref, maxreflen);
     blob.clear(parent);
     blob.append_region(parent, str.size());
     blob.write_from_string(str, parent, 0);
-    guarantee(blob.valuesize() == static_cast<int64_t>(slen));
+    guarantee(blob.valuesize() == static_cast<int64_t>(str.size()));
 }
 
 template<class T>
@@ -218,6 +233,7 @@ cluster_persistent_file_t::cluster_persistent_file_t(io_backender_t *io_backende
                                                      const serializer_filepath_t &filename,
                                                      perfmon_collection_t *perfmon_parent) :
     persistent_file_t<cluster_semilattice_metadata_t>(io_backender, filename, perfmon_parent, false) {
+    load_metadata();
     construct_branch_history_managers(false);
 }
 
@@ -243,6 +259,15 @@ cluster_persistent_file_t::cluster_persistent_file_t(io_backender_t *io_backende
                sb->metadata_blob,
                cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN,
                initial_metadata);
+    write_blob(buf_parent_t(&superblock),
+               sb->metadata_log_blob,
+               cluster_metadata_superblock_t::METADATA_LOG_BLOB_MAXREFLEN,
+               static_cast<uint64_t>(0));
+    metadata_on_disk = initial_metadata;
+    metadata_checkpoint_size = blob::value_size(
+        sb->metadata_blob, cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN);
+    metadata_log_size = sizeof(uint64_t);
+    metadata_log_entries = 0;
     write_blob(buf_parent_t(&superblock),
                sb->dummy_branch_history_blob,
                cluster_metadata_superblock_t::BRANCH_HISTORY_BLOB_MAXREFLEN,
@@ -263,7 +288,7 @@ cluster_persistent_file_t::~cluster_persistent_file_t() {
     // Do nothing
 }
 
-cluster_semilattice_metadata_t cluster_persistent_file_t::read_metadata() {
+void cluster_persistent_file_t::load_metadata() {
     object_buffer_t<txn_t> txn;
     get_read_transaction(&txn);
     buf_lock_t superblock(buf_parent_t(txn.get()), SUPERBLOCK_ID,
@@ -272,13 +297,61 @@ cluster_semilattice_metadata_t cluster_persistent_file_t::read_metadata() {
 
     const cluster_metadata_superblock_t *sb
         = static_cast<const cluster_metadata_superblock_t *>(sb_read.get_data_read());
-    cluster_semilattice_metadata_t metadata;
     read_blob(buf_parent_t(&superblock), sb->metadata_blob,
-              cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN, &metadata);
-    return metadata;
+              cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN, &metadata_on_disk);
+    metadata_checkpoint_size = blob::value_size(
+        sb->metadata_blob, cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN);
+
+    metadata_log_size = blob::value_size(
+        sb->metadata_log_blob, cluster_metadata_superblock_t::METADATA_LOG_BLOB_MAXREFLEN);
+    metadata_log_entries = 0;
+    if (metadata_log_size != 0) {
+        blob_t blob(get_cache_block_size(), const_cast<char *>(sb->metadata_log_blob),
+                    cluster_metadata_superblock_t::METADATA_LOG_BLOB_MAXREFLEN);
+        blob_acq_t acq_group;
+        buffer_group_t group;
+        blob.expose_all(buf_parent_t(&superblock), access_t::read, &group, &acq_group);
+        buffer_group_read_stream_t ss(const_view(&group));
+        archive_result_t res = deserialize(&ss, &metadata_log_entries);
+        guarantee_deserialization(res, "metadata log count");
+        for (uint64_t i = 0; i < metadata_log_entries; ++i) {
+            cluster_semilattice_metadata_t delta;
+            res = deserialize(&ss, &delta);
+            guarantee_deserialization(res, "metadata log entry");
+            semilattice_join(&metadata_on_disk, delta);
+        }
+    }
+}
+
+cluster_semilattice_metadata_t cluster_persistent_file_t::read_metadata() {
+    return metadata_on_disk;
 }
 
 void cluster_persistent_file_t::update_metadata(const cluster_semilattice_metadata_t &metadata) {
+    /* The metadata only ever grows by joins, so joining the delta into what is on
+    disk should give `metadata` back. If it doesn't, or the log has grown too big,
+    we write a new checkpoint instead. */
+    cluster_semilattice_metadata_t delta;
+    bool checkpoint = !get_semilattice_delta(metadata_on_disk, metadata, &delta);
+    if (!checkpoint) {
+        if (delta == cluster_semilattice_metadata_t()) {
+            return;
+        }
+        cluster_semilattice_metadata_t joined = metadata_on_disk;
+        semilattice_join(&joined, delta);
+        checkpoint = !(joined == metadata);
+    }
+
+    std::string entry;
+    if (!checkpoint) {
+        write_message_t msg;
+        msg << delta;
+        entry = message_to_string(&msg);
+        const int64_t new_log_size = metadata_log_size + entry.size();
+        checkpoint = new_log_size > METADATA_LOG_CHECKPOINT_MIN_SIZE
+            && new_log_size > metadata_checkpoint_size;
+    }
+
     object_buffer_t<txn_t> txn;
     get_write_transaction(&txn);
     buf_lock_t superblock(buf_parent_t(txn.get()), SUPERBLOCK_ID,
@@ -286,8 +359,37 @@ void cluster_persistent_file_t::update_metadata(const cluster_semilattice_metada
     buf_write_t sb_write(&superblock);
     cluster_metadata_superblock_t *sb
         = static_cast<cluster_metadata_superblock_t *>(sb_write.get_data_write());
-    write_blob(buf_parent_t(&superblock), sb->metadata_blob,
-               cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN, metadata);
+    if (checkpoint) {
+        write_blob(buf_parent_t(&superblock), sb->metadata_blob,
+                   cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN, metadata);
+        write_blob(buf_parent_t(&superblock), sb->metadata_log_blob,
+                   cluster_metadata_superblock_t::METADATA_LOG_BLOB_MAXREFLEN,
+                   static_cast<uint64_t>(0));
+        metadata_checkpoint_size = blob::value_size(
+            sb->metadata_blob, cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN);
+        metadata_log_size = sizeof(uint64_t);
+        metadata_log_entries = 0;
+    } else {
+        blob_t blob(get_cache_block_size(), sb->metadata_log_blob,
+                    cluster_metadata_superblock_t::METADATA_LOG_BLOB_MAXREFLEN);
+        if (metadata_log_size == 0) {
+            // A file from before the log existed.
+            write_message_t msg;
+            msg << static_cast<uint64_t>(0);
+            std::string count = message_to_string(&msg);
+            blob.append_region(buf_parent_t(&superblock), count.size());
+            blob.write_from_string(count, buf_parent_t(&superblock), 0);
+            metadata_log_size = count.size();
+        }
+        blob.append_region(buf_parent_t(&superblock), entry.size());
+        blob.write_from_string(entry, buf_parent_t(&superblock), metadata_log_size);
+        ++metadata_log_entries;
+        write_message_t msg;
+        msg << metadata_log_entries;
+        blob.write_from_string(message_to_string(&msg), buf_parent_t(&superblock), 0);
+        metadata_log_size += entry.size();
+    }
+    metadata_on_disk = metadata;
 }
 
 machine_id_t cluster_persistent_file_t::read_machine_id() {
@@ -351,7 +453,7 @@ public:
         std::pair<typename std::map<branch_id_t, branch_birth_certificate_t<protocol_t> >::iterator, bool>
             insert_res = bh.branches.insert(std::make_pair(branch_id, bc));
         guarantee(insert_res.second);
-        flush(interruptor);
+        flush_new_branches(std::vector<branch_id_t>(1, branch_id), interruptor);
     }
 
     void export_branch_history(branch_id_t branch,
@@ -379,13 +481,70 @@ public:
     void import_branch_history(const branch_history_t<protocol_t> &new_records,
                                signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
         home_thread_mixin_t::assert_thread();
+        std::vector<branch_id_t> new_branches;
         for (typename std::map<branch_id_t, branch_birth_certificate_t<protocol_t> >::const_iterator it = new_records.branches.begin(); it != new_records.branches.end(); it++) {
-            bh.branches.insert(std::make_pair(it->first, it->second));
+            if (bh.branches.insert(std::make_pair(it->first, it->second)).second) {
+                new_branches.push_back(it->first);
+            }
+        }
+        flush_new_branches(new_branches, interruptor);
+    }
+
+    void prune_branch_history(const std::set<branch_id_t> &roots,
+                              signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        home_thread_mixin_t::assert_thread();
+        if (remove_unreachable_branches(roots, &bh) != 0) {
+            flush(interruptor);
         }
-        flush(interruptor);
     }
 
 private:
+    /* Writes `new_branches`, which must already be in `bh`, to disk. The blob
+    holds `bh` as a serialized `std::map`: a varint count followed by the
+    entries, in any order as far as deserialization is concerned. So instead of
+    rewriting the whole history every time a branch is added, we append the new
+    entries and rewrite the count in place. That only fails when the count's
+    encoding gets longer, in which case we rewrite everything. */
+    void flush_new_branches(const std::vector<branch_id_t> &new_branches,
+                            signal_t *interruptor) {
+        if (new_branches.empty()) {
+            return;
+        }
+        const uint64_t old_count = bh.branches.size() - new_branches.size();
+        if (varint_uint64_serialized_size(old_count)
+                != varint_uint64_serialized_size(bh.branches.size())) {
+            flush(interruptor);
+            return;
+        }
+
+        write_message_t entries_msg;
+        for (std::vector<branch_id_t>::const_iterator it = new_branches.begin();
+             it != new_branches.end();
+             ++it) {
+            typename std::map<branch_id_t, branch_birth_certificate_t<protocol_t> >::const_iterator entry = bh.branches.find(*it);
+            guarantee(entry != bh.branches.end());
+            entries_msg << *entry;
+        }
+        const std::string entries = message_to_string(&entries_msg);
+        write_message_t count_msg;
+        serialize_varint_uint64(&count_msg, bh.branches.size());
+        const std::string count = message_to_string(&count_msg);
+
+        object_buffer_t<txn_t> txn;
+        parent->get_write_transaction(&txn);
+        buf_lock_t superblock(buf_parent_t(txn.get()), SUPERBLOCK_ID,
+                              access_t::write);
+        buf_write_t sb_write(&superblock);
+        cluster_metadata_superblock_t *sb
+            = static_cast<cluster_metadata_superblock_t *>(sb_write.get_data_write());
+        blob_t blob(parent->get_cache_block_size(), sb->*field_name,
+                    cluster_metadata_superblock_t::BRANCH_HISTORY_BLOB_MAXREFLEN);
+        const int64_t old_size = blob.valuesize();
+        blob.append_region(buf_parent_t(&superblock), entries.size());
+        blob.write_from_string(entries, buf_parent_t(&superblock), old_size);
+        blob.write_from_string(count, buf_parent_t(&superblock), 0);
+    }
+
     void flush(UNUSED signal_t *interruptor) {
         object_buffer_t<txn_t> txn;
         parent->get_write_transaction(&txn);
@@ -450,6 +609,12 @@ void semilattice_watching_persister_t<metadata_t>::dump_loop(auto_drainer_t::loc
                 wait_interruptible(&c, keepalive.get_drain_signal());
             }
             if (flush_again->is_pulsed()) {
+                /* Give a burst of changes a moment to settle, so that it becomes a
+                single write. */
+                signal_timer_t timer;
+                timer.start(METADATA_PERSIST_COALESCE_MS);
+                wait_any_t c(&timer, &stop);
+                wait_interruptible(&c, keepalive.get_drain_signal());
                 scoped_ptr_t<cond_t> tmp(new cond_t);
                 flush_again.swap(tmp);
             } else {
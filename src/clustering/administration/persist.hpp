@@ -86,6 +86,15 @@ public:
 
 private:
     void construct_branch_history_managers(bool create);
+    void load_metadata();
+
+    /* The metadata file holds a checkpoint of the whole metadata and a log of the
+    changes since, so that `update_metadata()` only has to write what changed.
+    These describe what is on disk. */
+    cluster_semilattice_metadata_t metadata_on_disk;
+    int64_t metadata_checkpoint_size;
+    int64_t metadata_log_size;
+    uint64_t metadata_log_entries;
 
     template <class protocol_t> class persistent_branch_history_manager_t;
 
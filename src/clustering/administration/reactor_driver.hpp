@@ -2,16 +2,20 @@
 #ifndef CLUSTERING_ADMINISTRATION_REACTOR_DRIVER_HPP_
 #define CLUSTERING_ADMINISTRATION_REACTOR_DRIVER_HPP_
 
+#include <deque>
 #include <map>
+#include <set>
 
 #include "errors.hpp"
 #include <boost/ptr_container/ptr_map.hpp>
 #include <boost/shared_ptr.hpp>
 
+#include "buffer_cache/alt/memory_arbiter.hpp"
 #include "clustering/administration/machine_id_to_peer_id.hpp"
 #include "clustering/administration/metadata.hpp"
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "clustering/reactor/blueprint.hpp"
+#include "concurrency/cond_var.hpp"
 #include "concurrency/watchable.hpp"
 #include "rpc/semilattice/view.hpp"
 #include "serializer/serializer.hpp"
@@ -67,10 +71,15 @@ class svs_by_namespace_t {
 public:
     virtual void get_svs(perfmon_collection_t *perfmon_collection, namespace_id_t namespace_id,
                          int64_t cache_size,
+                         const cache_memory_quota_t &cache_quota,
+                         int64_t block_size,
+                         int hash_shards,
                          stores_lifetimer_t<protocol_t> *stores_out,
                          scoped_ptr_t<multistore_ptr_t<protocol_t> > *svs_out,
                          typename protocol_t::context_t *) = 0;
     virtual void destroy_svs(namespace_id_t namespace_id) = 0;
+    // Whether there are stores on disk for the namespace.
+    virtual bool has_svs(namespace_id_t namespace_id) = 0;
 
 protected:
     virtual ~svs_by_namespace_t() { }
@@ -116,6 +125,11 @@ private:
         const namespace_id_t reactor_namespace,
         const boost::optional<reactor_directory_entry_t> &new_value);
     void commit_directory_changes(auto_drainer_t::lock_t lock);
+    void wait_for_branch_history_pruning(const namespace_id_t &namespace_id,
+                                         multistore_ptr_t<protocol_t> *svs);
+    void prune_branch_history(auto_drainer_t::lock_t lock);
+    void acquire_table_opening_slot(bool is_primary);
+    void release_table_opening_slot();
     // This function is passed by `commit_directory_changes()` into the
     // `apply_read()` method of the directory watchable
     static bool apply_directory_changes(
@@ -150,6 +164,26 @@ private:
     // until after reactor_data is destructed.
     auto_drainer_t directory_change_drainer;
 
+    /* Opening a table reads its serializer's LBA and the superblocks of all its
+    stores, so opening hundreds of tables at once at startup thrashes the disk and
+    holds a lot of memory. No more than MAX_CONCURRENT_TABLE_OPENS tables are
+    opened at a time, and tables that we are a primary for go first, since they
+    are what makes a table available. */
+    int table_openings_in_progress;
+    std::deque<cond_t *> primary_table_opening_waiters;
+    std::deque<cond_t *> other_table_opening_waiters;
+
+    /* At startup, before the reactors of the tables we already have run, we
+    prune the branch history down to the branches their stores are on (see
+    `branch_history_manager_t::prune_branch_history()`). Reactors created after
+    that wait for it too. If we have stores for a table that didn't get a reactor
+    (say, because its blueprint is in conflict), we can't tell what they are on
+    and don't prune. `branch_history_roots_pending` holds the tables whose stores
+    we haven't read yet. These must outlive `reactor_data`. */
+    std::set<namespace_id_t> branch_history_roots_pending;
+    std::set<branch_id_t> branch_history_roots;
+    cond_t branch_history_pruned;
+
     reactor_map_t reactor_data;
 
     auto_drainer_t drainer;
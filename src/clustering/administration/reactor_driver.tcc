@@ -15,10 +15,12 @@
 #include "clustering/reactor/blueprint.hpp"
 #include "clustering/reactor/reactor.hpp"
 #include "concurrency/cross_thread_watchable.hpp"
+#include "config/args.hpp"
 #include "concurrency/watchable.hpp"
 #include "containers/incremental_lenses.hpp"
 #include "rpc/semilattice/view/field.hpp"
 #include "rpc/semilattice/watchable.hpp"
+#include "serializer/log/config.hpp"
 #include "stl_utils.hpp"
 #include "utils.hpp"
 
@@ -118,6 +120,9 @@ public:
                             reactor_driver_t<protocol_t> *parent,
                             namespace_id_t namespace_id,
                             int64_t _cache_size,
+                            const cache_memory_quota_t &_cache_quota,
+                            int64_t _block_size,
+                            int _hash_shards,
                             const blueprint_t<protocol_t> &bp,
                             svs_by_namespace_t<protocol_t> *svs_by_namespace,
                             typename protocol_t::context_t *_ctx) :
@@ -127,7 +132,10 @@ public:
         parent_(parent),
         namespace_id_(namespace_id),
         svs_by_namespace_(svs_by_namespace),
-        cache_size(_cache_size)
+        cache_size(_cache_size),
+        cache_quota(_cache_quota),
+        block_size(_block_size),
+        hash_shards(_hash_shards)
     {
         coro_t::spawn_sometime(boost::bind(&watchable_and_reactor_t<protocol_t>::initialize_reactor, this, io_backender));
     }
@@ -304,8 +312,25 @@ private:
         perfmon_collection_t *namespace_collection = &perfmon_collections->namespace_collection;
         perfmon_collection_t *serializers_collection = &perfmon_collections->serializers_collection;
 
+        bool is_primary = false;
+        {
+            const blueprint_t<protocol_t> bp = watchable.get_watchable()->get();
+            typename blueprint_t<protocol_t>::role_map_t::const_iterator roles
+                = bp.peers_roles.find(parent_->mbox_manager->get_connectivity_service()->get_me());
+            if (roles != bp.peers_roles.end()) {
+                for (typename blueprint_t<protocol_t>::region_to_role_map_t::const_iterator it = roles->second.begin();
+                     it != roles->second.end();
+                     ++it) {
+                    is_primary = is_primary || it->second == blueprint_role_primary;
+                }
+            }
+        }
+
+        parent_->acquire_table_opening_slot(is_primary);
         // TODO: We probably shouldn't have to pass in this perfmon collection.
-        svs_by_namespace_->get_svs(serializers_collection, namespace_id_, cache_size, &stores_lifetimer_, &svs_, ctx);
+        svs_by_namespace_->get_svs(serializers_collection, namespace_id_, cache_size, cache_quota, block_size, hash_shards, &stores_lifetimer_, &svs_, ctx);
+        parent_->release_table_opening_slot();
+        parent_->wait_for_branch_history_pruning(namespace_id_, svs_.get());
 
         auto const extract_reactor_directory_per_peer_fun =
             boost::bind(&watchable_and_reactor_t<protocol_t>::extract_reactor_directory_per_peer,
@@ -359,6 +384,9 @@ private:
 
     scoped_ptr_t<typename watchable_t<directory_echo_wrapper_t<cow_ptr_t<reactor_business_card_t<protocol_t> > > >::subscription_t> reactor_directory_subscription_;
     int64_t cache_size;
+    cache_memory_quota_t cache_quota;
+    int64_t block_size;
+    int hash_shards;
 
     DISABLE_COPYING(watchable_and_reactor_t);
 };
@@ -387,6 +415,7 @@ reactor_driver_t<protocol_t>::reactor_driver_t(const base_path_t &_base_path,
       svs_by_namespace(_svs_by_namespace),
       ack_info(new ack_info_t<protocol_t>(machine_id_translation_table, machines_view, namespaces_view)),
       watchable_variable(namespaces_directory_metadata_t<protocol_t>()),
+      table_openings_in_progress(0),
       semilattice_subscription(boost::bind(&reactor_driver_t<protocol_t>::on_change, this), namespaces_view),
       translation_table_subscription(boost::bind(&reactor_driver_t<protocol_t>::on_change, this)),
       perfmon_collection_repo(_perfmon_collection_repo)
@@ -394,6 +423,25 @@ reactor_driver_t<protocol_t>::reactor_driver_t(const base_path_t &_base_path,
     watchable_t<change_tracking_map_t<peer_id_t, machine_id_t> >::freeze_t freeze(machine_id_translation_table);
     translation_table_subscription.reset(machine_id_translation_table, &freeze);
     on_change();
+
+    cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > namespaces = namespaces_view->get();
+    for (typename namespaces_semilattice_metadata_t<protocol_t>::namespace_map_t::const_iterator
+             it = namespaces->namespaces.begin(); it != namespaces->namespaces.end(); ++it) {
+        if (!it->second.is_deleted() && !std_contains(reactor_data, it->first)
+            && svs_by_namespace->has_svs(it->first)) {
+            branch_history_pruned.pulse();
+            return;
+        }
+    }
+    for (typename reactor_map_t::const_iterator it = reactor_data.begin();
+         it != reactor_data.end();
+         ++it) {
+        branch_history_roots_pending.insert(it->first);
+    }
+    if (branch_history_roots_pending.empty()) {
+        coro_t::spawn_sometime(boost::bind(&reactor_driver_t<protocol_t>::prune_branch_history,
+                                           this, auto_drainer_t::lock_t(&drainer)));
+    }
 }
 
 template<class protocol_t>
@@ -477,6 +525,61 @@ void reactor_driver_t<protocol_t>::delete_reactor_data(
     svs_by_namespace->destroy_svs(namespace_id);
 }
 
+template<class protocol_t>
+void reactor_driver_t<protocol_t>::acquire_table_opening_slot(bool is_primary) {
+    if (table_openings_in_progress < MAX_CONCURRENT_TABLE_OPENS) {
+        ++table_openings_in_progress;
+        return;
+    }
+    /* `release_table_opening_slot()` hands its slot over to us. */
+    cond_t slot_available;
+    (is_primary ? primary_table_opening_waiters : other_table_opening_waiters)
+        .push_back(&slot_available);
+    slot_available.wait_lazily_unordered();
+}
+
+template<class protocol_t>
+void reactor_driver_t<protocol_t>::release_table_opening_slot() {
+    std::deque<cond_t *> *waiters = !primary_table_opening_waiters.empty()
+        ? &primary_table_opening_waiters : &other_table_opening_waiters;
+    if (waiters->empty()) {
+        --table_openings_in_progress;
+    } else {
+        cond_t *next = waiters->front();
+        waiters->pop_front();
+        next->pulse();
+    }
+}
+
+template<class protocol_t>
+void reactor_driver_t<protocol_t>::wait_for_branch_history_pruning(
+        const namespace_id_t &namespace_id,
+        multistore_ptr_t<protocol_t> *svs) {
+    if (branch_history_roots_pending.erase(namespace_id) != 0) {
+        cond_t non_interruptor;
+        order_source_t order_source;
+        object_buffer_t<fifo_enforcer_sink_t::exit_read_t> read_token;
+        svs->new_read_token(&read_token);
+        region_map_t<protocol_t, binary_blob_t> metainfo;
+        svs->do_get_metainfo(order_source.check_in("reactor_driver_t::wait_for_branch_history_pruning").with_read_mode(),
+                             &read_token, &non_interruptor, &metainfo);
+        get_referenced_branches(to_version_range_map(metainfo), &branch_history_roots);
+        if (branch_history_roots_pending.empty()) {
+            prune_branch_history(auto_drainer_t::lock_t(&drainer));
+        }
+    }
+    branch_history_pruned.wait_lazily_unordered();
+}
+
+template<class protocol_t>
+void reactor_driver_t<protocol_t>::prune_branch_history(auto_drainer_t::lock_t lock) {
+    lock.assert_is_holding(&drainer);
+    cond_t non_interruptor;
+    branch_history_manager->prune_branch_history(branch_history_roots, &non_interruptor);
+    branch_history_roots.clear();
+    branch_history_pruned.pulse();
+}
+
 template<class protocol_t>
 void reactor_driver_t<protocol_t>::on_change() {
     cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > namespaces = namespaces_view->get();
@@ -539,8 +642,50 @@ void reactor_driver_t<protocol_t>::on_change() {
                                 it->second.get_ref().name.in_conflict() ? "Name in conflict" : it->second.get_ref().name.get().c_str());
                     }
 
+                    // A floor or ceiling of zero (or in conflict) means it's the
+                    // same as the cache size.
+                    int64_t cache_size_floor = cache_size;
+                    if (!it->second.get_ref().cache_size_floor.in_conflict()
+                        && it->second.get_ref().cache_size_floor.get() > 0) {
+                        cache_size_floor = std::min(cache_size,
+                            std::max<int64_t>(16 * MEGABYTE,
+                                              it->second.get_ref().cache_size_floor.get()));
+                    }
+                    int64_t cache_size_ceiling = cache_size;
+                    if (!it->second.get_ref().cache_size_ceiling.in_conflict()
+                        && it->second.get_ref().cache_size_ceiling.get() > 0) {
+                        cache_size_ceiling = std::max(cache_size,
+                            std::min<int64_t>(64 * GIGABYTE,
+                                              it->second.get_ref().cache_size_ceiling.get()));
+                    }
+
+                    // A block size of zero (or in conflict) means the default.
+                    int64_t block_size = DEFAULT_BTREE_BLOCK_SIZE;
+                    if (!it->second.get_ref().block_size.in_conflict()
+                        && it->second.get_ref().block_size.get() != 0) {
+                        if (log_serializer_static_config_t::is_valid_block_size(
+                                it->second.get_ref().block_size.get())) {
+                            block_size = it->second.get_ref().block_size.get();
+                        } else {
+                            logINF("Namespace %s(%s) has an invalid block size. Using %d bytes instead.\n",
+                                    uuid_to_str(it->first).c_str(),
+                                    it->second.get_ref().name.in_conflict() ? "Name in conflict" : it->second.get_ref().name.get().c_str(),
+                                    DEFAULT_BTREE_BLOCK_SIZE);
+                        }
+                    }
+
+                    // So does a hash shard count of zero.
+                    int hash_shards = CPU_SHARDING_FACTOR;
+                    if (!it->second.get_ref().hash_shards.in_conflict()
+                        && it->second.get_ref().hash_shards.get() != 0) {
+                        hash_shards = std::max<int64_t>(
+                            1,
+                            std::min<int64_t>(MAX_HASH_SHARDS,
+                                              it->second.get_ref().hash_shards.get()));
+                    }
+
                     namespace_id_t tmp = it->first;
-                    reactor_data.insert(tmp, new watchable_and_reactor_t<protocol_t>(base_path, io_backender, this, it->first, cache_size, bp, svs_by_namespace, ctx));
+                    reactor_data.insert(tmp, new watchable_and_reactor_t<protocol_t>(base_path, io_backender, this, it->first, cache_size, cache_memory_quota_t(cache_size_floor, cache_size_ceiling), block_size, hash_shards, bp, svs_by_namespace, ctx));
                 } else {
                     struct op_closure_t {
                         static bool apply(const blueprint_t<protocol_t> &_bp,
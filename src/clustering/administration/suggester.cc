@@ -44,9 +44,12 @@ persistable_blueprint_t<protocol_t> suggest_blueprint_for_namespace(
     region_map_t<protocol_t, std::set<machine_id_t> > secondary_pinnings =
         ns_goals.secondary_pinnings.get();
 
+    /* We have no per-shard rates here, so every shard counts the same. */
     return suggest_blueprint(directory, primary_datacenter,
         datacenter_affinities, shards, machine_data_centers,
-        primary_pinnings, secondary_pinnings, usage, prioritize_distribution);
+        primary_pinnings, secondary_pinnings,
+        std::map<typename protocol_t::region_t, double>(),
+        usage, prioritize_distribution);
 }
 
 template<class protocol_t>
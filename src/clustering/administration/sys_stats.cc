@@ -4,6 +4,8 @@
 #include <inttypes.h>
 #include <sys/statvfs.h>
 
+#include "arch/runtime/numa.hpp"
+#include "arch/runtime/thread_pool.hpp"
 #include "utils.hpp"
 
 struct disk_stat_t {
@@ -54,5 +56,21 @@ sys_stats_collector_t::instantaneous_stats_collector_t::end_stats(void *) {
     result->insert("global_disk_space_used", new perfmon_result_t(strprintf("%" PRIi64, disk_stat.disk_space_used)));
     result->insert("global_disk_space_total", new perfmon_result_t(strprintf("%" PRIi64, disk_stat.disk_space_total)));
 
+    // Which CPUs the threads are pinned to ("any" when they aren't).
+    const linux_thread_pool_t *thread_pool = linux_thread_pool_t::get_thread_pool();
+    scoped_ptr_t<perfmon_result_t> thread_cpus = perfmon_result_t::alloc_map_result();
+    for (int i = 0; i < thread_pool->n_threads; ++i) {
+        const int cpu = thread_pool->thread_cpus[i];
+        thread_cpus->insert(strprintf("thread_%d", i),
+                            new perfmon_result_t(cpu == -1 ? std::string("any") : strprintf("%d", cpu)));
+    }
+    result->insert("thread_cpu_affinity", thread_cpus.release());
+
+    const std::vector<int> &blocker_cpus = get_blocker_cpus();
+    result->insert("blocker_cpu_affinity",
+                   new perfmon_result_t(blocker_cpus.empty()
+                                        ? std::string("any")
+                                        : format_cpu_list(blocker_cpus)));
+
     return result;
 }
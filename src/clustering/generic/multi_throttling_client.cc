@@ -2,12 +2,19 @@
 
 #include "clustering/generic/registrant.hpp"
 #include "containers/archive/boost_types.hpp"
+#include "perfmon/perfmon.hpp"
+
+static perfmon_latency_histogram_t pm_query_ticket_wait;
+static perfmon_membership_t pm_query_ticket_wait_membership(
+    &get_global_perfmon_collection(), &pm_query_ticket_wait, "query_ticket_wait");
 
 template <class request_type, class inner_client_business_card_type>
-multi_throttling_client_t<request_type, inner_client_business_card_type>::ticket_acq_t::ticket_acq_t(multi_throttling_client_t *p) : parent(p) {
+multi_throttling_client_t<request_type, inner_client_business_card_type>::ticket_acq_t::ticket_acq_t(multi_throttling_client_t *p)
+    : parent(p), start_time(get_ticks()) {
     if (parent->free_tickets > 0) {
         state = state_acquired_ticket;
         parent->free_tickets--;
+        pm_query_ticket_wait.record(0);
         pulse();
     } else {
         state = state_waiting_for_ticket;
@@ -41,6 +48,8 @@ multi_throttling_client_t<request_type, inner_client_business_card_type>::multi_
     mailbox_manager(mm),
     free_tickets(0),
     to_relinquish(0),
+    reported_waiting(0),
+    demand_report_timer(demand_report_interval_ms, this),
     give_tickets_mailbox(mailbox_manager,
         boost::bind(&multi_throttling_client_t::on_give_tickets, this, _1)),
     reclaim_tickets_mailbox(mailbox_manager,
@@ -124,6 +133,7 @@ void multi_throttling_client_t<request_type, inner_client_business_card_type>::p
         ticket_queue.remove(lucky_winner);
         lucky_winner->state = ticket_acq_t::state_acquired_ticket;
         free_tickets--;
+        pm_query_ticket_wait.record(get_ticks() - lucky_winner->start_time);
         lucky_winner->pulse();
     }
     // If we didn't need all tickets, see if we are still supposed to return some
@@ -165,6 +175,22 @@ void multi_throttling_client_t<request_type, inner_client_business_card_type>::r
     }
 }
 
+template <class request_type, class inner_client_business_card_type>
+void multi_throttling_client_t<request_type, inner_client_business_card_type>::on_ring() {
+    /* Only say something when the backlog changes, so idle clients stay quiet. */
+    const int waiting = ticket_queue.size();
+    if (waiting != reported_waiting && intro_promise.get_ready_signal()->is_pulsed()) {
+        reported_waiting = waiting;
+        coro_t::spawn_sometime(boost::bind(&multi_throttling_client_t<request_type, inner_client_business_card_type>::report_demand_blocking, this,
+                                           waiting,
+                                           auto_drainer_t::lock_t(&drainer)));
+    }
+}
+
+template <class request_type, class inner_client_business_card_type>
+void multi_throttling_client_t<request_type, inner_client_business_card_type>::report_demand_blocking(int waiting, auto_drainer_t::lock_t) {
+    send(mailbox_manager, intro_promise.wait().report_demand_addr, waiting);
+}
 
 #include "clustering/immediate_consistency/query/master_access.hpp"
 
@@ -4,6 +4,7 @@
 
 #include <algorithm>
 
+#include "arch/timing.hpp"
 #include "clustering/generic/multi_throttling_metadata.hpp"
 #include "concurrency/promise.hpp"
 #include "rpc/mailbox/typed.hpp"
@@ -12,8 +13,12 @@ template <class> class registrant_t;
 template <class> class clone_ptr_t;
 template <class> class watchable_t;
 
+/* Requests wait here for tickets from the `multi_throttling_server_t`. So that the
+server can move tickets to the clients that need them, the client tells it every
+`demand_report_interval_ms` how many requests are waiting, and how long requests
+wait for tickets goes into the `query_ticket_wait` histogram. */
 template <class request_type, class inner_client_business_card_type>
-class multi_throttling_client_t {
+class multi_throttling_client_t : private repeating_timer_callback_t {
 private:
     typedef multi_throttling_business_card_t<request_type, inner_client_business_card_type> mt_business_card_t;
     typedef typename mt_business_card_t::server_business_card_t server_business_card_t;
@@ -33,6 +38,7 @@ public:
         };
         multi_throttling_client_t *parent;
         state_t state;
+        ticks_t start_time;
 
         DISABLE_COPYING(ticket_acq_t);
     };
@@ -63,6 +69,12 @@ private:
 
     void relinquish_tickets_blocking(int count, auto_drainer_t::lock_t keepalive);
 
+    void on_ring();
+
+    void report_demand_blocking(int waiting, auto_drainer_t::lock_t keepalive);
+
+    static const int demand_report_interval_ms = 100;
+
     mailbox_manager_t *const mailbox_manager;
 
     promise_t<server_business_card_t> intro_promise;
@@ -70,9 +82,13 @@ private:
     int free_tickets;
     int to_relinquish;
     intrusive_list_t<ticket_acq_t> ticket_queue;
+    // What we last told the server about `ticket_queue`.
+    int reported_waiting;
 
     auto_drainer_t drainer;
 
+    repeating_timer_t demand_report_timer;
+
     mailbox_t<void(int)> give_tickets_mailbox;
     mailbox_t<void(int)> reclaim_tickets_mailbox;
 
@@ -16,13 +16,17 @@ public:
         server_business_card_t() { }
         server_business_card_t(
                 const mailbox_addr_t<void(request_t)> &ra,
-                const mailbox_addr_t<void(int)> &rta) :
-            request_addr(ra), relinquish_tickets_addr(rta) { }
+                const mailbox_addr_t<void(int)> &rta,
+                const mailbox_addr_t<void(int)> &rda) :
+            request_addr(ra), relinquish_tickets_addr(rta), report_demand_addr(rda) { }
         mailbox_addr_t<void(request_t)> request_addr;
         mailbox_addr_t<void(int)> relinquish_tickets_addr;
-        RDB_MAKE_ME_SERIALIZABLE_2(request_addr, relinquish_tickets_addr);
-        RDB_MAKE_ME_EQUALITY_COMPARABLE_2(this_t::server_business_card_t,
-            request_addr, relinquish_tickets_addr);
+        /* The client sends how many requests are waiting for tickets here. */
+        mailbox_addr_t<void(int)> report_demand_addr;
+        RDB_MAKE_ME_SERIALIZABLE_3(request_addr, relinquish_tickets_addr,
+            report_demand_addr);
+        RDB_MAKE_ME_EQUALITY_COMPARABLE_3(this_t::server_business_card_t,
+            request_addr, relinquish_tickets_addr, report_demand_addr);
     };
 
     class client_business_card_t {
@@ -39,7 +39,10 @@ public:
     }
 
 private:
-    static const int reallocate_interval_ms = 1000;
+    /* Tickets are reallocated often so that they follow load spikes, but the QPS
+    estimates are sampled over a longer period so that they don't jump around. */
+    static const int reallocate_interval_ms = 200;
+    static const int qps_sample_interval_ms = 1000;
     static const int fair_fraction_denom = 5;
 
     class client_t :
@@ -50,11 +53,12 @@ private:
                 const client_business_card_t &client_bc) :
             parent(p),
             target_tickets(0), held_tickets(0), in_use_tickets(0),
+            waiting_requests(0),
 
             time_of_last_qps_sample(get_ticks()),
             requests_since_last_qps_sample(0),
             running_qps_estimate(0),
-            qps_sample_timer(reallocate_interval_ms, this),
+            qps_sample_timer(qps_sample_interval_ms, this),
 
             give_tickets_addr(client_bc.give_tickets_addr),
             reclaim_tickets_addr(client_bc.reclaim_tickets_addr),
@@ -66,11 +70,14 @@ private:
             request_mailbox(new mailbox_t<void(request_type)>(parent->mailbox_manager,
                 std::bind(&client_t::on_request, this, ph::_1))),
             relinquish_tickets_mailbox(new mailbox_t<void(int)>(parent->mailbox_manager,
-                std::bind(&client_t::on_relinquish_tickets, this, ph::_1)))
+                std::bind(&client_t::on_relinquish_tickets, this, ph::_1))),
+            report_demand_mailbox(new mailbox_t<void(int)>(parent->mailbox_manager,
+                std::bind(&client_t::on_report_demand, this, ph::_1)))
         {
             send(parent->mailbox_manager, client_bc.intro_addr,
                  server_business_card_t(request_mailbox->get_address(),
-                                        relinquish_tickets_mailbox->get_address()));
+                                        relinquish_tickets_mailbox->get_address(),
+                                        report_demand_mailbox->get_address()));
             parent->clients.push_back(this);
             parent->adjust_total_tickets();
             parent->recompute_allocations();
@@ -82,6 +89,7 @@ private:
             parent->recompute_allocations();
             request_mailbox.reset();
             relinquish_tickets_mailbox.reset();
+            report_demand_mailbox.reset();
             drainer.reset();
             guarantee(in_use_tickets == 0);
             parent->return_tickets(held_tickets);
@@ -120,6 +128,12 @@ private:
                 requests_since_last_qps_sample * secs_to_ticks(1) / time_span;
         }
 
+        /* The QPS the client needs: what it has been doing, plus enough to clear
+        the requests that are waiting for tickets before the next reallocation. */
+        int estimate_demand() {
+            return estimate_qps() + waiting_requests * 1000 / reallocate_interval_ms;
+        }
+
     private:
         void on_request(const request_type &request) {
             guarantee(held_tickets > 0);
@@ -147,6 +161,10 @@ private:
             parent->return_tickets(tickets);
         }
 
+        void on_report_demand(int waiting) {
+            waiting_requests = waiting;
+        }
+
         void give_tickets_blocking(int tickets, auto_drainer_t::lock_t) {
             send(parent->mailbox_manager, give_tickets_addr, tickets);
         }
@@ -165,6 +183,8 @@ private:
         multi_throttling_server_t *parent;
 
         int target_tickets, held_tickets, in_use_tickets;
+        // As of the client's last report.
+        int waiting_requests;
 
         ticks_t time_of_last_qps_sample;
         int requests_since_last_qps_sample;
@@ -180,6 +200,7 @@ private:
 
         scoped_ptr_t<mailbox_t<void(request_type)> > request_mailbox;
         scoped_ptr_t<mailbox_t<void(int)> > relinquish_tickets_mailbox;
+        scoped_ptr_t<mailbox_t<void(int)> > report_demand_mailbox;
     };
 
     void on_ring() {
@@ -189,13 +210,15 @@ private:
     void recompute_allocations() {
         /* We divide the total number of tickets into two pools. The first pool
         is distributed evenly among all the clients. The second pool is
-        distributed in proportion to the clients' QPS. */
+        distributed in proportion to the clients' demand, which counts both
+        their QPS and their backlog, so that a client whose requests pile up
+        gets tickets from the ones that aren't using theirs. */
         int fair_tickets = std::max(static_cast<int>(clients.size()),
                 total_tickets / fair_fraction_denom);
         int qps_tickets = total_tickets - fair_tickets;
         int total_qps = 0;
         for (client_t *c = clients.head(); c != NULL; c = clients.next(c)) {
-            total_qps += c->estimate_qps();
+            total_qps += c->estimate_demand();
         }
         if (clients.size() == 0) {
             return;
@@ -209,7 +232,7 @@ private:
             /* This math isn't exact, but it's OK if the target tickets of all
             the clients don't add up to `total_tickets`. */
             c->set_target_tickets(fair_tickets / clients.size() +
-                                  qps_tickets * c->estimate_qps() / total_qps);
+                                  qps_tickets * c->estimate_demand() / total_qps);
         }
         redistribute_tickets();
     }
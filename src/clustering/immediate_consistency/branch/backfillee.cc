@@ -12,6 +12,9 @@
 // Must be <= than MAX_CHUNKS_OUT in backfiller.cc
 #define ALLOCATION_CHUNK 8
 
+// How many key ranges `backfillee()` splits a backfill into.
+#define BACKFILL_NUM_RANGES 16
+
 template <class protocol_t>
 struct backfill_queue_entry_t {
     // TODO: The fact that fifo_enforcer_queue_t requires a default
@@ -143,12 +146,13 @@ void receive_end_point_message(promise_t<std::pair<region_map_t<protocol_t, vers
     promise->pulse(std::make_pair(end_point, associated_branch_history));
 }
 
+/* Backfills `region` in one go. */
 template<class protocol_t>
-void backfillee(
+void backfill_region(
         mailbox_manager_t *mailbox_manager,
         branch_history_manager_t<protocol_t> *branch_history_manager,
         store_view_t<protocol_t> *svs,
-        typename protocol_t::region_t region,
+        const typename protocol_t::region_t &region,
         clone_ptr_t<watchable_t<boost::optional<boost::optional<backfiller_business_card_t<protocol_t> > > > > backfiller_metadata,
         backfill_session_id_t backfill_session_id,
         signal_t *interruptor)
@@ -349,6 +353,36 @@ void backfillee(
         interruptor);
 }
 
+template<class protocol_t>
+void backfillee(
+        mailbox_manager_t *mailbox_manager,
+        branch_history_manager_t<protocol_t> *branch_history_manager,
+        store_view_t<protocol_t> *svs,
+        typename protocol_t::region_t region,
+        clone_ptr_t<watchable_t<boost::optional<boost::optional<backfiller_business_card_t<protocol_t> > > > > backfiller_metadata,
+        backfill_session_id_t backfill_session_id,
+        signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t)
+{
+    /* We backfill `region` one key range at a time. Each range records where it
+    got to in the metainfo when it's done, so if we're interrupted, the next
+    backfill only gets what has changed since in the ranges that finished. The
+    ranges end up at different versions, though, and `listener_t` needs the whole
+    region at one version, so then we backfill the whole region once more. That
+    only sends what changed while the ranges were backfilling. */
+    for (int i = 0; i < BACKFILL_NUM_RANGES; ++i) {
+        typename protocol_t::region_t range = region_intersection(
+            region, protocol_t::backfill_subspace(i, BACKFILL_NUM_RANGES));
+        if (region_is_empty(range) || range == region) {
+            continue;
+        }
+        backfill_region(mailbox_manager, branch_history_manager, svs, range,
+                        backfiller_metadata, backfill_session_id, interruptor);
+    }
+    backfill_region(mailbox_manager, branch_history_manager, svs, region,
+                    backfiller_metadata, backfill_session_id, interruptor);
+}
+
 
 #include "memcached/protocol.hpp"
 #include "mock/dummy_protocol.hpp"
@@ -1,9 +1,13 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/immediate_consistency/branch/backfiller.hpp"
 
+#include <algorithm>
+#include <deque>
+
 #include "errors.hpp"
 #include <boost/bind.hpp>
 
+#include "arch/timing.hpp"
 #include "btree/parallel_traversal.hpp"
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "concurrency/fifo_enforcer.hpp"
@@ -20,6 +24,103 @@
 // never finish.
 #define MAX_CHUNKS_OUT 64
 
+// How `backfill_throttle_t` spaces out chunks: the gap between them grows by doubling
+// from BACKFILL_THROTTLE_MIN_GAP_MS, shrinks by that much at a time, and is never more
+// than BACKFILL_THROTTLE_MAX_GAP_MS.
+#define BACKFILL_THROTTLE_MIN_GAP_MS 1
+#define BACKFILL_THROTTLE_MAX_GAP_MS 1000
+
+static int64_t backfill_latency_target_ms = 0;
+
+void set_backfill_latency_target_ms(int64_t ms) {
+    backfill_latency_target_ms = ms;
+}
+
+/* Spaces out the chunks of one backfill while they take longer than the latency
+target to read here or to apply on the backfillee, which is when the backfill is
+competing with queries for the disks and the cache on one end or the other. The gap
+doubles each time a chunk comes back applied while either is over the target, and
+shrinks a step at a time while both are under, so the backfill gets back to full
+speed once the queries let up. */
+class backfill_throttle_t {
+public:
+    backfill_throttle_t()
+        : target(ms_to_ticks(backfill_latency_target_ms)),
+          gap(0), next_send(0), last_sent(get_ticks()),
+          read_latency(0), apply_latency(0) { }
+
+    // Waits for the next chunk's turn to be sent.
+    void wait_to_send(signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        if (target == 0) {
+            return;
+        }
+        const ticks_t now = get_ticks();
+        update_latency(&read_latency, now - last_sent);
+        const ticks_t turn = std::max(now, next_send);
+        next_send = turn + gap;
+        const int64_t wait_ms = (turn - now) / ms_to_ticks(1);
+        if (wait_ms > 0) {
+            nap(wait_ms, interruptor);
+        }
+    }
+
+    void on_chunk_sent() {
+        if (target == 0) {
+            return;
+        }
+        last_sent = get_ticks();
+        send_times.push_back(last_sent);
+    }
+
+    // The backfillee has applied the next `count` chunks.
+    void on_chunks_applied(int count) {
+        if (target == 0) {
+            return;
+        }
+        const ticks_t now = get_ticks();
+        for (int i = 0; i < count && !send_times.empty(); ++i) {
+            update_latency(&apply_latency, now - send_times.front());
+            send_times.pop_front();
+        }
+        if (std::max(read_latency, apply_latency) > target) {
+            gap = std::min(std::max(gap * 2, ms_to_ticks(BACKFILL_THROTTLE_MIN_GAP_MS)),
+                           ms_to_ticks(BACKFILL_THROTTLE_MAX_GAP_MS));
+        } else {
+            gap -= std::min(gap, ms_to_ticks(BACKFILL_THROTTLE_MIN_GAP_MS));
+        }
+    }
+
+private:
+    static ticks_t ms_to_ticks(int64_t ms) {
+        return secs_to_ticks(1) / 1000 * ms;
+    }
+
+    static void update_latency(ticks_t *latency, ticks_t sample) {
+        *latency = *latency - *latency / 8 + sample / 8;
+    }
+
+    const ticks_t target;
+    ticks_t gap;
+    ticks_t next_send;
+    // When the last chunk went out, and when each chunk that the backfillee hasn't
+    // applied yet went out.
+    ticks_t last_sent;
+    std::deque<ticks_t> send_times;
+    // Moving averages of how long it takes to come up with a chunk and how long
+    // the backfillee takes to apply one.
+    ticks_t read_latency;
+    ticks_t apply_latency;
+
+    DISABLE_COPYING(backfill_throttle_t);
+};
+
+static void on_chunks_applied(semaphore_t *chunk_semaphore,
+                              backfill_throttle_t *throttle,
+                              int count) {
+    throttle->on_chunks_applied(count);
+    chunk_semaphore->unlock(count);
+}
+
 inline state_timestamp_t get_earliest_timestamp_of_version_range(const version_range_t &vr) {
     return vr.earliest.timestamp;
 }
@@ -101,9 +202,12 @@ void do_send_chunk(mailbox_manager_t *mbox_manager,
                    const typename protocol_t::backfill_chunk_t &chunk,
                    fifo_enforcer_source_t *fifo_src,
                    semaphore_t *chunk_semaphore,
+                   backfill_throttle_t *throttle,
                    signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+    throttle->wait_to_send(interruptor);
     chunk_semaphore->co_lock_interruptible(interruptor);
     send(mbox_manager, chunk_addr, chunk, fifo_src->enter_write());
+    throttle->on_chunk_sent();
 }
 
 template <class protocol_t>
@@ -115,6 +219,7 @@ public:
                                         mailbox_addr_t<void(typename protocol_t::backfill_chunk_t, fifo_enforcer_write_token_t)> chunk_cont,
                                         fifo_enforcer_source_t *fifo_src,
                                         semaphore_t *chunk_semaphore,
+                                        backfill_throttle_t *throttle,
                                         backfiller_t<protocol_t> *backfiller)
         : start_point_(start_point),
           end_point_cont_(end_point_cont),
@@ -122,6 +227,7 @@ public:
           chunk_cont_(chunk_cont),
           fifo_src_(fifo_src),
           chunk_semaphore_(chunk_semaphore),
+          throttle_(throttle),
           backfiller_(backfiller) { }
 
     bool should_backfill_impl(const typename store_view_t<protocol_t>::metainfo_t &metainfo) {
@@ -129,7 +235,7 @@ public:
     }
 
     void send_chunk(const typename protocol_t::backfill_chunk_t &chunk, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
-        do_send_chunk<protocol_t>(mailbox_manager_, chunk_cont_, chunk, fifo_src_, chunk_semaphore_, interruptor);
+        do_send_chunk<protocol_t>(mailbox_manager_, chunk_cont_, chunk, fifo_src_, chunk_semaphore_, throttle_, interruptor);
     }
 private:
     const region_map_t<protocol_t, version_range_t> *start_point_;
@@ -138,6 +244,7 @@ private:
     mailbox_addr_t<void(typename protocol_t::backfill_chunk_t, fifo_enforcer_write_token_t)> chunk_cont_;
     fifo_enforcer_source_t *fifo_src_;
     semaphore_t *chunk_semaphore_;
+    backfill_throttle_t *throttle_;
     backfiller_t<protocol_t> *backfiller_;
 
     DISABLE_COPYING(backfiller_send_backfill_callback_t);
@@ -171,7 +278,8 @@ void backfiller_t<protocol_t>::on_backfill(backfill_session_id_t session_id,
     wait_any_t interrupted(&local_interruptor, keepalive.get_drain_signal());
 
     static_semaphore_t chunk_semaphore(MAX_CHUNKS_OUT);
-    mailbox_t<void(int)> receive_allocations_mbox(mailbox_manager, boost::bind(&semaphore_t::unlock, &chunk_semaphore, _1));
+    backfill_throttle_t throttle;
+    mailbox_t<void(int)> receive_allocations_mbox(mailbox_manager, boost::bind(&on_chunks_applied, &chunk_semaphore, &throttle, _1));
     send(mailbox_manager, allocation_registration_box, receive_allocations_mbox.get_address());
 
     try {
@@ -187,7 +295,7 @@ void backfiller_t<protocol_t>::on_backfill(backfill_session_id_t session_id,
         svs->new_read_token_pair(&send_backfill_token_pair);
 
         backfiller_send_backfill_callback_t<protocol_t>
-            send_backfill_cb(&start_point, end_point_cont, mailbox_manager, chunk_cont, &fifo_src, &chunk_semaphore, this);
+            send_backfill_cb(&start_point, end_point_cont, mailbox_manager, chunk_cont, &fifo_src, &chunk_semaphore, &throttle, this);
 
         /* Actually perform the backfill */
         svs->send_backfill(
@@ -200,6 +308,12 @@ void backfiller_t<protocol_t>::on_backfill(backfill_session_id_t session_id,
                      &send_backfill_token_pair,
                      &interrupted);
 
+        /* `backfillee()` may start another backfill with the same session ID
+        as soon as it hears that this one is done, so we take the session out of
+        our maps first. */
+        be_interruptible.reset();
+        display_progress.reset();
+
         /* Send a confirmation */
         send(mailbox_manager, done_cont, fifo_src.enter_write());
 
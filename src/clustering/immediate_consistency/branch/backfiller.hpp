@@ -12,6 +12,12 @@ template <class> class backfiller_send_backfill_callback_t;
 template <class> class semilattice_read_view_t;
 class traversal_progress_combiner_t;
 
+/* While reading a backfill chunk here or applying one on the backfillee takes longer
+than `ms` on average, backfills from this node slow down to leave the disks and the
+cache to queries. 0, the default, lets backfills go as fast as they can. Call it
+before any backfill starts. */
+void set_backfill_latency_target_ms(int64_t ms);
+
 /* If you construct a `backfiller_t` for a given store, then it will advertise
 its existence in the metadata and serve backfills over the network. Generally
 `backfiller_t` is constructed as a member of `replier_t`. */
@@ -17,6 +17,9 @@
 #include "rpc/semilattice/view/field.hpp"
 #include "rpc/semilattice/view/member.hpp"
 
+/* The most writes that `spawn_write()` puts in one message to a readable mirror. */
+#define BROADCASTER_MAX_WRITE_BATCH_SIZE 64
+
 template <class protocol_t>
 broadcaster_t<protocol_t>::write_callback_t::write_callback_t() : write(NULL) { }
 
@@ -37,6 +40,9 @@ broadcaster_t<protocol_t>::broadcaster_t(mailbox_manager_t *mm,
         signal_t *interruptor) THROWS_ONLY(interrupted_exc_t)
     : broadcaster_collection(),
       broadcaster_membership(parent_perfmon_collection, &broadcaster_collection, "broadcaster"),
+      write_ack_latency(),
+      write_ack_latency_membership(&broadcaster_collection, &write_ack_latency,
+                                   "write_ack_latency"),
       mailbox_manager(mm),
       branch_id(generate_uuid()),
       branch_history_manager(bhm),
@@ -131,11 +137,14 @@ template <class protocol_t>
 class broadcaster_t<protocol_t>::incomplete_write_t : public home_thread_mixin_debug_only_t {
 public:
     incomplete_write_t(broadcaster_t *p, const typename protocol_t::write_t &w, transition_timestamp_t ts, write_callback_t *cb) :
-        write(w), timestamp(ts), callback(cb), parent(p), incomplete_count(0) { }
+        write(w), timestamp(ts), callback(cb), start_ticks(get_ticks()), parent(p),
+        incomplete_count(0) { }
 
     const typename protocol_t::write_t write;
     const transition_timestamp_t timestamp;
     write_callback_t *callback;
+    // When the write was sent to the mirrors.
+    const ticks_t start_ticks;
 
 private:
     friend class incomplete_write_ref_t;
@@ -193,6 +202,20 @@ private:
     boost::shared_ptr<incomplete_write_t> write;
 };
 
+template <class protocol_t>
+class broadcaster_t<protocol_t>::writeread_batch_t {
+public:
+    writeread_batch_t() { }
+
+    /* These keep the writes from being declared complete until the mirror has
+    answered for them. */
+    std::vector<incomplete_write_ref_t> write_refs;
+    std::vector<listener_writeread_t<protocol_t> > writes;
+
+private:
+    DISABLE_COPYING(writeread_batch_t);
+};
+
 /* The `registrar_t` constructs a `dispatchee_t` for every mirror that
    connects to us. */
 
@@ -203,6 +226,12 @@ public:
         write_mailbox(d.write_mailbox), is_readable(false),
         queue_count(),
         queue_count_membership(&c->broadcaster_collection, &queue_count, uuid_to_str(d.write_mailbox.get_peer().get_uuid()) + "_broadcast_queue_count"),
+        reads_in_flight(0),
+        read_latency_estimate(0),
+        read_stats(secs_to_ticks(1), true),
+        read_stats_membership(&c->broadcaster_collection, &read_stats,
+                              uuid_to_str(d.write_mailbox.get_peer().get_uuid())
+                              + "_reads"),
         background_write_queue(&queue_count),
         // TODO magic constant
         background_write_workers(100, &background_write_queue, &background_write_caller),
@@ -250,6 +279,31 @@ public:
         return write_mailbox.get_peer();
     }
 
+    /* About how long a read sent to us now would take: one read's time for each
+    read we're answering, plus the new one. It's 0 until we've answered a read. */
+    uint64_t expected_read_cost() const {
+        return (reads_in_flight + 1) * read_latency_estimate;
+    }
+
+    void begin_read() {
+        ++reads_in_flight;
+    }
+
+    void end_read(ticks_t start, bool succeeded) {
+        guarantee(reads_in_flight > 0);
+        --reads_in_flight;
+        if (!succeeded) {
+            return;
+        }
+        // A moving average that follows changes in our load within a few dozen reads.
+        const int64_t latency = get_ticks() - start;
+        if (read_latency_estimate == 0) {
+            read_latency_estimate = latency;
+        } else {
+            read_latency_estimate += (latency - read_latency_estimate) / 8;
+        }
+    }
+
 private:
     /* The constructor spawns `send_intro()` in the background. */
     void send_intro(listener_business_card_t<protocol_t> to_send_intro_to,
@@ -311,6 +365,18 @@ public:
 
     perfmon_counter_t queue_count;
     perfmon_membership_t queue_count_membership;
+
+    /* `single_read()` keeps these up to date, on our controller's thread. */
+    uint64_t reads_in_flight;
+    int64_t read_latency_estimate;
+    // Reports the reads in flight, how many there have been, and how long they take.
+    perfmon_duration_sampler_t read_stats;
+    perfmon_membership_t read_stats_membership;
+
+    /* The batch that `spawn_write()` adds our writereads to, if its job hasn't
+    started yet. */
+    boost::shared_ptr<writeread_batch_t> open_writeread_batch;
+
     unlimited_fifo_queue_t<boost::function<void()> > background_write_queue;
     calling_callback_t background_write_caller;
 
@@ -448,12 +514,15 @@ void broadcaster_t<protocol_t>::spawn_write(const typename protocol_t::write_t &
             case DURABILITY_REQUIREMENT_HARD:
                 durability = write_durability_t::HARD;
                 break;
+            case DURABILITY_REQUIREMENT_GROUP_SOFT:
+                durability = write_durability_t::GROUP_SOFT;
+                break;
             default:
                 unreachable();
             }
 
-            it->first->background_write_queue.push(boost::bind(&broadcaster_t::background_writeread, this,
-                it->first, it->second, write_ref, order_token, fifo_enforcer_token, durability));
+            add_to_writeread_batch(it->first, it->second, write_ref, order_token,
+                                   fifo_enforcer_token, durability);
         } else {
             it->first->background_write_queue.push(boost::bind(&broadcaster_t::background_write, this,
                 it->first, it->second, write_ref, order_token, fifo_enforcer_token));
@@ -470,12 +539,21 @@ void broadcaster_t<protocol_t>::pick_a_readable_dispatchee(dispatchee_t **dispat
         throw cannot_perform_query_exc_t("No mirrors readable. this is strange because "
             "the primary mirror should be always readable.");
     }
-    *dispatchee_out = readable_dispatchees.head();
-
-    /* Cycle the readable dispatchees so that the load gets distributed
-    evenly */
-    readable_dispatchees.pop_front();
-    readable_dispatchees.push_back(*dispatchee_out);
+    /* Every readable dispatchee is up to date as of the reads we send it, so we can
+    send the read to whichever one should answer it soonest. Ties (such as between
+    dispatchees that haven't answered a read yet) go to the one at the front, and
+    we cycle the one we pick to the back so that they're broken in turn. */
+    dispatchee_t *best = readable_dispatchees.head();
+    for (dispatchee_t *d = readable_dispatchees.next(best);
+         d != NULL;
+         d = readable_dispatchees.next(d)) {
+        if (d->expected_read_cost() < best->expected_read_cost()) {
+            best = d;
+        }
+    }
+    *dispatchee_out = best;
+    readable_dispatchees.remove(best);
+    readable_dispatchees.push_back(best);
 
     *lock_out = dispatchees[*dispatchee_out];
 }
@@ -512,21 +590,51 @@ void broadcaster_t<protocol_t>::background_write(dispatchee_t *mirror, auto_drai
 }
 
 template<class protocol_t>
-void broadcaster_t<protocol_t>::background_writeread(dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock, incomplete_write_ref_t write_ref, order_token_t order_token, fifo_enforcer_write_token_t token, const write_durability_t durability) THROWS_NOTHING {
+void broadcaster_t<protocol_t>::add_to_writeread_batch(
+        dispatchee_t *mirror, const auto_drainer_t::lock_t &mirror_lock,
+        incomplete_write_ref_t write_ref, order_token_t order_token,
+        fifo_enforcer_write_token_t token, write_durability_t durability) {
+    if (!mirror->open_writeread_batch
+        || mirror->open_writeread_batch->writes.size() >= BROADCASTER_MAX_WRITE_BATCH_SIZE) {
+        mirror->open_writeread_batch = boost::make_shared<writeread_batch_t>();
+        mirror->background_write_queue.push(boost::bind(
+            &broadcaster_t::background_writeread_batch, this,
+            mirror, mirror_lock, mirror->open_writeread_batch));
+    }
+    mirror->open_writeread_batch->write_refs.push_back(write_ref);
+    mirror->open_writeread_batch->writes.push_back(listener_writeread_t<protocol_t>(
+        write_ref.get()->write, write_ref.get()->timestamp, order_token, token,
+        durability));
+}
+
+template<class protocol_t>
+void broadcaster_t<protocol_t>::background_writeread_batch(
+        dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock,
+        boost::shared_ptr<writeread_batch_t> batch) THROWS_NOTHING {
+    if (mirror->open_writeread_batch == batch) {
+        mirror->open_writeread_batch.reset();
+    }
     try {
         cond_t response_cond;
-        typename protocol_t::write_response_t response;
-        mailbox_t<void(typename protocol_t::write_response_t)> response_mailbox(
+        std::vector<typename protocol_t::write_response_t> responses;
+        mailbox_t<void(std::vector<typename protocol_t::write_response_t>)> response_mailbox(
             mailbox_manager,
-            boost::bind(&store_listener_response<typename protocol_t::write_response_t>, &response, _1, &response_cond));
+            boost::bind(&store_listener_response<std::vector<typename protocol_t::write_response_t> >,
+                        &responses, _1, &response_cond));
 
-        send(mailbox_manager, mirror->writeread_mailbox, write_ref.get()->write, write_ref.get()->timestamp, order_token, token, response_mailbox.get_address(), durability);
+        send(mailbox_manager, mirror->writeread_mailbox, batch->writes, response_mailbox.get_address());
 
         wait_interruptible(&response_cond, mirror_lock.get_drain_signal());
 
-        // TODO: Require that everybody provide a callback.
-        if (write_ref.get()->callback) {
-            write_ref.get()->callback->on_response(mirror->get_peer(), response);
+        guarantee(responses.size() == batch->write_refs.size());
+        const ticks_t now = get_ticks();
+        for (size_t i = 0; i < responses.size(); ++i) {
+            write_ack_latency.record(now - batch->write_refs[i].get()->start_ticks);
+            // TODO: Require that everybody provide a callback.
+            if (batch->write_refs[i].get()->callback) {
+                batch->write_refs[i].get()->callback->on_response(mirror->get_peer(),
+                                                                  responses[i]);
+            }
         }
 
     } catch (const interrupted_exc_t &) {
@@ -593,14 +701,19 @@ void broadcaster_t<protocol_t>::single_read(
         /* This is safe even if `interruptor` gets pulsed because nothing
         checks `interruptor` until after we have sent the message. */
         enforcer_token = reader->fifo_source.enter_read();
+        reader->begin_read();
     }
 
+    const ticks_t start = get_ticks();
+    block_pm_duration read_timer(&reader->read_stats);
     try {
         wait_any_t interruptor2(reader_lock.get_drain_signal(), interruptor);
         listener_read<protocol_t>(mailbox_manager, reader->read_mailbox,
                                   read, response, timestamp, order_token, enforcer_token,
                                   &interruptor2);
+        reader->end_read(start, true);
     } catch (const interrupted_exc_t &) {
+        reader->end_read(start, false);
         if (interruptor->is_pulsed()) {
             throw;
         } else {
@@ -13,6 +13,7 @@
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "clustering/immediate_consistency/branch/metadata.hpp"
 #include "concurrency/queue/unlimited_fifo.hpp"
+#include "perfmon/perfmon.hpp"
 #include "protocol_api.hpp"
 #include "timestamps.hpp"
 
@@ -97,11 +98,11 @@ private:
     class dispatchee_t;
 
     /* Reads need to pick a single readable mirror to perform the operation.
-    Writes need to choose a readable mirror to get the reply from. Both use
-    `pick_a_readable_dispatchee()` to do the picking. You must hold
-    `dispatchee_mutex` and pass in `proof` of the mutex acquisition. (A
-    dispatchee is "readable" if a `replier_t` exists for it on the remote
-    machine.) */
+    `pick_a_readable_dispatchee()` picks the one that should answer soonest,
+    judging by the reads it's answering and how long its reads have been taking.
+    You must hold `dispatchee_mutex` and pass in `proof` of the mutex
+    acquisition. (A dispatchee is "readable" if a `replier_t` exists for it on
+    the remote machine.) */
     void pick_a_readable_dispatchee(
         dispatchee_t **dispatchee_out, mutex_assertion_t::acq_t *proof,
         auto_drainer_t::lock_t *lock_out) THROWS_ONLY(cannot_perform_query_exc_t);
@@ -114,10 +115,20 @@ private:
         dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock,
         incomplete_write_ref_t write_ref, order_token_t order_token,
         fifo_enforcer_write_token_t token) THROWS_NOTHING;
-    void background_writeread(
-        dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock,
+    /* Writes for a readable mirror are sent in batches. `spawn_write()` adds each
+    write to the mirror's open batch, if it has one, or starts a new one and puts
+    a `background_writeread_batch()` job for it in the mirror's queue. The job
+    closes the batch when it starts, so every write that arrives while the job
+    waits its turn goes in the same message. */
+    class writeread_batch_t;
+
+    void add_to_writeread_batch(
+        dispatchee_t *mirror, const auto_drainer_t::lock_t &mirror_lock,
         incomplete_write_ref_t write_ref, order_token_t order_token,
-        fifo_enforcer_write_token_t token, write_durability_t durability) THROWS_NOTHING;
+        fifo_enforcer_write_token_t token, write_durability_t durability);
+    void background_writeread_batch(
+        dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock,
+        boost::shared_ptr<writeread_batch_t> batch) THROWS_NOTHING;
     void end_write(boost::shared_ptr<incomplete_write_t> write) THROWS_NOTHING;
 
     void single_read(
@@ -143,6 +154,10 @@ private:
     perfmon_collection_t broadcaster_collection;
     perfmon_membership_t broadcaster_membership;
 
+    // How long each mirror took to acknowledge each write, from when we sent it.
+    perfmon_latency_histogram_t write_ack_latency;
+    perfmon_membership_t write_ack_latency_membership;
+
     mailbox_manager_t *mailbox_manager;
 
     branch_id_t branch_id;
@@ -2,6 +2,7 @@
 #include "clustering/immediate_consistency/branch/history.hpp"
 
 #include <stack>
+#include <vector>
 
 template <class protocol_t>
 bool version_is_ancestor(
@@ -83,6 +84,51 @@ bool version_is_divergent(
 }
 
 
+template <class protocol_t>
+void get_referenced_branches(const region_map_t<protocol_t, version_range_t> &region_map, std::set<branch_id_t> *branches_out) {
+    for (typename region_map_t<protocol_t, version_range_t>::const_iterator it = region_map.begin();
+                                                                            it != region_map.end();
+                                                                            ++it) {
+        if (!it->second.earliest.branch.is_nil()) {
+            branches_out->insert(it->second.earliest.branch);
+        }
+        if (!it->second.latest.branch.is_nil()) {
+            branches_out->insert(it->second.latest.branch);
+        }
+    }
+}
+
+template <class protocol_t>
+size_t remove_unreachable_branches(const std::set<branch_id_t> &roots, branch_history_t<protocol_t> *history) {
+    /* `version_is_ancestor()` follows the earliest versions of a branch's origin
+    and `export_branch_history()` the latest ones, so we keep both. */
+    std::set<branch_id_t> reachable;
+    std::vector<branch_id_t> to_process(roots.begin(), roots.end());
+    while (!to_process.empty()) {
+        branch_id_t next = to_process.back();
+        to_process.pop_back();
+        typename std::map<branch_id_t, branch_birth_certificate_t<protocol_t> >::const_iterator it = history->branches.find(next);
+        if (it == history->branches.end() || !reachable.insert(next).second) {
+            continue;
+        }
+        std::set<branch_id_t> parents;
+        get_referenced_branches(it->second.origin, &parents);
+        to_process.insert(to_process.end(), parents.begin(), parents.end());
+    }
+
+    size_t removed = 0;
+    for (typename std::map<branch_id_t, branch_birth_certificate_t<protocol_t> >::iterator it = history->branches.begin();
+                                                                                           it != history->branches.end();) {
+        if (reachable.count(it->first) == 0) {
+            history->branches.erase(it++);
+            ++removed;
+        } else {
+            ++it;
+        }
+    }
+    return removed;
+}
+
 template <class protocol_t>
 region_map_t<protocol_t, version_range_t> to_version_range_map(const region_map_t<protocol_t, binary_blob_t> &blob_map) {
     return region_map_transform<protocol_t, binary_blob_t, version_range_t>(blob_map,
@@ -145,3 +191,15 @@ template region_map_t<mock::dummy_protocol_t, version_range_t> to_version_range_
 template region_map_t<memcached_protocol_t, version_range_t> to_version_range_map<memcached_protocol_t>(const region_map_t<memcached_protocol_t, binary_blob_t> &blob_map);
 
 template region_map_t<rdb_protocol_t, version_range_t> to_version_range_map<rdb_protocol_t>(const region_map_t<rdb_protocol_t, binary_blob_t> &blob_map);
+
+template void get_referenced_branches<mock::dummy_protocol_t>(const region_map_t<mock::dummy_protocol_t, version_range_t> &region_map, std::set<branch_id_t> *branches_out);
+
+template size_t remove_unreachable_branches<mock::dummy_protocol_t>(const std::set<branch_id_t> &roots, branch_history_t<mock::dummy_protocol_t> *history);
+
+template void get_referenced_branches<memcached_protocol_t>(const region_map_t<memcached_protocol_t, version_range_t> &region_map, std::set<branch_id_t> *branches_out);
+
+template size_t remove_unreachable_branches<memcached_protocol_t>(const std::set<branch_id_t> &roots, branch_history_t<memcached_protocol_t> *history);
+
+template void get_referenced_branches<rdb_protocol_t>(const region_map_t<rdb_protocol_t, version_range_t> &region_map, std::set<branch_id_t> *branches_out);
+
+template size_t remove_unreachable_branches<rdb_protocol_t>(const std::set<branch_id_t> &roots, branch_history_t<rdb_protocol_t> *history);
@@ -214,8 +214,25 @@ public:
     B-tree's metainfo and then crash, we had better be able to find the
     `branch_birth_certificate_t` when we start back up. */
     virtual void import_branch_history(const branch_history_t<protocol_t> &new_records, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
+
+    /* Forgets every branch that isn't in `roots` or an ancestor of one. Blocks
+    until that is on disk. This is only safe while nothing but `roots` can refer
+    to the branches in this manager; the `reactor_driver_t` calls it at startup,
+    with the branches its stores are on, before any reactor runs. We don't need
+    to keep branches other servers might still be on, because they send their
+    history along with their branch IDs as described above. */
+    virtual void prune_branch_history(const std::set<branch_id_t> &roots, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
 };
 
+/* Adds the branches in `region_map` to `branches_out`. */
+template <class protocol_t>
+void get_referenced_branches(const region_map_t<protocol_t, version_range_t> &region_map, std::set<branch_id_t> *branches_out);
+
+/* Removes every branch from `history` that isn't in `roots` or an ancestor of one
+of them. Returns the number of branches removed. */
+template <class protocol_t>
+size_t remove_unreachable_branches(const std::set<branch_id_t> &roots, branch_history_t<protocol_t> *history);
+
 /* `version_is_ancestor()` returns `true` if every key in `relevant_region` of
 the table passed through `ancestor` version on the way to `descendent` version.
 Also returns true if `ancestor` and `descendent` are the same version. */
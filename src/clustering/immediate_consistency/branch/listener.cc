@@ -8,6 +8,7 @@
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "concurrency/coro_pool.hpp"
 #include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/pmap.hpp"
 
 
 /* `WRITE_QUEUE_CORO_POOL_SIZE` is the number of coroutines that will be used
@@ -78,7 +79,7 @@ listener_t<protocol_t>::listener_t(const base_path_t &base_path,
     write_mailbox_(mailbox_manager_,
         boost::bind(&listener_t::on_write, this, _1, _2, _3, _4, _5)),
     writeread_mailbox_(mailbox_manager_,
-        boost::bind(&listener_t::on_writeread, this, _1, _2, _3, _4, _5, _6)),
+        boost::bind(&listener_t::on_writeread, this, _1, _2)),
     read_mailbox_(mailbox_manager_,
         boost::bind(&listener_t::on_read, this, _1, _2, _3, _4, _5))
 {
@@ -247,7 +248,7 @@ listener_t<protocol_t>::listener_t(const base_path_t &base_path,
     write_mailbox_(mailbox_manager_,
         boost::bind(&listener_t::on_write, this, _1, _2, _3, _4, _5)),
     writeread_mailbox_(mailbox_manager_,
-        boost::bind(&listener_t::on_writeread, this, _1, _2, _3, _4, _5, _6)),
+        boost::bind(&listener_t::on_writeread, this, _1, _2)),
     read_mailbox_(mailbox_manager_,
         boost::bind(&listener_t::on_read, this, _1, _2, _3, _4, _5))
 {
@@ -465,73 +466,82 @@ void listener_t<protocol_t>::perform_enqueued_write(const write_queue_entry_t &q
 }
 
 template <class protocol_t>
-void listener_t<protocol_t>::on_writeread(const typename protocol_t::write_t &write,
-        transition_timestamp_t transition_timestamp,
-        order_token_t order_token,
-        fifo_enforcer_write_token_t fifo_token,
-        mailbox_addr_t<void(typename protocol_t::write_response_t)> ack_addr,
-        write_durability_t durability) THROWS_NOTHING {
-    rassert(region_is_superset(our_branch_region_, write.get_region()));
-    rassert(!region_is_empty(write.get_region()));
-    rassert(region_is_superset(svs_->get_region(), write.get_region()));
-    order_token.assert_write_mode();
+void listener_t<protocol_t>::on_writeread(
+        const std::vector<listener_writeread_t<protocol_t> > &writes,
+        mailbox_addr_t<void(std::vector<typename protocol_t::write_response_t>)> ack_addr)
+        THROWS_NOTHING {
+    for (auto it = writes.begin(); it != writes.end(); ++it) {
+        rassert(region_is_superset(our_branch_region_, it->write.get_region()));
+        rassert(!region_is_empty(it->write.get_region()));
+        rassert(region_is_superset(svs_->get_region(), it->write.get_region()));
+        it->order_token.assert_write_mode();
+    }
 
     coro_t::spawn_sometime(boost::bind(
-        &listener_t<protocol_t>::perform_writeread, this,
-        write, transition_timestamp, order_token, fifo_token, ack_addr, durability,
-        auto_drainer_t::lock_t(&drainer_)));
+        &listener_t<protocol_t>::perform_writereads, this,
+        writes, ack_addr, auto_drainer_t::lock_t(&drainer_)));
 }
 
 template <class protocol_t>
-void listener_t<protocol_t>::perform_writeread(const typename protocol_t::write_t &write,
-        transition_timestamp_t transition_timestamp,
-        order_token_t order_token,
-        fifo_enforcer_write_token_t fifo_token,
-        mailbox_addr_t<void(typename protocol_t::write_response_t)> ack_addr,
-        const write_durability_t durability,
+void listener_t<protocol_t>::perform_writereads(
+        const std::vector<listener_writeread_t<protocol_t> > &writes,
+        mailbox_addr_t<void(std::vector<typename protocol_t::write_response_t>)> ack_addr,
         auto_drainer_t::lock_t keepalive) THROWS_NOTHING {
+    /* The writes take their turns at `store_entrance_sink_`, so we start them all
+    at once and they go through the store together, just as if they had come in
+    messages of their own. We answer for all of them together. */
+    std::vector<typename protocol_t::write_response_t> responses(writes.size());
+    pmap(writes.size(), [&](int i) {
+        perform_writeread(writes[i], &responses[i], keepalive.get_drain_signal());
+    });
+    if (keepalive.get_drain_signal()->is_pulsed()) {
+        return;
+    }
+    send(mailbox_manager_, ack_addr, responses);
+}
+
+template <class protocol_t>
+void listener_t<protocol_t>::perform_writeread(const listener_writeread_t<protocol_t> &w,
+        typename protocol_t::write_response_t *response_out,
+        signal_t *interruptor) THROWS_NOTHING {
     try {
         write_token_pair_t write_token_pair;
         {
             {
                 /* Briefly pass through `write_queue_entrance_sink_` in case we
                 are receiving a mix of writes and write-reads */
-                fifo_enforcer_sink_t::exit_write_t fifo_exit_1(&write_queue_entrance_sink_, fifo_token);
+                fifo_enforcer_sink_t::exit_write_t fifo_exit_1(&write_queue_entrance_sink_, w.fifo_token);
             }
 
-            fifo_enforcer_sink_t::exit_write_t fifo_exit_2(&store_entrance_sink_, fifo_token);
-            wait_interruptible(&fifo_exit_2, keepalive.get_drain_signal());
+            fifo_enforcer_sink_t::exit_write_t fifo_exit_2(&store_entrance_sink_, w.fifo_token);
+            wait_interruptible(&fifo_exit_2, interruptor);
 
-            advance_current_timestamp_and_pulse_waiters(transition_timestamp);
+            advance_current_timestamp_and_pulse_waiters(w.timestamp);
 
             svs_->new_write_token_pair(&write_token_pair);
         }
 
         // Make sure we can serve the entire operation without masking it.
         // (We shouldn't have been signed up for writereads if we couldn't.)
-        rassert(region_is_superset(svs_->get_region(), write.get_region()));
+        rassert(region_is_superset(svs_->get_region(), w.write.get_region()));
 
 
 #ifndef NDEBUG
-        version_leq_metainfo_checker_callback_t<protocol_t> metainfo_checker_callback(transition_timestamp.timestamp_before());
+        version_leq_metainfo_checker_callback_t<protocol_t> metainfo_checker_callback(w.timestamp.timestamp_before());
         metainfo_checker_t<protocol_t> metainfo_checker(&metainfo_checker_callback, svs_->get_region());
 #endif
 
         // Perform the operation
-        typename protocol_t::write_response_t response;
-
         svs_->write(DEBUG_ONLY(metainfo_checker, )
                     region_map_t<protocol_t, binary_blob_t>(svs_->get_region(),
-                                                            binary_blob_t(version_range_t(version_t(branch_id_, transition_timestamp.timestamp_after())))),
-                    write,
-                    &response,
-                    durability,
-                    transition_timestamp,
-                    order_token,
+                                                            binary_blob_t(version_range_t(version_t(branch_id_, w.timestamp.timestamp_after())))),
+                    w.write,
+                    response_out,
+                    w.durability,
+                    w.timestamp,
+                    w.order_token,
                     &write_token_pair,
-                    keepalive.get_drain_signal());
-
-        send(mailbox_manager_, ack_addr, response);
+                    interruptor);
 
     } catch (const interrupted_exc_t &) {
         /* pass */
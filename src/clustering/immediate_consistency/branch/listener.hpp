@@ -3,6 +3,7 @@
 #define CLUSTERING_IMMEDIATE_CONSISTENCY_BRANCH_LISTENER_HPP_
 
 #include <map>
+#include <vector>
 
 #include "clustering/immediate_consistency/branch/metadata.hpp"
 #include "concurrency/promise.hpp"
@@ -171,23 +172,20 @@ private:
     /* See the note at the place where `writeread_mailbox` is declared for an
     explanation of why `on_writeread()` and `on_read()` are here. */
 
-    void on_writeread(const typename protocol_t::write_t &write,
-            transition_timestamp_t transition_timestamp,
-            order_token_t order_token,
-            fifo_enforcer_write_token_t fifo_token,
-            mailbox_addr_t<void(typename protocol_t::write_response_t)> ack_addr,
-            write_durability_t durability)
+    void on_writeread(const std::vector<listener_writeread_t<protocol_t> > &writes,
+            mailbox_addr_t<void(std::vector<typename protocol_t::write_response_t>)> ack_addr)
         THROWS_NOTHING;
 
-    void perform_writeread(const typename protocol_t::write_t &write,
-            transition_timestamp_t transition_timestamp,
-            order_token_t order_token,
-            fifo_enforcer_write_token_t fifo_token,
-            mailbox_addr_t<void(typename protocol_t::write_response_t)> ack_addr,
-            write_durability_t durability,
+    void perform_writereads(const std::vector<listener_writeread_t<protocol_t> > &writes,
+            mailbox_addr_t<void(std::vector<typename protocol_t::write_response_t>)> ack_addr,
             auto_drainer_t::lock_t keepalive)
         THROWS_NOTHING;
 
+    void perform_writeread(const listener_writeread_t<protocol_t> &write,
+            typename protocol_t::write_response_t *response_out,
+            signal_t *interruptor)
+        THROWS_NOTHING;
+
     void on_read(const typename protocol_t::read_t &read,
             state_timestamp_t expected_timestamp,
             order_token_t order_token,
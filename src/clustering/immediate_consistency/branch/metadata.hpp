@@ -4,12 +4,14 @@
 
 #include <map>
 #include <utility>
+#include <vector>
 
 #include "clustering/generic/registration_metadata.hpp"
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "concurrency/fifo_checker.hpp"
 #include "concurrency/fifo_enforcer.hpp"
 #include "concurrency/promise.hpp"
+#include "containers/archive/stl_types.hpp"
 #include "containers/uuid.hpp"
 #include "protocol_api.hpp"
 #include "rpc/mailbox/typed.hpp"
@@ -19,6 +21,27 @@
 
 template <class> class listener_intro_t;
 
+/* One of the writes in a message to a `listener_t`'s `writeread_mailbox`. */
+template <class protocol_t>
+class listener_writeread_t {
+public:
+    listener_writeread_t() { }
+    listener_writeread_t(const typename protocol_t::write_t &w,
+                         transition_timestamp_t ts,
+                         order_token_t ot,
+                         fifo_enforcer_write_token_t ft,
+                         write_durability_t d)
+        : write(w), timestamp(ts), order_token(ot), fifo_token(ft), durability(d) { }
+
+    typename protocol_t::write_t write;
+    transition_timestamp_t timestamp;
+    order_token_t order_token;
+    fifo_enforcer_write_token_t fifo_token;
+    write_durability_t durability;
+
+    RDB_MAKE_ME_SERIALIZABLE_5(write, timestamp, order_token, fifo_token, durability);
+};
+
 /* Every `listener_t` constructs a `listener_business_card_t` and sends it to
 the `broadcaster_t`. */
 
@@ -35,12 +58,12 @@ public:
                            fifo_enforcer_write_token_t,
                            mailbox_addr_t<void()> ack_addr)> write_mailbox_t;
 
-    typedef mailbox_t<void(typename protocol_t::write_t,
-                           transition_timestamp_t,
-                           order_token_t,
-                           fifo_enforcer_write_token_t,
-                           mailbox_addr_t<void(typename protocol_t::write_response_t)>,
-                           write_durability_t)> writeread_mailbox_t;
+    /* The master sends the writes it has for a readable mirror in batches, in
+    timestamp order, and the mirror answers with their responses in the same
+    order once it has performed all of them. */
+    typedef mailbox_t<void(std::vector<listener_writeread_t<protocol_t> >,
+                           mailbox_addr_t<void(std::vector<typename protocol_t::write_response_t>)>
+                           )> writeread_mailbox_t;
 
     typedef mailbox_t<void(typename protocol_t::read_t,
                            state_timestamp_t,
@@ -6,6 +6,7 @@
 #include "clustering/immediate_consistency/query/master_access.hpp"
 #include "concurrency/fifo_enforcer.hpp"
 #include "concurrency/watchable.hpp"
+#include "config/args.hpp"
 
 template <class protocol_t>
 cluster_namespace_interface_t<protocol_t>::cluster_namespace_interface_t(
@@ -15,6 +16,7 @@ cluster_namespace_interface_t<protocol_t>::cluster_namespace_interface_t(
     : mailbox_manager(mm),
       directory_view(dv),
       ctx(_ctx),
+      master_routes_valid(false),
       start_count(0),
       watcher_subscription(new watchable_subscription_t<std::map<peer_id_t, cow_ptr_t<reactor_business_card_t<protocol_t> > > >(std::bind(&cluster_namespace_interface_t::update_registrants, this, false))) {
     {
@@ -108,20 +110,16 @@ void cluster_namespace_interface_t<protocol_t>::dispatch_immediate_op(
         masters_to_contact;
     scoped_ptr_t<immediate_op_info_t<op_type, fifo_enforcer_token_type> >
         new_op_info(new immediate_op_info_t<op_type, fifo_enforcer_token_type>());
-    for (auto it = relationships.begin(); it != relationships.end(); ++it) {
-        if (op.shard(it->first, &new_op_info->sharded_op)) {
-            relationship_t *chosen_relationship = NULL;
-            const std::set<relationship_t *> *relationship_map = &it->second;
-            for (auto jt = relationship_map->begin();
-                 jt != relationship_map->end();
-                 ++jt) {
-                if ((*jt)->master_access) {
-                    if (chosen_relationship) {
-                        throw cannot_perform_query_exc_t("Too many masters available");
-                    }
-                    chosen_relationship = *jt;
-                }
+    // Only the routes whose regions intersect the op's can take part of it, so a
+    // point read or write looks up a single route.
+    get_master_routes().visit_intersecting(op.get_region(), [&](
+            const typename protocol_t::region_t &region,
+            const master_route_t &route) {
+        if (op.shard(region, &new_op_info->sharded_op)) {
+            if (route.too_many_masters) {
+                throw cannot_perform_query_exc_t("Too many masters available");
             }
+            relationship_t *chosen_relationship = route.master;
             if (!chosen_relationship) {
                 throw cannot_perform_query_exc_t("No master available");
             }
@@ -134,7 +132,7 @@ void cluster_namespace_interface_t<protocol_t>::dispatch_immediate_op(
             new_op_info.init(
                 new immediate_op_info_t<op_type, fifo_enforcer_token_type>());
         }
-    }
+    });
 
     std::vector<op_response_type> results(masters_to_contact.size());
     std::vector<std::string> failures(masters_to_contact.size());
@@ -161,6 +159,31 @@ void cluster_namespace_interface_t<protocol_t>::dispatch_immediate_op(
     op.unshard(results.data(), results.size(), response, ctx, interruptor);
 }
 
+template <class protocol_t>
+const region_map_t<protocol_t, typename cluster_namespace_interface_t<protocol_t>::master_route_t> &
+cluster_namespace_interface_t<protocol_t>::get_master_routes() {
+    if (!master_routes_valid) {
+        std::vector<std::pair<typename protocol_t::region_t, master_route_t> > routes;
+        routes.reserve(relationships.size());
+        for (auto it = relationships.begin(); it != relationships.end(); ++it) {
+            master_route_t route;
+            for (auto jt = it->second.begin(); jt != it->second.end(); ++jt) {
+                if ((*jt)->master_access) {
+                    if (route.master != NULL) {
+                        route.too_many_masters = true;
+                    }
+                    route.master = *jt;
+                }
+            }
+            routes.push_back(std::make_pair(it->first, route));
+        }
+        master_routes = region_map_t<protocol_t, master_route_t>(routes.begin(),
+                                                                  routes.end());
+        master_routes_valid = true;
+    }
+    return master_routes;
+}
+
 template <class protocol_t>
 template<class op_type, class fifo_enforcer_token_type, class op_response_type>
 void cluster_namespace_interface_t<protocol_t>::perform_immediate_op(
@@ -215,12 +238,14 @@ cluster_namespace_interface_t<protocol_t>::dispatch_outdated_read(
     boost::ptr_vector<outdated_read_info_t> direct_readers_to_contact;
 
     scoped_ptr_t<outdated_read_info_t> new_op_info(new outdated_read_info_t());
-    for (auto it = relationships.begin(); it != relationships.end(); ++it) {
-        if (op.shard(it->first, &new_op_info->sharded_op)) {
+    relationships.visit_intersecting(op.get_region(), [&](
+            const typename protocol_t::region_t &region,
+            const std::set<relationship_t *> &relationship_set) {
+        if (op.shard(region, &new_op_info->sharded_op)) {
             std::vector<relationship_t *> potential_relationships;
             relationship_t *chosen_relationship = NULL;
 
-            const std::set<relationship_t *> *relationship_map = &it->second;
+            const std::set<relationship_t *> *relationship_map = &relationship_set;
             for (auto jt = relationship_map->begin();
                  jt != relationship_map->end();
                  ++jt) {
@@ -235,8 +260,7 @@ cluster_namespace_interface_t<protocol_t>::dispatch_outdated_read(
             }
             if (!chosen_relationship && !potential_relationships.empty()) {
                 chosen_relationship
-                    = potential_relationships[
-                        distributor_rng.randint(potential_relationships.size())];
+                    = choose_remote_direct_reader(potential_relationships);
             }
             if (!chosen_relationship) {
                 /* Don't bother looking for masters; if there are no direct
@@ -245,12 +269,13 @@ cluster_namespace_interface_t<protocol_t>::dispatch_outdated_read(
             }
             new_op_info->direct_reader_access
                 = chosen_relationship->direct_reader_access;
+            new_op_info->relationship = chosen_relationship;
             new_op_info->keepalive = auto_drainer_t::lock_t(
                 &chosen_relationship->drainer);
             direct_readers_to_contact.push_back(new_op_info.release());
             new_op_info.init(new outdated_read_info_t());
         }
-    }
+    });
 
     std::vector<typename protocol_t::read_response_t> results(direct_readers_to_contact.size());
     std::vector<std::string> failures(direct_readers_to_contact.size());
@@ -268,6 +293,33 @@ cluster_namespace_interface_t<protocol_t>::dispatch_outdated_read(
     op.unshard(results.data(), results.size(), response, ctx, interruptor);
 }
 
+template <class protocol_t>
+typename cluster_namespace_interface_t<protocol_t>::relationship_t *
+cluster_namespace_interface_t<protocol_t>::choose_remote_direct_reader(
+        const std::vector<relationship_t *> &candidates) {
+    guarantee(!candidates.empty());
+    /* Readers we haven't timed yet get reads first. After that, one read in
+    OUTDATED_READ_EXPLORATION_RATE goes to a random reader, so that the times keep
+    up with changes in the network and in the peers' load. */
+    std::vector<relationship_t *> untimed;
+    relationship_t *fastest = NULL;
+    for (auto it = candidates.begin(); it != candidates.end(); ++it) {
+        if ((*it)->outdated_read_latency == 0) {
+            untimed.push_back(*it);
+        } else if (fastest == NULL
+                   || (*it)->outdated_read_latency < fastest->outdated_read_latency) {
+            fastest = *it;
+        }
+    }
+    if (!untimed.empty()) {
+        return untimed[distributor_rng.randint(untimed.size())];
+    }
+    if (distributor_rng.randint(OUTDATED_READ_EXPLORATION_RATE) == 0) {
+        return candidates[distributor_rng.randint(candidates.size())];
+    }
+    return fastest;
+}
+
 template <class protocol_t>
 void outdated_read_store_result(typename protocol_t::read_response_t *result_out, const typename protocol_t::read_response_t &result_in, cond_t *done) {
     *result_out = result_in;
@@ -286,6 +338,7 @@ void cluster_namespace_interface_t<protocol_t>::perform_outdated_read(
     outdated_read_info_t *direct_reader_to_contact = &(*direct_readers_to_contact)[i];
 
     try {
+        const ticks_t start = get_ticks();
         cond_t done;
         mailbox_t<void(typename protocol_t::read_response_t)> cont(mailbox_manager,
                                                                    std::bind(&outdated_read_store_result<protocol_t>, &results->at(i), ph::_1, &done));
@@ -294,6 +347,16 @@ void cluster_namespace_interface_t<protocol_t>::perform_outdated_read(
         wait_any_t waiter(direct_reader_to_contact->direct_reader_access->get_failed_signal(), &done);
         wait_interruptible(&waiter, interruptor);
         direct_reader_to_contact->direct_reader_access->access();   /* throws if `get_failed_signal()->is_pulsed()` */
+
+        // `keepalive` keeps the relationship around.
+        relationship_t *relationship = direct_reader_to_contact->relationship;
+        const int64_t latency = get_ticks() - start;
+        if (relationship->outdated_read_latency == 0) {
+            relationship->outdated_read_latency = latency;
+        } else {
+            relationship->outdated_read_latency
+                += (latency - relationship->outdated_read_latency) / 8;
+        }
     } catch (const resource_lost_exc_t &) {
         failures->at(i).assign("lost contact with direct reader");
     } catch (const interrupted_exc_t &) {
@@ -434,10 +497,12 @@ void cluster_namespace_interface_t<protocol_t>::relationship_coroutine(peer_id_t
         relationship_record.region = region;
         relationship_record.master_access = master_access.has() ? master_access.get() : NULL;
         relationship_record.direct_reader_access = direct_reader_access.has() ? direct_reader_access.get() : NULL;
+        relationship_record.outdated_read_latency = 0;
 
         region_map_set_membership_t<protocol_t, relationship_t *> relationship_map_insertion(&relationships,
                                                                                              region,
                                                                                              &relationship_record);
+        master_routes_valid = false;
 
         if (is_start) {
             guarantee(start_count > 0);
@@ -462,6 +527,8 @@ void cluster_namespace_interface_t<protocol_t>::relationship_coroutine(peer_id_t
     } catch (const interrupted_exc_t &e) {
         /* ignore */
     }
+    // `relationship_map_insertion` may have taken our relationship out again.
+    master_routes_valid = false;
 
     if (is_start) {
         guarantee(start_count > 0);
@@ -88,9 +88,21 @@ private:
         typename protocol_t::region_t region;
         master_access_t<protocol_t> *master_access;
         resource_access_t<direct_reader_business_card_t<protocol_t> > *direct_reader_access;
+        /* A moving average of how long the peer's direct reader has taken to answer
+        our outdated reads, including the trip over the network. 0 until it has
+        answered one. */
+        int64_t outdated_read_latency;
         auto_drainer_t drainer;
     };
 
+    /* Which relationship's master takes the immediate ops for a region. */
+    class master_route_t {
+    public:
+        master_route_t() : master(NULL), too_many_masters(false) { }
+        relationship_t *master;
+        bool too_many_masters;
+    };
+
     /* The code for handling immediate reads is 99% the same as the code for
     handling writes, so it's factored out into the `dispatch_immediate_op()`
     function. */
@@ -108,6 +120,7 @@ private:
     public:
         typename protocol_t::read_t sharded_op;
         resource_access_t<direct_reader_business_card_t<protocol_t> > *direct_reader_access;
+        relationship_t *relationship;
         auto_drainer_t::lock_t keepalive;
     };
 
@@ -143,6 +156,12 @@ private:
             signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t);
 
+    /* Picks which of the remote direct readers for a shard to send an outdated
+    read to: the one that has been answering fastest, which is usually one in our
+    own datacenter. */
+    relationship_t *choose_remote_direct_reader(
+            const std::vector<relationship_t *> &candidates);
+
     void perform_outdated_read(
             boost::ptr_vector<outdated_read_info_t> *direct_readers_to_contact,
             std::vector<typename protocol_t::read_response_t> *results,
@@ -151,6 +170,10 @@ private:
             signal_t *interruptor)
         THROWS_NOTHING;
 
+    /* Works `master_routes` out again from `relationships` if they have changed
+    since it last was. */
+    const region_map_t<protocol_t, master_route_t> &get_master_routes();
+
     void update_registrants(bool is_start);
 
     static boost::optional<boost::optional<master_business_card_t<protocol_t> > > extract_master_business_card(const std::map<peer_id_t, cow_ptr_t<reactor_business_card_t<protocol_t> > > &map, const peer_id_t &peer, const reactor_activity_id_t &activity_id);
@@ -172,6 +195,12 @@ private:
     std::set<reactor_activity_id_t> handled_activity_ids;
     region_map_t<protocol_t, std::set<relationship_t *> > relationships;
 
+    /* The routing table for `dispatch_immediate_op()`, so that it doesn't have to
+    look through the sets of relationships on every op.  `relationship_coroutine()`
+    clears `master_routes_valid` whenever it changes `relationships`. */
+    region_map_t<protocol_t, master_route_t> master_routes;
+    bool master_routes_valid;
+
     /* `start_cond` will be pulsed when we have either successfully connected to
     or tried and failed to connect to every peer present when the constructor
     was called. `start_count` is the number of peers we're still waiting for. */
@@ -17,6 +17,12 @@
 class io_backender_t;
 template <class> class multistore_ptr_t;
 
+/* Whether a reactor that the blueprint makes primary may take over while some of
+the blueprint's other peers are unreachable (see `is_safe_for_us_to_be_primary()`).
+Off by default, because writes that only the lost peers acknowledged are then
+lost. */
+void set_reactor_fast_failover(bool enabled);
+
 template<class protocol_t>
 class reactor_t : public home_thread_mixin_t {
 public:
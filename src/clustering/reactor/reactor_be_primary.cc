@@ -18,6 +18,12 @@
 #include "config/args.hpp"
 #include "stl_utils.hpp"
 
+static bool reactor_fast_failover = false;
+
+void set_reactor_fast_failover(bool enabled) {
+    reactor_fast_failover = enabled;
+}
+
 template <class protocol_t>
 reactor_t<protocol_t>::backfill_candidate_t::backfill_candidate_t(version_range_t _version_range, std::vector<backfill_location_t> _places_to_get_this_version, bool _present_in_our_store)
     : version_range(_version_range), places_to_get_this_version(_places_to_get_this_version),
@@ -119,6 +125,12 @@ boost::optional<boost::optional<backfiller_business_card_t<protocol_t> > > extra
  * and the best_backfiller_out parameter will contain a set of backfillers we
  * can use to get the latest version of the data.
  * Otherwise it will return false and best_backfiller_out will be unmodified.
+ *
+ * With `--fast-failover`, peers that aren't connected (a primary that just went
+ * down, usually) don't hold us up as long as the peers we can see, us included,
+ * are a majority of the blueprint's and our store already has the latest version
+ * any of them knows of.  Then we can become primary without backfilling and
+ * without waiting for the lost peers to be declared dead.
  */
 template <class protocol_t>
 bool reactor_t<protocol_t>::is_safe_for_us_to_be_primary(const change_tracking_map_t<peer_id_t, cow_ptr_t<reactor_business_card_t<protocol_t> > > &_reactor_directory,
@@ -130,6 +142,7 @@ bool reactor_t<protocol_t>::is_safe_for_us_to_be_primary(const change_tracking_m
     typedef reactor_business_card_t<protocol_t> rb_t;
 
     best_backfiller_map_t res = *best_backfiller_out;
+    size_t missing_peers = 0;
 
     /* Iterator through the peers the blueprint claims we should be able to
      * see. */
@@ -145,7 +158,11 @@ bool reactor_t<protocol_t>::is_safe_for_us_to_be_primary(const change_tracking_m
 
         typename std::map<peer_id_t, cow_ptr_t<reactor_business_card_t<protocol_t> > >::const_iterator bcard_it = _reactor_directory.get_inner().find(p_it->first);
         if (bcard_it == _reactor_directory.get_inner().end()) {
-            return false;
+            if (!reactor_fast_failover) {
+                return false;
+            }
+            ++missing_peers;
+            continue;
         }
 
         std::vector<typename protocol_t::region_t> regions;
@@ -238,6 +255,18 @@ bool reactor_t<protocol_t>::is_safe_for_us_to_be_primary(const change_tracking_m
         }
     }
 
+    if (missing_peers != 0) {
+        const size_t num_peers = blueprint.peers_roles.size();
+        if (2 * (num_peers - missing_peers) <= num_peers) {
+            return false;
+        }
+        for (typename best_backfiller_map_t::iterator it = res.begin(); it != res.end(); ++it) {
+            if (!it->second.present_in_our_store) {
+                return false;
+            }
+        }
+    }
+
     *best_backfiller_out = res;
 
     *merge_branch_history_out = false;
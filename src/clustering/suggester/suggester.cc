@@ -1,6 +1,8 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/suggester/suggester.hpp"
 
+#include <algorithm>
+
 #include "stl_utils.hpp"
 #include "containers/priority_queue.hpp"
 #include "clustering/generic/nonoverlapping_regions.hpp"
@@ -15,6 +17,10 @@
 #define PRIMARY_USAGE_COST  10
 #define SECONDARY_USAGE_COST  8
 
+// With shard loads, a machine counts as running hot when the shards it's primary for
+// get this many times the average machine's share of the load.
+#define HOT_MACHINE_LOAD_FACTOR 1.25
+
 namespace {
 
 struct priority_t {
@@ -200,7 +206,9 @@ std::map<machine_id_t, blueprint_role_t> suggest_blueprint_for_shard(
         const std::set<machine_id_t> &primary_pinnings,
         const std::set<machine_id_t> &secondary_pinnings,
         std::map<machine_id_t, int> *usage,
-        bool prioritize_distribution) {
+        bool prioritize_distribution,
+        int primary_cost,
+        int secondary_cost) {
 
     std::map<machine_id_t, blueprint_role_t> sub_blueprint;
 
@@ -232,7 +240,7 @@ std::map<machine_id_t, blueprint_role_t> suggest_blueprint_for_shard(
         sub_blueprint[primary] = blueprint_role_primary;
 
         //Update primary_usage
-        (*usage)[primary] += PRIMARY_USAGE_COST;
+        (*usage)[primary] += primary_cost;
     }
 
 
@@ -253,7 +261,7 @@ std::map<machine_id_t, blueprint_role_t> suggest_blueprint_for_shard(
 
         for (std::vector<machine_id_t>::iterator jt = secondaries.begin(); jt != secondaries.end(); jt++) {
             //Update secondary usage
-            (*usage)[*jt] += SECONDARY_USAGE_COST;
+            (*usage)[*jt] += secondary_cost;
             sub_blueprint[*jt] = blueprint_role_secondary;
             unused_machines.erase(*jt);
         }
@@ -275,7 +283,7 @@ std::map<machine_id_t, blueprint_role_t> suggest_blueprint_for_shard(
         sub_blueprint[primary] = blueprint_role_primary;
 
         //Update primary_usage
-        (*usage)[primary] += PRIMARY_USAGE_COST;
+        (*usage)[primary] += primary_cost;
     }
 
     /* Finally pick the secondaries for the nil datacenter */
@@ -290,7 +298,7 @@ std::map<machine_id_t, blueprint_role_t> suggest_blueprint_for_shard(
 
         for (std::vector<machine_id_t>::iterator jt = secondaries.begin(); jt != secondaries.end(); jt++) {
             //Update secondary usage
-            (*usage)[*jt] += SECONDARY_USAGE_COST;
+            (*usage)[*jt] += secondary_cost;
             sub_blueprint[*jt] = blueprint_role_secondary;
             unused_machines.erase(*jt);
         }
@@ -306,6 +314,125 @@ std::map<machine_id_t, blueprint_role_t> suggest_blueprint_for_shard(
     return sub_blueprint;
 }
 
+/* How many times the average shard's load `shard` gets, or 1 if we don't know. */
+template <class protocol_t>
+double relative_shard_load(
+        const std::map<typename protocol_t::region_t, double> &shard_loads,
+        const typename protocol_t::region_t &shard) {
+    if (shard_loads.empty()) {
+        return 1;
+    }
+    double total = 0;
+    for (auto it = shard_loads.begin(); it != shard_loads.end(); ++it) {
+        total += it->second;
+    }
+    const double mean = total / shard_loads.size();
+    auto it = shard_loads.find(shard);
+    if (it == shard_loads.end() || mean <= 0) {
+        return 1;
+    }
+    return it->second / mean;
+}
+
+/* Hands the primary role for the shards of the hottest machine to one of their
+secondaries on a cooler machine, for as long as that makes the hottest machine less
+hot. Only machines that may be primaries are considered. */
+template <class protocol_t>
+void move_primaries_off_hot_machines(
+        const datacenter_id_t &primary_datacenter,
+        const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
+        const std::map<typename protocol_t::region_t, double> &shard_loads,
+        const std::map<typename protocol_t::region_t, std::set<machine_id_t> > &shard_primary_pinnings,
+        std::map<machine_id_t, int> *usage,
+        persistable_blueprint_t<protocol_t> *blueprint) {
+    typedef typename protocol_t::region_t region_t;
+
+    std::map<machine_id_t, double> primary_load;
+    std::map<region_t, machine_id_t> primaries;
+    for (auto it = blueprint->machines_roles.begin(); it != blueprint->machines_roles.end(); ++it) {
+        auto dc_it = machine_data_centers.find(it->first);
+        if (!primary_datacenter.is_nil()
+            && (dc_it == machine_data_centers.end() || dc_it->second != primary_datacenter)) {
+            continue;
+        }
+        primary_load[it->first] = 0;
+        for (auto jt = it->second.begin(); jt != it->second.end(); ++jt) {
+            if (jt->second == blueprint_role_primary) {
+                primary_load[it->first] += relative_shard_load<protocol_t>(shard_loads, jt->first);
+                primaries[jt->first] = it->first;
+            }
+        }
+    }
+    if (primary_load.empty()) {
+        return;
+    }
+    double total_load = 0;
+    for (auto it = primary_load.begin(); it != primary_load.end(); ++it) {
+        total_load += it->second;
+    }
+    const double hot_load = HOT_MACHINE_LOAD_FACTOR * total_load / primary_load.size();
+
+    /* Each move makes the hottest machine cooler, so this ends; the bound is there
+    in case of rounding. */
+    for (size_t moves = 0; moves < primaries.size(); ++moves) {
+        machine_id_t hottest = primary_load.begin()->first;
+        for (auto it = primary_load.begin(); it != primary_load.end(); ++it) {
+            if (it->second > primary_load[hottest]) {
+                hottest = it->first;
+            }
+        }
+        if (primary_load[hottest] <= hot_load) {
+            return;
+        }
+
+        bool moved = false;
+        for (auto it = primaries.begin(); it != primaries.end() && !moved; ++it) {
+            if (it->second != hottest) {
+                continue;
+            }
+            const region_t &shard = it->first;
+            const double load = relative_shard_load<protocol_t>(shard_loads, shard);
+            auto pin_it = shard_primary_pinnings.find(shard);
+            const bool pinned = pin_it != shard_primary_pinnings.end() && !pin_it->second.empty();
+            if (pinned && std_contains(pin_it->second, hottest)) {
+                continue;
+            }
+
+            /* The coolest secondary that would still be cooler than `hottest` is
+            now once it takes the shard. */
+            machine_id_t best = nil_uuid();
+            for (auto mt = primary_load.begin(); mt != primary_load.end(); ++mt) {
+                if (mt->first == hottest
+                    || blueprint->machines_roles[mt->first][shard] != blueprint_role_secondary
+                    || (pinned && !std_contains(pin_it->second, mt->first))
+                    || mt->second + load >= primary_load[hottest]) {
+                    continue;
+                }
+                if (best.is_nil() || mt->second < primary_load[best]) {
+                    best = mt->first;
+                }
+            }
+            if (best.is_nil()) {
+                continue;
+            }
+
+            blueprint->machines_roles[hottest][shard] = blueprint_role_secondary;
+            blueprint->machines_roles[best][shard] = blueprint_role_primary;
+            primary_load[hottest] -= load;
+            primary_load[best] += load;
+            const int cost_difference = static_cast<int>(
+                (PRIMARY_USAGE_COST - SECONDARY_USAGE_COST) * load + 0.5);
+            (*usage)[hottest] -= cost_difference;
+            (*usage)[best] += cost_difference;
+            it->second = best;
+            moved = true;
+        }
+        if (!moved) {
+            return;
+        }
+    }
+}
+
 template<class protocol_t>
 persistable_blueprint_t<protocol_t> suggest_blueprint(
         const std::map<machine_id_t, reactor_business_card_t<protocol_t> > &directory,
@@ -315,6 +442,7 @@ persistable_blueprint_t<protocol_t> suggest_blueprint(
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
         const region_map_t<protocol_t, machine_id_t> &primary_pinnings,
         const region_map_t<protocol_t, std::set<machine_id_t> > &secondary_pinnings,
+        const std::map<typename protocol_t::region_t, double> &shard_loads,
         std::map<machine_id_t, int> *usage,
         bool prioritize_distribution) {
 
@@ -322,6 +450,7 @@ persistable_blueprint_t<protocol_t> suggest_blueprint(
     typedef region_map_t<protocol_t, std::set<machine_id_t> > secondary_pinnings_map_t;
 
     persistable_blueprint_t<protocol_t> blueprint;
+    std::map<typename protocol_t::region_t, std::set<machine_id_t> > shard_primary_pinnings;
 
     for (typename nonoverlapping_regions_t<protocol_t>::iterator it = shards.begin();
             it != shards.end(); it++) {
@@ -343,18 +472,29 @@ persistable_blueprint_t<protocol_t> suggest_blueprint(
             machines_shard_secondary_is_pinned_to.insert(pit->second.begin(), pit->second.end());
         }
 
+        /* A shard with more load counts for more when we balance usage. */
+        const double load = relative_shard_load<protocol_t>(shard_loads, *it);
         std::map<machine_id_t, blueprint_role_t> shard_blueprint =
             suggest_blueprint_for_shard(directory, primary_datacenter,
                     datacenter_affinities, *it, machine_data_centers,
                     machines_shard_primary_is_pinned_to,
                     machines_shard_secondary_is_pinned_to, usage,
-                    prioritize_distribution);
+                    prioritize_distribution,
+                    std::max(1, static_cast<int>(PRIMARY_USAGE_COST * load + 0.5)),
+                    std::max(1, static_cast<int>(SECONDARY_USAGE_COST * load + 0.5)));
+        shard_primary_pinnings[*it] = machines_shard_primary_is_pinned_to;
         for (typename std::map<machine_id_t, blueprint_role_t>::iterator jt = shard_blueprint.begin();
                 jt != shard_blueprint.end(); jt++) {
             blueprint.machines_roles[jt->first][*it] = jt->second;
         }
     }
 
+    if (!shard_loads.empty()) {
+        move_primaries_off_hot_machines(primary_datacenter, machine_data_centers,
+                                        shard_loads, shard_primary_pinnings, usage,
+                                        &blueprint);
+    }
+
     return blueprint;
 }
 
@@ -370,6 +510,7 @@ persistable_blueprint_t<mock::dummy_protocol_t> suggest_blueprint<mock::dummy_pr
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
         const region_map_t<mock::dummy_protocol_t, machine_id_t> &primary_pinnings,
         const region_map_t<mock::dummy_protocol_t, std::set<machine_id_t> > &secondary_pinnings,
+        const std::map<mock::dummy_protocol_t::region_t, double> &shard_loads,
         std::map<machine_id_t, int> *usage,
         bool prioritize_distribution);
 
@@ -385,6 +526,7 @@ persistable_blueprint_t<memcached_protocol_t> suggest_blueprint<memcached_protoc
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
         const region_map_t<memcached_protocol_t, machine_id_t> &primary_pinnings,
         const region_map_t<memcached_protocol_t, std::set<machine_id_t> > &secondary_pinnings,
+        const std::map<memcached_protocol_t::region_t, double> &shard_loads,
         std::map<machine_id_t, int> *usage,
         bool prioritize_distribution);
 
@@ -400,5 +542,6 @@ persistable_blueprint_t<rdb_protocol_t> suggest_blueprint<rdb_protocol_t>(
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
         const region_map_t<rdb_protocol_t, machine_id_t> &primary_pinnings,
         const region_map_t<rdb_protocol_t, std::set<machine_id_t> > &secondary_pinnings,
+        const std::map<rdb_protocol_t::region_t, double> &shard_loads,
         std::map<machine_id_t, int> *usage,
         bool prioritize_distribution);
@@ -28,6 +28,14 @@ public:
 
 };
 
+/* Picks the machines for each shard's primary and secondaries, spreading the shards
+over the machines by `usage`, which it updates.
+
+`shard_loads` can give each shard's load (reads and writes per second, or size, in
+any unit as long as it's the same for all of them). Then a shard counts for its share
+of the load instead of the same as every other shard, and if the primaries still
+leave a machine hot, the primary role of some of its shards moves to one of their
+secondaries. */
 template<class protocol_t>
 persistable_blueprint_t<protocol_t> suggest_blueprint(
         const std::map<machine_id_t, reactor_business_card_t<protocol_t> > &directory,
@@ -37,6 +45,7 @@ persistable_blueprint_t<protocol_t> suggest_blueprint(
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
         const region_map_t<protocol_t, machine_id_t> &primary_pinnings,
         const region_map_t<protocol_t, std::set<machine_id_t> > &secondary_pinnings,
+        const std::map<typename protocol_t::region_t, double> &shard_loads,
         std::map<machine_id_t, int> *usage,
         bool prioritize_distribution);
 
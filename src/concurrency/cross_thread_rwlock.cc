@@ -0,0 +1,164 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "concurrency/cross_thread_rwlock.hpp"
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/runtime.hpp"
+#include "arch/runtime/thread_pool.hpp"
+
+cross_thread_rwlock_t::acq_t::acq_t(cross_thread_rwlock_t *l, access_t access)
+    : lock_(NULL), shard_(0), access_(access) {
+    reset(l, access);
+}
+
+cross_thread_rwlock_t::acq_t::~acq_t() {
+    reset();
+}
+
+void cross_thread_rwlock_t::acq_t::reset() {
+    if (lock_) {
+        if (access_ == access_t::read) {
+            lock_->unlock_read(shard_);
+        } else {
+            lock_->unlock_write();
+        }
+    }
+    lock_ = NULL;
+}
+
+void cross_thread_rwlock_t::acq_t::reset(cross_thread_rwlock_t *l, access_t access) {
+    reset();
+    lock_ = l;
+    access_ = access;
+    if (access_ == access_t::read) {
+        shard_ = lock_->co_lock_read();
+    } else {
+        lock_->co_lock_write();
+    }
+}
+
+cross_thread_rwlock_t::cross_thread_rwlock_t()
+    : writer_in(false), draining_writer(NULL), shards_to_drain(0) {
+    // Static objects are constructed before there is a thread pool to tell us how
+    // many threads there are.  Their readers all share one shard.
+    shards.init(linux_thread_pool_t::get_thread_pool() != NULL ? get_num_threads() : 1);
+}
+
+cross_thread_rwlock_t::~cross_thread_rwlock_t() {
+#ifndef NDEBUG
+    for (size_t i = 0; i < shards.size(); ++i) {
+        spinlock_acq_t acq(&shards[i].value.spinlock);
+        rassert(shards[i].value.readers == 0);
+        rassert(!shards[i].value.blocked);
+    }
+    spinlock_acq_t acq(&writers_spinlock);
+    rassert(!writer_in);
+#endif
+}
+
+size_t cross_thread_rwlock_t::co_lock_read() {
+    const size_t shard = get_thread_id().threadnum % shards.size();
+    shard_t *s = &shards[shard].value;
+    bool do_wait = false;
+    {
+        spinlock_acq_t acq(&s->spinlock);
+        if (s->blocked) {
+            guarantee(coro_t::self() != NULL);
+            s->waiting_readers.push_back(coro_t::self());
+            do_wait = true;
+        } else {
+            ++s->readers;
+        }
+    }
+    if (do_wait) {
+        // `unlock_write()` counts us in before it wakes us up.
+        coro_t::wait();
+    }
+    return shard;
+}
+
+void cross_thread_rwlock_t::unlock_read(size_t shard) {
+    shard_t *s = &shards[shard].value;
+    coro_t *writer = NULL;
+    {
+        spinlock_acq_t acq(&s->spinlock);
+        rassert(s->readers > 0);
+        --s->readers;
+        if (s->readers == 0 && s->writer_waiting) {
+            s->writer_waiting = false;
+            if (__sync_sub_and_fetch(&shards_to_drain, 1) == 0) {
+                writer = draining_writer;
+            }
+        }
+    }
+    if (writer != NULL) {
+        writer->notify_sometime();
+    }
+}
+
+void cross_thread_rwlock_t::co_lock_write() {
+    bool do_wait = false;
+    {
+        spinlock_acq_t acq(&writers_spinlock);
+        if (writer_in) {
+            guarantee(coro_t::self() != NULL);
+            waiting_writers.push_back(coro_t::self());
+            do_wait = true;
+        } else {
+            writer_in = true;
+        }
+    }
+    if (do_wait) {
+        // `unlock_write()` hands `writer_in` over to us.
+        coro_t::wait();
+    }
+
+    draining_writer = coro_t::self();
+    shards_to_drain = 1;
+    for (size_t i = 0; i < shards.size(); ++i) {
+        shard_t *s = &shards[i].value;
+        spinlock_acq_t acq(&s->spinlock);
+        s->blocked = true;
+        if (s->readers > 0) {
+            s->writer_waiting = true;
+            __sync_add_and_fetch(&shards_to_drain, 1);
+        }
+    }
+    if (__sync_sub_and_fetch(&shards_to_drain, 1) != 0) {
+        guarantee(draining_writer != NULL,
+            "Tried to write-lock a cross_thread_rwlock_t with readers outside of a "
+            "coroutine.");
+        coro_t::wait();
+    }
+}
+
+void cross_thread_rwlock_t::unlock_write() {
+    // Let in the readers that came while we had the lock before the next writer gets
+    // in line behind them.
+    for (size_t i = 0; i < shards.size(); ++i) {
+        shard_t *s = &shards[i].value;
+        spinlock_acq_t acq(&s->spinlock);
+        rassert(s->blocked);
+        rassert(s->readers == 0);
+        s->blocked = false;
+        s->readers = s->waiting_readers.size();
+        for (auto it = s->waiting_readers.begin(); it != s->waiting_readers.end(); ++it) {
+            (*it)->notify_sometime();
+        }
+        s->waiting_readers.clear();
+    }
+
+    coro_t *next = NULL;
+    {
+        spinlock_acq_t acq(&writers_spinlock);
+        rassert(writer_in);
+        if (waiting_writers.empty()) {
+            writer_in = false;
+        } else {
+            next = waiting_writers.front();
+            waiting_writers.pop_front();
+        }
+    }
+    if (next != NULL) {
+        next->notify_sometime();
+    }
+}
@@ -0,0 +1,84 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CONCURRENCY_CROSS_THREAD_RWLOCK_HPP_
+#define CONCURRENCY_CROSS_THREAD_RWLOCK_HPP_
+
+#include <stdint.h>
+
+#include <deque>
+
+#include "arch/spinlock.hpp"
+#include "concurrency/access.hpp"
+#include "concurrency/cache_line_padded.hpp"
+#include "containers/scoped.hpp"
+
+class coro_t;
+
+/* `cross_thread_rwlock_t` is a read/write lock for read-mostly structures that are
+ * read from coroutines on any thread.  `rwlock_t` can only be used on its home
+ * thread, and `cross_thread_mutex_t` lets in one reader at a time.  Here a reader
+ * only touches a counter kept for the thread it's on, so readers on different
+ * threads don't contend and nobody has to switch threads.
+ *
+ * Writers pay for that: a writer stops new readers on every thread and waits for
+ * the ones already in.  The lock is phase-fair.  A writer waits only for the
+ * readers that got in before it.  Readers that come while a writer is in line or
+ * holding the lock all get in together when it releases, before the next writer.
+ * So neither side starves.
+ *
+ * Read acquisition is not recursive.  A coroutine that takes the read lock again
+ * while a writer is in line deadlocks. */
+class cross_thread_rwlock_t {
+public:
+    class acq_t {
+    public:
+        acq_t() : lock_(NULL), shard_(0), access_(access_t::read) { }
+        acq_t(cross_thread_rwlock_t *l, access_t access);
+        ~acq_t();
+        void reset();
+        void reset(cross_thread_rwlock_t *l, access_t access);
+    private:
+        cross_thread_rwlock_t *lock_;
+        // The shard a reader is counted in, in case it moves to another thread.
+        size_t shard_;
+        access_t access_;
+        DISABLE_COPYING(acq_t);
+    };
+
+    cross_thread_rwlock_t();
+    ~cross_thread_rwlock_t();
+
+private:
+    struct shard_t {
+        shard_t() : readers(0), blocked(false), writer_waiting(false) { }
+        spinlock_t spinlock;
+        int readers;
+        // Set while a writer is in line for the lock or holding it.  New readers
+        // wait in `waiting_readers` then.
+        bool blocked;
+        // Whether the writer is waiting for this shard's readers to leave.
+        bool writer_waiting;
+        std::deque<coro_t *> waiting_readers;
+    };
+
+    // These are private. Use `acq_t` to lock and unlock.
+    size_t co_lock_read();
+    void unlock_read(size_t shard);
+    void co_lock_write();
+    void unlock_write();
+
+    scoped_array_t<cache_line_padded_t<shard_t> > shards;
+
+    spinlock_t writers_spinlock;
+    // Whether a writer holds the lock or is waiting for the readers to leave.
+    bool writer_in;
+    std::deque<coro_t *> waiting_writers;
+
+    // The writer that is waiting for readers to leave, and how many shards it is
+    // waiting on.  The count is one higher while the writer is still blocking shards.
+    coro_t *draining_writer;
+    intptr_t shards_to_drain;
+
+    DISABLE_COPYING(cross_thread_rwlock_t);
+};
+
+#endif /* CONCURRENCY_CROSS_THREAD_RWLOCK_HPP_ */
@@ -2,6 +2,8 @@
 #ifndef CONCURRENCY_CROSS_THREAD_SEMAPHORE_HPP_
 #define CONCURRENCY_CROSS_THREAD_SEMAPHORE_HPP_
 
+#include <functional>
+
 #include "containers/scoped.hpp"
 #include "containers/intrusive_list.hpp"
 #include "concurrency/interruptor.hpp"
@@ -32,7 +34,14 @@ public:
     class lock_t {
     public:
         explicit lock_t(cross_thread_semaphore_t *_parent, signal_t *interruptor) :
-            parent(_parent), value(parent->lock(interruptor)) { }
+            parent(_parent), value(parent->lock(interruptor, nullptr)) { }
+
+        // Takes an available element that `prefer` returns true for, if there is
+        //  one.  `prefer` is called with the semaphore's mutex held, on elements
+        //  nobody has locked.
+        lock_t(cross_thread_semaphore_t *_parent, signal_t *interruptor,
+               const std::function<bool(const value_t *)> &prefer) :
+            parent(_parent), value(parent->lock(interruptor, prefer)) { }
 
         ~lock_t() {
             parent->unlock(value);
@@ -92,7 +101,8 @@ private:
         request_node_t *request;
     };
 
-    value_t *lock(signal_t *interruptor);
+    value_t *lock(signal_t *interruptor,
+                  const std::function<bool(const value_t *)> &prefer);
     void unlock(value_t *value);
 
     // Mutex to control access, since a lock may be constructed from any thread
@@ -114,7 +124,7 @@ private:
 template <class value_t>
 cross_thread_semaphore_t<value_t>::~cross_thread_semaphore_t() {
     for (size_t i = 0; i < values.size(); ++i) {
-        delete lock(NULL);
+        delete lock(NULL, nullptr);
     }
 }
 
@@ -134,7 +144,9 @@ void cross_thread_semaphore_t<value_t>::pass_value_coroutine(request_node_t *req
 }
 
 template <class value_t>
-value_t *cross_thread_semaphore_t<value_t>::lock(signal_t *interruptor) {
+value_t *cross_thread_semaphore_t<value_t>::lock(
+        signal_t *interruptor,
+        const std::function<bool(const value_t *)> &prefer) {
     system_mutex_t::lock_t lock(&mutex);
     value_t *result = NULL;
 
@@ -143,6 +155,16 @@ value_t *cross_thread_semaphore_t<value_t>::lock(signal_t *interruptor) {
         lock.unlock();
         result = request.wait_and_get(interruptor);
     } else {
+        // The available elements are the ones from `available_value_index` on, so
+        //  a preferred one gets swapped to the front of them
+        if (prefer) {
+            for (size_t i = available_value_index + 1; i < values.size(); ++i) {
+                if (prefer(values[i])) {
+                    std::swap(values[i], values[available_value_index]);
+                    break;
+                }
+            }
+        }
         result = values[available_value_index];
         values[available_value_index] = NULL;
         ++available_value_index;
@@ -4,14 +4,21 @@
 
 #include "concurrency/watchable.hpp"
 #include "concurrency/auto_drainer.hpp"
-#include "concurrency/queue/single_value_producer.hpp"
+#include "concurrency/queue/passive_producer.hpp"
 #include "concurrency/coro_pool.hpp"
+#include "containers/cow_ptr.hpp"
 
 /* `cross_thread_watchable_variable_t` is used to "proxy" a `watchable_t` from
 one thread to another. Create the `cross_thread_watchable_variable_t` on the
 source thread; then call `get_watchable()`, and you will get a watchable that is
 usable on the `_dest_thread` that you passed to the constructor.
 
+Changes are coalesced. While a value is on its way to `_dest_thread`, further
+changes only mark the proxy out of date; when the delivery finishes, whatever
+the value is by then gets copied and sent. The copy is made once on the source
+thread and handed over in a `cow_ptr_t`, so the destination thread doesn't copy
+it again.
+
 See also: `cross_thread_signal_t`, which is the same thing for `signal_t`. */
 
 template <class value_t>
@@ -30,7 +37,7 @@ public:
 private:
     friend class cross_thread_watcher_subscription_t;
     void on_value_changed();
-    void deliver(value_t new_value);
+    void deliver(cow_ptr_t<value_t> new_value);
 
     static void call(const boost::function<void()> &f) {
         f();
@@ -38,7 +45,7 @@ private:
 
     void apply_read(const std::function<void(const value_t*)> &read) {
         ASSERT_NO_CORO_WAITING;
-        read(const_cast<const value_t *>(&value));
+        read(value.get());
     }
 
     class w_t : public watchable_t<value_t> {
@@ -49,7 +56,7 @@ private:
             return new w_t(parent);
         }
         value_t get() {
-            return parent->value;
+            return *parent->value;
         }
         void apply_read(const std::function<void(const value_t*)> &read) {
             return parent->apply_read(read);
@@ -69,7 +76,7 @@ private:
     clone_ptr_t<watchable_t<value_t> > original;
     publisher_controller_t<boost::function<void()> > publisher_controller;
     rwi_lock_assertion_t rwi_lock_assertion;
-    value_t value;
+    cow_ptr_t<value_t> value;
     w_t watchable;
 
     threadnum_t watchable_thread;
@@ -103,9 +110,30 @@ private:
     `auto_drainer_t::lock_t`. */
     typename watchable_t<value_t>::subscription_t subs;
 
-    single_value_producer_t<value_t> value_producer;
-    boost_function_callback_t<value_t> deliver_cb;
-    coro_pool_t<value_t> messanger_pool;
+    /* Hands out the latest value of `original` when `messanger_pool` is ready to
+    deliver one. It doesn't copy the value until then, so changes that come in
+    while a delivery is in flight cost nothing. */
+    class latest_value_producer_t : public passive_producer_t<cow_ptr_t<value_t> > {
+    public:
+        explicit latest_value_producer_t(cross_thread_watchable_variable_t *p) :
+            passive_producer_t<cow_ptr_t<value_t> >(&availability_control),
+            parent(p) { }
+        void mark_changed() {
+            availability_control.set_available(true);
+        }
+    private:
+        cow_ptr_t<value_t> produce_next_value() {
+            availability_control.set_available(false);
+            cow_ptr_t<value_t> latest;
+            parent->original->apply_read(
+                [&](const value_t *v) { latest.set(*v); });
+            return latest;
+        }
+        cross_thread_watchable_variable_t *parent;
+        availability_control_t availability_control;
+    } value_producer;
+    boost_function_callback_t<cow_ptr_t<value_t> > deliver_cb;
+    coro_pool_t<cow_ptr_t<value_t> > messanger_pool;
 
     DISABLE_COPYING(cross_thread_watchable_variable_t);
 };
@@ -10,23 +10,25 @@ cross_thread_watchable_variable_t<value_t>::cross_thread_watchable_variable_t(co
     dest_thread(_dest_thread),
     rethreader(this),
     subs(boost::bind(&cross_thread_watchable_variable_t<value_t>::on_value_changed, this)),
+    value_producer(this),
     deliver_cb(boost::bind(&cross_thread_watchable_variable_t<value_t>::deliver, this, _1)),
     messanger_pool(1, &value_producer, &deliver_cb) //Note it's very important that this coro_pool only have one worker it will be a race condition if it has more
 {
     rassert(original->get_rwi_lock_assertion()->home_thread() == watchable_thread);
     typename watchable_t<value_t>::freeze_t freeze(original);
-    value = original->get();
+    original->apply_read([&](const value_t *v) { value.set(*v); });
     subs.reset(original, &freeze);
 }
 
 template <class value_t>
 void cross_thread_watchable_variable_t<value_t>::on_value_changed() {
-    value_producer.give_value(original->get());
+    value_producer.mark_changed();
 }
 
 template <class value_t>
-void cross_thread_watchable_variable_t<value_t>::deliver(value_t new_value) {
+void cross_thread_watchable_variable_t<value_t>::deliver(cow_ptr_t<value_t> new_value) {
     on_thread_t thread_switcher(dest_thread);
+    // Shares `new_value`'s copy instead of making another one on this thread.
     value = new_value;
     publisher_controller.publish(&cross_thread_watchable_variable_t<value_t>::call);
 }
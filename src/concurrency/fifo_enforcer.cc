@@ -50,8 +50,13 @@ void fifo_enforcer_sink_t::exit_read_t::begin(fifo_enforcer_sink_t *p, fifo_enfo
 
     parent->assert_thread();
     mutex_assertion_t::acq_t acq(&parent->internal_lock);
-    parent->internal_read_queue.push(this);
-    parent->internal_pump();
+    if (parent->can_skip_queue(token)) {
+        parent->popped_state.advance_by_read(token);
+        pulse();
+    } else {
+        parent->internal_read_queue.push(this);
+        parent->internal_pump();
+    }
 }
 
 void fifo_enforcer_sink_t::exit_read_t::end() THROWS_NOTHING {
@@ -112,8 +117,13 @@ void fifo_enforcer_sink_t::exit_write_t::begin(fifo_enforcer_sink_t *p, fifo_enf
 
     parent->assert_thread();
     mutex_assertion_t::acq_t acq(&parent->internal_lock);
-    parent->internal_write_queue.push(this);
-    parent->internal_pump();
+    if (parent->can_skip_queue(token)) {
+        parent->popped_state.advance_by_write(token);
+        pulse();
+    } else {
+        parent->internal_write_queue.push(this);
+        parent->internal_pump();
+    }
 }
 
 void fifo_enforcer_sink_t::exit_write_t::end() THROWS_NOTHING {
@@ -166,6 +176,16 @@ fifo_enforcer_sink_t::~fifo_enforcer_sink_t() THROWS_NOTHING {
     }
 }
 
+bool fifo_enforcer_sink_t::can_skip_queue(fifo_enforcer_read_token_t token) const THROWS_NOTHING {
+    return !in_pump && token.timestamp == finished_state.timestamp;
+}
+
+bool fifo_enforcer_sink_t::can_skip_queue(fifo_enforcer_write_token_t token) const THROWS_NOTHING {
+    return !in_pump
+        && token.timestamp.timestamp_before() == finished_state.timestamp
+        && token.num_preceding_reads == finished_state.num_reads;
+}
+
 void fifo_enforcer_sink_t::internal_pump() THROWS_NOTHING {
     ASSERT_FINITE_CORO_WAITING;
     if (in_pump) {
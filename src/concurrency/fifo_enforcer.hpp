@@ -254,6 +254,14 @@ public:
     intrusive_priority_queue_t<internal_exit_write_t> internal_write_queue;
 
 private:
+    /* Whether a token that just arrived could go through right away. The queues
+    can't hold anything that could go through, because `internal_pump()` lets
+    those through as soon as they can go. So in that case an arriving
+    `exit_{read,write}_t` doesn't need to get in line. That is the usual case,
+    because tokens mostly arrive in order. */
+    bool can_skip_queue(fifo_enforcer_read_token_t token) const THROWS_NOTHING;
+    bool can_skip_queue(fifo_enforcer_write_token_t token) const THROWS_NOTHING;
+
     /* The difference between `popped_state` and `finished_state` is the
     operations that are currently running. They have been popped off the queue,
     but they have not finished. */
@@ -2,6 +2,7 @@
 #ifndef CONCURRENCY_FIFO_ENFORCER_QUEUE_HPP_
 #define CONCURRENCY_FIFO_ENFORCER_QUEUE_HPP_
 
+#include <deque>
 #include <map>
 #include <utility>
 
@@ -16,7 +17,11 @@ void run_FIFOEnforcer_QueueEquivalence();
 
 /* `fifo_enforcer_queue_t` consumes FIFO read and write tokens just like
 `fifo_enforcer_sink_t` does, but it uses them to order items in a queue instead
-of using them to block up coroutines. */
+of using them to block up coroutines.
+
+Items almost always arrive in token order, so those go into a plain FIFO and
+come out of its front. The maps are only used once something arrives out of
+order; from then on everything goes into the maps until they drain. */
 
 template <class T>
 class fifo_enforcer_queue_t : public passive_producer_t<T>, public home_thread_mixin_debug_only_t {
@@ -31,6 +36,28 @@ public:
     void finish_write(fifo_enforcer_write_token_t write_token);
 
 private:
+    struct in_order_entry_t {
+        in_order_entry_t(fifo_enforcer_read_token_t token, const T &t)
+            : is_write(false), read_token(token), value(t) { }
+        in_order_entry_t(fifo_enforcer_write_token_t token, const T &t)
+            : is_write(true), write_token(token), value(t) { }
+        bool is_write;
+        fifo_enforcer_read_token_t read_token;
+        fifo_enforcer_write_token_t write_token;
+        T value;
+    };
+
+    bool out_of_order_queues_empty() const {
+        return read_queue.empty() && write_queue.empty();
+    }
+    bool can_pop_in_order() const;
+    void on_out_of_order_pop();
+
+    /* Items that arrived in order, as long as nothing came out of order.
+    `arrived_state` is where the next item has to pick up to go in here. */
+    std::deque<in_order_entry_t> in_order_queue;
+    fifo_enforcer_state_t arrived_state;
+
     typedef std::multimap<state_timestamp_t, T> read_queue_t;
     read_queue_t read_queue;
 
@@ -39,7 +66,9 @@ private:
 
     mutex_assertion_t lock;
 
-    fifo_enforcer_state_t state;
+    /* `state` counts the items that have finished; `produced_state` counts the
+    ones that have been handed out. */
+    fifo_enforcer_state_t state, produced_state;
 
     perfmon_counter_t *read_counter, *write_counter;
 
@@ -7,13 +7,19 @@
 
 template <class T>
 fifo_enforcer_queue_t<T>::fifo_enforcer_queue_t()
-    : passive_producer_t<T>(&control), state(state_timestamp_t::zero(), 0),
+    : passive_producer_t<T>(&control),
+      arrived_state(state_timestamp_t::zero(), 0),
+      state(state_timestamp_t::zero(), 0),
+      produced_state(state_timestamp_t::zero(), 0),
       read_counter(NULL), write_counter(NULL)
 { }
 
 template <class T>
 fifo_enforcer_queue_t<T>::fifo_enforcer_queue_t(perfmon_counter_t *_read_counter, perfmon_counter_t *_write_counter)
-    : passive_producer_t<T>(&control), state(state_timestamp_t::zero(), 0),
+    : passive_producer_t<T>(&control),
+      arrived_state(state_timestamp_t::zero(), 0),
+      state(state_timestamp_t::zero(), 0),
+      produced_state(state_timestamp_t::zero(), 0),
       read_counter(_read_counter), write_counter(_write_counter)
 { }
 
@@ -27,7 +33,12 @@ void fifo_enforcer_queue_t<T>::push(fifo_enforcer_read_token_t token, const T &t
     assert_thread();
     DEBUG_VAR mutex_assertion_t::acq_t acq(&lock);
 
-    read_queue.insert(std::make_pair(token.timestamp, t));
+    if (out_of_order_queues_empty() && token.timestamp == arrived_state.timestamp) {
+        in_order_queue.push_back(in_order_entry_t(token, t));
+        arrived_state.advance_by_read(token);
+    } else {
+        read_queue.insert(std::make_pair(token.timestamp, t));
+    }
     consider_changing_available();
 }
 
@@ -50,7 +61,15 @@ void fifo_enforcer_queue_t<T>::push(fifo_enforcer_write_token_t token, const T &
     assert_thread();
     DEBUG_VAR mutex_assertion_t::acq_t acq(&lock);
 
-    write_queue.insert(std::make_pair(token.timestamp, std::make_pair(token.num_preceding_reads, t)));
+    if (out_of_order_queues_empty()
+            && token.timestamp.timestamp_before() == arrived_state.timestamp
+            && token.num_preceding_reads == arrived_state.num_reads) {
+        in_order_queue.push_back(in_order_entry_t(token, t));
+        arrived_state.advance_by_write(token);
+    } else {
+        write_queue.insert(std::make_pair(token.timestamp,
+                                          std::make_pair(token.num_preceding_reads, t)));
+    }
     consider_changing_available();
 }
 
@@ -68,12 +87,41 @@ void fifo_enforcer_queue_t<T>::finish_write(fifo_enforcer_write_token_t write_to
     consider_changing_available();
 }
 
+template <class T>
+bool fifo_enforcer_queue_t<T>::can_pop_in_order() const {
+    if (in_order_queue.empty()) {
+        return false;
+    }
+    const in_order_entry_t &front = in_order_queue.front();
+    if (front.is_write) {
+        return front.write_token.timestamp.timestamp_before() == state.timestamp
+            && front.write_token.num_preceding_reads == state.num_reads;
+    } else {
+        return front.read_token.timestamp == state.timestamp;
+    }
+}
+
 template <class T>
 T fifo_enforcer_queue_t<T>::produce_next_value() {
+    if (can_pop_in_order()) {
+        in_order_entry_t &front = in_order_queue.front();
+        if (front.is_write) {
+            produced_state.advance_by_write(front.write_token);
+        } else {
+            produced_state.advance_by_read(front.read_token);
+        }
+        T res = front.value;
+        in_order_queue.pop_front();
+        consider_changing_available();
+        return res;
+    }
+
     typename read_queue_t::iterator rit = read_queue.find(state.timestamp);
     if (rit != read_queue.end()) {
         T res = rit->second;
+        produced_state.advance_by_read(fifo_enforcer_read_token_t(rit->first));
         read_queue.erase(rit);
+        on_out_of_order_pop();
         consider_changing_available();
         return res;
     }
@@ -86,7 +134,10 @@ T fifo_enforcer_queue_t<T>::produce_next_value() {
 
         if (state.num_reads == expected_num_reads) {
             T res = wit->second.second;
+            produced_state.advance_by_write(
+                fifo_enforcer_write_token_t(wit->first, expected_num_reads));
             write_queue.erase(wit);
+            on_out_of_order_pop();
             consider_changing_available();
             return res;
         }
@@ -97,9 +148,22 @@ T fifo_enforcer_queue_t<T>::produce_next_value() {
     return T();
 }
 
+template <class T>
+void fifo_enforcer_queue_t<T>::on_out_of_order_pop() {
+    /* Everything that has arrived so far has now been handed out, because the
+    in-order items all come before the out-of-order ones. So arrivals can go
+    back to the in-order queue, picking up where the handed-out ones left off. */
+    if (out_of_order_queues_empty()) {
+        rassert(in_order_queue.empty());
+        arrived_state = produced_state;
+    }
+}
+
 template <class T>
 void fifo_enforcer_queue_t<T>::consider_changing_available() {
-    if (std_contains(read_queue, state.timestamp)) {
+    if (can_pop_in_order()) {
+        control.set_available(true);
+    } else if (std_contains(read_queue, state.timestamp)) {
         control.set_available(true);
     } else if (std_contains(write_queue, transition_timestamp_t::starting_from(state.timestamp)) &&
             write_queue.find(transition_timestamp_t::starting_from(state.timestamp))->second.first == state.num_reads) {
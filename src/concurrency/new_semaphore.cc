@@ -1,15 +1,32 @@
 #include "concurrency/new_semaphore.hpp"
 
 new_semaphore_t::new_semaphore_t(int64_t capacity)
-    : capacity_(capacity), current_(0) { }
+    : capacity_(capacity), current_(0),
+      normal_weight_(1), background_weight_(1),
+      normal_turns_(1), background_turns_(1) { }
 
 new_semaphore_t::~new_semaphore_t() {
     guarantee(current_ == 0);
     guarantee(waiters_.empty());
+    guarantee(background_waiters_.empty());
+}
+
+void new_semaphore_t::set_priority_weights(int64_t normal_weight,
+                                           int64_t background_weight) {
+    guarantee(normal_weight > 0);
+    guarantee(background_weight > 0);
+    normal_weight_ = normal_weight;
+    background_weight_ = background_weight;
+    normal_turns_ = normal_weight;
+    background_turns_ = background_weight;
+}
+
+intrusive_list_t<new_semaphore_acq_t> *new_semaphore_t::line(semaphore_priority_t priority) {
+    return priority == semaphore_priority_t::normal ? &waiters_ : &background_waiters_;
 }
 
 void new_semaphore_t::add_acquirer(new_semaphore_acq_t *acq) {
-    waiters_.push_back(acq);
+    line(acq->priority_)->push_back(acq);
     pulse_waiters();
 }
 
@@ -18,16 +35,34 @@ void new_semaphore_t::remove_acquirer(new_semaphore_acq_t *acq) {
     if (acq->cond_.is_pulsed()) {
         current_ -= acq->count_;
     } else {
-        waiters_.remove(acq);
+        line(acq->priority_)->remove(acq);
     }
     pulse_waiters();
 }
 
+intrusive_list_t<new_semaphore_acq_t> *new_semaphore_t::next_line() {
+    if (background_waiters_.empty()) {
+        return waiters_.empty() ? NULL : &waiters_;
+    } else if (waiters_.empty()) {
+        return &background_waiters_;
+    }
+    if (normal_turns_ == 0 && background_turns_ == 0) {
+        normal_turns_ = normal_weight_;
+        background_turns_ = background_weight_;
+    }
+    return normal_turns_ > 0 ? &waiters_ : &background_waiters_;
+}
+
 void new_semaphore_t::pulse_waiters() {
-    while (new_semaphore_acq_t *acq = waiters_.head()) {
+    while (intrusive_list_t<new_semaphore_acq_t> *next = next_line()) {
+        new_semaphore_acq_t *acq = next->head();
         if (acq->count_ <= capacity_ - current_ || current_ == 0) {
+            // Turns only count while the two lines compete.
+            if (!waiters_.empty() && !background_waiters_.empty()) {
+                --(next == &waiters_ ? normal_turns_ : background_turns_);
+            }
             current_ += acq->count_;
-            waiters_.remove(acq);
+            next->remove(acq);
             acq->cond_.pulse();
         } else {
             break;
@@ -44,24 +79,28 @@ void new_semaphore_acq_t::reset() {
         semaphore_->remove_acquirer(this);
         semaphore_ = NULL;
         count_ = 0;
+        priority_ = semaphore_priority_t::normal;
         cond_.reset();
     }
 }
 
 new_semaphore_acq_t::new_semaphore_acq_t()
-    : semaphore_(NULL), count_(0) { }
+    : semaphore_(NULL), count_(0), priority_(semaphore_priority_t::normal) { }
 
-new_semaphore_acq_t::new_semaphore_acq_t(new_semaphore_t *semaphore, int64_t count)
-    : semaphore_(NULL), count_(0) {
-    init(semaphore, count);
+new_semaphore_acq_t::new_semaphore_acq_t(new_semaphore_t *semaphore, int64_t count,
+                                         semaphore_priority_t priority)
+    : semaphore_(NULL), count_(0), priority_(semaphore_priority_t::normal) {
+    init(semaphore, count, priority);
 }
 
-void new_semaphore_acq_t::init(new_semaphore_t *semaphore, int64_t count) {
+void new_semaphore_acq_t::init(new_semaphore_t *semaphore, int64_t count,
+                               semaphore_priority_t priority) {
     guarantee(semaphore_ == NULL);
     rassert(count_ == 0);
     guarantee(count >= 0);
     semaphore_ = semaphore;
     count_ = count;
+    priority_ = priority;
     semaphore_->add_acquirer(this);
 }
 
@@ -69,6 +108,7 @@ new_semaphore_acq_t::new_semaphore_acq_t(new_semaphore_acq_t &&movee)
     : intrusive_list_node_t<new_semaphore_acq_t>(std::move(movee)),
       semaphore_(movee.semaphore_),
       count_(movee.count_),
+      priority_(movee.priority_),
       cond_(std::move(movee.cond_)) {
     movee.semaphore_ = NULL;
     movee.count_ = 0;
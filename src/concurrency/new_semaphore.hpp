@@ -2,6 +2,7 @@
 #ifndef CONCURRENCY_NEW_SEMAPHORE_HPP_
 #define CONCURRENCY_NEW_SEMAPHORE_HPP_
 
+#include "arch/runtime/small_object_allocator.hpp"
 #include "concurrency/cond_var.hpp"
 #include "containers/intrusive_list.hpp"
 
@@ -11,9 +12,16 @@
 // new_semaphore_acq_t's will receive access to the semaphore in the same order that
 // such access was requested.  Also, there aren't problems with starvation.  Also, it
 // doesn't have naked lock and unlock functions, you have to use new_semaphore_acq_t.
+//
+// That order is kept per priority.  Normal and background acquirers wait in
+// separate lines.  When both lines have waiters, the semaphore takes from them in
+// turns by their weights (see set_priority_weights()), so background work can't
+// crowd out normal work and still gets its share.
 
 class new_semaphore_acq_t;
 
+enum class semaphore_priority_t { normal, background };
+
 class new_semaphore_t {
 public:
     explicit new_semaphore_t(int64_t capacity);
@@ -22,12 +30,20 @@ public:
     int64_t capacity() const { return capacity_; }
     int64_t current() const { return current_; }
 
+    // While both lines have waiters, for every `normal_weight` normal acquirers
+    // that get the semaphore, `background_weight` background ones do.  Both are
+    // 1 by default.
+    void set_priority_weights(int64_t normal_weight, int64_t background_weight);
+
 private:
     friend class new_semaphore_acq_t;
     void add_acquirer(new_semaphore_acq_t *acq);
     void remove_acquirer(new_semaphore_acq_t *acq);
 
     void pulse_waiters();
+    // The line whose head is next in turn, or NULL if nobody is waiting.
+    intrusive_list_t<new_semaphore_acq_t> *next_line();
+    intrusive_list_t<new_semaphore_acq_t> *line(semaphore_priority_t priority);
 
     // Normally, current_ <= capacity_, and capacity_ doesn't change.  current_ can
     // exceed capacity_ for three reasons.
@@ -38,19 +54,30 @@ private:
     int64_t current_;
 
     intrusive_list_t<new_semaphore_acq_t> waiters_;
+    intrusive_list_t<new_semaphore_acq_t> background_waiters_;
+
+    int64_t normal_weight_;
+    int64_t background_weight_;
+    // How many more acquirers of each priority get their turn before the weights
+    // start a new round.
+    int64_t normal_turns_;
+    int64_t background_turns_;
 
     DISABLE_COPYING(new_semaphore_t);
 };
 
-class new_semaphore_acq_t : public intrusive_list_node_t<new_semaphore_acq_t> {
+class new_semaphore_acq_t
+    : public intrusive_list_node_t<new_semaphore_acq_t>,
+      public small_object_allocated_t<small_object_kind_t::semaphore_acquirer> {
 public:
     // Construction is non-blocking, it gets you in line for the semaphore.  You need
     // to call acquisition()->wait() in order to wait for your acquisition of the
-    // semaphore.  Acquirers receive the semaphore in the same order that they've
-    // acquired it.
+    // semaphore.  Acquirers of the same priority receive the semaphore in the same
+    // order that they've acquired it.
     ~new_semaphore_acq_t();
     new_semaphore_acq_t();
-    new_semaphore_acq_t(new_semaphore_t *semaphore, int64_t count);
+    new_semaphore_acq_t(new_semaphore_t *semaphore, int64_t count,
+                        semaphore_priority_t priority = semaphore_priority_t::normal);
     new_semaphore_acq_t(new_semaphore_acq_t &&movee);
 
     // Returns "how much" of the semaphore this acq has acquired or would acquire.
@@ -64,7 +91,8 @@ public:
     void change_count(int64_t new_count);
 
     // Initializes the object.
-    void init(new_semaphore_t *semaphore, int64_t count);
+    void init(new_semaphore_t *semaphore, int64_t count,
+              semaphore_priority_t priority = semaphore_priority_t::normal);
 
     void reset();
 
@@ -82,6 +110,9 @@ private:
     // non-NULL).
     int64_t count_;
 
+    // Which line we wait in.
+    semaphore_priority_t priority_;
+
     // Gets pulsed when we have successfully acquired the semaphore.
     cond_t cond_;
     DISABLE_COPYING(new_semaphore_acq_t);
@@ -0,0 +1,205 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CONCURRENCY_PARALLEL_FOR_HPP_
+#define CONCURRENCY_PARALLEL_FOR_HPP_
+
+#include <algorithm>
+#include <exception>
+
+#include "arch/runtime/runtime.hpp"
+#include "concurrency/pmap.hpp"
+#include "config/args.hpp"
+#include "threading.hpp"
+
+/* `parallel_for_chunks(count, chunk_size, fn)` calls `fn(begin, end)` for the
+consecutive ranges [0, chunk_size), [chunk_size, 2 * chunk_size), ... that cover
+[0, count), using all the threads at once, and blocks the calling coroutine until all
+the calls are done.
+
+This is only for CPU-bound work that doesn't care which thread it runs on: `fn` may
+be called on any thread, concurrently with itself, and it must not block or touch
+anything that belongs to a thread (like `counted_t`s of `single_threaded_countable_t`
+objects or the query's `env_t`).  If `fn` throws, the remaining chunks are skipped and
+the first exception is rethrown on the calling thread.
+
+Every thread takes the next chunk that nobody has taken yet until there are none
+left.  The calling thread starts on the chunks right away, and a busy thread only
+joins in once its event loop gets to it, so the idle threads end up doing most of
+the work. */
+
+template <class fn_t>
+class parallel_chunks_t {
+public:
+    parallel_chunks_t(size_t _count, size_t _chunk_size, const fn_t *_fn)
+        : count(_count), chunk_size(_chunk_size),
+          num_chunks((_count + _chunk_size - 1) / _chunk_size),
+          fn(_fn), next_chunk(0), failed(0),
+          caller_thread(get_thread_id()) {
+        rassert(chunk_size > 0);
+    }
+
+    int num_workers() const {
+        return std::min<size_t>(get_num_threads(), num_chunks);
+    }
+
+    void operator()(int worker) {
+        if (worker == 0) {
+            run_chunks();
+        } else {
+            const int thread = (caller_thread.threadnum + worker) % get_num_threads();
+            on_thread_t thread_switcher((threadnum_t(thread)));
+            run_chunks();
+        }
+    }
+
+    void rethrow_if_failed() {
+        if (failed != 0) {
+            std::rethrow_exception(exception);
+        }
+    }
+
+private:
+    void run_chunks() {
+        for (;;) {
+            if (__sync_fetch_and_add(&failed, 0) != 0) {
+                return;
+            }
+            const size_t chunk = __sync_fetch_and_add(&next_chunk, 1);
+            if (chunk >= num_chunks) {
+                return;
+            }
+            const size_t begin = chunk * chunk_size;
+            const size_t end = std::min(begin + chunk_size, count);
+            try {
+                (*fn)(begin, end);
+            } catch (...) {
+                if (__sync_bool_compare_and_swap(&failed, 0, 1)) {
+                    exception = std::current_exception();
+                }
+            }
+        }
+    }
+
+    const size_t count;
+    const size_t chunk_size;
+    const size_t num_chunks;
+    const fn_t *const fn;
+
+    size_t next_chunk;
+    // Set (to 1) by whoever stores `exception`.
+    int failed;
+    std::exception_ptr exception;
+
+    const threadnum_t caller_thread;
+
+    DISABLE_COPYING(parallel_chunks_t);
+};
+
+template <class fn_t>
+class parallel_chunks_worker_t {
+public:
+    explicit parallel_chunks_worker_t(parallel_chunks_t<fn_t> *_parent)
+        : parent(_parent) { }
+    void operator()(int worker) const { (*parent)(worker); }
+private:
+    parallel_chunks_t<fn_t> *parent;
+};
+
+template <class fn_t>
+void parallel_for_chunks(size_t count, size_t chunk_size, const fn_t &fn) {
+    if (count == 0) {
+        return;
+    }
+    parallel_chunks_t<fn_t> chunks(count, chunk_size, &fn);
+    pmap(chunks.num_workers(), parallel_chunks_worker_t<fn_t>(&chunks));
+    chunks.rethrow_if_failed();
+}
+
+/* `parallel_map_across_threads(count, fn)` calls `fn(i)` for every `i` in
+[0, count) with `parallel_for_chunks`, for fan-outs whose items are each a good deal
+of work.  It picks the chunk size so that every thread gets about
+`PARALLEL_MAP_CHUNKS_PER_THREAD` chunks, so a thread that draws expensive items
+doesn't hold up the rest.  The same rules as for `parallel_for_chunks` apply to
+`fn`. */
+
+template <class fn_t>
+class parallel_map_chunk_fn_t {
+public:
+    explicit parallel_map_chunk_fn_t(const fn_t *_fn) : fn(_fn) { }
+    void operator()(size_t begin, size_t end) const {
+        for (size_t i = begin; i < end; ++i) {
+            (*fn)(i);
+        }
+    }
+private:
+    const fn_t *fn;
+};
+
+template <class fn_t>
+void parallel_map_across_threads(size_t count, const fn_t &fn) {
+    const size_t target_chunks =
+        static_cast<size_t>(get_num_threads()) * PARALLEL_MAP_CHUNKS_PER_THREAD;
+    parallel_for_chunks(count, std::max<size_t>(1, count / target_chunks),
+                        parallel_map_chunk_fn_t<fn_t>(&fn));
+}
+
+/* `parallel_sort(begin, end, less)` is like `std::sort(begin, end, less)`, but
+sorts big ranges with `parallel_for_chunks`: it sorts chunks of
+`PARALLEL_SORT_CHUNK_SIZE` elements and then merges them pairwise.  The same rules as
+for `parallel_for_chunks` apply to `less` and to the elements' move and copy
+operations.  Ranges of fewer than `PARALLEL_SORT_MIN_SIZE` elements are just sorted
+on the calling thread. */
+
+template <class iterator_t, class less_t>
+class parallel_sort_chunk_fn_t {
+public:
+    parallel_sort_chunk_fn_t(iterator_t _begin, const less_t *_less)
+        : begin(_begin), less(_less) { }
+    void operator()(size_t chunk_begin, size_t chunk_end) const {
+        std::sort(begin + chunk_begin, begin + chunk_end, *less);
+    }
+private:
+    iterator_t begin;
+    const less_t *less;
+};
+
+template <class iterator_t, class less_t>
+class parallel_sort_merge_fn_t {
+public:
+    parallel_sort_merge_fn_t(iterator_t _begin, size_t _size, size_t _run_size,
+                             const less_t *_less)
+        : begin(_begin), size(_size), run_size(_run_size), less(_less) { }
+    // Merges the pairs of sorted runs [first_pair, last_pair).
+    void operator()(size_t first_pair, size_t last_pair) const {
+        for (size_t pair = first_pair; pair < last_pair; ++pair) {
+            const size_t lo = pair * 2 * run_size;
+            const size_t mid = std::min(lo + run_size, size);
+            const size_t hi = std::min(lo + 2 * run_size, size);
+            std::inplace_merge(begin + lo, begin + mid, begin + hi, *less);
+        }
+    }
+private:
+    iterator_t begin;
+    size_t size;
+    size_t run_size;
+    const less_t *less;
+};
+
+template <class iterator_t, class less_t>
+void parallel_sort(iterator_t begin, iterator_t end, const less_t &less) {
+    const size_t size = end - begin;
+    if (size < PARALLEL_SORT_MIN_SIZE || get_num_threads() == 1) {
+        std::sort(begin, end, less);
+        return;
+    }
+
+    parallel_for_chunks(size, PARALLEL_SORT_CHUNK_SIZE,
+                        parallel_sort_chunk_fn_t<iterator_t, less_t>(begin, &less));
+    for (size_t run_size = PARALLEL_SORT_CHUNK_SIZE; run_size < size; run_size *= 2) {
+        const size_t num_pairs = (size + 2 * run_size - 1) / (2 * run_size);
+        parallel_for_chunks(
+            num_pairs, 1,
+            parallel_sort_merge_fn_t<iterator_t, less_t>(begin, size, run_size, &less));
+    }
+}
+
+#endif  // CONCURRENCY_PARALLEL_FOR_HPP_
@@ -4,6 +4,7 @@
 
 #include "concurrency/queue/passive_producer.hpp"
 #include "containers/intrusive_list.hpp"
+#include "time.hpp"
 
 /* `accounting_queue_t` is useful when you have some number of actors competing
 for a shared resource, and you want them to be granted access to the resource in
@@ -15,7 +16,22 @@ from a number of other `passive_producer_t`s. To associate the
 `account_t`s determines which `passive_producer_t`s the `accounting_queue_t`
 will `pop()` from when its own `pop()` method is called. When one of the sub-
 `passive_producer_t`s is not available, then it is ignored until it becomes
-available. */
+available.
+
+An `account_t` can also be given an `accounting_queue_deadline_t`.  Whenever the
+next value of such an account is past its deadline, the `accounting_queue_t` pops
+that value before looking at the shares.  (If several accounts are late, the one
+that is the most late goes first.)  That way a latency-sensitive account doesn't
+have to wait for its turn behind accounts that have a lot queued up. */
+
+class accounting_queue_deadline_t {
+public:
+    /* The time by which the next value of the account's `passive_producer_t` should
+    be popped.  This is only called when that producer is available. */
+    virtual ticks_t next_deadline() = 0;
+protected:
+    virtual ~accounting_queue_deadline_t() { }
+};
 
 template<class value_t>
 class accounting_queue_t :
@@ -26,6 +42,7 @@ public:
     explicit accounting_queue_t(int _batch_factor) :
         passive_producer_t<value_t>(&available_control),
         total_shares(0),
+        active_deadline_accounts(0),
         selector(0),
         batch_factor(_batch_factor) {
 
@@ -39,8 +56,9 @@ public:
 
     class account_t : private availability_callback_t, public intrusive_list_node_t<account_t> {
     public:
-        account_t(accounting_queue_t *p, passive_producer_t<value_t> *s, int _shares)
-            : parent(p), source(s), shares(_shares), active(false) {
+        account_t(accounting_queue_t *p, passive_producer_t<value_t> *s, int _shares,
+                  accounting_queue_deadline_t *_deadline = NULL)
+            : parent(p), source(s), shares(_shares), deadline(_deadline), active(false) {
             parent->assert_thread();
             rassert(shares > 0);
             if (source->available->get()) {
@@ -81,16 +99,23 @@ public:
             active = true;
             parent->active_accounts.push_back(this);
             parent->total_shares += shares;
+            if (deadline != NULL) {
+                ++parent->active_deadline_accounts;
+            }
         }
         void deactivate() {
             active = false;
             parent->active_accounts.remove(this);
             parent->total_shares -= shares;
+            if (deadline != NULL) {
+                --parent->active_deadline_accounts;
+            }
         }
 
         accounting_queue_t *parent;
         passive_producer_t<value_t> *source;
         int shares;
+        accounting_queue_deadline_t *deadline;
         bool active;
     };
 
@@ -99,12 +124,41 @@ private:
 
     intrusive_list_t<account_t> active_accounts, inactive_accounts;
 
-    int total_shares, selector, batch_factor;
+    int total_shares, active_deadline_accounts, selector, batch_factor;
 
     availability_control_t available_control;
+    // Returns the active account whose next value is the most late, or NULL if no
+    // account is late.
+    account_t *most_late_account() {
+        const ticks_t now = get_ticks();
+        account_t *most_late = NULL;
+        ticks_t most_late_deadline = 0;
+        for (account_t *acct = active_accounts.head();
+             acct != NULL;
+             acct = active_accounts.next(acct)) {
+            if (acct->deadline != NULL) {
+                const ticks_t d = acct->deadline->next_deadline();
+                if (d <= now && (most_late == NULL || d < most_late_deadline)) {
+                    most_late = acct;
+                    most_late_deadline = d;
+                }
+            }
+        }
+        return most_late;
+    }
+
     value_t produce_next_value() {
         assert_thread();
 
+        if (active_deadline_accounts > 0) {
+            account_t *late = most_late_account();
+            if (late != NULL) {
+                // This doesn't count against the late account's shares, so the other
+                // accounts still get their turns when nothing is late.
+                return late->source->pop();
+            }
+        }
+
         selector %= total_shares * batch_factor;
         // TODO: Maybe that line should be like this instead?
         // It would be very fair, but there might be some issues with that (like
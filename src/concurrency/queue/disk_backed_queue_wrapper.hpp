@@ -2,7 +2,9 @@
 #ifndef CONCURRENCY_QUEUE_DISK_BACKED_QUEUE_WRAPPER_HPP_
 #define CONCURRENCY_QUEUE_DISK_BACKED_QUEUE_WRAPPER_HPP_
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include "errors.hpp"
 #include <boost/circular_buffer.hpp>
@@ -10,6 +12,7 @@
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/queue/passive_producer.hpp"
 #include "concurrency/wait_any.hpp"
+#include "config/args.hpp"
 #include "containers/disk_backed_queue.hpp"
 
 /* `disk_backed_queue_t` can't be used directly as a `passive_producer_t`
@@ -27,6 +30,8 @@ template<class T>
 class disk_backed_queue_wrapper_t : public passive_producer_t<T> {
 public:
     static const int memory_queue_capacity = 1000;
+    // The most values we read from the disk queue in one go.
+    static const int disk_pop_batch_size = 100;
 
     disk_backed_queue_wrapper_t(io_backender_t *_io_backender,
             const serializer_filepath_t &_filename, perfmon_collection_t *_stats_parent) :
@@ -55,7 +60,8 @@ public:
             }
         } else {
             if (memory_queue.full()) {
-                disk_queue.init(new disk_backed_queue_t<T>(io_backender, filename, stats_parent));
+                disk_queue.init(new disk_backed_queue_t<T>(io_backender, filename, stats_parent,
+                                                           DISK_BACKED_QUEUE_MEMORY_LIMIT));
                 disk_queue->push(value);
                 coro_t::spawn_sometime(std::bind(
                     &disk_backed_queue_wrapper_t<T>::copy_from_disk_queue_to_memory_queue,
@@ -100,15 +106,22 @@ private:
                     }
                     break;
                 }
-                T value;
-                disk_queue->pop(&value);
                 if (memory_queue.full()) {
                     guarantee(notify_when_room_in_memory_queue == NULL);
                     cond_t cond;
                     assignment_sentry_t<cond_t *> assignment_sentry(&notify_when_room_in_memory_queue, &cond);
                     wait_interruptible(&cond, keepalive.get_drain_signal());
                 }
-                memory_queue.push_back(value);
+                /* Read ahead as much as fits in the memory queue, so that the
+                consumer finds the values there instead of waiting on the disk. */
+                std::vector<T> values;
+                disk_queue->pop_many(
+                    std::min<int64_t>(disk_pop_batch_size,
+                                      memory_queue_capacity - memory_queue.size()),
+                    &values);
+                for (auto it = values.begin(); it != values.end(); ++it) {
+                    memory_queue.push_back(*it);
+                }
                 available_control.set_available(true);
             }
         } catch (const interrupted_exc_t &) {
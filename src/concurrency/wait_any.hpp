@@ -2,6 +2,7 @@
 #ifndef CONCURRENCY_WAIT_ANY_HPP_
 #define CONCURRENCY_WAIT_ANY_HPP_
 
+#include "arch/runtime/small_object_allocator.hpp"
 #include "concurrency/signal.hpp"
 #include "containers/intrusive_list.hpp"
 #include "containers/object_buffer.hpp"
@@ -24,7 +25,10 @@ public:
     void add(const signal_t *s);
 
 private:
-    class wait_any_subscription_t : public signal_t::subscription_t, public intrusive_list_node_t<wait_any_subscription_t> {
+    class wait_any_subscription_t
+        : public signal_t::subscription_t,
+          public intrusive_list_node_t<wait_any_subscription_t>,
+          public small_object_allocated_t<small_object_kind_t::signal_subscription> {
     public:
         wait_any_subscription_t(wait_any_t *_parent, bool _alloc_on_heap) : parent(_parent), alloc_on_heap(_alloc_on_heap) { }
         virtual void run();
@@ -16,22 +16,52 @@
  */
 
 #define SOFTWARE_NAME_STRING "RethinkDB"
-#define SERIALIZER_VERSION_STRING "1.12"
+#define SERIALIZER_VERSION_STRING "1.13"
+// Serializers with a separate index file write this version into their static
+// headers, so that versions that don't know about index files refuse to open them.
+// Single-file serializers keep writing SERIALIZER_VERSION_STRING.
+#define SERIALIZER_SPLIT_VERSION_STRING "1.14"
 
 /**
  * Basic configuration parameters.
  */
 
-// The number of hash-based CPU shards per table.
-// This "must" be hard-coded because a cluster cannot run with
-// differing cpu sharding factors.
+// The number of hash-based CPU shards per table, unless the table's metadata says
+// otherwise (see `namespace_semilattice_metadata_t::hash_shards`).  Nodes may have
+// different numbers of them for the same table.
 #define CPU_SHARDING_FACTOR                       8
+// The most hash-based CPU shards a table may have.
+#define MAX_HASH_SHARDS                           64
 
 // Defines the maximum size of the batch of IO events to process on
 // each loop iteration. A larger number will increase throughput but
 // decrease concurrency
 #define MAX_IO_EVENT_PROCESSING_BATCH_SIZE        50
 
+// The most that `--busy-poll-us` accepts: past a millisecond, sleeping costs little
+// compared to the wait.
+#define MAX_EVENT_QUEUE_BUSY_POLL_US              1000
+
+// The most that `--backfill-latency-target-ms` accepts.
+#define MAX_BACKFILL_LATENCY_TARGET_MS            60000
+
+// How often `--auto-reshard` looks at the tables, and how big their shards may get
+// before it splits them.  A shard is also split if it gained more than
+// AUTO_RESHARD_MIN_HOT_KEYS keys since the last look, and AUTO_RESHARD_HOT_FACTOR
+// times as many as the table's shards did on average.
+#define AUTO_RESHARD_POLL_INTERVAL_MS             (60 * 1000)
+#define AUTO_RESHARD_MAX_SHARD_BYTES              (GIGABYTE * 16)
+#define AUTO_RESHARD_MIN_HOT_KEYS                 100000
+#define AUTO_RESHARD_HOT_FACTOR                   3.0
+// No table gets more shards than this from `--auto-reshard`, no more than
+// AUTO_RESHARD_MAX_CONCURRENT tables are resharded at once, and a table is left alone
+// for AUTO_RESHARD_COOLDOWN_MS after its reshard is done.
+#define AUTO_RESHARD_MAX_SHARDS                   32
+#define AUTO_RESHARD_MAX_CONCURRENT               1
+#define AUTO_RESHARD_COOLDOWN_MS                  (30 * 60 * 1000)
+// The keys each shard samples for the distribution reads `--auto-reshard` takes.
+#define AUTO_RESHARD_SAMPLE_SIZE                  1000
+
 // The io batch factor ensures a minimum number of i/o operations
 // which are picked from any specific i/o account consecutively.
 // A higher value might be advantageous for throughput if seek times
@@ -45,6 +75,11 @@
 // useful.
 #define DEFAULT_IO_BATCH_FACTOR                   1
 
+// The disk manager merges writes (or reads) that are queued at the same time and
+// that continue each other in the same file into one vectored write (or read) of at
+// most this many bytes.  A single action that is bigger than this is never split.
+#define IO_COALESCING_MAX_BYTES                   MEGABYTE
+
 // Currently, each cache uses two IO accounts:
 // one account for writes, and one account for reads.
 // By adjusting the priorities of these accounts, reads
@@ -52,11 +87,141 @@
 #define CACHE_READS_IO_PRIORITY                   (512 / CPU_SHARDING_FACTOR)
 #define CACHE_WRITES_IO_PRIORITY                  (64 / CPU_SHARDING_FACTOR)
 
+// A cache read that a query is waiting for goes ahead of the other accounts' IO
+// once it has been queued for this long.  Background IO (GC, backfilling, secondary
+// index construction) only gets its share of the disk.
+#define CACHE_READS_IO_DEADLINE_MS                5
+
 // The cache priority to use for secondary index post construction
 // 100 = same priority as all other read operations in the cache together.
 // 0 = minimal priority
 #define SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY   5
 
+// How many rows per second secondary index post construction indexes on each hash
+// shard, for all the indexes it builds together.  It waits between leaves until it
+// is back within the budget.  0 = no limit.
+#define SINDEX_POST_CONSTRUCTION_MAX_ROWS_PER_SEC 0
+
+// The Bloom filter over a shard's primary keys (see btree/key_filter.hpp) uses about
+// this many bits per key it's sized for, and sets this many of them for each key
+// (about a 1% false positive rate).  It's sized for twice the keys the table has
+// when it's built, but for at least `KEY_FILTER_MIN_KEYS`; a table whose filter
+// would take more than `KEY_FILTER_MAX_BYTES` doesn't get one.
+#define KEY_FILTER_BITS_PER_KEY                   10
+#define KEY_FILTER_HASHES                         7
+#define KEY_FILTER_MIN_KEYS                       4096
+#define KEY_FILTER_MAX_BYTES                      (32 * MEGABYTE)
+
+// The cache priority of the traversal that builds a primary key filter.
+#define KEY_FILTER_BUILD_CACHE_PRIORITY           5
+
+// How many bytes of queued values a disk-backed queue of changes (like the ones a
+// listener queues up during a backfill) keeps in memory before it writes the oldest
+// ones to its file.
+#define DISK_BACKED_QUEUE_MEMORY_LIMIT            (4 * MEGABYTE)
+
+// How many random walks down its btree a shard takes, per row asked for, when it
+// reads a random sample of its rows.  Walks to rows that don't make it into the
+// sample count too.
+#define SAMPLE_READ_WALKS_PER_ROW 10
+
+// Table exports compress their rows in chunks of about this many (uncompressed)
+// bytes.
+#define EXPORT_CHUNK_SIZE                         (4 * MEGABYTE)
+
+// The most rows a table import writes at once.
+#define IMPORT_BATCH_SIZE                         1000
+
+// The most rows `map` sends to a JavaScript worker in one message.  The worker's
+// reply holds a result for each of them.
+#define JS_CALL_MAX_BATCH_SIZE 256
+
+// The size of each of the two rings of shared memory that jobs and their results go
+// through between the main process and an extproc worker.  A message bigger than this
+// just takes more than one trip around.
+#define EXTPROC_SHM_RING_SIZE (1 * MEGABYTE)
+
+// How many compiled functions a JavaScript worker process keeps for later jobs, and
+// how many recent affinity keys the main process remembers for each worker (which
+// should match, since a key stands for a function).
+#define JS_WORKER_FUNCTION_CACHE_SIZE 100
+#define EXTPROC_WORKER_AFFINITY_KEYS JS_WORKER_FUNCTION_CACHE_SIZE
+
+// How many extproc workers `rethinkdb serve` starts before any query needs them, and
+// restarts when they get killed.
+#define DEFAULT_EXTPROC_WARM_WORKERS 1
+
+// The most operands an `r.js` function can have for `translate_js_function` to turn
+// it into terms.  This bounds how deep the parser and the terms it makes can nest.
+#define JS_TRANSLATE_MAX_OPERANDS 256
+
+// How many batches of a streaming insert are written at once.  The server doesn't
+// answer the client's next batch until one of them is done.
+#define INSERT_STREAM_MAX_BATCHES_IN_FLIGHT 4
+
+// How many of a union's streams (one per key of a `get_all` on a secondary index,
+// say) are read from at once.  Each keeps a batch buffered until it's returned.
+#define UNION_DATUM_STREAM_MAX_CONCURRENT_READS 128
+
+// How many of a client connection's queries the server runs at once.  It doesn't
+// read the connection's next query until one of them is done.
+#define PROTOB_MAX_REQUESTS_IN_FLIGHT_PER_CONNECTION 32
+
+// A new client connection goes to the thread whose event loop has been the least
+// busy lately.  Threads within this many thousandths of it count as just as busy, and
+// the one with the fewest connections wins.
+#define CONNECTION_PLACEMENT_UTILIZATION_SLACK_PERMILLE 50
+
+// The slow query log writes at most this many entries a minute, and says how many it
+// left out.
+#define SLOW_QUERY_LOG_MAX_ENTRIES_PER_MINUTE 60
+
+// One query in this many is profiled for the slow query log, whether or not the
+// client asked for a profile.
+#define SLOW_QUERY_LOG_PROFILE_SAMPLE_RATE 100
+
+// About how long the slow query log's description of a query's terms can get, and how
+// much of each datum in it is shown.
+#define SLOW_QUERY_LOG_MAX_SUMMARY_SIZE 1024
+#define SLOW_QUERY_LOG_MAX_DATUM_SIZE 64
+
+// How long GET /ajax/metrics reuses the stats it collected, so that concurrent
+// scrapers don't each walk the perfmon tree.
+#define METRICS_CACHE_MS 1000
+
+// How long an HTTP connection may sit idle between requests before we close it.
+#define HTTP_KEEPALIVE_TIMEOUT_MS 30000
+
+// HTTP/1.1 responses at least this big are gzipped as they're sent, in chunks of
+// HTTP_STREAM_CHUNK_SIZE, rather than compressed whole first.
+#define HTTP_STREAM_GZIP_MIN_SIZE (64 * KILOBYTE)
+#define HTTP_STREAM_CHUNK_SIZE (16 * KILOBYTE)
+
+// One outdated read in this many goes to a random remote replica instead of the one
+// that has been answering fastest, to keep the replicas' times up to date.
+#define OUTDATED_READ_EXPLORATION_RATE 32
+
+// How deeply arrays and objects can be nested in the JSON that `r.json` and R_JSON
+// datums are parsed from.  The parser recurses on the coroutine's stack.
+#define JSON_MAX_NESTING_DEPTH 256
+
+// How many field names each thread remembers, so that the objects it deserializes
+// or parses can share one copy of each.  When it has more, it starts over.  Names
+// longer than DATUM_KEY_MAX_INTERNED_SIZE are never shared.
+#define DATUM_KEY_INTERN_TABLE_SIZE 1024
+#define DATUM_KEY_MAX_INTERNED_SIZE 128
+
+// How many freed datums each thread keeps for making new ones.
+#define DATUM_POOL_MAX_SIZE 4096
+
+// Small objects (see arch/runtime/small_object_allocator.hpp) of up to
+// SMALL_OBJECT_MAX_SIZE bytes are carved out of per-thread slabs of
+// SMALL_OBJECT_SLAB_SIZE bytes, in size classes SMALL_OBJECT_GRANULARITY bytes
+// apart.
+#define SMALL_OBJECT_SLAB_SIZE (64 * KILOBYTE)
+#define SMALL_OBJECT_MAX_SIZE 256
+#define SMALL_OBJECT_GRANULARITY 16
+
 // Garbage Collection uses its own two IO accounts.
 // There is one low-priority account that is meant to guarantee
 // (performance-wise) unintrusive garbage collection.
@@ -73,6 +238,10 @@
 // Size of the buffer used to perform IO operations (in bytes).
 #define IO_BUFFER_SIZE                            (4 * KILOBYTE)
 
+// The most that a TCP connection asks the kernel for at once when it fills its
+// read buffer. Connections start at IO_BUFFER_SIZE and grow towards this.
+#define TCP_CONN_MAX_READ_SIZE                    (64 * KILOBYTE)
+
 // Size of the device block size (in bytes)
 #define DEVICE_BLOCK_SIZE                         512
 
@@ -82,9 +251,150 @@
 // Size of each btree node (in bytes) on disk
 #define DEFAULT_BTREE_BLOCK_SIZE                  (4 * KILOBYTE)
 
+// The largest btree block size a table can be configured with.  Offsets within
+// leaf and internal nodes are 16 bits wide, so it has to stay below 64 KB.
+#define MAX_BTREE_BLOCK_SIZE                      (32 * KILOBYTE)
+
+// In tables with blocks larger than DEFAULT_BTREE_BLOCK_SIZE, rdb values of up to
+// this fraction of the block size are stored directly in the leaf nodes.
+#define RDB_IN_NODE_VALUE_BLOCK_FRACTION          8
+
 // Size of each extent (in bytes)
 #define DEFAULT_EXTENT_SIZE                       (512 * KILOBYTE)
 
+// How often the node-wide alt_memory_arbiter_t moves cache memory between tables.
+#define CACHE_MEMORY_ARBITER_INTERVAL_MS          1000
+
+// When the alt_memory_arbiter_t weighs tables against each other, a cache miss
+// counts this many times as much as a cache hit.
+#define CACHE_MEMORY_ARBITER_MISS_WEIGHT          8
+
+// Block buffers (see serializer/buffer_allocator.hpp) up to
+// BLOCK_BUFFER_MAX_SLAB_CHUNK_SIZE bytes are carved out of slabs of
+// BLOCK_BUFFER_SLAB_SIZE bytes (the size of a huge page), which are taken from an
+// address range of BLOCK_BUFFER_ARENA_SIZE bytes that is reserved at startup.
+#define BLOCK_BUFFER_SLAB_SIZE                    (2 * MEGABYTE)
+#define BLOCK_BUFFER_MAX_SLAB_CHUNK_SIZE          (64 * KILOBYTE)
+#define BLOCK_BUFFER_ARENA_SIZE                   TERABYTE
+
+// The default share of a cache's memory limit (in percent) that may hold compressed
+// copies of evicted pages.
+#define CACHE_COMPRESSED_TIER_PERCENT             25
+
+// When a btree traversal walks through the children of an internal node in order,
+// it loads this many of the following children ahead of time.  The window doubles
+// each time it gets half used up, up to BTREE_READ_AHEAD_MAX_WINDOW.
+#define BTREE_READ_AHEAD_INITIAL_WINDOW           2
+#define BTREE_READ_AHEAD_MAX_WINDOW               32
+
+// A parallel btree traversal (as used by backfills and secondary index
+// post-construction) starts loading up to this many of the blocks it's going to
+// acquire next, on top of the ones it's acquiring.  0 turns that off.
+#define PARALLEL_TRAVERSAL_PREFETCH_WINDOW        64
+
+// Each btree samples about one in BTREE_HOT_KEYS_SAMPLE_RATE point reads and writes
+// to find its most accessed keys and leaves.  It keeps approximate counts for
+// BTREE_HOT_KEYS_SKETCH_SIZE of each, halves the counts every
+// BTREE_HOT_KEYS_DECAY_INTERVAL samples, and reports the top
+// BTREE_HOT_KEYS_REPORTED of each in its stats.
+#define BTREE_HOT_KEYS_SAMPLE_RATE                16
+#define BTREE_HOT_KEYS_SKETCH_SIZE                64
+#define BTREE_HOT_KEYS_DECAY_INTERVAL             4096
+#define BTREE_HOT_KEYS_REPORTED                   10
+
+// Subtrees that an erase range unlinks from a btree are freed in the background,
+// this many nodes per transaction, with a pause of this many milliseconds after
+// each transaction.
+#define SUBTREE_ERASER_NODES_PER_BATCH            64
+#define SUBTREE_ERASER_BATCH_INTERVAL_MS          10
+
+// How often a cache rewrites its warm-up manifest (the list of its hottest blocks
+// that gets loaded back into the cache after a restart).
+#define CACHE_WARM_UP_MANIFEST_INTERVAL_MS        (5 * 60 * 1000)
+
+// A cache's writeback_scheduler_t wakes up every CACHE_WRITEBACK_INTERVAL_MS to write
+// dirty pages of txns that are waiting to flush, at most
+// CACHE_WRITEBACK_MAX_BATCH_BYTES at a time.  It writes at the measured disk
+// throughput (never assumed to be below CACHE_WRITEBACK_MIN_THROUGHPUT bytes per
+// second, and starting at CACHE_WRITEBACK_INITIAL_THROUGHPUT) once
+// CACHE_WRITEBACK_DIRTY_PAGES_TARGET pages are waiting, and proportionally slower
+// when fewer are.
+#define CACHE_WRITEBACK_INTERVAL_MS               20
+#define CACHE_WRITEBACK_MAX_BATCH_BYTES           MEGABYTE
+#define CACHE_WRITEBACK_INITIAL_THROUGHPUT        (50 * MEGABYTE)
+#define CACHE_WRITEBACK_MIN_THROUGHPUT            MEGABYTE
+#define CACHE_WRITEBACK_DIRTY_PAGES_TARGET        100
+
+// The default for how long a cache may put off flushing group-soft durability
+// writes, which is how much of them a crash may lose.
+#define CACHE_GROUP_SOFT_LOSS_WINDOW_MS           100
+
+// How many block accesses each thread keeps while block tracing is on (the oldest
+// are overwritten first).  A record is 24 bytes.
+#define BLOCK_TRACE_RECORDS_PER_THREAD            (1 << 18)
+
+// parallel_sort() spreads sorting ranges of at least PARALLEL_SORT_MIN_SIZE elements
+// over all the threads, in chunks of PARALLEL_SORT_CHUNK_SIZE elements.  (Used for
+// in-memory orderBy.)
+#define PARALLEL_SORT_MIN_SIZE                    20000
+#define PARALLEL_SORT_CHUNK_SIZE                  4096
+
+// parallel_map_across_threads() hands out its items in chunks sized so that each
+// thread gets about this many of them, to balance the load between the threads.
+#define PARALLEL_MAP_CHUNKS_PER_THREAD            4
+
+// Once a connection's cursors hold more than STREAM_CACHE_MAX_BYTES_PER_CONNECTION
+// bytes of rows between batches, or all the connections' cursors hold more than
+// STREAM_CACHE_MAX_BYTES, the idle ones let go of the rows they can read again; if
+// a connection is still over its limit, its idle cursors are closed.
+#define STREAM_CACHE_MAX_BYTES_PER_CONNECTION     (64 * MEGABYTE)
+#define STREAM_CACHE_MAX_BYTES                    (512 * MEGABYTE)
+
+// The most bytes of rows (by their serialized size) that one query can hold in the
+// arrays, groups and sorts it builds, and that all of a server's queries can hold
+// together.  Sorts that go over spill to disk; anything else fails.
+#define QUERY_MEMORY_LIMIT                        (1 * GIGABYTE)
+#define GLOBAL_QUERY_MEMORY_LIMIT                 (4 * GIGABYTE)
+
+// Each client connection keeps the compiled terms of up to TERM_CACHE_SIZE recent
+// queries for reuse by queries of the same shape, leaving out queries of more than
+// TERM_CACHE_MAX_QUERY_TERMS terms.
+#define TERM_CACHE_SIZE                           64
+#define TERM_CACHE_MAX_QUERY_TERMS                1000
+
+// Each thread keeps the last REGEX_CACHE_SIZE patterns that `match` compiled.
+#define REGEX_CACHE_SIZE                          64
+
+// A changefeed holds on to at most CHANGEFEED_MAX_QUEUED_CHANGES changes that its
+// client hasn't read yet.  Past that, it fails rather than fall further behind.
+#define CHANGEFEED_MAX_QUEUED_CHANGES             100000
+
+// When the hash shards' results of an aggregation have at least this many groups
+// between them, they're merged pairwise on all the threads.
+#define PARALLEL_UNSHARD_MIN_GROUPS               1024
+
+// Each thread lets between QL_ADMISSION_MIN_LIMIT and QL_ADMISSION_MAX_LIMIT of its
+// clients' queries run at once, starting at QL_ADMISSION_INITIAL_LIMIT (see
+// `ql::query_admission_t`).  Up to QL_ADMISSION_MAX_QUEUED more wait in line, for at
+// most QL_ADMISSION_QUEUE_TIMEOUT_MS; the rest get turned away.
+#define QL_ADMISSION_INITIAL_LIMIT                64
+#define QL_ADMISSION_MIN_LIMIT                    8
+#define QL_ADMISSION_MAX_LIMIT                    1024
+#define QL_ADMISSION_MAX_QUEUED                   1024
+#define QL_ADMISSION_QUEUE_TIMEOUT_MS             1000
+
+// The limit comes down once the last QL_ADMISSION_SHORT_SAMPLES or so queries take
+// this many times longer than the last QL_ADMISSION_LONG_SAMPLES or so.
+#define QL_ADMISSION_LATENCY_TOLERANCE            1.5
+#define QL_ADMISSION_SHORT_SAMPLES                16
+#define QL_ADMISSION_LONG_SAMPLES                 600
+
+// Each store remembers up to RESULT_CACHE_BYTES of the results of the aggregations
+// that queries ask it to remember (see `result_cache_t`), none bigger than
+// RESULT_CACHE_MAX_RESULT_BYTES.
+#define RESULT_CACHE_BYTES                        (4 * MEGABYTE)
+#define RESULT_CACHE_MAX_RESULT_BYTES             (256 * KILOBYTE)
+
 // Ratio of free ram to use for the cache by default
 // TODO: DEFAULT_MAX_CACHE_RATIO is unused. Should it be deleted?
 #define DEFAULT_MAX_CACHE_RATIO                   0.5
@@ -102,6 +412,11 @@
 // merger serializer.
 #define MERGED_INDEX_WRITE_IO_PRIORITY            128
 
+// How many proxy serializers (each holding one CPU shard of a table) the shared
+// table file has, with --shared-table-file.  The proxies' block ids are
+// interleaved in the file's LBA, so a large number makes it sparse.
+#define SHARED_TABLE_FILE_SLOTS                   256
+
 
 // Maximum number of threads we support
 // TODO: make this dynamic where possible
@@ -110,6 +425,10 @@
 // Ticks (in milliseconds) the internal timed tasks are performed at
 #define TIMER_TICKS_IN_MS                         5
 
+// The granularity (in milliseconds) of the timer wheel that `timer_handler_t` keeps the
+// timers in; timers ring at the first tick that isn't earlier than their deadline.
+#define TIMER_WHEEL_TICK_MS                       1
+
 // How many milliseconds to allow changes to sit in memory before flushing to disk
 #define DEFAULT_FLUSH_TIMER_MS                    1000
 
@@ -127,6 +446,10 @@
 // How large can the key be, in bytes?  This value needs to fit in a byte.
 #define MAX_KEY_SIZE                              250
 
+// `store_key_t`s with up to this many bytes are kept inside the object, and longer
+// ones on the heap.  This fits a primary key that's a UUID string.
+#define STORE_KEY_INLINE_SIZE                     47
+
 // Any values of this size or less will be directly stored in btree leaf nodes.
 // Values greater than this size will be stored in overflow blocks. This value
 // needs to fit in a byte.
@@ -145,6 +468,14 @@
 // The number of concurrent queries when loading memcached operations from a file.
 #define MAX_CONCURRENT_QUEURIES_ON_IMPORT         1000
 
+// How many bytes of values the first round of a memcached "rget" reads; each round
+// after that reads twice as much, up to a megabyte.
+#define MEMCACHED_RGET_FIRST_CHUNK_SIZE           (64 * KILOBYTE)
+
+// The most quiet gets from one memcached binary-protocol client that are read and
+// looked up together, like the keys of one text-protocol "get".
+#define MAX_BINARY_GET_BATCH                      256
+
 // How many timestamps we store in a leaf node.  We store the
 // NUM_LEAF_NODE_EARLIER_TIMES+1 most-recent timestamps.
 #define NUM_LEAF_NODE_EARLIER_TIMES               4
@@ -163,10 +494,53 @@
 // The ratio at which we don't want to keep GC'ing.
 #define DEFAULT_GC_LOW_RATIO                      0.15
 
+// Whether the serializer compresses blocks before writing them by default.
+#define DEFAULT_SERIALIZER_BLOCK_COMPRESSION      false
+// The zlib compression level for serializer blocks.  Blocks are compressed on the
+// write path, so speed matters more than the ratio.
+#define SERIALIZER_BLOCK_COMPRESSION_LEVEL        1
+
+// How long (in ms) an index write waits for more index writes to share its
+// metablock write and datasyncs with, by default.
+#define DEFAULT_SERIALIZER_GROUP_COMMIT_WINDOW_MS  0
+
+// Whether the serializer discards (TRIMs) freed extents, by default.
+#define DEFAULT_SERIALIZER_DISCARD_FREED_EXTENTS   false
+
+// For serializers with an archive file: how far (in repli timestamps, so roughly in
+// the table's writes) a block's recency has to be behind the newest recency in the
+// serializer for the GC to move the block to the archive file, by default.
+#define DEFAULT_SERIALIZER_ARCHIVE_RECENCY_LAG     (100 * MILLION)
+
+// How many freed extents the serializer discards at a time, and how long (in ms) it
+// waits between those batches.
+#define EXTENT_DISCARD_BATCH_SIZE                  16
+#define EXTENT_DISCARD_INTERVAL_MS                 50
+
 // What's the maximum number of "young" extents we can have?
 #define GC_YOUNG_EXTENT_MAX_SIZE                  50
 // What's the definition of a "young" extent in microseconds?
 #define GC_YOUNG_EXTENT_TIMELIMIT_MICROS          50000
+// How often (at most) the GC recomputes the cost-benefit priorities of the old
+// extents, which change as the extents age.
+#define GC_PRIORITY_REFRESH_INTERVAL_MICROS       1000000
+
+// The GC slows down while the recent disk read latency is above this, so that it
+// doesn't hurt queries too much (see gc_scheduler_t).
+#define GC_TARGET_READ_LATENCY_MICROS             2000
+// How often the GC rate gets adjusted to the disk read latency.
+#define GC_RATE_ADJUSTMENT_INTERVAL_MS            100
+// The GC rate (in bytes read and written per second) starts here, and stays
+// between the min and the max.
+#define GC_INITIAL_RATE                           (32 * MEGABYTE)
+#define GC_MIN_RATE                               MEGABYTE
+#define GC_MAX_RATE                               (512 * MEGABYTE)
+// How many bytes the GC may save up for a burst while it's idle.
+#define GC_MAX_BURST_BYTES                        (16 * MEGABYTE)
+
+// The "serializer_write_amplification" stat weighs the bytes written this many seconds
+// ago half as much as the ones written now.
+#define WRITE_AMPLIFICATION_HALF_LIFE_SECS        60
 
 // If the size of the LBA on a given disk exceeds LBA_MIN_SIZE_FOR_GC, then the fraction of the
 // entries that are live and not garbage should be at least LBA_MIN_UNGARBAGE_FRACTION.
@@ -204,15 +578,65 @@
 // freed. This value is per thread.
 #define COROUTINE_FREE_LIST_SIZE                  64
 
+// How long a coroutine has to sit unused on the free list before the part of its stack
+// that it isn't using is given back to the kernel, and how often we check for those.
+#define COROUTINE_STACK_IDLE_RELEASE_MS           1000
+
+// Each thread measures how much of the time its event loop is busy over windows of
+// this length.  `get_thread_utilization_permille()` averages the recent windows.
+#define THREAD_UTILIZATION_WINDOW_MS              100
+
+// The "event_loop_threads" stats report the longest coroutine scheduling lag of the
+// current and the previous window of this length.
+#define EVENT_LOOP_STATS_WINDOW_MS                1000
+
 #define MAX_COROS_PER_THREAD                      10000
 
 
+// How many tables a server opens at a time, at startup or otherwise.
+#define MAX_CONCURRENT_TABLE_OPENS                8
+
 // Minimal time we nap before re-checking if a goal is satisfied in the reactor (in ms).
 // This is an optimization to save CPU time. Checking for whether the goal is
 // satisfied can be an expensive operation. By napping we increase our chances
 // that the event we are waiting for has occurred in the meantime.
 #define REACTOR_RUN_UNTIL_SATISFIED_NAP           100
 
+// Cluster messages shorter than this are sent uncompressed even on compressed
+// connections; most mailbox messages are this small and wouldn't shrink anyway.
+#define CLUSTER_COMPRESSION_MIN_MESSAGE_SIZE      512
+// The zlib compression level for cluster connections.  Messages are compressed on
+// the connection's thread, so speed matters more than the ratio.
+#define CLUSTER_COMPRESSION_LEVEL                 1
+// The largest frame that is sent or accepted on a compressed cluster connection.
+// Bigger messages are split across several frames.
+#define CLUSTER_COMPRESSION_MAX_FRAME_SIZE        MEGABYTE
+
+// Cluster messages are sent in fragments of at most this size, so that a message of
+// a higher priority never has to wait for more than one fragment of a big message.
+#define CLUSTER_MESSAGE_FRAGMENT_SIZE             (64 * KILOBYTE)
+// After a priority's queued messages have been passed over for this many fragments
+// in a row, it gets to send the next fragment, so bulk transfers aren't starved.
+#define CLUSTER_SEND_QUEUE_MAX_SKIPS              16
+
+// Directory changes are usually sent to peers as deltas against the previous value.
+// Every this many changes the whole value is sent instead, so that a peer that
+// couldn't apply a delta recovers.
+#define DIRECTORY_FULL_UPDATE_INTERVAL            64
+
+// Changes to the cluster metadata are written to the metadata file at most this often,
+// so that a burst of changes (like creating tables in a loop) becomes one write.
+#define METADATA_PERSIST_COALESCE_MS              50
+// Changes to the cluster metadata are appended to a log in the metadata file, and the
+// whole metadata is only written again once the log is bigger than both this and the
+// metadata itself.
+#define METADATA_LOG_CHECKPOINT_MIN_SIZE          (64 * KILOBYTE)
+
+// Strings at least this long that are deserialized from a mailbox message point into
+// the message instead of being copied. Shorter ones are copied, since they're cheap
+// to copy and would keep the whole message in memory for as long as they live.
+#define WIRE_STRING_MIN_BORROW_SIZE               256
+
 
 /**
  * Message scheduler configuration
@@ -248,6 +672,7 @@
 #define CORO_PRIORITY_BACKFILL_SENDER           (-2)
 #define CORO_PRIORITY_BACKFILL_RECEIVER         (-2)
 #define CORO_PRIORITY_RESET_DATA                (-2)
+#define CORO_PRIORITY_SUBTREE_ERASER            (-2)
 #define CORO_PRIORITY_REACTOR                   (-1)
 #define CORO_PRIORITY_DIRECTORY_CHANGES         (-2)
 #define CORO_PRIORITY_LBA_GC                    (-2)
@@ -1,13 +1,19 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "containers/archive/archive.hpp"
 
+#include <inttypes.h>
+#include <stdlib.h>
 #include <string.h>
 #include <netinet/in.h>
 
 #include <algorithm>
+#include <new>
+#include <vector>
 
 #include "containers/uuid.hpp"
 #include "rpc/serialize_macros.hpp"
+#include "thread_local.hpp"
+#include "utils.hpp"
 
 const char *archive_result_as_str(archive_result_t archive_result) {
     switch (archive_result) {
@@ -52,21 +58,73 @@ int64_t force_read(read_stream_t *s, void *p, int64_t n) {
     return written_so_far;
 }
 
+// The number of free DEFAULT_SIZE buffers that each thread holds on to.
+static const int WRITE_BUFFER_POOL_MAX_SIZE = 64;
+
+TLS_with_init(write_buffer_t *, write_buffer_pool, NULL);
+TLS_with_init(int, write_buffer_pool_size, 0);
+
+const int64_t write_buffer_t::DEFAULT_SIZE;
+
+write_buffer_t::write_buffer_t(int64_t _capacity)
+    : size(0), capacity(_capacity), data(reinterpret_cast<char *>(this + 1)),
+      next_free(NULL) { }
+
+write_buffer_t *write_buffer_t::allocate(int64_t capacity) {
+    if (capacity <= DEFAULT_SIZE) {
+        write_buffer_t *buffer = TLS_get_write_buffer_pool();
+        if (buffer != NULL) {
+            TLS_set_write_buffer_pool(buffer->next_free);
+            TLS_set_write_buffer_pool_size(TLS_get_write_buffer_pool_size() - 1);
+            buffer->next_free = NULL;
+            buffer->size = 0;
+            return buffer;
+        }
+        capacity = DEFAULT_SIZE;
+    }
+    void *memory = malloc(sizeof(write_buffer_t) + capacity);
+    guarantee(memory != NULL, "Could not allocate a write buffer of %" PRIi64 " bytes",
+              capacity);
+    return new (memory) write_buffer_t(capacity);
+}
+
+void write_buffer_t::release(write_buffer_t *buffer) {
+    if (buffer->capacity == DEFAULT_SIZE
+            && TLS_get_write_buffer_pool_size() < WRITE_BUFFER_POOL_MAX_SIZE) {
+        buffer->next_free = TLS_get_write_buffer_pool();
+        TLS_set_write_buffer_pool(buffer);
+        TLS_set_write_buffer_pool_size(TLS_get_write_buffer_pool_size() + 1);
+        return;
+    }
+    buffer->~write_buffer_t();
+    free(buffer);
+}
+
 write_message_t::~write_message_t() {
     while (write_buffer_t *buffer = buffers_.head()) {
         buffers_.remove(buffer);
-        delete buffer;
+        write_buffer_t::release(buffer);
     }
 }
 
+void write_message_t::reserve(int64_t n) {
+    if (n <= 0) {
+        return;
+    }
+    if (!buffers_.empty() && buffers_.tail()->capacity - buffers_.tail()->size >= n) {
+        return;
+    }
+    buffers_.push_back(write_buffer_t::allocate(n));
+}
+
 void write_message_t::append(const void *p, int64_t n) {
     while (n > 0) {
-        if (buffers_.empty() || buffers_.tail()->size == write_buffer_t::DATA_SIZE) {
-            buffers_.push_back(new write_buffer_t);
+        if (buffers_.empty() || buffers_.tail()->size == buffers_.tail()->capacity) {
+            buffers_.push_back(write_buffer_t::allocate(write_buffer_t::DEFAULT_SIZE));
         }
 
         write_buffer_t *b = buffers_.tail();
-        int64_t k = std::min<int64_t>(n, write_buffer_t::DATA_SIZE - b->size);
+        int64_t k = std::min<int64_t>(n, b->capacity - b->size);
 
         memcpy(b->data + b->size, p, k);
         b->size += k;
@@ -83,15 +141,49 @@ size_t write_message_t::size() const {
     return ret;
 }
 
+int64_t write_stream_t::writev(const iovec *iov, size_t iovcnt) {
+    int64_t total = 0;
+    for (size_t i = 0; i < iovcnt; ++i) {
+        int64_t res = write(iov[i].iov_base, iov[i].iov_len);
+        if (res == -1) {
+            return -1;
+        }
+        rassert(res == static_cast<int64_t>(iov[i].iov_len));
+        total += res;
+    }
+    return total;
+}
+
 int send_write_message(write_stream_t *s, const write_message_t *msg) {
     intrusive_list_t<write_buffer_t> *list = const_cast<write_message_t *>(msg)->unsafe_expose_buffers();
-    for (write_buffer_t *p = list->head(); p; p = list->next(p)) {
-        int64_t res = s->write(p->data, p->size);
+    if (list->empty()) {
+        return 0;
+    }
+    if (list->head() == list->tail()) {
+        int64_t res = s->write(list->head()->data, list->head()->size);
         if (res == -1) {
             return -1;
         }
-        rassert(res == p->size);
+        rassert(res == list->head()->size);
+        return 0;
+    }
+
+    // Hand all of the buffers to the stream at once, so that it doesn't have to
+    // copy them or send them one by one.
+    std::vector<iovec> iov;
+    int64_t expected = 0;
+    for (write_buffer_t *p = list->head(); p; p = list->next(p)) {
+        iovec v;
+        v.iov_base = p->data;
+        v.iov_len = p->size;
+        iov.push_back(v);
+        expected += p->size;
+    }
+    int64_t res = s->writev(iov.data(), iov.size());
+    if (res == -1) {
+        return -1;
     }
+    rassert(res == expected);
     return 0;
 }
 
@@ -3,6 +3,7 @@
 #define CONTAINERS_ARCHIVE_ARCHIVE_HPP_
 
 #include <stdint.h>
+#include <sys/uio.h>
 
 #include <type_traits>
 
@@ -82,21 +83,38 @@ public:
     write_stream_t() { }
     // Returns n, or -1 upon error. Blocks until all bytes are written.
     virtual MUST_USE int64_t write(const void *p, int64_t n) = 0;
+    // Writes the `iovcnt` buffers in order. Returns the total number of bytes, or
+    // -1 upon error. The default implementation calls `write()` on each buffer;
+    // streams that can send them all at once should override it.
+    virtual MUST_USE int64_t writev(const iovec *iov, size_t iovcnt);
 protected:
     virtual ~write_stream_t() { }
 private:
     DISABLE_COPYING(write_stream_t);
 };
 
+// A chunk of a `write_message_t`.  Most are DEFAULT_SIZE bytes and are recycled
+// through a small per-thread pool, so that serializing the usual small messages
+// doesn't allocate once a thread has warmed up; `write_message_t::reserve()` makes
+// bigger ones for data whose size is known up front.
 class write_buffer_t : public intrusive_list_node_t<write_buffer_t> {
 public:
-    write_buffer_t() : size(0) { }
+    static const int64_t DEFAULT_SIZE = 4096;
 
-    static const int DATA_SIZE = 4096;
-    int size;
-    char data[DATA_SIZE];
+    static write_buffer_t *allocate(int64_t capacity);
+    static void release(write_buffer_t *buffer);
+
+    int64_t size;
+    const int64_t capacity;
+    char *const data;
 
 private:
+    explicit write_buffer_t(int64_t _capacity);
+    ~write_buffer_t() { }
+
+    // The next buffer in the thread's pool, while this one is in it.
+    write_buffer_t *next_free;
+
     DISABLE_COPYING(write_buffer_t);
 };
 
@@ -113,6 +131,11 @@ public:
 
     void append(const void *p, int64_t n);
 
+    // Makes sure that the next n bytes appended go into one contiguous buffer, so
+    // that a big value whose serialized size is known doesn't get spread across
+    // lots of small ones.
+    void reserve(int64_t n);
+
     size_t size() const;
 
     intrusive_list_t<write_buffer_t> *unsafe_expose_buffers() { return &buffers_; }
@@ -194,6 +217,14 @@ empty_ok_t<T> empty_ok(T &field) {  // NOLINT(runtime/references)
 template <class T>
 struct serialized_size_t;
 
+// Specialize this (to std::true_type) for a type whose serialization is exactly its
+// own sizeof(T) bytes, as they are in memory, so that arrays of it can be sent and
+// received with one copy instead of one call per element (see the std::vector
+// serialization in stl_types.hpp).  This is part of the wire format: only do it for
+// trivial types whose operator<< already writes them that way.
+template <class T>
+struct serialized_as_raw_t : public std::false_type { };
+
 // Keep in sync with serialized_size_t defined below.
 #define ARCHIVE_PRIM_MAKE_WRITE_SERIALIZABLE(typ1, typ2)                \
     inline write_message_t &operator<<(write_message_t &msg, typ1 x) {  \
@@ -256,7 +287,10 @@ struct serialized_size_t;
                                                                         \
     template <>                                                         \
     struct serialized_size_t<typ>                                       \
-        : public std::integral_constant<size_t, sizeof(typ)> { }
+        : public std::integral_constant<size_t, sizeof(typ)> { };       \
+                                                                        \
+    template <>                                                         \
+    struct serialized_as_raw_t<typ> : public std::true_type { }
 
 
 ARCHIVE_PRIM_MAKE_RAW_SERIALIZABLE(unsigned char);  // NOLINT(runtime/int)
@@ -0,0 +1,54 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "containers/archive/shared_buffer_stream.hpp"
+
+#include <string.h>
+
+shared_buffer_read_stream_t::shared_buffer_read_stream_t(std::vector<char> &&vector,
+                                                         int64_t offset)
+    : buffer(new shared_buffer_t(std::move(vector))),
+      end(buffer->data.size()),
+      pos(offset),
+      terminator_pos(-1),
+      terminator_byte('\0') {
+    guarantee(pos >= 0);
+    guarantee(pos <= end);
+}
+
+shared_buffer_read_stream_t::~shared_buffer_read_stream_t() { }
+
+int64_t shared_buffer_read_stream_t::read(void *p, int64_t n) {
+    int64_t num_left = end - pos;
+    int64_t num_to_read = n < num_left ? n : num_left;
+    if (num_to_read <= 0) {
+        return 0;
+    }
+
+    memcpy(p, buffer->data.data() + pos, num_to_read);
+    if (terminator_pos == pos) {
+        static_cast<char *>(p)[0] = terminator_byte;
+    }
+
+    pos += num_to_read;
+
+    return num_to_read;
+}
+
+bool shared_buffer_read_stream_t::borrow(int64_t n, const char **data_out,
+                                         counted_t<shared_buffer_t> *buffer_out) {
+    if (n < 0 || n >= end - pos || (n > 0 && terminator_pos == pos)) {
+        return false;
+    }
+
+    char *data = buffer->data.data();
+    // For an empty slice right after another one, the terminator is already there.
+    if (terminator_pos != pos + n) {
+        terminator_pos = pos + n;
+        terminator_byte = data[terminator_pos];
+        data[terminator_pos] = '\0';
+    }
+
+    *data_out = data + pos;
+    *buffer_out = buffer;
+    pos += n;
+    return true;
+}
@@ -0,0 +1,62 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CONTAINERS_ARCHIVE_SHARED_BUFFER_STREAM_HPP_
+#define CONTAINERS_ARCHIVE_SHARED_BUFFER_STREAM_HPP_
+
+#include <vector>
+
+#include "arch/runtime/small_object_allocator.hpp"
+#include "containers/archive/archive.hpp"
+#include "containers/counted.hpp"
+
+/* `shared_buffer_t` is a reference-counted block of received data. Objects that are
+deserialized from it can point into it instead of copying their contents out, as
+long as they hold a reference to it. The references may be released on any
+thread. */
+class shared_buffer_t
+    : public slow_atomic_countable_t<shared_buffer_t>,
+      public small_object_allocated_t<small_object_kind_t::mailbox_buffer> {
+public:
+    explicit shared_buffer_t(std::vector<char> &&_data) : data(std::move(_data)) { }
+
+private:
+    friend class shared_buffer_read_stream_t;
+
+    std::vector<char> data;
+
+    DISABLE_COPYING(shared_buffer_t);
+};
+
+/* Like `vector_read_stream_t`, but the data goes into a `shared_buffer_t` and
+deserializers can borrow slices of it with `borrow()` instead of reading them. */
+class shared_buffer_read_stream_t : public read_stream_t {
+public:
+    explicit shared_buffer_read_stream_t(std::vector<char> &&vector, int64_t offset = 0);
+    virtual ~shared_buffer_read_stream_t();
+
+    virtual MUST_USE int64_t read(void *p, int64_t n);
+
+    /* Consumes the next `n` bytes without copying them: sets `*data_out` to point at
+    them and `*buffer_out` to the buffer that holds them, and returns true. The byte
+    after the slice is overwritten with '\0' so that the slice can be used as a C
+    string; the stream still returns its real value to the next `read()`.
+
+    Returns false without consuming anything if fewer than `n + 1` bytes are left, or
+    if the first byte is already holding the terminator of the previous slice. The
+    caller should `read()` the data instead then. */
+    MUST_USE bool borrow(int64_t n, const char **data_out,
+                         counted_t<shared_buffer_t> *buffer_out);
+
+private:
+    const counted_t<shared_buffer_t> buffer;
+    const int64_t end;
+    int64_t pos;
+
+    /* The terminator of the last borrowed slice is at `terminator_pos`, and the
+    byte that was there before is `terminator_byte`. */
+    int64_t terminator_pos;
+    char terminator_byte;
+
+    DISABLE_COPYING(shared_buffer_read_stream_t);
+};
+
+#endif  // CONTAINERS_ARCHIVE_SHARED_BUFFER_STREAM_HPP_
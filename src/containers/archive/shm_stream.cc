@@ -0,0 +1,281 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "containers/archive/shm_stream.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+
+#include "arch/runtime/system_event/eventfd.hpp"
+#include "concurrency/interruptor.hpp"
+#include "concurrency/wait_any.hpp"
+
+// The total numbers of bytes ever written to and read from a ring.  Only the side
+// that writes the ring moves `written`, and only the other side moves `read`.
+struct shm_ring_t {
+    std::atomic<uint64_t> written;
+    std::atomic<uint64_t> read;
+};
+
+// The start of the shared memory.  The data of both rings follows it.
+struct shm_header_t {
+    uint64_t ring_size;
+    // Written by the parent and by the child, respectively.
+    shm_ring_t rings[2];
+    // Set by a side that is about to wait on its eventfd.
+    std::atomic<uint32_t> waiting[2];
+};
+
+// glibc of this vintage has no wrapper for memfd_create.
+static int sys_memfd_create(const char *name, unsigned int flags) {
+    return syscall(__NR_memfd_create, name, flags);
+}
+
+static void make_nonblocking_eventfd(scoped_fd_t *out) {
+    const fd_t fd = eventfd(0, 0);
+    guarantee_err(fd != -1, "could not create eventfd for worker process");
+    out->reset(fd);
+    const int res = fcntl(fd, F_SETFL, O_NONBLOCK);
+    guarantee_err(res == 0, "could not make eventfd for worker process non-blocking");
+}
+
+shm_channel_t::shm_channel_t(size_t ring_size) :
+    header(NULL), data(NULL), mapping_size(sizeof(shm_header_t) + 2 * ring_size) {
+    guarantee(ring_size > 0);
+
+    const fd_t fd = sys_memfd_create("rethinkdb-extproc", 0);
+    guarantee_err(fd != -1, "could not create shared memory for worker process");
+    memory_fd.reset(fd);
+    const int res = ftruncate(fd, mapping_size);
+    guarantee_err(res == 0, "could not size shared memory for worker process");
+
+    make_nonblocking_eventfd(&event_fds[0]);
+    make_nonblocking_eventfd(&event_fds[1]);
+
+    map();
+    new (header) shm_header_t;
+    header->ring_size = ring_size;
+    for (int i = 0; i < 2; ++i) {
+        header->rings[i].written.store(0);
+        header->rings[i].read.store(0);
+        header->waiting[i].store(0);
+    }
+}
+
+shm_channel_t::shm_channel_t(const fd_t fds[num_fds]) :
+    header(NULL), data(NULL), mapping_size(0) {
+    memory_fd.reset(fds[0]);
+    event_fds[0].reset(fds[1]);
+    event_fds[1].reset(fds[2]);
+
+    struct stat st;
+    const int res = fstat(memory_fd.get(), &st);
+    guarantee_err(res == 0, "could not stat shared memory from main process");
+    guarantee(static_cast<size_t>(st.st_size) > sizeof(shm_header_t));
+    mapping_size = st.st_size;
+
+    map();
+    guarantee(mapping_size == sizeof(shm_header_t) + 2 * header->ring_size);
+}
+
+shm_channel_t::~shm_channel_t() {
+    const int res = munmap(header, mapping_size);
+    guarantee_err(res == 0, "could not unmap shared memory of worker process");
+}
+
+void shm_channel_t::get_fds(fd_t fds_out[num_fds]) {
+    fds_out[0] = memory_fd.get();
+    fds_out[1] = event_fds[0].get();
+    fds_out[2] = event_fds[1].get();
+}
+
+void shm_channel_t::map() {
+    void *res = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     memory_fd.get(), 0);
+    guarantee_err(res != MAP_FAILED, "could not map shared memory of worker process");
+    header = static_cast<shm_header_t *>(res);
+    data = static_cast<char *>(res) + sizeof(shm_header_t);
+}
+
+shm_stream_t::shm_stream_t(shm_channel_t *_channel, side_t _side, fd_t _peer_socket) :
+    channel(_channel),
+    side(_side),
+    peer_socket(_peer_socket),
+    interruptor(NULL),
+    closed(false) {
+    guarantee(peer_socket != INVALID_FD);
+    if (side == PARENT_SIDE) {
+        event_watcher.init(
+            new linux_event_watcher_t(channel->event_fds[side].get(), this));
+        peer_socket_watcher.init(new linux_event_watcher_t(peer_socket, this));
+    }
+}
+
+shm_stream_t::~shm_stream_t() { }
+
+int64_t shm_stream_t::readable_bytes() const {
+    const shm_ring_t *ring = &channel->header->rings[1 - side];
+    const uint64_t used = ring->written.load() - ring->read.load();
+    if (used > channel->header->ring_size) {
+        return -1;
+    }
+    return used;
+}
+
+int64_t shm_stream_t::writable_bytes() const {
+    const shm_ring_t *ring = &channel->header->rings[side];
+    const uint64_t used = ring->written.load() - ring->read.load();
+    if (used > channel->header->ring_size) {
+        return -1;
+    }
+    return channel->header->ring_size - used;
+}
+
+int64_t shm_stream_t::read(void *p, int64_t n) {
+    guarantee(n > 0);
+    if (closed) {
+        return -1;
+    }
+
+    const int64_t available = wait_until(&shm_stream_t::readable_bytes);
+    if (available == -1) {
+        closed = true;
+        return -1;
+    }
+
+    shm_ring_t *ring = &channel->header->rings[1 - side];
+    const uint64_t ring_size = channel->header->ring_size;
+    const char *ring_data = channel->data + (1 - side) * ring_size;
+    const uint64_t read_so_far = ring->read.load();
+    const uint64_t size = std::min(n, available);
+    const uint64_t start = read_so_far % ring_size;
+    const uint64_t before_wrap = std::min(size, ring_size - start);
+    memcpy(p, ring_data + start, before_wrap);
+    memcpy(static_cast<char *>(p) + before_wrap, ring_data, size - before_wrap);
+    ring->read.store(read_so_far + size);
+
+    wake_peer();
+    return size;
+}
+
+int64_t shm_stream_t::write(const void *p, int64_t n) {
+    guarantee(n > 0);
+    if (closed) {
+        return -1;
+    }
+
+    shm_ring_t *ring = &channel->header->rings[side];
+    const uint64_t ring_size = channel->header->ring_size;
+    char *ring_data = channel->data + side * ring_size;
+    const char *bufp = static_cast<const char *>(p);
+    int64_t remaining = n;
+    while (remaining > 0) {
+        const int64_t space = wait_until(&shm_stream_t::writable_bytes);
+        if (space == -1) {
+            closed = true;
+            return -1;
+        }
+
+        const uint64_t written_so_far = ring->written.load();
+        const uint64_t size = std::min(remaining, space);
+        const uint64_t start = written_so_far % ring_size;
+        const uint64_t before_wrap = std::min(size, ring_size - start);
+        memcpy(ring_data + start, bufp, before_wrap);
+        memcpy(ring_data, bufp + before_wrap, size - before_wrap);
+        ring->written.store(written_so_far + size);
+
+        wake_peer();
+        bufp += size;
+        remaining -= size;
+    }
+    return n;
+}
+
+int64_t shm_stream_t::wait_until(int64_t (shm_stream_t::*can_proceed)() const) {
+    std::atomic<uint32_t> *waiting = &channel->header->waiting[side];
+    for (;;) {
+        int64_t res = (this->*can_proceed)();
+        if (res != 0) {
+            return res;
+        }
+
+        // Wakeups from before here are stale.  The other side only writes our
+        // eventfd if it sees `waiting`, so we have to look again after setting it.
+        uint64_t value;
+        ssize_t read_res;
+        do {
+            read_res = ::read(channel->event_fds[side].get(), &value, sizeof(value));
+        } while (read_res == -1 && get_errno() == EINTR);
+        guarantee_err(read_res == sizeof(value) || get_errno() == EAGAIN,
+                      "could not read eventfd of shared memory stream");
+        waiting->store(1);
+
+        res = (this->*can_proceed)();
+        if (res != 0) {
+            waiting->store(0);
+            return res;
+        }
+        if (!sleep()) {
+            return -1;
+        }
+    }
+}
+
+bool shm_stream_t::sleep() {
+    if (side == CHILD_SIDE) {
+        // The child isn't on the event loop, and isn't interruptible.
+        pollfd fds[2];
+        fds[0].fd = channel->event_fds[side].get();
+        fds[0].events = POLLIN;
+        fds[1].fd = peer_socket;
+        fds[1].events = POLLIN;
+        int res;
+        do {
+            fds[0].revents = fds[1].revents = 0;
+            res = poll(fds, 2, -1);
+        } while (res == -1 && get_errno() == EINTR);
+        guarantee_err(res > 0, "could not poll eventfd of shared memory stream");
+        // The parent never writes to the socket, so it's only readable once closed.
+        return fds[1].revents == 0;
+    }
+
+    linux_event_watcher_t::watch_t notified(event_watcher.get(), poll_event_in);
+    linux_event_watcher_t::watch_t peer_closed(peer_socket_watcher.get(),
+                                               poll_event_in);
+    wait_any_t waiter(&notified, &peer_closed, &peer_gone);
+    if (interruptor != NULL) {
+        waiter.add(interruptor);
+    }
+    waiter.wait_lazily_unordered();
+
+    if (interruptor != NULL && interruptor->is_pulsed()) {
+        closed = true;
+        throw interrupted_exc_t();
+    }
+    // Likewise, the child never writes to the socket.
+    return !peer_closed.is_pulsed() && !peer_gone.is_pulsed();
+}
+
+void shm_stream_t::wake_peer() {
+    const int peer = 1 - side;
+    if (channel->header->waiting[peer].exchange(0) != 0) {
+        const uint64_t value = 1;
+        ssize_t res;
+        do {
+            res = ::write(channel->event_fds[peer].get(), &value, sizeof(value));
+        } while (res == -1 && get_errno() == EINTR);
+        guarantee_err(res == sizeof(value),
+                      "could not write eventfd of shared memory stream");
+    }
+}
+
+void shm_stream_t::on_event(UNUSED int events) {
+    // Only the socket gets errors, when the other process dies.
+    peer_gone.pulse_if_not_already_pulsed();
+}
@@ -0,0 +1,104 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CONTAINERS_ARCHIVE_SHM_STREAM_HPP_
+#define CONTAINERS_ARCHIVE_SHM_STREAM_HPP_
+
+#include "arch/io/event_watcher.hpp"
+#include "arch/io/io_utils.hpp"
+#include "concurrency/cond_var.hpp"
+#include "containers/archive/archive.hpp"
+#include "containers/scoped.hpp"
+#include "errors.hpp"
+
+struct shm_header_t;
+
+/* The memory and eventfds that a process and a child process it spawned share, so
+that they can talk through a pair of `shm_stream_t`s.  The memory holds a ring of
+bytes for each direction.  Each side has an eventfd that the other side writes to
+when it puts data in the side's incoming ring or makes room in its outgoing ring, but
+only if the side has said it is about to wait, so a busy stream makes no system calls
+at all. */
+class shm_channel_t {
+public:
+    static const size_t num_fds = 3;
+
+    // Creates a new channel with rings of `ring_size` bytes.
+    explicit shm_channel_t(size_t ring_size);
+    // Takes ownership of the fds of a channel that another process created, as
+    // `get_fds` returned them.
+    explicit shm_channel_t(const fd_t fds[num_fds]);
+    ~shm_channel_t();
+
+    // The fds to send to the other process.  They still belong to us.
+    void get_fds(fd_t fds_out[num_fds]);
+
+private:
+    friend class shm_stream_t;
+
+    void map();
+
+    scoped_fd_t memory_fd;
+    // The eventfds the parent and the child wait on.
+    scoped_fd_t event_fds[2];
+
+    shm_header_t *header;
+    char *data;
+    size_t mapping_size;
+
+    DISABLE_COPYING(shm_channel_t);
+};
+
+/* One end of a stream through an `shm_channel_t`.  It shuts down if the other
+process dies, which it finds out through `peer_socket`, a socket to the other process
+that the other process never writes to.
+
+A parent stream waits on the event loop, so it has to be used on the thread it was
+created on, and it can be interrupted.  A child stream blocks the thread while it
+waits, and can't be. */
+class shm_stream_t :
+    public read_stream_t,
+    public write_stream_t,
+    private linux_event_callback_t
+{
+public:
+    enum side_t { PARENT_SIDE = 0, CHILD_SIDE = 1 };
+
+    shm_stream_t(shm_channel_t *channel, side_t side, fd_t peer_socket);
+    virtual ~shm_stream_t();
+
+    virtual MUST_USE int64_t read(void *p, int64_t n);
+    virtual int64_t write(const void *p, int64_t n);
+
+    void set_interruptor(signal_t *_interruptor) { interruptor = _interruptor; }
+
+private:
+    // Returns the number of bytes that can be read or written now, or -1 if the
+    // other process has left the rings in a state that makes no sense.
+    int64_t readable_bytes() const;
+    int64_t writable_bytes() const;
+
+    // Waits until `can_proceed` returns something but 0, and returns that.  Returns
+    // -1 if the other process died.  Raises interrupted_exc_t if `interruptor` is
+    // pulsed.  Either way, the stream is shut down.
+    int64_t wait_until(int64_t (shm_stream_t::*can_proceed)() const);
+    // Sleeps until the other side writes our eventfd, or until it dies (in which
+    // case it returns false).
+    bool sleep();
+    void wake_peer();
+
+    void on_event(int events);  // for linux_event_callback_t
+
+    shm_channel_t *channel;
+    side_t side;
+    fd_t peer_socket;
+    signal_t *interruptor;
+    bool closed;
+
+    // Only for a parent stream.
+    scoped_ptr_t<linux_event_watcher_t> event_watcher;
+    scoped_ptr_t<linux_event_watcher_t> peer_socket_watcher;
+    cond_t peer_gone;
+
+    DISABLE_COPYING(shm_stream_t);
+};
+
+#endif  // CONTAINERS_ARCHIVE_SHM_STREAM_HPP_
@@ -9,6 +9,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <utility>
 
@@ -128,11 +129,45 @@ size_t serialized_size(const std::string &s);
 write_message_t &operator<<(write_message_t &msg, const std::string &s);
 MUST_USE archive_result_t deserialize(read_stream_t *s, std::string *out);
 
-// Think twice before using this function on vectors containing a primitive type --
-// it'll take O(n) time!
-// Keep in sync with operator<<.
+// Vectors of types that are serialized_as_raw_t are sent with one copy, in the same
+// format as the element-by-element path below.
 template <class T>
-size_t serialized_size(const std::vector<T> &v) {
+size_t serialized_size(const std::vector<T> &v, std::true_type) {
+    return varint_uint64_serialized_size(v.size()) + v.size() * sizeof(T);
+}
+
+template <class T>
+void serialize_vector_elements(write_message_t *msg, const std::vector<T> &v,
+                               std::true_type) {
+    static_assert(std::is_trivial<T>::value, "serialized_as_raw_t types must be trivial");
+    if (!v.empty()) {
+        msg->append(v.data(), v.size() * sizeof(T));
+    }
+}
+
+template <class T>
+MUST_USE archive_result_t deserialize_vector_elements(read_stream_t *s,
+                                                      std::vector<T> *v,
+                                                      std::true_type) {
+    static_assert(std::is_trivial<T>::value, "serialized_as_raw_t types must be trivial");
+    if (v->empty()) {
+        return archive_result_t::SUCCESS;
+    }
+    const int64_t size = v->size() * sizeof(T);
+    int64_t res = force_read(s, v->data(), size);
+    if (res == -1) {
+        return archive_result_t::SOCK_ERROR;
+    }
+    if (res < size) {
+        return archive_result_t::SOCK_EOF;
+    }
+    return archive_result_t::SUCCESS;
+}
+
+// Think twice before using this function on vectors containing a primitive type
+// that isn't serialized_as_raw_t -- it'll take O(n) time!
+template <class T>
+size_t serialized_size(const std::vector<T> &v, std::false_type) {
     size_t ret = varint_uint64_serialized_size(v.size());
     for (auto it = v.begin(), e = v.end(); it != e; ++it) {
         ret += serialized_size(*it);
@@ -140,15 +175,36 @@ size_t serialized_size(const std::vector<T> &v) {
     return ret;
 }
 
+template <class T>
+void serialize_vector_elements(write_message_t *msg, const std::vector<T> &v,
+                               std::false_type) {
+    for (auto it = v.begin(), e = v.end(); it != e; ++it) {
+        *msg << *it;
+    }
+}
+
+template <class T>
+MUST_USE archive_result_t deserialize_vector_elements(read_stream_t *s,
+                                                      std::vector<T> *v,
+                                                      std::false_type) {
+    for (size_t i = 0; i < v->size(); ++i) {
+        archive_result_t res = deserialize(s, &(*v)[i]);
+        if (bad(res)) { return res; }
+    }
+    return archive_result_t::SUCCESS;
+}
+
+// Keep in sync with operator<<.
+template <class T>
+size_t serialized_size(const std::vector<T> &v) {
+    return serialized_size(v, serialized_as_raw_t<T>());
+}
 
 // Keep in sync with serialized_size.
 template <class T>
 write_message_t &operator<<(write_message_t &msg, const std::vector<T> &v) {
     serialize_varint_uint64(&msg, v.size());
-    for (auto it = v.begin(), e = v.end(); it != e; ++it) {
-        msg << *it;
-    }
-
+    serialize_vector_elements(&msg, v, serialized_as_raw_t<T>());
     return msg;
 }
 
@@ -160,17 +216,15 @@ MUST_USE archive_result_t deserialize(read_stream_t *s, std::vector<T> *v) {
     archive_result_t res = deserialize_varint_uint64(s, &sz);
     if (bad(res)) { return res; }
 
-    if (sz > std::numeric_limits<size_t>::max()) {
+    if (sz > std::numeric_limits<size_t>::max()
+        || (serialized_as_raw_t<T>::value
+            && sz > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())
+                    / sizeof(T))) {
         return archive_result_t::RANGE_ERROR;
     }
 
     v->resize(sz);
-    for (uint64_t i = 0; i < sz; ++i) {
-        res = deserialize(s, &(*v)[i]);
-        if (bad(res)) { return res; }
-    }
-
-    return archive_result_t::SUCCESS;
+    return deserialize_vector_elements(s, v, serialized_as_raw_t<T>());
 }
 
 // TODO: Stop using std::list! What are you thinking?
@@ -1,44 +1,31 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "containers/archive/varint.hpp"
 
-size_t varint_uint64_serialized_size(uint64_t value) {
-    size_t count = 0;
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
-    ++count;
-    value /= 128;
-
-    while (value > 0) {
-        value /= 128;
-        ++count;
-    }
-
-    return count;
-}
-
-void serialize_varint_uint64(write_message_t *msg, const uint64_t value) {
+void serialize_varint_uint64_slow(write_message_t *msg, const uint64_t value) {
     // buf needs to be 10 or more -- ceil(64/7) is 10.
     uint8_t buf[16];
     size_t size = 0;
-    if (value == 0) {
-        buf[0] = 0;
-        size = 1;
-    } else {
-        uint64_t n = value;
-        while (n >= (1 << 7)) {
-            buf[size] = ((n & ((1 << 7) - 1)) | (1 << 7));
-            ++size;
-            n >>= 7;
-        }
-        buf[size] = n;
+    uint64_t n = value;
+    while (n >= (1 << 7)) {
+        buf[size] = ((n & ((1 << 7) - 1)) | (1 << 7));
         ++size;
+        n >>= 7;
     }
+    buf[size] = n;
+    ++size;
     msg->append(buf, size);
 }
 
-archive_result_t deserialize_varint_uint64(read_stream_t *s, uint64_t *value_out) {
-    uint64_t value = 0;
+archive_result_t deserialize_varint_uint64_slow(read_stream_t *s, uint8_t first_byte,
+                                                uint64_t *value_out) {
+    rassert((first_byte & (1 << 7)) != 0);
+    uint64_t value = (first_byte & ((1 << 7) - 1));
 
-    int offset = 0;
+    int offset = 7;
     for (;;) {
         uint8_t buf[1];
         int64_t res = s->read(buf, 1);
@@ -67,3 +54,64 @@ archive_result_t deserialize_varint_uint64(read_stream_t *s, uint64_t *value_out
     }
 }
 
+// Decodes one varint from `[*p, end)`, the same way `deserialize_varint_uint64`
+// does from a stream.
+static archive_result_t decode_varint_uint64(const char **p, const char *end,
+                                             uint64_t *value_out) {
+    const char *q = *p;
+    uint64_t value = 0;
+    for (int offset = 0; q != end; offset += 7) {
+        const uint8_t byte = *q;
+        ++q;
+        uint64_t x = (byte & ((1 << 7) - 1));
+        value |= (x << offset);
+        if ((byte & (1 << 7)) == 0) {
+            if (offset == 63 && x > 1) {
+                return archive_result_t::RANGE_ERROR;
+            }
+            *value_out = value;
+            *p = q;
+            return archive_result_t::SUCCESS;
+        }
+        if (offset == 63) {
+            return archive_result_t::RANGE_ERROR;
+        }
+    }
+    return archive_result_t::SOCK_EOF;
+}
+
+archive_result_t decode_varint_uint64s(const char **p, const char *end, size_t count,
+                                       uint64_t *values_out) {
+    const char *q = *p;
+    size_t i = 0;
+#ifdef __SSE2__
+    // Most varints are small enough to be one byte.  We find the bytes with the
+    // continuation bit set 16 at a time, and copy the one-byte varints before the
+    // first of them out directly.
+    while (count - i >= 16 && end - q >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(q));
+        const int continued = _mm_movemask_epi8(chunk);
+        const int run = continued == 0 ? 16 : __builtin_ctz(continued);
+        for (int j = 0; j < run; ++j) {
+            values_out[i + j] = static_cast<uint8_t>(q[j]);
+        }
+        i += run;
+        q += run;
+        if (run < 16) {
+            archive_result_t res = decode_varint_uint64(&q, end, &values_out[i]);
+            if (bad(res)) {
+                return res;
+            }
+            ++i;
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        archive_result_t res = decode_varint_uint64(&q, end, &values_out[i]);
+        if (bad(res)) {
+            return res;
+        }
+    }
+    *p = q;
+    return archive_result_t::SUCCESS;
+}
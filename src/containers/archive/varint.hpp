@@ -21,8 +21,49 @@
 // Unlike protocol buffers does (or what its documentation claims it does), we don't
 // silently truncate out-of-range varints when decoding.
 
-size_t varint_uint64_serialized_size(uint64_t value);
-void serialize_varint_uint64(write_message_t *msg, const uint64_t value);
-archive_result_t deserialize_varint_uint64(read_stream_t *s, uint64_t *value_out);
+inline size_t varint_uint64_serialized_size(uint64_t value) {
+    // One byte for every 7 bits, and one for zero.
+    return (64 - __builtin_clzll(value | 1) + 6) / 7;
+}
+
+void serialize_varint_uint64_slow(write_message_t *msg, const uint64_t value);
+
+inline void serialize_varint_uint64(write_message_t *msg, const uint64_t value) {
+    if (value < (1 << 7)) {
+        const uint8_t byte = value;
+        msg->append(&byte, 1);
+    } else {
+        serialize_varint_uint64_slow(msg, value);
+    }
+}
+
+archive_result_t deserialize_varint_uint64_slow(read_stream_t *s, uint8_t first_byte,
+                                                uint64_t *value_out);
+
+inline archive_result_t deserialize_varint_uint64(read_stream_t *s,
+                                                  uint64_t *value_out) {
+    uint8_t first_byte;
+    int64_t res = s->read(&first_byte, 1);
+    if (res == 1) {
+        if ((first_byte & (1 << 7)) == 0) {
+            *value_out = first_byte;
+            return archive_result_t::SUCCESS;
+        }
+        return deserialize_varint_uint64_slow(s, first_byte, value_out);
+    } else if (res == -1) {
+        return archive_result_t::SOCK_ERROR;
+    } else {
+        rassert(res == 0);
+        return archive_result_t::SOCK_EOF;
+    }
+}
+
+// Decodes `count` varints from the buffer `[*p, end)` into `values_out` and moves
+// `*p` past them.  A stream has to be read a byte at a time to find where a varint
+// ends, so when there are a lot of varints in a row, it's much cheaper to read them
+// into a buffer and decode them here.  Returns SOCK_EOF if the buffer ends before
+// the last varint does.
+archive_result_t decode_varint_uint64s(const char **p, const char *end, size_t count,
+                                       uint64_t *values_out);
 
 #endif  // CONTAINERS_ARCHIVE_VARINT_HPP_
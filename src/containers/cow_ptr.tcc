@@ -79,6 +79,10 @@ void cow_ptr_t<T>::set(const T &new_value) {
 template <class T>
 bool cow_ptr_t<T>::operator==(const cow_ptr_t<T> &other) const {
     guarantee(ptr.has() && other.ptr.has());
+    // Copies share their pointee until one of them changes, so this is common.
+    if (ptr.get() == other.ptr.get()) {
+        return true;
+    }
     return *ptr == *other.ptr;
 }
 
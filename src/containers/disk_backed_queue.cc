@@ -10,17 +10,34 @@
 
 #define DBQ_MAX_REF_SIZE 251
 
-internal_disk_backed_queue_t::internal_disk_backed_queue_t(io_backender_t *io_backender,
-                                                           const serializer_filepath_t &filename,
-                                                           perfmon_collection_t *stats_parent)
+// Queues are written and read front to back, so they use larger blocks than tables
+// do: each block holds more values, and popping through it takes fewer reads.
+#define DBQ_BLOCK_SIZE (16 * KILOBYTE)
+
+internal_disk_backed_queue_t::internal_disk_backed_queue_t(io_backender_t *_io_backender,
+                                                           const serializer_filepath_t &_filename,
+                                                           perfmon_collection_t *stats_parent,
+                                                           int64_t _memory_limit)
     : perfmon_membership(stats_parent, &perfmon_collection,
-                         filename.permanent_path().c_str()),
+                         _filename.permanent_path().c_str()),
+      io_backender(_io_backender),
+      filename(_filename),
       queue_size(0),
+      memory_limit(_memory_limit),
+      memory_segment_size(0),
+      disk_queue_size(0),
       head_block_id(NULL_BLOCK_ID),
       tail_block_id(NULL_BLOCK_ID) {
+    guarantee(memory_limit >= 0);
+}
+
+internal_disk_backed_queue_t::~internal_disk_backed_queue_t() { }
+
+void internal_disk_backed_queue_t::create_disk_queue() {
+    rassert(!cache.has());
     filepath_file_opener_t file_opener(filename, io_backender);
     standard_serializer_t::create(&file_opener,
-                                  standard_serializer_t::static_config_t());
+                                  standard_serializer_t::static_config_t(DBQ_BLOCK_SIZE));
 
     serializer.init(new standard_serializer_t(standard_serializer_t::dynamic_config_t(),
                                               &file_opener,
@@ -46,20 +63,72 @@ internal_disk_backed_queue_t::internal_disk_backed_queue_t(io_backender_t *io_ba
     memset(buf, 0, block_size.value());
 }
 
-internal_disk_backed_queue_t::~internal_disk_backed_queue_t() { }
-
 void internal_disk_backed_queue_t::push(const write_message_t &wm) {
+    push_many(std::vector<const write_message_t *>(1, &wm));
+}
+
+void internal_disk_backed_queue_t::push_many(
+        const std::vector<const write_message_t *> &values) {
+    if (values.empty()) {
+        return;
+    }
     mutex_t::acq_t mutex_acq(&mutex);
 
-    // There's no need for hard durability with an unlinked dbq file.
+    if (memory_limit == 0) {
+        if (!cache.has()) {
+            create_disk_queue();
+        }
+        // There's no need for hard durability with an unlinked dbq file.
+        txn_t txn(cache_conn.get(), write_durability_t::SOFT,
+                  repli_timestamp_t::distant_past, 2);
+        for (auto it = values.begin(); it != values.end(); ++it) {
+            push_to_head(&txn, **it);
+        }
+        disk_queue_size += values.size();
+    } else {
+        for (auto it = values.begin(); it != values.end(); ++it) {
+            vector_stream_t stream;
+            stream.reserve((*it)->size());
+            int res = send_write_message(&stream, *it);
+            guarantee(res == 0);
+            memory_segment.push_back(std::vector<char>());
+            stream.swap(&memory_segment.back());
+            memory_segment_size += memory_segment.back().size();
+        }
+        if (memory_segment_size > memory_limit) {
+            spill_memory_segment();
+        }
+    }
+
+    queue_size += values.size();
+}
+
+void internal_disk_backed_queue_t::spill_memory_segment() {
+    if (!cache.has()) {
+        create_disk_queue();
+    }
     txn_t txn(cache_conn.get(), write_durability_t::SOFT,
               repli_timestamp_t::distant_past, 2);
+    // We spill down to half the limit, so that a queue that stays near its limit
+    // goes to disk in batches instead of on every push.
+    while (memory_segment_size > memory_limit / 2) {
+        const std::vector<char> &oldest = memory_segment.front();
+        write_message_t wm;
+        wm.append(oldest.data(), oldest.size());
+        push_to_head(&txn, wm);
+        ++disk_queue_size;
+        memory_segment_size -= oldest.size();
+        memory_segment.pop_front();
+    }
+}
 
+void internal_disk_backed_queue_t::push_to_head(txn_t *txn,
+                                                const write_message_t &wm) {
     if (head_block_id == NULL_BLOCK_ID) {
-        add_block_to_head(&txn);
+        add_block_to_head(txn);
     }
 
-    auto _head = make_scoped<buf_lock_t>(buf_parent_t(&txn), head_block_id,
+    auto _head = make_scoped<buf_lock_t>(buf_parent_t(txn), head_block_id,
                                          access_t::write);
     auto write = make_scoped<buf_write_t>(_head.get());
     queue_block_t *head = static_cast<queue_block_t *>(write->get_data_write());
@@ -76,8 +145,8 @@ void internal_disk_backed_queue_t::push(const write_message_t &wm) {
         head = NULL;
         write.reset();
         _head.reset();
-        add_block_to_head(&txn);
-        _head.init(new buf_lock_t(buf_parent_t(&txn), head_block_id,
+        add_block_to_head(txn);
+        _head.init(new buf_lock_t(buf_parent_t(txn), head_block_id,
                                   access_t::write));
         write.init(new buf_write_t(_head.get()));
         head = static_cast<queue_block_t *>(write->get_data_write());
@@ -86,20 +155,45 @@ void internal_disk_backed_queue_t::push(const write_message_t &wm) {
     memcpy(head->data + head->data_size, buffer,
            blob.refsize(cache->max_block_size()));
     head->data_size += blob.refsize(cache->max_block_size());
-
-    queue_size++;
 }
 
 void internal_disk_backed_queue_t::pop(buffer_group_viewer_t *viewer) {
+    pop_many(viewer, 1);
+}
+
+void internal_disk_backed_queue_t::pop_many(buffer_group_viewer_t *viewer,
+                                            int64_t max_values) {
     guarantee(size() != 0);
+    guarantee(max_values > 0);
     mutex_t::acq_t mutex_acq(&mutex);
 
-    char buffer[DBQ_MAX_REF_SIZE];
-    // No need for hard durability with an unlinked dbq file.
-    txn_t txn(cache_conn.get(), write_durability_t::SOFT,
-              repli_timestamp_t::distant_past, 2);
+    int64_t i = 0;
+    if (disk_queue_size != 0) {
+        // No need for hard durability with an unlinked dbq file.
+        txn_t txn(cache_conn.get(), write_durability_t::SOFT,
+                  repli_timestamp_t::distant_past, 2);
 
-    buf_lock_t _tail(buf_parent_t(&txn), tail_block_id, access_t::write);
+        for (; i < max_values && disk_queue_size != 0; ++i) {
+            pop_from_tail(&txn, viewer);
+        }
+    }
+
+    // The values in memory are all newer than the ones on disk.
+    for (; i < max_values && !memory_segment.empty(); ++i) {
+        const std::vector<char> &oldest = memory_segment.front();
+        const_buffer_group_t group;
+        group.add_buffer(oldest.size(), oldest.data());
+        viewer->view_buffer_group(&group);
+        memory_segment_size -= oldest.size();
+        memory_segment.pop_front();
+        queue_size--;
+    }
+}
+
+void internal_disk_backed_queue_t::pop_from_tail(txn_t *txn,
+                                                 buffer_group_viewer_t *viewer) {
+    char buffer[DBQ_MAX_REF_SIZE];
+    buf_lock_t _tail(buf_parent_t(txn), tail_block_id, access_t::write);
 
     /* Grab the data from the blob and delete it. */
     {
@@ -107,6 +201,12 @@ void internal_disk_backed_queue_t::pop(buffer_group_viewer_t *viewer) {
         const queue_block_t *tail
             = static_cast<const queue_block_t *>(read.get_data_read());
         rassert(tail->data_size != tail->live_data_offset);
+        // We're about to start on this block, so start loading the one after it
+        // while we pop through it.
+        if (tail->live_data_offset == 0 && tail->next != NULL_BLOCK_ID) {
+            cache->prefetch_blocks(std::vector<block_id_t>(1, tail->next),
+                                   txn->account());
+        }
         memcpy(buffer, tail->data + tail->live_data_offset,
                blob::ref_size(cache->max_block_size(),
                               tail->data + tail->live_data_offset,
@@ -141,12 +241,13 @@ void internal_disk_backed_queue_t::pop(buffer_group_viewer_t *viewer) {
     blob.clear(buf_parent_t(&_tail));
 
     queue_size--;
+    disk_queue_size--;
 
     _tail.reset_buf_lock();
 
     /* If that was the last blob in this block move on to the next one. */
     if (live_data_offset == data_size) {
-        remove_block_from_tail(&txn);
+        remove_block_from_tail(txn);
     }
 }
 
@@ -2,6 +2,7 @@
 #ifndef CONTAINERS_DISK_BACKED_QUEUE_HPP_
 #define CONTAINERS_DISK_BACKED_QUEUE_HPP_
 
+#include <deque>
 #include <string>
 #include <vector>
 
@@ -39,24 +40,42 @@ protected:
     DISABLE_COPYING(buffer_group_viewer_t);
 };
 
+/* The queue keeps its newest values in memory, up to `memory_limit` bytes of them,
+ * and only writes to its file once they don't fit.  Then it moves the oldest ones
+ * out to disk, so the values on disk are always older than the ones in memory.  The
+ * file isn't created until the first value goes to disk.  With a `memory_limit` of
+ * 0 every value goes straight to disk, which suits queues that are written once and
+ * then read back. */
 class internal_disk_backed_queue_t {
 public:
-    internal_disk_backed_queue_t(io_backender_t *io_backender, const serializer_filepath_t& filename, perfmon_collection_t *stats_parent);
+    internal_disk_backed_queue_t(io_backender_t *io_backender, const serializer_filepath_t& filename, perfmon_collection_t *stats_parent,
+                                 int64_t memory_limit = 0);
     ~internal_disk_backed_queue_t();
 
     // TODO: order_token_t::ignore.  This should take an order token and store it.
     void push(const write_message_t &value);
 
+    // Pushes the values in order, writing whatever goes to disk in one transaction.
+    void push_many(const std::vector<const write_message_t *> &values);
+
     // TODO: order_token_t::ignore.  This should output an order token (that was passed in to push).
     void pop(buffer_group_viewer_t *viewer);
 
+    // Pops up to `max_values` values, in one transaction, and shows each to `viewer`
+    // in turn.  The queue mustn't be empty.
+    void pop_many(buffer_group_viewer_t *viewer, int64_t max_values);
+
     bool empty();
 
     int64_t size();
 
 private:
+    void create_disk_queue();
+    void spill_memory_segment();
+    void push_to_head(txn_t *txn, const write_message_t &value);
     void add_block_to_head(txn_t *txn);
     void remove_block_from_tail(txn_t *txn);
+    void pop_from_tail(txn_t *txn, buffer_group_viewer_t *viewer);
 
     mutex_t mutex;
 
@@ -65,8 +84,19 @@ private:
     perfmon_collection_t perfmon_collection;
     perfmon_membership_t perfmon_membership;
 
+    io_backender_t *const io_backender;
+    const serializer_filepath_t filename;
+
+    // All the values, on disk and in memory.
     int64_t queue_size;
 
+    // The values newer than the ones on disk, serialized, oldest first.
+    const int64_t memory_limit;
+    std::deque<std::vector<char> > memory_segment;
+    int64_t memory_segment_size;
+
+    int64_t disk_queue_size;
+
     // The end we push onto.
     block_id_t head_block_id;
     // The end we pop from.
@@ -94,11 +124,32 @@ private:
     DISABLE_COPYING(deserializing_viewer_t);
 };
 
+template <class T>
+class appending_viewer_t : public buffer_group_viewer_t {
+public:
+    explicit appending_viewer_t(std::vector<T> *values_out) : values_out_(values_out) { }
+    virtual ~appending_viewer_t() { }
+
+    virtual void view_buffer_group(const const_buffer_group_t *group) {
+        values_out_->push_back(T());
+        deserialize_from_group(group, &values_out_->back());
+    }
+
+private:
+    std::vector<T> *values_out_;
+
+    DISABLE_COPYING(appending_viewer_t);
+};
+
 template <class T>
 class disk_backed_queue_t {
 public:
-    disk_backed_queue_t(io_backender_t *io_backender, const serializer_filepath_t& filename, perfmon_collection_t *stats_parent)
-        : internal_(io_backender, filename, stats_parent) { }
+    // The most values `push_many` serializes before handing them to the queue.
+    static const size_t push_batch_size = 100;
+
+    disk_backed_queue_t(io_backender_t *io_backender, const serializer_filepath_t& filename, perfmon_collection_t *stats_parent,
+                        int64_t memory_limit = 0)
+        : internal_(io_backender, filename, stats_parent, memory_limit) { }
 
     void push(const T &t) {
         // TODO: There's an unnecessary copying of data here (which would require a
@@ -108,11 +159,36 @@ public:
         internal_.push(wm);
     }
 
+    // Pushes the values in [begin, end) in order.  Cheaper than pushing them one at
+    // a time.
+    template <class iterator_t>
+    void push_many(iterator_t begin, iterator_t end) {
+        std::vector<scoped_ptr_t<write_message_t> > wms;
+        std::vector<const write_message_t *> batch;
+        while (begin != end) {
+            wms.clear();
+            batch.clear();
+            for (; begin != end && batch.size() < push_batch_size; ++begin) {
+                wms.push_back(make_scoped<write_message_t>());
+                *wms.back() << *begin;
+                batch.push_back(wms.back().get());
+            }
+            internal_.push_many(batch);
+        }
+    }
+
     void pop(T *out) {
         deserializing_viewer_t<T> viewer(out);
         internal_.pop(&viewer);
     }
 
+    // Appends up to `max_values` values to `out`.  Cheaper than popping them one
+    // at a time.
+    void pop_many(int64_t max_values, std::vector<T> *out) {
+        appending_viewer_t<T> viewer(out);
+        internal_.pop_many(&viewer, max_values);
+    }
+
     bool empty() {
         return internal_.empty();
     }
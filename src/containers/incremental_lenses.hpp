@@ -39,6 +39,16 @@ public:
         changed_keys.insert(key);
         inner[key] = std::move(value);
     }
+    // Returns a pointer through which the value of `key` can be changed in place.
+    // `key` must already be in the map.
+    inner_type *get_mutable_value(const key_type &key) {
+        rassert (current_version > 0, "You must call begin_version() before "
+            "performing any changes.");
+        typename std::map<key_type, inner_type>::iterator it = inner.find(key);
+        guarantee(it != inner.end());
+        changed_keys.insert(key);
+        return &it->second;
+    }
     void delete_value(const key_type &key) {
         rassert (current_version > 0, "You must call begin_version() before "
             "performing any changes.");
@@ -136,6 +136,13 @@ T priority_queue_t<T, Less>::pop() {
     return result;
 }
 
+template<class T, class Less>
+void priority_queue_t<T, Less>::rebuild() {
+    for (int i = static_cast<int>(heap.size() / 2) - 1; i >= 0; --i) {
+        bubble_down(i);
+    }
+}
+
 template<class T, class Less>
 void priority_queue_t<T, Less>::update(int index) {
     rassert(index >= 0);
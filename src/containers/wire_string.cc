@@ -6,6 +6,8 @@
 #include <string.h>
 #include <limits>
 
+#include "config/args.hpp"
+#include "containers/archive/shared_buffer_stream.hpp"
 #include "containers/archive/varint.hpp"
 #include "utils.hpp"
 
@@ -15,6 +17,8 @@ wire_string_t *wire_string_t::create(size_t _size) {
     void *raw_result = ::rmalloc(memory_size);
     wire_string_t *result = reinterpret_cast<wire_string_t *>(raw_result);
     result->size_ = _size;
+    result->contents_ = result->data_;
+    result->buffer_ = NULL;
     // Append a 0 character to allow for an efficient `c_str()`
     result->data_[_size] = '\0';
     return result;
@@ -24,26 +28,48 @@ wire_string_t *wire_string_t::create_and_init(size_t _size, const char *_data) {
     memcpy(result->data_, _data, _size);
     return result;
 }
+wire_string_t *wire_string_t::create_borrowed(counted_t<shared_buffer_t> &&buffer,
+                                              const char *_data, size_t _size) {
+    rassert(_data[_size] == '\0');
+    void *raw_result = ::rmalloc(sizeof(wire_string_t));
+    wire_string_t *result = reinterpret_cast<wire_string_t *>(raw_result);
+    result->size_ = _size;
+    result->contents_ = _data;
+    // The reference that `buffer` held now belongs to the string.
+    result->buffer_ = buffer.get();
+    counted_add_ref(result->buffer_);
+    buffer.reset();
+    return result;
+}
+wire_string_t::~wire_string_t() {
+    if (buffer_ != NULL) {
+        counted_release(buffer_);
+    }
+}
 void wire_string_t::operator delete(void *p) {
     ::free(p);
 }
 
 const char *wire_string_t::c_str() const {
-    return data_;
+    return contents_;
 }
 char *wire_string_t::data() {
+    rassert(!is_borrowed());
     return data_;
 }
 const char *wire_string_t::data() const {
-    return data_;
+    return contents_;
 }
 size_t wire_string_t::size() const {
     return size_;
 }
+bool wire_string_t::is_borrowed() const {
+    return buffer_ != NULL;
+}
 
 int wire_string_t::compare(const wire_string_t &other) const {
     size_t common_size = std::min(size_, other.size_);
-    int content_compare = memcmp(data_, other.data_, common_size);
+    int content_compare = memcmp(contents_, other.contents_, common_size);
     if (content_compare == 0) {
         // Both strings have the same first `content_compare` characters.
         // Compare their lengths.
@@ -60,8 +86,8 @@ int wire_string_t::compare(const wire_string_t &other) const {
 }
 
 bool wire_string_t::operator==(const char *other) const {
-    rassert(data_[size_] == '\0');
-    return strcmp(data_, other) == 0;
+    rassert(contents_[size_] == '\0');
+    return strcmp(contents_, other) == 0;
 }
 bool wire_string_t::operator==(const wire_string_t &other) const {
     return compare(other) == 0;
@@ -83,13 +109,13 @@ bool wire_string_t::operator>=(const wire_string_t &other) const {
 }
 
 std::string wire_string_t::to_std() const {
-    return std::string(data_, size_);
+    return std::string(contents_, size_);
 }
 
 wire_string_t *wire_string_t::operator+(const wire_string_t &other) const {
     wire_string_t *result = create(size_ + other.size_);
-    memcpy(result->data_, data_, size_);
-    memcpy(&result->data_[size_], other.data_, other.size_);
+    memcpy(result->data_, contents_, size_);
+    memcpy(&result->data_[size_], other.contents_, other.size_);
     return result;
 }
 
@@ -115,6 +141,20 @@ archive_result_t deserialize(read_stream_t *s, wire_string_t **out) THROWS_NOTHI
         return archive_result_t::RANGE_ERROR;
     }
 
+    // Big strings from a received message point into the message instead of being
+    // copied out of it.
+    if (sz >= WIRE_STRING_MIN_BORROW_SIZE) {
+        shared_buffer_read_stream_t *shared_stream
+            = dynamic_cast<shared_buffer_read_stream_t *>(s);
+        const char *data;
+        counted_t<shared_buffer_t> buffer;
+        if (shared_stream != NULL
+            && shared_stream->borrow(static_cast<int64_t>(sz), &data, &buffer)) {
+            *out = wire_string_t::create_borrowed(std::move(buffer), data, sz);
+            return archive_result_t::SUCCESS;
+        }
+    }
+
     *out = wire_string_t::create(sz);
 
     int64_t num_read = force_read(s, (*out)->data(), sz);
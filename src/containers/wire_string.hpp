@@ -5,6 +5,9 @@
 #include <string>
 
 #include "containers/archive/archive.hpp"
+#include "containers/counted.hpp"
+
+class shared_buffer_t;
 
 /* `wire_string_t` is a length-prefixed ("Pascal style") string.
  * This has two advantages over C-strings:
@@ -16,6 +19,12 @@
  * `wire_string_t` has no public constructors, and doesn't have
  * a fixed size. You can allocate one through the create() or create_and_init()
  * function. The returned object can be freed by using the delete operator.
+ *
+ * A `wire_string_t` created by `create_borrowed()` doesn't hold its contents itself,
+ * but points into a `shared_buffer_t` that it keeps a reference to. `deserialize()`
+ * creates such strings from a `shared_buffer_read_stream_t` for strings of at least
+ * `WIRE_STRING_MIN_BORROW_SIZE` bytes. The contents of borrowed strings can't be
+ * changed through `data()`.
  */
 class wire_string_t {
 public:
@@ -23,6 +32,10 @@ public:
 
     static wire_string_t *create(size_t _size);
     static wire_string_t *create_and_init(size_t _size, const char *_data);
+    // `_data` must point into `buffer`, and `_data[_size]` must be '\0'.
+    static wire_string_t *create_borrowed(counted_t<shared_buffer_t> &&buffer,
+                                          const char *_data, size_t _size);
+    ~wire_string_t();
     static void operator delete(void *p);
 
     // The memory pointed to by the result to c_str() is guaranteed to be null
@@ -52,8 +65,14 @@ public:
     // The new string is the concatenation of this and other.
     wire_string_t *operator+(const wire_string_t &other) const;
 
+    bool is_borrowed() const;
+
 private:
     size_t size_;
+    // Points at `data_` unless the string is borrowed.
+    const char *contents_;
+    // The buffer the contents are borrowed from, or NULL.
+    shared_buffer_t *buffer_;
     char data_[1];
 
     DISABLE_COPYING(wire_string_t);
@@ -5,7 +5,8 @@
 
 extproc_job_t::extproc_job_t(extproc_pool_t *_pool,
                              bool (*worker_fn) (read_stream_t *, write_stream_t *),
-                             signal_t *_user_interruptor) :
+                             signal_t *_user_interruptor,
+                             const boost::optional<uint64_t> &affinity_key) :
     pool(_pool),
     user_error(false),
     user_interruptor(_user_interruptor),
@@ -15,9 +16,20 @@ extproc_job_t::extproc_job_t(extproc_pool_t *_pool,
         combined_interruptor.add(user_interruptor);
     }
 
-    worker_lock.create(pool->get_worker_semaphore(), &combined_interruptor);
+    if (affinity_key) {
+        const uint64_t key = *affinity_key;
+        worker_lock.create(pool->get_worker_semaphore(), &combined_interruptor,
+                           [key](const extproc_worker_t *worker) {
+                               return worker->has_affinity(key);
+                           });
+    } else {
+        worker_lock.create(pool->get_worker_semaphore(), &combined_interruptor);
+    }
 
     try {
+        if (affinity_key) {
+            worker_lock.get()->get_value()->add_affinity(*affinity_key);
+        }
         worker_lock.get()->get_value()->acquired(&combined_interruptor);
         worker_lock.get()->get_value()->run_job(worker_fn);
     } catch (...) {
@@ -4,6 +4,9 @@
 
 #include <exception>
 
+#include "errors.hpp"
+#include <boost/optional.hpp>
+
 #include "utils.hpp"
 #include "containers/archive/archive.hpp"
 #include "concurrency/wait_any.hpp"
@@ -15,9 +18,12 @@ class extproc_worker_t;
 
 class extproc_job_t : public home_thread_mixin_t {
 public:
+    // If a free worker has run a job with the same `affinity_key` recently, the job
+    //  goes to it (see `extproc_worker_t::has_affinity`)
     extproc_job_t(extproc_pool_t *_pool,
                   bool (*worker_fn) (read_stream_t *, write_stream_t *),
-                  signal_t *_user_interruptor);
+                  signal_t *_user_interruptor,
+                  const boost::optional<uint64_t> &affinity_key = boost::none);
     ~extproc_job_t();
 
     // All data written and read by the user must be accounted for, or the worker will
@@ -1,11 +1,28 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "extproc/extproc_pool.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
 #include "extproc/extproc_spawner.hpp"
 
+static size_t extproc_warm_workers = 0;
+
+void set_extproc_warm_workers(size_t count) {
+    extproc_warm_workers = count;
+}
+
 extproc_pool_t::extproc_pool_t(size_t worker_count) :
     ct_interruptors(&interruptor),
     worker_semaphore(worker_count,
-                     extproc_spawner_t::get_instance()) { }
+                     extproc_spawner_t::get_instance()) {
+    const size_t warm_count = std::min(extproc_warm_workers, worker_count);
+    if (warm_count > 0) {
+        coro_t::spawn_sometime(std::bind(&extproc_pool_t::warm_up_workers,
+                                         this, warm_count, drainer.lock()));
+    }
+}
 
 extproc_pool_t::~extproc_pool_t() {
     // Can only be destructed on the same thread we were created on
@@ -19,6 +36,23 @@ cross_thread_semaphore_t<extproc_worker_t> *extproc_pool_t::get_worker_semaphore
     return &worker_semaphore;
 }
 
+void extproc_pool_t::warm_up_workers(size_t count, auto_drainer_t::lock_t keepalive) {
+    typedef cross_thread_semaphore_t<extproc_worker_t>::lock_t worker_lock_t;
+    try {
+        // We lock them all before starting any, so that we get different workers
+        std::vector<scoped_ptr_t<worker_lock_t> > locks;
+        for (size_t i = 0; i < count; ++i) {
+            locks.push_back(make_scoped<worker_lock_t>(&worker_semaphore,
+                                                       keepalive.get_drain_signal()));
+        }
+        for (auto it = locks.begin(); it != locks.end(); ++it) {
+            (*it)->get_value()->keep_warm();
+        }
+    } catch (const interrupted_exc_t &) {
+        // We're shutting down
+    }
+}
+
 signal_t *extproc_pool_t::get_shutdown_signal() {
     return ct_interruptors.get();
 }
@@ -4,11 +4,17 @@
 
 #include "utils.hpp"
 #include "containers/scoped.hpp"
+#include "concurrency/auto_drainer.hpp"
 #include "concurrency/cond_var.hpp"
 #include "concurrency/cross_thread_signal.hpp"
 #include "concurrency/cross_thread_semaphore.hpp"
 #include "extproc/extproc_worker.hpp"
 
+// How many of its workers an extproc pool starts right away and keeps running, so
+//  that queries don't wait for them to be spawned.  None by default; call it before
+//  creating the pool.
+void set_extproc_warm_workers(size_t count);
+
 // Extproc pool is used to acquire and release workers from any thread,
 //  must be created from within the thread pool
 class extproc_pool_t : public home_thread_mixin_t {
@@ -24,6 +30,8 @@ public:
     cross_thread_semaphore_t<extproc_worker_t> *get_worker_semaphore();
 
 private:
+    void warm_up_workers(size_t count, auto_drainer_t::lock_t keepalive);
+
     // The interruptor to be pulsed when shutting down
     cond_t interruptor;
 
@@ -39,6 +47,8 @@ private:
 
     // Cross-threaded semaphore allowing workers to be acquired from any thread
     cross_thread_semaphore_t<extproc_worker_t> worker_semaphore;
+
+    auto_drainer_t drainer;
 };
 
 #endif /* EXTPROC_EXTPROC_POOL_HPP_ */
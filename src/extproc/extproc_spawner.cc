@@ -9,14 +9,23 @@
 #include "extproc/extproc_spawner.hpp"
 #include "extproc/extproc_worker.hpp"
 #include "arch/fd_send_recv.hpp"
+#include "arch/runtime/numa.hpp"
+#include "containers/archive/shm_stream.hpp"
+#include "containers/archive/socket_stream.hpp"
 
 extproc_spawner_t *extproc_spawner_t::instance = NULL;
 
+// The fds the spawner passes to a worker: its socket, then the `shm_channel_t`'s
+static const size_t worker_num_fds = 1 + shm_channel_t::num_fds;
+
 // This is the class that runs in the external process, doing all the work
 class worker_run_t {
 public:
-    worker_run_t(fd_t _socket, pid_t _spawner_pid) :
-        socket(_socket), socket_stream(socket.get(), &blocking_watcher) {
+    worker_run_t(const fd_t fds[worker_num_fds], pid_t _spawner_pid) :
+        socket(fds[0]),
+        socket_stream(socket.get(), &blocking_watcher),
+        channel(fds + 1),
+        shm_stream(&channel, shm_stream_t::CHILD_SIDE, socket.get()) {
         guarantee(spawner_pid == -1);
         spawner_pid = _spawner_pid;
 
@@ -35,7 +44,9 @@ public:
         guarantee(old_timerval.it_value.tv_sec == 0 && old_timerval.it_value.tv_usec == 0,
                   "worker: setitimer saw that we already had an itimer!");
 
-        // Send our pid over to the main process (because it didn't fork us directly)
+        // Send our pid over to the main process (because it didn't fork us directly).
+        // This is the only thing we ever write to the socket, everything else goes
+        // through the shared memory.
         write_message_t msg;
         msg << getpid();
         int res = send_write_message(&socket_stream, &msg);
@@ -53,19 +64,19 @@ public:
         bool (*fn) (read_stream_t *, write_stream_t *);
         while (true) {
             int64_t read_size = sizeof(fn);
-            const int64_t read_res = force_read(&socket_stream, &fn, read_size);
+            const int64_t read_res = force_read(&shm_stream, &fn, read_size);
             if (read_res != read_size) {
                 break;
             }
 
-            if (!fn(&socket_stream, &socket_stream)) {
+            if (!fn(&shm_stream, &shm_stream)) {
                 break;
             }
 
             // Trade magic numbers with the parent
             uint64_t magic_from_parent;
             {
-                archive_result_t res = deserialize(&socket_stream, &magic_from_parent);
+                archive_result_t res = deserialize(&shm_stream, &magic_from_parent);
                 if (res != archive_result_t::SUCCESS ||
                     magic_from_parent != extproc_worker_t::parent_to_worker_magic) {
                     break;
@@ -74,7 +85,7 @@ public:
 
             write_message_t msg;
             msg << extproc_worker_t::worker_to_parent_magic;
-            int res = send_write_message(&socket_stream, &msg);
+            int res = send_write_message(&shm_stream, &msg);
             if (res != 0) {
                 break;
             }
@@ -94,6 +105,8 @@ private:
     scoped_fd_t socket;
     blocking_fd_watcher_t blocking_watcher;
     socket_stream_t socket_stream;
+    shm_channel_t channel;
+    shm_stream_t shm_stream;
 };
 
 pid_t worker_run_t::spawner_pid = -1;
@@ -126,8 +139,9 @@ public:
         pid_t spawner_pid = getpid();
 
         while(true) {
-            fd_t worker_socket;
-            fd_recv_result_t recv_res = recv_fds(socket.get(), 1, &worker_socket);
+            fd_t worker_fds[worker_num_fds];
+            fd_recv_result_t recv_res = recv_fds(socket.get(), worker_num_fds,
+                                                 worker_fds);
             if (recv_res != FD_RECV_OK) {
                 break;
             }
@@ -136,13 +150,15 @@ public:
             if (res == 0) {
                 // Worker process here
                 socket.reset(); // Don't need the spawner's pipe
-                worker_run_t worker_runner(worker_socket, spawner_pid);
+                worker_run_t worker_runner(worker_fds, spawner_pid);
                 worker_runner.main_loop();
                 ::_exit(EXIT_FAILURE);
             }
 
             guarantee_err(res != -1, "could not fork worker process");
-            scoped_fd_t closer(worker_socket);
+            for (size_t i = 0; i < worker_num_fds; ++i) {
+                scoped_fd_t closer(worker_fds[i]);
+            }
         }
     }
 
@@ -192,6 +208,9 @@ void extproc_spawner_t::fork_spawner() {
             res = ::close(fds[0]);
         } while (res == 0 && get_errno() == EINTR);
 
+        // The workers inherit this, so they stay off the event loop CPUs.
+        apply_blocker_cpu_affinity();
+
         spawner_run_t spawner(fds[1]);
         spawner.main_loop();
         ::_exit(EXIT_SUCCESS);
@@ -205,23 +224,27 @@ void extproc_spawner_t::fork_spawner() {
 }
 
 // Spawns a new worker process and returns the fd of the socket used to communicate with it
-fd_t extproc_spawner_t::spawn(object_buffer_t<socket_stream_t> *stream_out, pid_t *pid_out) {
+fd_t extproc_spawner_t::spawn(shm_channel_t *channel, pid_t *pid_out) {
     guarantee(spawner_socket.get() != INVALID_FD);
 
     fd_t fds[2];
     int res = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
     guarantee_err(res == 0, "could not create socket pair for worker process");
 
-    res = send_fds(spawner_socket.get(), 1, &fds[1]);
-    guarantee_err(res == 0, "could not send socket file descriptor to worker process");
-
-    stream_out->create(fds[0], reinterpret_cast<fd_watcher_t*>(NULL));
+    fd_t worker_fds[worker_num_fds];
+    worker_fds[0] = fds[1];
+    channel->get_fds(worker_fds + 1);
+    res = send_fds(spawner_socket.get(), worker_num_fds, worker_fds);
+    guarantee_err(res == 0, "could not send file descriptors to worker process");
 
     // Get the pid of the new worker process
-    archive_result_t archive_res;
-    archive_res = deserialize(stream_out->get(), pid_out);
-    guarantee_deserialization(archive_res, "pid_out");
-    guarantee(*pid_out != -1);
+    {
+        socket_stream_t stream(fds[0], reinterpret_cast<fd_watcher_t*>(NULL));
+        archive_result_t archive_res;
+        archive_res = deserialize(&stream, pid_out);
+        guarantee_deserialization(archive_res, "pid_out");
+        guarantee(*pid_out != -1);
+    }
 
     scoped_fd_t closer(fds[1]);
     return fds[0];
@@ -5,8 +5,8 @@
 #include <sys/types.h>
 #include "arch/io/io_utils.hpp"
 #include "arch/types.hpp"
-#include "containers/archive/socket_stream.hpp"
-#include "containers/object_buffer.hpp"
+
+class shm_channel_t;
 
 // The extproc_spawner_t controls an external process which launches workers
 // This is necessary to avoid some forking problems with tcmalloc, and
@@ -20,9 +20,9 @@ public:
     extproc_spawner_t();
     ~extproc_spawner_t();
 
-    // Spawns a new worker, and returns the socket file descriptor for communication
-    //  with the worker process
-    fd_t spawn(object_buffer_t<socket_stream_t> *stream_out, pid_t *pid_out);
+    // Spawns a new worker that talks to us through `channel`, and returns the socket
+    //  file descriptor that tells each of us when the other dies
+    fd_t spawn(shm_channel_t *channel, pid_t *pid_out);
 
     static extproc_spawner_t *get_instance();
 
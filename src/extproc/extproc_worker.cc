@@ -1,13 +1,15 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include <unistd.h>
 
+#include <algorithm>
+
 #include "logger.hpp"
 
 #include "extproc/extproc_worker.hpp"
 #include "extproc/extproc_spawner.hpp"
 #include "arch/timing.hpp"
 #include "arch/runtime/runtime.hpp"
-#include "containers/archive/socket_stream.hpp"
+#include "config/args.hpp"
 
 // Guaranteed to be random, chosen by fair dice roll
 const uint64_t extproc_worker_t::parent_to_worker_magic = 0x700168fe5380e17bLL;
@@ -23,11 +25,12 @@ NORETURN bool worker_exit_fn(read_stream_t *stream_in, write_stream_t *) {
 extproc_worker_t::extproc_worker_t(extproc_spawner_t *_spawner) :
     spawner(_spawner),
     worker_pid(-1),
-    interruptor(NULL) { }
+    interruptor(NULL),
+    warm(false) { }
 
 extproc_worker_t::~extproc_worker_t() {
     if (worker_pid != -1) {
-        socket_stream.create(socket.get(), reinterpret_cast<fd_watcher_t*>(NULL));
+        stream.create(channel.get(), shm_stream_t::PARENT_SIDE, socket.get());
 
         // TODO: check that worker is extant and/or catch exceptions
         run_job(&worker_exit_fn);
@@ -37,7 +40,7 @@ extproc_worker_t::~extproc_worker_t() {
         msg << exit_code;
         int res = send_write_message(get_write_stream(), &msg);
 
-        socket_stream.reset();
+        stream.reset();
 
         if (res != 0) {
             logERR("Could not shut down worker orderly, killing it...");
@@ -54,16 +57,15 @@ void extproc_worker_t::acquired(signal_t *_interruptor) {
 
     // We create the streams here, since they are thread-dependant
     if (worker_pid == -1) {
-        socket.reset(spawner->spawn(&socket_stream, &worker_pid));
-    } else {
-        socket_stream.create(socket.get(), reinterpret_cast<fd_watcher_t*>(NULL));
+        spawn();
     }
+    stream.create(channel.get(), shm_stream_t::PARENT_SIDE, socket.get());
 
     // Apply the user interruptor to our stream along with the extproc pool's interruptor
     guarantee(interruptor == NULL);
     interruptor = _interruptor;
     guarantee(interruptor != NULL);
-    socket_stream.get()->set_interruptor(interruptor);
+    stream.get()->set_interruptor(interruptor);
 }
 
 void extproc_worker_t::released(bool user_error, signal_t *user_interruptor) {
@@ -77,7 +79,7 @@ void extproc_worker_t::released(bool user_error, signal_t *user_interruptor) {
         // Set up a timeout interruptor for the final write/read
         signal_timer_t timeout;
         wait_any_t final_interruptor(&timeout, interruptor);
-        socket_stream->set_interruptor(&final_interruptor);
+        stream->set_interruptor(&final_interruptor);
         timeout.start(100); // Allow 100ms for the child to respond
 
         // Trade magic numbers with worker process to see if it is still coherent
@@ -85,7 +87,7 @@ void extproc_worker_t::released(bool user_error, signal_t *user_interruptor) {
             write_message_t msg;
             msg << parent_to_worker_magic;
             {
-                int res = send_write_message(socket_stream.get(), &msg);
+                int res = send_write_message(stream.get(), &msg);
                 if (res != 0) {
                     throw std::runtime_error("failed to send magic number");
                 }
@@ -93,7 +95,7 @@ void extproc_worker_t::released(bool user_error, signal_t *user_interruptor) {
 
 
             uint64_t magic_from_child;
-            archive_result_t res = deserialize(socket_stream.get(), &magic_from_child);
+            archive_result_t res = deserialize(stream.get(), &magic_from_child);
             if (bad(res) || magic_from_child != worker_to_parent_magic) {
                 throw std::runtime_error("did not receive magic number");
             }
@@ -106,23 +108,59 @@ void extproc_worker_t::released(bool user_error, signal_t *user_interruptor) {
         }
     }
 
-    socket_stream.reset();
+    stream.reset();
     interruptor = NULL;
 
     // If anything went wrong, we just kill the worker and recreate it later
     if (errored) {
         kill_process();
+        if (warm) {
+            spawn();
+        }
+    }
+}
+
+void extproc_worker_t::keep_warm() {
+    warm = true;
+    if (worker_pid == -1) {
+        spawn();
     }
 }
 
+bool extproc_worker_t::has_affinity(uint64_t key) const {
+    return std::find(affinity_keys.begin(), affinity_keys.end(), key)
+        != affinity_keys.end();
+}
+
+void extproc_worker_t::add_affinity(uint64_t key) {
+    auto it = std::find(affinity_keys.begin(), affinity_keys.end(), key);
+    if (it != affinity_keys.end()) {
+        affinity_keys.erase(it);
+    }
+    affinity_keys.push_front(key);
+    if (affinity_keys.size() > EXTPROC_WORKER_AFFINITY_KEYS) {
+        affinity_keys.pop_back();
+    }
+}
+
+void extproc_worker_t::spawn() {
+    guarantee(worker_pid == -1);
+    channel.init(new shm_channel_t(EXTPROC_SHM_RING_SIZE));
+    socket.reset(spawner->spawn(channel.get(), &worker_pid));
+}
+
 void extproc_worker_t::kill_process() {
     guarantee(worker_pid != -1);
 
     ::kill(worker_pid, SIGKILL);
     worker_pid = -1;
 
-    // Clean up our socket fd
+    // Clean up our socket fd and the shared memory
     socket.reset();
+    channel.reset();
+
+    // Whatever earlier jobs left in the process is gone with it
+    affinity_keys.clear();
 }
 
 void extproc_worker_t::run_job(bool (*fn) (read_stream_t *, write_stream_t *)) {
@@ -133,9 +171,9 @@ void extproc_worker_t::run_job(bool (*fn) (read_stream_t *, write_stream_t *)) {
 }
 
 read_stream_t *extproc_worker_t::get_read_stream() {
-    return socket_stream.get();
+    return stream.get();
 }
 
 write_stream_t *extproc_worker_t::get_write_stream() {
-    return socket_stream.get();
+    return stream.get();
 }
@@ -3,12 +3,15 @@
 #define EXTPROC_EXTPROC_WORKER_HPP_
 
 #include <sys/types.h>
+
+#include <deque>
+
 #include "arch/io/io_utils.hpp"
 #include "concurrency/wait_any.hpp"
 #include "concurrency/cross_thread_signal.hpp"
 #include "containers/object_buffer.hpp"
 #include "containers/scoped.hpp"
-#include "containers/archive/socket_stream.hpp"
+#include "containers/archive/shm_stream.hpp"
 
 class extproc_spawner_t;
 
@@ -28,6 +31,17 @@ public:
     read_stream_t *get_read_stream();
     write_stream_t *get_write_stream();
 
+    // Starts the worker process now, if it isn't running, and again whenever it
+    //  gets killed from now on, so the next job doesn't wait for it
+    void keep_warm();
+
+    // Jobs say what they'll need from the worker process with an affinity key (for
+    //  JavaScript, a hash of the function's source), so that the pool can send jobs
+    //  to a worker that still has what it built for an earlier job with the same key.
+    //  This remembers the most recent keys since the process was started.
+    bool has_affinity(uint64_t key) const;
+    void add_affinity(uint64_t key);
+
     static const uint64_t parent_to_worker_magic;
     static const uint64_t worker_to_parent_magic;
 
@@ -41,11 +55,17 @@ private:
 
     extproc_spawner_t *spawner;
     pid_t worker_pid;
+    // Nothing is sent through the socket once the worker is up, but it tells the
+    //  worker and us when the other one dies
     scoped_fd_t socket;
+    scoped_ptr_t<shm_channel_t> channel;
 
-    object_buffer_t<socket_stream_t> socket_stream;
+    object_buffer_t<shm_stream_t> stream;
 
     signal_t *interruptor;
+
+    bool warm;
+    std::deque<uint64_t> affinity_keys;
 };
 
 #endif /* EXTPROC_EXTPROC_WORKER_HPP_ */
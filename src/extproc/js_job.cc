@@ -14,8 +14,11 @@
 
 #include <cmath>
 #include <limits>
+#include <list>
+#include <utility>
 
 #include "containers/archive/boost_types.hpp"
+#include "config/args.hpp"
 #include "containers/archive/stl_types.hpp"
 #include "extproc/extproc_job.hpp"
 #include "rdb_protocol/rdb_protocol_json.hpp"
@@ -41,6 +44,61 @@ counted_t<const ql::datum_t> js_to_datum(const v8::Handle<v8::Value> &value,
 // Should never error.
 v8::Handle<v8::Value> js_from_datum(const counted_t<const ql::datum_t> &datum);
 
+typedef boost::shared_ptr<v8::Persistent<v8::Value> > persistent_value_t;
+
+static persistent_value_t make_persistent(const v8::Handle<v8::Value> &value) {
+    persistent_value_t persistent_handle(new v8::Persistent<v8::Value>());
+#ifdef V8_PRE_3_19
+    *persistent_handle = v8::Persistent<v8::Value>::New(value);
+#else
+    persistent_handle->Reset(v8::Isolate::GetCurrent(), value);
+#endif
+    return persistent_handle;
+}
+
+static v8::Local<v8::Value> make_local(const persistent_value_t &persistent_handle) {
+#ifdef V8_PRE_3_19
+    return v8::Local<v8::Value>::New(*persistent_handle);
+#else
+    return v8::Local<v8::Value>::New(v8::Isolate::GetCurrent(), *persistent_handle);
+#endif
+}
+
+// The functions that jobs in this worker process have evaluated, most recently used
+// first.  Each job gets a new `js_env_t`, but a job that evaluates the same source as
+// an earlier one gets the function that one compiled.  (So the function also sees
+// whatever the earlier job's calls left in its global variables.)
+class js_function_cache_t {
+public:
+    // Returns an empty pointer if we don't have `source`.
+    persistent_value_t find(const std::string &source) {
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (it->first == source) {
+                entries.splice(entries.begin(), entries, it);
+                return it->second;
+            }
+        }
+        return persistent_value_t();
+    }
+
+    void insert(const std::string &source, const v8::Handle<v8::Function> &func) {
+        entries.push_front(std::make_pair(source, make_persistent(func)));
+        if (entries.size() > JS_WORKER_FUNCTION_CACHE_SIZE) {
+            entries.back().second->Dispose();
+            entries.pop_back();
+        }
+    }
+
+private:
+    std::list<std::pair<std::string, persistent_value_t> > entries;
+};
+
+static js_function_cache_t *get_function_cache() {
+    // The worker process never exits normally, so this is never destroyed.
+    static js_function_cache_t *cache = new js_function_cache_t;
+    return cache;
+}
+
 // Worker-side JS evaluation environment.
 class js_env_t {
 public:
@@ -49,9 +107,16 @@ public:
 
     js_result_t eval(const std::string &source);
     js_result_t call(js_id_t id, const std::vector<counted_t<const ql::datum_t> > &args);
+    std::vector<js_result_t> call_batch(
+        js_id_t id,
+        const std::vector<std::vector<counted_t<const ql::datum_t> > > &arg_tuples);
     void release(js_id_t id);
 
 private:
+    // Like call(), but in the context the caller set up.
+    js_result_t call_in_context(js_id_t id,
+                                const std::vector<counted_t<const ql::datum_t> > &args);
+
     js_id_t remember_value(const v8::Handle<v8::Value> &value);
     const boost::shared_ptr<v8::Persistent<v8::Value> > find_value(js_id_t id);
 
@@ -87,13 +152,14 @@ public:
 enum js_task_t {
     TASK_EVAL,
     TASK_CALL,
+    TASK_CALL_BATCH,
     TASK_RELEASE,
     TASK_EXIT
 };
 
 // The job_t runs in the context of the main rethinkdb process
-js_job_t::js_job_t(extproc_pool_t *pool, signal_t *interruptor) :
-    extproc_job(pool, &worker_fn, interruptor) { }
+js_job_t::js_job_t(extproc_pool_t *pool, uint64_t affinity_key, signal_t *interruptor) :
+    extproc_job(pool, &worker_fn, interruptor, affinity_key) { }
 
 js_result_t js_job_t::eval(const std::string &source) {
     js_task_t task = js_task_t::TASK_EVAL;
@@ -134,6 +200,31 @@ js_result_t js_job_t::call(js_id_t id, const std::vector<counted_t<const ql::dat
     return result;
 }
 
+std::vector<js_result_t> js_job_t::call_batch(
+        js_id_t id,
+        const std::vector<std::vector<counted_t<const ql::datum_t> > > &arg_tuples) {
+    js_task_t task = js_task_t::TASK_CALL_BATCH;
+    write_message_t msg;
+    msg.append(&task, sizeof(task));
+    msg << id;
+    msg << arg_tuples;
+    {
+        int res = send_write_message(extproc_job.write_stream(), &msg);
+        if (res != 0) { throw js_worker_exc_t("failed to send data to the worker"); }
+    }
+
+    std::vector<js_result_t> results;
+    archive_result_t res = deserialize(extproc_job.read_stream(), &results);
+    if (bad(res)) {
+        throw js_worker_exc_t(strprintf("failed to deserialize result from worker (%s)",
+                                        archive_result_as_str(res)));
+    }
+    if (results.size() != arg_tuples.size()) {
+        throw js_worker_exc_t("worker returned the wrong number of results");
+    }
+    return results;
+}
+
 void js_job_t::release(js_id_t id) {
     js_task_t task = js_task_t::TASK_RELEASE;
     write_message_t msg;
@@ -201,6 +292,24 @@ bool js_job_t::worker_fn(read_stream_t *stream_in, write_stream_t *stream_out) {
                 if (res != 0) { return false; }
             }
             break;
+        case TASK_CALL_BATCH:
+            {
+                js_id_t id;
+                std::vector<std::vector<counted_t<const ql::datum_t> > > arg_tuples;
+                {
+                    archive_result_t res = deserialize(stream_in, &id);
+                    if (bad(res)) { return false; }
+                    res = deserialize(stream_in, &arg_tuples);
+                    if (bad(res)) { return false; }
+                }
+
+                std::vector<js_result_t> js_results = js_env.call_batch(id, arg_tuples);
+                write_message_t msg;
+                msg << js_results;
+                int res = send_write_message(stream_out, &msg);
+                if (res != 0) { return false; }
+            }
+            break;
         case TASK_RELEASE:
             {
                 js_id_t id;
@@ -240,6 +349,12 @@ js_env_t::~js_env_t() {
 }
 
 js_result_t js_env_t::eval(const std::string &source) {
+    persistent_value_t cached = get_function_cache()->find(source);
+    if (cached) {
+        DECLARE_HANDLE_SCOPE(handle_scope);
+        return js_result_t(remember_value(make_local(cached)));
+    }
+
     js_context_t clean_context;
     js_result_t result("");
     std::string *errmsg = boost::get<std::string>(&result);
@@ -272,6 +387,7 @@ js_result_t js_env_t::eval(const std::string &source) {
                 v8::Handle<v8::Function> func
                     = v8::Handle<v8::Function>::Cast(result_val);
                 result = remember_value(func);
+                get_function_cache()->insert(source, func);
             } else {
                 guarantee(!result_val.IsEmpty());
 
@@ -293,15 +409,7 @@ js_id_t js_env_t::remember_value(const v8::Handle<v8::Value> &value) {
 
     // Save this value in a persistent handle so it isn't deallocated when
     // its scope is destructed.
-
-    boost::shared_ptr<v8::Persistent<v8::Value> > persistent_handle(new v8::Persistent<v8::Value>());
-#ifdef V8_PRE_3_19
-    *persistent_handle = v8::Persistent<v8::Value>::New(value);
-#else
-    persistent_handle->Reset(v8::Isolate::GetCurrent(), value);
-#endif
-
-    values.insert(std::make_pair(id, persistent_handle));
+    values.insert(std::make_pair(id, make_persistent(value)));
     return id;
 }
 
@@ -339,6 +447,24 @@ v8::Handle<v8::Value> run_js_func(v8::Handle<v8::Function> fn,
 js_result_t js_env_t::call(js_id_t id,
                            const std::vector<counted_t<const ql::datum_t> > &args) {
     js_context_t clean_context;
+    return call_in_context(id, args);
+}
+
+std::vector<js_result_t> js_env_t::call_batch(
+        js_id_t id,
+        const std::vector<std::vector<counted_t<const ql::datum_t> > > &arg_tuples) {
+    // All the calls share one context, which is most of the cost of a small call.
+    js_context_t clean_context;
+    std::vector<js_result_t> results;
+    results.reserve(arg_tuples.size());
+    for (auto it = arg_tuples.begin(); it != arg_tuples.end(); ++it) {
+        results.push_back(call_in_context(id, *it));
+    }
+    return results;
+}
+
+js_result_t js_env_t::call_in_context(
+        js_id_t id, const std::vector<counted_t<const ql::datum_t> > &args) {
     js_result_t result("");
     std::string *errmsg = boost::get<std::string>(&result);
 
@@ -348,13 +474,7 @@ js_result_t js_env_t::call(js_id_t id,
     DECLARE_HANDLE_SCOPE(handle_scope);
 
     // Construct local handle from persistent handle
-
-
-#ifdef V8_PRE_3_19
-    v8::Local<v8::Value> local_handle = v8::Local<v8::Value>::New(*found_value);
-#else
-    v8::Local<v8::Value> local_handle = v8::Local<v8::Value>::New(v8::Isolate::GetCurrent(), *found_value);
-#endif
+    v8::Local<v8::Value> local_handle = make_local(found_value);
     v8::Local<v8::Function> fn = v8::Local<v8::Function>::Cast(local_handle);
     v8::Handle<v8::Value> value = run_js_func(fn, args, errmsg);
 
@@ -537,7 +657,7 @@ v8::Handle<v8::Value> js_from_datum(const counted_t<const ql::datum_t> &datum) {
             return date;
         } else {
             v8::Handle<v8::Object> obj = v8::Object::New();
-            const std::map<std::string, counted_t<const ql::datum_t> > &source_map = datum->as_object();
+            const ql::datum_object_t &source_map = datum->as_object();
 
             for (auto it = source_map.begin(); it != source_map.end(); ++it) {
                 DECLARE_HANDLE_SCOPE(scope);
@@ -19,10 +19,14 @@
 
 class js_job_t {
 public:
-    js_job_t(extproc_pool_t *pool, signal_t *interruptor);
+    // `affinity_key` is a hash of the first source the job will evaluate.
+    js_job_t(extproc_pool_t *pool, uint64_t affinity_key, signal_t *interruptor);
 
     js_result_t eval(const std::string &source);
     js_result_t call(js_id_t id, const std::vector<counted_t<const ql::datum_t> > &args);
+    std::vector<js_result_t> call_batch(
+        js_id_t id,
+        const std::vector<std::vector<counted_t<const ql::datum_t> > > &arg_tuples);
     void release(js_id_t id);
     void exit();
 
@@ -1,6 +1,7 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "extproc/js_runner.hpp"
 
+#include <functional>
 #include <map>
 
 #include "extproc/js_job.hpp"
@@ -43,12 +44,12 @@ private:
 //  easily clear it all and replace it
 class js_runner_t::job_data_t {
 public:
-    job_data_t(extproc_pool_t *pool, signal_t *interruptor) :
+    job_data_t(extproc_pool_t *pool, uint64_t affinity_key, signal_t *interruptor) :
         combined_interruptor(interruptor, js_timeout.get_signal()),
-        js_job(pool, &combined_interruptor) { }
+        js_job(pool, affinity_key, &combined_interruptor) { }
 
-    explicit job_data_t(extproc_pool_t *pool) :
-        js_job(pool, js_timeout.get_signal()) { }
+    job_data_t(extproc_pool_t *pool, uint64_t affinity_key) :
+        js_job(pool, affinity_key, js_timeout.get_signal()) { }
 
     struct func_info_t {
         explicit func_info_t(js_id_t _id) :
@@ -64,7 +65,7 @@ public:
     js_job_t js_job;
 };
 
-js_runner_t::js_runner_t() { }
+js_runner_t::js_runner_t() : pool(NULL), interruptor(NULL) { }
 
 js_runner_t::~js_runner_t() {
     assert_thread();
@@ -85,23 +86,41 @@ js_runner_t::~js_runner_t() {
 
 bool js_runner_t::connected() const {
     assert_thread();
-    return job_data.has();
+    return pool != NULL;
 }
 
-// Starts the javascript function in the worker process
-void js_runner_t::begin(extproc_pool_t *pool, signal_t *interruptor) {
+void js_runner_t::begin(extproc_pool_t *_pool, signal_t *_interruptor) {
     assert_thread();
+    guarantee(!connected());
+    pool = _pool;
+    interruptor = _interruptor;
+}
+
+// Starts the javascript function in the worker process
+void js_runner_t::start_job(const std::string &first_source) {
+    guarantee(connected() && !job_data.has());
+    const uint64_t affinity_key = std::hash<std::string>()(first_source);
     if (interruptor == NULL) {
-        job_data.init(new job_data_t(pool));
+        job_data.init(new job_data_t(pool, affinity_key));
     } else {
-        job_data.init(new job_data_t(pool, interruptor));
+        job_data.init(new job_data_t(pool, affinity_key, interruptor));
     }
 }
 
+void js_runner_t::disconnect() {
+    job_data.reset();
+    pool = NULL;
+    interruptor = NULL;
+}
+
 js_result_t js_runner_t::eval(const std::string &source,
                               const req_config_t &config) {
     assert_thread();
-    guarantee(job_data.has());
+    guarantee(connected());
+
+    if (!job_data.has()) {
+        start_job(source);
+    }
 
     js_result_t result;
 
@@ -123,7 +142,7 @@ js_result_t js_runner_t::eval(const std::string &source,
         // This will mark the worker as errored so we don't try to re-sync with it
         //  on the next line (since we're in a catch statement, we aren't allowed)
         job_data->js_job.worker_error();
-        job_data.reset();
+        disconnect();
         throw;
     }
 
@@ -140,7 +159,7 @@ js_result_t js_runner_t::call(const std::string &source,
                               const std::vector<counted_t<const ql::datum_t> > &args,
                               const req_config_t &config) {
     assert_thread();
-    guarantee(job_data.has());
+    guarantee(connected());
 
     // This will retrieve the function from the cache if it's there, or re-eval it
     js_result_t result = eval(source, config);
@@ -158,7 +177,7 @@ js_result_t js_runner_t::call(const std::string &source,
         // This will mark the worker as errored so we don't try to re-sync with it
         //  on the next line (since we're in a catch statement, we aren't allowed)
         job_data->js_job.worker_error();
-        job_data.reset();
+        disconnect();
         throw;
     }
 
@@ -171,6 +190,43 @@ js_result_t js_runner_t::call(const std::string &source,
     return result;
 }
 
+std::vector<js_result_t> js_runner_t::call_batch(
+        const std::string &source,
+        const std::vector<std::vector<counted_t<const ql::datum_t> > > &arg_tuples,
+        const req_config_t &config) {
+    assert_thread();
+    guarantee(connected());
+
+    // This will retrieve the function from the cache if it's there, or re-eval it
+    js_result_t fn = eval(source, config);
+    js_id_t *fn_id = boost::get<js_id_t>(&fn);
+    guarantee(fn_id != NULL);
+
+    object_buffer_t<js_timeout_t::sentry_t> sentry;
+    sentry.create(&job_data->js_timeout, config.timeout_ms);
+
+    std::vector<js_result_t> results;
+    try {
+        results = job_data->js_job.call_batch(*fn_id, arg_tuples);
+        for (auto it = results.begin(); it != results.end(); ++it) {
+            js_id_t *any_id = boost::get<js_id_t>(&*it);
+            if (any_id != NULL) {
+                release_id(*any_id);
+            }
+        }
+    } catch (...) {
+        // Sentry must be destroyed before the js_timeout
+        sentry.reset();
+        // This will mark the worker as errored so we don't try to re-sync with it
+        //  on the next line (since we're in a catch statement, we aren't allowed)
+        job_data->js_job.worker_error();
+        disconnect();
+        throw;
+    }
+
+    return results;
+}
+
 void js_runner_t::cache_id(js_id_t id, const std::string &source) {
     guarantee(job_data.has());
     guarantee(id != INVALID_ID);
@@ -208,7 +264,7 @@ void js_runner_t::trim_cache() {
         // This will mark the worker as errored so we don't try to re-sync with it
         //  on the next line (since we're in a catch statement, we aren't allowed)
         job_data->js_job.worker_error();
-        job_data.reset();
+        disconnect();
         throw;
     }
 }
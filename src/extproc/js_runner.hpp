@@ -52,6 +52,8 @@ public:
         uint64_t timeout_ms;
     };
 
+    // Doesn't take a worker yet: the first eval or call does, preferring one that
+    // has compiled its source before.
     void begin(extproc_pool_t *pool,
                signal_t *interruptor);
 
@@ -64,9 +66,21 @@ public:
                      const std::vector<counted_t<const ql::datum_t> > &args,
                      const req_config_t &config);
 
+    // Calls a previously compiled function once for each of `arg_tuples`, all in
+    // one round trip to the worker.  `config.timeout_ms` is for the whole batch.
+    // Functions returned by the calls aren't kept, so their ids can't be used.
+    std::vector<js_result_t> call_batch(
+        const std::string &source,
+        const std::vector<std::vector<counted_t<const ql::datum_t> > > &arg_tuples,
+        const req_config_t &config);
+
 private:
     static const size_t CACHE_SIZE;
 
+    void start_job(const std::string &first_source);
+    // Drops the worker after an error; we have to `begin` again.
+    void disconnect();
+
     void cache_id(js_id_t id, const std::string &source);
     void trim_cache();
 
@@ -75,6 +89,10 @@ private:
     void release_id(js_id_t id);
 
 
+    // Set by `begin`.
+    extproc_pool_t *pool;
+    signal_t *interruptor;
+
     class job_data_t;
     scoped_ptr_t<job_data_t> job_data;
 
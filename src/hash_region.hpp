@@ -5,6 +5,7 @@
 #include <inttypes.h>
 
 #include <algorithm>
+#include <iterator>
 #include <vector>
 
 #include "containers/archive/archive.hpp"
@@ -232,6 +233,40 @@ bool operator<(const hash_region_t<inner_region_t> &r1, const hash_region_t<inne
 }
 
 
+// Sorted hash regions come in runs with the same hash range, and within each run
+// the inner regions are disjoint and in order, so only each run's start and the
+// first of its pairs that intersect `region` have to be searched for.
+template <class inner_region_t, class iterator_t, class callable_t>
+void region_map_visit_sorted(iterator_t begin, iterator_t end,
+                             const hash_region_t<inner_region_t> &region,
+                             const callable_t &cb) {
+    typedef hash_region_t<inner_region_t> region_t;
+    iterator_t run = begin;
+    while (run != end) {
+        const uint64_t run_beg = run->first.beg, run_end = run->first.end;
+        const iterator_t next_run = std::partition_point(run, end,
+            [&](const typename std::iterator_traits<iterator_t>::value_type &pair) {
+                return pair.first.beg == run_beg && pair.first.end == run_end;
+            });
+        if (run_beg < region.end && region.beg < run_end) {
+            iterator_t it = std::partition_point(run, next_run,
+                [&](const typename std::iterator_traits<iterator_t>::value_type &pair) {
+                    return pair.first.inner < region.inner
+                        && region_is_empty(region_intersection(pair.first.inner,
+                                                               region.inner));
+                });
+            for (; it != next_run; ++it) {
+                region_t ixn = region_intersection(it->first, region);
+                if (region_is_empty(ixn)) {
+                    break;
+                }
+                cb(*it, ixn);
+            }
+        }
+        run = next_run;
+    }
+}
+
 template <class inner_region_t>
 void debug_print(printf_buffer_t *buf, const hash_region_t<inner_region_t> &r) {
     buf->appendf("hash_region_t{beg: 0x%" PRIx64 ", end: 0x%" PRIx64 ", inner: ", r.beg, r.end);
@@ -12,7 +12,10 @@
 #include <boost/bind.hpp>
 #include <boost/algorithm/string.hpp>
 
+#include "arch/crc32c.hpp"
 #include "arch/io/network.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/wait_any.hpp"
 #include "logger.hpp"
 #include "utils.hpp"
 
@@ -167,6 +170,19 @@ void http_res_t::add_header_line(const std::string& key, const std::string& val)
     header_lines.push_back(hdr_ln);
 }
 
+void http_res_t::set_body_generator(const std::string &content_type,
+                                    const boost::shared_ptr<http_body_generator_t> &generator) {
+    for (std::vector<header_line_t>::iterator it = header_lines.begin(); it != header_lines.end(); ++it) {
+        guarantee(it->key != "Content-Type");
+        guarantee(it->key != "Content-Length");
+    }
+    guarantee(body.size() == 0);
+
+    add_header_line("Content-Type", content_type);
+
+    body_generator = generator;
+}
+
 void http_res_t::set_body(const std::string& content_type, const std::string& content) {
     for (std::vector<header_line_t>::iterator it = header_lines.begin(); it != header_lines.end(); ++it) {
         guarantee(it->key != "Content-Type");
@@ -181,13 +197,8 @@ void http_res_t::set_body(const std::string& content_type, const std::string& co
     body = content;
 }
 
-bool maybe_gzip_response(const http_req_t &req, http_res_t *res) {
-    // Don't bother zipping anything less than 0.5k
-    size_t body_size = res->body.size();
-    if (body_size < 512) {
-        return false;
-    }
-
+// Whether the client's Accept-Encoding lets us (and prefers that we) send gzip.
+static bool client_accepts_gzip(const http_req_t &req) {
     // See the specification for the "Accept-Encoding" header line here:
     // http://www.w3.org/Protocols/rfc2616/rfc2616-sec14.html#sec14.3
     // We do not implement the entire standard, that is, we will always fallback to
@@ -275,6 +286,20 @@ bool maybe_gzip_response(const http_req_t &req, http_res_t *res) {
         return false;
     }
 
+    return true;
+}
+
+bool maybe_gzip_response(const http_req_t &req, http_res_t *res) {
+    // Don't bother zipping anything less than 0.5k
+    size_t body_size = res->body.size();
+    if (body_size < 512) {
+        return false;
+    }
+
+    if (!client_accepts_gzip(req)) {
+        return false;
+    }
+
     // Gzip is supported and preferred, gzip the body of the result
     scoped_array_t<char> out_buffer(body_size);
 
@@ -327,6 +352,136 @@ bool maybe_gzip_response(const http_req_t &req, http_res_t *res) {
     return true;
 }
 
+/* Compresses a body that's already in memory a chunk at a time, so that the
+compressed copy never has to be held whole and the first chunk can go out before the
+rest is compressed. */
+class gzip_body_generator_t : public http_body_generator_t {
+public:
+    gzip_body_generator_t() : initialized(false), finished(false) { }
+    ~gzip_body_generator_t() {
+        if (initialized) {
+            deflateEnd(&zstream);
+        }
+    }
+
+    // Takes the contents of `*_body`.  Returns false if zlib couldn't be set up.
+    bool init(std::string *_body) {
+        body.swap(*_body);
+        zstream.zalloc = Z_NULL;
+        zstream.zfree = Z_NULL;
+        zstream.opaque = Z_NULL;
+        zstream.avail_in = body.size();
+        zstream.next_in = reinterpret_cast<unsigned char*>(const_cast<char *>(body.data()));
+        zstream.total_in = 0;
+        zstream.total_out = 0;
+        zstream.data_type = Z_ASCII;
+        // Same parameters as in `maybe_gzip_response()`
+        initialized = deflateInit2(&zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                                   31, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+        if (!initialized) {
+            body.swap(*_body);
+        }
+        return initialized;
+    }
+
+    bool next_chunk(std::string *chunk_out) {
+        if (finished) {
+            return false;
+        }
+        chunk_out->resize(HTTP_STREAM_CHUNK_SIZE);
+        zstream.next_out = reinterpret_cast<unsigned char*>(&(*chunk_out)[0]);
+        zstream.avail_out = HTTP_STREAM_CHUNK_SIZE;
+        int zres = deflate(&zstream, Z_FINISH);
+        guarantee(zres == Z_OK || zres == Z_STREAM_END, "deflate failed: %d", zres);
+        finished = (zres == Z_STREAM_END);
+        chunk_out->resize(HTTP_STREAM_CHUNK_SIZE - zstream.avail_out);
+        return true;
+    }
+
+private:
+    std::string body;
+    z_stream zstream;
+    bool initialized;
+    bool finished;
+};
+
+bool maybe_stream_gzip_response(const http_req_t &req, http_res_t *res) {
+    if (res->body_generator || res->body.size() < HTTP_STREAM_GZIP_MIN_SIZE) {
+        return false;
+    }
+
+    if (!client_accepts_gzip(req)) {
+        return false;
+    }
+
+    boost::shared_ptr<gzip_body_generator_t> generator(new gzip_body_generator_t);
+    if (!generator->init(&res->body)) {
+        return false;
+    }
+    res->body_generator = generator;
+
+    // The length isn't known until the body has been compressed
+    for (auto it = res->header_lines.begin(); it != res->header_lines.end(); ++it) {
+        if (it->key == "Content-Length") {
+            res->header_lines.erase(it);
+            break;
+        }
+    }
+
+    res->add_header_line("Content-Encoding", "gzip");
+    return true;
+}
+
+bool http_keep_alive(const http_req_t &req) {
+    boost::optional<std::string> connection = req.find_header_line("Connection");
+    if (connection) {
+        if (boost::ifind_first(connection.get(), "close")) {
+            return false;
+        }
+        if (boost::ifind_first(connection.get(), "keep-alive")) {
+            return true;
+        }
+    }
+    // Connections are persistent by default since HTTP/1.1
+    return req.version == "1.1";
+}
+
+std::string http_etag(const std::string &body) {
+    // Weak, because gzipping the body doesn't change it.
+    return strprintf("W/\"%08" PRIx32 "-%zx\"", crc32c(body.data(), body.size()), body.size());
+}
+
+static bool if_none_match(const http_req_t &req, const std::string &etag) {
+    boost::optional<std::string> header = req.find_header_line("If-None-Match");
+    if (!header) {
+        return false;
+    }
+    // If-None-Match uses the weak comparison, so the "W/" prefixes don't matter.
+    const std::string opaque_tag = boost::starts_with(etag, "W/") ? etag.substr(2) : etag;
+    std::vector<std::string> tags;
+    boost::split(tags, header.get(), boost::is_any_of(","));
+    for (std::vector<std::string>::iterator it = tags.begin(); it != tags.end(); ++it) {
+        boost::trim(*it);
+        if (boost::starts_with(*it, "W/")) {
+            it->erase(0, 2);
+        }
+        if (*it == "*" || *it == opaque_tag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void http_etag_res(const http_req_t &req, const std::string &content_type,
+                   const std::string &body, const std::string &etag, http_res_t *res) {
+    if (if_none_match(req, etag)) {
+        *res = http_res_t(HTTP_NOT_MODIFIED);
+    } else {
+        *res = http_res_t(HTTP_OK, content_type, body);
+    }
+    res->add_header_line("ETag", etag);
+}
+
 http_res_t http_error_res(const std::string &content, http_status_code_t rescode) {
     return http_res_t(rescode, "application/text", content);
 }
@@ -436,38 +591,92 @@ std::string human_readable_status(int code) {
     }
 }
 
+// Turns a generated body into an ordinary one, for clients that can't take the
+// chunked transfer encoding.
+void collect_generated_body(http_res_t *res) {
+    std::string chunk;
+    while (res->body_generator->next_chunk(&chunk)) {
+        res->body.append(chunk);
+    }
+    res->body_generator.reset();
+    res->add_header_line("Content-Length", strprintf("%zu", res->body.size()));
+}
+
 void write_http_msg(tcp_conn_t *conn, const http_res_t &res, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
     conn->writef(closer, "HTTP/%s %d %s\r\n", res.version.c_str(), res.code, human_readable_status(res.code).c_str());
+    bool has_length = false;
     for (std::vector<header_line_t>::const_iterator it = res.header_lines.begin(); it != res.header_lines.end(); ++it) {
         conn->writef(closer, "%s: %s\r\n", it->key.c_str(), it->val.c_str());
+        has_length = has_length || it->key == "Content-Length";
+    }
+    if (res.body_generator) {
+        conn->writef(closer, "Transfer-Encoding: chunked\r\n\r\n");
+        std::string chunk;
+        while (res.body_generator->next_chunk(&chunk)) {
+            // An empty chunk would mark the end of the body.
+            if (!chunk.empty()) {
+                conn->writef(closer, "%zx\r\n", chunk.size());
+                conn->write(chunk.data(), chunk.size(), closer);
+                conn->writef(closer, "\r\n");
+            }
+        }
+        conn->writef(closer, "0\r\n\r\n");
+    } else {
+        // On a persistent connection, the length is how the client knows where the
+        // body ends.  A 304 has no body, and its length would be the one of the body
+        // the client already has.
+        if (!has_length && res.code != HTTP_NOT_MODIFIED) {
+            conn->writef(closer, "Content-Length: %zu\r\n", res.body.size());
+        }
+        conn->writef(closer, "\r\n");
+        conn->write(res.body.c_str(), res.body.size(), closer);
     }
-    conn->writef(closer, "\r\n");
-    conn->write(res.body.c_str(), res.body.size(), closer);
 }
 
 void http_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn, auto_drainer_t::lock_t keepalive) {
     scoped_ptr_t<tcp_conn_t> conn;
     nconn->make_overcomplicated(&conn);
 
-    http_req_t req;
-    tcp_http_msg_parser_t http_msg_parser;
-
-    // Parse the request
+    // Serve requests until the client asks us to close the connection or stays idle
+    // for HTTP_KEEPALIVE_TIMEOUT_MS.
     try {
-        http_res_t res;
-        if (http_msg_parser.parse(conn.get(), &req, keepalive.get_drain_signal())) {
-            application->handle(req, &res, keepalive.get_drain_signal());
-            res.version = req.version;
-            maybe_gzip_response(req, &res);
-        } else {
-            res = http_res_t(HTTP_BAD_REQUEST);
+        bool keep_alive = true;
+        while (keep_alive) {
+            http_req_t req;
+            tcp_http_msg_parser_t http_msg_parser;
+            http_res_t res;
+
+            // Parse the request
+            signal_timer_t idle_timer;
+            idle_timer.start(HTTP_KEEPALIVE_TIMEOUT_MS);
+            wait_any_t closer(&idle_timer, keepalive.get_drain_signal());
+            if (http_msg_parser.parse(conn.get(), &req, &closer)) {
+                idle_timer.cancel();
+                application->handle(req, &res, keepalive.get_drain_signal());
+                res.version = req.version;
+                // We send HEAD responses a body anyway, so the client could take it
+                // for the start of the next response.
+                keep_alive = req.method != HEAD && http_keep_alive(req);
+                if (req.version != "1.1") {
+                    if (res.body_generator) {
+                        collect_generated_body(&res);
+                    }
+                    maybe_gzip_response(req, &res);
+                } else if (!maybe_stream_gzip_response(req, &res)) {
+                    maybe_gzip_response(req, &res);
+                }
+            } else {
+                res = http_res_t(HTTP_BAD_REQUEST);
+                keep_alive = false;
+            }
+            res.add_header_line("Connection", keep_alive ? "keep-alive" : "close");
+            write_http_msg(conn.get(), res, keepalive.get_drain_signal());
         }
-        write_http_msg(conn.get(), res, keepalive.get_drain_signal());
     } catch (const interrupted_exc_t &) {
         // The query was interrupted, no response since we are shutting down
     } catch (const tcp_conn_read_closed_exc_t &) {
         // Someone disconnected before sending us all the information we
-        // needed... oh well.
+        // needed (or didn't send another request in time)... oh well.
     } catch (const tcp_conn_write_closed_exc_t &) {
         // We were trying to write to someone and they didn't stick around long
         // enough to write it.
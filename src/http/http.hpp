@@ -10,6 +10,7 @@
 #include "errors.hpp"
 #include <boost/tokenizer.hpp>
 #include <boost/shared_array.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/optional.hpp>
 
 #include "arch/types.hpp"
@@ -90,6 +91,7 @@ int content_length(const http_req_t&);
 enum http_status_code_t {
     HTTP_OK = 200,
     HTTP_NO_CONTENT = 204,
+    HTTP_NOT_MODIFIED = 304,
     HTTP_BAD_REQUEST = 400,
     HTTP_FORBIDDEN = 403,
     HTTP_NOT_FOUND = 404,
@@ -99,15 +101,30 @@ enum http_status_code_t {
     HTTP_INTERNAL_SERVER_ERROR = 500
 };
 
+/* A response body that is produced a piece at a time, so that it never has to be in
+memory all at once.  It's sent with the chunked transfer encoding, or collected and
+sent whole to clients older than HTTP/1.1. */
+class http_body_generator_t {
+public:
+    virtual ~http_body_generator_t() { }
+    // Sets `*chunk_out` to the next piece of the body.  Returns false once there is
+    // nothing left.
+    virtual bool next_chunk(std::string *chunk_out) = 0;
+};
+
 class http_res_t {
 public:
     std::string version;
     int code;
     std::vector<header_line_t> header_lines;
     std::string body;
+    // If set, the body comes from here instead of `body`.
+    boost::shared_ptr<http_body_generator_t> body_generator;
 
     void add_header_line(const std::string&, const std::string&);
     void set_body(const std::string&, const std::string&);
+    void set_body_generator(const std::string &content_type,
+                            const boost::shared_ptr<http_body_generator_t> &generator);
 
     http_res_t();
     explicit http_res_t(http_status_code_t rescode);
@@ -117,6 +134,23 @@ public:
 
 bool maybe_gzip_response(const http_req_t &req, http_res_t *res);
 
+// Like `maybe_gzip_response()`, but for bodies of at least HTTP_STREAM_GZIP_MIN_SIZE,
+// and it compresses the body a chunk at a time as it's sent.  Only for HTTP/1.1
+// clients, because it turns the body into a `http_body_generator_t`.
+bool maybe_stream_gzip_response(const http_req_t &req, http_res_t *res);
+
+// Whether the connection should stay open for another request after this one.
+bool http_keep_alive(const http_req_t &req);
+
+// A weak ETag for a response with `body`.
+std::string http_etag(const std::string &body);
+
+// Makes `*res` a response with `body`, tagged with `etag`.  If the request's
+// If-None-Match already names `etag`, it's an empty 304 instead, so that a client
+// polling for something that hasn't changed doesn't get sent it again.
+void http_etag_res(const http_req_t &req, const std::string &content_type,
+                   const std::string &body, const std::string &etag, http_res_t *res);
+
 http_res_t http_error_res(const std::string &content,
                           http_status_code_t rescode = HTTP_BAD_REQUEST);
 
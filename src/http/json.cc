@@ -19,7 +19,11 @@ std::string (*cJSON_default_print)(cJSON *json) = cJSON_print_unformatted_std_st
 
 void http_json_res(cJSON *json, http_res_t *result) {
     result->code = HTTP_OK;
-    result->set_body("application/json", cJSON_default_print(json));
+    result->set_body("application/json", http_json_body(json));
+}
+
+std::string http_json_body(cJSON *json) {
+    return cJSON_default_print(json);
 }
 
 cJSON *cJSON_merge(cJSON *lhs, cJSON *rhs) {
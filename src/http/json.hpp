@@ -12,6 +12,8 @@
 class http_res_t;
 
 void http_json_res(cJSON *json, http_res_t *result);
+// The body `http_json_res()` sends for `json`.
+std::string http_json_body(cJSON *json);
 
 //TODO: do we both merge and cJSON_merge?
 //Merge two cJSON objects, crashes if there are overlapping keys
@@ -48,6 +48,14 @@ public:
         //we didn't every find a crlf unleash the exception
         if (*head) throw no_more_data_exc_t();
     }
+
+    uint8_t peek_byte(signal_t *interruptor) {
+        if (interruptor->is_pulsed()) throw no_more_data_exc_t();
+        int c = getc(file);
+        if (c == EOF) throw no_more_data_exc_t();
+        ungetc(c, file);
+        return c;
+    }
 };
 
 void import_memcache(const char *filename, namespace_interface_t<memcached_protocol_t> *nsi, signal_t *interrupter) {
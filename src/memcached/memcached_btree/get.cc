@@ -34,3 +34,27 @@ get_result_t memcached_get(const store_key_t &store_key,
     return get_result_t(dp, value->mcflags(), 0);
 }
 
+
+get_multi_result_t memcached_get_multi(const std::vector<store_key_t> &keys,
+                                       btree_slice_t *slice, exptime_t effective_time,
+                                       superblock_t *superblock) {
+    // `memcached_get()` releases the superblock, so every key after the first gets it
+    // again from the same transaction.  Because the keys are sorted, neighbouring
+    // lookups mostly land on leaves that were just loaded.
+    txn_t *txn = superblock->expose_buf().txn();
+
+    get_multi_result_t result;
+    scoped_ptr_t<real_superblock_t> next_superblock;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        superblock_t *key_superblock = superblock;
+        if (i > 0) {
+            get_btree_superblock(txn, access_t::read, &next_superblock);
+            key_superblock = next_superblock.get();
+        }
+        get_result_t res = memcached_get(keys[i], slice, effective_time, key_superblock);
+        if (res.value.has()) {
+            result.values[keys[i]] = res;
+        }
+    }
+    return result;
+}
@@ -2,6 +2,8 @@
 #ifndef MEMCACHED_MEMCACHED_BTREE_GET_HPP_
 #define MEMCACHED_MEMCACHED_BTREE_GET_HPP_
 
+#include <vector>
+
 #include "buffer_cache/types.hpp"
 #include "memcached/queries.hpp"
 
@@ -11,4 +13,10 @@ class superblock_t;
 get_result_t memcached_get(const store_key_t &key, btree_slice_t *slice,
                            exptime_t effective_time, superblock_t *superblock);
 
+// Looks up each of `keys`, which must be sorted, in one transaction.  Like
+// `memcached_get()`, it releases `superblock`.
+get_multi_result_t memcached_get_multi(const std::vector<store_key_t> &keys,
+                                       btree_slice_t *slice, exptime_t effective_time,
+                                       superblock_t *superblock);
+
 #endif // MEMCACHED_MEMCACHED_BTREE_GET_HPP_
@@ -64,8 +64,9 @@ size_t estimate_rget_result_pair_size(const key_with_data_buffer_t &pair) {
 class rget_depth_first_traversal_callback_t : public depth_first_traversal_callback_t {
 public:
     rget_depth_first_traversal_callback_t(buf_parent_t par,
-                                          int max, exptime_t et) :
-        parent(par), maximum(max), effective_time(et), cumulative_size(0) { }
+                                          int max, size_t chunk, exptime_t et) :
+        parent(par), maximum(max), chunk_size(chunk), effective_time(et),
+        cumulative_size(0) { }
     done_traversing_t handle_pair(scoped_key_value_t &&keyvalue) {
         const memcached_value_t *mc_value
             = static_cast<const memcached_value_t *>(keyvalue.value());
@@ -78,7 +79,7 @@ public:
                                                       data));
         cumulative_size += estimate_rget_result_pair_size(result.pairs.back());
         if ((static_cast<int64_t>(result.pairs.size()) < maximum)
-            && (cumulative_size < rget_max_chunk_size)) {
+            && (cumulative_size < chunk_size)) {
             return done_traversing_t::NO;
         } else {
             return done_traversing_t::YES;
@@ -86,19 +87,21 @@ public:
     }
     buf_parent_t parent;
     int maximum;
+    size_t chunk_size;
     exptime_t effective_time;
     rget_result_t result;
     size_t cumulative_size;
 };
 
 rget_result_t memcached_rget_slice(const key_range_t &range,
-                                   int maximum, exptime_t effective_time,
+                                   int maximum, size_t chunk_size,
+                                   exptime_t effective_time,
                                    superblock_t *superblock) {
 
     rget_depth_first_traversal_callback_t callback(superblock->expose_buf(),
-                                                   maximum, effective_time);
+                                                   maximum, chunk_size, effective_time);
     btree_depth_first_traversal(superblock, range, &callback, FORWARD);
-    if (callback.cumulative_size >= rget_max_chunk_size) {
+    if (callback.cumulative_size >= chunk_size) {
         callback.result.truncated = true;
     } else {
         callback.result.truncated = false;
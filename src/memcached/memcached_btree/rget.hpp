@@ -8,12 +8,11 @@
 
 class superblock_t;
 
-static const size_t rget_max_chunk_size = MEGABYTE;
-
 size_t estimate_rget_result_pair_size(const key_with_data_buffer_t &pair);
 
 rget_result_t memcached_rget_slice(const key_range_t &range,
-                                   int maximum, exptime_t effective_time,
+                                   int maximum, size_t chunk_size,
+                                   exptime_t effective_time,
                                    superblock_t *superblock);
 
 #endif // MEMCACHED_MEMCACHED_BTREE_RGET_HPP_
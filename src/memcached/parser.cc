@@ -5,18 +5,23 @@
 #include <stdarg.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <map>
 #include <set>
 #include <stdexcept>
 #include <vector>
 
 #include "errors.hpp"
 #include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include "concurrency/coro_fifo.hpp"
 #include "concurrency/mutex.hpp"
 #include "concurrency/semaphore.hpp"
 #include "concurrency/fifo_checker.hpp"
 #include "concurrency/cond_var.hpp"
+#include "concurrency/interruptor.hpp"
 #include "concurrency/pmap.hpp"
 #include "concurrency/promise.hpp"
 #include "containers/buffer_group.hpp"
@@ -26,6 +31,7 @@
 #include "arch/os_signal.hpp"
 #include "perfmon/collect.hpp"
 #include "memcached/stats.hpp"
+#include "thread_local.hpp"
 
 static const char *crlf = "\r\n";
 
@@ -175,6 +181,14 @@ struct txt_memcached_handler_t : public home_thread_mixin_debug_only_t {
         }
     }
 
+    uint8_t peek_byte() THROWS_ONLY(memcached_interface_t::no_more_data_exc_t) {
+        try {
+            return interface->peek_byte(interruptor);
+        } catch (const interrupted_exc_t &) {
+            throw memcached_interface_t::no_more_data_exc_t();
+        }
+    }
+
     void read_line(std::vector<char> *dest) THROWS_ONLY(memcached_interface_t::no_more_data_exc_t) {
         try {
             interface->read_line(dest, interruptor);
@@ -296,6 +310,39 @@ void do_one_get(txt_memcached_handler_t *rh, bool with_cas, get_t *gets, int i,
     }
 }
 
+/* Reads all of the keys of `gets` with one `get_multi_query_t`, which the namespace
+interface turns into one read per shard instead of one per key. */
+void do_multi_get(txt_memcached_handler_t *rh, std::vector<get_t> *gets, order_token_t token) {
+    std::vector<store_key_t> keys;
+    keys.reserve(gets->size());
+    for (size_t i = 0; i < gets->size(); ++i) {
+        keys.push_back((*gets)[i].key);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    try {
+        get_multi_query_t get_multi_query(keys);
+        memcached_protocol_t::read_t read(get_multi_query, time(NULL));
+        memcached_protocol_t::read_response_t response;
+        rh->nsi->read(read, &response, token, rh->interruptor);
+        const get_multi_result_t &result = boost::get<get_multi_result_t>(response.result);
+        for (size_t i = 0; i < gets->size(); ++i) {
+            std::map<store_key_t, get_result_t>::const_iterator it
+                = result.values.find((*gets)[i].key);
+            (*gets)[i].res = it == result.values.end() ? get_result_t() : it->second;
+            (*gets)[i].ok = true;
+        }
+    } catch (const cannot_perform_query_exc_t &e) {
+        for (size_t i = 0; i < gets->size(); ++i) {
+            (*gets)[i].error_message = e.what();
+            (*gets)[i].ok = false;
+        }
+    } catch (const interrupted_exc_t &) {
+        /* do nothing */
+    }
+}
+
 void do_get(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, bool with_cas, int argc, char **argv, order_token_t token) {
     // We should already be spawned within a coroutine.
     pipeliner_acq_t pipeliner_acq(pipeliner);
@@ -331,8 +378,13 @@ void do_get(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, bool with_cas,
 
     block_pm_duration get_timer(&rh->stats->pm_cmd_get);
 
-    /* Now that we're sure they're all valid, send off the requests */
-    pmap(gets.size(), boost::bind(&do_one_get, rh, with_cas, gets.data(), _1, token));
+    /* Now that we're sure they're all valid, send off the requests.  "gets" has to
+    go key by key, because each key gets a CAS written to it. */
+    if (with_cas || gets.size() == 1) {
+        pmap(gets.size(), boost::bind(&do_one_get, rh, with_cas, gets.data(), _1, token));
+    } else {
+        do_multi_get(rh, &gets, token);
+    }
 
     if (rh->interruptor->is_pulsed()) {
         pipeliner_acq.begin_write();
@@ -458,10 +510,17 @@ void do_rget(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, order_source_t
         avoid having to store all that data in memory at once or transfer it all
         over the network at once, we break the range scan into many
         sub-requests. `rget_query_t` will automatically stop the range scan once
-        it has read `rget_max_chunk_size` bytes of data. When we get the
+        it has read `chunk_size` bytes of data. When we get the
         `rget_result_t` back, if the query was truncated, we dispatch another
         `rget_query_t` starting where the last one left off. */
 
+        /* The chunks are written out as they come in, and writing blocks once the
+        connection's write queue is full, so a slow client holds up the next chunk's
+        traversal instead of letting results pile up here.  The first chunk is small
+        so the client sees data quickly; the chunks then double up to
+        `rget_max_chunk_size` so that big scans don't take too many round trips. */
+        size_t chunk_size = MEMCACHED_RGET_FIRST_CHUNK_SIZE;
+
         /* The naive approach has a problem, though. Suppose that we request a
         range from 'a' to 'z', and the database is sharded at 'm'. Both the
         'a'-'m' shard and the 'm'-'z' shard will get a request. Because the
@@ -488,7 +547,12 @@ void do_rget(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, order_source_t
         std::set<key_range_t>::const_iterator shard_it = real_shards.begin();
 
         while (max_items > 0) {
-            rget_query_t rget_query(region_intersection(memcached_protocol_t::region_t(range), memcached_protocol_t::region_t(*shard_it)), max_items);
+            /* There's no point in scanning further for a client that went away */
+            if (!rh->is_write_open()) {
+                break;
+            }
+
+            rget_query_t rget_query(region_intersection(memcached_protocol_t::region_t(range), memcached_protocol_t::region_t(*shard_it)), max_items, chunk_size);
             memcached_protocol_t::read_t read(rget_query, time(NULL));
             memcached_protocol_t::read_response_t response;
             rh->nsi->read(read, &response, order_source->check_in("do_rget").with_read_mode(), rh->interruptor);
@@ -509,6 +573,7 @@ void do_rget(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, order_source_t
                 guarantee(!results.pairs.empty());
                 range.left = results.pairs.back().key;
                 range.left.increment();
+                chunk_size = std::min(chunk_size * 2, rget_max_chunk_size);
             } else {
                 /* This round of the range scan stopped for some other reason... */
                 ++shard_it;
@@ -572,6 +637,27 @@ struct storage_metadata_t {
         : mcflags(_mcflags), exptime(_exptime), unique(_unique) { }
 };
 
+exptime_t absolute_exptime(exptime_t exptime) {
+    // This is protocol.txt, verbatim:
+    // Some commands involve a client sending some kind of expiration time
+    // (relative to an item or to an operation requested by the client) to
+    // the server. In all such cases, the actual value sent may either be
+    // Unix time (number of seconds since January 1, 1970, as a 32-bit
+    // value), or a number of seconds starting from current time. In the
+    // latter case, this number of seconds may not exceed 60*60*24*30 (number
+    // of seconds in 30 days); if the number sent by a client is larger than
+    // that, the server will consider it to be real Unix time value rather
+    // than an offset from current time.
+    if (exptime <= 60*60*24*30 && exptime > 0) {
+        // If 60*60*24*30 < exptime <= time(NULL), that's fine, the
+        // btree code needs to handle that case gracefully anyway
+        // (since the clock can tick in the middle of an insert
+        // anyway...).  We have tests in expiration.py.
+        exptime += time(NULL);
+    }
+    return exptime;
+}
+
 void run_storage_command(txt_memcached_handler_t *rh,
                          pipeliner_acq_t *pipeliner_acq_raw,
                          storage_command_t sc,
@@ -766,23 +852,7 @@ void do_storage(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, storage_com
         return;
     }
 
-    // This is protocol.txt, verbatim:
-    // Some commands involve a client sending some kind of expiration time
-    // (relative to an item or to an operation requested by the client) to
-    // the server. In all such cases, the actual value sent may either be
-    // Unix time (number of seconds since January 1, 1970, as a 32-bit
-    // value), or a number of seconds starting from current time. In the
-    // latter case, this number of seconds may not exceed 60*60*24*30 (number
-    // of seconds in 30 days); if the number sent by a client is larger than
-    // that, the server will consider it to be real Unix time value rather
-    // than an offset from current time.
-    if (exptime <= 60*60*24*30 && exptime > 0) {
-        // If 60*60*24*30 < exptime <= time(NULL), that's fine, the
-        // btree code needs to handle that case gracefully anyway
-        // (since the clock can tick in the middle of an insert
-        // anyway...).  We have tests in expiration.py.
-        exptime += time(NULL);
-    }
+    exptime = absolute_exptime(exptime);
 
     /* Now parse the value length */
     size_t value_size = strtou64_strict(argv[4], &invalid_char, 10);
@@ -856,6 +926,154 @@ void do_storage(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, storage_com
 }
 
 /* "incr" and "decr" commands */
+
+/* Rate limiters and the like send lots of increments to a few counters.  While an
+increment of a key is being written, the increments of that key that come in on the
+same thread (through the same namespace interface) get collected into a batch, which
+goes out as one write once the one before it is done.  The batch's write adds up its
+increments, and each increment gets the value it would have gotten if the batch's
+increments had been applied one after another, in the order they came in.
+
+Decrements stop at zero, so from the result of a combined decrement we couldn't tell
+what each of them would have gotten; they always get their own write. */
+class incr_combiner_t : public home_thread_mixin_debug_only_t {
+public:
+    // Calls `pipeliner_acq->done_argparsing()` once the increment's place among the
+    // connection's writes is decided.
+    incr_decr_result_t incr(txt_memcached_handler_t *rh, pipeliner_acq_t *pipeliner_acq,
+                            const store_key_t &key, uint64_t amount, order_token_t token)
+        THROWS_ONLY(cannot_perform_query_exc_t, interrupted_exc_t);
+
+private:
+    enum class outcome_t { PENDING, SUCCEEDED, FAILED, INTERRUPTED };
+
+    struct batch_t {
+        batch_t() : total(0), outcome(outcome_t::PENDING) { }
+        // The sum of the batch's increments, wrapping around like they do.
+        uint64_t total;
+        // `sent` is pulsed when the batch's write goes out, `done` when it returns.
+        cond_t sent, done;
+        outcome_t outcome;
+        incr_decr_result_t result;
+        std::string error_message;
+    };
+
+    typedef std::pair<namespace_interface_t<memcached_protocol_t> *, store_key_t> key_t;
+
+    struct key_state_t {
+        // The batch whose write is out, and the one new increments join.
+        boost::shared_ptr<batch_t> sent, open;
+    };
+
+    void send_batch(txt_memcached_handler_t *rh, pipeliner_acq_t *pipeliner_acq,
+                    const key_t &key, batch_t *batch, order_token_t token);
+    void forget_batch(const key_t &key, batch_t *batch);
+
+    std::map<key_t, key_state_t> keys_;
+};
+
+incr_decr_result_t incr_combiner_t::incr(txt_memcached_handler_t *rh,
+                                         pipeliner_acq_t *pipeliner_acq,
+                                         const store_key_t &store_key, uint64_t amount,
+                                         order_token_t token)
+        THROWS_ONLY(cannot_perform_query_exc_t, interrupted_exc_t) {
+    assert_thread();
+    const key_t key(rh->nsi, store_key);
+
+    key_state_t *state = &keys_[key];
+    const bool first = !state->open;
+    if (first) {
+        state->open = boost::make_shared<batch_t>();
+    }
+    boost::shared_ptr<batch_t> batch = state->open;
+    const uint64_t before = batch->total;
+    batch->total += amount;
+
+    if (first) {
+        send_batch(rh, pipeliner_acq, key, batch.get(), token);
+    } else {
+        rh->stats->pm_cmd_incr_combined.record();
+        // The connection's later commands go after the write that carries this one.
+        try {
+            wait_interruptible(&batch->sent, rh->interruptor);
+        } catch (const interrupted_exc_t &) {
+            pipeliner_acq->done_argparsing();
+            throw;
+        }
+        pipeliner_acq->done_argparsing();
+        wait_interruptible(&batch->done, rh->interruptor);
+    }
+
+    switch (batch->outcome) {
+    case outcome_t::SUCCEEDED:
+        if (batch->result.res == incr_decr_result_t::idr_success) {
+            return incr_decr_result_t(incr_decr_result_t::idr_success,
+                batch->result.new_value - batch->total + before + amount);
+        }
+        return batch->result;
+    case outcome_t::FAILED:
+        throw cannot_perform_query_exc_t(batch->error_message);
+    case outcome_t::INTERRUPTED:
+        throw interrupted_exc_t();
+    case outcome_t::PENDING:
+    default:
+        unreachable();
+    }
+}
+
+void incr_combiner_t::send_batch(txt_memcached_handler_t *rh,
+                                 pipeliner_acq_t *pipeliner_acq,
+                                 const key_t &key, batch_t *batch,
+                                 order_token_t token) {
+    try {
+        // One write per key at a time; increments pile up in `batch` meanwhile.
+        while (keys_[key].sent) {
+            boost::shared_ptr<batch_t> sent = keys_[key].sent;
+            wait_interruptible(&sent->done, rh->interruptor);
+        }
+    } catch (const interrupted_exc_t &) {
+        batch->outcome = outcome_t::INTERRUPTED;
+        keys_[key].open.reset();
+        forget_batch(key, batch);
+        pipeliner_acq->done_argparsing();
+        return;
+    }
+    pipeliner_acq->done_argparsing();
+
+    key_state_t *state = &keys_[key];
+    guarantee(state->open.get() == batch && !state->sent);
+    state->sent.swap(state->open);
+    batch->sent.pulse();
+
+    try {
+        incr_decr_mutation_t incr_decr_mutation(incr_decr_INCR, key.second, batch->total);
+        memcached_protocol_t::write_t write(incr_decr_mutation, rh->generate_cas(), time(NULL));
+        memcached_protocol_t::write_response_t result;
+        rh->nsi->write(write, &result, token, rh->interruptor);
+        batch->result = boost::get<incr_decr_result_t>(result.result);
+        batch->outcome = outcome_t::SUCCEEDED;
+    } catch (const cannot_perform_query_exc_t &e) {
+        batch->error_message = e.what();
+        batch->outcome = outcome_t::FAILED;
+    } catch (const interrupted_exc_t &) {
+        batch->outcome = outcome_t::INTERRUPTED;
+    }
+
+    keys_[key].sent.reset();
+    forget_batch(key, batch);
+}
+
+void incr_combiner_t::forget_batch(const key_t &key, batch_t *batch) {
+    const key_state_t &state = keys_[key];
+    if (!state.sent && !state.open) {
+        keys_.erase(key);
+    }
+    batch->sent.pulse_if_not_already_pulsed();
+    batch->done.pulse();
+}
+
+TLS_with_init(incr_combiner_t *, incr_combiner, NULL);
+
 void run_incr_decr(txt_memcached_handler_t *rh, pipeliner_acq_t *pipeliner_acq, store_key_t key, uint64_t amount, bool incr, bool noreply, order_token_t token) {
     block_pm_duration set_timer(&rh->stats->pm_cmd_set);
 
@@ -864,13 +1082,21 @@ void run_incr_decr(txt_memcached_handler_t *rh, pipeliner_acq_t *pipeliner_acq,
     bool ok;
 
     try {
-        incr_decr_mutation_t incr_decr_mutation(
-            incr ? incr_decr_INCR : incr_decr_DECR,
-            key, amount);
-        memcached_protocol_t::write_t write(incr_decr_mutation, rh->generate_cas(), time(NULL));
-        memcached_protocol_t::write_response_t result;
-        rh->nsi->write(write, &result, token, rh->interruptor);
-        res = boost::get<incr_decr_result_t>(result.result);
+        if (incr) {
+            incr_combiner_t *combiner = TLS_get_incr_combiner();
+            if (combiner == NULL) {
+                combiner = new incr_combiner_t;
+                TLS_set_incr_combiner(combiner);
+            }
+            res = combiner->incr(rh, pipeliner_acq, key, amount, token);
+        } else {
+            pipeliner_acq->done_argparsing();
+            incr_decr_mutation_t incr_decr_mutation(incr_decr_DECR, key, amount);
+            memcached_protocol_t::write_t write(incr_decr_mutation, rh->generate_cas(), time(NULL));
+            memcached_protocol_t::write_response_t result;
+            rh->nsi->write(write, &result, token, rh->interruptor);
+            res = boost::get<incr_decr_result_t>(result.result);
+        }
         ok = true;
     } catch (const cannot_perform_query_exc_t &e) {
         error_message = e.what();
@@ -952,8 +1178,7 @@ void do_incr_decr(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, bool i, i
         noreply = false;
     }
 
-    pipeliner_acq.done_argparsing();
-
+    // `run_incr_decr()` calls `pipeliner_acq.done_argparsing()`.
     run_incr_decr(rh, &pipeliner_acq, key, delta, i, noreply, token);
 }
 
@@ -1059,7 +1284,7 @@ void do_delete(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, int argc, ch
 
 /* "stats" command */
 
-void format_stats(const perfmon_result_t *stats, const std::string& name, const std::set<std::string>& names_to_match, std::vector<std::string> *result) {
+void format_stats(const perfmon_result_t *stats, const std::string& name, const std::set<std::string>& names_to_match, std::vector<std::pair<std::string, std::string> > *result) {
     // `switch` is used instead of `if` with `is_map` and `is_string` checks
     // because that way the compiler guarantees us an error message if someone
     // adds another type of `perfmon_results_t` and forgets to change this code
@@ -1068,7 +1293,7 @@ void format_stats(const perfmon_result_t *stats, const std::string& name, const
              // This is not super-efficient (better to only scan for the stats
              // that match the name), but we don't care right now
             if (names_to_match.empty() || names_to_match.count(name) != 0) {
-                result->push_back(strprintf("STAT %s %s\r\n", name.c_str(), stats->get_string()->c_str()));
+                result->push_back(std::make_pair(name, *stats->get_string()));
             }
             break;
         case perfmon_result_t::type_map:
@@ -1092,10 +1317,662 @@ void memcached_stats(int argc, char **argv, std::vector<std::string> *stat_respo
     }
 
     scoped_ptr_t<perfmon_result_t> stats(perfmon_get_stats());
-    format_stats(stats.get(), std::string(), names_to_match, stat_response_lines);
+    std::vector<std::pair<std::string, std::string> > values;
+    format_stats(stats.get(), std::string(), names_to_match, &values);
+    for (size_t i = 0; i < values.size(); ++i) {
+        stat_response_lines->push_back(strprintf("STAT %s %s\r\n", values[i].first.c_str(), values[i].second.c_str()));
+    }
     stat_response_lines->push_back(end_marker);
 }
 
+/* The binary protocol.  A connection speaks it if the first byte it sends is
+`BINARY_REQUEST_MAGIC`.  Each request and response is a 24-byte header followed by
+the extras, the key and the value, and the header's integers are big-endian.  The
+requests go through the same `pipeliner_t` as text commands, so the responses come
+back in the order the requests came in.
+
+The quiet variants of the commands only respond on a miss or an error (or, for the
+quiet gets, on a hit).  Clients get many keys at once with a run of quiet gets ended
+by a get or a no-op, so such a run is read as a batch and its keys are looked up in
+parallel, like the keys of a text "get". */
+
+static const uint8_t BINARY_REQUEST_MAGIC = 0x80;
+static const uint8_t BINARY_RESPONSE_MAGIC = 0x81;
+static const size_t BINARY_HEADER_SIZE = 24;
+
+enum binary_opcode_t {
+    BINARY_GET = 0x00,
+    BINARY_SET = 0x01,
+    BINARY_ADD = 0x02,
+    BINARY_REPLACE = 0x03,
+    BINARY_DELETE = 0x04,
+    BINARY_INCREMENT = 0x05,
+    BINARY_DECREMENT = 0x06,
+    BINARY_QUIT = 0x07,
+    BINARY_FLUSH = 0x08,
+    BINARY_GETQ = 0x09,
+    BINARY_NOOP = 0x0a,
+    BINARY_VERSION = 0x0b,
+    BINARY_GETK = 0x0c,
+    BINARY_GETKQ = 0x0d,
+    BINARY_APPEND = 0x0e,
+    BINARY_PREPEND = 0x0f,
+    BINARY_STAT = 0x10,
+    BINARY_SETQ = 0x11,
+    BINARY_ADDQ = 0x12,
+    BINARY_REPLACEQ = 0x13,
+    BINARY_DELETEQ = 0x14,
+    BINARY_INCREMENTQ = 0x15,
+    BINARY_DECREMENTQ = 0x16,
+    BINARY_QUITQ = 0x17,
+    BINARY_FLUSHQ = 0x18,
+    BINARY_APPENDQ = 0x19,
+    BINARY_PREPENDQ = 0x1a
+};
+
+enum binary_status_t {
+    BINARY_STATUS_OK = 0x0000,
+    BINARY_STATUS_KEY_NOT_FOUND = 0x0001,
+    BINARY_STATUS_KEY_EXISTS = 0x0002,
+    BINARY_STATUS_VALUE_TOO_LARGE = 0x0003,
+    BINARY_STATUS_INVALID_ARGUMENTS = 0x0004,
+    BINARY_STATUS_ITEM_NOT_STORED = 0x0005,
+    BINARY_STATUS_NON_NUMERIC = 0x0006,
+    BINARY_STATUS_UNKNOWN_COMMAND = 0x0081,
+    BINARY_STATUS_NOT_SUPPORTED = 0x0083,
+    BINARY_STATUS_INTERNAL_ERROR = 0x0084
+};
+
+struct binary_request_t {
+    uint8_t opcode;
+    uint32_t opaque;
+    cas_t cas;
+    std::string extras;
+    std::string key;
+    counted_t<data_buffer_t> value;
+};
+
+static uint64_t decode_big_endian(const char *bytes, size_t size) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; ++i) {
+        value = (value << 8) | static_cast<uint8_t>(bytes[i]);
+    }
+    return value;
+}
+
+static void encode_big_endian(uint64_t value, size_t size, char *bytes_out) {
+    for (size_t i = size; i-- > 0;) {
+        bytes_out[i] = static_cast<char>(value & 0xff);
+        value >>= 8;
+    }
+}
+
+static std::string big_endian_string(uint64_t value, size_t size) {
+    char bytes[sizeof(uint64_t)];
+    encode_big_endian(value, size, bytes);
+    return std::string(bytes, size);
+}
+
+/* Maps the quiet variant of a command to the command itself, and every other opcode
+to itself. */
+static uint8_t binary_loud_opcode(uint8_t opcode) {
+    switch (opcode) {
+    case BINARY_GETQ: return BINARY_GET;
+    case BINARY_GETKQ: return BINARY_GETK;
+    case BINARY_SETQ: return BINARY_SET;
+    case BINARY_ADDQ: return BINARY_ADD;
+    case BINARY_REPLACEQ: return BINARY_REPLACE;
+    case BINARY_DELETEQ: return BINARY_DELETE;
+    case BINARY_INCREMENTQ: return BINARY_INCREMENT;
+    case BINARY_DECREMENTQ: return BINARY_DECREMENT;
+    case BINARY_QUITQ: return BINARY_QUIT;
+    case BINARY_FLUSHQ: return BINARY_FLUSH;
+    case BINARY_APPENDQ: return BINARY_APPEND;
+    case BINARY_PREPENDQ: return BINARY_PREPEND;
+    default: return opcode;
+    }
+}
+
+static bool is_binary_quiet(uint8_t opcode) {
+    return binary_loud_opcode(opcode) != opcode;
+}
+
+static bool is_binary_get(uint8_t opcode) {
+    uint8_t loud = binary_loud_opcode(opcode);
+    return loud == BINARY_GET || loud == BINARY_GETK;
+}
+
+static const char *binary_status_message(uint16_t status) {
+    switch (status) {
+    case BINARY_STATUS_KEY_NOT_FOUND: return "Not found";
+    case BINARY_STATUS_KEY_EXISTS: return "Data exists for key";
+    case BINARY_STATUS_VALUE_TOO_LARGE: return "Too large";
+    case BINARY_STATUS_INVALID_ARGUMENTS: return "Invalid arguments";
+    case BINARY_STATUS_ITEM_NOT_STORED: return "Not stored";
+    case BINARY_STATUS_NON_NUMERIC: return "Non-numeric server-side value for incr or decr";
+    case BINARY_STATUS_UNKNOWN_COMMAND: return "Unknown command";
+    case BINARY_STATUS_NOT_SUPPORTED: return "Not supported";
+    default: return "";
+    }
+}
+
+/* Reads the next request off the connection.  Returns false if the client closed
+the connection or sent something that isn't a binary request, in which case the
+connection should be closed. */
+static bool read_binary_request(txt_memcached_handler_t *rh, binary_request_t *request) {
+    try {
+        char header[BINARY_HEADER_SIZE];
+        rh->read(header, BINARY_HEADER_SIZE);
+        if (static_cast<uint8_t>(header[0]) != BINARY_REQUEST_MAGIC) {
+            return false;
+        }
+        request->opcode = header[1];
+        const size_t key_size = decode_big_endian(header + 2, 2);
+        const size_t extras_size = static_cast<uint8_t>(header[4]);
+        const size_t body_size = decode_big_endian(header + 8, 4);
+        request->opaque = decode_big_endian(header + 12, 4);
+        request->cas = decode_big_endian(header + 16, 8);
+
+        // Check for signed 32 bit max value for Memcached compatibility...
+        if (body_size < key_size + extras_size || body_size >= (1u << 31) - 1) {
+            return false;
+        }
+
+        request->extras.resize(extras_size);
+        if (extras_size > 0) {
+            rh->read(&request->extras[0], extras_size);
+        }
+        request->key.resize(key_size);
+        if (key_size > 0) {
+            rh->read(&request->key[0], key_size);
+        }
+        const size_t value_size = body_size - key_size - extras_size;
+        request->value = data_buffer_t::create(value_size);
+        if (value_size > 0) {
+            rh->read(request->value->buf(), value_size);
+        }
+        return true;
+    } catch (const memcached_interface_t::no_more_data_exc_t &) {
+        return false;
+    }
+}
+
+static bool parse_binary_key(const binary_request_t &request, store_key_t *key_out) {
+    return !request.key.empty()
+        && unescaped_str_to_key(request.key.data(), request.key.size(), key_out);
+}
+
+static void write_binary_response(txt_memcached_handler_t *rh,
+                                  const binary_request_t &request,
+                                  uint16_t status,
+                                  cas_t cas,
+                                  const std::string &extras,
+                                  const std::string &key,
+                                  const char *value,
+                                  size_t value_size) THROWS_NOTHING {
+    char header[BINARY_HEADER_SIZE];
+    header[0] = static_cast<char>(BINARY_RESPONSE_MAGIC);
+    header[1] = static_cast<char>(request.opcode);
+    encode_big_endian(key.size(), 2, header + 2);
+    header[4] = static_cast<char>(extras.size());
+    header[5] = 0;  // The data type, which is always raw bytes.
+    encode_big_endian(status, 2, header + 6);
+    encode_big_endian(extras.size() + key.size() + value_size, 4, header + 8);
+    encode_big_endian(request.opaque, 4, header + 12);
+    encode_big_endian(cas, 8, header + 16);
+
+    rh->write(header, BINARY_HEADER_SIZE);
+    if (!extras.empty()) {
+        rh->write(extras);
+    }
+    if (!key.empty()) {
+        rh->write(key);
+    }
+    if (value_size == 0) {
+        /* Nothing to write */
+    } else if (value_size < MAX_BUFFERED_GET_SIZE) {
+        rh->write(value, value_size);
+    } else {
+        rh->write_unbuffered(value, value_size);
+    }
+}
+
+/* Writes a response with no extras or key.  If it's an error and `value` is empty,
+the value is the usual message for `status`. */
+static void write_binary_response(txt_memcached_handler_t *rh,
+                                  const binary_request_t &request,
+                                  uint16_t status,
+                                  const std::string &value) THROWS_NOTHING {
+    std::string message = value.empty() ? binary_status_message(status) : value;
+    write_binary_response(rh, request, status, 0, std::string(), std::string(),
+                          message.data(), message.size());
+}
+
+/* "get", "getq", "getk" and "getkq", batched */
+
+void do_binary_gets(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, const std::vector<binary_request_t> &requests, order_token_t token) {
+    // We should already be spawned within a coroutine.
+    pipeliner_acq_t pipeliner_acq(pipeliner);
+
+    /* Only the requests with valid keys get an entry in `gets`, so that all of it
+    can be looked up at once. */
+    std::vector<get_t> gets;
+    std::vector<bool> valid(requests.size());
+    gets.reserve(requests.size());
+    for (size_t i = 0; i < requests.size(); ++i) {
+        store_key_t key;
+        valid[i] = requests[i].extras.empty() && parse_binary_key(requests[i], &key);
+        if (valid[i]) {
+            gets.push_back(get_t());
+            gets.back().key = key;
+            rh->stats->pm_get_key_size.record(key.size());
+        }
+    }
+
+    pipeliner_acq.done_argparsing();
+
+    block_pm_duration get_timer(&rh->stats->pm_cmd_get);
+
+    if (gets.size() == 1) {
+        do_one_get(rh, false, gets.data(), 0, token);
+    } else if (!gets.empty()) {
+        do_multi_get(rh, &gets, token);
+    }
+
+    if (rh->interruptor->is_pulsed()) {
+        pipeliner_acq.begin_write();
+        pipeliner_acq.end_write();
+        return;
+    }
+
+    pipeliner_acq.begin_write();
+
+    size_t next_get = 0;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        const binary_request_t &request = requests[i];
+        if (!valid[i]) {
+            write_binary_response(rh, request, BINARY_STATUS_INVALID_ARGUMENTS, std::string());
+            continue;
+        }
+
+        const get_t &get = gets[next_get++];
+        const std::string &key = binary_loud_opcode(request.opcode) == BINARY_GETK
+            ? request.key : std::string();
+        if (!get.ok) {
+            write_binary_response(rh, request, BINARY_STATUS_INTERNAL_ERROR, get.error_message);
+        } else if (get.res.value.has()) {
+            write_binary_response(rh, request, BINARY_STATUS_OK, get.res.cas,
+                                  big_endian_string(get.res.flags, 4), key,
+                                  get.res.value->buf(), get.res.value->size());
+        } else if (!is_binary_quiet(request.opcode)) {
+            const char *message = binary_status_message(BINARY_STATUS_KEY_NOT_FOUND);
+            write_binary_response(rh, request, BINARY_STATUS_KEY_NOT_FOUND, 0,
+                                  std::string(), key, message, strlen(message));
+        }
+    }
+
+    pipeliner_acq.end_write();
+}
+
+/* "set", "add", "replace", "append", "prepend", "delete", "incr" and "decr", and their
+quiet variants */
+
+/* Performs `query`.  Returns false and sets `*error_out` if it couldn't be performed. */
+static bool perform_binary_write(txt_memcached_handler_t *rh,
+                                 const memcached_protocol_t::write_t::query_t &query,
+                                 cas_t proposed_cas,
+                                 memcached_protocol_t::write_response_t *response_out,
+                                 std::string *error_out,
+                                 order_token_t token) THROWS_ONLY(interrupted_exc_t) {
+    try {
+        memcached_protocol_t::write_t write(query, proposed_cas, time(NULL));
+        rh->nsi->write(write, response_out, token, rh->interruptor);
+        return true;
+    } catch (const cannot_perform_query_exc_t &e) {
+        *error_out = e.what();
+        return false;
+    }
+}
+
+static uint16_t run_binary_sarc(txt_memcached_handler_t *rh,
+                                uint8_t opcode,
+                                const store_key_t &key,
+                                const binary_request_t &request,
+                                std::string *error_out,
+                                order_token_t token) THROWS_ONLY(interrupted_exc_t) {
+    add_policy_t add_policy = opcode == BINARY_REPLACE ? add_policy_no : add_policy_yes;
+    replace_policy_t replace_policy = opcode == BINARY_ADD ? replace_policy_no : replace_policy_yes;
+    cas_t unique = NO_CAS_SUPPLIED;
+    if (request.cas != 0 && opcode != BINARY_ADD) {
+        // A set or replace with a CAS is the text protocol's "cas" command.
+        add_policy = add_policy_no;
+        replace_policy = replace_policy_if_cas_matches;
+        unique = request.cas;
+    }
+
+    sarc_mutation_t sarc_mutation(key, request.value,
+                                  decode_big_endian(request.extras.data(), 4),
+                                  absolute_exptime(decode_big_endian(request.extras.data() + 4, 4)),
+                                  add_policy, replace_policy, unique);
+    memcached_protocol_t::write_response_t response;
+    if (!perform_binary_write(rh, sarc_mutation, rh->generate_cas(), &response, error_out, token)) {
+        return BINARY_STATUS_INTERNAL_ERROR;
+    }
+
+    switch (boost::get<set_result_t>(response.result)) {
+    case sr_stored: return BINARY_STATUS_OK;
+    // A replace or CAS of a key that isn't there
+    case sr_didnt_add: return BINARY_STATUS_KEY_NOT_FOUND;
+    // An add of a key that is there, or a CAS that didn't match
+    case sr_didnt_replace: return BINARY_STATUS_KEY_EXISTS;
+    case sr_too_large: return BINARY_STATUS_VALUE_TOO_LARGE;
+    default: unreachable();
+    }
+}
+
+static uint16_t run_binary_append_prepend(txt_memcached_handler_t *rh,
+                                          uint8_t opcode,
+                                          const store_key_t &key,
+                                          const binary_request_t &request,
+                                          std::string *error_out,
+                                          order_token_t token) THROWS_ONLY(interrupted_exc_t) {
+    append_prepend_mutation_t append_prepend_mutation(
+        opcode == BINARY_APPEND ? append_prepend_APPEND : append_prepend_PREPEND,
+        key, request.value);
+    memcached_protocol_t::write_response_t response;
+    if (!perform_binary_write(rh, append_prepend_mutation, rh->generate_cas(), &response, error_out, token)) {
+        return BINARY_STATUS_INTERNAL_ERROR;
+    }
+
+    switch (boost::get<append_prepend_result_t>(response.result)) {
+    case apr_success: return BINARY_STATUS_OK;
+    case apr_not_found: return BINARY_STATUS_ITEM_NOT_STORED;
+    case apr_too_large: return BINARY_STATUS_VALUE_TOO_LARGE;
+    default: unreachable();
+    }
+}
+
+static uint16_t run_binary_delete(txt_memcached_handler_t *rh,
+                                  const store_key_t &key,
+                                  std::string *error_out,
+                                  order_token_t token) THROWS_ONLY(interrupted_exc_t) {
+    delete_mutation_t delete_mutation(key, false);
+    memcached_protocol_t::write_response_t response;
+    if (!perform_binary_write(rh, delete_mutation, INVALID_CAS, &response, error_out, token)) {
+        return BINARY_STATUS_INTERNAL_ERROR;
+    }
+
+    switch (boost::get<delete_result_t>(response.result)) {
+    case dr_deleted: return BINARY_STATUS_OK;
+    case dr_not_found: return BINARY_STATUS_KEY_NOT_FOUND;
+    default: unreachable();
+    }
+}
+
+/* Unlike the text protocol's, the binary "incr" and "decr" create a missing key with
+the initial value in their extras, unless its expiration time is all ones. */
+static uint16_t run_binary_incr_decr(txt_memcached_handler_t *rh,
+                                     uint8_t opcode,
+                                     const store_key_t &key,
+                                     const binary_request_t &request,
+                                     std::string *value_out,
+                                     std::string *error_out,
+                                     order_token_t token) THROWS_ONLY(interrupted_exc_t) {
+    const uint64_t delta = decode_big_endian(request.extras.data(), 8);
+    const uint64_t initial = decode_big_endian(request.extras.data() + 8, 8);
+    const exptime_t exptime = decode_big_endian(request.extras.data() + 16, 4);
+
+    for (;;) {
+        incr_decr_mutation_t incr_decr_mutation(
+            opcode == BINARY_INCREMENT ? incr_decr_INCR : incr_decr_DECR,
+            key, delta);
+        memcached_protocol_t::write_response_t response;
+        if (!perform_binary_write(rh, incr_decr_mutation, rh->generate_cas(), &response, error_out, token)) {
+            return BINARY_STATUS_INTERNAL_ERROR;
+        }
+
+        incr_decr_result_t res = boost::get<incr_decr_result_t>(response.result);
+        switch (res.res) {
+        case incr_decr_result_t::idr_success:
+            *value_out = big_endian_string(res.new_value, 8);
+            return BINARY_STATUS_OK;
+        case incr_decr_result_t::idr_not_found:
+            break;
+        case incr_decr_result_t::idr_not_numeric:
+            return BINARY_STATUS_NON_NUMERIC;
+        default: unreachable();
+        }
+
+        if (exptime == 0xffffffff) {
+            return BINARY_STATUS_KEY_NOT_FOUND;
+        }
+
+        std::string initial_str = strprintf("%" PRIu64, initial);
+        counted_t<data_buffer_t> data = data_buffer_t::create(initial_str.size());
+        memcpy(data->buf(), initial_str.data(), initial_str.size());
+        sarc_mutation_t sarc_mutation(key, data, 0, absolute_exptime(exptime),
+                                      add_policy_yes, replace_policy_no, NO_CAS_SUPPLIED);
+
+        // The commands after this one may already have gone out with later tokens,
+        // so the writes that follow up on the first one can't be order-checked.
+        token = order_token_t::ignore;
+        if (!perform_binary_write(rh, sarc_mutation, rh->generate_cas(), &response, error_out, token)) {
+            return BINARY_STATUS_INTERNAL_ERROR;
+        }
+        if (boost::get<set_result_t>(response.result) == sr_stored) {
+            *value_out = big_endian_string(initial, 8);
+            return BINARY_STATUS_OK;
+        }
+        // Somebody else created the key in the meantime, so apply the delta to theirs.
+    }
+}
+
+void do_binary_write(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, const binary_request_t &request, order_token_t token) {
+    // We should already be spawned within a coroutine.
+    pipeliner_acq_t pipeliner_acq(pipeliner);
+
+    const uint8_t opcode = binary_loud_opcode(request.opcode);
+    size_t extras_size = 0;
+    bool has_value = false;
+    switch (opcode) {
+    case BINARY_SET:
+    case BINARY_ADD:
+    case BINARY_REPLACE:
+        extras_size = 8;
+        has_value = true;
+        break;
+    case BINARY_APPEND:
+    case BINARY_PREPEND:
+        has_value = true;
+        break;
+    case BINARY_INCREMENT:
+    case BINARY_DECREMENT:
+        extras_size = 20;
+        break;
+    case BINARY_DELETE:
+        break;
+    default: unreachable();
+    }
+
+    store_key_t key;
+    if (!parse_binary_key(request, &key)
+        || request.extras.size() != extras_size
+        || (!has_value && request.value->size() != 0)) {
+        pipeliner_acq.done_argparsing();
+        pipeliner_acq.begin_write();
+        write_binary_response(rh, request, BINARY_STATUS_INVALID_ARGUMENTS, std::string());
+        pipeliner_acq.end_write();
+        return;
+    }
+    if (has_value) {
+        rh->stats->pm_storage_key_size.record(key.size());
+        rh->stats->pm_storage_value_size.record(request.value->size());
+    }
+
+    pipeliner_acq.done_argparsing();
+
+    block_pm_duration set_timer(&rh->stats->pm_cmd_set);
+
+    uint16_t status;
+    std::string value;
+    std::string error_message;
+    try {
+        switch (opcode) {
+        case BINARY_SET:
+        case BINARY_ADD:
+        case BINARY_REPLACE:
+            status = run_binary_sarc(rh, opcode, key, request, &error_message, token);
+            break;
+        case BINARY_APPEND:
+        case BINARY_PREPEND:
+            status = run_binary_append_prepend(rh, opcode, key, request, &error_message, token);
+            break;
+        case BINARY_INCREMENT:
+        case BINARY_DECREMENT:
+            status = run_binary_incr_decr(rh, opcode, key, request, &value, &error_message, token);
+            break;
+        case BINARY_DELETE:
+            status = run_binary_delete(rh, key, &error_message, token);
+            break;
+        default: unreachable();
+        }
+    } catch (const interrupted_exc_t &) {
+        pipeliner_acq.begin_write();
+        pipeliner_acq.end_write();
+        return;
+    }
+
+    pipeliner_acq.begin_write();
+    if (status != BINARY_STATUS_OK) {
+        write_binary_response(rh, request, status, error_message);
+    } else if (!is_binary_quiet(request.opcode)) {
+        write_binary_response(rh, request, status, 0, std::string(), std::string(),
+                              value.data(), value.size());
+    }
+    pipeliner_acq.end_write();
+}
+
+/* Responds to a request that doesn't touch the table, in order with the others. */
+static void write_binary_response_in_order(txt_memcached_handler_t *rh,
+                                           pipeliner_t *pipeliner,
+                                           const binary_request_t &request,
+                                           uint16_t status,
+                                           const std::string &value) {
+    pipeliner_acq_t pipeliner_acq(pipeliner);
+    pipeliner_acq.done_argparsing();
+    pipeliner_acq.begin_write();
+    write_binary_response(rh, request, status, 0, std::string(), std::string(),
+                          value.data(), value.size());
+    pipeliner_acq.end_write();
+}
+
+static void handle_binary_memcache(txt_memcached_handler_t *rh,
+                                   pipeliner_t *pipeliner,
+                                   order_source_t *order_source) {
+    /* The request that ended the last batch of gets, if it wasn't a get itself */
+    binary_request_t next_request;
+    bool have_next_request = false;
+
+    while (pipeliner->lock_argparsing(), !rh->interruptor->is_pulsed()) {
+        /* Read a request off the socket */
+        block_pm_duration read_timer(&rh->stats->pm_conns_reading);
+        binary_request_t request;
+        if (have_next_request) {
+            request = next_request;
+            have_next_request = false;
+        } else if (!read_binary_request(rh, &request)) {
+            break;
+        }
+        read_timer.end();
+
+        block_pm_duration action_timer(&rh->stats->pm_conns_acting);
+
+        bool closing = false;
+        order_token_t token = order_source->check_in("handle_binary_memcache");
+        switch (binary_loud_opcode(request.opcode)) {
+        case BINARY_GET:
+        case BINARY_GETK: {
+            std::vector<binary_request_t> batch(1, request);
+            while (is_binary_quiet(batch.back().opcode) && batch.size() < MAX_BINARY_GET_BATCH) {
+                if (!read_binary_request(rh, &next_request)) {
+                    closing = true;
+                    break;
+                }
+                if (!is_binary_get(next_request.opcode)) {
+                    have_next_request = true;
+                    break;
+                }
+                batch.push_back(next_request);
+            }
+            coro_t::spawn_now_dangerously(boost::bind(&do_binary_gets, rh, pipeliner, batch, token.with_read_mode()));
+        } break;
+        case BINARY_SET:
+        case BINARY_ADD:
+        case BINARY_REPLACE:
+        case BINARY_APPEND:
+        case BINARY_PREPEND:
+        case BINARY_DELETE:
+        case BINARY_INCREMENT:
+        case BINARY_DECREMENT:
+            coro_t::spawn_now_dangerously(boost::bind(&do_binary_write, rh, pipeliner, request, token));
+            break;
+        case BINARY_NOOP:
+            write_binary_response_in_order(rh, pipeliner, request, BINARY_STATUS_OK, std::string());
+            break;
+        case BINARY_VERSION:
+            write_binary_response_in_order(rh, pipeliner, request, BINARY_STATUS_OK,
+                                           strprintf("rethinkdb-%s", RETHINKDB_VERSION));
+            break;
+        case BINARY_QUIT:
+            if (request.opcode == BINARY_QUITQ) {
+                return;
+            }
+            write_binary_response_in_order(rh, pipeliner, request, BINARY_STATUS_OK, std::string());
+            closing = true;
+            break;
+        case BINARY_STAT: {
+            pipeliner_acq_t pipeliner_acq(pipeliner);
+
+            std::set<std::string> names_to_match;
+            if (!request.key.empty()) {
+                names_to_match.insert(request.key);
+            }
+            scoped_ptr_t<perfmon_result_t> stats(perfmon_get_stats());
+            std::vector<std::pair<std::string, std::string> > values;
+            format_stats(stats.get(), std::string(), names_to_match, &values);
+
+            // We block everybody before writing.  I don't think we care.
+            pipeliner_acq.done_argparsing();
+            pipeliner_acq.begin_write();
+            for (size_t i = 0; i < values.size(); ++i) {
+                write_binary_response(rh, request, BINARY_STATUS_OK, 0, std::string(), values[i].first,
+                                      values[i].second.data(), values[i].second.size());
+            }
+            // An empty response marks the end of the stats.
+            write_binary_response(rh, request, BINARY_STATUS_OK, 0, std::string(), std::string(), NULL, 0);
+            pipeliner_acq.end_write();
+        } break;
+        case BINARY_FLUSH:
+            write_binary_response_in_order(rh, pipeliner, request, BINARY_STATUS_NOT_SUPPORTED,
+                                           binary_status_message(BINARY_STATUS_NOT_SUPPORTED));
+            break;
+        default:
+            write_binary_response_in_order(rh, pipeliner, request, BINARY_STATUS_UNKNOWN_COMMAND,
+                                           binary_status_message(BINARY_STATUS_UNKNOWN_COMMAND));
+            break;
+        }
+
+        action_timer.end();
+
+        if (closing) {
+            // The caller expects the argparsing lock to be held, like it is when the
+            // loop condition fails.
+            pipeliner->lock_argparsing();
+            break;
+        }
+    }
+}
+
 /* Handle memcached, takes a txt_memcached_handler_t and handles the memcached commands that come in on it */
 void handle_memcache(memcached_interface_t *interface,
         namespace_interface_t<memcached_protocol_t> *nsi,
@@ -1118,7 +1995,18 @@ void handle_memcache(memcached_interface_t *interface,
 
     pipeliner_t pipeliner(&rh);
 
-    while (pipeliner.lock_argparsing(), !interruptor->is_pulsed()) {
+    /* Binary requests start with a magic byte that no text command does. */
+    bool binary;
+    try {
+        binary = rh.peek_byte() == BINARY_REQUEST_MAGIC;
+    } catch (const memcached_interface_t::no_more_data_exc_t &) {
+        binary = false;
+    }
+    if (binary) {
+        handle_binary_memcache(&rh, &pipeliner, &order_source);
+    }
+
+    while (!binary && (pipeliner.lock_argparsing(), !interruptor->is_pulsed())) {
         /* Read a line off the socket */
         block_pm_duration read_timer(&rh.stats->pm_conns_reading);
         try {
@@ -31,6 +31,9 @@ struct memcached_interface_t {
     };
     virtual void read(void *, size_t, signal_t *interruptor) = 0;
     virtual void read_line(std::vector<char> *, signal_t *interruptor) = 0;
+    // Returns the next byte without consuming it, so that `handle_memcache()` can
+    // tell which protocol the client speaks.
+    virtual uint8_t peek_byte(signal_t *interruptor) = 0;
 
     virtual ~memcached_interface_t() { }
 };
@@ -74,9 +74,11 @@ archive_result_t deserialize(read_stream_t *s, counted_t<data_buffer_t> *buf) {
 }
 
 RDB_IMPL_SERIALIZABLE_1(get_query_t, key);
-RDB_IMPL_SERIALIZABLE_2(rget_query_t, region, maximum);
+RDB_IMPL_SERIALIZABLE_1(get_multi_query_t, keys);
+RDB_IMPL_SERIALIZABLE_3(rget_query_t, region, maximum, chunk_size);
 RDB_IMPL_SERIALIZABLE_3(distribution_get_query_t, max_depth, result_limit, region);
 RDB_IMPL_SERIALIZABLE_3(get_result_t, value, flags, cas);
+RDB_IMPL_SERIALIZABLE_1(get_multi_result_t, values);
 RDB_IMPL_SERIALIZABLE_3(key_with_data_buffer_t, key, mcflags, value_provider);
 RDB_IMPL_SERIALIZABLE_2(rget_result_t, pairs, truncated);
 RDB_IMPL_SERIALIZABLE_2(distribution_result_t, region, key_counts);
@@ -120,6 +122,21 @@ struct read_get_region_visitor_t : public boost::static_visitor<region_t> {
     region_t operator()(distribution_get_query_t dst_get) {
         return dst_get.region;
     }
+    region_t operator()(const get_multi_query_t &get_multi) {
+        // The smallest rectangle that holds all of the keys
+        guarantee(!get_multi.keys.empty());
+        uint64_t beg = UINT64_MAX;
+        uint64_t end = 0;
+        for (size_t i = 0; i < get_multi.keys.size(); ++i) {
+            const store_key_t &key = get_multi.keys[i];
+            uint64_t h = hash_region_hasher(key.contents(), key.size());
+            beg = std::min(beg, h);
+            end = std::max(end, h + 1);
+        }
+        return region_t(beg, end,
+                        key_range_t(key_range_t::closed, get_multi.keys.front(),
+                                    key_range_t::closed, get_multi.keys.back()));
+    }
 };
 
 }   /* anonymous namespace */
@@ -168,6 +185,21 @@ struct read_shard_visitor_t : public boost::static_visitor<bool> {
         return rangey_query(distribution_get);
     }
 
+    bool operator()(const get_multi_query_t &get_multi) const {
+        get_multi_query_t tmp;
+        for (size_t i = 0; i < get_multi.keys.size(); ++i) {
+            if (region_contains_key(*region, get_multi.keys[i])) {
+                tmp.keys.push_back(get_multi.keys[i]);
+            }
+        }
+        if (!tmp.keys.empty()) {
+            *read_out = read_t(tmp, effective_time);
+            return true;
+        } else {
+            return false;
+        }
+    }
+
 private:
     const exptime_t effective_time;
     const region_t *region;
@@ -234,6 +266,15 @@ struct read_unshard_visitor_t : public boost::static_visitor<read_response_t> {
         guarantee(count == 1);
         return read_response_t(boost::get<get_result_t>(bits[0].result));
     }
+    read_response_t operator()(UNUSED const get_multi_query_t &get_multi) {
+        get_multi_result_t result;
+        for (size_t i = 0; i < count; ++i) {
+            const get_multi_result_t *bit = boost::get<get_multi_result_t>(&bits[i].result);
+            guarantee(bit, "Bad boost::get\n");
+            result.values.insert(bit->values.begin(), bit->values.end());
+        }
+        return read_response_t(result);
+    }
     read_response_t operator()(rget_query_t rget) {
         // TODO: do this without dynamic memory?
         std::vector<key_with_data_buffer_t> pairs;
@@ -247,7 +288,7 @@ struct read_unshard_visitor_t : public boost::static_visitor<read_response_t> {
         size_t cumulative_size = 0;
         int ix = 0;
         for (int e = std::min<int>(rget.maximum, pairs.size());
-             ix < e && cumulative_size < rget_max_chunk_size;
+             ix < e && cumulative_size < rget.chunk_size;
              ++ix) {
             cumulative_size += estimate_rget_result_pair_size(pairs[ix]);
         }
@@ -255,7 +296,7 @@ struct read_unshard_visitor_t : public boost::static_visitor<read_response_t> {
         rget_result_t result;
         pairs.resize(ix);
         result.pairs.swap(pairs);
-        result.truncated = (cumulative_size >= rget_max_chunk_size);
+        result.truncated = (cumulative_size >= rget.chunk_size);
 
         return read_response_t(result);
     }
@@ -411,6 +452,11 @@ region_t memcached_protocol_t::cpu_sharding_subspace(int subregion_number, int n
     return region_t(beg, end, key_range_t::universe());
 }
 
+region_t memcached_protocol_t::backfill_subspace(int piece_number, int num_pieces) {
+    return region_t(0, HASH_REGION_HASH_SIZE,
+                    printable_key_subrange("", piece_number, num_pieces));
+}
+
 store_t::store_t(serializer_t *serializer,
                  const std::string &perfmon_name,
                  int64_t cache_size,
@@ -437,9 +483,14 @@ struct read_visitor_t : public boost::static_visitor<read_response_t> {
             memcached_get(get.key, btree, effective_time, superblock));
     }
 
+    read_response_t operator()(const get_multi_query_t& get_multi) {
+        return read_response_t(
+            memcached_get_multi(get_multi.keys, btree, effective_time, superblock));
+    }
+
     read_response_t operator()(const rget_query_t& rget) {
         return read_response_t(
-            memcached_rget_slice(rget.region.inner, rget.maximum,
+            memcached_rget_slice(rget.region.inner, rget.maximum, rget.chunk_size,
                                  effective_time, superblock));
     }
 
@@ -50,15 +50,35 @@ struct get_result_t {
     cas_t cas;
 };
 
+/* `get` of many keys at once, which is routed as one read per shard */
+
+struct get_multi_query_t {
+    // Sorted, without duplicates.
+    std::vector<store_key_t> keys;
+    get_multi_query_t() { }
+    explicit get_multi_query_t(const std::vector<store_key_t> &_keys) : keys(_keys) { }
+};
+
+struct get_multi_result_t {
+    // The keys that weren't found are left out.
+    std::map<store_key_t, get_result_t> values;
+};
+
 /* `rget` */
 
+static const size_t rget_max_chunk_size = MEGABYTE;
+
 struct rget_query_t {
     hash_region_t<key_range_t> region;
     int maximum;
+    // The scan stops (and the result is marked truncated) once it has read about
+    // this many bytes.
+    size_t chunk_size;
 
     rget_query_t() { }
-    rget_query_t(const hash_region_t<key_range_t> &_region, int _maximum)
-        : region(_region), maximum(_maximum) { }
+    rget_query_t(const hash_region_t<key_range_t> &_region, int _maximum,
+                 size_t _chunk_size = rget_max_chunk_size)
+        : region(_region), maximum(_maximum), chunk_size(_chunk_size) { }
 };
 
 struct key_with_data_buffer_t {
@@ -10,6 +10,7 @@ struct memcached_stats_t {
           pm_cmd_set(secs_to_ticks(1.0)),
           pm_cmd_get(secs_to_ticks(1.0)),
           pm_cmd_rget(secs_to_ticks(1.0)),
+          pm_cmd_incr_combined(secs_to_ticks(1.0)),
           pm_delete_key_size(),
           pm_get_key_size(),
           pm_storage_key_size(),
@@ -23,6 +24,7 @@ struct memcached_stats_t {
               &pm_cmd_set, "cmd_set",
               &pm_cmd_get, "cmd_get",
               &pm_cmd_rget, "cmd_rget",
+              &pm_cmd_incr_combined, "cmd_incr_combined",
               &pm_delete_key_size, "cmd_delete_key_size",
               &pm_get_key_size, "cmd_get_key_size",
               &pm_storage_key_size, "cmd_set_key_size",
@@ -40,6 +42,9 @@ struct memcached_stats_t {
         pm_cmd_get,
         pm_cmd_rget;
 
+    // Increments that went out as part of another increment's write.
+    perfmon_rate_monitor_t pm_cmd_incr_combined;
+
     perfmon_stddev_t
         pm_delete_key_size,
         pm_get_key_size,
@@ -53,11 +53,24 @@ struct tcp_conn_memcached_interface_t : public memcached_interface_t, public hom
         }
     }
 
+    uint8_t peek_byte(signal_t *interruptor) {
+        try {
+            return conn->peek(1, interruptor).beg[0];
+        } catch (const tcp_conn_read_closed_exc_t &) {
+            throw no_more_data_exc_t();
+        }
+    }
+
     void read_line(std::vector<char> *dest, signal_t *interruptor) {
         try {
+            // How much of the buffer we already know not to contain a CRLF (except
+            // for maybe a trailing '\r').
+            size_t scanned = 0;
             for (;;) {
                 const_charslice sl = conn->peek();
-                void *crlf_loc = memmem(sl.beg, sl.end - sl.beg, "\r\n", 2);
+                const size_t scan_from = scanned > 0 ? scanned - 1 : 0;
+                void *crlf_loc = memmem(sl.beg + scan_from, sl.end - sl.beg - scan_from,
+                                        "\r\n", 2);
                 ssize_t threshold = MEGABYTE;
 
                 if (crlf_loc) {
@@ -81,6 +94,7 @@ struct tcp_conn_memcached_interface_t : public memcached_interface_t, public hom
                 }
 
                 // Keep trying until we get a complete line.
+                scanned = sl.end - sl.beg;
                 conn->read_more_buffered(interruptor);
             }
 
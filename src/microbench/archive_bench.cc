@@ -0,0 +1,96 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string>
+#include <vector>
+
+#include "containers/archive/archive.hpp"
+#include "containers/archive/stl_types.hpp"
+#include "containers/archive/varint.hpp"
+#include "containers/archive/vector_stream.hpp"
+#include "microbench/microbench.hpp"
+#include "utils.hpp"
+
+namespace microbench {
+
+// Mostly one-byte values with some longer ones, like the lengths and counts
+// that datum serialization writes.
+static std::vector<uint64_t> make_varint_values() {
+    std::vector<uint64_t> values;
+    for (uint64_t i = 0; i < 1024; ++i) {
+        values.push_back(i % 8 == 0 ? i * 1000003 : i % 100);
+    }
+    return values;
+}
+
+static std::vector<char> serialize_varints(const std::vector<uint64_t> &values) {
+    write_message_t wm;
+    for (uint64_t value : values) {
+        serialize_varint_uint64(&wm, value);
+    }
+    vector_stream_t stream;
+    int res = send_write_message(&stream, &wm);
+    guarantee(res == 0);
+    std::vector<char> serialized;
+    stream.swap(&serialized);
+    return serialized;
+}
+
+// Each iteration codes the 1024 values.
+MICROBENCH(VarintSerialize1024) {
+    std::vector<uint64_t> values = make_varint_values();
+    while (state->keep_running()) {
+        write_message_t wm;
+        for (uint64_t value : values) {
+            serialize_varint_uint64(&wm, value);
+        }
+        do_not_optimize(wm);
+    }
+}
+
+MICROBENCH(VarintDeserialize1024) {
+    std::vector<uint64_t> values = make_varint_values();
+    std::vector<char> serialized = serialize_varints(values);
+    std::vector<char> spare = serialized;
+    vector_read_stream_t stream(std::move(serialized));
+    while (state->keep_running()) {
+        for (size_t i = 0; i < values.size(); ++i) {
+            uint64_t value;
+            archive_result_t res = deserialize_varint_uint64(&stream, &value);
+            guarantee_deserialization(res, "benchmark varint");
+            do_not_optimize(value);
+        }
+        int64_t pos = 0;
+        stream.swap(&spare, &pos);
+    }
+}
+
+MICROBENCH(VarintDecodeMany1024) {
+    std::vector<uint64_t> values = make_varint_values();
+    std::vector<char> serialized = serialize_varints(values);
+    std::vector<uint64_t> decoded(values.size());
+    while (state->keep_running()) {
+        const char *p = serialized.data();
+        archive_result_t res = decode_varint_uint64s(&p, p + serialized.size(),
+                                                     decoded.size(), decoded.data());
+        guarantee_deserialization(res, "benchmark varints");
+        do_not_optimize(decoded);
+    }
+}
+
+// Builds a message out of the kind of small pieces a btree key/value write
+// serializes.
+MICROBENCH(WriteMessageBuild) {
+    const std::string key = "an average sized primary key";
+    const std::string value(200, 'v');
+    while (state->keep_running()) {
+        write_message_t wm;
+        for (int i = 0; i < 16; ++i) {
+            wm << static_cast<int32_t>(i);
+            wm << key;
+            wm << static_cast<uint64_t>(i);
+            wm << value;
+        }
+        do_not_optimize(wm);
+    }
+}
+
+}  // namespace microbench
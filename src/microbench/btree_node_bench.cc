@@ -0,0 +1,127 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string>
+#include <vector>
+
+#include "btree/internal_node.hpp"
+#include "btree/leaf_node.hpp"
+#include "btree/node.hpp"
+#include "containers/scoped.hpp"
+#include "microbench/microbench.hpp"
+#include "repli_timestamp.hpp"
+#include "utils.hpp"
+
+namespace microbench {
+
+// Every value is the same eight bytes, so that the benchmarks measure the leaf
+// node code and not the value sizer.
+class fixed_value_sizer_t : public value_sizer_t<void> {
+public:
+    explicit fixed_value_sizer_t(block_size_t bs) : block_size_(bs) { }
+
+    int size(const void *) const { return value_size; }
+    bool fits(const void *, int length_available) const {
+        return length_available >= value_size;
+    }
+    int max_possible_size() const { return value_size; }
+    block_magic_t btree_leaf_magic() const {
+        block_magic_t magic = { { 'b', 'n', 'L', 'F' } };
+        return magic;
+    }
+    block_size_t block_size() const { return block_size_; }
+
+    static const int value_size = 8;
+
+private:
+    block_size_t block_size_;
+
+    DISABLE_COPYING(fixed_value_sizer_t);
+};
+
+static std::vector<store_key_t> make_keys(size_t count) {
+    std::vector<store_key_t> keys;
+    for (size_t i = 0; i < count; ++i) {
+        keys.push_back(store_key_t(strprintf("key%08zu", i * 2)));
+    }
+    return keys;
+}
+
+// A leaf node filled with keys, and the keys it holds.
+class full_leaf_t {
+public:
+    full_leaf_t()
+        : bs(block_size_t::unsafe_make(4096)), sizer(bs), node(bs.value()), tstamp(1) {
+        leaf::init(&sizer, node.get());
+        char value[fixed_value_sizer_t::value_size] = { 0 };
+        for (const store_key_t &key : make_keys(1000)) {
+            if (leaf::is_full(&sizer, node.get(), key.btree_key(), value)) {
+                break;
+            }
+            leaf::insert(&sizer, node.get(), key.btree_key(), value, next_tstamp(),
+                         key_modification_proof_t::real_proof());
+            keys.push_back(key);
+        }
+    }
+
+    repli_timestamp_t next_tstamp() {
+        repli_timestamp_t t;
+        t.longtime = tstamp++;
+        return t;
+    }
+
+    block_size_t bs;
+    fixed_value_sizer_t sizer;
+    scoped_malloc_t<leaf_node_t> node;
+    std::vector<store_key_t> keys;
+    uint64_t tstamp;
+};
+
+MICROBENCH(LeafFindKey) {
+    full_leaf_t leaf;
+    size_t i = 0;
+    while (state->keep_running()) {
+        int index;
+        bool found = leaf::find_key(leaf.node.get(), leaf.keys[i].btree_key(), &index);
+        do_not_optimize(found);
+        i = (i + 1) % leaf.keys.size();
+    }
+}
+
+// Removes a key from a full node and inserts it back, so the node is the same
+// size for every iteration.
+MICROBENCH(LeafRemoveInsert) {
+    full_leaf_t leaf;
+    char value[fixed_value_sizer_t::value_size] = { 0 };
+    size_t i = 0;
+    while (state->keep_running()) {
+        const btree_key_t *key = leaf.keys[i].btree_key();
+        leaf::remove(&leaf.sizer, leaf.node.get(), key, leaf.next_tstamp(),
+                     key_modification_proof_t::real_proof());
+        leaf::insert(&leaf.sizer, leaf.node.get(), key, value, leaf.next_tstamp(),
+                     key_modification_proof_t::real_proof());
+        i = (i + 1) % leaf.keys.size();
+    }
+}
+
+MICROBENCH(InternalNodeLookup) {
+    block_size_t bs = block_size_t::unsafe_make(4096);
+    scoped_malloc_t<internal_node_t> node(bs.value());
+    internal_node::init(bs, node.get());
+    std::vector<store_key_t> keys;
+    block_id_t block_id = 0;
+    for (const store_key_t &key : make_keys(1000)) {
+        if (!internal_node::insert(bs, node.get(), key.btree_key(), block_id, block_id + 1)) {
+            break;
+        }
+        ++block_id;
+        keys.push_back(key);
+    }
+
+    size_t i = 0;
+    while (state->keep_running()) {
+        block_id_t child = internal_node::lookup(node.get(), keys[i].btree_key());
+        do_not_optimize(child);
+        i = (i + 1) % keys.size();
+    }
+}
+
+}  // namespace microbench
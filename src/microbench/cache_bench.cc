@@ -0,0 +1,528 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "microbench/cache_bench.hpp"
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "arch/io/disk.hpp"
+#include "arch/runtime/runtime.hpp"
+#include "arch/runtime/starter.hpp"
+#include "buffer_cache/alt/alt.hpp"
+#include "buffer_cache/alt/block_trace.hpp"
+#include "config/args.hpp"
+#include "containers/scoped.hpp"
+#include "concurrency/pmap.hpp"
+#include "microbench/microbench.hpp"
+#include "perfmon/perfmon.hpp"
+#include "serializer/log/log_serializer.hpp"
+#include "threading.hpp"
+#include "time.hpp"
+#include "utils.hpp"
+
+namespace microbench {
+
+enum class workload_t {
+    // 90% reads and 10% writes of uniformly chosen blocks.
+    uniform,
+    // The same mix, with blocks chosen from a zipfian distribution.
+    zipfian,
+    // 95% uniform point reads, and 5% reads of runs of consecutive blocks.
+    scan_mix,
+    // 20% reads and 80% writes of uniformly chosen blocks.
+    write_heavy,
+    // The accesses in a trace file.
+    trace
+};
+
+struct cache_bench_config_t {
+    cache_bench_config_t()
+        : workload(workload_t::uniform), directory("."), num_blocks(100000),
+          num_ops(200000), concurrency(16), cache_size(64 * MEGABYTE),
+          scan_length(100), zipfian_theta(0.99), direct_io(true),
+          trace_cache_id(-1) { }
+
+    workload_t workload;
+    std::string directory;
+    std::string trace_file;
+    int64_t num_blocks;
+    int64_t num_ops;
+    int concurrency;
+    uint64_t cache_size;
+    int64_t scan_length;
+    double zipfian_theta;
+    bool direct_io;
+    // For binary traces, the cache whose accesses to replay, or -1 for all of them.
+    int64_t trace_cache_id;
+};
+
+// One operation: a write of `block_id`, or a read of the `length` blocks starting
+// at `block_id` in one transaction.
+struct block_access_t {
+    block_id_t block_id;
+    int64_t length;
+    bool write;
+};
+
+// Picks ranks in [0, n) with probability proportional to 1 / (rank + 1)^theta, the
+// way YCSB does (Gray et al, "Quickly Generating Billion-Record Synthetic
+// Databases").
+class zipfian_generator_t {
+public:
+    zipfian_generator_t(int64_t n, double theta)
+        : n_(n), theta_(theta), alpha_(1.0 / (1.0 - theta)), zetan_(zeta(n, theta)),
+          eta_((1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta(2, theta) / zetan_)) { }
+
+    int64_t next(rng_t *rng) const {
+        const double u = rng->randdouble();
+        const double uz = u * zetan_;
+        if (uz < 1.0) {
+            return 0;
+        } else if (uz < 1.0 + pow(0.5, theta_)) {
+            return 1;
+        }
+        const int64_t rank = n_ * pow(eta_ * u - eta_ + 1.0, alpha_);
+        return std::min(rank, n_ - 1);
+    }
+
+private:
+    static double zeta(int64_t n, double theta) {
+        double sum = 0;
+        for (int64_t i = 1; i <= n; ++i) {
+            sum += 1.0 / pow(i, theta);
+        }
+        return sum;
+    }
+
+    const int64_t n_;
+    const double theta_;
+    const double alpha_;
+    const double zetan_;
+    const double eta_;
+};
+
+static bool parse_workload(const std::string &name, workload_t *out) {
+    if (name == "uniform") {
+        *out = workload_t::uniform;
+    } else if (name == "zipfian") {
+        *out = workload_t::zipfian;
+    } else if (name == "scan-mix") {
+        *out = workload_t::scan_mix;
+    } else if (name == "write-heavy") {
+        *out = workload_t::write_heavy;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static std::vector<block_access_t> generate_accesses(const cache_bench_config_t &config) {
+    rng_t rng(1);
+    scoped_ptr_t<zipfian_generator_t> zipfian;
+    if (config.workload == workload_t::zipfian) {
+        zipfian.init(new zipfian_generator_t(config.num_blocks, config.zipfian_theta));
+    }
+    std::vector<block_access_t> accesses;
+    accesses.reserve(config.num_ops);
+    for (int64_t i = 0; i < config.num_ops; ++i) {
+        block_access_t access;
+        access.block_id = rng.randint(config.num_blocks);
+        access.length = 1;
+        const int percent = rng.randint(100);
+        switch (config.workload) {
+        case workload_t::uniform:
+            access.write = percent < 10;
+            break;
+        case workload_t::zipfian:
+            // Spread the hot ranks over the file instead of packing them into its
+            // first extents.
+            access.block_id = (zipfian->next(&rng) * 1000003) % config.num_blocks;
+            access.write = percent < 10;
+            break;
+        case workload_t::scan_mix:
+            access.write = false;
+            if (percent < 5) {
+                access.length = std::min<int64_t>(config.scan_length,
+                                                  config.num_blocks - access.block_id);
+            }
+            break;
+        case workload_t::write_heavy:
+            access.write = percent < 80;
+            break;
+        case workload_t::trace:
+        default:
+            unreachable();
+        }
+        accesses.push_back(access);
+    }
+    return accesses;
+}
+
+// Reads a dump from `block_tracer_t` (see block_trace.hpp), after its magic bytes.
+// The blocks of different caches are given block ids of their own, numbered in
+// order of first access, unless `cache_id` picks out one cache.
+static bool read_binary_trace(FILE *f, const std::string &path, int64_t cache_id,
+                              std::vector<block_access_t> *out,
+                              int64_t *max_block_id_out) {
+    uint32_t header[2];
+    if (fread(header, sizeof(header), 1, f) != 1
+        || header[0] != sizeof(block_trace_record_t)) {
+        fprintf(stderr, "%s: not a block trace from this version.\n", path.c_str());
+        return false;
+    }
+    std::map<std::pair<uint32_t, uint64_t>, block_id_t> block_ids;
+    int64_t misses = 0;
+    int64_t total = 0;
+    block_trace_record_t record;
+    while (fread(&record, sizeof(record), 1, f) == 1) {
+        if (cache_id != -1 && record.cache_id != cache_id) {
+            continue;
+        }
+        auto res = block_ids.insert(std::make_pair(
+            std::make_pair(record.cache_id, record.block_id),
+            static_cast<block_id_t>(block_ids.size())));
+        block_access_t access;
+        access.block_id = res.first->second;
+        access.length = 1;
+        access.write = (record.flags & BLOCK_TRACE_WRITE) != 0;
+        out->push_back(access);
+        ++total;
+        if ((record.flags & BLOCK_TRACE_MISS) != 0) {
+            ++misses;
+        }
+    }
+    *max_block_id_out = static_cast<int64_t>(block_ids.size()) - 1;
+    if (total > 0) {
+        printf("Trace: %" PRIi64 " accesses to %zu blocks, recorded hit ratio %.4f\n",
+               total, block_ids.size(),
+               static_cast<double>(total - misses) / total);
+    }
+    return true;
+}
+
+// Reads a trace: either a dump from `block_tracer_t`, or text with one access per
+// line: "r BLOCK_ID" or "w BLOCK_ID", or "r BLOCK_ID LENGTH" for a read of
+// consecutive blocks.  Blank lines and lines starting with '#' are skipped.
+static bool read_trace(const std::string &path, int64_t cache_id,
+                       std::vector<block_access_t> *out, int64_t *max_block_id_out) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == NULL) {
+        fprintf(stderr, "Could not open trace file %s.\n", path.c_str());
+        return false;
+    }
+    char magic[sizeof(BLOCK_TRACE_MAGIC) - 1];
+    if (fread(magic, sizeof(magic), 1, f) == 1
+        && memcmp(magic, BLOCK_TRACE_MAGIC, sizeof(magic)) == 0) {
+        const bool ok = read_binary_trace(f, path, cache_id, out, max_block_id_out);
+        fclose(f);
+        return ok;
+    }
+    rewind(f);
+
+    *max_block_id_out = -1;
+    char line[256];
+    int line_number = 0;
+    bool ok = true;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        ++line_number;
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        char op;
+        uint64_t block_id;
+        int64_t length = 1;
+        const int fields = sscanf(line, " %c %" SCNu64 " %" SCNd64,
+                                  &op, &block_id, &length);
+        if (fields < 2 || (op != 'r' && op != 'w') || length < 1
+            || (op == 'w' && length != 1)) {
+            fprintf(stderr, "%s:%d: expected \"r BLOCK_ID [LENGTH]\" or "
+                    "\"w BLOCK_ID\".\n", path.c_str(), line_number);
+            ok = false;
+            break;
+        }
+        block_access_t access;
+        access.block_id = block_id;
+        access.length = length;
+        access.write = op == 'w';
+        out->push_back(access);
+        *max_block_id_out = std::max<int64_t>(*max_block_id_out, block_id + length - 1);
+    }
+    fclose(f);
+    return ok;
+}
+
+static void run_access(cache_conn_t *cache_conn, const block_access_t &access) {
+    if (access.write) {
+        txn_t txn(cache_conn, write_durability_t::SOFT,
+                  repli_timestamp_t::distant_past, 1);
+        buf_lock_t lock(buf_parent_t(&txn), access.block_id, access_t::write);
+        buf_write_t write(&lock);
+        char *data = static_cast<char *>(write.get_data_write());
+        ++data[0];
+    } else {
+        txn_t txn(cache_conn, read_access_t::read);
+        for (int64_t i = 0; i < access.length; ++i) {
+            buf_lock_t lock(buf_parent_t(&txn), access.block_id + i, access_t::read);
+            buf_read_t read(&lock);
+            // This waits for the block to be loaded, if it isn't in memory.
+            read.get_data_read();
+        }
+    }
+}
+
+// Writes every block once, so that the workload only touches blocks that exist.
+static void populate(cache_conn_t *cache_conn, int64_t num_blocks) {
+    const int64_t batch_size = 1000;
+    for (int64_t begin = 0; begin < num_blocks; begin += batch_size) {
+        const int64_t end = std::min(begin + batch_size, num_blocks);
+        // The last batch waits until everything is on disk.
+        txn_t txn(cache_conn,
+                  end == num_blocks ? write_durability_t::HARD : write_durability_t::SOFT,
+                  repli_timestamp_t::distant_past, end - begin);
+        for (int64_t id = begin; id < end; ++id) {
+            buf_lock_t lock(&txn, id, alt_create_t::create);
+            buf_write_t write(&lock);
+            memset(write.get_data_write(), 0, txn.cache()->get_block_size().value());
+        }
+    }
+}
+
+static scoped_ptr_t<perfmon_result_t> collect_stats(perfmon_collection_t *stats) {
+    void *data = stats->begin_stats();
+    pmap(get_num_threads(), [stats, data](int thread) {
+        on_thread_t thread_switcher((threadnum_t(thread)));
+        stats->visit_stats(data);
+    });
+    return stats->end_stats(data);
+}
+
+// Returns the value of the stat `name` in the sub-collection `collection`, or 0 if
+// there is no such stat.
+static double get_stat(const perfmon_result_t *stats,
+                       const char *collection, const char *name) {
+    auto sub = stats->get_map()->find(collection);
+    if (sub == stats->get_map()->end() || !sub->second->is_map()) {
+        return 0;
+    }
+    const perfmon_result_t *sub_stats = sub->second;
+    auto stat = sub_stats->get_map()->find(name);
+    if (stat == sub_stats->get_map()->end() || !stat->second->is_string()) {
+        return 0;
+    }
+    const perfmon_result_t *value = stat->second;
+    return strtod(value->get_string()->c_str(), NULL);
+}
+
+// Prints how many operations took under 1us, 2us, 4us, and so on.
+static void print_histogram(const std::vector<ticks_t> &latencies) {
+    std::vector<int64_t> buckets;
+    for (ticks_t latency : latencies) {
+        size_t bucket = 0;
+        while ((static_cast<ticks_t>(1000) << bucket) <= latency) {
+            ++bucket;
+        }
+        if (buckets.size() <= bucket) {
+            buckets.resize(bucket + 1, 0);
+        }
+        ++buckets[bucket];
+    }
+    printf("Latency histogram:\n");
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        if (buckets[i] != 0) {
+            printf("  < %8" PRIu64 "us %10" PRId64 " %6.2f%%\n", uint64_t(1) << i,
+                   buckets[i], 100.0 * buckets[i] / latencies.size());
+        }
+    }
+}
+
+static void run_workload(const cache_bench_config_t &config,
+                         const std::vector<block_access_t> &accesses,
+                         int64_t num_blocks) {
+    const base_path_t base_path(config.directory);
+    recreate_temporary_directory(base_path);
+    io_backender_t io_backender(config.direct_io
+                                ? file_direct_io_mode_t::direct_desired
+                                : file_direct_io_mode_t::buffered_desired);
+    filepath_file_opener_t file_opener(serializer_filepath_t(base_path, "cache_bench.data"),
+                                       &io_backender);
+    const log_serializer_t::static_config_t static_config;
+    log_serializer_t::create(&file_opener, static_config);
+
+    perfmon_collection_t stats;
+    scoped_ptr_t<log_serializer_t> serializer(
+        new log_serializer_t(log_serializer_t::dynamic_config_t(), &file_opener, &stats));
+    alt_cache_config_t cache_config;
+    cache_config.page_config.memory_limit = config.cache_size;
+    scoped_ptr_t<cache_t> cache(new cache_t(serializer.get(), cache_config, &stats));
+
+    printf("Writing %" PRId64 " blocks...\n", num_blocks);
+    {
+        cache_conn_t cache_conn(cache.get());
+        populate(&cache_conn, num_blocks);
+    }
+    scoped_ptr_t<perfmon_result_t> before = collect_stats(&stats);
+
+    printf("Running %zu operations with %d at a time...\n",
+           accesses.size(), config.concurrency);
+    std::vector<ticks_t> read_latencies, write_latencies;
+    int64_t writes = 0;
+    size_t next_access = 0;
+    const ticks_t start = get_ticks();
+    pmap(config.concurrency, [&](int) {
+        cache_conn_t cache_conn(cache.get());
+        // Everything runs on this thread, so the workers can share these without
+        // locking.
+        while (next_access < accesses.size()) {
+            const block_access_t &access = accesses[next_access++];
+            const ticks_t op_start = get_ticks();
+            run_access(&cache_conn, access);
+            const ticks_t latency = get_ticks() - op_start;
+            if (access.write) {
+                write_latencies.push_back(latency);
+                ++writes;
+            } else {
+                read_latencies.push_back(latency);
+            }
+        }
+    });
+    const double secs = ticks_to_secs(get_ticks() - start);
+    scoped_ptr_t<perfmon_result_t> after_run = collect_stats(&stats);
+
+    // Destroying the cache flushes the rest of the writes, so that the serializer
+    // stats count all of them.
+    cache.reset();
+    scoped_ptr_t<perfmon_result_t> after_flush = collect_stats(&stats);
+    serializer.reset();
+    file_opener.unlink_serializer_file();
+
+    std::vector<ticks_t> all_latencies(read_latencies);
+    all_latencies.insert(all_latencies.end(), write_latencies.begin(), write_latencies.end());
+    printf("\nThroughput: %.0f operations/s (%.2fs)\n", accesses.size() / secs, secs);
+    print_latencies("reads", &read_latencies);
+    print_latencies("writes", &write_latencies);
+    print_histogram(all_latencies);
+
+    auto delta = [&](const scoped_ptr_t<perfmon_result_t> &after, const char *collection,
+                     const char *name) {
+        return get_stat(after.get(), collection, name)
+            - get_stat(before.get(), collection, name);
+    };
+    const double hits = delta(after_run, "cache", "page_hits");
+    const double misses = delta(after_run, "cache", "page_misses");
+    printf("\nCache hit ratio: %.4f (%.0f hits, %.0f misses)\n",
+           hits + misses == 0 ? 0 : hits / (hits + misses), hits, misses);
+
+    const double block_writes = delta(after_flush, "serializer", "serializer_block_writes");
+    const double extents_written
+        = delta(after_flush, "serializer", "serializer_data_extents_allocated");
+    printf("Block writes: %.0f for %" PRId64 " writes\n", block_writes, writes);
+    if (writes > 0) {
+        // The cache can merge several writes of a block into one block write, and
+        // the GC moves live blocks into new extents, so the bytes that reach disk
+        // differ from the bytes written through the cache.
+        printf("Write amplification: %.2f (data extent bytes / bytes written)\n",
+               extents_written * static_config.extent_size()
+               / (static_cast<double>(writes) * static_config.block_size().value()));
+    }
+    printf("GC: %.0f data extents collected, %.0f LBA GCs, %.0f extents in use after\n",
+           delta(after_flush, "serializer", "serializer_data_extents_gced"),
+           delta(after_flush, "serializer", "serializer_lba_gcs"),
+           get_stat(after_flush.get(), "serializer", "serializer_extents_in_use"));
+}
+
+static void usage() {
+    fprintf(stderr,
+            "Usage: rethinkdb-bench cache [OPTIONS]\n"
+            "  --workload=uniform|zipfian|scan-mix|write-heavy  (default uniform)\n"
+            "  --trace=FILE          replay the accesses in FILE instead; each line is\n"
+            "                        \"r BLOCK_ID [LENGTH]\" or \"w BLOCK_ID\", or FILE\n"
+            "                        is a dump from /ajax/block_trace\n"
+            "  --trace-cache=N       replay only cache N's accesses from a dump\n"
+            "  --blocks=N            blocks in the file (default 100000)\n"
+            "  --ops=N               operations to run (default 200000)\n"
+            "  --concurrency=N       operations at once (default 16; use 1 to replay\n"
+            "                        a trace in order)\n"
+            "  --cache-size-mb=N     cache memory limit (default 64)\n"
+            "  --scan-length=N       blocks per scan-mix scan (default 100)\n"
+            "  --zipfian-theta=X     zipfian skew (default 0.99)\n"
+            "  --directory=DIR       where to put the data file (default .)\n"
+            "  --buffered-io         don't use O_DIRECT\n");
+}
+
+static bool parse_flag(const char *arg, const char *name, const char **value_out) {
+    const size_t length = strlen(name);
+    if (strncmp(arg, name, length) == 0 && arg[length] == '=') {
+        *value_out = arg + length + 1;
+        return true;
+    }
+    return false;
+}
+
+int run_cache_bench(int argc, char **argv) {
+    cache_bench_config_t config;
+    for (int i = 1; i < argc; ++i) {
+        const char *value;
+        if (parse_flag(argv[i], "--workload", &value)) {
+            if (!parse_workload(value, &config.workload)) {
+                usage();
+                return EXIT_FAILURE;
+            }
+        } else if (parse_flag(argv[i], "--trace", &value)) {
+            config.workload = workload_t::trace;
+            config.trace_file = value;
+        } else if (parse_flag(argv[i], "--trace-cache", &value)) {
+            config.trace_cache_id = atoll(value);
+        } else if (parse_flag(argv[i], "--blocks", &value)) {
+            config.num_blocks = atoll(value);
+        } else if (parse_flag(argv[i], "--ops", &value)) {
+            config.num_ops = atoll(value);
+        } else if (parse_flag(argv[i], "--concurrency", &value)) {
+            config.concurrency = atoi(value);
+        } else if (parse_flag(argv[i], "--cache-size-mb", &value)) {
+            config.cache_size = atoll(value) * MEGABYTE;
+        } else if (parse_flag(argv[i], "--scan-length", &value)) {
+            config.scan_length = atoll(value);
+        } else if (parse_flag(argv[i], "--zipfian-theta", &value)) {
+            config.zipfian_theta = atof(value);
+        } else if (parse_flag(argv[i], "--directory", &value)) {
+            config.directory = value;
+        } else if (strcmp(argv[i], "--buffered-io") == 0) {
+            config.direct_io = false;
+        } else {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (config.num_blocks < 1 || config.num_ops < 0 || config.concurrency < 1
+        || config.scan_length < 1 || config.zipfian_theta <= 0
+        || config.zipfian_theta >= 1) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    std::vector<block_access_t> accesses;
+    int64_t num_blocks = config.num_blocks;
+    if (config.workload == workload_t::trace) {
+        int64_t max_block_id;
+        if (!read_trace(config.trace_file, config.trace_cache_id, &accesses,
+                        &max_block_id)) {
+            return EXIT_FAILURE;
+        }
+        num_blocks = std::max(num_blocks, max_block_id + 1);
+    } else {
+        accesses = generate_accesses(config);
+    }
+
+    run_in_thread_pool([&]() { run_workload(config, accesses, num_blocks); }, 1);
+    return EXIT_SUCCESS;
+}
+
+}  // namespace microbench
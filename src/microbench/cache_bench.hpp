@@ -0,0 +1,16 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef MICROBENCH_CACHE_BENCH_HPP_
+#define MICROBENCH_CACHE_BENCH_HPP_
+
+namespace microbench {
+
+/* `rethinkdb-bench cache [OPTIONS]` runs a block workload against a `cache_t` on a
+`log_serializer_t` in a file of its own, without the rest of the server, and reports
+throughput, latencies, write amplification, GC activity and the cache hit ratio.
+The workload is generated (uniform, zipfian, scan-mix or write-heavy) or replayed
+from a trace file.  `argv[0]` is "cache".  Returns the process's exit code. */
+int run_cache_bench(int argc, char **argv);
+
+}  // namespace microbench
+
+#endif  // MICROBENCH_CACHE_BENCH_HPP_
@@ -0,0 +1,80 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string>
+#include <vector>
+
+#include "containers/archive/vector_stream.hpp"
+#include "http/json.hpp"
+#include "microbench/microbench.hpp"
+#include "rdb_protocol/datum.hpp"
+
+namespace microbench {
+
+// A typical small row.
+static counted_t<const ql::datum_t> make_row(int id) {
+    scoped_cJSON_t json(cJSON_Parse(strprintf(
+        "{\"id\": %d, \"name\": \"user %d\", \"email\": \"user%d@example.com\","
+        " \"score\": 3.25, \"active\": true, \"tags\": [\"a\", \"b\", \"c\"],"
+        " \"address\": {\"city\": \"Springfield\", \"zip\": \"12345\"}}",
+        id, id, id).c_str()));
+    return make_counted<const ql::datum_t>(json);
+}
+
+static std::vector<char> serialize_to_vector(const counted_t<const ql::datum_t> &datum) {
+    write_message_t wm;
+    wm << datum;
+    vector_stream_t stream;
+    int res = send_write_message(&stream, &wm);
+    guarantee(res == 0);
+    std::vector<char> serialized;
+    stream.swap(&serialized);
+    return serialized;
+}
+
+MICROBENCH(DatumSerialize) {
+    counted_t<const ql::datum_t> row = make_row(1);
+    while (state->keep_running()) {
+        write_message_t wm;
+        wm << row;
+        do_not_optimize(wm);
+    }
+}
+
+MICROBENCH(DatumDeserialize) {
+    std::vector<char> serialized = serialize_to_vector(make_row(1));
+    std::vector<char> spare = serialized;
+    vector_read_stream_t stream(std::move(serialized));
+    while (state->keep_running()) {
+        counted_t<const ql::datum_t> row;
+        archive_result_t res = deserialize(&stream, &row);
+        guarantee_deserialization(res, "benchmark row");
+        do_not_optimize(row);
+        // Rewind by swapping in the other copy of the same bytes.
+        int64_t pos = 0;
+        stream.swap(&spare, &pos);
+    }
+}
+
+MICROBENCH(DatumLessThan) {
+    // The rows only differ in the last field compared, so every comparison walks
+    // the whole object.
+    counted_t<const ql::datum_t> lhs = make_row(1);
+    ql::datum_ptr_t rhs_builder(lhs->as_object());
+    rhs_builder.add("tags", make_counted<const ql::datum_t>(std::string("z")), ql::CLOBBER);
+    counted_t<const ql::datum_t> rhs = rhs_builder.to_counted();
+    while (state->keep_running()) {
+        bool less = *lhs < *rhs;
+        do_not_optimize(less);
+    }
+}
+
+MICROBENCH(MangleSecondary) {
+    const std::string secondary = make_row(1)->get("email")->print_primary();
+    const std::string primary = make_counted<const ql::datum_t>(12345.0)->print_primary();
+    const std::string tag;
+    while (state->keep_running()) {
+        std::string mangled = ql::datum_t::mangle_secondary(secondary, primary, tag);
+        do_not_optimize(mangled);
+    }
+}
+
+}  // namespace microbench
@@ -0,0 +1,46 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "microbench/cache_bench.hpp"
+#include "microbench/microbench.hpp"
+#include "microbench/rpc_bench.hpp"
+#include "utils.hpp"
+
+// Usage: rethinkdb-bench [--filter=SUBSTRING] [--min-time=SECONDS]
+//        rethinkdb-bench cache [OPTIONS]
+//        rethinkdb-bench rpc [OPTIONS]
+int main(int argc, char **argv) {
+    startup_shutdown_t startup_shutdown;
+
+    if (argc >= 2 && strcmp(argv[1], "cache") == 0) {
+        return microbench::run_cache_bench(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && strcmp(argv[1], "rpc") == 0) {
+        return microbench::run_rpc_bench(argc - 1, argv + 1);
+    }
+
+    std::string filter;
+    double min_secs = 0.5;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--filter=", strlen("--filter=")) == 0) {
+            filter = argv[i] + strlen("--filter=");
+        } else if (strncmp(argv[i], "--min-time=", strlen("--min-time=")) == 0) {
+            min_secs = atof(argv[i] + strlen("--min-time="));
+        } else {
+            fprintf(stderr, "Usage: %s [--filter=SUBSTRING] [--min-time=SECONDS]\n"
+                    "       %s cache [OPTIONS]\n"
+                    "       %s rpc [OPTIONS]\n", argv[0], argv[0], argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (microbench::run_benchmarks(filter, min_secs) == 0) {
+        fprintf(stderr, "No benchmarks match \"%s\".\n", filter.c_str());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,80 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "microbench/microbench.hpp"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace microbench {
+
+state_t::state_t(int64_t iterations)
+    : iterations_(iterations), iterations_done_(0), start_(0), elapsed_(0) { }
+
+struct benchmark_t {
+    const char *name;
+    benchmark_fn_t fn;
+};
+
+// A function-local static, so that registrations from other translation units'
+// static initializers don't run before it's constructed.
+static std::vector<benchmark_t> *benchmarks() {
+    static std::vector<benchmark_t> registered;
+    return &registered;
+}
+
+registration_t::registration_t(const char *name, benchmark_fn_t fn) {
+    benchmark_t benchmark = { name, fn };
+    benchmarks()->push_back(benchmark);
+}
+
+int run_benchmarks(const std::string &filter, double min_secs) {
+    printf("%-40s %14s %14s\n", "Benchmark", "Iterations", "ns/iteration");
+    int count = 0;
+    for (const benchmark_t &benchmark : *benchmarks()) {
+        if (std::string(benchmark.name).find(filter) == std::string::npos) {
+            continue;
+        }
+
+        // Run once to warm up, then keep growing the iteration count until a run
+        // takes long enough to time reliably.
+        int64_t iterations = 1;
+        ticks_t elapsed;
+        for (;;) {
+            state_t state(iterations);
+            benchmark.fn(&state);
+            elapsed = state.elapsed();
+            if (ticks_to_secs(elapsed) >= min_secs || iterations >= (int64_t(1) << 40)) {
+                break;
+            }
+            // Aim for 1.5 times the minimum, but grow by at most 100x at once.
+            double wanted = elapsed == 0
+                ? iterations * 100.0
+                : iterations * min_secs * 1.5 / ticks_to_secs(elapsed);
+            iterations = std::max<int64_t>(iterations + 1,
+                                           std::min<double>(wanted, iterations * 100.0));
+        }
+        printf("%-40s %14" PRIi64 " %14.1f\n", benchmark.name, iterations,
+               static_cast<double>(elapsed) / iterations);
+        ++count;
+    }
+    return count;
+}
+
+void print_latencies(const char *name, std::vector<ticks_t> *latencies) {
+    if (latencies->empty()) {
+        return;
+    }
+    std::sort(latencies->begin(), latencies->end());
+    const double percentiles[] = { 0.50, 0.90, 0.99, 0.999 };
+    printf("%-8s", name);
+    for (double p : percentiles) {
+        const size_t index = std::min(latencies->size() - 1,
+                                      static_cast<size_t>(p * latencies->size()));
+        printf(" p%-5g %9.1fus", p * 100, (*latencies)[index] / 1000.0);
+    }
+    printf(" max %9.1fus\n", latencies->back() / 1000.0);
+}
+
+}  // namespace microbench
@@ -0,0 +1,80 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef MICROBENCH_MICROBENCH_HPP_
+#define MICROBENCH_MICROBENCH_HPP_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "errors.hpp"
+#include "time.hpp"
+
+namespace microbench {
+
+/* A benchmark loops `while (state->keep_running())`, doing one of the operations
+it measures each time around.  The runner picks how many iterations to run, and
+work that shouldn't be counted can go between `pause_timing()` and
+`resume_timing()`. */
+class state_t {
+public:
+    explicit state_t(int64_t iterations);
+
+    bool keep_running() {
+        if (iterations_done_ == 0) {
+            start_ = get_ticks();
+        }
+        if (iterations_done_ < iterations_) {
+            ++iterations_done_;
+            return true;
+        }
+        elapsed_ += get_ticks() - start_;
+        return false;
+    }
+
+    void pause_timing() { elapsed_ += get_ticks() - start_; }
+    void resume_timing() { start_ = get_ticks(); }
+
+    int64_t iterations() const { return iterations_; }
+    ticks_t elapsed() const { return elapsed_; }
+
+private:
+    int64_t iterations_;
+    int64_t iterations_done_;
+    ticks_t start_;
+    ticks_t elapsed_;
+
+    DISABLE_COPYING(state_t);
+};
+
+/* Keeps the compiler from optimizing away the computation of `value`. */
+template <class T>
+inline void do_not_optimize(const T &value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+typedef void (*benchmark_fn_t)(state_t *state);
+
+class registration_t {
+public:
+    registration_t(const char *name, benchmark_fn_t fn);
+};
+
+/* Runs the benchmarks whose names contain `filter`, each for long enough to take
+at least `min_secs`, and prints the time per iteration of each.  Returns the
+number of benchmarks that ran. */
+int run_benchmarks(const std::string &filter, double min_secs);
+
+/* Prints a line with the 50th, 90th, 99th and 99.9th percentiles and the maximum of
+`latencies`, which it sorts.  Prints nothing if there are none. */
+void print_latencies(const char *name, std::vector<ticks_t> *latencies);
+
+}  // namespace microbench
+
+#define MICROBENCH(name)                                                \
+    static void microbench_##name(::microbench::state_t *state);        \
+    static ::microbench::registration_t microbench_registration_##name( \
+        #name, &microbench_##name);                                      \
+    static void microbench_##name(::microbench::state_t *state)
+
+#endif  // MICROBENCH_MICROBENCH_HPP_
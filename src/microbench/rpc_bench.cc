@@ -0,0 +1,416 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "microbench/rpc_bench.hpp"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "arch/os_signal.hpp"
+#include "arch/runtime/starter.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/one_per_thread.hpp"
+#include "concurrency/pmap.hpp"
+#include "concurrency/wait_any.hpp"
+#include "config/args.hpp"
+#include "containers/archive/stl_types.hpp"
+#include "microbench/microbench.hpp"
+#include "rpc/connectivity/cluster.hpp"
+#include "rpc/connectivity/multiplexer.hpp"
+#include "rpc/directory/read_manager.tcc"
+#include "rpc/directory/write_manager.tcc"
+#include "rpc/mailbox/mailbox.hpp"
+#include "rpc/mailbox/typed.hpp"
+#include "threading.hpp"
+#include "time.hpp"
+#include "utils.hpp"
+
+namespace microbench {
+
+// How long a round trip may take after the end of a run before the sender gives up
+// on it, in case an echo peer went away.
+static const int64_t ack_grace_ms = 10 * THOUSAND;
+// How long to wait for the other peers to show up.
+static const int64_t connect_timeout_ms = 30 * THOUSAND;
+
+struct rpc_bench_config_t {
+    rpc_bench_config_t()
+        : num_peers(2), serve(false), port(ANY_PORT), join_port(0),
+          thread_counts(1, 4), concurrency(16), secs(5) {
+        payload_sizes.push_back(16);
+        payload_sizes.push_back(KILOBYTE);
+        payload_sizes.push_back(64 * KILOBYTE);
+        payload_sizes.push_back(MEGABYTE);
+    }
+
+    // The peers in the cluster, this one included.
+    int num_peers;
+    bool serve;
+    int port;
+    std::string join_host;
+    int join_port;
+    std::vector<int64_t> thread_counts;
+    std::vector<int64_t> payload_sizes;
+    // Round trips at once on each thread.
+    int concurrency;
+    int secs;
+};
+
+// The echo mailbox sends the sequence number back to the ack mailbox.
+typedef mailbox_t<void(int64_t)> ack_mailbox_t;
+typedef mailbox_t<void(int64_t, std::string, ack_mailbox_t::address_t)> echo_mailbox_t;
+
+// A peer's echo mailboxes, by thread, as it puts them in the directory.
+typedef std::vector<echo_mailbox_t::address_t> echo_addresses_t;
+
+/* One peer of the benchmark's cluster, with its messaging set up the way `serve()`
+sets up the server's.  Every peer has an echo mailbox on each thread. */
+class rpc_peer_t {
+public:
+    rpc_peer_t(const std::set<ip_address_t> &local_addresses, int port)
+            THROWS_ONLY(address_in_use_exc_t, tcp_socket_exc_t)
+        : multiplexer(&cluster),
+          mailbox_client(&multiplexer, 'M'),
+          mailbox_manager(&mailbox_client),
+          mailbox_client_run(&mailbox_client, &mailbox_manager),
+          echo_mailboxes(&mailbox_manager,
+                         std::bind(&rpc_peer_t::on_echo, this, ph::_1, ph::_2, ph::_3)),
+          directory_value(get_echo_addresses(&echo_mailboxes)),
+          directory_client(&multiplexer, 'D'),
+          directory_write_manager(&directory_client, directory_value.get_watchable()),
+          directory_read_manager(cluster.get_connectivity_service()),
+          directory_client_run(&directory_client, &directory_read_manager),
+          multiplexer_run(&multiplexer),
+          cluster_run(&cluster, local_addresses, peer_address_t(), port,
+                      &multiplexer_run, 0, NULL) { }
+
+    // Waits for `num_others` other peers to show up in the directory, and returns
+    // their echo mailboxes.  Returns false if they don't show up in time.
+    bool wait_for_peers(int num_others, std::vector<echo_addresses_t> *peers_out) {
+        signal_timer_t timeout;
+        timeout.start(connect_timeout_ms);
+        const peer_id_t me = cluster.get_me();
+        try {
+            directory_read_manager.get_root_view()->run_until_satisfied(
+                [&](const change_tracking_map_t<peer_id_t, echo_addresses_t> &peers) {
+                    peers_out->clear();
+                    for (auto it = peers.get_inner().begin();
+                         it != peers.get_inner().end(); ++it) {
+                        if (it->first != me && !it->second.empty()) {
+                            peers_out->push_back(it->second);
+                        }
+                    }
+                    return static_cast<int>(peers_out->size()) >= num_others;
+                },
+                &timeout);
+        } catch (const interrupted_exc_t &) {
+            return false;
+        }
+        return true;
+    }
+
+    connectivity_cluster_t cluster;
+    message_multiplexer_t multiplexer;
+
+    message_multiplexer_t::client_t mailbox_client;
+    mailbox_manager_t mailbox_manager;
+    message_multiplexer_t::client_t::run_t mailbox_client_run;
+
+    one_per_thread_t<echo_mailbox_t> echo_mailboxes;
+
+    watchable_variable_t<echo_addresses_t> directory_value;
+    message_multiplexer_t::client_t directory_client;
+    directory_write_manager_t<echo_addresses_t> directory_write_manager;
+    directory_read_manager_t<echo_addresses_t> directory_read_manager;
+    message_multiplexer_t::client_t::run_t directory_client_run;
+
+    message_multiplexer_t::run_t multiplexer_run;
+    connectivity_cluster_t::run_t cluster_run;
+
+private:
+    void on_echo(int64_t seq, const std::string &, const ack_mailbox_t::address_t &ack) {
+        send(&mailbox_manager, ack, seq);
+    }
+
+    static echo_addresses_t get_echo_addresses(one_per_thread_t<echo_mailbox_t> *mailboxes) {
+        echo_addresses_t addresses(get_num_threads());
+        pmap(get_num_threads(), [&](int thread) {
+            on_thread_t thread_switcher((threadnum_t(thread)));
+            addresses[thread] = mailboxes->get()->get_address();
+        });
+        return addresses;
+    }
+
+    DISABLE_COPYING(rpc_peer_t);
+};
+
+/* Sends payloads to echo mailboxes, one at a time, and waits for each one's ack. */
+class round_tripper_t {
+public:
+    explicit round_tripper_t(mailbox_manager_t *_manager)
+        : manager(_manager), seq(0), acked(NULL),
+          ack_mailbox(manager, std::bind(&round_tripper_t::on_ack, this, ph::_1)) { }
+
+    // Returns false if `give_up` was pulsed before the ack came.
+    bool round_trip(const echo_mailbox_t::address_t &dest, const std::string &payload,
+                    signal_t *give_up) {
+        cond_t ack;
+        acked = &ack;
+        ++seq;
+        send(manager, dest, seq, payload, ack_mailbox.get_address());
+        wait_any_t waiter(&ack, give_up);
+        waiter.wait_lazily_unordered();
+        acked = NULL;
+        return ack.is_pulsed();
+    }
+
+private:
+    void on_ack(int64_t acked_seq) {
+        // Acks that come after we gave up on them are ignored.
+        if (acked != NULL && acked_seq == seq) {
+            acked->pulse();
+        }
+    }
+
+    mailbox_manager_t *const manager;
+    int64_t seq;
+    cond_t *acked;
+    ack_mailbox_t ack_mailbox;
+
+    DISABLE_COPYING(round_tripper_t);
+};
+
+// Runs round trips with one payload size for `config.secs`, and prints the results.
+// Returns false if an echo peer stopped answering.
+static bool run_round_trips(rpc_peer_t *sender, const std::vector<echo_addresses_t> &peers,
+                            const rpc_bench_config_t &config, size_t payload_size) {
+    const std::string payload(payload_size, 'x');
+    std::vector<std::vector<ticks_t> > latencies(get_num_threads());
+    std::vector<int64_t> lost(get_num_threads(), 0);
+    const ticks_t start = get_ticks();
+    const ticks_t end = start + secs_to_ticks(config.secs);
+    pmap(get_num_threads(), [&](int thread) {
+        on_thread_t thread_switcher((threadnum_t(thread)));
+        signal_timer_t give_up;
+        give_up.start(config.secs * THOUSAND + ack_grace_ms);
+        pmap(config.concurrency, [&](int worker) {
+            round_tripper_t round_tripper(&sender->mailbox_manager);
+            // The workers take turns with the echo peers.  Each thread sends to the
+            // same thread on the other end, so that all of them are busy.
+            for (size_t i = worker; get_ticks() < end; i += config.concurrency) {
+                const echo_addresses_t &peer = peers[i % peers.size()];
+                const ticks_t op_start = get_ticks();
+                if (!round_tripper.round_trip(peer[thread % peer.size()], payload,
+                                              &give_up)) {
+                    ++lost[thread];
+                    break;
+                }
+                // The workers on this thread share its vector without locking.
+                latencies[thread].push_back(get_ticks() - op_start);
+            }
+        });
+    });
+    const double secs = ticks_to_secs(get_ticks() - start);
+
+    std::vector<ticks_t> all_latencies;
+    int64_t all_lost = 0;
+    for (int i = 0; i < get_num_threads(); ++i) {
+        all_latencies.insert(all_latencies.end(), latencies[i].begin(), latencies[i].end());
+        all_lost += lost[i];
+    }
+    const double round_trips = all_latencies.size();
+    printf("\nPayload %zu bytes: %.0f round trips/s (%.0f messages/s), %.2f MB/s\n",
+           payload_size, round_trips / secs, 2 * round_trips / secs,
+           round_trips * payload_size / secs / MEGABYTE);
+    print_latencies("latency", &all_latencies);
+    if (all_lost > 0) {
+        fprintf(stderr, "%" PRIi64 " round trips got no reply.\n", all_lost);
+        return false;
+    }
+    return true;
+}
+
+// Sets up this process's peer, finds the others and runs every payload size.
+static void run_senders(const rpc_bench_config_t &config, bool *ok_out) {
+    *ok_out = false;
+    const bool joining = !config.join_host.empty();
+    try {
+        // In-process peers only have to reach each other.
+        const std::set<ip_address_t> local_addresses
+            = get_local_ips(std::set<ip_address_t>(), joining);
+        rpc_peer_t sender(local_addresses, ANY_PORT);
+        std::vector<scoped_ptr_t<rpc_peer_t> > echoers;
+        if (joining) {
+            std::set<host_and_port_t> hosts;
+            hosts.insert(host_and_port_t(config.join_host, port_t(config.join_port)));
+            sender.cluster_run.join(peer_address_t(hosts));
+        } else {
+            for (int i = 1; i < config.num_peers; ++i) {
+                echoers.push_back(scoped_ptr_t<rpc_peer_t>(
+                    new rpc_peer_t(local_addresses, ANY_PORT)));
+                connectivity_cluster_t *echoer = &echoers.back()->cluster;
+                sender.cluster_run.join(echoer->get_peer_address(echoer->get_me()));
+            }
+        }
+
+        std::vector<echo_addresses_t> peers;
+        if (!sender.wait_for_peers(config.num_peers - 1, &peers)) {
+            fprintf(stderr, "Only %zu of the %d other peers showed up.\n",
+                    peers.size(), config.num_peers - 1);
+            return;
+        }
+
+        printf("%d threads, %d round trips at once on each, %zu echo peers%s:\n",
+               get_num_threads(), config.concurrency, peers.size(),
+               joining ? "" : " in this process");
+        for (int64_t size : config.payload_sizes) {
+            if (!run_round_trips(&sender, peers, config, size)) {
+                return;
+            }
+        }
+        printf("\n");
+        *ok_out = true;
+    } catch (const address_in_use_exc_t &ex) {
+        fprintf(stderr, "%s\n", ex.what());
+    } catch (const tcp_socket_exc_t &ex) {
+        fprintf(stderr, "%s\n", ex.what());
+    }
+}
+
+// Echoes the round trips of peers in other processes, until SIGINT.
+static void serve_echoes(const rpc_bench_config_t &config, bool *ok_out) {
+    *ok_out = false;
+    os_signal_cond_t sigint_cond;
+    try {
+        rpc_peer_t peer(get_local_ips(std::set<ip_address_t>(), true), config.port);
+        printf("Echoing on port %d with %d threads.\n",
+               peer.cluster_run.get_port(), get_num_threads());
+        fflush(stdout);
+        sigint_cond.wait_lazily_unordered();
+        *ok_out = true;
+    } catch (const address_in_use_exc_t &ex) {
+        fprintf(stderr, "%s\n", ex.what());
+    } catch (const tcp_socket_exc_t &ex) {
+        fprintf(stderr, "%s\n", ex.what());
+    }
+}
+
+static void usage() {
+    fprintf(stderr,
+            "Usage: rethinkdb-bench rpc [OPTIONS]\n"
+            "  --peers=N             peers in the cluster, this one included (default 2);\n"
+            "                        the others echo what this one sends\n"
+            "  --join=HOST:PORT      use the echo peers of a cluster started with --serve\n"
+            "                        instead of ones in this process\n"
+            "  --serve               be an echo peer for other processes until ^C\n"
+            "  --port=N              the port for --serve (default any)\n"
+            "  --threads=N,...       thread counts to run with (default 4)\n"
+            "  --sizes=N,...         payload sizes in bytes (default 16,1024,65536,1048576)\n"
+            "  --concurrency=N       round trips at once on each thread (default 16)\n"
+            "  --secs=N              seconds to run each payload size (default 5)\n");
+}
+
+static bool parse_flag(const char *arg, const char *name, const char **value_out) {
+    const size_t length = strlen(name);
+    if (strncmp(arg, name, length) == 0 && arg[length] == '=') {
+        *value_out = arg + length + 1;
+        return true;
+    }
+    return false;
+}
+
+// Parses a comma-separated list of positive numbers.
+static bool parse_list(const char *value, std::vector<int64_t> *out) {
+    out->clear();
+    for (;;) {
+        char *end;
+        const long long n = strtoll(value, &end, 10);
+        if (end == value || n <= 0) {
+            return false;
+        }
+        out->push_back(n);
+        if (*end == '\0') {
+            return true;
+        } else if (*end != ',') {
+            return false;
+        }
+        value = end + 1;
+    }
+}
+
+static bool parse_host_and_port(const char *value, std::string *host_out, int *port_out) {
+    const char *colon = strrchr(value, ':');
+    if (colon == NULL || colon == value) {
+        return false;
+    }
+    *host_out = std::string(value, colon);
+    *port_out = atoi(colon + 1);
+    return *port_out > 0 && *port_out < 65536;
+}
+
+int run_rpc_bench(int argc, char **argv) {
+    rpc_bench_config_t config;
+    for (int i = 1; i < argc; ++i) {
+        const char *value;
+        if (parse_flag(argv[i], "--peers", &value)) {
+            config.num_peers = atoi(value);
+        } else if (parse_flag(argv[i], "--join", &value)) {
+            if (!parse_host_and_port(value, &config.join_host, &config.join_port)) {
+                usage();
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--serve") == 0) {
+            config.serve = true;
+        } else if (parse_flag(argv[i], "--port", &value)) {
+            config.port = atoi(value);
+        } else if (parse_flag(argv[i], "--threads", &value)) {
+            if (!parse_list(value, &config.thread_counts)) {
+                usage();
+                return EXIT_FAILURE;
+            }
+        } else if (parse_flag(argv[i], "--sizes", &value)) {
+            if (!parse_list(value, &config.payload_sizes)) {
+                usage();
+                return EXIT_FAILURE;
+            }
+        } else if (parse_flag(argv[i], "--concurrency", &value)) {
+            config.concurrency = atoi(value);
+        } else if (parse_flag(argv[i], "--secs", &value)) {
+            config.secs = atoi(value);
+        } else {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (config.num_peers < 2 || config.concurrency < 1 || config.secs < 1
+        || config.port < 0 || (config.serve && !config.join_host.empty())) {
+        usage();
+        return EXIT_FAILURE;
+    }
+    for (int64_t threads : config.thread_counts) {
+        if (threads > MAX_THREADS) {
+            fprintf(stderr, "At most %d threads.\n", MAX_THREADS);
+            return EXIT_FAILURE;
+        }
+    }
+
+    bool ok;
+    if (config.serve) {
+        run_in_thread_pool([&]() { serve_echoes(config, &ok); }, config.thread_counts[0]);
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // Each thread count gets a thread pool, and cluster connections, of its own.
+    for (int64_t threads : config.thread_counts) {
+        run_in_thread_pool([&]() { run_senders(config, &ok); }, threads);
+        if (!ok) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+}  // namespace microbench
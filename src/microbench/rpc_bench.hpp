@@ -0,0 +1,18 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef MICROBENCH_RPC_BENCH_HPP_
+#define MICROBENCH_RPC_BENCH_HPP_
+
+namespace microbench {
+
+/* `rethinkdb-bench rpc [OPTIONS]` measures the cluster messaging stack on its own:
+`connectivity_cluster_t`, `message_multiplexer_t` and `mailbox_manager_t`, over
+real TCP connections.  It sends payloads of several sizes to echo mailboxes on
+other peers, which are in the same process or started with `rpc --serve` in
+others, and reports round trips per second, bandwidth and latency percentiles for
+each payload size and thread count.  `argv[0]` is "rpc".  Returns the process's
+exit code. */
+int run_rpc_bench(int argc, char **argv);
+
+}  // namespace microbench
+
+#endif  // MICROBENCH_RPC_BENCH_HPP_
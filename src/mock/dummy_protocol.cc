@@ -208,6 +208,16 @@ dummy_protocol_t::region_t dummy_protocol_t::cpu_sharding_subspace(int subregion
     }
 }
 
+dummy_protocol_t::region_t dummy_protocol_t::backfill_subspace(int piece_number, int num_pieces) {
+    rassert(piece_number >= 0);
+    rassert(piece_number < num_pieces);
+
+    // Split 'a' through 'z' evenly.
+    char first = 'a' + 26 * piece_number / num_pieces;
+    char end = 'a' + 26 * (piece_number + 1) / num_pieces;
+    return first == end ? region_t::empty() : region_t(first, end - 1);
+}
+
 
 dummy_protocol_t::store_t::store_t() : store_view_t<dummy_protocol_t>(dummy_protocol_t::region_t('a', 'z')), serializer(NULL) {
     initialize_empty();
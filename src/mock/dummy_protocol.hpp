@@ -17,6 +17,8 @@
 #include "perfmon/types.hpp"
 #include "utils.hpp"
 
+class alt_memory_arbiter_t;
+class cache_memory_quota_t;
 class signal_t;
 class io_backender_t;
 class serializer_t;
@@ -100,6 +102,8 @@ public:
 
     static region_t cpu_sharding_subspace(int subregion_number, int num_cpu_shards);
 
+    static region_t backfill_subspace(int piece_number, int num_pieces);
+
 
     class store_t : public store_view_t<dummy_protocol_t> {
     public:
@@ -112,6 +116,11 @@ public:
                 io_backender_t *io, const base_path_t &);
         ~store_t();
 
+        // The dummy store has no cache, so there's nothing to arbitrate.
+        void set_cache_memory_quota(alt_memory_arbiter_t *,
+                                    const cache_memory_quota_t &) { }
+        void enable_cache_warm_up_manifest(const std::string &) { }
+
         void new_read_token(object_buffer_t<fifo_enforcer_sink_t::exit_read_t> *token_out) THROWS_NOTHING;
         void new_write_token(object_buffer_t<fifo_enforcer_sink_t::exit_write_t> *token_out) THROWS_NOTHING;
 
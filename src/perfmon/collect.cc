@@ -4,6 +4,7 @@
 
 #include "perfmon/collect.hpp"
 #include "concurrency/pmap.hpp"
+#include "perfmon/filter.hpp"
 
 /* This is the function that actually gathers the stats. It is illegal to create or destroy
 perfmon_t objects while perfmon_get_stats is active. */
@@ -20,3 +21,15 @@ scoped_ptr_t<perfmon_result_t> perfmon_get_stats() {
     return get_global_perfmon_collection().end_stats(data);
 }
 
+scoped_ptr_t<perfmon_result_t> perfmon_get_stats(const perfmon_filter_t &filter) {
+    // Each thread still gets one visit, for everything the filter wants.
+    void *data = get_global_perfmon_collection().begin_filtered_stats(
+        &filter, 0, filter.all_paths_active());
+    pmap(get_num_threads(), boost::bind(&co_perfmon_visit, _1, data));
+    scoped_ptr_t<perfmon_result_t> result
+        = get_global_perfmon_collection().end_stats(data);
+    // Perfmons that aren't collections were collected whole.
+    filter.filter(&result);
+    return result;
+}
+
@@ -11,4 +11,9 @@
  */
 scoped_ptr_t<perfmon_result_t> perfmon_get_stats();
 
+/* Like `perfmon_get_stats()`, but only returns what `filter` keeps, and doesn't
+ * collect the collections it would throw away in the first place.
+ */
+scoped_ptr_t<perfmon_result_t> perfmon_get_stats(const perfmon_filter_t &filter);
+
 #endif  // PERFMON_COLLECT_HPP_
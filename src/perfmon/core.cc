@@ -6,6 +6,7 @@
 #include "containers/scoped_regex.hpp"
 #include "logger.hpp"
 #include "perfmon/core.hpp"
+#include "perfmon/filter.hpp"
 #include "utils.hpp"
 
 /* Constructor and destructor register and deregister the perfmon. */
@@ -17,21 +18,23 @@ perfmon_t::~perfmon_t() {
 
 struct stats_collection_context_t : public home_thread_mixin_t {
 private:
-    // This could be a read lock ... if we used a read-write lock instead of a mutex.
-    cross_thread_mutex_t::acq_t lock_sentry;
+    cross_thread_rwlock_t::acq_t lock_sentry;
 public:
     scoped_array_t<void *> contexts;
+    // Which constituents are being collected; a filtered collection skips some.
+    std::vector<bool> included;
 
-    stats_collection_context_t(cross_thread_mutex_t *constituents_lock,
+    stats_collection_context_t(cross_thread_rwlock_t *constituents_lock,
                                const intrusive_list_t<perfmon_membership_t> &constituents) :
-        lock_sentry(constituents_lock),
+        lock_sentry(constituents_lock, access_t::read),
         contexts(new void *[constituents.size()](),
-                 constituents.size()) { }
+                 constituents.size()),
+        included(constituents.size(), true) { }
 
     ~stats_collection_context_t() { }
 };
 
-perfmon_collection_t::perfmon_collection_t() : constituents_access(true) { }
+perfmon_collection_t::perfmon_collection_t() { }
 perfmon_collection_t::~perfmon_collection_t() { }
 
 void *perfmon_collection_t::begin_stats() {
@@ -45,11 +48,42 @@ void *perfmon_collection_t::begin_stats() {
     return ctx;
 }
 
+void *perfmon_collection_t::begin_filtered_stats(const perfmon_filter_t *filter,
+                                                 size_t depth,
+                                                 const std::vector<bool> &active) {
+    stats_collection_context_t *ctx =
+        new stats_collection_context_t(&constituents_access, constituents);
+
+    size_t i = 0;
+    for (perfmon_membership_t *p = constituents.head(); p != NULL; p = constituents.next(p), ++i) {
+        perfmon_collection_t *subcollection
+            = dynamic_cast<perfmon_collection_t *>(p->get());
+        if (p->splice()) {
+            // The children of a spliced perfmon end up at our depth.
+            ctx->contexts[i] = subcollection != NULL
+                ? subcollection->begin_filtered_stats(filter, depth, active)
+                : p->get()->begin_stats();
+            continue;
+        }
+        std::vector<bool> subactive;
+        if (!filter->child_may_match(p->name, depth, active, &subactive)) {
+            ctx->included[i] = false;
+            continue;
+        }
+        ctx->contexts[i] = subcollection != NULL
+            ? subcollection->begin_filtered_stats(filter, depth + 1, subactive)
+            : p->get()->begin_stats();
+    }
+    return ctx;
+}
+
 void perfmon_collection_t::visit_stats(void *_context) {
     stats_collection_context_t *ctx = reinterpret_cast<stats_collection_context_t*>(_context);
     size_t i = 0;
     for (perfmon_membership_t *p = constituents.head(); p != NULL; p = constituents.next(p), ++i) {
-        p->get()->visit_stats(ctx->contexts[i]);
+        if (ctx->included[i]) {
+            p->get()->visit_stats(ctx->contexts[i]);
+        }
     }
 }
 
@@ -60,6 +94,9 @@ scoped_ptr_t<perfmon_result_t> perfmon_collection_t::end_stats(void *_context) {
 
     size_t i = 0;
     for (perfmon_membership_t *p = constituents.head(); p != NULL; p = constituents.next(p), ++i) {
+        if (!ctx->included[i]) {
+            continue;
+        }
         scoped_ptr_t<perfmon_result_t> stat = p->get()->end_stats(ctx->contexts[i]);
         if (p->splice()) {
             stat->splice_into(map.get());
@@ -79,7 +116,7 @@ void perfmon_collection_t::add(perfmon_membership_t *perfmon) {
         thread_switcher.init(new on_thread_t(home_thread()));
     }
 
-    cross_thread_mutex_t::acq_t write_acq(&constituents_access);
+    cross_thread_rwlock_t::acq_t write_acq(&constituents_access, access_t::write);
     constituents.push_back(perfmon);
 }
 
@@ -89,7 +126,7 @@ void perfmon_collection_t::remove(perfmon_membership_t *perfmon) {
         thread_switcher.init(new on_thread_t(home_thread()));
     }
 
-    cross_thread_mutex_t::acq_t write_acq(&constituents_access);
+    cross_thread_rwlock_t::acq_t write_acq(&constituents_access, access_t::write);
     constituents.remove(perfmon);
 }
 
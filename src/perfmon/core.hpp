@@ -8,12 +8,13 @@
 #include <utility>
 #include <vector>
 
-#include "concurrency/cross_thread_mutex.hpp"
+#include "concurrency/cross_thread_rwlock.hpp"
 #include "containers/intrusive_list.hpp"
 #include "containers/scoped.hpp"
 #include "threading.hpp"
 
 class perfmon_collection_t;
+class perfmon_filter_t;
 class perfmon_result_t;
 class scoped_regex_t;
 
@@ -59,16 +60,23 @@ public:
     void visit_stats(void *_contexts);
     scoped_ptr_t<perfmon_result_t> end_stats(void *_contexts);
 
+    /* Like `begin_stats()`, but skips the constituents that `filter` would throw
+    away anyway, so that they aren't visited on every thread (see
+    `perfmon_filter_t::child_may_match()` for `depth` and `active`). Sub-collections
+    are pruned the same way; other perfmons are collected whole. Call
+    `visit_stats()` and `end_stats()` on the result as usual. */
+    void *begin_filtered_stats(const perfmon_filter_t *filter, size_t depth,
+                               const std::vector<bool> &active);
+
 private:
     friend class perfmon_membership_t;
 
     void add(perfmon_membership_t *perfmon);
     void remove(perfmon_membership_t *perfmon);
 
-    // TODO: This should be a cross_thread_rwi_lock_t.
-    // However concurrent reads to a perfmon_collection are currently rare,
-    // and this makes the implementation simpler.
-    cross_thread_mutex_t constituents_access;
+    // Stats are collected from many threads at once (the stat and metrics apps, the
+    // stats log), while constituents come and go rarely.
+    cross_thread_rwlock_t constituents_access;
     intrusive_list_t<perfmon_membership_t> constituents;
 };
 
@@ -60,6 +60,32 @@ void perfmon_filter_t::filter(const scoped_ptr_t<perfmon_result_t> *p) const {
     guarantee(p->has(), "subfilter is not supposed to delete the top-most node.");
 }
 
+std::vector<bool> perfmon_filter_t::all_paths_active() const {
+    return std::vector<bool>(regexps.size(), true);
+}
+
+/* This has to agree with what [subfilter] does with the children of a map. */
+bool perfmon_filter_t::child_may_match(
+    const std::string &name, const size_t depth, const std::vector<bool> &active,
+    std::vector<bool> *subactive_out) const {
+
+    *subactive_out = active;
+    bool some_subpath = false;
+    for (size_t i = 0; i < regexps.size(); ++i) {
+        if (!active[i]) {
+            continue;
+        }
+        if (depth >= regexps[i].size()) {
+            // This path wants everything under here.
+            *subactive_out = active;
+            return true;
+        }
+        (*subactive_out)[i] = regexps[i][depth]->matches(name);
+        some_subpath |= (*subactive_out)[i];
+    }
+    return some_subpath;
+}
+
 /* Filter a [perfmon_result_t].  [depth] is how deep we are in the paths that
    the [perfmon_filter_t] was constructed from, and [active] is the set of paths
    that are still active (i.e. that haven't failed a match yet).  This should
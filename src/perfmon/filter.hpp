@@ -18,6 +18,16 @@ public:
     ~perfmon_filter_t();
     // This takes a const scoped_ptr_t because subfilter needs one to sanely work.
     void filter(const scoped_ptr_t<perfmon_result_t> *target) const;
+
+    // These let stats collection skip the subtrees that `filter` would throw away.
+    // `active` says which paths have matched all the way down to a map at `depth`;
+    // at the top, all of them have.  `child_may_match` tells whether `filter` might
+    // keep some of the map's child called `name`, and if so, which paths are still
+    // active under it.
+    std::vector<bool> all_paths_active() const;
+    bool child_may_match(const std::string &name, size_t depth,
+                         const std::vector<bool> &active,
+                         std::vector<bool> *subactive_out) const;
 private:
     void subfilter(scoped_ptr_t<perfmon_result_t> *target,
                    size_t depth, std::vector<bool> active) const;
@@ -289,6 +289,175 @@ scoped_ptr_t<perfmon_result_t> perfmon_rate_monitor_t::output_stat(const double
     return make_scoped<perfmon_result_t>(strprintf("%.8f", stat / ticks_to_secs(length)));
 }
 
+/* latency_histogram_t */
+
+latency_histogram_t::latency_histogram_t() {
+    clear();
+}
+
+int latency_histogram_t::bucket_for(uint64_t micros) {
+    const uint64_t sub_buckets = 1 << SUB_BUCKET_BITS;
+    if (micros < sub_buckets) {
+        return micros;
+    }
+    if (micros >= (uint64_t(1) << 32)) {
+        return NUM_BUCKETS - 1;
+    }
+    const int log2 = 63 - __builtin_clzll(micros);
+    const int shift = log2 - SUB_BUCKET_BITS;
+    return ((shift + 1) << SUB_BUCKET_BITS) + ((micros >> shift) - sub_buckets);
+}
+
+uint64_t latency_histogram_t::bucket_end(int bucket) {
+    const uint64_t sub_buckets = 1 << SUB_BUCKET_BITS;
+    if (bucket < static_cast<int>(sub_buckets)) {
+        return bucket + 1;
+    }
+    const int shift = (bucket >> SUB_BUCKET_BITS) - 1;
+    return (sub_buckets + (bucket & (sub_buckets - 1)) + 1) << shift;
+}
+
+void latency_histogram_t::record(ticks_t latency) {
+    ++count_;
+    max_ = std::max(max_, latency);
+    ++buckets_[bucket_for(latency / (secs_to_ticks(1) / MILLION))];
+}
+
+void latency_histogram_t::merge(const latency_histogram_t &other) {
+    count_ += other.count_;
+    max_ = std::max(max_, other.max_);
+    for (int i = 0; i < NUM_BUCKETS; ++i) {
+        buckets_[i] += other.buckets_[i];
+    }
+}
+
+void latency_histogram_t::clear() {
+    count_ = 0;
+    max_ = 0;
+    std::fill(buckets_, buckets_ + NUM_BUCKETS, 0);
+}
+
+ticks_t latency_histogram_t::percentile(double fraction) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    // The rank of the latency we want, counting from 1.
+    const uint64_t rank = std::max<uint64_t>(1, ceil(fraction * count_));
+    uint64_t seen = 0;
+    for (int i = 0; i < NUM_BUCKETS; ++i) {
+        seen += buckets_[i];
+        if (seen >= rank) {
+            const ticks_t end = bucket_end(i) * (secs_to_ticks(1) / MILLION);
+            return std::min(max_, end - 1);
+        }
+    }
+    return max_;
+}
+
+/* perfmon_latency_histogram_t */
+
+static const char *const latency_bucket_names[] = {
+    "under_1ms", "under_10ms", "under_100ms", "under_1s", "under_10s", "over_10s"
+};
+
+static const struct {
+    const char *name;
+    double fraction;
+} latency_percentiles[] = {
+    { "p50", 0.5 }, { "p90", 0.9 }, { "p99", 0.99 }, { "p99.9", 0.999 }
+};
+
+perfmon_latency_histogram_t::perfmon_latency_histogram_t(ticks_t _window)
+    : perfmon_perthread_t<counts_t>(), window(_window) { }
+
+void perfmon_latency_histogram_t::update(thread_info_t *thread, ticks_t now) {
+    const int64_t interval = now / window;
+    if (!thread->current.has()) {
+        thread->current.init(new latency_histogram_t);
+        thread->last.init(new latency_histogram_t);
+        thread->current_interval = interval;
+    } else if (thread->current_interval == interval) {
+        /* We're up to date; nothing to do */
+    } else if (thread->current_interval + 1 == interval) {
+        /* We're one step behind */
+        thread->current.swap(thread->last);
+        thread->current->clear();
+        thread->current_interval++;
+    } else {
+        /* We're more than one step behind */
+        thread->current->clear();
+        thread->last->clear();
+        thread->current_interval = interval;
+    }
+}
+
+void perfmon_latency_histogram_t::record(ticks_t latency) {
+    int bucket = 0;
+    for (ticks_t limit = secs_to_ticks(1) / 1000;
+         bucket < perfmon_latency_histogram::NUM_BUCKETS - 1 && latency >= limit;
+         limit *= 10) {
+        ++bucket;
+    }
+    rassert(get_thread_id().threadnum >= 0);
+    thread_info_t *thread = &thread_data[get_thread_id().threadnum].value;
+    ++thread->buckets[bucket];
+    update(thread, get_ticks());
+    thread->current->record(latency);
+}
+
+void perfmon_latency_histogram_t::get_thread_stat(counts_t *stat) {
+    rassert(get_thread_id().threadnum >= 0);
+    thread_info_t *thread = &thread_data[get_thread_id().threadnum].value;
+    std::copy(thread->buckets, thread->buckets + perfmon_latency_histogram::NUM_BUCKETS,
+              stat->buckets);
+    // Threads that never recorded anything have no window to report.
+    if (thread->current.has()) {
+        update(thread, get_ticks());
+        stat->recent = *thread->last;
+    }
+}
+
+perfmon_latency_histogram_t::counts_t perfmon_latency_histogram_t::combine_stats(
+        const counts_t *stats) {
+    counts_t total;
+    for (int i = 0; i < get_num_threads(); i++) {
+        for (int j = 0; j < perfmon_latency_histogram::NUM_BUCKETS; ++j) {
+            total.buckets[j] += stats[i].buckets[j];
+        }
+        total.recent.merge(stats[i].recent);
+    }
+    return total;
+}
+
+scoped_ptr_t<perfmon_result_t> perfmon_latency_histogram_t::output_stat(
+        const counts_t &stat) {
+    CT_ASSERT(sizeof(latency_bucket_names) / sizeof(latency_bucket_names[0])
+              == perfmon_latency_histogram::NUM_BUCKETS);
+    scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
+    for (int i = 0; i < perfmon_latency_histogram::NUM_BUCKETS; ++i) {
+        result->insert(latency_bucket_names[i],
+                       new perfmon_result_t(strprintf("%" PRIu64, stat.buckets[i])));
+    }
+
+    scoped_ptr_t<perfmon_result_t> recent = perfmon_result_t::alloc_map_result();
+    recent->insert(stat_count,
+                   new perfmon_result_t(strprintf("%" PRIu64, stat.recent.count())));
+    for (size_t i = 0; i < sizeof(latency_percentiles) / sizeof(latency_percentiles[0]); ++i) {
+        recent->insert(latency_percentiles[i].name,
+                       stat.recent.count() == 0
+                       ? new perfmon_result_t(no_value)
+                       : new perfmon_result_t(strprintf("%.8f", ticks_to_secs(
+                           stat.recent.percentile(latency_percentiles[i].fraction)))));
+    }
+    recent->insert(stat_max,
+                   stat.recent.count() == 0
+                   ? new perfmon_result_t(no_value)
+                   : new perfmon_result_t(strprintf("%.8f",
+                                                    ticks_to_secs(stat.recent.max()))));
+    result->insert("recent", recent.release());
+    return result;
+}
+
 perfmon_duration_sampler_t::perfmon_duration_sampler_t(ticks_t length, bool _ignore_global_full_perfmon)
     : stat(), active(), total(), recent(length, true),
       active_membership(&stat, &active, "active_count"),
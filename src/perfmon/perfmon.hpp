@@ -204,6 +204,89 @@ public:
     void record(double value = 1.0);
 };
 
+/* `latency_histogram_t` counts latencies in log-linear buckets, like an HDR
+ * histogram: below 8us each microsecond gets a bucket, and above that each power
+ * of two is split into 8 buckets, so a percentile read back from it is off by at
+ * most 12.5%. Histograms are merged by adding up their buckets, so per-thread ones
+ * can be combined. Latencies of 2^32us (a bit over an hour) or more all go in the
+ * last bucket.
+ */
+class latency_histogram_t {
+public:
+    static const int SUB_BUCKET_BITS = 3;
+    static const int NUM_BUCKETS = (32 - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+    latency_histogram_t();
+
+    void record(ticks_t latency);
+    void merge(const latency_histogram_t &other);
+    void clear();
+
+    uint64_t count() const { return count_; }
+    ticks_t max() const { return max_; }
+    // The latency that `fraction` (between 0 and 1) of the recorded latencies are
+    // at or below, rounded up to the end of its bucket (but never past `max()`).
+    // Zero if nothing was recorded.
+    ticks_t percentile(double fraction) const;
+
+    // Which bucket a latency of `micros` microseconds goes in, and the first
+    // latency in microseconds that is past bucket `bucket`.
+    static int bucket_for(uint64_t micros);
+    static uint64_t bucket_end(int bucket);
+
+private:
+    uint64_t count_;
+    ticks_t max_;
+    uint64_t buckets_[NUM_BUCKETS];
+};
+
+/* `perfmon_latency_histogram_t` counts events by how long they took, in buckets
+ * that are ten times wider each: under 1ms, under 10ms, under 100ms, under 1s,
+ * under 10s, and 10s or more. The counts are totals since it was created. It also
+ * reports the count, the 50th, 90th, 99th and 99.9th percentiles, and the maximum
+ * of the latencies recorded in the last full `window` (see `latency_histogram_t`).
+ * A thread's window histograms are only allocated once it records something.
+ */
+namespace perfmon_latency_histogram {
+
+static const int NUM_BUCKETS = 6;
+
+struct counts_t {
+    counts_t() {
+        std::fill(buckets, buckets + NUM_BUCKETS, 0);
+    }
+    uint64_t buckets[NUM_BUCKETS];
+    latency_histogram_t recent;
+};
+
+}  // namespace perfmon_latency_histogram
+
+class perfmon_latency_histogram_t
+    : public perfmon_perthread_t<perfmon_latency_histogram::counts_t> {
+    typedef perfmon_latency_histogram::counts_t counts_t;
+
+    struct thread_info_t {
+        thread_info_t() : current_interval(0) {
+            std::fill(buckets, buckets + perfmon_latency_histogram::NUM_BUCKETS, 0);
+        }
+        uint64_t buckets[perfmon_latency_histogram::NUM_BUCKETS];
+        scoped_ptr_t<latency_histogram_t> current, last;
+        int64_t current_interval;
+    };
+
+    cache_line_padded_t<thread_info_t> thread_data[MAX_THREADS];
+    const ticks_t window;
+
+    void update(thread_info_t *thread, ticks_t now);
+
+    void get_thread_stat(counts_t *);
+    counts_t combine_stats(const counts_t *);
+    scoped_ptr_t<perfmon_result_t> output_stat(const counts_t &);
+public:
+    explicit perfmon_latency_histogram_t(ticks_t window = secs_to_ticks(10));
+    void record(ticks_t latency);
+};
+
 /* perfmon_duration_sampler_t is a perfmon_t that monitors events that have a
  * starting and ending time. When something starts, call begin(); when
  * something ends, call end() with the same value as begin. It will produce
@@ -5,6 +5,7 @@
 #include <set>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "errors.hpp"
 #include <boost/function.hpp>
@@ -16,6 +17,10 @@
 #include "arch/timing.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/mutex.hpp"
+#include "concurrency/new_semaphore.hpp"
+#include "concurrency/one_per_thread.hpp"
+#include "config/args.hpp"
 #include "containers/archive/archive.hpp"
 #include "http/http.hpp"
 
@@ -93,10 +98,14 @@ public:
     }
 
     void on_ring() {
+        // Destroying a connection can block (to stop its cursors' prefetches), so the
+        // expired ones go once we're done with the map.
+        std::vector<boost::shared_ptr<http_conn_t> > expired;
         for (auto it = cache.begin(); it != cache.end();) {
             auto tmp = it++;
             if (tmp->second->is_expired()) {
                 tmp->second->pulse();
+                expired.push_back(tmp->second);
                 cache.erase(tmp);
             }
         }
@@ -122,11 +131,18 @@ private:
 // // Retrieves the protocol buffers object from an initialized request_t.
 // request_t::protob_type *underlying_protob_value(request_t *request);
 //
-// "request_t::protob_type" does not actually have to be defined.
+// // Whether the request may only run once every request that came before it on
+// // the connection has finished.  Only used by CORO_ORDERED and CORO_UNORDERED.
+// bool is_barrier_request(request_t *request);
+//
+// "request_t::protob_type" does not actually have to be defined, but it must have
+// a `token` field.  In CORO_ORDERED and CORO_UNORDERED mode, the requests with the
+// same token run one at a time, in the order they arrived, and the others run at the
+// same time (up to PROTOB_MAX_REQUESTS_IN_FLIGHT_PER_CONNECTION of them).
 
 
 template <class request_t, class response_t, class context_t>
-class protob_server_t : public http_app_t {
+class protob_server_t : public http_app_t, public home_thread_mixin_t {
 public:
     protob_server_t(const std::set<ip_address_t> &local_addresses,
                     int port,
@@ -138,8 +154,39 @@ public:
 
     int get_port() const;
 private:
+    // What the requests running at once on a connection share, in CORO_ORDERED and
+    // CORO_UNORDERED mode.
+    struct conn_requests_t {
+        conn_requests_t() : slots(PROTOB_MAX_REQUESTS_IN_FLIGHT_PER_CONNECTION) { }
+        // A request holds one of these while it runs.
+        new_semaphore_t slots;
+        // For each token with requests in flight, pulsed when the last of them is
+        // done.
+        std::map<int64_t, boost::shared_ptr<cond_t> > token_done;
+        // In CORO_ORDERED mode, pulsed when the last request's response is sent.
+        boost::shared_ptr<cond_t> last_sent;
+        // Each response is written in one piece.
+        mutex_t send_mutex;
+    };
+
+    // The signals a request waits for before it runs and before it sends its
+    // response, and the ones it pulses when it has.  (The waits can be NULL.)
+    struct request_turns_t {
+        boost::shared_ptr<cond_t> token_prev, token_done;
+        boost::shared_ptr<cond_t> send_prev, send_done;
+    };
 
-    void handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn, auto_drainer_t::lock_t);
+    void handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn);
+    // Picks the thread to handle a new connection on (see
+    // CONNECTION_PLACEMENT_UTILIZATION_SLACK_PERMILLE).  Called on the home thread.
+    threadnum_t choose_conn_thread();
+    void handle_request(auto_drainer_t::lock_t keepalive,
+                        tcp_conn_t *conn,
+                        context_t *ctx,
+                        conn_requests_t *requests,
+                        request_t request,
+                        request_turns_t turns,
+                        new_semaphore_acq_t *slot);
     void send(const response_t &, tcp_conn_t *conn, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
     static auth_key_t read_auth_key(tcp_conn_t *conn, signal_t *interruptor);
 
@@ -158,6 +205,9 @@ private:
     signal_t *shutdown_signal() { return &shutting_down_conds[get_thread_id().threadnum]; }
     boost::ptr_vector<cross_thread_signal_t> shutting_down_conds;
     auto_drainer_t auto_drainer;
+    // Connections are locked with the drainer of the thread that accepted them,
+    // which isn't always our home thread.
+    one_per_thread_t<auto_drainer_t> conn_drainers;
     struct pulse_on_destruct_t {
         explicit pulse_on_destruct_t(cond_t *_cond) : cond(_cond) { }
         ~pulse_on_destruct_t() { cond->pulse(); }
@@ -165,9 +215,16 @@ private:
     } pulse_sdc_on_shutdown;
     http_conn_cache_t<context_t> http_conn_cache;
 
-    scoped_ptr_t<tcp_listener_t> tcp_listener;
-
+    // Whether each thread accepts and handles its own connections. If not, we accept
+    // them on our home thread and hand them out to the least busy threads.
+    const bool per_thread_listeners;
+    // Where `choose_conn_thread` starts looking, so ties go to each thread in turn.
     unsigned next_thread;
+    // How many of the connections we handed out each thread has.  They are counted
+    // down on those threads.
+    std::vector<int64_t> conns_per_thread;
+
+    scoped_ptr_t<reuseport_tcp_listener_t> tcp_listener;
 };
 
 //TODO figure out how to do 0 copy serialization with this.
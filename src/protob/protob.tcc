@@ -6,17 +6,20 @@
 
 #include <google/protobuf/stubs/common.h>
 
+#include <functional>
 #include <set>
 #include <string>
 
 #include "errors.hpp"
 #include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
 
 #include "arch/arch.hpp"
 #include "arch/io/network.hpp"
 #include "clustering/administration/metadata.hpp"
 #include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/interruptor.hpp"
 #include "containers/auth_key.hpp"
 #include "rpc/semilattice/joins/vclock.hpp"
 #include "rpc/semilattice/view.hpp"
@@ -37,7 +40,10 @@ protob_server_t<request_t, response_t, context_t>::protob_server_t(
       cb_mode(_cb_mode),
       shutting_down_conds(get_num_threads()),
       pulse_sdc_on_shutdown(&main_shutting_down_cond),
-      next_thread(0) {
+      per_thread_listeners(
+          reuseport_tcp_listener_t::listens_per_thread(get_num_db_threads())),
+      next_thread(0),
+      conns_per_thread(get_num_db_threads(), 0) {
 
     for (int i = 0; i < get_num_threads(); ++i) {
         cross_thread_signal_t *s =
@@ -47,11 +53,12 @@ protob_server_t<request_t, response_t, context_t>::protob_server_t(
     }
 
     try {
-        tcp_listener.init(new tcp_listener_t(
+        tcp_listener.init(new reuseport_tcp_listener_t(
             local_addresses,
             port,
             boost::bind(&protob_server_t<request_t, response_t, context_t>::handle_conn,
-                        this, _1, auto_drainer_t::lock_t(&auto_drainer))));
+                        this, _1),
+            per_thread_listeners ? get_num_db_threads() : 1));
     } catch (const address_in_use_exc_t &ex) {
         throw address_in_use_exc_t(strprintf("Could not bind to RDB protocol port: %s", ex.what()));
     }
@@ -64,6 +71,51 @@ int protob_server_t<request_t, response_t, context_t>::get_port() const {
     return tcp_listener->get_port();
 }
 
+template <class request_t, class response_t, class context_t>
+threadnum_t protob_server_t<request_t, response_t, context_t>::choose_conn_thread() {
+    assert_thread();
+    const int num_threads = get_num_db_threads();
+    const int start = (next_thread++) % num_threads;
+    int best = -1;
+    int best_utilization = 0;
+    int64_t best_conns = 0;
+    for (int i = 0; i < num_threads; ++i) {
+        const int thread = (start + i) % num_threads;
+        const int utilization = get_thread_utilization_permille(threadnum_t(thread));
+        const int64_t conns = __sync_fetch_and_add(&conns_per_thread[thread], 0);
+        if (best == -1
+            || utilization + CONNECTION_PLACEMENT_UTILIZATION_SLACK_PERMILLE
+               < best_utilization
+            || (utilization <= best_utilization
+                               + CONNECTION_PLACEMENT_UTILIZATION_SLACK_PERMILLE
+                && conns < best_conns)) {
+            best = thread;
+            best_utilization = utilization;
+            best_conns = conns;
+        }
+    }
+    return threadnum_t(best);
+}
+
+// Counts a connection in `protob_server_t::conns_per_thread` while it lasts.
+class scoped_conn_count_t {
+public:
+    scoped_conn_count_t() : count(NULL) { }
+    ~scoped_conn_count_t() {
+        if (count != NULL) {
+            __sync_fetch_and_sub(count, 1);
+        }
+    }
+    void init(int64_t *_count) {
+        guarantee(count == NULL);
+        count = _count;
+        __sync_fetch_and_add(count, 1);
+    }
+private:
+    int64_t *count;
+    DISABLE_COPYING(scoped_conn_count_t);
+};
+
 struct protob_server_exc_t : public std::exception {
 public:
     explicit protob_server_exc_t(const std::string& data) : info(data) { }
@@ -97,13 +149,23 @@ auth_key_t protob_server_t<request_t, response_t, context_t>::read_auth_key(tcp_
 
 template <class request_t, class response_t, class context_t>
 void protob_server_t<request_t, response_t, context_t>::handle_conn(
-    const scoped_ptr_t<tcp_conn_descriptor_t> &nconn,
-    auto_drainer_t::lock_t keepalive) {
-
-    // This must be read here because of home threads and stuff
-    const vclock_t<auth_key_t> auth_vclock = auth_metadata->get().auth_key;
+    const scoped_ptr_t<tcp_conn_descriptor_t> &nconn) {
+    // We are on the thread that accepted the connection.
+    auto_drainer_t::lock_t keepalive(conn_drainers.get());
+
+    vclock_t<auth_key_t> auth_vclock;
+    threadnum_t chosen_thread = get_thread_id();
+    scoped_conn_count_t conn_count;
+    {
+        // This must be read here because of home threads and stuff
+        on_thread_t home_rethreader(home_thread());
+        auth_vclock = auth_metadata->get().auth_key;
+        if (!per_thread_listeners) {
+            chosen_thread = choose_conn_thread();
+            conn_count.init(&conns_per_thread[chosen_thread.threadnum]);
+        }
+    }
 
-    threadnum_t chosen_thread = threadnum_t((next_thread++) % get_num_db_threads());
     cross_thread_signal_t ct_keepalive(keepalive.get_drain_signal(), chosen_thread);
     on_thread_t rethreader(chosen_thread);
 
@@ -165,7 +227,11 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
         return;
     }
 
-    //TODO figure out how to do this with less copying
+    // Destroyed first, so the requests still running are done with the connection
+    // before it goes away.
+    conn_requests_t requests;
+    auto_drainer_t requests_drainer;
+
     for (;;) {
         request_t request;
         make_empty_protob_bearer(&request);
@@ -180,11 +246,17 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
                 forced_response = on_unparsable_query(request_t(), err);
                 force_response = true;
             } else {
-                scoped_array_t<char> data(size);
-                conn->read(data.data(), size, &ct_keepalive);
-
-                const bool res
-                    = underlying_protob_value(&request)->ParseFromArray(data.data(), size);
+                bool res;
+                if (size <= TCP_CONN_MAX_READ_SIZE) {
+                    // Parse the query right out of the connection's read buffer.
+                    const_charslice data = conn->peek(size, &ct_keepalive);
+                    res = underlying_protob_value(&request)->ParseFromArray(data.beg, size);
+                    conn->pop(size, &ct_keepalive);
+                } else {
+                    scoped_array_t<char> data(size);
+                    conn->read(data.data(), size, &ct_keepalive);
+                    res = underlying_protob_value(&request)->ParseFromArray(data.data(), size);
+                }
                 if (!res) {
                     err = "Client is buggy (failed to deserialize protobuf).";
                     forced_response = on_unparsable_query(request, err);
@@ -211,10 +283,43 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
                 }
                 break;
             case CORO_ORDERED:
-                crash("unimplemented");
-                break;
             case CORO_UNORDERED:
-                crash("unimplemented");
+                if (force_response || is_barrier_request(&request)) {
+                    // This gets all the slots once the requests before it are done,
+                    // and the requests after it wait until it is.
+                    new_semaphore_acq_t all(&requests.slots,
+                                            PROTOB_MAX_REQUESTS_IN_FLIGHT_PER_CONNECTION);
+                    wait_interruptible(all.acquisition_signal(), &ct_keepalive);
+                    if (force_response) {
+                        send(forced_response, conn.get(), &ct_keepalive);
+                    } else {
+                        response_t response;
+                        bool response_needed = f(request, &response, &ctx);
+                        if (response_needed) {
+                            send(response, conn.get(), &ct_keepalive);
+                        }
+                    }
+                } else {
+                    scoped_ptr_t<new_semaphore_acq_t> slot(
+                        new new_semaphore_acq_t(&requests.slots, 1));
+                    wait_interruptible(slot->acquisition_signal(), &ct_keepalive);
+
+                    request_turns_t turns;
+                    boost::shared_ptr<cond_t> *token_done =
+                        &requests.token_done[underlying_protob_value(&request)->token()];
+                    turns.token_prev = *token_done;
+                    turns.token_done = boost::make_shared<cond_t>();
+                    *token_done = turns.token_done;
+                    if (cb_mode == CORO_ORDERED) {
+                        turns.send_prev = requests.last_sent;
+                        turns.send_done = boost::make_shared<cond_t>();
+                        requests.last_sent = turns.send_done;
+                    }
+                    coro_t::spawn_sometime(std::bind(
+                        &protob_server_t<request_t, response_t, context_t>::handle_request,
+                        this, auto_drainer_t::lock_t(&requests_drainer), conn.get(),
+                        &ctx, &requests, request, turns, slot.release()));
+                }
                 break;
             default:
                 crash("unreachable");
@@ -224,7 +329,52 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
             //TODO need to figure out what blocks us up here in non inline cb
             //mode
             return;
+        } catch (const interrupted_exc_t &) {
+            return;
+        }
+    }
+}
+
+template <class request_t, class response_t, class context_t>
+void protob_server_t<request_t, response_t, context_t>::handle_request(
+    auto_drainer_t::lock_t keepalive,
+    tcp_conn_t *conn,
+    context_t *ctx,
+    conn_requests_t *requests,
+    request_t request,
+    request_turns_t turns,
+    new_semaphore_acq_t *_slot) {
+    scoped_ptr_t<new_semaphore_acq_t> slot(_slot);
+    const int64_t token = underlying_protob_value(&request)->token();
+    try {
+        if (turns.token_prev) {
+            wait_interruptible(turns.token_prev.get(), keepalive.get_drain_signal());
         }
+        response_t response;
+        bool response_needed = f(request, &response, ctx);
+        if (turns.send_prev) {
+            wait_interruptible(turns.send_prev.get(), keepalive.get_drain_signal());
+        }
+        if (response_needed) {
+            mutex_t::acq_t send_acq(&requests->send_mutex);
+            send(response, conn, keepalive.get_drain_signal());
+        }
+    } catch (const interrupted_exc_t &) {
+        // The connection is closing.
+    } catch (const tcp_conn_write_closed_exc_t &) {
+        // The connection's loop finds out when it next reads.
+    }
+
+    auto it = requests->token_done.find(token);
+    if (it != requests->token_done.end() && it->second == turns.token_done) {
+        requests->token_done.erase(it);
+    }
+    turns.token_done->pulse();
+    if (turns.send_done) {
+        if (requests->last_sent == turns.send_done) {
+            requests->last_sent.reset();
+        }
+        turns.send_done->pulse();
     }
 }
 
@@ -327,7 +477,10 @@ void protob_server_t<request_t, response_t, context_t>::handle(const http_req_t
 
             response_t response;
             switch (cb_mode) {
+            // An HTTP connection only runs one query at a time anyway.
             case INLINE:
+            case CORO_ORDERED:
+            case CORO_UNORDERED:
                 {
                     boost::shared_ptr<typename http_conn_cache_t<context_t>::http_conn_t> conn =
                         http_conn_cache.find(conn_id);
@@ -367,9 +520,6 @@ void protob_server_t<request_t, response_t, context_t>::handle(const http_req_t
                     }
                 }
                 break;
-            case CORO_ORDERED:
-            case CORO_UNORDERED:
-                crash("unimplemented");
             default:
                 crash("unreachable");
                 break;
@@ -67,7 +67,24 @@ protected:
     virtual ~namespace_interface_t() { }
 };
 
-/* Regions contained in region_map_t must never intersect. */
+/* Calls `cb(pair, intersection)` for each pair in `[begin, end)` whose region
+intersects `region`.  The pairs' regions are sorted and never intersect.  This one
+looks at every pair; region types whose order says more overload it (see
+`hash_region_t`). */
+template <class region_t, class iterator_t, class callable_t>
+void region_map_visit_sorted(iterator_t begin, iterator_t end, const region_t &region,
+                             const callable_t &cb) {
+    for (iterator_t it = begin; it != end; ++it) {
+        region_t ixn = region_intersection(it->first, region);
+        if (!region_is_empty(ixn)) {
+            cb(*it, ixn);
+        }
+    }
+}
+
+/* Regions contained in region_map_t must never intersect.  The pairs are kept
+sorted by region, so that `visit_mask()`, `mask()` and `update()` only have to look
+at the pairs that intersect the region they're given. */
 template<class protocol_t, class value_t>
 class region_map_t {
 private:
@@ -75,6 +92,7 @@ private:
     typedef std::vector<internal_pair_t> internal_vec_t;
 public:
     typedef typename internal_vec_t::const_iterator const_iterator;
+    /* Only the values may be changed through an `iterator`. */
     typedef typename internal_vec_t::iterator iterator;
 
     /* I got the ypedefs like a std::map. */
@@ -93,6 +111,7 @@ public:
     region_map_t(const input_iterator_t &_begin, const input_iterator_t &_end)
         : regions_and_values(_begin, _end)
     {
+        sort_pairs(regions_and_values.begin(), regions_and_values.end());
         DEBUG_ONLY(get_domain());
     }
 
@@ -124,14 +143,38 @@ public:
         return regions_and_values.end();
     }
 
+    /* Calls `cb(subregion, value)` for each part of `region` that the map has a
+    value for, without copying the map like `mask()` does. */
+    template <class callable_t>
+    void visit_mask(const typename protocol_t::region_t &region,
+                    const callable_t &cb) const {
+        region_map_visit_sorted(regions_and_values.begin(), regions_and_values.end(),
+                                region,
+                                [&](const internal_pair_t &pair,
+                                    const typename protocol_t::region_t &ixn) {
+                                    cb(ixn, pair.second);
+                                });
+    }
+
+    /* Calls `cb(region, value)` for each pair whose region intersects `region`, with
+    the pair's whole region. */
+    template <class callable_t>
+    void visit_intersecting(const typename protocol_t::region_t &region,
+                            const callable_t &cb) const {
+        region_map_visit_sorted(regions_and_values.begin(), regions_and_values.end(),
+                                region,
+                                [&](const internal_pair_t &pair,
+                                    const typename protocol_t::region_t &) {
+                                    cb(pair.first, pair.second);
+                                });
+    }
+
     MUST_USE region_map_t mask(typename protocol_t::region_t region) const {
         internal_vec_t masked_pairs;
-        for (size_t i = 0; i < regions_and_values.size(); ++i) {
-            typename protocol_t::region_t ixn = region_intersection(regions_and_values[i].first, region);
-            if (!region_is_empty(ixn)) {
-                masked_pairs.push_back(internal_pair_t(ixn, regions_and_values[i].second));
-            }
-        }
+        visit_mask(region, [&](const typename protocol_t::region_t &ixn,
+                               const value_t &value) {
+            masked_pairs.push_back(internal_pair_t(ixn, value));
+        });
         return region_map_t(masked_pairs.begin(), masked_pairs.end());
     }
 
@@ -139,23 +182,42 @@ public:
     void update(const region_map_t& new_values) {
         rassert(region_is_superset(get_domain(), new_values.get_domain()), "Update cannot expand the domain of a region_map.");
         std::vector<typename protocol_t::region_t> overlay_regions;
+        std::vector<bool> overlaid(regions_and_values.size(), false);
         for (const_iterator i = new_values.begin(); i != new_values.end(); ++i) {
             overlay_regions.push_back(i->first);
+            region_map_visit_sorted(regions_and_values.begin(), regions_and_values.end(),
+                                    i->first,
+                                    [&](const internal_pair_t &pair,
+                                        const typename protocol_t::region_t &) {
+                                        overlaid[&pair - regions_and_values.data()] = true;
+                                    });
         }
 
+        // The pairs that don't intersect `new_values` stay as they are, and in order.
         internal_vec_t updated_pairs;
-        for (const_iterator i = begin(); i != end(); ++i) {
-            typename protocol_t::region_t old = i->first;
-            std::vector<typename protocol_t::region_t> old_subregions = region_subtract_many(old, overlay_regions);
-
-            // Insert the unchanged parts of the old region into updated_pairs with the old value
-            for (typename std::vector<typename protocol_t::region_t>::const_iterator j = old_subregions.begin(); j != old_subregions.end(); ++j) {
-                updated_pairs.push_back(internal_pair_t(*j, i->second));
+        updated_pairs.reserve(regions_and_values.size() + new_values.size());
+        for (size_t i = 0; i < regions_and_values.size(); ++i) {
+            if (!overlaid[i]) {
+                updated_pairs.push_back(std::move(regions_and_values[i]));
+            }
+        }
+        const size_t num_kept = updated_pairs.size();
+        for (size_t i = 0; i < regions_and_values.size(); ++i) {
+            if (overlaid[i]) {
+                std::vector<typename protocol_t::region_t> old_subregions
+                    = region_subtract_many(regions_and_values[i].first, overlay_regions);
+                // Insert the unchanged parts of the old region into updated_pairs with the old value
+                for (typename std::vector<typename protocol_t::region_t>::const_iterator j = old_subregions.begin(); j != old_subregions.end(); ++j) {
+                    updated_pairs.push_back(internal_pair_t(*j, regions_and_values[i].second));
+                }
             }
         }
         std::copy(new_values.begin(), new_values.end(), std::back_inserter(updated_pairs));
 
-        regions_and_values = updated_pairs;
+        sort_pairs(updated_pairs.begin() + num_kept, updated_pairs.end());
+        std::inplace_merge(updated_pairs.begin(), updated_pairs.begin() + num_kept,
+                           updated_pairs.end(), &pair_less);
+        regions_and_values.swap(updated_pairs);
     }
 
     void set(const typename protocol_t::region_t &r, const value_t &v) {
@@ -173,9 +235,30 @@ public:
         return regions_and_values[n];
     }
 
+    friend class write_message_t;
+    void rdb_serialize(write_message_t &msg /* NOLINT */) const {
+        msg << regions_and_values;
+    }
+    friend class archive_deserializer_t;
+    archive_result_t rdb_deserialize(read_stream_t *s) {
+        archive_result_t res = deserialize(s, &regions_and_values);
+        if (bad(res)) { return res; }
+        // Maps written before the pairs were kept in order aren't sorted.
+        sort_pairs(regions_and_values.begin(), regions_and_values.end());
+        return res;
+    }
+
 private:
+    static bool pair_less(const internal_pair_t &a, const internal_pair_t &b) {
+        return a.first < b.first;
+    }
+
+    static void sort_pairs(typename internal_vec_t::iterator _begin,
+                           typename internal_vec_t::iterator _end) {
+        std::sort(_begin, _end, &pair_less);
+    }
+
     internal_vec_t regions_and_values;
-    RDB_MAKE_ME_SERIALIZABLE_1(regions_and_values);
 };
 
 template <class P, class V>
@@ -335,14 +418,18 @@ struct write_token_pair_t {
 //    hard durability.
 //  - DURABILITY_REQUIREMENT_SOFT: Override the table's durability settings with
 //    soft durability.
+//  - DURABILITY_REQUIREMENT_GROUP_SOFT: Like soft durability, but the write is
+//    flushed together with the other group-soft writes that came in at most
+//    the cache's group_soft_loss_window_ms earlier.
 enum durability_requirement_t { DURABILITY_REQUIREMENT_DEFAULT,
                                 DURABILITY_REQUIREMENT_HARD,
-                                DURABILITY_REQUIREMENT_SOFT };
+                                DURABILITY_REQUIREMENT_SOFT,
+                                DURABILITY_REQUIREMENT_GROUP_SOFT };
 
 ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(durability_requirement_t,
                                       int8_t,
                                       DURABILITY_REQUIREMENT_DEFAULT,
-                                      DURABILITY_REQUIREMENT_SOFT);
+                                      DURABILITY_REQUIREMENT_GROUP_SOFT);
 
 template <class protocol_t>
 class store_view_t : public home_thread_mixin_t {
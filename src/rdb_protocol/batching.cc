@@ -2,6 +2,8 @@
 
 #include "rdb_protocol/batching.hpp"
 
+#include <algorithm>
+
 #include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/error.hpp"
@@ -17,6 +19,8 @@ static const int64_t DEFAULT_MAX_DURATION = 500 * 1000;
 // for an explanation.
 static const int64_t DIVISOR_SCALING_FACTOR = 8;
 static const int64_t SCALE_CONSTANT = 8;
+// See `batch_history_t`.
+static const int64_t MAX_BATCH_GROWTH = 8;
 
 batchspec_t::batchspec_t(
     batch_type_t _batch_type,
@@ -137,6 +141,22 @@ batchspec_t batchspec_t::scale_down(int64_t divisor) const {
                        first_scaledown_factor, end_time);
 }
 
+batchspec_t batchspec_t::scale_up(int64_t multiplier) const {
+    r_sanity_check(multiplier >= 1);
+    int64_t new_max_els =
+        max_els > std::numeric_limits<decltype(batchspec_t().max_els)>::max()
+                  / multiplier
+            ? std::numeric_limits<decltype(batchspec_t().max_els)>::max()
+            : max_els * multiplier;
+    int64_t new_max_size =
+        max_size > std::numeric_limits<decltype(batchspec_t().max_size)>::max()
+                   / multiplier
+            ? std::numeric_limits<decltype(batchspec_t().max_size)>::max()
+            : max_size * multiplier;
+    return batchspec_t(batch_type, min_els, new_max_els, new_max_size,
+                       first_scaledown_factor, end_time);
+}
+
 batcher_t batchspec_t::to_batcher() const {
     int64_t real_min_els =
         batch_type != batch_type_t::NORMAL_FIRST
@@ -183,6 +203,24 @@ batcher_t::batcher_t(
       size_left(max_size),
       end_time(_end_time) { }
 
+batchspec_t batch_history_t::next_batchspec(env_t *env) const {
+    if (batches == 0) {
+        return batchspec_t::user(batch_type_t::NORMAL_FIRST, env);
+    }
+    return batchspec_t::user(batch_type_t::NORMAL, env).scale_up(growth);
+}
+
+void batch_history_t::note_batch(const batchspec_t &batchspec, microtime_t start) {
+    batches += 1;
+    const microtime_t end_time = batchspec.get_end_time();
+    const microtime_t duration = current_microtime() - start;
+    if (end_time > start && duration > (end_time - start) / 2) {
+        growth = std::max<int64_t>(1, growth / 2);
+    } else {
+        growth = std::min<int64_t>(MAX_BATCH_GROWTH, growth * 2);
+    }
+}
+
 size_t array_size_limit() { return 100000; }
 
 } // namespace ql
@@ -75,6 +75,9 @@ public:
     batchspec_t with_new_batch_type(batch_type_t new_batch_type) const;
     batchspec_t with_at_most(uint64_t max_els) const;
     batchspec_t scale_down(int64_t divisor) const;
+    // Allows `multiplier` times as many elements and bytes.
+    batchspec_t scale_up(int64_t multiplier) const;
+    microtime_t get_end_time() const { return end_time; }
     batcher_t to_batcher() const;
     RDB_MAKE_ME_SERIALIZABLE_6(batch_type, min_els, max_els, max_size, \
                                first_scaledown_factor, end_time);
@@ -90,6 +93,24 @@ private:
     microtime_t end_time;
 };
 
+// Picks the batches of a stream that a client reads a batch at a time.  The first
+// one is small, so that it comes back fast.  After that, each time the client asks
+// for more, the batch may hold twice as much as the last one (up to
+// `MAX_BATCH_GROWTH` times the normal size) as long as the last one took less
+// than half of its time limit; if it took longer, the next one is half as big.
+// Small rows then take fewer round trips, while the time limit still caps each
+// batch's latency.
+class batch_history_t {
+public:
+    batch_history_t() : batches(0), growth(1) { }
+    batchspec_t next_batchspec(env_t *env) const;
+    // `start` is when the batch from `batchspec` was started.
+    void note_batch(const batchspec_t &batchspec, microtime_t start);
+private:
+    uint64_t batches;
+    int64_t growth;
+};
+
 // TODO: make user-tunable.
 size_t array_size_limit();
 
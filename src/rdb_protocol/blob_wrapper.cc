@@ -39,3 +39,11 @@ void rdb_blob_wrapper_t::expose_all(
         "Other blocks might be referencing this blob, it's invalid to modify it in place.");
     internal.expose_all(parent, mode, buffer_group_out, acq_group_out);
 }
+
+void rdb_blob_wrapper_t::expose_region(
+        buf_parent_t parent, int64_t offset, int64_t size,
+        buffer_group_t *buffer_group_out,
+        blob_acq_t *acq_group_out) {
+    internal.expose_region(parent, access_t::read, offset, size,
+                           buffer_group_out, acq_group_out);
+}
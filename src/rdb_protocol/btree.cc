@@ -1,10 +1,13 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/btree.hpp"
 
+#include <algorithm>
 #include <functional>
+#include <iterator>
 #include <string>
 #include <vector>
 
+#include "arch/timing.hpp"
 #include "btree/backfill.hpp"
 #include "btree/concurrent_traversal.hpp"
 #include "btree/erase_range.hpp"
@@ -12,14 +15,17 @@
 #include "btree/operations.hpp"
 #include "btree/parallel_traversal.hpp"
 #include "buffer_cache/alt/alt_serialize_onto_blob.hpp"
+#include "config/args.hpp"
 #include "containers/archive/boost_types.hpp"
 #include "containers/archive/buffer_group_stream.hpp"
 #include "containers/archive/vector_stream.hpp"
 #include "containers/scoped.hpp"
 #include "rdb_protocol/blob_wrapper.hpp"
+#include "rdb_protocol/changefeed.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/lazy_json.hpp"
 #include "rdb_protocol/shards.hpp"
+#include "time.hpp"
 
 value_sizer_t<rdb_value_t>::value_sizer_t(block_size_t bs) : block_size_(bs) { }
 
@@ -36,7 +42,7 @@ bool value_sizer_t<rdb_value_t>::fits(const void *value, int length_available) c
 }
 
 int value_sizer_t<rdb_value_t>::max_possible_size() const {
-    return blob::btree_maxreflen;
+    return rdb_value_maxreflen(block_size_);
 }
 
 block_magic_t value_sizer_t<rdb_value_t>::leaf_magic() {
@@ -51,15 +57,17 @@ block_magic_t value_sizer_t<rdb_value_t>::btree_leaf_magic() const {
 block_size_t value_sizer_t<rdb_value_t>::block_size() const { return block_size_; }
 
 bool btree_value_fits(block_size_t bs, int data_length, const rdb_value_t *value) {
-    return blob::ref_fits(bs, data_length, value->value_ref(), blob::btree_maxreflen);
+    return blob::ref_fits(bs, data_length, value->value_ref(),
+                          rdb_value_maxreflen(bs));
 }
 
 // Remember that secondary indexes and the main btree both point to the same rdb
 // value -- you don't want to double-delete that value!
 void actually_delete_rdb_value(buf_parent_t parent, void *value) {
-    blob_t blob(parent.cache()->get_block_size(),
+    const block_size_t block_size = parent.cache()->get_block_size();
+    blob_t blob(block_size,
                 static_cast<rdb_value_t *>(value)->value_ref(),
-                blob::btree_maxreflen);
+                rdb_value_maxreflen(block_size));
     blob.clear(parent);
 }
 
@@ -67,15 +75,24 @@ void detach_rdb_value(buf_parent_t parent, const void *value) {
     // This const_cast is ok, since `detach_subtrees` is one of the operations
     // that does not actually change value.
     void *non_const_value = const_cast<void *>(value);
-    blob_t blob(parent.cache()->get_block_size(),
+    const block_size_t block_size = parent.cache()->get_block_size();
+    blob_t blob(block_size,
                 static_cast<rdb_value_t *>(non_const_value)->value_ref(),
-                blob::btree_maxreflen);
+                rdb_value_maxreflen(block_size));
     blob.detach_subtrees(parent);
 }
 
 void rdb_get(const store_key_t &store_key, btree_slice_t *slice,
              superblock_t *superblock, point_read_response_t *response,
              profile::trace_t *trace) {
+    if (!slice->key_filter.may_contain(store_key.btree_key())) {
+        slice->stats.pm_keys_read.record();
+        slice->stats.pm_keys_filtered.record();
+        superblock->release();
+        response->data.reset(new ql::datum_t(ql::datum_t::R_NULL));
+        return;
+    }
+
     keyvalue_location_t<rdb_value_t> kv_location;
     find_keyvalue_location_for_read(superblock, store_key.btree_key(), &kv_location,
                                     &slice->stats, trace);
@@ -88,6 +105,42 @@ void rdb_get(const store_key_t &store_key, btree_slice_t *slice,
     }
 }
 
+class batched_get_callback_t : public multi_key_read_callback_t<rdb_value_t> {
+public:
+    batched_get_callback_t(const std::vector<store_key_t> *_keys,
+                           batched_point_read_response_t *_response)
+        : keys(_keys), response(_response) { }
+    void on_value(size_t i, const rdb_value_t *value, buf_lock_t *leaf) {
+        response->rows[(*keys)[i]] = get_data(value, buf_parent_t(leaf));
+    }
+private:
+    const std::vector<store_key_t> *keys;
+    batched_point_read_response_t *response;
+};
+
+void rdb_get_batch(const std::vector<store_key_t> &keys, btree_slice_t *slice,
+                   superblock_t *superblock, batched_point_read_response_t *response,
+                   profile::trace_t *trace) {
+    // Keys the filter rules out just don't get rows.
+    std::vector<store_key_t> maybe_present;
+    maybe_present.reserve(keys.size());
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        if (slice->key_filter.may_contain(it->btree_key())) {
+            maybe_present.push_back(*it);
+        } else {
+            slice->stats.pm_keys_read.record();
+            slice->stats.pm_keys_filtered.record();
+        }
+    }
+    std::vector<const btree_key_t *> btree_keys;
+    btree_keys.reserve(maybe_present.size());
+    for (auto it = maybe_present.begin(); it != maybe_present.end(); ++it) {
+        btree_keys.push_back(it->btree_key());
+    }
+    batched_get_callback_t cb(&maybe_present, response);
+    find_keyvalue_locations_for_read(superblock, btree_keys, &cb, &slice->stats, trace);
+}
+
 void kv_location_delete(keyvalue_location_t<rdb_value_t> *kv_location,
                         const store_key_t &key,
                         repli_timestamp_t timestamp,
@@ -124,13 +177,16 @@ void kv_location_set(keyvalue_location_t<rdb_value_t> *kv_location,
                      repli_timestamp_t timestamp,
                      const deletion_context_t *deletion_context,
                      rdb_modification_info_t *mod_info_out) {
-    scoped_malloc_t<rdb_value_t> new_value(blob::btree_maxreflen);
-    memset(new_value.get(), 0, blob::btree_maxreflen);
-
     const block_size_t block_size = kv_location->buf.cache()->get_block_size();
+    const int maxreflen = rdb_value_maxreflen(block_size);
+    scoped_malloc_t<rdb_value_t> new_value(maxreflen);
+    memset(new_value.get(), 0, maxreflen);
+
     {
-        blob_t blob(block_size, new_value->value_ref(), blob::btree_maxreflen);
-        serialize_onto_blob(buf_parent_t(&kv_location->buf), &blob, data);
+        blob_t blob(block_size, new_value->value_ref(), maxreflen);
+        write_message_t wm;
+        ql::serialize_for_storage(&wm, data);
+        write_onto_blob(buf_parent_t(&kv_location->buf), &blob, wm);
     }
 
     if (mod_info_out) {
@@ -180,38 +236,30 @@ void kv_location_set(keyvalue_location_t<rdb_value_t> *kv_location,
                           deletion_context->balancing_detacher(), &null_cb);
 }
 
-batched_replace_response_t rdb_replace_and_return_superblock(
-    const btree_loc_info_t &info,
+// Replaces the value of `key`, which `kv_location` has been found for.
+batched_replace_response_t rdb_replace_at_location(
+    keyvalue_location_t<rdb_value_t> *kv_location,
+    const btree_info_t &info,
+    const store_key_t &key,
     const btree_point_replacer_t *replacer,
     const deletion_context_t *deletion_context,
-    promise_t<superblock_t *> *superblock_promise,
-    rdb_modification_info_t *mod_info_out,
-    profile::trace_t *trace)
+    rdb_modification_info_t *mod_info_out)
 {
     bool return_vals = replacer->should_return_vals();
-    const std::string &primary_key = *info.btree->primary_key;
-    const store_key_t &key = *info.key;
+    const std::string &primary_key = *info.primary_key;
     ql::datum_ptr_t resp(ql::datum_t::R_OBJECT);
     try {
-        keyvalue_location_t<rdb_value_t> kv_location;
-        find_keyvalue_location_for_write(info.superblock, info.key->btree_key(),
-                                         deletion_context->balancing_detacher(),
-                                         &kv_location,
-                                         &info.btree->slice->stats,
-                                         trace,
-                                         superblock_promise);
-
         bool started_empty, ended_empty;
         counted_t<const ql::datum_t> old_val;
-        if (!kv_location.value.has()) {
+        if (!kv_location->value.has()) {
             // If there's no entry with this key, pass NULL to the function.
             started_empty = true;
             old_val = make_counted<ql::datum_t>(ql::datum_t::R_NULL);
         } else {
             // Otherwise pass the entry with this key to the function.
             started_empty = false;
-            old_val = get_data(kv_location.value.get(),
-                               buf_parent_t(&kv_location.buf));
+            old_val = get_data(kv_location->value.get(),
+                               buf_parent_t(&kv_location->buf));
             guarantee(old_val->get(primary_key, ql::NOTHROW).has());
         }
         guarantee(old_val.has());
@@ -261,8 +309,8 @@ batched_replace_response_t rdb_replace_and_return_superblock(
             } else {
                 conflict = resp.add("inserted", make_counted<ql::datum_t>(1.0));
                 r_sanity_check(new_val->get(primary_key, ql::NOTHROW).has());
-                kv_location_set(&kv_location, *info.key, new_val, 
-                                info.btree->timestamp, deletion_context,
+                kv_location_set(kv_location, key, new_val,
+                                info.timestamp, deletion_context,
                                 mod_info_out);
                 guarantee(mod_info_out->deleted.second.empty());
                 guarantee(!mod_info_out->added.second.empty());
@@ -271,7 +319,7 @@ batched_replace_response_t rdb_replace_and_return_superblock(
         } else {
             if (ended_empty) {
                 conflict = resp.add("deleted", make_counted<ql::datum_t>(1.0));
-                kv_location_delete(&kv_location, *info.key, info.btree->timestamp,
+                kv_location_delete(kv_location, key, info.timestamp,
                                    deletion_context, mod_info_out);
                 guarantee(!mod_info_out->deleted.second.empty());
                 guarantee(mod_info_out->added.second.empty());
@@ -285,8 +333,8 @@ batched_replace_response_t rdb_replace_and_return_superblock(
                 } else {
                     conflict = resp.add("replaced", make_counted<ql::datum_t>(1.0));
                     r_sanity_check(new_val->get(primary_key, ql::NOTHROW).has());
-                    kv_location_set(&kv_location, *info.key, new_val,
-                                    info.btree->timestamp, deletion_context,
+                    kv_location_set(kv_location, key, new_val,
+                                    info.timestamp, deletion_context,
                                     mod_info_out);
                     guarantee(!mod_info_out->deleted.second.empty());
                     guarantee(!mod_info_out->added.second.empty());
@@ -324,33 +372,58 @@ private:
     const size_t index;
 };
 
-void do_a_replace_from_batched_replace(
+// Replaces the run of keys `keys[order[begin]]`, `keys[order[begin + 1]]`, ... that
+// go in the same leaf, with one walk down the tree and one acquisition of the leaf.
+// The end of the run (as the leaf's parent has it before anything changes) and the
+// superblock are passed on as soon as they're known, so that the next run can get
+// started.  Keys at the end of the run that the leaf can't take after all (because a
+// split filled up the parent, say) are left out of `done`, for another round.
+void do_a_leaf_from_batched_replace(
     auto_drainer_t::lock_t,
-    fifo_enforcer_sink_t *batched_replaces_fifo_sink,
-    const fifo_enforcer_write_token_t &batched_replaces_fifo_token,
-    const btree_loc_info_t &info,
-    const one_replace_t one_replace,
+    const btree_info_t *info,
+    superblock_t *superblock,
+    const std::vector<store_key_t> *keys,
+    const std::vector<size_t> *order,
+    size_t begin,
+    const btree_batched_replacer_t *replacer,
     promise_t<superblock_t *> *superblock_promise,
-    rdb_modification_report_cb_t *sindex_cb,
+    promise_t<size_t> *end_promise,
+    std::vector<rdb_modification_report_t> *mod_reports,
+    std::vector<bool> *done,
     batched_replace_response_t *stats_out,
     profile::trace_t *trace)
 {
-    fifo_enforcer_sink_t::exit_write_t exiter(
-        batched_replaces_fifo_sink, batched_replaces_fifo_token);
-
     rdb_live_deletion_context_t deletion_context;
-    rdb_modification_report_t mod_report(*info.key);
-    counted_t<const ql::datum_t> res = rdb_replace_and_return_superblock(
-        info, &one_replace, &deletion_context, superblock_promise, &mod_report.info,
-        trace);
-    *stats_out = (*stats_out)->merge(res, ql::stats_merge);
-
-    // KSI: What is this for?  are we waiting to get in line to call on_mod_report?
-    // I guess so.
-
-    // JD: Looks like this is a do_a_replace_from_batched_replace specific thing.
-    exiter.wait();
-    sindex_cb->on_mod_report(mod_report);
+    keyvalue_location_t<rdb_value_t> kv_location;
+    find_keyvalue_location_for_write(superblock, (*keys)[(*order)[begin]].btree_key(),
+                                     deletion_context.balancing_detacher(),
+                                     &kv_location,
+                                     &info->slice->stats,
+                                     trace,
+                                     superblock_promise);
+
+    size_t end = begin + 1;
+    while (end < order->size()
+           && keyvalue_location_holds_key(&kv_location,
+                                          (*keys)[(*order)[end]].btree_key())) {
+        ++end;
+    }
+    end_promise->pulse(end);
+
+    for (size_t i = begin; i < end; ++i) {
+        const size_t index = (*order)[i];
+        if (i != begin
+            && !move_keyvalue_location_for_write(&kv_location,
+                                                 (*keys)[index].btree_key())) {
+            break;
+        }
+        const one_replace_t one_replace(replacer, index);
+        counted_t<const ql::datum_t> res = rdb_replace_at_location(
+            &kv_location, *info, (*keys)[index], &one_replace, &deletion_context,
+            &(*mod_reports)[index].info);
+        *stats_out = (*stats_out)->merge(res, ql::stats_merge);
+        (*done)[index] = true;
+    }
 }
 
 batched_replace_response_t rdb_batched_replace(
@@ -361,39 +434,81 @@ batched_replace_response_t rdb_batched_replace(
     rdb_modification_report_cb_t *sindex_cb,
     profile::trace_t *trace) {
 
-    fifo_enforcer_source_t batched_replaces_fifo_source;
-    fifo_enforcer_sink_t batched_replaces_fifo_sink;
+    // We still hold the superblock, so reads that come after this write will find
+    // the keys in the filter.
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        info.slice->key_filter.note_key(it->btree_key());
+    }
+
+    // The keys are replaced in order, so that the ones that go in the same leaf come
+    // one after the other.  A key that's in `keys` twice is still replaced in the
+    // order it was given.
+    std::vector<size_t> key_order(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        key_order[i] = i;
+    }
+    std::stable_sort(key_order.begin(), key_order.end(),
+                     [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
+
+    std::vector<rdb_modification_report_t> mod_reports;
+    mod_reports.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        mod_reports.emplace_back(keys[i]);
+    }
+    std::vector<bool> done(keys.size(), false);
 
     counted_t<const ql::datum_t> stats(new ql::datum_t(ql::datum_t::R_OBJECT));
 
-    // We have to drain write operations before destructing everything above us,
-    // because the coroutines being drained use them.
-    {
-        auto_drainer_t drainer;
-        // Note the destructor ordering: We release the superblock before draining
-        // on all the write operations.
-        scoped_ptr_t<superblock_t> current_superblock(superblock->release());
-        for (size_t i = 0; i < keys.size(); ++i) {
-            // Pass out the point_replace_response_t.
-            promise_t<superblock_t *> superblock_promise;
-            coro_t::spawn_sometime(
-                std::bind(
-                    &do_a_replace_from_batched_replace,
-                    auto_drainer_t::lock_t(&drainer),
-                    &batched_replaces_fifo_sink,
-                    batched_replaces_fifo_source.enter_write(),
-
-                    btree_loc_info_t(&info, current_superblock.release(), &keys[i]),
-                    one_replace_t(replacer, i),
-
-                    &superblock_promise,
-                    sindex_cb,
-                    &stats,
-                    trace));
-
-            current_superblock.init(superblock_promise.wait());
+    scoped_ptr_t<superblock_t> current_superblock(superblock->release());
+    std::vector<size_t> order = key_order;
+    while (!order.empty()) {
+        // We have to drain write operations before going on, because the coroutines
+        // being drained use everything above.
+        {
+            auto_drainer_t drainer;
+            for (size_t begin = 0; begin < order.size();) {
+                promise_t<superblock_t *> superblock_promise;
+                promise_t<size_t> end_promise;
+                coro_t::spawn_sometime(
+                    std::bind(
+                        &do_a_leaf_from_batched_replace,
+                        auto_drainer_t::lock_t(&drainer),
+                        &info,
+                        current_superblock.release(),
+                        &keys,
+                        &order,
+                        begin,
+                        replacer,
+                        &superblock_promise,
+                        &end_promise,
+                        &mod_reports,
+                        &done,
+                        &stats,
+                        trace));
+
+                begin = end_promise.wait();
+                current_superblock.init(superblock_promise.wait());
+            }
+        }
+
+        // Every run got at least its first key in, so this gets shorter.
+        std::vector<size_t> rest;
+        for (auto it = order.begin(); it != order.end(); ++it) {
+            if (!done[*it]) {
+                rest.push_back(*it);
+            }
         }
-    } // Make sure the drainer is destructed before the return statement.
+        order.swap(rest);
+    }
+    current_superblock.reset();
+
+    // The secondary indexes are updated for the whole batch at once, in key order.
+    std::vector<rdb_modification_report_t> sorted_mod_reports;
+    sorted_mod_reports.reserve(keys.size());
+    for (auto it = key_order.begin(); it != key_order.end(); ++it) {
+        sorted_mod_reports.push_back(std::move(mod_reports[*it]));
+    }
+    sindex_cb->on_mod_reports(sorted_mod_reports);
     return stats;
 }
 
@@ -408,6 +523,7 @@ void rdb_set(const store_key_t &key,
              rdb_modification_info_t *mod_info,
              profile::trace_t *trace,
              promise_t<superblock_t *> *pass_back_superblock) {
+    slice->key_filter.note_key(key.btree_key());
     keyvalue_location_t<rdb_value_t> kv_location;
     find_keyvalue_location_for_write(superblock, key.btree_key(),
                                      deletion_context->balancing_detacher(),
@@ -636,6 +752,7 @@ void rdb_erase_major_range(key_tester_t *tester,
                            buf_lock_t *sindex_block,
                            superblock_t *superblock,
                            btree_store_t<rdb_protocol_t> *store,
+                           background_subtree_eraser_t *subtree_eraser,
                            signal_t *interruptor) {
 
     /* Dispatch the erase range to the sindexes. */
@@ -685,6 +802,16 @@ void rdb_erase_major_range(key_tester_t *tester,
     /* Actually delete the values */
     rdb_value_deleter_t deleter;
 
+    /* If every key in the range goes, whole subtrees can be unlinked now and freed
+     * in the background, leaving only the nodes along the range's edges for the
+     * traversal below. */
+    if (subtree_eraser != NULL && tester->erases_every_key()) {
+        btree_detach_erased_subtrees(sizer,
+            left_key_supplied ? left_key_exclusive.btree_key() : NULL,
+            right_key_supplied ? right_key_inclusive.btree_key() : NULL,
+            superblock, subtree_eraser);
+    }
+
     btree_erase_range_generic(sizer, tester, &deleter,
         left_key_supplied ? left_key_exclusive.btree_key() : NULL,
         right_key_supplied ? right_key_inclusive.btree_key() : NULL,
@@ -755,13 +882,18 @@ public:
     sindex_data_t(const key_range_t &_pkey_range, const datum_range_t &_range,
                   ql::map_wire_func_t wire_func, sindex_multi_bool_t _multi)
         : pkey_range(_pkey_range), range(_range),
-          func(wire_func.compile_wire_func()), multi(_multi) { }
+          func(wire_func.compile_wire_func()), multi(_multi) {
+        is_field = func->is_get_field_of_arg(&field);
+    }
 private:
     friend class rget_cb_t;
     const key_range_t pkey_range;
     const datum_range_t range;
     const counted_t<ql::func_t> func;
     const sindex_multi_bool_t multi;
+    // Whether `func` just gets `field` of the row.
+    bool is_field;
+    std::string field;
 };
 
 class job_data_t {
@@ -780,11 +912,18 @@ public:
             transformers.emplace_back(ql::make_op(env, _transforms[i]));
         }
         guarantee(transformers.size() == _transforms.size());
+        const ql::project_wire_func_t *projection = _transforms.empty()
+            ? NULL
+            : boost::get<ql::project_wire_func_t>(&_transforms[0]);
+        projects_fields = projection != NULL
+            && projection->needed_fields(&projected_fields);
     }
     job_data_t(job_data_t &&jd)
         : env(jd.env),
           batcher(std::move(jd.batcher)),
           transformers(std::move(jd.transformers)),
+          projects_fields(jd.projects_fields),
+          projected_fields(std::move(jd.projected_fields)),
           sorting(jd.sorting),
           accumulator(jd.accumulator.release()) {
     }
@@ -793,6 +932,10 @@ private:
     ql::env_t *const env;
     ql::batcher_t batcher;
     std::vector<scoped_ptr_t<ql::op_t> > transformers;
+    // True if the first transformation is a projection that only reads the
+    // (top-level) fields in `projected_fields`, so that's all we have to load.
+    bool projects_fields;
+    std::vector<std::string> projected_fields;
     sorting_t sorting;
     scoped_ptr_t<ql::accumulator_t> accumulator;
 };
@@ -852,6 +995,24 @@ void rget_cb_t::finish() THROWS_ONLY(interrupted_exc_t) {
     }
 }
 
+// Returns an object with just the given fields of the row (the ones it has).
+// `fields` must be sorted.
+counted_t<const ql::datum_t> get_row_fields(const lazy_json_t &row,
+                                            const std::vector<std::string> &fields) {
+    std::vector<ql::datum_object_t::value_type> pairs;
+    pairs.reserve(fields.size());
+    for (auto it = fields.begin(); it != fields.end(); ++it) {
+        counted_t<const ql::datum_t> field = row.get_field(*it);
+        if (field.has()) {
+            pairs.push_back(std::make_pair(*it, std::move(field)));
+        }
+    }
+    ql::datum_object_t object;
+    std::string duplicate_key;
+    guarantee(object.assign(std::move(pairs), &duplicate_key));
+    return make_counted<const ql::datum_t>(std::move(object));
+}
+
 // Handle a keyvalue pair.  Returns whether or not we're done early.
 done_traversing_t rget_cb_t::handle_pair(scoped_key_value_t &&keyvalue,
                               concurrent_traversal_fifo_enforcer_signal_t waiter)
@@ -867,12 +1028,33 @@ THROWS_ONLY(interrupted_exc_t) {
     if (sindex && !sindex->pkey_range.contains_key(ql::datum_t::extract_primary(key))) {
         return done_traversing_t::NO;
     }
+    ++io.response->rows_scanned;
 
     lazy_json_t row(static_cast<const rdb_value_t *>(keyvalue.value()),
                     keyvalue.expose_buf());
     counted_t<const ql::datum_t> val;
-    // We only load the value if we actually use it (`count` does not).
-    if (job.accumulator->uses_val() || job.transformers.size() != 0 || sindex) {
+    const bool uses_val = job.accumulator->uses_val() || job.transformers.size() != 0;
+    // Most sindex keys hold the whole index value, so we don't have to get it from
+    // the row (and `count` doesn't load the row at all).
+    counted_t<const ql::datum_t> sindex_key_val;
+    if (sindex) {
+        sindex_key_val = ql::datum_t::extract_secondary_value(key);
+    }
+    // If all we need from the row (other than what a projection reads) is the
+    // indexed field, we only load that.
+    counted_t<const ql::datum_t> sindex_field;
+    if (sindex && !sindex_key_val.has() && sindex->is_field
+        && (!uses_val || job.projects_fields)) {
+        sindex_field = row.get_field(sindex->field);
+    }
+    const bool have_sindex_val = sindex_key_val.has() || sindex_field.has();
+    if (uses_val && job.projects_fields && (!sindex || have_sindex_val)) {
+        // The projection gives the same result on just the fields it reads.
+        val = get_row_fields(row, job.projected_fields);
+        io.slice->stats.pm_keys_read.record();
+        row.reset();
+    } else if (uses_val || (sindex && !have_sindex_val)) {
+        // We only load the value if we actually use it (`count` does not).
         val = row.get();
         io.slice->stats.pm_keys_read.record();
     } else {
@@ -892,7 +1074,13 @@ THROWS_ONLY(interrupted_exc_t) {
         // Check whether we're out of sindex range.
         counted_t<const ql::datum_t> sindex_val; // NULL if no sindex.
         if (sindex) {
-            sindex_val = sindex->func->call(job.env, val)->as_datum();
+            if (sindex_key_val.has()) {
+                sindex_val = sindex_key_val;
+            } else if (sindex_field.has()) {
+                sindex_val = sindex_field;
+            } else {
+                sindex_val = sindex->func->call(job.env, val)->as_datum();
+            }
             if (sindex->multi == sindex_multi_bool_t::MULTI
                 && sindex_val->get_type() == ql::datum_t::R_ARRAY) {
                 boost::optional<uint64_t> tag = *ql::datum_t::extract_tag(key);
@@ -928,6 +1116,17 @@ THROWS_ONLY(interrupted_exc_t) {
     }
 }
 
+// A terminal only aggregates the rows it sees, so they don't have to reach it in key
+// order, and a row whose blob takes a random read to load doesn't have to hold up
+// the ones behind it.  Streams do need key order, because a batch that fills up ends
+// at the last key it saw, and the next one starts after it.
+traversal_order_t rget_traversal_order(const boost::optional<terminal_variant_t> &terminal,
+                                       sorting_t sorting) {
+    return terminal && sorting == sorting_t::UNORDERED
+        ? traversal_order_t::LOAD_ORDER
+        : traversal_order_t::KEY_ORDER;
+}
+
 // TODO: Having two functions which are 99% the same sucks.
 void rdb_rget_slice(
     btree_slice_t *slice,
@@ -947,7 +1146,8 @@ void rdb_rget_slice(
         boost::optional<sindex_data_t>(),
         range);
     btree_concurrent_traversal(superblock, range, &callback,
-                               (!reversed(sorting) ? FORWARD : BACKWARD));
+                               (!reversed(sorting) ? FORWARD : BACKWARD),
+                               rget_traversal_order(terminal, sorting));
     callback.finish();
 }
 
@@ -974,7 +1174,8 @@ void rdb_rget_secondary_slice(
         sindex_region.inner);
     btree_concurrent_traversal(
         superblock, sindex_region.inner, &callback,
-        (!reversed(sorting) ? FORWARD : BACKWARD));
+        (!reversed(sorting) ? FORWARD : BACKWARD),
+        rget_traversal_order(terminal, sorting));
     callback.finish();
 }
 
@@ -1002,6 +1203,81 @@ void rdb_distribution_get(int max_depth,
     }
 }
 
+void rdb_distribution_sample(size_t sample_size,
+                             const store_key_t &left_key,
+                             superblock_t *superblock,
+                             distribution_read_response_t *response) {
+    const block_size_t block_size = superblock->cache()->get_block_size();
+    int64_t key_count;
+    int64_t byte_count;
+    std::vector<std::pair<store_key_t, int64_t> > samples;
+    get_btree_key_sample(
+        superblock, sample_size,
+        [block_size](const btree_key_t *key, const void *value) -> int64_t {
+            return key->size
+                + static_cast<const rdb_value_t *>(value)->value_size(block_size);
+        },
+        &key_count, &byte_count, &samples);
+
+    if (samples.empty()) {
+        response->key_counts[left_key] = 0;
+        response->byte_counts[left_key] = 0;
+        return;
+    }
+
+    // Each sampled key stands for the same number of keys, and for bytes in
+    // proportion to its own size.  The first range starts at `left_key` rather
+    // than at the first sample.  We round the running totals rather than each
+    // count, so that the counts add up to the totals.
+    int64_t sampled_bytes = 0;
+    for (auto it = samples.begin(); it != samples.end(); ++it) {
+        sampled_bytes += it->second;
+    }
+    const double keys_per_sample
+        = static_cast<double>(key_count) / static_cast<double>(samples.size());
+    const double bytes_per_sampled_byte = sampled_bytes == 0
+        ? 0.0
+        : static_cast<double>(byte_count) / static_cast<double>(sampled_bytes);
+    int64_t keys_so_far = 0;
+    int64_t bytes_so_far = 0;
+    int64_t sampled_bytes_so_far = 0;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const store_key_t &range_left = i == 0 ? left_key : samples[i].first;
+        sampled_bytes_so_far += samples[i].second;
+        const int64_t keys_through_here
+            = static_cast<int64_t>(keys_per_sample * (i + 1) + 0.5);
+        const int64_t bytes_through_here = static_cast<int64_t>(
+            bytes_per_sampled_byte * sampled_bytes_so_far + 0.5);
+        response->key_counts[range_left] = keys_through_here - keys_so_far;
+        response->byte_counts[range_left] = bytes_through_here - bytes_so_far;
+        keys_so_far = keys_through_here;
+        bytes_so_far = bytes_through_here;
+    }
+}
+
+void rdb_sample(size_t sample_size,
+                const key_range_t &range,
+                superblock_t *superblock,
+                sample_read_response_t *response) {
+    std::vector<counted_t<const ql::datum_t> > *rows = &response->rows;
+    get_btree_random_sample(
+        superblock, sample_size, sample_size * SAMPLE_READ_WALKS_PER_ROW,
+        [rows, &range](const btree_key_t *key, const void *value,
+                       buf_lock_t *leaf) -> bool {
+            if (!range.contains_key(key->contents, key->size)) {
+                return false;
+            }
+            rows->push_back(get_data(static_cast<const rdb_value_t *>(value),
+                                     buf_parent_t(leaf)));
+            return true;
+        },
+        &response->key_count);
+
+    // The rows came in the order they were found, which is already random.
+    response->complete = static_cast<int64_t>(rows->size())
+        >= std::min<int64_t>(sample_size, response->key_count);
+}
+
 static const int8_t HAS_VALUE = 0;
 static const int8_t HAS_NO_VALUE = 1;
 
@@ -1051,10 +1327,11 @@ RDB_IMPL_ME_SERIALIZABLE_1(rdb_erase_major_range_report_t, range_to_erase);
 
 rdb_modification_report_cb_t::rdb_modification_report_cb_t(
         btree_store_t<rdb_protocol_t> *store,
+        ql::changefeed::server_t *changefeed_server,
         buf_lock_t *sindex_block,
         auto_drainer_t::lock_t lock)
-    : lock_(lock), store_(store),
-      sindex_block_(sindex_block) {
+    : lock_(lock), store_(store), changefeed_server_(changefeed_server),
+      sindex_block_(sindex_block), txn_(sindex_block->txn()) {
     store_->acquire_post_constructed_sindex_superblocks_for_write(
             sindex_block_, &sindexes_);
 }
@@ -1063,16 +1340,58 @@ rdb_modification_report_cb_t::~rdb_modification_report_cb_t() { }
 
 void rdb_modification_report_cb_t::on_mod_report(
         const rdb_modification_report_t &mod_report) {
+    guarantee(sindex_block_ != NULL, "Only one change can be reported.");
     mutex_t::acq_t acq;
     store_->lock_sindex_queue(sindex_block_, &acq);
 
     write_message_t wm;
     wm << rdb_sindex_change_t(mod_report);
     store_->sindex_queue_push(wm, &acq);
+    release_sindex_block(&acq);
 
     rdb_live_deletion_context_t deletion_context;
-    rdb_update_sindexes(sindexes_, &mod_report, sindex_block_->txn(),
-                        &deletion_context);
+    rdb_update_sindexes(sindexes_, &mod_report, txn_, &deletion_context);
+
+    if (changefeed_server_ != NULL) {
+        changefeed_server_->send_change(mod_report.info.deleted.first,
+                                        mod_report.info.added.first);
+    }
+}
+
+void rdb_modification_report_cb_t::on_mod_reports(
+        const std::vector<rdb_modification_report_t> &mod_reports) {
+    if (mod_reports.empty()) {
+        return;
+    }
+    guarantee(sindex_block_ != NULL, "Only one batch of changes can be reported.");
+    mutex_t::acq_t acq;
+    store_->lock_sindex_queue(sindex_block_, &acq);
+
+    for (auto it = mod_reports.begin(); it != mod_reports.end(); ++it) {
+        write_message_t wm;
+        wm << rdb_sindex_change_t(*it);
+        store_->sindex_queue_push(wm, &acq);
+    }
+    release_sindex_block(&acq);
+
+    rdb_live_deletion_context_t deletion_context;
+    rdb_update_sindexes(sindexes_, mod_reports, txn_, &deletion_context);
+
+    if (changefeed_server_ != NULL) {
+        for (auto it = mod_reports.begin(); it != mod_reports.end(); ++it) {
+            changefeed_server_->send_change(it->info.deleted.first,
+                                            it->info.added.first);
+        }
+    }
+}
+
+void rdb_modification_report_cb_t::release_sindex_block(mutex_t::acq_t *acq) {
+    // The changes are in the sindex queue, and the secondary indexes' superblocks
+    // were acquired in line with the sindex block, so the next write can have the
+    // sindex block (and the queue) while these changes go into the indexes.
+    acq->reset();
+    sindex_block_->reset_buf_lock();
+    sindex_block_ = NULL;
 }
 
 typedef btree_store_t<rdb_protocol_t>::sindex_access_vector_t sindex_access_vector_t;
@@ -1094,18 +1413,126 @@ void compute_keys(const store_key_t &primary_key, counted_t<const ql::datum_t> d
     }
 }
 
-/* Used below by rdb_update_sindexes. */
-void rdb_update_single_sindex(
+/* Used below by update_sindex_for_modification.  Returns the sorted index keys of
+ * `doc`, or no keys if the mapping fails on it (so it isn't in the index). */
+std::vector<store_key_t> compute_sorted_keys(const store_key_t &primary_key,
+                                             counted_t<const ql::datum_t> doc,
+                                             ql::map_wire_func_t *mapping,
+                                             sindex_multi_bool_t multi,
+                                             ql::env_t *env) {
+    std::vector<store_key_t> keys;
+    try {
+        compute_keys(primary_key, doc, mapping, multi, env, &keys);
+    } catch (const ql::base_exc_t &) {
+        keys.clear();
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+/* Used below by rdb_update_single_sindex.  `*super_block_inout` is the superblock of
+ * the secondary index, which gets passed from one change to the next. */
+void update_sindex_for_modification(
         const btree_store_t<rdb_protocol_t>::sindex_access_t *sindex,
         const deletion_context_t *deletion_context,
         const rdb_modification_report_t *modification,
-        auto_drainer_t::lock_t) {
-    // Note if you get this error it's likely that you've passed in a default
-    // constructed mod_report. Don't do that.  Mod reports should always be passed
-    // to a function as an output parameter before they're passed to this
-    // function.
-    guarantee(modification->primary_key.size() != 0);
+        ql::map_wire_func_t *mapping,
+        sindex_multi_bool_t multi,
+        ql::env_t *env,
+        superblock_t **super_block_inout) {
+    superblock_t *super_block = *super_block_inout;
+
+    std::vector<store_key_t> deleted_keys;
+    if (modification->info.deleted.first) {
+        guarantee(!modification->info.deleted.second.empty());
+        deleted_keys = compute_sorted_keys(modification->primary_key,
+                                           modification->info.deleted.first,
+                                           mapping, multi, env);
+    }
+    std::vector<store_key_t> added_keys;
+    if (modification->info.added.first) {
+        added_keys = compute_sorted_keys(modification->primary_key,
+                                         modification->info.added.first,
+                                         mapping, multi, env);
+    }
+
+    // Keys the row had before and still has don't get deleted and reinserted.  Their
+    // entries hold the row's value reference, though, so unless that stayed the same
+    // too they still get overwritten with the new one (one write instead of two).
+    std::vector<store_key_t> keys_to_delete;
+    std::set_difference(deleted_keys.begin(), deleted_keys.end(),
+                        added_keys.begin(), added_keys.end(),
+                        std::back_inserter(keys_to_delete));
+    std::vector<store_key_t> keys_to_set;
+    if (modification->info.added.second == modification->info.deleted.second) {
+        std::set_difference(added_keys.begin(), added_keys.end(),
+                            deleted_keys.begin(), deleted_keys.end(),
+                            std::back_inserter(keys_to_set));
+    } else {
+        keys_to_set = std::move(added_keys);
+    }
+
+    for (auto it = keys_to_delete.begin(); it != keys_to_delete.end(); ++it) {
+        promise_t<superblock_t *> return_superblock_local;
+        {
+            keyvalue_location_t<rdb_value_t> kv_location;
+            find_keyvalue_location_for_write(super_block,
+                                             it->btree_key(),
+                                             deletion_context->balancing_detacher(),
+                                             &kv_location,
+                                             &sindex->btree->stats,
+                                             env->trace.get_or_null(),
+                                             &return_superblock_local);
+
+            if (kv_location.value.has()) {
+                kv_location_delete(&kv_location, *it,
+                    repli_timestamp_t::distant_past, deletion_context, NULL);
+            }
+            // The keyvalue location gets destroyed here.
+        }
+        super_block = return_superblock_local.wait();
+    }
+
+    for (auto it = keys_to_set.begin(); it != keys_to_set.end(); ++it) {
+        promise_t<superblock_t *> return_superblock_local;
+        {
+            keyvalue_location_t<rdb_value_t> kv_location;
+
+            find_keyvalue_location_for_write(super_block,
+                                             it->btree_key(),
+                                             deletion_context->balancing_detacher(),
+                                             &kv_location,
+                                             &sindex->btree->stats,
+                                             env->trace.get_or_null(),
+                                             &return_superblock_local);
+
+            // The index entry's value is the row's own value (its blob
+            // reference), so every secondary index covers every field:
+            // range reads get rows (or just the fields they need, see
+            // `rget_cb_t::handle_pair`) from the index's leaves without
+            // looking them up in the primary btree.
+            kv_location_set(&kv_location, *it,
+                            modification->info.added.second,
+                            repli_timestamp_t::distant_past,
+                            deletion_context);
+            // The keyvalue location gets destroyed here.
+        }
+        super_block = return_superblock_local.wait();
+    }
+
+    *super_block_inout = super_block;
+}
 
+
+/* Used below by rdb_update_sindexes.  Applies `modifications[0]` through
+ * `modifications[num_modifications - 1]` to one secondary index, in order. */
+void rdb_update_single_sindex(
+        const btree_store_t<rdb_protocol_t>::sindex_access_t *sindex,
+        const deletion_context_t *deletion_context,
+        const rdb_modification_report_t *modifications,
+        size_t num_modifications,
+        auto_drainer_t::lock_t) {
     ql::map_wire_func_t mapping;
     sindex_multi_bool_t multi = sindex_multi_bool_t::MULTI;
     inplace_vector_read_stream_t read_stream(&sindex->sindex.opaque_definition);
@@ -1124,77 +1551,23 @@ void rdb_update_single_sindex(
 
     superblock_t *super_block = sindex->super_block.get();
 
-    if (modification->info.deleted.first) {
-        guarantee(!modification->info.deleted.second.empty());
-        try {
-            counted_t<const ql::datum_t> deleted = modification->info.deleted.first;
-
-            std::vector<store_key_t> keys;
-
-            compute_keys(modification->primary_key, deleted, &mapping, multi, &env, &keys);
-
-            for (auto it = keys.begin(); it != keys.end(); ++it) {
-                promise_t<superblock_t *> return_superblock_local;
-                {
-                    keyvalue_location_t<rdb_value_t> kv_location;
-                    find_keyvalue_location_for_write(super_block,
-                                                     it->btree_key(),
-                                                     deletion_context->balancing_detacher(),
-                                                     &kv_location,
-                                                     &sindex->btree->stats,
-                                                     env.trace.get_or_null(),
-                                                     &return_superblock_local);
-
-                    if (kv_location.value.has()) {
-                        kv_location_delete(&kv_location, *it,
-                            repli_timestamp_t::distant_past, deletion_context, NULL);
-                    }
-                    // The keyvalue location gets destroyed here.
-                }
-                super_block = return_superblock_local.wait();
-            }
-        } catch (const ql::base_exc_t &) {
-            // Do nothing (it wasn't actually in the index).
-        }
-    }
-
-    if (modification->info.added.first) {
-        try {
-            counted_t<const ql::datum_t> added = modification->info.added.first;
-
-            std::vector<store_key_t> keys;
-
-            compute_keys(modification->primary_key, added, &mapping, multi, &env, &keys);
-
-            for (auto it = keys.begin(); it != keys.end(); ++it) {
-                promise_t<superblock_t *> return_superblock_local;
-                {
-                    keyvalue_location_t<rdb_value_t> kv_location;
-
-                    find_keyvalue_location_for_write(super_block,
-                                                     it->btree_key(),
-                                                     deletion_context->balancing_detacher(),
-                                                     &kv_location,
-                                                     &sindex->btree->stats,
-                                                     env.trace.get_or_null(),
-                                                     &return_superblock_local);
-
-                    kv_location_set(&kv_location, *it,
-                                    modification->info.added.second,
-                                    repli_timestamp_t::distant_past,
-                                    deletion_context);
-                    // The keyvalue location gets destroyed here.
-                }
-                super_block = return_superblock_local.wait();
-            }
-        } catch (const ql::base_exc_t &) {
-            // Do nothing (we just drop the row from the index).
-        }
+    for (size_t i = 0; i < num_modifications; ++i) {
+        const rdb_modification_report_t *modification = &modifications[i];
+        // Note if you get this error it's likely that you've passed in a default
+        // constructed mod_report. Don't do that.  Mod reports should always be
+        // passed to a function as an output parameter before they're passed to
+        // this function.
+        guarantee(modification->primary_key.size() != 0);
+        update_sindex_for_modification(sindex, deletion_context, modification,
+                                       &mapping, multi, &env, &super_block);
     }
 }
 
+/* Applies `num_modifications` changes to all the secondary indexes, with one pass
+ * over the changes for each index. */
 void rdb_update_sindexes(const sindex_access_vector_t &sindexes,
-                         const rdb_modification_report_t *modification,
+                         const rdb_modification_report_t *modifications,
+                         size_t num_modifications,
                          txn_t *txn, const deletion_context_t *deletion_context) {
     {
         auto_drainer_t drainer;
@@ -1204,25 +1577,43 @@ void rdb_update_sindexes(const sindex_access_vector_t &sindexes,
                                                     ++it) {
             coro_t::spawn_sometime(std::bind(
                         &rdb_update_single_sindex, &*it, deletion_context,
-                        modification, auto_drainer_t::lock_t(&drainer)));
+                        modifications, num_modifications,
+                        auto_drainer_t::lock_t(&drainer)));
         }
     }
 
     /* All of the sindex have been updated now it's time to actually clear the
-     * deleted blob if it exists. */
-    if (modification->info.deleted.first) {
-        // Deleting the value unfortunately updates the ref in-place as it operates, so
-        // we need to make a copy of the blob reference that is extended to the
-        // appropriate width.
-        std::vector<char> ref_cpy(modification->info.deleted.second);
-        ref_cpy.insert(ref_cpy.end(), blob::btree_maxreflen - ref_cpy.size(), 0);
-        guarantee(ref_cpy.size() == static_cast<size_t>(blob::btree_maxreflen));
-
-        deletion_context->post_deleter()->delete_value(buf_parent_t(txn),
-                                                       ref_cpy.data());
+     * deleted blobs if they exist. */
+    const int maxreflen = rdb_value_maxreflen(txn->cache()->get_block_size());
+    for (size_t i = 0; i < num_modifications; ++i) {
+        const rdb_modification_report_t *modification = &modifications[i];
+        if (modification->info.deleted.first) {
+            // Deleting the value unfortunately updates the ref in-place as it
+            // operates, so we need to make a copy of the blob reference that is
+            // extended to the appropriate width.
+            std::vector<char> ref_cpy(modification->info.deleted.second);
+            ref_cpy.insert(ref_cpy.end(), maxreflen - ref_cpy.size(), 0);
+            guarantee(ref_cpy.size() == static_cast<size_t>(maxreflen));
+
+            deletion_context->post_deleter()->delete_value(buf_parent_t(txn),
+                                                           ref_cpy.data());
+        }
     }
 }
 
+void rdb_update_sindexes(const sindex_access_vector_t &sindexes,
+                         const rdb_modification_report_t *modification,
+                         txn_t *txn, const deletion_context_t *deletion_context) {
+    rdb_update_sindexes(sindexes, modification, 1, txn, deletion_context);
+}
+
+void rdb_update_sindexes(const sindex_access_vector_t &sindexes,
+                         const std::vector<rdb_modification_report_t> &modifications,
+                         txn_t *txn, const deletion_context_t *deletion_context) {
+    rdb_update_sindexes(sindexes, modifications.data(), modifications.size(), txn,
+                        deletion_context);
+}
+
 void rdb_erase_major_range_sindexes(const sindex_access_vector_t &sindexes,
                               const rdb_erase_major_range_report_t *erase_range,
                               signal_t *interruptor, const value_deleter_t *deleter) {
@@ -1244,12 +1635,21 @@ public:
             )
         : store_(store),
           sindexes_to_post_construct_(sindexes_to_post_construct),
-          interrupt_myself_(interrupt_myself), interruptor_(interruptor)
+          interrupt_myself_(interrupt_myself), interruptor_(interruptor),
+          window_start_(get_ticks()), rows_in_window_(0)
     { }
 
     void process_a_leaf(buf_lock_t *leaf_node_buf,
                         const btree_key_t *, const btree_key_t *,
                         signal_t *, int *) THROWS_ONLY(interrupted_exc_t) {
+        // Wait before taking any locks, so that writes aren't held up by the
+        // throttling.
+        try {
+            throttle();
+        } catch (const interrupted_exc_t &e) {
+            return;
+        }
+
         write_token_pair_t token_pair;
         store_->new_write_token_pair(&token_pair);
 
@@ -1270,7 +1670,8 @@ public:
                     &token_pair,
                     &wtxn,
                     &superblock,
-                    interruptor_);
+                    interruptor_,
+                    semaphore_priority_t::background);
 
             // Acquire the sindex block.
             const block_id_t sindex_block_id = superblock->get_sindex_block_id();
@@ -1319,10 +1720,31 @@ public:
 
             rdb_update_sindexes(sindexes, &mod_report, wtxn.get(), &deletion_context);
             store_->btree->stats.pm_keys_set.record();
+            ++rows_in_window_;
             coro_t::yield();
         }
     }
 
+    // Waits until the rows indexed in the last second are within
+    // `SINDEX_POST_CONSTRUCTION_MAX_ROWS_PER_SEC`.
+    void throttle() THROWS_ONLY(interrupted_exc_t) {
+        if (SINDEX_POST_CONSTRUCTION_MAX_ROWS_PER_SEC == 0) {
+            return;
+        }
+        for (;;) {
+            const ticks_t now = get_ticks();
+            if (now - window_start_ >= secs_to_ticks(1)) {
+                window_start_ = now;
+                rows_in_window_ = 0;
+            }
+            if (rows_in_window_ < SINDEX_POST_CONSTRUCTION_MAX_ROWS_PER_SEC) {
+                return;
+            }
+            const ticks_t left = window_start_ + secs_to_ticks(1) - now;
+            nap(std::max<int64_t>(1, left / (secs_to_ticks(1) / 1000)), interruptor_);
+        }
+    }
+
     void postprocess_internal_node(buf_lock_t *) { }
 
     void filter_interesting_children(buf_parent_t,
@@ -1341,6 +1763,10 @@ public:
     const std::set<uuid_u> &sindexes_to_post_construct_;
     cond_t *interrupt_myself_;
     signal_t *interruptor_;  
+
+    // The leaves are processed concurrently, so they share the budget.
+    ticks_t window_start_;
+    int64_t rows_in_window_;
 };
 
 void post_construct_secondary_indexes(
@@ -1393,3 +1819,118 @@ void post_construct_secondary_indexes(
 
     btree_parallel_traversal(superblock.get(), &helper, &wait_any);
 }
+
+class key_filter_traversal_helper_t : public btree_traversal_helper_t {
+public:
+    explicit key_filter_traversal_helper_t(key_filter_t *filter) : filter_(filter) { }
+
+    void process_a_leaf(buf_lock_t *leaf_node_buf,
+                        const btree_key_t *, const btree_key_t *,
+                        signal_t *, int *) THROWS_ONLY(interrupted_exc_t) {
+        buf_read_t leaf_read(leaf_node_buf);
+        const leaf_node_t *leaf_node
+            = static_cast<const leaf_node_t *>(leaf_read.get_data_read());
+        for (auto it = leaf::begin(*leaf_node); it != leaf::end(*leaf_node); ++it) {
+            filter_->add_built_key((*it).first);
+        }
+    }
+
+    void postprocess_internal_node(buf_lock_t *) { }
+
+    void filter_interesting_children(buf_parent_t,
+                                     ranged_block_ids_t *ids_source,
+                                     interesting_children_callback_t *cb) {
+        for (int i = 0, e = ids_source->num_block_ids(); i < e; ++i) {
+            cb->receive_interesting_child(i);
+        }
+        cb->no_more_interesting_children();
+    }
+
+    access_t btree_superblock_mode() { return access_t::read; }
+    access_t btree_node_mode() { return access_t::read; }
+
+private:
+    key_filter_t *filter_;
+};
+
+void build_primary_key_filter(
+        btree_store_t<rdb_protocol_t> *store,
+        signal_t *interruptor)
+    THROWS_ONLY(interrupted_exc_t) {
+    key_filter_t *filter = &store->btree->key_filter;
+
+    int64_t population;
+    {
+        object_buffer_t<fifo_enforcer_sink_t::exit_read_t> read_token;
+        store->new_read_token(&read_token);
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        store->acquire_superblock_for_read(&read_token, &txn, &superblock,
+                                           interruptor, false);
+        population = get_btree_population(superblock.get());
+    }
+
+    // Writes note their keys in the new filter from here on, so every key that the
+    // snapshot below doesn't have gets in that way.
+    if (!filter->start_building(population)) {
+        return;
+    }
+
+    try {
+        object_buffer_t<fifo_enforcer_sink_t::exit_read_t> read_token;
+        store->new_read_token(&read_token);
+
+        // Mind the destructor ordering, as in `post_construct_secondary_indexes()`.
+        cache_account_t cache_account;
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        store->acquire_superblock_for_read(&read_token, &txn, &superblock,
+                                           interruptor, true /* USE_SNAPSHOT */);
+
+        cache_account
+            = txn->cache()->create_cache_account(KEY_FILTER_BUILD_CACHE_PRIORITY);
+        txn->set_account(&cache_account);
+
+        key_filter_traversal_helper_t helper(filter);
+        btree_parallel_traversal(superblock.get(), &helper, interruptor);
+        // A traversal that got interrupted might have left out some leaves.
+        if (interruptor->is_pulsed()) {
+            throw interrupted_exc_t();
+        }
+    } catch (const interrupted_exc_t &) {
+        filter->abandon_building();
+        throw;
+    }
+
+    filter->finish_building();
+}
+
+void freeze_primary_btree(
+        btree_store_t<rdb_protocol_t> *store,
+        signal_t *interruptor)
+    THROWS_ONLY(interrupted_exc_t) {
+    value_sizer_t<rdb_value_t> sizer(store->btree->cache()->get_block_size());
+    rdb_value_detacher_t detacher;
+    store_key_t cursor = store_key_t::min();
+    bool more;
+    do {
+        write_token_pair_t token_pair;
+        store->new_write_token_pair(&token_pair);
+
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        // Soft durability is enough, since a leaf that doesn't get frozen on disk is
+        // still a fine leaf.
+        store->acquire_superblock_for_write(
+                repli_timestamp_t::distant_past,
+                2,
+                write_durability_t::SOFT,
+                &token_pair,
+                &txn,
+                &superblock,
+                interruptor,
+                semaphore_priority_t::background);
+
+        more = freeze_btree_step(&sizer, superblock.get(), &detacher, &cursor);
+    } while (more);
+}
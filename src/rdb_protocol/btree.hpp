@@ -13,6 +13,7 @@
 #include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/protocol.hpp"
 
+class background_subtree_eraser_t;
 class key_tester_t;
 class parallel_traversal_progress_t;
 template <class> class promise_t;
@@ -23,12 +24,14 @@ typedef rdb_protocol_t::read_response_t read_response_t;
 
 typedef rdb_protocol_t::point_read_t point_read_t;
 typedef rdb_protocol_t::point_read_response_t point_read_response_t;
+typedef rdb_protocol_t::batched_point_read_response_t batched_point_read_response_t;
 
 typedef rdb_protocol_t::rget_read_t rget_read_t;
 typedef rdb_protocol_t::rget_read_response_t rget_read_response_t;
 
 typedef rdb_protocol_t::distribution_read_t distribution_read_t;
 typedef rdb_protocol_t::distribution_read_response_t distribution_read_response_t;
+typedef rdb_protocol_t::sample_read_response_t sample_read_response_t;
 
 typedef rdb_protocol_t::write_t write_t;
 typedef rdb_protocol_t::write_response_t write_response_t;
@@ -85,6 +88,14 @@ void rdb_get(
     point_read_response_t *response,
     profile::trace_t *trace);
 
+// `keys` has to be sorted.
+void rdb_get_batch(
+    const std::vector<store_key_t> &keys,
+    btree_slice_t *slice,
+    superblock_t *superblock,
+    batched_point_read_response_t *response,
+    profile::trace_t *trace);
+
 enum return_vals_t {
     NO_RETURN_VALS = 0,
     RETURN_VALS = 1
@@ -104,20 +115,6 @@ struct btree_info_t {
     const std::string *primary_key;
 };
 
-struct btree_loc_info_t {
-    btree_loc_info_t(const btree_info_t *_btree,
-                     superblock_t *_superblock,
-                     const store_key_t *_key)
-        : btree(_btree), superblock(_superblock), key(_key) {
-        guarantee(btree != NULL);
-        guarantee(superblock != NULL);
-        guarantee(key != NULL);
-    }
-    const btree_info_t *const btree;
-    superblock_t *const superblock;
-    const store_key_t *const key;
-};
-
 struct btree_batched_replacer_t {
     virtual ~btree_batched_replacer_t() { }
     virtual counted_t<const ql::datum_t> replace(
@@ -131,6 +128,9 @@ struct btree_point_replacer_t {
     virtual bool should_return_vals() const = 0;
 };
 
+// Replaces `keys` in key order, with one walk down the tree and one acquisition of
+// the leaf for each run of them that goes in the same leaf, and then updates the
+// secondary indexes for all of them at once.
 batched_replace_response_t rdb_batched_replace(
     const btree_info_t &info,
     scoped_ptr_t<superblock_t> *superblock,
@@ -185,12 +185,15 @@ void rdb_delete(const store_key_t &key, btree_slice_t *slice, repli_timestamp_t
                 profile::trace_t *trace);
 
 /* `rdb_erase_major_range` has a complexity of O(n) where n is the size of the
- * btree, if secondary indexes are present. Be careful when to use it. */
+ * btree, if secondary indexes are present. Be careful when to use it.
+ * If `subtree_eraser` isn't NULL and `tester` erases every key, the subtrees that
+ * lie entirely inside `keys` are unlinked and freed later by `subtree_eraser`. */
 void rdb_erase_major_range(key_tester_t *tester,
                            const key_range_t &keys,
                            buf_lock_t *sindex_block,
                            superblock_t *superblock,
                            btree_store_t<rdb_protocol_t> *store,
+                           background_subtree_eraser_t *subtree_eraser,
                            signal_t *interruptor);
 
 /* `rdb_erase_small_range` has a complexity of O(log n * m) where n is the size of
@@ -241,6 +244,21 @@ void rdb_distribution_get(int max_depth,
                           superblock_t *superblock,
                           distribution_read_response_t *response);
 
+/* Like `rdb_distribution_get()`, but bases the distribution on `sample_size` keys
+ * sampled from all leaves, and also fills in `response->byte_counts`. */
+void rdb_distribution_sample(size_t sample_size,
+                             const store_key_t &left_key,
+                             superblock_t *superblock,
+                             distribution_read_response_t *response);
+
+/* Fills in `response` with a random sample of up to `sample_size` of the rows with
+ * keys in `range`, taken by walking down to random leaves.  `response->key_count` is
+ * the population of the whole btree, so `range` should be everything it has. */
+void rdb_sample(size_t sample_size,
+                const key_range_t &range,
+                superblock_t *superblock,
+                sample_read_response_t *response);
+
 /* Secondary Indexes */
 
 struct rdb_modification_info_t {
@@ -278,23 +296,35 @@ typedef boost::variant<rdb_modification_report_t,
         rdb_sindex_change_t;
 
 /* An rdb_modification_cb_t is passed to BTree operations and allows them to
- * modify the secondary while they perform an operation. */
+ * modify the secondary while they perform an operation.  It also hands the changes
+ * to `changefeed_server`, if that isn't NULL. */
 class rdb_modification_report_cb_t {
 public:
     rdb_modification_report_cb_t(
             btree_store_t<rdb_protocol_t> *store,
+            ql::changefeed::server_t *changefeed_server,
             buf_lock_t *sindex_block,
             auto_drainer_t::lock_t lock);
 
+    // These release the sindex block before updating the secondary indexes, so only
+    // one of them can be called, once.
     void on_mod_report(const rdb_modification_report_t &mod_report);
+    // Like calling `on_mod_report` for each of `mod_reports`, but each secondary
+    // index is only walked through once.
+    void on_mod_reports(const std::vector<rdb_modification_report_t> &mod_reports);
 
     ~rdb_modification_report_cb_t();
 
 private:
+    void release_sindex_block(mutex_t::acq_t *acq);
+
     /* Fields initialized by the constructor. */
     auto_drainer_t::lock_t lock_;
     btree_store_t<rdb_protocol_t> *store_;
+    ql::changefeed::server_t *changefeed_server_;
+    // Becomes `NULL` once the changes are in the sindex queue.
     buf_lock_t *sindex_block_;
+    txn_t *txn_;
 
     /* Fields initialized by calls to on_mod_report */
     btree_store_t<rdb_protocol_t>::sindex_access_vector_t sindexes_;
@@ -306,6 +336,13 @@ void rdb_update_sindexes(
         txn_t *txn,
         const deletion_context_t *deletion_context);
 
+// Applies `modifications` in order.
+void rdb_update_sindexes(
+        const btree_store_t<rdb_protocol_t>::sindex_access_vector_t &sindexes,
+        const std::vector<rdb_modification_report_t> &modifications,
+        txn_t *txn,
+        const deletion_context_t *deletion_context);
+
 
 void rdb_erase_major_range_sindexes(
         const btree_store_t<rdb_protocol_t>::sindex_access_vector_t &sindexes,
@@ -318,6 +355,20 @@ void post_construct_secondary_indexes(
         signal_t *interruptor)
     THROWS_ONLY(interrupted_exc_t);
 
+/* Builds `store->btree->key_filter` from the primary btree, unless the table is too
+big for one.  The filter in use (if any) stays in use until the new one is done. */
+void build_primary_key_filter(
+        btree_store_t<rdb_protocol_t> *store,
+        signal_t *interruptor)
+    THROWS_ONLY(interrupted_exc_t);
+
+/* Freezes the primary btree of `store` (see `freeze_btree_step()`), one write
+transaction at a time, behind the writes that are queued up when each one starts. */
+void freeze_primary_btree(
+        btree_store_t<rdb_protocol_t> *store,
+        signal_t *interruptor)
+    THROWS_ONLY(interrupted_exc_t);
+
 /* This deleter actually deletes the value and all associated blocks. */
 class rdb_value_deleter_t : public value_deleter_t {
 public:
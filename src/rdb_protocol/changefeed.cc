@@ -0,0 +1,192 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/changefeed.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <set>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/wait_any.hpp"
+#include "config/args.hpp"
+#include "containers/archive/boost_types.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rpc/mailbox/mailbox.hpp"
+
+namespace ql {
+namespace changefeed {
+
+RDB_IMPL_ME_SERIALIZABLE_2(msg_t::change_t, old_val, new_val);
+RDB_IMPL_ME_SERIALIZABLE_0(msg_t::stop_t);
+RDB_IMPL_ME_SERIALIZABLE_1(msg_t, op);
+
+server_t::server_t(mailbox_manager_t *_manager)
+    : manager(_manager),
+      stop_mailbox(manager,
+                   std::bind(&server_t::remove_client, this, std::placeholders::_1)) { }
+
+server_t::~server_t() {
+    assert_thread();
+    if (!clients.empty()) {
+        send_all(msg_t(msg_t::stop_t()), auto_drainer_t::lock_t(&drainer));
+    }
+}
+
+void server_t::add_client(const client_addr_t &addr) {
+    assert_thread();
+    clients.push_back(addr);
+}
+
+void server_t::send_change(counted_t<const datum_t> old_val,
+                           counted_t<const datum_t> new_val) {
+    assert_thread();
+    if (clients.empty() || (!old_val.has() && !new_val.has())) {
+        return;
+    }
+    // Like an update that set a field to the value it already had.
+    if (old_val.has() && new_val.has() && *old_val == *new_val) {
+        return;
+    }
+    coro_t::spawn_sometime(std::bind(&server_t::send_all, this,
+                                     msg_t(msg_t::change_t(old_val, new_val)),
+                                     auto_drainer_t::lock_t(&drainer)));
+}
+
+server_addr_t server_t::get_stop_addr() const {
+    return stop_mailbox.get_address();
+}
+
+void server_t::send_all(const msg_t &msg, UNUSED auto_drainer_t::lock_t keepalive) {
+    assert_thread();
+    mutex_t::acq_t acq(&send_mutex);
+
+    // Feeds whose node went away can't unsubscribe, so they're dropped here.
+    connectivity_service_t *connectivity = manager->get_connectivity_service();
+    clients.erase(std::remove_if(clients.begin(), clients.end(),
+                                 [connectivity](const client_addr_t &addr) {
+                                     return !connectivity->get_peer_connected(
+                                         addr.get_peer());
+                                 }),
+                  clients.end());
+
+    // `send` can block, and `clients` can change while it does.
+    const std::vector<client_addr_t> to_send = clients;
+    for (auto it = to_send.begin(); it != to_send.end(); ++it) {
+        send(manager, *it, msg);
+    }
+}
+
+void server_t::remove_client(const client_addr_t &addr) {
+    assert_thread();
+    auto it = std::find(clients.begin(), clients.end(), addr);
+    if (it != clients.end()) {
+        clients.erase(it);
+    }
+}
+
+feed_t::feed_t(mailbox_manager_t *_manager)
+    : manager(_manager),
+      changes_cond(NULL),
+      mailbox(manager, std::bind(&feed_t::on_msg, this, std::placeholders::_1)) { }
+
+feed_t::~feed_t() {
+    assert_thread();
+    for (auto it = servers.begin(); it != servers.end(); ++it) {
+        send(manager, *it, mailbox.get_address());
+    }
+}
+
+client_addr_t feed_t::get_addr() const {
+    return mailbox.get_address();
+}
+
+void feed_t::add_servers(const std::vector<server_addr_t> &server_addrs) {
+    assert_thread();
+    std::set<peer_id_t> peers;
+    for (auto it = servers.begin(); it != servers.end(); ++it) {
+        peers.insert(it->get_peer());
+    }
+    for (auto it = server_addrs.begin(); it != server_addrs.end(); ++it) {
+        servers.push_back(*it);
+        if (peers.insert(it->get_peer()).second) {
+            disconnect_watchers.push_back(make_scoped<disconnect_watcher_t>(
+                manager->get_connectivity_service(), it->get_peer()));
+        }
+    }
+}
+
+std::vector<counted_t<const datum_t> > feed_t::wait_for_changes(signal_t *interruptor)
+    THROWS_ONLY(interrupted_exc_t, datum_exc_t) {
+    assert_thread();
+    while (changes.empty() && error.empty()) {
+        for (auto it = disconnect_watchers.begin(); it != disconnect_watchers.end(); ++it) {
+            if ((*it)->is_pulsed()) {
+                error = "Changefeed aborted because a server with the table's data "
+                        "disconnected.";
+            }
+        }
+        if (!error.empty()) {
+            break;
+        }
+
+        cond_t cond;
+        wait_any_t waiter(&cond);
+        for (auto it = disconnect_watchers.begin(); it != disconnect_watchers.end(); ++it) {
+            waiter.add(it->get());
+        }
+        changes_cond = &cond;
+        try {
+            wait_interruptible(&waiter, interruptor);
+        } catch (const interrupted_exc_t &) {
+            changes_cond = NULL;
+            throw;
+        }
+        changes_cond = NULL;
+    }
+
+    // The changes that came before the error still get returned.
+    if (changes.empty()) {
+        throw datum_exc_t(base_exc_t::GENERIC, error);
+    }
+    std::vector<counted_t<const datum_t> > ret(changes.begin(), changes.end());
+    changes.clear();
+    return ret;
+}
+
+void feed_t::on_msg(const msg_t &msg) {
+    assert_thread();
+    if (!error.empty()) {
+        return;
+    }
+    if (const msg_t::change_t *change = boost::get<msg_t::change_t>(&msg.op)) {
+        if (changes.size() >= CHANGEFEED_MAX_QUEUED_CHANGES) {
+            changes.clear();
+            error = strprintf("Changefeed aborted because it fell more than %d "
+                              "changes behind.", CHANGEFEED_MAX_QUEUED_CHANGES);
+        } else {
+            const counted_t<const datum_t> null = make_counted<datum_t>(datum_t::R_NULL);
+            std::map<std::string, counted_t<const datum_t> > obj;
+            obj["old_val"] = change->old_val.has() ? change->old_val : null;
+            obj["new_val"] = change->new_val.has() ? change->new_val : null;
+            changes.push_back(make_counted<datum_t>(std::move(obj)));
+        }
+    } else {
+        r_sanity_check(boost::get<msg_t::stop_t>(&msg.op) != NULL);
+        error = "Changefeed aborted because a shard of the table went away (was the "
+                "table resharded or dropped?).";
+    }
+    if (changes_cond != NULL && !changes_cond->is_pulsed()) {
+        changes_cond->pulse();
+    }
+}
+
+stream_t::stream_t(scoped_ptr_t<feed_t> &&_feed, const protob_t<const Backtrace> &bt)
+    : eager_datum_stream_t(bt), feed(std::move(_feed)) { }
+
+std::vector<counted_t<const datum_t> >
+stream_t::next_raw_batch(env_t *env, UNUSED const batchspec_t &batchspec) {
+    return feed->wait_for_changes(env->interruptor);
+}
+
+}  // namespace changefeed
+}  // namespace ql
@@ -0,0 +1,143 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_CHANGEFEED_HPP_
+#define RDB_PROTOCOL_CHANGEFEED_HPP_
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/variant.hpp>
+
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
+#include "concurrency/mutex.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/datum_stream.hpp"
+#include "rpc/connectivity/connectivity.hpp"
+#include "rpc/mailbox/typed.hpp"
+
+namespace ql {
+namespace changefeed {
+
+/* Changefeeds let a client follow the writes to a table instead of polling it.  A
+`changes` query makes a `feed_t`, whose mailbox is subscribed to every shard of the
+table with a `changefeed_subscribe_t` read.  Each shard's store has a `server_t`,
+which the store's writes hand the old and new values of the rows they change (the
+same values the modification reports give the secondary indexes).  The server sends
+them on to the subscribed feeds, and the query's stream returns them as they come,
+one batch per `CONTINUE`.
+
+A feed only gets the changes made after it subscribed, by the writes that report
+them (not by backfills), and fails once one of its servers goes away (say, because
+the table was resharded or the server holding the shard went down). */
+
+struct msg_t {
+    struct change_t {
+        change_t() { }
+        change_t(counted_t<const datum_t> _old_val, counted_t<const datum_t> _new_val)
+            : old_val(_old_val), new_val(_new_val) { }
+        // Empty if the row didn't exist before or after the write.
+        counted_t<const datum_t> old_val;
+        counted_t<const datum_t> new_val;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+    // The server is going away, so no more changes will come from it.
+    struct stop_t {
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
+    msg_t() { }
+    explicit msg_t(const change_t &change) : op(change) { }
+    explicit msg_t(const stop_t &stop) : op(stop) { }
+
+    boost::variant<stop_t, change_t> op;
+    RDB_DECLARE_ME_SERIALIZABLE;
+};
+
+// Lives on its store's home thread.
+class server_t : public home_thread_mixin_t {
+public:
+    explicit server_t(mailbox_manager_t *manager);
+    // Tells the feeds that they won't get any more changes from here.
+    ~server_t();
+
+    void add_client(const client_addr_t &addr);
+    // Sends the change to the subscribed feeds, in the background so that the write
+    // doesn't wait for the network.  Does nothing if nobody is subscribed.
+    void send_change(counted_t<const datum_t> old_val,
+                     counted_t<const datum_t> new_val);
+    // Feeds send their address here to unsubscribe.
+    server_addr_t get_stop_addr() const;
+
+private:
+    void send_all(const msg_t &msg, auto_drainer_t::lock_t keepalive);
+    void remove_client(const client_addr_t &addr);
+
+    mailbox_manager_t *manager;
+    std::vector<client_addr_t> clients;
+
+    // Makes the changes go out one at a time, in the order they were made.
+    mutex_t send_mutex;
+    auto_drainer_t drainer;
+    mailbox_t<void(client_addr_t)> stop_mailbox;
+
+    DISABLE_COPYING(server_t);
+};
+
+// The query node's end of a changefeed, kept by its stream.
+class feed_t : public home_thread_mixin_t {
+public:
+    explicit feed_t(mailbox_manager_t *manager);
+    // Unsubscribes from the servers.
+    ~feed_t();
+
+    client_addr_t get_addr() const;
+    void add_servers(const std::vector<server_addr_t> &server_addrs);
+
+    // Blocks until there are changes (as `{old_val, new_val}` objects), and returns
+    // them.  Throws if a server went away or too many changes piled up.
+    std::vector<counted_t<const datum_t> > wait_for_changes(signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t, datum_exc_t);
+
+private:
+    void on_msg(const msg_t &msg);
+
+    mailbox_manager_t *manager;
+    std::vector<server_addr_t> servers;
+    // One for each peer that has one of `servers`.
+    std::vector<scoped_ptr_t<disconnect_watcher_t> > disconnect_watchers;
+
+    std::deque<counted_t<const datum_t> > changes;
+    // Set once the feed has failed.
+    std::string error;
+    // Pulsed when there are changes (or an error), while `wait_for_changes` waits.
+    cond_t *changes_cond;
+
+    mailbox_t<void(msg_t)> mailbox;
+
+    DISABLE_COPYING(feed_t);
+};
+
+// The stream a `changes` query returns, which never runs out.
+class stream_t : public eager_datum_stream_t {
+public:
+    stream_t(scoped_ptr_t<feed_t> &&_feed, const protob_t<const Backtrace> &bt);
+
+private:
+    virtual bool is_array() { return false; }
+    virtual counted_t<const datum_t> as_array(env_t *) {
+        return counted_t<const datum_t>();
+    }
+    virtual bool is_exhausted() const { return false; }
+    virtual std::vector<counted_t<const datum_t> >
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+
+    scoped_ptr_t<feed_t> feed;
+};
+
+}  // namespace changefeed
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_CHANGEFEED_HPP_
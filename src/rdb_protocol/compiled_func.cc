@@ -0,0 +1,631 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/compiled_func.hpp"
+
+#include <cmath>
+#include <string>
+#include <utility>
+
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/error.hpp"
+#include "rdb_protocol/ql2.pb.h"
+
+namespace ql {
+
+typedef filter_predicate_t::result_t result_t;
+
+// What a value node computes: a datum that lives as long as the test (part of the
+// row, or a constant), or a number computed from them.
+struct pred_value_t {
+    // NULL if the value is `num`.
+    const datum_t *datum;
+    double num;
+
+    datum_t::type_t get_type() const {
+        return datum != NULL ? datum->get_type() : datum_t::R_NUM;
+    }
+    double as_num() const {
+        return datum != NULL ? datum->as_num() : num;
+    }
+};
+
+// Compares `a` and `b` like `datum_t::cmp`.  Returns false for arrays and objects,
+// which could hold pseudotypes.
+static bool scalar_cmp(const pred_value_t &a, const pred_value_t &b, int *out) {
+    const datum_t::type_t a_type = a.get_type();
+    const datum_t::type_t b_type = b.get_type();
+    if (a_type == datum_t::R_ARRAY || a_type == datum_t::R_OBJECT
+        || b_type == datum_t::R_ARRAY || b_type == datum_t::R_OBJECT) {
+        return false;
+    }
+    if (a_type != b_type) {
+        *out = a_type < b_type ? -1 : 1;
+    } else if (a_type == datum_t::R_NUM) {
+        const double x = a.as_num();
+        const double y = b.as_num();
+        *out = x == y ? 0 : (x < y ? -1 : 1);
+    } else {
+        *out = a.datum->cmp(*b.datum);
+    }
+    return true;
+}
+
+class value_node_t {
+public:
+    virtual ~value_node_t() { }
+    // Returns false if evaluating the term would raise an error.
+    virtual bool eval(const datum_t *row, pred_value_t *out) const = 0;
+};
+
+class pred_node_t {
+public:
+    virtual ~pred_node_t() { }
+    virtual result_t test(const datum_t *row) const = 0;
+};
+
+class row_node_t : public value_node_t {
+public:
+    bool eval(const datum_t *row, pred_value_t *out) const {
+        out->datum = row;
+        return true;
+    }
+};
+
+class constant_node_t : public value_node_t {
+public:
+    explicit constant_node_t(counted_t<const datum_t> &&_value)
+        : value(std::move(_value)) { }
+    bool eval(const datum_t *, pred_value_t *out) const {
+        out->datum = value.get();
+        return true;
+    }
+private:
+    counted_t<const datum_t> value;
+};
+
+class get_field_node_t : public value_node_t {
+public:
+    get_field_node_t(scoped_ptr_t<value_node_t> &&_obj, const std::string &_field)
+        : obj(std::move(_obj)), field(_field) { }
+    bool eval(const datum_t *row, pred_value_t *out) const {
+        pred_value_t v;
+        // `get_field` maps over arrays, so only objects are looked at here.
+        if (!obj->eval(row, &v) || v.get_type() != datum_t::R_OBJECT) {
+            return false;
+        }
+        const datum_object_t &o = v.datum->as_object();
+        auto it = o.find(field);
+        if (it == o.end()) {
+            return false;
+        }
+        out->datum = it->second.get();
+        return true;
+    }
+private:
+    scoped_ptr_t<value_node_t> obj;
+    std::string field;
+};
+
+class arith_node_t : public value_node_t {
+public:
+    arith_node_t(int _type, std::vector<scoped_ptr_t<value_node_t> > &&_args)
+        : type(_type), args(std::move(_args)) { }
+    bool eval(const datum_t *row, pred_value_t *out) const {
+        if (!args[0]->eval(row, out)) {
+            return false;
+        }
+        for (size_t i = 1; i < args.size(); ++i) {
+            pred_value_t rhs;
+            if (out->get_type() != datum_t::R_NUM || !args[i]->eval(row, &rhs)
+                || rhs.get_type() != datum_t::R_NUM) {
+                return false;
+            }
+            const double x = out->as_num();
+            const double y = rhs.as_num();
+            switch (type) {
+            case Term::ADD: out->num = x + y; break;
+            case Term::SUB: out->num = x - y; break;
+            case Term::MUL: out->num = x * y; break;
+            case Term::DIV:
+                if (y == 0) {
+                    return false;
+                }
+                out->num = x / y;
+                break;
+            default: unreachable();
+            }
+            // Numbers that don't fit into a datum are an error.
+            if (!std::isfinite(out->num)) {
+                return false;
+            }
+            out->datum = NULL;
+        }
+        return true;
+    }
+private:
+    int type;
+    std::vector<scoped_ptr_t<value_node_t> > args;
+};
+
+// Uses a value where a boolean is expected.
+class bool_value_node_t : public pred_node_t {
+public:
+    explicit bool_value_node_t(scoped_ptr_t<value_node_t> &&_value)
+        : value(std::move(_value)) { }
+    result_t test(const datum_t *row) const {
+        pred_value_t v;
+        if (!value->eval(row, &v) || v.get_type() != datum_t::R_BOOL) {
+            return result_t::UNKNOWN;
+        }
+        return v.datum->as_bool() ? result_t::MATCH : result_t::NO_MATCH;
+    }
+private:
+    scoped_ptr_t<value_node_t> value;
+};
+
+// True if JavaScript orders `a` and `b` like `scalar_cmp`: two numbers, or two strings
+// without characters outside the BMP (JavaScript compares UTF-16 code units, which
+// puts those before U+E000 to U+FFFF).
+static bool js_orders_alike(const pred_value_t &a, const pred_value_t &b) {
+    const datum_t::type_t type = a.get_type();
+    if (type != b.get_type()) {
+        return false;
+    }
+    if (type == datum_t::R_NUM) {
+        return true;
+    }
+    if (type != datum_t::R_STR) {
+        return false;
+    }
+    const pred_value_t *values[2] = { &a, &b };
+    for (int i = 0; i < 2; ++i) {
+        const wire_string_t &str = values[i]->datum->as_str();
+        const uint8_t *data = reinterpret_cast<const uint8_t *>(str.data());
+        for (size_t j = 0; j < str.size(); ++j) {
+            if (data[j] >= 0xF0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+class compare_node_t : public pred_node_t {
+public:
+    compare_node_t(int _type, std::vector<scoped_ptr_t<value_node_t> > &&_args,
+                   comparisons_t _comparisons)
+        : type(_type), args(std::move(_args)), comparisons(_comparisons) { }
+    result_t test(const datum_t *row) const {
+        // Like `predicate_term_t`, stops at the first pair that doesn't hold.
+        const bool invert = type == Term::NE;
+        pred_value_t lhs;
+        if (!args[0]->eval(row, &lhs)) {
+            return result_t::UNKNOWN;
+        }
+        for (size_t i = 1; i < args.size(); ++i) {
+            pred_value_t rhs;
+            int c;
+            if (!args[i]->eval(row, &rhs) || !scalar_cmp(lhs, rhs, &c)) {
+                return result_t::UNKNOWN;
+            }
+            if (comparisons == comparisons_t::JAVASCRIPT && type != Term::EQ
+                && type != Term::NE && !js_orders_alike(lhs, rhs)) {
+                return result_t::UNKNOWN;
+            }
+            if (!holds(c)) {
+                return invert ? result_t::MATCH : result_t::NO_MATCH;
+            }
+            lhs = rhs;
+        }
+        return invert ? result_t::NO_MATCH : result_t::MATCH;
+    }
+private:
+    bool holds(int c) const {
+        switch (type) {
+        case Term::EQ: // fallthru
+        case Term::NE: return c == 0;
+        case Term::LT: return c < 0;
+        case Term::LE: return c <= 0;
+        case Term::GT: return c > 0;
+        case Term::GE: return c >= 0;
+        default: unreachable();
+        }
+    }
+
+    int type;
+    std::vector<scoped_ptr_t<value_node_t> > args;
+    comparisons_t comparisons;
+};
+
+class not_node_t : public pred_node_t {
+public:
+    explicit not_node_t(scoped_ptr_t<pred_node_t> &&_arg) : arg(std::move(_arg)) { }
+    result_t test(const datum_t *row) const {
+        switch (arg->test(row)) {
+        case result_t::MATCH: return result_t::NO_MATCH;
+        case result_t::NO_MATCH: return result_t::MATCH;
+        case result_t::UNKNOWN: return result_t::UNKNOWN;
+        default: unreachable();
+        }
+    }
+private:
+    scoped_ptr_t<pred_node_t> arg;
+};
+
+// `and` and `or`, which stop at the first argument that decides them.
+class all_any_node_t : public pred_node_t {
+public:
+    all_any_node_t(bool _is_all, std::vector<scoped_ptr_t<pred_node_t> > &&_args)
+        : is_all(_is_all), args(std::move(_args)) { }
+    result_t test(const datum_t *row) const {
+        const result_t decides = is_all ? result_t::NO_MATCH : result_t::MATCH;
+        for (auto it = args.begin(); it != args.end(); ++it) {
+            const result_t res = (*it)->test(row);
+            if (res == decides || res == result_t::UNKNOWN) {
+                return res;
+            }
+        }
+        return is_all ? result_t::MATCH : result_t::NO_MATCH;
+    }
+private:
+    bool is_all;
+    std::vector<scoped_ptr_t<pred_node_t> > args;
+};
+
+class has_fields_node_t : public pred_node_t {
+public:
+    has_fields_node_t(scoped_ptr_t<value_node_t> &&_obj,
+                      std::vector<std::string> &&_fields)
+        : obj(std::move(_obj)), fields(std::move(_fields)) { }
+    result_t test(const datum_t *row) const {
+        pred_value_t v;
+        // On arrays `has_fields` filters them instead.
+        if (!obj->eval(row, &v) || v.get_type() != datum_t::R_OBJECT) {
+            return result_t::UNKNOWN;
+        }
+        const datum_object_t &o = v.datum->as_object();
+        for (auto it = fields.begin(); it != fields.end(); ++it) {
+            auto jt = o.find(*it);
+            if (jt == o.end() || jt->second->get_type() == datum_t::R_NULL) {
+                return result_t::NO_MATCH;
+            }
+        }
+        return result_t::MATCH;
+    }
+private:
+    scoped_ptr_t<value_node_t> obj;
+    std::vector<std::string> fields;
+};
+
+// An object shortcut, like `filter_match` in func.cc.
+class match_node_t : public pred_node_t {
+public:
+    explicit match_node_t(counted_t<const datum_t> &&_predicate)
+        : predicate(std::move(_predicate)) { }
+    result_t test(const datum_t *row) const {
+        return match(predicate.get(), row);
+    }
+private:
+    static result_t match(const datum_t *pred, const datum_t *value) {
+        if (pred->is_ptype() || value->get_type() != datum_t::R_OBJECT) {
+            return result_t::UNKNOWN;
+        }
+        const datum_object_t &pred_obj = pred->as_object();
+        const datum_object_t &obj = value->as_object();
+        for (auto it = pred_obj.begin(); it != pred_obj.end(); ++it) {
+            auto elt = obj.find(it->first);
+            if (elt == obj.end()) {
+                return result_t::UNKNOWN;
+            }
+            if (it->second->get_type() == datum_t::R_OBJECT
+                && elt->second->get_type() == datum_t::R_OBJECT) {
+                const result_t res = match(it->second.get(), elt->second.get());
+                if (res != result_t::MATCH) {
+                    return res;
+                }
+            } else {
+                pred_value_t a, b;
+                a.datum = elt->second.get();
+                b.datum = it->second.get();
+                int c;
+                if (!scalar_cmp(a, b, &c)) {
+                    return result_t::UNKNOWN;
+                }
+                if (c != 0) {
+                    return result_t::NO_MATCH;
+                }
+            }
+        }
+        return result_t::MATCH;
+    }
+
+    counted_t<const datum_t> predicate;
+};
+
+// Uses a predicate where a value is expected.
+class pred_value_node_t : public value_node_t {
+public:
+    explicit pred_value_node_t(scoped_ptr_t<pred_node_t> &&_pred)
+        : pred(std::move(_pred)),
+          true_datum(make_counted<const datum_t>(datum_t::R_BOOL, true)),
+          false_datum(make_counted<const datum_t>(datum_t::R_BOOL, false)) { }
+    bool eval(const datum_t *row, pred_value_t *out) const {
+        switch (pred->test(row)) {
+        case result_t::MATCH: out->datum = true_datum.get(); return true;
+        case result_t::NO_MATCH: out->datum = false_datum.get(); return true;
+        case result_t::UNKNOWN: return false;
+        default: unreachable();
+        }
+    }
+private:
+    scoped_ptr_t<pred_node_t> pred;
+    counted_t<const datum_t> true_datum, false_datum;
+};
+
+// Only takes a boolean condition; `branch` treats anything but `false` and `null` as
+// true, which JavaScript doesn't.
+class branch_node_t : public value_node_t {
+public:
+    branch_node_t(scoped_ptr_t<pred_node_t> &&_test,
+                  scoped_ptr_t<value_node_t> &&_true_branch,
+                  scoped_ptr_t<value_node_t> &&_false_branch)
+        : test(std::move(_test)),
+          true_branch(std::move(_true_branch)),
+          false_branch(std::move(_false_branch)) { }
+    bool eval(const datum_t *row, pred_value_t *out) const {
+        switch (test->test(row)) {
+        case result_t::MATCH: return true_branch->eval(row, out);
+        case result_t::NO_MATCH: return false_branch->eval(row, out);
+        case result_t::UNKNOWN: return false;
+        default: unreachable();
+        }
+    }
+private:
+    scoped_ptr_t<pred_node_t> test;
+    scoped_ptr_t<value_node_t> true_branch, false_branch;
+};
+
+class func_compiler_t {
+public:
+    func_compiler_t(const std::vector<sym_t> &_arg_names, comparisons_t _comparisons)
+        : arg_names(_arg_names), comparisons(_comparisons) {
+        // `reql_func_t::call` checks the number of arguments.
+        guarantee(arg_names.size() == 1);
+    }
+
+    // These return an empty pointer if they don't know something in `t`.
+    scoped_ptr_t<value_node_t> compile_value(const Term &t) {
+        if (t.optargs_size() != 0) {
+            return scoped_ptr_t<value_node_t>();
+        }
+        switch (t.type()) {
+        case Term::DATUM:
+            return make_scoped<constant_node_t>(
+                make_counted<const datum_t>(&t.datum()));
+        case Term::VAR:
+            if (t.args_size() == 1
+                && t.args(0).type() == Term::DATUM
+                && t.args(0).datum().type() == Datum::R_NUM
+                && t.args(0).datum().r_num() == arg_names[0].value) {
+                return make_scoped<row_node_t>();
+            }
+            break;
+        case Term::IMPLICIT_VAR:
+            // There are no nested functions, so this is our argument if it's anything.
+            if (t.args_size() == 0 && function_emits_implicit_variable(arg_names)) {
+                return make_scoped<row_node_t>();
+            }
+            break;
+        case Term::GET_FIELD:
+            if (t.args_size() == 2 && t.args(1).type() == Term::DATUM
+                && t.args(1).datum().type() == Datum::R_STR) {
+                scoped_ptr_t<value_node_t> obj = compile_value(t.args(0));
+                if (obj.has()) {
+                    return make_scoped<get_field_node_t>(std::move(obj),
+                                                         t.args(1).datum().r_str());
+                }
+            }
+            break;
+        case Term::ADD: // fallthru
+        case Term::SUB: // fallthru
+        case Term::MUL: // fallthru
+        case Term::DIV: {
+            std::vector<scoped_ptr_t<value_node_t> > args;
+            if (compile_values(t, 1, &args)) {
+                return make_scoped<arith_node_t>(t.type(), std::move(args));
+            }
+        } break;
+        case Term::BRANCH:
+            if (t.args_size() == 3) {
+                scoped_ptr_t<pred_node_t> test = compile_pred(t.args(0));
+                scoped_ptr_t<value_node_t> true_branch = compile_value(t.args(1));
+                scoped_ptr_t<value_node_t> false_branch = compile_value(t.args(2));
+                if (test.has() && true_branch.has() && false_branch.has()) {
+                    return make_scoped<branch_node_t>(std::move(test),
+                                                      std::move(true_branch),
+                                                      std::move(false_branch));
+                }
+            }
+            break;
+        case Term::EQ: // fallthru
+        case Term::NE: // fallthru
+        case Term::LT: // fallthru
+        case Term::LE: // fallthru
+        case Term::GT: // fallthru
+        case Term::GE: // fallthru
+        case Term::NOT: // fallthru
+        case Term::ALL: // fallthru
+        case Term::ANY: // fallthru
+        case Term::HAS_FIELDS: {
+            scoped_ptr_t<pred_node_t> pred = compile_pred(t);
+            if (pred.has()) {
+                return make_scoped<pred_value_node_t>(std::move(pred));
+            }
+        } break;
+        default: break;
+        }
+        return scoped_ptr_t<value_node_t>();
+    }
+
+    scoped_ptr_t<pred_node_t> compile_pred(const Term &t) {
+        if (t.optargs_size() != 0) {
+            return scoped_ptr_t<pred_node_t>();
+        }
+        switch (t.type()) {
+        case Term::EQ: // fallthru
+        case Term::NE: // fallthru
+        case Term::LT: // fallthru
+        case Term::LE: // fallthru
+        case Term::GT: // fallthru
+        case Term::GE: {
+            std::vector<scoped_ptr_t<value_node_t> > args;
+            if (compile_values(t, 2, &args)) {
+                return make_scoped<compare_node_t>(t.type(), std::move(args),
+                                                   comparisons);
+            }
+            return scoped_ptr_t<pred_node_t>();
+        }
+        case Term::NOT: {
+            if (t.args_size() == 1) {
+                scoped_ptr_t<pred_node_t> arg = compile_pred(t.args(0));
+                if (arg.has()) {
+                    return make_scoped<not_node_t>(std::move(arg));
+                }
+            }
+            return scoped_ptr_t<pred_node_t>();
+        }
+        case Term::ALL: // fallthru
+        case Term::ANY: {
+            if (t.args_size() < 1) {
+                return scoped_ptr_t<pred_node_t>();
+            }
+            std::vector<scoped_ptr_t<pred_node_t> > args;
+            for (int i = 0; i < t.args_size(); ++i) {
+                args.push_back(compile_pred(t.args(i)));
+                if (!args.back().has()) {
+                    return scoped_ptr_t<pred_node_t>();
+                }
+            }
+            return make_scoped<all_any_node_t>(t.type() == Term::ALL, std::move(args));
+        }
+        case Term::HAS_FIELDS: {
+            if (t.args_size() < 2) {
+                return scoped_ptr_t<pred_node_t>();
+            }
+            std::vector<std::string> fields;
+            for (int i = 1; i < t.args_size(); ++i) {
+                if (t.args(i).type() != Term::DATUM
+                    || t.args(i).datum().type() != Datum::R_STR) {
+                    return scoped_ptr_t<pred_node_t>();
+                }
+                fields.push_back(t.args(i).datum().r_str());
+            }
+            scoped_ptr_t<value_node_t> obj = compile_value(t.args(0));
+            if (!obj.has()) {
+                return scoped_ptr_t<pred_node_t>();
+            }
+            return make_scoped<has_fields_node_t>(std::move(obj), std::move(fields));
+        }
+        default: {
+            scoped_ptr_t<value_node_t> value = compile_value(t);
+            if (!value.has()) {
+                return scoped_ptr_t<pred_node_t>();
+            }
+            return make_scoped<bool_value_node_t>(std::move(value));
+        }
+        }
+    }
+
+private:
+    bool compile_values(const Term &t, int min_args,
+                        std::vector<scoped_ptr_t<value_node_t> > *out) {
+        if (t.args_size() < min_args) {
+            return false;
+        }
+        for (int i = 0; i < t.args_size(); ++i) {
+            out->push_back(compile_value(t.args(i)));
+            if (!out->back().has()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const std::vector<sym_t> &arg_names;
+    comparisons_t comparisons;
+};
+
+filter_predicate_t::filter_predicate_t(scoped_ptr_t<pred_node_t> &&_root)
+    : root(std::move(_root)) { }
+
+filter_predicate_t::~filter_predicate_t() { }
+
+result_t filter_predicate_t::test(const counted_t<const datum_t> &row) const {
+    return root->test(row.get());
+}
+
+scoped_ptr_t<filter_predicate_t> compile_filter_predicate(
+        const std::vector<sym_t> &arg_names, const Term &body,
+        comparisons_t comparisons) {
+    if (arg_names.size() != 1) {
+        return scoped_ptr_t<filter_predicate_t>();
+    }
+    scoped_ptr_t<pred_node_t> root;
+    try {
+        if (body.type() == Term::DATUM && body.datum().type() == Datum::R_OBJECT) {
+            // Like `reql_func_t::filter_helper`, an object constant is a shortcut.
+            counted_t<const datum_t> predicate
+                = make_counted<const datum_t>(&body.datum());
+            if (!predicate->is_ptype()) {
+                root.init(new match_node_t(std::move(predicate)));
+            }
+        } else if (body.type() != Term::MAKE_OBJ) {
+            root = func_compiler_t(arg_names, comparisons).compile_pred(body);
+        }
+    } catch (const base_exc_t &e) {
+        // A constant that isn't a valid datum; evaluating the function reports it.
+        return scoped_ptr_t<filter_predicate_t>();
+    }
+    if (!root.has()) {
+        return scoped_ptr_t<filter_predicate_t>();
+    }
+    return scoped_ptr_t<filter_predicate_t>(new filter_predicate_t(std::move(root)));
+}
+
+map_function_t::map_function_t(scoped_ptr_t<value_node_t> &&_root)
+    : root(std::move(_root)) { }
+
+map_function_t::~map_function_t() { }
+
+bool map_function_t::apply(const counted_t<const datum_t> &row,
+                           counted_t<const datum_t> *out) const {
+    pred_value_t v;
+    if (!root->eval(row.get(), &v)) {
+        return false;
+    }
+    if (v.datum != NULL) {
+        *out = counted_t<const datum_t>(v.datum);
+    } else {
+        *out = make_counted<const datum_t>(v.num);
+    }
+    return true;
+}
+
+scoped_ptr_t<map_function_t> compile_map_function(
+        const std::vector<sym_t> &arg_names, const Term &body,
+        comparisons_t comparisons) {
+    if (arg_names.size() != 1) {
+        return scoped_ptr_t<map_function_t>();
+    }
+    scoped_ptr_t<value_node_t> root;
+    try {
+        root = func_compiler_t(arg_names, comparisons).compile_value(body);
+    } catch (const base_exc_t &e) {
+        return scoped_ptr_t<map_function_t>();
+    }
+    if (!root.has()) {
+        return scoped_ptr_t<map_function_t>();
+    }
+    return scoped_ptr_t<map_function_t>(new map_function_t(std::move(root)));
+}
+
+}  // namespace ql
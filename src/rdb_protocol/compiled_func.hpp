@@ -0,0 +1,87 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_COMPILED_FUNC_HPP_
+#define RDB_PROTOCOL_COMPILED_FUNC_HPP_
+
+#include <vector>
+
+#include "containers/counted.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/sym.hpp"
+
+class Term;
+
+namespace ql {
+
+class datum_t;
+class pred_node_t;
+class value_node_t;
+
+/* Functions of one argument lowered into trees of closures that work on rows
+directly, so that `map` and `filter` can run them over a batch without evaluating
+terms or making a datum for every intermediate value.  They know the common shapes:
+fields of the argument, constants, arithmetic on numbers, comparisons, `and`, `or`,
+`not`, `branch`, `has_fields` of field names, and (for `filter`) object shortcuts like
+`filter({name: "x"})`.
+
+They never give a result for a row that evaluating the function would have raised an
+error for (a missing field, a type mismatch, a `filter` result that isn't a
+boolean...).  The caller has to call the function the usual way for those rows, so
+the error, or the `default` optarg of `filter`, behaves as before. */
+
+// How `lt`, `le`, `gt` and `ge` order values.  ReQL orders values of different types
+// by their type names.  JavaScript converts them, so for the bodies
+// `translate_js_function` makes those only give a result for two numbers or two
+// strings.
+enum class comparisons_t { REQL, JAVASCRIPT };
+
+class filter_predicate_t {
+public:
+    enum class result_t { MATCH, NO_MATCH, UNKNOWN };
+
+    ~filter_predicate_t();
+
+    result_t test(const counted_t<const datum_t> &row) const;
+
+private:
+    friend scoped_ptr_t<filter_predicate_t> compile_filter_predicate(
+        const std::vector<sym_t> &arg_names, const Term &body,
+        comparisons_t comparisons);
+    explicit filter_predicate_t(scoped_ptr_t<pred_node_t> &&_root);
+
+    scoped_ptr_t<pred_node_t> root;
+
+    DISABLE_COPYING(filter_predicate_t);
+};
+
+class map_function_t {
+public:
+    ~map_function_t();
+
+    // Returns false, and leaves `*out` alone, if the function has to be called.
+    MUST_USE bool apply(const counted_t<const datum_t> &row,
+                        counted_t<const datum_t> *out) const;
+
+private:
+    friend scoped_ptr_t<map_function_t> compile_map_function(
+        const std::vector<sym_t> &arg_names, const Term &body,
+        comparisons_t comparisons);
+    explicit map_function_t(scoped_ptr_t<value_node_t> &&_root);
+
+    scoped_ptr_t<value_node_t> root;
+
+    DISABLE_COPYING(map_function_t);
+};
+
+// These lower the function with the arguments `arg_names` and the body `body`.  They
+// return an empty pointer if it has anything they don't know.  `body` is only looked
+// at here.
+scoped_ptr_t<filter_predicate_t> compile_filter_predicate(
+    const std::vector<sym_t> &arg_names, const Term &body,
+    comparisons_t comparisons = comparisons_t::REQL);
+scoped_ptr_t<map_function_t> compile_map_function(
+    const std::vector<sym_t> &arg_names, const Term &body,
+    comparisons_t comparisons = comparisons_t::REQL);
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_COMPILED_FUNC_HPP_
@@ -7,17 +7,24 @@
 #include <stdlib.h>
 
 #include <algorithm>
+#include <limits>
+#include <unordered_map>
 
 #include "errors.hpp"
 #include <boost/detail/endian.hpp>
 
+#include "config/args.hpp"
+#include "containers/archive/buffer_group_stream.hpp"
 #include "containers/archive/stl_types.hpp"
+#include "containers/buffer_group.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/error.hpp"
+#include "rdb_protocol/json_parser.hpp"
 #include "rdb_protocol/pseudo_literal.hpp"
 #include "rdb_protocol/pseudo_time.hpp"
 #include "rdb_protocol/shards.hpp"
 #include "stl_utils.hpp"
+#include "thread_local.hpp"
 
 namespace ql {
 
@@ -59,15 +66,22 @@ datum_t::datum_t(std::vector<counted_t<const datum_t> > &&_array)
 
 datum_t::datum_t(std::map<std::string, counted_t<const datum_t> > &&_object)
     : type(R_OBJECT),
-      r_object(new std::map<std::string, counted_t<const datum_t> >(
-                   std::move(_object))) {
+      r_object(new datum_object_t(std::move(_object))) {
+    maybe_sanitize_ptype();
+}
+
+datum_t::datum_t(datum_object_t &&_object)
+    : type(R_OBJECT),
+      r_object(new datum_object_t(std::move(_object))) {
     maybe_sanitize_ptype();
 }
 
 datum_t::datum_t(grouped_data_t &&gd)
     : type(R_OBJECT),
-      r_object(new std::map<std::string, counted_t<const datum_t> >()) {
-    (*r_object)[reql_type_string] = make_counted<const datum_t>("GROUPED_DATA");
+      r_object(new datum_object_t()) {
+    UNUSED bool b = r_object->set(reql_type_string,
+                                  make_counted<const datum_t>("GROUPED_DATA"),
+                                  CLOBBER);
     std::vector<counted_t<const datum_t> > v;
     v.reserve(gd.size());
     for (auto kv = gd.begin(); kv != gd.end(); ++kv) {
@@ -75,7 +89,7 @@ datum_t::datum_t(grouped_data_t &&gd)
                         std::vector<counted_t<const datum_t> >{
                             std::move(kv->first), std::move(kv->second)}));
     }
-    (*r_object)["data"] = make_counted<const datum_t>(std::move(v));
+    b = r_object->set("data", make_counted<const datum_t>(std::move(v)), CLOBBER);
     // We don't sanitize the ptype because this is a fake ptype that should only
     // be used for serialization.
 }
@@ -93,7 +107,7 @@ datum_t::datum_t(datum_t::type_t _type) : type(_type) {
         r_array = new std::vector<counted_t<const datum_t> >();
     } break;
     case R_OBJECT: {
-        r_object = new std::map<std::string, counted_t<const datum_t> >();
+        r_object = new datum_object_t();
     } break;
     case UNINITIALIZED: // fallthru
     default: unreachable();
@@ -122,6 +136,38 @@ datum_t::~datum_t() {
     }
 }
 
+// The memory of the freed datums this thread holds on to, linked through their
+// first bytes.  A datum freed on another thread than it was made on goes to the
+// other thread's pool, which is fine, since it's just memory.
+TLS_with_init(void *, datum_pool, NULL);
+TLS_with_init(int, datum_pool_size, 0);
+
+void *datum_t::operator new(size_t size) {
+    CT_ASSERT(sizeof(datum_t) >= sizeof(void *));
+    if (size == sizeof(datum_t)) {
+        void *p = TLS_get_datum_pool();
+        if (p != NULL) {
+            TLS_set_datum_pool(*static_cast<void **>(p));
+            TLS_set_datum_pool_size(TLS_get_datum_pool_size() - 1);
+            return p;
+        }
+    }
+    return ::operator new(size);
+}
+
+void datum_t::operator delete(void *p, size_t size) {
+    if (p == NULL) {
+        return;
+    }
+    if (size == sizeof(datum_t) && TLS_get_datum_pool_size() < DATUM_POOL_MAX_SIZE) {
+        *static_cast<void **>(p) = TLS_get_datum_pool();
+        TLS_set_datum_pool(p);
+        TLS_set_datum_pool_size(TLS_get_datum_pool_size() + 1);
+        return;
+    }
+    ::operator delete(p);
+}
+
 void datum_t::init_str(size_t size, const char *data) {
     type = R_STR;
     r_str = wire_string_t::create_and_init(size, data);
@@ -134,7 +180,7 @@ void datum_t::init_array() {
 
 void datum_t::init_object() {
     type = R_OBJECT;
-    r_object = new std::map<std::string, counted_t<const datum_t> >();
+    r_object = new datum_object_t();
 }
 
 void datum_t::init_json(cJSON *json) {
@@ -171,12 +217,18 @@ void datum_t::init_json(cJSON *json) {
     } break;
     case cJSON_Object: {
         init_object();
+        // Sorting the fields once is cheaper than inserting them one at a time.
+        std::vector<datum_object_t::value_type> fields;
         json_object_iterator_t it(json);
         while (cJSON *item = it.next()) {
-            bool conflict = add(item->string, make_counted<datum_t>(item));
-            rcheck(!conflict, base_exc_t::GENERIC,
-                   strprintf("Duplicate key `%s` in JSON.", item->string));
+            check_str_validity(item->string);
+            fields.push_back(std::make_pair(std::string(item->string),
+                                            make_counted<const datum_t>(item)));
         }
+        std::string duplicate_key;
+        rcheck(r_object->assign(std::move(fields), &duplicate_key),
+               base_exc_t::GENERIC,
+               strprintf("Duplicate key `%s` in JSON.", duplicate_key.c_str()));
         maybe_sanitize_ptype();
     } break;
     default: unreachable();
@@ -205,6 +257,36 @@ void datum_t::check_str_validity(const std::string &str) {
                      str.c_str(), null_offset));
 }
 
+void datum_t::init_shallow_copy(const datum_t &other) {
+    switch (other.type) {
+    case R_NULL: {
+        type = R_NULL;
+        r_str = NULL;
+    } break;
+    case R_BOOL: {
+        type = R_BOOL;
+        r_bool = other.r_bool;
+    } break;
+    case R_NUM: {
+        type = R_NUM;
+        r_num = other.r_num;
+    } break;
+    case R_STR: {
+        init_str(other.r_str->size(), other.r_str->data());
+    } break;
+    case R_ARRAY: {
+        type = R_ARRAY;
+        r_array = new std::vector<counted_t<const datum_t> >(*other.r_array);
+    } break;
+    case R_OBJECT: {
+        type = R_OBJECT;
+        r_object = new datum_object_t(*other.r_object);
+    } break;
+    case UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
 datum_t::datum_t(cJSON *json) {
     init_json(json);
 }
@@ -563,6 +645,45 @@ boost::optional<uint64_t> datum_t::extract_tag(const store_key_t &key) {
     return extract_tag(key_to_unescaped_str(key));
 }
 
+counted_t<const datum_t> datum_t::extract_secondary_value(const store_key_t &key) {
+    if (key_is_truncated(key)) {
+        return counted_t<const datum_t>();
+    }
+    const std::string secondary = extract_secondary(key_to_unescaped_str(key));
+    if (secondary.empty()) {
+        return counted_t<const datum_t>();
+    }
+    switch (secondary[0]) {
+    case 'N': {
+        // The inverse of `num_to_str_key`.
+        const size_t hex_size = sizeof(double) * 2;
+        if (secondary.size() < 1 + hex_size) {
+            return counted_t<const datum_t>();
+        }
+        union {
+            double d;
+            uint64_t u;
+        } packed;
+        packed.u = strtoull(secondary.substr(1, hex_size).c_str(), NULL, 16);
+        if (packed.u & (1ULL << 63)) {
+            packed.u ^= (1ULL << 63);
+        } else {
+            packed.u = ~packed.u;
+        }
+        return make_counted<const datum_t>(packed.d);
+    }
+    case 'S':
+        return make_counted<const datum_t>(secondary.substr(1));
+    case 'B':
+        if (secondary == "Bt" || secondary == "Bf") {
+            return make_counted<const datum_t>(R_BOOL, secondary == "Bt");
+        }
+        return counted_t<const datum_t>();
+    default:
+        return counted_t<const datum_t>();
+    }
+}
+
 // This function returns a store_key_t suitable for searching by a
 // secondary-index.  This is needed because secondary indexes may be truncated,
 // but the amount truncated depends on the length of the primary key.  Since we
@@ -743,8 +864,7 @@ counted_t<const datum_t> datum_t::get(size_t index, throw_bool_t throw_bool) con
 
 counted_t<const datum_t> datum_t::get(const std::string &key,
                                       throw_bool_t throw_bool) const {
-    std::map<std::string, counted_t<const datum_t> >::const_iterator it
-        = as_object().find(key);
+    datum_object_t::const_iterator it = as_object().find(key);
     if (it != as_object().end()) return it->second;
     if (throw_bool == THROW) {
         rfail(base_exc_t::NON_EXISTENCE,
@@ -753,11 +873,126 @@ counted_t<const datum_t> datum_t::get(const std::string &key,
     return counted_t<const datum_t>();
 }
 
-const std::map<std::string, counted_t<const datum_t> > &datum_t::as_object() const {
+const datum_object_t &datum_t::as_object() const {
     check_type(R_OBJECT);
     return *r_object;
 }
 
+datum_object_t::datum_object_t(std::map<std::string, counted_t<const datum_t> > &&map) {
+    // The map is already sorted.
+    fields.reserve(map.size());
+    for (auto it = map.begin(); it != map.end(); ++it) {
+        fields.push_back(std::make_pair(it->first, std::move(it->second)));
+    }
+}
+
+// The names interned on this thread.  Keys hold onto their names themselves, so
+// we can forget all of them when there get to be too many.
+typedef std::unordered_map<std::string, datum_key_t> key_intern_table_t;
+TLS_with_init(key_intern_table_t *, key_intern_table, NULL);
+
+datum_key_t::datum_key_t(const std::string &_name) {
+    *this = intern(_name.data(), _name.size());
+}
+
+datum_key_t::datum_key_t(std::string &&_name) {
+    if (_name.size() > DATUM_KEY_MAX_INTERNED_SIZE) {
+        name = make_counted<const name_t>(std::move(_name));
+    } else {
+        *this = intern(_name.data(), _name.size());
+    }
+}
+
+datum_key_t::datum_key_t(const char *_name) {
+    *this = intern(_name, strlen(_name));
+}
+
+datum_key_t datum_key_t::intern(const char *data, size_t size) {
+    datum_key_t key;
+    if (size > DATUM_KEY_MAX_INTERNED_SIZE) {
+        key.name = make_counted<const name_t>(std::string(data, size));
+        return key;
+    }
+    key_intern_table_t *table = TLS_get_key_intern_table();
+    if (table == NULL) {
+        table = new key_intern_table_t;
+        TLS_set_key_intern_table(table);
+    }
+    std::string str(data, size);
+    auto it = table->find(str);
+    if (it != table->end()) {
+        return it->second;
+    }
+    if (table->size() >= DATUM_KEY_INTERN_TABLE_SIZE) {
+        table->clear();
+    }
+    key.name = make_counted<const name_t>(std::string(str));
+    table->insert(std::make_pair(std::move(str), key));
+    return key;
+}
+
+const std::string &datum_key_t::str() const {
+    static const std::string empty_name;
+    return name.has() ? name->value : empty_name;
+}
+
+static bool field_key_less(const datum_object_t::value_type &field,
+                           const std::string &key) {
+    return field.first < key;
+}
+
+datum_object_t::const_iterator datum_object_t::find(const std::string &key) const {
+    const_iterator it = std::lower_bound(fields.begin(), fields.end(), key,
+                                         &field_key_less);
+    return it != fields.end() && it->first == key ? it : fields.end();
+}
+
+std::vector<datum_object_t::value_type>::iterator
+datum_object_t::lower_bound(const std::string &key) {
+    return std::lower_bound(fields.begin(), fields.end(), key, &field_key_less);
+}
+
+MUST_USE bool datum_object_t::set(const std::string &key,
+                                  counted_t<const datum_t> val,
+                                  clobber_bool_t clobber_bool) {
+    auto it = lower_bound(key);
+    if (it != fields.end() && it->first == key) {
+        if (clobber_bool == CLOBBER) {
+            it->second = std::move(val);
+        }
+        return true;
+    }
+    fields.insert(it, std::make_pair(key, std::move(val)));
+    return false;
+}
+
+MUST_USE bool datum_object_t::erase(const std::string &key) {
+    auto it = lower_bound(key);
+    if (it != fields.end() && it->first == key) {
+        fields.erase(it);
+        return true;
+    }
+    return false;
+}
+
+MUST_USE bool datum_object_t::assign(std::vector<value_type> &&unsorted_fields,
+                                     std::string *duplicate_key_out) {
+    fields = std::move(unsorted_fields);
+    auto key_less = [](const value_type &x, const value_type &y) {
+        return x.first < y.first;
+    };
+    if (!std::is_sorted(fields.begin(), fields.end(), key_less)) {
+        std::sort(fields.begin(), fields.end(), key_less);
+    }
+    for (size_t i = 1; i < fields.size(); ++i) {
+        if (fields[i - 1].first == fields[i].first) {
+            *duplicate_key_out = fields[i].first;
+            return false;
+        }
+    }
+    return true;
+}
+
 cJSON *datum_t::as_json_raw() const {
     switch (get_type()) {
     case R_NULL: return cJSON_CreateNull();
@@ -773,8 +1008,8 @@ cJSON *datum_t::as_json_raw() const {
     } break;
     case R_OBJECT: {
         scoped_cJSON_t obj(cJSON_CreateObject());
-        for (std::map<std::string, counted_t<const datum_t> >::const_iterator
-                 it = r_object->begin(); it != r_object->end(); ++it) {
+        for (datum_object_t::const_iterator it = r_object->begin();
+             it != r_object->end(); ++it) {
             obj.AddItemToObject(it->first.c_str(), it->second->as_json_raw());
         }
         return obj.release();
@@ -789,6 +1024,76 @@ scoped_cJSON_t datum_t::as_json() const {
     return scoped_cJSON_t(as_json_raw());
 }
 
+// Escapes `str` the way cJSON's `print_string_ptr` does.
+static void write_json_string(const char *str, size_t size, std::string *out) {
+    out->push_back('"');
+    for (size_t i = 0; i < size; ++i) {
+        const unsigned char c = str[i];
+        switch (c) {
+        case '\\': out->append("\\\\"); break;
+        case '"': out->append("\\\""); break;
+        case '\b': out->append("\\b"); break;
+        case '\f': out->append("\\f"); break;
+        case '\n': out->append("\\n"); break;
+        case '\r': out->append("\\r"); break;
+        case '\t': out->append("\\t"); break;
+        default:
+            if (c < 32) {
+                char buf[8];
+                int res = snprintf(buf, sizeof(buf), "\\u%04x", c);
+                guarantee(res == 6);
+                out->append(buf, res);
+            } else {
+                out->push_back(c);
+            }
+        }
+    }
+    out->push_back('"');
+}
+
+void datum_t::write_json(std::string *out) const {
+    switch (get_type()) {
+    case R_NULL: out->append("null"); break;
+    case R_BOOL: out->append(r_bool ? "true" : "false"); break;
+    case R_NUM: {
+        // so we can use `isfinite` in a GCC 4.4.3-compatible way
+        using namespace std;  // NOLINT(build/namespaces)
+        r_sanity_check(isfinite(r_num));
+        // The format cJSON's `print_number` uses.
+        char buf[64];
+        int res = snprintf(buf, sizeof(buf), "%.20g", r_num);
+        guarantee(res > 0 && static_cast<size_t>(res) < sizeof(buf));
+        out->append(buf, res);
+    } break;
+    case R_STR: write_json_string(r_str->data(), r_str->size(), out); break;
+    case R_ARRAY: {
+        out->push_back('[');
+        for (size_t i = 0; i < r_array->size(); ++i) {
+            if (i != 0) {
+                out->push_back(',');
+            }
+            (*r_array)[i]->write_json(out);
+        }
+        out->push_back(']');
+    } break;
+    case R_OBJECT: {
+        out->push_back('{');
+        for (datum_object_t::const_iterator it = r_object->begin();
+             it != r_object->end(); ++it) {
+            if (it != r_object->begin()) {
+                out->push_back(',');
+            }
+            write_json_string(it->first.data(), it->first.size(), out);
+            out->push_back(':');
+            it->second->write_json(out);
+        }
+        out->push_back('}');
+    } break;
+    case UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
 // TODO: make STR and OBJECT convertible to sequence?
 counted_t<datum_stream_t>
 datum_t::as_datum_stream(const protob_t<const Backtrace> &backtrace) const {
@@ -821,9 +1126,7 @@ MUST_USE bool datum_t::add(const std::string &key, counted_t<const datum_t> val,
     check_type(R_OBJECT);
     check_str_validity(key);
     r_sanity_check(val.has());
-    bool key_in_obj = r_object->count(key) > 0;
-    if (!key_in_obj || (clobber_bool == CLOBBER)) (*r_object)[key] = val;
-    return key_in_obj;
+    return r_object->set(key, val, clobber_bool);
 }
 
 MUST_USE bool datum_t::delete_field(const std::string &key) {
@@ -834,7 +1137,7 @@ counted_t<const datum_t> datum_t::merge(counted_t<const datum_t> rhs) const {
     if (get_type() != R_OBJECT || rhs->get_type() != R_OBJECT) { return rhs; }
 
     datum_ptr_t d(as_object());
-    const std::map<std::string, counted_t<const datum_t> > &rhs_obj = rhs->as_object();
+    const datum_object_t &rhs_obj = rhs->as_object();
     for (auto it = rhs_obj.begin(); it != rhs_obj.end(); ++it) {
         counted_t<const datum_t> sub_lhs = d->get(it->first, NOTHROW);
         bool is_literal = it->second->is_ptype(pseudo::literal_string);
@@ -860,7 +1163,7 @@ counted_t<const datum_t> datum_t::merge(counted_t<const datum_t> rhs) const {
 counted_t<const datum_t> datum_t::merge(counted_t<const datum_t> rhs,
                                         merge_resoluter_t f) const {
     datum_ptr_t d(as_object());
-    const std::map<std::string, counted_t<const datum_t> > &rhs_obj = rhs->as_object();
+    const datum_object_t &rhs_obj = rhs->as_object();
     for (auto it = rhs_obj.begin(); it != rhs_obj.end(); ++it) {
         if (counted_t<const datum_t> left = get(it->first, NOTHROW)) {
             bool b = d.add(it->first, f(it->first, left, it->second), CLOBBER);
@@ -880,6 +1183,81 @@ int derived_cmp(T a, T b) {
 }
 
 
+// The bytes `append_order_key` starts each datum with.  Plain types are in the order
+// `cmp` puts them in (which is the order of `type_t`), and pseudotypes come after all
+// of them.  Arrays and objects end with a byte below all of these.
+const char ORDER_KEY_END = 0;
+const char ORDER_KEY_FIELD = 1;
+const char ORDER_KEY_PTYPE = datum_t::R_STR + 1;
+
+// Strings end with two NULs, and NULs in them are followed by 0xFF, so a string
+// sorts before any longer string it's a prefix of.
+void append_order_key_string(const char *data, size_t size, std::string *out) {
+    for (size_t i = 0; i < size; ++i) {
+        out->push_back(data[i]);
+        if (data[i] == '\0') {
+            out->push_back('\xFF');
+        }
+    }
+    out->append(2, '\0');
+}
+
+// The bits of the number mangled the way `num_to_str_key` does it, big-endian.
+void append_order_key_num(double d, std::string *out) {
+    union {
+        double d;
+        uint64_t u;
+    } packed;
+    // -0.0 and 0.0 are equal.
+    packed.d = (d == 0) ? 0.0 : d;
+    if (packed.u & (1ULL << 63)) {
+        packed.u = ~packed.u;
+    } else {
+        packed.u ^= (1ULL << 63);
+    }
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        out->push_back(static_cast<char>((packed.u >> shift) & 0xFF));
+    }
+}
+
+void datum_t::append_order_key(std::string *out) const {
+    if (is_ptype()) {
+        out->push_back(ORDER_KEY_PTYPE);
+        const std::string reql_type = get_reql_type();
+        append_order_key_string(reql_type.data(), reql_type.size(), out);
+        rcheck(reql_type == pseudo::time_string, base_exc_t::GENERIC,
+               strprintf("Incomparable type %s.", get_type_name().c_str()));
+        append_order_key_num(get(pseudo::epoch_time_key)->as_num(), out);
+        return;
+    }
+
+    out->push_back(static_cast<char>(get_type()));
+    switch (get_type()) {
+    case R_NULL: break;
+    case R_BOOL: out->push_back(as_bool() ? 1 : 0); break;
+    case R_NUM: append_order_key_num(as_num(), out); break;
+    case R_STR: append_order_key_string(as_str().data(), as_str().size(), out); break;
+    case R_ARRAY: {
+        const std::vector<counted_t<const datum_t> > &arr = as_array();
+        for (auto it = arr.begin(); it != arr.end(); ++it) {
+            (*it)->append_order_key(out);
+        }
+        out->push_back(ORDER_KEY_END);
+    } break;
+    case R_OBJECT: {
+        const datum_object_t &obj = as_object();
+        for (auto it = obj.begin(); it != obj.end(); ++it) {
+            out->push_back(ORDER_KEY_FIELD);
+            append_order_key_string(it->first.data(), it->first.size(), out);
+            it->second->append_order_key(out);
+        }
+        out->push_back(ORDER_KEY_END);
+    } break;
+    case UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
 int datum_t::cmp(const datum_t &rhs) const {
     if (is_ptype() && !rhs.is_ptype()) {
         return 1;
@@ -915,13 +1293,12 @@ int datum_t::cmp(const datum_t &rhs) const {
             }
             return pseudo_cmp(rhs);
         } else {
-            const std::map<std::string, counted_t<const datum_t> > &obj = as_object();
-            const std::map<std::string, counted_t<const datum_t> > &rhs_obj
-                = rhs.as_object();
+            const datum_object_t &obj = as_object();
+            const datum_object_t &rhs_obj = rhs.as_object();
             auto it = obj.begin();
             auto it2 = rhs_obj.begin();
             while (it != obj.end() && it2 != rhs_obj.end()) {
-                int key_cmpval = it->first.compare(it2->first);
+                int key_cmpval = it->first.str().compare(it2->first.str());
                 if (key_cmpval != 0) {
                     return key_cmpval;
                 }
@@ -949,6 +1326,69 @@ bool datum_t::operator<=(const datum_t &rhs) const { return cmp(rhs) <= 0; }
 bool datum_t::operator>(const datum_t &rhs) const { return cmp(rhs) > 0; }
 bool datum_t::operator>=(const datum_t &rhs) const { return cmp(rhs) >= 0; }
 
+// 64-bit FNV-1a.
+static void hash_bytes(const void *data, size_t size, uint64_t *hash) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        *hash ^= bytes[i];
+        *hash *= 1099511628211ULL;
+    }
+}
+
+// This must be kept in sync with `cmp`: whatever it ignores, this has to ignore.
+static void hash_datum(const datum_t &d, uint64_t *hash) {
+    const uint8_t type = d.get_type();
+    hash_bytes(&type, sizeof(type), hash);
+    switch (d.get_type()) {
+    case datum_t::R_NULL: break;
+    case datum_t::R_BOOL: {
+        const uint8_t b = d.as_bool();
+        hash_bytes(&b, sizeof(b), hash);
+    } break;
+    case datum_t::R_NUM: {
+        // 0.0 and -0.0 are equal.
+        const double n = d.as_num() == 0 ? 0.0 : d.as_num();
+        hash_bytes(&n, sizeof(n), hash);
+    } break;
+    case datum_t::R_STR: {
+        const wire_string_t &str = d.as_str();
+        hash_bytes(str.data(), str.size(), hash);
+    } break;
+    case datum_t::R_ARRAY: {
+        const std::vector<counted_t<const datum_t> > &arr = d.as_array();
+        const uint64_t size = arr.size();
+        hash_bytes(&size, sizeof(size), hash);
+        for (auto it = arr.begin(); it != arr.end(); ++it) {
+            hash_datum(**it, hash);
+        }
+    } break;
+    case datum_t::R_OBJECT: {
+        if (d.is_ptype(pseudo::time_string)) {
+            // Times are compared by their epoch time alone.
+            hash_bytes(pseudo::time_string, strlen(pseudo::time_string), hash);
+            hash_datum(*d.get(pseudo::epoch_time_key), hash);
+            break;
+        }
+        const datum_object_t &obj = d.as_object();
+        const uint64_t size = obj.size();
+        hash_bytes(&size, sizeof(size), hash);
+        for (auto it = obj.begin(); it != obj.end(); ++it) {
+            // The terminating '\0' keeps the key from running into the value.
+            hash_bytes(it->first.c_str(), it->first.size() + 1, hash);
+            hash_datum(*it->second, hash);
+        }
+    } break;
+    case datum_t::UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
+uint64_t datum_t::hash() const {
+    uint64_t ret = 14695981039346656037ULL;
+    hash_datum(*this, &ret);
+    return ret;
+}
+
 void datum_t::runtime_fail(base_exc_t::type_t exc_type,
                            const char *test, const char *file, int line,
                            std::string msg) const {
@@ -985,8 +1425,11 @@ void datum_t::init_from_pb(const Datum *d) {
         check_str_validity(r_str);
     } break;
     case Datum::R_JSON: {
-        scoped_cJSON_t cjson(cJSON_Parse(d->r_str().c_str()));
-        init_json(cjson.get());
+        counted_t<const datum_t> parsed = parse_json(d->r_str().data(),
+                                                     d->r_str().size());
+        rcheck(parsed.has(), base_exc_t::GENERIC,
+               "Failed to parse R_JSON datum as JSON.");
+        init_shallow_copy(*parsed);
     } break;
     case Datum::R_ARRAY: {
         init_array();
@@ -996,15 +1439,19 @@ void datum_t::init_from_pb(const Datum *d) {
     } break;
     case Datum::R_OBJECT: {
         init_object();
+        std::vector<datum_object_t::value_type> fields;
+        fields.reserve(d->r_object_size());
         for (int i = 0; i < d->r_object_size(); ++i) {
             const Datum_AssocPair *ap = &d->r_object(i);
             const std::string &key = ap->key();
             check_str_validity(key);
-            rcheck(r_object->count(key) == 0,
-                   base_exc_t::GENERIC,
-                   strprintf("Duplicate key %s in object.", key.c_str()));
-            (*r_object)[key] = make_counted<datum_t>(&ap->val());
+            fields.push_back(
+                std::make_pair(key, make_counted<const datum_t>(&ap->val())));
         }
+        std::string duplicate_key;
+        rcheck(r_object->assign(std::move(fields), &duplicate_key),
+               base_exc_t::GENERIC,
+               strprintf("Duplicate key %s in object.", duplicate_key.c_str()));
         std::set<std::string> allowed_ptypes = { pseudo::literal_string };
         maybe_sanitize_ptype(allowed_ptypes);
     } break;
@@ -1075,7 +1522,7 @@ void datum_t::write_to_protobuf(Datum *d, use_json_t use_json) const {
     } break;
     case use_json_t::YES: {
         d->set_type(Datum::R_JSON);
-        d->set_r_str(as_json().PrintUnformatted());
+        write_json(d->mutable_r_str());
     } break;
     default: unreachable();
     }
@@ -1090,11 +1537,13 @@ enum class datum_serialized_type_t {
     R_STR = 6,
     INT_NEGATIVE = 7,
     INT_POSITIVE = 8,
+    // An object followed by the offsets of its fields; see serialize_for_storage.
+    R_INDEXED_OBJECT = 9,
 };
 
 ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(datum_serialized_type_t, int8_t,
                                       datum_serialized_type_t::R_ARRAY,
-                                      datum_serialized_type_t::INT_POSITIVE);
+                                      datum_serialized_type_t::R_INDEXED_OBJECT);
 
 // This must be kept in sync with operator<<(write_message_t &, const counted_t<const
 // datum_T> &).
@@ -1119,7 +1568,12 @@ size_t serialized_size(const counted_t<const datum_t> &datum) {
         }
     } break;
     case datum_t::R_OBJECT: {
-        sz += serialized_size(datum->as_object());
+        const datum_object_t &value = datum->as_object();
+        sz += varint_uint64_serialized_size(value.size());
+        for (auto it = value.begin(); it != value.end(); ++it) {
+            sz += serialized_size(it->first.str());
+            sz += serialized_size(it->second);
+        }
     } break;
     case datum_t::R_STR: {
         sz += serialized_size(datum->as_str());
@@ -1131,14 +1585,20 @@ size_t serialized_size(const counted_t<const datum_t> &datum) {
     return sz;
 }
 
-write_message_t &operator<<(write_message_t &wm,
+// This writes the same thing as serializing the arrays and objects with the
+// `std::vector` and `std::map` operators would, but doesn't go through
+// `operator<<` for nested datums, which would compute their sizes over and over.
+static void serialize_datum(write_message_t &wm,  // NOLINT(runtime/references)
                             const counted_t<const datum_t> &datum) {
     r_sanity_check(datum.has());
     switch (datum->get_type()) {
     case datum_t::R_ARRAY: {
         wm << datum_serialized_type_t::R_ARRAY;
         const std::vector<counted_t<const datum_t> > &value = datum->as_array();
-        wm << value;
+        serialize_varint_uint64(&wm, value.size());
+        for (auto it = value.begin(); it != value.end(); ++it) {
+            serialize_datum(wm, *it);
+        }
     } break;
     case datum_t::R_BOOL: {
         wm << datum_serialized_type_t::R_BOOL;
@@ -1170,7 +1630,12 @@ write_message_t &operator<<(write_message_t &wm,
     } break;
     case datum_t::R_OBJECT: {
         wm << datum_serialized_type_t::R_OBJECT;
-        wm << datum->as_object();
+        const datum_object_t &value = datum->as_object();
+        serialize_varint_uint64(&wm, value.size());
+        for (auto it = value.begin(); it != value.end(); ++it) {
+            wm << it->first.str();
+            serialize_datum(wm, it->second);
+        }
     } break;
     case datum_t::R_STR: {
         wm << datum_serialized_type_t::R_STR;
@@ -1181,9 +1646,254 @@ write_message_t &operator<<(write_message_t &wm,
     default:
         unreachable();
     }
+}
+
+write_message_t &operator<<(write_message_t &wm,
+                            const counted_t<const datum_t> &datum) {
+    // Datums can be big, so we write each one into a single buffer of the right
+    // size rather than a chain of small ones.
+    wm.reserve(serialized_size(datum));
+    serialize_datum(wm, datum);
     return wm;
 }
 
+// The format is the R_INDEXED_OBJECT tag, the number of fields (a varint), the
+// offset of each field as a uint32_t (counting from the end of the offsets), and then
+// the fields (key and value) in order, like an R_OBJECT has them.  Only the top level
+// gets offsets; nested objects are written the usual way.
+void serialize_for_storage(write_message_t *wm, const counted_t<const datum_t> &datum) {
+    r_sanity_check(datum.has());
+    if (datum->get_type() != datum_t::R_OBJECT) {
+        *wm << datum;
+        return;
+    }
+
+    const datum_object_t &value = datum->as_object();
+    std::vector<uint32_t> offsets;
+    offsets.reserve(value.size());
+    size_t fields_size = 0;
+    for (auto it = value.begin(); it != value.end(); ++it) {
+        offsets.push_back(fields_size);
+        fields_size += serialized_size(it->first.str()) + serialized_size(it->second);
+    }
+    guarantee(fields_size <= std::numeric_limits<uint32_t>::max());
+
+    wm->reserve(1 + varint_uint64_serialized_size(value.size())
+                + value.size() * serialized_size_t<uint32_t>::value + fields_size);
+    *wm << datum_serialized_type_t::R_INDEXED_OBJECT;
+    serialize_varint_uint64(wm, value.size());
+    for (auto it = offsets.begin(); it != offsets.end(); ++it) {
+        *wm << *it;
+    }
+    for (auto it = value.begin(); it != value.end(); ++it) {
+        *wm << it->first.str();
+        serialize_datum(*wm, it->second);
+    }
+}
+
+// Makes `out` hold `count` bytes of `group` from byte `pos` on.
+static void buffer_group_range(const const_buffer_group_t *group, size_t pos,
+                               size_t count, const_buffer_group_t *out) {
+    for (size_t i = 0; i < group->num_buffers() && count > 0; ++i) {
+        const_buffer_group_t::buffer_t buf = group->get_buffer(i);
+        const size_t size = buf.size;
+        if (pos >= size) {
+            pos -= size;
+        } else {
+            const size_t n = std::min(size - pos, count);
+            out->add_buffer(n, static_cast<const char *>(buf.data) + pos);
+            count -= n;
+            pos = 0;
+        }
+    }
+}
+
+class buffer_group_datum_source_t : public serialized_datum_source_t {
+public:
+    explicit buffer_group_datum_source_t(const const_buffer_group_t *_group)
+        : group(_group) { }
+    uint64_t size() {
+        return group->get_size();
+    }
+    archive_result_t read(uint64_t offset, uint64_t count,
+                          const std::function<archive_result_t(read_stream_t *)> &fn) {
+        const_buffer_group_t range;
+        buffer_group_range(group, offset, count, &range);
+        buffer_group_read_stream_t stream(&range);
+        return fn(&stream);
+    }
+private:
+    const const_buffer_group_t *group;
+};
+
+archive_result_t deserialize_field(const const_buffer_group_t *group,
+                                   const std::string &key,
+                                   counted_t<const datum_t> *field_out,
+                                   counted_t<const datum_t> *whole_out) {
+    buffer_group_datum_source_t source(group);
+    return deserialize_field(&source, key, field_out, whole_out);
+}
+
+// Reads the key at the start of a field that's `field_size` bytes long, or enough of
+// it to tell how it compares to `key`.  Sets `*key_size_out` to the size of the
+// serialized key if it's equal to `key`.
+static archive_result_t compare_field_key(serialized_datum_source_t *source,
+                                          uint64_t field_pos, uint64_t field_size,
+                                          const std::string &key, int *cmp_out,
+                                          uint64_t *key_size_out) {
+    const uint64_t max_size_size
+        = varint_uint64_serialized_size(std::numeric_limits<uint64_t>::max());
+    return source->read(
+        field_pos, std::min<uint64_t>(field_size, max_size_size + key.size() + 1),
+        [&](read_stream_t *s) {
+            uint64_t size;
+            archive_result_t res = deserialize_varint_uint64(s, &size);
+            if (bad(res)) {
+                return res;
+            }
+            // One byte past `key` is enough to tell a longer key is bigger.
+            const uint64_t prefix_size = std::min<uint64_t>(size, key.size() + 1);
+            std::string prefix(prefix_size, '\0');
+            if (force_read(s, &prefix[0], prefix_size)
+                != static_cast<int64_t>(prefix_size)) {
+                return archive_result_t::SOCK_EOF;
+            }
+            *cmp_out = prefix.compare(key);
+            *key_size_out = varint_uint64_serialized_size(size) + size;
+            return archive_result_t::SUCCESS;
+        });
+}
+
+archive_result_t deserialize_field(serialized_datum_source_t *source,
+                                   const std::string &key,
+                                   counted_t<const datum_t> *field_out,
+                                   counted_t<const datum_t> *whole_out) {
+    field_out->reset();
+    const uint64_t total_size = source->size();
+
+    datum_serialized_type_t type;
+    uint64_t size = 0;
+    const uint64_t max_header_size
+        = 1 + varint_uint64_serialized_size(std::numeric_limits<uint64_t>::max());
+    archive_result_t res = source->read(
+        0, std::min(total_size, max_header_size),
+        [&](read_stream_t *s) {
+            archive_result_t r = deserialize(s, &type);
+            if (bad(r) || type != datum_serialized_type_t::R_INDEXED_OBJECT) {
+                return r;
+            }
+            return deserialize_varint_uint64(s, &size);
+        });
+    if (bad(res)) {
+        return res;
+    }
+    if (type != datum_serialized_type_t::R_INDEXED_OBJECT) {
+        // There are no offsets, so we have to read the whole thing.
+        counted_t<const datum_t> datum;
+        res = source->read(0, total_size, [&](read_stream_t *s) {
+            return deserialize(s, &datum);
+        });
+        if (bad(res)) {
+            return res;
+        }
+        if (datum->get_type() == datum_t::R_OBJECT) {
+            *field_out = datum->get(key, NOTHROW);
+        }
+        if (whole_out != NULL) {
+            *whole_out = std::move(datum);
+        }
+        return archive_result_t::SUCCESS;
+    }
+
+    const uint64_t offset_size = serialized_size_t<uint32_t>::value;
+    const uint64_t offsets_pos = 1 + varint_uint64_serialized_size(size);
+    const uint64_t fields_pos = offsets_pos + size * offset_size;
+    if (fields_pos > total_size) {
+        return archive_result_t::RANGE_ERROR;
+    }
+
+    // Binary search over the fields, which are sorted by key.  Each step only reads
+    // a field's offset, the next one (where the field ends) and the field's key.
+    uint64_t begin = 0;
+    uint64_t end = size;
+    while (begin < end) {
+        const uint64_t i = begin + (end - begin) / 2;
+
+        uint32_t offset, next_offset;
+        const bool is_last = i + 1 == size;
+        res = source->read(
+            offsets_pos + i * offset_size, is_last ? offset_size : 2 * offset_size,
+            [&](read_stream_t *s) {
+                archive_result_t r = deserialize(s, &offset);
+                if (bad(r) || is_last) {
+                    return r;
+                }
+                return deserialize(s, &next_offset);
+            });
+        if (bad(res)) {
+            return res;
+        }
+        const uint64_t field_end = is_last ? total_size : fields_pos + next_offset;
+        const uint64_t field_pos = fields_pos + offset;
+        if (field_pos > field_end || field_end > total_size) {
+            return archive_result_t::RANGE_ERROR;
+        }
+
+        int cmp;
+        uint64_t key_size;
+        res = compare_field_key(source, field_pos, field_end - field_pos, key,
+                                &cmp, &key_size);
+        if (bad(res)) {
+            return res;
+        }
+
+        if (cmp == 0) {
+            if (key_size > field_end - field_pos) {
+                return archive_result_t::RANGE_ERROR;
+            }
+            return source->read(
+                field_pos + key_size, field_end - field_pos - key_size,
+                [&](read_stream_t *s) {
+                    return deserialize(s, field_out);
+                });
+        } else if (cmp < 0) {
+            begin = i + 1;
+        } else {
+            end = i;
+        }
+    }
+    return archive_result_t::SUCCESS;
+}
+
+// Deserializes a field name the way `deserialize` does a `std::string`, but the
+// names that objects have in common share one copy.
+static archive_result_t deserialize_key(read_stream_t *s, datum_key_t *key_out) {
+    uint64_t size;
+    archive_result_t res = deserialize_varint_uint64(s, &size);
+    if (bad(res)) {
+        return res;
+    }
+    if (size > std::numeric_limits<size_t>::max()) {
+        return archive_result_t::RANGE_ERROR;
+    }
+    char small_buf[DATUM_KEY_MAX_INTERNED_SIZE];
+    std::vector<char> big_buf;
+    char *buf = small_buf;
+    if (size > DATUM_KEY_MAX_INTERNED_SIZE) {
+        big_buf.resize(size);
+        buf = big_buf.data();
+    }
+    int64_t num_read = force_read(s, buf, size);
+    if (num_read == -1) {
+        return archive_result_t::SOCK_ERROR;
+    }
+    if (static_cast<uint64_t>(num_read) < size) {
+        return archive_result_t::SOCK_EOF;
+    }
+    *key_out = datum_key_t::intern(buf, size);
+    return archive_result_t::SUCCESS;
+}
+
 archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum) {
     datum_serialized_type_t type;
     archive_result_t res = deserialize(s, &type);
@@ -1255,12 +1965,42 @@ archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum)
             return archive_result_t::RANGE_ERROR;
         }
     } break;
-    case datum_serialized_type_t::R_OBJECT: {
-        std::map<std::string, counted_t<const datum_t> > value;
-        res = deserialize(s, &value);
+    case datum_serialized_type_t::R_OBJECT:  // fall through
+    case datum_serialized_type_t::R_INDEXED_OBJECT: {
+        uint64_t size;
+        res = deserialize_varint_uint64(s, &size);
         if (bad(res)) {
             return res;
         }
+        if (type == datum_serialized_type_t::R_INDEXED_OBJECT) {
+            // We read the fields in order, so we don't need their offsets.
+            for (uint64_t i = 0; i < size; ++i) {
+                uint32_t offset;
+                res = deserialize(s, &offset);
+                if (bad(res)) {
+                    return res;
+                }
+            }
+        }
+        std::vector<datum_object_t::value_type> fields;
+        for (uint64_t i = 0; i < size; ++i) {
+            datum_object_t::value_type field;
+            res = deserialize_key(s, &field.first);
+            if (bad(res)) {
+                return res;
+            }
+            res = deserialize(s, &field.second);
+            if (bad(res)) {
+                return res;
+            }
+            fields.push_back(std::move(field));
+        }
+        // The fields were written in order, so this doesn't actually sort them.
+        datum_object_t value;
+        std::string duplicate_key;
+        if (!value.assign(std::move(fields), &duplicate_key)) {
+            return archive_result_t::RANGE_ERROR;
+        }
         try {
             datum->reset(new datum_t(std::move(value)));
         } catch (const base_exc_t &) {
@@ -2,10 +2,12 @@
 #ifndef RDB_PROTOCOL_DATUM_HPP_
 #define RDB_PROTOCOL_DATUM_HPP_
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -21,6 +23,7 @@
 #include "rdb_protocol/error.hpp"
 
 class Datum;
+class const_buffer_group_t;
 
 RDB_DECLARE_SERIALIZABLE(Datum);
 
@@ -50,6 +53,7 @@ enum clobber_bool_t { NOCLOBBER = 0, CLOBBER = 1};
 enum class use_json_t { NO = 0, YES = 1 };
 
 class grouped_data_t;
+class datum_object_t;
 
 // A `datum_t` is basically a JSON value, although we may extend it later.
 class datum_t : public slow_atomic_countable_t<datum_t> {
@@ -72,10 +76,12 @@ public:
     // TODO: Eventually get rid of the std::string constructor (in favor of
     //   wire_string_t *)
     explicit datum_t(std::string &&str);
+    // Takes ownership of `str`, which may be borrowed from a received message.
     explicit datum_t(wire_string_t *str);
     explicit datum_t(const char *cstr);
     explicit datum_t(std::vector<counted_t<const datum_t> > &&_array);
     explicit datum_t(std::map<std::string, counted_t<const datum_t> > &&object);
+    explicit datum_t(datum_object_t &&object);
 
     // This should only be used to send responses to the client.
     explicit datum_t(grouped_data_t &&gd);
@@ -89,6 +95,11 @@ public:
 
     ~datum_t();
 
+    // Queries make and free datums all the time, so each thread keeps the memory of
+    // some freed datums to make new ones with instead of going back to malloc.
+    static void *operator new(size_t size);
+    static void operator delete(void *p, size_t size);
+
     void write_to_protobuf(Datum *out, use_json_t use_json) const;
 
     type_t get_type() const;
@@ -111,6 +122,10 @@ public:
     static boost::optional<uint64_t> extract_tag(
         const std::string &secondary_and_primary);
     static boost::optional<uint64_t> extract_tag(const store_key_t &key);
+    /* Returns the value a secondary index key was made from if the key holds all of
+    it, which is when it's a number, string or bool and the key isn't truncated.
+    Returns an empty pointer otherwise. */
+    static counted_t<const datum_t> extract_secondary_value(const store_key_t &key);
     store_key_t truncated_secondary() const;
     void check_type(type_t desired, const char *msg = NULL) const;
     void type_error(const std::string &msg) const NORETURN;
@@ -126,7 +141,7 @@ public:
     // Access an element of an array.
     counted_t<const datum_t> get(size_t index, throw_bool_t throw_bool = THROW) const;
     // Use of `get` is preferred to `as_object` when possible.
-    const std::map<std::string, counted_t<const datum_t> > &as_object() const;
+    const datum_object_t &as_object() const;
 
     // Access an element of an object.
     counted_t<const datum_t> get(const std::string &key,
@@ -140,6 +155,9 @@ public:
 
     cJSON *as_json_raw() const;
     scoped_cJSON_t as_json() const;
+    // Appends what `as_json().PrintUnformatted()` would return to `out`, without
+    // building the cJSON tree.  (Unlike cJSON, it doesn't cut strings off at a NUL.)
+    void write_json(std::string *out) const;
     counted_t<datum_stream_t> as_datum_stream(
             const protob_t<const Backtrace> &backtrace) const;
 
@@ -155,6 +173,14 @@ public:
     bool operator<=(const datum_t &rhs) const;
     bool operator>(const datum_t &rhs) const;
     bool operator>=(const datum_t &rhs) const;
+    // Appends bytes to `*out` that compare with `memcmp` (a shorter string sorting
+    // first) the way `cmp` compares data, so that sorts can compare keys without
+    // walking the data.  No datum's bytes are a prefix of another's.  Fails on
+    // pseudotypes other than times, which `cmp` can't compare either.
+    void append_order_key(std::string *out) const;
+    // Data that are equal by `cmp` hash the same.  The hash doesn't depend on the
+    // process or the machine.
+    uint64_t hash() const;
 
     void runtime_fail(base_exc_t::type_t exc_type,
                       const char *test, const char *file, int line,
@@ -195,6 +221,8 @@ private:
     void init_array();
     void init_object();
     void init_json(cJSON *json);
+    // Makes the datum the same as `other`, sharing the datums inside it.
+    void init_shallow_copy(const datum_t &other);
 
     void check_str_validity(const wire_string_t *str);
     void check_str_validity(const std::string &str);
@@ -216,7 +244,7 @@ private:
         double r_num;
         wire_string_t *r_str;
         std::vector<counted_t<const datum_t> > *r_array;
-        std::map<std::string, counted_t<const datum_t> > *r_object;
+        datum_object_t *r_object;
     };
 
 public:
@@ -226,11 +254,167 @@ private:
     DISABLE_COPYING(datum_t);
 };
 
+// For keeping data in hash tables (see `datum_hash_set_t`).
+struct datum_hasher_t {
+    size_t operator()(const counted_t<const datum_t> &d) const {
+        return d->hash();
+    }
+};
+struct datum_equal_t {
+    bool operator()(const counted_t<const datum_t> &l,
+                    const counted_t<const datum_t> &r) const {
+        return *l == *r;
+    }
+};
+typedef std::unordered_set<counted_t<const datum_t>, datum_hasher_t, datum_equal_t>
+    datum_hash_set_t;
+
+// The name of a field of an object.  The rows of a table mostly have the same
+// fields, so instead of every row having its own copy of each name, keys made on the
+// same thread share one copy of the names they have in common (unless the names are
+// long).  Otherwise a key acts like a `const std::string`.
+class datum_key_t {
+public:
+    datum_key_t() { }
+    datum_key_t(const std::string &name);  // NOLINT(runtime/explicit)
+    datum_key_t(std::string &&name);  // NOLINT(runtime/explicit)
+    datum_key_t(const char *name);  // NOLINT(runtime/explicit)
+
+    // Makes a key for the name in [data, data + size) without copying it to a
+    // `std::string` first.
+    static datum_key_t intern(const char *data, size_t size);
+
+    const std::string &str() const;
+    operator const std::string &() const { return str(); }  // NOLINT(runtime/explicit)
+    const char *c_str() const { return str().c_str(); }
+    const char *data() const { return str().data(); }
+    size_t size() const { return str().size(); }
+    bool empty() const { return str().empty(); }
+
+    // Keys for the same name usually share their copy, so it's quick to tell that
+    // they're equal.
+    bool operator==(const datum_key_t &other) const {
+        return name == other.name || str() == other.str();
+    }
+    bool operator!=(const datum_key_t &other) const { return !(*this == other); }
+    bool operator<(const datum_key_t &other) const {
+        return name != other.name && str() < other.str();
+    }
+
+private:
+    class name_t : public slow_atomic_countable_t<name_t> {
+    public:
+        explicit name_t(std::string &&_value) : value(std::move(_value)) { }
+        const std::string value;
+    };
+
+    counted_t<const name_t> name;
+};
+
+inline bool operator==(const datum_key_t &key, const std::string &str) {
+    return key.str() == str;
+}
+inline bool operator==(const std::string &str, const datum_key_t &key) {
+    return str == key.str();
+}
+inline bool operator==(const datum_key_t &key, const char *str) {
+    return key.str() == str;
+}
+inline bool operator!=(const datum_key_t &key, const std::string &str) {
+    return key.str() != str;
+}
+inline bool operator!=(const datum_key_t &key, const char *str) {
+    return key.str() != str;
+}
+inline bool operator<(const datum_key_t &key, const std::string &str) {
+    return key.str() < str;
+}
+inline bool operator<(const std::string &str, const datum_key_t &key) {
+    return str < key.str();
+}
+
+// The fields of an object, in a vector sorted by key.  Compared to a `std::map`,
+// that's one allocation for the whole object instead of one per field, the fields
+// sit next to each other in memory, and lookups are a binary search over them.  It
+// has the read-only part of `std::map`'s interface.
+class datum_object_t {
+public:
+    typedef datum_key_t key_type;
+    typedef std::pair<datum_key_t, counted_t<const datum_t> > value_type;
+    typedef std::vector<value_type>::const_iterator const_iterator;
+    typedef const_iterator iterator;
+    typedef std::vector<value_type>::const_reverse_iterator const_reverse_iterator;
+
+    datum_object_t() { }
+    explicit datum_object_t(std::map<std::string, counted_t<const datum_t> > &&map);
+
+    const_iterator begin() const { return fields.begin(); }
+    const_iterator end() const { return fields.end(); }
+    const_reverse_iterator rbegin() const { return fields.rbegin(); }
+    const_reverse_iterator rend() const { return fields.rend(); }
+    size_t size() const { return fields.size(); }
+    bool empty() const { return fields.empty(); }
+
+    const_iterator find(const std::string &key) const;
+    size_t count(const std::string &key) const { return find(key) == end() ? 0 : 1; }
+
+    // Returns true if `key` was already there (in which case the value is only
+    // replaced if `clobber_bool` is CLOBBER).
+    MUST_USE bool set(const std::string &key, counted_t<const datum_t> val,
+                      clobber_bool_t clobber_bool);
+    // Returns true if `key` was there.
+    MUST_USE bool erase(const std::string &key);
+
+    // Replaces the fields with `unsorted_fields`, which can be in any order.  If two
+    // of them have the same key, returns false and sets `*duplicate_key_out`.
+    MUST_USE bool assign(std::vector<value_type> &&unsorted_fields,
+                         std::string *duplicate_key_out);
+
+private:
+    std::vector<value_type>::iterator lower_bound(const std::string &key);
+
+    std::vector<value_type> fields;
+};
+
 size_t serialized_size(const counted_t<const datum_t> &datum);
 
 write_message_t &operator<<(write_message_t &wm, const counted_t<const datum_t> &datum);
 archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum);
 
+// Serializes a row the way we store it in the btree.  That's like operator<<, except
+// that an object gets a table of its fields' offsets, so that `deserialize_field` can
+// find one field without deserializing the others.  `deserialize` reads it too.
+void serialize_for_storage(write_message_t *wm, const counted_t<const datum_t> &datum);
+
+// Random access to a serialized datum.  `deserialize_field` asks a source only for
+// the bytes it needs, so a source can avoid loading the rest (like the blocks of a
+// big row that hold the other fields).
+class serialized_datum_source_t {
+public:
+    virtual uint64_t size() = 0;
+    // Calls `fn` with a stream of the bytes [offset, offset + count), which are
+    // within `size()`, and returns what it returns.
+    virtual archive_result_t read(
+        uint64_t offset, uint64_t count,
+        const std::function<archive_result_t(read_stream_t *)> &fn) = 0;
+protected:
+    virtual ~serialized_datum_source_t() { }
+};
+
+// Deserializes only the field `key` of the serialized object in `source` (or sets
+// `*field_out` to an empty pointer if there's no such field, or if the datum isn't an
+// object).  Objects not written by `serialize_for_storage` get deserialized whole;
+// then the whole datum is stored in `*whole_out`, if it isn't NULL.
+archive_result_t deserialize_field(serialized_datum_source_t *source,
+                                   const std::string &key,
+                                   counted_t<const datum_t> *field_out,
+                                   counted_t<const datum_t> *whole_out = NULL);
+// The same for a serialized object that's all in memory.
+archive_result_t deserialize_field(const const_buffer_group_t *group,
+                                   const std::string &key,
+                                   counted_t<const datum_t> *field_out,
+                                   counted_t<const datum_t> *whole_out = NULL);
+
 write_message_t &operator<<(write_message_t &wm, const empty_ok_t<const counted_t<const datum_t> > &datum);
 archive_result_t deserialize(read_stream_t *s, empty_ok_ref_t<counted_t<const datum_t> > datum);
 
@@ -1,9 +1,11 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/datum_stream.hpp"
 
+#include <exception>
 #include <map>
 
 #include "clustering/administration/metadata.hpp"
+#include "concurrency/pmap.hpp"
 #include "rdb_protocol/batching.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
@@ -94,16 +96,35 @@ T groups_to_batch(std::map<counted_t<const datum_t>, T> *g) {
     }
 }
 
+// Whether `rget`, which has a terminal, gives the same result every time it's run
+// on the same rows.
+static bool is_deterministic(const rget_read_t &rget) {
+    for (auto it = rget.optargs.begin(); it != rget.optargs.end(); ++it) {
+        if (!it->second.compile_wire_func()->is_deterministic()) {
+            return false;
+        }
+    }
+    for (auto it = rget.transforms.begin(); it != rget.transforms.end(); ++it) {
+        if (!funcs_are_deterministic(*it)) {
+            return false;
+        }
+    }
+    return funcs_are_deterministic(*rget.terminal);
+}
+
 // RANGE/READGEN STUFF
 reader_t::reader_t(
     const rdb_namespace_access_t &_ns_access,
     bool _use_outdated,
+    bool _use_result_cache,
     scoped_ptr_t<readgen_t> &&_readgen)
     : ns_access(_ns_access),
       use_outdated(_use_outdated),
+      use_result_cache(_use_result_cache),
       started(false), shards_exhausted(false),
       readgen(std::move(_readgen)),
-      active_range(readgen->original_keyrange()) { }
+      active_range(readgen->original_keyrange()),
+      items_index(0) { }
 
 void reader_t::add_transformation(transform_variant_t &&tv) {
     r_sanity_check(!started);
@@ -115,6 +136,11 @@ void reader_t::accumulate(env_t *env, eager_acc_t *acc, const terminal_variant_t
     started = shards_exhausted = true;
     batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
     read_t read = readgen->terminal_read(transforms, tv, batchspec);
+    if (use_result_cache) {
+        rget_read_t *rget = boost::get<rget_read_t>(&read.read);
+        r_sanity_check(rget != NULL);
+        rget->use_result_cache = is_deterministic(*rget);
+    }
     result_t res = do_read(env, std::move(read)).result;
     acc->add_res(&res);
 }
@@ -152,6 +178,7 @@ rget_read_response_t reader_t::do_read(env_t *env, const read_t &read) {
     if (auto e = boost::get<ql::exc_t>(&rget_res->result)) {
         throw *e;
     }
+    env->rows_scanned += rget_res->rows_scanned;
     return std::move(*rget_res);
 }
 
@@ -188,6 +215,7 @@ bool reader_t::load_items(env_t *env, const batchspec_t &batchspec) {
     started = true;
     if (items_index >= items.size() && !shards_exhausted) { // read some more
         items_index = 0;
+        items_range = active_range;
         items = do_range_read(
             env, readgen->next_read(active_range, transforms, batchspec));
         // Everything below this point can handle `items` being empty (this is
@@ -300,6 +328,31 @@ bool reader_t::is_finished() const {
     return shards_exhausted && items_index >= items.size();
 }
 
+int64_t reader_t::buffered_bytes() const {
+    int64_t ret = 0;
+    for (size_t i = items_index; i < items.size(); ++i) {
+        ret += serialized_size(items[i].data);
+    }
+    return ret;
+}
+
+void reader_t::release_items() {
+    if (items_index >= items.size() || !readgen->items_in_key_order()) {
+        return;
+    }
+    // Pick up again right after the last row we returned.
+    key_range_t range = items_range;
+    if (items_index > 0
+        && readgen->update_range(&range, items[items_index - 1].key)) {
+        return;
+    }
+    active_range = range;
+    shards_exhausted = false;
+    items_index = 0;
+    std::vector<rget_item_t> tmp;
+    tmp.swap(items);
+}
+
 readgen_t::readgen_t(
     const std::map<std::string, wire_func_t> &_global_optargs,
     const datum_range_t &_original_datum_range,
@@ -401,6 +454,11 @@ std::string primary_readgen_t::sindex_name() const {
     return "";
 }
 
+bool primary_readgen_t::items_in_key_order() const {
+    // Unordered reads put the shards' rows one after another.
+    return sorting != sorting_t::UNORDERED;
+}
+
 sindex_readgen_t::sindex_readgen_t(
     const std::map<std::string, wire_func_t> &global_optargs,
     const std::string &_sindex,
@@ -417,25 +475,31 @@ scoped_ptr_t<readgen_t> sindex_readgen_t::make(
             sindex, range, env->profile(), sorting));
 }
 
-class sindex_compare_t {
-public:
-    explicit sindex_compare_t(sorting_t _sorting) : sorting(_sorting) { }
-    bool operator()(const rget_item_t &l, const rget_item_t &r) {
-        r_sanity_check(l.sindex_key.has() && r.sindex_key.has());
-        return reversed(sorting)
-            ? (*l.sindex_key > *r.sindex_key)
-            : (*l.sindex_key < *r.sindex_key);
-    }
-private:
-    sorting_t sorting;
-};
-
 void sindex_readgen_t::sindex_sort(std::vector<rget_item_t> *vec) const {
     if (vec->size() == 0) {
         return;
     }
     if (sorting != sorting_t::UNORDERED) {
-        std::sort(vec->begin(), vec->end(), sindex_compare_t(sorting));
+        // Each item's index value is encoded once, and then the items are sorted by
+        // comparing the encodings.
+        std::vector<std::pair<std::string, size_t> > keys(vec->size());
+        for (size_t i = 0; i < vec->size(); ++i) {
+            r_sanity_check((*vec)[i].sindex_key.has());
+            (*vec)[i].sindex_key->append_order_key(&keys[i].first);
+            keys[i].second = i;
+        }
+        const bool descending = reversed(sorting);
+        std::sort(keys.begin(), keys.end(),
+                  [descending](const std::pair<std::string, size_t> &l,
+                               const std::pair<std::string, size_t> &r) {
+                      return descending ? r.first < l.first : l.first < r.first;
+                  });
+        std::vector<rget_item_t> sorted;
+        sorted.reserve(vec->size());
+        for (auto it = keys.begin(); it != keys.end(); ++it) {
+            sorted.push_back(std::move((*vec)[it->second]));
+        }
+        vec->swap(sorted);
     }
 }
 
@@ -511,7 +575,7 @@ counted_t<val_t> datum_stream_t::run_terminal(
 }
 
 counted_t<val_t> datum_stream_t::to_array(env_t *env) {
-    scoped_ptr_t<eager_acc_t> acc(make_to_array());
+    scoped_ptr_t<eager_acc_t> acc(make_to_array(env));
     accumulate_all(env, acc.get());
     return acc->finish_eager(backtrace(), is_grouped());
 }
@@ -653,11 +717,12 @@ counted_t<const datum_t> eager_datum_stream_t::as_array(env_t *env) {
 lazy_datum_stream_t::lazy_datum_stream_t(
     rdb_namespace_access_t *ns_access,
     bool use_outdated,
+    bool use_result_cache,
     scoped_ptr_t<readgen_t> &&readgen,
     const protob_t<const Backtrace> &bt_src)
     : datum_stream_t(bt_src),
       current_batch_offset(0),
-      reader(*ns_access, use_outdated, std::move(readgen)) { }
+      reader(*ns_access, use_outdated, use_result_cache, std::move(readgen)) { }
 
 counted_t<datum_stream_t>
 lazy_datum_stream_t::add_transformation(
@@ -913,6 +978,9 @@ counted_t<const datum_t> union_datum_stream_t::as_array(env_t *env) {
 }
 
 bool union_datum_stream_t::is_exhausted() const {
+    if (!ready_batches.empty()) {
+        return false;
+    }
     for (auto it = streams.begin(); it != streams.end(); ++it) {
         if (!(*it)->is_exhausted()) {
             return false;
@@ -921,16 +989,69 @@ bool union_datum_stream_t::is_exhausted() const {
     return batch_cache_exhausted();
 }
 
+int64_t union_datum_stream_t::buffered_bytes() {
+    int64_t bytes = 0;
+    for (auto it = streams.begin(); it != streams.end(); ++it) {
+        bytes += (*it)->buffered_bytes();
+    }
+    for (auto it = ready_batches.begin(); it != ready_batches.end(); ++it) {
+        for (auto d = it->begin(); d != it->end(); ++d) {
+            bytes += serialized_size(*d);
+        }
+    }
+    return bytes;
+}
+
 std::vector<counted_t<const datum_t> >
 union_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec) {
-    for (; streams_index < streams.size(); ++streams_index) {
-        std::vector<counted_t<const datum_t> > batch
-            = streams[streams_index]->next_batch(env, batchspec);
-        if (batch.size() != 0) {
-            return batch;
+    while (ready_batches.empty() && !active_streams.empty()) {
+        // Read from the next few streams at once, so that (for example) a
+        // `get_all` over many index keys waits for about one round trip rather
+        // than one per key.  Batches are returned in the order of the streams
+        // they came from.
+        std::vector<size_t> to_read;
+        while (!active_streams.empty()
+               && to_read.size() < UNION_DATUM_STREAM_MAX_CONCURRENT_READS) {
+            to_read.push_back(active_streams.front());
+            active_streams.pop_front();
+        }
+
+        std::vector<std::vector<counted_t<const datum_t> > > batches(to_read.size());
+        std::vector<std::exception_ptr> errors(to_read.size());
+        {
+            // The reads share `env->trace`, which can't take concurrent events.
+            scoped_ptr_t<profile::disabler_t> disabler;
+            if (to_read.size() > 1) {
+                disabler.init(new profile::disabler_t(env->trace));
+            }
+            pmap(to_read.size(), [&](int i) {
+                try {
+                    batches[i] = streams[to_read[i]]->next_batch(env, batchspec);
+                } catch (const std::exception &) {
+                    errors[i] = std::current_exception();
+                }
+            });
+        }
+
+        for (size_t i = 0; i < to_read.size(); ++i) {
+            if (errors[i]) {
+                std::rethrow_exception(errors[i]);
+            }
+        }
+        for (size_t i = 0; i < to_read.size(); ++i) {
+            if (!batches[i].empty()) {
+                ready_batches.push_back(std::move(batches[i]));
+                active_streams.push_back(to_read[i]);
+            }
         }
     }
-    return std::vector<counted_t<const datum_t> >();
+
+    if (ready_batches.empty()) {
+        return std::vector<counted_t<const datum_t> >();
+    }
+    std::vector<counted_t<const datum_t> > batch = std::move(ready_batches.front());
+    ready_batches.pop_front();
+    return batch;
 }
 
 } // namespace ql
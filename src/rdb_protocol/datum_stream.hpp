@@ -94,7 +94,8 @@ public:
     counted_t<val_t> to_array(env_t *env);
 
     // stream -> stream (always eager)
-    counted_t<datum_stream_t> slice(size_t l, size_t r);
+    // (Virtual so that an unindexed sort can find out how many rows are needed.)
+    virtual counted_t<datum_stream_t> slice(size_t l, size_t r);
     counted_t<datum_stream_t> zip();
     counted_t<datum_stream_t> indexes_of(counted_t<func_t> f);
 
@@ -117,6 +118,12 @@ public:
         env_t *env, eager_acc_t *acc, const terminal_variant_t &tv) = 0;
     virtual void accumulate_all(env_t *env, eager_acc_t *acc) = 0;
 
+    // Roughly how many bytes of rows the stream holds on to for its next batches
+    // (for the stream cache's limits), and a way to let go of the ones it can read
+    // again later.
+    virtual int64_t buffered_bytes() { return 0; }
+    virtual void release_buffers() { }
+
 protected:
     bool batch_cache_exhausted() const;
     void check_not_grouped(const char *msg);
@@ -171,6 +178,8 @@ private:
     virtual bool is_exhausted() const {
         return source->is_exhausted() && batch_cache_exhausted();
     }
+    virtual int64_t buffered_bytes() { return source->buffered_bytes(); }
+    virtual void release_buffers() { source->release_buffers(); }
 
 protected:
     const counted_t<datum_stream_t> source;
@@ -252,7 +261,11 @@ class union_datum_stream_t : public datum_stream_t {
 public:
     union_datum_stream_t(std::vector<counted_t<datum_stream_t> > &&_streams,
                          const protob_t<const Backtrace> &bt_src)
-        : datum_stream_t(bt_src), streams(_streams), streams_index(0) { }
+        : datum_stream_t(bt_src), streams(_streams) {
+        for (size_t i = 0; i < streams.size(); ++i) {
+            active_streams.push_back(i);
+        }
+    }
 
     virtual counted_t<datum_stream_t> add_transformation(
         env_t *env, transform_variant_t &&tv, const protob_t<const Backtrace> &bt);
@@ -262,13 +275,18 @@ public:
     virtual bool is_array();
     virtual counted_t<const datum_t> as_array(env_t *env);
     virtual bool is_exhausted() const;
+    virtual int64_t buffered_bytes();
 
 private:
     std::vector<counted_t<const datum_t> >
     next_batch_impl(env_t *env, const batchspec_t &batchspec);
 
     std::vector<counted_t<datum_stream_t> > streams;
-    size_t streams_index;
+    // The indices of the streams that haven't returned an empty batch yet, in the
+    // order we read from them.  A stream goes to the back after each read.
+    std::deque<size_t> active_streams;
+    // Batches read concurrently that haven't been returned yet.
+    std::deque<std::vector<counted_t<const datum_t> > > ready_batches;
 };
 
 // This class generates the `read_t`s used in range reads.  It's used by
@@ -310,6 +328,9 @@ public:
     // Returns `true` if there is no more to read.
     bool update_range(key_range_t *active_range,
                       const store_key_t &last_key) const;
+    // Whether the rows of a read come back in the order of their keys, so that
+    // the rest of the range can be read again starting after any one of them.
+    virtual bool items_in_key_order() const = 0;
 protected:
     const std::map<std::string, wire_func_t> global_optargs;
     const datum_range_t original_datum_range;
@@ -344,6 +365,7 @@ private:
     virtual void sindex_sort(std::vector<rget_item_t> *vec) const;
     virtual key_range_t original_keyrange() const;
     virtual std::string sindex_name() const; // Used for error checking.
+    virtual bool items_in_key_order() const;
 };
 
 class sindex_readgen_t : public readgen_t {
@@ -370,6 +392,8 @@ private:
     virtual void sindex_sort(std::vector<rget_item_t> *vec) const;
     virtual key_range_t original_keyrange() const;
     virtual std::string sindex_name() const; // Used for error checking.
+    // Rows are reordered by their full secondary index values.
+    virtual bool items_in_key_order() const { return false; }
 
     const std::string sindex;
 };
@@ -379,6 +403,7 @@ public:
     explicit reader_t(
         const rdb_namespace_access_t &ns_access,
         bool use_outdated,
+        bool use_result_cache,
         scoped_ptr_t<readgen_t> &&readgen);
     void add_transformation(transform_variant_t &&tv);
     void accumulate(env_t *env, eager_acc_t *acc, const terminal_variant_t &tv);
@@ -386,6 +411,10 @@ public:
     std::vector<counted_t<const datum_t> >
     next_batch(env_t *env, const batchspec_t &batchspec);
     bool is_finished() const;
+    int64_t buffered_bytes() const;
+    // Drops the rows that were read but not returned yet, if they can be read
+    // again.
+    void release_items();
 private:
     // Returns `true` if there's data in `items`.
     bool load_items(env_t *env, const batchspec_t &batchspec);
@@ -394,11 +423,16 @@ private:
 
     rdb_namespace_access_t ns_access;
     const bool use_outdated;
+    // Whether a terminal read whose functions are all deterministic may use the
+    // shards' `result_cache_t`.
+    const bool use_result_cache;
     std::vector<transform_variant_t> transforms;
 
     bool started, shards_exhausted;
     const scoped_ptr_t<const readgen_t> readgen;
     key_range_t active_range;
+    // What `active_range` was before the read that filled `items`.
+    key_range_t items_range;
 
     // We need this to handle the SINDEX_CONSTANT case.
     std::vector<rget_item_t> items;
@@ -410,6 +444,7 @@ public:
     lazy_datum_stream_t(
         rdb_namespace_access_t *_ns_access,
         bool _use_outdated,
+        bool _use_result_cache,
         scoped_ptr_t<readgen_t> &&_readgen,
         const protob_t<const Backtrace> &bt_src);
 
@@ -419,6 +454,8 @@ public:
     }
 
     bool is_exhausted() const;
+    virtual int64_t buffered_bytes() { return reader.buffered_bytes(); }
+    virtual void release_buffers() { reader.release_items(); }
 private:
     std::vector<counted_t<const datum_t> >
     next_batch_impl(env_t *env, const batchspec_t &batchspec);
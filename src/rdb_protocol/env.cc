@@ -7,6 +7,7 @@
 #include "extproc/js_runner.hpp"
 #include "rdb_protocol/counted_term.hpp"
 #include "rdb_protocol/func.hpp"
+#include "rdb_protocol/insert_stream.hpp"
 #include "rdb_protocol/minidriver.hpp"
 #include "rdb_protocol/term_walker.hpp"
 
@@ -176,7 +177,12 @@ env_t::env_t(rdb_protocol_t::context_t *ctx, signal_t *_interruptor)
                     semilattice_readwrite_view_t<cluster_semilattice_metadata_t> >(),
           NULL,
           ctx ? ctx->machine_id : uuid_u()),
+      io_backender(ctx ? ctx->io_backender : NULL),
+      temp_path(ctx ? ctx->temp_path : boost::optional<base_path_t>()),
+      mailbox_manager(ctx ? ctx->mailbox_manager : NULL),
       interruptor(_interruptor),
+      send_profile(true),
+      rows_scanned(0),
       eval_callback(NULL) { }
 
 env_t::env_t(
@@ -201,7 +207,11 @@ env_t::env_t(
                    _semilattice_metadata,
                    _directory_read_manager,
                    _this_machine),
+    io_backender(NULL),
+    mailbox_manager(NULL),
     interruptor(_interruptor),
+    send_profile(true),
+    rows_scanned(0),
     eval_callback(NULL)
 {
     if (query.has()) {
@@ -237,7 +247,11 @@ env_t::env_t(
                    _semilattice_metadata,
                    _directory_read_manager,
                    _this_machine),
+    io_backender(NULL),
+    mailbox_manager(NULL),
     interruptor(_interruptor),
+    send_profile(true),
+    rows_scanned(0),
     eval_callback(NULL)
 {
     if (_profile == profile_bool_t::PROFILE) {
@@ -13,6 +13,7 @@
 #include "extproc/js_runner.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/protocol.hpp"
+#include "rdb_protocol/query_memory.hpp"
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/val.hpp"
 
@@ -20,6 +21,7 @@ class extproc_pool_t;
 
 namespace ql {
 class datum_t;
+class insert_stream_t;
 class term_t;
 
 /* If and optarg with the given key is present and is of type DATUM it will be
@@ -154,13 +156,35 @@ public:
     // Access to the cluster, for talking over the cluster or about the cluster.
     cluster_access_t cluster_access;
 
+    // Where to put temporary files (see `rdb_protocol_t::context_t`).  NULL and
+    // empty if there's nowhere to put them.
+    io_backender_t *io_backender;
+    boost::optional<base_path_t> temp_path;
+
+    // For changefeeds' mailboxes (see `rdb_protocol_t::context_t`).  NULL if
+    // tables can't be subscribed to.
+    mailbox_manager_t *mailbox_manager;
+
     // The interruptor signal while a query evaluates.  This can get overwritten!
     signal_t *interruptor;
 
     scoped_ptr_t<profile::trace_t> trace;
+    // False if the server profiles the query on its own, for the slow query log, in
+    // which case the client doesn't get `trace`'s profile.
+    bool send_profile;
 
     profile_bool_t profile();
 
+    // The rows the shards' range and index scans have read for the query.
+    uint64_t rows_scanned;
+
+    // The memory that the query's intermediate results take up.
+    query_memory_t memory;
+
+    // Started by an `insert` with `stream: true`, for `ql::run` to hand over to
+    // the connection's `insert_stream_cache_t`.
+    scoped_ptr_t<insert_stream_t> insert_stream;
+
 private:
     js_runner_t js_runner;
 
@@ -169,13 +193,20 @@ private:
     DISABLE_COPYING(env_t);
 };
 
+// The DATUM terms made while compiling a query, by the `Term` they were made from.
+typedef std::multimap<const Term *, counted_t<term_t> > datum_terms_t;
+
 // An environment in which expressions are compiled.  Since compilation doesn't
 // evaluate anything, it doesn't need an env_t *.
 class compile_env_t {
 public:
-    explicit compile_env_t(var_visibility_t &&_visibility)
-        : visibility(std::move(_visibility)) { }
+    explicit compile_env_t(var_visibility_t &&_visibility,
+                           datum_terms_t *_datum_terms = NULL)
+        : visibility(std::move(_visibility)), datum_terms(_datum_terms) { }
     var_visibility_t visibility;
+    // If not NULL, `compile_term` records the DATUM terms it makes here (see
+    // `term_cache_t`).
+    datum_terms_t *datum_terms;
 };
 
 // This is an environment for evaluating things that use variables in scope.  It
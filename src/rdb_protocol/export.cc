@@ -0,0 +1,342 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/export.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <functional>
+
+#include "arch/runtime/thread_pool.hpp"
+#include "btree/leaf_node.hpp"
+#include "btree/node.hpp"
+#include "btree/parallel_traversal.hpp"
+#include "buffer_cache/alt/alt.hpp"
+#include "config/args.hpp"
+#include "containers/archive/string_stream.hpp"
+#include "containers/uuid.hpp"
+#include "rdb_protocol/lazy_json.hpp"
+
+static const char EXPORT_FILE_MAGIC[] = "rethinkdb table export 1\n";
+static const size_t EXPORT_FILE_MAGIC_SIZE = sizeof(EXPORT_FILE_MAGIC) - 1;
+
+// The number of rows, their size and their compressed size.
+static const size_t CHUNK_HEADER_SIZE = 3 * sizeof(uint32_t);
+
+static bool write_all(fd_t fd, const char *data, size_t size) {
+    size_t written = 0;
+    while (written < size) {
+        ssize_t res = ::write(fd, data + written, size - written);
+        if (res == -1) {
+            if (get_errno() == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        written += res;
+    }
+    return true;
+}
+
+// Returns how many bytes it read, which is less than `size` only at the end of the
+// file, or -1.
+static ssize_t read_all(fd_t fd, char *data, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t res = ::read(fd, data + done, size - done);
+        if (res == -1) {
+            if (get_errno() == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (res == 0) {
+            break;
+        }
+        done += res;
+    }
+    return done;
+}
+
+export_writer_t::export_writer_t(const std::string &path)
+    : path_(path), pending_row_count_(0) {
+    thread_pool_t::run_in_blocker_pool(
+        std::bind(&export_writer_t::open_blocking, std::cref(path_), &fd_, &error_));
+}
+
+void export_writer_t::add_row(const std::string &serialized_row) {
+    if (!error_.empty()) {
+        return;
+    }
+    pending_.append(serialized_row);
+    ++pending_row_count_;
+    if (pending_.size() >= EXPORT_CHUNK_SIZE) {
+        write_pending();
+    }
+}
+
+void export_writer_t::finish() {
+    write_pending();
+    mutex_t::acq_t acq(&write_mutex_);
+    if (error_.empty()) {
+        std::string error;
+        thread_pool_t::run_in_blocker_pool(
+            std::bind(&export_writer_t::sync_blocking, fd_.get(), &error));
+        error_ = error;
+    }
+    fd_.reset();
+}
+
+void export_writer_t::write_pending() {
+    std::string rows;
+    rows.swap(pending_);
+    const uint32_t row_count = pending_row_count_;
+    pending_row_count_ = 0;
+    if (row_count == 0) {
+        return;
+    }
+
+    // Other rows can pile up in `pending_` while we write these.
+    mutex_t::acq_t acq(&write_mutex_);
+    if (!error_.empty()) {
+        return;
+    }
+    std::string error;
+    thread_pool_t::run_in_blocker_pool(
+        std::bind(&export_writer_t::write_chunk_blocking, fd_.get(), row_count,
+                  &rows, &error));
+    error_ = error;
+}
+
+void export_writer_t::open_blocking(const std::string &path, scoped_fd_t *fd_out,
+                                    std::string *error_out) {
+    int res;
+    do {
+        res = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    } while (res == -1 && get_errno() == EINTR);
+    if (res == -1) {
+        *error_out = strprintf("Could not create the export file \"%s\": %s",
+                               path.c_str(), errno_string(get_errno()).c_str());
+        return;
+    }
+    fd_out->reset(res);
+    if (!write_all(fd_out->get(), EXPORT_FILE_MAGIC, EXPORT_FILE_MAGIC_SIZE)) {
+        *error_out = strprintf("Could not write the export file \"%s\": %s",
+                               path.c_str(), errno_string(get_errno()).c_str());
+    }
+}
+
+void export_writer_t::write_chunk_blocking(fd_t fd, uint32_t row_count,
+                                           const std::string *rows,
+                                           std::string *error_out) {
+    guarantee(rows->size() <= UINT32_MAX);
+    uLongf compressed_size = compressBound(rows->size());
+    std::string chunk(CHUNK_HEADER_SIZE + compressed_size, '\0');
+    // Backups care more about how long they take than about how big they are.
+    int res = compress2(reinterpret_cast<Bytef *>(&chunk[CHUNK_HEADER_SIZE]),
+                        &compressed_size,
+                        reinterpret_cast<const Bytef *>(rows->data()), rows->size(),
+                        Z_BEST_SPEED);
+    guarantee(res == Z_OK, "compress2 failed (%d)", res);
+    chunk.resize(CHUNK_HEADER_SIZE + compressed_size);
+
+    const uint32_t header[3] = { row_count,
+                                 static_cast<uint32_t>(rows->size()),
+                                 static_cast<uint32_t>(compressed_size) };
+    memcpy(&chunk[0], header, CHUNK_HEADER_SIZE);
+    if (!write_all(fd, chunk.data(), chunk.size())) {
+        *error_out = strprintf("Could not write to an export file: %s",
+                               errno_string(get_errno()).c_str());
+    }
+}
+
+void export_writer_t::sync_blocking(fd_t fd, std::string *error_out) {
+    if (::fsync(fd) != 0) {
+        *error_out = strprintf("Could not sync an export file: %s",
+                               errno_string(get_errno()).c_str());
+    }
+}
+
+export_reader_t::export_reader_t(const std::string &path) : path_(path) {
+    thread_pool_t::run_in_blocker_pool(
+        std::bind(&export_reader_t::open_blocking, std::cref(path_), &fd_, &error_));
+}
+
+bool export_reader_t::next_chunk(std::vector<counted_t<const ql::datum_t> > *rows_out) {
+    rows_out->clear();
+    if (!error_.empty() || fd_.get() == INVALID_FD) {
+        return false;
+    }
+
+    uint32_t row_count;
+    std::string rows;
+    bool eof = false;
+    thread_pool_t::run_in_blocker_pool(
+        std::bind(&export_reader_t::read_chunk_blocking, fd_.get(), &row_count,
+                  &rows, &eof, &error_));
+    if (eof || !error_.empty()) {
+        fd_.reset();
+        return false;
+    }
+
+    string_read_stream_t stream(std::move(rows), 0);
+    rows_out->reserve(row_count);
+    for (uint32_t i = 0; i < row_count; ++i) {
+        counted_t<const ql::datum_t> row;
+        archive_result_t res = deserialize(&stream, &row);
+        if (bad(res)) {
+            error_ = strprintf("The export file \"%s\" is corrupted.", path_.c_str());
+            rows_out->clear();
+            return false;
+        }
+        rows_out->push_back(std::move(row));
+    }
+    return true;
+}
+
+void export_reader_t::open_blocking(const std::string &path, scoped_fd_t *fd_out,
+                                    std::string *error_out) {
+    int res;
+    do {
+        res = ::open(path.c_str(), O_RDONLY);
+    } while (res == -1 && get_errno() == EINTR);
+    if (res == -1) {
+        *error_out = strprintf("Could not open the export file \"%s\": %s",
+                               path.c_str(), errno_string(get_errno()).c_str());
+        return;
+    }
+    fd_out->reset(res);
+
+    char magic[EXPORT_FILE_MAGIC_SIZE];
+    if (read_all(fd_out->get(), magic, EXPORT_FILE_MAGIC_SIZE)
+            != static_cast<ssize_t>(EXPORT_FILE_MAGIC_SIZE)
+        || memcmp(magic, EXPORT_FILE_MAGIC, EXPORT_FILE_MAGIC_SIZE) != 0) {
+        *error_out = strprintf("\"%s\" is not a table export file.", path.c_str());
+    }
+}
+
+void export_reader_t::read_chunk_blocking(fd_t fd, uint32_t *row_count_out,
+                                          std::string *rows_out, bool *eof_out,
+                                          std::string *error_out) {
+    uint32_t header[3];
+    ssize_t res = read_all(fd, reinterpret_cast<char *>(header), CHUNK_HEADER_SIZE);
+    if (res == 0) {
+        *eof_out = true;
+        return;
+    }
+    if (res != static_cast<ssize_t>(CHUNK_HEADER_SIZE)) {
+        *error_out = "An export file is truncated or unreadable.";
+        return;
+    }
+    *row_count_out = header[0];
+
+    std::string compressed(header[2], '\0');
+    if (read_all(fd, &compressed[0], compressed.size())
+            != static_cast<ssize_t>(compressed.size())) {
+        *error_out = "An export file is truncated or unreadable.";
+        return;
+    }
+
+    rows_out->assign(header[1], '\0');
+    uLongf size = rows_out->size();
+    int zres = uncompress(reinterpret_cast<Bytef *>(&(*rows_out)[0]), &size,
+                          reinterpret_cast<const Bytef *>(compressed.data()),
+                          compressed.size());
+    if (zres != Z_OK || size != rows_out->size()) {
+        *error_out = "An export file is corrupted.";
+    }
+}
+
+// Hands the rows of each leaf to the writer, as they're stored.  The leaves are
+// processed concurrently, so the rows aren't written in key order.
+class export_traversal_helper_t : public btree_traversal_helper_t,
+                                  public home_thread_mixin_debug_only_t {
+public:
+    export_traversal_helper_t(const key_range_t &range, export_writer_t *writer)
+        : range_(range), writer_(writer), rows_(0) { }
+
+    void process_a_leaf(buf_lock_t *leaf_node_buf,
+                        const btree_key_t *, const btree_key_t *,
+                        signal_t *, int *) THROWS_ONLY(interrupted_exc_t) {
+        buf_read_t read(leaf_node_buf);
+        const leaf_node_t *node
+            = static_cast<const leaf_node_t *>(read.get_data_read());
+
+        std::string row;
+        for (auto it = leaf::begin(*node); it != leaf::end(*node); ++it) {
+            const btree_key_t *key = (*it).first;
+            if (!range_.contains_key(key->contents, key->size)) {
+                continue;
+            }
+            row.clear();
+            get_data_serialized(static_cast<const rdb_value_t *>((*it).second),
+                                buf_parent_t(leaf_node_buf), &row);
+            writer_->add_row(row);
+            ++rows_;
+        }
+    }
+
+    void postprocess_internal_node(buf_lock_t *) { }
+
+    void filter_interesting_children(buf_parent_t,
+                                     ranged_block_ids_t *ids_source,
+                                     interesting_children_callback_t *cb) {
+        for (int i = 0, e = ids_source->num_block_ids(); i < e; ++i) {
+            cb->receive_interesting_child(i);
+        }
+        cb->no_more_interesting_children();
+    }
+
+    access_t btree_superblock_mode() { return access_t::read; }
+    access_t btree_node_mode() { return access_t::read; }
+
+    uint64_t rows() const { return rows_; }
+
+private:
+    const key_range_t range_;
+    export_writer_t *writer_;
+    uint64_t rows_;
+
+    DISABLE_COPYING(export_traversal_helper_t);
+};
+
+static void unlink_blocking(const std::string &path) {
+    // A partial export is useless, but not harmful enough to fail over.
+    UNUSED int res = ::unlink(path.c_str());
+}
+
+void rdb_export(const key_range_t &range,
+                const std::string &directory,
+                superblock_t *superblock,
+                signal_t *interruptor,
+                rdb_protocol_t::export_read_response_t *response)
+    THROWS_ONLY(interrupted_exc_t) {
+    const std::string path = strprintf("%s/%s.rdbexport", directory.c_str(),
+                                       uuid_to_str(generate_uuid()).c_str());
+    export_writer_t writer(path);
+    if (!writer.error().empty()) {
+        // We couldn't create the file, so there's nothing to clean up.
+        response->error = writer.error();
+        return;
+    }
+
+    export_traversal_helper_t helper(range, &writer);
+    try {
+        btree_parallel_traversal(superblock, &helper, interruptor);
+    } catch (const interrupted_exc_t &) {
+        writer.finish();
+        thread_pool_t::run_in_blocker_pool(std::bind(&unlink_blocking, std::cref(path)));
+        throw;
+    }
+    writer.finish();
+
+    if (writer.error().empty()) {
+        response->files.push_back(path);
+        response->rows = helper.rows();
+    } else {
+        response->error = writer.error();
+        thread_pool_t::run_in_blocker_pool(std::bind(&unlink_blocking, std::cref(path)));
+    }
+}
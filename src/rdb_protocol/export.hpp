@@ -0,0 +1,99 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_EXPORT_HPP_
+#define RDB_PROTOCOL_EXPORT_HPP_
+
+#include <string>
+#include <vector>
+
+#include "arch/io/io_utils.hpp"
+#include "btree/keys.hpp"
+#include "concurrency/mutex.hpp"
+#include "concurrency/signal.hpp"
+#include "containers/counted.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/protocol.hpp"
+
+class superblock_t;
+
+/* A table export is one file per shard, holding the shard's rows as they're
+serialized in its btree, so neither the export nor the import goes through JSON or
+protobufs.  Each shard writes its file from a snapshot of its btree (taken by the
+`export_read_t` that starts it), so the file is the shard as it was at one moment,
+but the shards aren't snapshotted at the same moment.
+
+A file is `EXPORT_FILE_MAGIC`, followed by chunks of rows.  Each chunk is its number
+of rows, their size, the size they compressed to, and the zlib-compressed rows, which
+are the serialized datums one after another.  The numbers are 32-bit and in the
+server's byte order. */
+
+// Writes an export file.  Only the first error is kept, and after one the writer
+// ignores the rest of the rows.
+class export_writer_t {
+public:
+    explicit export_writer_t(const std::string &path);
+
+    void add_row(const std::string &serialized_row);
+    // Writes the rows that haven't been written yet and syncs the file.
+    void finish();
+
+    // Empty unless something went wrong.
+    const std::string &error() const { return error_; }
+
+private:
+    // Takes the rows out of `pending_` and writes them.
+    void write_pending();
+
+    static void open_blocking(const std::string &path, scoped_fd_t *fd_out,
+                              std::string *error_out);
+    static void write_chunk_blocking(fd_t fd, uint32_t row_count,
+                                     const std::string *rows, std::string *error_out);
+    static void sync_blocking(fd_t fd, std::string *error_out);
+
+    const std::string path_;
+    scoped_fd_t fd_;
+    std::string pending_;
+    uint32_t pending_row_count_;
+    // Keeps the chunks from being written on top of each other.
+    mutex_t write_mutex_;
+    std::string error_;
+
+    DISABLE_COPYING(export_writer_t);
+};
+
+// Reads an export file, one chunk at a time.
+class export_reader_t {
+public:
+    explicit export_reader_t(const std::string &path);
+
+    // Replaces `*rows_out` with the rows of the next chunk.  Returns false at the end
+    // of the file, or if something went wrong.
+    bool next_chunk(std::vector<counted_t<const ql::datum_t> > *rows_out);
+
+    // Empty unless something went wrong.
+    const std::string &error() const { return error_; }
+
+private:
+    static void open_blocking(const std::string &path, scoped_fd_t *fd_out,
+                              std::string *error_out);
+    static void read_chunk_blocking(fd_t fd, uint32_t *row_count_out,
+                                    std::string *rows_out, bool *eof_out,
+                                    std::string *error_out);
+
+    const std::string path_;
+    scoped_fd_t fd_;
+    std::string error_;
+
+    DISABLE_COPYING(export_reader_t);
+};
+
+/* Writes the rows with keys in `range` to a new file in `directory`, walking the
+ * btree with `btree_parallel_traversal()`.  Fills in the file's path and number of
+ * rows (or the error) in `response`. */
+void rdb_export(const key_range_t &range,
+                const std::string &directory,
+                superblock_t *superblock,
+                signal_t *interruptor,
+                rdb_protocol_t::export_read_response_t *response)
+    THROWS_ONLY(interrupted_exc_t);
+
+#endif  // RDB_PROTOCOL_EXPORT_HPP_
@@ -1,7 +1,12 @@
 #include "rdb_protocol/func.hpp"
 
+#include <algorithm>
+
+#include "config/args.hpp"
+
 #include "rdb_protocol/counted_term.hpp"
 #include "rdb_protocol/env.hpp"
+#include "rdb_protocol/js_translate.hpp"
 #include "rdb_protocol/minidriver.hpp"
 #include "rdb_protocol/pseudo_literal.hpp"
 #include "rdb_protocol/ql2.pb.h"
@@ -32,6 +37,12 @@ counted_t<val_t> func_t::call(env_t *env,
     return call(env, make_vector(arg1, arg2), eval_flags);
 }
 
+void func_t::map_rows(env_t *env, std::vector<counted_t<const datum_t> > *rows) const {
+    for (auto it = rows->begin(); it != rows->end(); ++it) {
+        *it = call(env, *it)->as_datum();
+    }
+}
+
 void func_t::assert_deterministic(const char *extra_msg) const {
     rcheck(is_deterministic(),
            base_exc_t::GENERIC,
@@ -77,19 +88,98 @@ bool reql_func_t::is_deterministic() const {
     return body->is_deterministic();
 }
 
+// Whether `t` gets a field of the only argument of a function with the arguments
+// `arg_names`.
+static bool is_get_field_of(const Term &t, const std::vector<sym_t> &arg_names,
+                            std::string *field_out) {
+    if (arg_names.size() != 1) {
+        return false;
+    }
+    if (t.type() != Term::GET_FIELD || t.args_size() != 2 || t.optargs_size() != 0) {
+        return false;
+    }
+    const Term &var = t.args(0);
+    if (var.type() == Term::IMPLICIT_VAR) {
+        if (var.args_size() != 0 || !function_emits_implicit_variable(arg_names)) {
+            return false;
+        }
+    } else if (var.type() != Term::VAR || var.args_size() != 1
+               || var.args(0).type() != Term::DATUM
+               || var.args(0).datum().type() != Datum::R_NUM
+               || var.args(0).datum().r_num() != arg_names[0].value) {
+        return false;
+    }
+    const Term &field = t.args(1);
+    if (field.type() != Term::DATUM || field.datum().type() != Datum::R_STR) {
+        return false;
+    }
+    *field_out = field.datum().r_str();
+    return true;
+}
+
+bool reql_func_t::is_get_field_of_arg(std::string *field_out) const {
+    return is_get_field_of(*body->get_src(), arg_names, field_out);
+}
+
+bool reql_func_t::is_get_field_eq_constant(std::string *field_out,
+                                           counted_t<const datum_t> *value_out) const {
+    const Term *src = body->get_src().get();
+    if (src->type() != Term::EQ || src->args_size() != 2 || src->optargs_size() != 0) {
+        return false;
+    }
+    for (int i = 0; i < 2; ++i) {
+        const Term &constant = src->args(1 - i);
+        if (is_get_field_of(src->args(i), arg_names, field_out)
+            && constant.type() == Term::DATUM
+            && (constant.datum().type() == Datum::R_NUM
+                || constant.datum().type() == Datum::R_STR)) {
+            *value_out = make_counted<const datum_t>(&constant.datum());
+            return true;
+        }
+    }
+    return false;
+}
+
+scoped_ptr_t<filter_predicate_t> reql_func_t::make_filter_predicate() const {
+    return compile_filter_predicate(arg_names, *body->get_src());
+}
+
+scoped_ptr_t<map_function_t> reql_func_t::make_map_function() const {
+    return compile_map_function(arg_names, *body->get_src());
+}
+
 js_func_t::js_func_t(const std::string &_js_source,
                      uint64_t timeout_ms,
                      protob_t<const Backtrace> backtrace)
     : func_t(backtrace),
       js_source(_js_source),
-      js_timeout_ms(timeout_ms) { }
+      js_timeout_ms(timeout_ms),
+      native_body(translate_js_function(js_source)) {
+    if (native_body.has()) {
+        native = compile_map_function(js_function_args(), *native_body,
+                                      comparisons_t::JAVASCRIPT);
+    }
+}
 
 js_func_t::~js_func_t() { }
 
+std::vector<sym_t> js_func_t::js_function_args() {
+    return make_vector(pb::dummy_var_to_sym(pb::dummy_var_t::JS_FUNCTION_ARG));
+}
+
+bool js_func_t::call_natively(const counted_t<const datum_t> &arg,
+                              counted_t<const datum_t> *out) const {
+    return native.has() && native->apply(arg, out);
+}
+
 counted_t<val_t> js_func_t::call(
     env_t *env,
     const std::vector<counted_t<const datum_t> > &args,
     UNUSED eval_flags_t eval_flags) const {
+    counted_t<const datum_t> native_result;
+    if (args.size() == 1 && call_natively(args[0], &native_result)) {
+        return make_counted<val_t>(native_result, backtrace());
+    }
     try {
         js_runner_t::req_config_t config;
         config.timeout_ms = js_timeout_ms;
@@ -118,10 +208,75 @@ counted_t<val_t> js_func_t::call(
     }
 }
 
+void js_func_t::map_rows(env_t *env,
+                         std::vector<counted_t<const datum_t> > *rows) const {
+    // The rows the function has to be run in a worker for.
+    std::vector<size_t> pending;
+    for (size_t i = 0; i < rows->size(); ++i) {
+        counted_t<const datum_t> native_result;
+        if (call_natively((*rows)[i], &native_result)) {
+            (*rows)[i] = std::move(native_result);
+        } else {
+            pending.push_back(i);
+        }
+    }
+
+    try {
+        r_sanity_check(!js_source.empty());
+        for (size_t start = 0; start < pending.size(); start += JS_CALL_MAX_BATCH_SIZE) {
+            const size_t end = std::min<size_t>(pending.size(),
+                                                start + JS_CALL_MAX_BATCH_SIZE);
+            std::vector<std::vector<counted_t<const datum_t> > > arg_tuples;
+            arg_tuples.reserve(end - start);
+            for (size_t i = start; i < end; ++i) {
+                arg_tuples.push_back(make_vector((*rows)[pending[i]]));
+            }
+
+            // Every row gets as long as it would have had on its own.
+            js_runner_t::req_config_t config;
+            config.timeout_ms = js_timeout_ms > UINT64_MAX / (end - start)
+                ? UINT64_MAX
+                : js_timeout_ms * (end - start);
+
+            std::vector<js_result_t> results;
+            try {
+                results = env->get_js_runner()->call_batch(js_source, arg_tuples,
+                                                           config);
+            } catch (const js_worker_exc_t &e) {
+                rfail(base_exc_t::GENERIC,
+                      "Javascript query `%s` caused a crash in a worker process.",
+                      js_source.c_str());
+            } catch (const interrupted_exc_t &e) {
+                rfail(base_exc_t::GENERIC,
+                      "JavaScript query `%s` timed out after "
+                      "%" PRIu64 ".%03" PRIu64 " seconds.",
+                      js_source.c_str(), js_timeout_ms / 1000, js_timeout_ms % 1000);
+            }
+
+            for (size_t i = 0; i < results.size(); ++i) {
+                (*rows)[pending[start + i]] = boost::apply_visitor(
+                    js_result_visitor_t(js_source, js_timeout_ms, this),
+                    results[i])->as_datum();
+            }
+        }
+    } catch (const datum_exc_t &e) {
+        rfail(e.get_type(), "%s", e.what());
+        unreachable();
+    }
+}
+
 bool js_func_t::is_deterministic() const {
     return false;
 }
 
+scoped_ptr_t<filter_predicate_t> js_func_t::make_filter_predicate() const {
+    if (!native_body.has()) {
+        return scoped_ptr_t<filter_predicate_t>();
+    }
+    return compile_filter_predicate(js_function_args(), *native_body,
+                                    comparisons_t::JAVASCRIPT);
+}
+
 void reql_func_t::visit(func_visitor_t *visitor) const {
     visitor->on_reql_func(this);
 }
@@ -176,7 +331,7 @@ func_term_t::func_term_t(compile_env_t *env, const protob_t<const Term> &t)
 
     var_visibility_t varname_visibility = env->visibility.with_func_arg_name_list(args);
 
-    compile_env_t body_env(std::move(varname_visibility));
+    compile_env_t body_env(std::move(varname_visibility), env->datum_terms);
 
     protob_t<const Term> body_source = t.make_child(&t->args(1));
     counted_t<term_t> compiled_body = compile_term(&body_env, body_source);
@@ -223,8 +378,7 @@ bool filter_match(counted_t<const datum_t> predicate, counted_t<const datum_t> v
     if (predicate->is_ptype(pseudo::literal_string)) {
         return *predicate->get(pseudo::value_key) == *value;
     } else {
-        const std::map<std::string, counted_t<const datum_t> > &obj
-            = predicate->as_object();
+        const datum_object_t &obj = predicate->as_object();
         for (auto it = obj.begin(); it != obj.end(); ++it) {
             r_sanity_check(it->second.has());
             counted_t<const datum_t> elt = value->get(it->first, NOTHROW);
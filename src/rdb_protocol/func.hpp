@@ -13,6 +13,7 @@
 #include "containers/counted.hpp"
 #include "containers/uuid.hpp"
 #include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/compiled_func.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/sym.hpp"
 #include "rdb_protocol/term.hpp"
@@ -42,10 +43,42 @@ public:
 
     void assert_deterministic(const char *extra_msg) const;
 
+    // Returns true, and sets `*field_out`, if the function just returns a field of
+    // its argument (like the function `index_create` makes out of a field name).
+    virtual bool is_get_field_of_arg(UNUSED std::string *field_out) const {
+        return false;
+    }
+
+    // Returns true, and sets `*field_out` and `*value_out`, if the function just
+    // compares a field of its argument to a number or string constant.
+    virtual bool is_get_field_eq_constant(
+            UNUSED std::string *field_out,
+            UNUSED counted_t<const datum_t> *value_out) const {
+        return false;
+    }
+
+    // Returns the function lowered into a `filter_predicate_t` for `filter`, or an
+    // empty pointer if it can't be.  `filter_call` still has to decide the rows the
+    // predicate returns `UNKNOWN` for.
+    virtual scoped_ptr_t<filter_predicate_t> make_filter_predicate() const {
+        return scoped_ptr_t<filter_predicate_t>();
+    }
+
+    // Likewise for `map`.
+    virtual scoped_ptr_t<map_function_t> make_map_function() const {
+        return scoped_ptr_t<map_function_t>();
+    }
+
     bool filter_call(env_t *env,
                      counted_t<const datum_t> arg,
                      counted_t<func_t> default_filter_val) const;
 
+    // Replaces each of `rows` with the datum the function returns for it, as `map`
+    // does.  This calls the function on one row after another, but `js_func_t`
+    // hands the rows to its worker in batches.
+    virtual void map_rows(env_t *env,
+                          std::vector<counted_t<const datum_t> > *rows) const;
+
     // These are simple, they call the vector version of call.
     counted_t<val_t> call(env_t *env, eval_flags_t eval_flags = NO_FLAGS) const;
     counted_t<val_t> call(env_t *env,
@@ -79,6 +112,13 @@ public:
         eval_flags_t eval_flags) const;
     bool is_deterministic() const;
 
+    bool is_get_field_of_arg(std::string *field_out) const;
+    bool is_get_field_eq_constant(std::string *field_out,
+                                  counted_t<const datum_t> *value_out) const;
+
+    scoped_ptr_t<filter_predicate_t> make_filter_predicate() const;
+    scoped_ptr_t<map_function_t> make_map_function() const;
+
     std::string print_source() const;
 
     void visit(func_visitor_t *visitor) const;
@@ -112,8 +152,16 @@ public:
                           const std::vector<counted_t<const datum_t> > &args,
                           eval_flags_t eval_flags) const;
 
+    void map_rows(env_t *env, std::vector<counted_t<const datum_t> > *rows) const;
+
     bool is_deterministic() const;
 
+    scoped_ptr_t<filter_predicate_t> make_filter_predicate() const;
+
+    // True if `translate_js_function` knew the source, so that most calls don't need
+    // a worker.
+    bool is_translated() const { return native_body.has(); }
+
     std::string print_source() const;
 
     void visit(func_visitor_t *visitor) const;
@@ -122,9 +170,20 @@ private:
     friend class wire_func_serialization_visitor_t;
     bool filter_helper(env_t *env, counted_t<const datum_t> arg) const;
 
+    // Calls the function natively on `arg`, if it can.
+    bool call_natively(const counted_t<const datum_t> &arg,
+                       counted_t<const datum_t> *out) const;
+    // The arguments of `native_body`.
+    static std::vector<sym_t> js_function_args();
+
     std::string js_source;
     uint64_t js_timeout_ms;
 
+    // The source translated into terms and lowered, or empty.  Rows these give up on
+    // still go to a worker.
+    scoped_ptr_t<Term> native_body;
+    scoped_ptr_t<map_function_t> native;
+
     DISABLE_COPYING(js_func_t);
 };
 
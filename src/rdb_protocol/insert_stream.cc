@@ -0,0 +1,184 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/insert_stream.hpp"
+
+#include <functional>
+#include <utility>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/interruptor.hpp"
+#include "concurrency/watchable.hpp"
+#include "config/args.hpp"
+#include "containers/uuid.hpp"
+#include "rdb_protocol/batching.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/error.hpp"
+#include "rdb_protocol/val.hpp"
+
+namespace ql {
+
+// Predeclarations, defined with the write terms.
+counted_t<const datum_t> pure_merge(const std::string &key,
+                                    counted_t<const datum_t> l,
+                                    counted_t<const datum_t> r);
+counted_t<const datum_t> new_stats_object();
+
+std::string generate_missing_key(const counted_t<table_t> &table,
+                                 counted_t<const datum_t> *datum_inout) {
+    if ((*datum_inout)->get(table->get_pkey(), NOTHROW).has()) {
+        return std::string();
+    }
+    std::string key = uuid_to_str(generate_uuid());
+    datum_ptr_t d(datum_t::R_OBJECT);
+    bool conflict = d.add(table->get_pkey(),
+                          make_counted<const datum_t>(std::string(key)));
+    r_sanity_check(!conflict);
+    *datum_inout = (*datum_inout)->merge(d.to_counted(), pure_merge);
+    return key;
+}
+
+insert_stream_t::insert_stream_t(env_t *env, counted_t<table_t> _table, bool _upsert,
+                                 durability_requirement_t _durability_requirement)
+    : table(_table),
+      upsert(_upsert),
+      durability_requirement(_durability_requirement),
+      write_env(new env_t(env->extproc_pool,
+                          env->cluster_access.ns_repo,
+                          env->cluster_access.namespaces_semilattice_metadata,
+                          env->cluster_access.databases_semilattice_metadata,
+                          env->cluster_access.semilattice_metadata,
+                          env->cluster_access.directory_read_manager,
+                          &stopping,
+                          env->cluster_access.this_machine,
+                          profile_bool_t::DONT_PROFILE)),
+      batches_in_flight(INSERT_STREAM_MAX_BATCHES_IN_FLIGHT),
+      stats(new_stats_object()) { }
+
+insert_stream_t::~insert_stream_t() {
+    // `drainer` then waits for the batches to give up.
+    stopping.pulse();
+}
+
+counted_t<const datum_t> insert_stream_t::add_batch(
+        std::vector<counted_t<const datum_t> > &&docs, signal_t *interruptor) {
+    throw_if_failed();
+    rcheck_datum(docs.size() <= array_size_limit(), base_exc_t::GENERIC,
+                 strprintf("Array over size limit `%zu`.", array_size_limit()));
+
+    std::vector<counted_t<const datum_t> > generated_keys;
+    for (auto it = docs.begin(); it != docs.end(); ++it) {
+        try {
+            std::string key = generate_missing_key(table, &*it);
+            if (!key.empty()) {
+                generated_keys.push_back(make_counted<const datum_t>(std::move(key)));
+            }
+        } catch (const base_exc_t &) {
+            // The write reports the same error for the document.
+        }
+    }
+
+    if (!docs.empty()) {
+        scoped_ptr_t<new_semaphore_acq_t> acq(
+            new new_semaphore_acq_t(&batches_in_flight, 1));
+        wait_interruptible(acq->acquisition_signal(), interruptor);
+        coro_t::spawn_sometime(std::bind(&insert_stream_t::write_batch, this,
+                                         auto_drainer_t::lock_t(&drainer),
+                                         std::move(docs), acq.release()));
+    }
+
+    datum_ptr_t res(datum_t::R_OBJECT);
+    UNUSED bool b = res.add("generated_keys",
+                            make_counted<const datum_t>(std::move(generated_keys)));
+    return res.to_counted();
+}
+
+counted_t<const datum_t> insert_stream_t::finish(signal_t *interruptor) {
+    wait_for_writes(interruptor);
+    throw_if_failed();
+    return stats;
+}
+
+void insert_stream_t::wait_for_writes(signal_t *interruptor) {
+    // The semaphore hands itself out in order, so this gets all of it once the
+    // batches before it are done.
+    new_semaphore_acq_t all(&batches_in_flight, INSERT_STREAM_MAX_BATCHES_IN_FLIGHT);
+    wait_interruptible(all.acquisition_signal(), interruptor);
+}
+
+void insert_stream_t::write_batch(auto_drainer_t::lock_t,
+                                  std::vector<counted_t<const datum_t> > docs,
+                                  new_semaphore_acq_t *_acq) {
+    scoped_ptr_t<new_semaphore_acq_t> acq(_acq);
+    try {
+        counted_t<const datum_t> batch_stats = table->batched_insert(
+            write_env.get(), std::move(docs), upsert, durability_requirement, false);
+        stats = stats->merge(batch_stats, stats_merge);
+    } catch (const base_exc_t &e) {
+        if (!failure) {
+            failure = std::string(e.what());
+        }
+    } catch (const interrupted_exc_t &) {
+        if (!failure) {
+            failure = std::string("Streaming insert interrupted.");
+        }
+    }
+}
+
+void insert_stream_t::throw_if_failed() const {
+    if (failure) {
+        rfail_datum(base_exc_t::GENERIC, "%s", failure->c_str());
+    }
+}
+
+bool insert_stream_cache_t::contains(int64_t key) {
+    return streams.find(key) != streams.end();
+}
+
+void insert_stream_cache_t::insert(int64_t key,
+                                   use_json_t use_json,
+                                   scoped_ptr_t<insert_stream_t> &&stream) {
+    std::pair<boost::ptr_map<int64_t, entry_t>::iterator, bool> res = streams.insert(
+        key, new entry_t(use_json, std::move(stream)));
+    guarantee(res.second);
+}
+
+void insert_stream_cache_t::erase(int64_t key) {
+    size_t num_erased = streams.erase(key);
+    guarantee(num_erased == 1);
+}
+
+void insert_stream_cache_t::serve(int64_t key, const Query &q, Response *res,
+                                  signal_t *interruptor) {
+    boost::ptr_map<int64_t, entry_t>::iterator it = streams.find(key);
+    guarantee(it != streams.end());
+    entry_t *entry = it->second;
+    try {
+        if (q.has_query()) {
+            rcheck_toplevel(q.query().type() == Term::DATUM, base_exc_t::GENERIC,
+                            "A streaming insert takes each batch of documents "
+                            "as a DATUM term.");
+            counted_t<const datum_t> batch
+                = make_counted<const datum_t>(&q.query().datum());
+            std::vector<counted_t<const datum_t> > docs = batch->as_array();
+            counted_t<const datum_t> keys
+                = entry->stream->add_batch(std::move(docs), interruptor);
+            keys->write_to_protobuf(res->add_response(), entry->use_json);
+            res->set_type(Response::SUCCESS_PARTIAL);
+        } else {
+            counted_t<const datum_t> stats = entry->stream->finish(interruptor);
+            stats->write_to_protobuf(res->add_response(), entry->use_json);
+            res->set_type(Response::SUCCESS_ATOM);
+            erase(key);
+        }
+    } catch (const std::exception &e) {
+        erase(key);
+        throw;
+    }
+}
+
+void insert_stream_cache_t::wait_for_writes(signal_t *interruptor) {
+    for (auto it = streams.begin(); it != streams.end(); ++it) {
+        it->second->stream->wait_for_writes(interruptor);
+    }
+}
+
+}  // namespace ql
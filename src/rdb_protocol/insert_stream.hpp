@@ -0,0 +1,118 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_INSERT_STREAM_HPP_
+#define RDB_PROTOCOL_INSERT_STREAM_HPP_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/optional.hpp>
+#include <boost/ptr_container/ptr_map.hpp>
+
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
+#include "concurrency/new_semaphore.hpp"
+#include "containers/counted.hpp"
+#include "containers/scoped.hpp"
+#include "protocol_api.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/ql2.pb.h"
+
+namespace ql {
+
+class env_t;
+class table_t;
+
+// Gives `*datum_inout` a random primary key for `table` if it doesn't have one, and
+// returns the key, or an empty string if it had one.
+std::string generate_missing_key(const counted_t<table_t> &table,
+                                 counted_t<const datum_t> *datum_inout);
+
+/* The writes of an `insert` that was run with `stream: true`.  Each batch of
+documents is written to the table while the client sends the next ones, but no more
+than INSERT_STREAM_MAX_BATCHES_IN_FLIGHT of them at once: `add_batch` waits for one
+to finish first, and the client doesn't get its answer (or start on the insert's
+next batch) until then.
+
+The batches are written in an env_t of their own, since they outlive the query that
+handed them over. */
+class insert_stream_t {
+public:
+    insert_stream_t(env_t *env, counted_t<table_t> table, bool upsert,
+                    durability_requirement_t durability_requirement);
+    // Interrupts the batches being written.  Some of their documents may have been
+    // written anyway.
+    ~insert_stream_t();
+
+    // Gives `docs` the primary keys they don't have and starts writing them.
+    // Returns an object with the generated keys.  Throws the error that stopped
+    // an earlier batch, if one did.
+    counted_t<const datum_t> add_batch(std::vector<counted_t<const datum_t> > &&docs,
+                                       signal_t *interruptor);
+
+    // Waits for every batch to be written, and returns the stats of the whole
+    // insert.
+    counted_t<const datum_t> finish(signal_t *interruptor);
+
+    // Waits for the batches being written now.
+    void wait_for_writes(signal_t *interruptor);
+
+private:
+    void write_batch(auto_drainer_t::lock_t,
+                     std::vector<counted_t<const datum_t> > docs,
+                     new_semaphore_acq_t *acq);
+    void throw_if_failed() const;
+
+    const counted_t<table_t> table;
+    const bool upsert;
+    const durability_requirement_t durability_requirement;
+
+    // The interruptor of `write_env`, pulsed when the stream is destroyed.
+    cond_t stopping;
+    scoped_ptr_t<env_t> write_env;
+
+    new_semaphore_t batches_in_flight;
+    counted_t<const datum_t> stats;
+    // The error that a batch failed with, as a whole.
+    boost::optional<std::string> failure;
+
+    auto_drainer_t drainer;
+
+    DISABLE_COPYING(insert_stream_t);
+};
+
+/* The streaming inserts that the queries on a connection have started, by token.
+The client sends each batch of documents as the `query` of a CONTINUE query, a DATUM
+term holding an array, and ends the insert with a CONTINUE query without one. */
+class insert_stream_cache_t {
+public:
+    insert_stream_cache_t() { }
+
+    MUST_USE bool contains(int64_t key);
+    void insert(int64_t key, use_json_t use_json,
+                scoped_ptr_t<insert_stream_t> &&stream);
+    void erase(int64_t key);
+    // Answers the CONTINUE query `q` for the insert `key`.
+    void serve(int64_t key, const Query &q, Response *res, signal_t *interruptor);
+
+    // Waits for all the batches the inserts are writing.
+    void wait_for_writes(signal_t *interruptor);
+
+private:
+    struct entry_t {
+        entry_t(use_json_t _use_json, scoped_ptr_t<insert_stream_t> &&_stream)
+            : use_json(_use_json), stream(std::move(_stream)) { }
+        use_json_t use_json;
+        scoped_ptr_t<insert_stream_t> stream;
+    private:
+        DISABLE_COPYING(entry_t);
+    };
+
+    boost::ptr_map<int64_t, entry_t> streams;
+    DISABLE_COPYING(insert_stream_cache_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_INSERT_STREAM_HPP_
@@ -0,0 +1,413 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/js_translate.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmath>
+#include <string>
+#include <utility>
+
+#include "config/args.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/ql2.pb.h"
+
+namespace ql {
+
+// Words that can't name the function's argument.
+static const char *const reserved_words[] = {
+    "break", "case", "catch", "class", "const", "continue", "debugger", "default",
+    "delete", "do", "else", "enum", "export", "extends", "false", "finally", "for",
+    "function", "if", "implements", "import", "in", "instanceof", "interface", "let",
+    "new", "null", "package", "private", "protected", "public", "return", "static",
+    "super", "switch", "this", "throw", "true", "try", "typeof", "var", "void",
+    "while", "with", "yield"
+};
+
+// The punctuators the parser stops at, longest first so that `<` isn't read out of
+// `<=`.  It only knows some of them; the others are here so they aren't read as one
+// it knows (`==` as `=`, or the start of a comment as `/`).
+static const char *const punctuators[] = {
+    "===", "!==", ">>>", "<<=", ">>=",
+    "==", "!=", "<=", ">=", "&&", "||", "<<", ">>", "++", "--", "+=", "-=", "*=",
+    "/=", "%=", "&=", "|=", "^=", "//", "/*",
+    "<", ">", "+", "-", "*", "/", "%", "!", "?", ":", "(", ")", "[", "]", "{", "}",
+    ".", ";", ",", "=", "&", "|", "^", "~"
+};
+
+static bool is_identifier_start(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '$';
+}
+
+static bool is_identifier_part(char c) {
+    return is_identifier_start(c) || (c >= '0' && c <= '9');
+}
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+template <class... T>
+static scoped_ptr_t<Term> make_term(Term_TermType type, T &&... args) {
+    return scoped_ptr_t<Term>(r::reql_t(type, std::forward<T>(args)...).release());
+}
+
+static r::reql_t wrap(scoped_ptr_t<Term> &&term) {
+    return r::reql_t(std::move(term));
+}
+
+class js_parser_t {
+public:
+    explicit js_parser_t(const std::string &_source)
+        : source(_source), pos(0), operands(0) { }
+
+    // (function [name](arg) { return <ternary>[;] })[;]
+    scoped_ptr_t<Term> parse_function() {
+        std::string name;
+        if (!eat_punctuator("(") || !eat_word("function")) {
+            return scoped_ptr_t<Term>();
+        }
+        if (peek_identifier(&name)) {
+            // The name of the function, which it can't use.
+            if (!eat_identifier(&name) || is_reserved(name)) {
+                return scoped_ptr_t<Term>();
+            }
+        }
+        if (!eat_punctuator("(") || !eat_identifier(&arg_name) || is_reserved(arg_name)
+            || !eat_punctuator(")") || !eat_punctuator("{") || !eat_word("return")) {
+            return scoped_ptr_t<Term>();
+        }
+        // A line break right after `return` makes it return `undefined`.
+        if (skip_whitespace()) {
+            return scoped_ptr_t<Term>();
+        }
+        scoped_ptr_t<Term> body = parse_ternary();
+        if (!body.has()) {
+            return scoped_ptr_t<Term>();
+        }
+        eat_punctuator(";");
+        if (!eat_punctuator("}") || !eat_punctuator(")")) {
+            return scoped_ptr_t<Term>();
+        }
+        eat_punctuator(";");
+        skip_whitespace();
+        if (pos != source.size()) {
+            return scoped_ptr_t<Term>();
+        }
+        return body;
+    }
+
+private:
+    // <or> [? <ternary> : <ternary>]
+    scoped_ptr_t<Term> parse_ternary() {
+        scoped_ptr_t<Term> test = parse_binary(0);
+        if (!test.has() || !eat_punctuator("?")) {
+            return test;
+        }
+        scoped_ptr_t<Term> true_branch = parse_ternary();
+        if (!true_branch.has() || !eat_punctuator(":")) {
+            return scoped_ptr_t<Term>();
+        }
+        scoped_ptr_t<Term> false_branch = parse_ternary();
+        if (!false_branch.has()) {
+            return scoped_ptr_t<Term>();
+        }
+        return make_term(Term::BRANCH, wrap(std::move(test)),
+                         wrap(std::move(true_branch)), wrap(std::move(false_branch)));
+    }
+
+    // The left-associative binary operators, from the loosest to the tightest.
+    struct binary_op_t {
+        int level;
+        const char *punctuator;
+        Term_TermType type;
+    };
+
+    scoped_ptr_t<Term> parse_binary(int level) {
+        static const binary_op_t ops[] = {
+            { 0, "||", Term::ANY },
+            { 1, "&&", Term::ALL },
+            { 2, "===", Term::EQ }, { 2, "!==", Term::NE },
+            { 3, "<", Term::LT }, { 3, "<=", Term::LE },
+            { 3, ">", Term::GT }, { 3, ">=", Term::GE },
+            { 4, "+", Term::ADD }, { 4, "-", Term::SUB },
+            { 5, "*", Term::MUL }, { 5, "/", Term::DIV }
+        };
+        static const int num_levels = 6;
+        if (level == num_levels) {
+            return parse_unary();
+        }
+
+        scoped_ptr_t<Term> lhs = parse_binary(level + 1);
+        while (lhs.has()) {
+            const std::string punctuator = peek_punctuator();
+            const binary_op_t *op = NULL;
+            for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); ++i) {
+                if (ops[i].level == level && punctuator == ops[i].punctuator) {
+                    op = &ops[i];
+                }
+            }
+            if (op == NULL) {
+                break;
+            }
+            eat_punctuator(op->punctuator);
+            scoped_ptr_t<Term> rhs = parse_binary(level + 1);
+            if (!rhs.has()) {
+                return scoped_ptr_t<Term>();
+            }
+            lhs = make_term(op->type, wrap(std::move(lhs)), wrap(std::move(rhs)));
+        }
+        return lhs;
+    }
+
+    // [! | -]* <postfix>
+    scoped_ptr_t<Term> parse_unary() {
+        if (++operands > JS_TRANSLATE_MAX_OPERANDS) {
+            return scoped_ptr_t<Term>();
+        }
+        if (eat_punctuator("!")) {
+            scoped_ptr_t<Term> arg = parse_unary();
+            if (!arg.has()) {
+                return scoped_ptr_t<Term>();
+            }
+            return make_term(Term::NOT, wrap(std::move(arg)));
+        }
+        if (eat_punctuator("-")) {
+            scoped_ptr_t<Term> arg = parse_unary();
+            if (!arg.has()) {
+                return scoped_ptr_t<Term>();
+            }
+            if (arg->type() == Term::DATUM && arg->datum().type() == Datum::R_NUM) {
+                arg->mutable_datum()->set_r_num(-arg->datum().r_num());
+                return arg;
+            }
+            // Not `0 - x`, which is 0 rather than -0 for 0.
+            return make_term(Term::MUL, r::expr(-1.0), wrap(std::move(arg)));
+        }
+        return parse_postfix();
+    }
+
+    // <primary> [.name | ["name"]]*
+    scoped_ptr_t<Term> parse_postfix() {
+        scoped_ptr_t<Term> obj = parse_primary();
+        while (obj.has()) {
+            std::string field;
+            if (eat_punctuator(".")) {
+                if (!eat_identifier(&field)) {
+                    return scoped_ptr_t<Term>();
+                }
+            } else if (eat_punctuator("[")) {
+                if (!eat_string(&field) || !eat_punctuator("]")) {
+                    return scoped_ptr_t<Term>();
+                }
+            } else {
+                break;
+            }
+            // The prototype isn't a field.
+            if (field == "__proto__") {
+                return scoped_ptr_t<Term>();
+            }
+            obj = make_term(Term::GET_FIELD, wrap(std::move(obj)), r::expr(field));
+        }
+        return obj;
+    }
+
+    scoped_ptr_t<Term> parse_primary() {
+        skip_whitespace();
+        double num;
+        std::string str;
+        if (eat_number(&num)) {
+            return scoped_ptr_t<Term>(r::expr(num).release());
+        } else if (eat_string(&str)) {
+            return scoped_ptr_t<Term>(r::expr(str).release());
+        } else if (eat_punctuator("(")) {
+            scoped_ptr_t<Term> inner = parse_ternary();
+            if (!inner.has() || !eat_punctuator(")")) {
+                return scoped_ptr_t<Term>();
+            }
+            return inner;
+        } else if (eat_identifier(&str)) {
+            if (str == arg_name) {
+                return scoped_ptr_t<Term>(
+                    r::var(pb::dummy_var_t::JS_FUNCTION_ARG).release());
+            } else if (str == "true" || str == "false") {
+                return scoped_ptr_t<Term>(r::boolean(str == "true").release());
+            } else if (str == "null") {
+                return scoped_ptr_t<Term>(r::null().release());
+            }
+        }
+        return scoped_ptr_t<Term>();
+    }
+
+    // Returns true if it skipped a line break.
+    bool skip_whitespace() {
+        bool line_break = false;
+        while (pos < source.size()) {
+            const char c = source[pos];
+            if (c == '\n' || c == '\r') {
+                line_break = true;
+            } else if (c != ' ' && c != '\t') {
+                break;
+            }
+            ++pos;
+        }
+        return line_break;
+    }
+
+    std::string peek_punctuator() {
+        skip_whitespace();
+        for (size_t i = 0; i < sizeof(punctuators) / sizeof(punctuators[0]); ++i) {
+            if (source.compare(pos, strlen(punctuators[i]), punctuators[i]) == 0) {
+                return punctuators[i];
+            }
+        }
+        return std::string();
+    }
+
+    bool eat_punctuator(const char *punctuator) {
+        // A number like `.5` isn't a `.`.
+        if (peek_punctuator() != punctuator
+            || (source[pos] == '.' && pos + 1 < source.size()
+                && is_digit(source[pos + 1]))) {
+            return false;
+        }
+        pos += strlen(punctuator);
+        return true;
+    }
+
+    bool peek_identifier(std::string *out) {
+        const size_t start = pos;
+        const bool res = eat_identifier(out);
+        pos = start;
+        return res;
+    }
+
+    bool eat_identifier(std::string *out) {
+        skip_whitespace();
+        if (pos == source.size() || !is_identifier_start(source[pos])) {
+            return false;
+        }
+        const size_t start = pos;
+        while (pos < source.size() && is_identifier_part(source[pos])) {
+            ++pos;
+        }
+        out->assign(source, start, pos - start);
+        return true;
+    }
+
+    bool eat_word(const char *word) {
+        const size_t start = pos;
+        std::string identifier;
+        if (eat_identifier(&identifier) && identifier == word) {
+            return true;
+        }
+        pos = start;
+        return false;
+    }
+
+    // Only decimal literals; a leading 0 would make an octal one.
+    bool eat_number(double *out) {
+        skip_whitespace();
+        size_t end = pos;
+        while (end < source.size() && is_digit(source[end])) {
+            ++end;
+        }
+        const size_t int_digits = end - pos;
+        size_t frac_digits = 0;
+        if (end < source.size() && source[end] == '.') {
+            ++end;
+            while (end < source.size() && is_digit(source[end])) {
+                ++end;
+                ++frac_digits;
+            }
+        }
+        if ((int_digits == 0 && frac_digits == 0)
+            || (int_digits > 1 && source[pos] == '0')) {
+            return false;
+        }
+        if (end < source.size() && (source[end] == 'e' || source[end] == 'E')) {
+            ++end;
+            if (end < source.size() && (source[end] == '+' || source[end] == '-')) {
+                ++end;
+            }
+            if (end == source.size() || !is_digit(source[end])) {
+                return false;
+            }
+            while (end < source.size() && is_digit(source[end])) {
+                ++end;
+            }
+        }
+        if (end < source.size() && is_identifier_part(source[end])) {
+            return false;
+        }
+        const std::string literal(source, pos, end - pos);
+        *out = strtod(literal.c_str(), NULL);
+        if (!std::isfinite(*out)) {
+            return false;
+        }
+        pos = end;
+        return true;
+    }
+
+    // Only printable ASCII and the simple escapes.
+    bool eat_string(std::string *out) {
+        skip_whitespace();
+        if (pos == source.size() || (source[pos] != '"' && source[pos] != '\'')) {
+            return false;
+        }
+        const char quote = source[pos];
+        std::string str;
+        for (size_t i = pos + 1; i < source.size(); ++i) {
+            const char c = source[i];
+            if (c == quote) {
+                *out = str;
+                pos = i + 1;
+                return true;
+            } else if (c < 0x20 || c > 0x7e) {
+                return false;
+            } else if (c != '\\') {
+                str.push_back(c);
+                continue;
+            }
+            if (++i == source.size()) {
+                return false;
+            }
+            switch (source[i]) {
+            case '"': // fallthru
+            case '\'': // fallthru
+            case '\\': // fallthru
+            case '/': str.push_back(source[i]); break;
+            case 'b': str.push_back('\b'); break;
+            case 'f': str.push_back('\f'); break;
+            case 'n': str.push_back('\n'); break;
+            case 'r': str.push_back('\r'); break;
+            case 't': str.push_back('\t'); break;
+            case 'v': str.push_back('\v'); break;
+            default: return false;
+            }
+        }
+        return false;
+    }
+
+    static bool is_reserved(const std::string &word) {
+        for (size_t i = 0; i < sizeof(reserved_words) / sizeof(reserved_words[0]); ++i) {
+            if (word == reserved_words[i]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const std::string &source;
+    size_t pos;
+    int operands;
+    std::string arg_name;
+
+    DISABLE_COPYING(js_parser_t);
+};
+
+scoped_ptr_t<Term> translate_js_function(const std::string &source) {
+    return js_parser_t(source).parse_function();
+}
+
+}  // namespace ql
@@ -0,0 +1,33 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_JS_TRANSLATE_HPP_
+#define RDB_PROTOCOL_JS_TRANSLATE_HPP_
+
+#include <string>
+
+#include "containers/scoped.hpp"
+
+class Term;
+
+namespace ql {
+
+/* Translates the source of an `r.js` function, if it's simple enough, into the body
+of a ReQL function of the one argument `pb::dummy_var_t::JS_FUNCTION_ARG`, so that
+`js_func_t` can run it without a worker.  It knows functions like
+
+    (function(doc) { return doc.a * 2 > doc["b"] ? doc.a : -doc.b; })
+
+that return an expression of their argument's fields, number, string, boolean and null
+literals, `+ - * /`, `=== !== < <= > >=`, `! && ||` and `?:`.
+
+JavaScript and ReQL disagree about most of these for some values (`"a" + 1`, `5 &&
+x`, `1 < "2"`...).  The body only says what the function does for the values they
+agree on, when `compile_map_function` and `compile_filter_predicate` lower it with
+`comparisons_t::JAVASCRIPT`, and the function still has to be run in a worker for the
+rows those give up on.
+
+Returns an empty pointer if it doesn't know everything in `source`. */
+scoped_ptr_t<Term> translate_js_function(const std::string &source);
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_JS_TRANSLATE_HPP_
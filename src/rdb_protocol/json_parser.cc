@@ -0,0 +1,351 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/json_parser.hpp"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "config/args.hpp"
+#include "containers/wire_string.hpp"
+#include "rdb_protocol/error.hpp"
+
+namespace ql {
+
+// The first `"` or `\` in `[p, end)`, or `end`.  Strings are most of most JSON
+// documents, so we look at 16 bytes at a time where we can.
+static const char *find_quote_or_backslash(const char *p, const char *end) {
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                                  _mm_cmpeq_epi8(chunk, backslash)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+    while (p != end && *p != '"' && *p != '\\') {
+        ++p;
+    }
+    return p;
+}
+
+static bool is_number_char(char c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.'
+        || c == 'e' || c == 'E';
+}
+
+static void append_utf8(uint32_t code_point, std::string *out) {
+    if (code_point < 0x80) {
+        out->push_back(code_point);
+    } else if (code_point < 0x800) {
+        out->push_back(0xC0 | (code_point >> 6));
+        out->push_back(0x80 | (code_point & 0x3F));
+    } else if (code_point < 0x10000) {
+        out->push_back(0xE0 | (code_point >> 12));
+        out->push_back(0x80 | ((code_point >> 6) & 0x3F));
+        out->push_back(0x80 | (code_point & 0x3F));
+    } else {
+        out->push_back(0xF0 | (code_point >> 18));
+        out->push_back(0x80 | ((code_point >> 12) & 0x3F));
+        out->push_back(0x80 | ((code_point >> 6) & 0x3F));
+        out->push_back(0x80 | (code_point & 0x3F));
+    }
+}
+
+// A recursive descent parser.  Each `parse_*` function returns an empty `counted_t`
+// (or false) if the text isn't JSON, and leaves `p` after what it parsed.
+class json_parser_t {
+public:
+    json_parser_t(const char *json, size_t size) : p(json), end(json + size) { }
+
+    counted_t<const datum_t> parse() {
+        skip_whitespace();
+        counted_t<const datum_t> res = parse_value(0);
+        skip_whitespace();
+        return p == end ? res : counted_t<const datum_t>();
+    }
+
+private:
+    counted_t<const datum_t> parse_value(int depth) {
+        if (p == end) {
+            return counted_t<const datum_t>();
+        }
+        switch (*p) {
+        case 'n':
+            return consume_literal("null")
+                ? make_counted<const datum_t>(datum_t::R_NULL)
+                : counted_t<const datum_t>();
+        case 't':
+            return consume_literal("true")
+                ? make_counted<const datum_t>(datum_t::R_BOOL, true)
+                : counted_t<const datum_t>();
+        case 'f':
+            return consume_literal("false")
+                ? make_counted<const datum_t>(datum_t::R_BOOL, false)
+                : counted_t<const datum_t>();
+        case '"': return parse_string_datum();
+        case '[': return parse_array(depth + 1);
+        case '{': return parse_object(depth + 1);
+        default:
+            if (*p == '-' || (*p >= '0' && *p <= '9')) {
+                return parse_number();
+            }
+            return counted_t<const datum_t>();
+        }
+    }
+
+    counted_t<const datum_t> parse_array(int depth) {
+        check_depth(depth);
+        ++p;
+        skip_whitespace();
+        std::vector<counted_t<const datum_t> > items;
+        if (p != end && *p == ']') {
+            ++p;
+            return make_counted<const datum_t>(std::move(items));
+        }
+        for (;;) {
+            counted_t<const datum_t> item = parse_value(depth);
+            if (!item.has()) {
+                return counted_t<const datum_t>();
+            }
+            items.push_back(std::move(item));
+            skip_whitespace();
+            if (p == end) {
+                return counted_t<const datum_t>();
+            } else if (*p == ',') {
+                ++p;
+                skip_whitespace();
+            } else if (*p == ']') {
+                ++p;
+                return make_counted<const datum_t>(std::move(items));
+            } else {
+                return counted_t<const datum_t>();
+            }
+        }
+    }
+
+    counted_t<const datum_t> parse_object(int depth) {
+        check_depth(depth);
+        ++p;
+        skip_whitespace();
+        std::vector<datum_object_t::value_type> fields;
+        if (p != end && *p == '}') {
+            ++p;
+        } else {
+            for (;;) {
+                std::string key;
+                if (p == end || *p != '"' || !parse_string(&key)) {
+                    return counted_t<const datum_t>();
+                }
+                skip_whitespace();
+                if (p == end || *p != ':') {
+                    return counted_t<const datum_t>();
+                }
+                ++p;
+                skip_whitespace();
+                counted_t<const datum_t> val = parse_value(depth);
+                if (!val.has()) {
+                    return counted_t<const datum_t>();
+                }
+                size_t null_offset = key.find('\0');
+                rcheck_datum(null_offset == std::string::npos, base_exc_t::GENERIC,
+                             strprintf("String `%.20s` (truncated) contains NULL byte "
+                                       "at offset %zu.", key.c_str(), null_offset));
+                fields.push_back(std::make_pair(std::move(key), std::move(val)));
+                skip_whitespace();
+                if (p == end) {
+                    return counted_t<const datum_t>();
+                } else if (*p == ',') {
+                    ++p;
+                    skip_whitespace();
+                } else if (*p == '}') {
+                    ++p;
+                    break;
+                } else {
+                    return counted_t<const datum_t>();
+                }
+            }
+        }
+        datum_object_t object;
+        std::string duplicate_key;
+        rcheck_datum(object.assign(std::move(fields), &duplicate_key),
+                     base_exc_t::GENERIC,
+                     strprintf("Duplicate key `%s` in JSON.", duplicate_key.c_str()));
+        return make_counted<const datum_t>(std::move(object));
+    }
+
+    counted_t<const datum_t> parse_number() {
+        const char *start = p;
+        while (p != end && is_number_char(*p)) {
+            ++p;
+        }
+
+        // Most numbers are small integers, which we can read without `strtod`.
+        const char *digits = *start == '-' ? start + 1 : start;
+        double num;
+        if (p - digits > 0 && p - digits <= 15
+            && std::all_of(digits, p, [](char c) { return c >= '0' && c <= '9'; })) {
+            int64_t n = 0;
+            for (const char *d = digits; d != p; ++d) {
+                n = n * 10 + (*d - '0');
+            }
+            num = static_cast<double>(n);
+            if (digits != start) {
+                num = -num;
+            }
+        } else {
+            // `strtod` needs the number to end with a NUL.
+            const std::string text(start, p);
+            char *text_end;
+            num = strtod(text.c_str(), &text_end);
+            if (text_end != text.c_str() + text.size()) {
+                return counted_t<const datum_t>();
+            }
+        }
+
+        // so we can use `isfinite` in a GCC 4.4.3-compatible way
+        using namespace std;  // NOLINT(build/namespaces)
+        rcheck_datum(isfinite(num), base_exc_t::GENERIC,
+                     strprintf("Non-finite value `%lf` in JSON.", num));
+        return make_counted<const datum_t>(num);
+    }
+
+    counted_t<const datum_t> parse_string_datum() {
+        // Strings without escape sequences are copied straight out of the text.
+        const char *start = p + 1;
+        const char *stop = find_quote_or_backslash(start, end);
+        if (stop != end && *stop == '"') {
+            p = stop + 1;
+            return make_counted<const datum_t>(
+                wire_string_t::create_and_init(stop - start, start));
+        }
+        std::string str;
+        if (!parse_string(&str)) {
+            return counted_t<const datum_t>();
+        }
+        return make_counted<const datum_t>(std::move(str));
+    }
+
+    MUST_USE bool parse_string(std::string *out) {
+        ++p;
+        for (;;) {
+            const char *stop = find_quote_or_backslash(p, end);
+            out->append(p, stop - p);
+            p = stop;
+            if (p == end) {
+                return false;
+            }
+            if (*p == '"') {
+                ++p;
+                return true;
+            }
+            ++p;
+            if (p == end) {
+                return false;
+            }
+            const char c = *p++;
+            switch (c) {
+            case '"': // fallthru
+            case '\\': // fallthru
+            case '/': out->push_back(c); break;
+            case 'b': out->push_back('\b'); break;
+            case 'f': out->push_back('\f'); break;
+            case 'n': out->push_back('\n'); break;
+            case 'r': out->push_back('\r'); break;
+            case 't': out->push_back('\t'); break;
+            case 'u': {
+                uint32_t code_point;
+                if (!parse_hex4(&code_point)
+                    || (code_point >= 0xDC00 && code_point <= 0xDFFF)) {
+                    return false;
+                }
+                if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+                    // The first half of a UTF-16 surrogate pair.
+                    uint32_t low;
+                    if (end - p < 2 || p[0] != '\\' || p[1] != 'u') {
+                        return false;
+                    }
+                    p += 2;
+                    if (!parse_hex4(&low) || low < 0xDC00 || low > 0xDFFF) {
+                        return false;
+                    }
+                    code_point = 0x10000 + ((code_point - 0xD800) << 10)
+                        + (low - 0xDC00);
+                }
+                append_utf8(code_point, out);
+            } break;
+            default: return false;
+            }
+        }
+    }
+
+    MUST_USE bool parse_hex4(uint32_t *out) {
+        if (end - p < 4) {
+            return false;
+        }
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) {
+            const char c = *p++;
+            value <<= 4;
+            if (c >= '0' && c <= '9') {
+                value |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                value |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                value |= c - 'A' + 10;
+            } else {
+                return false;
+            }
+        }
+        *out = value;
+        return true;
+    }
+
+    template <size_t N>
+    MUST_USE bool consume_literal(const char (&literal)[N]) {
+        const size_t size = N - 1;
+        if (static_cast<size_t>(end - p) < size || memcmp(p, literal, size) != 0) {
+            return false;
+        }
+        p += size;
+        return true;
+    }
+
+    void check_depth(int depth) {
+        rcheck_datum(depth <= JSON_MAX_NESTING_DEPTH, base_exc_t::GENERIC,
+                     strprintf("JSON is nested more than %d levels deep.",
+                               JSON_MAX_NESTING_DEPTH));
+    }
+
+    // Like cJSON, we take every control character for whitespace.
+    void skip_whitespace() {
+        while (p != end && *p != '\0' && static_cast<unsigned char>(*p) <= 32) {
+            ++p;
+        }
+    }
+
+    const char *p;
+    const char *const end;
+
+    DISABLE_COPYING(json_parser_t);
+};
+
+counted_t<const datum_t> parse_json(const char *json, size_t size) {
+    json_parser_t parser(json, size);
+    return parser.parse();
+}
+
+}  // namespace ql
@@ -0,0 +1,23 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_JSON_PARSER_HPP_
+#define RDB_PROTOCOL_JSON_PARSER_HPP_
+
+#include <stddef.h>
+
+#include "containers/counted.hpp"
+#include "rdb_protocol/datum.hpp"
+
+namespace ql {
+
+/* Parses the JSON text in `[json, json + size)` into a datum, without building a cJSON
+tree on the way.  Returns an empty `counted_t` if the text isn't JSON.  Like
+`datum_t(cJSON *)`, throws if the JSON isn't a valid datum (for example if an object
+has the same key twice, or a string holds a NUL byte).
+
+Unlike cJSON, it doesn't ignore what follows the value, other than whitespace, and
+doesn't drop invalid escape sequences from strings; both make the text not JSON. */
+counted_t<const datum_t> parse_json(const char *json, size_t size);
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_JSON_PARSER_HPP_
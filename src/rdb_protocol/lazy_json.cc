@@ -5,9 +5,10 @@
 #include "rdb_protocol/blob_wrapper.hpp"
 
 counted_t<const ql::datum_t> get_data(const rdb_value_t *value, buf_parent_t parent) {
-    rdb_blob_wrapper_t blob(parent.cache()->get_block_size(),
+    const block_size_t block_size = parent.cache()->get_block_size();
+    rdb_blob_wrapper_t blob(block_size,
                             const_cast<rdb_value_t *>(value)->value_ref(),
-                            blob::btree_maxreflen);
+                            rdb_value_maxreflen(block_size));
 
     counted_t<const ql::datum_t> data;
 
@@ -21,6 +22,63 @@ counted_t<const ql::datum_t> get_data(const rdb_value_t *value, buf_parent_t par
     return data;
 }
 
+void get_data_serialized(const rdb_value_t *value, buf_parent_t parent,
+                         std::string *out) {
+    const block_size_t block_size = parent.cache()->get_block_size();
+    rdb_blob_wrapper_t blob(block_size,
+                            const_cast<rdb_value_t *>(value)->value_ref(),
+                            rdb_value_maxreflen(block_size));
+
+    blob_acq_t acq_group;
+    buffer_group_t buffer_group;
+    blob.expose_all(parent, access_t::read, &buffer_group, &acq_group);
+    out->reserve(out->size() + buffer_group.get_size());
+    for (size_t i = 0; i < buffer_group.num_buffers(); ++i) {
+        buffer_group_t::buffer_t buf = buffer_group.get_buffer(i);
+        out->append(static_cast<const char *>(buf.data), buf.size);
+    }
+}
+
+// Reads the parts of a row's blob that `ql::deserialize_field` asks for, so that
+// getting one field of a big row only loads the blocks that field is in.
+class blob_datum_source_t : public ql::serialized_datum_source_t {
+public:
+    blob_datum_source_t(rdb_blob_wrapper_t *_blob, buf_parent_t _parent)
+        : blob(_blob), parent(_parent) { }
+    uint64_t size() {
+        return blob->valuesize();
+    }
+    archive_result_t read(uint64_t offset, uint64_t count,
+                          const std::function<archive_result_t(read_stream_t *)> &fn) {
+        blob_acq_t acq_group;
+        buffer_group_t buffer_group;
+        blob->expose_region(parent, offset, count, &buffer_group, &acq_group);
+        buffer_group_read_stream_t read_stream(const_view(&buffer_group));
+        return fn(&read_stream);
+    }
+private:
+    rdb_blob_wrapper_t *blob;
+    buf_parent_t parent;
+};
+
+counted_t<const ql::datum_t> get_data_field(const rdb_value_t *value,
+                                            buf_parent_t parent,
+                                            const std::string &key,
+                                            counted_t<const ql::datum_t> *whole_out) {
+    const block_size_t block_size = parent.cache()->get_block_size();
+    rdb_blob_wrapper_t blob(block_size,
+                            const_cast<rdb_value_t *>(value)->value_ref(),
+                            rdb_value_maxreflen(block_size));
+
+    counted_t<const ql::datum_t> field;
+
+    blob_datum_source_t source(&blob, parent);
+    archive_result_t res = ql::deserialize_field(&source, key, &field, whole_out);
+    guarantee_deserialization(res, "rdb value field");
+
+    return field;
+}
+
 const counted_t<const ql::datum_t> &lazy_json_t::get() const {
     guarantee(pointee.has());
     if (!pointee->ptr.has()) {
@@ -31,6 +89,26 @@ const counted_t<const ql::datum_t> &lazy_json_t::get() const {
     return pointee->ptr;
 }
 
+counted_t<const ql::datum_t> lazy_json_t::get_field(const std::string &key) const {
+    guarantee(pointee.has());
+    if (pointee->ptr.has()) {
+        return pointee->ptr->get_type() == ql::datum_t::R_OBJECT
+            ? pointee->ptr->get(key, ql::NOTHROW)
+            : counted_t<const ql::datum_t>();
+    }
+    counted_t<const ql::datum_t> whole;
+    counted_t<const ql::datum_t> field
+        = get_data_field(pointee->rdb_value, pointee->parent, key, &whole);
+    if (whole.has()) {
+        // The row is in a format we can't read one field of, so keep the whole
+        // thing for the next call.
+        pointee->ptr = std::move(whole);
+        pointee->rdb_value = NULL;
+        pointee->parent = buf_parent_t();
+    }
+    return field;
+}
+
 bool lazy_json_t::references_parent() const {
     return pointee.has() && !pointee->parent.empty();
 }
@@ -6,16 +6,26 @@
 #include "buffer_cache/alt/blob.hpp"
 #include "rdb_protocol/datum.hpp"
 
+// The maxreflen of rdb values in a btree with block size `bs`.  Files with the
+// default block size keep using blob::btree_maxreflen, which they were written
+// with; larger blocks store proportionally larger values in their leaf nodes.
+inline int rdb_value_maxreflen(block_size_t bs) {
+    if (bs.ser_value() <= DEFAULT_BTREE_BLOCK_SIZE) {
+        return blob::btree_maxreflen;
+    }
+    return bs.ser_value() / RDB_IN_NODE_VALUE_BLOCK_FRACTION;
+}
+
 struct rdb_value_t {
     char contents[];
 
 public:
     int inline_size(block_size_t bs) const {
-        return blob::ref_size(bs, contents, blob::btree_maxreflen);
+        return blob::ref_size(bs, contents, rdb_value_maxreflen(bs));
     }
 
-    int64_t value_size() const {
-        return blob::value_size(contents, blob::btree_maxreflen);
+    int64_t value_size(block_size_t bs) const {
+        return blob::value_size(contents, rdb_value_maxreflen(bs));
     }
 
     const char *value_ref() const {
@@ -30,6 +40,20 @@ public:
 counted_t<const ql::datum_t> get_data(const rdb_value_t *value,
                                       buf_parent_t parent);
 
+// Appends the row stored in `value` to `*out` as it's serialized in the btree, without
+// deserializing it.
+void get_data_serialized(const rdb_value_t *value, buf_parent_t parent,
+                         std::string *out);
+
+// Reads one field of the row stored in `value`, without deserializing the other
+// fields (if the row was stored with an offset table).  Returns an empty pointer if
+// the row has no such field.  If the whole row had to be deserialized, it's stored in
+// `*whole_out` (see `ql::deserialize_field`).
+counted_t<const ql::datum_t> get_data_field(const rdb_value_t *value,
+                                            buf_parent_t parent,
+                                            const std::string &key,
+                                            counted_t<const ql::datum_t> *whole_out);
+
 class lazy_json_pointee_t : public single_threaded_countable_t<lazy_json_pointee_t> {
     lazy_json_pointee_t(const rdb_value_t *_rdb_value, buf_parent_t _parent)
         : rdb_value(_rdb_value), parent(_parent) {
@@ -63,6 +87,9 @@ public:
         : pointee(new lazy_json_pointee_t(rdb_value, parent)) { }
 
     const counted_t<const ql::datum_t> &get() const;
+    // Gets one field of the row, without loading the whole row if it isn't loaded
+    // already.  Returns an empty pointer if the row has no such field.
+    counted_t<const ql::datum_t> get_field(const std::string &key) const;
     bool references_parent() const;
     void reset();
 
@@ -183,7 +183,11 @@ void op_term_t::accumulate_captures(var_captures_t *captures) const {
 
 
 bool op_term_t::is_deterministic() const {
-    for (size_t i = 0; i < args.size(); ++i) {
+    return args_are_deterministic(0);
+}
+
+bool op_term_t::args_are_deterministic(size_t i) const {
+    for (; i < args.size(); ++i) {
         if (!args[i]->is_deterministic()) {
             return false;
         }
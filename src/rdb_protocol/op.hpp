@@ -73,6 +73,9 @@ protected:
     counted_t<func_term_t> lazy_literal_optarg(
         compile_env_t *env, const std::string &key);
 
+    // Whether the arguments from `i` on (and the optargs) are deterministic.
+    bool args_are_deterministic(size_t i) const;
+
     // Provides a default implementation, passing off a call to arg terms and optarg
     // terms.  implicit_var_term_t overrides this.  (var_term_t does too, but it's not
     // a subclass).
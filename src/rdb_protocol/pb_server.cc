@@ -3,6 +3,7 @@
 
 #include "concurrency/cross_thread_watchable.hpp"
 #include "concurrency/watchable.hpp"
+#include "config/args.hpp"
 #include "rdb_protocol/counted_term.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/profile.hpp"
@@ -19,12 +20,13 @@ Response on_unparsable_query2(ql::protob_t<Query> q, std::string msg) {
 query2_server_t::query2_server_t(const std::set<ip_address_t> &local_addresses,
                                  int port,
                                  rdb_protocol_t::context_t *_ctx) :
+    admission(QL_ADMISSION_INITIAL_LIMIT, QL_ADMISSION_QUEUE_TIMEOUT_MS),
     server(local_addresses,
            port,
            boost::bind(&query2_server_t::handle, this, _1, _2, _3),
            &on_unparsable_query2,
            _ctx->auth_metadata,
-           INLINE),
+           CORO_UNORDERED),
     ctx(_ctx), parser_id(generate_uuid()), thread_counters(0)
 { }
 
@@ -42,7 +44,9 @@ namespace ql {
              rdb_protocol_t::context_t *ctx,
              signal_t *interruptor,
              Response *res,
-             stream_cache2_t *stream_cache2);
+             stream_cache2_t *stream_cache2,
+             insert_stream_cache_t *insert_streams,
+             term_cache_t *term_cache);
 }
 
 class scoped_ops_running_stat_t {
@@ -59,6 +63,33 @@ private:
     DISABLE_COPYING(scoped_ops_running_stat_t);
 };
 
+// Records how long a query took in the latency histogram for its type.
+class scoped_latency_stat_t {
+public:
+    explicit scoped_latency_stat_t(perfmon_latency_histogram_t *_histogram)
+        : histogram(_histogram), start(get_ticks()) { }
+    ~scoped_latency_stat_t() {
+        if (histogram != NULL) {
+            histogram->record(get_ticks() - start);
+        }
+    }
+private:
+    perfmon_latency_histogram_t *histogram;
+    ticks_t start;
+    DISABLE_COPYING(scoped_latency_stat_t);
+};
+
+perfmon_latency_histogram_t *latency_histogram(rdb_protocol_t::context_t *ctx,
+                                               Query::QueryType type) {
+    switch (type) {
+    case Query::START: return &ctx->ql_start_latency;
+    case Query::CONTINUE: return &ctx->ql_continue_latency;
+    case Query::STOP: return &ctx->ql_stop_latency;
+    case Query::NOREPLY_WAIT: return &ctx->ql_noreply_wait_latency;
+    default: return NULL;
+    }
+}
+
 bool query2_server_t::handle(ql::protob_t<Query> q,
                              Response *response_out,
                              context_t *query2_context) {
@@ -73,9 +104,20 @@ bool query2_server_t::handle(ql::protob_t<Query> q,
          noreply->as_bool());
     try {
         scoped_ops_running_stat_t stat(&ctx->ql_ops_running);
+        scoped_latency_stat_t latency(latency_histogram(ctx, q->type()));
+        // Only new queries wait in line; the ones that continue or stop a cursor
+        // finish what's already been let in.
+        ql::query_admission_t::acq_t admission_acq;
+        if (q->type() == Query::START
+            && !admission_acq.enter(admission.get(), interruptor)) {
+            ql::fill_error(response_out, Response::RUNTIME_ERROR,
+                           "Server overloaded.  Try the query again later.");
+            return response_needed;
+        }
         guarantee(ctx->directory_read_manager);
         // `ql::run` will set the status code
-        ql::run(q, ctx, interruptor, response_out, stream_cache2);
+        ql::run(q, ctx, interruptor, response_out, stream_cache2,
+                &query2_context->insert_streams, &query2_context->term_cache);
     } catch (const ql::exc_t &e) {
         fill_error(response_out, Response::COMPILE_ERROR, e.what(), e.backtrace());
     } catch (const ql::datum_exc_t &e) {
@@ -98,3 +140,8 @@ void make_empty_protob_bearer(ql::protob_t<Query> *request) {
 Query *underlying_protob_value(ql::protob_t<Query> *request) {
     return request->get();
 }
+
+bool is_barrier_request(ql::protob_t<Query> *request) {
+    // NOREPLY_WAIT promises that the queries before it are done.
+    return (*request)->type() == Query::NOREPLY_WAIT;
+}
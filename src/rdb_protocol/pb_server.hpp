@@ -6,16 +6,21 @@
 #include <set>
 #include <string>
 
+#include "concurrency/one_per_thread.hpp"
 #include "protob/protob.hpp"
 #include "protocol_api.hpp"
+#include "rdb_protocol/insert_stream.hpp"
 #include "rdb_protocol/protocol.hpp"
+#include "rdb_protocol/query_admission.hpp"
 #include "rdb_protocol/stream_cache.hpp"
+#include "rdb_protocol/term_cache.hpp"
 
 namespace ql { template <class> class protob_t; }
 
 // Overloads used by protob_server_t.
 void make_empty_protob_bearer(ql::protob_t<Query> *request);
 Query *underlying_protob_value(ql::protob_t<Query> *request);
+bool is_barrier_request(ql::protob_t<Query> *request);
 
 class query2_server_t {
 public:
@@ -31,12 +36,16 @@ public:
         static const int32_t no_auth_magic_number = VersionDummy::V0_1;
         static const int32_t auth_magic_number = VersionDummy::V0_2;
         ql::stream_cache2_t stream_cache2;
+        ql::insert_stream_cache_t insert_streams;
+        ql::term_cache_t term_cache;
         signal_t *interruptor;
     };
 private:
     MUST_USE bool handle(ql::protob_t<Query> q,
                          Response *response_out,
                          context_t *query2_context);
+    // Declared before `server` so that it outlives the connections.
+    one_per_thread_t<ql::query_admission_t> admission;
     protob_server_t<ql::protob_t<Query>, Response, context_t> server;
     rdb_protocol_t::context_t *ctx;
     uuid_u parser_id;
@@ -43,6 +43,17 @@ stop_t::stop_t()
 
 RDB_IMPL_ME_SERIALIZABLE_1(stop_t, when_);
 
+cache_counts_t::cache_counts_t()
+    : blocks_acquired_(0), cache_misses_(0), disk_reads_(0), disk_bytes_read_(0) { }
+
+cache_counts_t::cache_counts_t(int64_t blocks_acquired, int64_t cache_misses,
+                               int64_t disk_reads, int64_t disk_bytes_read)
+    : blocks_acquired_(blocks_acquired), cache_misses_(cache_misses),
+      disk_reads_(disk_reads), disk_bytes_read_(disk_bytes_read) { }
+
+RDB_IMPL_ME_SERIALIZABLE_4(cache_counts_t, blocks_acquired_, cache_misses_,
+                           disk_reads_, disk_bytes_read_);
+
 counted_t<const ql::datum_t> construct_start(
         ticks_t duration, std::string &&description,
         counted_t<const ql::datum_t> sub_tasks) {
@@ -71,6 +82,21 @@ counted_t<const ql::datum_t> construct_sample(
     return make_counted<const ql::datum_t>(std::move(res));
 }
 
+counted_t<const ql::datum_t> construct_cache_counts(
+        const cache_counts_t &counts) {
+    std::map<std::string, counted_t<const ql::datum_t> > res;
+    res["description"] = make_counted<const ql::datum_t>("Buffer cache accesses.");
+    res["blocks_acquired"] = make_counted<const ql::datum_t>(
+        safe_to_double(counts.blocks_acquired_));
+    res["cache_misses"] = make_counted<const ql::datum_t>(
+        safe_to_double(counts.cache_misses_));
+    res["disk_reads"] = make_counted<const ql::datum_t>(
+        safe_to_double(counts.disk_reads_));
+    res["disk_bytes_read"] = make_counted<const ql::datum_t>(
+        safe_to_double(counts.disk_bytes_read_));
+    return make_counted<const ql::datum_t>(std::move(res));
+}
+
 counted_t<const ql::datum_t> construct_datum(
         event_log_t::iterator *begin,
         event_log_t::iterator end);
@@ -109,6 +135,10 @@ public:
     void operator()(const stop_t &) const {
         //Nothing to do here
     }
+    void operator()(const cache_counts_t &counts) const {
+        (*begin_)++;
+        res_->push_back(construct_cache_counts(counts));
+    }
 
 private:
     event_log_t::iterator *begin_;
@@ -143,6 +173,12 @@ public:
     void operator()(const stop_t &) const {
         logINF("Stop.\n");
     }
+    void operator()(const cache_counts_t &counts) const {
+        logINF("Cache counts: %" PRIi64 " blocks, %" PRIi64 " misses, %" PRIi64
+               " disk reads, %" PRIi64 " bytes.\n",
+               counts.blocks_acquired_, counts.cache_misses_, counts.disk_reads_,
+               counts.disk_bytes_read_);
+    }
 };
 
 void print_event_log(const event_log_t &event_log) {
@@ -274,6 +310,12 @@ void disabler_t::init(trace_t *parent) {
     }
 }
 
+void record_cache_counts(trace_t *parent, const cache_counts_t &counts) {
+    if (parent != NULL && !parent->disabled()) {
+        parent->event_log_target()->push_back(counts);
+    }
+}
+
 trace_t::trace_t()
     : redirected_event_log_(NULL), disabled_ref_count(0) { }
 
@@ -55,7 +55,20 @@ struct stop_t {
     RDB_DECLARE_ME_SERIALIZABLE;
 };
 
-typedef boost::variant<start_t, split_t, sample_t, stop_t> event_t;
+struct cache_counts_t {
+    cache_counts_t();
+    cache_counts_t(int64_t blocks_acquired, int64_t cache_misses,
+                   int64_t disk_reads, int64_t disk_bytes_read);
+
+    int64_t blocks_acquired_;
+    int64_t cache_misses_;
+    int64_t disk_reads_;
+    int64_t disk_bytes_read_;
+
+    RDB_DECLARE_ME_SERIALIZABLE;
+};
+
+typedef boost::variant<start_t, split_t, sample_t, stop_t, cache_counts_t> event_t;
 
 typedef std::vector<event_t> event_log_t;
 
@@ -71,6 +84,7 @@ private:
     friend class splitter_t;
     friend class sampler_t;
     friend class disabler_t;
+    friend void record_cache_counts(trace_t *parent, const cache_counts_t &counts);
     void start(const std::string &description);
     void stop();
     void start_split();
@@ -195,6 +209,19 @@ private:
     trace_t *parent_;
 };
 
+/* record_cache_counts records what a task cost the buffer cache, which the cache
+ * counts in a txn_profile_counters_t.  Example:
+ * {
+ *     starter_t starter("Perform read on shard.", trace);
+ *
+ *     Count the read's block acquisitions and perform it in here
+ *
+ *     record_cache_counts(trace, cache_counts_t(...));
+ * }
+ *
+ * This is used for reads and writes on the shards. */
+void record_cache_counts(trace_t *parent, const cache_counts_t &counts);
+
 void print_event_log(const event_log_t &event_log);
 
 }  // namespace profile
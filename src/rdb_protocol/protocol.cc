@@ -6,8 +6,10 @@
 
 #include "arch/io/disk.hpp"
 #include "btree/erase_range.hpp"
+#include "btree/operations.hpp"
 #include "btree/parallel_traversal.hpp"
 #include "btree/slice.hpp"
+#include "btree/subtree_eraser.hpp"
 #include "btree/superblock.hpp"
 #include "clustering/administration/metadata.hpp"
 #include "clustering/reactor/reactor.hpp"
@@ -16,11 +18,14 @@
 #include "concurrency/promise.hpp"
 #include "concurrency/wait_any.hpp"
 #include "containers/archive/archive.hpp"
+#include "containers/archive/varint.hpp"
 #include "containers/archive/vector_stream.hpp"
 #include "containers/disk_backed_queue.hpp"
 #include "protob/protob.hpp"
 #include "rdb_protocol/btree.hpp"
+#include "rdb_protocol/changefeed.hpp"
 #include "rdb_protocol/env.hpp"
+#include "rdb_protocol/export.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/shards.hpp"
 #include "rdb_protocol/minidriver.hpp"
@@ -43,6 +48,8 @@ typedef rdb_protocol_t::read_response_t read_response_t;
 
 typedef rdb_protocol_t::point_read_t point_read_t;
 typedef rdb_protocol_t::point_read_response_t point_read_response_t;
+typedef rdb_protocol_t::batched_point_read_t batched_point_read_t;
+typedef rdb_protocol_t::batched_point_read_response_t batched_point_read_response_t;
 
 typedef rdb_protocol_t::rget_read_t rget_read_t;
 typedef rdb_protocol_t::rget_read_response_t rget_read_response_t;
@@ -50,6 +57,15 @@ typedef rdb_protocol_t::rget_read_response_t rget_read_response_t;
 typedef rdb_protocol_t::distribution_read_t distribution_read_t;
 typedef rdb_protocol_t::distribution_read_response_t distribution_read_response_t;
 
+typedef rdb_protocol_t::sample_read_t sample_read_t;
+typedef rdb_protocol_t::sample_read_response_t sample_read_response_t;
+
+typedef rdb_protocol_t::changefeed_subscribe_t changefeed_subscribe_t;
+typedef rdb_protocol_t::changefeed_subscribe_response_t changefeed_subscribe_response_t;
+
+typedef rdb_protocol_t::export_read_t export_read_t;
+typedef rdb_protocol_t::export_read_response_t export_read_response_t;
+
 typedef rdb_protocol_t::sindex_list_t sindex_list_t;
 typedef rdb_protocol_t::sindex_list_response_t sindex_list_response_t;
 
@@ -77,6 +93,9 @@ typedef rdb_protocol_t::sindex_drop_response_t sindex_drop_response_t;
 typedef rdb_protocol_t::sync_t sync_t;
 typedef rdb_protocol_t::sync_response_t sync_response_t;
 
+typedef rdb_protocol_t::freeze_t freeze_t;
+typedef rdb_protocol_t::freeze_response_t freeze_response_t;
+
 typedef rdb_protocol_t::backfill_chunk_t backfill_chunk_t;
 
 typedef rdb_protocol_t::backfill_progress_t backfill_progress_t;
@@ -183,7 +202,8 @@ void bring_sindexes_up_to_date(
                 serializer_filepath_t(
                     store->base_path_,
                     "post_construction_" + uuid_to_str(post_construct_id)),
-                &store->perfmon_collection));
+                &store->perfmon_collection,
+                DISK_BACKED_QUEUE_MEMORY_LIMIT));
 
     {
         mutex_t::acq_t acq;
@@ -270,7 +290,8 @@ void post_construct_and_drain_queue(
                 &token_pair,
                 &queue_txn,
                 &queue_superblock,
-                lock.get_drain_signal());
+                lock.get_drain_signal(),
+                semaphore_priority_t::background);
 
             // Synchronization is guaranteed through the token_pair.
             // Let's get the information we need from the superblock and then
@@ -297,17 +318,17 @@ void post_construct_and_drain_queue(
             store->lock_sindex_queue(&queue_sindex_block, &acq);
 
             const int MAX_CHUNK_SIZE = 100;
-            int current_chunk_size = 0;
-            while (current_chunk_size < MAX_CHUNK_SIZE && mod_queue->size() > 0) {
-                rdb_sindex_change_t sindex_change;
-                deserializing_viewer_t<rdb_sindex_change_t> viewer(&sindex_change);
-                mod_queue->pop(&viewer);
-                boost::apply_visitor(apply_sindex_change_visitor_t(
-                                        &sindexes,
-                                        queue_txn.get(),
-                                        lock.get_drain_signal()),
-                                     sindex_change);
-                ++current_chunk_size;
+            if (mod_queue->size() > 0) {
+                std::vector<rdb_sindex_change_t> sindex_changes;
+                appending_viewer_t<rdb_sindex_change_t> viewer(&sindex_changes);
+                mod_queue->pop_many(&viewer, MAX_CHUNK_SIZE);
+                for (auto it = sindex_changes.begin(); it != sindex_changes.end(); ++it) {
+                    boost::apply_visitor(apply_sindex_change_visitor_t(
+                                            &sindexes,
+                                            queue_txn.get(),
+                                            lock.get_drain_signal()),
+                                         *it);
+                }
             }
 
             if (mod_queue->size() == 0) {
@@ -345,7 +366,8 @@ void post_construct_and_drain_queue(
             &token_pair,
             &queue_txn,
             &queue_superblock,
-            lock.get_drain_signal());
+            lock.get_drain_signal(),
+            semaphore_priority_t::background);
 
         // Synchronization is guaranteed through the token_pair.
         // Let's get the information we need from the superblock and then
@@ -364,6 +386,38 @@ void post_construct_and_drain_queue(
     }
 }
 
+/* Builds the primary btree's key filter when the store starts, and again whenever
+ * the table outgrows it, until the store goes away. */
+void maintain_primary_key_filter(
+        auto_drainer_t::lock_t lock,
+        btree_store_t<rdb_protocol_t> *store)
+    THROWS_NOTHING
+{
+    with_priority_t p(CORO_PRIORITY_SINDEX_CONSTRUCTION);
+    try {
+        for (;;) {
+            wait_interruptible(store->btree->key_filter.get_rebuild_wanted(),
+                               lock.get_drain_signal());
+            build_primary_key_filter(store, lock.get_drain_signal());
+        }
+    } catch (const interrupted_exc_t &) {
+        // Lookups just walk the tree until the store is loaded again.
+    }
+}
+
+/* Freezes the primary btree for a `freeze_t`.  If the store goes away first, the
+ * rest of the table just doesn't get frozen. */
+void freeze_primary_btree_in_background(
+        auto_drainer_t::lock_t lock,
+        btree_store_t<rdb_protocol_t> *store)
+    THROWS_NOTHING
+{
+    with_priority_t p(CORO_PRIORITY_SINDEX_CONSTRUCTION);
+    try {
+        freeze_primary_btree(store, lock.get_drain_signal());
+    } catch (const interrupted_exc_t &) {
+    }
+}
 
 bool range_key_tester_t::key_should_be_erased(const btree_key_t *key) {
     uint64_t h = hash_region_hasher(key->contents, key->size);
@@ -380,6 +434,8 @@ void add_status(const single_sindex_status_t &new_status,
     status_out->blocks_processed += new_status.blocks_processed;
     status_out->blocks_total += new_status.blocks_total;
     status_out->ready &= new_status.ready;
+    // Every shard has the same definition.
+    status_out->simple_field = new_status.simple_field;
 }
 
 }  // namespace rdb_protocol_details
@@ -390,8 +446,17 @@ rdb_protocol_t::context_t::context_t()
     cross_thread_database_watchables(get_num_threads()),
     directory_read_manager(NULL),
     signals(get_num_threads()),
+    io_backender(NULL),
+    slow_query_log(NULL),
+    mailbox_manager(NULL),
     ql_stats_membership(&get_global_perfmon_collection(), &ql_stats_collection, "query_language"),
-    ql_ops_running_membership(&ql_stats_collection, &ql_ops_running, "ops_running")
+    ql_ops_running_membership(&ql_stats_collection, &ql_ops_running, "ops_running"),
+    ql_latency_membership(&ql_stats_collection, &ql_latency_collection, "latency"),
+    ql_latency_memberships(&ql_latency_collection,
+                           &ql_start_latency, "start",
+                           &ql_continue_latency, "continue",
+                           &ql_stop_latency, "stop",
+                           &ql_noreply_wait_latency, "noreply_wait")
 { }
 
 rdb_protocol_t::context_t::context_t(
@@ -413,8 +478,17 @@ rdb_protocol_t::context_t::context_t(
       directory_read_manager(_directory_read_manager),
       signals(get_num_threads()),
       machine_id(_machine_id),
+      io_backender(NULL),
+      slow_query_log(NULL),
+      mailbox_manager(NULL),
       ql_stats_membership(global_stats, &ql_stats_collection, "query_language"),
-      ql_ops_running_membership(&ql_stats_collection, &ql_ops_running, "ops_running")
+      ql_ops_running_membership(&ql_stats_collection, &ql_ops_running, "ops_running"),
+      ql_latency_membership(&ql_stats_collection, &ql_latency_collection, "latency"),
+      ql_latency_memberships(&ql_latency_collection,
+                             &ql_start_latency, "start",
+                             &ql_continue_latency, "continue",
+                             &ql_stop_latency, "stop",
+                             &ql_noreply_wait_latency, "noreply_wait")
 {
     for (int thread = 0; thread < get_num_threads(); ++thread) {
         cross_thread_namespace_watchables[thread].init(new cross_thread_watchable_variable_t<cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > >(
@@ -465,12 +539,18 @@ store_key_t sindex_list_region_key() {
     return store_key_t();
 }
 
+region_t region_from_keys(const std::vector<store_key_t> &keys);
+
 /* read_t::get_region implementation */
 struct rdb_r_get_region_visitor : public boost::static_visitor<region_t> {
     region_t operator()(const point_read_t &pr) const {
         return rdb_protocol_t::monokey_region(pr.key);
     }
 
+    region_t operator()(const batched_point_read_t &bpr) const {
+        return region_from_keys(bpr.keys);
+    }
+
     region_t operator()(const rget_read_t &rg) const {
         return rg.region;
     }
@@ -479,6 +559,18 @@ struct rdb_r_get_region_visitor : public boost::static_visitor<region_t> {
         return dg.region;
     }
 
+    region_t operator()(const sample_read_t &sr) const {
+        return sr.region;
+    }
+
+    region_t operator()(const changefeed_subscribe_t &s) const {
+        return s.region;
+    }
+
+    region_t operator()(const export_read_t &er) const {
+        return er.region;
+    }
+
     region_t operator()(UNUSED const sindex_list_t &sl) const {
         return rdb_protocol_t::monokey_region(sindex_list_region_key());
     }
@@ -512,6 +604,21 @@ struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
         return keyed_read(pr, pr.key);
     }
 
+    bool operator()(const batched_point_read_t &bpr) const {
+        std::vector<store_key_t> shard_keys;
+        for (auto it = bpr.keys.begin(); it != bpr.keys.end(); ++it) {
+            if (region_contains_key(*region, *it)) {
+                shard_keys.push_back(*it);
+            }
+        }
+        if (!shard_keys.empty()) {
+            *read_out = read_t(batched_point_read_t(std::move(shard_keys)), profile);
+            return true;
+        } else {
+            return false;
+        }
+    }
+
     template <class T>
     bool rangey_read(const T &arg) const {
         const hash_region_t<key_range_t> intersection
@@ -530,7 +637,17 @@ struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
         bool do_read = rangey_read(rg);
         if (do_read) {
             auto rg_out = boost::get<rget_read_t>(&read_out->read);
-            rg_out->batchspec = rg_out->batchspec.scale_down(CPU_SHARDING_FACTOR);
+            // Tables don't all have CPU_SHARDING_FACTOR hash shards, so when the
+            // read is cut along the hash dimension we scale by how much of it is
+            // left.  Cuts along keys can't be measured, so they keep the old guess.
+            const uint64_t old_width = rg.region.end - rg.region.beg;
+            const uint64_t new_width = rg_out->region.end - rg_out->region.beg;
+            if (new_width < old_width) {
+                rg_out->batchspec = rg_out->batchspec.scale_down(
+                    std::max<uint64_t>(1, old_width / new_width));
+            } else if (!(rg_out->region == rg.region)) {
+                rg_out->batchspec = rg_out->batchspec.scale_down(CPU_SHARDING_FACTOR);
+            }
         }
         return do_read;
     }
@@ -539,6 +656,18 @@ struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
         return rangey_read(dg);
     }
 
+    bool operator()(const sample_read_t &sr) const {
+        return rangey_read(sr);
+    }
+
+    bool operator()(const changefeed_subscribe_t &s) const {
+        return rangey_read(s);
+    }
+
+    bool operator()(const export_read_t &er) const {
+        return rangey_read(er);
+    }
+
     bool operator()(const sindex_list_t &sl) const {
         return keyed_read(sl, sindex_list_region_key());
     }
@@ -571,8 +700,9 @@ public:
 };
 
 // Scale the distribution down by combining ranges to fit it within the limit of
-// the query
-void scale_down_distribution(size_t result_limit, std::map<store_key_t, int64_t> *key_counts) {
+// the query.  `byte_counts` is either empty or has the same keys as `key_counts`.
+void scale_down_distribution(size_t result_limit, std::map<store_key_t, int64_t> *key_counts,
+                             std::map<store_key_t, int64_t> *byte_counts) {
     guarantee(result_limit > 0);
     const size_t combine = (key_counts->size() / result_limit); // Combine this many other ranges into the previous range
     for (std::map<store_key_t, int64_t>::iterator it = key_counts->begin(); it != key_counts->end(); ) {
@@ -580,6 +710,10 @@ void scale_down_distribution(size_t result_limit, std::map<store_key_t, int64_t>
         ++next;
         for (size_t i = 0; i < combine && next != key_counts->end(); ++i) {
             it->second += next->second;
+            if (!byte_counts->empty()) {
+                (*byte_counts)[it->first] += (*byte_counts)[next->first];
+                byte_counts->erase(next->first);
+            }
             std::map<store_key_t, int64_t>::iterator tmp = next;
             ++next;
             key_counts->erase(tmp);
@@ -599,9 +733,13 @@ public:
           env(ctx, interruptor) { }
 
     void operator()(const point_read_t &);
+    void operator()(const batched_point_read_t &);
 
     void operator()(const rget_read_t &rg);
     void operator()(const distribution_read_t &rg);
+    void operator()(const sample_read_t &sr);
+    void operator()(const changefeed_subscribe_t &s);
+    void operator()(const export_read_t &er);
     void operator()(const sindex_list_t &rg);
     void operator()(const sindex_status_t &rg);
 
@@ -618,6 +756,20 @@ void rdb_r_unshard_visitor_t::operator()(const point_read_t &) {
     *response_out = responses[0];
 }
 
+void rdb_r_unshard_visitor_t::operator()(const batched_point_read_t &) {
+    response_out->response = batched_point_read_response_t();
+    auto out = boost::get<batched_point_read_response_t>(&response_out->response);
+    for (size_t i = 0; i < count; ++i) {
+        auto resp = boost::get<batched_point_read_response_t>(&responses[i].response);
+        guarantee(resp != NULL);
+        if (out->rows.empty()) {
+            out->rows.swap(resp->rows);
+        } else {
+            out->rows.insert(resp->rows.begin(), resp->rows.end());
+        }
+    }
+}
+
 void rdb_r_unshard_visitor_t::operator()(const rget_read_t &rg) {
     // Initialize response.
     response_out->response = rget_read_response_t();
@@ -632,6 +784,7 @@ void rdb_r_unshard_visitor_t::operator()(const rget_read_t &rg) {
     for (size_t i = 0; i < count; ++i) {
         auto resp = boost::get<rget_read_response_t>(&responses[i].response);
         guarantee(resp);
+        out->rows_scanned += resp->rows_scanned;
         if (resp->truncated) {
             out->truncated = true;
             if (best == NULL || key_le(resp->last_key, *best)) {
@@ -707,22 +860,97 @@ void rdb_r_unshard_visitor_t::operator()(const distribution_read_t &dg) {
                  ++mit) {
                 mit->second = static_cast<int64_t>(mit->second * scale_factor);
             }
+            for (auto mit = results[largest_index].byte_counts.begin();
+                 mit != results[largest_index].byte_counts.end();
+                 ++mit) {
+                mit->second = static_cast<int64_t>(mit->second * scale_factor);
+            }
 
             // TODO: move semantics.
             res.key_counts.insert(
                 results[largest_index].key_counts.begin(),
                 results[largest_index].key_counts.end());
+            res.byte_counts.insert(
+                results[largest_index].byte_counts.begin(),
+                results[largest_index].byte_counts.end());
         }
     }
 
     // If the result is larger than the requested limit, scale it down
     if (dg.result_limit > 0 && res.key_counts.size() > dg.result_limit) {
-        scale_down_distribution(dg.result_limit, &res.key_counts);
+        scale_down_distribution(dg.result_limit, &res.key_counts, &res.byte_counts);
     }
 
     response_out->response = res;
 }
 
+void rdb_r_unshard_visitor_t::operator()(const sample_read_t &sr) {
+    response_out->response = sample_read_response_t();
+    auto out = boost::get<sample_read_response_t>(&response_out->response);
+    std::vector<sample_read_response_t *> results(count);
+    // How many of each shard's rows haven't been picked yet.
+    std::vector<int64_t> remaining(count);
+    int64_t total_remaining = 0;
+    for (size_t i = 0; i < count; ++i) {
+        results[i] = boost::get<sample_read_response_t>(&responses[i].response);
+        guarantee(results[i] != NULL);
+        out->key_count += results[i]->key_count;
+        out->complete = out->complete && results[i]->complete;
+        remaining[i] = results[i]->key_count;
+        total_remaining += remaining[i];
+    }
+
+    // Each row is picked from a shard with probability proportional to how many
+    // rows it has left, and is the next row of that shard's sample, which makes
+    // it a uniformly random sample of all the rows.
+    std::vector<size_t> used(count, 0);
+    while (out->rows.size() < sr.sample_size && total_remaining > 0) {
+        int64_t pick = std::min<int64_t>(randdouble() * total_remaining,
+                                         total_remaining - 1);
+        size_t i = 0;
+        while (pick >= remaining[i]) {
+            pick -= remaining[i];
+            ++i;
+        }
+        if (used[i] < results[i]->rows.size()) {
+            out->rows.push_back(std::move(results[i]->rows[used[i]]));
+            ++used[i];
+            --remaining[i];
+            --total_remaining;
+        } else {
+            // The shard's sample is smaller than it should be.
+            total_remaining -= remaining[i];
+            remaining[i] = 0;
+        }
+    }
+}
+
+void rdb_r_unshard_visitor_t::operator()(UNUSED const changefeed_subscribe_t &s) {
+    response_out->response = changefeed_subscribe_response_t();
+    auto out = boost::get<changefeed_subscribe_response_t>(&response_out->response);
+    for (size_t i = 0; i < count; ++i) {
+        auto resp = boost::get<changefeed_subscribe_response_t>(&responses[i].response);
+        guarantee(resp != NULL);
+        out->server_addrs.insert(out->server_addrs.end(),
+                                 resp->server_addrs.begin(),
+                                 resp->server_addrs.end());
+    }
+}
+
+void rdb_r_unshard_visitor_t::operator()(UNUSED const export_read_t &er) {
+    response_out->response = export_read_response_t();
+    auto out = boost::get<export_read_response_t>(&response_out->response);
+    for (size_t i = 0; i < count; ++i) {
+        auto resp = boost::get<export_read_response_t>(&responses[i].response);
+        guarantee(resp != NULL);
+        out->files.insert(out->files.end(), resp->files.begin(), resp->files.end());
+        out->rows += resp->rows;
+        if (out->error.empty()) {
+            out->error = resp->error;
+        }
+    }
+}
+
 void rdb_r_unshard_visitor_t::operator()(UNUSED const sindex_list_t &sl) {
     guarantee(count == 1);
     guarantee(boost::get<sindex_list_response_t>(&responses[0].response));
@@ -733,7 +961,7 @@ void rdb_r_unshard_visitor_t::operator()(UNUSED const sindex_status_t &ss) {
     *response_out = read_response_t(sindex_status_response_t());
     auto ss_response = boost::get<sindex_status_response_t>(&response_out->response);
     for (size_t i = 0; i < count; ++i) {
-        auto resp = boost::get<sindex_status_response_t>(&responses[0].response);
+        auto resp = boost::get<sindex_status_response_t>(&responses[i].response);
         guarantee(resp != NULL);
         for (auto it = resp->statuses.begin(); it != resp->statuses.end(); ++it) {
             add_status(it->second, &ss_response->statuses[it->first]);
@@ -837,6 +1065,10 @@ struct rdb_w_get_region_visitor : public boost::static_visitor<region_t> {
     region_t operator()(const sync_t &s) const {
         return s.region;
     }
+
+    region_t operator()(const freeze_t &f) const {
+        return f.region;
+    }
 };
 
 #ifndef NDEBUG
@@ -943,6 +1175,10 @@ struct rdb_w_shard_visitor_t : public boost::static_visitor<bool> {
         return rangey_write(s);
     }
 
+    bool operator()(const freeze_t &f) const {
+        return rangey_write(f);
+    }
+
     const region_t *region;
     durability_requirement_t durability_requirement;
     profile_bool_t profile;
@@ -997,6 +1233,10 @@ struct rdb_w_unshard_visitor_t : public boost::static_visitor<void> {
         *response_out = responses[0];
     }
 
+    void operator()(const freeze_t &) const {
+        *response_out = responses[0];
+    }
+
     rdb_w_unshard_visitor_t(const write_response_t *_responses, size_t _count,
                             write_response_t *_response_out)
         : responses(_responses), count(_count), response_out(_response_out) { }
@@ -1049,8 +1289,17 @@ store_t::store_t(serializer_t *serializer,
                  const base_path_t &base_path) :
     btree_store_t<rdb_protocol_t>(serializer, perfmon_name, cache_target,
             create, parent_perfmon_collection, _ctx, io, base_path),
-    ctx(_ctx)
+    ctx(_ctx),
+    subtree_eraser_sizer(new value_sizer_t<rdb_value_t>(cache->get_block_size())),
+    subtree_eraser_deleter(new rdb_value_deleter_t()),
+    subtree_eraser(new background_subtree_eraser_t(cache.get(),
+                                                   subtree_eraser_sizer.get(),
+                                                   subtree_eraser_deleter.get()))
 {
+    if (ctx != NULL && ctx->mailbox_manager != NULL) {
+        changefeed_server_.init(new ql::changefeed::server_t(ctx->mailbox_manager));
+    }
+
     // Make sure to continue bringing sindexes up-to-date if it was interrupted earlier
 
     // This uses a dummy interruptor because this is the only thing using the store at
@@ -1085,12 +1334,36 @@ store_t::store_t(serializer_t *serializer,
         rdb_protocol_details::bring_sindexes_up_to_date(sindexes_to_update, this,
                                                         &sindex_block);
     }
+
+    coro_t::spawn_sometime(std::bind(
+            &rdb_protocol_details::maintain_primary_key_filter,
+            auto_drainer_t::lock_t(&drainer),
+            this));
 }
 
 store_t::~store_t() {
     assert_thread();
 }
 
+// The field `sindex`'s function gets, if the index isn't multi and that's all its
+// function does.  Empty otherwise.
+static std::string sindex_simple_field(const secondary_index_t &sindex) {
+    ql::map_wire_func_t mapping;
+    sindex_multi_bool_t multi = sindex_multi_bool_t::MULTI;
+    inplace_vector_read_stream_t read_stream(&sindex.opaque_definition);
+    archive_result_t success = deserialize(&read_stream, &mapping);
+    guarantee_deserialization(success, "sindex deserialize");
+    success = deserialize(&read_stream, &multi);
+    guarantee_deserialization(success, "sindex deserialize");
+
+    std::string field;
+    if (multi == sindex_multi_bool_t::SINGLE
+        && mapping.compile_wire_func()->is_get_field_of_arg(&field)) {
+        return field;
+    }
+    return std::string();
+}
+
 // TODO: get rid of this extra response_t copy on the stack
 struct rdb_read_visitor_t : public boost::static_visitor<void> {
     void operator()(const point_read_t &get) {
@@ -1100,6 +1373,13 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
         rdb_get(get.key, btree, superblock, res, ql_env.trace.get_or_null());
     }
 
+    void operator()(const batched_point_read_t &get) {
+        response->response = batched_point_read_response_t();
+        batched_point_read_response_t *res =
+            boost::get<batched_point_read_response_t>(&response->response);
+        rdb_get_batch(get.keys, btree, superblock, res, ql_env.trace.get_or_null());
+    }
+
     void operator()(const rget_read_t &rget) {
         if (rget.transforms.size() != 0 || rget.terminal) {
             rassert(rget.optargs.size() != 0);
@@ -1109,7 +1389,53 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
         rget_read_response_t *res =
             boost::get<rget_read_response_t>(&response->response);
 
-        if (!rget.sindex) {
+        if (!rget.use_result_cache) {
+            do_rget(rget, res);
+            return;
+        }
+
+        // Writes bump the version while they hold the superblock, so the result of
+        // reading what we see from here is the one for this version.
+        const std::string cache_key = result_cache_key(rget);
+        const uint64_t cache_version = result_cache->get_version();
+        if (const std::vector<char> *cached = result_cache->find(cache_key)) {
+            inplace_vector_read_stream_t stream(cached);
+            archive_result_t success = deserialize(&stream, res);
+            guarantee_deserialization(success, "cached rget response");
+            // The slow query log should only count the rows this read went through.
+            res->rows_scanned = 0;
+            return;
+        }
+
+        do_rget(rget, res);
+        if (!res->truncated && boost::get<ql::exc_t>(&res->result) == NULL) {
+            write_message_t wm;
+            wm << *res;
+            vector_stream_t stream;
+            stream.reserve(wm.size());
+            int write_res = send_write_message(&stream, &wm);
+            guarantee(write_res == 0);
+            result_cache->insert(cache_key, cache_version,
+                                 std::vector<char>(stream.vector()));
+        }
+    }
+
+    void do_rget(const rget_read_t &rget, rget_read_response_t *res) {
+        if (!rget.sindex && population_is_exact && rget.transforms.empty()
+            && rget.terminal
+            && boost::get<ql::count_wire_func_t>(&*rget.terminal) != NULL
+            && rget.region == store->get_region()) {
+            // An unfiltered count of everything in the store is the population
+            // in the stat block.
+            const int64_t population = get_btree_population(superblock);
+            rassert(population >= 0);
+            ql::grouped_t<uint64_t> counts;
+            if (population > 0) {
+                counts[counted_t<const ql::datum_t>()] = population;
+            }
+            res->result = std::move(counts);
+            res->last_key = key_max(rget.sorting);
+        } else if (!rget.sindex) {
             // Normal rget
             rdb_rget_slice(btree, rget.region.inner, superblock,
                            &ql_env, rget.batchspec, rget.transforms, rget.terminal,
@@ -1162,10 +1488,16 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
     void operator()(const distribution_read_t &dg) {
         response->response = distribution_read_response_t();
         distribution_read_response_t *res = boost::get<distribution_read_response_t>(&response->response);
-        rdb_distribution_get(dg.max_depth, dg.region.inner.left,
-                             superblock, res);
+        if (dg.sample_size > 0) {
+            rdb_distribution_sample(dg.sample_size, dg.region.inner.left,
+                                    superblock, res);
+        } else {
+            rdb_distribution_get(dg.max_depth, dg.region.inner.left,
+                                 superblock, res);
+        }
         for (std::map<store_key_t, int64_t>::iterator it = res->key_counts.begin(); it != res->key_counts.end(); ) {
             if (!dg.region.inner.contains_key(store_key_t(it->first))) {
+                res->byte_counts.erase(it->first);
                 std::map<store_key_t, int64_t>::iterator tmp = it;
                 ++it;
                 res->key_counts.erase(tmp);
@@ -1176,12 +1508,38 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
 
         // If the result is larger than the requested limit, scale it down
         if (dg.result_limit > 0 && res->key_counts.size() > dg.result_limit) {
-            scale_down_distribution(dg.result_limit, &res->key_counts);
+            scale_down_distribution(dg.result_limit, &res->key_counts,
+                                    &res->byte_counts);
         }
 
         res->region = dg.region;
     }
 
+    void operator()(const sample_read_t &sr) {
+        response->response = sample_read_response_t();
+        sample_read_response_t *res
+            = boost::get<sample_read_response_t>(&response->response);
+        rdb_sample(sr.sample_size, sr.region.inner, superblock, res);
+    }
+
+    void operator()(const changefeed_subscribe_t &s) {
+        response->response = changefeed_subscribe_response_t();
+        changefeed_subscribe_response_t *res
+            = boost::get<changefeed_subscribe_response_t>(&response->response);
+        // The feed gets the changes of the writes that come after this read.
+        if (changefeed_server != NULL) {
+            changefeed_server->add_client(s.addr);
+            res->server_addrs.push_back(changefeed_server->get_stop_addr());
+        }
+    }
+
+    void operator()(const export_read_t &er) {
+        response->response = export_read_response_t();
+        export_read_response_t *res
+            = boost::get<export_read_response_t>(&response->response);
+        rdb_export(er.region.inner, er.directory, superblock, &interruptor, res);
+    }
+
     void operator()(UNUSED const sindex_list_t &sinner) {
         response->response = sindex_list_response_t();
         sindex_list_response_t *res = &boost::get<sindex_list_response_t>(response->response);
@@ -1222,6 +1580,7 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
                 rdb_protocol_details::single_sindex_status_t *s =
                     &res->statuses[it->first];
                 s->ready = it->second.post_construction_complete;
+                s->simple_field = sindex_simple_field(it->second);
                 if (!s->ready) {
                     if (frac.estimate_of_total_nodes == -1) {
                         s->blocks_processed = 0;
@@ -1237,15 +1596,21 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
 
     rdb_read_visitor_t(btree_slice_t *_btree,
                        btree_store_t<rdb_protocol_t> *_store,
+                       result_cache_t *_result_cache,
+                       ql::changefeed::server_t *_changefeed_server,
                        superblock_t *_superblock,
                        rdb_protocol_t::context_t *ctx,
                        read_response_t *_response,
                        profile_bool_t profile,
+                       bool _population_is_exact,
                        signal_t *_interruptor) :
         response(_response),
         btree(_btree),
         store(_store),
+        result_cache(_result_cache),
+        changefeed_server(_changefeed_server),
         superblock(_superblock),
+        population_is_exact(_population_is_exact),
         interruptor(_interruptor, ctx->signals[get_thread_id().threadnum].get()),
         ql_env(ctx->extproc_pool,
                ctx->ns_repo,
@@ -1273,27 +1638,79 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
     }
 
 private:
+    // The key of the result of `rget` in a `result_cache_t`: all of it but the
+    // batchspec, which has the time the query started and doesn't change the result
+    // of a read that isn't truncated.
+    static std::string result_cache_key(const rget_read_t &rget) {
+        write_message_t wm;
+        wm << rget.region;
+        wm << rget.optargs;
+        wm << rget.transforms;
+        wm << rget.terminal;
+        wm << rget.sindex;
+        wm << rget.sorting;
+        vector_stream_t stream;
+        stream.reserve(wm.size());
+        int res = send_write_message(&stream, &wm);
+        guarantee(res == 0);
+        return std::string(stream.vector().begin(), stream.vector().end());
+    }
+
     read_response_t *response;
     btree_slice_t *btree;
     btree_store_t<rdb_protocol_t> *store;
+    result_cache_t *result_cache;
+    ql::changefeed::server_t *changefeed_server;
     superblock_t *superblock;
+    // False while subtrees that were unlinked from the btree are still being
+    // freed, because their keys are still counted in the stat block then.
+    bool population_is_exact;
     wait_any_t interruptor;
     ql::env_t ql_env;
 
     DISABLE_COPYING(rdb_read_visitor_t);
 };
 
+// Counts the block acquisitions of a profiled shard operation's transaction, and
+// records them in its trace when it's done.
+class scoped_cache_counting_t {
+public:
+    scoped_cache_counting_t(txn_t *_txn, profile::trace_t *_trace)
+        : txn(_trace != NULL ? _txn : NULL), trace(_trace) {
+        if (txn != NULL) {
+            txn->set_profile_counters(&counters);
+        }
+    }
+    ~scoped_cache_counting_t() {
+        if (txn != NULL) {
+            txn->set_profile_counters(NULL);
+            profile::record_cache_counts(
+                trace, profile::cache_counts_t(counters.blocks_acquired,
+                                               counters.cache_misses,
+                                               counters.disk_reads,
+                                               counters.disk_bytes_read));
+        }
+    }
+private:
+    txn_t *const txn;
+    profile::trace_t *const trace;
+    txn_profile_counters_t counters;
+    DISABLE_COPYING(scoped_cache_counting_t);
+};
+
 void store_t::protocol_read(const read_t &read,
                             read_response_t *response,
                             btree_slice_t *btree,
                             superblock_t *superblock,
                             signal_t *interruptor) {
     rdb_read_visitor_t v(
-        btree, this,
+        btree, this, &result_cache, changefeed_server_.get_or_null(),
         superblock,
-        ctx, response, read.profile, interruptor);
+        ctx, response, read.profile, subtree_eraser->is_idle(), interruptor);
     {
         profile::starter_t start_write("Perform read on shard.", v.get_env()->trace);
+        scoped_cache_counting_t counting(superblock->expose_buf().txn(),
+                                         v.get_env()->trace.get_or_null());
         boost::apply_visitor(v, read.read);
     }
 
@@ -1349,7 +1766,7 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
     void operator()(const batched_replace_t &br) {
         ql_env.global_optargs.init_optargs(br.optargs);
         rdb_modification_report_cb_t sindex_cb(
-            store, &sindex_block,
+            store, changefeed_server, &sindex_block,
             auto_drainer_t::lock_t(&store->drainer));
         func_replacer_t replacer(&ql_env, br.f, br.return_vals);
         response->response =
@@ -1363,6 +1780,7 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
     void operator()(const batched_insert_t &bi) {
         rdb_modification_report_cb_t sindex_cb(
             store,
+            changefeed_server,
             &sindex_block,
             auto_drainer_t::lock_t(&store->drainer));
         datum_replacer_t replacer(&bi.inserts, bi.upsert, bi.pkey, bi.return_vals);
@@ -1458,17 +1876,31 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
         // the superblock.)
     }
 
+    void operator()(const freeze_t &) {
+        response->response = freeze_response_t();
+
+        // The freeze takes a write transaction per internal node at the bottom of
+        // the tree, so it can't happen in this one.
+        coro_t::spawn_sometime(std::bind(
+                &rdb_protocol_details::freeze_primary_btree_in_background,
+                auto_drainer_t::lock_t(&store->drainer),
+                store));
+    }
+
 
     rdb_write_visitor_t(btree_slice_t *_btree,
                         btree_store_t<rdb_protocol_t> *_store,
+                        ql::changefeed::server_t *_changefeed_server,
                         txn_t *_txn,
                         scoped_ptr_t<superblock_t> *_superblock,
                         repli_timestamp_t _timestamp,
                         rdb_protocol_t::context_t *ctx,
                         write_response_t *_response,
+                        profile_bool_t profile,
                         signal_t *_interruptor) :
         btree(_btree),
         store(_store),
+        changefeed_server(_changefeed_server),
         txn(_txn),
         response(_response),
         superblock(_superblock),
@@ -1482,7 +1914,7 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
                NULL,
                &interruptor,
                ctx->machine_id,
-               ql::protob_t<Query>()) {
+               profile) {
         sindex_block =
             store->acquire_sindex_block_for_write((*superblock)->expose_buf(),
                                                   (*superblock)->get_sindex_block_id());
@@ -1512,12 +1944,23 @@ private:
         sindex_access_vector_t sindexes;
         store->acquire_post_constructed_sindex_superblocks_for_write(&sindex_block,
                                                                      &sindexes);
+        // The index superblocks are acquired in line now, so the next write can
+        // have the sindex block while the change goes into the indexes.
+        acq.reset();
+        sindex_block.reset_buf_lock();
+
         rdb_live_deletion_context_t deletion_context;
         rdb_update_sindexes(sindexes, mod_report, txn, &deletion_context);
+
+        if (changefeed_server != NULL) {
+            changefeed_server->send_change(mod_report->info.deleted.first,
+                                           mod_report->info.added.first);
+        }
     }
 
     btree_slice_t *btree;
     btree_store_t<rdb_protocol_t> *store;
+    ql::changefeed::server_t *changefeed_server;
     txn_t *txn;
     write_response_t *response;
     scoped_ptr_t<superblock_t> *superblock;
@@ -1535,13 +1978,16 @@ void store_t::protocol_write(const write_t &write,
                              btree_slice_t *btree,
                              scoped_ptr_t<superblock_t> *superblock,
                              signal_t *interruptor) {
-    rdb_write_visitor_t v(btree, this,
+    result_cache.note_modification();
+    rdb_write_visitor_t v(btree, this, changefeed_server_.get_or_null(),
                           (*superblock)->expose_buf().txn(),
                           superblock,
                           timestamp.to_repli_timestamp(), ctx,
-                          response, interruptor);
+                          response, write.profile, interruptor);
     {
         profile::starter_t start_write("Perform write on shard.", v.get_env()->trace);
+        scoped_cache_counting_t counting((*superblock)->expose_buf().txn(),
+                                         v.get_env()->trace.get_or_null());
         boost::apply_visitor(v, write.write);
     }
 
@@ -1792,6 +2238,7 @@ void store_t::protocol_receive_backfill(btree_slice_t *btree,
                                         const backfill_chunk_t &chunk) {
     scoped_ptr_t<superblock_t> superblock(std::move(_superblock));
     with_priority_t p(CORO_PRIORITY_BACKFILL_RECEIVER);
+    result_cache.note_modification();
     rdb_receive_backfill_visitor_t v(this, btree,
                                      superblock->expose_buf().txn(),
                                      std::move(superblock),
@@ -1804,6 +2251,7 @@ void store_t::protocol_reset_data(const region_t& subregion,
                                   superblock_t *superblock,
                                   signal_t *interruptor) {
     with_priority_t p(CORO_PRIORITY_RESET_DATA);
+    result_cache.note_modification();
     value_sizer_t<rdb_value_t> sizer(btree->cache()->get_block_size());
 
     always_true_key_tester_t key_tester;
@@ -1813,6 +2261,7 @@ void store_t::protocol_reset_data(const region_t& subregion,
     rdb_erase_major_range(&key_tester, subregion.inner,
                           &sindex_block,
                           superblock, this,
+                          subtree_eraser.get(),
                           interruptor);
 }
 
@@ -1831,20 +2280,34 @@ region_t rdb_protocol_t::cpu_sharding_subspace(int subregion_number,
     return region_t(beg, end, key_range_t::universe());
 }
 
-RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_details::single_sindex_status_t,
-                           blocks_total, blocks_processed, ready);
+region_t rdb_protocol_t::backfill_subspace(int piece_number, int num_pieces) {
+    // Most primary keys are strings, which `datum_t::print_primary` starts with "S".
+    return region_t(0, HASH_REGION_HASH_SIZE,
+                    printable_key_subrange("S", piece_number, num_pieces));
+}
+
+RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_details::single_sindex_status_t,
+                           blocks_total, blocks_processed, ready, simple_field);
 
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::point_read_response_t, data);
-RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_t::rget_read_response_t,
-                           result, key_range, truncated, last_key);
-RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::distribution_read_response_t,
-                           region, key_counts);
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::batched_point_read_response_t, rows);
+RDB_IMPL_ME_SERIALIZABLE_5(rdb_protocol_t::rget_read_response_t,
+                           result, key_range, truncated, last_key, rows_scanned);
+RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::distribution_read_response_t,
+                           region, key_counts, byte_counts);
+RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::sample_read_response_t,
+                           key_count, rows, complete);
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::changefeed_subscribe_response_t,
+                           server_addrs);
+RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::export_read_response_t,
+                           files, rows, error);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::sindex_list_response_t, sindexes);
 RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::read_response_t,
                            response, event_log, n_shards);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::sindex_status_response_t, statuses);
 
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::point_read_t, key);
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::batched_point_read_t, keys);
 RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::sindex_rangespec_t,
                            id, region, original_range);
 
@@ -1853,12 +2316,16 @@ ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(key_range_t::bound_t, int8_t,
 RDB_IMPL_ME_SERIALIZABLE_4(datum_range_t,
                            empty_ok(left_bound), empty_ok(right_bound),
                            left_bound_type, right_bound_type);
-RDB_IMPL_ME_SERIALIZABLE_7(rdb_protocol_t::rget_read_t,
+RDB_IMPL_ME_SERIALIZABLE_8(rdb_protocol_t::rget_read_t,
                            region, optargs, batchspec,
-                           transforms, terminal, sindex, sorting);
-
-RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::distribution_read_t,
-                           max_depth, result_limit, region);
+                           transforms, terminal, sindex, sorting,
+                           use_result_cache);
+
+RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_t::distribution_read_t,
+                           max_depth, result_limit, sample_size, region);
+RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::sample_read_t, sample_size, region);
+RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::changefeed_subscribe_t, addr, region);
+RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::export_read_t, directory, region);
 RDB_IMPL_ME_SERIALIZABLE_0(rdb_protocol_t::sindex_list_t);
 RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::sindex_status_t, sindexes, region);
 RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::read_t, read, profile);
@@ -1868,6 +2335,7 @@ RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::point_delete_response_t, result);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::sindex_create_response_t, success);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::sindex_drop_response_t, success);
 RDB_IMPL_ME_SERIALIZABLE_0(rdb_protocol_t::sync_response_t);
+RDB_IMPL_ME_SERIALIZABLE_0(rdb_protocol_t::freeze_response_t);
 
 RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::write_response_t, response, event_log, n_shards);
 
@@ -1882,6 +2350,7 @@ RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::point_delete_t, key);
 RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_t::sindex_create_t, id, mapping, region, multi);
 RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::sindex_drop_t, id, region);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::sync_t, region);
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::freeze_t, region);
 
 RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::write_t,
                            write, durability_requirement, profile);
@@ -1889,8 +2358,118 @@ RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::backfill_chunk_t::delete_key_t, key);
 
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::backfill_chunk_t::delete_range_t, range);
 
-RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::backfill_chunk_t::key_value_pairs_t,
-                           backfill_atoms);
+// The atoms of a chunk come from one leaf in key order, so each key is sent as the
+// length of the prefix it shares with the key before and the rest of it, and each
+// recency as how much later it is than the earliest one in the chunk.  The recencies
+// are all sent before the atoms.
+void rdb_protocol_t::backfill_chunk_t::key_value_pairs_t::rdb_serialize(
+        write_message_t &msg /* NOLINT */) const {
+    repli_timestamp_t earliest = repli_timestamp_t::invalid;
+    for (auto it = backfill_atoms.begin(); it != backfill_atoms.end(); ++it) {
+        earliest = std::min(earliest, it->recency);
+    }
+    serialize_varint_uint64(&msg, backfill_atoms.size());
+    msg << earliest;
+
+    // The size of the recencies, so that they can be read and decoded in one go.
+    uint64_t recencies_size = 0;
+    for (auto it = backfill_atoms.begin(); it != backfill_atoms.end(); ++it) {
+        recencies_size
+            += varint_uint64_serialized_size(it->recency.longtime - earliest.longtime);
+    }
+    serialize_varint_uint64(&msg, recencies_size);
+    for (auto it = backfill_atoms.begin(); it != backfill_atoms.end(); ++it) {
+        serialize_varint_uint64(&msg, it->recency.longtime - earliest.longtime);
+    }
+
+    const store_key_t *prev_key = NULL;
+    for (auto it = backfill_atoms.begin(); it != backfill_atoms.end(); ++it) {
+        int shared = 0;
+        if (prev_key != NULL) {
+            const int max_shared = std::min(prev_key->size(), it->key.size());
+            while (shared < max_shared
+                   && prev_key->contents()[shared] == it->key.contents()[shared]) {
+                ++shared;
+            }
+        }
+        const uint8_t shared_size = shared;
+        const uint8_t suffix_size = it->key.size() - shared;
+        msg << shared_size;
+        msg << suffix_size;
+        msg.append(it->key.contents() + shared, suffix_size);
+        msg << it->value;
+        prev_key = &it->key;
+    }
+}
+
+archive_result_t rdb_protocol_t::backfill_chunk_t::key_value_pairs_t::rdb_deserialize(
+        read_stream_t *s) {
+    uint64_t num_atoms;
+    archive_result_t res = deserialize_varint_uint64(s, &num_atoms);
+    if (bad(res)) { return res; }
+    repli_timestamp_t earliest;
+    res = deserialize(s, &earliest);
+    if (bad(res)) { return res; }
+
+    uint64_t recencies_size;
+    res = deserialize_varint_uint64(s, &recencies_size);
+    if (bad(res)) { return res; }
+    // Every varint is one to ten bytes.
+    if (recencies_size < num_atoms || recencies_size > 10 * num_atoms) {
+        return archive_result_t::RANGE_ERROR;
+    }
+    std::vector<char> recencies_buf(recencies_size);
+    int64_t num_read = force_read(s, recencies_buf.data(), recencies_size);
+    if (num_read == -1) {
+        return archive_result_t::SOCK_ERROR;
+    }
+    if (static_cast<uint64_t>(num_read) < recencies_size) {
+        return archive_result_t::SOCK_EOF;
+    }
+    std::vector<uint64_t> recency_deltas(num_atoms);
+    const char *p = recencies_buf.data();
+    const char *const end = p + recencies_size;
+    res = decode_varint_uint64s(&p, end, num_atoms, recency_deltas.data());
+    if (res == archive_result_t::SOCK_EOF || (!bad(res) && p != end)) {
+        return archive_result_t::RANGE_ERROR;
+    }
+    if (bad(res)) { return res; }
+
+    backfill_atoms.clear();
+    backfill_atoms.reserve(num_atoms);
+    for (uint64_t i = 0; i < num_atoms; ++i) {
+        rdb_protocol_details::backfill_atom_t atom;
+        uint8_t shared_size;
+        res = deserialize(s, &shared_size);
+        if (bad(res)) { return res; }
+        uint8_t suffix_size;
+        res = deserialize(s, &suffix_size);
+        if (bad(res)) { return res; }
+        if (shared_size + suffix_size > MAX_KEY_SIZE
+            || (i == 0 ? shared_size != 0
+                       : shared_size > backfill_atoms.back().key.size())) {
+            return archive_result_t::RANGE_ERROR;
+        }
+        atom.key.set_size(shared_size + suffix_size);
+        if (shared_size != 0) {
+            memcpy(atom.key.contents(), backfill_atoms.back().key.contents(),
+                   shared_size);
+        }
+        num_read = force_read(s, atom.key.contents() + shared_size, suffix_size);
+        if (num_read == -1) {
+            return archive_result_t::SOCK_ERROR;
+        }
+        if (num_read < suffix_size) {
+            return archive_result_t::SOCK_EOF;
+        }
+
+        res = deserialize(s, &atom.value);
+        if (bad(res)) { return res; }
+        atom.recency.longtime = earliest.longtime + recency_deltas[i];
+        backfill_atoms.push_back(std::move(atom));
+    }
+    return archive_result_t::SUCCESS;
+}
 
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::backfill_chunk_t::sindexes_t, sindexes);
 
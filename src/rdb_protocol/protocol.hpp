@@ -24,8 +24,11 @@
 #include "http/json/cJSON.hpp"
 #include "memcached/region.hpp"
 #include "protocol_api.hpp"
+#include "rdb_protocol/result_cache.hpp"
 #include "rdb_protocol/shards.hpp"
+#include "rpc/mailbox/typed.hpp"
 
+class background_subtree_eraser_t;
 class extproc_pool_t;
 class cluster_directory_metadata_t;
 template <class> class cow_ptr_t;
@@ -33,13 +36,29 @@ template <class> class cross_thread_watchable_variable_t;
 class cross_thread_signal_t;
 class databases_semilattice_metadata_t;
 template <class> class directory_read_manager_t;
+class mailbox_manager_t;
 template <class> class namespace_repo_t;
 template <class> class namespaces_semilattice_metadata_t;
 template <class> class semilattice_readwrite_view_t;
+class rdb_value_deleter_t;
+struct rdb_value_t;
+class slow_query_log_t;
 class traversal_progress_combiner_t;
+template <class> class value_sizer_t;
 
 namespace unittest { struct make_sindex_read_t; }
 
+namespace ql {
+namespace changefeed {
+struct msg_t;
+class server_t;
+// Where a feed gets the changes of the shards it's subscribed to.
+typedef mailbox_addr_t<void(msg_t)> client_addr_t;
+// Where a feed unsubscribes from a shard (see `server_t`).
+typedef mailbox_addr_t<void(client_addr_t)> server_addr_t;
+}  // namespace changefeed
+}  // namespace ql
+
 enum class profile_bool_t {
     PROFILE,
     DONT_PROFILE
@@ -165,6 +184,9 @@ struct single_sindex_status_t {
           blocks_total(_blocks_total), ready(_ready) { }
     size_t blocks_processed, blocks_total;
     bool ready;
+    // If the index isn't multi and its function just gets a field of the row, that
+    // field.  Empty otherwise.
+    std::string simple_field;
 
     RDB_DECLARE_ME_SERIALIZABLE;
 };
@@ -228,10 +250,32 @@ struct rdb_protocol_t {
         scoped_array_t<scoped_ptr_t<cross_thread_signal_t> > signals;
         uuid_u machine_id;
 
+        // Where queries can spill temporary files (like the sorted runs of an
+        // unindexed `order_by` too big to sort in memory).  `io_backender` is NULL
+        // if there's no such place, as on proxies.
+        io_backender_t *io_backender;
+        boost::optional<base_path_t> temp_path;
+
+        // Where slow queries are logged, or NULL if they aren't.
+        slow_query_log_t *slow_query_log;
+
+        // For the changefeeds' mailboxes.  NULL if there's no cluster, in which
+        // case tables can't be subscribed to.
+        mailbox_manager_t *mailbox_manager;
+
         perfmon_collection_t ql_stats_collection;
         perfmon_membership_t ql_stats_membership;
         perfmon_counter_t ql_ops_running;
         perfmon_membership_t ql_ops_running_membership;
+
+        // How long the queries of each type took to answer.
+        perfmon_collection_t ql_latency_collection;
+        perfmon_membership_t ql_latency_membership;
+        perfmon_latency_histogram_t ql_start_latency;
+        perfmon_latency_histogram_t ql_continue_latency;
+        perfmon_latency_histogram_t ql_stop_latency;
+        perfmon_latency_histogram_t ql_noreply_wait_latency;
+        perfmon_multi_membership_t ql_latency_memberships;
     };
 
     struct point_read_response_t {
@@ -242,6 +286,12 @@ struct rdb_protocol_t {
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
+    struct batched_point_read_response_t {
+        // Only the keys that have rows.
+        std::map<store_key_t, counted_t<const ql::datum_t> > rows;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
     struct rget_read_response_t {
 
         class empty_t { RDB_MAKE_ME_SERIALIZABLE_0() };
@@ -250,13 +300,15 @@ struct rdb_protocol_t {
         ql::result_t result;
         bool truncated;
         store_key_t last_key;
+        // The rows the traversal read to get `result` (for the slow query log).
+        uint64_t rows_scanned;
 
-        rget_read_response_t() : truncated(false) { }
+        rget_read_response_t() : truncated(false), rows_scanned(0) { }
         rget_read_response_t(
             const key_range_t &_key_range, const ql::result_t &_result,
             bool _truncated, const store_key_t &_last_key)
             : key_range(_key_range), result(_result),
-              truncated(_truncated), last_key(_last_key) { }
+              truncated(_truncated), last_key(_last_key), rows_scanned(0) { }
 
         RDB_DECLARE_ME_SERIALIZABLE;
     };
@@ -270,6 +322,40 @@ struct rdb_protocol_t {
         // key_counts[kn] = the number of keys in [kn, right_key)
         region_t region;
         std::map<store_key_t, int64_t> key_counts;
+        // Estimates of the sizes of the same ranges in bytes.  Only filled in by
+        // sampling distribution reads.
+        std::map<store_key_t, int64_t> byte_counts;
+
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
+    struct sample_read_response_t {
+        sample_read_response_t() : key_count(0), complete(true) { }
+        // The number of rows the sample was taken from.
+        int64_t key_count;
+        // A uniformly random sample of them, in random order.
+        std::vector<counted_t<const ql::datum_t> > rows;
+        // False if a shard gave up before it had as many rows as it was asked for
+        // (or as it has).
+        bool complete;
+
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
+    struct changefeed_subscribe_response_t {
+        // The servers of the shards that the feed subscribed to.
+        std::vector<ql::changefeed::server_addr_t> server_addrs;
+
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
+    struct export_read_response_t {
+        export_read_response_t() : rows(0) { }
+        // The export files the shards wrote, on the servers that hold them.
+        std::vector<std::string> files;
+        uint64_t rows;
+        // The first error a shard ran into, or empty.
+        std::string error;
 
         RDB_DECLARE_ME_SERIALIZABLE;
     };
@@ -294,7 +380,11 @@ struct rdb_protocol_t {
                                rget_read_response_t,
                                distribution_read_response_t,
                                sindex_list_response_t,
-                               sindex_status_response_t> variant_t;
+                               sindex_status_response_t,
+                               batched_point_read_response_t,
+                               sample_read_response_t,
+                               changefeed_subscribe_response_t,
+                               export_read_response_t> variant_t;
         variant_t response;
         profile::event_log_t event_log;
         size_t n_shards;
@@ -316,6 +406,20 @@ struct rdb_protocol_t {
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
+    // Reads several rows by primary key.  Each shard looks up its keys in one walk
+    // down its btree.
+    class batched_point_read_t {
+    public:
+        batched_point_read_t() { }
+        // `_keys` has to be sorted and without duplicates.
+        explicit batched_point_read_t(std::vector<store_key_t> &&_keys)
+            : keys(std::move(_keys)) { }
+
+        std::vector<store_key_t> keys;
+
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
     struct sindex_rangespec_t {
         sindex_rangespec_t() { }
         sindex_rangespec_t(const std::string &_id,
@@ -335,7 +439,8 @@ struct rdb_protocol_t {
         typedef rdb_protocol_details::transform_variant_t transform_variant_t;
         typedef rdb_protocol_details::terminal_variant_t terminal_variant_t;
     public:
-        rget_read_t() : batchspec(ql::batchspec_t::empty()) { }
+        rget_read_t()
+            : batchspec(ql::batchspec_t::empty()), use_result_cache(false) { }
 
         rget_read_t(const region_t &_region,
                     const std::map<std::string, ql::wire_func_t> &_optargs,
@@ -350,7 +455,8 @@ struct rdb_protocol_t {
               transforms(_transforms),
               terminal(std::move(_terminal)),
               sindex(std::move(_sindex)),
-              sorting(_sorting) { }
+              sorting(_sorting),
+              use_result_cache(false) { }
 
         region_t region; // We need this even for sindex reads due to sharding.
         std::map<std::string, ql::wire_func_t> optargs;
@@ -367,21 +473,74 @@ struct rdb_protocol_t {
 
         sorting_t sorting; // Optional sorting info (UNORDERED means no sorting).
 
+        // Whether the shards may answer with, and should remember, the result of
+        // the same read (see `result_cache_t`).  Only set for reads with a
+        // terminal whose functions are all deterministic.
+        bool use_result_cache;
+
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
     class distribution_read_t {
     public:
         distribution_read_t()
-            : max_depth(0), result_limit(0), region(region_t::universe())
+            : max_depth(0), result_limit(0), sample_size(0),
+              region(region_t::universe())
         { }
         distribution_read_t(int _max_depth, size_t _result_limit)
             : max_depth(_max_depth), result_limit(_result_limit),
-              region(region_t::universe())
+              sample_size(0), region(region_t::universe())
         { }
 
         int max_depth;
         size_t result_limit;
+        // If nonzero, each shard bases its distribution on this many keys sampled
+        // uniformly from all of its leaves (and also estimates byte counts),
+        // rather than on the keys in the nodes `max_depth` levels down.
+        size_t sample_size;
+        region_t region;
+
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
+    // Takes a random sample of up to `sample_size` rows.  Each shard walks down its
+    // btree to random rows (see `get_btree_random_sample()`) instead of reading
+    // them all.
+    class sample_read_t {
+    public:
+        sample_read_t() : sample_size(0), region(region_t::universe()) { }
+        explicit sample_read_t(size_t _sample_size)
+            : sample_size(_sample_size), region(region_t::universe()) { }
+
+        size_t sample_size;
+        region_t region;
+
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
+    // Subscribes the feed at `addr` to the changes that the writes to the shards
+    // make from now on (see `ql::changefeed::server_t`).
+    class changefeed_subscribe_t {
+    public:
+        changefeed_subscribe_t() : region(region_t::universe()) { }
+        explicit changefeed_subscribe_t(const ql::changefeed::client_addr_t &_addr)
+            : addr(_addr), region(region_t::universe()) { }
+
+        ql::changefeed::client_addr_t addr;
+        region_t region;
+
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
+    // Makes each shard write its rows to an export file in `directory` on the
+    // server it's read from (see `rdb_export()`).
+    class export_read_t {
+    public:
+        export_read_t() : region(region_t::universe()) { }
+        explicit export_read_t(const std::string &_directory)
+            : directory(_directory), region(region_t::universe()) { }
+
+        std::string directory;
         region_t region;
 
         RDB_DECLARE_ME_SERIALIZABLE;
@@ -409,7 +568,11 @@ struct rdb_protocol_t {
                                rget_read_t,
                                distribution_read_t,
                                sindex_list_t,
-                               sindex_status_t> variant_t;
+                               sindex_status_t,
+                               batched_point_read_t,
+                               sample_read_t,
+                               changefeed_subscribe_t,
+                               export_read_t> variant_t;
         variant_t read;
         profile_bool_t profile;
 
@@ -428,8 +591,12 @@ struct rdb_protocol_t {
         read_t(const variant_t &r, profile_bool_t _profile)
             : read(r), profile(_profile) { }
 
-        // Only use snapshotting if we're doing a range get.
-        bool use_snapshot() const THROWS_NOTHING { return boost::get<rget_read_t>(&read); }
+        // Only use snapshotting if we're doing a range get (or a sample, which holds
+        // on to the root of the btree while it walks down from it, or an export).
+        bool use_snapshot() const THROWS_NOTHING {
+            return boost::get<rget_read_t>(&read) || boost::get<sample_read_t>(&read)
+                || boost::get<export_read_t>(&read);
+        }
 
         // Returns true if this read should be sent to every replica.
         bool all_read() const THROWS_NOTHING { return boost::get<sindex_status_t>(&read); }
@@ -477,6 +644,11 @@ struct rdb_protocol_t {
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
+    struct freeze_response_t {
+        // The freeze goes on in the background after this is sent.
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
     typedef counted_t<const ql::datum_t> batched_replace_response_t;
     struct write_response_t {
         boost::variant<batched_replace_response_t,
@@ -485,7 +657,8 @@ struct rdb_protocol_t {
                        point_delete_response_t,
                        sindex_create_response_t,
                        sindex_drop_response_t,
-                       sync_response_t> response;
+                       sync_response_t,
+                       freeze_response_t> response;
 
         profile::event_log_t event_log;
         size_t n_shards;
@@ -617,6 +790,22 @@ struct rdb_protocol_t {
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
+    /* Packs the table's rows into as few leaves as they fit in and drops the
+    leaves' timestamps and deletion history (see `freeze_btree_step()`), for tables
+    that are done being written to.  Reads go through the packed leaves like any
+    others, and writes to a frozen table work as usual, unpacking the leaves they
+    change. */
+    class freeze_t {
+    public:
+        freeze_t()
+            : region(region_t::universe())
+        { }
+
+        region_t region;
+
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
     struct write_t {
         boost::variant<batched_replace_t,
                        batched_insert_t,
@@ -624,7 +813,8 @@ struct rdb_protocol_t {
                        point_delete_t,
                        sindex_create_t,
                        sindex_drop_t,
-                       sync_t> write;
+                       sync_t,
+                       freeze_t> write;
 
         durability_requirement_t durability_requirement;
         profile_bool_t profile;
@@ -683,6 +873,10 @@ struct rdb_protocol_t {
                 durability_requirement_t durability,
                 profile_bool_t _profile)
             : write(c), durability_requirement(durability), profile(_profile) { }
+        write_t(const freeze_t &f,
+                durability_requirement_t durability,
+                profile_bool_t _profile)
+            : write(f), durability_requirement(durability), profile(_profile) { }
 
         RDB_DECLARE_ME_SERIALIZABLE;
     };
@@ -765,6 +959,15 @@ struct rdb_protocol_t {
                 const base_path_t &base_path);
         ~store_t();
 
+        // NULL if the context has no mailbox manager.
+        ql::changefeed::server_t *changefeed_server() {
+            return changefeed_server_.get_or_null();
+        }
+
+        // Aggregation results that the store's reads get to reuse until the next
+        // write.
+        result_cache_t result_cache;
+
     private:
         friend struct read_visitor_t;
         void protocol_read(const read_t &read,
@@ -800,9 +1003,21 @@ struct rdb_protocol_t {
                                  superblock_t *superblock,
                                  signal_t *interruptor);
         context_t *ctx;
+
+        // Frees the subtrees that `protocol_reset_data()` unlinks.  It's declared
+        // after the sizer and deleter it uses so that it gets destroyed first.
+        scoped_ptr_t<value_sizer_t<rdb_value_t> > subtree_eraser_sizer;
+        scoped_ptr_t<rdb_value_deleter_t> subtree_eraser_deleter;
+        scoped_ptr_t<background_subtree_eraser_t> subtree_eraser;
+
+        // Sends the changes of this store's writes to the feeds subscribed to it.
+        scoped_ptr_t<ql::changefeed::server_t> changefeed_server_;
     };
 
     static region_t cpu_sharding_subspace(int subregion_number, int num_cpu_shards);
+
+    // One of the key ranges that `backfillee()` backfills one at a time.
+    static region_t backfill_subspace(int piece_number, int num_pieces);
 };
 
 namespace rdb_protocol_details {
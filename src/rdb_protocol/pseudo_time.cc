@@ -294,6 +294,227 @@ std::string iso8601(const std::string &s, const std::string &default_tz, date_fo
 
 } // namespace sanitize
 
+// The fast paths below handle the overwhelmingly common case -- a time whose
+// timezone is already sanitized and whose date is in the range boost supports --
+// with plain integer arithmetic, and fall back to boost for everything else so
+// that errors stay exactly the same.  Building a `posix_time_zone` and a
+// `local_date_time` for every row was most of the cost of `year()`, `date()`
+// and friends over big tables.
+
+const std::string epoch_time_field(epoch_time_key);
+const std::string timezone_field(timezone_key);
+
+const int64_t usec_per_sec = 1000000;
+const int64_t secs_per_day = 24 * 60 * 60;
+const int64_t usec_per_day = secs_per_day * usec_per_sec;
+
+// Boost's date range, and the offsets `posix_time_zone` accepts.
+const int min_boost_year = 1400;
+const int max_boost_year = 9999;
+const int64_t min_boost_offset = -12 * 60 * 60;
+const int64_t max_boost_offset = 14 * 60 * 60;
+
+// If `tz` is in the `[+-]HH:MM` form that `sanitize::tz` produces, sets
+// `*offset_out` to its offset from UTC in seconds and returns true.  Doesn't
+// allocate.
+bool parse_sanitized_tz(const char *tz, size_t size, int64_t *offset_out) {
+    if (size != 6 || (tz[0] != '+' && tz[0] != '-') || tz[3] != ':') {
+        return false;
+    }
+    // These also check that the characters are digits.
+    if (!sanitize::hours_valid(tz[1], tz[2]) || !sanitize::minutes_valid(tz[4], tz[5])) {
+        return false;
+    }
+    int64_t offset = ((tz[1] - '0') * 10 + (tz[2] - '0')) * 3600
+        + ((tz[4] - '0') * 10 + (tz[5] - '0')) * 60;
+    if (tz[0] == '-') {
+        if (offset == 0) {
+            // `-00:00` is not a valid time offset.
+            return false;
+        }
+        offset = -offset;
+    }
+    *offset_out = offset;
+    return true;
+}
+
+bool parse_sanitized_tz(const wire_string_t &tz, int64_t *offset_out) {
+    return parse_sanitized_tz(tz.data(), tz.size(), offset_out);
+}
+
+// Days since 1970-01-01 of a date in the proleptic Gregorian calendar, and back.
+// (These are Howard Hinnant's `days_from_civil` and `civil_from_days`.)
+int64_t days_from_civil(int64_t y, int64_t m, int64_t d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const int64_t yoe = y - era * 400;
+    const int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+void civil_from_days(int64_t days, int *y_out, int *m_out, int *d_out) {
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const int64_t doe = days - era * 146097;
+    const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const int64_t mp = (5 * doy + 2) / 153;
+    *d_out = doy - (153 * mp + 2) / 5 + 1;
+    *m_out = mp + (mp < 10 ? 3 : -9);
+    *y_out = yoe + era * 400 + (*m_out <= 2);
+}
+
+bool is_leap_year(int y) {
+    return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+}
+
+int days_in_month(int y, int m) {
+    static const int days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    return (m == 2 && is_leap_year(y)) ? 29 : days[m - 1];
+}
+
+int64_t floor_div(int64_t x, int64_t y) {
+    return x / y - (x % y != 0 && (x < 0) != (y < 0));
+}
+
+bool days_in_boost_range(int64_t days) {
+    return days_from_civil(min_boost_year, 1, 1) <= days
+        && days <= days_from_civil(max_boost_year, 12, 31);
+}
+
+// A time broken down the way `time_to_boost(time).local_time()` would.
+struct civil_time_t {
+    // Microseconds since the epoch, in UTC.
+    int64_t utc_usec;
+    // Days since the epoch, and microseconds since midnight, in the time's zone.
+    int64_t local_days;
+    int64_t local_usec_of_day;
+    int year, month, day;
+};
+
+// Fills in `*out` and returns true unless `time` needs the slow path.
+bool time_to_civil(const datum_t &time, civil_time_t *out) {
+    const datum_object_t &obj = time.as_object();
+    auto epoch_it = obj.find(epoch_time_field);
+    auto tz_it = obj.find(timezone_field);
+    if (epoch_it == obj.end() || tz_it == obj.end()
+        || epoch_it->second->get_type() != datum_t::R_NUM
+        || tz_it->second->get_type() != datum_t::R_STR) {
+        return false;
+    }
+
+    int64_t offset;
+    if (!parse_sanitized_tz(tz_it->second->as_str(), &offset)
+        || offset < min_boost_offset || offset > max_boost_offset) {
+        return false;
+    }
+
+    double raw_sec = epoch_it->second->as_num();
+    // Past about 30000 years the microsecond count could overflow; boost can't
+    // represent those dates anyway.  (This also rejects NaN.)
+    if (!(fabs(raw_sec) < 1e12)) {
+        return false;
+    }
+    // Split the seconds exactly the way `add_seconds_to_ptime` does, so we round
+    // the same way.
+    int64_t sec = raw_sec;
+    int64_t microsec = (raw_sec * 1000000.0) - (sec * 1000000);
+    out->utc_usec = sec * usec_per_sec + microsec;
+
+    int64_t local_usec = out->utc_usec + offset * usec_per_sec;
+    out->local_days = floor_div(local_usec, usec_per_day);
+    out->local_usec_of_day = local_usec - out->local_days * usec_per_day;
+    if (!days_in_boost_range(out->local_days)
+        || !days_in_boost_range(floor_div(out->utc_usec, usec_per_day))) {
+        return false;
+    }
+    civil_from_days(out->local_days, &out->year, &out->month, &out->day);
+    return true;
+}
+
+// Parses the output of `sanitize::iso8601` without boost.  Returns false if the
+// string needs the slow path (which will either parse it or produce the error).
+bool sanitized_iso8601_to_epoch(const std::string &s, date_format_t df,
+                                double *epoch_out, std::string *tz_out) {
+    // YYYY-MM-DDTHH:MM:SS.sss or YYYY-DDDTHH:MM:SS.sss, followed by the zone.
+    const size_t date_size = (df == MONTH_DAY) ? 10 : 8;
+    const size_t time_size = 12;
+    if ((df != MONTH_DAY && df != DAYCOUNT)
+        || s.size() < date_size + 1 + time_size) {
+        return false;
+    }
+    const char *p = s.data();
+    size_t pos = 0;
+    auto digits = [&](size_t n, int64_t *out) -> bool {
+        int64_t v = 0;
+        for (size_t i = 0; i < n; ++i, ++pos) {
+            if (p[pos] < '0' || p[pos] > '9') {
+                return false;
+            }
+            v = v * 10 + (p[pos] - '0');
+        }
+        *out = v;
+        return true;
+    };
+    auto literal = [&](char c) -> bool {
+        return p[pos++] == c;
+    };
+
+    int64_t year, month = 1, day = 1, day_of_year = 0;
+    if (!digits(4, &year) || !literal('-')) {
+        return false;
+    }
+    if (df == MONTH_DAY) {
+        if (!digits(2, &month) || !literal('-') || !digits(2, &day)) {
+            return false;
+        }
+    } else {
+        if (!digits(3, &day_of_year)) {
+            return false;
+        }
+    }
+    int64_t hours, minutes, seconds, millis;
+    if (!literal('T') || !digits(2, &hours) || !literal(':')
+        || !digits(2, &minutes) || !literal(':') || !digits(2, &seconds)
+        || !literal('.') || !digits(3, &millis)) {
+        return false;
+    }
+
+    if (year < min_boost_year || year > max_boost_year
+        || hours >= 24 || minutes >= 60 || seconds >= 60) {
+        return false;
+    }
+    int64_t days;
+    if (df == MONTH_DAY) {
+        if (month < 1 || month > 12 || day < 1 || day > days_in_month(year, month)) {
+            return false;
+        }
+        days = days_from_civil(year, month, day);
+    } else {
+        if (day_of_year < 1 || day_of_year > (is_leap_year(year) ? 366 : 365)) {
+            return false;
+        }
+        days = days_from_civil(year, 1, 1) + day_of_year - 1;
+    }
+
+    int64_t offset;
+    if (!parse_sanitized_tz(p + pos, s.size() - pos, &offset)
+        || offset < min_boost_offset || offset > max_boost_offset) {
+        return false;
+    }
+
+    int64_t utc_usec =
+        ((days * secs_per_day + hours * 3600 + minutes * 60 + seconds - offset)
+         * usec_per_sec) + millis * 1000;
+    if (!days_in_boost_range(floor_div(utc_usec, usec_per_day))) {
+        return false;
+    }
+    *epoch_out = utc_usec / 1000000.0;
+    tz_out->assign(p + pos, s.size() - pos);
+    return true;
+}
+
 bool tz_valid(const std::string &tz, std::string *tz_out = NULL) {
     try {
         std::string s = sanitize::tz(tz);
@@ -348,6 +569,12 @@ counted_t<const datum_t> iso8601_to_time(
             rfail_target(target, base_exc_t::GENERIC, "%s", e.what());
         }
 
+        double epoch_time;
+        std::string tz;
+        if (sanitized_iso8601_to_epoch(sanitized, df, &epoch_time, &tz)) {
+            return make_time(epoch_time, std::move(tz));
+        }
+
         std::istringstream ss(sanitized);
         ss.exceptions(std::ios_base::failbit);
         switch (df) {
@@ -446,10 +673,18 @@ counted_t<const datum_t> time_now() {
     } HANDLE_BOOST_ERRORS_NO_TARGET;
 }
 
+// Sorts call this a lot, so it looks the field up without building a
+// `std::string` or touching any reference counts.
+const datum_t &epoch_time_of(const datum_t &time) {
+    auto it = time.as_object().find(epoch_time_field);
+    r_sanity_check(it != time.as_object().end());
+    return *it->second;
+}
+
 int time_cmp(const datum_t &x, const datum_t &y) {
-    r_sanity_check(x.is_ptype(time_string));
-    r_sanity_check(y.is_ptype(time_string));
-    return x.get(epoch_time_key)->cmp(*y.get(epoch_time_key));
+    rassert(x.is_ptype(time_string));
+    rassert(y.is_ptype(time_string));
+    return epoch_time_of(x).cmp(epoch_time_of(y));
 }
 
 double sanitize_epoch_sec(double d) {
@@ -539,6 +774,11 @@ counted_t<const datum_t> time_in_tz(counted_t<const datum_t> t,
                                     counted_t<const datum_t> tz) {
     r_sanity_check(t->is_ptype(time_string));
     datum_ptr_t t2(t->as_object());
+    int64_t offset;
+    if (parse_sanitized_tz(tz->as_str(), &offset)) {
+        UNUSED bool b = t2.add(timezone_key, tz, CLOBBER);
+        return t2.to_counted();
+    }
     std::string raw_new_tzs = tz->as_str().to_std();
     std::string new_tzs = sanitize::tz(raw_new_tzs);
     if (raw_new_tzs == new_tzs) {
@@ -621,6 +861,30 @@ counted_t<const datum_t> time_sub(counted_t<const datum_t> time,
 }
 
 double time_portion(counted_t<const datum_t> time, time_component_t c) {
+    civil_time_t civil;
+    if (time_to_civil(*time, &civil)) {
+        switch (c) {
+        case YEAR: return civil.year;
+        case MONTH: return civil.month;
+        case DAY: return civil.day;
+        case DAY_OF_WEEK: {
+            // 1970-01-01 was a Thursday, which is day 4 counting from Monday as 1.
+            int64_t d = civil.local_days + 3;
+            return d - floor_div(d, 7) * 7 + 1;
+        } break;
+        case DAY_OF_YEAR:
+            return civil.local_days - days_from_civil(civil.year, 1, 1) + 1;
+        case HOURS: return civil.local_usec_of_day / (3600 * usec_per_sec);
+        case MINUTES: return (civil.local_usec_of_day / (60 * usec_per_sec)) % 60;
+        case SECONDS: {
+            double frac = modf(epoch_time_of(*time).as_num(), &frac);
+            frac = round(frac * 1000) / 1000;
+            return (civil.local_usec_of_day / usec_per_sec) % 60 + frac;
+        } break;
+        default: unreachable();
+        }
+    }
+
     try {
         ptime_t ptime = time_to_boost(time).local_time();
         switch (c) {
@@ -653,12 +917,32 @@ time_t boost_date(time_t boost_time) {
 
 counted_t<const datum_t> time_date(counted_t<const datum_t> time,
                                    const rcheckable_t *target) {
+    civil_time_t civil;
+    if (time_to_civil(*time, &civil)) {
+        // Like `boost_date`, this takes midnight of the local date as a UTC time.
+        datum_ptr_t res(time->as_object());
+        bool clobbered = res.add(
+            epoch_time_key,
+            make_counted<const datum_t>(
+                static_cast<double>(civil.local_days * secs_per_day)),
+            CLOBBER);
+        r_sanity_check(clobbered);
+        return res.to_counted();
+    }
+
     try {
         return boost_to_time(boost_date(time_to_boost(time)), target);
     } HANDLE_BOOST_ERRORS(target);
 }
 
 counted_t<const datum_t> time_of_day(counted_t<const datum_t> time) {
+    civil_time_t civil;
+    if (time_to_civil(*time, &civil)) {
+        double sec = (civil.utc_usec - civil.local_days * usec_per_day) / 1000000.0;
+        sec = round(sec * 1000) / 1000;
+        return make_counted<const datum_t>(sec);
+    }
+
     try {
         time_t boost_time = time_to_boost(time);
         double sec =
@@ -12,6 +12,7 @@ class datum_t;
 
 namespace pseudo {
 extern const char *const time_string;
+extern const char *const epoch_time_key;
 
 counted_t<const datum_t> iso8601_to_time(
     const std::string &s, const std::string &default_tz, const rcheckable_t *t);
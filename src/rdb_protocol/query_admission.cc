@@ -0,0 +1,144 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/query_admission.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "arch/timing.hpp"
+#include "concurrency/wait_any.hpp"
+#include "config/args.hpp"
+#include "perfmon/perfmon.hpp"
+
+namespace ql {
+
+static perfmon_collection_t pm_admission_collection;
+static perfmon_membership_t pm_admission_membership(
+    &get_global_perfmon_collection(), &pm_admission_collection, "query_admission");
+static perfmon_counter_t pm_queries_queued;
+static perfmon_latency_histogram_t pm_queue_wait;
+static perfmon_rate_monitor_t pm_queries_rejected(secs_to_ticks(1));
+// The sum of the threads' limits.
+static perfmon_counter_t pm_concurrency_limit;
+static perfmon_multi_membership_t pm_admission_memberships(
+    &pm_admission_collection,
+    &pm_queries_queued, "queued",
+    &pm_queue_wait, "queue_wait",
+    &pm_queries_rejected, "rejected",
+    &pm_concurrency_limit, "concurrency_limit");
+
+query_admission_t::query_admission_t(int64_t initial_limit, int64_t _queue_timeout_ms)
+    : queue_timeout_ms(_queue_timeout_ms), limit(0), running(0),
+      long_latency(0), short_latency(0) {
+    set_limit(initial_limit);
+}
+
+query_admission_t::~query_admission_t() {
+    assert_thread();
+    guarantee(running == 0);
+    guarantee(waiters.empty());
+    pm_concurrency_limit -= get_limit();
+}
+
+void query_admission_t::set_limit(double new_limit) {
+    const int64_t old_limit = get_limit();
+    limit = new_limit;
+    pm_concurrency_limit += get_limit() - old_limit;
+}
+
+void query_admission_t::pump() {
+    while (!waiters.empty() && running < get_limit()) {
+        acq_t *acq = waiters.head();
+        waiters.pop_front();
+        ++running;
+        acq->admitted.pulse();
+    }
+}
+
+void query_admission_t::on_done(ticks_t latency) {
+    const double sample = std::max<ticks_t>(latency, 1);
+    if (short_latency == 0) {
+        long_latency = short_latency = sample;
+        return;
+    }
+    short_latency += (sample - short_latency) / QL_ADMISSION_SHORT_SAMPLES;
+    long_latency += (sample - long_latency) / QL_ADMISSION_LONG_SAMPLES;
+    if (long_latency > 2 * short_latency) {
+        // Queries have got much faster (say, the overload is over), so stop holding
+        // the slow ones against the limit.
+        long_latency *= 0.95;
+    }
+
+    const double gradient = std::max(
+        0.5,
+        std::min(1.0, QL_ADMISSION_LATENCY_TOLERANCE * long_latency / short_latency));
+    if (gradient == 1.0 && 2 * running < get_limit()) {
+        // Nothing says more queries would be fine.
+        return;
+    }
+    const double target = limit * gradient + sqrt(limit);
+    set_limit(std::max<double>(QL_ADMISSION_MIN_LIMIT,
+                               std::min<double>(QL_ADMISSION_MAX_LIMIT,
+                                                0.8 * limit + 0.2 * target)));
+}
+
+query_admission_t::acq_t::acq_t() : parent(NULL), start(0) { }
+
+query_admission_t::acq_t::~acq_t() {
+    if (parent != NULL) {
+        parent->assert_thread();
+        rassert(parent->running > 0);
+        parent->on_done(get_ticks() - start);
+        --parent->running;
+        parent->pump();
+    }
+}
+
+bool query_admission_t::acq_t::enter(query_admission_t *admission,
+                                     signal_t *interruptor)
+    THROWS_ONLY(interrupted_exc_t) {
+    guarantee(parent == NULL);
+    admission->assert_thread();
+
+    if (admission->waiters.empty() && admission->running < admission->get_limit()) {
+        ++admission->running;
+    } else {
+        if (admission->get_queued() >= QL_ADMISSION_MAX_QUEUED) {
+            pm_queries_rejected.record();
+            return false;
+        }
+
+        const ticks_t arrived = get_ticks();
+        admission->waiters.push_back(this);
+        ++pm_queries_queued;
+        signal_timer_t timeout;
+        timeout.start(admission->queue_timeout_ms);
+        wait_any_t admitted_or_timeout(&admitted, &timeout);
+        try {
+            wait_interruptible(&admitted_or_timeout, interruptor);
+        } catch (const interrupted_exc_t &) {
+            --pm_queries_queued;
+            if (admitted.is_pulsed()) {
+                --admission->running;
+                admission->pump();
+            } else {
+                admission->waiters.remove(this);
+            }
+            throw;
+        }
+        --pm_queries_queued;
+        pm_queue_wait.record(get_ticks() - arrived);
+
+        if (!admitted.is_pulsed()) {
+            admission->waiters.remove(this);
+            pm_queries_rejected.record();
+            return false;
+        }
+    }
+
+    parent = admission;
+    start = get_ticks();
+    return true;
+}
+
+}  // namespace ql
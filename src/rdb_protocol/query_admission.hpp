@@ -0,0 +1,86 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_QUERY_ADMISSION_HPP_
+#define RDB_PROTOCOL_QUERY_ADMISSION_HPP_
+
+#include <stdint.h>
+
+#include "concurrency/cond_var.hpp"
+#include "concurrency/interruptor.hpp"
+#include "containers/intrusive_list.hpp"
+#include "threading.hpp"
+#include "time.hpp"
+
+namespace ql {
+
+/* Decides when the queries of one thread's client connections get to start, so that
+an overloaded server turns some queries away quickly instead of making all of them
+slow.  At most `get_limit()` queries run at once.  The others wait in line, and a
+query that finds the line full, or that waits in it for longer than the queue
+timeout, gets turned away.
+
+The limit follows the queries' latency.  After each query, it gets scaled by how
+long queries have taken in the long run over how long they've taken lately (times
+QL_ADMISSION_LATENCY_TOLERANCE, and by no less than one half), and then gets the
+square root of itself added so that a few queries can queue up.  So while queries
+take longer than usual the limit comes down, and otherwise it goes up, as long as
+the queries are using at least half of it.
+
+The "query_admission" stats show how many queries are waiting, how long they waited
+for, how many got turned away, and the limits of all the threads added up. */
+class query_admission_t : public home_thread_mixin_debug_only_t {
+public:
+    class acq_t;
+
+    query_admission_t(int64_t initial_limit, int64_t queue_timeout_ms);
+    ~query_admission_t();
+
+    int64_t get_limit() const { return static_cast<int64_t>(limit); }
+    int64_t get_running() const { return running; }
+    int64_t get_queued() const { return waiters.size(); }
+
+private:
+    void set_limit(double new_limit);
+    // Lets in the queries at the front of the line that fit under the limit.
+    void pump();
+    void on_done(ticks_t latency);
+
+    const int64_t queue_timeout_ms;
+
+    double limit;
+    int64_t running;
+    intrusive_list_t<acq_t> waiters;
+
+    // Moving averages of the queries' latency in ticks, over about
+    // QL_ADMISSION_LONG_SAMPLES and QL_ADMISSION_SHORT_SAMPLES queries.  Zero until
+    // the first query is done.
+    double long_latency, short_latency;
+
+    DISABLE_COPYING(query_admission_t);
+};
+
+// A query's turn to run.
+class query_admission_t::acq_t : public intrusive_list_node_t<acq_t> {
+public:
+    acq_t();
+    // Gives back the turn, if this has one.
+    ~acq_t();
+
+    // Waits in line for a turn.  Returns false, without one, if the query got
+    // turned away.
+    MUST_USE bool enter(query_admission_t *admission, signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t);
+
+private:
+    friend class query_admission_t;
+
+    // The admission whose turn this holds, or NULL.
+    query_admission_t *parent;
+    cond_t admitted;
+    ticks_t start;
+
+    DISABLE_COPYING(acq_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_QUERY_ADMISSION_HPP_
@@ -0,0 +1,64 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/query_memory.hpp"
+
+#include <inttypes.h>
+
+#include "config/args.hpp"
+#include "perfmon/perfmon.hpp"
+
+namespace ql {
+
+static perfmon_counter_t pm_query_memory;
+static perfmon_membership_t pm_query_memory_membership(
+    &get_global_perfmon_collection(), &pm_query_memory, "query_memory");
+
+// `used` of all the queries.  (The queries are on different threads.)
+static int64_t total_used = 0;
+
+query_memory_t::~query_memory_t() {
+    release(used);
+}
+
+bool query_memory_t::try_charge(int64_t bytes) {
+    rassert(bytes >= 0);
+    if (used + bytes > QUERY_MEMORY_LIMIT) {
+        return false;
+    }
+    if (__sync_add_and_fetch(&total_used, bytes) > GLOBAL_QUERY_MEMORY_LIMIT) {
+        __sync_fetch_and_sub(&total_used, bytes);
+        return false;
+    }
+    used += bytes;
+    pm_query_memory += bytes;
+    return true;
+}
+
+void query_memory_t::charge(int64_t bytes) THROWS_ONLY(datum_exc_t) {
+    if (try_charge(bytes)) {
+        return;
+    }
+    if (used + bytes > QUERY_MEMORY_LIMIT) {
+        throw datum_exc_t(
+            base_exc_t::GENERIC,
+            strprintf("Query uses more than the %" PRIi64 " bytes of memory that a "
+                      "query can use.", static_cast<int64_t>(QUERY_MEMORY_LIMIT)));
+    } else {
+        throw datum_exc_t(
+            base_exc_t::GENERIC,
+            strprintf("Query aborted because the server's queries are using more "
+                      "than %" PRIi64 " bytes of memory.",
+                      static_cast<int64_t>(GLOBAL_QUERY_MEMORY_LIMIT)));
+    }
+}
+
+void query_memory_t::release(int64_t bytes) {
+    rassert(bytes >= 0 && bytes <= used);
+    if (bytes == 0) {
+        return;
+    }
+    used -= bytes;
+    __sync_fetch_and_sub(&total_used, bytes);
+    pm_query_memory -= bytes;
+}
+
+}  // namespace ql
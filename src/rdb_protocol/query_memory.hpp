@@ -0,0 +1,42 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_QUERY_MEMORY_HPP_
+#define RDB_PROTOCOL_QUERY_MEMORY_HPP_
+
+#include <stdint.h>
+
+#include "errors.hpp"
+#include "rdb_protocol/error.hpp"
+
+namespace ql {
+
+/* Counts the memory that a query's intermediate results take up: the rows that
+`coerce_to('array')`, `group`, `distinct` and `orderBy` hold on to while they run.
+Rows are counted by their serialized size, which is close enough and doesn't need
+the allocator's help.  A query can't count more than QUERY_MEMORY_LIMIT bytes, nor
+all of the server's queries more than GLOBAL_QUERY_MEMORY_LIMIT; the "query_memory"
+stat is what they count now.
+
+Rows are counted until the query is over, even if it lets go of them earlier,
+unless whoever counted them says otherwise. */
+class query_memory_t {
+public:
+    query_memory_t() : used(0) { }
+    ~query_memory_t();
+
+    // Counts `bytes` more and returns true, unless that goes over a limit.
+    MUST_USE bool try_charge(int64_t bytes);
+    // Counts `bytes` more, or throws if that goes over a limit.
+    void charge(int64_t bytes) THROWS_ONLY(datum_exc_t);
+    void release(int64_t bytes);
+
+    int64_t get_used() const { return used; }
+
+private:
+    int64_t used;
+
+    DISABLE_COPYING(query_memory_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_QUERY_MEMORY_HPP_
@@ -0,0 +1,51 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/regex_cache.hpp"
+
+#include <re2/re2.h>
+
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+#include "config/args.hpp"
+#include "thread_local.hpp"
+#include "utils.hpp"
+
+namespace ql {
+
+struct regex_cache_t {
+    typedef std::list<std::pair<std::string, boost::shared_ptr<const RE2> > > lru_t;
+    // Most recently used first.
+    lru_t lru;
+    std::unordered_map<std::string, lru_t::iterator> index;
+};
+
+TLS_with_init(regex_cache_t *, regex_cache, NULL);
+
+boost::shared_ptr<const RE2> get_compiled_regex(const std::string &pattern) {
+    regex_cache_t *cache = TLS_get_regex_cache();
+    if (cache == NULL) {
+        cache = new regex_cache_t;
+        TLS_set_regex_cache(cache);
+    }
+
+    auto it = cache->index.find(pattern);
+    if (it != cache->index.end()) {
+        cache->lru.splice(cache->lru.begin(), cache->lru, it->second);
+        return it->second->second;
+    }
+
+    boost::shared_ptr<const RE2> regexp(new RE2(pattern.c_str()));
+    if (!regexp->ok()) {
+        return regexp;
+    }
+    if (cache->lru.size() >= REGEX_CACHE_SIZE) {
+        cache->index.erase(cache->lru.back().first);
+        cache->lru.pop_back();
+    }
+    cache->lru.push_front(std::make_pair(pattern, regexp));
+    cache->index.insert(std::make_pair(pattern, cache->lru.begin()));
+    return regexp;
+}
+
+}  // namespace ql
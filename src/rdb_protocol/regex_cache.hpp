@@ -0,0 +1,24 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_REGEX_CACHE_HPP_
+#define RDB_PROTOCOL_REGEX_CACHE_HPP_
+
+#include <string>
+
+#include "errors.hpp"
+#include <boost/shared_ptr.hpp>
+
+namespace re2 {
+class RE2;
+}  // namespace re2
+
+namespace ql {
+
+/* Returns `pattern` compiled, from this thread's cache of the REGEX_CACHE_SIZE
+patterns it compiled most recently, so that `match` over lots of rows compiles its
+pattern once rather than once per row.  Check `ok()` on the result; patterns that
+don't compile aren't cached. */
+boost::shared_ptr<const re2::RE2> get_compiled_regex(const std::string &pattern);
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_REGEX_CACHE_HPP_
@@ -0,0 +1,50 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/response_writer.hpp"
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/unknown_field_set.h>
+#include <google/protobuf/wire_format_lite.h>
+
+namespace ql {
+
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::internal::WireFormatLite;
+
+// The most bytes a 32-bit varint takes.
+static const size_t MAX_VARINT32_SIZE = 5;
+
+static void append_varint(uint32_t value, std::string *out) {
+    uint8_t buf[MAX_VARINT32_SIZE];
+    uint8_t *end = CodedOutputStream::WriteVarint32ToArray(value, buf);
+    out->append(reinterpret_cast<char *>(buf), end - buf);
+}
+
+response_writer_t::response_writer_t(Response *_res, use_json_t _use_json)
+    : res(_res), use_json(_use_json) { }
+
+void response_writer_t::add(const counted_t<const datum_t> &d) {
+    if (use_json == use_json_t::NO) {
+        d->write_to_protobuf(res->add_response(), use_json);
+        return;
+    }
+
+    json.clear();
+    d->write_json(&json);
+
+    // The message `Datum { type: R_JSON, r_str: json }`.
+    std::string *out = res->mutable_unknown_fields()->AddLengthDelimited(
+        Response::kResponseFieldNumber);
+    out->reserve(4 * MAX_VARINT32_SIZE + json.size());
+    append_varint(WireFormatLite::MakeTag(Datum::kTypeFieldNumber,
+                                          WireFormatLite::WIRETYPE_VARINT),
+                  out);
+    append_varint(Datum::R_JSON, out);
+    append_varint(WireFormatLite::MakeTag(Datum::kRStrFieldNumber,
+                                          WireFormatLite::WIRETYPE_LENGTH_DELIMITED),
+                  out);
+    guarantee(json.size() <= static_cast<size_t>(INT32_MAX));
+    append_varint(json.size(), out);
+    out->append(json);
+}
+
+}  // namespace ql
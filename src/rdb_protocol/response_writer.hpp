@@ -0,0 +1,36 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_RESPONSE_WRITER_HPP_
+#define RDB_PROTOCOL_RESPONSE_WRITER_HPP_
+
+#include <string>
+
+#include "containers/counted.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/ql2.pb.h"
+
+namespace ql {
+
+/* Adds the datums of a batch to `res->response()`.  For a client that accepts R_JSON
+datums, it writes the encoded `Datum` message of each one straight into the
+response's unknown fields, so the server never builds a `Datum` (or a cJSON tree)
+for it; protocol buffers serialize unknown fields with the others, so the client
+reads the same bytes either way.  Unknown fields come after the known ones, so all
+of a response's datums have to be added through the same writer. */
+class response_writer_t {
+public:
+    response_writer_t(Response *res, use_json_t use_json);
+
+    void add(const counted_t<const datum_t> &d);
+
+private:
+    Response *const res;
+    const use_json_t use_json;
+    // Reused for each datum's JSON.
+    std::string json;
+
+    DISABLE_COPYING(response_writer_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_RESPONSE_WRITER_HPP_
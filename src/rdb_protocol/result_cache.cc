@@ -0,0 +1,71 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/result_cache.hpp"
+
+#include "config/args.hpp"
+#include "perfmon/perfmon.hpp"
+
+static perfmon_collection_t pm_result_cache_collection;
+static perfmon_membership_t pm_result_cache_membership(
+    &get_global_perfmon_collection(), &pm_result_cache_collection, "result_cache");
+static perfmon_rate_monitor_t pm_result_cache_hits(secs_to_ticks(1));
+static perfmon_rate_monitor_t pm_result_cache_misses(secs_to_ticks(1));
+static perfmon_counter_t pm_result_cache_bytes;
+static perfmon_multi_membership_t pm_result_cache_memberships(
+    &pm_result_cache_collection,
+    &pm_result_cache_hits, "hits",
+    &pm_result_cache_misses, "misses",
+    &pm_result_cache_bytes, "bytes");
+
+result_cache_t::result_cache_t() : version(0), bytes(0) { }
+
+result_cache_t::~result_cache_t() {
+    assert_thread();
+    clear();
+}
+
+void result_cache_t::note_modification() {
+    assert_thread();
+    ++version;
+    clear();
+}
+
+const std::vector<char> *result_cache_t::find(const std::string &key) {
+    assert_thread();
+    auto it = index.find(key);
+    if (it == index.end()) {
+        pm_result_cache_misses.record();
+        return NULL;
+    }
+    pm_result_cache_hits.record();
+    entries.splice(entries.begin(), entries, it->second);
+    return &it->second->second;
+}
+
+void result_cache_t::insert(const std::string &key, uint64_t read_version,
+                            std::vector<char> &&result) {
+    assert_thread();
+    const size_t size = key.size() + result.size();
+    if (read_version != version || size > RESULT_CACHE_MAX_RESULT_BYTES
+        || index.find(key) != index.end()) {
+        return;
+    }
+    while (bytes + size > RESULT_CACHE_BYTES) {
+        const size_t evicted = entries.back().first.size()
+            + entries.back().second.size();
+        index.erase(entries.back().first);
+        entries.pop_back();
+        bytes -= evicted;
+        pm_result_cache_bytes -= evicted;
+    }
+    entries.push_front(std::make_pair(key, std::move(result)));
+    index[key] = entries.begin();
+    bytes += size;
+    pm_result_cache_bytes += size;
+}
+
+void result_cache_t::clear() {
+    pm_result_cache_bytes -= bytes;
+    bytes = 0;
+    index.clear();
+    entries.clear();
+}
@@ -0,0 +1,64 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_RESULT_CACHE_HPP_
+#define RDB_PROTOCOL_RESULT_CACHE_HPP_
+
+#include <stdint.h>
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "threading.hpp"
+
+/* Remembers the results of a store's aggregations (reads with a terminal, like
+`count` or `group(...).sum(...)`) for the queries that ask for it with the
+`result_cache` optarg of `table`, so that a dashboard that runs the same aggregation
+every few seconds against a table that rarely changes doesn't read the whole range
+every time.  Queries only ask for it if all their functions are deterministic.
+
+Results are kept serialized, under a key made of the serialized read (without its
+batchspec, which has the time the query started).  Every write to the store bumps
+the version (see `note_modification()`) and forgets all the results.  A read gets the
+version before it starts reading, and only gets its result remembered if the
+version is still the same once it's done, so a write that comes in while it's reading
+doesn't leave a stale result behind.
+
+Up to RESULT_CACHE_BYTES of keys and results are kept, and the least recently used
+ones make room for new ones.  The "result_cache" stats count the hits and misses of
+all the stores. */
+class result_cache_t : public home_thread_mixin_debug_only_t {
+public:
+    result_cache_t();
+    ~result_cache_t();
+
+    uint64_t get_version() const { return version; }
+    // Called for every write, while the writer holds the superblock.
+    void note_modification();
+
+    // Returns the result remembered for `key`, or NULL.  The pointer is good until
+    // the next call of a non-const method.
+    const std::vector<char> *find(const std::string &key);
+    // Remembers `result` for `key`, unless the store has been written to since
+    // `read_version` or the result is too big.
+    void insert(const std::string &key, uint64_t read_version,
+                std::vector<char> &&result);
+
+    size_t get_bytes() const { return bytes; }
+
+private:
+    typedef std::list<std::pair<std::string, std::vector<char> > > entries_t;
+
+    void clear();
+
+    uint64_t version;
+    // Most recently used first.
+    entries_t entries;
+    std::unordered_map<std::string, entries_t::iterator> index;
+    size_t bytes;
+
+    DISABLE_COPYING(result_cache_t);
+};
+
+#endif  // RDB_PROTOCOL_RESULT_CACHE_HPP_
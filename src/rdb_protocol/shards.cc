@@ -1,11 +1,17 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/shards.hpp"
 
+#include <algorithm>
+#include <map>
+
 #include "debug.hpp"
 #include "errors.hpp"
 #include <boost/variant.hpp>
 
+#include "concurrency/parallel_for.hpp"
+#include "config/args.hpp"
 #include "rdb_protocol/func.hpp"
+#include "rdb_protocol/pathspec.hpp"
 #include "rdb_protocol/profile.hpp"
 #include "rdb_protocol/protocol.hpp"
 
@@ -84,6 +90,7 @@ private:
         guarantee(acc.size() == 0);
     }
 
+protected:
     virtual void unshard(const store_key_t &last_key,
                          const std::vector<result_t *> &results) {
         guarantee(acc.size() == 0);
@@ -193,11 +200,15 @@ accumulator_t *make_append(const sorting_t &sorting, batcher_t *batcher) {
 // This can't be a normal terminal because it wouldn't preserve ordering.
 // (Also, I'm sorry for this absurd type hierarchy.)
 class to_array_t : public eager_acc_t {
+public:
+    explicit to_array_t(env_t *_env) : env(_env) { }
 private:
     virtual void operator()(groups_t *gs) {
         for (auto kv = gs->begin(); kv != gs->end(); ++kv) {
             datums_t *lst1 = &groups[kv->first];
             datums_t *lst2 = &kv->second;
+            charge(lst2->begin(), lst2->end(),
+                   [](const counted_t<const datum_t> &d) { return d; });
             lst1->reserve(lst1->size() + lst2->size());
             std::move(lst2->begin(), lst2->end(), std::back_inserter(*lst1));
         }
@@ -210,6 +221,8 @@ private:
         for (auto kv = streams->begin(); kv != streams->end(); ++kv) {
             datums_t *lst = &groups[kv->first];
             stream_t *stream = &kv->second;
+            charge(stream->begin(), stream->end(),
+                   [](const rget_item_t &item) { return item.data; });
             lst->reserve(lst->size() + stream->size());
             for (auto it = stream->begin(); it != stream->end(); ++it) {
                 lst->push_back(std::move(it->data));
@@ -235,11 +248,21 @@ private:
         }
     }
 
+    template<class It, class Get>
+    void charge(It begin, It end, const Get &get) {
+        int64_t bytes = 0;
+        for (It it = begin; it != end; ++it) {
+            bytes += serialized_size(get(*it));
+        }
+        env->memory.charge(bytes);
+    }
+
+    env_t *env;
     groups_t groups;
 };
 
-eager_acc_t *make_to_array() {
-    return new to_array_t();
+eager_acc_t *make_to_array(env_t *env) {
+    return new to_array_t(env);
 }
 
 template<class T>
@@ -247,6 +270,64 @@ class terminal_t : public grouped_acc_t<T>, public eager_acc_t {
 protected:
     explicit terminal_t(T &&t) : grouped_acc_t<T>(std::move(t)) { }
 private:
+    // Whether `unshard_impl(T *, T *)` can run on any thread, i.e. it doesn't call
+    // functions in the query's `env_t`.
+    virtual bool unshard_is_thread_safe() { return false; }
+
+    // Merges the results pairwise, with every round of merges spread over all
+    // the threads, when there are enough groups for that to pay off.
+    virtual void unshard(const store_key_t &last_key,
+                         const std::vector<result_t *> &results) {
+        std::vector<std::map<counted_t<const datum_t>, T> *> maps;
+        maps.reserve(results.size());
+        size_t num_groups = 0;
+        for (auto res = results.begin(); res != results.end(); ++res) {
+            guarantee(*res);
+            grouped_t<T> *gres = boost::get<grouped_t<T> >(*res);
+            guarantee(gres);
+            maps.push_back(gres->get_underlying_map());
+            num_groups += gres->size();
+        }
+        if (!unshard_is_thread_safe()
+            || num_groups < PARALLEL_UNSHARD_MIN_GROUPS
+            || get_num_threads() == 1) {
+            grouped_acc_t<T>::unshard(last_key, results);
+            return;
+        }
+
+        while (maps.size() > 1) {
+            parallel_map_across_threads(
+                maps.size() / 2,
+                [this, &maps](size_t i) {
+                    merge(maps[2 * i], maps[2 * i + 1]);
+                });
+            for (size_t i = 1; 2 * i < maps.size(); ++i) {
+                maps[i] = maps[2 * i];
+            }
+            maps.resize((maps.size() + 1) / 2);
+        }
+        grouped_t<T> *acc = grouped_acc_t<T>::get_acc();
+        guarantee(acc->size() == 0);
+        acc->get_underlying_map()->swap(*maps[0]);
+    }
+
+    // Merges `from` into `into`.  (Runs on any thread.)
+    void merge(std::map<counted_t<const datum_t>, T> *into,
+               std::map<counted_t<const datum_t>, T> *from) {
+        if (into->size() < from->size()) {
+            into->swap(*from);
+        }
+        for (auto kv = from->begin(); kv != from->end(); ++kv) {
+            auto it = into->find(kv->first);
+            if (it == into->end()) {
+                into->insert(it, std::move(*kv));
+            } else {
+                unshard_impl(&it->second, &kv->second);
+            }
+        }
+        from->clear();
+    }
+
     virtual void operator()(groups_t *groups) {
         grouped_t<T> *acc = grouped_acc_t<T>::get_acc();
         const T *default_val = grouped_acc_t<T>::get_default_val();
@@ -328,6 +409,7 @@ public:
         : terminal_t<uint64_t>(0) { }
 private:
     virtual bool uses_val() { return false; }
+    virtual bool unshard_is_thread_safe() { return true; }
     virtual bool accumulate(const counted_t<const datum_t> &, uint64_t *out) {
         *out += 1;
         return true;
@@ -340,6 +422,42 @@ private:
     }
 };
 
+// The distinct elements are found on each shard, so that duplicates don't have to
+// be sent back.  The result is sorted, like `distinct` of an array.
+class distinct_terminal_t : public terminal_t<datum_hash_set_t> {
+public:
+    distinct_terminal_t(env_t *_env, const distinct_wire_func_t &)
+        : terminal_t<datum_hash_set_t>(datum_hash_set_t()), env(_env) { }
+private:
+    virtual bool unshard_is_thread_safe() { return true; }
+    virtual bool accumulate(const counted_t<const datum_t> &el,
+                            datum_hash_set_t *out) {
+        if (out->insert(el).second) {
+            env->memory.charge(serialized_size(el));
+        }
+        return true;
+    }
+    virtual counted_t<const datum_t> unpack(datum_hash_set_t *ds) {
+        rcheck_datum(ds->size() <= array_size_limit(), base_exc_t::GENERIC,
+                     strprintf("Array over size limit `%zu`.",
+                               array_size_limit()));
+        std::vector<counted_t<const datum_t> > ret(ds->begin(), ds->end());
+        ds->clear();
+        std::sort(ret.begin(), ret.end(),
+                  [](const counted_t<const datum_t> &l,
+                     const counted_t<const datum_t> &r) {
+                      return *l < *r;
+                  });
+        return make_counted<const datum_t>(std::move(ret));
+    }
+    virtual void unshard_impl(datum_hash_set_t *out, datum_hash_set_t *el) {
+        out->insert(el->begin(), el->end());
+        el->clear();
+    }
+
+    env_t *env;
+};
+
 class acc_func_t {
 public:
     acc_func_t(const counted_t<func_t> &_f, env_t *_env) : f(_f), env(_env) { }
@@ -358,6 +476,7 @@ protected:
         : terminal_t<T>(std::move(t)),
           f(wf.compile_wire_func(), env),
           bt(wf.bt.get_bt()) { }
+    virtual bool unshard_is_thread_safe() { return true; }
     virtual bool accumulate(const counted_t<const datum_t> &el, T *out) {
         try {
             maybe_acc(el, out, f);
@@ -522,6 +641,111 @@ private:
     counted_t<func_t> f;
 };
 
+void keyed_row_t::rdb_serialize(write_message_t &msg) const {  // NOLINT
+    msg << key;
+    msg << row;
+}
+
+archive_result_t keyed_row_t::rdb_deserialize(read_stream_t *s) {
+    archive_result_t res = deserialize(s, &key);
+    if (bad(res)) { return res; }
+    return deserialize(s, &row);
+}
+
+counted_t<const datum_t> sort_key(env_t *env, const counted_t<func_t> &f,
+                                  const counted_t<const datum_t> &row) {
+    try {
+        return f->call(env, row)->as_datum();
+    } catch (const base_exc_t &e) {
+        if (e.get_type() != base_exc_t::NON_EXISTENCE) {
+            throw;
+        }
+    }
+    return counted_t<const datum_t>();
+}
+
+void append_sort_key(sort_direction_t direction,
+                     const counted_t<const datum_t> &val,
+                     std::string *out) {
+    const size_t start = out->size();
+    if (!val.has()) {
+        out->push_back(1);
+    } else {
+        out->push_back(2);
+        val->append_order_key(out);
+    }
+    // The bytes of one value are never a prefix of another's, so flipping them
+    // all reverses the order.
+    if (direction == sort_direction_t::DESC) {
+        for (size_t i = start; i < out->size(); ++i) {
+            (*out)[i] = ~(*out)[i];
+        }
+    }
+}
+
+// Keeps the first `n` rows in `order_by` order, so that an unindexed
+// `order_by(...).limit(n)` only has to hold (and send back from each shard) `n`
+// rows rather than all of them.
+class orderby_limit_terminal_t : public terminal_t<keyed_rows_t> {
+public:
+    orderby_limit_terminal_t(env_t *_env, const orderby_limit_wire_func_t &f)
+        : terminal_t<keyed_rows_t>(keyed_rows_t()),
+          env(_env),
+          funcs(f.compile_funcs()),
+          directions(f.get_directions()),
+          n(f.get_n()),
+          bt(f.get_bt()) { }
+private:
+    virtual bool unshard_is_thread_safe() { return true; }
+
+    virtual bool accumulate(const counted_t<const datum_t> &el, keyed_rows_t *out) {
+        std::string key;
+        try {
+            for (size_t i = 0; i < funcs.size(); ++i) {
+                append_sort_key(directions[i], sort_key(env, funcs[i], el), &key);
+            }
+        } catch (const datum_exc_t &e) {
+            throw exc_t(e, bt.get(), 1);
+        }
+        counted_t<const datum_t> row = el;
+        push(keyed_row_t(std::move(key), std::move(row)), out);
+        return true;
+    }
+    virtual counted_t<const datum_t> unpack(keyed_rows_t *rows) {
+        std::sort_heap(rows->begin(), rows->end());
+        std::vector<counted_t<const datum_t> > ret;
+        ret.reserve(rows->size());
+        for (auto it = rows->begin(); it != rows->end(); ++it) {
+            ret.push_back(std::move(it->row));
+        }
+        rows->clear();
+        return make_counted<const datum_t>(std::move(ret));
+    }
+    virtual void unshard_impl(keyed_rows_t *out, keyed_rows_t *el) {
+        for (auto it = el->begin(); it != el->end(); ++it) {
+            push(std::move(*it), out);
+        }
+        el->clear();
+    }
+
+    void push(keyed_row_t &&row, keyed_rows_t *heap) {
+        if (heap->size() < n) {
+            heap->push_back(std::move(row));
+            std::push_heap(heap->begin(), heap->end());
+        } else if (!heap->empty() && row < heap->front()) {
+            std::pop_heap(heap->begin(), heap->end());
+            heap->back() = std::move(row);
+            std::push_heap(heap->begin(), heap->end());
+        }
+    }
+
+    env_t *env;
+    std::vector<counted_t<func_t> > funcs;
+    std::vector<sort_direction_t> directions;
+    uint64_t n;
+    protob_t<const Backtrace> bt;
+};
+
 template<class T>
 class terminal_visitor_t : public boost::static_visitor<T *> {
 public:
@@ -544,6 +768,12 @@ public:
     T *operator()(const reduce_wire_func_t &f) const {
         return new reduce_terminal_t(env, f);
     }
+    T *operator()(const distinct_wire_func_t &f) const {
+        return new distinct_terminal_t(env, f);
+    }
+    T *operator()(const orderby_limit_wire_func_t &f) const {
+        return new orderby_limit_terminal_t(env, f);
+    }
     env_t *env;
 };
 
@@ -684,12 +914,21 @@ private:
 class map_trans_t : public ungrouped_op_t {
 public:
     map_trans_t(env_t *_env, const map_wire_func_t &_f)
-        : env(_env), f(_f.compile_wire_func()) { }
+        : env(_env), f(_f.compile_wire_func()), compiled(f->make_map_function()) { }
 private:
     virtual void lst_transform(datums_t *lst) {
         try {
+            if (!compiled.has()) {
+                f->map_rows(env, lst);
+                return;
+            }
             for (auto it = lst->begin(); it != lst->end(); ++it) {
-                *it = f->call(env, *it)->as_datum();
+                counted_t<const datum_t> res;
+                if (compiled->apply(*it, &res)) {
+                    *it = std::move(res);
+                } else {
+                    *it = f->call(env, *it)->as_datum();
+                }
             }
         } catch (const datum_exc_t &e) {
             throw exc_t(e, f->backtrace().get(), 1);
@@ -697,6 +936,8 @@ private:
     }
     env_t *env;
     counted_t<func_t> f;
+    // Maps most rows without evaluating `f`, if `f` is simple enough.
+    scoped_ptr_t<map_function_t> compiled;
 };
 
 class filter_trans_t : public ungrouped_op_t {
@@ -706,14 +947,20 @@ public:
           f(_f.filter_func.compile_wire_func()),
           default_val(_f.default_filter_val
                       ? _f.default_filter_val->compile_wire_func()
-                      : counted_t<func_t>()) { }
+                      : counted_t<func_t>()),
+          predicate(f->make_filter_predicate()) { }
 private:
     virtual void lst_transform(datums_t *lst) {
         auto it = lst->begin();
         auto loc = it;
         try {
             for (it = lst->begin(); it != lst->end(); ++it) {
-                if (f->filter_call(env, *it, default_val)) {
+                const filter_predicate_t::result_t res = predicate.has()
+                    ? predicate->test(*it)
+                    : filter_predicate_t::result_t::UNKNOWN;
+                if (res == filter_predicate_t::result_t::MATCH
+                    || (res == filter_predicate_t::result_t::UNKNOWN
+                        && f->filter_call(env, *it, default_val))) {
                     loc->swap(*it);
                     ++loc;
                 }
@@ -725,6 +972,8 @@ private:
     }
     env_t *env;
     counted_t<func_t> f, default_val;
+    // Decides most rows without evaluating `f`, if `f` is simple enough.
+    scoped_ptr_t<filter_predicate_t> predicate;
 };
 
 class concatmap_trans_t : public ungrouped_op_t {
@@ -756,6 +1005,76 @@ private:
     counted_t<func_t> f;
 };
 
+class project_trans_t : public ungrouped_op_t {
+public:
+    explicit project_trans_t(const project_wire_func_t &f)
+        : kind(f.get_kind()),
+          // The parsing node already checked that the paths are valid, so this
+          // doesn't need a term to report errors to.
+          pathspec(f.get_paths(), NULL),
+          name(f.name()),
+          bt(f.get_bt()) {
+        if (kind == project_wire_func_t::kind_t::GET_FIELD) {
+            field = f.get_paths()->as_str().to_std();
+        }
+    }
+private:
+    virtual void lst_transform(datums_t *lst) {
+        auto loc = lst->begin();
+        try {
+            for (auto it = lst->begin(); it != lst->end(); ++it) {
+                counted_t<const datum_t> res = project_row(*it);
+                if (res.has()) {
+                    *loc = std::move(res);
+                    ++loc;
+                }
+            }
+        } catch (const datum_exc_t &e) {
+            throw exc_t(e, bt.get(), 1);
+        }
+        lst->erase(loc, lst->end());
+    }
+
+    // Returns an empty pointer if the row should be dropped.  The errors are the
+    // ones the term gives when it's called on the row.
+    counted_t<const datum_t> project_row(const counted_t<const datum_t> &row) {
+        switch (row->get_type()) {
+        case datum_t::R_OBJECT:
+            switch (kind) {
+            case project_wire_func_t::kind_t::PLUCK:
+                return project(row, pathspec, DONT_RECURSE);
+            case project_wire_func_t::kind_t::WITHOUT:
+                return unproject(row, pathspec, DONT_RECURSE);
+            case project_wire_func_t::kind_t::GET_FIELD:
+                return row->get(field, NOTHROW);
+            default: unreachable();
+            }
+        case datum_t::R_ARRAY:
+            rcheck_src(bt.get(), base_exc_t::GENERIC, false,
+                       strprintf("Cannot perform %s on a sequence of sequences.",
+                                 name));
+            unreachable();
+        default:
+            // `get_field` on a sequence skips rows for which it fails with a
+            // non-existence error, like it does for a missing field.
+            if (kind == project_wire_func_t::kind_t::GET_FIELD
+                && exc_type(row) == base_exc_t::NON_EXISTENCE) {
+                return counted_t<const datum_t>();
+            }
+            rcheck_src(bt.get(), exc_type(row), false,
+                       strprintf("Cannot perform %s on a non-object non-sequence `%s`.",
+                                 name, row->trunc_print().c_str()));
+            unreachable();
+        }
+    }
+
+    project_wire_func_t::kind_t kind;
+    pathspec_t pathspec;
+    std::string field;
+    const char *name;
+    protob_t<const Backtrace> bt;
+};
+
 class transform_visitor_t : public boost::static_visitor<op_t *> {
 public:
     explicit transform_visitor_t(env_t *_env) : env(_env) { }
@@ -771,6 +1090,9 @@ public:
     op_t *operator()(const concatmap_wire_func_t &f) const {
         return new concatmap_trans_t(env, f);
     }
+    op_t *operator()(const project_wire_func_t &f) const {
+        return new project_trans_t(f);
+    }
 private:
     env_t *env;
 };
@@ -779,6 +1101,57 @@ op_t *make_op(env_t *env, const transform_variant_t &tv) {
     return boost::apply_visitor(transform_visitor_t(env), tv);
 }
 
+// The function of a `skip_wire_func_t` can be missing.
+static bool wire_func_is_deterministic(const wire_func_t &f) {
+    counted_t<func_t> func = f.compile_wire_func();
+    return !func.has() || func->is_deterministic();
+}
+
+static bool all_deterministic(const std::vector<counted_t<func_t> > &funcs) {
+    for (auto it = funcs.begin(); it != funcs.end(); ++it) {
+        if (!(*it)->is_deterministic()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+class deterministic_visitor_t : public boost::static_visitor<bool> {
+public:
+    // `map`, `concat_map`, `reduce`, `sum`, `avg`, `min` and `max`.
+    bool operator()(const wire_func_t &f) const {
+        return wire_func_is_deterministic(f);
+    }
+    bool operator()(const group_wire_func_t &f) const {
+        return all_deterministic(f.compile_funcs());
+    }
+    bool operator()(const filter_wire_func_t &f) const {
+        return wire_func_is_deterministic(f.filter_func)
+            && (!f.default_filter_val
+                || wire_func_is_deterministic(*f.default_filter_val));
+    }
+    bool operator()(const project_wire_func_t &) const {
+        return true;
+    }
+    bool operator()(const orderby_limit_wire_func_t &f) const {
+        return all_deterministic(f.compile_funcs());
+    }
+    bool operator()(const count_wire_func_t &) const {
+        return true;
+    }
+    bool operator()(const distinct_wire_func_t &) const {
+        return true;
+    }
+};
+
+bool funcs_are_deterministic(const transform_variant_t &tv) {
+    return boost::apply_visitor(deterministic_visitor_t(), tv);
+}
+
+bool funcs_are_deterministic(const terminal_variant_t &t) {
+    return boost::apply_visitor(deterministic_visitor_t(), t);
+}
+
 RDB_IMPL_ME_SERIALIZABLE_3(rget_item_t, key, empty_ok(sindex_key), data);
 
 } // namespace ql
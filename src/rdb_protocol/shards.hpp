@@ -57,6 +57,35 @@ public:
     counted_t<const datum_t> unpack(const char *name);
     counted_t<const datum_t> row, val;
 };
+
+// A row of an unindexed `order_by`, along with its sort key.
+struct keyed_row_t {
+    keyed_row_t() { }
+    keyed_row_t(std::string &&_key, counted_t<const datum_t> &&_row)
+        : key(std::move(_key)), row(std::move(_row)) { }
+
+    void rdb_serialize(write_message_t &msg) const;  // NOLINT(runtime/references)
+    archive_result_t rdb_deserialize(read_stream_t *s);
+
+    bool operator<(const keyed_row_t &other) const { return key < other.key; }
+
+    // The `append_sort_key` bytes of the values of all the `order_by`'s functions.
+    std::string key;
+    counted_t<const datum_t> row;
+};
+// The value of one of an unindexed `order_by`'s functions for `row`, or an empty
+// value if it doesn't exist.
+counted_t<const datum_t> sort_key(env_t *env, const counted_t<func_t> &f,
+                                  const counted_t<const datum_t> &row);
+// Appends bytes for such a value to `*out`, so that keys made of them for each of
+// the functions in turn compare with `memcmp` the way `order_by` orders rows.
+// Values that don't exist come first (before `direction` is applied).
+void append_sort_key(sort_direction_t direction,
+                     const counted_t<const datum_t> &val,
+                     std::string *out);
+// The first rows of an `order_by(...).limit(n)` seen so far, as a heap with the
+// last one on top.
+typedef std::vector<keyed_row_t> keyed_rows_t;
 static inline void serialize_grouped(
     write_message_t *msg, const optimizer_t &o) { // NOLINT
     *msg << o.row.has();
@@ -102,6 +131,16 @@ static inline void serialize_grouped(write_message_t *msg, const stream_t &sz) {
 static inline void serialize_grouped(write_message_t *msg, const datums_t &ds) {
     *msg << ds;
 }
+static inline void serialize_grouped(write_message_t *msg, const keyed_rows_t &rs) {
+    *msg << rs;
+}
+static inline void serialize_grouped(write_message_t *msg,
+                                     const datum_hash_set_t &ds) {
+    serialize_varint_uint64(msg, ds.size());
+    for (auto it = ds.begin(); it != ds.end(); ++it) {
+        *msg << *it;
+    }
+}
 
 static inline archive_result_t deserialize_grouped(
     read_stream_t *s, counted_t<const datum_t> *d) {
@@ -133,6 +172,27 @@ static inline archive_result_t deserialize_grouped(read_stream_t *s, stream_t *s
 static inline archive_result_t deserialize_grouped(read_stream_t *s, datums_t *ds) {
     return deserialize(s, ds);
 }
+static inline archive_result_t deserialize_grouped(read_stream_t *s,
+                                                   keyed_rows_t *rs) {
+    return deserialize(s, rs);
+}
+static inline archive_result_t deserialize_grouped(read_stream_t *s,
+                                                   datum_hash_set_t *ds) {
+    uint64_t sz;
+    archive_result_t res = deserialize_varint_uint64(s, &sz);
+    if (bad(res)) { return res; }
+    if (sz > std::numeric_limits<size_t>::max()) {
+        return archive_result_t::RANGE_ERROR;
+    }
+    ds->reserve(sz);
+    for (uint64_t i = 0; i < sz; ++i) {
+        counted_t<const datum_t> d;
+        res = deserialize(s, &d);
+        if (bad(res)) { return res; }
+        ds->insert(std::move(d));
+    }
+    return archive_result_t::SUCCESS;
+}
 
 // This is basically a templated typedef with special serialization.
 template<class T>
@@ -206,13 +266,16 @@ typedef boost::variant<
     grouped_t<counted_t<const ql::datum_t> >, // Reduce (may be NULL)
     grouped_t<optimizer_t>, // min, max
     grouped_t<stream_t>, // No terminal.,
+    grouped_t<keyed_rows_t>, // orderby_limit
+    grouped_t<datum_hash_set_t>, // distinct
     exc_t // Don't re-order (we don't want this to initialize to an error.)
     > result_t;
 
 typedef boost::variant<map_wire_func_t,
                        group_wire_func_t,
                        filter_wire_func_t,
-                       concatmap_wire_func_t
+                       concatmap_wire_func_t,
+                       project_wire_func_t
                        > transform_variant_t;
 
 typedef boost::variant<count_wire_func_t,
@@ -220,7 +283,9 @@ typedef boost::variant<count_wire_func_t,
                        avg_wire_func_t,
                        min_wire_func_t,
                        max_wire_func_t,
-                       reduce_wire_func_t
+                       reduce_wire_func_t,
+                       orderby_limit_wire_func_t,
+                       distinct_wire_func_t
                        > terminal_variant_t;
 
 class op_t {
@@ -270,12 +335,17 @@ accumulator_t *make_append(const sorting_t &sorting, batcher_t *batcher);
 accumulator_t *make_terminal(
     ql::env_t *env, const terminal_variant_t &t);
 
-eager_acc_t *make_to_array();
+eager_acc_t *make_to_array(env_t *env);
 eager_acc_t *make_eager_terminal(
     ql::env_t *env, const terminal_variant_t &t);
 
 op_t *make_op(env_t *env, const transform_variant_t &tv);
 
+// Whether all the functions of `tv` (or `t`) are deterministic, so that it gives the
+// same result every time it's run on the same rows.
+bool funcs_are_deterministic(const transform_variant_t &tv);
+bool funcs_are_deterministic(const terminal_variant_t &t);
+
 } // namespace ql
 
 #endif  // RDB_PROTOCOL_SHARDS_HPP_
@@ -0,0 +1,221 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/slow_query_log.hpp"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include <functional>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "arch/types.hpp"
+#include "config/args.hpp"
+#include "logger.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/error.hpp"
+#include "rdb_protocol/ql2.pb.h"
+#include "utils.hpp"
+
+// The name of the database or table in `term`, if it's a DATUM term with a string.
+static bool get_name(const Term &term, std::string *name_out) {
+    if (term.type() != Term::DATUM || term.datum().type() != Datum::R_STR) {
+        return false;
+    }
+    *name_out = term.datum().r_str();
+    return true;
+}
+
+// The name of the database in a DB term.
+static bool get_db_name(const Term &term, std::string *name_out) {
+    return term.type() == Term::DB && term.args_size() == 1
+        && get_name(term.args(0), name_out);
+}
+
+static void note_table(const Term &table,
+                       const std::string &default_db,
+                       std::set<std::string> *tables_out) {
+    std::string db = default_db;
+    std::string name;
+    if (table.args_size() == 1) {
+        if (!get_name(table.args(0), &name)) {
+            return;
+        }
+    } else if (table.args_size() == 2) {
+        if (!get_db_name(table.args(0), &db) || !get_name(table.args(1), &name)) {
+            return;
+        }
+    } else {
+        return;
+    }
+    tables_out->insert(db + "." + name);
+}
+
+static void summarize_term(const Term &term,
+                           const std::string &default_db,
+                           std::string *summary_out,
+                           std::set<std::string> *tables_out) {
+    if (summary_out->size() >= SLOW_QUERY_LOG_MAX_SUMMARY_SIZE) {
+        return;
+    }
+    if (term.type() == Term::DATUM) {
+        std::string datum;
+        try {
+            ql::datum_t(&term.datum()).write_json(&datum);
+        } catch (const ql::base_exc_t &) {
+            datum = "?";
+        }
+        if (datum.size() > SLOW_QUERY_LOG_MAX_DATUM_SIZE) {
+            datum.resize(SLOW_QUERY_LOG_MAX_DATUM_SIZE - 3);
+            datum += "...";
+        }
+        *summary_out += datum;
+        return;
+    }
+
+    if (term.type() == Term::TABLE) {
+        note_table(term, default_db, tables_out);
+    }
+    *summary_out += Term::TermType_Name(term.type());
+    *summary_out += "(";
+    for (int i = 0; i < term.args_size(); ++i) {
+        if (i != 0) {
+            *summary_out += ", ";
+        }
+        summarize_term(term.args(i), default_db, summary_out, tables_out);
+    }
+    for (int i = 0; i < term.optargs_size(); ++i) {
+        if (i != 0 || term.args_size() != 0) {
+            *summary_out += ", ";
+        }
+        *summary_out += term.optargs(i).key() + "=";
+        summarize_term(term.optargs(i).val(), default_db, summary_out, tables_out);
+    }
+    *summary_out += ")";
+}
+
+void summarize_query(const Query &query,
+                     std::string *summary_out,
+                     std::set<std::string> *tables_out) {
+    std::string default_db = "test";
+    for (int i = 0; i < query.global_optargs_size(); ++i) {
+        if (query.global_optargs(i).key() == "db") {
+            UNUSED bool b = get_db_name(query.global_optargs(i).val(), &default_db);
+        }
+    }
+
+    summary_out->clear();
+    if (query.has_query()) {
+        summarize_term(query.query(), default_db, summary_out, tables_out);
+    }
+    if (summary_out->size() > SLOW_QUERY_LOG_MAX_SUMMARY_SIZE) {
+        summary_out->resize(SLOW_QUERY_LOG_MAX_SUMMARY_SIZE - 3);
+        *summary_out += "...";
+    }
+}
+
+slow_query_log_t::slow_query_log_t(const slow_query_log_config_t &config)
+    : threshold(secs_to_ticks(1) / 1000 * config.threshold_ms),
+      filename(config.filename),
+      minute_start(get_ticks()),
+      entries_this_minute(0),
+      entries_left_out(0) {
+    guarantee(config.threshold_ms > 0);
+    int res;
+    do {
+        res = ::open(filename.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    } while (res == INVALID_FD && get_errno() == EINTR);
+    if (res == INVALID_FD) {
+        logERR("Couldn't open the slow query log '%s' (%s), so slow queries will be "
+               "logged to the main log.\n",
+               filename.c_str(), errno_string(get_errno()).c_str());
+    } else {
+        fd.reset(res);
+        logINF("Logging queries that take %" PRIi64 "ms or more to '%s'.\n",
+               config.threshold_ms, filename.c_str());
+    }
+}
+
+bool slow_query_log_t::should_profile() const {
+    return randint(SLOW_QUERY_LOG_PROFILE_SAMPLE_RATE) == 0;
+}
+
+void slow_query_log_t::record(slow_query_t &&query) {
+    std::vector<counted_t<const ql::datum_t> > tables;
+    for (auto it = query.tables.begin(); it != query.tables.end(); ++it) {
+        tables.push_back(make_counted<const ql::datum_t>(std::string(*it)));
+    }
+
+    ql::datum_ptr_t entry(ql::datum_t::R_OBJECT);
+    bool conflict
+        = entry.add("time", make_counted<const ql::datum_t>(
+                        format_time(clock_realtime())))
+        || entry.add("duration_ms", make_counted<const ql::datum_t>(
+                         ticks_to_secs(query.duration) * 1000))
+        || entry.add("query", make_counted<const ql::datum_t>(
+                         std::move(query.summary)))
+        || entry.add("tables", make_counted<const ql::datum_t>(std::move(tables)))
+        || entry.add("rows_scanned", make_counted<const ql::datum_t>(
+                         static_cast<double>(query.rows_scanned)))
+        || entry.add("rows_returned", make_counted<const ql::datum_t>(
+                         static_cast<double>(query.rows_returned)))
+        || (query.profile.has() && entry.add("profile", query.profile));
+    r_sanity_check(!conflict);
+
+    std::string json;
+    entry->write_json(&json);
+    coro_t::spawn_sometime(std::bind(&slow_query_log_t::write_entry, this,
+                                     std::move(json),
+                                     auto_drainer_t::lock_t(drainers.get())));
+}
+
+void slow_query_log_t::write_entry(const std::string &entry, auto_drainer_t::lock_t) {
+    on_thread_t thread_switcher(home_thread());
+    mutex_t::acq_t write_mutex_acq(&write_mutex);
+
+    const ticks_t now = get_ticks();
+    if (now - minute_start >= secs_to_ticks(60)) {
+        minute_start = now;
+        entries_this_minute = 0;
+    }
+    if (entries_this_minute >= SLOW_QUERY_LOG_MAX_ENTRIES_PER_MINUTE) {
+        ++entries_left_out;
+        return;
+    }
+    ++entries_this_minute;
+
+    std::string lines;
+    if (entries_left_out != 0) {
+        lines = strprintf("{\"time\":\"%s\",\"left_out\":%" PRIu64 "}\n",
+                          format_time(clock_realtime()).c_str(), entries_left_out);
+        entries_left_out = 0;
+    }
+    lines += entry + "\n";
+
+    if (fd.get() == INVALID_FD) {
+        logWRN("Slow query: %s", lines.c_str());
+        return;
+    }
+    bool ok;
+    thread_pool_t::run_in_blocker_pool(
+        std::bind(&slow_query_log_t::write_blocking, this, std::cref(lines), &ok));
+    if (!ok) {
+        logERR("Couldn't write to the slow query log '%s'.\n", filename.c_str());
+    }
+}
+
+void slow_query_log_t::write_blocking(const std::string &lines, bool *ok_out) {
+    size_t written = 0;
+    while (written < lines.size()) {
+        ssize_t res = ::write(fd.get(), lines.data() + written, lines.size() - written);
+        if (res == -1) {
+            if (get_errno() == EINTR) {
+                continue;
+            }
+            *ok_out = false;
+            return;
+        }
+        written += res;
+    }
+    *ok_out = true;
+}
@@ -0,0 +1,91 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_SLOW_QUERY_LOG_HPP_
+#define RDB_PROTOCOL_SLOW_QUERY_LOG_HPP_
+
+#include <set>
+#include <string>
+
+#include "arch/io/io_utils.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/mutex.hpp"
+#include "concurrency/one_per_thread.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "time.hpp"
+
+class Query;
+
+// How the slow query log was configured on the command line.
+class slow_query_log_config_t {
+public:
+    slow_query_log_config_t() : threshold_ms(0) { }
+    // Queries that take at least this long are logged.  0 turns the log off.
+    int64_t threshold_ms;
+    // The file they're logged to.
+    std::string filename;
+};
+
+// What the slow query log says about a query.
+class slow_query_t {
+public:
+    slow_query_t() : duration(0), rows_scanned(0), rows_returned(0) { }
+
+    ticks_t duration;
+    // A short description of the query's term tree (see `summarize_query`).
+    std::string summary;
+    std::set<std::string> tables;
+    // The rows the shards' range and index scans read for the query, and the rows
+    // it answered with.  Filters and `count` make the first much bigger.
+    uint64_t rows_scanned;
+    uint64_t rows_returned;
+    // The query's profile, if it was profiled.
+    counted_t<const ql::datum_t> profile;
+};
+
+// Describes the term tree of `query` like `FILTER(TABLE(DB("test"), "t"), ...)`, in
+// at most about SLOW_QUERY_LOG_MAX_SUMMARY_SIZE bytes, and adds the tables it names
+// to `tables_out` as "db.table".
+void summarize_query(const Query &query,
+                     std::string *summary_out,
+                     std::set<std::string> *tables_out);
+
+/* Logs the queries that take at least the configured threshold to a file of its own,
+one JSON object per line, but no more than SLOW_QUERY_LOG_MAX_ENTRIES_PER_MINUTE of
+them; the next entry then says how many were left out.
+
+A query's profile only exists if it was profiled, so `should_profile` has the server
+profile one query in SLOW_QUERY_LOG_PROFILE_SAMPLE_RATE on its own, without sending
+the profile to the client. */
+class slow_query_log_t : public home_thread_mixin_t {
+public:
+    explicit slow_query_log_t(const slow_query_log_config_t &config);
+
+    bool is_slow(ticks_t duration) const {
+        return duration >= threshold;
+    }
+
+    // Whether to profile a query that the client didn't ask to profile.
+    bool should_profile() const;
+
+    // May be called on any thread.  Writes the entry in the background.
+    void record(slow_query_t &&query);
+
+private:
+    void write_entry(const std::string &entry, auto_drainer_t::lock_t);
+    void write_blocking(const std::string &line, bool *ok_out);
+
+    const ticks_t threshold;
+    const std::string filename;
+    scoped_fd_t fd;
+
+    // These are only touched on the home thread.
+    ticks_t minute_start;
+    int entries_this_minute;
+    uint64_t entries_left_out;
+    mutex_t write_mutex;
+
+    one_per_thread_t<auto_drainer_t> drainers;
+
+    DISABLE_COPYING(slow_query_log_t);
+};
+
+#endif  // RDB_PROTOCOL_SLOW_QUERY_LOG_HPP_
@@ -1,10 +1,30 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/stream_cache.hpp"
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/interruptor.hpp"
+#include "config/args.hpp"
+#include "perfmon/perfmon.hpp"
 #include "rdb_protocol/env.hpp"
+#include "rdb_protocol/response_writer.hpp"
+#include "rdb_protocol/slow_query_log.hpp"
 
 namespace ql {
 
+static perfmon_counter_t pm_cursors, pm_cursor_bytes;
+static perfmon_multi_membership_t pm_cursors_membership(
+    &get_global_perfmon_collection(),
+    &pm_cursors, "cursors",
+    &pm_cursor_bytes, "cursor_bytes");
+
+// `cached_bytes` of all the connections' cursors.  (The connections are on
+// different threads.)
+static int64_t total_cached_bytes = 0;
+
 bool stream_cache2_t::contains(int64_t key) {
     return streams.find(key) != streams.end();
 }
@@ -13,59 +33,132 @@ void stream_cache2_t::insert(int64_t key,
                              use_json_t use_json,
                              scoped_ptr_t<env_t> &&val_env,
                              counted_t<datum_stream_t> val_stream) {
-    maybe_evict();
     std::pair<boost::ptr_map<int64_t, entry_t>::iterator, bool> res = streams.insert(
         key, new entry_t(time(0), use_json, std::move(val_env), val_stream));
     guarantee(res.second);
 }
 
 void stream_cache2_t::erase(int64_t key) {
-    size_t num_erased = streams.erase(key);
-    guarantee(num_erased == 1);
+    boost::ptr_map<int64_t, entry_t>::iterator it = streams.find(key);
+    guarantee(it != streams.end());
+    // Destroying the entry waits for its prefetch, so take it out of the map first.
+    boost::ptr_map<int64_t, entry_t>::auto_type entry = streams.release(it);
 }
 
-bool stream_cache2_t::serve(int64_t key, Response *res, signal_t *interruptor) {
+bool stream_cache2_t::serve(int64_t key, Response *res, signal_t *interruptor,
+                            slow_query_t *query_out) {
     boost::ptr_map<int64_t, entry_t>::iterator it = streams.find(key);
     if (it == streams.end()) return false;
     entry_t *entry = it->second;
     entry->last_activity = time(0);
+    guarantee(!entry->serving);
+    entry->serving = true;
+    bool empty_batch = false;
+    std::exception_ptr error;
     try {
-        // Reset the env_t's interruptor to a good one before we use it.  This may be a
-        // hack.  (I'd rather not have env_t be mutable this way -- could we construct
-        // a new env_t instead?  Why do we keep env_t's around anymore?)
-        entry->env->interruptor = interruptor;
-
-        batch_type_t batch_type = entry->has_sent_batch
-                                      ? batch_type_t::NORMAL
-                                      : batch_type_t::NORMAL_FIRST;
-        std::vector<counted_t<const datum_t> > ds
-            = entry->stream->next_batch(
-                entry->env.get(),
-                batchspec_t::user(batch_type, entry->env.get()));
-        entry->has_sent_batch = true;
+        std::vector<counted_t<const datum_t> > ds;
+        uint64_t rows_scanned;
+        if (entry->prefetch.has()) {
+            wait_interruptible(&entry->prefetch->done, interruptor);
+            scoped_ptr_t<entry_t::prefetch_t> prefetch(std::move(entry->prefetch));
+            entry->env->interruptor = interruptor;
+            if (prefetch->error) {
+                std::rethrow_exception(prefetch->error);
+            }
+            ds = std::move(prefetch->batch);
+            rows_scanned = prefetch->rows_scanned;
+        } else {
+            // Reset the env_t's interruptor to a good one before we use it.  This may
+            // be a hack.  (I'd rather not have env_t be mutable this way -- could we
+            // construct a new env_t instead?  Why do we keep env_t's around anymore?)
+            entry->env->interruptor = interruptor;
+
+            const microtime_t start = current_microtime();
+            const uint64_t rows_scanned_before = entry->env->rows_scanned;
+            batchspec_t batchspec = entry->batch_history.next_batchspec(entry->env.get());
+            ds = entry->stream->next_batch(entry->env.get(), batchspec);
+            entry->batch_history.note_batch(batchspec, start);
+            rows_scanned = entry->env->rows_scanned - rows_scanned_before;
+        }
+        response_writer_t writer(res, entry->use_json);
         for (auto d = ds.begin(); d != ds.end(); ++d) {
-            (*d)->write_to_protobuf(res->add_response(), entry->use_json);
+            writer.add(*d);
         }
+        empty_batch = ds.empty();
+        counted_t<const datum_t> profile;
         if (entry->env->trace.has()) {
-            entry->env->trace->as_datum()->write_to_protobuf(
-                res->mutable_profile(), entry->use_json);
+            profile = entry->env->trace->as_datum();
+            if (entry->env->send_profile) {
+                profile->write_to_protobuf(res->mutable_profile(), entry->use_json);
+            }
         }
-    } catch (const std::exception &e) {
+        if (query_out != NULL) {
+            query_out->rows_scanned = rows_scanned;
+            query_out->rows_returned = ds.size();
+            query_out->profile = profile;
+        }
+    } catch (const std::exception &) {
+        error = std::current_exception();
+    }
+    if (error) {
+        // Not in the `catch`, since waiting for the prefetch can block.
         erase(key);
-        throw;
+        std::rethrow_exception(error);
     }
-    if (entry->stream->is_exhausted() || res->response_size() == 0) {
+    entry->serving = false;
+    if (entry->stream->is_exhausted() || empty_batch) {
         erase(key);
         res->set_type(Response::SUCCESS_SEQUENCE);
     } else {
         res->set_type(Response::SUCCESS_PARTIAL);
+        entry->update_cached_bytes();
+        const int64_t connection_bytes = maybe_evict(key);
+        if (connection_bytes <= STREAM_CACHE_MAX_BYTES_PER_CONNECTION / 2
+            && __sync_fetch_and_add(&total_cached_bytes, 0) <= STREAM_CACHE_MAX_BYTES / 2) {
+            entry->start_prefetch();
+        }
     }
 
     return true;
 }
 
-void stream_cache2_t::maybe_evict() {
-    // We never evict right now.
+int64_t stream_cache2_t::maybe_evict(int64_t key) {
+    int64_t connection_bytes = 0;
+    // The other cursors, least recently used first.
+    std::vector<std::pair<time_t, int64_t> > idle;
+    for (auto it = streams.begin(); it != streams.end(); ++it) {
+        connection_bytes += it->second->cached_bytes;
+        if (it->first != key && !it->second->serving
+            && !it->second->prefetch_running()) {
+            idle.push_back(std::make_pair(it->second->last_activity, it->first));
+        }
+    }
+    std::sort(idle.begin(), idle.end());
+
+    for (auto it = idle.begin(); it != idle.end(); ++it) {
+        if (connection_bytes <= STREAM_CACHE_MAX_BYTES_PER_CONNECTION
+            && __sync_fetch_and_add(&total_cached_bytes, 0) <= STREAM_CACHE_MAX_BYTES) {
+            return connection_bytes;
+        }
+        entry_t *entry = streams.find(it->second)->second;
+        connection_bytes -= entry->cached_bytes;
+        entry->stream->release_buffers();
+        entry->update_cached_bytes();
+        connection_bytes += entry->cached_bytes;
+    }
+
+    for (auto it = idle.begin(); it != idle.end(); ++it) {
+        if (connection_bytes <= STREAM_CACHE_MAX_BYTES_PER_CONNECTION) {
+            return connection_bytes;
+        }
+        auto entry_it = streams.find(it->second);
+        if (entry_it->second->cached_bytes > 0) {
+            connection_bytes -= entry_it->second->cached_bytes;
+            // Not prefetching, so this doesn't block.
+            streams.erase(entry_it);
+        }
+    }
+    return connection_bytes;
 }
 
 stream_cache2_t::entry_t::entry_t(time_t _last_activity,
@@ -77,9 +170,59 @@ stream_cache2_t::entry_t::entry_t(time_t _last_activity,
       env(std::move(env_ptr)),
       stream(_stream),
       max_age(DEFAULT_MAX_AGE),
-      has_sent_batch(false) { }
+      cached_bytes(0),
+      serving(false) {
+    ++pm_cursors;
+}
+
+stream_cache2_t::entry_t::~entry_t() {
+    __sync_fetch_and_sub(&total_cached_bytes, cached_bytes);
+    pm_cursor_bytes -= cached_bytes;
+    --pm_cursors;
+}
+
+void stream_cache2_t::entry_t::update_cached_bytes() {
+    const int64_t new_cached_bytes = stream->buffered_bytes()
+        + (prefetch.has() ? prefetch->bytes : 0);
+    __sync_fetch_and_add(&total_cached_bytes, new_cached_bytes - cached_bytes);
+    pm_cursor_bytes += new_cached_bytes - cached_bytes;
+    cached_bytes = new_cached_bytes;
+}
+
 
-stream_cache2_t::entry_t::~entry_t() { }
+bool stream_cache2_t::entry_t::prefetch_running() const {
+    return prefetch.has() && !prefetch->done.is_pulsed();
+}
+
+void stream_cache2_t::entry_t::start_prefetch() {
+    guarantee(!prefetch.has());
+    prefetch.init(new prefetch_t);
+    coro_t::spawn_sometime(std::bind(&entry_t::run_prefetch, this,
+                                     auto_drainer_t::lock_t(&drainer)));
+}
 
+void stream_cache2_t::entry_t::run_prefetch(auto_drainer_t::lock_t lock) {
+    // The query that served the last batch is over, so only closing the cursor
+    // interrupts this.  `serve` resets the interruptor once it's done.
+    env->interruptor = lock.get_drain_signal();
+    const microtime_t start = current_microtime();
+    const uint64_t rows_scanned_before = env->rows_scanned;
+    try {
+        batchspec_t batchspec = batch_history.next_batchspec(env.get());
+        prefetch->batch = stream->next_batch(env.get(), batchspec);
+        batch_history.note_batch(batchspec, start);
+        for (auto d = prefetch->batch.begin(); d != prefetch->batch.end(); ++d) {
+            prefetch->bytes += serialized_size(*d);
+        }
+    } catch (const std::exception &) {
+        prefetch->error = std::current_exception();
+    }
+    prefetch->rows_scanned = env->rows_scanned - rows_scanned_before;
+    if (!lock.get_drain_signal()->is_pulsed()) {
+        // (Otherwise the destructor has already taken `cached_bytes` off the totals.)
+        update_cached_bytes();
+    }
+    prefetch->done.pulse();
+}
 
 } // namespace ql
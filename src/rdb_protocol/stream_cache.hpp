@@ -4,16 +4,23 @@
 
 #include <time.h>
 
+#include <exception>
 #include <map>
+#include <vector>
 
 #include "errors.hpp"
 #include <boost/ptr_container/ptr_map.hpp>
 
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
 #include "concurrency/signal.hpp"
 #include "containers/scoped.hpp"
+#include "rdb_protocol/batching.hpp"
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/ql2.pb.h"
 
+class slow_query_t;
+
 namespace ql {
 class env_t;
 }
@@ -29,9 +36,20 @@ public:
                 scoped_ptr_t<env_t> &&val_env,
                 counted_t<datum_stream_t> val_stream);
     void erase(int64_t key);
-    MUST_USE bool serve(int64_t key, Response *res, signal_t *interruptor);
+    // If `query_out` isn't NULL, it gets the rows the batch took and the profile,
+    // for the slow query log.
+    //
+    // Once the client has a batch, the next one is read in the background, so that
+    // it's ready when the client asks for it.  That only happens while the
+    // connection's cursors hold less than half of the byte limits below, since a
+    // batch that has been read ahead can't be let go of.
+    MUST_USE bool serve(int64_t key, Response *res, signal_t *interruptor,
+                        slow_query_t *query_out = NULL);
 private:
-    void maybe_evict();
+    // Enforces the byte limits, without touching the cursor `key` is for or the ones
+    // that other queries on the connection are reading a batch from.  Returns the
+    // bytes the connection's cursors hold afterwards.
+    int64_t maybe_evict(int64_t key);
 
     struct entry_t {
         ~entry_t(); // `env_t` is incomplete
@@ -45,8 +63,33 @@ private:
         scoped_ptr_t<env_t> env;
         counted_t<datum_stream_t> stream;
         time_t max_age;
-        bool has_sent_batch;
+        batch_history_t batch_history;
+        // What `stream` had buffered after its last batch.
+        int64_t cached_bytes;
+        // Whether a query is reading a batch from `stream` now.
+        bool serving;
+        void update_cached_bytes();
+
+        // The next batch, read ahead after the last one was served.
+        struct prefetch_t {
+            prefetch_t() : rows_scanned(0), bytes(0) { }
+            // Pulsed when `batch` or `error` is set.
+            cond_t done;
+            std::vector<counted_t<const datum_t> > batch;
+            // What reading the batch threw instead.
+            std::exception_ptr error;
+            uint64_t rows_scanned;
+            int64_t bytes;
+        };
+        scoped_ptr_t<prefetch_t> prefetch;
+        bool prefetch_running() const;
+        void start_prefetch();
+
+        // Destroyed first, which interrupts the prefetch and waits for it.
+        auto_drainer_t drainer;
     private:
+        void run_prefetch(auto_drainer_t::lock_t lock);
+
         DISABLE_COPYING(entry_t);
     };
 
@@ -4,8 +4,11 @@
 #include "rdb_protocol/counted_term.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
+#include "rdb_protocol/insert_stream.hpp"
 #include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/slow_query_log.hpp"
 #include "rdb_protocol/stream_cache.hpp"
+#include "rdb_protocol/term_cache.hpp"
 #include "rdb_protocol/term_walker.hpp"
 #include "rdb_protocol/validate.hpp"
 
@@ -18,7 +21,13 @@ namespace ql {
 
 counted_t<term_t> compile_term(compile_env_t *env, protob_t<const Term> t) {
     switch (t->type()) {
-    case Term::DATUM:              return make_datum_term(t);
+    case Term::DATUM: {
+        counted_t<term_t> term = make_datum_term(t);
+        if (env->datum_terms != NULL) {
+            env->datum_terms->insert(std::make_pair(t.get(), term));
+        }
+        return term;
+    }
     case Term::MAKE_ARRAY:         return make_make_array_term(env, t);
     case Term::MAKE_OBJ:           return make_make_obj_term(env, t);
     case Term::VAR:                return make_var_term(env, t);
@@ -99,6 +108,7 @@ counted_t<term_t> compile_term(compile_env_t *env, protob_t<const Term> t) {
     case Term::TABLE_DROP:         return make_table_drop_term(env, t);
     case Term::TABLE_LIST:         return make_table_list_term(env, t);
     case Term::SYNC:               return make_sync_term(env, t);
+    case Term::CHANGES:            return make_changes_term(env, t);
     case Term::INDEX_CREATE:       return make_sindex_create_term(env, t);
     case Term::INDEX_DROP:         return make_sindex_drop_term(env, t);
     case Term::INDEX_LIST:         return make_sindex_list_term(env, t);
@@ -172,7 +182,9 @@ void run(protob_t<Query> q,
          rdb_protocol_t::context_t *ctx,
          signal_t *interruptor,
          Response *res,
-         stream_cache2_t *stream_cache2) {
+         stream_cache2_t *stream_cache2,
+         insert_stream_cache_t *insert_streams,
+         term_cache_t *term_cache) {
     try {
         validate_pb(*q);
     } catch (const base_exc_t &e) {
@@ -188,6 +200,7 @@ void run(protob_t<Query> q,
 
     switch (q->type()) {
     case Query_QueryType_START: {
+        const ticks_t start = get_ticks();
         threadnum_t th = get_thread_id();
         scoped_ptr_t<ql::env_t> env(
             new ql::env_t(
@@ -196,12 +209,21 @@ void run(protob_t<Query> q,
                 ctx->cross_thread_database_watchables[th.threadnum]->get_watchable(),
                 ctx->cluster_metadata, ctx->directory_read_manager,
                 interruptor, ctx->machine_id, q));
+        env->io_backender = ctx->io_backender;
+        env->temp_path = ctx->temp_path;
+        env->mailbox_manager = ctx->mailbox_manager;
+
+        slow_query_log_t *slow_query_log = ctx->slow_query_log;
+        slow_query_t slow_query;
+        if (slow_query_log != NULL && !env->trace.has()
+            && slow_query_log->should_profile()) {
+            env->trace.init(new profile::trace_t());
+            env->send_profile = false;
+        }
 
         counted_t<term_t> root_term;
         try {
-            Term *t = q->mutable_query();
-            compile_env_t compile_env((var_visibility_t()));
-            root_term = compile_term(&compile_env, q.make_child(t));
+            root_term = term_cache->compile(q);
             // TODO: handle this properly
         } catch (const exc_t &e) {
             fill_error(res, Response::COMPILE_ERROR, e.what(), e.backtrace());
@@ -212,7 +234,8 @@ void run(protob_t<Query> q,
         }
 
         try {
-            rcheck_toplevel(!stream_cache2->contains(token),
+            rcheck_toplevel(!stream_cache2->contains(token)
+                            && !insert_streams->contains(token),
                             base_exc_t::GENERIC,
                             strprintf("ERROR: duplicate token %" PRIi64, token));
         } catch (const exc_t &e) {
@@ -223,23 +246,35 @@ void run(protob_t<Query> q,
             return;
         }
 
+        // The compiled terms can only be reused if nothing from evaluating them
+        // outlives the query, which a cursor would.
+        bool made_cursor = false;
         try {
             scope_env_t scope_env(env.get(), var_scope_t());
             counted_t<val_t> val = root_term->eval(&scope_env);
-            if (val->get_type().is_convertible(val_t::type_t::DATUM)) {
+            if (env->insert_stream.has()) {
+                // The insert goes on with the documents of later CONTINUE queries.
+                res->set_type(Response::SUCCESS_PARTIAL);
+                val->as_datum()->write_to_protobuf(res->add_response(), use_json);
+                insert_streams->insert(token, use_json,
+                                       std::move(env->insert_stream));
+            } else if (val->get_type().is_convertible(val_t::type_t::DATUM)) {
                 res->set_type(Response_ResponseType_SUCCESS_ATOM);
                 counted_t<const datum_t> d = val->as_datum();
                 d->write_to_protobuf(res->add_response(), use_json);
-                if (env->trace.has()) {
+                slow_query.rows_returned
+                    = d->get_type() == datum_t::R_ARRAY ? d->size() : 1;
+                if (env->trace.has() && env->send_profile) {
                     env->trace->as_datum()->write_to_protobuf(
                         res->mutable_profile(), use_json);
                 }
             } else if (counted_t<grouped_data_t> gd
                        = val->maybe_as_promiscuous_grouped_data(scope_env.env)) {
                 res->set_type(Response::SUCCESS_ATOM);
+                slow_query.rows_returned = gd->size();
                 datum_t d(std::move(*gd));
                 d.write_to_protobuf(res->add_response(), use_json);
-                if (env->trace.has()) {
+                if (env->trace.has() && env->send_profile) {
                     env->trace->as_datum()->write_to_protobuf(
                         res->mutable_profile(), use_json);
                 }
@@ -248,13 +283,16 @@ void run(protob_t<Query> q,
                 if (counted_t<const datum_t> arr = seq->as_array(env.get())) {
                     res->set_type(Response_ResponseType_SUCCESS_ATOM);
                     arr->write_to_protobuf(res->add_response(), use_json);
-                    if (env->trace.has()) {
+                    slow_query.rows_returned = arr->size();
+                    if (env->trace.has() && env->send_profile) {
                         env->trace->as_datum()->write_to_protobuf(
                             res->mutable_profile(), use_json);
                     }
                 } else {
+                    made_cursor = true;
                     stream_cache2->insert(token, use_json, std::move(env), seq);
-                    bool b = stream_cache2->serve(token, res, interruptor);
+                    bool b = stream_cache2->serve(token, res, interruptor,
+                                                  &slow_query);
                     r_sanity_check(b);
                 }
             } else {
@@ -265,15 +303,42 @@ void run(protob_t<Query> q,
             }
         } catch (const exc_t &e) {
             fill_error(res, Response::RUNTIME_ERROR, e.what(), e.backtrace());
-            return;
         } catch (const datum_exc_t &e) {
             fill_error(res, Response::RUNTIME_ERROR, e.what(), backtrace_t());
-            return;
         }
 
+        if (!made_cursor) {
+            term_cache->put_back(root_term);
+        }
+
+        slow_query.duration = get_ticks() - start;
+        if (slow_query_log != NULL && slow_query_log->is_slow(slow_query.duration)) {
+            if (!made_cursor) {
+                // Otherwise the stream cache filled these in for the first batch.
+                slow_query.rows_scanned = env->rows_scanned;
+                if (env->trace.has()) {
+                    slow_query.profile = env->trace->as_datum();
+                }
+            }
+            summarize_query(*q, &slow_query.summary, &slow_query.tables);
+            slow_query_log->record(std::move(slow_query));
+        }
     } break;
     case Query_QueryType_CONTINUE: {
+        if (insert_streams->contains(token)) {
+            try {
+                insert_streams->serve(token, *q, res, interruptor);
+            } catch (const exc_t &e) {
+                fill_error(res, Response::RUNTIME_ERROR, e.what(), e.backtrace());
+            } catch (const datum_exc_t &e) {
+                fill_error(res, Response::RUNTIME_ERROR, e.what(), backtrace_t());
+            }
+            break;
+        }
         try {
+            rcheck_toplevel(!q->has_query(), base_exc_t::GENERIC,
+                            "Only a CONTINUE query for a streaming insert "
+                            "can have a `query`.");
             bool b = stream_cache2->serve(token, res, interruptor);
             rcheck_toplevel(b, base_exc_t::GENERIC,
                             strprintf("Token %" PRIi64 " not in stream cache.", token));
@@ -284,6 +349,12 @@ void run(protob_t<Query> q,
     } break;
     case Query_QueryType_STOP: {
         try {
+            if (insert_streams->contains(token)) {
+                // This interrupts the batches being written.
+                insert_streams->erase(token);
+                res->set_type(Response::SUCCESS_SEQUENCE);
+                break;
+            }
             rcheck_toplevel(stream_cache2->contains(token), base_exc_t::GENERIC,
                             strprintf("Token %" PRIi64 " not in stream cache.", token));
             stream_cache2->erase(token);
@@ -295,7 +366,8 @@ void run(protob_t<Query> q,
     } break;
     case Query_QueryType_NOREPLY_WAIT: {
         try {
-            rcheck_toplevel(!stream_cache2->contains(token),
+            rcheck_toplevel(!stream_cache2->contains(token)
+                            && !insert_streams->contains(token),
                             base_exc_t::GENERIC,
                             strprintf("ERROR: duplicate token %" PRIi64, token));
         } catch (const exc_t &e) {
@@ -306,10 +378,12 @@ void run(protob_t<Query> q,
             return;
         }
 
-        // NOREPLY_WAIT is just a no-op.
-        // This works because we only evaluate one Query at a time
-        // on the connection level. Once we get to the NOREPLY_WAIT Query
-        // we know that all previous Queries have completed processing.
+        // NOREPLY_WAIT is almost a no-op.
+        // This works because the connection runs a NOREPLY_WAIT Query
+        // only once all previous Queries have completed processing (see
+        // `is_barrier_request`), except for the batches that streaming
+        // inserts are still writing.
+        insert_streams->wait_for_writes(interruptor);
 
         // Send back a WAIT_COMPLETE response.
         res->set_type(Response_ResponseType_WAIT_COMPLETE);
@@ -0,0 +1,179 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/term_cache.hpp"
+
+#include <string>
+
+#include "config/args.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/term.hpp"
+#include "rdb_protocol/terms/terms.hpp"
+
+namespace ql {
+
+// 64-bit FNV-1a.
+static void hash_bytes(const void *data, size_t size, uint64_t *hash) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        *hash ^= bytes[i];
+        *hash *= 1099511628211ULL;
+    }
+}
+
+// Hashes everything about `t` but the values of its DATUM terms, and counts its
+// terms.
+static void hash_shape(const Term &t, uint64_t *hash, size_t *num_terms) {
+    ++*num_terms;
+    const int32_t type = t.type();
+    hash_bytes(&type, sizeof(type), hash);
+    if (t.type() == Term::DATUM) {
+        return;
+    }
+    const int32_t num_args = t.args_size();
+    hash_bytes(&num_args, sizeof(num_args), hash);
+    for (int i = 0; i < t.args_size(); ++i) {
+        hash_shape(t.args(i), hash, num_terms);
+    }
+    const int32_t num_optargs = t.optargs_size();
+    hash_bytes(&num_optargs, sizeof(num_optargs), hash);
+    for (int i = 0; i < t.optargs_size(); ++i) {
+        const std::string &key = t.optargs(i).key();
+        const uint64_t key_size = key.size();
+        hash_bytes(&key_size, sizeof(key_size), hash);
+        hash_bytes(key.data(), key.size(), hash);
+        hash_shape(t.optargs(i).val(), hash, num_terms);
+    }
+}
+
+static bool same_shape(const Term &a, const Term &b) {
+    if (a.type() != b.type()) {
+        return false;
+    }
+    if (a.type() == Term::DATUM) {
+        return true;
+    }
+    if (a.args_size() != b.args_size() || a.optargs_size() != b.optargs_size()) {
+        return false;
+    }
+    for (int i = 0; i < a.args_size(); ++i) {
+        if (!same_shape(a.args(i), b.args(i))) {
+            return false;
+        }
+    }
+    for (int i = 0; i < a.optargs_size(); ++i) {
+        if (a.optargs(i).key() != b.optargs(i).key()
+            || !same_shape(a.optargs(i).val(), b.optargs(i).val())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Finds the DATUM terms of `t`, in an order that only depends on its shape.
+static void get_datums(const Term &t, std::vector<const Term *> *out) {
+    if (t.type() == Term::DATUM) {
+        out->push_back(&t);
+        return;
+    }
+    for (int i = 0; i < t.args_size(); ++i) {
+        get_datums(t.args(i), out);
+    }
+    for (int i = 0; i < t.optargs_size(); ++i) {
+        get_datums(t.optargs(i).val(), out);
+    }
+}
+
+term_cache_t::term_cache_t() { }
+
+term_cache_t::~term_cache_t() { }
+
+counted_t<term_t> term_cache_t::compile(const protob_t<Query> &q) {
+    checked_out.reset();
+
+    uint64_t shape_hash = 14695981039346656037ULL;
+    size_t num_terms = 0;
+    hash_shape(q->query(), &shape_hash, &num_terms);
+    if (num_terms > TERM_CACHE_MAX_QUERY_TERMS) {
+        compile_env_t compile_env((var_visibility_t()));
+        return compile_term(&compile_env, q.make_child(q->mutable_query()));
+    }
+
+    if (bind(*q, shape_hash)) {
+        return checked_out->root;
+    }
+
+    scoped_ptr_t<entry_t> entry(new entry_t);
+    entry->shape_hash = shape_hash;
+    entry->query = q;
+    datum_terms_t datum_terms;
+    compile_env_t compile_env((var_visibility_t()), &datum_terms);
+    entry->root = compile_term(&compile_env, q.make_child(q->mutable_query()));
+
+    std::vector<const Term *> datums;
+    get_datums(q->query(), &datums);
+    entry->datums.resize(datums.size());
+    for (size_t i = 0; i < datums.size(); ++i) {
+        entry->datums[i].first = datums[i];
+        auto range = datum_terms.equal_range(datums[i]);
+        for (auto it = range.first; it != range.second; ++it) {
+            entry->datums[i].second.push_back(it->second);
+        }
+    }
+
+    checked_out.init(entry.release());
+    return checked_out->root;
+}
+
+bool term_cache_t::bind(const Query &q, uint64_t shape_hash) {
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->shape_hash != shape_hash
+            || !same_shape(it->query->query(), q.query())) {
+            continue;
+        }
+        std::vector<const Term *> datums;
+        get_datums(q.query(), &datums);
+        guarantee(datums.size() == it->datums.size());
+
+        // The constants no DATUM term was compiled from have to be the same.
+        bool same_constants = true;
+        for (size_t i = 0; i < datums.size() && same_constants; ++i) {
+            same_constants = !it->datums[i].second.empty()
+                || (it->datums[i].first->datum().SerializeAsString()
+                    == datums[i]->datum().SerializeAsString());
+        }
+        if (!same_constants) {
+            continue;
+        }
+
+        // If a constant turns out to be invalid, the tree is left half bound, so
+        // it's dropped.
+        scoped_ptr_t<entry_t> entry(entries.release(it).release());
+        for (size_t i = 0; i < datums.size(); ++i) {
+            if (entry->datums[i].second.empty()) {
+                continue;
+            }
+            // The `Term` is part of `entry->query`, which we own.
+            const_cast<Term *>(entry->datums[i].first)->mutable_datum()->CopyFrom(
+                datums[i]->datum());
+            for (auto jt = entry->datums[i].second.begin();
+                 jt != entry->datums[i].second.end();
+                 ++jt) {
+                reset_datum_term(jt->get());
+            }
+        }
+        checked_out.init(entry.release());
+        return true;
+    }
+    return false;
+}
+
+void term_cache_t::put_back(const counted_t<term_t> &root) {
+    if (!checked_out.has() || checked_out->root.get() != root.get()) {
+        return;
+    }
+    entries.push_front(checked_out.release());
+    while (entries.size() > TERM_CACHE_SIZE) {
+        entries.pop_back();
+    }
+}
+
+}  // namespace ql
@@ -0,0 +1,73 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_TERM_CACHE_HPP_
+#define RDB_PROTOCOL_TERM_CACHE_HPP_
+
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include <boost/ptr_container/ptr_list.hpp>
+
+#include "containers/counted.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/counted_term.hpp"
+
+namespace ql {
+
+class term_t;
+
+/* Keeps the compiled term trees of a connection's recent queries, so that a query of
+the same shape as one of them -- the same terms, differing only in the values of
+DATUM terms -- can reuse its tree instead of being compiled again.  The new query's
+constants get copied into the cached query's `Term`s, and the compiled DATUM terms
+re-read them from there.  (Everything that looks at a term's `Term` later, like
+functions sent to the shards, then sees the new constants too.)
+
+Constants that the terms read from their `Term`s while they are compiled, rather
+than by compiling a DATUM term, are part of the shape.  A term must not copy its
+arguments' `Term`s when it is compiled and compile the copy (see
+`obj_or_seq_op_term_t`), because the copy would keep the old constants.
+
+A tree is taken out of the cache while a query evaluates it.  It only goes back if
+nothing from the evaluation outlives the query, since binding another query's
+constants would change what a cursor still reading from it sees. */
+class term_cache_t {
+public:
+    term_cache_t();
+    ~term_cache_t();
+
+    // Compiles `q`'s (preprocessed) query, or binds its constants into a cached tree
+    // of the same shape.  Throws what `compile_term` throws.
+    counted_t<term_t> compile(const protob_t<Query> &q);
+
+    // Offers the tree the last call to `compile` returned back to the cache.  Only
+    // call this once nothing from its evaluation is still around.
+    void put_back(const counted_t<term_t> &root);
+
+private:
+    struct entry_t {
+        uint64_t shape_hash;
+        // The query the compiled terms point into.
+        protob_t<Query> query;
+        counted_t<term_t> root;
+        // The query's DATUM `Term`s in the order `get_datums` finds them, and the
+        // DATUM terms compiled from each (none if its value is part of the shape).
+        std::vector<std::pair<const Term *, std::vector<counted_t<term_t> > > > datums;
+    };
+
+    // If the cache has a tree of `q`'s shape, binds `q`'s constants into it and
+    // checks it out.
+    MUST_USE bool bind(const Query &q, uint64_t shape_hash);
+
+    // Most recently used first.
+    boost::ptr_list<entry_t> entries;
+    // The tree the last call to `compile` returned, if it can be cached.
+    scoped_ptr_t<entry_t> checked_out;
+
+    DISABLE_COPYING(term_cache_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_TERM_CACHE_HPP_
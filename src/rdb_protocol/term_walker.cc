@@ -193,6 +193,7 @@ private:
         case Term::UPCASE:
         case Term::DOWNCASE:
         case Term::SAMPLE:
+        case Term::CHANGES:
         case Term::IS_EMPTY:
         case Term::DEFAULT:
         case Term::CONTAINS:
@@ -361,6 +362,7 @@ private:
         case Term::UPCASE:
         case Term::DOWNCASE:
         case Term::SAMPLE:
+        case Term::CHANGES:
         case Term::IS_EMPTY:
         case Term::DEFAULT:
         case Term::CONTAINS:
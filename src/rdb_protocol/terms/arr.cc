@@ -227,7 +227,7 @@ private:
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         counted_t<const datum_t> arr = arg(env, 0)->as_datum();
         counted_t<const datum_t> new_el = arg(env, 1)->as_datum();
-        std::set<counted_t<const datum_t> > el_set;
+        datum_hash_set_t el_set;
         datum_ptr_t out(datum_t::R_ARRAY);
         for (size_t i = 0; i < arr->size(); ++i) {
             if (el_set.insert(arr->get(i)).second) {
@@ -252,7 +252,7 @@ private:
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         counted_t<const datum_t> arr1 = arg(env, 0)->as_datum();
         counted_t<const datum_t> arr2 = arg(env, 1)->as_datum();
-        std::set<counted_t<const datum_t> > el_set;
+        datum_hash_set_t el_set;
         datum_ptr_t out(datum_t::R_ARRAY);
         for (size_t i = 0; i < arr1->size(); ++i) {
             if (el_set.insert(arr1->get(i)).second) {
@@ -279,7 +279,7 @@ private:
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         counted_t<const datum_t> arr1 = arg(env, 0)->as_datum();
         counted_t<const datum_t> arr2 = arg(env, 1)->as_datum();
-        std::set<counted_t<const datum_t> > el_set;
+        datum_hash_set_t el_set;
         datum_ptr_t out(datum_t::R_ARRAY);
         for (size_t i = 0; i < arr1->size(); ++i) {
             el_set.insert(arr1->get(i));
@@ -305,7 +305,7 @@ private:
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         counted_t<const datum_t> arr1 = arg(env, 0)->as_datum();
         counted_t<const datum_t> arr2 = arg(env, 1)->as_datum();
-        std::set<counted_t<const datum_t> > el_set;
+        datum_hash_set_t el_set;
         datum_ptr_t out(datum_t::R_ARRAY);
         for (size_t i = 0; i < arr2->size(); ++i) {
             el_set.insert(arr2->get(i));
@@ -11,6 +11,9 @@ class datum_term_t : public term_t {
 public:
     explicit datum_term_t(protob_t<const Term> t)
         : term_t(t), raw_val(new_val(make_counted<const datum_t>(&t->datum()))) { }
+    void reset() {
+        raw_val = new_val(make_counted<const datum_t>(&get_src()->datum()));
+    }
 private:
     virtual void accumulate_captures(var_captures_t *) const { /* do nothing */ }
     virtual bool is_deterministic() const { return true; }
@@ -80,6 +83,11 @@ private:
 counted_t<term_t> make_datum_term(const protob_t<const Term> &term) {
     return make_counted<datum_term_t>(term);
 }
+void reset_datum_term(term_t *term) {
+    datum_term_t *datum_term = dynamic_cast<datum_term_t *>(term);
+    guarantee(datum_term != NULL);
+    datum_term->reset();
+}
 counted_t<term_t> make_constant_term(compile_env_t *env, const protob_t<const Term> &term,
                                      double constant, const char *name) {
     return make_counted<constant_term_t>(env, term, constant, name);
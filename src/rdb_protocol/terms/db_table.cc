@@ -3,11 +3,16 @@
 
 #include <map>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "clustering/administration/main/ports.hpp"
 #include "clustering/administration/suggester.hpp"
 #include "containers/wire_string.hpp"
+#include "rdb_protocol/func.hpp"
 #include "rdb_protocol/meta_utils.hpp"
+#include "rdb_protocol/minidriver.hpp"
 #include "rdb_protocol/op.hpp"
 #include "rpc/directory/read_manager.hpp"
 
@@ -191,8 +196,12 @@ private:
             }
         }
 
-        const bool hard_durability
-            = is_hard(parse_durability_optarg(optarg(env, "durability"), this));
+        const durability_requirement_t durability
+            = parse_durability_optarg(optarg(env, "durability"), this);
+        // Tables only know hard and soft durability.
+        rcheck(durability != DURABILITY_REQUIREMENT_GROUP_SOFT, base_exc_t::GENERIC,
+               "Durability option `group_soft` is only supported for writes.");
+        const bool hard_durability = is_hard(durability);
 
         std::string primary_key = "id";
         if (counted_t<val_t> v = optarg(env, "primary_key")) {
@@ -454,11 +463,13 @@ private:
 class table_term_t : public op_term_t {
 public:
     table_term_t(compile_env_t *env, const protob_t<const Term> &term)
-        : op_term_t(env, term, argspec_t(1, 2), optargspec_t({ "use_outdated" })) { }
+        : op_term_t(env, term, argspec_t(1, 2), optargspec_t({ "use_outdated", "result_cache" })) { }
 private:
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         counted_t<val_t> t = optarg(env, "use_outdated");
         bool use_outdated = t ? t->as_bool() : false;
+        counted_t<val_t> rc = optarg(env, "result_cache");
+        bool use_result_cache = rc ? rc->as_bool() : false;
         counted_t<const db_t> db;
         std::string name;
         if (num_args() == 1) {
@@ -472,7 +483,8 @@ private:
             name = arg(env, 1)->as_str().to_std();
         }
         return new_val(make_counted<table_t>(
-                           env->env, db, name, use_outdated, backtrace()));
+                           env->env, db, name, use_outdated, use_result_cache,
+                           backtrace()));
     }
     virtual bool is_deterministic() const { return false; }
     virtual const char *name() const { return "table"; }
@@ -512,12 +524,19 @@ private:
                 = make_counted<union_datum_stream_t>(std::move(streams), backtrace());
             return new_val(stream, table);
         } else {
-            datum_ptr_t arr(datum_t::R_ARRAY);
+            std::vector<counted_t<const datum_t> > keys;
+            keys.reserve(num_args() - 1);
             for (size_t i = 1; i < num_args(); ++i) {
-                counted_t<const datum_t> key = arg(env, i)->as_datum();
-                counted_t<const datum_t> row = table->get_row(env->env, key);
-                if (row->get_type() != datum_t::R_NULL) {
-                    arr.add(row);
+                keys.push_back(arg(env, i)->as_datum());
+            }
+            // The rows are read all at once, rather than one point read at a time.
+            std::map<store_key_t, counted_t<const datum_t> > rows
+                = table->get_rows(env->env, keys);
+            datum_ptr_t arr(datum_t::R_ARRAY);
+            for (auto it = keys.begin(); it != keys.end(); ++it) {
+                auto row = rows.find(store_key_t((*it)->print_primary()));
+                if (row != rows.end()) {
+                    arr.add(row->second);
                 }
             }
             counted_t<datum_stream_t> stream
@@ -528,6 +547,170 @@ private:
     virtual const char *name() const { return "get_all"; }
 };
 
+class changes_term_t : public op_term_t {
+public:
+    changes_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : op_term_t(env, term, argspec_t(1)) { }
+private:
+    virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
+        counted_t<table_t> table = arg(env, 0)->as_table();
+        return new_val(env->env, table->changes(env->env, backtrace()));
+    }
+    virtual bool is_deterministic() const { return false; }
+    virtual const char *name() const { return "changes"; }
+};
+
+// Joins each row of a stream with the rows of `table` whose `index` equals the row's
+// `left_attr` field.  The rows of each batch are looked up together: with one
+// batched read for the primary key, and with one read per distinct key otherwise.
+class eq_join_datum_stream_t : public wrapper_datum_stream_t {
+public:
+    eq_join_datum_stream_t(counted_t<datum_stream_t> _source,
+                           const std::string &_left_attr,
+                           counted_t<table_t> _table,
+                           const std::string &_index)
+        : wrapper_datum_stream_t(_source), left_attr(_left_attr),
+          table(_table), index(_index) { }
+private:
+    virtual std::vector<counted_t<const datum_t> >
+    next_raw_batch(env_t *env, const batchspec_t &batchspec) {
+        std::vector<counted_t<const datum_t> > ret;
+        profile::sampler_t sampler("Joining eagerly.", env->trace);
+        while (ret.size() == 0) {
+            std::vector<counted_t<const datum_t> > left_rows
+                = source->next_batch(env, batchspec);
+            if (left_rows.size() == 0) {
+                break;
+            }
+            std::vector<counted_t<const datum_t> > keys;
+            keys.reserve(left_rows.size());
+            for (auto it = left_rows.begin(); it != left_rows.end(); ++it) {
+                keys.push_back((*it)->get(left_attr));
+            }
+            if (index == table->get_pkey()) {
+                join_primary(env, left_rows, keys, &ret, &sampler);
+            } else {
+                join_sindex(env, left_rows, keys, &ret, &sampler);
+            }
+        }
+        return ret;
+    }
+
+    static counted_t<const datum_t> joined(counted_t<const datum_t> left,
+                                           counted_t<const datum_t> right) {
+        datum_ptr_t obj(datum_t::R_OBJECT);
+        UNUSED bool b1 = obj.add("left", left);
+        UNUSED bool b2 = obj.add("right", right);
+        return obj.to_counted();
+    }
+
+    void join_primary(env_t *env,
+                      const std::vector<counted_t<const datum_t> > &left_rows,
+                      const std::vector<counted_t<const datum_t> > &keys,
+                      std::vector<counted_t<const datum_t> > *out,
+                      profile::sampler_t *sampler) {
+        std::map<store_key_t, counted_t<const datum_t> > rows
+            = table->get_rows(env, keys);
+        for (size_t i = 0; i < left_rows.size(); ++i) {
+            auto row = rows.find(store_key_t(keys[i]->print_primary()));
+            if (row != rows.end()) {
+                out->push_back(joined(left_rows[i], row->second));
+            }
+            sampler->new_sample();
+        }
+    }
+
+    void join_sindex(env_t *env,
+                     const std::vector<counted_t<const datum_t> > &left_rows,
+                     const std::vector<counted_t<const datum_t> > &keys,
+                     std::vector<counted_t<const datum_t> > *out,
+                     profile::sampler_t *sampler) {
+        std::unordered_map<counted_t<const datum_t>,
+                           std::vector<counted_t<const datum_t> >,
+                           datum_hasher_t, datum_equal_t> rows;
+        batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
+        for (auto it = keys.begin(); it != keys.end(); ++it) {
+            auto res = rows.insert(
+                std::make_pair(*it, std::vector<counted_t<const datum_t> >()));
+            if (!res.second) {
+                continue;
+            }
+            counted_t<datum_stream_t> stream
+                = table->get_all(env, *it, index, backtrace());
+            for (;;) {
+                std::vector<counted_t<const datum_t> > batch
+                    = stream->next_batch(env, batchspec);
+                if (batch.size() == 0) {
+                    break;
+                }
+                res.first->second.insert(
+                    res.first->second.end(), batch.begin(), batch.end());
+            }
+        }
+        for (size_t i = 0; i < left_rows.size(); ++i) {
+            const std::vector<counted_t<const datum_t> > &matches
+                = rows.find(keys[i])->second;
+            for (auto it = matches.begin(); it != matches.end(); ++it) {
+                out->push_back(joined(left_rows[i], *it));
+            }
+            sampler->new_sample();
+        }
+    }
+
+    const std::string left_attr;
+    const counted_t<table_t> table;
+    const std::string index;
+};
+
+class eq_join_term_t : public op_term_t {
+public:
+    eq_join_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : op_term_t(env, term, argspec_t(3), optargspec_t({ "index" })) { }
+private:
+    virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
+        counted_t<datum_stream_t> left = arg(env, 0)->as_seq(env->env);
+        if (left->is_grouped()) {
+            // Each group is joined by mapping it, the way `eq_join` used to be
+            // rewritten.
+            return new_val(env->env, left->add_transformation(
+                env->env, concatmap_wire_func_t(join_func(env)), backtrace()));
+        }
+        std::string left_attr = arg(env, 1)->as_str().to_std();
+        counted_t<table_t> table = arg(env, 2)->as_table();
+        counted_t<val_t> index = optarg(env, "index");
+        std::string index_str = index ? index->as_str().to_std() : table->get_pkey();
+        return new_val(env->env, make_counted<eq_join_datum_stream_t>(
+            left, left_attr, table, index_str));
+    }
+
+    // `row -> right.get_all(row(left_attr), index).map(v -> {left: row, right: v})`,
+    // built from the term when it's needed (see `obj_or_seq_op_term_t`).
+    counted_t<func_t> join_func(scope_env_t *env) const {
+        auto row = pb::dummy_var_t::EQJOIN_ROW;
+        auto v = pb::dummy_var_t::EQJOIN_V;
+        const protob_t<const Term> term = get_src();
+
+        r::reql_t get_all =
+            r::expr(term->args(2)).get_all(
+                r::expr(term->args(1))(
+                    row, r::optarg("_SHORTCUT_", GET_FIELD_SHORTCUT)));
+        get_all.copy_optargs_from_term(*term);
+
+        protob_t<Term> func =
+            r::fun(row,
+                std::move(get_all).map(
+                    r::fun(v,
+                        r::object(r::optarg("left", row),
+                                  r::optarg("right", v))))).release_counted();
+        prop_bt(func.get());
+
+        compile_env_t compile_env(env->scope.compute_visibility());
+        counted_t<func_term_t> func_term = make_counted<func_term_t>(&compile_env, func);
+        return func_term->eval_to_func(env->scope);
+    }
+    virtual const char *name() const { return "eq_join"; }
+};
+
 counted_t<term_t> make_db_term(compile_env_t *env, const protob_t<const Term> &term) {
     return make_counted<db_term_t>(env, term);
 }
@@ -544,6 +727,14 @@ counted_t<term_t> make_get_all_term(compile_env_t *env, const protob_t<const Ter
     return make_counted<get_all_term_t>(env, term);
 }
 
+counted_t<term_t> make_changes_term(compile_env_t *env, const protob_t<const Term> &term) {
+    return make_counted<changes_term_t>(env, term);
+}
+
+counted_t<term_t> make_eq_join_term(compile_env_t *env, const protob_t<const Term> &term) {
+    return make_counted<eq_join_term_t>(env, term);
+}
+
 counted_t<term_t> make_db_create_term(compile_env_t *env, const protob_t<const Term> &term) {
     return make_counted<db_create_term_t>(env, term);
 }
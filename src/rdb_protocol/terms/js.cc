@@ -2,6 +2,7 @@
 #include <stdint.h>
 
 #include <string>
+#include <utility>
 
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/func.hpp"
@@ -32,6 +33,16 @@ private:
 
         std::string source = arg(env, 0)->as_datum()->as_str().to_std();
 
+        // A function simple enough to translate into terms doesn't need a worker to
+        // be evaluated, and won't need one for most rows either.  (It's translated
+        // here rather than when the term is compiled, because the term cache can
+        // change `source`.)
+        counted_t<js_func_t> translated
+            = make_counted<js_func_t>(source, timeout_ms, backtrace());
+        if (translated->is_translated()) {
+            return new_val(counted_t<func_t>(std::move(translated)));
+        }
+
         // JS runner configuration is limited to setting an execution timeout.
         js_runner_t::req_config_t config;
         config.timeout_ms = timeout_ms;
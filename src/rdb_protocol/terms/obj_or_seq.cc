@@ -26,17 +26,46 @@ public:
     obj_or_seq_op_term_t(compile_env_t *env, protob_t<const Term> term,
                          poly_type_t _poly_type, argspec_t argspec)
         : grouped_seq_op_term_t(env, term, argspec, optargspec_t({"_NO_RECURSE_"})),
-          poly_type(_poly_type), func(make_counted_term()) {
+          poly_type(_poly_type) { }
+protected:
+    // Evaluates the arguments after the first into an array of paths.
+    counted_t<const datum_t> paths_arg(scope_env_t *env) {
+        const size_t n = num_args();
+        std::vector<counted_t<const datum_t> > paths;
+        paths.reserve(n - 1);
+        for (size_t i = 1; i < n; ++i) {
+            paths.push_back(arg(env, i)->as_datum());
+        }
+        return make_counted<const datum_t>(std::move(paths));
+    }
 
+private:
+    virtual counted_t<val_t> obj_eval(scope_env_t *env, counted_t<val_t> v0) = 0;
+
+    // Terms that can be applied to the rows of a sequence by a
+    // `project_wire_func_t` (rather than by calling a function on each row) return
+    // it here.  It only gets called if the arguments are deterministic, because
+    // they're evaluated once instead of once per row.
+    virtual boost::optional<project_wire_func_t> seq_projection(
+        UNUSED scope_env_t *env) {
+        return boost::none;
+    }
+
+    // Builds the function this term applies to each row of a sequence.  (It's
+    // built from the term when it's needed, rather than when the term is compiled,
+    // so that it sees the constants the term cache may have bound into the term.)
+    protob_t<Term> make_func() const {
         auto varnum = pb::dummy_var_t::OBJORSEQ_VARNUM;
 
         // body is a new reql expression similar to term except that the first argument
         // is replaced by a new variable.
         // For example, foo.pluck('a') becomes varnum.pluck('a')
+        const protob_t<const Term> term = get_src();
         r::reql_t body = r::var(varnum).call(term->type());
         body.copy_args_from_term(*term, 1);
         body.add_arg(r::optarg("_NO_RECURSE_", r::boolean(true)));
 
+        protob_t<Term> func = make_counted_term();
         switch (poly_type) {
         case MAP: {
             func->Swap(&r::fun(varnum, std::move(body)).get());
@@ -52,9 +81,8 @@ public:
         }
 
         prop_bt(func.get());
+        return func;
     }
-private:
-    virtual counted_t<val_t> obj_eval(scope_env_t *env, counted_t<val_t> v0) = 0;
 
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         counted_t<val_t> v0 = arg(env, 0);
@@ -77,9 +105,17 @@ private:
                                  name()));
             }
 
+            if (args_are_deterministic(1)) {
+                if (boost::optional<project_wire_func_t> projection
+                    = seq_projection(env)) {
+                    return new_val(env->env, v0->as_seq(env->env)->add_transformation(
+                        env->env, std::move(*projection), backtrace()));
+                }
+            }
+
             compile_env_t compile_env(env->scope.compute_visibility());
             counted_t<func_term_t> func_term
-                = make_counted<func_term_t>(&compile_env, func);
+                = make_counted<func_term_t>(&compile_env, make_func());
             counted_t<func_t> f = func_term->eval_to_func(env->scope);
 
             switch (poly_type) {
@@ -102,7 +138,6 @@ private:
     }
 
     poly_type_t poly_type;
-    protob_t<Term> func;
 };
 
 class pluck_term_t : public obj_or_seq_op_term_t {
@@ -114,15 +149,16 @@ private:
         counted_t<const datum_t> obj = v0->as_datum();
         r_sanity_check(obj->get_type() == datum_t::R_OBJECT);
 
-        const size_t n = num_args();
-        std::vector<counted_t<const datum_t> > paths;
-        paths.reserve(n - 1);
-        for (size_t i = 1; i < n; ++i) {
-            paths.push_back(arg(env, i)->as_datum());
-        }
-        pathspec_t pathspec(make_counted<const datum_t>(std::move(paths)), this);
+        pathspec_t pathspec(paths_arg(env), this);
         return new_val(project(obj, pathspec, DONT_RECURSE));
     }
+    virtual boost::optional<project_wire_func_t> seq_projection(scope_env_t *env) {
+        counted_t<const datum_t> paths = paths_arg(env);
+        // This checks that the paths are valid, so that the shards don't have to.
+        pathspec_t pathspec(paths, this);
+        return project_wire_func_t(project_wire_func_t::kind_t::PLUCK, paths,
+                                   backtrace());
+    }
     virtual const char *name() const { return "pluck"; }
 };
 
@@ -135,15 +171,16 @@ private:
         counted_t<const datum_t> obj = v0->as_datum();
         r_sanity_check(obj->get_type() == datum_t::R_OBJECT);
 
-        std::vector<counted_t<const datum_t> > paths;
-        const size_t n = num_args();
-        paths.reserve(n - 1);
-        for (size_t i = 1; i < n; ++i) {
-            paths.push_back(arg(env, i)->as_datum());
-        }
-        pathspec_t pathspec(make_counted<const datum_t>(std::move(paths)), this);
+        pathspec_t pathspec(paths_arg(env), this);
         return new_val(unproject(obj, pathspec, DONT_RECURSE));
     }
+    virtual boost::optional<project_wire_func_t> seq_projection(scope_env_t *env) {
+        counted_t<const datum_t> paths = paths_arg(env);
+        // This checks that the paths are valid, so that the shards don't have to.
+        pathspec_t pathspec(paths, this);
+        return project_wire_func_t(project_wire_func_t::kind_t::WITHOUT, paths,
+                                   backtrace());
+    }
     virtual const char *name() const { return "without"; }
 };
 
@@ -225,6 +262,12 @@ private:
     virtual counted_t<val_t> obj_eval(scope_env_t *env, counted_t<val_t> v0) {
         return new_val(v0->as_datum()->get(arg(env, 1)->as_str().to_std()));
     }
+    virtual boost::optional<project_wire_func_t> seq_projection(scope_env_t *env) {
+        counted_t<const datum_t> field
+            = make_counted<const datum_t>(arg(env, 1)->as_str().to_std());
+        return project_wire_func_t(project_wire_func_t::kind_t::GET_FIELD, field,
+                                   backtrace());
+    }
     virtual const char *name() const { return "get_field"; }
 };
 
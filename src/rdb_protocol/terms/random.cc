@@ -23,6 +23,22 @@ public:
         counted_t<datum_stream_t> seq;
         counted_t<val_t> v = arg(env, 0);
 
+        // The shards of a whole table can sample their rows without reading them
+        // all.
+        if (v->get_type().get_raw_type() == val_t::type_t::TABLE) {
+            t = v->as_table();
+            boost::optional<std::vector<counted_t<const datum_t> > > rows;
+            {
+                profile::sampler_t sampler("Sampling rows.", env->env->trace);
+                rows = t->sample(env->env, num);
+            }
+            if (rows) {
+                counted_t<datum_stream_t> new_ds(new array_datum_stream_t(
+                    make_counted<const datum_t>(std::move(*rows)), backtrace()));
+                return new_val(new_ds, t);
+            }
+        }
+
         if (v->get_type().is_convertible(val_t::type_t::SELECTION)) {
             std::pair<counted_t<table_t>, counted_t<datum_stream_t> > t_seq
                 = v->as_selection(env->env);
@@ -172,6 +172,27 @@ private:
             defval = wire_func_t(default_filter_term->eval_to_func(env->scope));
         }
 
+        // A filter on a field that a secondary index covers only reads the rows
+        // with the right secondary key.  Rows without the field match neither way,
+        // but with a default value they would, so then the table is scanned.  The
+        // filter still runs on the rows read.
+        std::string field;
+        counted_t<const datum_t> value;
+        if (v0->get_type().get_raw_type() == val_t::type_t::TABLE
+            && !default_filter_term.has()
+            && f->is_get_field_eq_constant(&field, &value)) {
+            counted_t<table_t> table = v0->as_table();
+            boost::optional<std::string> sindex
+                = table->find_field_sindex(env->env, field);
+            if (sindex) {
+                counted_t<datum_stream_t> stream
+                    = table->get_all(env->env, value, *sindex, backtrace());
+                return new_val(stream->add_transformation(
+                                   env->env, filter_wire_func_t(f, defval), backtrace()),
+                               table);
+            }
+        }
+
         if (v0->get_type().is_convertible(val_t::type_t::SELECTION)) {
             std::pair<counted_t<table_t>, counted_t<datum_stream_t> > ts
                 = v0->as_selection(env->env);
@@ -1,12 +1,19 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/terms/terms.hpp"
 
+#include <algorithm>
+#include <functional>
+#include <limits>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "errors.hpp"
 #include <boost/bind.hpp>
 
+#include "concurrency/parallel_for.hpp"
+#include "containers/disk_backed_queue.hpp"
+#include "containers/uuid.hpp"
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/func.hpp"
@@ -51,12 +58,11 @@ public:
         : op_term_t(env, term, argspec_t(1, -1),
           optargspec_t({"index"})), src_term(term) { }
 private:
-    enum order_direction_t { ASC, DESC };
     class lt_cmp_t {
     public:
         typedef bool result_type;
         explicit lt_cmp_t(
-            std::vector<std::pair<order_direction_t, counted_t<func_t> > > _comparisons)
+            std::vector<std::pair<sort_direction_t, counted_t<func_t> > > _comparisons)
             : comparisons(std::move(_comparisons)) { }
 
         bool operator()(env_t *env,
@@ -65,58 +71,303 @@ private:
                         counted_t<const datum_t> r) const {
             sampler->new_sample();
             for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
-                counted_t<const datum_t> lval;
-                counted_t<const datum_t> rval;
-                try {
-                    lval = it->second->call(env, l)->as_datum();
-                } catch (const base_exc_t &e) {
-                    if (e.get_type() != base_exc_t::NON_EXISTENCE) {
-                        throw;
-                    }
+                std::string lkey, rkey;
+                append_sort_key(it->first, sort_key(env, it->second, l), &lkey);
+                append_sort_key(it->first, sort_key(env, it->second, r), &rkey);
+                const int cmp = lkey.compare(rkey);
+                if (cmp != 0) {
+                    return cmp < 0;
                 }
+            }
+            return false;
+        }
 
-                try {
-                    rval = it->second->call(env, r)->as_datum();
-                } catch (const base_exc_t &e) {
-                    if (e.get_type() != base_exc_t::NON_EXISTENCE) {
-                        throw;
-                    }
+        // The sort key of `row`, made from the values of all the comparison
+        // functions.  Rows' keys compare with `memcmp`, so unlike `operator()`
+        // that can be done on any thread.
+        std::string key(env_t *env, counted_t<const datum_t> row) const {
+            std::string ret;
+            for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
+                append_sort_key(it->first, sort_key(env, it->second, row), &ret);
+            }
+            return ret;
+        }
+
+        const std::vector<std::pair<sort_direction_t, counted_t<func_t> > > &
+        get_comparisons() const {
+            return comparisons;
+        }
+
+    private:
+        std::vector<std::pair<sort_direction_t, counted_t<func_t> > > comparisons;
+    };
+
+    // Sorts `rows` (emptying it) and returns them along with their keys.
+    static std::vector<keyed_row_t> sort_rows(
+            env_t *env, const lt_cmp_t &lt_cmp,
+            std::vector<counted_t<const datum_t> > *rows) {
+        profile::sampler_t sampler("Sorting in-memory.", env->trace);
+        // The comparison functions can only run here, so each row's key is computed
+        // once up front, and then the rows are sorted by their keys, which can be
+        // done on all the threads.
+        std::vector<keyed_row_t> keyed_rows;
+        keyed_rows.reserve(rows->size());
+        for (auto it = rows->begin(); it != rows->end(); ++it) {
+            keyed_rows.push_back(keyed_row_t(lt_cmp.key(env, *it), std::move(*it)));
+            sampler.new_sample();
+        }
+        rows->clear();
+        parallel_sort(keyed_rows.begin(), keyed_rows.end(), std::less<keyed_row_t>());
+        return keyed_rows;
+    }
+
+    // The sorted runs of a sort that's too big to do in memory.  Every run but the
+    // last one is written to a temporary file, and `next` merges them.
+    class sorted_runs_t {
+    public:
+        sorted_runs_t() { }
+
+        void add_disk_run(env_t *env, std::vector<keyed_row_t> &&rows) {
+            r_sanity_check(env->io_backender != NULL && env->temp_path);
+            r_sanity_check(memory_run.empty());
+            profile::sampler_t sampler("Writing a sorted run to disk.", env->trace);
+            scoped_ptr_t<disk_backed_queue_t<keyed_row_t> > run(
+                new disk_backed_queue_t<keyed_row_t>(
+                    env->io_backender,
+                    serializer_filepath_t(*env->temp_path,
+                                          "orderby_" + uuid_to_str(generate_uuid())),
+                    &perfmon_collection));
+            run->push_many(rows.begin(), rows.end());
+            disk_runs.push_back(std::move(run));
+        }
+
+        // Must be called once, after all the disk runs have been added.
+        void add_memory_run(std::vector<keyed_row_t> &&rows) {
+            memory_run = std::move(rows);
+            memory_run_index = 0;
+            for (size_t i = 0; i <= disk_runs.size(); ++i) {
+                head_t head;
+                head.run = i;
+                if (pop(i, &head.row)) {
+                    heads.push_back(std::move(head));
                 }
+            }
+            std::make_heap(heads.begin(), heads.end(), head_greater_t());
+        }
 
-                if (!lval.has() && !rval.has()) {
-                    continue;
+        bool empty() const { return heads.empty(); }
+
+        // Returns the smallest row left.
+        counted_t<const datum_t> next() {
+            r_sanity_check(!heads.empty());
+            std::pop_heap(heads.begin(), heads.end(), head_greater_t());
+            counted_t<const datum_t> ret = std::move(heads.back().row.row);
+            if (pop(heads.back().run, &heads.back().row)) {
+                std::push_heap(heads.begin(), heads.end(), head_greater_t());
+            } else {
+                heads.pop_back();
+            }
+            return ret;
+        }
+
+    private:
+        // The next row of each run that still has any, as a heap.
+        struct head_t {
+            keyed_row_t row;
+            // An index into `disk_runs`, or `disk_runs.size()` for the memory run.
+            size_t run;
+        };
+        class head_greater_t {
+        public:
+            bool operator()(const head_t &l, const head_t &r) const {
+                // Ties go to the earlier run, which keeps equal rows from
+                // different runs in the order they were read.
+                const int cmp = l.row.key.compare(r.row.key);
+                return cmp != 0 ? cmp > 0 : l.run > r.run;
+            }
+        };
+
+        bool pop(size_t run, keyed_row_t *out) {
+            if (run < disk_runs.size()) {
+                if (disk_runs[run]->empty()) {
+                    return false;
                 }
-                if (!lval.has()) {
-                    return true != (it->first == DESC);
+                disk_runs[run]->pop(out);
+                return true;
+            }
+            if (memory_run_index >= memory_run.size()) {
+                return false;
+            }
+            *out = std::move(memory_run[memory_run_index++]);
+            return true;
+        }
+
+        // The runs' files get deleted along with them.  Their stats don't go
+        // anywhere.
+        perfmon_collection_t perfmon_collection;
+        std::vector<scoped_ptr_t<disk_backed_queue_t<keyed_row_t> > > disk_runs;
+        std::vector<keyed_row_t> memory_run;
+        size_t memory_run_index;
+        std::vector<head_t> heads;
+
+        DISABLE_COPYING(sorted_runs_t);
+    };
+
+    // The result of a sort that was too big to do in memory, which merges the
+    // sorted runs as it's read.
+    class merge_datum_stream_t : public eager_datum_stream_t {
+    public:
+        merge_datum_stream_t(scoped_ptr_t<sorted_runs_t> &&_runs,
+                             const protob_t<const Backtrace> &bt)
+            : eager_datum_stream_t(bt), runs(std::move(_runs)) { }
+        virtual bool is_exhausted() const {
+            return runs->empty() && batch_cache_exhausted();
+        }
+    private:
+        virtual bool is_array() { return false; }
+        virtual counted_t<const datum_t> as_array(UNUSED env_t *env) {
+            return counted_t<const datum_t>();
+        }
+        virtual std::vector<counted_t<const datum_t> >
+        next_raw_batch(env_t *env, const batchspec_t &batchspec) {
+            std::vector<counted_t<const datum_t> > ret;
+            batcher_t batcher = batchspec.to_batcher();
+            profile::sampler_t sampler("Merging sorted runs.", env->trace);
+            while (!runs->empty() && !batcher.should_send_batch()) {
+                ret.push_back(runs->next());
+                batcher.note_el(ret.back());
+                sampler.new_sample();
+            }
+            return ret;
+        }
+
+        scoped_ptr_t<sorted_runs_t> runs;
+    };
+
+    // The result of an unindexed sort.  It isn't computed until it's first read,
+    // so that a `limit` (or `slice`) right after it can say how many rows it
+    // needs; then only that many are kept while sorting, and each shard of a table
+    // only sends back the first rows of its part.
+    class sort_datum_stream_t : public eager_datum_stream_t {
+    public:
+        sort_datum_stream_t(counted_t<datum_stream_t> _source,
+                            const lt_cmp_t &_lt_cmp,
+                            size_t _limit,
+                            const protob_t<const Backtrace> &bt)
+            : eager_datum_stream_t(bt),
+              source(std::move(_source)), lt_cmp(_lt_cmp), limit(_limit) { }
+        virtual bool is_exhausted() const {
+            return sorted.has() && sorted->is_exhausted() && batch_cache_exhausted();
+        }
+    private:
+        virtual counted_t<datum_stream_t> slice(size_t l, size_t r) {
+            if (!sorted.has() && !ops_to_do() && !is_grouped() && r < limit) {
+                return make_counted<sort_datum_stream_t>(source, lt_cmp, r,
+                                                         backtrace())
+                    ->datum_stream_t::slice(l, r);
+            }
+            return datum_stream_t::slice(l, r);
+        }
+        // A sort that was too big to do in memory isn't an array.
+        virtual bool is_array() { return !sorted.has() || sorted->is_array(); }
+        virtual counted_t<const datum_t> as_array(env_t *env) {
+            sort(env);
+            return sorted->is_array()
+                ? eager_datum_stream_t::as_array(env)
+                : counted_t<const datum_t>();
+        }
+        virtual std::vector<counted_t<const datum_t> >
+        next_raw_batch(env_t *env, const batchspec_t &batchspec) {
+            sort(env);
+            return sorted->next_batch(env, batchspec);
+        }
+
+        void sort(env_t *env) {
+            if (sorted.has()) {
+                return;
+            }
+            if (limit <= array_size_limit() && !source->is_grouped()) {
+                counted_t<val_t> top = source->run_terminal(
+                    env, orderby_limit_wire_func_t(lt_cmp.get_comparisons(), limit,
+                                                   backtrace()));
+                sorted = make_counted<array_datum_stream_t>(top->as_datum(),
+                                                            backtrace());
+                return;
+            }
+
+            std::vector<counted_t<const datum_t> > to_sort;
+            // The bytes of `to_sort` counted in `env->memory`.
+            int64_t to_sort_bytes = 0;
+            // Only used if there's more than fits in an array (or in the query's
+            // memory), in which case we sort each array's worth and merge them.
+            scoped_ptr_t<sorted_runs_t> runs;
+            batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
+            for (;;) {
+                std::vector<counted_t<const datum_t> > data
+                    = source->next_batch(env, batchspec);
+                if (data.size() == 0) {
+                    break;
+                }
+                int64_t data_bytes = 0;
+                for (auto it = data.begin(); it != data.end(); ++it) {
+                    data_bytes += serialized_size(*it);
+                }
+                std::move(data.begin(), data.end(), std::back_inserter(to_sort));
+                const bool in_memory = env->memory.try_charge(data_bytes);
+                if (in_memory) {
+                    to_sort_bytes += data_bytes;
                 }
-                if (!rval.has()) {
-                    return false != (it->first == DESC);
+                if (to_sort.size() > array_size_limit() || !in_memory) {
+                    if (env->io_backender == NULL || !env->temp_path) {
+                        rcheck(in_memory, base_exc_t::GENERIC,
+                               "Query uses too much memory to sort in memory.");
+                        rfail(base_exc_t::GENERIC, "Array over size limit %zu.",
+                              to_sort.size());
+                    }
+                    if (!runs.has()) {
+                        runs.init(new sorted_runs_t());
+                    }
+                    runs->add_disk_run(env, sort_rows(env, lt_cmp, &to_sort));
+                    env->memory.release(to_sort_bytes);
+                    to_sort_bytes = 0;
                 }
-                // TODO: use datum_t::cmp instead to be faster
-                if (*lval == *rval) {
-                    continue;
+            }
+            if (runs.has()) {
+                runs->add_memory_run(sort_rows(env, lt_cmp, &to_sort));
+                sorted = make_counted<merge_datum_stream_t>(std::move(runs),
+                                                            backtrace());
+            } else {
+                if (to_sort.size() > 1) {
+                    std::vector<keyed_row_t> keyed_rows
+                        = sort_rows(env, lt_cmp, &to_sort);
+                    to_sort.reserve(keyed_rows.size());
+                    for (auto it = keyed_rows.begin(); it != keyed_rows.end(); ++it) {
+                        to_sort.push_back(std::move(it->row));
+                    }
                 }
-                return (*lval < *rval) != (it->first == DESC);
+                sorted = make_counted<array_datum_stream_t>(
+                    make_counted<const datum_t>(std::move(to_sort)), backtrace());
             }
-
-            return false;
         }
 
-    private:
-        const std::vector<std::pair<order_direction_t, counted_t<func_t> > >
-            comparisons;
+        const counted_t<datum_stream_t> source;
+        const lt_cmp_t lt_cmp;
+        // How many rows are needed, if that's known.
+        const size_t limit;
+        counted_t<datum_stream_t> sorted;
     };
 
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
-        std::vector<std::pair<order_direction_t, counted_t<func_t> > > comparisons;
-        scoped_ptr_t<datum_t> arr(new datum_t(datum_t::R_ARRAY));
+        std::vector<std::pair<sort_direction_t, counted_t<func_t> > > comparisons;
         for (size_t i = 1; i < num_args(); ++i) {
             if (get_src()->args(i).type() == Term::DESC) {
                 comparisons.push_back(
-                        std::make_pair(DESC, arg(env, i)->as_func(GET_FIELD_SHORTCUT)));
+                    std::make_pair(sort_direction_t::DESC,
+                                   arg(env, i)->as_func(GET_FIELD_SHORTCUT)));
             } else {
                 comparisons.push_back(
-                        std::make_pair(ASC, arg(env, i)->as_func(GET_FIELD_SHORTCUT)));
+                    std::make_pair(sort_direction_t::ASC,
+                                   arg(env, i)->as_func(GET_FIELD_SHORTCUT)));
             }
         }
         lt_cmp_t lt_cmp(comparisons);
@@ -167,23 +418,8 @@ private:
             }
             rcheck(!comparisons.empty(), base_exc_t::GENERIC,
                    "Must specify something to order by.");
-            std::vector<counted_t<const datum_t> > to_sort;
-            batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
-            for (;;) {
-                std::vector<counted_t<const datum_t> > data
-                    = seq->next_batch(env->env, batchspec);
-                if (data.size() == 0) {
-                    break;
-                }
-                std::move(data.begin(), data.end(), std::back_inserter(to_sort));
-                rcheck(to_sort.size() <= array_size_limit(), base_exc_t::GENERIC,
-                       strprintf("Array over size limit %zu.", to_sort.size()).c_str());
-            }
-            profile::sampler_t sampler("Sorting in-memory.", env->env->trace);
-            auto fn = boost::bind(lt_cmp, env->env, &sampler, _1, _2);
-            std::sort(to_sort.begin(), to_sort.end(), fn);
-            seq = make_counted<array_datum_stream_t>(
-                make_counted<const datum_t>(std::move(to_sort)), backtrace());
+            seq = make_counted<sort_datum_stream_t>(
+                seq, lt_cmp, std::numeric_limits<size_t>::max(), backtrace());
         }
         return tbl.has() ? new_val(seq, tbl) : new_val(env->env, seq);
     }
@@ -199,35 +435,11 @@ public:
     distinct_term_t(compile_env_t *env, const protob_t<const Term> &term)
         : op_term_t(env, term, argspec_t(1)) { }
 private:
-    static bool lt_cmp(env_t *,
-                       counted_t<const datum_t> l,
-                       counted_t<const datum_t> r) {
-        return *l < *r;
-    }
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
-        counted_t<datum_stream_t> s = arg(env, 0)->as_seq(env->env);
-        std::vector<counted_t<const datum_t> > arr;
-        counted_t<const datum_t> last;
-        batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
-        {
-            profile::sampler_t sampler("Evaluating elements in distinct.",
-                                       env->env->trace);
-            while (counted_t<const datum_t> d = s->next(env->env, batchspec)) {
-                arr.push_back(std::move(d));
-                rcheck_array_size(arr, base_exc_t::GENERIC);
-                sampler.new_sample();
-            }
-        }
-        std::sort(arr.begin(), arr.end(),
-                  std::bind(lt_cmp, env->env,
-                            ph::_1, ph::_2));
-        std::vector<counted_t<const datum_t> > toret;
-        for (auto it = arr.begin(); it != arr.end(); ++it) {
-            if (toret.size() == 0 || **it != *toret[toret.size()-1]) {
-                toret.push_back(std::move(*it));
-            }
-        }
-        return new_val(make_counted<const datum_t>(std::move(toret)));
+        // The duplicates are dropped as the elements are read (on the shards, for
+        // a table), and only the distinct elements get sorted.
+        return arg(env, 0)->as_seq(env->env)->run_terminal(env->env,
+                                                           distinct_wire_func_t());
     }
     virtual const char *name() const { return "distinct"; }
 };
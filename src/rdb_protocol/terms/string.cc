@@ -5,17 +5,33 @@
 
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/op.hpp"
+#include "rdb_protocol/regex_cache.hpp"
 
 namespace ql {
 
 class match_term_t : public op_term_t {
 public:
     match_term_t(compile_env_t *env, const protob_t<const Term> &term)
-        : op_term_t(env, term, argspec_t(2)) { }
+        : op_term_t(env, term, argspec_t(2)) {
+        // A literal pattern gets compiled right away.  It's only a guess, though:
+        // the term cache can bind another constant into the `Term` later, so
+        // eval_impl still checks the pattern it gets.
+        if (term->args_size() == 2
+            && term->args(1).type() == Term::DATUM
+            && term->args(1).datum().type() == Datum::R_STR) {
+            pattern = term->args(1).datum().r_str();
+            compiled_regexp = get_compiled_regex(pattern);
+        }
+    }
 private:
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         std::string str = arg(env, 0)->as_str().to_std();
-        RE2 regexp(arg(env, 1)->as_str().c_str());
+        std::string new_pattern = arg(env, 1)->as_str().to_std();
+        if (!compiled_regexp || new_pattern != pattern) {
+            compiled_regexp = get_compiled_regex(new_pattern);
+            pattern = std::move(new_pattern);
+        }
+        const RE2 &regexp = *compiled_regexp;
         if (!regexp.ok()) {
             rfail(base_exc_t::GENERIC,
                   "Error in regexp `%s` (portion `%s`): %s",
@@ -64,6 +80,10 @@ private:
         }
     }
     virtual const char *name() const { return "match"; }
+
+    // The pattern we compiled last, and what we compiled it to.
+    std::string pattern;
+    boost::shared_ptr<const RE2> compiled_regexp;
 };
 
 const char *const splitchars = " \t\n\r\x0B\x0C";
@@ -66,6 +66,8 @@ counted_t<term_t> make_funcall_term(
 
 // datum_terms.cc
 counted_t<term_t> make_datum_term(const protob_t<const Term> &term);
+// Makes a term returned by `make_datum_term` read its value from its `Term` again.
+void reset_datum_term(term_t *term);
 counted_t<term_t> make_constant_term(
     compile_env_t *env, const protob_t<const Term> &term,
                                      double constant, const char *name);
@@ -83,6 +85,8 @@ counted_t<term_t> make_get_term(
     compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_get_all_term(
     compile_env_t *env, const protob_t<const Term> &term);
+counted_t<term_t> make_eq_join_term(
+    compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_db_create_term(
     compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_db_drop_term(
@@ -97,6 +101,8 @@ counted_t<term_t> make_table_list_term(
     compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_sync_term(
     compile_env_t *env, const protob_t<const Term> &term);
+counted_t<term_t> make_changes_term(
+    compile_env_t *env, const protob_t<const Term> &term);
 
 // error.cc
 counted_t<term_t> make_error_term(
@@ -157,8 +163,6 @@ counted_t<term_t> make_inner_join_term(
     compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_outer_join_term(
     compile_env_t *env, const protob_t<const Term> &term);
-counted_t<term_t> make_eq_join_term(
-    compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_update_term(
     compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_delete_term(
@@ -6,6 +6,7 @@
 
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/error.hpp"
+#include "rdb_protocol/insert_stream.hpp"
 #include "rdb_protocol/op.hpp"
 
 namespace ql {
@@ -34,10 +35,11 @@ durability_requirement_t parse_durability_optarg(counted_t<val_t> arg,
     const wire_string_t &str = arg->as_str();
     if (str == "hard") { return DURABILITY_REQUIREMENT_HARD; }
     if (str == "soft") { return DURABILITY_REQUIREMENT_SOFT; }
+    if (str == "group_soft") { return DURABILITY_REQUIREMENT_GROUP_SOFT; }
     rfail_target(target,
                  base_exc_t::GENERIC,
                  "Durability option `%s` unrecognized "
-                 "(options are \"hard\" and \"soft\").",
+                 "(options are \"hard\", \"soft\" and \"group_soft\").",
                  str.c_str());
 }
 
@@ -45,22 +47,18 @@ class insert_term_t : public op_term_t {
 public:
     insert_term_t(compile_env_t *env, const protob_t<const Term> &term)
         : op_term_t(env, term, argspec_t(2),
-                    optargspec_t({"upsert", "durability", "return_vals"})) { }
+                    optargspec_t({"upsert", "durability", "return_vals",
+                                  "stream"})) { }
 
 private:
     void maybe_generate_key(counted_t<table_t> tbl,
                             std::vector<std::string> *generated_keys_out,
                             size_t *keys_skipped_out,
                             counted_t<const datum_t> *datum_out) {
-        if (!(*datum_out)->get(tbl->get_pkey(), NOTHROW).has()) {
-            std::string key = uuid_to_str(generate_uuid());
-            counted_t<const datum_t> keyd(new datum_t(std::string(key)));
-            datum_ptr_t d(datum_t::R_OBJECT);
-            bool conflict = d.add(tbl->get_pkey(), keyd);
-            r_sanity_check(!conflict);
-            *datum_out = (*datum_out)->merge(d.to_counted(), pure_merge);
+        std::string key = generate_missing_key(tbl, datum_out);
+        if (!key.empty()) {
             if (generated_keys_out->size() < array_size_limit()) {
-                generated_keys_out->push_back(key);
+                generated_keys_out->push_back(std::move(key));
             } else {
                 *keys_skipped_out += 1;
             }
@@ -77,6 +75,27 @@ private:
         const durability_requirement_t durability_requirement
             = parse_durability_optarg(optarg(env, "durability"), this);
 
+        counted_t<val_t> stream_val = optarg(env, "stream");
+        if (stream_val.has() && stream_val->as_bool()) {
+            // The rest of the documents come in later CONTINUE queries (see
+            // `insert_stream_cache_t`).
+            rcheck(!return_vals, base_exc_t::GENERIC,
+                   "Optarg RETURN_VALS is invalid for streaming inserts.");
+            rcheck(!env->env->insert_stream.has(), base_exc_t::GENERIC,
+                   "A query can only start one streaming insert.");
+            counted_t<const datum_t> first_batch = arg(env, 1)->as_datum();
+            std::vector<counted_t<const datum_t> > docs;
+            if (first_batch->get_type() == datum_t::R_ARRAY) {
+                docs = first_batch->as_array();
+            } else {
+                docs.push_back(first_batch);
+            }
+            env->env->insert_stream.init(
+                new insert_stream_t(env->env, t, upsert, durability_requirement));
+            return new_val(env->env->insert_stream->add_batch(
+                               std::move(docs), env->env->interruptor));
+        }
+
         bool done = false;
         counted_t<const datum_t> stats = new_stats_object();
         std::vector<std::string> generated_keys;
@@ -1,7 +1,10 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/val.hpp"
 
+#include <algorithm>
+
 #include "math.hpp"
+#include "rdb_protocol/changefeed.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/meta_utils.hpp"
@@ -13,11 +16,13 @@ namespace ql {
 
 table_t::table_t(env_t *env,
                  counted_t<const db_t> _db, const std::string &_name,
-                 bool _use_outdated, const protob_t<const Backtrace> &backtrace)
+                 bool _use_outdated, bool _use_result_cache,
+                 const protob_t<const Backtrace> &backtrace)
     : pb_rcheckable_t(backtrace),
       db(_db),
       name(_name),
       use_outdated(_use_outdated),
+      use_result_cache(_use_result_cache),
       bounds(datum_range_t::universe()),
       sorting(sorting_t::UNORDERED) {
     uuid_u db_id = db->id;
@@ -264,6 +269,76 @@ counted_t<const datum_t> table_t::sindex_status(env_t *env, std::set<std::string
     }
 }
 
+boost::optional<std::string> table_t::find_field_sindex(env_t *env,
+                                                        const std::string &field) {
+    if (sindex_id || !bounds.is_universe() || sorting != sorting_t::UNORDERED) {
+        return boost::none;
+    }
+    rdb_protocol_t::sindex_status_t sindex_status((std::set<std::string>()));
+    rdb_protocol_t::read_t read(sindex_status, env->profile());
+    rdb_protocol_t::read_response_t res;
+    try {
+        access->get_namespace_if().read(
+            read, &res, order_token_t::ignore, env->interruptor);
+    } catch (const cannot_perform_query_exc_t &ex) {
+        // Reading the table itself reports this.
+        return boost::none;
+    }
+    auto s_res = boost::get<rdb_protocol_t::sindex_status_response_t>(&res.response);
+    r_sanity_check(s_res);
+
+    boost::optional<std::string> ret;
+    for (auto it = s_res->statuses.begin(); it != s_res->statuses.end(); ++it) {
+        if (it->second.ready && it->second.simple_field == field) {
+            // Prefer the index named after the field, as `index_create` names it.
+            if (!ret || it->first == field) {
+                ret = it->first;
+            }
+        }
+    }
+    return ret;
+}
+
+boost::optional<std::vector<counted_t<const datum_t> > > table_t::sample(
+        env_t *env, size_t num) {
+    if (sindex_id || !bounds.is_universe() || sorting != sorting_t::UNORDERED) {
+        return boost::none;
+    }
+    rdb_protocol_t::read_t read(rdb_protocol_t::sample_read_t(num), env->profile());
+    rdb_protocol_t::read_response_t res;
+    if (use_outdated) {
+        access->get_namespace_if().read_outdated(read, &res, env->interruptor);
+    } else {
+        access->get_namespace_if().read(
+            read, &res, order_token_t::ignore, env->interruptor);
+    }
+    auto s_res = boost::get<rdb_protocol_t::sample_read_response_t>(&res.response);
+    r_sanity_check(s_res);
+    if (!s_res->complete) {
+        return boost::none;
+    }
+    return std::move(s_res->rows);
+}
+
+counted_t<datum_stream_t> table_t::changes(env_t *env,
+                                           const protob_t<const Backtrace> &bt) {
+    rcheck(!sindex_id && bounds.is_universe() && sorting == sorting_t::UNORDERED,
+           base_exc_t::GENERIC, "changes can only be applied directly to a table.");
+    rcheck(env->mailbox_manager != NULL, base_exc_t::GENERIC,
+           "Changefeeds aren't available here.");
+    scoped_ptr_t<changefeed::feed_t> feed(
+        new changefeed::feed_t(env->mailbox_manager));
+    rdb_protocol_t::read_t read(rdb_protocol_t::changefeed_subscribe_t(feed->get_addr()),
+                                env->profile());
+    rdb_protocol_t::read_response_t res;
+    access->get_namespace_if().read(read, &res, order_token_t::ignore, env->interruptor);
+    auto s_res
+        = boost::get<rdb_protocol_t::changefeed_subscribe_response_t>(&res.response);
+    r_sanity_check(s_res);
+    feed->add_servers(s_res->server_addrs);
+    return make_counted<changefeed::stream_t>(std::move(feed), bt);
+}
+
 MUST_USE bool table_t::sync(env_t *env, const rcheckable_t *parent) {
     rcheck_target(parent, base_exc_t::GENERIC,
                   bounds.is_universe() && sorting == sorting_t::UNORDERED,
@@ -306,6 +381,34 @@ counted_t<const datum_t> table_t::get_row(env_t *env, counted_t<const datum_t> p
     return p_res->data;
 }
 
+std::map<store_key_t, counted_t<const datum_t> > table_t::get_rows(
+        env_t *env, const std::vector<counted_t<const datum_t> > &pvals) {
+    std::vector<store_key_t> keys;
+    keys.reserve(pvals.size());
+    for (auto it = pvals.begin(); it != pvals.end(); ++it) {
+        keys.push_back(store_key_t((*it)->print_primary()));
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    if (keys.empty()) {
+        return std::map<store_key_t, counted_t<const datum_t> >();
+    }
+
+    rdb_protocol_t::read_t read(
+            rdb_protocol_t::batched_point_read_t(std::move(keys)), env->profile());
+    rdb_protocol_t::read_response_t res;
+    if (use_outdated) {
+        access->get_namespace_if().read_outdated(read, &res, env->interruptor);
+    } else {
+        access->get_namespace_if().read(
+            read, &res, order_token_t::ignore, env->interruptor);
+    }
+    rdb_protocol_t::batched_point_read_response_t *b_res =
+        boost::get<rdb_protocol_t::batched_point_read_response_t>(&res.response);
+    r_sanity_check(b_res);
+    return std::move(b_res->rows);
+}
+
 counted_t<datum_stream_t> table_t::get_all(
         env_t *env,
         counted_t<const datum_t> value,
@@ -320,12 +423,14 @@ counted_t<datum_stream_t> table_t::get_all(
         return make_counted<lazy_datum_stream_t>(
             access.get(),
             use_outdated,
+            use_result_cache,
             primary_readgen_t::make(env, datum_range_t(value)),
             bt);
     } else {
         return make_counted<lazy_datum_stream_t>(
             access.get(),
             use_outdated,
+            use_result_cache,
             sindex_readgen_t::make(env, get_all_sindex_id, datum_range_t(value)),
             bt);
     }
@@ -369,6 +474,7 @@ counted_t<datum_stream_t> table_t::as_datum_stream(env_t *env,
     return make_counted<lazy_datum_stream_t>(
         access.get(),
         use_outdated,
+        use_result_cache,
         (!sindex_id || *sindex_id == get_pkey())
             ? primary_readgen_t::make(env, bounds, sorting)
             : sindex_readgen_t::make(env, *sindex_id, bounds, sorting),
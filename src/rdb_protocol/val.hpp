@@ -2,6 +2,7 @@
 #ifndef RDB_PROTOCOL_VAL_HPP_
 #define RDB_PROTOCOL_VAL_HPP_
 
+#include <map>
 #include <set>
 #include <string>
 #include <utility>
@@ -33,11 +34,16 @@ class table_t : public single_threaded_countable_t<table_t>, public pb_rcheckabl
 public:
     table_t(env_t *env,
             counted_t<const db_t> db, const std::string &name,
-            bool use_outdated, const protob_t<const Backtrace> &src);
+            bool use_outdated, bool use_result_cache,
+            const protob_t<const Backtrace> &src);
     counted_t<datum_stream_t> as_datum_stream(env_t *env,
                                               const protob_t<const Backtrace> &bt);
     const std::string &get_pkey();
     counted_t<const datum_t> get_row(env_t *env, counted_t<const datum_t> pval);
+    // Reads the rows with the primary keys `pvals` with one read, and returns the
+    // ones that exist.
+    std::map<store_key_t, counted_t<const datum_t> > get_rows(
+        env_t *env, const std::vector<counted_t<const datum_t> > &pvals);
     counted_t<datum_stream_t> get_all(
             env_t *env,
             counted_t<const datum_t> value,
@@ -75,7 +81,21 @@ public:
     counted_t<const datum_t> sindex_list(env_t *env);
     counted_t<const datum_t> sindex_status(env_t *env,
         std::set<std::string> sindex);
+    // Returns the name of a ready secondary index that isn't multi and just indexes
+    // `field` of the rows, if the table has one.  Only looks when this is the whole
+    // table.
+    boost::optional<std::string> find_field_sindex(env_t *env,
+                                                   const std::string &field);
+    // Returns a uniformly random sample of `num` rows of the table (or all of them,
+    // in random order, if it has fewer), read without reading the whole table.
+    // Returns boost::none if this isn't the whole table, or if the shards couldn't
+    // find enough rows that way.
+    boost::optional<std::vector<counted_t<const datum_t> > > sample(env_t *env,
+                                                                     size_t num);
     MUST_USE bool sync(env_t *env, const rcheckable_t *parent);
+    // Subscribes to the changes that the writes to the table make from now on (see
+    // `changefeed::feed_t`), which the stream returns as they come.
+    counted_t<datum_stream_t> changes(env_t *env, const protob_t<const Backtrace> &bt);
 
     counted_t<const db_t> db;
     const std::string name;
@@ -98,6 +118,8 @@ private:
         env_t *env, durability_requirement_t durability_requirement);
 
     bool use_outdated;
+    // Whether the table's aggregations may use the shards' `result_cache_t`.
+    bool use_result_cache;
     std::string pkey;
     scoped_ptr_t<rdb_namespace_access_t> access;
 
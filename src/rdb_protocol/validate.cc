@@ -43,6 +43,11 @@ void validate_pb(const Query &q) {
     if (q.type() == Query::START) {
         check_has(q, has_query, "query");
         validate_pb(q.query());
+    } else if (q.type() == Query::CONTINUE) {
+        // A batch of documents for a streaming insert.
+        if (q.has_query()) {
+            validate_pb(q.query());
+        }
     } else {
         check_not_has(q, has_query, "query");
     }
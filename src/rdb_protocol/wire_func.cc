@@ -1,6 +1,8 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/wire_func.hpp"
 
+#include <algorithm>
+
 #include "containers/archive/boost_types.hpp"
 #include "containers/archive/stl_types.hpp"
 #include "containers/archive/archive.hpp"
@@ -181,6 +183,7 @@ protob_t<const Backtrace> group_wire_func_t::get_bt() const {
 RDB_IMPL_ME_SERIALIZABLE_4(group_wire_func_t, funcs, append_index, multi, bt);
 
 RDB_IMPL_ME_SERIALIZABLE_0(count_wire_func_t);
+RDB_IMPL_ME_SERIALIZABLE_0(distinct_wire_func_t);
 
 map_wire_func_t map_wire_func_t::make_safely(
     pb::dummy_var_t dummy_var,
@@ -194,6 +197,75 @@ map_wire_func_t map_wire_func_t::make_safely(
 
 RDB_IMPL_SERIALIZABLE_2(filter_wire_func_t, filter_func, default_filter_val);
 
+const char *project_wire_func_t::name() const {
+    switch (kind) {
+    case kind_t::PLUCK: return "pluck";
+    case kind_t::WITHOUT: return "without";
+    case kind_t::GET_FIELD: return "get_field";
+    default: unreachable();
+    }
+}
+
+// Adds the top-level fields of the (valid) path argument `path` to `fields_out`.
+static void add_top_level_fields(const counted_t<const datum_t> &path,
+                                 std::vector<std::string> *fields_out) {
+    switch (path->get_type()) {
+    case datum_t::R_STR:
+        fields_out->push_back(path->as_str().to_std());
+        break;
+    case datum_t::R_ARRAY:
+        for (size_t i = 0; i < path->size(); ++i) {
+            add_top_level_fields(path->get(i), fields_out);
+        }
+        break;
+    case datum_t::R_OBJECT:
+        for (auto it = path->as_object().begin();
+             it != path->as_object().end(); ++it) {
+            fields_out->push_back(it->first);
+        }
+        break;
+    default:
+        unreachable();
+    }
+}
+
+bool project_wire_func_t::needed_fields(std::vector<std::string> *fields_out) const {
+    fields_out->clear();
+    if (kind == kind_t::WITHOUT) {
+        return false;
+    }
+    add_top_level_fields(paths, fields_out);
+    std::sort(fields_out->begin(), fields_out->end());
+    fields_out->erase(std::unique(fields_out->begin(), fields_out->end()),
+                      fields_out->end());
+    return true;
+}
+
+RDB_IMPL_ME_SERIALIZABLE_3(project_wire_func_t, kind, paths, bt);
+
+orderby_limit_wire_func_t::orderby_limit_wire_func_t(
+    const std::vector<std::pair<sort_direction_t, counted_t<func_t> > > &comparisons,
+    uint64_t _n, const protob_t<const Backtrace> &_bt)
+    : n(_n), bt(_bt) {
+    funcs.reserve(comparisons.size());
+    directions.reserve(comparisons.size());
+    for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
+        directions.push_back(it->first);
+        funcs.push_back(wire_func_t(it->second));
+    }
+}
+
+std::vector<counted_t<func_t> > orderby_limit_wire_func_t::compile_funcs() const {
+    std::vector<counted_t<func_t> > ret;
+    ret.reserve(funcs.size());
+    for (size_t i = 0; i < funcs.size(); ++i) {
+        ret.push_back(funcs[i].compile_wire_func());
+    }
+    return ret;
+}
+
+RDB_IMPL_ME_SERIALIZABLE_4(orderby_limit_wire_func_t, funcs, directions, n, bt);
+
 void bt_wire_func_t::rdb_serialize(write_message_t &msg) const { // NOLINT
     msg << *bt;
 }
@@ -5,10 +5,12 @@
 #include <functional>
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "containers/uuid.hpp"
 #include "rdb_protocol/counted_term.hpp"
+#include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/pb_utils.hpp"
 #include "rdb_protocol/sym.hpp"
 #include "rdb_protocol/var_types.hpp"
@@ -102,6 +104,10 @@ struct count_wire_func_t {
     RDB_DECLARE_ME_SERIALIZABLE;
 };
 
+struct distinct_wire_func_t {
+    RDB_DECLARE_ME_SERIALIZABLE;
+};
+
 class bt_wire_func_t {
 public:
     bt_wire_func_t() : bt(make_counted_backtrace()) { }
@@ -130,6 +136,77 @@ private:
     bt_wire_func_t bt;
 };
 
+// Projects each row of a sequence onto some of its fields, the way `pluck`,
+// `without` and `get_field` do.  It does the same as a `map_wire_func_t` (or a
+// `concatmap_wire_func_t` for `get_field`) calling the term on each row, but without
+// evaluating a ReQL function per row, and it tells a shard which fields of the row it
+// reads, so the shard doesn't have to deserialize the others.
+class project_wire_func_t {
+public:
+    enum class kind_t {
+        PLUCK = 0,
+        WITHOUT = 1,
+        // Rows without the field are dropped.
+        GET_FIELD = 2
+    };
+
+    project_wire_func_t() : kind(kind_t::PLUCK) { }
+    // `paths` must be valid, i.e. constructing a `pathspec_t` from it must not fail;
+    // for `GET_FIELD` it's the field name.
+    project_wire_func_t(kind_t _kind, const counted_t<const datum_t> &_paths,
+                        const protob_t<const Backtrace> &_bt)
+        : kind(_kind), paths(_paths), bt(_bt) { }
+
+    kind_t get_kind() const { return kind; }
+    const counted_t<const datum_t> &get_paths() const { return paths; }
+    protob_t<const Backtrace> get_bt() const { return bt.get_bt(); }
+    // The name of the term, for error messages.
+    const char *name() const;
+
+    // Sets `*fields_out` to the top-level fields the projection reads and returns
+    // true, or returns false if it needs the whole row (as `without` does).
+    bool needed_fields(std::vector<std::string> *fields_out) const;
+
+    RDB_DECLARE_ME_SERIALIZABLE;
+private:
+    kind_t kind;
+    counted_t<const datum_t> paths;
+    bt_wire_func_t bt;
+};
+
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
+    project_wire_func_t::kind_t, int8_t,
+    project_wire_func_t::kind_t::PLUCK, project_wire_func_t::kind_t::GET_FIELD);
+
+enum class sort_direction_t {
+    ASC = 0,
+    DESC = 1
+};
+
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
+    sort_direction_t, int8_t, sort_direction_t::ASC, sort_direction_t::DESC);
+
+// The terminal for an unindexed `order_by(...).limit(n)`: it finds the first `n`
+// rows in the order given by the functions, so that each shard only has to send
+// those back.
+class orderby_limit_wire_func_t {
+public:
+    orderby_limit_wire_func_t() : n(0) { }
+    orderby_limit_wire_func_t(
+        const std::vector<std::pair<sort_direction_t, counted_t<func_t> > > &comparisons,
+        uint64_t _n, const protob_t<const Backtrace> &_bt);
+    std::vector<counted_t<func_t> > compile_funcs() const;
+    const std::vector<sort_direction_t> &get_directions() const { return directions; }
+    uint64_t get_n() const { return n; }
+    protob_t<const Backtrace> get_bt() const { return bt.get_bt(); }
+    RDB_DECLARE_ME_SERIALIZABLE;
+private:
+    std::vector<wire_func_t> funcs;
+    std::vector<sort_direction_t> directions;
+    uint64_t n;
+    bt_wire_func_t bt;
+};
+
 template<class T>
 class skip_terminal_t;
 
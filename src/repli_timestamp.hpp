@@ -39,6 +39,9 @@ repli_timestamp_t superceding_recency(repli_timestamp_t x, repli_timestamp_t y);
 write_message_t &operator<<(write_message_t &msg, repli_timestamp_t tstamp);
 archive_result_t deserialize(read_stream_t *s, repli_timestamp_t *tstamp);
 
+template <>
+struct serialized_as_raw_t<repli_timestamp_t> : public std::true_type { };
+
 void debug_print(printf_buffer_t *buf, repli_timestamp_t tstamp);
 
 #endif  // REPLI_TIMESTAMP_HPP_
@@ -2,7 +2,9 @@
 #include "rpc/connectivity/cluster.hpp"
 
 #include <netinet/in.h>
+#include <string.h>
 
+#include <algorithm>
 #include <functional>
 
 #include "errors.hpp"
@@ -14,6 +16,7 @@
 #include "concurrency/cross_thread_signal.hpp"
 #include "concurrency/pmap.hpp"
 #include "concurrency/semaphore.hpp"
+#include "config/args.hpp"
 #include "containers/archive/vector_stream.hpp"
 #include "containers/object_buffer.hpp"
 #include "containers/uuid.hpp"
@@ -24,6 +27,12 @@
 // Number of messages after which the message handling loop yields
 #define MESSAGE_HANDLER_MAX_BATCH_SIZE           8
 
+static bool cluster_wire_compression = false;
+
+void set_cluster_wire_compression(bool compress) {
+    cluster_wire_compression = compress;
+}
+
 const std::string connectivity_cluster_t::cluster_proto_header("RethinkDB cluster\n");
 const std::string connectivity_cluster_t::cluster_version(RETHINKDB_CODE_VERSION);
 
@@ -113,7 +122,7 @@ connectivity_cluster_t::run_t::run_t(connectivity_cluster_t *p,
     `connection_map` on each thread and notifying any listeners that we're now
     connected to ourself. The destructor will remove us from the
     `connection_map` and again notify any listeners. */
-    connection_to_ourself(this, parent->me, NULL, routing_table[parent->me]),
+    connection_to_ourself(this, parent->me, NULL, routing_table[parent->me], false),
 
     listener(new tcp_listener_t(cluster_listener_socket.get(),
                                 std::bind(&connectivity_cluster_t::run_t::on_new_connection,
@@ -148,14 +157,21 @@ void connectivity_cluster_t::run_t::join(const peer_address_t &address) THROWS_N
 connectivity_cluster_t::run_t::connection_entry_t::connection_entry_t(run_t *p,
                                                                       peer_id_t id,
                                                                       tcp_conn_stream_t *c,
-                                                                      const peer_address_t &a) THROWS_NOTHING :
-    conn(c), address(a), session_id(generate_uuid()),
+                                                                      const peer_address_t &a,
+                                                                      bool compressed) THROWS_NOTHING :
+    conn(c), address(a),
+    compressor(compressed ? new cluster_message_compressor_t() : NULL),
+    session_id(generate_uuid()),
     pm_collection(),
     pm_bytes_sent(secs_to_ticks(1), true),
     pm_collection_membership(&p->parent->connectivity_collection, &pm_collection, uuid_to_str(id.get_uuid())),
     pm_bytes_sent_membership(&pm_collection, &pm_bytes_sent, "bytes_sent"),
+    sending(false),
     parent(p), peer(id),
     entries(new one_per_thread_t<entry_installation_t>(this)) {
+    for (int i = 0; i < NUM_MESSAGE_PRIORITIES; ++i) {
+        send_queue_skips[i] = 0;
+    }
     if (peer != parent->parent->me && parent->heartbeat_manager != NULL) {
         parent->heartbeat_manager->begin_peer_heartbeat(peer);
     }
@@ -170,8 +186,135 @@ connectivity_cluster_t::run_t::connection_entry_t::~connection_entry_t() THROWS_
     entries.reset();
 
     /* `~entry_installation_t` destroys the `auto_drainer_t`'s in entries,
-    so nothing can be holding the `send_mutex`. */
-    guarantee(!send_mutex.is_locked());
+    so nothing can be sending. */
+    guarantee(!sending);
+    for (int i = 0; i < NUM_MESSAGE_PRIORITIES; ++i) {
+        guarantee(send_queues[i].empty());
+    }
+}
+
+/* After the handshake, messages travel in fragments, which start with a header:
+the priority of the message, whether this is the message's last fragment, and the
+size of the fragment's data as a uint32_t. Fragments of messages of different
+priorities can be interleaved, but each priority only has one message in flight. */
+static const size_t FRAGMENT_HEADER_SIZE = 2 + sizeof(uint32_t);
+
+static void write_fragment_header(char *header, message_priority_t priority,
+                                  bool last, uint32_t size) {
+    header[0] = static_cast<char>(priority);
+    header[1] = last ? 1 : 0;
+    memcpy(header + 2, &size, sizeof(size));
+}
+
+void connectivity_cluster_t::run_t::connection_entry_t::send(outgoing_message_t *message) {
+    assert_thread();
+    guarantee(conn != NULL);
+    send_queues[static_cast<int>(message->priority)].push_back(message);
+
+    while (sending) {
+        message->wakeup.wait();
+        if (message->done) {
+            return;
+        }
+        /* Otherwise the previous sender handed the job of sending over to us,
+        but another coroutine might have taken it before we got to run. */
+        message->wakeup.reset();
+    }
+
+    sending = true;
+    while (!message->done) {
+        outgoing_message_t *next = pick_message_to_send();
+        send_fragment(next);
+        if (next->done && next != message) {
+            next->wakeup.pulse_if_not_already_pulsed();
+        }
+    }
+    sending = false;
+
+    // Hand the job of sending over to the sender of the most urgent queued message.
+    for (int i = 0; i < NUM_MESSAGE_PRIORITIES; ++i) {
+        if (!send_queues[i].empty()) {
+            send_queues[i].head()->wakeup.pulse_if_not_already_pulsed();
+            break;
+        }
+    }
+}
+
+connectivity_cluster_t::run_t::outgoing_message_t *
+connectivity_cluster_t::run_t::connection_entry_t::pick_message_to_send() {
+    // A queue that has been passed over too often goes first...
+    int chosen = -1;
+    for (int i = NUM_MESSAGE_PRIORITIES - 1; i >= 0; --i) {
+        if (!send_queues[i].empty() && send_queue_skips[i] >= CLUSTER_SEND_QUEUE_MAX_SKIPS) {
+            chosen = i;
+            break;
+        }
+    }
+    // ... otherwise the one with the highest priority does.
+    for (int i = 0; chosen == -1 && i < NUM_MESSAGE_PRIORITIES; ++i) {
+        if (!send_queues[i].empty()) {
+            chosen = i;
+        }
+    }
+    guarantee(chosen != -1);
+
+    for (int i = 0; i < NUM_MESSAGE_PRIORITIES; ++i) {
+        if (i == chosen) {
+            send_queue_skips[i] = 0;
+        } else if (!send_queues[i].empty()) {
+            ++send_queue_skips[i];
+        }
+    }
+    return send_queues[chosen].head();
+}
+
+void connectivity_cluster_t::run_t::connection_entry_t::send_fragment(outgoing_message_t *message) {
+    const size_t size = std::min<size_t>(message->data->size() - message->offset,
+                                         CLUSTER_MESSAGE_FRAGMENT_SIZE);
+    const bool last = message->offset + size == message->data->size();
+    const char *fragment_data = message->data->data() + message->offset;
+
+    char header[FRAGMENT_HEADER_SIZE];
+    write_fragment_header(header, message->priority, last, size);
+
+    int64_t res;
+    size_t wire_size;
+    if (compressor.has()) {
+        std::vector<char> fragment;
+        fragment.reserve(FRAGMENT_HEADER_SIZE + size);
+        fragment.insert(fragment.end(), header, header + FRAGMENT_HEADER_SIZE);
+        fragment.insert(fragment.end(), fragment_data, fragment_data + size);
+        std::vector<char> frames;
+        compressor->compress(fragment.data(), fragment.size(), &frames);
+        res = conn->write(frames.data(), frames.size());
+        wire_size = frames.size();
+    } else {
+        iovec iov[2];
+        iov[0].iov_base = header;
+        iov[0].iov_len = FRAGMENT_HEADER_SIZE;
+        iov[1].iov_base = const_cast<char *>(fragment_data);
+        iov[1].iov_len = size;
+        res = conn->writev(iov, 2);
+        wire_size = FRAGMENT_HEADER_SIZE + size;
+    }
+
+    if (res == -1) {
+        /* Close the other half of the connection to make sure that
+           `connectivity_cluster_t::run_t::handle()` notices that something is
+           up */
+        if (conn->is_read_open()) {
+            conn->shutdown_read();
+        }
+    } else {
+        guarantee(res == static_cast<int64_t>(wire_size));
+    }
+
+    message->offset += size;
+    message->wire_bytes += wire_size;
+    if (last) {
+        send_queues[static_cast<int>(message->priority)].remove(message);
+        message->done = true;
+    }
 }
 
 static void ping_connection_watcher(peer_id_t peer, peers_list_callback_t *connect_disconnect_cb) THROWS_NOTHING {
@@ -565,6 +708,7 @@ void connectivity_cluster_t::run_t::handle(
         msg.append(cluster_arch_bitsize.data(), cluster_arch_bitsize.length());
         msg << static_cast<uint64_t>(cluster_build_mode.length());
         msg.append(cluster_build_mode.data(), cluster_build_mode.length());
+        msg << cluster_wire_compression;
         msg << parent->me;
         msg << routing_table[parent->me].hosts();
         if (send_write_message(conn, &msg))
@@ -638,6 +782,12 @@ void connectivity_cluster_t::run_t::handle(
         }
     }
 
+    // Compress the connection if both sides want to.
+    bool remote_wire_compression;
+    if (deserialize_and_check(conn, &remote_wire_compression, peername))
+        return;
+    const bool compressed = cluster_wire_compression && remote_wire_compression;
+
     // Receive id, host/ports.
     peer_id_t other_id;
     std::set<host_and_port_t> other_peer_addr_hosts;
@@ -803,9 +953,17 @@ void connectivity_cluster_t::run_t::handle(
         /* `connection_entry_t` is the public interface of this coroutine. Its
         constructor registers it in the `connectivity_cluster_t`'s connection
         map and notifies any connect listeners. */
-        connection_entry_t conn_structure(this, other_id, conn, other_peer_addr);
+        connection_entry_t conn_structure(this, other_id, conn, other_peer_addr,
+                                          compressed);
         object_buffer_t<heartbeat_keepalive_t> keepalive;
 
+        /* Everything after the handshake is compressed, if it's compressed at all. */
+        object_buffer_t<cluster_decompressing_stream_t> decompressor;
+        read_stream_t *message_stream = conn;
+        if (compressed) {
+            message_stream = decompressor.create(conn);
+        }
+
         if (heartbeat_manager != NULL) {
             keepalive.create(conn, heartbeat_manager, other_id);
         }
@@ -814,9 +972,39 @@ void connectivity_cluster_t::run_t::handle(
         it's closed, which may be due to network events, or the other end
         shutting down, or us shutting down. */
         try {
+            /* The messages that are partially received, one per priority */
+            std::vector<char> partial_messages[NUM_MESSAGE_PRIORITIES];
             int messages_handled_since_yield = 0;
             while (true) {
-                message_handler->on_message(other_id, conn); // might raise fake_archive_exc_t
+                char header[FRAGMENT_HEADER_SIZE];
+                if (force_read(message_stream, header, FRAGMENT_HEADER_SIZE)
+                    != static_cast<int64_t>(FRAGMENT_HEADER_SIZE)) {
+                    throw fake_archive_exc_t();
+                }
+                const uint8_t priority = header[0];
+                const bool last = header[1] != 0;
+                uint32_t size;
+                memcpy(&size, header + 2, sizeof(size));
+                if (priority >= NUM_MESSAGE_PRIORITIES
+                    || size > CLUSTER_MESSAGE_FRAGMENT_SIZE) {
+                    throw fake_archive_exc_t();
+                }
+
+                std::vector<char> *partial = &partial_messages[priority];
+                const size_t old_size = partial->size();
+                partial->resize(old_size + size);
+                if (force_read(message_stream, partial->data() + old_size, size)
+                    != static_cast<int64_t>(size)) {
+                    throw fake_archive_exc_t();
+                }
+                if (!last) {
+                    continue;
+                }
+
+                std::vector<char> message_data;
+                message_data.swap(*partial);
+                vector_read_stream_t message(std::move(message_data));
+                message_handler->on_message(other_id, &message); // might raise fake_archive_exc_t
 
                 ++messages_handled_since_yield;
                 if (messages_handled_since_yield >= MESSAGE_HANDLER_MAX_BATCH_SIZE) {
@@ -901,6 +1089,7 @@ void connectivity_cluster_t::send_message(peer_id_t dest, send_message_write_cal
         ASSERT_FINITE_CORO_WAITING;
         callback->write(&buffer);
     }
+    const message_priority_t priority = callback->get_priority();
 
 #ifdef CLUSTER_MESSAGE_DEBUGGING
     {
@@ -954,24 +1143,11 @@ void connectivity_cluster_t::send_message(peer_id_t dest, send_message_write_cal
         guarantee(dest != me);
         on_thread_t threader(conn_structure->conn->home_thread());
 
-        /* Acquire the send-mutex so we don't collide with other things trying
-        to send on the same connection. */
-        mutex_t::acq_t acq(&conn_structure->send_mutex);
-
-        {
-            int64_t res = conn_structure->conn->write(buffer.vector().data(),
-                                                      buffer.vector().size());
-            if (res == -1) {
-                /* Close the other half of the connection to make sure that
-                   `connectivity_cluster_t::run_t::handle()` notices that something is
-                   up */
-                if (conn_structure->conn->is_read_open()) {
-                    conn_structure->conn->shutdown_read();
-                }
-            } else {
-                guarantee(res == static_cast<int64_t>(buffer.vector().size()));
-            }
-        }
+        /* Queue the message behind other things trying to send on the same
+        connection. `bytes_sent` counts what goes over the wire. */
+        run_t::outgoing_message_t message(&buffer.vector(), priority);
+        conn_structure->send(&message);
+        bytes_sent = message.wire_bytes;
     }
 
     conn_structure->pm_bytes_sent.record(bytes_sent);
@@ -12,11 +12,14 @@
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/one_per_thread.hpp"
 #include "concurrency/semaphore.hpp"
+#include "concurrency/cond_var.hpp"
 #include "containers/archive/tcp_conn_stream.hpp"
+#include "containers/intrusive_list.hpp"
 #include "containers/map_sentries.hpp"
 #include "containers/uuid.hpp"
 #include "perfmon/perfmon.hpp"
 #include "rpc/connectivity/connectivity.hpp"
+#include "rpc/connectivity/compression.hpp"
 #include "rpc/connectivity/messages.hpp"
 #include "utils.hpp"
 
@@ -26,6 +29,11 @@ template <class> class optional;
 
 class heartbeat_manager_t;
 
+/* Whether this node offers to compress its cluster connections. A connection is
+compressed only if the nodes on both ends offer to. This is off by default; call it
+before any `connectivity_cluster_t::run_t` is created. */
+void set_cluster_wire_compression(bool compress);
+
 class peer_address_set_t {
 public:
     size_t erase(const peer_address_t &addr) {
@@ -90,12 +98,36 @@ public:
     private:
         friend class connectivity_cluster_t;
 
+        /* A message that's queued or being sent on a `connection_entry_t`. */
+        class outgoing_message_t : public intrusive_list_node_t<outgoing_message_t> {
+        public:
+            outgoing_message_t(const std::vector<char> *_data, message_priority_t _priority) :
+                data(_data), priority(_priority), offset(0), wire_bytes(0), done(false) { }
+
+            const std::vector<char> *const data;
+            const message_priority_t priority;
+
+            /* How much of `data` has been sent, and how many bytes that took on
+            the wire. */
+            size_t offset;
+            size_t wire_bytes;
+            bool done;
+
+            /* Pulsed when the message has been sent, or when it's this message's
+            turn to send queued messages. */
+            cond_t wakeup;
+
+        private:
+            DISABLE_COPYING(outgoing_message_t);
+        };
+
         class connection_entry_t : public home_thread_mixin_debug_only_t {
         public:
             /* The constructor registers us in every thread's `connection_map`;
             the destructor deregisters us. Both also notify all subscribers. */
             connection_entry_t(run_t *, peer_id_t, tcp_conn_stream_t *,
-                               const peer_address_t &peer) THROWS_NOTHING;
+                               const peer_address_t &peer,
+                               bool compressed) THROWS_NOTHING;
             ~connection_entry_t() THROWS_NOTHING;
 
             /* NULL for our "connection" to ourself */
@@ -106,8 +138,19 @@ public:
             cross-thread to access the routing table. */
             peer_address_t address;
 
-            /* Unused for our connection to ourself */
-            mutex_t send_mutex;
+            /* Sends `message`, which must not be queued yet. Messages are sent in
+            fragments, and there's one queue per priority; a single coroutine at a
+            time sends the fragments of all queued messages, always picking the
+            queue with the highest priority. Other callers wait until their
+            message has been sent, or until they get to take over. Must be
+            called on the connection's thread. Unused for our connection to
+            ourself. */
+            void send(outgoing_message_t *message);
+
+            /* Empty unless the connection is compressed. Only used by the
+            coroutine that's sending, so messages are compressed in the order
+            they're sent. */
+            scoped_ptr_t<cluster_message_compressor_t> compressor;
 
             uuid_u session_id;
 
@@ -116,6 +159,16 @@ public:
             perfmon_membership_t pm_collection_membership, pm_bytes_sent_membership;
 
         private:
+            outgoing_message_t *pick_message_to_send();
+            void send_fragment(outgoing_message_t *message);
+
+            intrusive_list_t<outgoing_message_t> send_queues[NUM_MESSAGE_PRIORITIES];
+
+            /* For how many fragments in a row each queue has been passed over */
+            int send_queue_skips[NUM_MESSAGE_PRIORITIES];
+
+            bool sending;
+
             /* We only hold this information so we can deregister ourself */
             run_t *parent;
             peer_id_t peer;
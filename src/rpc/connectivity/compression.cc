@@ -0,0 +1,171 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rpc/connectivity/compression.hpp"
+
+#include <string.h>
+#include <zlib.h>
+
+#include <algorithm>
+
+#include "config/args.hpp"
+#include "errors.hpp"
+
+enum cluster_frame_type_t : uint8_t {
+    CLUSTER_FRAME_RAW = 0,
+    CLUSTER_FRAME_DEFLATE = 1
+};
+
+static const size_t CLUSTER_FRAME_HEADER_SIZE = sizeof(uint8_t) + sizeof(uint32_t);
+
+static void write_frame_header(char *p, cluster_frame_type_t type, uint32_t size) {
+    p[0] = static_cast<char>(type);
+    memcpy(p + 1, &size, sizeof(size));
+}
+
+cluster_message_compressor_t::cluster_message_compressor_t() : stream(new z_stream()) {
+    int res = deflateInit(stream.get(), CLUSTER_COMPRESSION_LEVEL);
+    guarantee(res == Z_OK, "deflateInit failed (zlib error %d)", res);
+}
+
+cluster_message_compressor_t::~cluster_message_compressor_t() {
+    deflateEnd(stream.get());
+}
+
+void cluster_message_compressor_t::compress(const char *data, size_t size,
+                                            std::vector<char> *frames_out) {
+    frames_out->clear();
+
+    if (size < CLUSTER_COMPRESSION_MIN_MESSAGE_SIZE) {
+        frames_out->resize(CLUSTER_FRAME_HEADER_SIZE + size);
+        write_frame_header(frames_out->data(), CLUSTER_FRAME_RAW, size);
+        memcpy(frames_out->data() + CLUSTER_FRAME_HEADER_SIZE, data, size);
+        return;
+    }
+
+    stream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    stream->avail_in = 0;
+    size_t remaining = size;
+    bool flushed = false;
+    while (!flushed) {
+        const size_t frame_start = frames_out->size();
+        const size_t frame_capacity =
+            std::min<size_t>(CLUSTER_COMPRESSION_MAX_FRAME_SIZE,
+                             deflateBound(stream.get(), remaining + stream->avail_in));
+        frames_out->resize(frame_start + CLUSTER_FRAME_HEADER_SIZE + frame_capacity);
+        stream->next_out = reinterpret_cast<Bytef *>(
+            frames_out->data() + frame_start + CLUSTER_FRAME_HEADER_SIZE);
+        stream->avail_out = frame_capacity;
+
+        while (stream->avail_out > 0) {
+            if (stream->avail_in == 0) {
+                const size_t chunk =
+                    std::min<size_t>(remaining, CLUSTER_COMPRESSION_MAX_FRAME_SIZE);
+                stream->avail_in = chunk;
+                remaining -= chunk;
+            }
+            const int flush = remaining == 0 ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+            int res = deflate(stream.get(), flush);
+            guarantee(res == Z_OK || res == Z_BUF_ERROR,
+                      "deflate failed (zlib error %d)", res);
+            // The flush is only complete once deflate stops filling up the output.
+            if (flush == Z_SYNC_FLUSH && stream->avail_in == 0
+                && stream->avail_out > 0) {
+                flushed = true;
+                break;
+            }
+        }
+
+        const size_t payload_size = frame_capacity - stream->avail_out;
+        if (payload_size == 0) {
+            frames_out->resize(frame_start);
+        } else {
+            write_frame_header(frames_out->data() + frame_start,
+                               CLUSTER_FRAME_DEFLATE, payload_size);
+            frames_out->resize(frame_start + CLUSTER_FRAME_HEADER_SIZE + payload_size);
+        }
+    }
+}
+
+cluster_decompressing_stream_t::cluster_decompressing_stream_t(read_stream_t *_inner)
+    : inner(_inner), stream(new z_stream()), buffer_pos(0), buffer_end(0) {
+    int res = inflateInit(stream.get());
+    guarantee(res == Z_OK, "inflateInit failed (zlib error %d)", res);
+}
+
+cluster_decompressing_stream_t::~cluster_decompressing_stream_t() {
+    inflateEnd(stream.get());
+}
+
+int64_t cluster_decompressing_stream_t::read(void *p, int64_t n) {
+    // Deflate frames can decode to nothing, so we might need several frames.
+    while (buffer_pos == buffer_end) {
+        int64_t res = read_frame();
+        if (res <= 0) {
+            return res;
+        }
+    }
+
+    const size_t num_to_read = std::min<size_t>(n, buffer_end - buffer_pos);
+    memcpy(p, buffer.data() + buffer_pos, num_to_read);
+    buffer_pos += num_to_read;
+    return num_to_read;
+}
+
+int64_t cluster_decompressing_stream_t::read_frame() {
+    char header[CLUSTER_FRAME_HEADER_SIZE];
+    int64_t res = force_read(inner, header, CLUSTER_FRAME_HEADER_SIZE);
+    if (res == 0) {
+        return 0;
+    } else if (res != static_cast<int64_t>(CLUSTER_FRAME_HEADER_SIZE)) {
+        return -1;
+    }
+
+    const uint8_t type = header[0];
+    uint32_t size;
+    memcpy(&size, header + 1, sizeof(size));
+    if (size > CLUSTER_COMPRESSION_MAX_FRAME_SIZE) {
+        return -1;
+    }
+
+    buffer_pos = 0;
+    buffer_end = 0;
+
+    switch (type) {
+    case CLUSTER_FRAME_RAW: {
+        if (buffer.size() < size) {
+            buffer.resize(size);
+        }
+        if (force_read(inner, buffer.data(), size) != size) {
+            return -1;
+        }
+        buffer_end = size;
+        return 1;
+    }
+    case CLUSTER_FRAME_DEFLATE: {
+        compressed.resize(size);
+        if (force_read(inner, compressed.data(), size) != size) {
+            return -1;
+        }
+        stream->next_in = reinterpret_cast<Bytef *>(compressed.data());
+        stream->avail_in = size;
+        stream->avail_out = 0;
+        while (stream->avail_in > 0 || stream->avail_out == 0) {
+            if (buffer.size() == buffer_end) {
+                buffer.resize(std::max<size_t>(2 * buffer.size(), 4 * size));
+            }
+            stream->next_out = reinterpret_cast<Bytef *>(buffer.data() + buffer_end);
+            stream->avail_out = buffer.size() - buffer_end;
+            int zres = inflate(stream.get(), Z_SYNC_FLUSH);
+            buffer_end = buffer.size() - stream->avail_out;
+            if (zres == Z_BUF_ERROR && stream->avail_out > 0) {
+                // No progress possible; all the output there was has been written.
+                break;
+            } else if (zres != Z_OK && zres != Z_BUF_ERROR) {
+                return -1;
+            }
+        }
+        return 1;
+    }
+    default:
+        return -1;
+    }
+}
@@ -0,0 +1,66 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RPC_CONNECTIVITY_COMPRESSION_HPP_
+#define RPC_CONNECTIVITY_COMPRESSION_HPP_
+
+#include <vector>
+
+#include "containers/archive/archive.hpp"
+#include "containers/scoped.hpp"
+
+struct z_stream_s;
+
+/* On a compressed cluster connection, every message is sent as one or more frames.
+A frame is a one-byte frame type, the size of its payload as a uint32_t, and the
+payload.  Messages shorter than CLUSTER_COMPRESSION_MIN_MESSAGE_SIZE go out in a raw
+frame.  Longer ones are fed through a zlib deflate stream that lasts as long as the
+connection, so later messages can refer back to the data of earlier ones, and the
+stream is flushed at the end of each message so the receiver can decode it without
+waiting for the next one. */
+
+/* `cluster_message_compressor_t` is the sending end of a compressed connection.
+Messages must be passed to `compress()` in the order they're written to the
+connection. */
+class cluster_message_compressor_t {
+public:
+    cluster_message_compressor_t();
+    ~cluster_message_compressor_t();
+
+    /* Replaces the contents of `frames_out` with the frames that carry the message. */
+    void compress(const char *data, size_t size, std::vector<char> *frames_out);
+
+private:
+    scoped_ptr_t<z_stream_s> stream;
+
+    DISABLE_COPYING(cluster_message_compressor_t);
+};
+
+/* `cluster_decompressing_stream_t` is the receiving end: it reads frames from
+`inner` and returns the messages they carry.  Corrupt frames are reported as read
+errors. */
+class cluster_decompressing_stream_t : public read_stream_t {
+public:
+    explicit cluster_decompressing_stream_t(read_stream_t *inner);
+    virtual ~cluster_decompressing_stream_t();
+
+    virtual MUST_USE int64_t read(void *p, int64_t n);
+
+private:
+    /* Reads the next frame into `buffer`. Returns 1 on success, 0 on EOF and -1 on
+    error. */
+    int64_t read_frame();
+
+    read_stream_t *const inner;
+    scoped_ptr_t<z_stream_s> stream;
+
+    /* `buffer[buffer_pos .. buffer_end)` is the data of the last frame that hasn't
+    been read yet. */
+    std::vector<char> buffer;
+    size_t buffer_pos;
+    size_t buffer_end;
+
+    std::vector<char> compressed;
+
+    DISABLE_COPYING(cluster_decompressing_stream_t);
+};
+
+#endif  // RPC_CONNECTIVITY_COMPRESSION_HPP_
@@ -46,10 +46,24 @@ no further messages are delivered. This gives a natural way to make sure that no
 messages are still being delivered at the time that the `application_t`
 destructor is called. */
 
+/* Every message is sent with one of these priorities. Between two nodes, a message
+is sent ahead of any queued messages of lower priority, and interrupts one that is
+already being sent, so a heartbeat doesn't have to wait behind a backfill chunk.
+Messages of the same priority arrive in the order they were sent; messages of
+different priorities may overtake each other. */
+enum class message_priority_t {
+    CONTROL = 0,    // heartbeats and other small messages that can't be late
+    QUERY = 1,      // the default
+    BULK = 2        // big transfers that can wait
+};
+
+static const int NUM_MESSAGE_PRIORITIES = 3;
+
 class send_message_write_callback_t {
 public:
     virtual ~send_message_write_callback_t() { }
     virtual void write(write_stream_t *stream) = 0;
+    virtual message_priority_t get_priority() { return message_priority_t::QUERY; }
 };
 
 class message_service_t  {
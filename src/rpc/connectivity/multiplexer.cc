@@ -51,9 +51,11 @@ message_multiplexer_t::client_t::run_t::~run_t() {
 
 message_multiplexer_t::client_t::client_t(message_multiplexer_t *p,
                                           tag_t t,
+                                          message_priority_t _priority,
                                           int max_outstanding) :
     parent(p),
     tag(t),
+    priority(_priority),
     run(NULL),
     outstanding_writes_semaphores(max_outstanding)
 {
@@ -74,8 +76,10 @@ connectivity_service_t *message_multiplexer_t::client_t::get_connectivity_servic
 
 class tagged_message_writer_t : public send_message_write_callback_t {
 public:
-    tagged_message_writer_t(message_multiplexer_t::tag_t _tag, send_message_write_callback_t *_subwriter) :
-        tag(_tag), subwriter(_subwriter) { }
+    tagged_message_writer_t(message_multiplexer_t::tag_t _tag,
+                            message_priority_t _priority,
+                            send_message_write_callback_t *_subwriter) :
+        tag(_tag), priority(_priority), subwriter(_subwriter) { }
     virtual ~tagged_message_writer_t() { }
 
     void write(write_stream_t *os) {
@@ -86,13 +90,18 @@ public:
         subwriter->write(os);
     }
 
+    message_priority_t get_priority() {
+        return priority;
+    }
+
 private:
     message_multiplexer_t::tag_t tag;
+    message_priority_t priority;
     send_message_write_callback_t *subwriter;
 };
 
 void message_multiplexer_t::client_t::send_message(peer_id_t dest, send_message_write_callback_t *callback) {
-    tagged_message_writer_t writer(tag, callback);
+    tagged_message_writer_t writer(tag, priority, callback);
     {
         semaphore_acq_t outstanding_write_acq (outstanding_writes_semaphores.get());
         parent->message_service->send_message(dest, &writer);
@@ -19,7 +19,8 @@
     app_x_t app_x(&app_x_client);
     message_multiplexer_t::client_t::run_t app_x_run(&app_x_client, &app_x);
 
-    message_multiplexer_t::client_t app_y_client(&multiplexer, 'Y');
+    message_multiplexer_t::client_t app_y_client(&multiplexer, 'Y',
+                                                 message_priority_t::BULK);
     app_y_t app_y(&app_y_client);
     message_multiplexer_t::client_t::run_t app_y_run(&app_y_client, &app_y);
 
@@ -30,6 +31,8 @@
 
     // destructors take care of shutting everything down
 
+Every client's messages are sent with the client's `message_priority_t`, so that
+e.g. app Y's big messages don't hold up app X's.
 */
 
 class message_multiplexer_t {
@@ -56,6 +59,7 @@ public:
             message_handler_t *const message_handler;
         };
         client_t(message_multiplexer_t *, tag_t tag,
+                 message_priority_t priority = message_priority_t::QUERY,
                  int max_outstanding = DEFAULT_MAX_OUTSTANDING_WRITES_PER_THREAD);
         ~client_t();
         connectivity_service_t *get_connectivity_service();
@@ -65,6 +69,7 @@ public:
         friend class message_multiplexer_t;
         message_multiplexer_t *const parent;
         const tag_t tag;
+        const message_priority_t priority;
         run_t *run;
         one_per_thread_t<static_semaphore_t> outstanding_writes_semaphores;
     };
@@ -0,0 +1,35 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RPC_DIRECTORY_DELTA_HPP_
+#define RPC_DIRECTORY_DELTA_HPP_
+
+#include "containers/archive/archive.hpp"
+
+/* When a directory value changes, `directory_write_manager_t` tries to send its
+peers only a delta against the previous value. A metadata type supports this by
+overloading these two functions:
+
+`serialize_directory_delta()` writes a delta that turns `old_value` into
+`new_value` to `msg` and returns true, or returns false if it can't, in which case
+the whole new value is sent.
+
+`apply_directory_delta()` reads a delta written by `serialize_directory_delta()`
+from `s` and applies it to `value`, which is the same as the `old_value` the delta
+was made from. If it fails, `value` may be left partly changed.
+
+The generic versions never make deltas, so types that don't overload them are
+always sent in full. */
+
+template <class metadata_t>
+bool serialize_directory_delta(UNUSED write_message_t *msg,
+                               UNUSED const metadata_t &old_value,
+                               UNUSED const metadata_t &new_value) {
+    return false;
+}
+
+template <class metadata_t>
+MUST_USE archive_result_t apply_directory_delta(UNUSED read_stream_t *s,
+                                                UNUSED metadata_t *value) {
+    return archive_result_t::RANGE_ERROR;
+}
+
+#endif  // RPC_DIRECTORY_DELTA_HPP_
@@ -6,6 +6,8 @@
 #include <boost/ptr_container/ptr_map.hpp>
 #include <boost/shared_ptr.hpp>
 
+#include <vector>
+
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/fifo_enforcer.hpp"
 #include "concurrency/one_per_thread.hpp"
@@ -33,12 +35,15 @@ private:
     when they disconnect. A new `session_t` is created if they reconnect. */
     class session_t {
     public:
-        explicit session_t(uuid_u si) : session_id(si) { }
+        explicit session_t(uuid_u si) : session_id(si), needs_full_update(false) { }
         /* We get this by calling `get_connection_session_id()` on the
         `connectivity_service_t` from `super_connectivity_service`. */
         const uuid_u session_id;
         cond_t got_initial_message;
         scoped_ptr_t<fifo_enforcer_sink_t> metadata_fifo_sink;
+        /* Set if a delta from the peer couldn't be applied. We ignore its deltas
+        until it sends the next full update. */
+        bool needs_full_update;
         auto_drainer_t drainer;
     };
 
@@ -58,7 +63,9 @@ private:
      * but we cannot easily pass that through to the coroutine call, which is why
      * we use boost::shared_ptr instead. */
     void propagate_initialization(peer_id_t peer, uuid_u session_id, const boost::shared_ptr<metadata_t> &new_value, fifo_enforcer_state_t metadata_fifo_state, auto_drainer_t::lock_t per_thread_keepalive) THROWS_NOTHING;
-    void propagate_update(peer_id_t peer, uuid_u session_id, const boost::shared_ptr<metadata_t> &new_value, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t per_thread_keepalive) THROWS_NOTHING;
+    /* For a delta update, `new_value` is empty and `delta` holds the serialized
+    delta instead. */
+    void propagate_update(peer_id_t peer, uuid_u session_id, const boost::shared_ptr<metadata_t> &new_value, const boost::shared_ptr<std::vector<char> > &delta, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t per_thread_keepalive) THROWS_NOTHING;
     void interrupt_updates_and_free_session(session_t *session, auto_drainer_t::lock_t global_keepalive) THROWS_NOTHING;
 
     /* The connectivity service telling us which peers are connected */
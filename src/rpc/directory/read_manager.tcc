@@ -10,6 +10,9 @@
 #include "concurrency/wait_any.hpp"
 #include "config/args.hpp"
 #include "containers/archive/archive.hpp"
+#include "containers/archive/vector_stream.hpp"
+#include "logger.hpp"
+#include "rpc/directory/delta.hpp"
 #include "stl_utils.hpp"
 
 template<class metadata_t>
@@ -85,7 +88,32 @@ void directory_read_manager_t<metadata_t>::on_message(peer_id_t source_peer,
             coro_t::spawn_sometime(boost::bind(
                 &directory_read_manager_t::propagate_update, this,
                 source_peer, connectivity_service->get_connection_session_id(source_peer),
-                new_value, metadata_fifo_token,
+                new_value, boost::shared_ptr<std::vector<char> >(), metadata_fifo_token,
+                auto_drainer_t::lock_t(per_thread_drainers.get())));
+
+            break;
+        }
+
+        case 'D': {
+            /* Delta against the previous value from another peer. We can only
+            apply it on the home thread, so for now we just keep the bytes. */
+            boost::shared_ptr<std::vector<char> > delta(new std::vector<char>());
+            fifo_enforcer_write_token_t metadata_fifo_token;
+            {
+                uint64_t delta_size;
+                archive_result_t res = deserialize(s, &delta_size);
+                if (res != archive_result_t::SUCCESS) { throw fake_archive_exc_t(); }
+                delta->resize(delta_size);
+                int64_t num_read = force_read(s, delta->data(), delta_size);
+                if (num_read != static_cast<int64_t>(delta_size)) { throw fake_archive_exc_t(); }
+                res = deserialize(s, &metadata_fifo_token);
+                if (res != archive_result_t::SUCCESS) { throw fake_archive_exc_t(); }
+            }
+
+            coro_t::spawn_sometime(boost::bind(
+                &directory_read_manager_t::propagate_update, this,
+                source_peer, connectivity_service->get_connection_session_id(source_peer),
+                boost::shared_ptr<metadata_t>(), delta, metadata_fifo_token,
                 auto_drainer_t::lock_t(per_thread_drainers.get())));
 
             break;
@@ -183,7 +211,7 @@ void directory_read_manager_t<metadata_t>::propagate_initialization(peer_id_t pe
 }
 
 template<class metadata_t>
-void directory_read_manager_t<metadata_t>::propagate_update(peer_id_t peer, uuid_u session_id, const boost::shared_ptr<metadata_t> &new_value, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t per_thread_keepalive) THROWS_NOTHING {
+void directory_read_manager_t<metadata_t>::propagate_update(peer_id_t peer, uuid_u session_id, const boost::shared_ptr<metadata_t> &new_value, const boost::shared_ptr<std::vector<char> > &delta, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t per_thread_keepalive) THROWS_NOTHING {
     per_thread_keepalive.assert_is_holding(per_thread_drainers.get());
     on_thread_t thread_switcher(home_thread());
 
@@ -225,7 +253,9 @@ void directory_read_manager_t<metadata_t>::propagate_update(peer_id_t peer, uuid
             struct op_closure_t {
                 static bool apply(const peer_id_t _peer,
                                   const boost::shared_ptr<metadata_t> &_new_value,
+                                  const boost::shared_ptr<std::vector<char> > &_delta,
                                   const boost::ptr_map<peer_id_t, session_t> &_sessions,
+                                  session_t *_session,
                                   change_tracking_map_t<peer_id_t, metadata_t> *map) {
                     typename std::map<peer_id_t, metadata_t>::const_iterator var_it
                         = map->get_inner().find(_peer);
@@ -234,8 +264,25 @@ void directory_read_manager_t<metadata_t>::propagate_update(peer_id_t peer, uuid
                         //The session was deleted we can ignore this update.
                         return false;
                     }
+                    if (_new_value.get() != NULL) {
+                        map->begin_version();
+                        map->set_value(_peer, std::move(*_new_value));
+                        _session->needs_full_update = false;
+                        return true;
+                    }
+                    if (_session->needs_full_update) {
+                        return false;
+                    }
                     map->begin_version();
-                    map->set_value(_peer, std::move(*_new_value));
+                    inplace_vector_read_stream_t stream(_delta.get());
+                    archive_result_t res
+                        = apply_directory_delta(&stream, map->get_mutable_value(_peer));
+                    if (res != archive_result_t::SUCCESS) {
+                        logWRN("Couldn't apply a directory delta from a peer; its "
+                               "directory entry may be out of date until it sends "
+                               "a full update.");
+                        _session->needs_full_update = true;
+                    }
                     return true;
                 }
             };
@@ -243,7 +290,9 @@ void directory_read_manager_t<metadata_t>::propagate_update(peer_id_t peer, uuid
             variable.apply_atomic_op(std::bind(&op_closure_t::apply,
                                                peer,
                                                std::ref(new_value),
+                                               std::ref(delta),
                                                std::ref(sessions),
+                                               session,
                                                std::placeholders::_1));
         }
     } catch (const interrupted_exc_t &) {
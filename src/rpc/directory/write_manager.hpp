@@ -5,6 +5,8 @@
 #include "errors.hpp"
 #include <boost/shared_ptr.hpp>
 
+#include <vector>
+
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/fifo_enforcer.hpp"
 #include "concurrency/watchable.hpp"
@@ -26,7 +28,9 @@ private:
     void on_change() THROWS_NOTHING;
 
     void send_initialization(peer_id_t peer, const metadata_t &initial_value, fifo_enforcer_state_t metadata_fifo_state, auto_drainer_t::lock_t keepalive) THROWS_NOTHING;
-    void send_update(peer_id_t peer, const boost::shared_ptr<metadata_t> &new_value, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t keepalive) THROWS_NOTHING;
+    /* `payload` is the serialized new value if `code` is 'U', or the serialized
+    delta against the previous value if `code` is 'D'. */
+    void send_update(peer_id_t peer, uint8_t code, const boost::shared_ptr<std::vector<char> > &payload, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t keepalive) THROWS_NOTHING;
 
     class initialization_writer_t;
     class update_writer_t;
@@ -34,6 +38,12 @@ private:
     message_service_t *const message_service;
     clone_ptr_t<watchable_t<metadata_t> > value_watchable;
     fifo_enforcer_source_t metadata_fifo_source;
+
+    /* The value that the last update was made from; the next delta is made
+    against it. */
+    boost::shared_ptr<metadata_t> last_value;
+    int updates_since_full_update;
+
     auto_drainer_t drainer;
     typename watchable_t<metadata_t>::subscription_t value_subscription;
     connectivity_service_t::peers_list_subscription_t connectivity_subscription;
@@ -7,7 +7,19 @@
 #include <set>
 
 #include "arch/runtime/coroutines.hpp"
+#include "config/args.hpp"
+#include "containers/archive/vector_stream.hpp"
 #include "rpc/connectivity/messages.hpp"
+#include "rpc/directory/delta.hpp"
+
+inline void directory_message_to_vector(const write_message_t *msg,
+                                        std::vector<char> *out) {
+    vector_stream_t stream;
+    stream.reserve(msg->size());
+    int res = send_write_message(&stream, msg);
+    guarantee(res == 0);
+    stream.swap(out);
+}
 
 template<class metadata_t>
 directory_write_manager_t<metadata_t>::directory_write_manager_t(
@@ -15,11 +27,13 @@ directory_write_manager_t<metadata_t>::directory_write_manager_t(
         const clone_ptr_t<watchable_t<metadata_t> > &value) THROWS_NOTHING :
     message_service(sub),
     value_watchable(value),
+    updates_since_full_update(0),
     value_subscription(boost::bind(&directory_write_manager_t::on_change, this)),
     connectivity_subscription(this) {
     typename watchable_t<metadata_t>::freeze_t value_freeze(value_watchable);
     connectivity_service_t::peers_list_freeze_t connectivity_freeze(message_service->get_connectivity_service());
     guarantee(message_service->get_connectivity_service()->get_peers_list().empty());
+    last_value.reset(new metadata_t(value_watchable->get()));
     value_subscription.reset(value_watchable, &value_freeze);
     connectivity_subscription.reset(message_service->get_connectivity_service(), &connectivity_freeze);
 }
@@ -47,11 +61,30 @@ void directory_write_manager_t<metadata_t>::on_change() THROWS_NOTHING {
     fifo_enforcer_write_token_t metadata_fifo_token = metadata_fifo_source.enter_write();
     std::set<peer_id_t> peers = message_service->get_connectivity_service()->get_peers_list();
     boost::shared_ptr<metadata_t> new_value(new metadata_t(std::move(value_watchable->get())));
+
+    /* The update is serialized once here rather than once per peer. Every peer
+    that gets it has seen `last_value`, either in an earlier update or in its
+    initialization, so we can usually send a delta against that. */
+    uint8_t code;
+    boost::shared_ptr<std::vector<char> > payload(new std::vector<char>());
+    write_message_t msg;
+    ++updates_since_full_update;
+    if (updates_since_full_update < DIRECTORY_FULL_UPDATE_INTERVAL
+            && serialize_directory_delta(&msg, *last_value, *new_value)) {
+        code = 'D';
+    } else {
+        code = 'U';
+        msg << *new_value;
+        updates_since_full_update = 0;
+    }
+    directory_message_to_vector(&msg, payload.get());
+    last_value = new_value;
+
     for (std::set<peer_id_t>::iterator it = peers.begin(); it != peers.end(); it++) {
         coro_t::spawn_sometime(boost::bind(
             &directory_write_manager_t::send_update, this,
             *it,
-            new_value, metadata_fifo_token,
+            code, payload, metadata_fifo_token,
             auto_drainer_t::lock_t(&drainer)));
     }
 }
@@ -82,15 +115,19 @@ private:
 template <class metadata_t>
 class directory_write_manager_t<metadata_t>::update_writer_t : public send_message_write_callback_t {
 public:
-    update_writer_t(const metadata_t &_new_value, fifo_enforcer_write_token_t _metadata_fifo_token) :
-        new_value(_new_value), metadata_fifo_token(_metadata_fifo_token) { }
+    update_writer_t(uint8_t _code, const std::vector<char> &_payload, fifo_enforcer_write_token_t _metadata_fifo_token) :
+        code(_code), payload(_payload), metadata_fifo_token(_metadata_fifo_token) { }
     ~update_writer_t() { }
 
     void write(write_stream_t *stream) {
         write_message_t msg;
-        uint8_t code = 'U';
         msg << code;
-        msg << new_value;
+        if (code == 'D') {
+            /* The receiver needs to know where the delta ends, because it has
+            to hold on to it until it can be applied. */
+            msg << static_cast<uint64_t>(payload.size());
+        }
+        msg.append(payload.data(), payload.size());
         msg << metadata_fifo_token;
         int res = send_write_message(stream, &msg);
         if (res) {
@@ -98,7 +135,8 @@ public:
         }
     }
 private:
-    const metadata_t &new_value;
+    uint8_t code;
+    const std::vector<char> &payload;
     fifo_enforcer_write_token_t metadata_fifo_token;
 };
 
@@ -109,8 +147,8 @@ void directory_write_manager_t<metadata_t>::send_initialization(peer_id_t peer,
 }
 
 template<class metadata_t>
-void directory_write_manager_t<metadata_t>::send_update(peer_id_t peer, const boost::shared_ptr<metadata_t> &new_value, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t) THROWS_NOTHING {
-    update_writer_t writer(*new_value, metadata_fifo_token);
+void directory_write_manager_t<metadata_t>::send_update(peer_id_t peer, uint8_t code, const boost::shared_ptr<std::vector<char> > &payload, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t) THROWS_NOTHING {
+    update_writer_t writer(code, *payload, metadata_fifo_token);
     message_service->send_message(peer, &writer);
 }
 
@@ -6,6 +6,7 @@
 #include <functional>
 
 #include "containers/archive/archive.hpp"
+#include "containers/archive/shared_buffer_stream.hpp"
 #include "containers/archive/vector_stream.hpp"
 #include "concurrency/pmap.hpp"
 #include "logger.hpp"
@@ -53,105 +54,214 @@ raw_mailbox_t::address_t raw_mailbox_t::get_address() const {
     return a;
 }
 
-class raw_mailbox_writer_t : public send_message_write_callback_t {
+class mailbox_batch_writer_t : public send_message_write_callback_t {
 public:
-    raw_mailbox_writer_t(int32_t _dest_thread, raw_mailbox_t::id_t _dest_mailbox_id, mailbox_write_callback_t *_subwriter) :
-        dest_thread(_dest_thread), dest_mailbox_id(_dest_mailbox_id), subwriter(_subwriter) { }
-    virtual ~raw_mailbox_writer_t() { }
+    mailbox_batch_writer_t(int32_t _dest_thread, uint64_t _num_messages,
+                           const std::vector<char> *_data) :
+        dest_thread(_dest_thread), num_messages(_num_messages), data(_data) { }
+    virtual ~mailbox_batch_writer_t() { }
 
     void write(write_stream_t *stream) {
         write_message_t msg;
         msg << dest_thread;
-        msg << dest_mailbox_id;
-        uint64_t prefix_length = static_cast<uint64_t>(msg.size());
-
-        subwriter->write(&msg);
-
-        // Prepend the message length
-        // TODO: It would be more efficient if we could make this part of `msg`.
-        //  e.g. with a `prepend()` method on write_message_t.
-        write_message_t length_msg;
-        length_msg << (static_cast<uint64_t>(msg.size()) - prefix_length);
-
-        int res = send_write_message(stream, &length_msg);
-        if (res) { throw fake_archive_exc_t(); }
-        res = send_write_message(stream, &msg);
+        msg << num_messages;
+        int res = send_write_message(stream, &msg);
         if (res) { throw fake_archive_exc_t(); }
+        int64_t written = stream->write(data->data(), data->size());
+        if (written != static_cast<int64_t>(data->size())) { throw fake_archive_exc_t(); }
     }
 private:
     int32_t dest_thread;
-    raw_mailbox_t::id_t dest_mailbox_id;
-    mailbox_write_callback_t *subwriter;
+    uint64_t num_messages;
+    const std::vector<char> *data;
 };
 
 void send(mailbox_manager_t *src, raw_mailbox_t::address_t dest, mailbox_write_callback_t *callback) {
     guarantee(src);
     guarantee(!dest.is_nil());
-    raw_mailbox_writer_t writer(dest.thread, dest.mailbox_id, callback);
-    src->message_service->send_message(dest.peer, &writer);
+    src->send_batched(dest.peer, dest.thread, dest.mailbox_id, callback);
 }
 
-mailbox_manager_t::mailbox_manager_t(message_service_t *ms) :
-    message_service(ms)
-    { }
+/* mailbox_table_t */
+
+const uint32_t mailbox_table_t::NO_FREE_SLOT = UINT32_MAX;
 
-mailbox_manager_t::mailbox_table_t::mailbox_table_t() {
-    next_mailbox_id = (UINT64_MAX / get_num_threads()) * get_thread_id().threadnum;
+mailbox_table_t::mailbox_table_t() : first_free(NO_FREE_SLOT), num_mailboxes(0) { }
+
+mailbox_table_t::~mailbox_table_t() {
+    guarantee(num_mailboxes == 0, "Please destroy all mailboxes before destroying the cluster");
+}
+
+raw_mailbox_t::id_t mailbox_table_t::register_mailbox(raw_mailbox_t *mailbox) {
+    guarantee(mailbox != NULL);
+    uint32_t index;
+    if (first_free != NO_FREE_SLOT) {
+        index = first_free;
+        first_free = slots[index].next_free;
+    } else {
+        guarantee(slots.size() < NO_FREE_SLOT, "Too many mailboxes on one thread");
+        index = slots.size();
+        slot_t slot;
+        slot.generation = 0;
+        slots.push_back(slot);
+    }
+    slot_t *slot = &slots[index];
+    slot->mailbox = mailbox;
+    // Generations start at 1, so that no mailbox gets the ID 0.
+    ++slot->generation;
+    if (slot->generation == 0) {
+        ++slot->generation;
+    }
+    ++num_mailboxes;
+    return (static_cast<raw_mailbox_t::id_t>(slot->generation) << 32) | index;
 }
 
-mailbox_manager_t::mailbox_table_t::~mailbox_table_t() {
-    guarantee(mailboxes.empty(), "Please destroy all mailboxes before destroying the cluster");
+void mailbox_table_t::unregister_mailbox(raw_mailbox_t::id_t id) {
+    const uint32_t index = static_cast<uint32_t>(id);
+    guarantee(index < slots.size());
+    slot_t *slot = &slots[index];
+    guarantee(slot->mailbox != NULL && slot->generation == static_cast<uint32_t>(id >> 32));
+    slot->mailbox = NULL;
+    slot->next_free = first_free;
+    first_free = index;
+    --num_mailboxes;
 }
 
-raw_mailbox_t *mailbox_manager_t::mailbox_table_t::find_mailbox(raw_mailbox_t::id_t id) {
-    std::map<raw_mailbox_t::id_t, raw_mailbox_t *>::iterator it = mailboxes.find(id);
-    if (it == mailboxes.end()) {
+raw_mailbox_t *mailbox_table_t::find_mailbox(raw_mailbox_t::id_t id) const {
+    const uint32_t index = static_cast<uint32_t>(id);
+    if (index >= slots.size()) {
         return NULL;
+    }
+    const slot_t &slot = slots[index];
+    // A free slot's mailbox is NULL, so we don't need to check for that.
+    return slot.generation == static_cast<uint32_t>(id >> 32) ? slot.mailbox : NULL;
+}
+
+/* mailbox_manager_t */
+
+mailbox_manager_t::mailbox_manager_t(message_service_t *ms) :
+    message_service(ms)
+    { }
+
+void mailbox_manager_t::send_batched(peer_id_t dest_peer,
+                                     int32_t dest_thread,
+                                     raw_mailbox_t::id_t dest_mailbox_id,
+                                     mailbox_write_callback_t *callback) {
+    write_message_t msg;
+    callback->write(&msg);
+
+    const std::pair<peer_id_t, int32_t> key(dest_peer, dest_thread);
+    outgoing_batches_t *batches = outgoing_batches.get();
+    scoped_ptr_t<outgoing_batch_t> *batch_ptr = &(*batches)[key];
+    if (!batch_ptr->has()) {
+        batch_ptr->init(new outgoing_batch_t);
+    }
+    outgoing_batch_t *batch = batch_ptr->get();
+
+    {
+        write_message_t header;
+        header << dest_mailbox_id;
+        header << static_cast<uint64_t>(msg.size());
+        int res = send_write_message(&batch->data, &header);
+        guarantee(res == 0);
+        res = send_write_message(&batch->data, &msg);
+        guarantee(res == 0);
+        ++batch->num_messages;
+    }
+
+    batch_waiter_t waiter;
+    batch->waiters.push_back(&waiter);
+    while (batch->sending) {
+        waiter.wakeup.wait();
+        if (waiter.sent) {
+            return;
+        }
+        /* Otherwise the previous sender handed the job of sending over to us, but
+        another coroutine might have taken it before we got to run. */
+        waiter.wakeup.reset();
+    }
+
+    batch->sending = true;
+
+    // Let the other coroutines that are ready to run add their messages first.
+    coro_t::yield();
+
+    std::vector<char> data;
+    batch->data.swap(&data);
+    const uint64_t num_messages = batch->num_messages;
+    batch->num_messages = 0;
+    intrusive_list_t<batch_waiter_t> waiters;
+    waiters.append_and_clear(&batch->waiters);
+
+    mailbox_batch_writer_t writer(dest_thread, num_messages, &data);
+    message_service->send_message(dest_peer, &writer);
+
+    while (!waiters.empty()) {
+        batch_waiter_t *w = waiters.head();
+        waiters.remove(w);
+        w->sent = true;
+        if (w != &waiter) {
+            w->wakeup.pulse_if_not_already_pulsed();
+        }
+    }
+    batch->sending = false;
+
+    if (!batch->waiters.empty()) {
+        // Hand the job of sending the next batch over to its first sender.
+        batch->waiters.head()->wakeup.pulse_if_not_already_pulsed();
     } else {
-        return it->second;
+        batches->erase(key);
     }
 }
 
 void mailbox_manager_t::on_message(peer_id_t source_peer, read_stream_t *stream) {
     int32_t dest_thread;
-    uint64_t data_length = 0;
-    raw_mailbox_t::id_t dest_mailbox_id;
+    uint64_t num_messages;
     {
-        archive_result_t res = deserialize(stream, &data_length);
-        if (res != archive_result_t::SUCCESS
-            || data_length > std::numeric_limits<size_t>::max()
-            || data_length > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
-            throw fake_archive_exc_t();
-        }
-
-        res = deserialize(stream, &dest_thread);
-        if (bad(res)) { throw fake_archive_exc_t(); }
-        res = deserialize(stream, &dest_mailbox_id);
+        archive_result_t res = deserialize(stream, &dest_thread);
         if (bad(res)) { throw fake_archive_exc_t(); }
+        res = deserialize(stream, &num_messages);
+        if (bad(res) || num_messages == 0) { throw fake_archive_exc_t(); }
     }
 
     // Read the data from the read stream, so it can be deallocated before we continue
     // in a coroutine
-    std::vector<char> stream_data;
-    int64_t stream_data_offset = 0;
-    // Special case for `vector_read_stream_t`s to avoid copying.
-    // `connectivity_cluster_t` gives us a `vector_read_stream_t` if the message is
-    // delivered locally.
-    vector_read_stream_t *vector_stream = dynamic_cast<vector_read_stream_t *>(stream);
-    if (vector_stream != NULL) {
-        // Avoid copying the data
-        vector_stream->swap(&stream_data, &stream_data_offset);
-        if(stream_data.size() - static_cast<uint64_t>(stream_data_offset) != data_length) {
-            // Either we go a vector_read_stream_t that contained more data
-            // than just ours (which shouldn't happen), or we got a wrong data_length
-            // from the network.
+    std::vector<incoming_message_t> messages;
+    for (uint64_t i = 0; i < num_messages; ++i) {
+        messages.push_back(incoming_message_t());
+        incoming_message_t *message = &messages.back();
+        message->data_offset = 0;
+
+        uint64_t data_length = 0;
+        archive_result_t res = deserialize(stream, &message->dest_mailbox_id);
+        if (bad(res)) { throw fake_archive_exc_t(); }
+        res = deserialize(stream, &data_length);
+        if (res != archive_result_t::SUCCESS
+            || data_length > std::numeric_limits<size_t>::max()
+            || data_length > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
             throw fake_archive_exc_t();
         }
-    } else {
-        stream_data.resize(data_length);
-        int64_t bytes_read = force_read(stream, stream_data.data(), data_length);
-        if (bytes_read != static_cast<int64_t>(data_length)) {
-            throw fake_archive_exc_t();
+
+        // Special case for `vector_read_stream_t`s to avoid copying the last message
+        // of a batch, which is the only message of a lone big one. All messages we
+        // get from `connectivity_cluster_t` come in a `vector_read_stream_t`.
+        vector_read_stream_t *vector_stream = dynamic_cast<vector_read_stream_t *>(stream);
+        if (vector_stream != NULL && i + 1 == num_messages) {
+            // Avoid copying the data
+            vector_stream->swap(&message->data, &message->data_offset);
+            if (message->data.size() - static_cast<uint64_t>(message->data_offset)
+                != data_length) {
+                // Either we go a vector_read_stream_t that contained more data
+                // than just ours (which shouldn't happen), or we got a wrong
+                // data_length from the network.
+                throw fake_archive_exc_t();
+            }
+        } else {
+            message->data.resize(data_length);
+            int64_t bytes_read = force_read(stream, message->data.data(), data_length);
+            if (bytes_read != static_cast<int64_t>(data_length)) {
+                throw fake_archive_exc_t();
+            }
         }
     }
 
@@ -160,64 +270,67 @@ void mailbox_manager_t::on_message(peer_id_t source_peer, read_stream_t *stream)
         dest_thread = get_thread_id().threadnum;
     }
 
-    // We use `spawn_now_dangerously()` to avoid having to heap-allocate `stream_data`.
+    // We use `spawn_now_dangerously()` to avoid having to heap-allocate `messages`.
     // Instead we pass in a pointer to our local automatically allocated object
     // and `mailbox_read_coroutine()` moves the data out of it before it yields.
     coro_t::spawn_now_dangerously(std::bind(&mailbox_manager_t::mailbox_read_coroutine,
                                             this, source_peer, threadnum_t(dest_thread),
-                                            dest_mailbox_id, &stream_data,
-                                            stream_data_offset));
+                                            &messages));
 }
 
 void mailbox_manager_t::mailbox_read_coroutine(peer_id_t source_peer,
                                                threadnum_t dest_thread,
-                                               raw_mailbox_t::id_t dest_mailbox_id,
-                                               std::vector<char> *stream_data,
-                                               int64_t stream_data_offset) {
+                                               std::vector<incoming_message_t> *messages) {
+    std::vector<incoming_message_t> batch(std::move(*messages));
+    messages = NULL; // <- It is not safe to use `messages` anymore once we
+                     //    switch the thread
+
+    const threadnum_t source_thread = get_thread_id();
+
+    // The whole batch goes to `dest_thread` at once. Each message still gets a
+    // coroutine of its own there, since mailbox callbacks may block.
+    on_thread_t rethreader(dest_thread);
+    for (auto it = batch.begin(); it != batch.end(); ++it) {
+        coro_t::spawn_now_dangerously(std::bind(&mailbox_manager_t::mailbox_read_message,
+                                                this, source_peer, source_thread,
+                                                it->dest_mailbox_id, &it->data,
+                                                it->data_offset));
+    }
+}
 
-    // Construct a new stream to use
-    vector_read_stream_t stream(std::move(*stream_data), stream_data_offset);
-    stream_data = NULL; // <- It is not safe to use `stream_data` anymore once we
-                        //    switch the thread
+void mailbox_manager_t::mailbox_read_message(peer_id_t source_peer,
+                                             threadnum_t source_thread,
+                                             raw_mailbox_t::id_t dest_mailbox_id,
+                                             std::vector<char> *data,
+                                             int64_t data_offset) {
+    // Construct a new stream to use. Big strings in the message will be borrowed from
+    // it rather than copied, so the message may outlive this function.
+    shared_buffer_read_stream_t stream(std::move(*data), data_offset);
+    data = NULL; // <- It is not safe to use `data` anymore once we yield
 
     bool archive_exception = false;
-    {
-        on_thread_t rethreader(dest_thread);
-
-        try {
-            raw_mailbox_t *mbox = mailbox_tables.get()->find_mailbox(dest_mailbox_id);
-            if (mbox != NULL) {
-                mbox->callback->read(&stream);
-            }
-        } catch (const fake_archive_exc_t &e) {
-            // Set a flag and handle the exception later.
-            // This is to avoid doing thread switches and other coroutine things
-            // while being in the exception handler. Just a precaution...
-            archive_exception = true;
+    try {
+        raw_mailbox_t *mbox = mailbox_tables.get()->find_mailbox(dest_mailbox_id);
+        if (mbox != NULL) {
+            mbox->callback->read(&stream);
         }
+    } catch (const fake_archive_exc_t &e) {
+        // Set a flag and handle the exception later.
+        // This is to avoid doing thread switches and other coroutine things
+        // while being in the exception handler. Just a precaution...
+        archive_exception = true;
     }
     if (archive_exception) {
         logWRN("Received an invalid cluster message from a peer. Disconnecting.");
+        on_thread_t rethreader(source_thread);
         message_service->kill_connection(source_peer);
     }
 }
 
-raw_mailbox_t::id_t mailbox_manager_t::generate_mailbox_id() {
-    raw_mailbox_t::id_t id = ++mailbox_tables.get()->next_mailbox_id;
-    return id;
-}
-
 raw_mailbox_t::id_t mailbox_manager_t::register_mailbox(raw_mailbox_t *mb) {
-    raw_mailbox_t::id_t id = generate_mailbox_id();
-    std::map<raw_mailbox_t::id_t, raw_mailbox_t *> *mailboxes = &mailbox_tables.get()->mailboxes;
-    std::pair<std::map<raw_mailbox_t::id_t, raw_mailbox_t *>::iterator, bool> res
-        = mailboxes->insert(std::make_pair(id, mb));
-    guarantee(res.second);  // Assert a new element was inserted.
-    return id;
+    return mailbox_tables.get()->register_mailbox(mb);
 }
 
 void mailbox_manager_t::unregister_mailbox(raw_mailbox_t::id_t id) {
-    size_t num_elements_erased = mailbox_tables.get()->mailboxes.erase(id);
-    guarantee(num_elements_erased == 1);
+    mailbox_tables.get()->unregister_mailbox(id);
 }
-
@@ -4,10 +4,13 @@
 
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "concurrency/cond_var.hpp"
 #include "containers/archive/archive.hpp"
 #include "containers/archive/vector_stream.hpp"
+#include "containers/intrusive_list.hpp"
 #include "rpc/connectivity/cluster.hpp"
 #include "rpc/semilattice/joins/macros.hpp"
 
@@ -37,7 +40,6 @@ public:
 
 private:
     friend class mailbox_manager_t;
-    friend class raw_mailbox_writer_t;
     friend void send(mailbox_manager_t *, address_t, mailbox_write_callback_t *);
 
     mailbox_manager_t *manager;
@@ -94,14 +96,50 @@ public:
     address_t get_address() const;
 };
 
-/* `send()` sends a message to a mailbox. It is safe to call `send()` outside of
-a coroutine; it does not block. If the mailbox does not exist or the peer is
+/* `send()` sends a message to a mailbox. It blocks until the message has been
+handed to the message service. If the mailbox does not exist or the peer is
 inaccessible, `send()` will silently fail. */
 
 void send(mailbox_manager_t *src,
           raw_mailbox_t::address_t dest,
           mailbox_write_callback_t *callback);
 
+/* `mailbox_table_t` maps the IDs of the mailboxes on one thread to the mailboxes.
+It's an array of slots, and a mailbox's ID is the index of its slot together with
+a generation number that changes every time the slot gets reused, so that messages
+for a mailbox that's gone can't reach the next mailbox in its slot. Lookups,
+registering and unregistering take constant time, and only registering ever
+allocates, when the array needs to grow. */
+
+class mailbox_table_t {
+public:
+    mailbox_table_t();
+    ~mailbox_table_t();
+
+    raw_mailbox_t::id_t register_mailbox(raw_mailbox_t *mailbox);
+    void unregister_mailbox(raw_mailbox_t::id_t id);
+
+    /* Returns NULL if there is no mailbox with that ID (anymore). */
+    raw_mailbox_t *find_mailbox(raw_mailbox_t::id_t id) const;
+
+private:
+    static const uint32_t NO_FREE_SLOT;
+
+    struct slot_t {
+        /* NULL if the slot is free */
+        raw_mailbox_t *mailbox;
+        uint32_t generation;
+        /* The next slot on the free list, if the slot is free */
+        uint32_t next_free;
+    };
+
+    std::vector<slot_t> slots;
+    uint32_t first_free;
+    size_t num_mailboxes;
+
+    DISABLE_COPYING(mailbox_table_t);
+};
+
 /* `mailbox_manager_t` uses a `message_service_t` to provide mailbox capability.
 Usually you will split a `message_service_t` into several sub-services using
 `message_multiplexer_t` and put a `mailbox_manager_t` on only one of them,
@@ -123,32 +161,62 @@ private:
 
     message_service_t *message_service;
 
-    struct mailbox_table_t {
-        mailbox_table_t();
-        ~mailbox_table_t();
-        raw_mailbox_t::id_t next_mailbox_id;
-        // TODO: use a buffered structure to reduce dynamic allocation
-        std::map<raw_mailbox_t::id_t, raw_mailbox_t *> mailboxes;
-        raw_mailbox_t *find_mailbox(raw_mailbox_t::id_t);
-    };
     one_per_thread_t<mailbox_table_t> mailbox_tables;
 
-    raw_mailbox_t::id_t generate_mailbox_id();
-
     raw_mailbox_t::id_t register_mailbox(raw_mailbox_t *mb);
     void unregister_mailbox(raw_mailbox_t::id_t id);
 
-    static void write_mailbox_message(write_stream_t *stream,
-                                      threadnum_t dest_thread,
-                                      raw_mailbox_t::id_t dest_mailbox_id,
-                                      mailbox_write_callback_t *callback);
+    /* Messages to mailboxes on the same peer and thread are sent in batches: while
+    one batch is being sent, the messages for the next one queue up behind it. So
+    under load, many small messages share one cluster message and one thread hop
+    on the receiving end, but when things are quiet no message waits for others.
+    A batch is sent as the destination thread, the number of messages, and then
+    the mailbox ID, size and data of each message. */
+    class batch_waiter_t : public intrusive_list_node_t<batch_waiter_t> {
+    public:
+        batch_waiter_t() : sent(false) { }
+        bool sent;
+        /* Pulsed when the message has been sent, or when it's this sender's turn
+        to send the batch. */
+        cond_t wakeup;
+    private:
+        DISABLE_COPYING(batch_waiter_t);
+    };
+
+    struct outgoing_batch_t {
+        outgoing_batch_t() : num_messages(0), sending(false) { }
+        ~outgoing_batch_t() {
+            guarantee(waiters.empty());
+        }
+        vector_stream_t data;
+        uint64_t num_messages;
+        /* The senders of the messages in `data` */
+        intrusive_list_t<batch_waiter_t> waiters;
+        bool sending;
+    };
+
+    typedef std::map<std::pair<peer_id_t, int32_t>, scoped_ptr_t<outgoing_batch_t> >
+        outgoing_batches_t;
+    one_per_thread_t<outgoing_batches_t> outgoing_batches;
+
+    void send_batched(peer_id_t dest_peer, int32_t dest_thread,
+                      raw_mailbox_t::id_t dest_mailbox_id,
+                      mailbox_write_callback_t *callback);
+
+    struct incoming_message_t {
+        raw_mailbox_t::id_t dest_mailbox_id;
+        std::vector<char> data;
+        int64_t data_offset;
+    };
 
     void on_message(peer_id_t source_peer, read_stream_t *stream);
 
     void mailbox_read_coroutine(peer_id_t source_peer, threadnum_t dest_thread,
-                                raw_mailbox_t::id_t dest_mailbox_id,
-                                std::vector<char> *stream_data,
-                                int64_t stream_data_offset);
+                                std::vector<incoming_message_t> *messages);
+
+    void mailbox_read_message(peer_id_t source_peer, threadnum_t source_thread,
+                              raw_mailbox_t::id_t dest_mailbox_id,
+                              std::vector<char> *data, int64_t data_offset);
 };
 
 #endif /* RPC_MAILBOX_MAILBOX_HPP_ */
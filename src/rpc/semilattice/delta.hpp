@@ -0,0 +1,124 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RPC_SEMILATTICE_DELTA_HPP_
+#define RPC_SEMILATTICE_DELTA_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "containers/archive/archive.hpp"
+#include "containers/archive/stl_types.hpp"
+#include "containers/archive/vector_stream.hpp"
+
+/* `semilattice_manager_t` normally sends its peers the whole metadata that was
+joined, and its whole metadata when a peer connects. A metadata type that is made up
+of maps of separately versioned entries (like the namespaces or databases of the
+cluster metadata) can do better by overloading these functions:
+
+`get_semilattice_delta()` sets `*delta_out` to the parts of `added` that differ from
+`current` and returns true. Joining the delta has the same effect as joining
+`added` for anyone whose metadata is at least `current`.
+
+`get_semilattice_digest()` describes `value` as a map from an ID for each entry to a
+hash of that entry, and returns true.
+
+`get_semilattice_digest_difference()` sets `*difference_out` to the entries of
+`value` that are missing from `digest` or have a different hash there. Two peers
+that swap digests and then join each other's differences end up with the same
+metadata.
+
+The generic versions return false, so types that don't overload them are always
+sent in full. */
+
+typedef std::map<std::string, uint64_t> semilattice_digest_t;
+
+template <class metadata_t>
+bool get_semilattice_delta(UNUSED const metadata_t &current,
+                           UNUSED const metadata_t &added,
+                           UNUSED metadata_t *delta_out) {
+    return false;
+}
+
+template <class metadata_t>
+bool get_semilattice_digest(UNUSED const metadata_t &value,
+                            UNUSED semilattice_digest_t *digest_out) {
+    return false;
+}
+
+template <class metadata_t>
+void get_semilattice_digest_difference(UNUSED const metadata_t &value,
+                                       UNUSED const semilattice_digest_t &digest,
+                                       UNUSED metadata_t *difference_out) {
+    unreachable();
+}
+
+/* Building blocks for overloads of the above, for metadata that consists of maps.
+`tag` tells the maps of one metadata type apart in the digest. */
+
+template <class key_t, class value_t>
+void get_changed_map_entries(const std::map<key_t, value_t> &current,
+                             const std::map<key_t, value_t> &added,
+                             std::map<key_t, value_t> *delta_out) {
+    typename std::map<key_t, value_t>::const_iterator current_it = current.begin();
+    for (typename std::map<key_t, value_t>::const_iterator it = added.begin();
+         it != added.end(); ++it) {
+        while (current_it != current.end() && current_it->first < it->first) {
+            ++current_it;
+        }
+        if (current_it == current.end() || it->first < current_it->first
+                || !(current_it->second == it->second)) {
+            delta_out->insert(delta_out->end(), *it);
+        }
+    }
+}
+
+template <class T>
+std::string serialize_for_semilattice_digest(const T &value) {
+    write_message_t msg;
+    msg << value;
+    vector_stream_t stream;
+    stream.reserve(msg.size());
+    int res = send_write_message(&stream, &msg);
+    guarantee(res == 0);
+    return std::string(stream.vector().begin(), stream.vector().end());
+}
+
+// 64-bit FNV-1a. The hashes are only compared between peers running the same
+// version, and nobody is trying to make them collide.
+inline uint64_t semilattice_digest_hash(const std::string &data) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < data.size(); ++i) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+template <class key_t, class value_t>
+void add_map_to_semilattice_digest(char tag,
+                                   const std::map<key_t, value_t> &map,
+                                   semilattice_digest_t *digest_out) {
+    for (typename std::map<key_t, value_t>::const_iterator it = map.begin();
+         it != map.end(); ++it) {
+        (*digest_out)[tag + serialize_for_semilattice_digest(it->first)]
+            = semilattice_digest_hash(serialize_for_semilattice_digest(it->second));
+    }
+}
+
+template <class key_t, class value_t>
+void get_map_digest_difference(char tag,
+                               const std::map<key_t, value_t> &map,
+                               const semilattice_digest_t &digest,
+                               std::map<key_t, value_t> *difference_out) {
+    for (typename std::map<key_t, value_t>::const_iterator it = map.begin();
+         it != map.end(); ++it) {
+        semilattice_digest_t::const_iterator digest_it
+            = digest.find(tag + serialize_for_semilattice_digest(it->first));
+        if (digest_it == digest.end() || digest_it->second
+                != semilattice_digest_hash(serialize_for_semilattice_digest(it->second))) {
+            difference_out->insert(difference_out->end(), *it);
+        }
+    }
+}
+
+#endif  // RPC_SEMILATTICE_DELTA_HPP_
@@ -6,6 +6,7 @@
 #include <utility>
 
 #include "rpc/mailbox/mailbox.hpp"
+#include "rpc/semilattice/delta.hpp"
 #include "rpc/semilattice/view.hpp"
 
 class cond_t;
@@ -29,6 +30,10 @@ constraints:
     such that `metadata_t` is a semilattice and `semilattice_join(a, b)` sets
     `*a` to the semilattice-join of `*a` and `b`.
 
+4. Optionally, it can overload the functions in `rpc/semilattice/delta.hpp`, so
+    that only the changed parts of the metadata are sent to peers, and peers that
+    connect only exchange the entries in which they differ.
+
 Currently it's not thread-safe at all; all accesses to the metadata must be on
 the home thread of the `semilattice_manager_t`. */
 
@@ -57,6 +62,7 @@ private:
     };
 
     class metadata_writer_t;
+    class digest_writer_t;
     class sync_from_query_writer_t;
     class sync_from_reply_writer_t;
     class sync_to_query_writer_t;
@@ -70,7 +76,9 @@ private:
 
     /* These are spawned in new coroutines. */
     void send_metadata_to_peer(peer_id_t, metadata_t, metadata_version_t, auto_drainer_t::lock_t);
+    void send_initial_metadata_to_peer(peer_id_t, auto_drainer_t::lock_t);
     void deliver_metadata_on_home_thread(peer_id_t sender, metadata_t, metadata_version_t, auto_drainer_t::lock_t);
+    void deliver_digest_on_home_thread(peer_id_t sender, semilattice_digest_t digest, auto_drainer_t::lock_t);
     void deliver_sync_from_query_on_home_thread(peer_id_t sender, sync_from_query_id_t query_id, auto_drainer_t::lock_t);
     void deliver_sync_from_reply_on_home_thread(peer_id_t sender, sync_from_query_id_t query_id, metadata_version_t version, auto_drainer_t::lock_t);
     void deliver_sync_to_query_on_home_thread(peer_id_t sender, sync_to_query_id_t query_id, metadata_version_t version, auto_drainer_t::lock_t);
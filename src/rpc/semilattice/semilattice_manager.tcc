@@ -61,6 +61,15 @@ void semilattice_manager_t<metadata_t>::root_view_t::join(const metadata_t &adde
     parent->assert_thread();
 
     metadata_version_t new_version = ++parent->metadata_version;
+
+    /* `added_metadata` is usually the whole metadata with a few entries changed,
+    so if we can we only send the entries that are actually new to us. We send the
+    (possibly empty) delta even if nothing changed, because peers track which of
+    our versions they've seen. */
+    metadata_t delta;
+    const bool have_delta = get_semilattice_delta(parent->metadata, added_metadata, &delta);
+    const metadata_t &metadata_to_send = have_delta ? delta : added_metadata;
+
     parent->join_metadata_locally(added_metadata);
 
     /* Distribute changes to all peers we can currently see. If we can't
@@ -72,13 +81,14 @@ void semilattice_manager_t<metadata_t>::root_view_t::join(const metadata_t &adde
         if (*it != parent->message_service->get_connectivity_service()->get_me()) {
             coro_t::spawn_sometime(boost::bind(
                 &semilattice_manager_t<metadata_t>::send_metadata_to_peer, parent,
-                *it, added_metadata, new_version,
+                *it, metadata_to_send, new_version,
                 auto_drainer_t::lock_t(parent->drainers.get())));
         }
     }
 }
 
 static const char message_code_metadata = 'M';
+static const char message_code_digest = 'D';
 static const char message_code_sync_from_query = 'F';
 static const char message_code_sync_from_reply = 'f';
 static const char message_code_sync_to_query = 'T';
@@ -104,6 +114,24 @@ private:
     metadata_version_t mdv;
 };
 
+template <class metadata_t>
+class semilattice_manager_t<metadata_t>::digest_writer_t : public send_message_write_callback_t {
+public:
+    explicit digest_writer_t(const semilattice_digest_t &_digest) :
+        digest(_digest) { }
+
+    void write(write_stream_t *stream) {
+        write_message_t msg;
+        uint8_t code = message_code_digest;
+        msg << code;
+        msg << digest;
+        int res = send_write_message(stream, &msg);
+        if (res) { throw fake_archive_exc_t(); }
+    }
+private:
+    const semilattice_digest_t &digest;
+};
+
 template <class metadata_t>
 class semilattice_manager_t<metadata_t>::sync_from_query_writer_t : public send_message_write_callback_t {
 public:
@@ -246,6 +274,17 @@ void semilattice_manager_t<metadata_t>::on_message(peer_id_t sender, read_stream
                 sender, added_metadata, change_version, auto_drainer_t::lock_t(drainers.get())));
             break;
         }
+        case message_code_digest: {
+            semilattice_digest_t digest;
+            {
+                archive_result_t res = deserialize(stream, &digest);
+                if (bad(res)) { throw fake_archive_exc_t(); }
+            }
+            coro_t::spawn_sometime(boost::bind(
+                &semilattice_manager_t<metadata_t>::deliver_digest_on_home_thread, this,
+                sender, digest, auto_drainer_t::lock_t(drainers.get())));
+            break;
+        }
         case message_code_sync_from_query: {
             sync_from_query_id_t query_id;
             {
@@ -312,8 +351,8 @@ void semilattice_manager_t<metadata_t>::on_connect(peer_id_t peer) {
     /* We have to spawn this in a separate coroutine because `on_connect()` is
     not supposed to block. */
     coro_t::spawn_sometime(boost::bind(
-        &semilattice_manager_t<metadata_t>::send_metadata_to_peer, this,
-        peer, metadata, metadata_version, auto_drainer_t::lock_t(drainers.get())));
+        &semilattice_manager_t<metadata_t>::send_initial_metadata_to_peer, this,
+        peer, auto_drainer_t::lock_t(drainers.get())));
 }
 
 template<class metadata_t>
@@ -329,6 +368,31 @@ void semilattice_manager_t<metadata_t>::send_metadata_to_peer(peer_id_t peer, me
     message_service->send_message(peer, &writer);
 }
 
+template<class metadata_t>
+void semilattice_manager_t<metadata_t>::send_initial_metadata_to_peer(peer_id_t peer, auto_drainer_t::lock_t keepalive) {
+    assert_thread();
+    /* If the metadata supports digests, we send the peer a digest of ours and it
+    replies with the entries we're missing, and vice versa. Otherwise we just send
+    all of our metadata. */
+    semilattice_digest_t digest;
+    if (get_semilattice_digest(metadata, &digest)) {
+        digest_writer_t writer(digest);
+        message_service->send_message(peer, &writer);
+    } else {
+        send_metadata_to_peer(peer, metadata, metadata_version, keepalive);
+    }
+}
+
+template<class metadata_t>
+void semilattice_manager_t<metadata_t>::deliver_digest_on_home_thread(peer_id_t sender, semilattice_digest_t digest, auto_drainer_t::lock_t keepalive) {
+    on_thread_t thread_switcher(home_thread());
+    /* This counts as the peer hearing about all of our metadata up to now, just
+    like the full metadata we'd otherwise send it when it connects. */
+    metadata_t difference;
+    get_semilattice_digest_difference(metadata, digest, &difference);
+    send_metadata_to_peer(sender, difference, metadata_version, keepalive);
+}
+
 template<class metadata_t>
 void semilattice_manager_t<metadata_t>::deliver_metadata_on_home_thread(peer_id_t sender, metadata_t md, metadata_version_t mv, auto_drainer_t::lock_t) {
     on_thread_t thread_switcher(home_thread());
@@ -0,0 +1,288 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "serializer/buffer_allocator.hpp"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "arch/runtime/numa.hpp"
+#include "arch/spinlock.hpp"
+#include "config/args.hpp"
+#include "containers/scoped.hpp"
+#include "math.hpp"
+#include "perfmon/perfmon.hpp"
+#include "utils.hpp"
+
+#define NUM_SIZE_CLASSES (BLOCK_BUFFER_MAX_SLAB_CHUNK_SIZE / DEVICE_BLOCK_SIZE)
+
+// Each NUMA node gets its own slabs (and free lists), so that buffers allocated on a
+// thread come from the thread's node.  Machines with more nodes than this share
+// free lists between some nodes.
+#define NUM_NUMA_FREE_LISTS 8
+
+class block_buffer_allocator_t {
+public:
+    struct stats_t {
+        uint64_t slabs;
+        uint64_t huge_page_slabs;
+        uint64_t bytes_in_use;
+        uint64_t fallback_allocations;
+    };
+
+    block_buffer_allocator_t()
+        : mode_(huge_pages_mode_t::transparent),
+          tried_to_reserve_arena_(false),
+          arena_(NULL),
+          num_slabs_(0),
+          huge_page_slabs_(0),
+          fallback_allocations_(0) { }
+
+    void configure(huge_pages_mode_t mode) {
+        spinlock_acq_t acq(&arena_lock_);
+        guarantee(!tried_to_reserve_arena_,
+                  "configure_block_buffer_allocator called after the first block "
+                  "buffer was allocated");
+        mode_ = mode;
+    }
+
+    void *allocate(size_t size) {
+        rassert(size > 0 && divides(DEVICE_BLOCK_SIZE, size));
+        if (size > BLOCK_BUFFER_MAX_SLAB_CHUNK_SIZE) {
+            return malloc_aligned(size, DEVICE_BLOCK_SIZE);
+        }
+
+        const size_t class_index = size / DEVICE_BLOCK_SIZE - 1;
+        const int numa_node = get_current_numa_node();
+        const size_t free_lists_index = numa_node % NUM_NUMA_FREE_LISTS;
+        size_class_t *size_class = &size_classes_[free_lists_index][class_index];
+        {
+            spinlock_acq_t acq(&size_class->lock);
+            if (size_class->free_chunks == NULL) {
+                add_slab(numa_node, free_lists_index, class_index);
+            }
+            free_chunk_t *chunk = size_class->free_chunks;
+            if (chunk != NULL) {
+                size_class->free_chunks = chunk->next;
+                ++size_class->chunks_in_use;
+                return chunk;
+            }
+        }
+
+        // We ran out of address space (or couldn't reserve it in the first place).
+        {
+            spinlock_acq_t acq(&arena_lock_);
+            ++fallback_allocations_;
+        }
+        return malloc_aligned(size, DEVICE_BLOCK_SIZE);
+    }
+
+    void free(void *ptr) {
+        char *const p = static_cast<char *>(ptr);
+        if (arena_ == NULL || p < arena_ || p >= arena_ + BLOCK_BUFFER_ARENA_SIZE) {
+            ::free(ptr);
+            return;
+        }
+
+        const size_t slab_index = (p - arena_) / BLOCK_BUFFER_SLAB_SIZE;
+        size_class_t *size_class
+            = &size_classes_[slab_free_lists_[slab_index]][slab_size_classes_[slab_index]];
+        free_chunk_t *chunk = static_cast<free_chunk_t *>(ptr);
+        spinlock_acq_t acq(&size_class->lock);
+        chunk->next = size_class->free_chunks;
+        size_class->free_chunks = chunk;
+        --size_class->chunks_in_use;
+    }
+
+    void get_stats(stats_t *stats_out) {
+        stats_out->bytes_in_use = 0;
+        for (size_t n = 0; n < NUM_NUMA_FREE_LISTS; ++n) {
+            for (size_t i = 0; i < NUM_SIZE_CLASSES; ++i) {
+                spinlock_acq_t acq(&size_classes_[n][i].lock);
+                stats_out->bytes_in_use
+                    += size_classes_[n][i].chunks_in_use * (i + 1) * DEVICE_BLOCK_SIZE;
+            }
+        }
+        spinlock_acq_t acq(&arena_lock_);
+        stats_out->slabs = num_slabs_;
+        stats_out->huge_page_slabs = huge_page_slabs_;
+        stats_out->fallback_allocations = fallback_allocations_;
+    }
+
+private:
+    struct free_chunk_t {
+        free_chunk_t *next;
+    };
+
+    struct size_class_t {
+        size_class_t() : free_chunks(NULL), chunks_in_use(0) { }
+
+        spinlock_t lock;
+        free_chunk_t *free_chunks;
+        uint64_t chunks_in_use;
+    };
+
+    // Reserves (but doesn't commit) the address range that slabs are taken from.
+    // Called with arena_lock_ held.
+    void reserve_arena() {
+        tried_to_reserve_arena_ = true;
+        // Reserve one slab more than we need, so that the arena can start at a slab
+        // boundary.  (Huge pages need to be aligned, too.)
+        void *res = mmap(NULL, BLOCK_BUFFER_ARENA_SIZE + BLOCK_BUFFER_SLAB_SIZE,
+                         PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                         -1, 0);
+        if (res == MAP_FAILED) {
+            return;
+        }
+        slab_size_classes_.init(BLOCK_BUFFER_ARENA_SIZE / BLOCK_BUFFER_SLAB_SIZE);
+        slab_free_lists_.init(BLOCK_BUFFER_ARENA_SIZE / BLOCK_BUFFER_SLAB_SIZE);
+        arena_ = reinterpret_cast<char *>(
+            ceil_aligned(reinterpret_cast<uintptr_t>(res), BLOCK_BUFFER_SLAB_SIZE));
+    }
+
+    // Commits a new slab on the given NUMA node, and carves it into chunks for the
+    // given size class.  Called with the size class' lock held.
+    void add_slab(int numa_node, size_t free_lists_index, size_t class_index) {
+        char *slab;
+        {
+            spinlock_acq_t acq(&arena_lock_);
+            if (!tried_to_reserve_arena_) {
+                reserve_arena();
+            }
+            if (arena_ == NULL
+                || num_slabs_ == BLOCK_BUFFER_ARENA_SIZE / BLOCK_BUFFER_SLAB_SIZE) {
+                return;
+            }
+
+            slab = arena_ + num_slabs_ * BLOCK_BUFFER_SLAB_SIZE;
+            if (!commit_slab(slab)) {
+                return;
+            }
+            slab_size_classes_[num_slabs_] = class_index;
+            slab_free_lists_[num_slabs_] = free_lists_index;
+            ++num_slabs_;
+        }
+
+        // The slab's memory gets allocated when it's first touched, which happens
+        // right below.
+        if (get_numa_node_count() > 1) {
+            prefer_numa_node_for_memory(slab, BLOCK_BUFFER_SLAB_SIZE, numa_node);
+        }
+
+        const size_t chunk_size = (class_index + 1) * DEVICE_BLOCK_SIZE;
+        size_class_t *size_class = &size_classes_[free_lists_index][class_index];
+        for (size_t offset = 0; offset + chunk_size <= BLOCK_BUFFER_SLAB_SIZE;
+             offset += chunk_size) {
+            free_chunk_t *chunk = reinterpret_cast<free_chunk_t *>(slab + offset);
+            chunk->next = size_class->free_chunks;
+            size_class->free_chunks = chunk;
+        }
+    }
+
+    // Called with arena_lock_ held.
+    bool commit_slab(char *slab) {
+        const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED;
+#ifdef MAP_HUGETLB
+        if (mode_ == huge_pages_mode_t::reserved) {
+            void *res = mmap(slab, BLOCK_BUFFER_SLAB_SIZE, PROT_READ | PROT_WRITE,
+                             flags | MAP_HUGETLB, -1, 0);
+            if (res != MAP_FAILED) {
+                ++huge_page_slabs_;
+                return true;
+            }
+        }
+#endif
+        void *res = mmap(slab, BLOCK_BUFFER_SLAB_SIZE, PROT_READ | PROT_WRITE,
+                         flags, -1, 0);
+        if (res == MAP_FAILED) {
+            return false;
+        }
+#ifdef MADV_HUGEPAGE
+        if (mode_ != huge_pages_mode_t::none) {
+            // This is only advice, so we don't care if it fails.
+            UNUSED int advise_res = madvise(slab, BLOCK_BUFFER_SLAB_SIZE, MADV_HUGEPAGE);
+        }
+#endif
+        return true;
+    }
+
+    size_class_t size_classes_[NUM_NUMA_FREE_LISTS][NUM_SIZE_CLASSES];
+
+    // Protects everything below.
+    spinlock_t arena_lock_;
+    huge_pages_mode_t mode_;
+    bool tried_to_reserve_arena_;
+    // Only ever set once, before any chunks are handed out, which is why free() can
+    // look at it without holding arena_lock_.
+    char *arena_;
+    // The size class and the NUMA free lists of each slab.  (Slabs never change
+    // either.)
+    scoped_array_t<uint8_t> slab_size_classes_;
+    scoped_array_t<uint8_t> slab_free_lists_;
+    uint64_t num_slabs_;
+    uint64_t huge_page_slabs_;
+    uint64_t fallback_allocations_;
+
+    DISABLE_COPYING(block_buffer_allocator_t);
+};
+
+static block_buffer_allocator_t *get_block_buffer_allocator() {
+    // This is never destroyed, because buffers can get freed by static destructors.
+    static block_buffer_allocator_t *allocator = new block_buffer_allocator_t;
+    return allocator;
+}
+
+void configure_block_buffer_allocator(huge_pages_mode_t mode) {
+    get_block_buffer_allocator()->configure(mode);
+}
+
+void *allocate_block_buffer(size_t size) {
+    return get_block_buffer_allocator()->allocate(size);
+}
+
+void free_block_buffer(void *ptr) {
+    if (ptr != NULL) {
+        get_block_buffer_allocator()->free(ptr);
+    }
+}
+
+// Reports the allocator's memory use in the global stats, as "block_buffers".
+class block_buffer_allocator_perfmon_t : public perfmon_t {
+public:
+    block_buffer_allocator_perfmon_t() { }
+
+    void *begin_stats() {
+        return NULL;
+    }
+    void visit_stats(void *) { }
+    scoped_ptr_t<perfmon_result_t> end_stats(void *) {
+        block_buffer_allocator_t::stats_t stats;
+        get_block_buffer_allocator()->get_stats(&stats);
+
+        scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
+        result->insert("slabs",
+                       new perfmon_result_t(strprintf("%" PRIu64, stats.slabs)));
+        result->insert("huge_page_slabs",
+                       new perfmon_result_t(strprintf("%" PRIu64,
+                                                      stats.huge_page_slabs)));
+        result->insert("slab_bytes",
+                       new perfmon_result_t(strprintf("%" PRIu64,
+                                                      stats.slabs
+                                                      * static_cast<uint64_t>(
+                                                          BLOCK_BUFFER_SLAB_SIZE))));
+        result->insert("bytes_in_use",
+                       new perfmon_result_t(strprintf("%" PRIu64,
+                                                      stats.bytes_in_use)));
+        result->insert("fallback_allocations",
+                       new perfmon_result_t(strprintf("%" PRIu64,
+                                                      stats.fallback_allocations)));
+        return result;
+    }
+
+private:
+    DISABLE_COPYING(block_buffer_allocator_perfmon_t);
+};
+
+static block_buffer_allocator_perfmon_t pm_block_buffers;
+static perfmon_membership_t pm_block_buffers_membership(
+    &get_global_perfmon_collection(), &pm_block_buffers, "block_buffers");
@@ -0,0 +1,32 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_BUFFER_ALLOCATOR_HPP_
+#define SERIALIZER_BUFFER_ALLOCATOR_HPP_
+
+#include <stddef.h>
+
+// How the slabs that block buffers get carved out of are backed.
+enum class huge_pages_mode_t {
+    // Regular pages.
+    none,
+    // The kernel is asked to use transparent huge pages.
+    transparent,
+    // Huge pages from the kernel's reserved huge page pool (see
+    // /proc/sys/vm/nr_hugepages), falling back to regular pages when the pool runs
+    // dry.
+    reserved
+};
+
+// Picks how slabs get backed.  This may only be called before the first block buffer
+// gets allocated.  (The default is huge_pages_mode_t::transparent.)
+void configure_block_buffer_allocator(huge_pages_mode_t mode);
+
+// Allocates a buffer for a block, which is aligned to DEVICE_BLOCK_SIZE so that it
+// can be used for direct I/O.  size must be a multiple of DEVICE_BLOCK_SIZE.
+// Buffers of up to BLOCK_BUFFER_MAX_SLAB_CHUNK_SIZE bytes come from per-size free
+// lists which are refilled a slab at a time, bigger ones come from malloc_aligned.
+void *allocate_block_buffer(size_t size);
+
+// Frees a buffer that came from allocate_block_buffer, or from malloc.
+void free_block_buffer(void *ptr);
+
+#endif  // SERIALIZER_BUFFER_ALLOCATOR_HPP_
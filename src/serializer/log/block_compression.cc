@@ -0,0 +1,58 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "serializer/log/block_compression.hpp"
+
+#include <inttypes.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "config/args.hpp"
+#include "containers/scoped.hpp"
+#include "math.hpp"
+#include "serializer/serializer.hpp"
+
+scoped_malloc_t<ser_buffer_t> compress_block(const ser_buffer_t *buf,
+                                             block_size_t block_size,
+                                             block_size_t *compressed_size_out) {
+    const uint32_t data_size = block_size.value();
+    uLongf compressed_data_size = compressBound(data_size);
+    scoped_array_t<char> data(compressed_data_size);
+    int res = compress2(reinterpret_cast<Bytef *>(data.data()), &compressed_data_size,
+                        reinterpret_cast<const Bytef *>(buf->cache_data), data_size,
+                        SERIALIZER_BLOCK_COMPRESSION_LEVEL);
+    if (res != Z_OK) {
+        return scoped_malloc_t<ser_buffer_t>();
+    }
+
+    // Blocks are laid out in the extents at DEVICE_BLOCK_SIZE boundaries, so there's
+    // no point in compressing a block unless that saves at least one device block.
+    const uint32_t compressed_ser_size = sizeof(ls_buf_data_t) + compressed_data_size;
+    if (ceil_aligned(compressed_ser_size, DEVICE_BLOCK_SIZE)
+        >= ceil_aligned(block_size.ser_value(), DEVICE_BLOCK_SIZE)) {
+        return scoped_malloc_t<ser_buffer_t>();
+    }
+
+    const block_size_t compressed_size = block_size_t::unsafe_make(compressed_ser_size);
+    scoped_malloc_t<ser_buffer_t> ret = serializer_t::allocate_buffer(compressed_size);
+    ret->ser_header = buf->ser_header;
+    memcpy(ret->cache_data, data.data(), compressed_data_size);
+    // The whole device block gets written, so don't write uninitialized memory.
+    memset(reinterpret_cast<char *>(ret.get()) + compressed_ser_size, 0,
+           ceil_aligned(compressed_ser_size, DEVICE_BLOCK_SIZE) - compressed_ser_size);
+
+    *compressed_size_out = compressed_size;
+    return ret;
+}
+
+void decompress_block(const ser_buffer_t *compressed_buf,
+                      block_size_t compressed_size,
+                      ser_buffer_t *buf_out,
+                      block_size_t block_size) {
+    uLongf data_size = block_size.value();
+    int res = uncompress(reinterpret_cast<Bytef *>(buf_out->cache_data), &data_size,
+                         reinterpret_cast<const Bytef *>(compressed_buf->cache_data),
+                         compressed_size.value());
+    guarantee(res == Z_OK && data_size == block_size.value(),
+              "Could not decompress block %" PRIu64 " (zlib error %d).",
+              compressed_buf->ser_header.block_id, res);
+    buf_out->ser_header = compressed_buf->ser_header;
+}
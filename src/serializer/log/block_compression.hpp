@@ -0,0 +1,27 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_LOG_BLOCK_COMPRESSION_HPP_
+#define SERIALIZER_LOG_BLOCK_COMPRESSION_HPP_
+
+#include "containers/scoped.hpp"
+#include "serializer/types.hpp"
+
+/* A compressed block starts with the same ls_buf_data_t header as any other block,
+followed by the zlib-compressed cache data of the block.  Whether a block is
+compressed, and how big it is once it's decompressed, is recorded in its lba entry
+(see lba_entry_t::ser_uncompressed_size), not in the block itself. */
+
+/* Returns a newly allocated buffer holding the compressed version of buf, and sets
+*compressed_size_out to its size.  Returns an empty buffer if the compressed block
+wouldn't take less space on disk than buf. */
+scoped_malloc_t<ser_buffer_t> compress_block(const ser_buffer_t *buf,
+                                             block_size_t block_size,
+                                             block_size_t *compressed_size_out);
+
+/* Decompresses a block that was compressed by compress_block into buf_out, which
+must have room for block_size bytes.  Crashes if the block is corrupted. */
+void decompress_block(const ser_buffer_t *compressed_buf,
+                      block_size_t compressed_size,
+                      ser_buffer_t *buf_out,
+                      block_size_t block_size);
+
+#endif  // SERIALIZER_LOG_BLOCK_COMPRESSION_HPP_
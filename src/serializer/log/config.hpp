@@ -17,6 +17,10 @@ struct log_serializer_dynamic_config_t {
         gc_high_ratio = DEFAULT_GC_HIGH_RATIO;
         read_ahead = true;
         io_batch_factor = DEFAULT_IO_BATCH_FACTOR;
+        compress_blocks = DEFAULT_SERIALIZER_BLOCK_COMPRESSION;
+        group_commit_window_ms = DEFAULT_SERIALIZER_GROUP_COMMIT_WINDOW_MS;
+        discard_freed_extents = DEFAULT_SERIALIZER_DISCARD_FREED_EXTENTS;
+        archive_recency_lag = DEFAULT_SERIALIZER_ARCHIVE_RECENCY_LAG;
     }
 
     /* When the proportion of garbage blocks hits gc_high_ratio, then the serializer will collect
@@ -31,7 +35,29 @@ struct log_serializer_dynamic_config_t {
     /* Enable reading more data than requested to let the cache warmup more quickly esp. on rotational drives */
     bool read_ahead;
 
-    RDB_MAKE_ME_SERIALIZABLE_4(gc_low_ratio, gc_high_ratio, io_batch_factor, read_ahead);
+    /* Compress blocks before writing them.  Compressed blocks take less space in the
+    extents, but need to be decompressed whenever they're read.  Blocks that don't get
+    any smaller on disk are written uncompressed. */
+    bool compress_blocks;
+
+    /* How long an index write waits for other index writes to share its metablock
+    write with.  Index writes that come in while a metablock is being written share
+    the next metablock write anyway. */
+    int32_t group_commit_window_ms;
+
+    /* Tell the file system or the device about extents that have been freed (by
+    punching holes into the file, or by discarding the range on a block device), so
+    that an SSD doesn't have to keep their contents around. */
+    bool discard_freed_extents;
+
+    /* With an archive file, the GC moves the blocks whose recency is at least this
+    far behind the newest recency in the serializer to the archive file.  (Blocks
+    that get written again go back to the data file, like every write.) */
+    uint64_t archive_recency_lag;
+
+    RDB_MAKE_ME_SERIALIZABLE_8(gc_low_ratio, gc_high_ratio, io_batch_factor, read_ahead,
+                               compress_blocks, group_commit_window_ms,
+                               discard_freed_extents, archive_recency_lag);
 };
 
 /* This is equivalent to log_serializer_static_config_t below, but is an on-disk
@@ -39,6 +65,12 @@ structure. Changes to this change the on-disk database format! */
 struct log_serializer_on_disk_static_config_t {
     uint64_t block_size_;
     uint64_t extent_size_;
+    // Non-zero if the metablocks and the LBA are kept in a separate index file, whose
+    // static header has the same value here.  (Files from before index files existed
+    // have a zero here, because the rest of the static header is zeroed.)
+    uint64_t index_file_id_;
+    // The same, for the archive file that old blocks get moved to.
+    uint64_t archive_file_id_;
 
     // Some helpers
     uint64_t blocks_per_extent() const { return extent_size_ / block_size_; }
@@ -47,6 +79,8 @@ struct log_serializer_on_disk_static_config_t {
     // Minimize calls to these.
     block_size_t block_size() const { return block_size_t::unsafe_make(block_size_); }
     uint64_t extent_size() const { return extent_size_; }
+    bool has_index_file() const { return index_file_id_ != 0; }
+    bool has_archive_file() const { return archive_file_id_ != 0; }
 };
 
 /* Configuration for the serializer that is set when the database is created */
@@ -54,6 +88,26 @@ struct log_serializer_static_config_t : public log_serializer_on_disk_static_con
     log_serializer_static_config_t() {
         extent_size_ = DEFAULT_EXTENT_SIZE;
         block_size_ = DEFAULT_BTREE_BLOCK_SIZE;
+        // Set by log_serializer_t::create(), depending on the file opener.
+        index_file_id_ = 0;
+        archive_file_id_ = 0;
+    }
+
+    // `block_size` must satisfy `is_valid_block_size()`.
+    explicit log_serializer_static_config_t(uint64_t block_size) {
+        guarantee(is_valid_block_size(block_size));
+        extent_size_ = DEFAULT_EXTENT_SIZE;
+        block_size_ = block_size;
+        index_file_id_ = 0;
+        archive_file_id_ = 0;
+    }
+
+    // Block sizes are powers of two from DEFAULT_BTREE_BLOCK_SIZE to
+    // MAX_BTREE_BLOCK_SIZE.
+    static bool is_valid_block_size(uint64_t block_size) {
+        return block_size >= DEFAULT_BTREE_BLOCK_SIZE
+            && block_size <= MAX_BTREE_BLOCK_SIZE
+            && (block_size & (block_size - 1)) == 0;
     }
 
     RDB_MAKE_ME_SERIALIZABLE_2(block_size_, extent_size_);
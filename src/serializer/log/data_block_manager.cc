@@ -4,13 +4,17 @@
 #include <inttypes.h>
 #include <sys/uio.h>
 
+#include <algorithm>
+
 #include "errors.hpp"
 #include <boost/bind.hpp>
 
 #include "arch/arch.hpp"
+#include "arch/crc32c.hpp"
 #include "arch/runtime/coroutines.hpp"
 #include "concurrency/mutex.hpp"
 #include "perfmon/perfmon.hpp"
+#include "serializer/log/block_compression.hpp"
 #include "serializer/log/log_serializer.hpp"
 #include "stl_utils.hpp"
 
@@ -30,10 +34,13 @@ private:
     };
 
 public:
-    /* This constructor is for starting a new active extent. */
-    explicit gc_entry_t(data_block_manager_t *_parent)
+    /* This constructor is for starting a new active extent for the stream. */
+    gc_entry_t(data_block_manager_t *_parent,
+               data_block_manager_t::write_stream_t stream)
         : parent(_parent),
-          extent_ref(parent->extent_manager->gen_extent()),
+          extent_ref(stream == data_block_manager_t::write_stream_t::archive
+                     ? parent->extent_manager->gen_archive_extent()
+                     : parent->extent_manager->gen_extent()),
           timestamp(current_microtime()),
           was_written(false),
           state(state_active),
@@ -157,6 +164,22 @@ public:
 
     bool all_garbage() const { return num_live_blocks() == 0; }
 
+    // The cost-benefit priority of GCing the extent, as in log-structured file
+    // systems:  the space we'd free, times the age of the data, over the cost of
+    // reading the extent and writing the live data back.  Data that's been around
+    // for a long time is not likely to become garbage by itself soon, so it's worth
+    // reclaiming the space of old extents with less garbage instead of repeatedly
+    // moving the (soon to be garbage) blocks of young extents with more garbage.
+    double gc_priority() const {
+        const double extent_size = parent->static_config->extent_size();
+        const double garbage = garbage_bytes();
+        // (We add 1 so that extents of the same age are ordered by their garbage.)
+        const double age = parent->gc_priority_time > timestamp
+            ? parent->gc_priority_time - timestamp + 1
+            : 1;
+        return garbage * age / (2 * extent_size - garbage);
+    }
+
     uint32_t garbage_bytes() const {
         rassert(compute_garbage_bytes() == garbage_bytes_stat);
         return garbage_bytes_stat;
@@ -340,7 +363,7 @@ public:
         // It has been, or is being, reconstructed from data on disk.
         state_reconstructing,
         // We are currently putting things on this extent. It is equal to
-        // last_data_extent.
+        // active_extent, cold_active_extent or archive_active_extent.
         state_active,
         // Not active, but not a GC candidate yet. It is in young_extent_queue.
         state_young,
@@ -382,7 +405,10 @@ private:
 data_block_manager_t::data_block_manager_t(const log_serializer_dynamic_config_t *_dynamic_config, extent_manager_t *em, log_serializer_t *_serializer, const log_serializer_on_disk_static_config_t *_static_config, log_serializer_stats_t *_stats)
     : stats(_stats), shutdown_callback(NULL), state(state_unstarted), dynamic_config(_dynamic_config),
       static_config(_static_config), extent_manager(em), serializer(_serializer),
-      gc_state(), gc_stats(stats)
+      active_extent(NULL), cold_active_extent(NULL), archive_active_extent(NULL),
+      newest_recency(repli_timestamp_t::distant_past), compaction_cursor(0),
+      gc_priority_time(current_microtime()), gc_state(), gc_stats(stats),
+      gc_scheduler(this, stats)
 {
     rassert(dynamic_config != NULL);
     rassert(static_config != NULL);
@@ -458,6 +484,11 @@ void data_block_manager_t::start_existing(file_t *file,
         active_extent = NULL;
     }
 
+    /* The cold and archive active extents aren't in the metablock, so they got
+    reconstructed as old extents (if they had live blocks). */
+    cold_active_extent = NULL;
+    archive_active_extent = NULL;
+
     /* Convert any extents that we found live blocks in, but that are not active
     extents, into old extents */
     while (gc_entry_t *entry = reconstructed_extents.head()) {
@@ -473,6 +504,7 @@ void data_block_manager_t::start_existing(file_t *file,
     }
 
     state = state_ready;
+    stats->pm_serializer_extent_live_data.set_data_block_manager(this, get_thread_id());
 }
 
 // Computes an offset and end offset for the purposes of readahead.  Returns an interval
@@ -564,6 +596,17 @@ void read_ahead_offset_and_size(int64_t off_in,
     *size_out = end_offset - offset;
 }
 
+static uint32_t compute_block_checksum(const ser_buffer_t *buf,
+                                       uint32_t ser_block_size) {
+    const uint32_t crc = crc32c(&buf->ser_header.block_id, sizeof(block_id_t));
+    return crc32c_extend(crc, buf->cache_data, ser_block_size - sizeof(ls_buf_data_t));
+}
+
+static bool block_checksum_matches(const void *block, uint32_t ser_block_size) {
+    const ser_buffer_t *buf = static_cast<const ser_buffer_t *>(block);
+    return buf->ser_header.checksum == compute_block_checksum(buf, ser_block_size);
+}
+
 class dbm_read_ahead_t {
 public:
     static std::vector<uint32_t> get_boundaries(data_block_manager_t *parent,
@@ -639,14 +682,26 @@ public:
                     continue;
                 }
 
-                scoped_malloc_t<ser_buffer_t> data
-                    = serializer_t::allocate_buffer(parent->serializer->max_block_size());
-                memcpy(data.get(), current_buf, info.ser_block_size);
                 guarantee(info.ser_block_size <= *(lower_it + 1) - *lower_it);
+                // If it's corrupted, we'll find out again (and report it) when
+                // somebody actually reads the block.
+                if (!block_checksum_matches(current_buf, info.ser_block_size)) {
+                    continue;
+                }
 
                 counted_t<ls_block_token_pointee_t> ls_token
-                    = parent->serializer->generate_block_token(current_offset,
-                                                               block_size_t::unsafe_make(info.ser_block_size));
+                    = parent->serializer->generate_block_token(current_offset, info);
+
+                scoped_malloc_t<ser_buffer_t> data
+                    = serializer_t::allocate_buffer(parent->serializer->max_block_size());
+                if (ls_token->is_compressed()) {
+                    decompress_block(reinterpret_cast<const ser_buffer_t *>(current_buf),
+                                     ls_token->disk_block_size(),
+                                     data.get(),
+                                     ls_token->block_size());
+                } else {
+                    memcpy(data.get(), current_buf, info.ser_block_size);
+                }
 
                 counted_t<standard_block_token_t> token
                     = to_standard_block_token(block_id, ls_token);
@@ -674,28 +729,43 @@ bool data_block_manager_t::should_perform_read_ahead(int64_t offset) {
     return !entry->was_written && serializer->should_perform_read_ahead();
 }
 
-void data_block_manager_t::read(int64_t off_in, uint32_t ser_block_size_in,
+bool data_block_manager_t::read(int64_t off_in, uint32_t ser_block_size_in,
                                 void *buf_out, file_account_t *io_account) {
     guarantee(state == state_ready);
     if (should_perform_read_ahead(off_in)) {
         dbm_read_ahead_t::perform_read_ahead(this, off_in, ser_block_size_in,
                                              buf_out, io_account);
     } else {
-        if (divides(DEVICE_BLOCK_SIZE, reinterpret_cast<intptr_t>(buf_out)) &&
-            divides(DEVICE_BLOCK_SIZE, off_in) &&
-            divides(DEVICE_BLOCK_SIZE, ser_block_size_in)) {
-            co_read(dbfile, off_in, ser_block_size_in, buf_out, io_account);
-        } else {
-            int64_t floor_off_in = floor_aligned(off_in, DEVICE_BLOCK_SIZE);
-            int64_t ceil_off_end = ceil_aligned(off_in + ser_block_size_in,
-                                                DEVICE_BLOCK_SIZE);
-            scoped_malloc_t<char> buf(malloc_aligned(ceil_off_end - floor_off_in,
-                                                     DEVICE_BLOCK_SIZE));
-            co_read(dbfile, floor_off_in, ceil_off_end - floor_off_in,
-                    buf.get(), io_account);
-
-            memcpy(buf_out, buf.get() + (off_in - floor_off_in), ser_block_size_in);
-        }
+        read_from_disk(off_in, ser_block_size_in, buf_out, io_account);
+    }
+
+    if (block_checksum_matches(buf_out, ser_block_size_in)) {
+        return true;
+    }
+
+    // The data might have gotten corrupted on its way from the disk rather than on
+    // the disk, so we give it a second chance.
+    ++stats->pm_serializer_block_checksum_retries;
+    read_from_disk(off_in, ser_block_size_in, buf_out, io_account);
+    return block_checksum_matches(buf_out, ser_block_size_in);
+}
+
+void data_block_manager_t::read_from_disk(int64_t off_in, uint32_t ser_block_size_in,
+                                          void *buf_out, file_account_t *io_account) {
+    if (divides(DEVICE_BLOCK_SIZE, reinterpret_cast<intptr_t>(buf_out)) &&
+        divides(DEVICE_BLOCK_SIZE, off_in) &&
+        divides(DEVICE_BLOCK_SIZE, ser_block_size_in)) {
+        co_read(dbfile, off_in, ser_block_size_in, buf_out, io_account);
+    } else {
+        int64_t floor_off_in = floor_aligned(off_in, DEVICE_BLOCK_SIZE);
+        int64_t ceil_off_end = ceil_aligned(off_in + ser_block_size_in,
+                                            DEVICE_BLOCK_SIZE);
+        scoped_malloc_t<char> buf(malloc_aligned(ceil_off_end - floor_off_in,
+                                                 DEVICE_BLOCK_SIZE));
+        co_read(dbfile, floor_off_in, ceil_off_end - floor_off_in,
+                buf.get(), io_account);
+
+        memcpy(buf_out, buf.get() + (off_in - floor_off_in), ser_block_size_in);
     }
 }
 
@@ -703,6 +773,25 @@ std::vector<counted_t<ls_block_token_pointee_t> >
 data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
                                   file_account_t *io_account,
                                   iocallback_t *cb) {
+    // The GC writes blocks through many_writes_to_stream directly, because it moves
+    // them as they are on disk, checksums included.
+    for (auto it = writes.begin(); it != writes.end(); ++it) {
+        it->buf->ser_header.block_id = it->block_id;
+        it->buf->ser_header.checksum = compute_block_checksum(it->buf,
+                                                              it->block_size.ser_value());
+        it->buf->ser_header.zero = 0;
+        stats->pm_serializer_user_bytes_written += it->block_size.ser_value();
+        stats->pm_serializer_write_amplification.record_user_write(
+            it->block_size.ser_value());
+    }
+    return many_writes_to_stream(writes, write_stream_t::hot, io_account, cb);
+}
+
+std::vector<counted_t<ls_block_token_pointee_t> >
+data_block_manager_t::many_writes_to_stream(const std::vector<buf_write_info_t> &writes,
+                                            write_stream_t stream,
+                                            file_account_t *io_account,
+                                            iocallback_t *cb) {
     // Either we're ready to write, or we're shutting down and just finished reading
     // blocks for gc and called do_write.
     guarantee(state == state_ready ||
@@ -711,7 +800,7 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
     // These tokens are grouped by extent.  You can do a contiguous write in each
     // extent.
     std::vector<std::vector<counted_t<ls_block_token_pointee_t> > > token_groups
-        = gimme_some_new_offsets(writes);
+        = gimme_some_new_offsets(writes, stream);
 
     for (auto it = writes.begin(); it != writes.end(); ++it) {
         it->buf->ser_header.block_id = it->block_id;
@@ -848,7 +937,7 @@ file_account_t *data_block_manager_t::choose_gc_io_account() {
 
     // This means that we can end up oscillating between both accounts, which
     // is probably fine. TODO: Make sure it actually is in practice!
-    if (garbage_ratio() > dynamic_config->gc_high_ratio * 1.02) {
+    if (gc_is_urgent()) {
         return gc_io_account_high.get();
     } else {
         return gc_io_account_nice.get();
@@ -874,6 +963,7 @@ void data_block_manager_t::mark_garbage(int64_t offset, extent_transaction_t *tx
     }
 
     check_and_handle_empty_extent(extent_id);
+    update_gc_debt();
 }
 
 void data_block_manager_t::mark_live_tokenwise_with_offset(int64_t offset) {
@@ -927,6 +1017,7 @@ struct block_write_cond_t : public cond_t, public iocallback_t {
 void data_block_manager_t::gc_writer_t::write_gcs(gc_write_t *writes, size_t num_writes) {
     if (parent->gc_state.current_entry != NULL) {
         block_write_cond_t block_write_cond;
+        block_write_cond_t archive_write_cond;
 
         // We acquire block tokens for all the blocks before writing new
         // version.  The point of this is to make sure the _new_ block is
@@ -944,6 +1035,14 @@ void data_block_manager_t::gc_writer_t::write_gcs(gc_write_t *writes, size_t num
             // Step 1: Write buffers to disk and assemble index operations
             ASSERT_NO_CORO_WAITING;
 
+            // The blocks that go to the archive file come last.
+            const gc_write_t *const archive_writes_begin
+                = std::stable_partition(writes, writes + num_writes,
+                                        [this](const gc_write_t &write) {
+                                            return !parent->should_archive(write);
+                                        });
+            const size_t num_fast_writes = archive_writes_begin - writes;
+
             std::vector<buf_write_info_t> the_writes;
             the_writes.reserve(num_writes);
             for (size_t i = 0; i < num_writes; ++i) {
@@ -953,17 +1052,48 @@ void data_block_manager_t::gc_writer_t::write_gcs(gc_write_t *writes, size_t num
                 the_writes.push_back(buf_write_info_t(writes[i].buf,
                                                       writes[i].block_size,
                                                       writes[i].buf->ser_header.block_id));
+                parent->stats->pm_serializer_gc_bytes_written
+                    += writes[i].block_size.ser_value();
+                parent->stats->pm_serializer_write_amplification.record_gc_write(
+                    writes[i].block_size.ser_value());
             }
 
-            new_block_tokens
-                = parent->many_writes(the_writes, parent->choose_gc_io_account(),
-                                      &block_write_cond);
+            // (many_writes_to_stream() would start an active extent for the
+            // stream even with no writes.)
+            if (num_fast_writes > 0) {
+                new_block_tokens
+                    = parent->many_writes_to_stream(
+                        std::vector<buf_write_info_t>(
+                            the_writes.begin(), the_writes.begin() + num_fast_writes),
+                        write_stream_t::cold,
+                        parent->choose_gc_io_account(),
+                        &block_write_cond);
+            } else {
+                block_write_cond.pulse();
+            }
+            if (num_fast_writes < num_writes) {
+                std::vector<counted_t<ls_block_token_pointee_t> > archive_tokens
+                    = parent->many_writes_to_stream(
+                        std::vector<buf_write_info_t>(
+                            the_writes.begin() + num_fast_writes, the_writes.end()),
+                        write_stream_t::archive,
+                        parent->choose_gc_io_account(),
+                        &archive_write_cond);
+                parent->stats->pm_serializer_blocks_archived
+                    += num_writes - num_fast_writes;
+                for (auto it = archive_tokens.begin(); it != archive_tokens.end(); ++it) {
+                    new_block_tokens.push_back(std::move(*it));
+                }
+            } else {
+                archive_write_cond.pulse();
+            }
 
             guarantee(new_block_tokens.size() == num_writes);
         }
 
         // Step 2: Wait on all writes to finish
         block_write_cond.wait();
+        archive_write_cond.wait();
 
         // We created block tokens for our blocks we're writing, so
         // there's no way the current entry could have become NULL.
@@ -984,6 +1114,20 @@ void data_block_manager_t::gc_writer_t::write_gcs(gc_write_t *writes, size_t num
                 if (parent->gc_state.current_entry->block_referenced_by_index(block_index)) {
                     block_id_t block_id = writes[i].buf->ser_header.block_id;
 
+                    // We moved the block's bytes as they were on disk, so if the
+                    // block is compressed, the new token has to learn the block's
+                    // real size from the lba entry (which still points at the old
+                    // offset).
+                    const index_block_info_t info
+                        = parent->serializer->lba_index->get_block_info(block_id);
+                    guarantee(info.offset.has_value()
+                              && info.offset.get_value() == writes[i].old_offset);
+                    if (info.ser_uncompressed_size != 0) {
+                        parent->serializer->set_uncompressed_block_size(
+                                new_block_tokens[i],
+                                block_size_t::unsafe_make(info.ser_uncompressed_size));
+                    }
+
                     index_write_ops.push_back(
                             index_write_op_t(block_id,
                                              to_standard_block_token(
@@ -1037,6 +1181,28 @@ void data_block_manager_t::gc_writer_t::write_gcs(gc_write_t *writes, size_t num
     delete this;
 }
 
+bool data_block_manager_t::should_archive(const gc_write_t &write) const {
+    if (!extent_manager->has_archive_file()) {
+        return false;
+    }
+    // Blocks that are only referenced by tokens are about to become garbage.
+    const unsigned int block_index = gc_state.current_entry->block_index(write.old_offset);
+    if (!gc_state.current_entry->block_referenced_by_index(block_index)) {
+        return false;
+    }
+    const repli_timestamp_t recency
+        = serializer->lba_index->get_block_recency(write.buf->ser_header.block_id);
+    return recency != repli_timestamp_t::invalid
+        && recency <= newest_recency
+        && newest_recency.longtime - recency.longtime >= dynamic_config->archive_recency_lag;
+}
+
+void data_block_manager_t::note_recency(repli_timestamp_t recency) {
+    if (recency != repli_timestamp_t::invalid && recency > newest_recency) {
+        newest_recency = recency;
+    }
+}
+
 void data_block_manager_t::on_gc_write_done() {
 
     // Continue GC
@@ -1049,22 +1215,54 @@ void data_block_manager_t::run_gc() {
         run_again = false;
         switch (gc_state.step()) {
             case gc_ready: {
-                if (gc_pq.empty() || !should_we_keep_gcing()) {
-                    return;
-                }
+                update_gc_debt();
 
                 ASSERT_NO_CORO_WAITING;
 
-                ++stats->pm_serializer_data_extents_gced;
+                // Collecting garbage comes before compacting.
+                const bool collecting = !gc_pq.empty() && should_we_keep_gcing();
+                gc_entry_t *entry;
+                if (collecting) {
+                    refresh_gc_priorities();
+                    entry = gc_pq.peak();
+                } else {
+                    entry = next_compaction_entry();
+                    if (entry == NULL) {
+                        return;
+                    }
+                }
+
+                // The gc_scheduler_t calls start_gc() later, if it says no.
+                const uint64_t live_bytes = static_config->extent_size()
+                    - entry->garbage_bytes();
+                if (!gc_scheduler.may_gc_extent(live_bytes,
+                                                collecting && gc_is_urgent())) {
+                    return;
+                }
+
+                if (collecting) {
+                    ++stats->pm_serializer_data_extents_gced;
+                } else {
+                    ++stats->pm_serializer_compaction_extents_moved;
+                    // The cursor was left on the entry, in case the scheduler
+                    // said no.
+                    --compaction_cursor;
+                    --stats->pm_serializer_compaction_extents_left;
+                }
 
                 /* grab the entry */
-                gc_state.current_entry = gc_pq.pop();
+                gc_pq.remove(entry->our_pq_entry);
+                gc_state.current_entry = entry;
                 gc_state.current_entry->our_pq_entry = NULL;
 
                 guarantee(gc_state.current_entry->state == gc_entry_t::state_old);
                 gc_state.current_entry->state = gc_entry_t::state_in_gc;
                 gc_stats.old_garbage_block_bytes -= gc_state.current_entry->garbage_bytes();
                 gc_stats.old_total_block_bytes -= static_config->extent_size();
+                stats->pm_serializer_gc_bytes_reclaimed
+                    += gc_state.current_entry->garbage_bytes();
+                stats->pm_serializer_write_amplification.record_gc_reclaim(
+                    gc_state.current_entry->garbage_bytes());
 
                 /* read all the live data into buffers */
 
@@ -1246,6 +1444,7 @@ bool data_block_manager_t::shutdown(data_block_manager::shutdown_callback_t *cb)
     rassert(cb != NULL);
     guarantee(state == state_ready);
     state = state_shutting_down;
+    stats->pm_serializer_extent_live_data.set_data_block_manager(NULL, get_thread_id());
 
     if (gc_state.step() != gc_ready) {
         shutdown_callback = cb;
@@ -1263,12 +1462,29 @@ void data_block_manager_t::actually_shutdown() {
 
     guarantee(reconstructed_extents.head() == NULL);
 
+    gc_scheduler.cancel();
+
+    stats->pm_serializer_compaction_extents_left -= compaction_cursor;
+    compaction_cursor = 0;
+
     if (active_extent != NULL) {
         UNUSED int64_t extent = active_extent->extent_ref.release();
         delete active_extent;
         active_extent = NULL;
     }
 
+    if (cold_active_extent != NULL) {
+        UNUSED int64_t extent = cold_active_extent->extent_ref.release();
+        delete cold_active_extent;
+        cold_active_extent = NULL;
+    }
+
+    if (archive_active_extent != NULL) {
+        UNUSED int64_t extent = archive_active_extent->extent_ref.release();
+        delete archive_active_extent;
+        archive_active_extent = NULL;
+    }
+
     while (gc_entry_t *entry = young_extent_queue.head()) {
         young_extent_queue.remove(entry);
         UNUSED int64_t extent = entry->extent_ref.release();
@@ -1287,17 +1503,24 @@ void data_block_manager_t::actually_shutdown() {
 }
 
 std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
-data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes) {
+data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes,
+                                             write_stream_t stream) {
     ASSERT_NO_CORO_WAITING;
 
+    // The active extent of the stream.
+    gc_entry_t *&active
+        = stream == write_stream_t::hot ? active_extent
+        : stream == write_stream_t::cold ? cold_active_extent
+        : archive_active_extent;
+
     // Start a new extent if necessary.
-    if (active_extent == NULL) {
-        active_extent = new gc_entry_t(this);
+    if (active == NULL) {
+        active = new gc_entry_t(this, stream);
         ++stats->pm_serializer_data_extents_allocated;
     }
 
 
-    guarantee(active_extent->state == gc_entry_t::state_active);
+    guarantee(active->state == gc_entry_t::state_active);
 
     std::vector<std::vector<counted_t<ls_block_token_pointee_t> > > ret;
 
@@ -1305,25 +1528,25 @@ data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t>
     for (auto it = writes.begin(); it != writes.end(); ++it) {
         uint32_t relative_offset = valgrind_undefined<uint32_t>(UINT32_MAX);
         unsigned int block_index = valgrind_undefined<unsigned int>(UINT_MAX);
-        if (!active_extent->new_offset(it->block_size,
-                                       &relative_offset, &block_index)) {
-            // Move the active_extent gc_entry_t to the young extent queue (if it's
+        if (!active->new_offset(it->block_size,
+                                &relative_offset, &block_index)) {
+            // Move the active gc_entry_t to the young extent queue (if it's
             // not already empty), and make a new gc_entry_t.
-            if (active_extent->num_live_blocks() == 0) {
-                gc_entry_t *old_active_extent = active_extent;
-                active_extent = new gc_entry_t(this);
+            if (active->num_live_blocks() == 0) {
+                gc_entry_t *old_active_extent = active;
+                active = new gc_entry_t(this, stream);
                 destroy_entry(old_active_extent);
             } else {
-                active_extent->state = gc_entry_t::state_young;
-                young_extent_queue.push_back(active_extent);
+                active->state = gc_entry_t::state_young;
+                young_extent_queue.push_back(active);
                 mark_unyoung_entries();
-                active_extent = new gc_entry_t(this);
+                active = new gc_entry_t(this, stream);
             }
 
             ++stats->pm_serializer_data_extents_allocated;
-            const bool succeeded = active_extent->new_offset(it->block_size,
-                                                             &relative_offset,
-                                                             &block_index);
+            const bool succeeded = active->new_offset(it->block_size,
+                                                      &relative_offset,
+                                                      &block_index);
             guarantee(succeeded);
 
             // Push the current group of tokens, if it's nonempty, onto the return vector.
@@ -1333,9 +1556,9 @@ data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t>
             }
         }
 
-        const int64_t offset = active_extent->extent_ref.offset() + relative_offset;
-        active_extent->was_written = true;
-        active_extent->mark_live_tokenwise(block_index);
+        const int64_t offset = active->extent_ref.offset() + relative_offset;
+        active->was_written = true;
+        active->mark_live_tokenwise(block_index);
 
         tokens.push_back(serializer->generate_block_token(offset, it->block_size));
     }
@@ -1396,8 +1619,73 @@ bool data_block_manager_t::do_we_want_to_start_gcing() const {
     return garbage_ratio() > dynamic_config->gc_high_ratio;
 }
 
+// Start going into high priority (and ignore the gc_scheduler_t) as soon as the
+// garbage ratio is more than 2% above the configured goal.
+bool data_block_manager_t::gc_is_urgent() const {
+    return garbage_ratio() > dynamic_config->gc_high_ratio * 1.02;
+}
+
+void data_block_manager_t::update_gc_debt() {
+    const double total = gc_stats.old_total_block_bytes.get()
+        + static_cast<double>(extent_manager->held_extents())
+        * static_config->extent_size();
+    gc_scheduler.set_debt(gc_stats.old_garbage_block_bytes.get()
+                          - dynamic_config->gc_low_ratio * total);
+}
+
+void data_block_manager_t::start_compaction() {
+    guarantee(state == state_ready);
+    const size_t old_cursor = compaction_cursor;
+    compaction_cursor = extent_manager->data_file_extents();
+    stats->pm_serializer_compaction_extents_left
+        += static_cast<int64_t>(compaction_cursor) - static_cast<int64_t>(old_cursor);
+    start_gc();
+}
+
+gc_entry_t *data_block_manager_t::next_compaction_entry() {
+    ASSERT_NO_CORO_WAITING;
+    if (compaction_cursor == 0) {
+        return NULL;
+    }
+
+    // Blocks that get moved go to the cold active extent, which is normally in the
+    // first free extent, so an extent is only worth moving if there is a free one
+    // before it.  The LBA's extents (when there's no index file) and the ones that
+    // aren't old yet stay where they are.
+    const size_t lowest_free = extent_manager->lowest_free_data_extent();
+    size_t cursor = std::min(compaction_cursor, extent_manager->data_file_extents());
+    gc_entry_t *entry = NULL;
+    while (cursor > lowest_free + 1) {
+        gc_entry_t *candidate = entries.get(cursor - 1);
+        if (candidate != NULL && candidate->state == gc_entry_t::state_old) {
+            entry = candidate;
+            break;
+        }
+        --cursor;
+    }
+    if (entry == NULL) {
+        // Done.
+        cursor = 0;
+    }
+
+    stats->pm_serializer_compaction_extents_left
+        += static_cast<int64_t>(cursor) - static_cast<int64_t>(compaction_cursor);
+    compaction_cursor = cursor;
+    return entry;
+}
+
+void data_block_manager_t::refresh_gc_priorities() {
+    ASSERT_NO_CORO_WAITING;
+    const microtime_t now = current_microtime();
+    if (now < gc_priority_time + GC_PRIORITY_REFRESH_INTERVAL_MICROS) {
+        return;
+    }
+    gc_priority_time = now;
+    gc_pq.rebuild();
+}
+
 bool gc_entry_less_t::operator()(const gc_entry_t *x, const gc_entry_t *y) {
-    return x->garbage_bytes() < y->garbage_bytes();
+    return x->gc_priority() < y->gc_priority();
 }
 
 /****************
@@ -1414,6 +1702,21 @@ double data_block_manager_t::garbage_ratio() const {
     }
 }
 
+void data_block_manager_t::get_live_data_histogram(std::array<int64_t, 10> *buckets_out) const {
+    buckets_out->fill(0);
+    const uint64_t extent_size = static_config->extent_size();
+    const size_t num_extents = extent_manager->data_file_extents();
+    for (size_t i = 0; i < num_extents; ++i) {
+        const gc_entry_t *entry = entries.get(i);
+        if (entry == NULL || entry->state != gc_entry_t::state_old) {
+            continue;
+        }
+        const uint64_t live_bytes = extent_size - entry->garbage_bytes();
+        const size_t bucket = std::min<uint64_t>(live_bytes * 10 / extent_size, 9);
+        ++(*buckets_out)[bucket];
+    }
+}
+
 void data_block_manager_t::gc_stat_t::operator+=(int64_t num) {
     val += num;
     *perfmon += num;
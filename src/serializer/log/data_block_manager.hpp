@@ -2,6 +2,7 @@
 #ifndef SERIALIZER_LOG_DATA_BLOCK_MANAGER_HPP_
 #define SERIALIZER_LOG_DATA_BLOCK_MANAGER_HPP_
 
+#include <array>
 #include <vector>
 
 #include "arch/types.hpp"
@@ -10,9 +11,12 @@
 #include "containers/scoped.hpp"
 #include "containers/two_level_array.hpp"
 #include "perfmon/types.hpp"
+#include "repli_timestamp.hpp"
 #include "serializer/log/config.hpp"
 #include "serializer/log/extent_manager.hpp"
+#include "serializer/log/gc_scheduler.hpp"
 #include "serializer/types.hpp"
+#include "time.hpp"
 
 class log_serializer_t;
 
@@ -64,8 +68,10 @@ public:
     static void prepare_initial_metablock(data_block_manager::metablock_mixin_t *mb);
     void start_existing(file_t *dbfile, data_block_manager::metablock_mixin_t *last_metablock);
 
-    void read(int64_t off_in, uint32_t ser_block_size,
-              void *buf_out, file_account_t *io_account);
+    /* Returns false if the block doesn't match its checksum, even after reading it
+    a second time. */
+    MUST_USE bool read(int64_t off_in, uint32_t ser_block_size,
+                       void *buf_out, file_account_t *io_account);
 
     /* exposed gc api */
     /* mark a buffer as garbage */
@@ -97,18 +103,57 @@ public:
     // ratio of garbage to blocks in the system
     double garbage_ratio() const;
 
+    /* Counts the old extents into ten buckets by the fraction of their bytes that
+    are live, for the "serializer_extent_live_data" stat. */
+    void get_live_data_histogram(std::array<int64_t, 10> *buckets_out) const;
+
+    /* Sets the block ids and checksums of the blocks and writes them. */
     std::vector<counted_t<ls_block_token_pointee_t> >
     many_writes(const std::vector<buf_write_info_t> &writes,
                 file_account_t *io_account,
                 iocallback_t *cb);
 
-    std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
-    gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes);
+    /* Tells us about a block's recency, as it goes into the index.  The GC measures
+    how old blocks are against the newest one. */
+    void note_recency(repli_timestamp_t recency);
 
+    /* Starts compacting the data file:  the GC moves the live blocks of the extents
+    at the end of the file into free extents nearer its start, so that the extent
+    manager can truncate the file once the extents at its end are free.  Compaction
+    goes at the GC's pace (see gc_scheduler_t), but only while the GC has no garbage
+    to collect, and it stops once no extent is left that could move closer to the
+    start.  Extents that were still being written to get skipped, so running it
+    again later can shrink the file some more. */
+    void start_compaction();
+    bool is_compacting() const { return compaction_cursor != 0; }
 
 private:
+    // The blocks that the GC moves have survived for a while already, and are much
+    // less likely to become garbage soon than freshly written blocks.  So they go
+    // to a separate ("cold") active extent, and don't make the extents that fresh
+    // blocks get written to ("hot" ones) look more alive than they'll stay.  With
+    // an archive file, the ones that haven't been written for a long time (see
+    // should_archive()) go to an active extent in the archive file instead.
+    enum class write_stream_t { hot, cold, archive };
+
+    void read_from_disk(int64_t off_in, uint32_t ser_block_size,
+                        void *buf_out, file_account_t *io_account);
+
+    std::vector<counted_t<ls_block_token_pointee_t> >
+    many_writes_to_stream(const std::vector<buf_write_info_t> &writes,
+                          write_stream_t stream,
+                          file_account_t *io_account,
+                          iocallback_t *cb);
+
+    std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
+    gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes,
+                           write_stream_t stream);
+
     void actually_shutdown();
 
+    // Whether the GC should move the block to the archive file.
+    bool should_archive(const gc_write_t &write) const;
+
     file_account_t *choose_gc_io_account();
 
     /* Checks whether the extent is empty and if it is, notifies the extent manager
@@ -118,6 +163,16 @@ private:
     // Tells if we should keep gc'ing.
     bool should_we_keep_gcing() const;
 
+    // Tells if the garbage ratio got so high that the GC must not be throttled.
+    bool gc_is_urgent() const;
+
+    // Tells gc_scheduler how far behind the GC is.
+    void update_gc_debt();
+
+    // The next extent (in state_old) that compaction should move, or NULL if
+    // compaction isn't running or just finished.
+    gc_entry_t *next_compaction_entry();
+
     // Pops things off young_extent_queue that are no longer young.
     void mark_unyoung_entries();
 
@@ -125,6 +180,10 @@ private:
     // to be not young.
     void remove_last_unyoung_entry();
 
+    // Moves gc_priority_time forward to now (if it's been long enough), and
+    // reorders gc_pq for the new priorities.
+    void refresh_gc_priorities();
+
     void destroy_entry(gc_entry_t *entry);
 
     bool should_perform_read_ahead(int64_t offset);
@@ -172,8 +231,19 @@ private:
     /* Contains every extent in the gc_entry_t::state_reconstructing state */
     intrusive_list_t<gc_entry_t> reconstructed_extents;
 
-    /* Contains the extent in the gc_entry_t::state_active state. */
+    /* Contain the extents in the gc_entry_t::state_active state:  the one that
+       new blocks are written to, and the ones that the GC moves blocks to. */
     gc_entry_t *active_extent;
+    gc_entry_t *cold_active_extent;
+    gc_entry_t *archive_active_extent;
+
+    /* The newest recency of any block in the index (except for
+       repli_timestamp_t::invalid). */
+    repli_timestamp_t newest_recency;
+
+    /* While compacting, the data file extents at indexes compaction_cursor and
+       above have been moved or skipped.  It is 0 when we're not compacting. */
+    size_t compaction_cursor;
 
     /* Contains every extent in the gc_entry_t::state_young state */
     intrusive_list_t<gc_entry_t> young_extent_queue;
@@ -181,6 +251,11 @@ private:
     /* Contains every extent in the gc_entry_t::state_old state */
     priority_queue_t<gc_entry_t *, gc_entry_less_t> gc_pq;
 
+    /* The time that the ages in the extents' cost-benefit priorities (see
+       gc_entry_t::gc_priority) are measured at.  It only changes in
+       refresh_gc_priorities, which keeps gc_pq ordered. */
+    microtime_t gc_priority_time;
+
 
     /* Buffer used during GC. */
     std::vector<gc_write_t> gc_writes;
@@ -250,6 +325,8 @@ private:
 
     gc_stats_t gc_stats;
 
+    gc_scheduler_t gc_scheduler;
+
     DISABLE_COPYING(data_block_manager_t);
 };
 
@@ -1,19 +1,26 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "serializer/log/extent_manager.hpp"
 
+#include <algorithm>
 #include <queue>
 
 #include "arch/arch.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
 #include "logger.hpp"
 #include "math.hpp"
 #include "perfmon/perfmon.hpp"
 #include "serializer/log/log_serializer.hpp"
+#include "serializer/log/split_file.hpp"
 
 struct extent_info_t {
 public:
     enum state_t {
         state_unreserved,
         state_in_use,
+        // Released, and waiting for its contents to be discarded before it goes
+        // into the free queue.
+        state_discarding,
         state_free
     };
 private:
@@ -44,9 +51,18 @@ public:
 class extent_zone_t {
     const size_t extent_size;
 
+    // The offset of the zone's first extent.  The zone's file (which is the data file
+    // or the index file) has that extent at offset 0.
+    const int64_t base_offset;
+
     size_t offset_to_id(int64_t extent) const {
-        rassert(divides(extent_size, extent));
-        return extent / extent_size;
+        rassert(extent >= base_offset);
+        rassert(divides(extent_size, extent - base_offset));
+        return (extent - base_offset) / extent_size;
+    }
+
+    int64_t id_to_offset(size_t id) const {
+        return base_offset + id * extent_size;
     }
 
     /* free-list and extent map. Contains one entry per extent.  During the
@@ -64,18 +80,38 @@ class extent_zone_t {
                         std::vector<size_t>,
                         std::greater<size_t> > free_queue;
 
+    // The state_discarding extents that haven't been handed out by take_discards().
+    std::vector<size_t> discard_queue;
+
     file_t *const dbfile;
 
     // The number of free extents in the file.
     size_t held_extents_;
 
+    // The number of state_discarding extents.
+    size_t discarding_extents_;
+
 public:
     size_t held_extents() const {
-        return held_extents_;
+        return held_extents_ + discarding_extents_;
     }
 
-    extent_zone_t(file_t *_dbfile, size_t _extent_size)
-        : extent_size(_extent_size), dbfile(_dbfile), held_extents_(0) {
+    size_t num_extents() const {
+        return extents.size();
+    }
+
+    // The id of the first free extent in the file, or num_extents() if there is
+    // none.
+    size_t lowest_free_extent() const {
+        if (held_extents_ == 0 || free_queue.empty()) {
+            return extents.size();
+        }
+        return std::min(free_queue.top(), extents.size());
+    }
+
+    extent_zone_t(file_t *_dbfile, size_t _extent_size, int64_t _base_offset)
+        : extent_size(_extent_size), base_offset(_base_offset), dbfile(_dbfile),
+          held_extents_(0), discarding_extents_(0) {
         // (Avoid a bunch of reallocations by resize calls (avoiding O(n log n)
         // work on average).)
         extents.reserve(dbfile->get_size() / extent_size);
@@ -104,11 +140,11 @@ public:
     }
 
     extent_reference_t gen_extent() {
-        int64_t extent;
+        size_t id;
 
         if (free_queue.empty()) {
             rassert(held_extents_ == 0);
-            extent = extents.size() * extent_size;
+            id = extents.size();
             extents.push_back(extent_info_t());
         } else if (free_queue.top() >= extents.size()) {
             rassert(held_extents_ == 0);
@@ -116,20 +152,20 @@ public:
                                 std::vector<size_t>,
                                 std::greater<size_t> > tmp;
             free_queue = tmp;
-            extent = extents.size() * extent_size;
+            id = extents.size();
             extents.push_back(extent_info_t());
         } else {
-            extent = free_queue.top() * extent_size;
+            id = free_queue.top();
             free_queue.pop();
             --held_extents_;
         }
 
-        extent_info_t *info = &extents[offset_to_id(extent)];
+        extent_info_t *info = &extents[id];
         info->set_state(extent_info_t::state_in_use);
 
-        extent_reference_t extent_ref = make_extent_reference(extent);
+        extent_reference_t extent_ref = make_extent_reference(id_to_offset(id));
 
-        dbfile->set_size_at_least(extent + extent_size);
+        dbfile->set_size_at_least((id + 1) * extent_size);
 
         return extent_ref;
     }
@@ -177,41 +213,118 @@ public:
         }
     }
 
-    void release_extent(extent_reference_t &&extent_ref) {
+    // Releases a reference to the extent.  If that was the last one and `discard` is
+    // true, the extent waits in the discard queue instead of becoming free.
+    void release_extent(extent_reference_t &&extent_ref, bool discard) {
         int64_t extent = extent_ref.release();
         extent_info_t *info = &extents[offset_to_id(extent)];
         guarantee(info->state() == extent_info_t::state_in_use);
         guarantee(info->extent_use_refcount > 0);
         --info->extent_use_refcount;
         if (info->extent_use_refcount == 0) {
-            info->set_state(extent_info_t::state_free);
-            free_queue.push(offset_to_id(extent));
-            ++held_extents_;
-            try_shrink_file();
+            if (discard) {
+                info->set_state(extent_info_t::state_discarding);
+                discard_queue.push_back(offset_to_id(extent));
+                ++discarding_extents_;
+            } else {
+                info->set_state(extent_info_t::state_free);
+                free_queue.push(offset_to_id(extent));
+                ++held_extents_;
+                try_shrink_file();
+            }
         }
     }
+
+    bool has_discards() const {
+        return !discard_queue.empty();
+    }
+
+    // Moves up to max_count extents from the discard queue to *offsets_out.  They
+    // stay state_discarding until finish_discard() is called for them.
+    void take_discards(size_t max_count, std::vector<int64_t> *offsets_out) {
+        while (!discard_queue.empty() && offsets_out->size() < max_count) {
+            offsets_out->push_back(id_to_offset(discard_queue.back()));
+            discard_queue.pop_back();
+        }
+    }
+
+    // Like file_t::discard(), for offsets in this zone.
+    int discard(int64_t offset, int64_t length) {
+        return dbfile->discard(offset - base_offset, length);
+    }
+
+    void finish_discard(int64_t extent) {
+        size_t id = offset_to_id(extent);
+        guarantee(id < extents.size());
+        guarantee(extents[id].state() == extent_info_t::state_discarding);
+        extents[id].set_state(extent_info_t::state_free);
+        free_queue.push(id);
+        --discarding_extents_;
+        ++held_extents_;
+        try_shrink_file();
+    }
 };
 
-extent_manager_t::extent_manager_t(file_t *file,
+extent_manager_t::extent_manager_t(file_t *data_file, file_t *index_file,
+                                   file_t *archive_file,
                                    const log_serializer_on_disk_static_config_t *static_config,
+                                   const log_serializer_dynamic_config_t *_dynamic_config,
                                    log_serializer_stats_t *_stats)
     : stats(_stats), extent_size(static_config->extent_size()),
-      state(state_reserving_extents) {
+      dynamic_config(_dynamic_config),
+      discard_drainer(new auto_drainer_t), discarder_active(false),
+      discard_unsupported(false), state(state_reserving_extents) {
     guarantee(divides(DEVICE_BLOCK_SIZE, extent_size));
 
-    zone.init(new extent_zone_t(file, extent_size));
+    zone.init(new extent_zone_t(data_file, extent_size, 0));
+    if (index_file != NULL) {
+        index_zone.init(new extent_zone_t(index_file, extent_size, INDEX_FILE_OFFSET));
+    }
+    if (archive_file != NULL) {
+        archive_zone.init(new extent_zone_t(archive_file, extent_size,
+                                            ARCHIVE_FILE_OFFSET));
+    }
 }
 
 extent_manager_t::~extent_manager_t() {
     rassert(state == state_reserving_extents || state == state_shut_down);
 }
 
+extent_zone_t *extent_manager_t::zone_for(int64_t extent) {
+    if (extent >= INDEX_FILE_OFFSET) {
+        guarantee(index_zone.has(), "An index file extent, but there's no index file.");
+        return index_zone.get();
+    } else if (extent >= ARCHIVE_FILE_OFFSET) {
+        guarantee(archive_zone.has(),
+                  "An archive file extent, but there's no archive file.");
+        return archive_zone.get();
+    } else {
+        return zone.get();
+    }
+}
+
+std::vector<extent_zone_t *> extent_manager_t::all_zones() {
+    std::vector<extent_zone_t *> zones;
+    zones.push_back(zone.get());
+    if (index_zone.has()) {
+        zones.push_back(index_zone.get());
+    }
+    if (archive_zone.has()) {
+        zones.push_back(archive_zone.get());
+    }
+    return zones;
+}
+
 extent_reference_t extent_manager_t::reserve_extent(int64_t extent) {
     assert_thread();
     rassert(state == state_reserving_extents);
     ++stats->pm_extents_in_use;
     stats->pm_bytes_in_use += extent_size;
-    return zone->reserve_extent(extent);
+    return zone_for(extent)->reserve_extent(extent);
+}
+
+int64_t extent_manager_t::index_extents_offset() const {
+    return index_zone.has() ? INDEX_FILE_OFFSET : 0;
 }
 
 void extent_manager_t::prepare_initial_metablock(metablock_mixin_t *mb) {
@@ -222,7 +335,10 @@ void extent_manager_t::start_existing(UNUSED metablock_mixin_t *last_metablock)
     assert_thread();
     rassert(state == state_reserving_extents);
     current_transaction = NULL;
-    zone->reconstruct_free_list();
+    const std::vector<extent_zone_t *> zones = all_zones();
+    for (auto it = zones.begin(); it != zones.end(); ++it) {
+        (*it)->reconstruct_free_list();
+    }
     state = state_running;
 
 }
@@ -237,9 +353,105 @@ void extent_manager_t::shutdown() {
     assert_thread();
     rassert(state == state_running);
     rassert(!current_transaction);
+    rassert(!discard_drainer.has());
     state = state_shut_down;
 }
 
+void extent_manager_t::stop_discarding() {
+    assert_thread();
+    rassert(coro_t::self() != NULL);
+
+    // Wait for the batch that's being discarded, then free the extents that are
+    // still waiting without discarding them.  Extents released from now on go
+    // straight into the free queue.
+    discard_drainer.reset();
+    rassert(!discarder_active);
+
+    const std::vector<extent_zone_t *> zones = all_zones();
+    for (size_t i = 0; i < zones.size(); ++i) {
+        std::vector<int64_t> offsets;
+        while (zones[i]->has_discards()) {
+            offsets.clear();
+            zones[i]->take_discards(EXTENT_DISCARD_BATCH_SIZE, &offsets);
+            for (auto it = offsets.begin(); it != offsets.end(); ++it) {
+                zones[i]->finish_discard(*it);
+            }
+        }
+    }
+}
+
+bool extent_manager_t::has_discards() const {
+    return zone->has_discards()
+        || (index_zone.has() && index_zone->has_discards())
+        || (archive_zone.has() && archive_zone->has_discards());
+}
+
+bool extent_manager_t::should_discard_released_extents() const {
+    return discard_drainer.has()
+        && !discard_unsupported
+        && dynamic_config->discard_freed_extents;
+}
+
+void extent_manager_t::maybe_start_discarder() {
+    if (!discarder_active && discard_drainer.has() && has_discards()) {
+        discarder_active = true;
+        coro_t::spawn_sometime(std::bind(&extent_manager_t::discard_extents, this,
+                                         auto_drainer_t::lock_t(discard_drainer.get())));
+    }
+}
+
+void extent_manager_t::discard_extents(auto_drainer_t::lock_t lock) {
+    assert_thread();
+    std::vector<int64_t> offsets;
+    while (has_discards()) {
+        // The data file's extents go first.
+        extent_zone_t *discard_zone = NULL;
+        const std::vector<extent_zone_t *> zones = all_zones();
+        for (auto it = zones.begin(); discard_zone == NULL; ++it) {
+            guarantee(it != zones.end());
+            if ((*it)->has_discards()) {
+                discard_zone = *it;
+            }
+        }
+        offsets.clear();
+        discard_zone->take_discards(EXTENT_DISCARD_BATCH_SIZE, &offsets);
+
+        // Adjacent extents get discarded with a single call.
+        std::sort(offsets.begin(), offsets.end());
+        for (size_t i = 0; i < offsets.size() && !discard_unsupported;) {
+            size_t j = i + 1;
+            while (j < offsets.size()
+                   && offsets[j] == offsets[j - 1] + static_cast<int64_t>(extent_size)) {
+                ++j;
+            }
+            const int res = discard_zone->discard(offsets[i], (j - i) * extent_size);
+            if (res != 0) {
+                logWRN("Could not discard freed extents (%s).  Freed extents will "
+                       "not be discarded any more.\n", errno_string(res).c_str());
+                discard_unsupported = true;
+            } else {
+                stats->pm_serializer_extents_discarded += j - i;
+            }
+            i = j;
+        }
+
+        for (auto it = offsets.begin(); it != offsets.end(); ++it) {
+            discard_zone->finish_discard(*it);
+        }
+
+        if (lock.get_drain_signal()->is_pulsed()) {
+            break;
+        }
+        // Spread the discards out so that they don't hold up other IO.
+        try {
+            nap(EXTENT_DISCARD_INTERVAL_MS, lock.get_drain_signal());
+        } catch (const interrupted_exc_t &) {
+            break;
+        }
+    }
+    discarder_active = false;
+}
+
 void extent_manager_t::begin_transaction(extent_transaction_t *out) {
     assert_thread();
     rassert(!current_transaction);
@@ -256,10 +468,29 @@ extent_reference_t extent_manager_t::gen_extent() {
     return zone->gen_extent();
 }
 
+extent_reference_t extent_manager_t::gen_index_extent() {
+    assert_thread();
+    rassert(state == state_running);
+    ++stats->pm_extents_in_use;
+    stats->pm_bytes_in_use += extent_size;
+
+    return index_zone.has() ? index_zone->gen_extent() : zone->gen_extent();
+}
+
+extent_reference_t extent_manager_t::gen_archive_extent() {
+    assert_thread();
+    rassert(state == state_running);
+    guarantee(archive_zone.has());
+    ++stats->pm_extents_in_use;
+    stats->pm_bytes_in_use += extent_size;
+
+    return archive_zone->gen_extent();
+}
+
 extent_reference_t
 extent_manager_t::copy_extent_reference(const extent_reference_t &extent_ref) {
     int64_t offset = extent_ref.offset();
-    return zone->make_extent_reference(offset);
+    return zone_for(offset)->make_extent_reference(offset);
 }
 
 void extent_manager_t::release_extent_into_transaction(extent_reference_t &&extent_ref, extent_transaction_t *txn) {
@@ -270,7 +501,9 @@ void extent_manager_t::release_extent_into_transaction(extent_reference_t &&exte
 
 void extent_manager_t::release_extent(extent_reference_t &&extent_ref) {
     release_extent_preliminaries();
-    zone->release_extent(std::move(extent_ref));
+    zone_for(extent_ref.offset())->release_extent(std::move(extent_ref),
+                                                  should_discard_released_extents());
+    maybe_start_discarder();
 }
 
 void extent_manager_t::release_extent_preliminaries() {
@@ -292,12 +525,29 @@ void extent_manager_t::end_transaction(extent_transaction_t *t) {
 void extent_manager_t::commit_transaction(extent_transaction_t *t) {
     assert_thread();
     std::vector<extent_reference_t> extents = t->reset();
+    const bool discard = should_discard_released_extents();
     for (auto it = extents.begin(); it != extents.end(); ++it) {
-        zone->release_extent(std::move(*it));
+        zone_for(it->offset())->release_extent(std::move(*it), discard);
     }
+    maybe_start_discarder();
+}
+
+size_t extent_manager_t::data_file_extents() const {
+    assert_thread();
+    return zone->num_extents();
+}
+
+size_t extent_manager_t::lowest_free_data_extent() const {
+    assert_thread();
+    return zone->lowest_free_extent();
 }
 
 size_t extent_manager_t::held_extents() {
     assert_thread();
-    return zone->held_extents();
+    size_t count = 0;
+    const std::vector<extent_zone_t *> zones = all_zones();
+    for (auto it = zones.begin(); it != zones.end(); ++it) {
+        count += (*it)->held_extents();
+    }
+    return count;
 }
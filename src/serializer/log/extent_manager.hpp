@@ -13,6 +13,7 @@
 #include <boost/ptr_container/ptr_vector.hpp>
 
 #include "arch/types.hpp"
+#include "concurrency/auto_drainer.hpp"
 #include "config/args.hpp"
 #include "containers/scoped.hpp"
 #include "serializer/log/config.hpp"
@@ -99,8 +100,13 @@ public:
         int64_t padding;
     };
 
-    extent_manager_t(file_t *file,
+    /* index_file is NULL if there's no index file.  Otherwise, the index extents
+    (see gen_index_extent()) are at offsets starting at INDEX_FILE_OFFSET, like in
+    split_file_t.  The same goes for archive_file, whose extents (see
+    gen_archive_extent()) start at ARCHIVE_FILE_OFFSET. */
+    extent_manager_t(file_t *data_file, file_t *index_file, file_t *archive_file,
                      const log_serializer_on_disk_static_config_t *static_config,
+                     const log_serializer_dynamic_config_t *dynamic_config,
                      log_serializer_stats_t *);
     ~extent_manager_t();
 
@@ -109,11 +115,24 @@ public:
 
     MUST_USE extent_reference_t reserve_extent(int64_t extent);
 
+    /* The offset of the index file's first extent (where its static header and the
+    metablocks are), or 0 if there's no index file. */
+    int64_t index_extents_offset() const;
+
     static void prepare_initial_metablock(metablock_mixin_t *mb);
     void start_existing(metablock_mixin_t *last_metablock);
     void prepare_metablock(metablock_mixin_t *metablock);
     void shutdown();
 
+    /* When `discard_freed_extents` is set in the dynamic config, extents whose last
+    reference is released get discarded (see `file_t::discard()`) in the background,
+    a few at a time, before they go into the free queue.  That way an SSD knows it
+    doesn't have to keep their contents around, and an extent can't be handed out
+    again while it's being discarded.  `stop_discarding()` must be called (in a
+    coroutine) before `shutdown()`; it waits for the discard in progress and frees
+    the extents that are still waiting. */
+    void stop_discarding();
+
     /* The extent manager uses transactions to make sure that extents are not freed
     before it is safe to free them. An extent manager transaction is created for every
     log serializer write transaction. Any extents that are freed in the course of
@@ -127,22 +146,57 @@ public:
 
     void begin_transaction(extent_transaction_t *out);
     MUST_USE extent_reference_t gen_extent();
+    /* gen_extent() for the LBA, whose extents go into the index file if there is
+    one. */
+    MUST_USE extent_reference_t gen_index_extent();
+    /* gen_extent() for the data blocks that go to the archive file.  There must be
+    one. */
+    MUST_USE extent_reference_t gen_archive_extent();
+    bool has_archive_file() const { return archive_zone.has(); }
     void release_extent_into_transaction(extent_reference_t &&extent_ref,
                                          extent_transaction_t *txn);
     void release_extent(extent_reference_t &&extent_ref);
     void end_transaction(extent_transaction_t *t);
     void commit_transaction(extent_transaction_t *t);
 
-    /* Number of extents that have been released but not handed back out again. */
+    /* Number of extents that have been released but not handed back out again
+    (including the ones waiting to be discarded). */
     size_t held_extents();
 
+    /* The number of extents in the data file, and the index of its first free
+    extent (or data_file_extents() if none is free), for compacting the data file.
+    Data file extent indexes are their offsets divided by the extent size. */
+    size_t data_file_extents() const;
+    size_t lowest_free_data_extent() const;
+
     log_serializer_stats_t *const stats;
     const uint64_t extent_size;   /* Same as static_config->extent_size */
 
 private:
     void release_extent_preliminaries();
 
+    extent_zone_t *zone_for(int64_t extent);
+    // The zones that there are, data file's first.
+    std::vector<extent_zone_t *> all_zones();
+
+    bool has_discards() const;
+    bool should_discard_released_extents() const;
+    void maybe_start_discarder();
+    void discard_extents(auto_drainer_t::lock_t lock);
+
+    const log_serializer_dynamic_config_t *const dynamic_config;
+
+    // The data file's extents, and the index and archive files' extents if there
+    // are such files.
     scoped_ptr_t<extent_zone_t> zone;
+    scoped_ptr_t<extent_zone_t> index_zone;
+    scoped_ptr_t<extent_zone_t> archive_zone;
+
+    // Reset by `stop_discarding()`.
+    scoped_ptr_t<auto_drainer_t> discard_drainer;
+    bool discarder_active;
+    // Set when a discard fails, so that we stop trying.
+    bool discard_unsupported;
 
     /* During serializer startup, each component informs the extent manager
     which extents in the file it was using at shutdown. This is the
@@ -0,0 +1,95 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "serializer/log/gc_scheduler.hpp"
+
+#include <algorithm>
+
+#include "arch/io/disk/stats_2.hpp"
+#include "config/args.hpp"
+#include "perfmon/perfmon.hpp"
+#include "serializer/log/data_block_manager.hpp"
+#include "serializer/log/stats.hpp"
+
+gc_scheduler_t::gc_scheduler_t(data_block_manager_t *_parent,
+                               log_serializer_stats_t *_stats)
+    : parent(_parent),
+      stats(_stats),
+      tokens(GC_MAX_BURST_BYTES),
+      rate(0),
+      last_refill_time(get_ticks()),
+      last_adjustment_time(last_refill_time),
+      reported_rate(0),
+      reported_debt(0),
+      timer(NULL) {
+    set_rate(GC_INITIAL_RATE);
+}
+
+gc_scheduler_t::~gc_scheduler_t() {
+    cancel();
+    stats->pm_serializer_gc_rate -= reported_rate;
+    stats->pm_serializer_gc_debt -= reported_debt;
+}
+
+bool gc_scheduler_t::may_gc_extent(uint64_t live_bytes, bool urgent) {
+    refill_and_adjust_rate();
+    // Moving the extent means reading and writing its live blocks.
+    const double cost = 2.0 * live_bytes;
+    if (urgent || tokens >= 0) {
+        tokens -= cost;
+        return true;
+    }
+
+    if (timer == NULL) {
+        const int64_t ms = std::max<int64_t>(1, -tokens / rate * 1000);
+        timer = fire_timer_once(ms, this);
+    }
+    return false;
+}
+
+void gc_scheduler_t::set_debt(int64_t debt_bytes) {
+    debt_bytes = std::max<int64_t>(debt_bytes, 0);
+    stats->pm_serializer_gc_debt += debt_bytes - reported_debt;
+    reported_debt = debt_bytes;
+}
+
+void gc_scheduler_t::cancel() {
+    if (timer != NULL) {
+        cancel_timer(timer);
+        timer = NULL;
+    }
+}
+
+void gc_scheduler_t::on_timer() {
+    // The timer token deletes itself after firing once.
+    timer = NULL;
+    parent->start_gc();
+}
+
+void gc_scheduler_t::refill_and_adjust_rate() {
+    const ticks_t now = get_ticks();
+    tokens = std::min<double>(tokens + rate * ticks_to_secs(now - last_refill_time),
+                              GC_MAX_BURST_BYTES);
+    last_refill_time = now;
+
+    if (now - last_adjustment_time < secs_to_ticks(1) / 1000
+                                     * GC_RATE_ADJUSTMENT_INTERVAL_MS) {
+        return;
+    }
+    last_adjustment_time = now;
+
+    const double latency_micros = ticks_to_secs(get_recent_disk_read_latency()) * 1e6;
+    if (latency_micros > GC_TARGET_READ_LATENCY_MICROS) {
+        set_rate(rate / 2);
+    } else if (latency_micros < GC_TARGET_READ_LATENCY_MICROS / 4.0) {
+        // The disk isn't busy, so let the GC catch up.
+        set_rate(rate * 2);
+    } else {
+        set_rate(rate * 1.1);
+    }
+}
+
+void gc_scheduler_t::set_rate(double new_rate) {
+    rate = std::min<double>(std::max<double>(new_rate, GC_MIN_RATE), GC_MAX_RATE);
+    const int64_t rounded_rate = rate;
+    stats->pm_serializer_gc_rate += rounded_rate - reported_rate;
+    reported_rate = rounded_rate;
+}
@@ -0,0 +1,67 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_LOG_GC_SCHEDULER_HPP_
+#define SERIALIZER_LOG_GC_SCHEDULER_HPP_
+
+#include <stdint.h>
+
+#include "arch/timer.hpp"
+#include "errors.hpp"
+#include "time.hpp"
+
+class data_block_manager_t;
+struct log_serializer_stats_t;
+
+/* Paces the data block manager's GC, so that its reads and writes don't push up the
+latency of everybody else's reads.  The GC may move one extent after the other as
+long as it has tokens in a bucket that gets refilled at the current GC rate (in
+bytes per second).  The rate is adjusted against the recent disk read latency (see
+get_recent_disk_read_latency):  it is halved when the latency is above
+GC_TARGET_READ_LATENCY_MICROS, grows slowly while it's below, and doubles while it's
+far below (when the disk is mostly idle), so that the GC catches up.
+
+When the garbage ratio gets too high, the GC isn't throttled at all, because the
+database growing indefinitely is worse than slow queries. */
+class gc_scheduler_t : private timer_callback_t {
+public:
+    gc_scheduler_t(data_block_manager_t *parent, log_serializer_stats_t *stats);
+    ~gc_scheduler_t();
+
+    /* Returns true if the GC may move an extent with the given number of live
+    bytes right now (and takes the tokens for it).  Otherwise, it returns false
+    and calls parent->start_gc() once the GC may go on. */
+    bool may_gc_extent(uint64_t live_bytes, bool urgent);
+
+    /* Tells the scheduler how many garbage bytes the GC would have to collect to
+    get down to the low garbage ratio, for the stats. */
+    void set_debt(int64_t debt_bytes);
+
+    /* Forgets about calling parent->start_gc(). */
+    void cancel();
+
+private:
+    void on_timer();
+
+    void refill_and_adjust_rate();
+
+    void set_rate(double rate);
+
+    data_block_manager_t *const parent;
+    log_serializer_stats_t *const stats;
+
+    /* The bytes the GC may read and write, which can be negative after an extent
+    with more live data than the bucket holds. */
+    double tokens;
+    double rate;
+    ticks_t last_refill_time;
+    ticks_t last_adjustment_time;
+
+    /* What we last added to the stats' counters. */
+    int64_t reported_rate;
+    int64_t reported_debt;
+
+    timer_token_t *timer;
+
+    DISABLE_COPYING(gc_scheduler_t);
+};
+
+#endif  // SERIALIZER_LOG_GC_SCHEDULER_HPP_
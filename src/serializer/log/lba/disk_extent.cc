@@ -53,7 +53,6 @@ void lba_disk_extent_t::read_step_1(read_info_t *info_out, extent_t::read_callba
 }
 
 void lba_disk_extent_t::read_step_2(read_info_t *info, in_memory_index_t *index) {
-    em->assert_thread();
     lba_extent_t *extent = reinterpret_cast<lba_extent_t *>(info->buffer);
     guarantee(memcmp(extent->header.magic, lba_magic, LBA_MAGIC_SIZE) == 0);
 
@@ -61,7 +60,7 @@ void lba_disk_extent_t::read_step_2(read_info_t *info, in_memory_index_t *index)
         lba_entry_t *e = &extent->entries[i];
         if (!lba_entry_t::is_padding(e)) {
             index->set_block_info(e->block_id, e->recency, e->offset,
-                                  e->ser_block_size);
+                                  e->ser_block_size, e->ser_uncompressed_size);
         }
     }
 
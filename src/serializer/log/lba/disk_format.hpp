@@ -62,26 +62,29 @@ static const block_id_t PADDING_BLOCK_ID = NULL_BLOCK_ID;
 struct lba_entry_t {
     block_id_t block_id;
 
+    // The size of the block on disk.
     uint32_t ser_block_size;
 
-    // TODO: Remove the need for these fields (or this zero field).  Remove the
-    // requirement that lba_entry_t be a divisor of DEVICE_BLOCK_SIZE.  When doing
-    // so, be sure to make lba entries backwards compatiblizable for now.  (We could
-    // in the future use this value being non-zero to mean the lba entry is a
-    // new-style entry.)
-    uint32_t zero2;
+    // If the block is compressed on disk, the block's (serializer) size once it's
+    // decompressed, otherwise 0.  This used to be a zero field, so older lba
+    // entries are for uncompressed blocks.
+    // TODO: Remove the requirement that lba_entry_t be a divisor of
+    // DEVICE_BLOCK_SIZE.  When doing so, be sure to make lba entries backwards
+    // compatiblizable for now.
+    uint32_t ser_uncompressed_size;
 
     repli_timestamp_t recency;
     // An offset into the file, with is_delete set appropriately.
     flagged_off64_t offset;
 
     static lba_entry_t make(block_id_t block_id, repli_timestamp_t recency,
-                            flagged_off64_t offset, uint32_t ser_block_size) {
+                            flagged_off64_t offset, uint32_t ser_block_size,
+                            uint32_t ser_uncompressed_size) {
         guarantee(ser_block_size != 0 || !offset.has_value());
         lba_entry_t entry;
         entry.block_id = block_id;
         entry.ser_block_size = ser_block_size;
-        entry.zero2 = 0;
+        entry.ser_uncompressed_size = ser_uncompressed_size;
         entry.recency = recency;
         entry.offset = offset;
         return entry;
@@ -92,7 +95,7 @@ struct lba_entry_t {
     }
 
     static lba_entry_t make_padding_entry() {
-        return make(PADDING_BLOCK_ID, repli_timestamp_t::invalid, flagged_off64_t::padding(), 0);
+        return make(PADDING_BLOCK_ID, repli_timestamp_t::invalid, flagged_off64_t::padding(), 0, 0);
     }
 } __attribute__((__packed__));
 
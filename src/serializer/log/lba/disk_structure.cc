@@ -1,6 +1,9 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "serializer/log/lba/disk_structure.hpp"
 
+#include <functional>
+
+#include "arch/runtime/coroutines.hpp"
 #include "containers/scoped.hpp"
 #include "math.hpp"
 
@@ -66,6 +69,7 @@ void lba_disk_structure_t::on_extent_read() {
 
 void lba_disk_structure_t::add_entry(block_id_t block_id, repli_timestamp_t recency,
                                      flagged_off64_t offset, uint32_t ser_block_size,
+                                     uint32_t ser_uncompressed_size,
                                      file_account_t *io_account, extent_transaction_t *txn) {
     if (last_extent && last_extent->full()) {
         /* We have filled up an extent. Transfer it to the superblock. */
@@ -84,7 +88,9 @@ void lba_disk_structure_t::add_entry(block_id_t block_id, repli_timestamp_t rece
 
     rassert(!last_extent->full());
 
-    last_extent->add_entry(lba_entry_t::make(block_id, recency, offset, ser_block_size), io_account);
+    last_extent->add_entry(lba_entry_t::make(block_id, recency, offset, ser_block_size,
+                                            ser_uncompressed_size),
+                          io_account);
 }
 
 std::set<lba_disk_extent_t *> lba_disk_structure_t::get_inactive_extents() const {
@@ -195,6 +201,7 @@ struct reader_t
 {
     lba_disk_structure_t *ds;   // The disk structure we are reading from
     in_memory_index_t *index;   // The in-memory-index we are reading into
+    threadnum_t decoding_thread;   // Where we put the entries into the index
     lba_disk_structure_t::read_callback_t *rcb;   // Who to call back when we finish
 
     /* extent_reader_t takes care of reading a single extent. */
@@ -241,7 +248,16 @@ struct reader_t
             if (have_read) done();
         }
         void done() {
-            extent->read_step_2(&read_info, parent->index);
+            // Putting the entries into the index is what takes most of the time when
+            // loading a big LBA, so it happens on a separate thread for each shard.
+            // The extents of a shard still get decoded one after the other.
+            coro_t::spawn_sometime(std::bind(&extent_reader_t::decode_extent, this));
+        }
+        void decode_extent() {
+            {
+                on_thread_t th(parent->decoding_thread);
+                extent->read_step_2(&read_info, parent->index);
+            }
             parent->active_readers--;
             parent->start_more_readers();
             if (index == static_cast<int>(parent->readers.size()) - 1) {
@@ -260,8 +276,9 @@ struct reader_t
     // reading process so that we stay under LBA_READ_BUFFER_SIZE.
     int active_readers;
 
-    reader_t(lba_disk_structure_t *_ds, in_memory_index_t *_index, lba_disk_structure_t::read_callback_t *cb)
-        : ds(_ds), index(_index), rcb(cb)
+    reader_t(lba_disk_structure_t *_ds, in_memory_index_t *_index,
+             threadnum_t _decoding_thread, lba_disk_structure_t::read_callback_t *cb)
+        : ds(_ds), index(_index), decoding_thread(_decoding_thread), rcb(cb)
     {
         for (lba_disk_extent_t *e = ds->extents_in_superblock.head();
              e != NULL; e = ds->extents_in_superblock.next(e)) {
@@ -295,8 +312,9 @@ struct reader_t
     }
 };
 
-void lba_disk_structure_t::read(in_memory_index_t *index, read_callback_t *cb) {
-    new reader_t(this, index, cb);
+void lba_disk_structure_t::read(in_memory_index_t *index, threadnum_t decoding_thread,
+                                read_callback_t *cb) {
+    new reader_t(this, index, decoding_thread, cb);
 }
 
 void lba_disk_structure_t::prepare_metablock(lba_shard_metablock_t *mb_out) {
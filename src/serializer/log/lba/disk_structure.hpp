@@ -8,6 +8,7 @@
 #include "serializer/log/extent_manager.hpp"
 #include "serializer/log/lba/disk_format.hpp"
 #include "serializer/log/lba/disk_extent.hpp"
+#include "threading.hpp"
 
 class lba_load_fsm_t;
 class lba_writer_t;
@@ -33,6 +34,7 @@ public:
     // Put entries in an LBA and then call sync() to write to disk
     void add_entry(block_id_t block_id, repli_timestamp_t recency,
                    flagged_off64_t offset, uint32_t ser_block_size,
+                   uint32_t ser_uncompressed_size,
                    file_account_t *io_account,
                    extent_transaction_t *txn);
     struct sync_callback_t {
@@ -54,12 +56,14 @@ public:
                          file_account_t *io_account, extent_transaction_t *txn);
 
     // If you call read(), then the in_memory_index_t will be populated and then the read_callback_t
-    // will be called when it is done.
+    // will be called when it is done.  The entries are put into the index on
+    // decoding_thread; nobody else may touch this disk structure's shard of the index
+    // until the read is done.
     struct read_callback_t {
         virtual void on_lba_extents_read() = 0;
         virtual ~read_callback_t() {}
     };
-    void read(in_memory_index_t *index, read_callback_t *cb);
+    void read(in_memory_index_t *index, threadnum_t decoding_thread, read_callback_t *cb);
 
     void prepare_metablock(lba_shard_metablock_t *mb_out);
 
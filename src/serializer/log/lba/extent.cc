@@ -67,7 +67,7 @@ struct extent_block_t :
 extent_t::extent_t(extent_manager_t *_em, file_t *_file)
     : amount_filled(0), em(_em),
       file(_file), last_block(NULL), current_block(NULL) {
-    extent_ref = em->gen_extent();
+    extent_ref = em->gen_index_extent();
     ++em->stats->pm_serializer_lba_extents;
 }
 
@@ -3,25 +3,151 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+
 #include "serializer/log/lba/disk_format.hpp"
 
-in_memory_index_t::in_memory_index_t() : end_block_id_(0) { }
+in_memory_index_chunk_t::in_memory_index_chunk_t() {
+    for (size_t i = 0; i < SIZE / 64; ++i) {
+        present_[i] = 0;
+    }
+}
+
+index_block_info_t in_memory_index_chunk_t::get(size_t index) const {
+    rassert(index < SIZE);
+    if (!is_present(index)) {
+        return index_block_info_t();
+    }
+    return decode(entries_[rank(index)]);
+}
+
+void in_memory_index_chunk_t::set(size_t index, const index_block_info_t &info) {
+    rassert(index < SIZE);
+    const size_t i = rank(index);
+    const uint64_t bit = static_cast<uint64_t>(1) << (index % 64);
+    if (info == index_block_info_t()) {
+        if (is_present(index)) {
+            entries_.erase(entries_.begin() + i);
+            present_[index / 64] &= ~bit;
+            if (entries_.empty()) {
+                // Give the memory back; the chunk is about to be deleted anyway.
+                std::vector<entry_t>().swap(entries_);
+            }
+        }
+    } else if (is_present(index)) {
+        entries_[i] = encode(info);
+    } else {
+        if (entries_.size() == entries_.capacity()) {
+            // Grow in small steps; the default doubling would waste up to half of
+            // the memory of the index.
+            entries_.reserve(entries_.size() + 16);
+        }
+        entries_.insert(entries_.begin() + i, encode(info));
+        present_[index / 64] |= bit;
+    }
+}
+
+size_t in_memory_index_chunk_t::rank(size_t index) const {
+    size_t ret = 0;
+    for (size_t i = 0; i < index / 64; ++i) {
+        ret += __builtin_popcountll(present_[i]);
+    }
+    const uint64_t mask = (static_cast<uint64_t>(1) << (index % 64)) - 1;
+    return ret + __builtin_popcountll(present_[index / 64] & mask);
+}
+
+in_memory_index_chunk_t::entry_t
+in_memory_index_chunk_t::encode(const index_block_info_t &info) {
+    uint64_t offset = NO_OFFSET;
+    if (info.offset.has_value()) {
+        const int64_t misalignment = info.offset.get_value() % DEVICE_BLOCK_SIZE;
+        guarantee(misalignment == 0,
+                  "Block offset %" PRIi64 " is not aligned.", info.offset.get_value());
+        offset = info.offset.get_value() / DEVICE_BLOCK_SIZE;
+        guarantee(offset < NO_OFFSET,
+                  "Block offset %" PRIi64 " is too large.", info.offset.get_value());
+    } else {
+        rassert(info.offset == flagged_off64_t::unused());
+    }
+
+    entry_t ret;
+    ret.offset_low = static_cast<uint32_t>(offset);
+    ret.offset_high = static_cast<uint8_t>(offset >> 32);
+    ret.ser_block_size = info.ser_block_size;
+    ret.ser_uncompressed_size = info.ser_uncompressed_size;
+    ret.recency = info.recency;
+    return ret;
+}
+
+index_block_info_t in_memory_index_chunk_t::decode(const entry_t &entry) {
+    const uint64_t offset = (static_cast<uint64_t>(entry.offset_high) << 32)
+        | entry.offset_low;
+    return index_block_info_t(offset == NO_OFFSET
+                              ? flagged_off64_t::unused()
+                              : flagged_off64_t::make(offset * DEVICE_BLOCK_SIZE),
+                              entry.recency,
+                              entry.ser_block_size,
+                              entry.ser_uncompressed_size);
+}
+
+in_memory_index_t::shard_t::~shard_t() {
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        delete chunks[i];
+    }
+}
+
+in_memory_index_t::in_memory_index_t() { }
 
 block_id_t in_memory_index_t::end_block_id() {
-    return end_block_id_;
+    block_id_t ret = 0;
+    for (int i = 0; i < LBA_SHARD_FACTOR; ++i) {
+        ret = std::max(ret, shards_[i].value.end_block_id);
+    }
+    return ret;
 }
 
 index_block_info_t in_memory_index_t::get_block_info(block_id_t id) {
-    return infos_.get(id);
+    const shard_t *shard = &shards_[id % LBA_SHARD_FACTOR].value;
+    const block_id_t index = id / LBA_SHARD_FACTOR;
+    const size_t chunk_id = index / in_memory_index_chunk_t::SIZE;
+    if (chunk_id >= shard->chunks.size() || shard->chunks[chunk_id] == NULL) {
+        return index_block_info_t();
+    }
+    return shard->chunks[chunk_id]->get(index % in_memory_index_chunk_t::SIZE);
 }
 
 void in_memory_index_t::set_block_info(block_id_t id, repli_timestamp_t recency,
-                                       flagged_off64_t offset, uint32_t ser_block_size) {
-    if (id >= end_block_id_) {
-        end_block_id_ = id + 1;
+                                       flagged_off64_t offset, uint32_t ser_block_size,
+                                       uint32_t ser_uncompressed_size) {
+    shard_t *shard = &shards_[id % LBA_SHARD_FACTOR].value;
+    if (id >= shard->end_block_id) {
+        shard->end_block_id = id + 1;
     }
 
-    index_block_info_t info(offset, recency, ser_block_size);
-    infos_.set(id, info);
-}
+    index_block_info_t info(offset, recency, ser_block_size, ser_uncompressed_size);
+    const block_id_t index = id / LBA_SHARD_FACTOR;
+    const size_t chunk_id = index / in_memory_index_chunk_t::SIZE;
+    if (chunk_id >= shard->chunks.size()) {
+        if (info == index_block_info_t()) {
+            return;
+        }
+        shard->chunks.resize(chunk_id + 1, NULL);
+    }
+    in_memory_index_chunk_t *chunk = shard->chunks[chunk_id];
+    if (chunk == NULL) {
+        if (info == index_block_info_t()) {
+            return;
+        }
+        chunk = new in_memory_index_chunk_t;
+        shard->chunks[chunk_id] = chunk;
+    }
 
+    chunk->set(index % in_memory_index_chunk_t::SIZE, info);
+    if (chunk->empty()) {
+        delete chunk;
+        shard->chunks[chunk_id] = NULL;
+        while (!shard->chunks.empty() && shard->chunks.back() == NULL) {
+            shard->chunks.pop_back();
+        }
+    }
+}
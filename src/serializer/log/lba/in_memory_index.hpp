@@ -2,7 +2,9 @@
 #ifndef SERIALIZER_LOG_LBA_IN_MEMORY_INDEX_HPP_
 #define SERIALIZER_LOG_LBA_IN_MEMORY_INDEX_HPP_
 
-#include "containers/two_level_array.hpp"
+#include <vector>
+
+#include "concurrency/cache_line_padded.hpp"
 #include "config/args.hpp"
 #include "serializer/serializer.hpp"
 #include "serializer/log/lba/disk_format.hpp"
@@ -11,32 +13,98 @@ struct index_block_info_t {
     index_block_info_t()
         : offset(flagged_off64_t::unused()),
           recency(repli_timestamp_t::invalid),
-          ser_block_size(0) { }
+          ser_block_size(0),
+          ser_uncompressed_size(0) { }
 
     index_block_info_t(flagged_off64_t _offset,
                        repli_timestamp_t _recency,
-                       uint32_t _ser_block_size)
+                       uint32_t _ser_block_size,
+                       uint32_t _ser_uncompressed_size)
         : offset(_offset),
           recency(_recency),
-          ser_block_size(_ser_block_size) { }
+          ser_block_size(_ser_block_size),
+          ser_uncompressed_size(_ser_uncompressed_size) { }
 
-    // For two_level_array_t.
+    // For in_memory_index_chunk_t.
     bool operator==(const index_block_info_t &other) const {
         return offset == other.offset &&
             recency == other.recency &&
-            ser_block_size == other.ser_block_size;
+            ser_block_size == other.ser_block_size &&
+            ser_uncompressed_size == other.ser_uncompressed_size;
     }
 
     flagged_off64_t offset;
     repli_timestamp_t recency;
+    // See lba_entry_t.
     uint32_t ser_block_size;
+    uint32_t ser_uncompressed_size;
 } __attribute__((__packed__));
 
 
 
+/* The entries of in_memory_index_chunk_t::SIZE consecutive block ids (of one shard
+of the index).  Only the block ids that have an entry take up space: present_ says
+which ones do, and entries_ holds their entries in block id order.  The entries are
+also smaller than an index_block_info_t, because block offsets are always multiples
+of DEVICE_BLOCK_SIZE. */
+class in_memory_index_chunk_t {
+public:
+    static const size_t SIZE = 512;
+
+    in_memory_index_chunk_t();
+
+    bool empty() const { return entries_.empty(); }
+
+    index_block_info_t get(size_t index) const;
+    // Setting an entry to index_block_info_t() removes it.
+    void set(size_t index, const index_block_info_t &info);
+
+private:
+    // Offsets (in DEVICE_BLOCK_SIZE units) take 40 bits, which is plenty for a
+    // petabyte-sized file.  This offset means that the block has no offset.
+    static const uint64_t NO_OFFSET = (static_cast<uint64_t>(1) << 40) - 1;
+
+    struct entry_t {
+        uint32_t offset_low;
+        uint8_t offset_high;
+        uint32_t ser_block_size;
+        uint32_t ser_uncompressed_size;
+        repli_timestamp_t recency;
+    } __attribute__((__packed__));
+
+    static entry_t encode(const index_block_info_t &info);
+    static index_block_info_t decode(const entry_t &entry);
+
+    bool is_present(size_t index) const {
+        return (present_[index / 64] & (static_cast<uint64_t>(1) << (index % 64))) != 0;
+    }
+    // The number of present entries before index.
+    size_t rank(size_t index) const;
+
+    uint64_t present_[SIZE / 64];
+    std::vector<entry_t> entries_;
+
+    DISABLE_COPYING(in_memory_index_chunk_t);
+};
+
+/* The index is split into LBA_SHARD_FACTOR shards, the same way as the LBA on disk (by
+block id modulo LBA_SHARD_FACTOR).  Different shards may be modified on different
+threads at the same time; that's how the LBA gets loaded in parallel on startup.
+
+Each shard is an array of chunks, where the chunks without any entries are NULL, so
+the index takes memory in proportion to the number of blocks that have an entry
+(plus a pointer per in_memory_index_chunk_t::SIZE block ids). */
 class in_memory_index_t {
-    two_level_array_t<index_block_info_t> infos_;
-    block_id_t end_block_id_;
+    struct shard_t {
+        shard_t() : end_block_id(0) { }
+        ~shard_t();
+        // Indexed by block id divided by LBA_SHARD_FACTOR, then divided by the
+        // chunk size.
+        std::vector<in_memory_index_chunk_t *> chunks;
+        block_id_t end_block_id;
+    };
+    // Padded so that threads loading different shards don't fight over cache lines.
+    cache_line_padded_t<shard_t> shards_[LBA_SHARD_FACTOR];
 
 public:
     in_memory_index_t();
@@ -46,9 +114,11 @@ public:
 
     index_block_info_t get_block_info(block_id_t id);
     void set_block_info(block_id_t id, repli_timestamp_t recency,
-                        flagged_off64_t offset, uint32_t ser_block_size);
+                        flagged_off64_t offset, uint32_t ser_block_size,
+                        uint32_t ser_uncompressed_size);
 
+private:
+    DISABLE_COPYING(in_memory_index_t);
 };
 
 #endif  // SERIALIZER_LOG_LBA_IN_MEMORY_INDEX_HPP_
-
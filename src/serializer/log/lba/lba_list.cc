@@ -89,8 +89,14 @@ public:
         cbs_out--;
         if (cbs_out == 0) {
             cbs_out = LBA_SHARD_FACTOR;
+            // The shards are disjoint, so they can be decoded in parallel.  We spread
+            // them over the threads after ours.
+            const int num_threads = get_num_threads();
+            const int32_t our_thread = get_thread_id().threadnum;
             for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
-                owner->disk_structures[i]->read(&owner->in_memory_index, this);
+                const threadnum_t decoding_thread((our_thread + 1 + i) % num_threads);
+                owner->disk_structures[i]->read(&owner->in_memory_index,
+                                                decoding_thread, this);
             }
         }
     }
@@ -108,7 +114,8 @@ public:
                         e->block_id,
                         e->recency,
                         e->offset,
-                        e->ser_block_size);
+                        e->ser_block_size,
+                        e->ser_uncompressed_size);
             }
             
             owner->state = lba_list_t::state_ready;
@@ -153,6 +160,10 @@ uint32_t lba_list_t::get_ser_block_size(block_id_t block) {
     return get_block_info(block).ser_block_size;
 }
 
+uint32_t lba_list_t::get_ser_uncompressed_size(block_id_t block) {
+    return get_block_info(block).ser_uncompressed_size;
+}
+
 block_size_t lba_list_t::get_block_size(block_id_t block) {
     return block_size_t::unsafe_make(get_block_info(block).ser_block_size);
 }
@@ -174,10 +185,12 @@ segmented_vector_t<repli_timestamp_t> lba_list_t::get_block_recencies(block_id_t
 
 void lba_list_t::set_block_info(block_id_t block, repli_timestamp_t recency,
                                 flagged_off64_t offset, uint32_t ser_block_size,
+                                uint32_t ser_uncompressed_size,
                                 file_account_t *io_account, extent_transaction_t *txn) {
     rassert(state == state_ready || state == state_gc_shutting_down);
 
-    in_memory_index.set_block_info(block, recency, offset, ser_block_size);
+    in_memory_index.set_block_info(block, recency, offset, ser_block_size,
+                                   ser_uncompressed_size);
 
     // If the inline LBA is full, free it up first by moving its entries to
     // the LBA extents
@@ -186,7 +199,7 @@ void lba_list_t::set_block_info(block_id_t block, repli_timestamp_t recency,
         rassert(!check_inline_lba_full());
     }
     // Then store the entry inline
-    add_inline_entry(block, recency, offset, ser_block_size);
+    add_inline_entry(block, recency, offset, ser_block_size, ser_uncompressed_size);
 }
 
 bool lba_list_t::check_inline_lba_full() const {
@@ -224,6 +237,7 @@ void lba_list_t::move_inline_entries_to_extents(file_account_t *io_account, exte
                 e.recency,
                 e.offset,
                 e.ser_block_size,
+                e.ser_uncompressed_size,
                 io_account,
                 txn);
     }
@@ -232,11 +246,13 @@ void lba_list_t::move_inline_entries_to_extents(file_account_t *io_account, exte
 }
 
 void lba_list_t::add_inline_entry(block_id_t block, repli_timestamp_t recency,
-                                flagged_off64_t offset, uint32_t ser_block_size) {
+                                flagged_off64_t offset, uint32_t ser_block_size,
+                                uint32_t ser_uncompressed_size) {
     
     rassert(!check_inline_lba_full());
     inline_lba_entries[inline_lba_entries_count++] =
-            lba_entry_t::make(block, recency, offset, ser_block_size);
+            lba_entry_t::make(block, recency, offset, ser_block_size,
+                              ser_uncompressed_size);
 }
 
 class lba_syncer_t :
@@ -312,11 +328,14 @@ void lba_list_t::gc(int lba_shard, auto_drainer_t::lock_t) {
     for (block_id_t id = lba_shard; id < end_id; id += LBA_SHARD_FACTOR) {
         flagged_off64_t off = get_block_offset(id);
         if (off.has_value()) {
-            uint32_t ser_block_size = get_ser_block_size(id);
+            const index_block_info_t info = get_block_info(id);
             disk_structures[lba_shard]->add_entry(id,
-                                                  get_block_recency(id),
-                                                  off, ser_block_size,
+                                                  info.recency,
+                                                  off, info.ser_block_size,
+                                                  info.ser_uncompressed_size,
                                                   gc_io_account.get(), &txns.back());
+            extent_manager->stats->pm_serializer_lba_gc_bytes_written
+                += sizeof(lba_entry_t);
         }
 
         ++num_written_in_batch;
@@ -2,24 +2,36 @@
 #include "serializer/log/log_serializer.hpp"
 
 #include <fcntl.h>
+#include <math.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+
+#include <array>
 #include <functional>
+#include <set>
 
 #include "arch/io/disk.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
 #include "buffer_cache/types.hpp"
+#include "concurrency/cache_line_padded.hpp"
+#include "concurrency/pmap.hpp"
+#include "containers/uuid.hpp"
 #include "logger.hpp"
 #include "perfmon/perfmon.hpp"
+#include "serializer/log/block_compression.hpp"
 #include "serializer/log/data_block_manager.hpp"
+#include "serializer/log/split_file.hpp"
 
 filepath_file_opener_t::filepath_file_opener_t(const serializer_filepath_t &filepath,
                                                io_backender_t *backender)
     : filepath_(filepath),
       backender_(backender),
-      opened_temporary_(false) { }
+      opened_temporary_(false),
+      opened_index_temporary_(false),
+      opened_archive_temporary_(false) { }
 
 filepath_file_opener_t::~filepath_file_opener_t() { }
 
@@ -66,6 +78,36 @@ void filepath_file_opener_t::move_serializer_file_to_permanent_location() {
     mutex_assertion_t::acq_t acq(&reentrance_mutex_);
 
     guarantee(opened_temporary_);
+
+    // The index and archive files go first, so that a data file in the permanent
+    // location always has them.
+    if (opened_archive_temporary_) {
+        const int res = ::rename(filepath_.archive_temporary_path().c_str(),
+                                 archive_file_name().c_str());
+        if (res != 0) {
+            crash("Could not rename archive file %s to permanent location %s\n",
+                  filepath_.archive_temporary_path().c_str(),
+                  archive_file_name().c_str());
+        }
+
+        guarantee_fsync_parent_directory(archive_file_name().c_str());
+
+        opened_archive_temporary_ = false;
+    }
+
+    if (opened_index_temporary_) {
+        const int res = ::rename(filepath_.index_temporary_path().c_str(),
+                                 index_file_name().c_str());
+        if (res != 0) {
+            crash("Could not rename index file %s to permanent location %s\n",
+                  filepath_.index_temporary_path().c_str(), index_file_name().c_str());
+        }
+
+        guarantee_fsync_parent_directory(index_file_name().c_str());
+
+        opened_index_temporary_ = false;
+    }
+
     const int res = ::rename(temporary_file_name().c_str(), file_name().c_str());
 
     if (res != 0) {
@@ -91,6 +133,74 @@ void filepath_file_opener_t::unlink_serializer_file() {
     guarantee(opened_temporary_);
     const int res = ::unlink(current_file_name().c_str());
     guarantee_err(res == 0, "unlink() failed");
+
+    if (opened_index_temporary_) {
+        const int index_res = ::unlink(filepath_.index_temporary_path().c_str());
+        guarantee_err(index_res == 0, "unlink() failed");
+    }
+
+    if (opened_archive_temporary_) {
+        const int archive_res = ::unlink(filepath_.archive_temporary_path().c_str());
+        guarantee_err(archive_res == 0, "unlink() failed");
+    }
+}
+
+bool filepath_file_opener_t::has_index_file() const {
+    return filepath_.has_index_file();
+}
+
+std::string filepath_file_opener_t::index_file_name() const {
+    return filepath_.index_permanent_path();
+}
+
+void filepath_file_opener_t::open_index_file_create_temporary(scoped_ptr_t<file_t> *file_out) {
+    mutex_assertion_t::acq_t acq(&reentrance_mutex_);
+    guarantee(filepath_.has_index_file());
+    open_serializer_file(filepath_.index_temporary_path(),
+                         linux_file_t::mode_create | linux_file_t::mode_truncate, file_out);
+    opened_index_temporary_ = true;
+}
+
+void filepath_file_opener_t::open_index_file_existing(scoped_ptr_t<file_t> *file_out) {
+    mutex_assertion_t::acq_t acq(&reentrance_mutex_);
+    if (!filepath_.has_index_file()) {
+        fail_due_to_user_error("The database file \"%s\" keeps its index in a separate "
+                               "index file, but no index directory was given.",
+                               file_name().c_str());
+    }
+    open_serializer_file(opened_index_temporary_
+                         ? filepath_.index_temporary_path()
+                         : filepath_.index_permanent_path(),
+                         0, file_out);
+}
+
+bool filepath_file_opener_t::has_archive_file() const {
+    return filepath_.has_archive_file();
+}
+
+std::string filepath_file_opener_t::archive_file_name() const {
+    return filepath_.archive_permanent_path();
+}
+
+void filepath_file_opener_t::open_archive_file_create_temporary(scoped_ptr_t<file_t> *file_out) {
+    mutex_assertion_t::acq_t acq(&reentrance_mutex_);
+    guarantee(filepath_.has_archive_file());
+    open_serializer_file(filepath_.archive_temporary_path(),
+                         linux_file_t::mode_create | linux_file_t::mode_truncate, file_out);
+    opened_archive_temporary_ = true;
+}
+
+void filepath_file_opener_t::open_archive_file_existing(scoped_ptr_t<file_t> *file_out) {
+    mutex_assertion_t::acq_t acq(&reentrance_mutex_);
+    if (!filepath_.has_archive_file()) {
+        fail_due_to_user_error("The database file \"%s\" keeps old blocks in a separate "
+                               "archive file, but no archive directory was given.",
+                               file_name().c_str());
+    }
+    open_serializer_file(opened_archive_temporary_
+                         ? filepath_.archive_temporary_path()
+                         : filepath_.archive_permanent_path(),
+                         0, file_out);
 }
 
 #ifdef SEMANTIC_SERIALIZER_CHECK
@@ -117,42 +227,215 @@ log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
       pm_serializer_block_reads(secs_to_ticks(1)),
       pm_serializer_index_reads(),
       pm_serializer_block_writes(),
+      pm_serializer_compressed_block_writes(),
+      pm_serializer_compressed_bytes_saved(),
       pm_serializer_index_writes(secs_to_ticks(1)),
       pm_serializer_index_writes_size(secs_to_ticks(1), false),
+      pm_serializer_metablock_writes(secs_to_ticks(1)),
+      pm_serializer_metablock_writes_per_sec(secs_to_ticks(1)),
+      pm_serializer_metablock_batch_size(secs_to_ticks(1), false),
       pm_extents_in_use(),
       pm_bytes_in_use(),
+      pm_serializer_extents_discarded(),
       pm_serializer_lba_extents(),
       pm_serializer_data_extents(),
       pm_serializer_data_extents_allocated(),
       pm_serializer_data_extents_gced(),
+      pm_serializer_blocks_archived(),
+      pm_serializer_compaction_extents_moved(),
+      pm_serializer_compaction_extents_left(),
       pm_serializer_old_garbage_block_bytes(),
       pm_serializer_old_total_block_bytes(),
+      pm_serializer_block_checksum_retries(),
+      pm_serializer_block_checksum_failures(),
+      pm_serializer_user_bytes_written(),
+      pm_serializer_gc_bytes_written(),
+      pm_serializer_gc_bytes_reclaimed(),
+      pm_serializer_write_amplification(),
+      pm_serializer_extent_live_data(),
+      pm_serializer_gc_rate(),
+      pm_serializer_gc_debt(),
       pm_serializer_lba_gcs(),
+      pm_serializer_lba_gc_bytes_written(),
       parent_collection_membership(parent, &serializer_collection, "serializer"),
       stats_membership(&serializer_collection,
           &pm_serializer_block_reads, "serializer_block_reads",
           &pm_serializer_index_reads, "serializer_index_reads",
           &pm_serializer_block_writes, "serializer_block_writes",
+          &pm_serializer_compressed_block_writes, "serializer_compressed_block_writes",
+          &pm_serializer_compressed_bytes_saved, "serializer_compressed_bytes_saved",
           &pm_serializer_index_writes, "serializer_index_writes",
           &pm_serializer_index_writes_size, "serializer_index_writes_size",
+          &pm_serializer_metablock_writes, "serializer_metablock_writes",
+          &pm_serializer_metablock_writes_per_sec, "serializer_metablock_writes_per_sec",
+          &pm_serializer_metablock_batch_size, "serializer_metablock_batch_size",
           &pm_extents_in_use, "serializer_extents_in_use",
           &pm_bytes_in_use, "serializer_bytes_in_use",
+          &pm_serializer_extents_discarded, "serializer_extents_discarded",
           &pm_serializer_lba_extents, "serializer_lba_extents",
           &pm_serializer_data_extents, "serializer_data_extents",
           &pm_serializer_data_extents_allocated, "serializer_data_extents_allocated",
           &pm_serializer_data_extents_gced, "serializer_data_extents_gced",
+          &pm_serializer_blocks_archived, "serializer_blocks_archived",
+          &pm_serializer_compaction_extents_moved, "serializer_compaction_extents_moved",
+          &pm_serializer_compaction_extents_left, "serializer_compaction_extents_left",
           &pm_serializer_old_garbage_block_bytes, "serializer_old_garbage_block_bytes",
           &pm_serializer_old_total_block_bytes, "serializer_old_total_block_bytes",
-          &pm_serializer_lba_gcs, "serializer_lba_gcs")
+          &pm_serializer_block_checksum_retries, "serializer_block_checksum_retries",
+          &pm_serializer_block_checksum_failures, "serializer_block_checksum_failures",
+          &pm_serializer_user_bytes_written, "serializer_user_bytes_written",
+          &pm_serializer_gc_bytes_written, "serializer_gc_bytes_written",
+          &pm_serializer_gc_bytes_reclaimed, "serializer_gc_bytes_reclaimed",
+          &pm_serializer_write_amplification, "serializer_write_amplification",
+          &pm_serializer_extent_live_data, "serializer_extent_live_data",
+          &pm_serializer_gc_rate, "serializer_gc_rate",
+          &pm_serializer_gc_debt, "serializer_gc_debt",
+          &pm_serializer_lba_gcs, "serializer_lba_gcs",
+          &pm_serializer_lba_gc_bytes_written, "serializer_lba_gc_bytes_written")
 { }
 
+perfmon_write_amplification_t::perfmon_write_amplification_t() {
+    const ticks_t now = get_ticks();
+    for (int i = 0; i < MAX_THREADS; ++i) {
+        thread_data[i].as_of = now;
+    }
+}
+
+perfmon_write_amplification_t::thread_info_t *
+perfmon_write_amplification_t::decayed_thread_info(ticks_t now) {
+    rassert(get_thread_id().threadnum >= 0);
+    thread_info_t *thread = &thread_data[get_thread_id().threadnum];
+    if (now > thread->as_of) {
+        const double factor = exp2(-ticks_to_secs(now - thread->as_of)
+                                   / WRITE_AMPLIFICATION_HALF_LIFE_SECS);
+        for (size_t i = 0; i < thread->sums.size(); ++i) {
+            thread->sums[i] *= factor;
+        }
+        thread->as_of = now;
+    }
+    return thread;
+}
+
+void perfmon_write_amplification_t::record(int which, int64_t bytes) {
+    decayed_thread_info(get_ticks())->sums[which] += bytes;
+}
+
+void perfmon_write_amplification_t::get_thread_stat(sums_t *stat) {
+    *stat = decayed_thread_info(get_ticks())->sums;
+}
+
+perfmon_write_amplification_t::sums_t
+perfmon_write_amplification_t::combine_stats(const sums_t *stats) {
+    sums_t total;
+    total.fill(0);
+    for (int i = 0; i < get_num_threads(); ++i) {
+        for (size_t j = 0; j < total.size(); ++j) {
+            total[j] += stats[i][j];
+        }
+    }
+    return total;
+}
+
+scoped_ptr_t<perfmon_result_t>
+perfmon_write_amplification_t::output_stat(const sums_t &sums) {
+    scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
+    // Below a block's worth of writes, there's nothing to say.
+    result->insert("factor", new perfmon_result_t(
+        sums[USER_WRITTEN] >= 1
+        ? strprintf("%.3f", (sums[USER_WRITTEN] + sums[GC_WRITTEN]) / sums[USER_WRITTEN])
+        : std::string("-")));
+    result->insert("gc_bytes_reclaimed_per_byte_written", new perfmon_result_t(
+        sums[GC_WRITTEN] >= 1
+        ? strprintf("%.3f", sums[GC_RECLAIMED] / sums[GC_WRITTEN])
+        : std::string("-")));
+    return result;
+}
+
+void perfmon_live_data_histogram_t::set_data_block_manager(data_block_manager_t *_dbm,
+                                                            threadnum_t _dbm_thread) {
+    dbm = _dbm;
+    dbm_thread = _dbm_thread;
+}
+
+void perfmon_live_data_histogram_t::get_thread_stat(buckets_t *stat) {
+    stat->fill(0);
+    if (dbm != NULL && get_thread_id() == dbm_thread) {
+        dbm->get_live_data_histogram(stat);
+    }
+}
+
+perfmon_live_data_histogram_t::buckets_t
+perfmon_live_data_histogram_t::combine_stats(const buckets_t *stats) {
+    buckets_t total;
+    total.fill(0);
+    for (int i = 0; i < get_num_threads(); ++i) {
+        for (size_t j = 0; j < total.size(); ++j) {
+            total[j] += stats[i][j];
+        }
+    }
+    return total;
+}
+
+scoped_ptr_t<perfmon_result_t>
+perfmon_live_data_histogram_t::output_stat(const buckets_t &buckets) {
+    scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        result->insert(strprintf("%zu-%zu%%", i * 10, (i + 1) * 10),
+                       new perfmon_result_t(strprintf("%" PRIi64, buckets[i])));
+    }
+    return result;
+}
+
+// A random non-zero id that ties an index or archive file to its data file.
+static uint64_t generate_split_file_id() {
+    const uuid_u uuid = generate_uuid();
+    uint64_t id;
+    memcpy(&id, uuid.data(), sizeof(id));
+    return id == 0 ? 1 : id;
+}
+
 void log_serializer_t::create(serializer_file_opener_t *file_opener, static_config_t static_config) {
     log_serializer_on_disk_static_config_t *on_disk_config = &static_config;
 
     scoped_ptr_t<file_t> file;
     file_opener->open_serializer_file_create_temporary(&file);
 
-    co_static_header_write(file.get(), on_disk_config, sizeof(*on_disk_config));
+    scoped_ptr_t<file_t> index_file;
+    static_config.index_file_id_ = 0;
+    if (file_opener->has_index_file()) {
+        static_config.index_file_id_ = generate_split_file_id();
+        file_opener->open_index_file_create_temporary(&index_file);
+    }
+    scoped_ptr_t<file_t> archive_file;
+    static_config.archive_file_id_ = 0;
+    if (file_opener->has_archive_file()) {
+        static_config.archive_file_id_ = generate_split_file_id();
+        file_opener->open_archive_file_create_temporary(&archive_file);
+    }
+
+    const int64_t metablock_base_offset = index_file.has() ? INDEX_FILE_OFFSET : 0;
+    if (index_file.has() || archive_file.has()) {
+        // Every file gets the same static header, which is how we tell that they
+        // belong together.
+        if (index_file.has()) {
+            co_static_header_write(index_file.get(), on_disk_config,
+                                   sizeof(*on_disk_config),
+                                   SERIALIZER_SPLIT_VERSION_STRING);
+        }
+        if (archive_file.has()) {
+            co_static_header_write(archive_file.get(), on_disk_config,
+                                   sizeof(*on_disk_config),
+                                   SERIALIZER_SPLIT_VERSION_STRING);
+        }
+        co_static_header_write(file.get(), on_disk_config, sizeof(*on_disk_config),
+                               SERIALIZER_SPLIT_VERSION_STRING);
+
+        scoped_ptr_t<file_t> data_file(file.release());
+        file.init(new split_file_t(std::move(data_file), std::move(index_file),
+                                   std::move(archive_file)));
+    } else {
+        co_static_header_write(file.get(), on_disk_config, sizeof(*on_disk_config));
+    }
 
     metablock_t metablock;
     bzero(&metablock, sizeof(metablock));
@@ -162,7 +445,8 @@ void log_serializer_t::create(serializer_file_opener_t *file_opener, static_conf
     data_block_manager_t::prepare_initial_metablock(&metablock.data_block_manager_part);
     lba_list_t::prepare_initial_metablock(&metablock.lba_index_part);
 
-    mb_manager_t::create(file.get(), static_config.extent_size(), &metablock);
+    mb_manager_t::create(file.get(), static_config.extent_size(), metablock_base_offset,
+                         &metablock);
 }
 
 /* The process of starting up the serializer is handled by the ls_start_*_fsm_t. This is not
@@ -177,17 +461,19 @@ struct ls_start_existing_fsm_t :
     public thread_message_t
 {
     explicit ls_start_existing_fsm_t(log_serializer_t *serializer)
-        : ser(serializer), start_existing_state(state_start) {
+        : ser(serializer), file_opener(NULL), index_file(NULL), archive_file(NULL),
+          start_existing_state(state_start) {
     }
 
     ~ls_start_existing_fsm_t() {
     }
 
-    bool run(cond_t *to_signal, serializer_file_opener_t *file_opener) {
+    bool run(cond_t *to_signal, serializer_file_opener_t *_file_opener) {
         // STATE A
         rassert(start_existing_state == state_start);
         rassert(ser->state == log_serializer_t::state_unstarted);
         ser->state = log_serializer_t::state_starting_up;
+        file_opener = _file_opener;
 
         scoped_ptr_t<file_t> dbfile;
         file_opener->open_serializer_file_existing(&dbfile);
@@ -225,14 +511,33 @@ struct ls_start_existing_fsm_t :
 
         if (start_existing_state == state_find_metablock) {
             // STATE D
-            ser->extent_manager = new extent_manager_t(ser->dbfile, &ser->static_config,
+            file_t *data_file = ser->dbfile;
+            if (ser->static_config.has_index_file()
+                || ser->static_config.has_archive_file()) {
+                open_split_files();
+            }
+
+            ser->extent_manager = new extent_manager_t(data_file, index_file,
+                                                       archive_file,
+                                                       &ser->static_config,
+                                                       &ser->dynamic_config,
                                                        ser->stats.get());
             {
-                // We never end up releasing the static header extent reference.  Nobody says we
-                // have to.
+                // We never end up releasing the static header extent references.  Nobody
+                // says we have to.
                 extent_reference_t extent_ref
                     = ser->extent_manager->reserve_extent(0);  // For static header.
                 UNUSED int64_t extent = extent_ref.release();
+                if (index_file != NULL) {
+                    extent_reference_t index_extent_ref
+                        = ser->extent_manager->reserve_extent(INDEX_FILE_OFFSET);
+                    UNUSED int64_t index_extent = index_extent_ref.release();
+                }
+                if (archive_file != NULL) {
+                    extent_reference_t archive_extent_ref
+                        = ser->extent_manager->reserve_extent(ARCHIVE_FILE_OFFSET);
+                    UNUSED int64_t archive_extent = archive_extent_ref.release();
+                }
             }
 
             ser->metablock_manager = new mb_manager_t(ser->extent_manager);
@@ -282,6 +587,8 @@ struct ls_start_existing_fsm_t :
                 if (offset.has_value()) {
                     ser->data_block_manager->mark_live(offset.get_value(),
                         ser->lba_index->get_block_size(num_blocks_reconstructed));
+                    ser->data_block_manager->note_recency(
+                        ser->lba_index->get_block_recency(num_blocks_reconstructed));
                 }
                 ++batch;
                 if (batch >= LBA_RECONSTRUCTION_BATCH_SIZE) {
@@ -311,6 +618,42 @@ struct ls_start_existing_fsm_t :
         unreachable("Invalid state %d.", start_existing_state);
     }
 
+    // Opens the index file and the archive file (whichever the data file has),
+    // checks that they belong to the data file, and makes ser->dbfile a
+    // split_file_t of them.  This blocks.
+    void open_split_files() {
+        scoped_ptr_t<file_t> index;
+        if (ser->static_config.has_index_file()) {
+            file_opener->open_index_file_existing(&index);
+            check_belongs_to_data_file(index.get(), "index",
+                                       file_opener->index_file_name());
+        }
+        scoped_ptr_t<file_t> archive;
+        if (ser->static_config.has_archive_file()) {
+            file_opener->open_archive_file_existing(&archive);
+            check_belongs_to_data_file(archive.get(), "archive",
+                                       file_opener->archive_file_name());
+        }
+
+        index_file = index.get();
+        archive_file = archive.get();
+        scoped_ptr_t<file_t> data_file(ser->dbfile);
+        ser->dbfile = new split_file_t(std::move(data_file), std::move(index),
+                                       std::move(archive));
+    }
+
+    void check_belongs_to_data_file(file_t *file, const char *kind,
+                                    const std::string &file_name) {
+        log_serializer_on_disk_static_config_t config;
+        co_static_header_read(file, &config, sizeof(config));
+        const log_serializer_on_disk_static_config_t *data_config = &ser->static_config;
+        if (memcmp(&config, data_config, sizeof(config)) != 0) {
+            fail_due_to_user_error("The %s file \"%s\" doesn't belong to the database "
+                                   "file \"%s\".", kind, file_name.c_str(),
+                                   file_opener->file_name().c_str());
+        }
+    }
+
     void on_static_header_read() {
         rassert(start_existing_state == state_waiting_for_static_header);
         // STATE C
@@ -340,6 +683,10 @@ struct ls_start_existing_fsm_t :
     }
 
     log_serializer_t *ser;
+    serializer_file_opener_t *file_opener;
+    // Owned by ser->dbfile, NULL if there's no index file or archive file.
+    file_t *index_file;
+    file_t *archive_file;
     cond_t *to_signal_when_done;
 
     enum state_t {
@@ -367,6 +714,15 @@ private:
     DISABLE_COPYING(ls_start_existing_fsm_t);
 };
 
+// The log serializers on each thread, for start_compaction_everywhere().  Each
+// thread only touches its own set.
+static std::array<cache_line_padded_t<std::set<log_serializer_t *> >, MAX_THREADS> &
+log_serializers_by_thread() {
+    static std::array<cache_line_padded_t<std::set<log_serializer_t *> >, MAX_THREADS>
+        serializers;
+    return serializers;
+}
+
 log_serializer_t::log_serializer_t(dynamic_config_t _dynamic_config, serializer_file_opener_t *file_opener, perfmon_collection_t *_perfmon_collection)
     : stats(new log_serializer_stats_t(_perfmon_collection)),  // can block in a perfmon_collection_t::add call.
       disk_stats_collection(),
@@ -382,16 +738,20 @@ log_serializer_t::log_serializer_t(dynamic_config_t _dynamic_config, serializer_
       metablock_manager(NULL),
       lba_index(NULL),
       data_block_manager(NULL),
+      metablock_writer_active(false),
       active_write_count(0) {
     // STATE A
     /* This is because the serializer is not completely converted to coroutines yet. */
     ls_start_existing_fsm_t *s = new ls_start_existing_fsm_t(this);
     cond_t cond;
     if (!s->run(&cond, file_opener)) cond.wait();
+
+    log_serializers_by_thread()[get_thread_id().threadnum].value.insert(this);
 }
 
 log_serializer_t::~log_serializer_t() {
     assert_thread();
+    log_serializers_by_thread()[get_thread_id().threadnum].value.erase(this);
     cond_t cond;
     if (!shutdown(&cond)) cond.wait();
 
@@ -400,10 +760,11 @@ log_serializer_t::~log_serializer_t() {
     rassert(active_write_count == 0);
 }
 
-file_account_t *log_serializer_t::make_io_account(int priority, int outstanding_requests_limit) {
+file_account_t *log_serializer_t::make_io_account(int priority, int outstanding_requests_limit,
+                                                  int deadline_ms) {
     assert_thread();
     rassert(dbfile);
-    return new file_account_t(dbfile, priority, outstanding_requests_limit);
+    return new file_account_t(dbfile, priority, outstanding_requests_limit, deadline_ms);
 }
 
 void log_serializer_t::block_read(const counted_t<ls_block_token_pointee_t> &token,
@@ -415,10 +776,35 @@ void log_serializer_t::block_read(const counted_t<ls_block_token_pointee_t> &tok
     ticks_t pm_time;
     stats->pm_serializer_block_reads.begin(&pm_time);
 
-    data_block_manager->read(token->offset_, token->block_size().ser_value(),
-                             buf, io_account);
+    bool checksum_ok;
+    if (token->is_compressed()) {
+        scoped_malloc_t<ser_buffer_t> compressed_buf
+            = serializer_t::allocate_buffer(token->disk_block_size());
+        checksum_ok = data_block_manager->read(token->offset_,
+                                               token->disk_block_size().ser_value(),
+                                               compressed_buf.get(), io_account);
+        if (checksum_ok) {
+            decompress_block(compressed_buf.get(), token->disk_block_size(),
+                             buf, token->block_size());
+        }
+    } else {
+        checksum_ok = data_block_manager->read(token->offset_,
+                                               token->block_size().ser_value(),
+                                               buf, io_account);
+    }
 
     stats->pm_serializer_block_reads.end(&pm_time);
+
+    if (!checksum_ok) {
+        report_corrupted_block(token->offset_);
+    }
+}
+
+void log_serializer_t::report_corrupted_block(int64_t offset) {
+    ++stats->pm_serializer_block_checksum_failures;
+    block_checksum_exc_t exc(offset);
+    logERR("%s", exc.what());
+    throw exc;
 }
 
 // God this is such a hack.
@@ -460,6 +846,8 @@ void log_serializer_t::index_write(const std::vector<index_write_op_t> &write_op
             const index_write_op_t& op = *write_op_it;
             flagged_off64_t offset = lba_index->get_block_offset(op.block_id);
             uint32_t ser_block_size = lba_index->get_ser_block_size(op.block_id);
+            uint32_t ser_uncompressed_size
+                = lba_index->get_ser_uncompressed_size(op.block_id);
 
             if (op.token) {
                 // Update the offset pointed to, and mark garbage/liveness as necessary.
@@ -474,21 +862,27 @@ void log_serializer_t::index_write(const std::vector<index_write_op_t> &write_op
                 // Write new token to index, or remove from index as appropriate.
                 if (token.has()) {
                     offset = flagged_off64_t::make(token->offset_);
-                    ser_block_size = token->block_size().ser_value();
+                    ser_block_size = token->disk_block_size().ser_value();
+                    ser_uncompressed_size = token->is_compressed()
+                        ? token->block_size().ser_value() : 0;
 
                     /* mark the life */
-                    data_block_manager->mark_live(offset.get_value(), token->block_size());
+                    data_block_manager->mark_live(offset.get_value(),
+                                                  token->disk_block_size());
                 } else {
                     offset = flagged_off64_t::unused();
                     ser_block_size = 0;
+                    ser_uncompressed_size = 0;
                 }
             }
 
             repli_timestamp_t recency = op.recency ? op.recency.get()
                 : lba_index->get_block_recency(op.block_id);
+            data_block_manager->note_recency(recency);
 
             lba_index->set_block_info(op.block_id, recency,
                                       offset, ser_block_size,
+                                      ser_uncompressed_size,
                                       io_account, &txn);
         }
     }
@@ -542,59 +936,187 @@ void log_serializer_t::index_write_finish(extent_transaction_t *txn, file_accoun
     }
 }
 
+struct log_serializer_t::metablock_waiter_t {
+    metablock_t metablock;
+    const signal_t *safe_to_write_cond;
+    // Pulsed once our metablock (or a newer one) has been written, or once it's our
+    // turn to write a metablock.
+    cond_t wakeup;
+    bool written;
+};
+
 void log_serializer_t::write_metablock(const signal_t &safe_to_write_cond,
                                        file_account_t *io_account) {
     assert_thread();
-    metablock_t mb_buffer;
+    metablock_waiter_t waiter;
+    waiter.safe_to_write_cond = &safe_to_write_cond;
+    waiter.written = false;
 
     /* Prepare metablock now instead of in when we write it so that we will have the correct
     metablock information for this write even if another write starts before we finish
     waiting on `safe_to_write_cond`. */
-    prepare_metablock(&mb_buffer);
+    prepare_metablock(&waiter.metablock);
 
     /* Get in line for the metablock manager */
-    bool waiting_for_prev_write = !metablock_waiter_queue.empty();
-    cond_t on_prev_write_submitted_metablock;
-    metablock_waiter_queue.push_back(&on_prev_write_submitted_metablock);
+    metablock_waiter_queue.push_back(&waiter);
+    if (metablock_writer_active) {
+        waiter.wakeup.wait();
+        if (waiter.written) {
+            return;
+        }
+    } else {
+        metablock_writer_active = true;
+    }
+    guarantee(metablock_waiter_queue.front() == &waiter);
+
+    /* Give more transactions a chance to join this metablock write. */
+    if (dynamic_config.group_commit_window_ms > 0) {
+        nap(dynamic_config.group_commit_window_ms);
+    }
 
     safe_to_write_cond.wait();
-    if (waiting_for_prev_write) on_prev_write_submitted_metablock.wait();
-    guarantee(metablock_waiter_queue.front() == &on_prev_write_submitted_metablock);
 
+    /* Every transaction after us in line whose data is on disk too can share our
+    write; the metablock of the last of them covers the others. */
+    std::list<metablock_waiter_t *>::iterator last = metablock_waiter_queue.begin();
+    int64_t batch_size = 1;
+    for (std::list<metablock_waiter_t *>::iterator it = ++metablock_waiter_queue.begin();
+         it != metablock_waiter_queue.end() && (*it)->safe_to_write_cond->is_pulsed();
+         ++it) {
+        last = it;
+        ++batch_size;
+    }
+    stats->pm_serializer_metablock_batch_size.record(batch_size);
+
+    ticks_t pm_time;
+    stats->pm_serializer_metablock_writes.begin(&pm_time);
+    stats->pm_serializer_metablock_writes_per_sec.record();
     struct : public cond_t, public mb_manager_t::metablock_write_callback_t {
         void on_metablock_write() { pulse(); }
     } on_metablock_write;
     const bool done_with_metablock =
-        metablock_manager->write_metablock(&mb_buffer, io_account, &on_metablock_write);
+        metablock_manager->write_metablock(&(*last)->metablock, io_account,
+                                           &on_metablock_write);
+    if (!done_with_metablock) on_metablock_write.wait();
+    stats->pm_serializer_metablock_writes.end(&pm_time);
 
-    /* Remove ourselves from the list of metablock waiters. */
+    /* Remove the batch from the list of metablock waiters, and wake up the other
+    transactions in it. */
     metablock_waiter_queue.pop_front();
-
-    /* If there was another transaction waiting for us to write our metablock so it could
-    write its metablock, notify it now so it can write its metablock. */
-    if (!metablock_waiter_queue.empty()) {
-        metablock_waiter_queue.front()->pulse();
+    for (int64_t i = 1; i < batch_size; ++i) {
+        metablock_waiter_t *other = metablock_waiter_queue.front();
+        metablock_waiter_queue.pop_front();
+        other->written = true;
+        other->wakeup.pulse();
     }
 
-    if (!done_with_metablock) on_metablock_write.wait();
+    /* If there are transactions that weren't ready in time, the first of them writes
+    the next metablock. */
+    if (metablock_waiter_queue.empty()) {
+        metablock_writer_active = false;
+    } else {
+        metablock_waiter_queue.front()->wakeup.pulse();
+    }
 }
 
 counted_t<ls_block_token_pointee_t>
 log_serializer_t::generate_block_token(int64_t offset, block_size_t block_size) {
+    return generate_block_token(offset, block_size, block_size);
+}
+
+counted_t<ls_block_token_pointee_t>
+log_serializer_t::generate_block_token(int64_t offset, block_size_t block_size,
+                                       block_size_t disk_block_size) {
     assert_thread();
-    counted_t<ls_block_token_pointee_t> ret(new ls_block_token_pointee_t(this, offset, block_size));
+    counted_t<ls_block_token_pointee_t> ret(new ls_block_token_pointee_t(this, offset,
+                                                                         block_size,
+                                                                         disk_block_size));
     return ret;
 }
 
+counted_t<ls_block_token_pointee_t>
+log_serializer_t::generate_block_token(int64_t offset, const index_block_info_t &info) {
+    const block_size_t disk_block_size = block_size_t::unsafe_make(info.ser_block_size);
+    return generate_block_token(offset,
+                                info.ser_uncompressed_size != 0
+                                ? block_size_t::unsafe_make(info.ser_uncompressed_size)
+                                : disk_block_size,
+                                disk_block_size);
+}
+
+void log_serializer_t::set_uncompressed_block_size(
+        const counted_t<ls_block_token_pointee_t> &token, block_size_t block_size) {
+    assert_thread();
+    rassert(!token->is_compressed());
+    rassert(token->disk_block_size().ser_value() < block_size.ser_value());
+    token->block_size_ = block_size;
+}
+
+// Holds on to the compressed versions of the blocks of a block_writes call until
+// they have been written.
+class compressed_block_writes_t : public iocallback_t {
+public:
+    explicit compressed_block_writes_t(iocallback_t *_cb) : cb(_cb) { }
+
+    void on_io_complete() {
+        iocallback_t *local_cb = cb;
+        delete this;
+        local_cb->on_io_complete();
+    }
+
+    std::vector<scoped_malloc_t<ser_buffer_t> > compressed_bufs;
+
+private:
+    iocallback_t *const cb;
+
+    DISABLE_COPYING(compressed_block_writes_t);
+};
+
 std::vector<counted_t<ls_block_token_pointee_t> >
 log_serializer_t::block_writes(const std::vector<buf_write_info_t> &write_infos,
                                file_account_t *io_account, iocallback_t *cb) {
     assert_thread();
     stats->pm_serializer_block_writes += write_infos.size();
 
+    if (!dynamic_config.compress_blocks) {
+        std::vector<counted_t<ls_block_token_pointee_t> > result
+            = data_block_manager->many_writes(write_infos, io_account, cb);
+        guarantee(result.size() == write_infos.size());
+        return result;
+    }
+
+    compressed_block_writes_t *compressed_writes = new compressed_block_writes_t(cb);
+    std::vector<buf_write_info_t> disk_write_infos;
+    disk_write_infos.reserve(write_infos.size());
+    std::vector<bool> is_compressed(write_infos.size(), false);
+    for (size_t i = 0; i < write_infos.size(); ++i) {
+        block_size_t compressed_size = block_size_t::undefined();
+        scoped_malloc_t<ser_buffer_t> compressed_buf
+            = compress_block(write_infos[i].buf, write_infos[i].block_size,
+                             &compressed_size);
+        if (compressed_buf.has()) {
+            disk_write_infos.push_back(buf_write_info_t(compressed_buf.get(),
+                                                        compressed_size,
+                                                        write_infos[i].block_id));
+            compressed_writes->compressed_bufs.push_back(std::move(compressed_buf));
+            is_compressed[i] = true;
+            stats->pm_serializer_compressed_block_writes += 1;
+            stats->pm_serializer_compressed_bytes_saved
+                += write_infos[i].block_size.ser_value() - compressed_size.ser_value();
+        } else {
+            disk_write_infos.push_back(write_infos[i]);
+        }
+    }
+
     std::vector<counted_t<ls_block_token_pointee_t> > result
-        = data_block_manager->many_writes(write_infos, io_account, cb);
+        = data_block_manager->many_writes(disk_write_infos, io_account,
+                                          compressed_writes);
     guarantee(result.size() == write_infos.size());
+    for (size_t i = 0; i < result.size(); ++i) {
+        if (is_compressed[i]) {
+            set_uncompressed_block_size(result[i], write_infos[i].block_size);
+        }
+    }
     return result;
 }
 
@@ -715,7 +1237,7 @@ counted_t<ls_block_token_pointee_t> log_serializer_t::index_read(block_id_t bloc
 
     index_block_info_t info = lba_index->get_block_info(block_id);
     if (info.offset.has_value()) {
-        return generate_block_token(info.offset.get_value(), block_size_t::unsafe_make(info.ser_block_size));
+        return generate_block_token(info.offset.get_value(), info);
     } else {
         return counted_t<ls_block_token_pointee_t>();
     }
@@ -753,6 +1275,9 @@ bool log_serializer_t::shutdown(cond_t *cb) {
     // to most of the remaining shutdown process which is still FSM-based.
     lba_index->shutdown_gc();
 
+    // This also blocks; it waits for the extent discard in progress, if there is one.
+    extent_manager->stop_discarding();
+
     return next_shutdown_step();
 }
 
@@ -842,6 +1367,27 @@ void log_serializer_t::prepare_metablock(metablock_t *mb_buffer) {
 }
 
 
+void log_serializer_t::start_compaction() {
+    assert_thread();
+    if (state == state_ready) {
+        data_block_manager->start_compaction();
+    }
+}
+
+void log_serializer_t::start_compaction_everywhere() {
+    pmap(get_num_threads(), &log_serializer_t::start_compaction_on_thread);
+}
+
+void log_serializer_t::start_compaction_on_thread(int thread) {
+    on_thread_t th((threadnum_t(thread)));
+    ASSERT_NO_CORO_WAITING;
+    const std::set<log_serializer_t *> &serializers
+        = log_serializers_by_thread()[thread].value;
+    for (auto it = serializers.begin(); it != serializers.end(); ++it) {
+        (*it)->start_compaction();
+    }
+}
+
 void log_serializer_t::consider_start_gc() {
     assert_thread();
     if (data_block_manager->do_we_want_to_start_gcing() && state == log_serializer_t::state_ready) {
@@ -895,9 +1441,11 @@ bool log_serializer_t::should_perform_read_ahead() {
 
 ls_block_token_pointee_t::ls_block_token_pointee_t(log_serializer_t *serializer,
                                                    int64_t initial_offset,
-                                                   block_size_t initial_block_size)
+                                                   block_size_t initial_block_size,
+                                                   block_size_t initial_disk_block_size)
     : serializer_(serializer), ref_count_(0),
-      block_size_(initial_block_size), offset_(initial_offset) {
+      block_size_(initial_block_size), disk_block_size_(initial_disk_block_size),
+      offset_(initial_offset) {
     serializer_->assert_thread();
     serializer_->register_block_token(this, initial_offset);
 }
@@ -72,6 +72,16 @@ public:
     void open_semantic_checking_file(scoped_ptr_t<semantic_checking_file_t> *file_out);
 #endif
 
+    bool has_index_file() const;
+    std::string index_file_name() const;
+    void open_index_file_create_temporary(scoped_ptr_t<file_t> *file_out);
+    void open_index_file_existing(scoped_ptr_t<file_t> *file_out);
+
+    bool has_archive_file() const;
+    std::string archive_file_name() const;
+    void open_archive_file_create_temporary(scoped_ptr_t<file_t> *file_out);
+    void open_archive_file_existing(scoped_ptr_t<file_t> *file_out);
+
 private:
     void open_serializer_file(const std::string &path, int extra_flags, scoped_ptr_t<file_t> *file_out);
 
@@ -96,6 +106,10 @@ private:
     // open_serializer_file_existing to know whether it should use the temporary or permanent path.
     bool opened_temporary_;
 
+    // The same, for the index file and the archive file.
+    bool opened_index_temporary_;
+    bool opened_archive_temporary_;
+
     DISABLE_COPYING(filepath_file_opener_t);
 };
 
@@ -136,7 +150,8 @@ public:
 #ifndef SEMANTIC_SERIALIZER_CHECK
     using serializer_t::make_io_account;
 #endif
-    file_account_t *make_io_account(int priority, int outstanding_requests_limit);
+    file_account_t *make_io_account(int priority, int outstanding_requests_limit,
+                                    int deadline_ms);
 
     void register_read_ahead_cb(serializer_read_ahead_callback_t *cb);
     void unregister_read_ahead_cb(serializer_read_ahead_callback_t *cb);
@@ -158,13 +173,33 @@ public:
 
     bool coop_lock_and_check();
 
+    /* Starts compacting the data file in the background, so that it shrinks after
+    lots of blocks have been deleted (see data_block_manager_t::start_compaction()).
+    The serializer's "serializer_compaction_extents_left" stat counts down to zero
+    as it goes. */
+    void start_compaction();
+
+    /* Calls start_compaction() for every log serializer on this server. */
+    static void start_compaction_everywhere();
+
 private:
+    static void start_compaction_on_thread(int thread);
+
     void register_block_token(ls_block_token_pointee_t *token, int64_t offset);
     bool tokens_exist_for_offset(int64_t off);
     void unregister_block_token(ls_block_token_pointee_t *token);
     void remap_block_to_new_offset(int64_t current_offset, int64_t new_offset);
     counted_t<ls_block_token_pointee_t> generate_block_token(int64_t offset,
                                                              block_size_t block_size);
+    counted_t<ls_block_token_pointee_t> generate_block_token(
+            int64_t offset, block_size_t block_size, block_size_t disk_block_size);
+    /* Returns a token for the block described by an lba entry. */
+    counted_t<ls_block_token_pointee_t> generate_block_token(
+            int64_t offset, const index_block_info_t &info);
+    /* Tells a token that was just created for the compressed version of a block
+    how big the block is once it's decompressed. */
+    void set_uncompressed_block_size(const counted_t<ls_block_token_pointee_t> &token,
+                                     block_size_t block_size);
 
     void offer_buf_to_read_ahead_callbacks(
             block_id_t block_id,
@@ -172,6 +207,9 @@ private:
             const counted_t<standard_block_token_t>& token);
     bool should_perform_read_ahead();
 
+    /* Counts and logs the corrupted block, and throws a block_checksum_exc_t. */
+    NORETURN void report_corrupted_block(int64_t offset);
+
     /* Starts a new transaction, updates perfmons etc. */
     void index_write_prepare(extent_transaction_t *txn);
     /* Finishes a write transaction */
@@ -186,7 +224,11 @@ private:
     /* Prepare a new metablock, then wait until safe_to_write_cond is pulsed.
     Finally write the new metablock to disk. Returns once the write is complete.
     This function writes the metablock in the state that it has when called, i.e.
-    it does not block between calling and preparing the new metablock. */
+    it does not block between calling and preparing the new metablock.
+
+    Concurrent calls share metablock writes (a group commit): while one metablock is
+    being written, the next ones queue up, and then only the newest of them whose
+    safe_to_write_cond is pulsed gets written, since it supersedes the older ones. */
     void write_metablock(const signal_t &safe_to_write_cond, file_account_t *io_account);
 
     typedef log_serializer_metablock_t metablock_t;
@@ -238,7 +280,10 @@ private:
     /* The running index writes organize themselves into a list so that they can be sure to
     write their metablocks in the correct order. The first element in the list
     is the oldest transaction that started but did not finish. */
-    std::list<cond_t *> metablock_waiter_queue;
+    struct metablock_waiter_t;
+    std::list<metablock_waiter_t *> metablock_waiter_queue;
+    // Whether one of the waiters is writing a metablock for the front of the queue.
+    bool metablock_writer_active;
 
     int active_write_count;
 
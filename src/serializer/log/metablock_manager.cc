@@ -14,7 +14,7 @@
 
 #include "serializer/log/log_serializer.hpp"
 
-std::vector<int64_t> initial_metablock_offsets(int64_t extent_size) {
+std::vector<int64_t> initial_metablock_offsets(int64_t extent_size, int64_t base_offset) {
     std::vector<int64_t> offsets;
 
     const int64_t metablocks_per_extent = std::min<int64_t>(extent_size / METABLOCK_SIZE, MB_BLOCKS_PER_EXTENT);
@@ -22,7 +22,7 @@ std::vector<int64_t> initial_metablock_offsets(int64_t extent_size) {
     // The very first DEVICE_BLOCK_SIZE of the file is used for the
     // static header, so we start j at 1.
     for (int64_t j = 1; j < metablocks_per_extent; ++j) {
-        int64_t offset = j * METABLOCK_SIZE;
+        int64_t offset = base_offset + j * METABLOCK_SIZE;
 
         offsets.push_back(offset);
     }
@@ -68,7 +68,9 @@ void metablock_manager_t<metablock_t>::metablock_manager_t::head_t::pop() {
 template<class metablock_t>
 metablock_manager_t<metablock_t>::metablock_manager_t(extent_manager_t *em)
     : head(this), mb_buffer(static_cast<crc_metablock_t *>(malloc_aligned(METABLOCK_SIZE, DEVICE_BLOCK_SIZE))),
-      extent_manager(em), metablock_offsets(initial_metablock_offsets(extent_manager->extent_size)),
+      extent_manager(em),
+      metablock_offsets(initial_metablock_offsets(extent_manager->extent_size,
+                                                  extent_manager->index_extents_offset())),
       state(state_unstarted), dbfile(NULL) {
     rassert(sizeof(crc_metablock_t) <= METABLOCK_SIZE);
     rassert(mb_buffer);
@@ -77,8 +79,8 @@ metablock_manager_t<metablock_t>::metablock_manager_t(extent_manager_t *em)
     /* Build the list of metablock locations in the file */
 
     // We don't try to reserve any metablock extents because the only
-    // extent we use is extent 0.  Extent 0 is already reserved by the
-    // static header, so we don't need to reserve it.
+    // extent we use is extent 0 (of the index file, if there is one).  Extent 0
+    // is already reserved by the static header, so we don't need to reserve it.
 }
 
 template<class metablock_t>
@@ -91,9 +93,10 @@ metablock_manager_t<metablock_t>::~metablock_manager_t() {
 }
 
 template<class metablock_t>
-void metablock_manager_t<metablock_t>::create(file_t *dbfile, int64_t extent_size, metablock_t *initial) {
+void metablock_manager_t<metablock_t>::create(file_t *dbfile, int64_t extent_size,
+                                              int64_t base_offset, metablock_t *initial) {
 
-    std::vector<int64_t> metablock_offsets = initial_metablock_offsets(extent_size);
+    std::vector<int64_t> metablock_offsets = initial_metablock_offsets(extent_size, base_offset);
 
     dbfile->set_size_at_least(metablock_offsets[metablock_offsets.size() - 1] + METABLOCK_SIZE);
 
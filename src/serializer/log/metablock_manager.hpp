@@ -38,7 +38,9 @@ static const char MB_MARKER_MAGIC[8] = {'m', 'e', 't', 'a', 'b', 'l', 'c', 'k'};
 static const char MB_MARKER_CRC[4] = {'c', 'r', 'c', ':'};
 static const char MB_MARKER_VERSION[8] = {'v', 'e', 'r', 's', 'i', 'o', 'n', ':'};
 
-std::vector<int64_t> initial_metablock_offsets(int64_t extent_size);
+// The metablocks live in the first extent after base_offset (which is 0, or
+// INDEX_FILE_OFFSET if there's an index file), after the static header.
+std::vector<int64_t> initial_metablock_offsets(int64_t extent_size, int64_t base_offset);
 
 
 
@@ -80,7 +82,8 @@ public:
     ~metablock_manager_t();
 
     /* Clear metablock slots and write an initial metablock to the database file */
-    static void create(file_t *dbfile, int64_t extent_size, metablock_t *initial);
+    static void create(file_t *dbfile, int64_t extent_size, int64_t base_offset,
+                       metablock_t *initial);
 
     /* Tries to load existing metablocks */
     void co_start_existing(file_t *dbfile, bool *mb_found, metablock_t *mb_out);
@@ -0,0 +1,133 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "serializer/log/split_file.hpp"
+
+#include <sys/uio.h>
+
+struct split_file_t::account_t {
+    account_t(split_file_t *parent, int priority, int outstanding_requests_limit,
+              int deadline_ms)
+        : data_account(parent->data_file(), priority, outstanding_requests_limit,
+                       deadline_ms) {
+        if (parent->index_file() != NULL) {
+            index_account.init(new file_account_t(parent->index_file(), priority,
+                                                  outstanding_requests_limit,
+                                                  deadline_ms));
+        }
+        if (parent->archive_file() != NULL) {
+            archive_account.init(new file_account_t(parent->archive_file(), priority,
+                                                    outstanding_requests_limit,
+                                                    deadline_ms));
+        }
+    }
+
+    file_account_t data_account;
+    scoped_ptr_t<file_account_t> index_account;
+    scoped_ptr_t<file_account_t> archive_account;
+};
+
+split_file_t::split_file_t(scoped_ptr_t<file_t> &&data_file,
+                           scoped_ptr_t<file_t> &&index_file,
+                           scoped_ptr_t<file_t> &&archive_file)
+    : data_file_(std::move(data_file)), index_file_(std::move(index_file)),
+      archive_file_(std::move(archive_file)) {
+    guarantee(data_file_.has());
+    guarantee(index_file_.has() || archive_file_.has());
+}
+
+split_file_t::~split_file_t() { }
+
+file_t *split_file_t::route(int64_t offset, int64_t length, int64_t *offset_out) {
+    if (offset >= INDEX_FILE_OFFSET) {
+        guarantee(index_file_.has(), "An index file offset, but there's no index file.");
+        *offset_out = offset - INDEX_FILE_OFFSET;
+        return index_file_.get();
+    } else if (offset >= ARCHIVE_FILE_OFFSET) {
+        guarantee(archive_file_.has(),
+                  "An archive file offset, but there's no archive file.");
+        guarantee(offset + length <= INDEX_FILE_OFFSET,
+                  "An operation straddles the archive file and the index file.");
+        *offset_out = offset - ARCHIVE_FILE_OFFSET;
+        return archive_file_.get();
+    } else {
+        guarantee(offset + length <= ARCHIVE_FILE_OFFSET,
+                  "An operation straddles the data file and another file.");
+        *offset_out = offset;
+        return data_file_.get();
+    }
+}
+
+file_account_t *split_file_t::route_account(file_t *file, file_account_t *account) {
+    if (account == DEFAULT_DISK_ACCOUNT) {
+        return DEFAULT_DISK_ACCOUNT;
+    }
+    account_t *split_account = static_cast<account_t *>(account->get_account());
+    if (file == index_file_.get()) {
+        return split_account->index_account.get();
+    } else if (file == archive_file_.get()) {
+        return split_account->archive_account.get();
+    } else {
+        return &split_account->data_account;
+    }
+}
+
+int64_t split_file_t::get_size() {
+    return data_file_->get_size();
+}
+
+void split_file_t::set_size(int64_t size) {
+    int64_t file_size;
+    file_t *file = route(size, 0, &file_size);
+    file->set_size(file_size);
+}
+
+void split_file_t::set_size_at_least(int64_t size) {
+    int64_t file_size;
+    file_t *file = route(size, 0, &file_size);
+    file->set_size_at_least(file_size);
+}
+
+void split_file_t::read_async(int64_t offset, size_t length, void *buf,
+                              file_account_t *account, linux_iocallback_t *cb) {
+    int64_t file_offset;
+    file_t *file = route(offset, length, &file_offset);
+    file->read_async(file_offset, length, buf, route_account(file, account), cb);
+}
+
+void split_file_t::write_async(int64_t offset, size_t length, const void *buf,
+                               file_account_t *account, linux_iocallback_t *cb,
+                               wrap_in_datasyncs_t wrap_in_datasyncs) {
+    int64_t file_offset;
+    file_t *file = route(offset, length, &file_offset);
+    file->write_async(file_offset, length, buf, route_account(file, account), cb,
+                      wrap_in_datasyncs);
+}
+
+void split_file_t::writev_async(int64_t offset, size_t length,
+                                scoped_array_t<iovec> &&bufs,
+                                file_account_t *account, linux_iocallback_t *cb) {
+    int64_t file_offset;
+    file_t *file = route(offset, length, &file_offset);
+    file->writev_async(file_offset, length, std::move(bufs),
+                       route_account(file, account), cb);
+}
+
+int split_file_t::discard(int64_t offset, int64_t length) {
+    int64_t file_offset;
+    file_t *file = route(offset, length, &file_offset);
+    return file->discard(file_offset, length);
+}
+
+void *split_file_t::create_account(int priority, int outstanding_requests_limit,
+                                   int deadline_ms) {
+    return new account_t(this, priority, outstanding_requests_limit, deadline_ms);
+}
+
+void split_file_t::destroy_account(void *account) {
+    delete static_cast<account_t *>(account);
+}
+
+bool split_file_t::coop_lock_and_check() {
+    return data_file_->coop_lock_and_check()
+        && (!index_file_.has() || index_file_->coop_lock_and_check())
+        && (!archive_file_.has() || archive_file_->coop_lock_and_check());
+}
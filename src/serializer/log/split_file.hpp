@@ -0,0 +1,73 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_LOG_SPLIT_FILE_HPP_
+#define SERIALIZER_LOG_SPLIT_FILE_HPP_
+
+#include "arch/types.hpp"
+#include "containers/scoped.hpp"
+
+/* Offsets at and above INDEX_FILE_OFFSET refer to the index file of a serializer whose
+metablocks and LBA are kept in a separate index file.  (Data files never get anywhere
+near that big.) */
+#define INDEX_FILE_OFFSET (int64_t(1) << 56)
+
+/* Offsets from ARCHIVE_FILE_OFFSET up to INDEX_FILE_OFFSET refer to the archive file
+of a serializer that moves the blocks that haven't been written for a long time to a
+separate archive file (on a larger, slower device).  This still leaves 64 TB for the
+data file, and the in-memory index can still tell the offsets apart (see
+in_memory_index_chunk_t). */
+#define ARCHIVE_FILE_OFFSET (int64_t(1) << 46)
+
+/* `split_file_t` presents a serializer's data file, index file and archive file as a
+single file: offsets below ARCHIVE_FILE_OFFSET go to the data file, offset
+ARCHIVE_FILE_OFFSET + x goes to offset x of the archive file, and offset
+INDEX_FILE_OFFSET + x goes to offset x of the index file.  A serializer may have
+either of the last two or both.  An operation must not straddle two files.
+
+Sizes go by the same rule: set_size(INDEX_FILE_OFFSET + x) resizes the index file to
+x bytes.  get_size() is the size of the data file. */
+class split_file_t : public file_t {
+public:
+    // index_file or archive_file may be empty, but not both.
+    split_file_t(scoped_ptr_t<file_t> &&data_file, scoped_ptr_t<file_t> &&index_file,
+                 scoped_ptr_t<file_t> &&archive_file);
+    ~split_file_t();
+
+    file_t *data_file() { return data_file_.get(); }
+    // These return NULL if there's no such file.
+    file_t *index_file() { return index_file_.get(); }
+    file_t *archive_file() { return archive_file_.get(); }
+
+    int64_t get_size();
+    void set_size(int64_t size);
+    void set_size_at_least(int64_t size);
+
+    void read_async(int64_t offset, size_t length, void *buf,
+                    file_account_t *account, linux_iocallback_t *cb);
+    void write_async(int64_t offset, size_t length, const void *buf,
+                     file_account_t *account, linux_iocallback_t *cb,
+                     wrap_in_datasyncs_t wrap_in_datasyncs);
+    void writev_async(int64_t offset, size_t length, scoped_array_t<iovec> &&bufs,
+                      file_account_t *account, linux_iocallback_t *cb);
+
+    int discard(int64_t offset, int64_t length);
+
+    void *create_account(int priority, int outstanding_requests_limit, int deadline_ms);
+    void destroy_account(void *account);
+
+    bool coop_lock_and_check();
+
+private:
+    struct account_t;
+
+    // Which file the range starting at offset is in, and where it is in that file.
+    file_t *route(int64_t offset, int64_t length, int64_t *offset_out);
+    file_account_t *route_account(file_t *file, file_account_t *account);
+
+    scoped_ptr_t<file_t> data_file_;
+    scoped_ptr_t<file_t> index_file_;
+    scoped_ptr_t<file_t> archive_file_;
+
+    DISABLE_COPYING(split_file_t);
+};
+
+#endif  // SERIALIZER_LOG_SPLIT_FILE_HPP_
@@ -21,7 +21,8 @@ bool static_header_check(file_t *file) {
     }
 }
 
-void co_static_header_write(file_t *file, void *data, size_t data_size) {
+void co_static_header_write(file_t *file, void *data, size_t data_size,
+                            const char *version) {
     static_header_t *buffer = reinterpret_cast<static_header_t *>(malloc_aligned(DEVICE_BLOCK_SIZE, DEVICE_BLOCK_SIZE));
     rassert(sizeof(static_header_t) + data_size < DEVICE_BLOCK_SIZE);
 
@@ -32,8 +33,8 @@ void co_static_header_write(file_t *file, void *data, size_t data_size) {
     rassert(sizeof(SOFTWARE_NAME_STRING) < 16);
     memcpy(buffer->software_name, SOFTWARE_NAME_STRING, sizeof(SOFTWARE_NAME_STRING));
 
-    rassert(sizeof(SERIALIZER_VERSION_STRING) < 16);
-    memcpy(buffer->version, SERIALIZER_VERSION_STRING, sizeof(SERIALIZER_VERSION_STRING));
+    guarantee(strlen(version) < sizeof(buffer->version));
+    memcpy(buffer->version, version, strlen(version) + 1);
 
     memcpy(buffer->data, data, data_size);
 
@@ -54,7 +55,25 @@ bool static_header_write(file_t *file, void *data, size_t data_size, static_head
     return false;
 }
 
-void co_static_header_read(file_t *file, static_header_read_callback_t *callback, void *data_out, size_t data_size) {
+// The serializer versions we can read, oldest first.  Single-file serializers from
+// this version are still SERIALIZER_VERSION_STRING; the split layout is
+// SERIALIZER_SPLIT_VERSION_STRING.
+static const char *const READABLE_SERIALIZER_VERSIONS[] = {
+    SERIALIZER_VERSION_STRING,
+    SERIALIZER_SPLIT_VERSION_STRING
+};
+
+static bool is_readable_serializer_version(const char *version, size_t version_size) {
+    for (size_t i = 0; i < sizeof(READABLE_SERIALIZER_VERSIONS) / sizeof(READABLE_SERIALIZER_VERSIONS[0]); ++i) {
+        if (strnlen(version, version_size) == strlen(READABLE_SERIALIZER_VERSIONS[i])
+            && strncmp(version, READABLE_SERIALIZER_VERSIONS[i], version_size) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void co_static_header_read(file_t *file, void *data_out, size_t data_size) {
     rassert(sizeof(static_header_t) + data_size < DEVICE_BLOCK_SIZE);
     static_header_t *buffer = reinterpret_cast<static_header_t *>(malloc_aligned(DEVICE_BLOCK_SIZE, DEVICE_BLOCK_SIZE));
     co_read(file, 0, DEVICE_BLOCK_SIZE, buffer, DEFAULT_DISK_ACCOUNT);
@@ -62,21 +81,25 @@ void co_static_header_read(file_t *file, static_header_read_callback_t *callback
         fail_due_to_user_error("This doesn't appear to be a RethinkDB data file.");
     }
 
-    if (memcmp(buffer->version, SERIALIZER_VERSION_STRING, sizeof(SERIALIZER_VERSION_STRING)) != 0) {
+    if (!is_readable_serializer_version(buffer->version, sizeof(buffer->version))) {
         fail_due_to_user_error("File version is incorrect. This file was created with "
                                "RethinkDB's serializer version %s, but you are trying "
                                "to read it with version %s.  See "
                                "http://rethinkdb.com/docs/migration/ for information on "
                                "migrating data from a previous version.",
-                               buffer->version, SERIALIZER_VERSION_STRING);
+                               buffer->version, SERIALIZER_SPLIT_VERSION_STRING);
     }
     memcpy(data_out, buffer->data, data_size);
-    callback->on_static_header_read();
-    // TODO: free buffer before you call the callback.
     free(buffer);
 }
 
+void co_static_header_read_helper(file_t *file, static_header_read_callback_t *callback,
+                                  void *data_out, size_t data_size) {
+    co_static_header_read(file, data_out, data_size);
+    callback->on_static_header_read();
+}
+
 bool static_header_read(file_t *file, void *data_out, size_t data_size, static_header_read_callback_t *cb) {
-    coro_t::spawn_later_ordered(boost::bind(co_static_header_read, file, cb, data_out, data_size));
+    coro_t::spawn_later_ordered(boost::bind(co_static_header_read_helper, file, cb, data_out, data_size));
     return false;
 }
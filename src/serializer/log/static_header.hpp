@@ -3,7 +3,9 @@
 #define SERIALIZER_LOG_STATIC_HEADER_HPP_
 
 #include <stddef.h>
+
 #include "arch/types.hpp"
+#include "config/args.hpp"
 
 struct static_header_t {
     char software_name[16];
@@ -18,7 +20,9 @@ struct static_header_write_callback_t {
     virtual ~static_header_write_callback_t() {}
 };
 
-void co_static_header_write(file_t *file, void *data, size_t data_size);
+// version is SERIALIZER_VERSION_STRING or SERIALIZER_SPLIT_VERSION_STRING.
+void co_static_header_write(file_t *file, void *data, size_t data_size,
+                            const char *version = SERIALIZER_VERSION_STRING);
 
 bool static_header_write(file_t *file, void *data, size_t data_size, static_header_write_callback_t *cb);
 
@@ -29,4 +33,7 @@ struct static_header_read_callback_t {
 
 bool static_header_read(file_t *file, void *data_out, size_t data_size, static_header_read_callback_t *cb);
 
+// Like static_header_read, but blocks until it's done.
+void co_static_header_read(file_t *file, void *data_out, size_t data_size);
+
 #endif /* SERIALIZER_LOG_STATIC_HEADER_HPP_ */
@@ -2,8 +2,67 @@
 #ifndef SERIALIZER_LOG_STATS_HPP_
 #define SERIALIZER_LOG_STATS_HPP_
 
+#include <array>
+
 #include "perfmon/perfmon.hpp"
 
+class data_block_manager_t;
+
+/* The data file's write amplification: the bytes that transactions and the GC wrote
+to it per byte that transactions wrote, and the GC's efficiency: the garbage bytes
+it reclaimed per byte that it rewrote.  Older bytes count for less, halving every
+WRITE_AMPLIFICATION_HALF_LIFE_SECS. */
+class perfmon_write_amplification_t : public perfmon_perthread_t<std::array<double, 3> > {
+public:
+    perfmon_write_amplification_t();
+
+    void record_user_write(int64_t bytes) { record(USER_WRITTEN, bytes); }
+    void record_gc_write(int64_t bytes) { record(GC_WRITTEN, bytes); }
+    void record_gc_reclaim(int64_t bytes) { record(GC_RECLAIMED, bytes); }
+
+private:
+    enum { USER_WRITTEN = 0, GC_WRITTEN = 1, GC_RECLAIMED = 2 };
+    typedef std::array<double, 3> sums_t;
+
+    struct thread_info_t {
+        thread_info_t() : as_of(0) { sums.fill(0); }
+        sums_t sums;
+        ticks_t as_of;
+    };
+
+    void record(int which, int64_t bytes);
+    // Brings the current thread's sums up to `now`.
+    thread_info_t *decayed_thread_info(ticks_t now);
+
+    void get_thread_stat(sums_t *);
+    sums_t combine_stats(const sums_t *);
+    scoped_ptr_t<perfmon_result_t> output_stat(const sums_t &);
+
+    thread_info_t thread_data[MAX_THREADS];
+};
+
+/* How many of the data file's old extents are 0-10% live, 10-20% live and so on.
+The GC has to rewrite the live part of an extent to reclaim the rest. */
+class perfmon_live_data_histogram_t
+    : public perfmon_perthread_t<std::array<int64_t, 10> > {
+public:
+    perfmon_live_data_histogram_t() : dbm(NULL), dbm_thread(-1) { }
+
+    // The data block manager is only looked at on its own thread.  Pass NULL when
+    // it stops.
+    void set_data_block_manager(data_block_manager_t *_dbm, threadnum_t _dbm_thread);
+
+private:
+    typedef std::array<int64_t, 10> buckets_t;
+
+    void get_thread_stat(buckets_t *);
+    buckets_t combine_stats(const buckets_t *);
+    scoped_ptr_t<perfmon_result_t> output_stat(const buckets_t &);
+
+    data_block_manager_t *dbm;
+    threadnum_t dbm_thread;
+};
+
 struct log_serializer_stats_t {
     perfmon_collection_t serializer_collection;
     explicit log_serializer_stats_t(perfmon_collection_t *perfmon_collection);
@@ -11,12 +70,19 @@ struct log_serializer_stats_t {
     perfmon_duration_sampler_t pm_serializer_block_reads;
     perfmon_counter_t pm_serializer_index_reads;
     perfmon_counter_t pm_serializer_block_writes;
+    perfmon_counter_t pm_serializer_compressed_block_writes;
+    perfmon_counter_t pm_serializer_compressed_bytes_saved;
     perfmon_duration_sampler_t pm_serializer_index_writes;
     perfmon_sampler_t pm_serializer_index_writes_size;
+    perfmon_duration_sampler_t pm_serializer_metablock_writes;
+    perfmon_rate_monitor_t pm_serializer_metablock_writes_per_sec;
+    // How many index writes each metablock write (and its datasyncs) covered.
+    perfmon_sampler_t pm_serializer_metablock_batch_size;
 
     /* used in serializer/log/extent_manager.cc */
     perfmon_counter_t pm_extents_in_use;
     perfmon_counter_t pm_bytes_in_use;
+    perfmon_counter_t pm_serializer_extents_discarded;
 
     /* used in serializer/log/lba/extent.cc */
     perfmon_counter_t pm_serializer_lba_extents;
@@ -25,11 +91,27 @@ struct log_serializer_stats_t {
     perfmon_counter_t pm_serializer_data_extents;
     perfmon_counter_t pm_serializer_data_extents_allocated;
     perfmon_counter_t pm_serializer_data_extents_gced;
+    perfmon_counter_t pm_serializer_blocks_archived;
+    perfmon_counter_t pm_serializer_compaction_extents_moved;
+    perfmon_counter_t pm_serializer_compaction_extents_left;
     perfmon_counter_t pm_serializer_old_garbage_block_bytes;
     perfmon_counter_t pm_serializer_old_total_block_bytes;
+    perfmon_counter_t pm_serializer_block_checksum_retries;
+    perfmon_counter_t pm_serializer_block_checksum_failures;
+    // The bytes of blocks that transactions wrote, that the GC moved, and the
+    // garbage bytes in the extents that the GC took.
+    perfmon_counter_t pm_serializer_user_bytes_written;
+    perfmon_counter_t pm_serializer_gc_bytes_written;
+    perfmon_counter_t pm_serializer_gc_bytes_reclaimed;
+    perfmon_write_amplification_t pm_serializer_write_amplification;
+    perfmon_live_data_histogram_t pm_serializer_extent_live_data;
+    /* used in serializer/log/gc_scheduler.cc */
+    perfmon_counter_t pm_serializer_gc_rate;
+    perfmon_counter_t pm_serializer_gc_debt;
 
     /* used in serializer/log/lba/lba_list.cc */
     perfmon_counter_t pm_serializer_lba_gcs;
+    perfmon_counter_t pm_serializer_lba_gc_bytes_written;
 
     perfmon_membership_t parent_collection_membership;
     perfmon_multi_membership_t stats_membership;
@@ -4,12 +4,13 @@
 #include "arch/arch.hpp"
 #include "boost_utils.hpp"
 #include "math.hpp"
+#include "serializer/buffer_allocator.hpp"
 
 scoped_malloc_t<ser_buffer_t>
 serializer_t::allocate_buffer(block_size_t block_size) {
     scoped_malloc_t<ser_buffer_t> buf(
-            malloc_aligned(ceil_aligned(block_size.ser_value(), DEVICE_BLOCK_SIZE),
-                           DEVICE_BLOCK_SIZE));
+            allocate_block_buffer(ceil_aligned(block_size.ser_value(),
+                                               DEVICE_BLOCK_SIZE)));
 
     return buf;
 }
@@ -26,7 +27,12 @@ void debug_print(printf_buffer_t *buf, const index_write_op_t &write_op) {
 
 file_account_t *serializer_t::make_io_account(int priority) {
     assert_thread();
-    return make_io_account(priority, UNLIMITED_OUTSTANDING_REQUESTS);
+    return make_io_account(priority, UNLIMITED_OUTSTANDING_REQUESTS, NO_IO_DEADLINE);
+}
+
+file_account_t *serializer_t::make_io_account(int priority, int outstanding_requests_limit) {
+    assert_thread();
+    return make_io_account(priority, outstanding_requests_limit, NO_IO_DEADLINE);
 }
 
 ser_buffer_t *convert_buffer_cache_buf_to_ser_buffer(const void *buf) {
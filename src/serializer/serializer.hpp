@@ -30,6 +30,20 @@ struct index_write_op_t {
 
 void debug_print(printf_buffer_t *buf, const index_write_op_t &write_op);
 
+/* Thrown by block_read when what's on disk doesn't match the block's checksum, even
+after reading it again.  This means the block is lost (on this server), but the rest of
+the file is still usable. */
+class block_checksum_exc_t : public std::exception {
+public:
+    explicit block_checksum_exc_t(int64_t offset)
+        : message_(strprintf("The block at offset %" PRIi64 " of the data file is "
+                             "corrupted (its checksum doesn't match).", offset)) { }
+    ~block_checksum_exc_t() throw () { }
+    const char *what() const throw () { return message_.c_str(); }
+private:
+    std::string message_;
+};
+
 /* serializer_t is an abstract interface that describes how each serializer should
 behave. It is implemented by log_serializer_t, semantic_checking_serializer_t, and
 translator_serializer_t. */
@@ -51,9 +65,11 @@ public:
     static scoped_malloc_t<ser_buffer_t> allocate_buffer(block_size_t block_size);
 
     /* Allocates a new io account for the underlying file.
-    Use delete to free it. */
+    Use delete to free it.  See `file_t::create_account()` for `deadline_ms`. */
     file_account_t *make_io_account(int priority);
-    virtual file_account_t *make_io_account(int priority, int outstanding_requests_limit) = 0;
+    file_account_t *make_io_account(int priority, int outstanding_requests_limit);
+    virtual file_account_t *make_io_account(int priority, int outstanding_requests_limit,
+                                            int deadline_ms) = 0;
 
     /* Some serializer implementations support read-ahead to speed up cache warmup.
     This is supported through a serializer_read_ahead_callback_t which gets called whenever the serializer has read-ahead some buf.
@@ -63,6 +79,7 @@ public:
     virtual void unregister_read_ahead_cb(serializer_read_ahead_callback_t *cb) = 0;
 
     // Reading a block from the serializer.  Reads a block, blocks the coroutine.
+    // Throws block_checksum_exc_t if the block is corrupted on disk.
     virtual void block_read(const counted_t<standard_block_token_t> &token,
                             ser_buffer_t *buf, file_account_t *io_account) = 0;
 
@@ -113,7 +113,8 @@ public:
     scoped_malloc_t<ser_buffer_t> allocate_buffer();
 
     /* Allocates a new io account for the underlying file */
-    file_account_t *make_io_account(int priority, int outstanding_requests_limit);
+    file_account_t *make_io_account(int priority, int outstanding_requests_limit,
+                                    int deadline_ms);
 
     void index_write(const std::vector<index_write_op_t> &write_ops, file_account_t *io_account);
 
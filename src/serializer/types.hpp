@@ -11,6 +11,7 @@
 #include "containers/counted.hpp"
 #include "containers/scoped.hpp"
 #include "errors.hpp"
+#include "serializer/buffer_allocator.hpp"
 #include "valgrind.hpp"
 
 // A relatively "lightweight" header file (we wish), in a sense.
@@ -25,6 +26,12 @@ typedef uint64_t block_id_t;
 // The first bytes of any block stored on disk or (as it happens) cached in memory.
 struct ls_buf_data_t {
     block_id_t block_id;
+    // The CRC32C of the block id and of the block's bytes after this header, as they
+    // are on disk.  The serializer sets it when it writes the block and checks it
+    // when it reads the block.
+    uint32_t checksum;
+    // Keeps the cache data 8-byte aligned.
+    uint32_t zero;
 } __attribute__((__packed__));
 
 // For use via scoped_malloc_t, a buffer that represents a block on disk.  Contains
@@ -38,6 +45,13 @@ struct ser_buffer_t {
     char cache_data[];
 } __attribute__((__packed__));
 
+// Buffers from serializer_t::allocate_buffer may be carved out of the block buffer
+// allocator's slabs, so they must not be handed to free().
+template <>
+inline scoped_malloc_t<ser_buffer_t>::~scoped_malloc_t() {
+    free_block_buffer(ptr_);
+}
+
 
 class block_size_t {
 public:
@@ -94,6 +108,10 @@ class ls_block_token_pointee_t {
 public:
     int64_t offset() const { return offset_; }
     block_size_t block_size() const { return block_size_; }
+    // The block's size on disk, which is smaller than block_size() if the block is
+    // compressed.
+    block_size_t disk_block_size() const { return disk_block_size_; }
+    bool is_compressed() const { return !(disk_block_size_ == block_size_); }
 
 private:
     friend class log_serializer_t;
@@ -103,7 +121,8 @@ private:
 
     ls_block_token_pointee_t(log_serializer_t *serializer,
                              int64_t initial_offset,
-                             block_size_t initial_ser_block_size);
+                             block_size_t initial_ser_block_size,
+                             block_size_t initial_disk_block_size);
 
     log_serializer_t *serializer_;
     intptr_t ref_count_;
@@ -111,6 +130,9 @@ private:
     // The block's size.
     block_size_t block_size_;
 
+    // The block's size on disk.
+    block_size_t disk_block_size_;
+
     // The block's offset on disk.
     int64_t offset_;
 
@@ -142,9 +164,28 @@ public:
     virtual std::string file_name() const = 0;
 
     virtual void open_serializer_file_create_temporary(scoped_ptr_t<file_t> *file_out) = 0;
+    // Moves the index and archive files too, if they have been created.
     virtual void move_serializer_file_to_permanent_location() = 0;
     virtual void open_serializer_file_existing(scoped_ptr_t<file_t> *file_out) = 0;
+    // Unlinks the index and archive files too, if they have been created.
     virtual void unlink_serializer_file() = 0;
+
+    // Whether the log serializer should keep its metablocks and LBA in a separate
+    // index file (on a lower-latency device than the data extents, say).  When a
+    // serializer file refers to an index file, it's opened with
+    // open_index_file_existing(), no matter what has_index_file() returns.
+    virtual bool has_index_file() const = 0;
+    virtual std::string index_file_name() const = 0;
+    virtual void open_index_file_create_temporary(scoped_ptr_t<file_t> *file_out) = 0;
+    virtual void open_index_file_existing(scoped_ptr_t<file_t> *file_out) = 0;
+
+    // Whether the log serializer should move the blocks that haven't been written
+    // for a long time to a separate archive file (on a larger, slower device than
+    // the data extents).  The same goes as for the index file.
+    virtual bool has_archive_file() const = 0;
+    virtual std::string archive_file_name() const = 0;
+    virtual void open_archive_file_create_temporary(scoped_ptr_t<file_t> *file_out) = 0;
+    virtual void open_archive_file_existing(scoped_ptr_t<file_t> *file_out) = 0;
 #ifdef SEMANTIC_SERIALIZER_CHECK
     virtual void open_semantic_checking_file(scoped_ptr_t<semantic_checking_file_t> *file_out) = 0;
 #endif
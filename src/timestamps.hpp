@@ -52,6 +52,9 @@ private:
 
 void debug_print(printf_buffer_t *buf, state_timestamp_t ts);
 
+template <>
+struct serialized_as_raw_t<state_timestamp_t> : public std::true_type { };
+
 class transition_timestamp_t {
 public:
     bool operator==(transition_timestamp_t t) const { return before == t.before; }
@@ -1,10 +1,19 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
+#include <string.h>
+
 #include <string>
+#include <vector>
 
 #include "unittest/gtest.hpp"
 
+#include "config/args.hpp"
 #include "containers/archive/boost_types.hpp"
+#include "containers/archive/shared_buffer_stream.hpp"
 #include "containers/archive/stl_types.hpp"
+#include "containers/archive/vector_stream.hpp"
+#include "containers/scoped.hpp"
+#include "containers/wire_string.hpp"
+#include "repli_timestamp.hpp"
 
 namespace unittest {
 
@@ -34,6 +43,154 @@ TEST(WriteMessageTest, Variant) {
     ASSERT_EQ(15u, s.size());
 }
 
+TEST(WriteMessageTest, SendMultipleBuffers) {
+    // Big enough to span several `write_buffer_t`s, which `send_write_message()`
+    // hands to the stream with one `writev()` call.
+    std::string payload;
+    for (int i = 0; i < 3 * write_buffer_t::DEFAULT_SIZE + 17; ++i) {
+        payload += 'a' + (i % 26);
+    }
+
+    write_message_t msg;
+    msg.append(payload.data(), payload.size());
+
+    vector_stream_t stream;
+    ASSERT_EQ(0, send_write_message(&stream, &msg));
+    ASSERT_EQ(payload, std::string(stream.vector().begin(), stream.vector().end()));
+}
+
+TEST(WriteMessageTest, Reserve) {
+    write_message_t msg;
+    msg.append("xy", 2);
+
+    // The reserved bytes don't fit into the first buffer, so they get one of
+    // their own that's big enough for all of them.
+    const int64_t n = 5 * write_buffer_t::DEFAULT_SIZE;
+    msg.reserve(n);
+    std::string payload(n, 'z');
+    msg.append(payload.data(), payload.size());
+
+    intrusive_list_t<write_buffer_t> *buffers = msg.unsafe_expose_buffers();
+    ASSERT_EQ(2, buffers->head()->size);
+    ASSERT_EQ(n, buffers->tail()->size);
+    ASSERT_EQ(buffers->tail(), buffers->next(buffers->head()));
+
+    std::string s;
+    dump_to_string(&msg, &s);
+    ASSERT_EQ("xy" + payload, s);
+
+    // Reserving what already fits doesn't start a new buffer.
+    write_message_t small_msg;
+    small_msg.append("xy", 2);
+    small_msg.reserve(10);
+    small_msg.append("0123456789", 10);
+    ASSERT_EQ(small_msg.unsafe_expose_buffers()->head(),
+              small_msg.unsafe_expose_buffers()->tail());
+}
+
+TEST(WriteMessageTest, BuffersAreReused) {
+    write_buffer_t *first;
+    {
+        write_message_t msg;
+        msg.append("abc", 3);
+        first = msg.unsafe_expose_buffers()->head();
+    }
+    write_message_t msg;
+    msg.append("def", 3);
+    // The buffer went back into this thread's pool and got handed out again.
+    ASSERT_EQ(first, msg.unsafe_expose_buffers()->head());
+    ASSERT_EQ(3, msg.unsafe_expose_buffers()->head()->size);
+}
+
+TEST(SharedBufferReadStreamTest, BorrowedStrings) {
+    const std::string big1(WIRE_STRING_MIN_BORROW_SIZE, 'a');
+    const std::string big2(WIRE_STRING_MIN_BORROW_SIZE + 1, 'b');
+    scoped_ptr_t<wire_string_t> big1_in(
+        wire_string_t::create_and_init(big1.size(), big1.data()));
+    scoped_ptr_t<wire_string_t> big2_in(
+        wire_string_t::create_and_init(big2.size(), big2.data()));
+    scoped_ptr_t<wire_string_t> small_in(wire_string_t::create_and_init(5, "small"));
 
+    write_message_t msg;
+    msg << *big1_in << *big2_in << *small_in << *big2_in;
+    vector_stream_t out;
+    ASSERT_EQ(0, send_write_message(&out, &msg));
+    std::vector<char> data;
+    out.swap(&data);
+
+    scoped_ptr_t<wire_string_t> big1_out, big2_out, small_out, last_out;
+    {
+        shared_buffer_read_stream_t stream(std::move(data));
+        wire_string_t *p;
+        ASSERT_EQ(archive_result_t::SUCCESS, deserialize(&stream, &p));
+        big1_out.init(p);
+        // The length of `big2` is read from where `big1`'s terminator went.
+        ASSERT_EQ(archive_result_t::SUCCESS, deserialize(&stream, &p));
+        big2_out.init(p);
+        ASSERT_EQ(archive_result_t::SUCCESS, deserialize(&stream, &p));
+        small_out.init(p);
+        ASSERT_EQ(archive_result_t::SUCCESS, deserialize(&stream, &p));
+        last_out.init(p);
+    }
+
+    // The borrowed strings keep the message alive after the stream is gone.
+    ASSERT_TRUE(big1_out->is_borrowed());
+    ASSERT_TRUE(big2_out->is_borrowed());
+    ASSERT_FALSE(small_out->is_borrowed());
+    // There's no room for a terminator after the last string, so it got copied.
+    ASSERT_FALSE(last_out->is_borrowed());
+
+    ASSERT_EQ(big1, big1_out->to_std());
+    ASSERT_EQ(big2, big2_out->to_std());
+    ASSERT_EQ(big2.size(), strlen(big2_out->c_str()));
+    ASSERT_EQ("small", small_out->to_std());
+    ASSERT_EQ(big2, last_out->to_std());
+}
+
+TEST(WriteMessageTest, RawVectors) {
+    std::vector<uint64_t> ints;
+    std::vector<repli_timestamp_t> timestamps;
+    for (uint64_t i = 0; i < 1000; ++i) {
+        ints.push_back(i * 0x0101010101010101ULL);
+        timestamps.push_back(repli_timestamp_t::distant_past);
+        timestamps.back().longtime = i;
+    }
+
+    write_message_t msg;
+    msg << ints;
+    msg << timestamps;
+    std::string s;
+    dump_to_string(&msg, &s);
+    ASSERT_EQ(serialized_size(ints) + serialized_size(timestamps), s.size());
+
+    // It's the same as sending the elements one at a time.
+    write_message_t slow_msg;
+    serialize_varint_uint64(&slow_msg, ints.size());
+    for (size_t i = 0; i < ints.size(); ++i) {
+        slow_msg << ints[i];
+    }
+    serialize_varint_uint64(&slow_msg, timestamps.size());
+    for (size_t i = 0; i < timestamps.size(); ++i) {
+        slow_msg << timestamps[i];
+    }
+    std::string slow_s;
+    dump_to_string(&slow_msg, &slow_s);
+    ASSERT_EQ(slow_s, s);
+
+    {
+        vector_read_stream_t stream(std::vector<char>(s.begin(), s.end()));
+        std::vector<uint64_t> ints_out;
+        std::vector<repli_timestamp_t> timestamps_out;
+        ASSERT_EQ(archive_result_t::SUCCESS, deserialize(&stream, &ints_out));
+        ASSERT_EQ(archive_result_t::SUCCESS, deserialize(&stream, &timestamps_out));
+        ASSERT_EQ(ints, ints_out);
+        ASSERT_TRUE(timestamps == timestamps_out);
+    }
+    {
+        vector_read_stream_t stream(std::vector<char>(s.begin(), s.begin() + 100));
+        std::vector<uint64_t> ints_out;
+        ASSERT_EQ(archive_result_t::SOCK_EOF, deserialize(&stream, &ints_out));
+    }
+}
 
 }  // namespace unittest
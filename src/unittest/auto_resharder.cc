@@ -0,0 +1,84 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "clustering/administration/auto_resharder.hpp"
+
+namespace unittest {
+
+// Two shards, split at "m".
+static nonoverlapping_regions_t<rdb_protocol_t> two_shards() {
+    std::vector<rdb_protocol_t::region_t> regions;
+    regions.push_back(rdb_protocol_t::region_t(
+        key_range_t(key_range_t::none, store_key_t(""),
+                    key_range_t::open, store_key_t("m"))));
+    regions.push_back(rdb_protocol_t::region_t(
+        key_range_t(key_range_t::closed, store_key_t("m"),
+                    key_range_t::none, store_key_t())));
+    nonoverlapping_regions_t<rdb_protocol_t> shards;
+    EXPECT_TRUE(shards.set_regions(regions));
+    return shards;
+}
+
+TEST(AutoResharder, SplitsBigShards) {
+    nonoverlapping_regions_t<rdb_protocol_t> shards = two_shards();
+    std::map<store_key_t, int64_t> key_counts;
+    key_counts[store_key_t("")] = 10;
+    key_counts[store_key_t("c")] = 10;
+    key_counts[store_key_t("e")] = 10;
+    key_counts[store_key_t("g")] = 10;
+    key_counts[store_key_t("m")] = 5;
+    key_counts[store_key_t("p")] = 5;
+    std::map<store_key_t, int64_t> byte_counts;
+    for (auto it = key_counts.begin(); it != key_counts.end(); ++it) {
+        byte_counts[it->first] = it->second * 100;
+    }
+
+    std::map<store_key_t, shard_load_t> loads
+        = get_shard_loads(shards, key_counts, byte_counts);
+    ASSERT_EQ(2u, loads.size());
+    EXPECT_EQ(40, loads[store_key_t("")].keys);
+    EXPECT_EQ(4000, loads[store_key_t("")].bytes);
+    EXPECT_EQ(10, loads[store_key_t("m")].keys);
+
+    std::set<store_key_t> split_points = choose_reshard_split_points(
+        shards, key_counts, byte_counts, std::map<store_key_t, shard_load_t>(),
+        3000, 1000, 3.0, 32);
+    ASSERT_EQ(1u, split_points.size());
+    EXPECT_EQ(store_key_t("e"), *split_points.begin());
+
+    // Not if the table already has as many shards as it may.
+    split_points = choose_reshard_split_points(
+        shards, key_counts, byte_counts, std::map<store_key_t, shard_load_t>(),
+        3000, 1000, 3.0, 2);
+    EXPECT_TRUE(split_points.empty());
+}
+
+TEST(AutoResharder, SplitsHotShards) {
+    nonoverlapping_regions_t<rdb_protocol_t> shards = two_shards();
+    std::map<store_key_t, int64_t> key_counts;
+    key_counts[store_key_t("")] = 1000;
+    key_counts[store_key_t("m")] = 1000;
+    key_counts[store_key_t("t")] = 1000;
+    std::map<store_key_t, shard_load_t> previous_loads
+        = get_shard_loads(shards, key_counts, std::map<store_key_t, int64_t>());
+
+    // Nothing has grown yet.
+    EXPECT_TRUE(choose_reshard_split_points(
+        shards, key_counts, std::map<store_key_t, int64_t>(), previous_loads,
+        GIGABYTE, 100, 1.5, 32).empty());
+
+    // Time-ordered keys pile up in the last shard.
+    key_counts[store_key_t("x")] = 5000;
+    std::set<store_key_t> split_points = choose_reshard_split_points(
+        shards, key_counts, std::map<store_key_t, int64_t>(), previous_loads,
+        GIGABYTE, 100, 1.5, 32);
+    ASSERT_EQ(1u, split_points.size());
+    EXPECT_EQ(store_key_t("x"), *split_points.begin());
+
+    // But not if it didn't grow by enough keys.
+    EXPECT_TRUE(choose_reshard_split_points(
+        shards, key_counts, std::map<store_key_t, int64_t>(), previous_loads,
+        GIGABYTE, 10000, 1.5, 32).empty());
+}
+
+}  // namespace unittest
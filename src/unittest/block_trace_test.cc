@@ -0,0 +1,72 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "unittest/gtest.hpp"
+
+#include "buffer_cache/alt/block_trace.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+static std::vector<block_trace_record_t> parse_dump(const std::string &dump) {
+    const size_t header_size = strlen(BLOCK_TRACE_MAGIC) + 2 * sizeof(uint32_t);
+    EXPECT_LE(header_size, dump.size());
+    EXPECT_EQ(0, memcmp(dump.data(), BLOCK_TRACE_MAGIC, strlen(BLOCK_TRACE_MAGIC)));
+    uint32_t record_size;
+    memcpy(&record_size, dump.data() + strlen(BLOCK_TRACE_MAGIC), sizeof(record_size));
+    EXPECT_EQ(sizeof(block_trace_record_t), record_size);
+    EXPECT_EQ(0u, (dump.size() - header_size) % sizeof(block_trace_record_t));
+
+    std::vector<block_trace_record_t> records(
+        (dump.size() - header_size) / sizeof(block_trace_record_t));
+    memcpy(records.data(), dump.data() + header_size,
+           records.size() * sizeof(block_trace_record_t));
+    return records;
+}
+
+TPTEST(BlockTraceTest, RecordAndDump) {
+    block_tracer_t tracer;
+    tracer.enable();
+    tracer.record(3, 10, false, true);
+    tracer.record(3, 11, true, false);
+    tracer.disable();
+
+    std::vector<block_trace_record_t> records = parse_dump(tracer.dump());
+    ASSERT_EQ(2u, records.size());
+    ASSERT_EQ(3u, records[0].cache_id);
+    ASSERT_EQ(10u, records[0].block_id);
+    ASSERT_EQ(BLOCK_TRACE_MISS, records[0].flags);
+    ASSERT_EQ(11u, records[1].block_id);
+    ASSERT_EQ(BLOCK_TRACE_WRITE, records[1].flags);
+    ASSERT_LE(records[0].ticks, records[1].ticks);
+
+    // Enabling again starts from scratch.
+    tracer.enable();
+    tracer.disable();
+    ASSERT_EQ(0u, parse_dump(tracer.dump()).size());
+}
+
+TPTEST(BlockTraceTest, RingWraps) {
+    block_tracer_t tracer;
+    tracer.enable();
+    const uint64_t total = BLOCK_TRACE_RECORDS_PER_THREAD + 5;
+    for (uint64_t i = 0; i < total; ++i) {
+        tracer.record(0, i, false, false);
+    }
+    tracer.disable();
+
+    // Only the most recent accesses are kept.
+    std::vector<block_trace_record_t> records = parse_dump(tracer.dump());
+    ASSERT_EQ(static_cast<size_t>(BLOCK_TRACE_RECORDS_PER_THREAD), records.size());
+    uint64_t min_block_id = total;
+    for (auto it = records.begin(); it != records.end(); ++it) {
+        min_block_id = std::min<uint64_t>(min_block_id, it->block_id);
+    }
+    ASSERT_EQ(5u, min_block_id);
+}
+
+}  // namespace unittest
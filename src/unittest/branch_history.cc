@@ -0,0 +1,60 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "clustering/immediate_consistency/branch/history.hpp"
+#include "containers/uuid.hpp"
+#include "mock/dummy_protocol.hpp"
+
+using mock::dummy_protocol_t;
+
+namespace unittest {
+
+// Adds a branch on `region` whose origin is `parent_region` at `parent` and the
+// rest of `region` at the root pseudobranch.
+static branch_id_t add_branch(const dummy_protocol_t::region_t &region,
+                              const dummy_protocol_t::region_t &parent_region,
+                              branch_id_t parent,
+                              branch_history_t<dummy_protocol_t> *history) {
+    branch_birth_certificate_t<dummy_protocol_t> bc;
+    bc.region = region;
+    bc.initial_timestamp = state_timestamp_t::zero();
+    bc.origin = region_map_t<dummy_protocol_t, version_range_t>(
+        region, version_range_t(version_t::zero()));
+    bc.origin.set(parent_region,
+                  version_range_t(version_t(parent, state_timestamp_t::zero())));
+    branch_id_t id = generate_uuid();
+    history->branches[id] = bc;
+    return id;
+}
+
+TEST(BranchHistory, RemoveUnreachableBranches) {
+    const dummy_protocol_t::region_t all('a', 'z');
+    const dummy_protocol_t::region_t left('a', 'm');
+    const dummy_protocol_t::region_t right('n', 'z');
+
+    branch_history_t<dummy_protocol_t> history;
+    branch_id_t root = add_branch(all, all, nil_uuid(), &history);
+    branch_id_t old_primary = add_branch(all, all, root, &history);
+    branch_id_t new_primary = add_branch(all, all, root, &history);
+    branch_id_t left_shard = add_branch(left, left, new_primary, &history);
+    branch_id_t right_shard = add_branch(right, right, new_primary, &history);
+
+    std::set<branch_id_t> roots;
+    roots.insert(left_shard);
+    EXPECT_EQ(2u, remove_unreachable_branches(roots, &history));
+    EXPECT_EQ(3u, history.branches.size());
+    EXPECT_EQ(1u, history.branches.count(left_shard));
+    EXPECT_EQ(1u, history.branches.count(new_primary));
+    EXPECT_EQ(1u, history.branches.count(root));
+    EXPECT_EQ(0u, history.branches.count(old_primary));
+    EXPECT_EQ(0u, history.branches.count(right_shard));
+
+    // Branches we don't know about are ignored.
+    roots.insert(generate_uuid());
+    EXPECT_EQ(0u, remove_unreachable_branches(roots, &history));
+
+    EXPECT_EQ(3u, remove_unreachable_branches(std::set<branch_id_t>(), &history));
+    EXPECT_TRUE(history.branches.empty());
+}
+
+}  // namespace unittest
@@ -64,6 +64,12 @@ void in_memory_branch_history_manager_t<protocol_t>::import_branch_history(const
     }
 }
 
+template <class protocol_t>
+void in_memory_branch_history_manager_t<protocol_t>::prune_branch_history(const std::set<branch_id_t> &roots, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+    nap(10, interruptor);
+    remove_unreachable_branches(roots, &bh);
+}
+
 }  // namespace unittest
 
 
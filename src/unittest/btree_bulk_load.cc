@@ -0,0 +1,360 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "arch/io/disk.hpp"
+#include "btree/get_distribution.hpp"
+#include "btree/internal_node.hpp"
+#include "btree/operations.hpp"
+#include "btree/slice.hpp"
+#include "serializer/config.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+struct bulk_load_test_value_t;
+
+// A value is a length byte followed by that many bytes.
+template <>
+class value_sizer_t<bulk_load_test_value_t> : public value_sizer_t<void> {
+public:
+    explicit value_sizer_t<bulk_load_test_value_t>(block_size_t bs) : block_size_(bs) { }
+
+    int size(const void *value) const {
+        return 1 + *static_cast<const uint8_t *>(value);
+    }
+
+    bool fits(const void *value, int length_available) const {
+        return length_available > 0 && size(value) <= length_available;
+    }
+
+    int max_possible_size() const {
+        return 256;
+    }
+
+    block_magic_t btree_leaf_magic() const {
+        block_magic_t magic = { { 'b', 'l', 'L', 'F' } };
+        return magic;
+    }
+
+    block_size_t block_size() const { return block_size_; }
+
+private:
+    block_size_t block_size_;
+
+    DISABLE_COPYING(value_sizer_t<bulk_load_test_value_t>);
+};
+
+namespace unittest {
+
+std::string bulk_load_test_key(int i) {
+    return strprintf("user/%08d", i);
+}
+
+std::string bulk_load_test_value(int i) {
+    return strprintf("value %d", i);
+}
+
+class bulk_load_test_source_t : public bulk_load_source_t {
+public:
+    explicit bulk_load_test_source_t(int _num_pairs) : i(0), num_pairs(_num_pairs) { }
+
+    bool next(UNUSED buf_parent_t parent, store_key_t *key_out, void *value_out) {
+        if (i == num_pairs) {
+            return false;
+        }
+        *key_out = store_key_t(bulk_load_test_key(i));
+        const std::string value = bulk_load_test_value(i);
+        uint8_t *out = static_cast<uint8_t *>(value_out);
+        out[0] = value.size();
+        memcpy(out + 1, value.data(), value.size());
+        ++i;
+        return true;
+    }
+
+private:
+    int i;
+    const int num_pairs;
+};
+
+// Checks that the subtree at `block_id` only has keys in (`left_excl`, `right_incl`],
+// appends its pairs to `pairs_out` and returns its height.
+int check_bulk_loaded_subtree(value_sizer_t<void> *sizer, buf_lock_t *parent,
+                              block_id_t block_id,
+                              const store_key_t *left_excl,
+                              const store_key_t *right_incl,
+                              std::vector<std::pair<std::string, std::string> > *pairs_out) {
+    buf_lock_t lock(parent, block_id, access_t::read);
+    buf_read_t read(&lock);
+    const node_t *node = static_cast<const node_t *>(read.get_data_read());
+    node::validate(sizer, node);
+
+    if (node::is_leaf(node)) {
+        const leaf_node_t *leaf = reinterpret_cast<const leaf_node_t *>(node);
+        for (auto it = leaf::begin(*leaf); it != leaf::end(*leaf); ++it) {
+            store_key_t key((*it).first);
+            EXPECT_TRUE(left_excl == NULL || *left_excl < key);
+            EXPECT_TRUE(right_incl == NULL || key <= *right_incl);
+            const uint8_t *value = static_cast<const uint8_t *>((*it).second);
+            pairs_out->push_back(std::make_pair(
+                key_to_unescaped_str(key),
+                std::string(reinterpret_cast<const char *>(value + 1), value[0])));
+        }
+        return 1;
+    }
+
+    const internal_node_t *inode = reinterpret_cast<const internal_node_t *>(node);
+    EXPECT_LE(2, inode->npairs);
+    int height = -1;
+    store_key_t left_key;
+    for (int i = 0; i < inode->npairs; ++i) {
+        const btree_internal_pair *pair = internal_node::get_pair_by_index(inode, i);
+        const bool is_last = i + 1 == inode->npairs;
+        store_key_t right_key(&pair->key);
+        int child_height = check_bulk_loaded_subtree(
+            sizer, &lock, pair->lnode,
+            i == 0 ? left_excl : &left_key,
+            is_last ? right_incl : &right_key,
+            pairs_out);
+        // All leaves are at the same depth.
+        EXPECT_TRUE(height == -1 || height == child_height);
+        height = child_height;
+        left_key = right_key;
+    }
+    return height + 1;
+}
+
+void run_bulk_load_test(int num_pairs) {
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    cache_t cache(&serializer, alt_cache_config_t(),
+                  &get_global_perfmon_collection());
+    cache_conn_t cache_conn(&cache);
+
+    {
+        txn_t txn(&cache_conn, write_durability_t::HARD, repli_timestamp_t::invalid, 1);
+        buf_lock_t superblock(&txn, SUPERBLOCK_ID, alt_create_t::create);
+        buf_write_t sb_write(&superblock);
+        btree_slice_t::init_superblock(&superblock,
+                                       std::vector<char>(), std::vector<char>());
+    }
+
+    value_sizer_t<bulk_load_test_value_t> sizer(cache.get_block_size());
+
+    {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        bulk_load_test_source_t source(num_pairs);
+        ASSERT_EQ(num_pairs, bulk_load_btree(&sizer, superblock.get(),
+                                             repli_timestamp_t::distant_past,
+                                             &source));
+    }
+
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    get_btree_superblock_and_txn_for_reading(&cache_conn, CACHE_SNAPSHOTTED_NO,
+                                             &superblock, &txn);
+    const block_id_t root_id = superblock->get_root_block_id();
+    if (num_pairs == 0) {
+        ASSERT_EQ(NULL_BLOCK_ID, root_id);
+        return;
+    }
+
+    std::vector<std::pair<std::string, std::string> > pairs;
+    int height = check_bulk_loaded_subtree(&sizer, superblock->get(), root_id,
+                                           NULL, NULL, &pairs);
+    ASSERT_EQ(static_cast<size_t>(num_pairs), pairs.size());
+    for (int i = 0; i < num_pairs; ++i) {
+        ASSERT_EQ(bulk_load_test_key(i), pairs[i].first);
+        ASSERT_EQ(bulk_load_test_value(i), pairs[i].second);
+    }
+    if (num_pairs >= 100000) {
+        ASSERT_LE(3, height);
+    }
+}
+
+TPTEST(BtreeKeySample, SamplesUniformlyFromAllLeaves) {
+    const int num_pairs = 100000;
+    const size_t sample_size = 1000;
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    cache_t cache(&serializer, alt_cache_config_t(),
+                  &get_global_perfmon_collection());
+    cache_conn_t cache_conn(&cache);
+
+    {
+        txn_t txn(&cache_conn, write_durability_t::HARD, repli_timestamp_t::invalid, 1);
+        buf_lock_t superblock(&txn, SUPERBLOCK_ID, alt_create_t::create);
+        buf_write_t sb_write(&superblock);
+        btree_slice_t::init_superblock(&superblock,
+                                       std::vector<char>(), std::vector<char>());
+    }
+
+    value_sizer_t<bulk_load_test_value_t> sizer(cache.get_block_size());
+
+    {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        bulk_load_test_source_t source(num_pairs);
+        ASSERT_EQ(num_pairs, bulk_load_btree(&sizer, superblock.get(),
+                                             repli_timestamp_t::distant_past,
+                                             &source));
+    }
+
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    get_btree_superblock_and_txn_for_reading(&cache_conn, CACHE_SNAPSHOTTED_NO,
+                                             &superblock, &txn);
+    int64_t key_count;
+    int64_t byte_count;
+    std::vector<std::pair<store_key_t, int64_t> > samples;
+    get_btree_key_sample(superblock.get(), sample_size,
+                         [&sizer](const btree_key_t *key, const void *value) {
+                             return static_cast<int64_t>(key->size + sizer.size(value));
+                         },
+                         &key_count, &byte_count, &samples);
+
+    ASSERT_EQ(num_pairs, key_count);
+    int64_t expected_bytes = 0;
+    for (int i = 0; i < num_pairs; ++i) {
+        expected_bytes += bulk_load_test_key(i).size() + 1
+            + bulk_load_test_value(i).size();
+    }
+    ASSERT_EQ(expected_bytes, byte_count);
+
+    ASSERT_EQ(sample_size, samples.size());
+    int in_first_half = 0;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        if (i > 0) {
+            ASSERT_TRUE(samples[i - 1].first < samples[i].first);
+        }
+        if (samples[i].first < store_key_t(bulk_load_test_key(num_pairs / 2))) {
+            ++in_first_half;
+        }
+    }
+    // The expected value is 500 and the standard deviation about 16.
+    EXPECT_LT(400, in_first_half);
+    EXPECT_GT(600, in_first_half);
+}
+
+TPTEST(BtreeKeySample, RandomWalksSampleUniformly) {
+    const int num_pairs = 100000;
+    const size_t sample_size = 1000;
+
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    cache_t cache(&serializer, alt_cache_config_t(),
+                  &get_global_perfmon_collection());
+    cache_conn_t cache_conn(&cache);
+
+    {
+        txn_t txn(&cache_conn, write_durability_t::HARD, repli_timestamp_t::invalid, 1);
+        buf_lock_t superblock(&txn, SUPERBLOCK_ID, alt_create_t::create);
+        buf_write_t sb_write(&superblock);
+        btree_slice_t::init_superblock(&superblock,
+                                       std::vector<char>(), std::vector<char>());
+    }
+
+    value_sizer_t<bulk_load_test_value_t> sizer(cache.get_block_size());
+
+    {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        bulk_load_test_source_t source(num_pairs);
+        ASSERT_EQ(num_pairs, bulk_load_btree(&sizer, superblock.get(),
+                                             repli_timestamp_t::distant_past,
+                                             &source));
+    }
+
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    get_btree_superblock_and_txn_for_reading(&cache_conn, CACHE_SNAPSHOTTED_NO,
+                                             &superblock, &txn);
+    int64_t key_count;
+    std::vector<store_key_t> samples;
+    get_btree_random_sample(superblock.get(), sample_size, 10 * sample_size,
+                            [&samples](const btree_key_t *key, const void *,
+                                       buf_lock_t *) {
+                                samples.push_back(store_key_t(key));
+                                return true;
+                            },
+                            &key_count);
+
+    ASSERT_EQ(num_pairs, key_count);
+    ASSERT_EQ(sample_size, samples.size());
+    std::sort(samples.begin(), samples.end());
+    int in_first_half = 0;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        if (i > 0) {
+            ASSERT_TRUE(samples[i - 1] < samples[i]);
+        }
+        if (samples[i] < store_key_t(bulk_load_test_key(num_pairs / 2))) {
+            ++in_first_half;
+        }
+    }
+    // The expected value is 500 and the standard deviation about 16.
+    EXPECT_LT(400, in_first_half);
+    EXPECT_GT(600, in_first_half);
+}
+
+TPTEST(BtreeBulkLoad, Empty) {
+    run_bulk_load_test(0);
+}
+
+TPTEST(BtreeBulkLoad, OneLeaf) {
+    run_bulk_load_test(10);
+}
+
+TPTEST(BtreeBulkLoad, ManyLevels) {
+    run_bulk_load_test(100000);
+}
+
+}  // namespace unittest
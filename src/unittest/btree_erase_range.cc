@@ -0,0 +1,224 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string>
+#include <vector>
+
+#include "arch/io/disk.hpp"
+#include "arch/timing.hpp"
+#include "btree/erase_range.hpp"
+#include "btree/internal_node.hpp"
+#include "btree/operations.hpp"
+#include "btree/slice.hpp"
+#include "btree/subtree_eraser.hpp"
+#include "concurrency/cond_var.hpp"
+#include "serializer/config.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+struct erase_range_test_value_t;
+
+// A value is a length byte followed by that many bytes.
+template <>
+class value_sizer_t<erase_range_test_value_t> : public value_sizer_t<void> {
+public:
+    explicit value_sizer_t<erase_range_test_value_t>(block_size_t bs) : block_size_(bs) { }
+
+    int size(const void *value) const {
+        return 1 + *static_cast<const uint8_t *>(value);
+    }
+
+    bool fits(const void *value, int length_available) const {
+        return length_available > 0 && size(value) <= length_available;
+    }
+
+    int max_possible_size() const {
+        return 256;
+    }
+
+    block_magic_t btree_leaf_magic() const {
+        block_magic_t magic = { { 'e', 'r', 'L', 'F' } };
+        return magic;
+    }
+
+    block_size_t block_size() const { return block_size_; }
+
+private:
+    block_size_t block_size_;
+
+    DISABLE_COPYING(value_sizer_t<erase_range_test_value_t>);
+};
+
+namespace unittest {
+
+std::string erase_range_test_key(int i) {
+    return strprintf("user/%08d", i);
+}
+
+class erase_range_test_source_t : public bulk_load_source_t {
+public:
+    explicit erase_range_test_source_t(int _num_pairs) : i(0), num_pairs(_num_pairs) { }
+
+    bool next(UNUSED buf_parent_t parent, store_key_t *key_out, void *value_out) {
+        if (i == num_pairs) {
+            return false;
+        }
+        *key_out = store_key_t(erase_range_test_key(i));
+        uint8_t *out = static_cast<uint8_t *>(value_out);
+        out[0] = 1;
+        out[1] = 'v';
+        ++i;
+        return true;
+    }
+
+private:
+    int i;
+    const int num_pairs;
+};
+
+class counting_value_deleter_t : public value_deleter_t {
+public:
+    counting_value_deleter_t() : num_deleted(0) { }
+    void delete_value(UNUSED buf_parent_t leaf_node, UNUSED const void *value) const {
+        ++num_deleted;
+    }
+    mutable int num_deleted;
+};
+
+void collect_erase_range_test_keys(value_sizer_t<void> *sizer, buf_lock_t *parent,
+                                   block_id_t block_id,
+                                   std::vector<std::string> *keys_out) {
+    buf_lock_t lock(parent, block_id, access_t::read);
+    buf_read_t read(&lock);
+    const node_t *node = static_cast<const node_t *>(read.get_data_read());
+    node::validate(sizer, node);
+
+    if (node::is_leaf(node)) {
+        const leaf_node_t *leaf = reinterpret_cast<const leaf_node_t *>(node);
+        for (auto it = leaf::begin(*leaf); it != leaf::end(*leaf); ++it) {
+            keys_out->push_back(key_to_unescaped_str(store_key_t((*it).first)));
+        }
+        return;
+    }
+
+    const internal_node_t *inode = reinterpret_cast<const internal_node_t *>(node);
+    EXPECT_LE(2, inode->npairs);
+    for (int i = 0; i < inode->npairs; ++i) {
+        collect_erase_range_test_keys(sizer, &lock,
+                                      internal_node::get_pair_by_index(inode, i)->lnode,
+                                      keys_out);
+    }
+}
+
+// Erases the keys in (`left`, `right`] from a tree of `num_pairs` keys, with -1
+// standing for an unbounded side.
+void run_erase_range_test(int num_pairs, int left, int right) {
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    cache_t cache(&serializer, alt_cache_config_t(),
+                  &get_global_perfmon_collection());
+    cache_conn_t cache_conn(&cache);
+
+    {
+        txn_t txn(&cache_conn, write_durability_t::HARD, repli_timestamp_t::invalid, 1);
+        buf_lock_t superblock(&txn, SUPERBLOCK_ID, alt_create_t::create);
+        buf_write_t sb_write(&superblock);
+        btree_slice_t::init_superblock(&superblock,
+                                       std::vector<char>(), std::vector<char>());
+    }
+
+    value_sizer_t<erase_range_test_value_t> sizer(cache.get_block_size());
+
+    {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        erase_range_test_source_t source(num_pairs);
+        ASSERT_EQ(num_pairs, bulk_load_btree(&sizer, superblock.get(),
+                                             repli_timestamp_t::distant_past,
+                                             &source));
+    }
+
+    counting_value_deleter_t deleter;
+    background_subtree_eraser_t eraser(&cache, &sizer, &deleter);
+
+    {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        const store_key_t left_key(erase_range_test_key(left));
+        const store_key_t right_key(erase_range_test_key(right));
+        const btree_key_t *left_or_null = left == -1 ? NULL : left_key.btree_key();
+        const btree_key_t *right_or_null = right == -1 ? NULL : right_key.btree_key();
+
+        always_true_key_tester_t tester;
+        cond_t non_interruptor;
+        btree_detach_erased_subtrees(&sizer, left_or_null, right_or_null,
+                                     superblock.get(), &eraser);
+        btree_erase_range_generic(&sizer, &tester, &deleter,
+                                  left_or_null, right_or_null,
+                                  superblock.get(), &non_interruptor);
+    }
+
+    while (!eraser.is_idle()) {
+        nap(10);
+    }
+
+    std::vector<std::string> expected_keys;
+    for (int i = 0; i < num_pairs; ++i) {
+        if ((left != -1 && i <= left) || (right != -1 && i > right)) {
+            expected_keys.push_back(erase_range_test_key(i));
+        }
+    }
+    ASSERT_EQ(num_pairs - static_cast<int>(expected_keys.size()), deleter.num_deleted);
+
+    {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn_for_reading(&cache_conn, CACHE_SNAPSHOTTED_NO,
+                                                 &superblock, &txn);
+        ASSERT_EQ(static_cast<int64_t>(expected_keys.size()),
+                  get_btree_population(superblock.get()));
+    }
+
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    get_btree_superblock_and_txn_for_reading(&cache_conn, CACHE_SNAPSHOTTED_NO,
+                                             &superblock, &txn);
+    const block_id_t root_id = superblock->get_root_block_id();
+    std::vector<std::string> keys;
+    if (root_id != NULL_BLOCK_ID) {
+        collect_erase_range_test_keys(&sizer, superblock->get(), root_id, &keys);
+    }
+    ASSERT_EQ(expected_keys, keys);
+}
+
+TPTEST(BtreeEraseRange, DetachesMiddleSubtrees) {
+    run_erase_range_test(100000, 20000, 80000);
+}
+
+TPTEST(BtreeEraseRange, DetachesWholeTree) {
+    run_erase_range_test(100000, -1, -1);
+}
+
+TPTEST(BtreeEraseRange, DetachesRightSide) {
+    run_erase_range_test(100000, 500, -1);
+}
+
+}  // namespace unittest
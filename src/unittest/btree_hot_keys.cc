@@ -0,0 +1,45 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "btree/hot_keys.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(SpaceSavingSketch, FindsHeavyHitters) {
+    space_saving_sketch_t<int> sketch(8);
+    // Items 0 and 1 make up half of the stream; the rest are all different.
+    for (int i = 0; i < 1000; ++i) {
+        sketch.record(i % 2, i % 2 == 0 ? access_t::write : access_t::read);
+        sketch.record(1000 + i, access_t::read);
+    }
+
+    std::vector<std::pair<int, space_saving_sketch_t<int>::counter_t> > top
+        = sketch.top(2);
+    ASSERT_EQ(2u, top.size());
+    EXPECT_EQ(1, top[0].first + top[1].first);
+    for (size_t i = 0; i < top.size(); ++i) {
+        const uint64_t actual = 500;
+        EXPECT_LE(top[i].second.count - top[i].second.error, actual);
+        EXPECT_GE(top[i].second.count, actual);
+    }
+}
+
+TEST(SpaceSavingSketch, CountsWritesAndDecays) {
+    space_saving_sketch_t<int> sketch(4);
+    for (int i = 0; i < 10; ++i) {
+        sketch.record(7, i < 4 ? access_t::write : access_t::read);
+    }
+    std::vector<std::pair<int, space_saving_sketch_t<int>::counter_t> > top
+        = sketch.top(10);
+    ASSERT_EQ(1u, top.size());
+    EXPECT_EQ(7, top[0].first);
+    EXPECT_EQ(10u, top[0].second.count);
+    EXPECT_EQ(0u, top[0].second.error);
+    EXPECT_EQ(4u, top[0].second.writes);
+
+    sketch.decay();
+    top = sketch.top(10);
+    EXPECT_EQ(5u, top[0].second.count);
+    EXPECT_EQ(2u, top[0].second.writes);
+}
+
+}  // namespace unittest
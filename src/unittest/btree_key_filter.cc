@@ -0,0 +1,65 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "btree/key_filter.hpp"
+#include "config/args.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+static store_key_t key_for(int i) {
+    return store_key_t(strprintf("key%d", i));
+}
+
+TPTEST(KeyFilter, NoFalseNegatives) {
+    key_filter_t filter;
+    // Until it's built, the filter can't rule anything out.
+    EXPECT_TRUE(filter.get_rebuild_wanted()->is_pulsed());
+    EXPECT_TRUE(filter.may_contain(key_for(0).btree_key()));
+
+    ASSERT_TRUE(filter.start_building(10000));
+    EXPECT_FALSE(filter.get_rebuild_wanted()->is_pulsed());
+    for (int i = 0; i < 5000; ++i) {
+        filter.add_built_key(key_for(i).btree_key());
+    }
+    // A write that comes in while the filter is being built.
+    filter.note_key(key_for(5000).btree_key());
+    EXPECT_FALSE(filter.is_ready());
+    filter.finish_building();
+    ASSERT_TRUE(filter.is_ready());
+
+    // And one that comes in afterwards.
+    filter.note_key(key_for(5001).btree_key());
+
+    for (int i = 0; i <= 5001; ++i) {
+        EXPECT_TRUE(filter.may_contain(key_for(i).btree_key()));
+    }
+
+    int false_positives = 0;
+    for (int i = 100000; i < 110000; ++i) {
+        false_positives += filter.may_contain(key_for(i).btree_key()) ? 1 : 0;
+    }
+    EXPECT_LT(false_positives, 300);
+}
+
+TPTEST(KeyFilter, AsksForRebuildWhenFull) {
+    key_filter_t filter;
+    ASSERT_TRUE(filter.start_building(0));
+    filter.finish_building();
+    EXPECT_FALSE(filter.get_rebuild_wanted()->is_pulsed());
+
+    for (int i = 0; i < KEY_FILTER_MIN_KEYS; ++i) {
+        filter.note_key(key_for(i).btree_key());
+    }
+    EXPECT_FALSE(filter.get_rebuild_wanted()->is_pulsed());
+    filter.note_key(key_for(KEY_FILTER_MIN_KEYS).btree_key());
+    EXPECT_TRUE(filter.get_rebuild_wanted()->is_pulsed());
+
+    // The old filter keeps answering while the new one gets built.
+    ASSERT_TRUE(filter.start_building(KEY_FILTER_MIN_KEYS + 1));
+    EXPECT_TRUE(filter.may_contain(key_for(0).btree_key()));
+    filter.abandon_building();
+    EXPECT_TRUE(filter.is_ready());
+    EXPECT_TRUE(filter.get_rebuild_wanted()->is_pulsed());
+}
+
+}  // namespace unittest
@@ -0,0 +1,71 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <map>
+#include <string>
+#include <vector>
+
+#include "unittest/gtest.hpp"
+
+#include "rdb_protocol/changefeed.hpp"
+#include "rpc/connectivity/cluster.hpp"
+#include "rpc/mailbox/mailbox.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+using ql::changefeed::feed_t;
+using ql::changefeed::server_t;
+
+static counted_t<const ql::datum_t> row(double id) {
+    std::map<std::string, counted_t<const ql::datum_t> > obj;
+    obj["id"] = make_counted<ql::datum_t>(id);
+    return make_counted<ql::datum_t>(std::move(obj));
+}
+
+TPTEST(ChangefeedTest, SendsChanges) {
+    connectivity_cluster_t c;
+    mailbox_manager_t m(&c);
+    connectivity_cluster_t::run_t r(&c, get_unittest_addresses(), peer_address_t(), ANY_PORT, &m, 0, NULL);
+
+    server_t server(&m);
+    feed_t feed(&m);
+    server.add_client(feed.get_addr());
+    feed.add_servers(std::vector<ql::changefeed::server_addr_t>(
+                         1, server.get_stop_addr()));
+
+    server.send_change(counted_t<const ql::datum_t>(), row(1));
+    // Writes that don't change the row aren't sent.
+    server.send_change(row(2), row(2));
+    server.send_change(row(1), counted_t<const ql::datum_t>());
+
+    cond_t non_interruptor;
+    std::vector<counted_t<const ql::datum_t> > changes;
+    while (changes.size() < 2) {
+        std::vector<counted_t<const ql::datum_t> > more
+            = feed.wait_for_changes(&non_interruptor);
+        changes.insert(changes.end(), more.begin(), more.end());
+    }
+    ASSERT_EQ(2u, changes.size());
+    EXPECT_EQ(ql::datum_t::R_NULL, changes[0]->get("old_val")->get_type());
+    EXPECT_EQ(*row(1), *changes[0]->get("new_val"));
+    EXPECT_EQ(*row(1), *changes[1]->get("old_val"));
+    EXPECT_EQ(ql::datum_t::R_NULL, changes[1]->get("new_val")->get_type());
+}
+
+TPTEST(ChangefeedTest, FailsWhenServerGoesAway) {
+    connectivity_cluster_t c;
+    mailbox_manager_t m(&c);
+    connectivity_cluster_t::run_t r(&c, get_unittest_addresses(), peer_address_t(), ANY_PORT, &m, 0, NULL);
+
+    feed_t feed(&m);
+    {
+        server_t server(&m);
+        server.add_client(feed.get_addr());
+        feed.add_servers(std::vector<ql::changefeed::server_addr_t>(
+                             1, server.get_stop_addr()));
+    }
+
+    cond_t non_interruptor;
+    EXPECT_THROW(feed.wait_for_changes(&non_interruptor), ql::datum_exc_t);
+}
+
+}  // namespace unittest
@@ -162,6 +162,64 @@ TEST(ClusteringBranch, ReadWrite) {
     run_in_thread_pool_with_broadcaster(&run_read_write_test);
 }
 
+/* The `BatchedWrites` test sends a burst of writes without waiting for any of them,
+so that the broadcaster sends them to the mirror in batches. Every write should be
+answered once, and they should be performed in order. */
+
+class counting_write_callback_t : public broadcaster_t<dummy_protocol_t>::write_callback_t {
+public:
+    counting_write_callback_t() : responses(0) { }
+    void on_response(peer_id_t, const dummy_protocol_t::write_response_t &) {
+        ++responses;
+    }
+    void on_done() {
+        done.pulse();
+    }
+    int responses;
+    cond_t done;
+};
+
+void run_batched_writes_test(UNUSED io_backender_t *io_backender,
+                             simple_mailbox_cluster_t *cluster,
+                             branch_history_manager_t<dummy_protocol_t> *branch_history_manager,
+                             UNUSED clone_ptr_t<watchable_t<boost::optional<broadcaster_business_card_t<dummy_protocol_t> > > > broadcaster_metadata_view,
+                             scoped_ptr_t<broadcaster_t<dummy_protocol_t> > *broadcaster,
+                             test_store_t<dummy_protocol_t> *store,
+                             scoped_ptr_t<listener_t<dummy_protocol_t> > *initial_listener,
+                             order_source_t *order_source) {
+    replier_t<dummy_protocol_t> replier(initial_listener->get(), cluster->get_mailbox_manager(), branch_history_manager);
+    let_stuff_happen();
+
+    // More than fit in one batch, and several writes to each key.
+    const int num_writes = 200;
+    counting_write_callback_t callbacks[num_writes];
+    std::map<std::string, std::string> values_inserted;
+    for (int i = 0; i < num_writes; i++) {
+        unittest::fake_fifo_enforcement_t enforce;
+        fifo_enforcer_sink_t::exit_write_t exiter(&enforce.sink, enforce.source.enter_write());
+
+        dummy_protocol_t::write_t w;
+        std::string key = std::string(1, 'a' + i % 26);
+        w.values[key] = values_inserted[key] = strprintf("%d", i);
+        cond_t non_interruptor;
+        spawn_write_fake_ack_checker_t ack_checker;
+        (*broadcaster)->spawn_write(w, &exiter, order_source->check_in("unittest::run_batched_writes_test(write)"), &callbacks[i], &non_interruptor, &ack_checker);
+    }
+
+    for (int i = 0; i < num_writes; i++) {
+        callbacks[i].done.wait_lazily_unordered();
+        EXPECT_EQ(1, callbacks[i].responses);
+    }
+    for (std::map<std::string, std::string>::iterator it = values_inserted.begin();
+            it != values_inserted.end(); it++) {
+        EXPECT_EQ(it->second, store->store.values[it->first]);
+    }
+}
+
+TEST(ClusteringBranch, BatchedWrites) {
+    run_in_thread_pool_with_broadcaster(&run_batched_writes_test);
+}
+
 /* The `Backfill` test starts up a node with one mirror, inserts some data, and
 then adds another mirror. */
 
@@ -17,7 +17,7 @@ public:
     directory_echo_cluster_t(const metadata_t &initial, int port) :
         connectivity_cluster(),
         message_multiplexer(&connectivity_cluster),
-        heartbeat_manager_client(&message_multiplexer, 'H'),
+        heartbeat_manager_client(&message_multiplexer, 'H', message_priority_t::CONTROL),
         heartbeat_manager(&heartbeat_manager_client),
         heartbeat_manager_client_run(&heartbeat_manager_client, &heartbeat_manager),
         mailbox_manager_client(&message_multiplexer, 'M'),
@@ -51,10 +51,66 @@ TEST(ClusteringSuggester, NewNamespace) {
         machine_data_centers,
         region_map_t<dummy_protocol_t, machine_id_t>(dummy_protocol_t::region_t::universe(), nil_uuid()),
         region_map_t<dummy_protocol_t, std::set<machine_id_t> >(),
+        std::map<dummy_protocol_t::region_t, double>(),
         &usage,
         true);
 
     EXPECT_EQ(machines.size(), blueprint.machines_roles.size());
 }
 
+TEST(ClusteringSuggester, ShardLoads) {
+    datacenter_id_t datacenter = generate_uuid();
+
+    std::vector<machine_id_t> machines;
+    std::map<machine_id_t, reactor_business_card_t<dummy_protocol_t> > directory;
+    std::map<machine_id_t, datacenter_id_t> machine_data_centers;
+    for (int i = 0; i < 4; i++) {
+        machines.push_back(generate_uuid());
+        reactor_business_card_t<dummy_protocol_t> rb;
+        rb.activities[generate_uuid()] = reactor_business_card_t<dummy_protocol_t>::activity_entry_t(a_thru_z_region(), reactor_business_card_t<dummy_protocol_t>::nothing_t());
+        directory[machines[i]] = rb;
+        machine_data_centers[machines[i]] = datacenter;
+    }
+
+    std::map<datacenter_id_t, int> affinities;
+    affinities[datacenter] = 1;
+
+    /* Two hot shards and six cold ones. Counting shards would give every machine
+    two primaries; counting load must keep the hot shards' primaries apart. */
+    nonoverlapping_regions_t<dummy_protocol_t> shards;
+    std::map<dummy_protocol_t::region_t, double> shard_loads;
+    std::vector<dummy_protocol_t::region_t> hot_shards;
+    for (char c = 'a'; c < 'i'; c++) {
+        dummy_protocol_t::region_t shard(c, c);
+        ASSERT_TRUE(shards.add_region(shard));
+        shard_loads[shard] = c < 'c' ? 100 : 1;
+        if (c < 'c') {
+            hot_shards.push_back(shard);
+        }
+    }
+
+    std::map<machine_id_t, int> usage;
+    persistable_blueprint_t<dummy_protocol_t> blueprint = suggest_blueprint<dummy_protocol_t>(
+        directory,
+        datacenter,
+        affinities,
+        shards,
+        machine_data_centers,
+        region_map_t<dummy_protocol_t, machine_id_t>(dummy_protocol_t::region_t::universe(), nil_uuid()),
+        region_map_t<dummy_protocol_t, std::set<machine_id_t> >(),
+        shard_loads,
+        &usage,
+        true);
+
+    for (auto it = blueprint.machines_roles.begin(); it != blueprint.machines_roles.end(); ++it) {
+        int hot_primaries = 0;
+        for (size_t i = 0; i < hot_shards.size(); ++i) {
+            if (it->second[hot_shards[i]] == blueprint_role_primary) {
+                ++hot_primaries;
+            }
+        }
+        EXPECT_LE(hot_primaries, 1);
+    }
+}
+
 }  // namespace unittest
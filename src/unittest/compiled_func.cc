@@ -0,0 +1,97 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/compiled_func.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+typedef ql::filter_predicate_t::result_t result_t;
+
+counted_t<const ql::datum_t> compiled_func_row(const char *json) {
+    scoped_cJSON_t parsed(cJSON_Parse(json));
+    return make_counted<const ql::datum_t>(parsed);
+}
+
+std::vector<ql::sym_t> compiled_func_args() {
+    return std::vector<ql::sym_t>(
+        1, ql::pb::dummy_var_to_sym(ql::pb::dummy_var_t::IGNORED));
+}
+
+scoped_ptr_t<ql::filter_predicate_t> compile_test_predicate(ql::r::reql_t &&body) {
+    return ql::compile_filter_predicate(compiled_func_args(), body.get());
+}
+
+TEST(FilterPredicate, ComparesFields) {
+    const ql::pb::dummy_var_t x = ql::pb::dummy_var_t::IGNORED;
+    scoped_ptr_t<ql::filter_predicate_t> pred = compile_test_predicate(
+        (ql::r::var(x)[std::string("a")] + ql::r::expr(1.0) > ql::r::expr(2.0))
+        && ql::r::var(x).has_fields(std::string("b")));
+    ASSERT_TRUE(pred.has());
+
+    EXPECT_EQ(result_t::MATCH, pred->test(compiled_func_row("{\"a\": 2, \"b\": 0}")));
+    EXPECT_EQ(result_t::NO_MATCH, pred->test(compiled_func_row("{\"a\": 1, \"b\": 0}")));
+    EXPECT_EQ(result_t::NO_MATCH, pred->test(compiled_func_row("{\"a\": 2, \"b\": null}")));
+    // Evaluating the function would raise errors for these.
+    EXPECT_EQ(result_t::UNKNOWN, pred->test(compiled_func_row("{\"b\": 0}")));
+    EXPECT_EQ(result_t::UNKNOWN, pred->test(compiled_func_row("{\"a\": \"2\"}")));
+}
+
+TEST(FilterPredicate, ObjectShortcut) {
+    scoped_ptr_t<ql::filter_predicate_t> pred = compile_test_predicate(
+        ql::r::expr(*compiled_func_row("{\"a\": 1, \"o\": {\"b\": \"x\"}}")));
+    ASSERT_TRUE(pred.has());
+
+    EXPECT_EQ(result_t::MATCH,
+              pred->test(compiled_func_row("{\"a\": 1, \"o\": {\"b\": \"x\", \"c\": 2}}")));
+    EXPECT_EQ(result_t::NO_MATCH,
+              pred->test(compiled_func_row("{\"a\": 1, \"o\": {\"b\": \"y\"}}")));
+    EXPECT_EQ(result_t::UNKNOWN, pred->test(compiled_func_row("{\"o\": {}}")));
+}
+
+TEST(FilterPredicate, RefusesUnknownTerms) {
+    const ql::pb::dummy_var_t x = ql::pb::dummy_var_t::IGNORED;
+    const ql::pb::dummy_var_t y = ql::pb::dummy_var_t::INNERJOIN_N;
+    EXPECT_FALSE(compile_test_predicate(
+        ql::r::var(x)[std::string("a")] == ql::r::var(y)).has());
+    EXPECT_FALSE(compile_test_predicate(
+        ql::r::var(x).contains(ql::r::expr(1.0))).has());
+}
+
+TEST(MapFunction, ComputesValues) {
+    const ql::pb::dummy_var_t x = ql::pb::dummy_var_t::IGNORED;
+    ql::r::reql_t body = ql::r::var(x)[std::string("a")] + ql::r::expr(3.0);
+    scoped_ptr_t<ql::map_function_t> fn
+        = ql::compile_map_function(compiled_func_args(), body.get());
+    ASSERT_TRUE(fn.has());
+
+    counted_t<const ql::datum_t> out;
+    ASSERT_TRUE(fn->apply(compiled_func_row("{\"a\": 3}"), &out));
+    EXPECT_EQ(6, out->as_num());
+    EXPECT_FALSE(fn->apply(compiled_func_row("{\"a\": [3]}"), &out));
+
+    ql::r::reql_t field = ql::r::var(x)[std::string("o")];
+    fn = ql::compile_map_function(compiled_func_args(), field.get());
+    ASSERT_TRUE(fn.has());
+    counted_t<const ql::datum_t> row = compiled_func_row("{\"o\": {\"b\": 1}}");
+    ASSERT_TRUE(fn->apply(row, &out));
+    // Fields of the row aren't copied.
+    EXPECT_EQ(row->get("o").get(), out.get());
+}
+
+TEST(MapFunction, BranchesOnBooleans) {
+    const ql::pb::dummy_var_t x = ql::pb::dummy_var_t::IGNORED;
+    ql::r::reql_t body(Term::BRANCH, ql::r::var(x)[std::string("c")],
+                       ql::r::expr(1.0), ql::r::expr(2.0));
+    scoped_ptr_t<ql::map_function_t> fn
+        = ql::compile_map_function(compiled_func_args(), body.get());
+    ASSERT_TRUE(fn.has());
+
+    counted_t<const ql::datum_t> out;
+    ASSERT_TRUE(fn->apply(compiled_func_row("{\"c\": false}"), &out));
+    EXPECT_EQ(2, out->as_num());
+    // `branch` takes this as true, but it's left to the term.
+    EXPECT_FALSE(fn->apply(compiled_func_row("{\"c\": 0}"), &out));
+}
+
+}  // namespace unittest
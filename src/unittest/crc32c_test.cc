@@ -0,0 +1,48 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include <string>
+
+#include "unittest/gtest.hpp"
+
+#include "arch/crc32c.hpp"
+
+namespace unittest {
+
+TEST(Crc32cTest, KnownValues) {
+    ASSERT_EQ(0u, crc32c("", 0));
+    ASSERT_EQ(0xe3069283u, crc32c("123456789", 9));
+
+    char zeros[32];
+    memset(zeros, 0, sizeof(zeros));
+    ASSERT_EQ(0x8a9136aau, crc32c(zeros, sizeof(zeros)));
+
+    char ones[32];
+    memset(ones, 0xff, sizeof(ones));
+    ASSERT_EQ(0x62a8ab43u, crc32c(ones, sizeof(ones)));
+}
+
+TEST(Crc32cTest, Extend) {
+    const std::string s = "The quick brown fox jumps over the lazy dog, twice over.";
+    const uint32_t whole = crc32c(s.data(), s.size());
+    for (size_t i = 0; i <= s.size(); ++i) {
+        SCOPED_TRACE(i);
+        ASSERT_EQ(whole, crc32c_extend(crc32c(s.data(), i), s.data() + i, s.size() - i));
+    }
+}
+
+TEST(Crc32cTest, DetectsBitFlips) {
+    char buf[4096];
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+        buf[i] = static_cast<char>(i * 7);
+    }
+    const uint32_t crc = crc32c(buf, sizeof(buf));
+    for (size_t i = 0; i < sizeof(buf); i += 97) {
+        buf[i] ^= 0x10;
+        ASSERT_NE(crc, crc32c(buf, sizeof(buf)));
+        buf[i] ^= 0x10;
+    }
+    ASSERT_EQ(crc, crc32c(buf, sizeof(buf)));
+}
+
+}  // namespace unittest
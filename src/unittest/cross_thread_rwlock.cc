@@ -0,0 +1,77 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <functional>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/cond_var.hpp"
+#include "concurrency/cross_thread_rwlock.hpp"
+#include "threading.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+void hold_cross_thread_rwlock(cross_thread_rwlock_t *lock, access_t access,
+                              cond_t *acquired, cond_t *release) {
+    cross_thread_rwlock_t::acq_t acq(lock, access);
+    acquired->pulse();
+    release->wait();
+}
+
+TPTEST(CrossThreadRWLock, ReadersOnManyThreads, 3) {
+    cross_thread_rwlock_t lock;
+    cross_thread_rwlock_t::acq_t read0(&lock, access_t::read);
+    {
+        on_thread_t thread_switcher(threadnum_t(1));
+        // Doesn't wait for the reader on thread 0.
+        cross_thread_rwlock_t::acq_t read1(&lock, access_t::read);
+        cross_thread_rwlock_t::acq_t read1_again(&lock, access_t::read);
+    }
+    // The reader can leave from another thread than the one it came in on.
+    cross_thread_rwlock_t::acq_t read2(&lock, access_t::read);
+    on_thread_t thread_switcher(threadnum_t(2));
+    read2.reset();
+}
+
+TPTEST(CrossThreadRWLock, PhaseFair) {
+    cross_thread_rwlock_t lock;
+    scoped_ptr_t<cross_thread_rwlock_t::acq_t> read1(
+        new cross_thread_rwlock_t::acq_t(&lock, access_t::read));
+
+    // The first writer waits for the reader that's in.
+    cond_t write1_acquired, write1_release;
+    coro_t::spawn_sometime(std::bind(&hold_cross_thread_rwlock, &lock, access_t::write,
+                                     &write1_acquired, &write1_release));
+    let_stuff_happen();
+    EXPECT_FALSE(write1_acquired.is_pulsed());
+
+    // A reader that comes after it waits for it.
+    cond_t read2_acquired, read2_release;
+    coro_t::spawn_sometime(std::bind(&hold_cross_thread_rwlock, &lock, access_t::read,
+                                     &read2_acquired, &read2_release));
+    let_stuff_happen();
+    EXPECT_FALSE(read2_acquired.is_pulsed());
+
+    read1.reset();
+    write1_acquired.wait();
+    EXPECT_FALSE(read2_acquired.is_pulsed());
+
+    // A second writer in line doesn't get ahead of the waiting reader.
+    cond_t write2_acquired, write2_release;
+    coro_t::spawn_sometime(std::bind(&hold_cross_thread_rwlock, &lock, access_t::write,
+                                     &write2_acquired, &write2_release));
+    let_stuff_happen();
+
+    write1_release.pulse();
+    read2_acquired.wait();
+    let_stuff_happen();
+    EXPECT_FALSE(write2_acquired.is_pulsed());
+
+    read2_release.pulse();
+    write2_acquired.wait();
+    write2_release.pulse();
+
+    // Nothing is left holding the lock.
+    cross_thread_rwlock_t::acq_t write3(&lock, access_t::write);
+}
+
+}  // namespace unittest
@@ -65,4 +65,38 @@ TPTEST(CrossThreadWatchable, CrossThreadWatchableTest) {
     }
 }
 
+void count_change(int *count) {
+    ++*count;
+}
+
+TPTEST(CrossThreadWatchable, CoalescesChanges, 2) {
+    watchable_variable_t<int> watchable(0);
+    cross_thread_watchable_variable_t<int> ctw(watchable.get_watchable(), threadnum_t(1));
+
+    int changes_seen = 0;
+    scoped_ptr_t<watchable_t<int>::subscription_t> subs;
+    {
+        on_thread_t thread_switcher(threadnum_t(1));
+        clone_ptr_t<watchable_t<int> > w = ctw.get_watchable();
+        watchable_t<int>::freeze_t freeze(w);
+        subs.init(new watchable_t<int>::subscription_t(
+            boost::bind(&count_change, &changes_seen), w, &freeze));
+    }
+
+    // Nothing yields between these, so only the first value and the last one
+    // should make it over.
+    for (int i = 1; i <= 100; ++i) {
+        watchable.set_value(i);
+    }
+
+    {
+        on_thread_t thread_switcher(threadnum_t(1));
+        signal_timer_t timer;
+        timer.start(5000);
+        ctw.get_watchable()->run_until_satisfied(boost::bind(&equals, 100, _1), &timer);
+        EXPECT_LE(changes_seen, 2);
+        subs.reset();
+    }
+}
+
 } //namespace unittest
@@ -1,7 +1,9 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 
 #include "containers/archive/string_stream.hpp"
+#include "containers/buffer_group.hpp"
 #include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/response_writer.hpp"
 #include "unittest/gtest.hpp"
 
 
@@ -62,6 +64,275 @@ TEST(DatumTest, NumericSerialization) {
     test_datum_serialization(make_counted<ql::datum_t>(std::move(vec)));
 }
 
+TEST(DatumTest, ObjectFields) {
+    scoped_cJSON_t json(cJSON_Parse("{\"b\": 2, \"c\": 3, \"a\": 1}"));
+    counted_t<const ql::datum_t> d = make_counted<const ql::datum_t>(json);
 
+    // The fields are kept sorted by key, whatever order they came in.
+    const ql::datum_object_t &obj = d->as_object();
+    ASSERT_EQ(3u, obj.size());
+    std::string keys;
+    for (auto it = obj.begin(); it != obj.end(); ++it) {
+        keys += it->first;
+    }
+    EXPECT_EQ("abc", keys);
+    EXPECT_EQ(2, d->get("b")->as_num());
+    EXPECT_FALSE(d->get("d", ql::NOTHROW).has());
+
+    ql::datum_ptr_t copy(d->as_object());
+    EXPECT_FALSE(copy.add("d", make_counted<const ql::datum_t>(4.0)));
+    EXPECT_TRUE(copy.add("a", make_counted<const ql::datum_t>(5.0), ql::NOCLOBBER));
+    EXPECT_TRUE(copy.delete_field("b"));
+    EXPECT_FALSE(copy.delete_field("b"));
+    counted_t<const ql::datum_t> changed = copy.to_counted();
+    EXPECT_EQ(3u, changed->as_object().size());
+    EXPECT_EQ(1, changed->get("a")->as_num());
+    EXPECT_FALSE(changed->get("b", ql::NOTHROW).has());
+    EXPECT_EQ(4, changed->get("d")->as_num());
+    test_datum_serialization(changed);
+
+    ql::datum_object_t dupes;
+    std::vector<ql::datum_object_t::value_type> fields;
+    fields.push_back(std::make_pair(std::string("x"), d));
+    fields.push_back(std::make_pair(std::string("x"), d));
+    std::string duplicate_key;
+    EXPECT_FALSE(dupes.assign(std::move(fields), &duplicate_key));
+    EXPECT_EQ("x", duplicate_key);
+}
+
+TEST(DatumTest, OrderKeys) {
+    const char *jsons[] = { "[]", "[null]", "[1]", "[1, 2]", "[[]]", "[\"a\"]",
+                            "false", "true", "null", "-1e300", "-2.5", "0", "-0",
+                            "1", "3.25", "1e300", "{}", "{\"a\": 1}",
+                            "{\"a\": 1, \"b\": 2}", "{\"a\": 2}", "{\"b\": null}",
+                            "\"\"", "\"a\"", "\"ab\"", "\"b\"" };
+    std::vector<counted_t<const ql::datum_t> > data;
+    for (size_t i = 0; i < sizeof(jsons) / sizeof(jsons[0]); ++i) {
+        scoped_cJSON_t json(cJSON_Parse(jsons[i]));
+        data.push_back(make_counted<const ql::datum_t>(json));
+    }
+    // Strings with NULs in them, which cJSON can't parse.
+    data.push_back(make_counted<const ql::datum_t>(std::string("a\0", 2)));
+    data.push_back(make_counted<const ql::datum_t>(std::string("a\0b", 3)));
+
+    for (auto x = data.begin(); x != data.end(); ++x) {
+        std::string x_key;
+        (*x)->append_order_key(&x_key);
+        for (auto y = data.begin(); y != data.end(); ++y) {
+            std::string y_key;
+            (*y)->append_order_key(&y_key);
+            const int cmp = (*x)->cmp(**y);
+            const int key_cmp = x_key.compare(y_key);
+            EXPECT_EQ(cmp < 0, key_cmp < 0) << (*x)->print() << " " << (*y)->print();
+            EXPECT_EQ(cmp == 0, key_cmp == 0) << (*x)->print() << " " << (*y)->print();
+        }
+    }
+}
+
+TEST(DatumTest, ObjectKeysShareNames) {
+    scoped_cJSON_t json(cJSON_Parse("{\"id\": 1, \"name\": \"x\"}"));
+    counted_t<const ql::datum_t> datum = make_counted<const ql::datum_t>(json);
+    string_stream_t write_stream;
+    write_message_t wm;
+    wm << datum;
+    ASSERT_EQ(0, send_write_message(&write_stream, &wm));
+
+    counted_t<const ql::datum_t> copies[2];
+    for (size_t i = 0; i < 2; ++i) {
+        string_read_stream_t read_stream(std::string(write_stream.str()), 0);
+        ASSERT_EQ(archive_result_t::SUCCESS, deserialize(&read_stream, &copies[i]));
+    }
+    ASSERT_EQ(copies[0], copies[1]);
+
+    // The two rows' keys point at the same copy of each name.
+    auto it0 = copies[0]->as_object().begin();
+    auto it1 = copies[1]->as_object().begin();
+    for (; it0 != copies[0]->as_object().end(); ++it0, ++it1) {
+        EXPECT_EQ(&it0->first.str(), &it1->first.str());
+    }
+}
+
+TEST(DatumTest, IndexedObjectSerialization) {
+    scoped_cJSON_t json(cJSON_Parse(
+        "{\"id\": 7, \"name\": \"x\", \"tags\": [1, 2], \"sub\": {\"a\": null}}"));
+    counted_t<const ql::datum_t> datum = make_counted<const ql::datum_t>(json);
+
+    string_stream_t write_stream;
+    write_message_t wm;
+    ql::serialize_for_storage(&wm, datum);
+    ASSERT_EQ(0, send_write_message(&write_stream, &wm));
+    const std::string serialized = write_stream.str();
+
+    // Split the buffer up, like a blob would be.
+    const_buffer_group_t group;
+    for (size_t i = 0; i < serialized.size(); i += 5) {
+        group.add_buffer(std::min<size_t>(5, serialized.size() - i),
+                         serialized.data() + i);
+    }
+
+    const char *keys[] = { "id", "name", "sub", "tags", "missing", "" };
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+        counted_t<const ql::datum_t> field;
+        ASSERT_EQ(archive_result_t::SUCCESS,
+                  ql::deserialize_field(&group, keys[i], &field));
+        counted_t<const ql::datum_t> expected = datum->get(keys[i], ql::NOTHROW);
+        ASSERT_EQ(expected.has(), field.has());
+        if (expected.has()) {
+            EXPECT_EQ(*expected, *field);
+        }
+    }
+
+    string_read_stream_t read_stream(std::string(serialized), 0);
+    counted_t<const ql::datum_t> deserialized;
+    ASSERT_EQ(archive_result_t::SUCCESS, deserialize(&read_stream, &deserialized));
+    EXPECT_EQ(*datum, *deserialized);
+}
+
+// A `serialized_datum_source_t` over a string that counts the bytes it's asked for.
+class counting_datum_source_t : public ql::serialized_datum_source_t {
+public:
+    explicit counting_datum_source_t(const std::string *_data)
+        : data(_data), bytes_read(0) { }
+    uint64_t size() {
+        return data->size();
+    }
+    archive_result_t read(uint64_t offset, uint64_t count,
+                          const std::function<archive_result_t(read_stream_t *)> &fn) {
+        EXPECT_LE(offset + count, data->size());
+        bytes_read += count;
+        string_read_stream_t stream(data->substr(offset, count), 0);
+        return fn(&stream);
+    }
+    const std::string *data;
+    uint64_t bytes_read;
+};
+
+TEST(DatumTest, IndexedObjectFieldReadsOnlyItsBytes) {
+    std::string json = "{\"a\": 1, \"big\": [";
+    for (int i = 0; i < 10000; ++i) {
+        json += (i == 0 ? "" : ", ") + strprintf("%d", i);
+    }
+    json += "], \"z\": \"last\"}";
+    scoped_cJSON_t parsed(cJSON_Parse(json.c_str()));
+    counted_t<const ql::datum_t> datum = make_counted<const ql::datum_t>(parsed);
+
+    string_stream_t write_stream;
+    write_message_t wm;
+    ql::serialize_for_storage(&wm, datum);
+    ASSERT_EQ(0, send_write_message(&write_stream, &wm));
+    const std::string serialized = write_stream.str();
+
+    const char *keys[] = { "a", "z", "missing" };
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+        counting_datum_source_t source(&serialized);
+        counted_t<const ql::datum_t> field;
+        ASSERT_EQ(archive_result_t::SUCCESS,
+                  ql::deserialize_field(&source, keys[i], &field));
+        counted_t<const ql::datum_t> expected = datum->get(keys[i], ql::NOTHROW);
+        ASSERT_EQ(expected.has(), field.has());
+        if (expected.has()) {
+            EXPECT_EQ(*expected, *field);
+        }
+        // The big array is never read.
+        EXPECT_LT(source.bytes_read, 100u);
+    }
+
+    counting_datum_source_t source(&serialized);
+    counted_t<const ql::datum_t> field;
+    ASSERT_EQ(archive_result_t::SUCCESS, ql::deserialize_field(&source, "big", &field));
+    EXPECT_EQ(*datum->get("big"), *field);
+}
+
+TEST(DatumTest, HashMatchesEquality) {
+    const char *jsons[] = { "null", "true", "false", "0", "1.5", "\"a\"", "\"b\"",
+                            "[]", "[1, 2]", "[2, 1]", "{}", "{\"a\": 1}",
+                            "{\"a\": 2}", "{\"b\": 1}", "{\"a\": 1, \"b\": [null]}" };
+    ql::datum_hash_set_t set;
+    for (size_t i = 0; i < sizeof(jsons) / sizeof(jsons[0]); ++i) {
+        scoped_cJSON_t json(cJSON_Parse(jsons[i]));
+        counted_t<const ql::datum_t> d = make_counted<const ql::datum_t>(json);
+        EXPECT_TRUE(set.insert(d).second) << jsons[i];
+
+        // An equal datum built separately hashes the same.
+        scoped_cJSON_t json2(cJSON_Parse(jsons[i]));
+        counted_t<const ql::datum_t> d2 = make_counted<const ql::datum_t>(json2);
+        EXPECT_EQ(d->hash(), d2->hash());
+        EXPECT_FALSE(set.insert(d2).second) << jsons[i];
+    }
+
+    EXPECT_EQ(make_counted<const ql::datum_t>(0.0)->hash(),
+              make_counted<const ql::datum_t>(-0.0)->hash());
+}
+
+TEST(DatumTest, SecondaryValueFromKey) {
+    const char *jsons[] = { "1.5", "-3", "0", "1e300", "\"abc\"", "\"\"", "true",
+                            "false" };
+    for (size_t i = 0; i < sizeof(jsons) / sizeof(jsons[0]); ++i) {
+        scoped_cJSON_t json(cJSON_Parse(jsons[i]));
+        counted_t<const ql::datum_t> d = make_counted<const ql::datum_t>(json);
+        store_key_t key(d->print_secondary(store_key_t("pk")));
+        counted_t<const ql::datum_t> extracted
+            = ql::datum_t::extract_secondary_value(key);
+        ASSERT_TRUE(extracted.has()) << jsons[i];
+        EXPECT_EQ(*d, *extracted) << jsons[i];
+    }
+
+    // Arrays and truncated keys don't hold the whole value.
+    scoped_cJSON_t json(cJSON_Parse("[1, 2]"));
+    counted_t<const ql::datum_t> array = make_counted<const ql::datum_t>(json);
+    EXPECT_FALSE(ql::datum_t::extract_secondary_value(
+                     store_key_t(array->print_secondary(store_key_t("pk")))).has());
+    counted_t<const ql::datum_t> long_str
+        = make_counted<const ql::datum_t>(std::string(MAX_KEY_SIZE, 'a'));
+    EXPECT_FALSE(ql::datum_t::extract_secondary_value(
+                     store_key_t(long_str->print_secondary(store_key_t("pk")))).has());
+}
+
+
+
+counted_t<const ql::datum_t> response_test_datum() {
+    scoped_cJSON_t json(cJSON_Parse(
+        "{\"a\": [1, 2.5, -3e100, true, null], \"b\": \"tab\\there \\\"q\\\"\", "
+        "\"c\": {\"\\u0001\": {}}, \"d\": []}"));
+    guarantee(json.get() != NULL);
+    return make_counted<const ql::datum_t>(json);
+}
+
+TEST(DatumTest, WriteJson) {
+    counted_t<const ql::datum_t> datum = response_test_datum();
+    std::string json;
+    datum->write_json(&json);
+    EXPECT_EQ(datum->as_json().PrintUnformatted(), json);
+}
+
+TEST(DatumTest, ResponseWriter) {
+    std::vector<counted_t<const ql::datum_t> > datums;
+    datums.push_back(response_test_datum());
+    datums.push_back(make_counted<const ql::datum_t>(std::string("x")));
+
+    Response res;
+    res.set_type(Response::SUCCESS_PARTIAL);
+    res.set_token(7);
+    ql::response_writer_t writer(&res, ql::use_json_t::YES);
+    for (auto it = datums.begin(); it != datums.end(); ++it) {
+        writer.add(*it);
+    }
+
+    // The client parses the same response it would have gotten from
+    // `write_to_protobuf`.
+    std::string bytes;
+    ASSERT_TRUE(res.SerializeToString(&bytes));
+    Response parsed;
+    ASSERT_TRUE(parsed.ParseFromString(bytes));
+    EXPECT_EQ(Response::SUCCESS_PARTIAL, parsed.type());
+    EXPECT_EQ(7, parsed.token());
+    ASSERT_EQ(2, parsed.response_size());
+    for (int i = 0; i < parsed.response_size(); ++i) {
+        Datum expected;
+        datums[i]->write_to_protobuf(&expected, ql::use_json_t::YES);
+        EXPECT_EQ(Datum::R_JSON, parsed.response(i).type());
+        EXPECT_EQ(expected.r_str(), parsed.response(i).r_str());
+    }
+}
 
 }  // namespace unittest
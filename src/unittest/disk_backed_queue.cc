@@ -45,6 +45,32 @@ TEST(DiskBackedQueue, ManyInts) {
     unittest::run_in_thread_pool(&run_many_ints_test, 2);
 }
 
+void run_pop_many_test() {
+    static const int NUM_ELTS_IN_QUEUE = 1000;
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    const serializer_filepath_t serializer_path = dbq_serializer_path();
+
+    disk_backed_queue_t<int> queue(&io_backender, serializer_path, &get_global_perfmon_collection());
+    for (int i = 0; i < NUM_ELTS_IN_QUEUE; ++i) {
+        queue.push(i);
+    }
+
+    // Batches that end in the middle of a block and run over the end of the queue.
+    std::vector<int> values;
+    while (!queue.empty()) {
+        queue.pop_many(37, &values);
+    }
+    ASSERT_EQ(static_cast<size_t>(NUM_ELTS_IN_QUEUE), values.size());
+    for (int i = 0; i < NUM_ELTS_IN_QUEUE; ++i) {
+        EXPECT_EQ(i, values[i]);
+    }
+}
+
+TEST(DiskBackedQueue, PopMany) {
+    unittest::run_in_thread_pool(&run_pop_many_test, 2);
+}
+
 void run_big_values_test() {
     static const int NUM_BIG_ELTS_IN_QUEUE = 100;
     io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
@@ -74,6 +100,41 @@ TEST(DiskBackedQueue, BigVals) {
     unittest::run_in_thread_pool(&run_big_values_test, 2);
 }
 
+void run_memory_segment_test() {
+    static const int NUM_ELTS_IN_QUEUE = 1000;
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    const serializer_filepath_t serializer_path = dbq_serializer_path();
+
+    // Small enough that most values spill to disk, in batches, while the newest
+    // ones stay in memory.
+    disk_backed_queue_t<int> queue(&io_backender, serializer_path,
+                                   &get_global_perfmon_collection(), 100);
+    std::vector<int> pushed;
+    for (int i = 0; i < NUM_ELTS_IN_QUEUE; ++i) {
+        pushed.push_back(i);
+        if (pushed.size() == 7) {
+            queue.push_many(pushed.begin(), pushed.end());
+            pushed.clear();
+        }
+    }
+    queue.push_many(pushed.begin(), pushed.end());
+    ASSERT_EQ(NUM_ELTS_IN_QUEUE, queue.size());
+
+    std::vector<int> values;
+    while (!queue.empty()) {
+        queue.pop_many(37, &values);
+    }
+    ASSERT_EQ(static_cast<size_t>(NUM_ELTS_IN_QUEUE), values.size());
+    for (int i = 0; i < NUM_ELTS_IN_QUEUE; ++i) {
+        EXPECT_EQ(i, values[i]);
+    }
+}
+
+TEST(DiskBackedQueue, MemorySegment) {
+    unittest::run_in_thread_pool(&run_memory_segment_test, 2);
+}
+
 static void randomly_delay(int, signal_t *) {
     nap(randint(100));
 }
@@ -66,11 +66,11 @@ TEST(DiskFormatTest, LbaEntryT) {
     ASSERT_TRUE(lba_entry_t::is_padding(&ent));
     flagged_off64_t real = flagged_off64_t::unused();
     real = flagged_off64_t::make(1);
-    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, real, 1234);
+    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, real, 1234, 0);
     ASSERT_FALSE(lba_entry_t::is_padding(&ent));
     flagged_off64_t deleteblock = flagged_off64_t::unused();
     deleteblock = flagged_off64_t::make(1);
-    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, deleteblock, 1234);
+    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, deleteblock, 1234, 0);
     ASSERT_FALSE(lba_entry_t::is_padding(&ent));
 }
 
@@ -125,7 +125,8 @@ TEST(DiskFormatTest, LogSerializerMetablockT) {
 TEST(DiskFormatTest, LogSerializerStaticConfigT) {
     EXPECT_EQ(0u, offsetof(log_serializer_on_disk_static_config_t, block_size_));
     EXPECT_EQ(8u, offsetof(log_serializer_on_disk_static_config_t, extent_size_));
-    EXPECT_EQ(16u, sizeof(log_serializer_on_disk_static_config_t));
+    EXPECT_EQ(16u, offsetof(log_serializer_on_disk_static_config_t, index_file_id_));
+    EXPECT_EQ(24u, sizeof(log_serializer_on_disk_static_config_t));
 }
 
 }  // namespace unittest
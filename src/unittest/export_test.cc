@@ -0,0 +1,68 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <map>
+#include <string>
+#include <vector>
+
+#include "unittest/gtest.hpp"
+
+#include "config/args.hpp"
+#include "containers/archive/string_stream.hpp"
+#include "rdb_protocol/export.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+static counted_t<const ql::datum_t> row(double id) {
+    std::map<std::string, counted_t<const ql::datum_t> > obj;
+    obj["id"] = make_counted<ql::datum_t>(id);
+    obj["padding"] = make_counted<ql::datum_t>(std::string(1000, 'x'));
+    return make_counted<ql::datum_t>(std::move(obj));
+}
+
+static std::string serialize_row(const counted_t<const ql::datum_t> &datum) {
+    string_stream_t stream;
+    write_message_t wm;
+    wm << datum;
+    int res = send_write_message(&stream, &wm);
+    guarantee(res == 0);
+    return stream.str();
+}
+
+TPTEST(ExportTest, RoundTrip) {
+    temp_file_t file;
+    const std::string path = file.name().temporary_path();
+
+    // Enough rows for several chunks.
+    const size_t num_rows = 3 * EXPORT_CHUNK_SIZE / 1000;
+    {
+        export_writer_t writer(path);
+        for (size_t i = 0; i < num_rows; ++i) {
+            writer.add_row(serialize_row(row(i)));
+        }
+        writer.finish();
+        ASSERT_EQ("", writer.error());
+    }
+
+    export_reader_t reader(path);
+    std::vector<counted_t<const ql::datum_t> > rows;
+    std::vector<counted_t<const ql::datum_t> > chunk;
+    while (reader.next_chunk(&chunk)) {
+        EXPECT_FALSE(chunk.empty());
+        rows.insert(rows.end(), chunk.begin(), chunk.end());
+    }
+    ASSERT_EQ("", reader.error());
+    ASSERT_EQ(num_rows, rows.size());
+    for (size_t i = 0; i < num_rows; ++i) {
+        EXPECT_EQ(*row(i), *rows[i]);
+    }
+}
+
+TPTEST(ExportTest, RejectsOtherFiles) {
+    temp_file_t file;
+    export_reader_t reader(file.name().permanent_path());
+    std::vector<counted_t<const ql::datum_t> > chunk;
+    EXPECT_FALSE(reader.next_chunk(&chunk));
+    EXPECT_NE("", reader.error());
+}
+
+}  // namespace unittest
@@ -1,4 +1,6 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <unistd.h>
+
 #include <functional>
 
 #include "arch/runtime/coroutines.hpp"
@@ -163,6 +165,55 @@ SPAWNER_TEST(ExtProc, TalkativeJob) {
     } while (n != 1);
 }
 
+// Returns the pid of the worker process it ran in.
+class pid_job_t {
+public:
+    pid_job_t(extproc_pool_t *pool, uint64_t affinity_key) :
+        extproc_job(pool, &worker_fn, NULL, affinity_key) { }
+
+    pid_t get_pid() {
+        pid_t pid;
+        archive_result_t res = deserialize(extproc_job.read_stream(), &pid);
+        guarantee(res == archive_result_t::SUCCESS);
+        return pid;
+    }
+
+private:
+    static bool worker_fn(read_stream_t *, write_stream_t *stream_out) {
+        write_message_t wm;
+        wm << getpid();
+        int res = send_write_message(stream_out, &wm);
+        guarantee(res == 0);
+        return true;
+    }
+
+    extproc_job_t extproc_job;
+};
+
+SPAWNER_TEST(ExtProc, AffinityPicksSameWorker) {
+    extproc_pool_t pool(2);
+
+    pid_t first_pid, second_pid;
+    {
+        scoped_ptr_t<pid_job_t> first_job(new pid_job_t(&pool, 1));
+        scoped_ptr_t<pid_job_t> second_job(new pid_job_t(&pool, 2));
+        first_pid = first_job->get_pid();
+        second_pid = second_job->get_pid();
+        ASSERT_NE(first_pid, second_pid);
+
+        // The second job's worker is now the first one the pool would hand out.
+        first_job.reset();
+        second_job.reset();
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        pid_job_t job(&pool, 1);
+        ASSERT_EQ(first_pid, job.get_pid());
+    }
+    pid_job_t job(&pool, 2);
+    ASSERT_EQ(second_pid, job.get_pid());
+}
+
 void run_single_job(extproc_pool_t *pool, size_t *counter, cond_t *done) {
     fib_job_t job(10, pool, NULL);
 
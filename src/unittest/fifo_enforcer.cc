@@ -8,6 +8,7 @@
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/fifo_enforcer_queue.hpp"
 #include "concurrency/wait_any.hpp"
+#include "time.hpp"
 #include "unittest/unittest_utils.hpp"
 #include "unittest/gtest.hpp"
 
@@ -132,5 +133,86 @@ TPTEST(FIFOEnforcer, QueueEquivalence) {
     EXPECT_EQ(total_inserted, 0);
 }
 
+TPTEST(FIFOEnforcer, QueueOutOfOrder) {
+    fifo_enforcer_source_t source;
+    fifo_enforcer_queue_t<int> queue;
+
+    fifo_enforcer_read_token_t r1 = source.enter_read();
+    fifo_enforcer_write_token_t w1 = source.enter_write();
+    fifo_enforcer_read_token_t r2 = source.enter_read();
+
+    queue.push(r2, 3);
+    queue.push(w1, 2);
+    EXPECT_FALSE(queue.available->get());
+    queue.push(r1, 1);
+
+    ASSERT_TRUE(queue.available->get());
+    EXPECT_EQ(1, queue.pop());
+    EXPECT_FALSE(queue.available->get());
+    queue.finish_read(r1);
+    ASSERT_TRUE(queue.available->get());
+    EXPECT_EQ(2, queue.pop());
+    EXPECT_FALSE(queue.available->get());
+    queue.finish_write(w1);
+    ASSERT_TRUE(queue.available->get());
+    EXPECT_EQ(3, queue.pop());
+    queue.finish_read(r2);
+
+    // Once everything out of order has gone through, arrivals in order still
+    // come out in order.
+    fifo_enforcer_write_token_t w2 = source.enter_write();
+    fifo_enforcer_read_token_t r3 = source.enter_read();
+    queue.push(w2, 4);
+    queue.push(r3, 5);
+    ASSERT_TRUE(queue.available->get());
+    EXPECT_EQ(4, queue.pop());
+    EXPECT_FALSE(queue.available->get());
+    queue.finish_write(w2);
+    ASSERT_TRUE(queue.available->get());
+    EXPECT_EQ(5, queue.pop());
+    queue.finish_read(r3);
+    EXPECT_FALSE(queue.available->get());
+}
+
+/* `SinkBenchmark` times tokens going through a `fifo_enforcer_sink_t` and a
+`fifo_enforcer_queue_t` in order, which is the common case. It's disabled by
+default; run it with `--gtest_also_run_disabled_tests`. */
+TPTEST(FIFOEnforcer, DISABLED_SinkBenchmark) {
+    const int num_ops = 1000000;
+    fifo_enforcer_source_t source, queue_source;
+    fifo_enforcer_sink_t sink;
+    fifo_enforcer_queue_t<int> queue;
+
+    ticks_t start = get_ticks();
+    for (int i = 0; i < num_ops; ++i) {
+        if (i % 4 == 0) {
+            fifo_enforcer_sink_t::exit_write_t exit(&sink, source.enter_write());
+            EXPECT_TRUE(exit.is_pulsed());
+        } else {
+            fifo_enforcer_sink_t::exit_read_t exit(&sink, source.enter_read());
+            EXPECT_TRUE(exit.is_pulsed());
+        }
+    }
+    ticks_t sink_done = get_ticks();
+    for (int i = 0; i < num_ops; ++i) {
+        if (i % 4 == 0) {
+            fifo_enforcer_write_token_t token = queue_source.enter_write();
+            queue.push(token, i);
+            EXPECT_EQ(i, queue.pop());
+            queue.finish_write(token);
+        } else {
+            fifo_enforcer_read_token_t token = queue_source.enter_read();
+            queue.push(token, i);
+            EXPECT_EQ(i, queue.pop());
+            queue.finish_read(token);
+        }
+    }
+    ticks_t queue_done = get_ticks();
+
+    printf("sink: %.1f ns/op, queue: %.1f ns/op\n",
+           ticks_to_secs(sink_done - start) * 1e9 / num_ops,
+           ticks_to_secs(queue_done - sink_done) * 1e9 / num_ops);
+}
+
 }   /* namespace unittest */
 
@@ -112,9 +112,30 @@ TEST(HashRegionTest, SpecialNonSquareRegionJoin) {
     assert_equal(key_range_t::universe(), r.inner);
 }
 
+TEST(HashRegionTest, PrintableKeySubranges) {
+    // The pieces join up into every key, in order, and split up the keys after the
+    // prefix.
+    const int num_pieces = 16;
+    std::vector<hash_region_t<key_range_t> > vec;
+    for (int i = 0; i < num_pieces; ++i) {
+        key_range_t piece = printable_key_subrange("S", i, num_pieces);
+        ASSERT_FALSE(piece.is_empty());
+        if (i != 0) {
+            ASSERT_FALSE(vec.back().inner.right.unbounded);
+            ASSERT_EQ(key_to_unescaped_str(vec.back().inner.right.key),
+                      key_to_unescaped_str(piece.left));
+        }
+        vec.push_back(hash_region_t<key_range_t>(piece));
+    }
+    EXPECT_TRUE(vec[0].inner.contains_key(store_key_t("N123")));
+    EXPECT_TRUE(vec[0].inner.contains_key(store_key_t("S0abc")));
+    EXPECT_TRUE(vec[num_pieces - 1].inner.contains_key(store_key_t("Szzz")));
+    EXPECT_FALSE(vec[0].inner.contains_key(store_key_t("Sm")));
 
-
-
+    hash_region_t<key_range_t> r;
+    ASSERT_EQ(REGION_JOIN_OK, region_join(vec, &r));
+    assert_equal(key_range_t::universe(), r.inner);
+}
 
 }  // namespace unittest
 
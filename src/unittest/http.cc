@@ -1,4 +1,6 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
+#include <zlib.h>
+
 #include <ctime>
 #include <functional>
 
@@ -91,6 +93,103 @@ TEST(Http, Encodings) {
     test_encoding("g_zip", false);
 }
 
+TEST(Http, StreamGzip) {
+    std::string body;
+    for (size_t i = 0; i < 4 * HTTP_STREAM_GZIP_MIN_SIZE; ++i) {
+        body += 'a' + (i * i % 26);
+    }
+
+    http_req_t req = http_req_encoding("gzip");
+    http_res_t res(HTTP_OK);
+    res.set_body("application/json", body);
+    ASSERT_TRUE(maybe_stream_gzip_response(req, &res));
+    ASSERT_TRUE(res.body_generator.get() != NULL);
+    EXPECT_TRUE(res.body.empty());
+    for (auto it = res.header_lines.begin(); it != res.header_lines.end(); ++it) {
+        EXPECT_NE("Content-Length", it->key);
+    }
+
+    // Uncompress the chunks as they come and compare with the original body
+    z_stream zstream;
+    zstream.zalloc = Z_NULL;
+    zstream.zfree = Z_NULL;
+    zstream.opaque = Z_NULL;
+    zstream.avail_in = 0;
+    zstream.next_in = Z_NULL;
+    ASSERT_EQ(Z_OK, inflateInit2(&zstream, 31));
+    std::string uncompressed(body.size() + 1, '\0');
+    zstream.next_out = reinterpret_cast<unsigned char *>(&uncompressed[0]);
+    zstream.avail_out = uncompressed.size();
+    std::string chunk;
+    size_t chunks = 0;
+    int zres = Z_OK;
+    while (res.body_generator->next_chunk(&chunk)) {
+        EXPECT_LE(chunk.size(), HTTP_STREAM_CHUNK_SIZE);
+        ++chunks;
+        zstream.next_in = reinterpret_cast<unsigned char *>(&chunk[0]);
+        zstream.avail_in = chunk.size();
+        zres = inflate(&zstream, Z_NO_FLUSH);
+        ASSERT_TRUE(zres == Z_OK || zres == Z_STREAM_END);
+    }
+    EXPECT_EQ(Z_STREAM_END, zres);
+    EXPECT_LT(1u, chunks);
+    uncompressed.resize(zstream.total_out);
+    inflateEnd(&zstream);
+    EXPECT_EQ(body, uncompressed);
+
+    // Small bodies are left to `maybe_gzip_response()`
+    http_res_t small_res(HTTP_OK);
+    small_res.set_body("application/json", "{}");
+    EXPECT_FALSE(maybe_stream_gzip_response(req, &small_res));
+}
+
+TEST(Http, KeepAlive) {
+    http_req_t req;
+    req.version = "1.1";
+    EXPECT_TRUE(http_keep_alive(req));
+    req.version = "1.0";
+    EXPECT_FALSE(http_keep_alive(req));
+
+    header_line_t connection;
+    connection.key = "Connection";
+    connection.val = "Keep-Alive";
+    req.header_lines.push_back(connection);
+    EXPECT_TRUE(http_keep_alive(req));
+
+    req.version = "1.1";
+    req.header_lines.back().val = "close";
+    EXPECT_FALSE(http_keep_alive(req));
+}
+
+TEST(Http, ETag) {
+    const std::string body = "{\"a\": 1}";
+    const std::string etag = http_etag(body);
+    EXPECT_NE(etag, http_etag("{\"a\": 2}"));
+
+    http_req_t req;
+    http_res_t res;
+    http_etag_res(req, "application/json", body, etag, &res);
+    EXPECT_EQ(HTTP_OK, res.code);
+    EXPECT_EQ(body, res.body);
+
+    header_line_t if_none_match;
+    if_none_match.key = "If-None-Match";
+    if_none_match.val = "\"stale\", " + etag;
+    req.header_lines.push_back(if_none_match);
+    http_etag_res(req, "application/json", body, etag, &res);
+    EXPECT_EQ(HTTP_NOT_MODIFIED, res.code);
+    EXPECT_TRUE(res.body.empty());
+
+    // The weak comparison ignores the "W/".
+    req.header_lines.back().val = etag.substr(2);
+    http_etag_res(req, "application/json", body, etag, &res);
+    EXPECT_EQ(HTTP_NOT_MODIFIED, res.code);
+
+    req.header_lines.back().val = http_etag("{\"a\": 2}");
+    http_etag_res(req, "application/json", body, etag, &res);
+    EXPECT_EQ(HTTP_OK, res.code);
+}
+
 class dummy_http_app_t : public http_app_t {
 public:
     signal_t *get_handle_signal() {
@@ -0,0 +1,78 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/compiled_func.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/js_translate.hpp"
+#include "rdb_protocol/pb_utils.hpp"
+#include "rdb_protocol/ql2.pb.h"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+counted_t<const ql::datum_t> js_translate_row(const char *json) {
+    scoped_cJSON_t parsed(cJSON_Parse(json));
+    return make_counted<const ql::datum_t>(parsed);
+}
+
+scoped_ptr_t<ql::map_function_t> translate_and_compile(const std::string &source) {
+    scoped_ptr_t<Term> body = ql::translate_js_function(source);
+    if (!body.has()) {
+        return scoped_ptr_t<ql::map_function_t>();
+    }
+    return ql::compile_map_function(
+        std::vector<ql::sym_t>(
+            1, ql::pb::dummy_var_to_sym(ql::pb::dummy_var_t::JS_FUNCTION_ARG)),
+        *body, ql::comparisons_t::JAVASCRIPT);
+}
+
+TEST(JSTranslate, Arithmetic) {
+    scoped_ptr_t<ql::map_function_t> fn = translate_and_compile(
+        "(function(d) { return d.a + d[\"b\"] * -2; })");
+    ASSERT_TRUE(fn.has());
+
+    counted_t<const ql::datum_t> out;
+    ASSERT_TRUE(fn->apply(js_translate_row("{\"a\": 10, \"b\": 3}"), &out));
+    EXPECT_EQ(4, out->as_num());
+    // JavaScript would concatenate these, or find `undefined`.
+    EXPECT_FALSE(fn->apply(js_translate_row("{\"a\": \"x\", \"b\": 3}"), &out));
+    EXPECT_FALSE(fn->apply(js_translate_row("{\"b\": 3}"), &out));
+}
+
+TEST(JSTranslate, TernaryAndComparisons) {
+    scoped_ptr_t<ql::map_function_t> fn = translate_and_compile(
+        "(function f(x){return x.a < 5 && x.s !== 'no' ? x.a : null})");
+    ASSERT_TRUE(fn.has());
+
+    counted_t<const ql::datum_t> out;
+    ASSERT_TRUE(fn->apply(js_translate_row("{\"a\": 1, \"s\": \"yes\"}"), &out));
+    EXPECT_EQ(1, out->as_num());
+    ASSERT_TRUE(fn->apply(js_translate_row("{\"a\": 7, \"s\": \"yes\"}"), &out));
+    EXPECT_EQ(ql::datum_t::R_NULL, out->get_type());
+    ASSERT_TRUE(fn->apply(js_translate_row("{\"a\": 1, \"s\": \"no\"}"), &out));
+    EXPECT_EQ(ql::datum_t::R_NULL, out->get_type());
+    // JavaScript converts the string to compare it, ReQL doesn't.
+    EXPECT_FALSE(fn->apply(js_translate_row("{\"a\": \"1\", \"s\": \"yes\"}"), &out));
+}
+
+TEST(JSTranslate, RefusesOtherCode) {
+    const char *sources[] = {
+        "(function(d) { return d.a == 1; })",
+        "(function(d) { return d.a % 2; })",
+        "(function(d) { return Math.max(d.a, 1); })",
+        "(function(d) { var x = d.a; return x; })",
+        "(function(d) { return d[0]; })",
+        "(function(d) { return d.a++; })",
+        "(function(d) { return\nd.a; })",
+        "(function(d) { return d.a; /* comment */ })",
+        "(function(d, e) { return d.a; })",
+        "(function(this) { return 1; })",
+        "function(d) { return d.a; }",
+        "(function(d) { return 017; })",
+        "(function(d) { return '\\u00e9'; })",
+        "1 + 2"
+    };
+    for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); ++i) {
+        EXPECT_FALSE(ql::translate_js_function(sources[i]).has()) << sources[i];
+    }
+}
+
+}  // namespace unittest
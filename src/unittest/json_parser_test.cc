@@ -0,0 +1,92 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string>
+
+#include "config/args.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/error.hpp"
+#include "rdb_protocol/json_parser.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+counted_t<const ql::datum_t> parse_json_string(const std::string &json) {
+    return ql::parse_json(json.data(), json.size());
+}
+
+TEST(JSONParser, MatchesCJSON) {
+    const char *docs[] = {
+        "null",
+        " true ",
+        "false",
+        "0",
+        "-0",
+        "123456789012345",
+        "1234567890123456789",
+        "-2.5e-3",
+        "1E10",
+        "\"\"",
+        "\"plain\"",
+        "\"tab\\tquote\\\"slash\\/\\\\\"",
+        "\"\\u00e9\\u4e2d\\ud83d\\ude00\"",
+        "[]",
+        "[1, [2, [3]], {}]",
+        "\n{ \"b\" : 1, \"a\" : {\"c\": [true, null]} }\n"
+    };
+    for (size_t i = 0; i < sizeof(docs) / sizeof(docs[0]); ++i) {
+        counted_t<const ql::datum_t> parsed = parse_json_string(docs[i]);
+        ASSERT_TRUE(parsed.has()) << docs[i];
+        scoped_cJSON_t cjson(cJSON_Parse(docs[i]));
+        ASSERT_TRUE(cjson.get() != NULL) << docs[i];
+        EXPECT_EQ(ql::datum_t(cjson), *parsed) << docs[i];
+    }
+}
+
+TEST(JSONParser, RejectsInvalidJSON) {
+    const char *docs[] = {
+        "",
+        "   ",
+        "[1,2",
+        "[1,]",
+        "{\"a\" 1}",
+        "{a: 1}",
+        "nul",
+        "trUe",
+        "-",
+        "1e",
+        "0x10",
+        "\"unterminated",
+        "\"bad escape \\q\"",
+        "\"\\u12\"",
+        "\"\\udc00\"",
+        "\"\\ud83d\"",
+        "[1] 2"
+    };
+    for (size_t i = 0; i < sizeof(docs) / sizeof(docs[0]); ++i) {
+        EXPECT_FALSE(parse_json_string(docs[i]).has()) << docs[i];
+    }
+}
+
+TEST(JSONParser, RejectsInvalidDatums) {
+    EXPECT_THROW(parse_json_string("{\"a\": 1, \"a\": 2}"), ql::base_exc_t);
+    EXPECT_THROW(parse_json_string("\"a\\u0000b\""), ql::base_exc_t);
+    EXPECT_THROW(parse_json_string("1e400"), ql::base_exc_t);
+
+    std::string deep(JSON_MAX_NESTING_DEPTH + 1, '[');
+    deep += std::string(JSON_MAX_NESTING_DEPTH + 1, ']');
+    EXPECT_THROW(parse_json_string(deep), ql::base_exc_t);
+    deep = deep.substr(1, deep.size() - 2);
+    EXPECT_TRUE(parse_json_string(deep).has());
+}
+
+TEST(JSONParser, LongStrings) {
+    // Long enough to go through the 16-byte scan more than once, with the escape
+    // sequence in the middle of a block.
+    std::string text(40, 'x');
+    std::string json = "[\"" + text + "\", \"" + text + "\\n" + text + "\"]";
+    counted_t<const ql::datum_t> parsed = parse_json_string(json);
+    ASSERT_TRUE(parsed.has());
+    EXPECT_EQ(text, parsed->get(0)->as_str().to_std());
+    EXPECT_EQ(text + "\n" + text, parsed->get(1)->as_str().to_std());
+}
+
+}  // namespace unittest
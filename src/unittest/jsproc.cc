@@ -1,4 +1,5 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "config/args.hpp"
 #include "containers/archive/archive.hpp"
 #include "extproc/extproc_pool.hpp"
 #include "extproc/extproc_spawner.hpp"
@@ -111,6 +112,42 @@ SPAWNER_TEST(JSProc, EvalAndCall) {
     ASSERT_EQ((*res_datum)->as_int(), 10337);
 }
 
+SPAWNER_TEST(JSProc, CallBatch) {
+    extproc_pool_t extproc_pool(1);
+    js_runner_t js_runner;
+
+    js_runner.begin(&extproc_pool, NULL);
+
+    const std::string source_code =
+        "(function (x) { if (x == 2) { return 4 / 0; } return x * 10; })";
+
+    js_runner_t::req_config_t config;
+    config.timeout_ms = 10000;
+
+    std::vector<std::vector<counted_t<const ql::datum_t> > > arg_tuples;
+    for (int i = 0; i < 4; ++i) {
+        arg_tuples.push_back(std::vector<counted_t<const ql::datum_t> >(
+            1, make_counted<const ql::datum_t>(static_cast<double>(i))));
+    }
+
+    std::vector<js_result_t> results =
+        js_runner.call_batch(source_code, arg_tuples, config);
+    ASSERT_TRUE(js_runner.connected());
+    ASSERT_EQ(4u, results.size());
+
+    // Each row gets its own result, and an error in one doesn't spoil the rest.
+    for (int i = 0; i < 4; ++i) {
+        if (i == 2) {
+            ASSERT_TRUE(boost::get<std::string>(&results[i]) != NULL);
+            continue;
+        }
+        counted_t<const ql::datum_t> *res_datum =
+            boost::get<counted_t<const ql::datum_t> >(&results[i]);
+        ASSERT_TRUE(res_datum != NULL);
+        ASSERT_EQ(i * 10, (*res_datum)->as_int());
+    }
+}
+
 SPAWNER_TEST(JSProc, BrokenFunction) {
     extproc_pool_t extproc_pool(1);
     js_runner_t js_runner;
@@ -250,6 +287,18 @@ void passthrough_test_internal(extproc_pool_t *pool, const counted_t<const ql::d
     ASSERT_EQ(*res_datum->get(), *arg.get());
 }
 
+// Jobs and results bigger than the shared memory rings have to go around them more
+// than once.
+SPAWNER_TEST(JSProc, PassthroughBiggerThanRing) {
+    extproc_pool_t pool(1);
+
+    passthrough_test_internal(&pool, make_counted<const ql::datum_t>(
+        std::string(EXTPROC_SHM_RING_SIZE * 3 + 17, 'x')));
+
+    // The worker is still in sync afterwards.
+    passthrough_test_internal(&pool, make_counted<const ql::datum_t>("string str"));
+}
+
 // This test will make sure that conversion of datum_t to and from v8 types works
 // correctly
 SPAWNER_TEST(JSProc, Passthrough) {
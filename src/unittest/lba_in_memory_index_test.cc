@@ -0,0 +1,115 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "serializer/log/lba/in_memory_index.hpp"
+
+namespace unittest {
+
+static repli_timestamp_t make_recency(uint64_t longtime) {
+    repli_timestamp_t ret;
+    ret.longtime = longtime;
+    return ret;
+}
+
+static void set_info(in_memory_index_t *index, block_id_t id, int64_t offset) {
+    index->set_block_info(id, make_recency(id + 1), flagged_off64_t::make(offset),
+                          id % 4096 + 1, id % 3 == 0 ? id % 4096 + 100 : 0);
+}
+
+static void check_info(in_memory_index_t *index, block_id_t id, int64_t offset) {
+    index_block_info_t info = index->get_block_info(id);
+    ASSERT_TRUE(info.offset == flagged_off64_t::make(offset));
+    ASSERT_EQ(id + 1, info.recency.longtime);
+    ASSERT_EQ(id % 4096 + 1, info.ser_block_size);
+    ASSERT_EQ(id % 3 == 0 ? id % 4096 + 100 : 0, info.ser_uncompressed_size);
+}
+
+static void check_missing(in_memory_index_t *index, block_id_t id) {
+    ASSERT_TRUE(index->get_block_info(id) == index_block_info_t());
+}
+
+TEST(LbaInMemoryIndexTest, Empty) {
+    in_memory_index_t index;
+    ASSERT_EQ(0u, index.end_block_id());
+    check_missing(&index, 0);
+    check_missing(&index, 123456789);
+}
+
+TEST(LbaInMemoryIndexTest, SetAndGet) {
+    in_memory_index_t index;
+    for (block_id_t id = 0; id < 5000; ++id) {
+        set_info(&index, id, (id * 7 % 5000) * DEVICE_BLOCK_SIZE);
+    }
+    ASSERT_EQ(5000u, index.end_block_id());
+    for (block_id_t id = 0; id < 5000; ++id) {
+        check_info(&index, id, (id * 7 % 5000) * DEVICE_BLOCK_SIZE);
+    }
+    check_missing(&index, 5000);
+
+    // Overwrite every other entry.
+    for (block_id_t id = 0; id < 5000; id += 2) {
+        set_info(&index, id, id * DEVICE_BLOCK_SIZE);
+    }
+    for (block_id_t id = 0; id < 5000; ++id) {
+        check_info(&index, id, (id % 2 == 0 ? id : id * 7 % 5000) * DEVICE_BLOCK_SIZE);
+    }
+}
+
+TEST(LbaInMemoryIndexTest, SparseAndLargeOffsets) {
+    in_memory_index_t index;
+    const int64_t large_offset = static_cast<int64_t>(1) << 45;
+    const block_id_t ids[] = { 3, 100003, 7777777, 1000000007 };
+    for (size_t i = 0; i < sizeof(ids) / sizeof(ids[0]); ++i) {
+        set_info(&index, ids[i], large_offset + i * DEVICE_BLOCK_SIZE);
+    }
+    ASSERT_EQ(1000000008u, index.end_block_id());
+    for (size_t i = 0; i < sizeof(ids) / sizeof(ids[0]); ++i) {
+        check_info(&index, ids[i], large_offset + i * DEVICE_BLOCK_SIZE);
+        check_missing(&index, ids[i] + 1);
+        check_missing(&index, ids[i] + LBA_SHARD_FACTOR);
+    }
+}
+
+TEST(LbaInMemoryIndexTest, DeletedBlocks) {
+    in_memory_index_t index;
+    for (block_id_t id = 0; id < 2000; ++id) {
+        set_info(&index, id, id * DEVICE_BLOCK_SIZE);
+    }
+
+    // A deleted block keeps its recency but has no offset.
+    index.set_block_info(10, make_recency(55), flagged_off64_t::unused(), 0, 0);
+    index_block_info_t info = index.get_block_info(10);
+    ASSERT_TRUE(info.offset == flagged_off64_t::unused());
+    ASSERT_EQ(55u, info.recency.longtime);
+
+    // Resetting the entries removes them.
+    for (block_id_t id = 0; id < 2000; ++id) {
+        if (id % 5 != 0) {
+            index.set_block_info(id, repli_timestamp_t::invalid,
+                                 flagged_off64_t::unused(), 0, 0);
+        }
+    }
+    for (block_id_t id = 0; id < 2000; ++id) {
+        if (id == 10) {
+            ASSERT_EQ(55u, index.get_block_info(id).recency.longtime);
+        } else if (id % 5 == 0) {
+            check_info(&index, id, id * DEVICE_BLOCK_SIZE);
+        } else {
+            check_missing(&index, id);
+        }
+    }
+    // The end block id doesn't shrink.
+    ASSERT_EQ(2000u, index.end_block_id());
+
+    for (block_id_t id = 0; id < 2000; id += 5) {
+        index.set_block_info(id, repli_timestamp_t::invalid,
+                             flagged_off64_t::unused(), 0, 0);
+        check_missing(&index, id);
+    }
+
+    // The chunks can be filled again after becoming empty.
+    set_info(&index, 1234, 5 * DEVICE_BLOCK_SIZE);
+    check_info(&index, 1234, 5 * DEVICE_BLOCK_SIZE);
+}
+
+}  // namespace unittest
@@ -152,26 +152,26 @@ public:
 
         store_key_t replacement;
         bool can_level = leaf::level(&sizer_, nodecmp_value, node(), sibling->node(),
-                                     replacement.btree_key(), NULL);
+                                     replacement.writable_btree_key(), NULL);
 
         if (can_level) {
             ASSERT_TRUE(!sibling->kv_.empty());
             if (nodecmp_value < 0) {
-                // Copy keys from front of sibling until and including replacement key.
+                // Copy keys from front of sibling up to the replacement key, which
+                // separates the moved keys from the ones that stay.
 
                 std::map<store_key_t, std::string>::iterator p = sibling->kv_.begin();
-                while (p != sibling->kv_.end() && p->first < replacement) {
+                ASSERT_TRUE(p->first <= replacement);
+                while (p != sibling->kv_.end() && p->first <= replacement) {
                     kv_[p->first] = p->second;
                     std::map<store_key_t, std::string>::iterator prev = p;
                     ++p;
                     sibling->kv_.erase(prev);
                 }
                 ASSERT_TRUE(p != sibling->kv_.end());
-                ASSERT_EQ(key_to_unescaped_str(p->first), key_to_unescaped_str(replacement));
-                kv_[p->first] = p->second;
-                sibling->kv_.erase(p);
             } else {
-                // Copy keys from end of sibling until but not including replacement key.
+                // Copy keys from end of sibling that are greater than the replacement
+                // key.
 
                 std::map<store_key_t, std::string>::iterator p = sibling->kv_.end();
                 --p;
@@ -182,7 +182,7 @@ public:
                     sibling->kv_.erase(prev);
                 }
 
-                ASSERT_EQ(key_to_unescaped_str(p->first), key_to_unescaped_str(replacement));
+                ASSERT_TRUE(p->first <= replacement);
             }
         }
 
@@ -192,13 +192,18 @@ public:
         sibling->Verify();
     }
 
-    void Split(LeafNodeTracker *right) {
+    void Split(LeafNodeTracker *right, store_key_t *median_out = NULL,
+               leaf::split_policy_t policy = leaf::split_policy_t::EVEN) {
         ASSERT_EQ(bs_.ser_value(), right->bs_.ser_value());
 
         ASSERT_TRUE(leaf::is_empty(right->node()));
 
         store_key_t median;
-        leaf::split(&sizer_, node(), right->node(), median.btree_key());
+        leaf::split(&sizer_, node(), right->node(), median.writable_btree_key(),
+                    policy);
+        if (median_out != NULL) {
+            *median_out = median;
+        }
 
         std::map<store_key_t, std::string>::iterator p = kv_.end();
         --p;
@@ -209,7 +214,21 @@ public:
             kv_.erase(prev);
         }
 
-        ASSERT_EQ(key_to_unescaped_str(p->first), key_to_unescaped_str(median));
+        ASSERT_TRUE(p->first <= median);
+        ASSERT_FALSE(right->kv_.empty());
+    }
+
+    void Freeze() {
+        leaf::freeze(&sizer_, node());
+        Verify();
+    }
+
+    bool IsUnderfull() {
+        return leaf::is_underfull(&sizer_, node());
+    }
+
+    size_t Size() const {
+        return kv_.size();
     }
 
     bool IsFull(const store_key_t& key, const std::string& value) {
@@ -609,6 +628,84 @@ TEST(LeafNodeTest, Splitting) {
     left.Split(&right);
 }
 
+TEST(LeafNodeTest, AppendSplitting) {
+    LeafNodeTracker left;
+    int i = 0;
+    while (left.Insert(store_key_t(strprintf("a%05d", i)), strprintf("A%d", i))) {
+        ++i;
+    }
+    const store_key_t next(strprintf("a%05d", i));
+    ASSERT_TRUE(leaf::is_past_last_key(left.node(), next.btree_key()));
+    ASSERT_FALSE(leaf::is_past_last_key(left.node(), store_key_t("a").btree_key()));
+
+    LeafNodeTracker right;
+    store_key_t median;
+    left.Split(&right, &median, leaf::split_policy_t::APPEND);
+    // Only the last key moves over; the next keys go after it.
+    ASSERT_EQ(1u, right.Size());
+    ASSERT_EQ(static_cast<size_t>(i - 1), left.Size());
+    ASSERT_FALSE(left.IsUnderfull());
+    ASSERT_TRUE(right.IsUnderfull());
+    ASSERT_TRUE(median < next);
+    ASSERT_TRUE(right.Insert(next, "next"));
+}
+
+TEST(LeafNodeTest, Freezing) {
+    LeafNodeTracker node;
+    int i = 0;
+    while (node.Insert(store_key_t(strprintf("a%05d", i)), strprintf("A%d", i))) {
+        ++i;
+    }
+    for (int j = 0; j < i; j += 2) {
+        node.Remove(store_key_t(strprintf("a%05d", j)));
+    }
+
+    node.Freeze();
+    // No timestamps are left, and neither are the deletion entries.
+    ASSERT_EQ(node.node()->frontmost, node.node()->tstamp_cutpoint);
+    ASSERT_EQ(node.Size(), node.node()->num_pairs);
+
+    // The leaf takes writes as usual afterwards.
+    ASSERT_TRUE(node.Insert(store_key_t("a00000"), "again"));
+    node.Remove(store_key_t("a00001"));
+}
+
+TEST(LeafNodeTest, SplittingUsesShortSeparators) {
+    LeafNodeTracker left;
+    for (char c = 'a'; c <= 'z'; ++c) {
+        if (!left.Insert(store_key_t(std::string(1, c) + std::string(200, 'x')), "V")) {
+            break;
+        }
+    }
+
+    LeafNodeTracker right;
+    store_key_t median;
+    left.Split(&right, &median);
+    // The keys differ in their first byte, so one byte is enough to tell the halves
+    // apart.
+    ASSERT_EQ(1, median.size());
+}
+
+TEST(LeafNodeTest, ShortestSeparator) {
+    struct {
+        const char *left, *right, *separator;
+    } cases[] = {
+        { "apple", "banana", "b" },
+        { "apple", "b", "apple" },
+        { "abc", "abcd", "abc" },
+        { "abcx", "abdy", "abd" },
+        { "", "a", "" },
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        store_key_t left(cases[i].left), right(cases[i].right), separator;
+        get_shortest_separator(left.btree_key(), right.btree_key(),
+                               separator.writable_btree_key());
+        EXPECT_EQ(std::string(cases[i].separator), key_to_unescaped_str(separator));
+        EXPECT_TRUE(left <= separator);
+        EXPECT_TRUE(separator < right);
+    }
+}
+
 TEST(LeafNodeTest, Fullness) {
     LeafNodeTracker node;
     int i;
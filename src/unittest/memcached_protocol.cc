@@ -143,5 +143,54 @@ TEST(MemcachedProtocol, GetSet) {
     run_in_thread_pool_with_namespace_interface(&run_get_set_test);
 }
 
+/* `GetMulti` tests that a multi-key get finds the keys on both shards */
+void run_get_multi_test(namespace_interface_t<memcached_protocol_t> *nsi, order_source_t *order_source) {
+    const char *keys_to_set[] = { "a", "p" };
+    for (size_t i = 0; i < 2; ++i) {
+        sarc_mutation_t set;
+        set.key = store_key_t(keys_to_set[i]);
+        set.data = data_buffer_t::create(1);
+        set.data->buf()[0] = keys_to_set[i][0];
+        set.flags = i;
+        set.exptime = 0;
+        set.add_policy = add_policy_yes;
+        set.replace_policy = replace_policy_yes;
+        memcached_protocol_t::write_t write(set, time(NULL), 12345);
+
+        cond_t interruptor;
+        memcached_protocol_t::write_response_t result;
+        nsi->write(write, &result, order_source->check_in("unittest::run_get_multi_test(memcached_protocol.cc-A)"), &interruptor);
+        EXPECT_EQ(sr_stored, boost::get<set_result_t>(result.result));
+    }
+
+    std::vector<store_key_t> keys;
+    keys.push_back(store_key_t("a"));
+    keys.push_back(store_key_t("b"));
+    keys.push_back(store_key_t("p"));
+    memcached_protocol_t::read_t read(get_multi_query_t(keys), time(NULL));
+
+    cond_t interruptor;
+    memcached_protocol_t::read_response_t result;
+    nsi->read(read, &result, order_source->check_in("unittest::run_get_multi_test(memcached_protocol.cc-B)").with_read_mode(), &interruptor);
+
+    if (get_multi_result_t *maybe_result = boost::get<get_multi_result_t>(&result.result)) {
+        ASSERT_EQ(2u, maybe_result->values.size());
+        EXPECT_EQ(0u, maybe_result->values.count(store_key_t("b")));
+        const get_result_t &a = maybe_result->values[store_key_t("a")];
+        ASSERT_TRUE(a.value.has());
+        EXPECT_EQ('a', a.value->buf()[0]);
+        EXPECT_EQ(0u, a.flags);
+        const get_result_t &p = maybe_result->values[store_key_t("p")];
+        ASSERT_TRUE(p.value.has());
+        EXPECT_EQ('p', p.value->buf()[0]);
+        EXPECT_EQ(1u, p.flags);
+    } else {
+        ADD_FAILURE() << "got wrong type of result back";
+    }
+}
+TEST(MemcachedProtocol, GetMulti) {
+    run_in_thread_pool_with_namespace_interface(&run_get_multi_test);
+}
+
 }   /* namespace unittest */
 
@@ -0,0 +1,34 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "clustering/administration/http/metrics_app.hpp"
+#include "perfmon/core.hpp"
+
+namespace unittest {
+
+TEST(MetricsApp, RenderPerfmonMetrics) {
+    const std::string table = "2f5f5c3d-7d4c-4e0c-9b3e-6c1d0c7b8a9e";
+
+    scoped_ptr_t<perfmon_result_t> shard = perfmon_result_t::alloc_map_result();
+    shard->insert("keys_read", new perfmon_result_t("12"));
+    shard->insert("avg", new perfmon_result_t("-"));
+    scoped_ptr_t<perfmon_result_t> serializers = perfmon_result_t::alloc_map_result();
+    serializers->insert("shard_3", shard.release());
+    scoped_ptr_t<perfmon_result_t> table_stats = perfmon_result_t::alloc_map_result();
+    table_stats->insert("serializers", serializers.release());
+    table_stats->insert("p99.9", new perfmon_result_t("0.25000000"));
+
+    scoped_ptr_t<perfmon_result_t> root = perfmon_result_t::alloc_map_result();
+    root->insert(table, table_stats.release());
+    root->insert("uptime", new perfmon_result_t("7"));
+
+    EXPECT_EQ("# TYPE rethinkdb_p99_9 untyped\n"
+              "rethinkdb_p99_9{table=\"" + table + "\"} 0.25000000\n"
+              "# TYPE rethinkdb_serializers_keys_read untyped\n"
+              "rethinkdb_serializers_keys_read{table=\"" + table + "\",shard=\"3\"} 12\n"
+              "# TYPE rethinkdb_uptime untyped\n"
+              "rethinkdb_uptime 7\n",
+              render_perfmon_metrics(*root));
+}
+
+}  // namespace unittest
@@ -71,6 +71,15 @@ void mock_file_t::writev_async(int64_t offset, size_t length, scoped_array_t<iov
     write_async(offset, length, buf.get(), account, cb, NO_DATASYNCS);
 }
 
+int mock_file_t::discard(int64_t offset, int64_t length) {
+    guarantee(mode_ & mode_write);
+    guarantee(offset >= 0 && length >= 0);
+    guarantee(static_cast<uint64_t>(offset + length) <= data_->size());
+    // Discarded ranges read back as zeros, like a punched hole.
+    memset(data_->data() + offset, 0, length);
+    return 0;
+}
+
 bool mock_file_t::coop_lock_and_check() {
     // We don't actually implement the locking behavior.
     return true;
@@ -106,6 +115,12 @@ void mock_file_opener_t::open_serializer_file_create_temporary(scoped_ptr_t<file
 void mock_file_opener_t::move_serializer_file_to_permanent_location() {
     ASSERT_EQ(temporary_file, file_existence_state_);
     file_existence_state_ = permanent_file;
+    if (index_file_existence_state_ == temporary_file) {
+        index_file_existence_state_ = permanent_file;
+    }
+    if (archive_file_existence_state_ == temporary_file) {
+        archive_file_existence_state_ = permanent_file;
+    }
 }
 
 void mock_file_opener_t::open_serializer_file_existing(scoped_ptr_t<file_t> *file_out) {
@@ -116,6 +131,46 @@ void mock_file_opener_t::open_serializer_file_existing(scoped_ptr_t<file_t> *fil
 void mock_file_opener_t::unlink_serializer_file() {
     ASSERT_TRUE(file_existence_state_ == temporary_file || file_existence_state_ == permanent_file);
     file_existence_state_ = unlinked_file;
+    if (index_file_existence_state_ != no_file) {
+        index_file_existence_state_ = unlinked_file;
+    }
+    if (archive_file_existence_state_ != no_file) {
+        archive_file_existence_state_ = unlinked_file;
+    }
+}
+
+std::string mock_file_opener_t::index_file_name() const {
+    return "<mock index file>";
+}
+
+void mock_file_opener_t::open_index_file_create_temporary(scoped_ptr_t<file_t> *file_out) {
+    ASSERT_TRUE(with_index_file_);
+    ASSERT_EQ(no_file, index_file_existence_state_);
+    file_out->init(new mock_file_t(mock_file_t::mode_rw, &index_file_));
+    index_file_existence_state_ = temporary_file;
+}
+
+void mock_file_opener_t::open_index_file_existing(scoped_ptr_t<file_t> *file_out) {
+    ASSERT_TRUE(index_file_existence_state_ == temporary_file
+                || index_file_existence_state_ == permanent_file);
+    file_out->init(new mock_file_t(mock_file_t::mode_rw, &index_file_));
+}
+
+std::string mock_file_opener_t::archive_file_name() const {
+    return "<mock archive file>";
+}
+
+void mock_file_opener_t::open_archive_file_create_temporary(scoped_ptr_t<file_t> *file_out) {
+    ASSERT_TRUE(with_archive_file_);
+    ASSERT_EQ(no_file, archive_file_existence_state_);
+    file_out->init(new mock_file_t(mock_file_t::mode_rw, &archive_file_));
+    archive_file_existence_state_ = temporary_file;
+}
+
+void mock_file_opener_t::open_archive_file_existing(scoped_ptr_t<file_t> *file_out) {
+    ASSERT_TRUE(archive_file_existence_state_ == temporary_file
+                || archive_file_existence_state_ == permanent_file);
+    file_out->init(new mock_file_t(mock_file_t::mode_rw, &archive_file_));
 }
 
 #ifdef SEMANTIC_SERIALIZER_CHECK
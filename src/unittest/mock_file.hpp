@@ -32,7 +32,10 @@ public:
     void writev_async(int64_t offset, size_t length, scoped_array_t<iovec> &&bufs,
                       file_account_t *account, linux_iocallback_t *cb);
 
-    void *create_account(UNUSED int priority, UNUSED int outstanding_requests_limit) {
+    int discard(int64_t offset, int64_t length);
+
+    void *create_account(UNUSED int priority, UNUSED int outstanding_requests_limit,
+                         UNUSED int deadline_ms) {
         // We don't care about accounts.  Return an arbitrary non-null pointer.
         return this;
     }
@@ -69,7 +72,15 @@ private:
 
 class mock_file_opener_t : public serializer_file_opener_t {
 public:
-    mock_file_opener_t() : file_existence_state_(no_file) { }
+    // With with_index_file, the serializer gets a separate (mock) index file, and
+    // with with_archive_file, a separate (mock) archive file.
+    explicit mock_file_opener_t(bool with_index_file = false,
+                                bool with_archive_file = false)
+        : with_index_file_(with_index_file),
+          with_archive_file_(with_archive_file),
+          file_existence_state_(no_file),
+          index_file_existence_state_(no_file),
+          archive_file_existence_state_(no_file) { }
     std::string file_name() const;
 
     void open_serializer_file_create_temporary(scoped_ptr_t<file_t> *file_out);
@@ -80,10 +91,30 @@ public:
     void open_semantic_checking_file(scoped_ptr_t<semantic_checking_file_t> *file_out);
 #endif
 
+    bool has_index_file() const { return with_index_file_; }
+    std::string index_file_name() const;
+    void open_index_file_create_temporary(scoped_ptr_t<file_t> *file_out);
+    void open_index_file_existing(scoped_ptr_t<file_t> *file_out);
+
+    bool has_archive_file() const { return with_archive_file_; }
+    std::string archive_file_name() const;
+    void open_archive_file_create_temporary(scoped_ptr_t<file_t> *file_out);
+    void open_archive_file_existing(scoped_ptr_t<file_t> *file_out);
+
+    size_t file_size() const { return file_.size(); }
+    size_t index_file_size() const { return index_file_.size(); }
+    size_t archive_file_size() const { return archive_file_.size(); }
+
 private:
     enum existence_state_t { no_file, temporary_file, permanent_file, unlinked_file };
+    const bool with_index_file_;
+    const bool with_archive_file_;
     existence_state_t file_existence_state_;
+    existence_state_t index_file_existence_state_;
+    existence_state_t archive_file_existence_state_;
     std::vector<char> file_;
+    std::vector<char> index_file_;
+    std::vector<char> archive_file_;
 #ifdef SEMANTIC_SERIALIZER_CHECK
     std::vector<char> semantic_checking_file_;
 #endif
@@ -0,0 +1,34 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "concurrency/new_semaphore.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+TPTEST(NewSemaphore, PriorityWeights) {
+    new_semaphore_t semaphore(1);
+    semaphore.set_priority_weights(2, 1);
+    scoped_ptr_t<new_semaphore_acq_t> holder(new new_semaphore_acq_t(&semaphore, 1));
+    ASSERT_TRUE(holder->acquisition_signal()->is_pulsed());
+
+    const semaphore_priority_t normal = semaphore_priority_t::normal;
+    const semaphore_priority_t background = semaphore_priority_t::background;
+    new_semaphore_acq_t n1(&semaphore, 1, normal);
+    new_semaphore_acq_t b1(&semaphore, 1, background);
+    new_semaphore_acq_t n2(&semaphore, 1, normal);
+    new_semaphore_acq_t b2(&semaphore, 1, background);
+    new_semaphore_acq_t n3(&semaphore, 1, normal);
+
+    // Two normal acquirers get through for every background one, and each line
+    // stays in order.
+    new_semaphore_acq_t *expected[] = { &n1, &n2, &b1, &n3, &b2 };
+    holder.reset();
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i) {
+        for (size_t j = i; j < sizeof(expected) / sizeof(expected[0]); ++j) {
+            EXPECT_EQ(i == j, expected[j]->acquisition_signal()->is_pulsed());
+        }
+        expected[i]->reset();
+    }
+}
+
+}  // namespace unittest
@@ -18,6 +18,7 @@ using alt::page_cache_t;
 using alt::page_create_t;
 using alt::page_t;
 using alt::page_txn_t;
+using alt::txn_flush_t;
 
 namespace unittest {
 
@@ -46,21 +47,35 @@ class test_txn_t;
 class test_cache_t : public page_cache_t {
 public:
     test_cache_t(serializer_t *serializer, alt_memory_tracker_t *tracker)
-        : page_cache_t(serializer, page_cache_config_t(), tracker),
+        : page_cache_t(serializer, page_cache_config_t(), tracker, NULL),
           tracker_(tracker) { }
     test_cache_t(serializer_t *serializer, alt_memory_tracker_t *tracker,
                  uint64_t memory_limit)
-        : page_cache_t(serializer, make_config(memory_limit), tracker),
+        : page_cache_t(serializer, make_config(memory_limit), tracker, NULL),
+          tracker_(tracker) { }
+    test_cache_t(serializer_t *serializer, alt_memory_tracker_t *tracker,
+                 const page_cache_config_t &config)
+        : page_cache_t(serializer, config, tracker, NULL),
           tracker_(tracker) { }
 
     void flush(scoped_ptr_t<test_txn_t> txn) {
         flush_and_destroy_txn(std::move(txn), &reset_tracker_acq);
     }
 
+    // Sets *flushed_out once the flush is complete.
+    void flush(scoped_ptr_t<test_txn_t> txn, txn_flush_t flush, bool *flushed_out) {
+        flush_and_destroy_txn(std::move(txn),
+                              [flushed_out](alt::tracker_acq_t *acq) {
+                                  reset_tracker_acq(acq);
+                                  *flushed_out = true;
+                              },
+                              flush);
+    }
+
     alt::tracker_acq_t make_tracker_acq() {
         // KSI: We could make these tests better by varying the expected change
         // count.
-        return tracker_->begin_txn_or_throttle(0);
+        return tracker_->begin_txn_or_throttle(0, semaphore_priority_t::normal);
     }
 
 private:
@@ -308,6 +323,91 @@ TPTEST(PageTest, WriteWaitForFlush, 4) {
     pmap(2, std::bind(&WriteWaitForFlush_cases, &s, &page_cache, ph::_1));
 }
 
+void write_block(test_cache_t *page_cache, test_txn_t *txn, block_id_t block_id,
+                 page_create_t create) {
+    current_test_acq_t acq(txn, block_id, access_t::write, create);
+    test_acq_t page_acq;
+    page_acq.init(acq.current_page_for_write(), page_cache);
+    page_acq.buf_ready_signal()->wait();
+    ASSERT_TRUE(page_acq.get_buf_write() != NULL);
+}
+
+TPTEST(PageTest, GroupedFlushWaitsForWindow, 4) {
+    mock_ser_t mock;
+    page_cache_config_t config;
+    config.group_soft_loss_window_ms = 300;
+    test_cache_t page_cache(mock.ser.get(), mock.tracker.get(), config);
+
+    bool flushed1 = false;
+    bool flushed2 = false;
+    auto txn1 = make_scoped<test_txn_t>(&page_cache);
+    write_block(&page_cache, txn1.get(), 0, page_create_t::yes);
+    page_cache.flush(std::move(txn1), txn_flush_t::grouped, &flushed1);
+    auto txn2 = make_scoped<test_txn_t>(&page_cache);
+    write_block(&page_cache, txn2.get(), 1, page_create_t::yes);
+    page_cache.flush(std::move(txn2), txn_flush_t::grouped, &flushed2);
+
+    nap(50);
+    ASSERT_FALSE(flushed1);
+    ASSERT_FALSE(flushed2);
+    nap(2000);
+    ASSERT_TRUE(flushed1);
+    ASSERT_TRUE(flushed2);
+}
+
+TPTEST(PageTest, GroupedFlushTakenAlong, 4) {
+    mock_ser_t mock;
+    page_cache_config_t config;
+    config.group_soft_loss_window_ms = 60 * 1000;
+    test_cache_t page_cache(mock.ser.get(), mock.tracker.get(), config);
+
+    bool grouped_flushed = false;
+    auto txn1 = make_scoped<test_txn_t>(&page_cache);
+    write_block(&page_cache, txn1.get(), 0, page_create_t::yes);
+    page_cache.flush(std::move(txn1), txn_flush_t::grouped, &grouped_flushed);
+
+    // A txn that has to flush after the grouped one doesn't wait for the timer.
+    bool flushed = false;
+    auto txn2 = make_scoped<test_txn_t>(&page_cache);
+    write_block(&page_cache, txn2.get(), 0, page_create_t::no);
+    page_cache.flush(std::move(txn2), txn_flush_t::now, &flushed);
+
+    nap(2000);
+    ASSERT_TRUE(grouped_flushed);
+    ASSERT_TRUE(flushed);
+}
+
+TPTEST(PageTest, ReadCountsCacheMiss, 4) {
+    mock_ser_t mock;
+    {
+        test_cache_t page_cache(mock.ser.get(), mock.tracker.get());
+        auto txn = make_scoped<test_txn_t>(&page_cache);
+        write_block(&page_cache, txn.get(), 0, page_create_t::yes);
+        page_cache.flush(std::move(txn));
+    }
+
+    // A fresh cache has to load the block from the serializer.
+    test_cache_t page_cache(mock.ser.get(), mock.tracker.get());
+    auto txn = make_scoped<test_txn_t>(&page_cache);
+    {
+        current_test_acq_t acq(txn.get(), 0, access_t::read);
+        test_acq_t page_acq;
+        page_acq.init(acq.current_page_for_read(), &page_cache);
+        page_acq.buf_ready_signal()->wait();
+        ASSERT_TRUE(page_acq.cache_miss());
+        ASSERT_LT(0u, page_acq.disk_bytes_read());
+    }
+    {
+        current_test_acq_t acq(txn.get(), 0, access_t::read);
+        test_acq_t page_acq;
+        page_acq.init(acq.current_page_for_read(), &page_cache);
+        page_acq.buf_ready_signal()->wait();
+        ASSERT_FALSE(page_acq.cache_miss());
+        ASSERT_EQ(0u, page_acq.disk_bytes_read());
+    }
+    page_cache.flush(std::move(txn));
+}
+
 class bigger_test_t {
 public:
     explicit bigger_test_t(uint64_t _memory_limit)
@@ -1078,13 +1178,13 @@ private:
         test_acq_t page_acq;
         page_acq.init(acq->current_page_for_write(), c);
         const uint32_t n = page_acq.get_buf_size().value();
-        ASSERT_EQ(4088u, n);
+        ASSERT_EQ(4080u, n);
         memset(page_acq.get_buf_write(), 0, n);
     }
 
     void check_page_acq(page_acq_t *page_acq, const std::string &expected) {
         const uint32_t n = page_acq->get_buf_size().value();
-        ASSERT_EQ(4088u, n);
+        ASSERT_EQ(4080u, n);
         const char *const p = static_cast<const char *>(page_acq->get_buf_read());
 
         ASSERT_LE(expected.size() + 1, n);
@@ -1117,7 +1217,7 @@ private:
             check_page_acq(&page_acq, expected);
 
             char *const p = static_cast<char *>(page_acq.get_buf_write());
-            ASSERT_EQ(4088u, page_acq.get_buf_size().value());
+            ASSERT_EQ(4080u, page_acq.get_buf_size().value());
             ASSERT_LE(expected.size() + append.size() + 1,
                       page_acq.get_buf_size().value());
             memcpy(p + expected.size(), append.c_str(), append.size() + 1);
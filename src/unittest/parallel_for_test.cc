@@ -0,0 +1,89 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "unittest/gtest.hpp"
+
+#include "concurrency/parallel_for.hpp"
+#include "unittest/unittest_utils.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+class count_chunk_fn_t {
+public:
+    explicit count_chunk_fn_t(std::vector<int> *_hits) : hits(_hits) { }
+    void operator()(size_t begin, size_t end) const {
+        for (size_t i = begin; i < end; ++i) {
+            __sync_fetch_and_add(&(*hits)[i], 1);
+        }
+    }
+private:
+    std::vector<int> *hits;
+};
+
+TPTEST(ParallelForTest, CoversEveryIndexOnce, 4) {
+    std::vector<int> hits(10001, 0);
+    parallel_for_chunks(hits.size(), 64, count_chunk_fn_t(&hits));
+    for (size_t i = 0; i < hits.size(); ++i) {
+        ASSERT_EQ(1, hits[i]);
+    }
+}
+
+class count_index_fn_t {
+public:
+    explicit count_index_fn_t(std::vector<int> *_hits) : hits(_hits) { }
+    void operator()(size_t i) const {
+        __sync_fetch_and_add(&(*hits)[i], 1);
+    }
+private:
+    std::vector<int> *hits;
+};
+
+TPTEST(ParallelForTest, MapCoversEveryIndexOnce, 4) {
+    const size_t counts[] = { 0, 1, 3, 16, 1001 };
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+        SCOPED_TRACE(counts[c]);
+        std::vector<int> hits(counts[c], 0);
+        parallel_map_across_threads(hits.size(), count_index_fn_t(&hits));
+        for (size_t i = 0; i < hits.size(); ++i) {
+            ASSERT_EQ(1, hits[i]);
+        }
+    }
+}
+
+class throwing_chunk_fn_t {
+public:
+    void operator()(size_t begin, size_t) const {
+        if (begin == 8 * 16) {
+            throw std::runtime_error("chunk failed");
+        }
+    }
+};
+
+TPTEST(ParallelForTest, RethrowsOnCaller, 4) {
+    const threadnum_t thread = get_thread_id();
+    ASSERT_THROW(parallel_for_chunks(1000, 16, throwing_chunk_fn_t()),
+                 std::runtime_error);
+    ASSERT_TRUE(thread == get_thread_id());
+}
+
+TPTEST(ParallelForTest, Sort, 4) {
+    for (size_t size = PARALLEL_SORT_MIN_SIZE - 1;
+         size < 4 * PARALLEL_SORT_MIN_SIZE;
+         size += PARALLEL_SORT_MIN_SIZE + PARALLEL_SORT_CHUNK_SIZE / 3) {
+        SCOPED_TRACE(size);
+        std::vector<int> values(size);
+        for (size_t i = 0; i < size; ++i) {
+            values[i] = randint(1000);
+        }
+        std::vector<int> expected = values;
+        std::sort(expected.begin(), expected.end());
+
+        parallel_sort(values.begin(), values.end(), std::less<int>());
+        ASSERT_TRUE(values == expected);
+    }
+}
+
+}  // namespace unittest
@@ -5,8 +5,10 @@
 
 #include <cmath>  // for std::isnan -- read the comment below.
 
+#include "perfmon/filter.hpp"
 #include "perfmon/perfmon.hpp"
 #include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
 
 namespace unittest {
 
@@ -57,4 +59,121 @@ TEST(PerfmonTest, StddevComputation) {
     }
 }
 
+TPTEST(PerfmonTest, LatencyHistogram) {
+    perfmon_latency_histogram_t histogram;
+    histogram.record(secs_to_ticks(1) / 2000);
+    histogram.record(secs_to_ticks(1) / 200);
+    histogram.record(secs_to_ticks(1) / 200);
+    histogram.record(secs_to_ticks(20));
+
+    void *data = histogram.begin_stats();
+    histogram.visit_stats(data);
+    scoped_ptr_t<perfmon_result_t> result = histogram.end_stats(data);
+    ASSERT_TRUE(result->is_map());
+    const perfmon_result_t::internal_map_t *map
+        = static_cast<const perfmon_result_t *>(result.get())->get_map();
+
+    const char *const names[] = {
+        "under_1ms", "under_10ms", "under_100ms", "under_1s", "under_10s", "over_10s"
+    };
+    const char *const counts[] = { "1", "2", "0", "0", "0", "1" };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        auto it = map->find(names[i]);
+        ASSERT_TRUE(it != map->end()) << names[i];
+        EXPECT_EQ(counts[i], *it->second->get_string()) << names[i];
+    }
+
+    // Nothing was recorded in the last full window.
+    auto recent = map->find("recent");
+    ASSERT_TRUE(recent != map->end());
+    ASSERT_TRUE(recent->second->is_map());
+    const perfmon_result_t::internal_map_t *recent_map
+        = static_cast<const perfmon_result_t *>(recent->second)->get_map();
+    EXPECT_EQ("0", *recent_map->find("count")->second->get_string());
+    EXPECT_EQ("-", *recent_map->find("p99")->second->get_string());
+}
+
+TEST(PerfmonTest, LogLinearHistogram) {
+    // The buckets are contiguous and each covers at most an eighth of its start.
+    for (int i = 1; i < latency_histogram_t::NUM_BUCKETS; ++i) {
+        const uint64_t start = latency_histogram_t::bucket_end(i - 1);
+        EXPECT_EQ(i, latency_histogram_t::bucket_for(start));
+        EXPECT_EQ(i - 1, latency_histogram_t::bucket_for(start - 1));
+        EXPECT_LE((latency_histogram_t::bucket_end(i) - start) * 8, std::max<uint64_t>(8, start));
+    }
+    EXPECT_EQ(latency_histogram_t::NUM_BUCKETS - 1,
+              latency_histogram_t::bucket_for(uint64_t(1) << 40));
+
+    const ticks_t micro = secs_to_ticks(1) / MILLION;
+    latency_histogram_t histogram;
+    EXPECT_EQ(0u, histogram.percentile(0.5));
+    for (int i = 1; i <= 1000; ++i) {
+        histogram.record(i * micro);
+    }
+    EXPECT_EQ(1000u, histogram.count());
+    EXPECT_EQ(1000 * micro, histogram.max());
+    const ticks_t p50 = histogram.percentile(0.5);
+    EXPECT_GE(p50, 500 * micro);
+    EXPECT_LE(p50, 500 * micro * 9 / 8);
+    const ticks_t p99 = histogram.percentile(0.99);
+    EXPECT_GE(p99, 990 * micro);
+    EXPECT_LE(p99, 1000 * micro);
+
+    // Merging adds up the counts.
+    latency_histogram_t other;
+    for (int i = 0; i < 1000; ++i) {
+        other.record(10 * secs_to_ticks(1));
+    }
+    histogram.merge(other);
+    EXPECT_EQ(2000u, histogram.count());
+    EXPECT_EQ(10 * secs_to_ticks(1), histogram.max());
+    EXPECT_LE(histogram.percentile(0.5), 1000 * micro);
+    EXPECT_EQ(10 * secs_to_ticks(1), histogram.percentile(0.51));
+}
+
+// Counts how many times it was collected.
+class counting_perfmon_t : public perfmon_t {
+public:
+    counting_perfmon_t() : collections(0) { }
+    void *begin_stats() {
+        ++collections;
+        return NULL;
+    }
+    void visit_stats(void *) { }
+    scoped_ptr_t<perfmon_result_t> end_stats(void *) {
+        return make_scoped<perfmon_result_t>("1");
+    }
+    int collections;
+};
+
+TPTEST(PerfmonTest, FilteredCollection) {
+    perfmon_collection_t root, a, b;
+    counting_perfmon_t a_stat, b_stat, spliced_stat;
+    perfmon_collection_t spliced;
+    perfmon_membership_t a_membership(&root, &a, "a");
+    perfmon_membership_t b_membership(&root, &b, "b");
+    perfmon_membership_t a_stat_membership(&a, &a_stat, "stat");
+    perfmon_membership_t b_stat_membership(&b, &b_stat, "stat");
+    perfmon_membership_t spliced_membership(&root, &spliced, "");
+    perfmon_membership_t spliced_stat_membership(&spliced, &spliced_stat, "c");
+
+    std::set<std::string> paths;
+    paths.insert("a/stat");
+    paths.insert("c");
+    perfmon_filter_t filter(paths);
+    void *data = root.begin_filtered_stats(&filter, 0, filter.all_paths_active());
+    root.visit_stats(data);
+    scoped_ptr_t<perfmon_result_t> result = root.end_stats(data);
+    filter.filter(&result);
+
+    EXPECT_EQ(1, a_stat.collections);
+    EXPECT_EQ(0, b_stat.collections);
+    EXPECT_EQ(1, spliced_stat.collections);
+    const perfmon_result_t::internal_map_t *map
+        = static_cast<const perfmon_result_t *>(result.get())->get_map();
+    EXPECT_EQ(2u, map->size());
+    EXPECT_EQ(1u, map->count("a"));
+    EXPECT_EQ(1u, map->count("c"));
+}
+
 }  // namespace unittest
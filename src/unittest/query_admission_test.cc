@@ -0,0 +1,76 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <functional>
+
+#include "arch/runtime/coroutines.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/query_admission.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+typedef ql::query_admission_t::acq_t admission_acq_t;
+
+static void enter_in_background(admission_acq_t *acq, ql::query_admission_t *admission,
+                                signal_t *interruptor, int *result_out,
+                                cond_t *done) {
+    try {
+        *result_out = acq->enter(admission, interruptor) ? 1 : 0;
+    } catch (const interrupted_exc_t &) {
+        *result_out = -1;
+    }
+    done->pulse();
+}
+
+TPTEST(QueryAdmission, QueuesAtTheLimit) {
+    ql::query_admission_t admission(2, 60 * 1000);
+    cond_t interruptor;
+    scoped_ptr_t<admission_acq_t> first(new admission_acq_t);
+    admission_acq_t second, third;
+    ASSERT_TRUE(first->enter(&admission, &interruptor));
+    ASSERT_TRUE(second.enter(&admission, &interruptor));
+    EXPECT_EQ(2, admission.get_running());
+
+    int result = 0;
+    cond_t done;
+    coro_t::spawn_now_dangerously(std::bind(&enter_in_background, &third, &admission,
+                                            &interruptor, &result, &done));
+    EXPECT_FALSE(done.is_pulsed());
+    EXPECT_EQ(1, admission.get_queued());
+
+    // The query that waited gets the turn that's given back.
+    first.reset();
+    done.wait();
+    EXPECT_EQ(1, result);
+    EXPECT_EQ(0, admission.get_queued());
+    EXPECT_EQ(2, admission.get_running());
+}
+
+TPTEST(QueryAdmission, TurnsAwayAfterTimeout) {
+    ql::query_admission_t admission(1, 10);
+    cond_t interruptor;
+    admission_acq_t first, second;
+    ASSERT_TRUE(first.enter(&admission, &interruptor));
+    EXPECT_FALSE(second.enter(&admission, &interruptor));
+    EXPECT_EQ(0, admission.get_queued());
+    EXPECT_EQ(1, admission.get_running());
+}
+
+TPTEST(QueryAdmission, Interrupted) {
+    ql::query_admission_t admission(1, 60 * 1000);
+    cond_t interruptor;
+    admission_acq_t first, second;
+    ASSERT_TRUE(first.enter(&admission, &interruptor));
+
+    int result = 0;
+    cond_t done;
+    coro_t::spawn_now_dangerously(std::bind(&enter_in_background, &second, &admission,
+                                            &interruptor, &result, &done));
+    interruptor.pulse();
+    done.wait();
+    EXPECT_EQ(-1, result);
+    EXPECT_EQ(0, admission.get_queued());
+    EXPECT_EQ(1, admission.get_running());
+}
+
+}  // namespace unittest
@@ -0,0 +1,40 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <vector>
+
+#include "unittest/gtest.hpp"
+
+#include "config/args.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/query_memory.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+TPTEST(QueryMemoryTest, PerQueryLimit) {
+    ql::query_memory_t memory;
+    ASSERT_TRUE(memory.try_charge(QUERY_MEMORY_LIMIT - 10));
+    EXPECT_FALSE(memory.try_charge(11));
+    EXPECT_THROW(memory.charge(11), ql::datum_exc_t);
+    EXPECT_EQ(QUERY_MEMORY_LIMIT - 10, memory.get_used());
+
+    memory.release(100);
+    memory.charge(11);
+    EXPECT_EQ(QUERY_MEMORY_LIMIT - 99, memory.get_used());
+}
+
+TPTEST(QueryMemoryTest, GlobalLimit) {
+    const int queries = GLOBAL_QUERY_MEMORY_LIMIT / QUERY_MEMORY_LIMIT;
+    std::vector<scoped_ptr_t<ql::query_memory_t> > memories;
+    for (int i = 0; i < queries; ++i) {
+        memories.push_back(make_scoped<ql::query_memory_t>());
+        ASSERT_TRUE(memories.back()->try_charge(QUERY_MEMORY_LIMIT));
+    }
+    ql::query_memory_t memory;
+    EXPECT_FALSE(memory.try_charge(1));
+
+    // A query gives its memory back when it's over.
+    memories.pop_back();
+    EXPECT_TRUE(memory.try_charge(1));
+}
+
+}  // namespace unittest
@@ -5,6 +5,7 @@
 #include "clustering/immediate_consistency/branch/broadcaster.hpp"
 #include "clustering/immediate_consistency/branch/listener.hpp"
 #include "clustering/immediate_consistency/branch/replier.hpp"
+#include "containers/archive/string_stream.hpp"
 #include "extproc/extproc_pool.hpp"
 #include "extproc/extproc_spawner.hpp"
 #include "rdb_protocol/minidriver.hpp"
@@ -242,6 +243,37 @@ TEST(RDBProtocolBackfill, BackfillLargeValues) {
                        ph::_5, ph::_6, ph::_7, ph::_8));
 }
 
+TEST(RDBProtocolBackfill, KeyValuePairsSerialization) {
+    const char *keys[] = { "", "user:1", "user:10", "user:2", "user", "zzz" };
+    const uint64_t recencies[] = { 7, 5, 1000000, 5, 6, 123456789 };
+    std::vector<rdb_protocol_details::backfill_atom_t> atoms;
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+        repli_timestamp_t recency;
+        recency.longtime = recencies[i];
+        atoms.push_back(rdb_protocol_details::backfill_atom_t(
+            store_key_t(keys[i]),
+            make_counted<const ql::datum_t>(static_cast<double>(i)),
+            recency));
+    }
+    std::vector<rdb_protocol_details::backfill_atom_t> atoms_copy = atoms;
+    rdb_protocol_t::backfill_chunk_t::key_value_pairs_t kv(std::move(atoms_copy));
+
+    string_stream_t write_stream;
+    write_message_t wm;
+    wm << kv;
+    ASSERT_EQ(0, send_write_message(&write_stream, &wm));
+
+    string_read_stream_t read_stream(std::move(write_stream.str()), 0);
+    rdb_protocol_t::backfill_chunk_t::key_value_pairs_t kv_out;
+    ASSERT_EQ(archive_result_t::SUCCESS, deserialize(&read_stream, &kv_out));
+    ASSERT_EQ(atoms.size(), kv_out.backfill_atoms.size());
+    for (size_t i = 0; i < atoms.size(); ++i) {
+        EXPECT_EQ(atoms[i].key, kv_out.backfill_atoms[i].key);
+        EXPECT_EQ(*atoms[i].value, *kv_out.backfill_atoms[i].value);
+        EXPECT_EQ(atoms[i].recency, kv_out.backfill_atoms[i].recency);
+    }
+}
+
 void run_sindex_backfill_test(std::pair<io_backender_t *, simple_mailbox_cluster_t *> io_backender_and_cluster,
                               branch_history_manager_t<rdb_protocol_t> *branch_history_manager,
                               clone_ptr_t<watchable_t<boost::optional<boost::optional<broadcaster_business_card_t<rdb_protocol_t> > > > > broadcaster_metadata_view,
@@ -9,6 +9,7 @@
 #include "containers/archive/boost_types.hpp"
 #include "containers/archive/vector_stream.hpp"
 #include "rdb_protocol/btree.hpp"
+#include "rdb_protocol/lazy_json.hpp"
 #include "rdb_protocol/minidriver.hpp"
 #include "rdb_protocol/pb_utils.hpp"
 #include "rdb_protocol/protocol.hpp"
@@ -429,6 +430,7 @@ TPTEST(RDBBtree, SindexEraseRange) {
                               key_range_t::universe(),
                               &sindex_block,
                               super_block.get(), &store,
+                              NULL,
                               &dummy_interruptor);
     }
 
@@ -513,4 +515,81 @@ TPTEST(RDBBtree, SindexInterruptionViaStoreDelete) {
     store.reset();
 }
 
+TPTEST(RDBBtree, LargeBlocksStoreDocumentsInline) {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t(16 * KILOBYTE));
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    rdb_protocol_t::store_t store(
+            &serializer,
+            "unit_test_store",
+            GIGABYTE,
+            true,
+            &get_global_perfmon_collection(),
+            NULL,
+            &io_backender,
+            base_path_t("."));
+
+    const block_size_t block_size = store.cache->get_block_size();
+    ASSERT_EQ(16 * KILOBYTE, block_size.ser_value());
+    const int maxreflen = rdb_value_maxreflen(block_size);
+    ASSERT_EQ(16 * KILOBYTE / RDB_IN_NODE_VALUE_BLOCK_FRACTION, maxreflen);
+
+    cond_t dummy_interruptor;
+    const std::string text(1500, 'x');
+    store_key_t pk(make_counted<const ql::datum_t>(0.0)->print_primary());
+    {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        write_token_pair_t token_pair;
+        store.new_write_token_pair(&token_pair);
+        store.acquire_superblock_for_write(
+            repli_timestamp_t::invalid,
+            1, write_durability_t::SOFT,
+            &token_pair, &txn, &superblock, &dummy_interruptor);
+
+        std::string data = strprintf("{\"id\" : 0, \"text\" : \"%s\"}", text.c_str());
+        point_write_response_t response;
+        rdb_modification_report_t mod_report(pk);
+        rdb_live_deletion_context_t deletion_context;
+        rdb_set(pk,
+                make_counted<ql::datum_t>(scoped_cJSON_t(cJSON_Parse(data.c_str()))),
+                false, store.btree.get(), repli_timestamp_t::invalid,
+                superblock.get(), &deletion_context, &response, &mod_report.info,
+                static_cast<profile::trace_t *>(NULL));
+    }
+
+    read_token_pair_t token_pair;
+    store.new_read_token_pair(&token_pair);
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    store.acquire_superblock_for_read(
+            &token_pair.main_read_token, &txn, &superblock,
+            &dummy_interruptor, true);
+
+    keyvalue_location_t<rdb_value_t> kv_location;
+    find_keyvalue_location_for_read(superblock.get(), pk.btree_key(), &kv_location,
+                                    &store.btree->stats,
+                                    static_cast<profile::trace_t *>(NULL));
+    ASSERT_TRUE(kv_location.value.has());
+
+    // The document is stored in the leaf node rather than in a blob.
+    EXPECT_EQ(0, blob::ref_info(block_size, kv_location.value->value_ref(),
+                                maxreflen).levels);
+    counted_t<const ql::datum_t> doc = get_data(kv_location.value.get(),
+                                                buf_parent_t(&kv_location.buf));
+    EXPECT_EQ(text, doc->get("text")->as_str().to_std());
+}
+
 } //namespace unittest
@@ -97,6 +97,17 @@ void mock_namespace_interface_t::read_visitor_t::operator()(const rdb_protocol_t
     }
 }
 
+void mock_namespace_interface_t::read_visitor_t::operator()(const rdb_protocol_t::batched_point_read_t &get) {
+    response->response = rdb_protocol_t::batched_point_read_response_t();
+    rdb_protocol_t::batched_point_read_response_t &res = boost::get<rdb_protocol_t::batched_point_read_response_t>(response->response);
+
+    for (auto it = get.keys.begin(); it != get.keys.end(); ++it) {
+        if (data->find(*it) != data->end()) {
+            res.rows[*it] = make_counted<ql::datum_t>(scoped_cJSON_t(data->at(*it)->DeepCopy()));
+        }
+    }
+}
+
 void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(UNUSED const rdb_protocol_t::rget_read_t &rget) {
     throw cannot_perform_query_exc_t("unimplemented");
 }
@@ -105,6 +116,18 @@ void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(UNUSED cons
     throw cannot_perform_query_exc_t("unimplemented");
 }
 
+void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(UNUSED const rdb_protocol_t::sample_read_t &sr) {
+    throw cannot_perform_query_exc_t("unimplemented");
+}
+
+void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(UNUSED const rdb_protocol_t::changefeed_subscribe_t &s) {
+    throw cannot_perform_query_exc_t("unimplemented");
+}
+
+void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(UNUSED const rdb_protocol_t::export_read_t &er) {
+    throw cannot_perform_query_exc_t("unimplemented");
+}
+
 void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(UNUSED const rdb_protocol_t::sindex_list_t &sinner) {
     throw cannot_perform_query_exc_t("unimplemented");
 }
@@ -227,6 +250,10 @@ void NORETURN mock_namespace_interface_t::write_visitor_t::operator()(const rdb_
     throw cannot_perform_query_exc_t("unimplemented");
 }
 
+void NORETURN mock_namespace_interface_t::write_visitor_t::operator()(const rdb_protocol_t::freeze_t &) {
+    throw cannot_perform_query_exc_t("unimplemented");
+}
+
 mock_namespace_interface_t::write_visitor_t::write_visitor_t(std::map<store_key_t, scoped_cJSON_t*> *_data,
                                                              ql::env_t *_env,
                                                              rdb_protocol_t::write_response_t *_response) :
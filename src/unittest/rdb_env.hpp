@@ -66,8 +66,12 @@ private:
 
     struct read_visitor_t : public boost::static_visitor<void> {
         void operator()(const rdb_protocol_t::point_read_t &get);
+        void operator()(const rdb_protocol_t::batched_point_read_t &get);
         void NORETURN operator()(UNUSED const rdb_protocol_t::rget_read_t &rget);
         void NORETURN operator()(UNUSED const rdb_protocol_t::distribution_read_t &dg);
+        void NORETURN operator()(UNUSED const rdb_protocol_t::sample_read_t &sr);
+        void NORETURN operator()(UNUSED const rdb_protocol_t::changefeed_subscribe_t &s);
+        void NORETURN operator()(UNUSED const rdb_protocol_t::export_read_t &er);
         void NORETURN operator()(UNUSED const rdb_protocol_t::sindex_list_t &sl);
         void NORETURN operator()(UNUSED const rdb_protocol_t::sindex_status_t &ss);
 
@@ -85,6 +89,7 @@ private:
         void NORETURN operator()(UNUSED const rdb_protocol_t::sindex_create_t &s);
         void NORETURN operator()(UNUSED const rdb_protocol_t::sindex_drop_t &s);
         void NORETURN operator()(UNUSED const rdb_protocol_t::sync_t &s);
+        void NORETURN operator()(UNUSED const rdb_protocol_t::freeze_t &f);
 
         write_visitor_t(std::map<store_key_t, scoped_cJSON_t*> *_data, ql::env_t *_env, rdb_protocol_t::write_response_t *_response);
 
@@ -0,0 +1,42 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <re2/re2.h>
+
+#include <string>
+
+#include "unittest/gtest.hpp"
+
+#include "config/args.hpp"
+#include "rdb_protocol/regex_cache.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+TPTEST(RegexCacheTest, ReusesCompiledPatterns) {
+    boost::shared_ptr<const RE2> a = ql::get_compiled_regex("^foo");
+    ASSERT_TRUE(a->ok());
+    ASSERT_EQ(a.get(), ql::get_compiled_regex("^foo").get());
+    ASSERT_NE(a.get(), ql::get_compiled_regex("^bar").get());
+
+    // Patterns that don't compile are compiled again every time.
+    boost::shared_ptr<const RE2> bad = ql::get_compiled_regex("(");
+    ASSERT_FALSE(bad->ok());
+    ASSERT_NE(bad.get(), ql::get_compiled_regex("(").get());
+}
+
+TPTEST(RegexCacheTest, EvictsLeastRecentlyUsed) {
+    boost::shared_ptr<const RE2> first = ql::get_compiled_regex("first");
+    for (int i = 0; i < REGEX_CACHE_SIZE; ++i) {
+        ql::get_compiled_regex("pattern" + std::to_string(i));
+        // Keeps "first" the most recently used.
+        ql::get_compiled_regex("first");
+    }
+    ASSERT_EQ(first.get(), ql::get_compiled_regex("first").get());
+
+    boost::shared_ptr<const RE2> pattern0 = ql::get_compiled_regex("pattern0");
+    for (int i = 0; i < REGEX_CACHE_SIZE; ++i) {
+        ql::get_compiled_regex("other" + std::to_string(i));
+    }
+    ASSERT_NE(pattern0.get(), ql::get_compiled_regex("pattern0").get());
+}
+
+}  // namespace unittest
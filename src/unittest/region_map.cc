@@ -3,6 +3,7 @@
 
 #include "mock/dummy_protocol.hpp"
 #include "protocol_api.hpp"
+#include "rdb_protocol/protocol.hpp"
 
 namespace unittest {
 using mock::dummy_protocol_t;
@@ -44,4 +45,96 @@ TEST(RegionMap, Mask) {
         }
     }
 }
+
+// A grid of `num_slices` hash ranges by ten key ranges, "a" to "j".
+static region_map_t<rdb_protocol_t, int> hash_grid(int num_slices) {
+    std::vector<std::pair<rdb_protocol_t::region_t, int> > pairs;
+    const uint64_t slice = HASH_REGION_HASH_SIZE / num_slices;
+    for (int k = 0; k < 10; ++k) {
+        for (int h = 0; h < num_slices; ++h) {
+            key_range_t range(
+                k == 0 ? key_range_t::none : key_range_t::closed,
+                store_key_t(std::string(1, 'a' + k)),
+                k == 9 ? key_range_t::none : key_range_t::open,
+                store_key_t(std::string(1, 'a' + k + 1)));
+            pairs.push_back(std::make_pair(
+                rdb_protocol_t::region_t(
+                    h * slice,
+                    h == num_slices - 1 ? HASH_REGION_HASH_SIZE : (h + 1) * slice,
+                    range),
+                h * 10 + k));
+        }
+    }
+    return region_map_t<rdb_protocol_t, int>(pairs.begin(), pairs.end());
+}
+
+// The region of a single key with a single hash value.
+static rdb_protocol_t::region_t hash_point(uint64_t hash, const std::string &key) {
+    return rdb_protocol_t::region_t(hash, hash + 1,
+                                    key_range_t(key_range_t::closed, store_key_t(key),
+                                                key_range_t::closed, store_key_t(key)));
+}
+
+static std::vector<int> values_in(const region_map_t<rdb_protocol_t, int> &rmap,
+                                  const rdb_protocol_t::region_t &region) {
+    std::vector<int> values;
+    rmap.visit_mask(region, [&](const rdb_protocol_t::region_t &ixn, int value) {
+        EXPECT_TRUE(region_is_superset(region, ixn));
+        values.push_back(value);
+    });
+    std::sort(values.begin(), values.end());
+    return values;
+}
+
+TEST(RegionMap, HashRegionVisitMask) {
+    region_map_t<rdb_protocol_t, int> rmap = hash_grid(4);
+    EXPECT_TRUE(rmap.get_domain() == rdb_protocol_t::region_t::universe());
+    const uint64_t slice = HASH_REGION_HASH_SIZE / 4;
+
+    std::vector<int> values = values_in(rmap, hash_point(2 * slice + 5, "d"));
+    ASSERT_EQ(1u, values.size());
+    EXPECT_EQ(23, values[0]);
+
+    values = values_in(rmap, hash_point(0, ""));
+    ASSERT_EQ(1u, values.size());
+    EXPECT_EQ(0, values[0]);
+
+    values = values_in(rmap, hash_point(HASH_REGION_HASH_SIZE - 1, "zzz"));
+    ASSERT_EQ(1u, values.size());
+    EXPECT_EQ(39, values[0]);
+
+    // Keys "c" up to "f", in the two middle hash ranges.
+    rdb_protocol_t::region_t middle(slice + 1, 3 * slice - 1,
+                                    key_range_t(key_range_t::closed, store_key_t("c"),
+                                                key_range_t::open, store_key_t("f")));
+    values = values_in(rmap, middle);
+    const int expected[] = { 12, 13, 14, 22, 23, 24 };
+    EXPECT_EQ(std::vector<int>(expected, expected + 6), values);
+    EXPECT_TRUE(rmap.mask(middle).get_domain() == middle);
+}
+
+TEST(RegionMap, HashRegionUpdate) {
+    region_map_t<rdb_protocol_t, int> rmap = hash_grid(8);
+    const uint64_t slice = HASH_REGION_HASH_SIZE / 8;
+    rdb_protocol_t::region_t overlay(slice / 2, 5 * slice / 2,
+                                     key_range_t(key_range_t::closed, store_key_t("b5"),
+                                                 key_range_t::open, store_key_t("e")));
+    rmap.set(overlay, -1);
+    EXPECT_TRUE(rmap.get_domain() == rdb_protocol_t::region_t::universe());
+
+    // Every point has the value it would have had without the index.
+    const char *keys[] = { "a", "b", "b5", "c", "d", "dz", "e", "j" };
+    for (int h = 0; h < 8 * 4; ++h) {
+        const uint64_t hash = h * (slice / 4);
+        for (size_t k = 0; k < sizeof(keys) / sizeof(keys[0]); ++k) {
+            rdb_protocol_t::region_t point = hash_point(hash, keys[k]);
+            int expected = region_is_superset(overlay, point)
+                ? -1 : static_cast<int>(hash / slice) * 10 + (keys[k][0] - 'a');
+            std::vector<int> values = values_in(rmap, point);
+            ASSERT_EQ(1u, values.size()) << h << " " << keys[k];
+            EXPECT_EQ(expected, values[0]) << h << " " << keys[k];
+        }
+    }
+}
+
 } //namespace unittest
@@ -0,0 +1,57 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "config/args.hpp"
+#include "rdb_protocol/result_cache.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+static std::vector<char> result_of_size(size_t size) {
+    return std::vector<char>(size, 'r');
+}
+
+TPTEST(ResultCache, ForgetsOnModification) {
+    result_cache_t cache;
+    EXPECT_TRUE(cache.find("count") == NULL);
+    cache.insert("count", cache.get_version(), result_of_size(10));
+    const std::vector<char> *found = cache.find("count");
+    ASSERT_TRUE(found != NULL);
+    EXPECT_EQ(10u, found->size());
+
+    cache.note_modification();
+    EXPECT_TRUE(cache.find("count") == NULL);
+    EXPECT_EQ(0u, cache.get_bytes());
+}
+
+TPTEST(ResultCache, IgnoresResultsOfStaleReads) {
+    result_cache_t cache;
+    const uint64_t read_version = cache.get_version();
+    // A write comes in while the read is going through the table.
+    cache.note_modification();
+    cache.insert("count", read_version, result_of_size(10));
+    EXPECT_TRUE(cache.find("count") == NULL);
+}
+
+TPTEST(ResultCache, EvictsLeastRecentlyUsed) {
+    result_cache_t cache;
+    // Leaves room for the keys.
+    const size_t size = RESULT_CACHE_MAX_RESULT_BYTES - 16;
+    const int fit = RESULT_CACHE_BYTES / RESULT_CACHE_MAX_RESULT_BYTES;
+    for (int i = 0; i < fit; ++i) {
+        cache.insert(strprintf("%d", i), cache.get_version(), result_of_size(size));
+    }
+    // The first one was used most recently, so the second one goes.
+    EXPECT_TRUE(cache.find("0") != NULL);
+    cache.insert("new", cache.get_version(), result_of_size(size));
+    EXPECT_TRUE(cache.find("0") != NULL);
+    EXPECT_TRUE(cache.find("1") == NULL);
+    EXPECT_TRUE(cache.find("new") != NULL);
+    EXPECT_LE(cache.get_bytes(), static_cast<size_t>(RESULT_CACHE_BYTES));
+
+    // Results that are too big don't get in at all.
+    cache.insert("big", cache.get_version(),
+                 result_of_size(RESULT_CACHE_MAX_RESULT_BYTES));
+    EXPECT_TRUE(cache.find("big") == NULL);
+}
+
+}  // namespace unittest
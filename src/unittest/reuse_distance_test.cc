@@ -0,0 +1,72 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "buffer_cache/alt/reuse_distance.hpp"
+
+using alt::reuse_distance_estimator_t;
+
+namespace unittest {
+
+TEST(ReuseDistanceTest, Empty) {
+    reuse_distance_estimator_t estimator(0, 1000);
+    ASSERT_EQ(0u, estimator.sampled_accesses());
+    ASSERT_EQ(0.0, estimator.predicted_hit_ratio(100));
+}
+
+TEST(ReuseDistanceTest, RepeatedBlock) {
+    reuse_distance_estimator_t estimator(0, 1000);
+    for (int i = 0; i < 10; ++i) {
+        estimator.record_access(7);
+    }
+    ASSERT_EQ(10u, estimator.sampled_accesses());
+    ASSERT_EQ(1u, estimator.cold_accesses());
+    ASSERT_DOUBLE_EQ(0.9, estimator.predicted_hit_ratio(1));
+}
+
+TEST(ReuseDistanceTest, Cycle) {
+    // Cycling through 100 blocks, an LRU cache hits everything (except the first
+    // round) if it holds all of them, and nothing if it doesn't.
+    reuse_distance_estimator_t estimator(0, 1000);
+    for (int round = 0; round < 10; ++round) {
+        for (block_id_t id = 0; id < 100; ++id) {
+            estimator.record_access(id);
+        }
+    }
+    ASSERT_EQ(1000u, estimator.sampled_accesses());
+    ASSERT_EQ(100u, estimator.cold_accesses());
+    ASSERT_DOUBLE_EQ(0.9, estimator.predicted_hit_ratio(200));
+    ASSERT_DOUBLE_EQ(0.0, estimator.predicted_hit_ratio(50));
+}
+
+TEST(ReuseDistanceTest, ForgetsOldBlocks) {
+    // With only 16 blocks tracked, the blocks of a cycle through 100 get forgotten
+    // before they're accessed again.
+    reuse_distance_estimator_t estimator(0, 16);
+    for (int round = 0; round < 5; ++round) {
+        for (block_id_t id = 0; id < 100; ++id) {
+            estimator.record_access(id);
+        }
+    }
+    ASSERT_EQ(500u, estimator.sampled_accesses());
+    ASSERT_EQ(500u, estimator.cold_accesses());
+
+    // But recent blocks are still tracked.
+    estimator.record_access(99);
+    ASSERT_EQ(500u, estimator.cold_accesses());
+}
+
+TEST(ReuseDistanceTest, Sampling) {
+    // Distances among the sampled blocks get scaled up by the sampling rate.
+    reuse_distance_estimator_t estimator(4, 1000);
+    for (int round = 0; round < 10; ++round) {
+        for (block_id_t id = 0; id < 10000; ++id) {
+            estimator.record_access(id);
+        }
+    }
+    ASSERT_LT(0u, estimator.sampled_accesses());
+    ASSERT_GT(100000u, estimator.sampled_accesses());
+    ASSERT_NEAR(0.9, estimator.predicted_hit_ratio(40000), 0.01);
+    ASSERT_NEAR(0.0, estimator.predicted_hit_ratio(5000), 0.01);
+}
+
+}  // namespace unittest
@@ -3,10 +3,14 @@
 
 #include "arch/runtime/thread_pool.hpp"
 #include "arch/timing.hpp"
+#include "concurrency/pmap.hpp"
+#include "config/args.hpp"
 #include "containers/scoped.hpp"
 #include "containers/archive/socket_stream.hpp"
+#include "containers/archive/vector_stream.hpp"
 #include "unittest/unittest_utils.hpp"
 #include "rpc/connectivity/cluster.hpp"
+#include "rpc/connectivity/compression.hpp"
 #include "rpc/connectivity/multiplexer.hpp"
 #include "unittest/gtest.hpp"
 
@@ -437,6 +441,82 @@ TPTEST(RPCConnectivityTest, Multiplexer) {
     c2aB.expect_undelivered(10065);
 }
 
+/* `MultiplexerPriorities` sends messages that span several fragments through a
+bulk client while a control client sends small messages, and makes sure that
+they all arrive intact. */
+
+class big_message_test_application_t : public message_handler_t {
+public:
+    static const size_t message_size = 3 * CLUSTER_MESSAGE_FRAGMENT_SIZE + 17;
+
+    explicit big_message_test_application_t(message_service_t *s) :
+        service(s),
+        received(0)
+        { }
+    void send(peer_id_t peer) {
+        class writer_t : public send_message_write_callback_t {
+        public:
+            virtual ~writer_t() { }
+            void write(write_stream_t *stream) {
+                std::vector<char> data(message_size);
+                for (size_t i = 0; i < message_size; ++i) {
+                    data[i] = i % 251;
+                }
+                int64_t res = stream->write(data.data(), data.size());
+                if (res != static_cast<int64_t>(message_size)) { throw fake_archive_exc_t(); }
+            }
+        } writer;
+        service->send_message(peer, &writer);
+    }
+    void on_message(peer_id_t, read_stream_t *stream) {
+        std::vector<char> data(message_size);
+        int64_t res = force_read(stream, data.data(), message_size);
+        if (res != static_cast<int64_t>(message_size)) { throw fake_archive_exc_t(); }
+
+        for (size_t i = 0; i < message_size; ++i) {
+            EXPECT_EQ(static_cast<char>(i % 251), data[i]);
+        }
+        ++received;
+    }
+    message_service_t *service;
+    int received;
+};
+
+TPTEST(RPCConnectivityTest, MultiplexerPriorities) {
+    connectivity_cluster_t c1, c2;
+    message_multiplexer_t c1m(&c1), c2m(&c2);
+    message_multiplexer_t::client_t c1mcA(&c1m, 'A', message_priority_t::CONTROL),
+        c2mcA(&c2m, 'A', message_priority_t::CONTROL);
+    recording_test_application_t c1aA(&c1mcA), c2aA(&c2mcA);
+    message_multiplexer_t::client_t::run_t c1mcAr(&c1mcA, &c1aA), c2mcAr(&c2mcA, &c2aA);
+    message_multiplexer_t::client_t c1mcB(&c1m, 'B', message_priority_t::BULK),
+        c2mcB(&c2m, 'B', message_priority_t::BULK);
+    big_message_test_application_t c1aB(&c1mcB), c2aB(&c2mcB);
+    message_multiplexer_t::client_t::run_t c1mcBr(&c1mcB, &c1aB), c2mcBr(&c2mcB, &c2aB);
+    message_multiplexer_t::run_t c1mr(&c1m), c2mr(&c2m);
+    connectivity_cluster_t::run_t c1r(&c1, get_unittest_addresses(), peer_address_t(), ANY_PORT, &c1mr, 0, NULL);
+    connectivity_cluster_t::run_t c2r(&c2, get_unittest_addresses(), peer_address_t(), ANY_PORT, &c2mr, 0, NULL);
+
+    c1r.join(c2.get_peer_address(c2.get_me()));
+    let_stuff_happen();
+
+    // Send all of them at once, so their fragments get interleaved.
+    pmap(8, [&](int i) {
+        if (i % 2 == 0) {
+            c1aB.send(c2.get_me());
+        } else {
+            c1aA.send(i, c2.get_me());
+        }
+    });
+
+    let_stuff_happen();
+
+    EXPECT_EQ(4, c2aB.received);
+    for (int i = 1; i < 8; i += 2) {
+        c2aA.expect(i, c1.get_me());
+    }
+}
+
 /* `BinaryData` makes sure that any octet can be sent over the wire. */
 
 class binary_test_application_t : public message_handler_t {
@@ -488,6 +568,70 @@ TPTEST_MULTITHREAD(RPCConnectivityTest, BinaryData, 3) {
     EXPECT_TRUE(a2.got_spectrum);
 }
 
+/* `CompressionRoundTrip` makes sure that messages come out of a
+`cluster_decompressing_stream_t` the way they went into a
+`cluster_message_compressor_t`, whether they're sent raw, compressed, or split over
+several frames. */
+
+TEST(RPCConnectivityTest, CompressionRoundTrip) {
+    std::vector<std::string> messages;
+    messages.push_back("x");
+    messages.push_back(std::string(CLUSTER_COMPRESSION_MIN_MESSAGE_SIZE - 1, 'a'));
+    messages.push_back(std::string(CLUSTER_COMPRESSION_MIN_MESSAGE_SIZE, 'b'));
+    messages.push_back(std::string(3 * CLUSTER_COMPRESSION_MAX_FRAME_SIZE, 'c'));
+    std::string noise;
+    for (size_t i = 0; i < 3 * CLUSTER_COMPRESSION_MAX_FRAME_SIZE; ++i) {
+        noise.push_back(randint(256));
+    }
+    messages.push_back(noise);
+    messages.push_back("y");
+    messages.push_back(noise);
+
+    cluster_message_compressor_t compressor;
+    std::vector<char> wire;
+    for (auto it = messages.begin(); it != messages.end(); ++it) {
+        std::vector<char> frames;
+        compressor.compress(it->data(), it->size(), &frames);
+        wire.insert(wire.end(), frames.begin(), frames.end());
+    }
+
+    vector_read_stream_t wire_stream(std::move(wire));
+    cluster_decompressing_stream_t decompressor(&wire_stream);
+    for (auto it = messages.begin(); it != messages.end(); ++it) {
+        std::string received(it->size(), '\0');
+        ASSERT_EQ(static_cast<int64_t>(it->size()),
+                  force_read(&decompressor, &received[0], received.size()));
+        ASSERT_TRUE(*it == received);
+    }
+    char extra;
+    ASSERT_EQ(0, decompressor.read(&extra, 1));
+}
+
+/* `CompressedMessage` sends messages between nodes that both compress their
+connections. */
+
+TPTEST_MULTITHREAD(RPCConnectivityTest, CompressedMessage, 3) {
+    set_cluster_wire_compression(true);
+    {
+        connectivity_cluster_t c1, c2;
+        recording_test_application_t a1(&c1), a2(&c2);
+        connectivity_cluster_t::run_t cr1(&c1, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a1, 0, NULL);
+        connectivity_cluster_t::run_t cr2(&c2, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a2, 0, NULL);
+        cr2.join(c1.get_peer_address(c1.get_me()));
+
+        let_stuff_happen();
+
+        a1.send(873, c2.get_me());
+        a2.send(66663, c1.get_me());
+
+        let_stuff_happen();
+
+        a2.expect(873, c1.get_me());
+        a1.expect(66663, c2.get_me());
+    }
+    set_cluster_wire_compression(false);
+}
+
 /* `PeerIDSemantics` makes sure that `peer_id_t::is_nil()` works as expected. */
 TPTEST_MULTITHREAD(RPCConnectivityTest, PeerIDSemantics, 3) {
     peer_id_t nil_peer;
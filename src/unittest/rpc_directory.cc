@@ -1,5 +1,7 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "arch/timing.hpp"
+#include "clustering/administration/metadata.hpp"
+#include "containers/archive/vector_stream.hpp"
 #include "rpc/connectivity/cluster.hpp"
 #include "rpc/directory/read_manager.hpp"
 #include "rpc/directory/write_manager.hpp"
@@ -86,4 +88,32 @@ TPTEST(RPCDirectoryTest, DestructorRace) {
     w.set_value(6);
 }
 
+/* `ClusterDirectoryDelta` checks that a delta between two directory values turns
+the old value into the new one. */
+TEST(RPCDirectoryTest, ClusterDirectoryDelta) {
+    cluster_directory_metadata_t old_value;
+    old_value.machine_id = generate_uuid();
+    old_value.peer_id = peer_id_t(generate_uuid());
+    old_value.ips.push_back("10.0.0.1");
+    old_value.peer_type = SERVER_PEER;
+
+    cluster_directory_metadata_t new_value = old_value;
+    new_value.ips.push_back("10.0.0.2");
+    new_value.peer_type = PROXY_PEER;
+
+    write_message_t msg;
+    ASSERT_TRUE(serialize_directory_delta(&msg, old_value, new_value));
+    vector_stream_t stream;
+    ASSERT_EQ(0, send_write_message(&stream, &msg));
+
+    std::vector<char> delta = stream.vector();
+    inplace_vector_read_stream_t read_stream(&delta);
+    cluster_directory_metadata_t value = old_value;
+    ASSERT_EQ(archive_result_t::SUCCESS, apply_directory_delta(&read_stream, &value));
+    EXPECT_EQ(new_value.machine_id, value.machine_id);
+    EXPECT_EQ(new_value.peer_id, value.peer_id);
+    EXPECT_EQ(new_value.ips, value.ips);
+    EXPECT_EQ(PROXY_PEER, value.peer_type);
+}
+
 }   /* namespace unittest */
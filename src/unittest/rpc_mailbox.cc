@@ -2,9 +2,11 @@
 #include "unittest/gtest.hpp"
 
 #include "arch/timing.hpp"
+#include "concurrency/pmap.hpp"
 #include "unittest/unittest_utils.hpp"
 #include "rpc/mailbox/mailbox.hpp"
 #include "rpc/mailbox/typed.hpp"
+#include "time.hpp"
 
 namespace unittest {
 
@@ -101,6 +103,38 @@ TPTEST_MULTITHREAD(RPCMailboxTest, MailboxMessage, 3) {
     mbox.expect(7);
 }
 
+/* `MailboxBatch` sends many messages at once, so that they get batched together,
+to mailboxes on two different threads. */
+TPTEST_MULTITHREAD(RPCMailboxTest, MailboxBatch, 3) {
+    connectivity_cluster_t c1, c2;
+    mailbox_manager_t m1(&c1), m2(&c2);
+    connectivity_cluster_t::run_t r1(&c1, get_unittest_addresses(), peer_address_t(), ANY_PORT, &m1, 0, NULL);
+    connectivity_cluster_t::run_t r2(&c2, get_unittest_addresses(), peer_address_t(), ANY_PORT, &m2, 0, NULL);
+    r1.join(c2.get_peer_address(c2.get_me()));
+    let_stuff_happen();
+
+    dummy_mailbox_t mbox1(&m1);
+    raw_mailbox_t::address_t address1 = mbox1.mailbox.get_address();
+    on_thread_t thread_switcher(threadnum_t(1));
+    dummy_mailbox_t mbox2(&m1);
+    raw_mailbox_t::address_t address2 = mbox2.mailbox.get_address();
+
+    const int num_messages = 100;
+    pmap(num_messages, [&](int i) {
+        send(&m2, i % 2 == 0 ? address1 : address2, i);
+    });
+
+    let_stuff_happen();
+
+    for (int i = 0; i < num_messages; ++i) {
+        if (i % 2 == 0) {
+            mbox1.expect(i);
+        } else {
+            mbox2.expect(i);
+        }
+    }
+}
+
 /* `DeadMailbox` sends a message to a defunct mailbox. The expected behavior is
 for the message to be silently ignored. */
 TPTEST_MULTITHREAD(RPCMailboxTest, DeadMailbox, 3) {
@@ -167,4 +201,64 @@ TPTEST_MULTITHREAD(RPCMailboxTest, TypedMailbox, 3) {
     }
 }
 
+/* `MailboxTableReuse` makes sure that the ID of a dead mailbox doesn't find the
+mailbox that reuses its slot. */
+TEST(RPCMailboxTest, MailboxTableReuse) {
+    char fake_mailboxes[2];
+    raw_mailbox_t *mb1 = reinterpret_cast<raw_mailbox_t *>(&fake_mailboxes[0]);
+    raw_mailbox_t *mb2 = reinterpret_cast<raw_mailbox_t *>(&fake_mailboxes[1]);
+
+    mailbox_table_t table;
+    raw_mailbox_t::id_t id1 = table.register_mailbox(mb1);
+    EXPECT_EQ(mb1, table.find_mailbox(id1));
+    table.unregister_mailbox(id1);
+    EXPECT_TRUE(table.find_mailbox(id1) == NULL);
+
+    raw_mailbox_t::id_t id2 = table.register_mailbox(mb2);
+    EXPECT_NE(id1, id2);
+    EXPECT_TRUE(table.find_mailbox(id1) == NULL);
+    EXPECT_EQ(mb2, table.find_mailbox(id2));
+    table.unregister_mailbox(id2);
+}
+
+/* `MailboxTableBenchmark` times registering, looking up and unregistering
+mailboxes. It's disabled by default; run it with `--gtest_also_run_disabled_tests`. */
+TEST(RPCMailboxTest, DISABLED_MailboxTableBenchmark) {
+    const size_t num_mailboxes = 10000;
+    const int num_rounds = 100;
+    std::vector<char> fake_mailboxes(num_mailboxes);
+    std::vector<raw_mailbox_t::id_t> ids(num_mailboxes);
+    mailbox_table_t table;
+
+    ticks_t register_ticks = 0, find_ticks = 0, unregister_ticks = 0;
+    size_t found = 0;
+    for (int round = 0; round < num_rounds; ++round) {
+        ticks_t start = get_ticks();
+        for (size_t i = 0; i < num_mailboxes; ++i) {
+            ids[i] = table.register_mailbox(
+                reinterpret_cast<raw_mailbox_t *>(&fake_mailboxes[i]));
+        }
+        ticks_t registered = get_ticks();
+        for (size_t i = 0; i < num_mailboxes; ++i) {
+            found += table.find_mailbox(ids[(i * 7919) % num_mailboxes]) != NULL;
+        }
+        ticks_t looked_up = get_ticks();
+        for (size_t i = 0; i < num_mailboxes; ++i) {
+            table.unregister_mailbox(ids[i]);
+        }
+        ticks_t unregistered = get_ticks();
+
+        register_ticks += registered - start;
+        find_ticks += looked_up - registered;
+        unregister_ticks += unregistered - looked_up;
+    }
+    EXPECT_EQ(num_mailboxes * num_rounds, found);
+
+    const double ops = static_cast<double>(num_mailboxes) * num_rounds;
+    printf("register: %.1f ns/op, find: %.1f ns/op, unregister: %.1f ns/op\n",
+           ticks_to_secs(register_ticks) * 1e9 / ops,
+           ticks_to_secs(find_ticks) * 1e9 / ops,
+           ticks_to_secs(unregister_ticks) * 1e9 / ops);
+}
+
 }   /* namespace unittest */
@@ -4,6 +4,7 @@
 
 #include "containers/archive/archive.hpp"
 #include "unittest/unittest_utils.hpp"
+#include "rpc/semilattice/delta.hpp"
 #include "rpc/semilattice/semilattice_manager.hpp"
 #include "rpc/semilattice/joins/map.hpp"
 #include "rpc/semilattice/view/field.hpp"
@@ -245,6 +246,42 @@ TPTEST_MULTITHREAD(RPCSemilatticeTest, MemberView, 3) {
     EXPECT_EQ(9u, foo_view->get().i);
 }
 
+/* `MapDeltaAndDigest` checks the helpers that metadata made of maps uses to send
+only changed entries and to compare digests. */
+TEST(RPCSemilatticeTest, MapDeltaAndDigest) {
+    std::map<int32_t, int32_t> current;
+    current[1] = 10;
+    current[2] = 20;
+    current[3] = 30;
+
+    std::map<int32_t, int32_t> added = current;
+    added[2] = 21;
+    added[4] = 40;
+    added.erase(1);
+
+    std::map<int32_t, int32_t> delta;
+    get_changed_map_entries(current, added, &delta);
+    ASSERT_EQ(2u, delta.size());
+    EXPECT_EQ(21, delta[2]);
+    EXPECT_EQ(40, delta[4]);
+
+    semilattice_digest_t digest;
+    add_map_to_semilattice_digest('x', current, &digest);
+    EXPECT_EQ(3u, digest.size());
+
+    std::map<int32_t, int32_t> difference;
+    get_map_digest_difference('x', current, digest, &difference);
+    EXPECT_TRUE(difference.empty());
+
+    get_map_digest_difference('x', added, digest, &difference);
+    EXPECT_EQ(delta, difference);
+
+    /* Entries of another map with the same keys don't count. */
+    difference.clear();
+    get_map_digest_difference('y', current, digest, &difference);
+    EXPECT_EQ(current, difference);
+}
+
 }   /* namespace unittest */
 
 #include "rpc/semilattice/semilattice_manager.tcc"
@@ -84,5 +84,105 @@ TEST(SerializerTest, AddDeleteRepeatedlyWithIndex) {
     run_in_thread_pool(std::bind(run_AddDeleteRepeatedly, true), 4);
 }
 
+TPTEST(SerializerTest, SeparateIndexFile, 4) {
+    mock_file_opener_t file_opener(true);
+    standard_serializer_t::create(&file_opener, standard_serializer_t::static_config_t());
+    // The index file has the metablocks.
+    ASSERT_LT(0u, file_opener.index_file_size());
+
+    {
+        standard_serializer_t ser(standard_serializer_t::dynamic_config_t(),
+                                  &file_opener,
+                                  &get_global_perfmon_collection());
+
+        scoped_malloc_t<ser_buffer_t> buf
+            = serializer_t::allocate_buffer(ser.max_block_size());
+        memset(buf->cache_data, 0x5a, ser.max_block_size().value());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+
+        struct : public iocallback_t, public cond_t {
+            void on_io_complete() {
+                pulse();
+            }
+        } cb;
+        std::vector<buf_write_info_t> infos;
+        infos.push_back(buf_write_info_t(buf.get(), ser.max_block_size(), 0));
+        std::vector<counted_t<standard_block_token_t> > tokens
+            = ser.block_writes(infos, account.get(), &cb);
+        cb.wait();
+
+        std::vector<index_write_op_t> write_ops;
+        write_ops.push_back(index_write_op_t(0, tokens[0], repli_timestamp_t::distant_past));
+        ser.index_write(write_ops, account.get());
+    }
+
+    ASSERT_LT(0u, file_opener.file_size());
+
+    // Start the serializer again, which finds the index through the index file.
+
+    standard_serializer_t ser(standard_serializer_t::dynamic_config_t(),
+                              &file_opener,
+                              &get_global_perfmon_collection());
+    counted_t<standard_block_token_t> token = ser.index_read(0);
+    ASSERT_TRUE(token.has());
+    scoped_malloc_t<ser_buffer_t> buf
+        = serializer_t::allocate_buffer(ser.max_block_size());
+    scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+    ser.block_read(token, buf.get(), account.get());
+    for (size_t i = 0; i < ser.max_block_size().value(); ++i) {
+        ASSERT_EQ(0x5a, static_cast<uint8_t>(buf->cache_data[i]));
+    }
+}
+
+TPTEST(SerializerTest, SeparateArchiveFile, 4) {
+    mock_file_opener_t file_opener(false, true);
+    standard_serializer_t::create(&file_opener, standard_serializer_t::static_config_t());
+    // The archive file gets its own static header.
+    ASSERT_LT(0u, file_opener.archive_file_size());
+    const size_t archive_file_size = file_opener.archive_file_size();
+
+    {
+        standard_serializer_t ser(standard_serializer_t::dynamic_config_t(),
+                                  &file_opener,
+                                  &get_global_perfmon_collection());
+
+        scoped_malloc_t<ser_buffer_t> buf
+            = serializer_t::allocate_buffer(ser.max_block_size());
+        memset(buf->cache_data, 0x3c, ser.max_block_size().value());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+
+        struct : public iocallback_t, public cond_t {
+            void on_io_complete() {
+                pulse();
+            }
+        } cb;
+        std::vector<buf_write_info_t> infos;
+        infos.push_back(buf_write_info_t(buf.get(), ser.max_block_size(), 0));
+        std::vector<counted_t<standard_block_token_t> > tokens
+            = ser.block_writes(infos, account.get(), &cb);
+        cb.wait();
+
+        std::vector<index_write_op_t> write_ops;
+        write_ops.push_back(index_write_op_t(0, tokens[0], repli_timestamp_t::distant_past));
+        ser.index_write(write_ops, account.get());
+    }
+
+    // New writes always go to the data file; only the GC moves blocks over.
+    ASSERT_EQ(archive_file_size, file_opener.archive_file_size());
+
+    standard_serializer_t ser(standard_serializer_t::dynamic_config_t(),
+                              &file_opener,
+                              &get_global_perfmon_collection());
+    counted_t<standard_block_token_t> token = ser.index_read(0);
+    ASSERT_TRUE(token.has());
+    scoped_malloc_t<ser_buffer_t> buf
+        = serializer_t::allocate_buffer(ser.max_block_size());
+    scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+    ser.block_read(token, buf.get(), account.get());
+    for (size_t i = 0; i < ser.max_block_size().value(); ++i) {
+        ASSERT_EQ(0x3c, static_cast<uint8_t>(buf->cache_data[i]));
+    }
+}
+
 
 }  // namespace unittest
@@ -0,0 +1,63 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/ql2.pb.h"
+#include "rdb_protocol/slow_query_log.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+void set_string_datum(Term *term, const std::string &str) {
+    term->set_type(Term::DATUM);
+    term->mutable_datum()->set_type(Datum::R_STR);
+    term->mutable_datum()->set_r_str(str);
+}
+
+TEST(SlowQueryLog, SummarizeQuery) {
+    // r.db("foo").table("bar").count(), run with `db: "baz"`.
+    Query query;
+    query.set_type(Query::START);
+    Term *count = query.mutable_query();
+    count->set_type(Term::COUNT);
+    Term *table = count->add_args();
+    table->set_type(Term::TABLE);
+    Term *db = table->add_args();
+    db->set_type(Term::DB);
+    set_string_datum(db->add_args(), "foo");
+    set_string_datum(table->add_args(), "bar");
+    Query::AssocPair *db_optarg = query.add_global_optargs();
+    db_optarg->set_key("db");
+    db_optarg->mutable_val()->set_type(Term::DB);
+    set_string_datum(db_optarg->mutable_val()->add_args(), "baz");
+
+    std::string summary;
+    std::set<std::string> tables;
+    summarize_query(query, &summary, &tables);
+    EXPECT_EQ("COUNT(TABLE(DB(\"foo\"), \"bar\"))", summary);
+    EXPECT_EQ(std::set<std::string>({"foo.bar"}), tables);
+
+    // A table without a database is in the query's default database.
+    table->mutable_args()->DeleteSubrange(0, 1);
+    tables.clear();
+    summarize_query(query, &summary, &tables);
+    EXPECT_EQ("COUNT(TABLE(\"bar\"))", summary);
+    EXPECT_EQ(std::set<std::string>({"baz.bar"}), tables);
+}
+
+TEST(SlowQueryLog, SummaryIsTruncated) {
+    Query query;
+    query.set_type(Query::START);
+    Term *array = query.mutable_query();
+    array->set_type(Term::MAKE_ARRAY);
+    for (int i = 0; i < SLOW_QUERY_LOG_MAX_SUMMARY_SIZE; ++i) {
+        set_string_datum(array->add_args(), std::string(100, 'x'));
+    }
+
+    std::string summary;
+    std::set<std::string> tables;
+    summarize_query(query, &summary, &tables);
+    EXPECT_EQ(static_cast<size_t>(SLOW_QUERY_LOG_MAX_SUMMARY_SIZE), summary.size());
+    EXPECT_EQ("...", summary.substr(summary.size() - 3));
+    EXPECT_EQ(std::string::npos, summary.find(std::string(100, 'x')));
+    EXPECT_TRUE(tables.empty());
+}
+
+}  // namespace unittest
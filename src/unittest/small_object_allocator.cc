@@ -0,0 +1,72 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <set>
+#include <vector>
+
+#include "arch/runtime/small_object_allocator.hpp"
+#include "threading.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+class small_thing_t
+    : public small_object_allocated_t<small_object_kind_t::thread_message> {
+public:
+    explicit small_thing_t(int _value) : value(_value) { }
+    int value;
+    char padding[40];
+};
+
+TPTEST(SmallObjectAllocator, ReusesFreedChunks) {
+    std::vector<small_thing_t *> things;
+    std::set<small_thing_t *> addresses;
+    for (int i = 0; i < 1000; ++i) {
+        things.push_back(new small_thing_t(i));
+        addresses.insert(things.back());
+    }
+    // No two live objects share memory.
+    ASSERT_EQ(things.size(), addresses.size());
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_EQ(i, things[i]->value);
+        delete things[i];
+    }
+
+    // Freed chunks get handed out again before new slabs are made.
+    for (int i = 0; i < 1000; ++i) {
+        things[i] = new small_thing_t(i);
+        EXPECT_EQ(1u, addresses.count(things[i]));
+    }
+    for (int i = 0; i < 1000; ++i) {
+        delete things[i];
+    }
+}
+
+TPTEST(SmallObjectAllocator, RemoteFreesGoHome, 2) {
+    std::vector<small_thing_t *> things;
+    std::set<small_thing_t *> addresses;
+    for (int i = 0; i < 100; ++i) {
+        things.push_back(new small_thing_t(i));
+        addresses.insert(things.back());
+    }
+
+    {
+        on_thread_t thread_switcher((threadnum_t(1)));
+        for (int i = 0; i < 100; ++i) {
+            delete things[i];
+        }
+    }
+
+    // Thread 0 takes the chunks thread 1 freed back once it runs out of local ones.
+    size_t reused = 0;
+    for (int i = 0; i < 100000 && reused < 100; ++i) {
+        small_thing_t *thing = new small_thing_t(i);
+        things.push_back(thing);
+        reused += addresses.count(thing);
+    }
+    EXPECT_EQ(100u, reused);
+    for (size_t i = 100; i < things.size(); ++i) {
+        delete things[i];
+    }
+}
+
+}  // namespace unittest
@@ -0,0 +1,69 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "unittest/gtest.hpp"
+
+#include "btree/keys.hpp"
+#include "containers/archive/vector_stream.hpp"
+
+namespace unittest {
+
+TEST(StoreKeyTest, CopyAndMove) {
+    const std::string short_str(STORE_KEY_INLINE_SIZE, 's');
+    const std::string long_str(MAX_KEY_SIZE, 'l');
+
+    for (int i = 0; i < 2; ++i) {
+        const std::string &str = i == 0 ? short_str : long_str;
+        store_key_t key(str);
+        store_key_t copy(key);
+        EXPECT_EQ(str, key_to_unescaped_str(copy));
+
+        store_key_t moved(std::move(copy));
+        EXPECT_EQ(str, key_to_unescaped_str(moved));
+        EXPECT_EQ(0, copy.size());
+
+        store_key_t assigned(short_str + "x");
+        assigned = key;
+        EXPECT_EQ(key, assigned);
+        assigned = std::move(moved);
+        EXPECT_EQ(key, assigned);
+    }
+}
+
+TEST(StoreKeyTest, GrowsPastInlineSize) {
+    store_key_t key(std::string(STORE_KEY_INLINE_SIZE, 'a'));
+    ASSERT_TRUE(key.increment());
+    EXPECT_EQ(std::string(STORE_KEY_INLINE_SIZE, 'a') + '\0',
+              key_to_unescaped_str(key));
+
+    store_key_t other(std::string(STORE_KEY_INLINE_SIZE, 'a') + 'b');
+    ASSERT_TRUE(other.decrement());
+    EXPECT_EQ(MAX_KEY_SIZE, other.size());
+    EXPECT_TRUE(key < other);
+
+    store_key_t max = store_key_t::max();
+    EXPECT_FALSE(max.increment());
+    EXPECT_EQ(store_key_t::max(), max);
+}
+
+TEST(StoreKeyTest, Serialization) {
+    const store_key_t keys[] = { store_key_t(), store_key_t("short"),
+                                 store_key_t::max() };
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+        write_message_t msg;
+        msg << keys[i];
+        vector_stream_t stream;
+        ASSERT_EQ(0, send_write_message(&stream, &msg));
+
+        std::vector<char> data;
+        stream.swap(&data);
+        vector_read_stream_t read_stream(std::move(data));
+        store_key_t key("something else");
+        ASSERT_EQ(archive_result_t::SUCCESS, deserialize(&read_stream, &key));
+        EXPECT_EQ(keys[i], key);
+    }
+}
+
+}  // namespace unittest
@@ -117,7 +117,7 @@ reactor_test_cluster_t<protocol_t>::reactor_test_cluster_t(int port) :
     connectivity_cluster(),
     message_multiplexer(&connectivity_cluster),
 
-    heartbeat_manager_client(&message_multiplexer, 'H'),
+    heartbeat_manager_client(&message_multiplexer, 'H', message_priority_t::CONTROL),
     heartbeat_manager(&heartbeat_manager_client),
     heartbeat_manager_client_run(&heartbeat_manager_client, &heartbeat_manager),
 
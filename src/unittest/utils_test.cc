@@ -1,5 +1,7 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <algorithm>
 #include <ctime>
+#include <string>
 
 #include "arch/address.hpp"
 #include "arch/runtime/runtime.hpp"
@@ -94,6 +96,35 @@ TEST(BtreeUtilsTest, SizedStrcmp) {
     ASSERT_NE(0, sized_strcmp(test3, 11, test1, 14));
 }
 
+TEST(BtreeUtilsTest, SizedStrcmpFrom) {
+    const std::string strs[] = {
+        "", "a", "ab", "abcdefghijklmnop", "abcdefghijklmnoq", "abcdefghijklmnopq",
+        "abcdefgh", "abcdefgi", "b", std::string(20, 'x') + "\xff", std::string(21, 'x')
+    };
+    const int num_strs = sizeof(strs) / sizeof(strs[0]);
+    for (int i = 0; i < num_strs; ++i) {
+        for (int j = 0; j < num_strs; ++j) {
+            const uint8_t *s1 = reinterpret_cast<const uint8_t *>(strs[i].data());
+            const uint8_t *s2 = reinterpret_cast<const uint8_t *>(strs[j].data());
+            const int len1 = strs[i].size();
+            const int len2 = strs[j].size();
+            int expected_common = 0;
+            while (expected_common < std::min(len1, len2)
+                   && s1[expected_common] == s2[expected_common]) {
+                ++expected_common;
+            }
+            const int expected = sized_strcmp(s1, len1, s2, len2);
+            for (int skip = 0; skip <= expected_common; ++skip) {
+                int common;
+                const int res = sized_strcmp_from(s1, len1, s2, len2, skip, &common);
+                ASSERT_EQ(expected < 0, res < 0);
+                ASSERT_EQ(expected > 0, res > 0);
+                ASSERT_EQ(expected_common, common);
+            }
+        }
+    }
+}
+
 /* This doesn't quite belong in `utils_test.cc`, but I don't want to create a
 new file just for it. */
 
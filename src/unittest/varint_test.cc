@@ -1,6 +1,8 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include <inttypes.h>
 
+#include <vector>
+
 #include "containers/archive/string_stream.hpp"
 #include "containers/archive/varint.hpp"
 #include "unittest/gtest.hpp"
@@ -85,4 +87,42 @@ TEST(VarintTest, RangeError) {
     }
 }
 
+TEST(VarintTest, DecodeMany) {
+    // Runs of one-byte varints longer and shorter than 16, between bigger ones.
+    std::vector<uint64_t> values;
+    for (uint64_t i = 0; i < 40; ++i) {
+        values.push_back(i);
+    }
+    values.push_back(UINT64_MAX);
+    for (uint64_t i = 0; i < 5; ++i) {
+        values.push_back(127 - i);
+    }
+    values.push_back(128);
+    values.push_back(static_cast<uint64_t>(UINT32_MAX) + 1);
+    for (uint64_t i = 0; i < 20; ++i) {
+        values.push_back(i * 1000);
+    }
+
+    write_message_t msg;
+    for (size_t i = 0; i < values.size(); ++i) {
+        serialize_varint_uint64(&msg, values[i]);
+    }
+    string_stream_t write_stream;
+    ASSERT_EQ(0, send_write_message(&write_stream, &msg));
+    const std::string serialized = write_stream.str();
+
+    std::vector<uint64_t> decoded(values.size());
+    const char *p = serialized.data();
+    const char *const end = serialized.data() + serialized.size();
+    ASSERT_EQ(archive_result_t::SUCCESS,
+              decode_varint_uint64s(&p, end, values.size(), decoded.data()));
+    EXPECT_EQ(end, p);
+    EXPECT_EQ(values, decoded);
+
+    p = serialized.data();
+    EXPECT_EQ(archive_result_t::SOCK_EOF,
+              decode_varint_uint64s(&p, end - 1, values.size(), decoded.data()));
+    EXPECT_EQ(serialized.data(), p);
+}
+
 }  // namespace unittest
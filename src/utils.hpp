@@ -186,12 +186,43 @@ public:
         guarantee(!relative_path.empty());
     }
 
+    // Like the above, but the serializer also gets an index file (with the metablocks
+    // and the LBA) in index_directory, which would be on a lower-latency device.
+    serializer_filepath_t(const base_path_t& directory, const base_path_t& index_directory,
+                          const std::string& relative_path)
+        : permanent_path_(directory.path() + "/" + relative_path),
+          temporary_path_(directory.path() + "/" + TEMPORARY_DIRECTORY_NAME + "/" + relative_path + ".create"),
+          index_permanent_path_(index_directory.path() + "/" + relative_path + ".index"),
+          index_temporary_path_(index_directory.path() + "/" + TEMPORARY_DIRECTORY_NAME + "/" + relative_path + ".index.create") {
+        guarantee(!relative_path.empty());
+    }
+
     // A serializer_file_opener_t will first open the file in a temporary location, then move it to
     // the permanent location when it's finished being created.  These give the names of those
     // locations.
     std::string permanent_path() const { return permanent_path_; }
     std::string temporary_path() const { return temporary_path_; }
 
+    // The same for the index file, if there is one.
+    bool has_index_file() const { return !index_permanent_path_.empty(); }
+    std::string index_permanent_path() const { return index_permanent_path_; }
+    std::string index_temporary_path() const { return index_temporary_path_; }
+
+    // Gives the serializer an archive file (for the blocks that haven't been written
+    // for a long time) in archive_directory, which would be on a larger, slower
+    // device.
+    void set_archive_directory(const base_path_t& archive_directory) {
+        const std::string relative_path
+            = permanent_path_.substr(permanent_path_.rfind('/') + 1);
+        archive_permanent_path_ = archive_directory.path() + "/" + relative_path + ".archive";
+        archive_temporary_path_ = archive_directory.path() + "/" + TEMPORARY_DIRECTORY_NAME + "/" + relative_path + ".archive.create";
+    }
+
+    // The same for the archive file, if there is one.
+    bool has_archive_file() const { return !archive_permanent_path_.empty(); }
+    std::string archive_permanent_path() const { return archive_permanent_path_; }
+    std::string archive_temporary_path() const { return archive_temporary_path_; }
+
 private:
     friend serializer_filepath_t unittest::manual_serializer_filepath(const std::string& permanent_path,
                                                                       const std::string& temporary_path);
@@ -200,6 +231,10 @@ private:
 
     const std::string permanent_path_;
     const std::string temporary_path_;
+    const std::string index_permanent_path_;
+    const std::string index_temporary_path_;
+    std::string archive_permanent_path_;
+    std::string archive_temporary_path_;
 };
 
 void recreate_temporary_directory(const base_path_t& base_path);
@@ -1,27 +1,43 @@
 write_queries = [
     {
-        "query": "r.db('test').table(table['name']).get(table['ids'][i]).update({'update_field': 'value'})",
+        "query": "r.db('test').table(table['name']).get(i).update({'update_field': 'value'})",
         "tag": "single_update",
-        # We just clean what we update using between and the fact that the array table['ids'] is sorted
-        "clean": "r.db('test').table(table['name']).between(None, table['ids'][i], right_bound='closed').replace(r.row.without('update_field'))"
+        # We just clean what we update using between, since the rows are updated in id order
+        # and `i` is the highest id updated
+        "clean": "r.db('test').table(table['name']).between(None, i, right_bound='closed').replace(r.row.without('update_field'))"
     },
     {
-        "query": "r.db('test').table(table['name']).get(table['ids'][i]).replace(r.row.merge({'replace_field': 'value'}))",
+        "query": "r.db('test').table(table['name']).get(i).replace(r.row.merge({'replace_field': 'value'}))",
         "tag": "single_replace",
-        "clean": "r.db('test').table(table['name']).between(None, table['ids'][i], right_bound='closed').replace(r.row.without('replace_field'))"
+        "clean": "r.db('test').table(table['name']).between(None, i, right_bound='closed').replace(r.row.without('replace_field'))"
     }
 ]
 
+# New rows get ids after the dataset's; `doc(id)` makes a row like the dataset's
+insert_queries = [
+    {
+        "query": "r.db('test').table(table['name']).insert(doc(table['rows'] + i))",
+        "tag": "single-insert",
+        "clean": "r.db('test').table(table['name']).between(table['rows'], None).delete()"
+    },
+    {
+        "query": "r.db('test').table(table['name']).insert([doc(table['rows'] + i*100 + j) for j in xrange(100)])",
+        "tag": "batch-insert-100",
+        "clean": "r.db('test').table(table['name']).between(table['rows'], None).delete()"
+    }
+]
+
+# The deleted rows are inserted again after each run
 delete_queries = [
     {
-        "query": "r.db('test').table(table['name']).get(table['ids'][i]).delete()",
+        "query": "r.db('test').table(table['name']).get(i).delete()",
         "tag": "single-delete-pk"
     }
 ]
 
 table_queries = [
     {
-        "query": "r.db('test').table(table['name']).get(table['ids'][i])",
+        "query": "r.db('test').table(table['name']).get(i)",
         "tag": "single-read_pk"
     },
     {
@@ -33,70 +49,84 @@ table_queries = [
         "tag": "single_read_sindex1"
     },
     {
-        "query": "r.db('test').table(table['name']).between(table['ids'][i], table['ids'][i+100])",
+        "query": "r.db('test').table(table['name']).between(i, i+100)",
         "tag": "range_read_sindex1",
         "imax": 100
     },
     {
-        "query": "r.db('test').table(table['name']).between(table['ids'][i], table['ids'][i+100], index='field0')",
+        "query": "r.db('test').table(table['name']).between(str(i), str(i+100), index='field0')",
         "tag": "between_100",
         "imax": 100
     },
     {
         "query": "r.db('test').table(table['name']).filter(r.row['boolean'])",
-        "tag": "filter_field_bool"
+        "tag": "filter_field_bool",
+        "scan": True
     },
     {
         "query": "r.db('test').table(table['name']).filter(True)",
-        "tag": "filter_field_true"
+        "tag": "filter_field_true",
+        "scan": True
     },
     {
         "query": "r.db('test').table(table['name']).filter(False)",
-        "tag": "filter_field_false"
+        "tag": "filter_field_false",
+        "scan": True
     },
     {
         "query": "r.db('test').table(table['name']).filter(r.row['missing_field'])",
-        "tag": "filter_missing_field"
+        "tag": "filter_missing_field",
+        "scan": True
     },
     {
         "query": "r.db('test').table(table['name']).filter(r.row['field0'].gt('5'))",
-        "tag": "filter_string_5"
+        "tag": "filter_string_5",
+        "scan": True
     },
     {
         "query": "r.db('test').table(table['name']).limit(100).inner_join(r.db('test').table(table['name']), lambda left, right: left['id'] == right['id'])",
-        "tag": "inner_join"
+        "tag": "inner_join",
+        "scan": True
     },
     {
         "query": "r.db('test').table(table['name']).limit(100).outer_join(r.db('test').table(table['name']), lambda left, right: left['id'] == right['id'])",
-        "tag": "outer_join"
+        "tag": "outer_join",
+        "scan": True
     },
     {
         "query": "r.db('test').table(table['name']).eq_join('id', r.db('test').table(table['name']))",
-        "tag": "eq_join"
+        "tag": "eq_join",
+        "scan": True
     },
     {
         "query": "r.db('test').table(table['name']).eq_join('id', r.db('test').table(table['name'])).zip()",
-        "tag": "eq_join_zip"
+        "tag": "eq_join_zip",
+        "scan": True
     },
     {
         "query": "r.db('test').table(table['name']).map(r.row['id'])",
-        "tag": "map_id"
+        "tag": "map_id",
+        "scan": True
     },
     {
         "query": "r.db('test').table(table['name']).with_fields('id')",
-        "tag": "with_field_id"
+        "tag": "with_field_id",
+        "scan": True
     },
     {
         "query": "r.db('test').table(table['name']).with_fields('non_existing_field')",
-        "tag": "with_field_non_existing"
+        "tag": "with_field_non_existing",
+        "scan": True
     },
     {
         "query": "r.db('test').table(table['name']).concat_map(r.row['array_num'].default([]))",
-        "tag": "concat_map_array_num"
+        "tag": "concat_map_array_num",
+        "scan": True
     },
     {
         "query": "r.db('test').table(table['name']).concat_map(r.row['array_str'].default([]))",
-        "tag": "concat_map_array_str"
+        "tag": "concat_map_array_str",
+        "scan": True
     },
     {
         "query": "r.db('test').table(table['name']).limit(900).order_by(r.row['id'])",
@@ -104,15 +134,18 @@ table_queries = [
     },
     {
         "query": "r.db('test').table(table['name']).order_by(index='id')",
-        "tag": "order_by_id_index"
+        "tag": "order_by_id_index",
+        "scan": True
     },
     {
         "query": "r.db('test').table(table['name']).skip(0)",
-        "tag": "skip_0"
+        "tag": "skip_0",
+        "scan": True
     },
     {
         "query": "r.db('test').table(table['name']).skip(100)",
-        "tag": "skip_100"
+        "tag": "skip_100",
+        "scan": True
     },
     {
         "query": "r.db('test').table(table['name']).limit(0)",
@@ -128,11 +161,13 @@ table_queries = [
     },
     {
         "query": "r.db('test').table(table['name']).has_fields('id')",
-        "tag": "has_fields_id"
+        "tag": "has_fields_id",
+        "scan": True
     },
     {
         "query": "r.db('test').table(table['name']).has_fields('missing_field')",
-        "tag": "has_fields_missing"
+        "tag": "has_fields_missing",
+        "scan": True
     },
     {
         "query": "r.db('test').table(table['name']).info()",
@@ -140,21 +175,23 @@ table_queries = [
     },
     {
         "query": "r.db('test').table(table['name']).count()",
-        "tag": "count"
+        "tag": "count",
+        "scan": True
     },
     {
-        "query": "r.db('test').table(table['name']).between(table['ids'][i], table['ids'][i+100]).count()",
+        "query": "r.db('test').table(table['name']).between(i, i+100).count()",
         "tag": "count-pk-between",
         "imax": 100
     },
     {
-        "query": "r.db('test').table(table['name']).between(table['ids'][i], table['ids'][i+100], index='field0').count()",
+        "query": "r.db('test').table(table['name']).between(str(i), str(i+100), index='field0').count()",
         "tag": "count-sindex-between",
         "imax": 100
     },
     {
         "query": "r.db('test').table(table['name']).filter(r.expr(True)).count()",
-        "tag": "filter-true-count"
+        "tag": "filter-true-count",
+        "scan": True
     }
 ]
 
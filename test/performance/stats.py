@@ -0,0 +1,87 @@
+# Copyright 2010-2014 RethinkDB, all rights reserved.
+"""
+Statistics for comparing repeated measurements of a query against a baseline.
+"""
+import math
+
+# Two-sided 95% critical values of Student's t distribution, for 1 to 30 degrees of
+# freedom.
+T_95 = [12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042]
+
+def t_critical(df):
+    """
+    The two-sided 95% critical value for `df` degrees of freedom, rounded down to a
+    whole number of degrees, which errs on the side of a wider interval
+    """
+    df = int(math.floor(df))
+    if df < 1:
+        return float("inf")
+    if df <= len(T_95):
+        return T_95[df - 1]
+    # Within 0.002 of the real values above 30 degrees of freedom
+    return 1.96 + 2.5 / df
+
+def mean(samples):
+    return sum(samples) / float(len(samples))
+
+def variance(samples):
+    if len(samples) < 2:
+        return 0.
+    m = mean(samples)
+    return sum((x - m) ** 2 for x in samples) / (len(samples) - 1)
+
+def percentile(samples, p):
+    """
+    The nearest-rank `p`th percentile of `samples`, with `p` between 0 and 100
+    """
+    ordered = sorted(samples)
+    rank = int(math.ceil(p / 100. * len(ordered)))
+    return ordered[max(rank, 1) - 1]
+
+def confidence_interval(samples):
+    """
+    The 95% confidence interval of the mean of `samples`, as (low, high)
+    """
+    m = mean(samples)
+    if len(samples) < 2:
+        return (m, m)
+    half_width = t_critical(len(samples) - 1) * math.sqrt(variance(samples) / len(samples))
+    return (m - half_width, m + half_width)
+
+def compare(baseline, current, higher_is_better, min_change):
+    """
+    Compares the means of two sets of samples with Welch's t-test. Returns a dict with
+    the relative change of the mean, the 95% confidence interval of that change, and a
+    verdict: "regression" or "improvement" if the interval excludes 0 and the change is
+    at least `min_change` (e.g. 0.05 for 5%), "same" if not, and "unknown" if there
+    are too few samples to tell.
+    """
+    base_mean = mean(baseline)
+    result = {"change": None, "low": None, "high": None, "verdict": "unknown"}
+    if len(baseline) < 2 or len(current) < 2 or base_mean == 0:
+        return result
+
+    diff = mean(current) - base_mean
+    base_var = variance(baseline) / len(baseline)
+    current_var = variance(current) / len(current)
+    se = math.sqrt(base_var + current_var)
+    if se == 0:
+        df = len(baseline) + len(current) - 2
+    else:
+        # The Welch-Satterthwaite approximation
+        df = (base_var + current_var) ** 2 / (
+            base_var ** 2 / (len(baseline) - 1) + current_var ** 2 / (len(current) - 1))
+    half_width = t_critical(df) * se
+
+    result["change"] = diff / base_mean
+    result["low"] = (diff - half_width) / base_mean
+    result["high"] = (diff + half_width) / base_mean
+    significant = result["low"] > 0 or result["high"] < 0
+    if significant and abs(result["change"]) >= min_change:
+        worse = result["change"] < 0 if higher_is_better else result["change"] > 0
+        result["verdict"] = "regression" if worse else "improvement"
+    else:
+        result["verdict"] = "same"
+    return result
@@ -1,281 +1,368 @@
 #!/usr/bin/python
-# Copyright 2010-2012 RethinkDB, all rights reserved.
+# Copyright 2010-2014 RethinkDB, all rights reserved.
 import sys
-from sys import stdout, exit, path
 import time
 import json
 import os
+import threading
+from optparse import OptionParser
+from subprocess import Popen, PIPE
 
-from util import gen_doc, gen_num_docs
-from queries import constant_queries, table_queries, write_queries, delete_queries
+from util import gen_doc
+from queries import constant_queries, table_queries, write_queries, insert_queries, delete_queries
+import stats
 
-path.insert(0, "../../drivers/python")
+sys.path.insert(0, "../../drivers/python")
 
-from os import environ
 import rethinkdb as r
 
 sys.path.append(os.path.abspath(os.path.join(os.path.dirname(__file__), os.path.pardir, 'rql_test')))
 from test_util import RethinkDBTestServers
 
 
-import pdb
-
-# We define 4 tables (small/normal cache with small/big documents
-tables = [
-    {
-        "name": "smallinmemory", # Name of the table
-        "size_doc": "small", # Small docs
-        "cache": 1024*1024*1024, #1024MB
-        "ids": [] # Used to perform get
-    },
-    {
-        "name": "smalloutmemory",
-        "size_doc": "small",
-        "cache": 1024*1024*16,
-        "ids": []
-    },
-    {
-        "name": "biginmemory",
-        "size_doc": "big",
-        "cache": 1024*1024*1024,
-        "ids": []
-    },
-    {
-        "name": "bigoutmemory",
-        "size_doc": "big",
-        "cache": 1024*1024*16,
-        "ids": []
-    }
-]
-
-# We execute each query for 60 seconds or 1000 times, whatever comes first
-time_per_query = 60 # 1 minute max per query
-executions_per_query = 1000 # 1000 executions max per query
-
-# Global variables -- so we don't have to pass them around
-results = {}
-connection = None
-
-def run_tests(build="../../build/release"):
-    global connection
-    print "Starting cluster...",
-    sys.stdout.flush()
-    with RethinkDBTestServers(1, server_build_dir=build) as servers:
-        print " Done."
-        sys.stdout.flush()
-
-        print "Connecting...",
-        sys.stdout.flush()
-
-        connection = connect(servers)
-        print " Done."
-        sys.stdout.flush()
-
-        init_tables()
-
-        # Tests
-        execute_queries()
-
-    save_compare_results()
-
+# The datasets: how many rows, and whether the documents are small or big (17-18KB)
+datasets = {
+    "1K": {"rows": 1000, "size_doc": "small"},
+    "1M": {"rows": 1000000, "size_doc": "small"},
+    "100M": {"rows": 100000000, "size_doc": "small"},
+    "30K-big": {"rows": 30000, "size_doc": "big"}
+}
+
+# Rows per insert when loading a dataset, and connections loading at once
+load_batch_size = 1000
+load_concurrency = 8
+
+results_dir = "results"
+
+
+def parse_list(option, opt_str, value, parser, convert=str):
+    setattr(parser.values, option.dest, [convert(x) for x in value.split(",")])
+
+def parse_int_list(option, opt_str, value, parser):
+    parse_list(option, opt_str, value, parser, int)
+
+def parse_options():
+    parser = OptionParser(usage="%prog [options]\n       %prog --compare-only BASELINE.json CURRENT.json")
+    parser.add_option("--build", default="../../build/release",
+                      help="the build directory of the server (default %default)")
+    parser.add_option("--datasets", type="string", action="callback", callback=parse_list,
+                      default=["1K", "1M"],
+                      help="comma-separated datasets, of " + ", ".join(sorted(datasets)) + " (default 1K,1M)")
+    parser.add_option("--concurrency", type="string", action="callback", callback=parse_int_list,
+                      default=[1, 8, 32],
+                      help="comma-separated numbers of connections running a query at once (default 1,8,32)")
+    parser.add_option("--servers", type="string", action="callback", callback=parse_int_list,
+                      default=[1, 3],
+                      help="comma-separated cluster sizes (default 1,3)")
+    parser.add_option("--runs", type="int", default=5,
+                      help="how many times to measure each query (default %default)")
+    parser.add_option("--secs", type="float", default=5,
+                      help="seconds per measurement (default %default)")
+    parser.add_option("--max-scan-rows", type="int", default=1000000,
+                      help="skip the queries that read the whole table on bigger datasets (default %default)")
+    parser.add_option("--filter", default="",
+                      help="only run the queries whose tags contain this")
+    parser.add_option("--commit", default=None,
+                      help="the name of the results file (default: the current git commit)")
+    parser.add_option("--baseline", default=None,
+                      help="the commit or results file to compare with (default: the newest other results file)")
+    parser.add_option("--min-change", type="float", default=0.05,
+                      help="the smallest relative change that counts as a regression (default %default)")
+    parser.add_option("--compare-only", action="store_true", default=False,
+                      help="compare two results files instead of running the queries")
+    options, args = parser.parse_args()
+
+    if options.compare_only:
+        if len(args) != 2:
+            parser.error("--compare-only needs a baseline and a current results file")
+    elif len(args) != 0:
+        parser.error("unexpected arguments")
+    for name in options.datasets:
+        if name not in datasets:
+            parser.error("unknown dataset %s" % name)
+    if options.runs < 2:
+        parser.error("comparisons need at least 2 runs")
+    return options, args
+
+
+def current_commit():
+    commit = Popen(["git", "rev-parse", "--short", "HEAD"], stdout=PIPE).communicate()[0].strip()
+    if Popen(["git", "diff-index", "--quiet", "HEAD", "--"]).wait() != 0:
+        commit += "-dirty"
+    return commit
+
+
+def result_key(tag, dataset, concurrency, num_servers):
+    return "%s|%s|c%d|n%d" % (tag, dataset, concurrency, num_servers)
+
+
+def measure(connections, query, env, secs, wrap=None, limit=None):
+    """
+    Runs `query` on each of the connections at once for `secs` seconds. Each
+    connection's queries get `i` = its index, then the index plus the number of
+    connections and so on, modulo `wrap` or stopping at `limit`. Returns the queries
+    per second, the 99th percentile latency in ms and the highest `i` used.
+    """
+    code = compile(query, "<query>", "eval")
+    concurrency = len(connections)
+    latencies = [[] for t in xrange(concurrency)]
+    max_i = [-1] * concurrency
+    errors = []
+    deadline = time.time() + secs
+
+    def worker(t):
+        local_env = dict(env)
+        i = t
+        try:
+            while time.time() < deadline and (limit is None or i < limit):
+                local_env["i"] = i % wrap if wrap is not None else i
+                start = time.time()
+                cursor = eval(code, local_env).run(connections[t])
+                if isinstance(cursor, r.net.Cursor):
+                    list(cursor)
+                    cursor.close()
+                latencies[t].append(time.time() - start)
+                max_i[t] = max(max_i[t], local_env["i"])
+                i += concurrency
+        except r.errors.RqlError, e:
+            errors.append(str(e))
+
+    start = time.time()
+    threads = [threading.Thread(target=worker, args=(t,)) for t in xrange(concurrency)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    elapsed = time.time() - start
+
+    if len(errors) > 0:
+        raise RuntimeError("%s failed: %s" % (query, errors[0]))
+    all_latencies = sum(latencies, [])
+    if len(all_latencies) == 0:
+        raise RuntimeError("%s never finished" % query)
+    return len(all_latencies) / elapsed, stats.percentile(all_latencies, 99) * 1000, max(max_i)
+
+
+def load_rows(connection_ports, table, first, end):
+    """
+    Inserts the rows with ids in [first, end) into the table
+    """
+    def worker(t):
+        connection = r.connect(host="localhost", port=connection_ports[t % len(connection_ports)])
+        for batch in xrange(first + t * load_batch_size, end, load_batch_size * load_concurrency):
+            docs = [gen_doc(table["size_doc"], i) for i in xrange(batch, min(batch + load_batch_size, end))]
+            r.db("test").table(table["name"]).insert(docs, upsert=True, durability="soft").run(connection)
+        connection.close()
 
-def connect(servers):
-    return r.connect(host="localhost", port=servers.driver_port())
+    threads = [threading.Thread(target=worker, args=(t,)) for t in xrange(load_concurrency)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
 
 
-def init_tables():
+def init_tables(connection, ports, names):
     """
-    Create the tables we are going to use
+    Creates and fills the tables for the datasets
     """
-    global connection, tables
-
-    print "Creating databases/tables...",
-    sys.stdout.flush()
     try:
         r.db_drop("test").run(connection)
     except r.errors.RqlRuntimeError, e:
         pass
-
     r.db_create("test").run(connection)
 
-    for table in tables:
-        r.db("test").table_create(table["name"], cache_size=table["cache"]).run(connection)
-
-    for table in tables:
+    tables = []
+    for name in names:
+        table = dict(datasets[name])
+        table["dataset"] = name
+        table["name"] = "rows_" + name.replace("-", "_")
+        print "Loading %d rows into %s..." % (table["rows"], table["name"]),
+        sys.stdout.flush()
+        r.db("test").table_create(table["name"]).run(connection)
         r.db("test").table(table["name"]).index_create("field0").run(connection)
         r.db("test").table(table["name"]).index_create("field1").run(connection)
-
-    print " Done."
-    sys.stdout.flush()
-
+        load_rows(ports, table, 0, table["rows"])
+        r.db("test").table(table["name"]).index_wait().run(connection)
+        r.db("test").table(table["name"]).sync().run(connection)
+        print " Done."
+        sys.stdout.flush()
+        tables.append(table)
+    return tables
 
 
-def execute_queries():
+def run_terms(options, connections, ports, tables, num_servers, results):
     """
-    Execute all the queries (inserts/update, reads, terms, delete)
+    Measures every query once on the given connections, and adds the results to
+    `results`
     """
-    global results, connection, time_per_query, executions_per_query, constant_queries
-
-    print "Running inserts...",
-    sys.stdout.flush()
-    for table in tables:
-        docs = []
-        num_writes = gen_num_docs(table["size_doc"])
-        for i in xrange(num_writes):
-            docs.append(gen_doc(table["size_doc"], i))
-
-        start = time.time()
-        
-        i = 0
-        while (time.time()-start < time_per_query) & (i < num_writes):
-            result = r.db('test').table(table['name']).insert(docs[i]).run(connection)
-            if "generated_keys" in result:
-                table["ids"].append(result["generated_keys"][0])
-            i += 1
-
-        results["single-inserts-"+table["name"]] = i/(time.time()-start)
-
-        # Save it to know how many batch inserts we did
-        single_inserts = i
-
-        # Finish inserting the remaining data
-        size_batch = 500
-        if i < num_writes:
-            while i+size_batch < num_writes:
-                resutl = r.db('test').table(table['name']).insert(docs[i:i+size_batch]).run(connection)
-                table["ids"] += result["generated_keys"]
-                i += size_batch
-
-            if i < num_writes:
-                result = r.db('test').table(table['name']).insert(docs[i:len(docs)]).run(connection)
-                table["ids"] += result["generated_keys"]
-
-        results["batch-inserts-"+table["name"]] = (len(docs)-single_inserts)/(time.time()-start)
-    
-        table["ids"].sort()
-        
-    print " Done."
-    sys.stdout.flush()
-
-
-    # Execute the insert queries
-    print "Running update/replace...",
-    sys.stdout.flush()
-    for table in tables:
-        for p in xrange(len(write_queries)):
-            docs = []
-            num_writes = gen_num_docs(table["size_doc"])
-            for i in xrange(num_writes):
-                docs.append(gen_doc(table["size_doc"], i))
-
-            start = time.time()
-
-            i = 0
-            while (time.time()-start < time_per_query) & (i < write_queries):
-                eval(write_queries[p]["query"]).run(connection)
-                results[write_queries[p]["tag"]+"-"+table["name"]] = i/(time.time()-start)
+    concurrency = len(connections)
 
-            # Clean the update
-            eval(write_queries[p]["clean"]).run(connection)
+    def record(tag, dataset, qps, p99):
+        entry = results.setdefault(result_key(tag, dataset, concurrency, num_servers),
+                                   {"throughput": [], "p99_ms": []})
+        entry["throughput"].append(qps)
+        entry["p99_ms"].append(p99)
 
-    print " Done."
-    sys.stdout.flush()
+    def selected(tag):
+        return options.filter in tag
 
-
-    # Execute the read queries on every tables
-    print "Running reads...",
-    sys.stdout.flush()
     for table in tables:
-        for p in xrange(len(table_queries)):
-            start = time.time()
-            count = 0
-            i = 0
-            if "imax" in table_queries[p]:
-                max_i = table_queries[p]["imax"]+1
-            else:
-                max_i = 1
-
-            while (time.time()-start < time_per_query) & (count < executions_per_query):
-                try:
-                    cursor = eval(table_queries[p]["query"]).run(connection)
-                    if isinstance(cursor, r.net.Cursor):
-                        list(cursor)
-                        cursor.close()
-
-                    if i >= len(table["ids"])-max_i:
-                        i = 0
-                    else:
-                         i+= 1
-                except:
-                    print "Query failed"
-                    print constant_queries[p]
+        env = {"r": r, "table": table, "doc": lambda i, size_doc=table["size_doc"]: gen_doc(size_doc, i)}
+        for query in table_queries:
+            if not selected(query["tag"]):
+                continue
+            if query.get("scan", False) and table["rows"] > options.max_scan_rows:
+                continue
+            wrap = table["rows"] - query.get("imax", 0)
+            qps, p99, max_i = measure(connections, query["query"], env, options.secs, wrap=wrap)
+            record(query["tag"], table["dataset"], qps, p99)
+
+        for query in write_queries:
+            if not selected(query["tag"]):
+                continue
+            qps, p99, max_i = measure(connections, query["query"], env, options.secs, limit=table["rows"])
+            record(query["tag"], table["dataset"], qps, p99)
+            if max_i >= 0:
+                eval(query["clean"], dict(env, i=max_i)).run(connections[0])
+
+        for query in insert_queries:
+            if not selected(query["tag"]):
+                continue
+            qps, p99, max_i = measure(connections, query["query"], env, options.secs)
+            record(query["tag"], table["dataset"], qps, p99)
+            eval(query["clean"], env).run(connections[0])
+
+        for query in delete_queries:
+            if not selected(query["tag"]):
+                continue
+            qps, p99, max_i = measure(connections, query["query"], env, options.secs, limit=table["rows"])
+            record(query["tag"], table["dataset"], qps, p99)
+            load_rows(ports, table, 0, max_i + 1)
+
+    for query in constant_queries:
+        if type(query) == type(""):
+            query = {"query": query, "tag": query}
+        if not selected(query["tag"]):
+            continue
+        qps, p99, max_i = measure(connections, query["query"], {"r": r}, options.secs)
+        record(query["tag"], "-", qps, p99)
+
+
+def run_tests(options):
+    results = {}
+    for num_servers in options.servers:
+        print "Starting a cluster of %d servers..." % num_servers,
+        sys.stdout.flush()
+        with RethinkDBTestServers(num_servers, server_build_dir=options.build) as servers:
+            print " Done."
+            sys.stdout.flush()
+            ports = [server.cpp_port for server in servers.servers]
+            connection = r.connect(host="localhost", port=ports[0])
+            tables = init_tables(connection, ports, options.datasets)
+
+            for concurrency in options.concurrency:
+                # Spread the connections over the servers
+                connections = [r.connect(host="localhost", port=ports[t % len(ports)])
+                               for t in xrange(concurrency)]
+                # Each run measures every query once, so that a slow spell of the
+                # machine doesn't land on all the runs of one query.
+                for run in xrange(options.runs):
+                    print "Running queries on %d servers with %d connections, run %d of %d..." % (
+                        num_servers, concurrency, run + 1, options.runs),
                     sys.stdout.flush()
-                    break
-
-                count+=1
-
-            results[table_queries[p]["tag"]+"-"+table["name"]] = count/(time.time()-start)
-
-    print " Done."
-    sys.stdout.flush()
-
-
-    # Execute the queries that do not require a table
-    print "Running constant queries...",
-    sys.stdout.flush()
-    for p in xrange(len(constant_queries)):
-        start = time.time()
-        count = 0
-        while (time.time()-start < time_per_query) & (count < executions_per_query):
-            if type(constant_queries[p]) == type(""):
-                try:
-                    cursor = eval(constant_queries[p]).run(connection)
-                    if isinstance(cursor, r.net.Cursor):
-                        list(cursor)
-                        cursor.close()
-                except:
-                    print "Query failed"
-                    print constant_queries[p]
+                    run_terms(options, connections, ports, tables, num_servers, results)
+                    print " Done."
                     sys.stdout.flush()
-            else:
-                cursor = eval(constant_queries[p]["query"]).run(connection)
-                if isinstance(cursor, r.net.Cursor):
-                    list(cursor)
-                    cursor.close()
-            count+=1
-
-        if type(constant_queries[p]) == type(""):
-            results[constant_queries[p]] = count/(time.time()-start)
-        else:
-            results[constant_queries[p]["tag"]] = count/(time.time()-start)
+                for c in connections:
+                    c.close()
+            connection.close()
+    return results
 
-    print " Done."
-    sys.stdout.flush()
 
+def save_results(options, results):
+    """
+    Saves the results in results/<commit>.json, and returns the path
+    """
+    commit = options.commit or current_commit()
+    if not os.path.exists(results_dir):
+        os.makedirs(results_dir)
+    path = os.path.join(results_dir, commit + ".json")
+    f = open(path, "w")
+    json.dump({
+        "commit": commit,
+        "date": time.strftime("%Y-%m-%dT%H:%M:%S"),
+        "options": {
+            "datasets": options.datasets,
+            "concurrency": options.concurrency,
+            "servers": options.servers,
+            "runs": options.runs,
+            "secs": options.secs
+        },
+        "results": results
+    }, f, indent=2, sort_keys=True)
+    f.close()
+    return path
 
-    # Execute the delete queries
-    print "Running delete...",
-    sys.stdout.flush()
-    for table in tables:
-        for p in xrange(len(delete_queries)):
-            start = time.time()
-
-            i = 0
-            while (time.time()-start < time_per_query) & (i < len(table["ids"])):
-                eval(delete_queries[p]["query"]).run(connection)
-
-            results[delete_queries[p]["tag"]+"-"+table["name"]] = i/(time.time()-start)
-
-    print " Done."
-    sys.stdout.flush()
 
+def load_results(path):
+    f = open(path, "r")
+    data = json.load(f)
+    f.close()
+    return data
 
 
-def stop_cluster(cluster):
+def find_baseline(options, current_path):
+    """
+    The results file named by --baseline, or else the newest other one
     """
-    Stop the cluster
+    if options.baseline is not None:
+        if os.path.exists(options.baseline):
+            return options.baseline
+        return os.path.join(results_dir, options.baseline + ".json")
+    newest = None
+    for filename in os.listdir(results_dir):
+        path = os.path.join(results_dir, filename)
+        if not filename.endswith(".json") or os.path.abspath(path) == os.path.abspath(current_path):
+            continue
+        date = load_results(path)["date"]
+        if newest is None or date > newest[0]:
+            newest = (date, path)
+    return newest[1] if newest is not None else None
+
+
+def format_change(comparison):
+    if comparison["change"] is None:
+        return "%24s" % "-"
+    return "%+7.1f%% [%+6.1f%%, %+6.1f%%]" % (
+        comparison["change"] * 100, comparison["low"] * 100, comparison["high"] * 100)
+
+
+def compare_results(baseline, current, min_change):
     """
-    cluster.check_and_stop()
+    Prints the change of each query's throughput and p99 latency, with its 95%
+    confidence interval. Returns the number of regressions.
+    """
+    print "Comparing %s with %s (changes of at least %.0f%% count):" % (
+        current["commit"], baseline["commit"], min_change * 100)
+    print "%-50s %-28s %-28s %s" % ("Query|dataset|connections|servers", "Throughput", "p99 latency", "")
+    regressions = 0
+    for key in sorted(current["results"]):
+        if key not in baseline["results"]:
+            continue
+        old, new = baseline["results"][key], current["results"][key]
+        throughput = stats.compare(old["throughput"], new["throughput"], True, min_change)
+        latency = stats.compare(old["p99_ms"], new["p99_ms"], False, min_change)
+        verdicts = [v for v in (throughput["verdict"], latency["verdict"]) if v in ("regression", "improvement")]
+        status = ""
+        if "regression" in verdicts:
+            status = "REGRESSION"
+            regressions += 1
+        elif len(verdicts) > 0:
+            status = "improvement"
+        print "%-50s %-28s %-28s %s" % (key[:50], format_change(throughput), format_change(latency), status)
+    print "%d regressions." % regressions
+    return regressions
+
 
 def check_driver():
     """
@@ -285,91 +372,29 @@ def check_driver():
     if r.protobuf_implementation == 'py':
         print "Please install the C++ backend for the tests."
         sys.stdout.flush()
-        exit(1)
-
-
-def save_compare_results():
-    """
-    Save the current results, and if previous results are available, generate an HTML page with the differences
-    """
-    global results, str_date
-
-    # Save results
-    if not os.path.exists("results"):
-        os.makedirs("results")
-    str_date = time.strftime("%y.%m.%d-%H:%M:%S")
-    f = open("results/result_"+str_date+".txt", "w")
-    str_res = json.dumps(results, indent=2)
-    f.write(str_res)
-    f.close()
-
-    # Read all the previous results stored in results/
-    file_paths = []
-    for root, directories, files in os.walk("results/"):
-        for filename in files:
-            # Join the two strings in order to form the full filepath.
-            filepath = os.path.join(root, filename) 
-            file_paths.append(filepath)  # Add it to the list.
-
-    # Sort files, we just need the last one (the most recent one)
-    file_paths.sort()
-    if len(file_paths) > 1:
-        last_file = file_paths[-2] #The last file is the one we just saved
-
-        f = open(last_file, "r")
-        previous_results = json.loads(f.read())
-        f.close()
-    else:
-        previous_results = {}
-
-    if not os.path.exists("comparisons"):
-        os.makedirs("comparisons")
-
-    f = open("comparisons/comparison_"+str_date+".html", "w")
-    f.write("<html><head><style>table{padding: 0px; margin: 0px;border-collapse:collapse;}\ntd{border: 1px solid #000; padding: 5px 8px; margin: 0px; text-align: right;}</style></head><body><table>")
-    f.write("<tr><td>Query</td><td>Previous q/s</td><td>q/s</td><td>Previous ms/q</td><td>ms/q</td><td>Diff</td><td>Status</td></tr>")
-    for key in sorted(results):
-        if key in previous_results:
-            if results[key] > 0:
-                diff = 1.*(previous_results[key]-results[key])/(results[key])
-            else:
-                diff = "undefined"
-
-            if (type(diff) == type(0.)):
-                if(diff < 0.2):
-                    status = "Success"
-                    color = "green"
-                else:
-                    status = "Fail"
-                    color = "red"
-            else:
-                status = "Bug"
-                color = "gray"
-            try:
-                f.write("<tr><td>"+str(key)[:50]+"</td><td>%.2f</td><td>%.2f</td><td>%.2f</td><td>%.2f</td><td>%.4f</td>"%(previous_results[key], results[key], 1000/previous_results[key], 1000/results[key], diff)+"<td style='background: "+str(color)+"'>"+str(status)+"</td></tr>")
-            except:
-                print key
-
-        else:
-            status = "Unknown"
-            color = "gray"
-
-            try:
-                f.write("<tr><td>"+str(key)[:50]+"</td><td>Unknown</td><td>%.2f</td><td>Unknown</td><td>%.2f</td><td>Unknown</td>"%(results[key], 1000/results[key])+"<td style='background: "+str(color)+"'>"+str(status)+"</td></tr>")
-            except:
-                print key
-
-
-    f.write("</table></body></html>")
-    f.close()
+        sys.exit(1)
 
 
 def main():
     """
     Main method
     """
+    options, args = parse_options()
+    if options.compare_only:
+        regressions = compare_results(load_results(args[0]), load_results(args[1]), options.min_change)
+        sys.exit(1 if regressions > 0 else 0)
+
     check_driver()
-    run_tests()
+    results = run_tests(options)
+    path = save_results(options, results)
+    print "Saved the results in %s." % path
+
+    baseline_path = find_baseline(options, path)
+    if baseline_path is None:
+        print "No baseline to compare with."
+        return
+    regressions = compare_results(load_results(baseline_path), load_results(path), options.min_change)
+    sys.exit(1 if regressions > 0 else 0)
 
 if __name__ == "__main__":
     main()